@@ -0,0 +1,67 @@
+/**
+ * @file log_bench.cpp
+ * @brief Write-ahead log benchmarks
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+#include "common/value.hpp"
+#include "executor/types.hpp"
+#include "recovery/log_manager.hpp"
+#include "recovery/log_record.hpp"
+#include "storage/heap_table.hpp"
+
+using namespace cloudsql;
+using namespace cloudsql::recovery;
+
+namespace {
+
+const char* const LOG_FILE = "./bench_data/bench_wal.log";
+
+LogRecord insert_record(txn_id_t txn_id) {
+    return LogRecord(txn_id, -1, LogRecordType::INSERT, "bench_table",
+                     storage::HeapTable::TupleId(static_cast<uint32_t>(txn_id), 1),
+                     executor::Tuple({common::Value::make_int64(static_cast<int64_t>(txn_id)),
+                                      common::Value::make_text("payload")}));
+}
+
+/** Appends into the WAL buffer only; the buffer flushes when it fills */
+void BM_LogAppend(benchmark::State& state) {
+    std::filesystem::create_directories("./bench_data");
+    static_cast<void>(std::remove(LOG_FILE));
+    LogManager log(LOG_FILE);
+
+    txn_id_t txn_id = 1;
+    for (auto _ : state) {
+        LogRecord record = insert_record(txn_id++);
+        benchmark::DoNotOptimize(log.append_log_record(record));
+    }
+    log.flush(true);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LogAppend);
+
+/** Arg: records appended per forced flush, i.e. the group size of a commit */
+void BM_LogAppendFlush(benchmark::State& state) {
+    std::filesystem::create_directories("./bench_data");
+    static_cast<void>(std::remove(LOG_FILE));
+    LogManager log(LOG_FILE);
+
+    txn_id_t txn_id = 1;
+    for (auto _ : state) {
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            LogRecord record = insert_record(txn_id++);
+            static_cast<void>(log.append_log_record(record));
+        }
+        log.flush(true);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LogAppendFlush)->Arg(1)->Arg(64)->UseRealTime();
+
+}  // namespace
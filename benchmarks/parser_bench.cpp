@@ -0,0 +1,95 @@
+/**
+ * @file parser_bench.cpp
+ * @brief Lexer, parser and RPC serializer benchmarks
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/value.hpp"
+#include "executor/types.hpp"
+#include "network/rpc_message.hpp"
+#include "parser/lexer.hpp"
+#include "parser/parser.hpp"
+#include "parser/token.hpp"
+
+using namespace cloudsql;
+
+namespace {
+
+const char* const QUERY =
+    "SELECT o.id, u.name, SUM(o.amount) FROM orders o JOIN users u ON o.user_id = u.id "
+    "WHERE o.amount > 100 AND u.name <> 'bob' GROUP BY o.id, u.name ORDER BY o.id LIMIT 50";
+
+void BM_Lexer(benchmark::State& state) {
+    const std::string query = QUERY;
+    for (auto _ : state) {
+        parser::Lexer lexer(query);
+        size_t tokens = 0;
+        while (lexer.next_token().type() != parser::TokenType::End) {
+            ++tokens;
+        }
+        benchmark::DoNotOptimize(tokens);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(query.size()));
+}
+BENCHMARK(BM_Lexer);
+
+void BM_Parser(benchmark::State& state) {
+    const std::string query = QUERY;
+    for (auto _ : state) {
+        parser::Parser parser(std::make_unique<parser::Lexer>(query));
+        auto stmt = parser.parse_statement();
+        benchmark::DoNotOptimize(stmt);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Parser);
+
+std::vector<executor::Tuple> serializer_rows(int64_t count) {
+    std::vector<executor::Tuple> rows;
+    rows.reserve(static_cast<size_t>(count));
+    for (int64_t i = 0; i < count; ++i) {
+        rows.emplace_back(std::vector<common::Value>{
+            common::Value::make_int64(i), common::Value::make_float64(static_cast<double>(i) * 0.5),
+            common::Value::make_text("row_" + std::to_string(i % 100))});
+    }
+    return rows;
+}
+
+/** Args: row count, and 1 for the columnar encoding */
+void BM_SerializerEncode(benchmark::State& state) {
+    const auto rows = serializer_rows(state.range(0));
+    const bool columnar = state.range(1) != 0;
+    std::vector<uint8_t> out;
+    for (auto _ : state) {
+        out.clear();
+        network::Serializer::serialize_rows(rows, out, columnar);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["bytes_per_row"] =
+        static_cast<double>(out.size()) / static_cast<double>(state.range(0));
+}
+BENCHMARK(BM_SerializerEncode)->Args({1024, 0})->Args({1024, 1});
+
+void BM_SerializerDecode(benchmark::State& state) {
+    const bool columnar = state.range(1) != 0;
+    std::vector<uint8_t> encoded;
+    network::Serializer::serialize_rows(serializer_rows(state.range(0)), encoded, columnar);
+    for (auto _ : state) {
+        size_t offset = 0;
+        auto rows = network::Serializer::deserialize_rows(encoded.data(), offset, encoded.size(),
+                                                          columnar);
+        benchmark::DoNotOptimize(rows);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SerializerDecode)->Args({1024, 0})->Args({1024, 1});
+
+}  // namespace
@@ -0,0 +1,244 @@
+/**
+ * @file pg_client.hpp
+ * @brief Minimal blocking PostgreSQL wire protocol client for the workload driver
+ */
+
+#ifndef CLOUDSQL_BENCHMARKS_PG_CLIENT_HPP
+#define CLOUDSQL_BENCHMARKS_PG_CLIENT_HPP
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cloudsql::bench {
+
+/**
+ * @brief Outcome of one simple-protocol query
+ */
+struct QueryResult {
+    bool ok = false;
+    std::string error; /**< Server message or connection failure, when !ok */
+    std::vector<std::vector<std::optional<std::string>>> rows; /**< Text values; nullopt = NULL */
+};
+
+/**
+ * @class PgConnection
+ * @brief One client session speaking the simple query protocol
+ *
+ * Enough of the protocol for load generation: the v3 startup handshake, 'Q'
+ * queries, and the DataRow / ErrorResponse / ReadyForQuery replies. Every
+ * query blocks until the server is ready for the next one.
+ */
+class PgConnection {
+   public:
+    PgConnection() = default;
+    ~PgConnection() { close(); }
+
+    PgConnection(const PgConnection&) = delete;
+    PgConnection& operator=(const PgConnection&) = delete;
+    PgConnection(PgConnection&& other) noexcept : fd_(other.fd_), buffer_(std::move(other.buffer_)) {
+        other.fd_ = -1;
+    }
+    PgConnection& operator=(PgConnection&&) = delete;
+
+    /**
+     * @brief Connect and complete the startup handshake
+     */
+    bool connect(const std::string& host, uint16_t port) {
+        close();
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addrs = nullptr;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addrs) != 0) {
+            return false;
+        }
+        fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        const bool connected =
+            fd_ >= 0 && ::connect(fd_, addrs->ai_addr, addrs->ai_addrlen) == 0;
+        freeaddrinfo(addrs);
+        if (!connected) {
+            close();
+            return false;
+        }
+        int one = 1;
+        static_cast<void>(setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)));
+
+        /* Length, protocol 3.0, "user" parameter, terminator */
+        std::vector<char> startup(8);
+        const uint32_t protocol = htonl(PROTOCOL_V3);
+        std::memcpy(startup.data() + 4, &protocol, 4);
+        for (const char* s : {"user", "cloudsql"}) {
+            startup.insert(startup.end(), s, s + std::strlen(s) + 1);
+        }
+        startup.push_back('\0');
+        const uint32_t len = htonl(static_cast<uint32_t>(startup.size()));
+        std::memcpy(startup.data(), &len, 4);
+        if (!send_all(startup.data(), startup.size())) {
+            close();
+            return false;
+        }
+        QueryResult ignored;
+        if (!read_until_ready(ignored)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool connected() const { return fd_ >= 0; }
+
+    /**
+     * @brief Run one statement (or several, ';'-separated) and collect its rows
+     */
+    QueryResult query(const std::string& sql) {
+        QueryResult result;
+        if (fd_ < 0) {
+            result.error = "not connected";
+            return result;
+        }
+        std::vector<char> msg(5);
+        msg[0] = 'Q';
+        msg.insert(msg.end(), sql.begin(), sql.end());
+        msg.push_back('\0');
+        const uint32_t len = htonl(static_cast<uint32_t>(msg.size() - 1));
+        std::memcpy(msg.data() + 1, &len, 4);
+        if (!send_all(msg.data(), msg.size()) || !read_until_ready(result)) {
+            result.ok = false;
+            result.error = "connection lost";
+            close();
+            return result;
+        }
+        return result;
+    }
+
+    void close() {
+        if (fd_ >= 0) {
+            const std::array<char, 5> terminate = {'X', 0, 0, 0, 4};
+            static_cast<void>(::send(fd_, terminate.data(), terminate.size(), MSG_NOSIGNAL));
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+   private:
+    static constexpr uint32_t PROTOCOL_V3 = 196608;
+
+    bool send_all(const char* data, size_t size) const {
+        while (size > 0) {
+            const ssize_t n = ::send(fd_, data, size, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool recv_exact(char* out, size_t size) {
+        while (size > 0) {
+            const ssize_t n = ::recv(fd_, out, size, 0);
+            if (n <= 0) {
+                return false;
+            }
+            out += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    /** @brief Consume replies up to ReadyForQuery, filling `result` */
+    bool read_until_ready(QueryResult& result) {
+        result.ok = true;
+        for (;;) {
+            std::array<char, 5> header{};
+            if (!recv_exact(header.data(), header.size())) {
+                return false;
+            }
+            uint32_t len = 0;
+            std::memcpy(&len, header.data() + 1, 4);
+            len = ntohl(len);
+            if (len < 4) {
+                return false;
+            }
+            buffer_.resize(len - 4);
+            if (!recv_exact(buffer_.data(), buffer_.size())) {
+                return false;
+            }
+            switch (header[0]) {
+                case 'D':
+                    result.rows.push_back(parse_data_row());
+                    break;
+                case 'E':
+                    result.ok = false;
+                    result.error = parse_error();
+                    break;
+                case 'Z':
+                    return true;
+                default:
+                    break; /* Auth, parameters, row descriptions, completions */
+            }
+        }
+    }
+
+    std::vector<std::optional<std::string>> parse_data_row() const {
+        std::vector<std::optional<std::string>> row;
+        size_t pos = 0;
+        uint16_t cols = 0;
+        if (buffer_.size() < 2) {
+            return row;
+        }
+        std::memcpy(&cols, buffer_.data(), 2);
+        cols = ntohs(cols);
+        pos = 2;
+        for (uint16_t c = 0; c < cols && pos + 4 <= buffer_.size(); ++c) {
+            uint32_t raw = 0;
+            std::memcpy(&raw, buffer_.data() + pos, 4);
+            pos += 4;
+            const auto value_len = static_cast<int32_t>(ntohl(raw));
+            if (value_len < 0) {
+                row.emplace_back(std::nullopt);
+                continue;
+            }
+            const size_t n = std::min(static_cast<size_t>(value_len), buffer_.size() - pos);
+            row.emplace_back(std::string(buffer_.data() + pos, n));
+            pos += n;
+        }
+        return row;
+    }
+
+    /** @return The 'M' (message) field of an ErrorResponse */
+    std::string parse_error() const {
+        size_t pos = 0;
+        while (pos < buffer_.size() && buffer_[pos] != '\0') {
+            const char field = buffer_[pos++];
+            const size_t end = std::min(buffer_.size(), pos + std::strlen(buffer_.data() + pos));
+            if (field == 'M') {
+                return std::string(buffer_.data() + pos, end - pos);
+            }
+            pos = end + 1;
+        }
+        return "error";
+    }
+
+    int fd_ = -1;
+    std::vector<char> buffer_;
+};
+
+}  // namespace cloudsql::bench
+
+#endif  // CLOUDSQL_BENCHMARKS_PG_CLIENT_HPP
@@ -0,0 +1,187 @@
+/**
+ * @file storage_bench.cpp
+ * @brief Buffer pool, heap table and B+ tree index benchmarks
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/value.hpp"
+#include "executor/types.hpp"
+#include "storage/btree_index.hpp"
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/heap_table.hpp"
+#include "storage/storage_manager.hpp"
+
+using namespace cloudsql;
+using namespace cloudsql::storage;
+
+namespace {
+
+const char* const DATA_DIR = "./bench_data";
+
+/* Shared by the threads of the contention benchmark, set up by thread 0 */
+std::unique_ptr<StorageManager> shared_disk;
+std::unique_ptr<BufferPoolManager> shared_bpm;
+
+constexpr uint32_t CONTENTION_PAGES = 64;
+
+void reset_data_dir() {
+    std::filesystem::remove_all(DATA_DIR);
+    std::filesystem::create_directories(DATA_DIR);
+}
+
+/**
+ * Fetch and unpin of resident pages from several threads: measures latch
+ * contention on the page table, not I/O. Arg: buffer pool partitions.
+ */
+void BM_BufferPoolFetchUnpin(benchmark::State& state) {
+    const std::string file = "bench_bpm.db";
+    if (state.thread_index() == 0) {
+        reset_data_dir();
+        shared_disk = std::make_unique<StorageManager>(DATA_DIR);
+        shared_bpm = std::make_unique<BufferPoolManager>(
+            CONTENTION_PAGES * 2, *shared_disk, nullptr, static_cast<size_t>(state.range(0)));
+        for (uint32_t i = 0; i < CONTENTION_PAGES; ++i) {
+            uint32_t page_id = i;
+            static_cast<void>(shared_bpm->new_page(file, &page_id));
+            static_cast<void>(shared_bpm->unpin_page(file, page_id, true));
+        }
+    }
+
+    uint32_t page_id = static_cast<uint32_t>(state.thread_index());
+    for (auto _ : state) {
+        Page* const page = shared_bpm->fetch_page(file, page_id);
+        benchmark::DoNotOptimize(page);
+        static_cast<void>(shared_bpm->unpin_page(file, page_id, false));
+        page_id = (page_id + 7) % CONTENTION_PAGES;
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0) {
+        shared_bpm.reset();
+        shared_disk.reset();
+    }
+}
+BENCHMARK(BM_BufferPoolFetchUnpin)->Arg(1)->Arg(8)->ThreadRange(1, 8)->UseRealTime();
+
+executor::Schema heap_schema() {
+    executor::Schema schema;
+    schema.add_column("id", common::ValueType::TYPE_INT64);
+    schema.add_column("name", common::ValueType::TYPE_TEXT);
+    return schema;
+}
+
+executor::Tuple heap_row(int64_t i) {
+    return executor::Tuple({common::Value::make_int64(i),
+                            common::Value::make_text("name_" + std::to_string(i))});
+}
+
+void BM_HeapTableInsert(benchmark::State& state) {
+    reset_data_dir();
+    StorageManager disk(DATA_DIR);
+    BufferPoolManager bpm(256, disk);
+    HeapTable table("bench_heap_insert", bpm, heap_schema());
+    static_cast<void>(table.create());
+
+    int64_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.insert(heap_row(i++)));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HeapTableInsert);
+
+/** Arg: rows in the table; one iteration is a full scan */
+void BM_HeapTableScan(benchmark::State& state) {
+    reset_data_dir();
+    StorageManager disk(DATA_DIR);
+    BufferPoolManager bpm(1024, disk);
+    HeapTable table("bench_heap_scan", bpm, heap_schema());
+    static_cast<void>(table.create());
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        static_cast<void>(table.insert(heap_row(i)));
+    }
+
+    for (auto _ : state) {
+        auto it = table.scan();
+        executor::Tuple tuple;
+        int64_t rows = 0;
+        while (it.next(tuple)) {
+            ++rows;
+        }
+        benchmark::DoNotOptimize(rows);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HeapTableScan)->Arg(1000)->Arg(50000);
+
+void BM_HeapTableGet(benchmark::State& state) {
+    reset_data_dir();
+    StorageManager disk(DATA_DIR);
+    BufferPoolManager bpm(1024, disk);
+    HeapTable table("bench_heap_get", bpm, heap_schema());
+    static_cast<void>(table.create());
+    std::vector<HeapTable::TupleId> ids;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        ids.push_back(table.insert(heap_row(i)));
+    }
+
+    size_t next = 0;
+    executor::Tuple tuple;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.get(ids[next], tuple));
+        next = (next + 7919) % ids.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HeapTableGet)->Arg(50000);
+
+void BM_BTreeIndexInsert(benchmark::State& state) {
+    reset_data_dir();
+    StorageManager disk(DATA_DIR);
+    BufferPoolManager bpm(1024, disk);
+    BTreeIndex index("bench_idx_insert", bpm, common::ValueType::TYPE_INT64);
+    static_cast<void>(index.create());
+
+    uint64_t key = 0;
+    for (auto _ : state) {
+        /* Multiplicative hash: random order without duplicates */
+        const auto scrambled = static_cast<int64_t>((key * 2654435761ULL) & 0xFFFFFFFFULL);
+        benchmark::DoNotOptimize(index.insert(
+            common::Value::make_int64(scrambled),
+            HeapTable::TupleId(static_cast<uint32_t>(key / 64) + 1, static_cast<uint16_t>(key % 64))));
+        ++key;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BTreeIndexInsert);
+
+void BM_BTreeIndexSearch(benchmark::State& state) {
+    reset_data_dir();
+    StorageManager disk(DATA_DIR);
+    BufferPoolManager bpm(1024, disk);
+    BTreeIndex index("bench_idx_search", bpm, common::ValueType::TYPE_INT64);
+    static_cast<void>(index.create());
+    const int64_t keys = state.range(0);
+    for (int64_t i = 0; i < keys; ++i) {
+        static_cast<void>(index.insert(common::Value::make_int64(i),
+                                       HeapTable::TupleId(static_cast<uint32_t>(i / 64) + 1,
+                                                          static_cast<uint16_t>(i % 64))));
+    }
+
+    int64_t key = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(index.search(common::Value::make_int64(key)));
+        key = (key + 7919) % keys;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BTreeIndexSearch)->Arg(100000);
+
+}  // namespace
@@ -0,0 +1,178 @@
+/**
+ * @file vectorized_bench.cpp
+ * @brief Vectorized operator benchmarks over synthetic columnar tables
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/value.hpp"
+#include "executor/types.hpp"
+#include "executor/vectorized_operator.hpp"
+#include "parser/expression.hpp"
+#include "parser/token.hpp"
+#include "storage/columnar_table.hpp"
+#include "storage/storage_manager.hpp"
+
+using namespace cloudsql;
+using namespace cloudsql::executor;
+using namespace cloudsql::parser;
+
+namespace {
+
+const char* const DATA_DIR = "./bench_data";
+constexpr int64_t GROUPS = 64;
+
+/**
+ * @brief Columnar table of `rows` rows: id, grp (id % GROUPS), amount (float)
+ */
+std::shared_ptr<storage::ColumnarTable> make_table(storage::StorageManager& disk,
+                                                   const std::string& name, int64_t rows) {
+    Schema schema;
+    schema.add_column("id", common::ValueType::TYPE_INT64);
+    schema.add_column("grp", common::ValueType::TYPE_INT64);
+    schema.add_column("amount", common::ValueType::TYPE_FLOAT64);
+
+    auto table = std::make_shared<storage::ColumnarTable>(name, disk, schema);
+    static_cast<void>(table->create());
+    static_cast<void>(table->open());
+
+    constexpr int64_t BATCH_ROWS = 1024;
+    for (int64_t start = 0; start < rows; start += BATCH_ROWS) {
+        auto batch = VectorBatch::create(schema);
+        for (int64_t i = start; i < rows && i < start + BATCH_ROWS; ++i) {
+            batch->append_tuple(Tuple({common::Value::make_int64(i),
+                                       common::Value::make_int64(i % GROUPS),
+                                       common::Value::make_float64(static_cast<double>(i % 1000))}));
+        }
+        static_cast<void>(table->append_batch(*batch));
+    }
+    return table;
+}
+
+/** @return Rows the operator produced, draining it batch by batch */
+int64_t drain(VectorizedOperator& op) {
+    auto batch = VectorBatch::create(op.output_schema());
+    int64_t rows = 0;
+    while (op.next_batch(*batch)) {
+        rows += static_cast<int64_t>(batch->row_count());
+        batch->clear();
+    }
+    return rows;
+}
+
+/** @return DATA_DIR, emptied of earlier runs */
+const char* fresh_data_dir() {
+    std::filesystem::remove_all(DATA_DIR);
+    return DATA_DIR;
+}
+
+/** Shared set-up: a fresh data directory and one table of range(0) rows */
+struct Fixture {
+    explicit Fixture(int64_t rows)
+        : disk(fresh_data_dir()),
+          table(make_table(disk, "bench_fact", rows)) {}
+
+    storage::StorageManager disk;
+    std::shared_ptr<storage::ColumnarTable> table;
+};
+
+std::unique_ptr<Expression> amount_above(double bound) {
+    return std::make_unique<BinaryExpr>(std::make_unique<ColumnExpr>("amount"), TokenType::Gt,
+                                        std::make_unique<ConstantExpr>(
+                                            common::Value::make_float64(bound)));
+}
+
+void BM_VectorizedSeqScan(benchmark::State& state) {
+    Fixture fx(state.range(0));
+    for (auto _ : state) {
+        VectorizedSeqScanOperator scan("bench_fact", fx.table);
+        benchmark::DoNotOptimize(drain(scan));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_VectorizedSeqScan)->Arg(100000);
+
+void BM_VectorizedFilter(benchmark::State& state) {
+    Fixture fx(state.range(0));
+    for (auto _ : state) {
+        VectorizedFilterOperator filter(
+            std::make_unique<VectorizedSeqScanOperator>("bench_fact", fx.table),
+            amount_above(500.0));
+        benchmark::DoNotOptimize(drain(filter));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_VectorizedFilter)->Arg(100000);
+
+void BM_VectorizedProject(benchmark::State& state) {
+    Fixture fx(state.range(0));
+    for (auto _ : state) {
+        Schema out;
+        out.add_column("scaled", common::ValueType::TYPE_FLOAT64);
+        std::vector<std::unique_ptr<Expression>> exprs;
+        exprs.push_back(std::make_unique<BinaryExpr>(
+            std::make_unique<ColumnExpr>("amount"), TokenType::Star,
+            std::make_unique<ConstantExpr>(common::Value::make_float64(1.5))));
+        VectorizedProjectOperator project(
+            std::make_unique<VectorizedSeqScanOperator>("bench_fact", fx.table), std::move(out),
+            std::move(exprs));
+        benchmark::DoNotOptimize(drain(project));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_VectorizedProject)->Arg(100000);
+
+void BM_VectorizedAggregate(benchmark::State& state) {
+    Fixture fx(state.range(0));
+    for (auto _ : state) {
+        Schema out;
+        out.add_column("rows", common::ValueType::TYPE_INT64);
+        out.add_column("total", common::ValueType::TYPE_FLOAT64);
+        VectorizedAggregateOperator agg(
+            std::make_unique<VectorizedSeqScanOperator>("bench_fact", fx.table), std::move(out),
+            {{AggregateType::Count, -1}, {AggregateType::Sum, 2}});
+        benchmark::DoNotOptimize(drain(agg));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_VectorizedAggregate)->Arg(100000);
+
+void BM_VectorizedHashAggregate(benchmark::State& state) {
+    Fixture fx(state.range(0));
+    for (auto _ : state) {
+        Schema out;
+        out.add_column("grp", common::ValueType::TYPE_INT64);
+        out.add_column("rows", common::ValueType::TYPE_INT64);
+        out.add_column("total", common::ValueType::TYPE_FLOAT64);
+        VectorizedHashAggregateOperator agg(
+            std::make_unique<VectorizedSeqScanOperator>("bench_fact", fx.table), {1}, out,
+            {{AggregateType::Count, -1}, {AggregateType::Sum, 2}});
+        benchmark::DoNotOptimize(drain(agg));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_VectorizedHashAggregate)->Arg(100000);
+
+/** Probe: range(0) fact rows; build: GROUPS dimension rows keyed like fact.grp */
+void BM_VectorizedHashJoin(benchmark::State& state) {
+    Fixture fx(state.range(0));
+    auto dim = make_table(fx.disk, "bench_dim", GROUPS);
+    for (auto _ : state) {
+        VectorizedHashJoinOperator join(
+            std::make_unique<VectorizedSeqScanOperator>("bench_fact", fx.table),
+            std::make_unique<VectorizedSeqScanOperator>("bench_dim", dim), {1}, {0});
+        benchmark::DoNotOptimize(drain(join));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_VectorizedHashJoin)->Arg(100000);
+
+}  // namespace
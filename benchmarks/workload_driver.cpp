@@ -0,0 +1,731 @@
+/**
+ * @file workload_driver.cpp
+ * @brief Multi-threaded TPC-C / TPC-H style load generator over the PostgreSQL protocol
+ *
+ * Loads a scaled-down TPC-C schema (warehouses, districts, customers, items,
+ * stock, orders) and / or a TPC-H style star (lineitem, orders, customer),
+ * then drives it from concurrent client sessions for a fixed time and reports
+ * throughput (tpmC, transactions and queries per second) and p50 / p99 / p999
+ * latency per transaction or query type.
+ *
+ * It talks to whatever listens on --host/--port: a standalone server or the
+ * coordinator of a cluster. Keys are single integers (district = w * 10 + d,
+ * and so on) so that every lookup can use the engine's single-column indexes.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "pg_client.hpp"
+
+using cloudsql::bench::PgConnection;
+using cloudsql::bench::QueryResult;
+
+namespace {
+
+/* Scaled down from the specification's 100000 items / 3000 customers so a load takes seconds */
+constexpr int64_t ITEMS = 10000;
+constexpr int64_t DISTRICTS = 10;
+constexpr int64_t CUSTOMERS = 300;
+constexpr int64_t INITIAL_ORDERS = 30; /**< Per district */
+constexpr int64_t ORDER_SPACE = 10000000; /**< o_key = d_key * ORDER_SPACE + o_id */
+constexpr size_t LOAD_BATCH = 200;        /**< Rows per INSERT while loading */
+constexpr uint32_t MAX_PORT = 65535;
+
+enum class Workload : uint8_t { Tpcc, Tpch, Mixed };
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 5432;
+    Workload workload = Workload::Tpcc;
+    size_t clients = 4;
+    size_t analytic_clients = 1; /**< Extra TPC-H sessions in the mixed workload */
+    int64_t warehouses = 1;
+    int64_t lineitems = 60000;
+    std::chrono::seconds duration{30};
+    std::chrono::seconds warmup{5};
+    bool load = true;
+};
+
+/**
+ * @brief Latencies and outcomes of one transaction or query type, per client
+ */
+struct Recorder {
+    std::vector<uint32_t> micros; /**< Completed (committed or read) executions */
+    uint64_t aborted = 0;
+};
+
+/**
+ * @brief A named unit of work: runs once on a session, returns false if it aborted
+ */
+struct Action {
+    std::string name;
+    uint32_t weight; /**< Share of the mix, in percent of a client's picks */
+    std::function<bool(PgConnection&, std::mt19937_64&)> run;
+};
+
+int64_t uniform(std::mt19937_64& rng, int64_t lo, int64_t hi) {
+    return std::uniform_int_distribution<int64_t>(lo, hi)(rng);
+}
+
+/** @brief TPC-C non-uniform random: NURand(A, x, y), skewing picks towards hot keys */
+int64_t nurand(std::mt19937_64& rng, int64_t a, int64_t x, int64_t y) {
+    constexpr int64_t C = 42;
+    return (((uniform(rng, 0, a) | uniform(rng, x, y)) + C) % (y - x + 1)) + x;
+}
+
+std::string money(double v) {
+    std::array<char, 32> buf{};
+    static_cast<void>(std::snprintf(buf.data(), buf.size(), "%.2f", v));
+    return buf.data();
+}
+
+/** @brief Run a statement, throwing on failure (loading only) */
+void must(PgConnection& conn, const std::string& sql) {
+    const QueryResult res = conn.query(sql);
+    if (!res.ok) {
+        throw std::runtime_error(sql.substr(0, 60) + "...: " + res.error);
+    }
+}
+
+/** @brief Buffers VALUES tuples and sends them LOAD_BATCH at a time; call flush() at the end */
+class BatchInserter {
+   public:
+    BatchInserter(PgConnection& conn, std::string table) : conn_(conn), table_(std::move(table)) {}
+
+    void add(const std::string& tuple) {
+        sql_ += rows_ == 0 ? "INSERT INTO " + table_ + " VALUES " : ", ";
+        sql_ += "(" + tuple + ")";
+        if (++rows_ == LOAD_BATCH) {
+            flush();
+        }
+    }
+
+    void flush() {
+        if (rows_ > 0) {
+            must(conn_, sql_);
+            sql_.clear();
+            rows_ = 0;
+        }
+    }
+
+   private:
+    PgConnection& conn_;
+    std::string table_;
+    std::string sql_;
+    size_t rows_ = 0;
+};
+
+PgConnection open_session(const Options& opts) {
+    PgConnection conn;
+    if (!conn.connect(opts.host, opts.port)) {
+        throw std::runtime_error("cannot connect to " + opts.host + ":" + std::to_string(opts.port));
+    }
+    return conn;
+}
+
+/** @brief Run `fn(i)` for i in [0, n) on up to `threads` sessions in parallel */
+void parallel_load(const Options& opts, int64_t n, size_t threads,
+                   const std::function<void(PgConnection&, int64_t)>& fn) {
+    std::atomic<int64_t> next{0};
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors(threads);
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            try {
+                PgConnection conn = open_session(opts);
+                for (int64_t i = next++; i < n; i = next++) {
+                    fn(conn, i);
+                }
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    for (const auto& e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------ TPC-C */
+
+void load_tpcc(const Options& opts) {
+    PgConnection conn = open_session(opts);
+    for (const char* sql : {
+             "CREATE TABLE warehouse (w_id INT, w_name TEXT, w_ytd DOUBLE)",
+             "CREATE TABLE district (d_key INT, d_w_id INT, d_ytd DOUBLE, d_next_o_id INT)",
+             "CREATE TABLE customer (c_key INT, c_d_key INT, c_last TEXT, c_balance DOUBLE, "
+             "c_payment_cnt INT, c_delivery_cnt INT)",
+             "CREATE TABLE item (i_id INT, i_name TEXT, i_price DOUBLE)",
+             "CREATE TABLE stock (s_key INT, s_i_id INT, s_w_id INT, s_quantity INT, s_ytd INT)",
+             "CREATE TABLE orders (o_key BIGINT, o_d_key INT, o_c_key INT, o_ol_cnt INT, "
+             "o_carrier INT)",
+             "CREATE TABLE order_line (ol_o_key BIGINT, ol_i_id INT, ol_quantity INT, "
+             "ol_amount DOUBLE)",
+             "CREATE TABLE history (h_c_key INT, h_amount DOUBLE)",
+             "CREATE INDEX warehouse_pk ON warehouse (w_id)",
+             "CREATE INDEX district_pk ON district (d_key)",
+             "CREATE INDEX customer_pk ON customer (c_key)",
+             "CREATE INDEX item_pk ON item (i_id)",
+             "CREATE INDEX stock_pk ON stock (s_key)",
+             "CREATE INDEX orders_pk ON orders (o_key)",
+             "CREATE INDEX orders_customer ON orders (o_c_key)",
+             "CREATE INDEX orders_district ON orders (o_d_key)",
+             "CREATE INDEX order_line_order ON order_line (ol_o_key)",
+         }) {
+        must(conn, sql);
+    }
+
+    {
+        BatchInserter items(conn, "item");
+        for (int64_t i = 0; i < ITEMS; ++i) {
+            items.add(std::to_string(i) + ", 'item" + std::to_string(i) + "', " +
+                      money(1.0 + static_cast<double>(i % 9900) / 100.0));
+        }
+        items.flush();
+    }
+
+    const size_t threads = std::max<size_t>(1, std::min<size_t>(opts.clients, 8));
+    parallel_load(opts, opts.warehouses, threads, [](PgConnection& c, int64_t w) {
+        must(c, "INSERT INTO warehouse VALUES (" + std::to_string(w) + ", 'wh" +
+                    std::to_string(w) + "', 300000.00)");
+        {
+            BatchInserter stock(c, "stock");
+            for (int64_t i = 0; i < ITEMS; ++i) {
+                stock.add(std::to_string(w * ITEMS + i) + ", " + std::to_string(i) + ", " +
+                          std::to_string(w) + ", " + std::to_string(10 + (i * 7) % 91) + ", 0");
+            }
+            stock.flush();
+        }
+        BatchInserter districts(c, "district");
+        BatchInserter customers(c, "customer");
+        BatchInserter orders(c, "orders");
+        BatchInserter lines(c, "order_line");
+        for (int64_t d = 0; d < DISTRICTS; ++d) {
+            const int64_t d_key = w * DISTRICTS + d;
+            districts.add(std::to_string(d_key) + ", " + std::to_string(w) + ", 30000.00, " +
+                          std::to_string(INITIAL_ORDERS));
+            for (int64_t c_id = 0; c_id < CUSTOMERS; ++c_id) {
+                customers.add(std::to_string(d_key * CUSTOMERS + c_id) + ", " +
+                              std::to_string(d_key) + ", 'cust" + std::to_string(c_id % 1000) +
+                              "', -10.00, 1, 0");
+            }
+            for (int64_t o = 0; o < INITIAL_ORDERS; ++o) {
+                const int64_t o_key = d_key * ORDER_SPACE + o;
+                orders.add(std::to_string(o_key) + ", " + std::to_string(d_key) + ", " +
+                           std::to_string(d_key * CUSTOMERS + (o * 7) % CUSTOMERS) + ", 5, " +
+                           (o < INITIAL_ORDERS * 2 / 3 ? "1" : "0"));
+                for (int64_t l = 0; l < 5; ++l) {
+                    lines.add(std::to_string(o_key) + ", " + std::to_string((o * 31 + l) % ITEMS) +
+                              ", 5, " + money(static_cast<double>((o + l) % 100)));
+                }
+            }
+        }
+        for (auto* batch : {&districts, &customers, &orders, &lines}) {
+            batch->flush();
+        }
+    });
+}
+
+/** @brief Run `body` between BEGIN and COMMIT; rolls back and reports false on any failure */
+bool transaction(PgConnection& conn, const std::function<bool(PgConnection&)>& body) {
+    if (!conn.query("BEGIN").ok) {
+        return false;
+    }
+    if (body(conn) && conn.query("COMMIT").ok) {
+        return true;
+    }
+    static_cast<void>(conn.query("ROLLBACK"));
+    return false;
+}
+
+bool ok(PgConnection& conn, const std::string& sql) { return conn.query(sql).ok; }
+
+std::optional<std::string> scalar(PgConnection& conn, const std::string& sql) {
+    QueryResult res = conn.query(sql);
+    if (!res.ok || res.rows.empty() || res.rows[0].empty()) {
+        return std::nullopt;
+    }
+    return res.rows[0][0];
+}
+
+std::vector<Action> tpcc_mix(const Options& opts) {
+    const int64_t warehouses = opts.warehouses;
+    const auto district_of = [warehouses](std::mt19937_64& rng) {
+        return uniform(rng, 0, warehouses - 1) * DISTRICTS + uniform(rng, 0, DISTRICTS - 1);
+    };
+
+    std::vector<Action> mix;
+    mix.push_back({"NewOrder", 45, [=](PgConnection& conn, std::mt19937_64& rng) {
+        const int64_t d_key = district_of(rng);
+        const int64_t w = d_key / DISTRICTS;
+        const int64_t c_key = d_key * CUSTOMERS + nurand(rng, 1023, 0, CUSTOMERS - 1);
+        const int64_t lines = uniform(rng, 5, 15);
+        /* 1% of orders name an unused item and roll back, as the specification asks */
+        const bool rollback = uniform(rng, 0, 99) == 0;
+        return transaction(conn, [&](PgConnection& c) {
+            const auto next = scalar(c, "SELECT d_next_o_id FROM district WHERE d_key = " +
+                                            std::to_string(d_key));
+            if (!next.has_value() ||
+                !ok(c, "UPDATE district SET d_next_o_id = d_next_o_id + 1 WHERE d_key = " +
+                           std::to_string(d_key))) {
+                return false;
+            }
+            const int64_t o_key = d_key * ORDER_SPACE + std::stoll(*next);
+            if (!ok(c, "INSERT INTO orders VALUES (" + std::to_string(o_key) + ", " +
+                           std::to_string(d_key) + ", " + std::to_string(c_key) + ", " +
+                           std::to_string(lines) + ", 0)")) {
+                return false;
+            }
+            for (int64_t l = 0; l < lines; ++l) {
+                const int64_t item = rollback && l == lines - 1
+                                         ? ITEMS
+                                         : nurand(rng, 8191, 0, ITEMS - 1);
+                const int64_t qty = uniform(rng, 1, 10);
+                const auto price =
+                    scalar(c, "SELECT i_price FROM item WHERE i_id = " + std::to_string(item));
+                if (!price.has_value()) {
+                    return false;
+                }
+                if (!ok(c, "UPDATE stock SET s_quantity = s_quantity - " + std::to_string(qty) +
+                               ", s_ytd = s_ytd + " + std::to_string(qty) +
+                               " WHERE s_key = " + std::to_string(w * ITEMS + item)) ||
+                    !ok(c, "INSERT INTO order_line VALUES (" + std::to_string(o_key) + ", " +
+                               std::to_string(item) + ", " + std::to_string(qty) + ", " +
+                               money(std::stod(*price) * static_cast<double>(qty)) + ")")) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }});
+
+    mix.push_back({"Payment", 43, [=](PgConnection& conn, std::mt19937_64& rng) {
+        const int64_t d_key = district_of(rng);
+        const int64_t c_key = d_key * CUSTOMERS + nurand(rng, 1023, 0, CUSTOMERS - 1);
+        const std::string amount = money(static_cast<double>(uniform(rng, 100, 500000)) / 100.0);
+        return transaction(conn, [&](PgConnection& c) {
+            return ok(c, "UPDATE warehouse SET w_ytd = w_ytd + " + amount +
+                             " WHERE w_id = " + std::to_string(d_key / DISTRICTS)) &&
+                   ok(c, "UPDATE district SET d_ytd = d_ytd + " + amount +
+                             " WHERE d_key = " + std::to_string(d_key)) &&
+                   ok(c, "UPDATE customer SET c_balance = c_balance - " + amount +
+                             ", c_payment_cnt = c_payment_cnt + 1 WHERE c_key = " +
+                             std::to_string(c_key)) &&
+                   ok(c, "INSERT INTO history VALUES (" + std::to_string(c_key) + ", " + amount +
+                             ")");
+        });
+    }});
+
+    mix.push_back({"OrderStatus", 4, [=](PgConnection& conn, std::mt19937_64& rng) {
+        const int64_t c_key = district_of(rng) * CUSTOMERS + nurand(rng, 1023, 0, CUSTOMERS - 1);
+        if (!ok(conn, "SELECT c_last, c_balance FROM customer WHERE c_key = " +
+                          std::to_string(c_key))) {
+            return false;
+        }
+        const QueryResult last = conn.query("SELECT o_key FROM orders WHERE o_c_key = " +
+                                            std::to_string(c_key) +
+                                            " ORDER BY o_key DESC LIMIT 1");
+        if (!last.ok) {
+            return false;
+        }
+        if (last.rows.empty() || !last.rows[0][0].has_value()) {
+            return true;
+        }
+        return ok(conn, "SELECT ol_i_id, ol_quantity, ol_amount FROM order_line WHERE "
+                        "ol_o_key = " + *last.rows[0][0]);
+    }});
+
+    mix.push_back({"Delivery", 4, [=](PgConnection& conn, std::mt19937_64& rng) {
+        const int64_t w = uniform(rng, 0, warehouses - 1);
+        const int64_t carrier = uniform(rng, 1, 10);
+        return transaction(conn, [&](PgConnection& c) {
+            for (int64_t d = 0; d < DISTRICTS; ++d) {
+                const QueryResult oldest = c.query(
+                    "SELECT o_key, o_c_key FROM orders WHERE o_d_key = " +
+                    std::to_string(w * DISTRICTS + d) + " AND o_carrier = 0 ORDER BY o_key LIMIT 1");
+                if (!oldest.ok) {
+                    return false;
+                }
+                if (oldest.rows.empty() || !oldest.rows[0][0] || !oldest.rows[0][1]) {
+                    continue; /* Nothing to deliver in this district */
+                }
+                const std::string& o_key = *oldest.rows[0][0];
+                const auto total =
+                    scalar(c, "SELECT SUM(ol_amount) FROM order_line WHERE ol_o_key = " + o_key);
+                if (!ok(c, "UPDATE orders SET o_carrier = " + std::to_string(carrier) +
+                               " WHERE o_key = " + o_key) ||
+                    !ok(c, "UPDATE customer SET c_balance = c_balance + " +
+                               total.value_or("0") +
+                               ", c_delivery_cnt = c_delivery_cnt + 1 WHERE c_key = " +
+                               *oldest.rows[0][1])) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }});
+
+    mix.push_back({"StockLevel", 4, [=](PgConnection& conn, std::mt19937_64& rng) {
+        const int64_t d_key = district_of(rng);
+        const auto next =
+            scalar(conn, "SELECT d_next_o_id FROM district WHERE d_key = " + std::to_string(d_key));
+        if (!next.has_value()) {
+            return false;
+        }
+        /* Items of the district's last 20 orders whose stock is below the threshold */
+        const int64_t hi = d_key * ORDER_SPACE + std::stoll(*next);
+        return ok(conn,
+                  "SELECT COUNT(stock.s_i_id) FROM order_line JOIN stock ON "
+                  "order_line.ol_i_id = stock.s_i_id WHERE order_line.ol_o_key >= " +
+                      std::to_string(hi - 20) + " AND order_line.ol_o_key < " +
+                      std::to_string(hi) + " AND stock.s_w_id = " +
+                      std::to_string(d_key / DISTRICTS) + " AND stock.s_quantity < " +
+                      std::to_string(uniform(rng, 10, 20)));
+    }});
+    return mix;
+}
+
+/* ------------------------------------------------------------------ TPC-H */
+
+void load_tpch(const Options& opts) {
+    PgConnection conn = open_session(opts);
+    for (const char* sql : {
+             "CREATE TABLE h_customer (c_custkey INT, c_segment TEXT)",
+             "CREATE TABLE h_orders (o_orderkey INT, o_custkey INT, o_orderdate INT, "
+             "o_priority TEXT)",
+             "CREATE TABLE h_lineitem (l_orderkey INT, l_partkey INT, l_quantity INT, "
+             "l_price DOUBLE, l_discount DOUBLE, l_shipdate INT, l_returnflag TEXT)",
+         }) {
+        must(conn, sql);
+    }
+
+    static const std::array<const char*, 5> SEGMENTS = {"AUTOMOBILE", "BUILDING", "FURNITURE",
+                                                        "HOUSEHOLD", "MACHINERY"};
+    static const std::array<const char*, 3> FLAGS = {"A", "N", "R"};
+    const int64_t orders = std::max<int64_t>(1, opts.lineitems / 4);
+    const int64_t customers = std::max<int64_t>(1, orders / 10);
+    {
+        BatchInserter rows(conn, "h_customer");
+        for (int64_t c = 0; c < customers; ++c) {
+            rows.add(std::to_string(c) + ", '" + SEGMENTS[c % SEGMENTS.size()] + "'");
+        }
+        rows.flush();
+    }
+
+    /* Deterministic per chunk, so the data does not depend on the loader's thread count */
+    constexpr int64_t CHUNK = 1000;
+    const size_t threads = std::max<size_t>(1, std::min<size_t>(opts.clients, 8));
+    parallel_load(opts, (orders + CHUNK - 1) / CHUNK, threads, [&](PgConnection& c, int64_t chunk) {
+        std::mt19937_64 rng(static_cast<uint64_t>(chunk));
+        BatchInserter order_rows(c, "h_orders");
+        BatchInserter line_rows(c, "h_lineitem");
+        for (int64_t o = chunk * CHUNK; o < std::min(orders, (chunk + 1) * CHUNK); ++o) {
+            const int64_t date = uniform(rng, 0, 2400);
+            order_rows.add(std::to_string(o) + ", " + std::to_string(uniform(rng, 0, customers - 1)) +
+                           ", " + std::to_string(date) + ", '" +
+                           std::to_string(uniform(rng, 1, 5)) + "-PRIORITY'");
+            for (int64_t l = 0; l < 4; ++l) {
+                line_rows.add(std::to_string(o) + ", " + std::to_string(uniform(rng, 0, 19999)) +
+                              ", " + std::to_string(uniform(rng, 1, 50)) + ", " +
+                              money(static_cast<double>(uniform(rng, 90000, 10000000)) / 100.0) +
+                              ", " + money(static_cast<double>(uniform(rng, 0, 10)) / 100.0) +
+                              ", " + std::to_string(date + uniform(rng, 1, 120)) + ", '" +
+                              FLAGS[static_cast<size_t>(uniform(rng, 0, 2))] + "'");
+            }
+        }
+        order_rows.flush();
+        line_rows.flush();
+    });
+}
+
+std::vector<Action> tpch_mix() {
+    const auto query = [](const std::string& sql) {
+        return [sql](PgConnection& conn, std::mt19937_64& /*rng*/) { return conn.query(sql).ok; };
+    };
+    std::vector<Action> mix;
+    /* Q1: pricing summary, a scan and a small grouped aggregate */
+    mix.push_back({"Q1", 25, query("SELECT l_returnflag, SUM(l_quantity), SUM(l_price), "
+                                   "SUM(l_price * (1 - l_discount)), AVG(l_quantity), "
+                                   "AVG(l_discount), COUNT(l_orderkey) FROM h_lineitem "
+                                   "WHERE l_shipdate <= 2300 GROUP BY l_returnflag "
+                                   "ORDER BY l_returnflag")});
+    /* Q3: shipping priority, a three-way join feeding a grouped top-N */
+    mix.push_back({"Q3", 25, query("SELECT h_orders.o_orderkey, "
+                                   "SUM(h_lineitem.l_price * (1 - h_lineitem.l_discount)) "
+                                   "FROM h_customer JOIN h_orders ON "
+                                   "h_customer.c_custkey = h_orders.o_custkey JOIN h_lineitem ON "
+                                   "h_lineitem.l_orderkey = h_orders.o_orderkey WHERE "
+                                   "h_customer.c_segment = 'BUILDING' AND "
+                                   "h_orders.o_orderdate < 1200 AND h_lineitem.l_shipdate > 1200 "
+                                   "GROUP BY h_orders.o_orderkey "
+                                   "ORDER BY h_orders.o_orderkey LIMIT 10")});
+    /* Q6: forecasting revenue change, a selective scan and one sum */
+    mix.push_back({"Q6", 25, query("SELECT SUM(l_price * l_discount) FROM h_lineitem WHERE "
+                                   "l_shipdate >= 365 AND l_shipdate < 730 AND "
+                                   "l_discount >= 0.05 AND l_discount <= 0.07 AND "
+                                   "l_quantity < 24")});
+    /* Q12-like: order priority counts over a join */
+    mix.push_back({"Q12", 25, query("SELECT h_orders.o_priority, COUNT(h_lineitem.l_orderkey) "
+                                    "FROM h_orders JOIN h_lineitem ON "
+                                    "h_orders.o_orderkey = h_lineitem.l_orderkey WHERE "
+                                    "h_lineitem.l_shipdate >= 730 AND "
+                                    "h_lineitem.l_shipdate < 1095 "
+                                    "GROUP BY h_orders.o_priority ORDER BY h_orders.o_priority")});
+    return mix;
+}
+
+/* ------------------------------------------------------------------ Driver */
+
+/**
+ * @brief One client session: picks actions by weight until the deadline
+ *
+ * Executions that finish during the warm-up are not recorded.
+ */
+void run_client(const Options& opts, const std::vector<Action>& mix, uint64_t seed,
+                std::chrono::steady_clock::time_point measure_from,
+                std::chrono::steady_clock::time_point until, std::vector<Recorder>& out) {
+    std::mt19937_64 rng(seed);
+    uint32_t total_weight = 0;
+    for (const auto& a : mix) {
+        total_weight += a.weight;
+    }
+    PgConnection conn;
+    while (std::chrono::steady_clock::now() < until) {
+        if (!conn.connected() && !conn.connect(opts.host, opts.port)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+        auto pick = static_cast<uint32_t>(uniform(rng, 0, total_weight - 1));
+        size_t idx = 0;
+        while (pick >= mix[idx].weight) {
+            pick -= mix[idx++].weight;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        const bool committed = mix[idx].run(conn, rng);
+        const auto end = std::chrono::steady_clock::now();
+        if (start < measure_from || end > until) {
+            continue;
+        }
+        if (committed) {
+            out[idx].micros.push_back(static_cast<uint32_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()));
+        } else {
+            out[idx].aborted++;
+        }
+    }
+}
+
+double percentile_ms(const std::vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const auto rank = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return static_cast<double>(sorted[std::min(rank, sorted.size() - 1)]) / 1000.0;
+}
+
+/**
+ * @brief Per-type counts and latency percentiles, merged over clients
+ * @return Completed executions per type, in `mix` order
+ */
+std::vector<uint64_t> report(const std::string& title, const std::vector<Action>& mix,
+                             const std::vector<std::vector<Recorder>>& per_client,
+                             double seconds) {
+    std::printf("\n%s\n", title.c_str());
+    std::printf("%-12s %10s %8s %10s %10s %10s %10s\n", "Type", "Completed", "Aborted", "per sec",
+                "p50 ms", "p99 ms", "p999 ms");
+    std::vector<uint64_t> completed;
+    uint64_t total = 0;
+    std::vector<uint32_t> all;
+    for (size_t i = 0; i < mix.size(); ++i) {
+        std::vector<uint32_t> lat;
+        uint64_t aborted = 0;
+        for (const auto& rec : per_client) {
+            lat.insert(lat.end(), rec[i].micros.begin(), rec[i].micros.end());
+            aborted += rec[i].aborted;
+        }
+        std::sort(lat.begin(), lat.end());
+        all.insert(all.end(), lat.begin(), lat.end());
+        completed.push_back(lat.size());
+        total += lat.size();
+        std::printf("%-12s %10zu %8llu %10.1f %10.2f %10.2f %10.2f\n", mix[i].name.c_str(),
+                    lat.size(), static_cast<unsigned long long>(aborted),
+                    static_cast<double>(lat.size()) / seconds, percentile_ms(lat, 0.50),
+                    percentile_ms(lat, 0.99), percentile_ms(lat, 0.999));
+    }
+    std::sort(all.begin(), all.end());
+    std::printf("%-12s %10llu %8s %10.1f %10.2f %10.2f %10.2f\n", "All",
+                static_cast<unsigned long long>(total), "", static_cast<double>(total) / seconds,
+                percentile_ms(all, 0.50), percentile_ms(all, 0.99), percentile_ms(all, 0.999));
+    return completed;
+}
+
+void print_usage(const char* prog) {
+    std::cout << "Usage: " << prog << " [OPTIONS]\n\n";
+    std::cout << "Options:\n";
+    std::cout << "  -H, --host HOST            Server or coordinator host (default: 127.0.0.1)\n";
+    std::cout << "  -p, --port PORT            PostgreSQL port (default: 5432)\n";
+    std::cout << "  -w, --workload KIND        tpcc, tpch or mixed (default: tpcc)\n";
+    std::cout << "  -c, --clients N            Concurrent sessions (default: 4)\n";
+    std::cout << "  -a, --analytic-clients N   TPC-H sessions alongside TPC-C in mixed (default: 1)\n";
+    std::cout << "      --warehouses N         TPC-C scale (default: 1)\n";
+    std::cout << "      --lineitems N          TPC-H lineitem rows (default: 60000)\n";
+    std::cout << "  -t, --duration SECONDS     Measured run time (default: 30)\n";
+    std::cout << "      --warmup SECONDS       Unmeasured lead-in (default: 5)\n";
+    std::cout << "      --no-load              Reuse tables loaded by an earlier run\n";
+    std::cout << "  -h, --help                 Show this help message\n";
+}
+
+int64_t positive(const std::string& s) {
+    const long long v = std::stoll(s);
+    if (v < 0) {
+        throw std::out_of_range("negative");
+    }
+    return v;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    const std::vector<std::string> args(argv, argv + argc);
+    try {
+        for (size_t i = 1; i < args.size(); ++i) {
+            const std::string& arg = args[i];
+            const bool has_value = i + 1 < args.size();
+            if (arg == "-h" || arg == "--help") {
+                print_usage(args[0].c_str());
+                return 0;
+            }
+            if ((arg == "-H" || arg == "--host") && has_value) {
+                opts.host = args[++i];
+            } else if ((arg == "-p" || arg == "--port") && has_value) {
+                const int64_t port = positive(args[++i]);
+                if (port > MAX_PORT) {
+                    throw std::out_of_range("port");
+                }
+                opts.port = static_cast<uint16_t>(port);
+            } else if ((arg == "-w" || arg == "--workload") && has_value) {
+                const std::string& kind = args[++i];
+                if (kind == "tpcc") {
+                    opts.workload = Workload::Tpcc;
+                } else if (kind == "tpch") {
+                    opts.workload = Workload::Tpch;
+                } else if (kind == "mixed") {
+                    opts.workload = Workload::Mixed;
+                } else {
+                    throw std::invalid_argument("workload " + kind);
+                }
+            } else if ((arg == "-c" || arg == "--clients") && has_value) {
+                opts.clients = static_cast<size_t>(std::max<int64_t>(1, positive(args[++i])));
+            } else if ((arg == "-a" || arg == "--analytic-clients") && has_value) {
+                opts.analytic_clients = static_cast<size_t>(positive(args[++i]));
+            } else if (arg == "--warehouses" && has_value) {
+                opts.warehouses = std::max<int64_t>(1, positive(args[++i]));
+            } else if (arg == "--lineitems" && has_value) {
+                opts.lineitems = std::max<int64_t>(4, positive(args[++i]));
+            } else if ((arg == "-t" || arg == "--duration") && has_value) {
+                opts.duration = std::chrono::seconds(std::max<int64_t>(1, positive(args[++i])));
+            } else if (arg == "--warmup" && has_value) {
+                opts.warmup = std::chrono::seconds(positive(args[++i]));
+            } else if (arg == "--no-load") {
+                opts.load = false;
+            } else {
+                std::cerr << "Unknown option: " << arg << "\n";
+                print_usage(args[0].c_str());
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid arguments (" << e.what() << ")\n";
+        return 1;
+    }
+
+    const bool oltp = opts.workload != Workload::Tpch;
+    const bool olap = opts.workload != Workload::Tpcc;
+    try {
+        if (opts.load) {
+            const auto start = std::chrono::steady_clock::now();
+            if (oltp) {
+                load_tpcc(opts);
+            }
+            if (olap) {
+                load_tpch(opts);
+            }
+            std::printf("Loaded in %.1f s\n",
+                        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                            .count());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Load failed: " << e.what() << "\n";
+        return 1;
+    }
+
+    /* Clients [0, oltp_clients) run TPC-C, the rest TPC-H */
+    const std::vector<Action> tpcc = tpcc_mix(opts);
+    const std::vector<Action> tpch = tpch_mix();
+    const size_t oltp_clients = oltp ? opts.clients : 0;
+    size_t olap_clients = 0;
+    if (olap) {
+        olap_clients = opts.workload == Workload::Tpch ? opts.clients : opts.analytic_clients;
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    const auto measure_from = begin + opts.warmup;
+    const auto until = measure_from + opts.duration;
+    std::vector<std::vector<Recorder>> oltp_stats(oltp_clients, std::vector<Recorder>(tpcc.size()));
+    std::vector<std::vector<Recorder>> olap_stats(olap_clients, std::vector<Recorder>(tpch.size()));
+    std::vector<std::thread> clients;
+    for (size_t i = 0; i < oltp_clients; ++i) {
+        clients.emplace_back(run_client, std::cref(opts), std::cref(tpcc), 1000 + i, measure_from,
+                             until, std::ref(oltp_stats[i]));
+    }
+    for (size_t i = 0; i < olap_clients; ++i) {
+        clients.emplace_back(run_client, std::cref(opts), std::cref(tpch), 2000 + i, measure_from,
+                             until, std::ref(olap_stats[i]));
+    }
+    for (auto& t : clients) {
+        t.join();
+    }
+
+    const double seconds = std::chrono::duration<double>(opts.duration).count();
+    std::printf("\n%s:%u, %.0f s measured after %lld s warm-up\n", opts.host.c_str(), opts.port,
+                seconds, static_cast<long long>(opts.warmup.count()));
+    if (oltp) {
+        const auto done = report("TPC-C (" + std::to_string(oltp_clients) + " clients, " +
+                                     std::to_string(opts.warehouses) + " warehouses)",
+                                 tpcc, oltp_stats, seconds);
+        std::printf("tpmC: %.1f\n", static_cast<double>(done[0]) * 60.0 / seconds);
+    }
+    if (olap) {
+        const auto done = report("TPC-H (" + std::to_string(olap_clients) + " clients, " +
+                                     std::to_string(opts.lineitems) + " lineitems)",
+                                 tpch, olap_stats, seconds);
+        uint64_t queries = 0;
+        for (const uint64_t n : done) {
+            queries += n;
+        }
+        std::printf("QPS: %.2f\n", static_cast<double>(queries) / seconds);
+    }
+    return 0;
+}
@@ -11,6 +11,7 @@
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -85,10 +86,64 @@ struct ShardInfo {
     std::string leader_id;              // Current Raft leader
 };
 
+/**
+ * @brief Consistent-hash ring that places shard keys on data nodes
+ *
+ * Every data node owns VIRTUAL_NODES tokens on a 64-bit ring; a key belongs
+ * to the node of the first token at or after its hash (see ShardManager).
+ * Adding a node only moves the keys that land on its new tokens.
+ */
+struct ShardRing {
+    struct VirtualNode {
+        uint64_t token = 0;
+        std::string node_id;
+    };
+
+    std::vector<VirtualNode> tokens; /**< Sorted by token */
+    /**
+     * Rows are still moving to the owners `tokens` gives them: a key may
+     * live on either its old or its new node, so lookups go to every node
+     */
+    bool migrating = false;
+
+    [[nodiscard]] bool empty() const { return tokens.empty(); }
+};
+
+/**
+ * @brief Distribution of one column, estimated by ANALYZE from a sample of rows
+ */
+struct ColumnStats {
+    double null_fraction = 0.0;
+    double distinct_count = 0.0; /**< Estimated distinct non-NULL values in the table */
+    std::vector<common::Value> most_common_values;
+    std::vector<double> most_common_freqs; /**< Fraction of all rows, per most common value */
+    /**
+     * Equi-depth histogram of the values that are not most common: about the
+     * same number of rows falls between each pair of adjacent bounds
+     */
+    std::vector<common::Value> histogram_bounds;
+};
+
+/**
+ * @brief Statistics of a table, as of its last ANALYZE
+ */
+struct TableStats {
+    uint64_t row_count = 0;
+    uint64_t page_count = 0;
+    uint64_t sampled_rows = 0;
+    std::vector<ColumnStats> columns; /**< By column position */
+    uint64_t analyzed_at = 0;
+};
+
 /**
  * @brief Table information structure
  */
 struct TableInfo {
+    /** Every data node holds all of the table's rows instead of a shard of them */
+    static constexpr uint32_t FLAG_REPLICATED = 0x1;
+    /** A columnar copy, fed from the WAL, answers analytical scans (ColumnarReplicaManager) */
+    static constexpr uint32_t FLAG_COLUMNAR_REPLICA = 0x2;
+
     oid_t table_id = 0;
     std::string name;
     std::vector<ColumnInfo> columns;
@@ -99,9 +154,13 @@ struct TableInfo {
     uint32_t flags = 0;
     uint64_t created_at = 0;
     uint64_t modified_at = 0;
+    std::optional<TableStats> stats; /**< Absent until the table is analyzed */
 
     TableInfo() = default;
 
+    [[nodiscard]] bool replicated() const { return (flags & FLAG_REPLICATED) != 0; }
+    [[nodiscard]] bool columnar_replica() const { return (flags & FLAG_COLUMNAR_REPLICA) != 0; }
+
     /**
      * @brief Get column by name
      */
@@ -151,18 +210,44 @@ struct DatabaseInfo {
 
 /**
  * @brief System Catalog class
+ *
+ * Every change is a command: the ones the catalog Raft group replicates, and
+ * what apply() replays. The catalog file is a versioned header followed by
+ * the commands of a compact image of the catalog and then by one record per
+ * change since, appended and synced as it happens, so DDL costs one small
+ * write however large the catalog is. Opening replays the records straight
+ * from a mapping of the file. Table statistics are not recorded; ANALYZE
+ * rebuilds them.
  */
 class Catalog : public raft::RaftStateMachine {
    public:
+    static constexpr uint32_t FILE_FORMAT_VERSION = 1;
+
     /**
      * @brief Apply a committed log entry (from RaftStateMachine)
      */
     void apply(const raft::LogEntry& entry) override;
 
+    /**
+     * @brief Write the tables and the shard ring (from RaftStateMachine)
+     */
+    bool save_snapshot(std::ostream& out) override;
+
+    /**
+     * @brief Replace the tables and the shard ring with a snapshot (from RaftStateMachine)
+     */
+    bool load_snapshot(std::istream& in) override;
+
     /**
      * @brief Default constructor
      */
     Catalog() = default;
+    ~Catalog() override;
+
+    Catalog(const Catalog&) = delete;
+    Catalog& operator=(const Catalog&) = delete;
+    Catalog(Catalog&&) = delete;
+    Catalog& operator=(Catalog&&) = delete;
 
     /**
      * @brief Create a new catalog
@@ -175,26 +260,34 @@ class Catalog : public raft::RaftStateMachine {
     void set_raft_group(raft::RaftGroup* raft_group) { raft_group_ = raft_group; }
 
     /**
-     * @brief Load catalog from file
+     * @brief Replay the catalog file `filename`, then record later changes in it
+     *
+     * A missing file is created empty. A record cut short by a crash is
+     * dropped; a file of mostly superseded records is compacted.
+     * @return false if the file cannot be opened or is not a catalog file
      */
     bool load(const std::string& filename);
 
     /**
-     * @brief Save catalog to file
+     * @brief Write a compact image to `filename`, then record later changes in it
+     *
+     * The image replaces the file atomically.
      */
-    [[nodiscard]] bool save(const std::string& filename) const;
+    [[nodiscard]] bool save(const std::string& filename);
 
     /**
      * @brief Create a new table
+     * @param flags TableInfo::FLAG_* bits
      * @return Table OID or 0 on error
      */
-    oid_t create_table(const std::string& table_name, std::vector<ColumnInfo> columns);
+    oid_t create_table(const std::string& table_name, std::vector<ColumnInfo> columns,
+                       uint32_t flags = 0);
 
     /**
      * @brief Local-only table creation (called by Raft)
      */
     oid_t create_table_local(const std::string& table_name, std::vector<ColumnInfo> columns,
-                             std::vector<ShardInfo> shards = {});
+                             std::vector<ShardInfo> shards = {}, uint32_t flags = 0);
 
     /**
      * @brief Drop a table
@@ -229,11 +322,23 @@ class Catalog : public raft::RaftStateMachine {
                        std::vector<uint16_t> column_positions, IndexType index_type,
                        bool is_unique);
 
+    /**
+     * @brief Local-only index creation (called by Raft)
+     */
+    oid_t create_index_local(const std::string& index_name, oid_t table_id,
+                             std::vector<uint16_t> column_positions, IndexType index_type,
+                             bool is_unique);
+
     /**
      * @brief Drop an index
      */
     bool drop_index(oid_t index_id);
 
+    /**
+     * @brief Local-only index drop (called by Raft)
+     */
+    bool drop_index_local(oid_t index_id);
+
     /**
      * @brief Get index by ID
      */
@@ -249,6 +354,11 @@ class Catalog : public raft::RaftStateMachine {
      */
     bool update_table_stats(oid_t table_id, uint64_t num_rows);
 
+    /**
+     * @brief Replace the statistics of a table, including its row count
+     */
+    bool set_table_stats(oid_t table_id, TableStats stats);
+
     /**
      * @brief Check if table exists
      */
@@ -274,6 +384,18 @@ class Catalog : public raft::RaftStateMachine {
      */
     void set_cluster_manager(cluster::ClusterManager* cm) { cluster_manager_ = cm; }
 
+    [[nodiscard]] const ShardRing& shard_ring() const { return shard_ring_; }
+
+    /**
+     * @brief Replace the shard ring (replicated through the catalog Raft group)
+     */
+    void set_shard_ring(ShardRing ring);
+
+    /**
+     * @brief Local-only ring update (called by Raft)
+     */
+    void set_shard_ring_local(ShardRing ring);
+
     /**
      * @brief Print catalog contents
      */
@@ -284,14 +406,46 @@ class Catalog : public raft::RaftStateMachine {
      */
     [[nodiscard]] uint64_t get_version() const { return version_; }
 
+    /**
+     * @brief Count a committed change to the rows of `table_name`
+     *
+     * Unlike get_version(), which DDL moves, this moves on data changes, one
+     * table at a time: a result read from a table stays current while the
+     * table's data version is still the one it was read at. Safe to call from
+     * any thread.
+     */
+    void note_data_change(const std::string& table_name);
+
+    /** @return The data version of `table_name`; 0 until its rows first change */
+    [[nodiscard]] uint64_t data_version(const std::string& table_name) const;
+
    private:
+    /** @brief Apply one command; apply() and load() share it */
+    void apply_command(const uint8_t* data, size_t len);
+
+    /** @return Commands that rebuild the catalog from empty, ids included */
+    [[nodiscard]] std::vector<std::vector<uint8_t>> image_commands() const;
+
+    /** @brief Append a change to the catalog file, if one is open */
+    void record(const std::vector<uint8_t>& cmd);
+
     std::unordered_map<oid_t, std::unique_ptr<TableInfo>> tables_;
+    std::unordered_map<std::string, oid_t> table_names_; /**< Name -> table id */
+    std::unordered_map<oid_t, oid_t> index_tables_;      /**< Index id -> table id */
     DatabaseInfo database_;
     oid_t next_oid_ = 1;
     uint64_t version_ = 1;
+    ShardRing shard_ring_;
+    mutable std::mutex data_versions_mutex_;
+    std::unordered_map<std::string, uint64_t> data_versions_; /**< Name -> last change */
+    uint64_t data_epoch_ = 0; /**< Data changes counted, across all tables */
     raft::RaftGroup* raft_group_ = nullptr;
     cluster::ClusterManager* cluster_manager_ = nullptr;
 
+    int file_fd_ = -1; /**< Catalog file changes are appended to; -1 if none */
+    std::string file_path_;
+    bool replaying_ = false; /**< load() is applying records already in the file */
+
     [[nodiscard]] static uint64_t get_current_time();
 };
 
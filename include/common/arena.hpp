@@ -0,0 +1,104 @@
+/**
+ * @file arena.hpp
+ * @brief Bump allocator for memory that is released all at once
+ */
+
+#ifndef CLOUDSQL_COMMON_ARENA_HPP
+#define CLOUDSQL_COMMON_ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+namespace cloudsql::common {
+
+/**
+ * @brief Memory resource that carves allocations out of large blocks
+ *
+ * Deallocation is a no-op; everything is released by reset() or the
+ * destructor. reset() keeps the largest block, so an arena reused for
+ * similar workloads (e.g. one query after another) stops calling malloc
+ * once it has warmed up. Not thread-safe.
+ */
+class Arena : public std::pmr::memory_resource {
+   public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = static_cast<size_t>(64) * 1024;
+
+    explicit Arena(size_t block_size = DEFAULT_BLOCK_SIZE) : block_size_(block_size) {}
+    ~Arena() override = default;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&&) = delete;
+    Arena& operator=(Arena&&) = delete;
+
+    /**
+     * @brief Releases every allocation, keeping the largest block for reuse
+     */
+    void reset() {
+        if (blocks_.size() > 1) {
+            const auto largest = std::max_element(
+                blocks_.begin(), blocks_.end(),
+                [](const Block& a, const Block& b) { return a.size < b.size; });
+            Block keep = std::move(*largest);
+            blocks_.clear();
+            blocks_.push_back(std::move(keep));
+        }
+        cursor_ = blocks_.empty() ? nullptr : blocks_.front().data.get();
+        end_ = blocks_.empty() ? nullptr : cursor_ + blocks_.front().size;
+        bytes_used_ = 0;
+    }
+
+    /** @return Bytes handed out since the last reset() */
+    [[nodiscard]] size_t bytes_used() const { return bytes_used_; }
+
+    /** @return Bytes held in blocks */
+    [[nodiscard]] size_t bytes_reserved() const {
+        size_t total = 0;
+        for (const auto& block : blocks_) total += block.size;
+        return total;
+    }
+
+   private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    size_t block_size_;
+    std::vector<Block> blocks_;
+    char* cursor_ = nullptr;
+    char* end_ = nullptr;
+    size_t bytes_used_ = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        auto address = reinterpret_cast<uintptr_t>(cursor_);
+        uintptr_t aligned = (address + alignment - 1) & ~(uintptr_t{alignment} - 1);
+        if (cursor_ == nullptr || aligned + bytes > reinterpret_cast<uintptr_t>(end_)) {
+            /* Blocks are left uninitialized; new[] aligns them for any fundamental type */
+            const size_t size = std::max(block_size_, bytes + alignment);
+            blocks_.push_back(Block{std::unique_ptr<char[]>(new char[size]), size});
+            cursor_ = blocks_.back().data.get();
+            end_ = cursor_ + size;
+            address = reinterpret_cast<uintptr_t>(cursor_);
+            aligned = (address + alignment - 1) & ~(uintptr_t{alignment} - 1);
+        }
+        cursor_ += (aligned - address) + bytes;
+        bytes_used_ += bytes;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void do_deallocate(void* /*p*/, size_t /*bytes*/, size_t /*alignment*/) override {}
+
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+}  // namespace cloudsql::common
+
+#endif  // CLOUDSQL_COMMON_ARENA_HPP
@@ -7,14 +7,23 @@
 #define SQL_ENGINE_COMMON_CLUSTER_MANAGER_HPP
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "common/config.hpp"
 #include "executor/types.hpp"
+#include "network/rpc_client.hpp"
+#include "network/rpc_client_pool.hpp"
 
 namespace cloudsql::raft {
 class RaftManager;
@@ -58,9 +67,24 @@ class ClusterManager {
     void register_node(const std::string& id, const std::string& address, uint16_t port,
                        config::RunMode role) {
         const std::scoped_lock<std::mutex> lock(mutex_);
+        const auto it = nodes_.find(id);
+        if (it != nodes_.end() &&
+            (it->second.address != address || it->second.cluster_port != port)) {
+            rpc_clients_.remove(it->second.address, it->second.cluster_port);
+        }
         nodes_[id] = {id, address, port, role, std::chrono::system_clock::now(), true};
     }
 
+    /**
+     * @brief Pooled connection to a node, kept open across queries
+     * @return nullptr if the node cannot be reached
+     */
+    [[nodiscard]] std::shared_ptr<network::RpcClient> get_client(const NodeInfo& node) {
+        return rpc_clients_.get(node.address, node.cluster_port);
+    }
+
+    [[nodiscard]] network::RpcClientPool& rpc_clients() { return rpc_clients_; }
+
     /**
      * @brief Set Raft manager for this node
      */
@@ -167,6 +191,9 @@ class ClusterManager {
         return members;
     }
 
+    /** Chunks buffered per shuffle stream before senders have to wait for credit */
+    static constexpr size_t SHUFFLE_BUFFERED_CHUNKS = 16;
+
     /**
      * @brief Buffer received shuffle data
      */
@@ -174,8 +201,82 @@ class ClusterManager {
                              std::vector<executor::Tuple> rows) {
         const std::scoped_lock<std::mutex> lock(mutex_);
         auto& target = shuffle_buffers_[context_id][table];
-        target.insert(target.end(), std::make_move_iterator(rows.begin()),
-                      std::make_move_iterator(rows.end()));
+        target.chunks.push_back(std::move(rows));
+        shuffle_cv_.notify_all();
+    }
+
+    /**
+     * @brief Buffer one chunk of a shuffle stream
+     * @param last The sender's final chunk for this table
+     * @param credit Run once the chunk may be acknowledged, which is at once
+     * unless SHUFFLE_BUFFERED_CHUNKS are already waiting to be consumed; the
+     * sender holds back further chunks while its acknowledgements are pending
+     */
+    void push_shuffle_chunk(const std::string& context_id, const std::string& table,
+                            std::vector<executor::Tuple> rows, bool last,
+                            std::function<void()> credit) {
+        {
+            const std::scoped_lock<std::mutex> lock(mutex_);
+            auto& target = shuffle_buffers_[context_id][table];
+            if (!rows.empty()) {
+                target.chunks.push_back(std::move(rows));
+            }
+            if (last) {
+                target.senders_done++;
+            }
+            shuffle_cv_.notify_all();
+            if (target.chunks.size() > SHUFFLE_BUFFERED_CHUNKS) {
+                target.credits.push_back(std::move(credit));
+                return;
+            }
+        }
+        credit();
+    }
+
+    enum class ShuffleWait : uint8_t { Chunk, End, Canceled, TimedOut };
+
+    /**
+     * @brief Take the next chunk of a shuffle stream, waiting for one to arrive
+     * @param senders Number of senders whose final chunk ends the stream
+     * @param idle_timeout How long to wait for the next chunk before giving up
+     * @return Chunk if `out` holds rows; End once every sender has finished and
+     * the buffer is drained, after which the stream is forgotten
+     */
+    ShuffleWait next_shuffle_chunk(const std::string& context_id, const std::string& table,
+                                   size_t senders, std::vector<executor::Tuple>& out,
+                                   const std::atomic<bool>* canceled,
+                                   std::chrono::milliseconds idle_timeout) {
+        std::function<void()> credit;
+        ShuffleWait result = ShuffleWait::Chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto& target = shuffle_buffers_[context_id][table];
+            const bool ready = shuffle_cv_.wait_for(lock, idle_timeout, [&] {
+                return !target.chunks.empty() || target.senders_done >= senders ||
+                       (canceled != nullptr && canceled->load(std::memory_order_relaxed));
+            });
+            if (canceled != nullptr && canceled->load(std::memory_order_relaxed)) {
+                return ShuffleWait::Canceled;
+            }
+            if (!ready) {
+                return ShuffleWait::TimedOut;
+            }
+            if (!target.chunks.empty()) {
+                out = std::move(target.chunks.front());
+                target.chunks.pop_front();
+                if (!target.credits.empty()) {
+                    credit = std::move(target.credits.front());
+                    target.credits.pop_front();
+                }
+            } else {
+                result = ShuffleWait::End;
+                erase_shuffle_buffer(context_id, table);
+            }
+        }
+        if (credit) {
+            credit();
+        }
+        return result;
     }
 
     /**
@@ -184,10 +285,12 @@ class ClusterManager {
     [[nodiscard]] bool has_shuffle_data(const std::string& context_id,
                                         const std::string& table) const {
         const std::scoped_lock<std::mutex> lock(mutex_);
-        if (shuffle_buffers_.count(context_id) == 0U) {
+        const auto it = shuffle_buffers_.find(context_id);
+        if (it == shuffle_buffers_.end()) {
             return false;
         }
-        return shuffle_buffers_.at(context_id).count(table) != 0U;
+        const auto buffer = it->second.find(table);
+        return buffer != it->second.end() && !buffer->second.chunks.empty();
     }
 
     /**
@@ -195,22 +298,114 @@ class ClusterManager {
      */
     std::vector<executor::Tuple> fetch_shuffle_data(const std::string& context_id,
                                                     const std::string& table) {
-        const std::scoped_lock<std::mutex> lock(mutex_);
         std::vector<executor::Tuple> data;
-        if (shuffle_buffers_.count(context_id) != 0U) {
-            auto& context_buffers = shuffle_buffers_[context_id];
-            if (context_buffers.count(table) != 0U) {
-                data = std::move(context_buffers[table]);
-                context_buffers.erase(table);
+        std::deque<std::function<void()>> credits;
+        {
+            const std::scoped_lock<std::mutex> lock(mutex_);
+            const auto it = shuffle_buffers_.find(context_id);
+            if (it == shuffle_buffers_.end()) {
+                return data;
             }
-            if (context_buffers.empty()) {
-                shuffle_buffers_.erase(context_id);
+            const auto buffer = it->second.find(table);
+            if (buffer != it->second.end()) {
+                for (auto& chunk : buffer->second.chunks) {
+                    data.insert(data.end(), std::make_move_iterator(chunk.begin()),
+                                std::make_move_iterator(chunk.end()));
+                }
+                credits = std::move(buffer->second.credits);
+                erase_shuffle_buffer(context_id, table);
             }
         }
+        for (auto& credit : credits) {
+            credit();
+        }
         return data;
     }
 
+    /**
+     * @brief Record a fragment starting for a context
+     * @return The flag cancel_fragments() sets; pass it to end_fragment() when done
+     */
+    std::shared_ptr<std::atomic<bool>> begin_fragment(const std::string& context_id) {
+        const std::scoped_lock<std::mutex> lock(mutex_);
+        auto canceled = std::make_shared<std::atomic<bool>>(false);
+        running_fragments_[context_id].push_back(canceled);
+        return canceled;
+    }
+
+    /**
+     * @brief Forget a fragment started with begin_fragment()
+     *
+     * After the last fragment of a context, shuffle data it left unread is
+     * dropped and withheld acknowledgements are sent, so no sender stays
+     * blocked on a consumer that is gone.
+     */
+    void end_fragment(const std::string& context_id,
+                      const std::shared_ptr<std::atomic<bool>>& canceled) {
+        std::vector<std::function<void()>> credits;
+        {
+            const std::scoped_lock<std::mutex> lock(mutex_);
+            auto it = running_fragments_.find(context_id);
+            if (it == running_fragments_.end()) {
+                return;
+            }
+            auto& flags = it->second;
+            flags.erase(std::remove(flags.begin(), flags.end(), canceled), flags.end());
+            if (!flags.empty()) {
+                return;
+            }
+            running_fragments_.erase(it);
+            const auto buffers = shuffle_buffers_.find(context_id);
+            if (buffers != shuffle_buffers_.end()) {
+                for (auto& [table, buffer] : buffers->second) {
+                    for (auto& credit : buffer.credits) {
+                        credits.push_back(std::move(credit));
+                    }
+                }
+                shuffle_buffers_.erase(buffers);
+            }
+        }
+        for (auto& credit : credits) {
+            credit();
+        }
+    }
+
+    /**
+     * @brief Ask every fragment running for a context to stop
+     * @return The number of fragments signalled
+     */
+    size_t cancel_fragments(const std::string& context_id) {
+        const std::scoped_lock<std::mutex> lock(mutex_);
+        auto it = running_fragments_.find(context_id);
+        if (it == running_fragments_.end()) {
+            return 0;
+        }
+        for (const auto& canceled : it->second) {
+            canceled->store(true, std::memory_order_relaxed);
+        }
+        shuffle_cv_.notify_all(); /* Wakes fragments waiting on a shuffle stream */
+        return it->second.size();
+    }
+
    private:
+    struct ShuffleBuffer {
+        std::deque<std::vector<executor::Tuple>> chunks;
+        size_t senders_done = 0;
+        std::deque<std::function<void()>> credits; /**< Withheld acknowledgements, oldest first */
+    };
+
+    /** @brief Forget a drained stream; mutex_ is held */
+    void erase_shuffle_buffer(const std::string& context_id, const std::string& table) {
+        const auto it = shuffle_buffers_.find(context_id);
+        if (it == shuffle_buffers_.end()) {
+            return;
+        }
+        it->second.erase(table);
+        if (it->second.empty()) {
+            shuffle_buffers_.erase(it);
+        }
+    }
+
     const config::Config* config_;
     raft::RaftManager* raft_manager_;
     NodeInfo self_node_;
@@ -218,8 +413,13 @@ class ClusterManager {
     std::unordered_map<uint16_t, std::string> group_leaders_;
     std::unordered_map<uint16_t, std::vector<std::string>> group_membership_;
     /* context_id -> table_name -> rows */
-    std::unordered_map<std::string, std::unordered_map<std::string, std::vector<executor::Tuple>>>
+    std::unordered_map<std::string, std::unordered_map<std::string, ShuffleBuffer>>
         shuffle_buffers_;
+    std::condition_variable shuffle_cv_;
+    /* context_id -> cancel flags of the fragments running for it */
+    std::unordered_map<std::string, std::vector<std::shared_ptr<std::atomic<bool>>>>
+        running_fragments_;
+    network::RpcClientPool rpc_clients_;
     mutable std::mutex mutex_;
 };
 
@@ -9,6 +9,8 @@
 #include <cstdint>
 #include <string>
 
+#include "storage/page.hpp"
+
 namespace cloudsql::config {
 
 /**
@@ -27,24 +29,85 @@ class Config {
    public:
     static constexpr uint16_t DEFAULT_PORT = 5432;
     static constexpr uint16_t DEFAULT_CLUSTER_PORT = 6432;
+    static constexpr uint16_t DEFAULT_METRICS_PORT = 0;
     static constexpr uint16_t MAX_PORT = 65535;
     static constexpr const char* DEFAULT_DATA_DIR = "./data";
     static constexpr int DEFAULT_MAX_CONNECTIONS = 100;
     static constexpr int DEFAULT_BUFFER_POOL_SIZE = 128;
-    static constexpr int DEFAULT_PAGE_SIZE = 8192;
-    static constexpr int MIN_PAGE_SIZE = 1024;
-    static constexpr int MAX_PAGE_SIZE = 65536;
+    static constexpr const char* DEFAULT_BUFFER_REPLACER = "lru";
+    static constexpr const char* DEFAULT_IO_BACKEND = "posix";
+    static constexpr int DEFAULT_PARALLELISM = 0;
+    static constexpr int DEFAULT_SCAN_WORKERS = 0;
+    static constexpr int DEFAULT_JOIN_MEMORY_MB = 256;
+    static constexpr int DEFAULT_SORT_MEMORY_MB = 256;
+    static constexpr int DEFAULT_AGGREGATE_MEMORY_MB = 256;
+    static constexpr int DEFAULT_MAX_MEMORY_MB = 0;
+    static constexpr int DEFAULT_QUERY_MEMORY_MB = 1024;
+    static constexpr int DEFAULT_STREAM_BATCH_ROWS = 1024;
+    static constexpr int DEFAULT_RESULT_CACHE_MB = 64;
+    static constexpr int DEFAULT_IO_THREADS = 2;
+    static constexpr int DEFAULT_WORKER_THREADS = 0;
+    static constexpr int DEFAULT_COMMIT_DELAY_US = 0;
+    static constexpr int DEFAULT_COMMIT_GROUP_SIZE = 16;
+    static constexpr int DEFAULT_RECOVERY_THREADS = 0;
+    static constexpr int DEFAULT_CHECKPOINT_INTERVAL_S = 60;
+    static constexpr int DEFAULT_CHECKPOINT_SPREAD_PCT = 50;
+    static constexpr int DEFAULT_BGWRITER_DELAY_MS = 200;
+    static constexpr int DEFAULT_BGWRITER_MAX_PAGES = 100;
+    static constexpr int DEFAULT_BGWRITER_CLEAN_PCT = 10;
+    static constexpr int DEFAULT_AUTOVACUUM_NAPTIME_MS = 1000;
+    static constexpr int DEFAULT_AUTOVACUUM_THRESHOLD = 500;
+    static constexpr int DEFAULT_VACUUM_COST_LIMIT = 200;
+    static constexpr int DEFAULT_VACUUM_COST_DELAY_MS = 20;
+    static constexpr int DEFAULT_REPLICA_NAPTIME_MS = 100;
+    static constexpr int DEFAULT_REPLICA_MAX_LAG_MS = 1000;
+    static constexpr double DEFAULT_TRACE_SAMPLE_RATE = 0.0;
+    static constexpr int DEFAULT_TRACE_BUFFER_SPANS = 4096;
 
     // Configuration fields
     uint16_t port = DEFAULT_PORT;
     uint16_t cluster_port = DEFAULT_CLUSTER_PORT;
+    uint16_t metrics_port = DEFAULT_METRICS_PORT;  // HTTP /metrics endpoint; 0 = off
     std::string data_dir = DEFAULT_DATA_DIR;
     std::string config_file;
     RunMode mode = RunMode::Standalone;
     std::string seed_nodes;  // Comma-separated list of coordinator addresses
     int max_connections = DEFAULT_MAX_CONNECTIONS;
     int buffer_pool_size = DEFAULT_BUFFER_POOL_SIZE;
-    int page_size = DEFAULT_PAGE_SIZE;
+    std::string buffer_replacer = DEFAULT_BUFFER_REPLACER;  // lru | clock | lru-k
+    bool buffer_huge_pages = true;  // back pools of 2 MB or more with huge pages
+    bool buffer_numa = false;       // split the pool's partitions and memory across NUMA nodes
+    std::string io_backend = DEFAULT_IO_BACKEND;            // posix | io_uring
+    bool direct_io = false;                                 // open data files with O_DIRECT
+    // new databases only; fixed once the data dir exists; limits are storage::Page's
+    int page_size = static_cast<int>(storage::Page::DEFAULT_PAGE_SIZE);
+    int parallelism = DEFAULT_PARALLELISM;  // vectorized query workers; 0 = one per core
+    int scan_workers = DEFAULT_SCAN_WORKERS;  // cap on heap scan workers; 0 = one per core, 1 = off
+    int join_memory_mb = DEFAULT_JOIN_MEMORY_MB;  // hash join build side before spilling; 0 = never
+    int sort_memory_mb = DEFAULT_SORT_MEMORY_MB;  // ORDER BY rows before spilling runs; 0 = never
+    int aggregate_memory_mb = DEFAULT_AGGREGATE_MEMORY_MB;  // GROUP BY state; 0 = never spill
+    int max_memory_mb = DEFAULT_MAX_MEMORY_MB;      // all queries and buffers; 0 = no limit
+    int query_memory_mb = DEFAULT_QUERY_MEMORY_MB;  // tracked by one query; 0 = no limit
+    int stream_batch_rows = DEFAULT_STREAM_BATCH_ROWS;  // DataRows per send; 0 = whole result
+    int result_cache_mb = DEFAULT_RESULT_CACHE_MB;  // results for SET result_cache; 0 = off
+    int io_threads = DEFAULT_IO_THREADS;          // epoll threads reading client connections
+    int worker_threads = DEFAULT_WORKER_THREADS;  // threads running queries; 0 = one per core
+    int commit_delay_us = DEFAULT_COMMIT_DELAY_US;  // WAL flush held back for more commits
+    int commit_group_size = DEFAULT_COMMIT_GROUP_SIZE;  // commits waiting that end the delay
+    int recovery_threads = DEFAULT_RECOVERY_THREADS;    // redo/undo workers; 0 = one per core
+    int checkpoint_interval_s = DEFAULT_CHECKPOINT_INTERVAL_S;  // fuzzy checkpoints; 0 = never
+    int checkpoint_spread_pct = DEFAULT_CHECKPOINT_SPREAD_PCT;  // of the interval spent writing
+    int bgwriter_delay_ms = DEFAULT_BGWRITER_DELAY_MS;    // between cleaning rounds; 0 = off
+    int bgwriter_max_pages = DEFAULT_BGWRITER_MAX_PAGES;  // pages written per round
+    int bgwriter_clean_pct = DEFAULT_BGWRITER_CLEAN_PCT;  // of the pool kept clean and evictable
+    int autovacuum_naptime_ms = DEFAULT_AUTOVACUUM_NAPTIME_MS;  // between checks; 0 = off
+    int autovacuum_threshold = DEFAULT_AUTOVACUUM_THRESHOLD;    // dead row versions per table
+    int vacuum_cost_limit = DEFAULT_VACUUM_COST_LIMIT;          // pages between autovacuum pauses
+    int vacuum_cost_delay_ms = DEFAULT_VACUUM_COST_DELAY_MS;    // length of a pause; 0 = none
+    int replica_naptime_ms = DEFAULT_REPLICA_NAPTIME_MS;  // columnar replicas read the WAL
+    int replica_max_lag_ms = DEFAULT_REPLICA_MAX_LAG_MS;  // staleness a replica read allows
+    double trace_sample_rate = DEFAULT_TRACE_SAMPLE_RATE;  // statements traced, 0 to 1; 0 = off
+    int trace_buffer_spans = DEFAULT_TRACE_BUFFER_SPANS;   // newest spans kept for sys_traces
     bool debug = false;
     bool verbose = false;
 
@@ -0,0 +1,94 @@
+/**
+ * @file latency_histogram.hpp
+ * @brief Lock-free log2-bucketed latency histogram
+ */
+
+#ifndef SQL_ENGINE_COMMON_LATENCY_HISTOGRAM_HPP
+#define SQL_ENGINE_COMMON_LATENCY_HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace cloudsql::common {
+
+/**
+ * @brief Histogram of durations in microseconds with power-of-two buckets
+ *
+ * Bucket i counts samples in [2^(i-1), 2^i) us (bucket 0 holds sub-microsecond
+ * samples); the last bucket is open-ended. Recording is wait-free.
+ */
+class LatencyHistogram {
+   public:
+    static constexpr size_t NUM_BUCKETS = 24;
+
+    LatencyHistogram() = default;
+
+    // Disable copy/move (atomic counters)
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+    LatencyHistogram(LatencyHistogram&&) = delete;
+    LatencyHistogram& operator=(LatencyHistogram&&) = delete;
+    ~LatencyHistogram() = default;
+
+    void record(uint64_t micros) {
+        static_cast<void>(sum_.fetch_add(micros, std::memory_order_relaxed));
+        size_t bucket = 0;
+        while (micros != 0 && bucket < NUM_BUCKETS - 1) {
+            micros >>= 1U;
+            bucket++;
+        }
+        static_cast<void>(buckets_[bucket].fetch_add(1, std::memory_order_relaxed));
+        static_cast<void>(count_.fetch_add(1, std::memory_order_relaxed));
+    }
+
+    void record(std::chrono::steady_clock::duration elapsed) {
+        record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+    }
+
+    [[nodiscard]] uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    /** @return Total of all samples in microseconds */
+    [[nodiscard]] uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+
+    [[nodiscard]] uint64_t bucket_count(size_t bucket) const {
+        return buckets_[bucket].load(std::memory_order_relaxed);
+    }
+
+    /** @return Exclusive upper bound of a bucket in microseconds */
+    [[nodiscard]] static uint64_t bucket_upper_bound(size_t bucket) {
+        return uint64_t{1} << bucket;
+    }
+
+    /**
+     * @brief Approximate percentile (upper bound of the bucket containing it)
+     * @param pct Percentile in [0, 100]
+     */
+    [[nodiscard]] uint64_t percentile(double pct) const {
+        const uint64_t total = count();
+        if (total == 0) {
+            return 0;
+        }
+        const auto target = static_cast<uint64_t>(static_cast<double>(total) * pct / 100.0);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            seen += bucket_count(i);
+            if (seen > target || seen == total) {
+                return bucket_upper_bound(i);
+            }
+        }
+        return bucket_upper_bound(NUM_BUCKETS - 1);
+    }
+
+   private:
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+};
+
+}  // namespace cloudsql::common
+
+#endif  // SQL_ENGINE_COMMON_LATENCY_HISTOGRAM_HPP
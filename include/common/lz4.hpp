@@ -0,0 +1,38 @@
+/**
+ * @file lz4.hpp
+ * @brief LZ4 block compression
+ *
+ * Implements the LZ4 block format (sequences of literals and back-references
+ * of up to 64 KB) in-tree, so no liblz4 is needed. Blocks are interchangeable
+ * with LZ4_compress_default / LZ4_decompress_safe; the compressor is a greedy
+ * single-probe matcher, which trades a little ratio for speed.
+ */
+
+#ifndef CLOUDSQL_COMMON_LZ4_HPP
+#define CLOUDSQL_COMMON_LZ4_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cloudsql::common::lz4 {
+
+/** @return The largest block compress() can produce for `size` input bytes */
+[[nodiscard]] constexpr size_t max_compressed_size(size_t size) {
+    return size + size / 255 + 16;
+}
+
+/**
+ * @brief Compresses `size` bytes and appends the block to `out`
+ */
+void compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+/**
+ * @brief Decodes a block that expands to exactly `out_size` bytes
+ * @return false if the block is malformed or does not match `out_size`
+ */
+[[nodiscard]] bool decompress(const uint8_t* data, size_t size, uint8_t* out, size_t out_size);
+
+}  // namespace cloudsql::common::lz4
+
+#endif  // CLOUDSQL_COMMON_LZ4_HPP
@@ -0,0 +1,133 @@
+/**
+ * @file memory_tracker.hpp
+ * @brief Hierarchical memory accounting: process, session, query and operator
+ */
+
+#ifndef SQL_ENGINE_COMMON_MEMORY_TRACKER_HPP
+#define SQL_ENGINE_COMMON_MEMORY_TRACKER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace cloudsql::common {
+
+/**
+ * @brief Thrown when a consumer that cannot spill is refused memory; the
+ * statement running it fails with the message
+ */
+class MemoryLimitError : public std::runtime_error {
+   public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief Bytes charged to one level of the tree global → session → query → operator
+ *
+ * A charge counts against the tracker and every ancestor. try_consume()
+ * refuses a charge that would take any of them past its limit (0 = none) and
+ * charges nothing then; consume() always charges, for memory that is already
+ * held. A tracker gives back whatever it still holds when destroyed, so it
+ * must not outlive its parent.
+ *
+ * Operators take a tracker of their own when built inside a Scope, the way
+ * they take OperatorStats inside an InstrumentScope. Charges are atomic, so a
+ * tracker may be charged from several threads. Estimates are what the
+ * consumers hold in their own containers; allocator overhead is not counted.
+ */
+class MemoryTracker {
+   public:
+    /**
+     * @brief While it lives, operators constructed on this thread charge
+     * trackers made under `tracker` (null: none)
+     */
+    class Scope {
+       public:
+        explicit Scope(MemoryTracker* tracker);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        Scope(Scope&&) = delete;
+        Scope& operator=(Scope&&) = delete;
+
+       private:
+        MemoryTracker* previous_;
+    };
+
+    explicit MemoryTracker(std::string label, size_t limit = 0, MemoryTracker* parent = nullptr);
+    ~MemoryTracker();
+
+    MemoryTracker(const MemoryTracker&) = delete;
+    MemoryTracker& operator=(const MemoryTracker&) = delete;
+    MemoryTracker(MemoryTracker&&) = delete;
+    MemoryTracker& operator=(MemoryTracker&&) = delete;
+
+    /** @return The root of every tree: all the memory the process accounts for */
+    [[nodiscard]] static MemoryTracker& global();
+
+    /** @return The tracker of the innermost Scope on this thread, or null */
+    [[nodiscard]] static MemoryTracker* current();
+
+    /** @return A fresh tracker under current(), or null outside a Scope */
+    [[nodiscard]] static std::unique_ptr<MemoryTracker> make_child(std::string label);
+
+    /**
+     * @brief Charges `bytes` unless that takes this tracker or an ancestor past its limit
+     * @param refused Set to the tracker whose limit refused the charge
+     */
+    [[nodiscard]] bool try_consume(size_t bytes, const MemoryTracker** refused = nullptr);
+
+    /** @brief Charges `bytes` whatever the limits */
+    void consume(size_t bytes);
+
+    void release(size_t bytes);
+
+    /**
+     * @brief Moves the charge to `bytes` in total
+     * @return false, leaving the charge as it was, if a limit refuses the growth
+     */
+    [[nodiscard]] bool try_resize(size_t bytes, const MemoryTracker** refused = nullptr);
+
+    /**
+     * @brief Moves the charge to `bytes` in total
+     * @throws MemoryLimitError naming `consumer` if a limit refuses the growth
+     */
+    void resize(size_t bytes, const std::string& consumer);
+
+    /** @brief The error resize() throws when `refused` turned `consumer` down */
+    [[nodiscard]] static std::string limit_message(const MemoryTracker& refused,
+                                                   const std::string& consumer);
+
+    [[nodiscard]] const std::string& label() const { return label_; }
+    [[nodiscard]] MemoryTracker* parent() const { return parent_; }
+
+    /** @brief Bytes this tracker may hold with its descendants; 0 = no limit */
+    [[nodiscard]] size_t limit() const { return limit_.load(std::memory_order_relaxed); }
+    void set_limit(size_t bytes) { limit_.store(bytes, std::memory_order_relaxed); }
+
+    [[nodiscard]] size_t consumed() const { return consumed_.load(std::memory_order_relaxed); }
+
+    /** @return The most ever charged at once */
+    [[nodiscard]] size_t peak() const { return peak_.load(std::memory_order_relaxed); }
+
+    /** @return Charges refused by this tracker's own limit */
+    [[nodiscard]] uint64_t refusals() const { return refusals_.load(std::memory_order_relaxed); }
+
+   private:
+    void raise_peak(size_t consumed);
+
+    std::string label_;
+    MemoryTracker* parent_;
+    std::atomic<size_t> limit_;
+    std::atomic<size_t> consumed_{0};
+    std::atomic<size_t> peak_{0};
+    std::atomic<uint64_t> refusals_{0};
+};
+
+}  // namespace cloudsql::common
+
+#endif  // SQL_ENGINE_COMMON_MEMORY_TRACKER_HPP
@@ -0,0 +1,200 @@
+/**
+ * @file metrics.hpp
+ * @brief Process-wide metrics registry with Prometheus text export
+ */
+
+#ifndef SQL_ENGINE_COMMON_METRICS_HPP
+#define SQL_ENGINE_COMMON_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/latency_histogram.hpp"
+
+namespace cloudsql::common {
+
+enum class MetricType : uint8_t { Counter, Gauge, Histogram };
+
+/**
+ * @brief Monotonic counter; increments are a single relaxed atomic add
+ */
+class Counter {
+   public:
+    void inc(uint64_t n = 1) { static_cast<void>(value_.fetch_add(n, std::memory_order_relaxed)); }
+    [[nodiscard]] uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+   private:
+    std::atomic<uint64_t> value_{0};
+};
+
+/**
+ * @brief Value that may go up and down
+ */
+class Gauge {
+   public:
+    void set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void add(int64_t n) { static_cast<void>(value_.fetch_add(n, std::memory_order_relaxed)); }
+    [[nodiscard]] int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+   private:
+    std::atomic<int64_t> value_{0};
+};
+
+/**
+ * @brief Values of every metric at one instant
+ *
+ * Collectors add to it, and series reported under the same name and labels
+ * are summed: two buffer pools in one process export one set of totals.
+ * Labels are given in Prometheus syntax without the braces, e.g. group="3".
+ * Histograms are latencies in microseconds, exported in seconds.
+ */
+class MetricsSnapshot {
+   public:
+    /** @brief One series as a row of the sys_metrics view */
+    struct Row {
+        std::string name;
+        std::string labels;
+        MetricType type = MetricType::Counter;
+        double value = 0;
+    };
+
+    void add_counter(const std::string& name, const std::string& help, double value,
+                     const std::string& labels = "");
+    void add_gauge(const std::string& name, const std::string& help, double value,
+                   const std::string& labels = "");
+    void add_histogram(const std::string& name, const std::string& help,
+                       const LatencyHistogram& histogram, const std::string& labels = "");
+
+    /** @brief Prometheus text exposition format, version 0.0.4 */
+    [[nodiscard]] std::string to_prometheus() const;
+
+    /**
+     * @brief Flattened series in name order; a histogram gives its _count,
+     * _sum and 0.5 / 0.99 quantiles
+     */
+    [[nodiscard]] std::vector<Row> rows() const;
+
+   private:
+    struct Series {
+        double value = 0;
+        std::array<uint64_t, LatencyHistogram::NUM_BUCKETS> buckets{};
+        uint64_t count = 0;
+        uint64_t sum_us = 0;
+    };
+
+    struct Family {
+        std::string help;
+        MetricType type = MetricType::Counter;
+        std::map<std::string, Series> series; /**< By label set */
+    };
+
+    Series& series(const std::string& name, const std::string& help, MetricType type,
+                   const std::string& labels);
+
+    std::map<std::string, Family> families_;
+};
+
+/**
+ * @class MetricsRegistry
+ * @brief Owns the process's metrics and the collectors that report the rest
+ *
+ * Hot paths hold a reference to a Counter, Gauge or LatencyHistogram looked
+ * up once, so recording never takes a lock. State already counted elsewhere
+ * (a buffer pool's Stats, a Raft group's indexes) is read at scrape time by a
+ * collector instead; the component keeps the returned Registration as its
+ * last member, so the collector is gone before the state it reads.
+ */
+class MetricsRegistry {
+   public:
+    using Collector = std::function<void(MetricsSnapshot&)>;
+
+    /** @brief Unregisters its collector when destroyed */
+    class Registration {
+       public:
+        Registration() = default;
+        Registration(MetricsRegistry* registry, uint64_t id) : registry_(registry), id_(id) {}
+        ~Registration() { reset(); }
+
+        Registration(const Registration&) = delete;
+        Registration& operator=(const Registration&) = delete;
+        Registration(Registration&& other) noexcept
+            : registry_(std::exchange(other.registry_, nullptr)), id_(other.id_) {}
+        Registration& operator=(Registration&& other) noexcept {
+            if (this != &other) {
+                reset();
+                registry_ = std::exchange(other.registry_, nullptr);
+                id_ = other.id_;
+            }
+            return *this;
+        }
+
+        void reset();
+
+       private:
+        MetricsRegistry* registry_ = nullptr;
+        uint64_t id_ = 0;
+    };
+
+    MetricsRegistry() = default;
+    ~MetricsRegistry() = default;
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+    MetricsRegistry(MetricsRegistry&&) = delete;
+    MetricsRegistry& operator=(MetricsRegistry&&) = delete;
+
+    /** @brief The registry scraped by the metrics endpoint and sys_metrics */
+    static MetricsRegistry& global();
+
+    /** @brief Find or create a metric; the reference stays valid for the registry's life */
+    Counter& counter(const std::string& name, const std::string& help,
+                     const std::string& labels = "");
+    Gauge& gauge(const std::string& name, const std::string& help,
+                 const std::string& labels = "");
+    LatencyHistogram& histogram(const std::string& name, const std::string& help,
+                                const std::string& labels = "");
+
+    [[nodiscard]] Registration add_collector(Collector collector);
+
+    /** @brief Read every metric and run every collector */
+    [[nodiscard]] MetricsSnapshot collect() const;
+
+   private:
+    struct Owned {
+        std::string name;
+        std::string labels;
+        std::string help;
+        MetricType type = MetricType::Counter;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<LatencyHistogram> histogram;
+    };
+
+    Owned& find_or_add(const std::string& name, const std::string& help, MetricType type,
+                       const std::string& labels);
+    void remove_collector(uint64_t id);
+
+    mutable std::mutex metrics_latch_; /**< Guards owned_; never held while calling out */
+    std::map<std::pair<std::string, std::string>, Owned> owned_;
+
+    /* Held while collectors run, so unregistering waits out a scrape in progress */
+    mutable std::mutex collectors_latch_;
+    std::map<uint64_t, Collector> collectors_;
+    uint64_t next_collector_ = 1;
+};
+
+/** @brief `key="value"`, with the value escaped for the text format */
+std::string metric_label(const std::string& key, const std::string& value);
+
+}  // namespace cloudsql::common
+
+#endif  // SQL_ENGINE_COMMON_METRICS_HPP
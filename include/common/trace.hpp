@@ -0,0 +1,180 @@
+/**
+ * @file trace.hpp
+ * @brief Sampled distributed tracing with an in-memory span buffer
+ */
+
+#ifndef SQL_ENGINE_COMMON_TRACE_HPP
+#define SQL_ENGINE_COMMON_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cloudsql::common {
+
+/**
+ * @brief Where a span sits in its trace; carried across nodes in the RPC header
+ */
+struct TraceContext {
+    uint64_t trace_id = 0; /**< 0 when the work is not being traced */
+    uint64_t span_id = 0;  /**< The span new work is a child of */
+
+    [[nodiscard]] bool traced() const { return trace_id != 0; }
+};
+
+/**
+ * @brief A finished span
+ */
+struct SpanRecord {
+    uint64_t trace_id = 0;
+    uint64_t span_id = 0;
+    uint64_t parent_id = 0; /**< 0 for the root of a trace */
+    std::string name;
+    std::string node;
+    int64_t start_us = 0; /**< Wall clock, microseconds since the Unix epoch */
+    uint64_t duration_us = 0;
+    std::vector<std::pair<std::string, std::string>> attributes;
+
+    /** @return The attributes as `key=value, key=value` */
+    [[nodiscard]] std::string attributes_text() const;
+};
+
+/**
+ * @class Tracer
+ * @brief Decides which statements are traced and keeps the spans they record
+ *
+ * A trace starts where a statement enters the cluster, with probability
+ * sample_rate(); everything the statement then does, on this node or on the
+ * ones it calls, records spans under the same trace id. Work outside a trace
+ * costs one thread-local read per span site. Finished spans go to a ring
+ * buffer of the newest capacity() spans, read by the sys_traces view and
+ * exported as OTLP/JSON.
+ */
+class Tracer {
+   public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+    Tracer() = default;
+    ~Tracer() = default;
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+    Tracer(Tracer&&) = delete;
+    Tracer& operator=(Tracer&&) = delete;
+
+    static Tracer& global();
+
+    /** @param rate Fraction of statements traced, from 0 (off) to 1 (all) */
+    void set_sample_rate(double rate);
+    [[nodiscard]] double sample_rate() const {
+        return sample_rate_.load(std::memory_order_relaxed);
+    }
+
+    /** @brief Resize the buffer, dropping the spans in it */
+    void set_capacity(size_t capacity);
+    [[nodiscard]] size_t capacity() const;
+
+    /** @brief Name recorded as the node of every span */
+    void set_node(const std::string& node);
+
+    /** @return A new trace, or an untraced context if this statement is not sampled */
+    [[nodiscard]] TraceContext start_trace() const;
+
+    void record(SpanRecord span);
+
+    /** @brief The buffered spans, oldest first */
+    [[nodiscard]] std::vector<SpanRecord> spans() const;
+
+    void clear();
+
+    /** @brief The buffered spans as an OTLP/JSON ExportTraceServiceRequest */
+    [[nodiscard]] std::string to_otlp_json() const;
+
+    /** @brief The calling thread's current span */
+    [[nodiscard]] static TraceContext current();
+
+    /** @return A random, non-zero span or trace id */
+    [[nodiscard]] static uint64_t new_id();
+
+    /** @return Microseconds since the Unix epoch, as SpanRecord::start_us */
+    [[nodiscard]] static int64_t wall_clock_us();
+
+    /** @return `id` as 16 hex digits */
+    [[nodiscard]] static std::string id_hex(uint64_t id);
+
+   private:
+    std::atomic<double> sample_rate_{0};
+
+    mutable std::mutex latch_; /**< Guards everything below */
+    std::string node_;
+    std::vector<SpanRecord> ring_ = std::vector<SpanRecord>(DEFAULT_CAPACITY);
+    size_t next_ = 0;       /**< Slot the next span goes in */
+    bool wrapped_ = false;  /**< Every slot has been written */
+};
+
+/**
+ * @brief Makes `context` the thread's current span until destroyed
+ */
+class TraceScope {
+   public:
+    explicit TraceScope(TraceContext context);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+    TraceScope(TraceScope&&) = delete;
+    TraceScope& operator=(TraceScope&&) = delete;
+
+   private:
+    TraceContext saved_;
+};
+
+/**
+ * @brief RAII span, recorded when it ends
+ *
+ * A span is a child of the thread's current span, or of an explicit parent
+ * that came in over the wire, and is itself the current span until it ends,
+ * so spans opened meanwhile on the same thread nest under it. Spans must end
+ * on the thread and in the reverse order they started. Outside a trace a span
+ * does nothing.
+ */
+class Span {
+   public:
+    enum class Start : uint8_t {
+        ChildOnly,     /**< Only inside a trace */
+        RootIfSampled  /**< Outside a trace, start one if the tracer samples it */
+    };
+
+    explicit Span(const char* name, Start start = Start::ChildOnly);
+    Span(const char* name, TraceContext parent);
+    ~Span() { end(); }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+    Span(Span&&) = delete;
+    Span& operator=(Span&&) = delete;
+
+    [[nodiscard]] bool active() const { return record_.trace_id != 0; }
+    [[nodiscard]] TraceContext context() const { return {record_.trace_id, record_.span_id}; }
+
+    void set_attribute(const std::string& key, const std::string& value);
+
+    /** @brief Record the span now rather than when it is destroyed */
+    void end();
+
+   private:
+    void begin(const char* name, TraceContext parent);
+
+    SpanRecord record_;
+    TraceContext saved_;
+    std::chrono::steady_clock::time_point started_;
+};
+
+}  // namespace cloudsql::common
+
+#endif  // SQL_ENGINE_COMMON_TRACE_HPP
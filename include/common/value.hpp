@@ -7,13 +7,15 @@
 #define CLOUDSQL_COMMON_VALUE_HPP
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <functional>
 #include <optional>
 #include <stdexcept>
 #include <string>
-#include <variant>
+#include <string_view>
 
 namespace cloudsql::common {
 
@@ -42,15 +44,84 @@ enum class ValueType : uint8_t {
 };
 
 /**
- * @brief Type-safe Value class with std::variant
+ * @brief Type-safe Value class in 16 bytes
+ *
+ * Text of up to INLINE_TEXT_CAPACITY bytes is stored inline, so only longer
+ * strings cost a heap allocation. The type decides which payload is live:
+ * integers and booleans share an int64_t, floats are held as double, and
+ * types without a payload (NULL, DECIMAL, DATE, ...) carry none.
  */
-class Value {
+class alignas(8) Value {
+   public:
+    static constexpr size_t INLINE_TEXT_CAPACITY = 14;
+
    private:
-    ValueType type_;
-    std::variant<std::monostate, bool, int64_t, double, std::string> data_;
+    enum class Payload : uint8_t { None, Bool, Int, Float, Text };
+
+    static constexpr uint8_t HEAP_TEXT = 0xFF; /**< text_size_ of heap text */
+    static constexpr size_t SCALAR_OFFSET = 6; /**< bytes_ offset of the 8-byte payload */
+    static constexpr size_t HEAP_SIZE_OFFSET = 2;
+
+    ValueType type_ = ValueType::TYPE_NULL;
+    uint8_t text_size_ = 0; /**< Inline text length, or HEAP_TEXT */
+    /* Inline text, or the scalar / heap text pointer at SCALAR_OFFSET with the
+       heap text length at HEAP_SIZE_OFFSET */
+    std::array<char, INLINE_TEXT_CAPACITY> bytes_{};
+
+    [[nodiscard]] static constexpr Payload payload_of(ValueType type) {
+        switch (type) {
+            case ValueType::TYPE_BOOL:
+                return Payload::Bool;
+            case ValueType::TYPE_INT8:
+            case ValueType::TYPE_INT16:
+            case ValueType::TYPE_INT32:
+            case ValueType::TYPE_INT64:
+                return Payload::Int;
+            case ValueType::TYPE_FLOAT32:
+            case ValueType::TYPE_FLOAT64:
+                return Payload::Float;
+            case ValueType::TYPE_CHAR:
+            case ValueType::TYPE_VARCHAR:
+            case ValueType::TYPE_TEXT:
+                return Payload::Text;
+            default:
+                return Payload::None;
+        }
+    }
+    [[nodiscard]] Payload payload() const { return payload_of(type_); }
+
+    template <typename T>
+    [[nodiscard]] T load(size_t offset = SCALAR_OFFSET) const {
+        T v;
+        std::memcpy(&v, bytes_.data() + offset, sizeof(T));
+        return v;
+    }
+    template <typename T>
+    void store(T v, size_t offset = SCALAR_OFFSET) {
+        std::memcpy(bytes_.data() + offset, &v, sizeof(T));
+    }
+
+    [[nodiscard]] bool heap_text() const { return text_size_ == HEAP_TEXT; }
+    [[nodiscard]] std::string_view text() const {
+        if (heap_text()) return {load<const char*>(), load<uint32_t>(HEAP_SIZE_OFFSET)};
+        return {bytes_.data(), text_size_};
+    }
+    void assign_text(std::string_view v);
+    void copy_from(const Value& other);
+    void steal(Value& other) noexcept {
+        type_ = other.type_;
+        text_size_ = other.text_size_;
+        bytes_ = other.bytes_;
+        other.type_ = ValueType::TYPE_NULL;
+        other.text_size_ = 0;
+    }
+    void release() noexcept {
+        if (heap_text()) delete[] load<char*>();
+        text_size_ = 0;
+    }
 
    public:
-    Value();
+    Value() = default;
     explicit Value(ValueType type);
     explicit Value(bool v);
     explicit Value(int8_t v);
@@ -60,13 +131,27 @@ class Value {
     explicit Value(float v);
     explicit Value(double v);
     explicit Value(const std::string& v);
+    explicit Value(std::string_view v);
     explicit Value(const char* v);
 
-    ~Value() = default;
-    Value(const Value& other) = default;
-    Value(Value&& other) noexcept = default;
-    Value& operator=(const Value& other) = default;
-    Value& operator=(Value&& other) noexcept = default;
+    ~Value() { release(); }
+    Value(const Value& other) { copy_from(other); }
+    Value(Value&& other) noexcept { steal(other); }
+    Value& operator=(const Value& other) {
+        if (this != &other) {
+            release();
+            type_ = ValueType::TYPE_NULL;
+            copy_from(other);
+        }
+        return *this;
+    }
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            release();
+            steal(other);
+        }
+        return *this;
+    }
 
     /* Comparison operators */
     [[nodiscard]] bool operator==(const Value& other) const;
@@ -80,7 +165,7 @@ class Value {
     [[nodiscard]] static Value make_bool(bool v);
     [[nodiscard]] static Value make_int64(int64_t v);
     [[nodiscard]] static Value make_float64(double v);
-    [[nodiscard]] static Value make_text(const std::string& v);
+    [[nodiscard]] static Value make_text(std::string_view v);
 
     [[nodiscard]] ValueType type() const { return type_; }
     [[nodiscard]] bool is_null() const { return type_ == ValueType::TYPE_NULL; }
@@ -93,7 +178,18 @@ class Value {
     [[nodiscard]] int64_t as_int64() const;
     [[nodiscard]] float as_float32() const;
     [[nodiscard]] double as_float64() const;
-    [[nodiscard]] const std::string& as_text() const;
+    [[nodiscard]] std::string as_text() const { return std::string(text_view()); }
+
+    /**
+     * @brief Text of a CHAR/VARCHAR/TEXT value without copying it
+     * @return View valid until the value is modified or destroyed
+     */
+    [[nodiscard]] std::string_view text_view() const;
+
+    /** @return Bytes this value owns outside itself (long text) */
+    [[nodiscard]] size_t heap_bytes() const {
+        return heap_text() ? load<uint32_t>(HEAP_SIZE_OFFSET) : 0;
+    }
 
     [[nodiscard]] int64_t to_int64() const;
     [[nodiscard]] double to_float64() const;
@@ -102,7 +198,8 @@ class Value {
 
     void swap(Value& other) noexcept {
         std::swap(type_, other.type_);
-        std::swap(data_, other.data_);
+        std::swap(text_size_, other.text_size_);
+        std::swap(bytes_, other.bytes_);
     }
 
     struct Hash {
@@ -110,54 +207,74 @@ class Value {
     };
 };
 
-// Constructors
-inline Value::Value() : type_(ValueType::TYPE_NULL), data_(std::monostate{}) {}
+static_assert(sizeof(Value) == 16, "Value is expected to fit in 16 bytes");
 
-inline Value::Value(ValueType type) : type_(type), data_(std::monostate{}) {
-    if (type != ValueType::TYPE_NULL) {
-        /* Initialize with default values based on type */
-        switch (type) {
-            case ValueType::TYPE_BOOL:
-                data_ = false;
-                break;
-            case ValueType::TYPE_INT8:
-            case ValueType::TYPE_INT16:
-            case ValueType::TYPE_INT32:
-            case ValueType::TYPE_INT64:
-                data_ = int64_t(0);
-                break;
-            case ValueType::TYPE_FLOAT32:
-            case ValueType::TYPE_FLOAT64:
-                data_ = 0.0;
-                break;
-            case ValueType::TYPE_TEXT:
-            case ValueType::TYPE_VARCHAR:
-            case ValueType::TYPE_CHAR:
-                data_ = std::string("");
-                break;
-            default:
-                break;
-        }
+// Storage
+inline void Value::assign_text(std::string_view v) {
+    if (v.size() <= INLINE_TEXT_CAPACITY) {
+        std::memcpy(bytes_.data(), v.data(), v.size());
+        text_size_ = static_cast<uint8_t>(v.size());
+        return;
+    }
+    if (v.size() > UINT32_MAX) {
+        throw std::length_error("Value text exceeds 4 GiB");
+    }
+    char* const heap = new char[v.size()];
+    std::memcpy(heap, v.data(), v.size());
+    store(static_cast<const char*>(heap));
+    store(static_cast<uint32_t>(v.size()), HEAP_SIZE_OFFSET);
+    text_size_ = HEAP_TEXT;
+}
+
+inline void Value::copy_from(const Value& other) {
+    if (other.heap_text()) {
+        assign_text(other.text());
+    } else {
+        bytes_ = other.bytes_;
+        text_size_ = other.text_size_;
     }
+    type_ = other.type_;
+}
+
+// Constructors
+inline Value::Value(ValueType type) : type_(type) {}
+
+inline Value::Value(bool v) : type_(ValueType::TYPE_BOOL) {
+    store(static_cast<int64_t>(v ? 1 : 0));
 }
 
-inline Value::Value(bool v) : type_(ValueType::TYPE_BOOL), data_(v) {}
+inline Value::Value(int8_t v) : type_(ValueType::TYPE_INT8) {
+    store(static_cast<int64_t>(v));
+}
 
-inline Value::Value(int8_t v) : type_(ValueType::TYPE_INT8), data_(static_cast<int64_t>(v)) {}
+inline Value::Value(int16_t v) : type_(ValueType::TYPE_INT16) {
+    store(static_cast<int64_t>(v));
+}
 
-inline Value::Value(int16_t v) : type_(ValueType::TYPE_INT16), data_(static_cast<int64_t>(v)) {}
+inline Value::Value(int32_t v) : type_(ValueType::TYPE_INT32) {
+    store(static_cast<int64_t>(v));
+}
 
-inline Value::Value(int32_t v) : type_(ValueType::TYPE_INT32), data_(static_cast<int64_t>(v)) {}
+inline Value::Value(int64_t v) : type_(ValueType::TYPE_INT64) {
+    store(v);
+}
 
-inline Value::Value(int64_t v) : type_(ValueType::TYPE_INT64), data_(v) {}
+inline Value::Value(float v) : type_(ValueType::TYPE_FLOAT32) {
+    store(static_cast<double>(v));
+}
 
-inline Value::Value(float v) : type_(ValueType::TYPE_FLOAT32), data_(static_cast<double>(v)) {}
+inline Value::Value(double v) : type_(ValueType::TYPE_FLOAT64) {
+    store(v);
+}
 
-inline Value::Value(double v) : type_(ValueType::TYPE_FLOAT64), data_(v) {}
+inline Value::Value(const std::string& v) : Value(std::string_view(v)) {}
 
-inline Value::Value(const std::string& v) : type_(ValueType::TYPE_TEXT), data_(v) {}
+inline Value::Value(std::string_view v) {
+    assign_text(v);
+    type_ = ValueType::TYPE_TEXT;
+}
 
-inline Value::Value(const char* v) : type_(ValueType::TYPE_TEXT), data_(std::string(v)) {}
+inline Value::Value(const char* v) : Value(std::string_view(v)) {}
 
 // Factory methods
 inline Value Value::make_null() {
@@ -172,7 +289,7 @@ inline Value Value::make_int64(int64_t v) {
 inline Value Value::make_float64(double v) {
     return Value(v);
 }
-inline Value Value::make_text(const std::string& v) {
+inline Value Value::make_text(std::string_view v) {
     return Value(v);
 }
 
@@ -189,104 +306,99 @@ inline bool Value::as_bool() const {
     if (type_ != ValueType::TYPE_BOOL) {
         throw std::runtime_error("Value is not bool");
     }
-    return std::get<bool>(data_);
+    return load<int64_t>() != 0;
 }
 
 inline int8_t Value::as_int8() const {
     if (type_ != ValueType::TYPE_INT8) {
         throw std::runtime_error("Value is not int8");
     }
-    return static_cast<int8_t>(std::get<int64_t>(data_));
+    return static_cast<int8_t>(load<int64_t>());
 }
 
 inline int16_t Value::as_int16() const {
     if (type_ != ValueType::TYPE_INT16) {
         throw std::runtime_error("Value is not int16");
     }
-    return static_cast<int16_t>(std::get<int64_t>(data_));
+    return static_cast<int16_t>(load<int64_t>());
 }
 
 inline int32_t Value::as_int32() const {
     if (type_ != ValueType::TYPE_INT32) {
         throw std::runtime_error("Value is not int32");
     }
-    return static_cast<int32_t>(std::get<int64_t>(data_));
+    return static_cast<int32_t>(load<int64_t>());
 }
 
 inline int64_t Value::as_int64() const {
     if (type_ != ValueType::TYPE_INT64) {
         throw std::runtime_error("Value is not int64");
     }
-    return std::get<int64_t>(data_);
+    return load<int64_t>();
 }
 
 inline float Value::as_float32() const {
     if (type_ != ValueType::TYPE_FLOAT32) {
         throw std::runtime_error("Value is not float32");
     }
-    return static_cast<float>(std::get<double>(data_));
+    return static_cast<float>(load<double>());
 }
 
 inline double Value::as_float64() const {
     if (type_ != ValueType::TYPE_FLOAT64) {
         throw std::runtime_error("Value is not float64");
     }
-    return std::get<double>(data_);
+    return load<double>();
 }
 
-inline const std::string& Value::as_text() const {
-    if (type_ != ValueType::TYPE_TEXT && type_ != ValueType::TYPE_VARCHAR &&
-        type_ != ValueType::TYPE_CHAR) {
+inline std::string_view Value::text_view() const {
+    if (payload() != Payload::Text) {
         throw std::runtime_error("Value is not text-based");
     }
-    return std::get<std::string>(data_);
+    return text();
 }
 
 // Conversions
 inline int64_t Value::to_int64() const {
-    if (std::holds_alternative<int64_t>(data_)) {
-        return std::get<int64_t>(data_);
-    }
-    if (std::holds_alternative<double>(data_)) {
-        return static_cast<int64_t>(std::get<double>(data_));
-    }
-    if (std::holds_alternative<bool>(data_)) {
-        return std::get<bool>(data_) ? 1 : 0;
+    switch (payload()) {
+        case Payload::Bool:
+        case Payload::Int:
+            return load<int64_t>();
+        case Payload::Float:
+            return static_cast<int64_t>(load<double>());
+        default:
+            return 0;
     }
-    return 0;
 }
 
 inline double Value::to_float64() const {
-    if (std::holds_alternative<double>(data_)) {
-        return std::get<double>(data_);
+    switch (payload()) {
+        case Payload::Bool:
+        case Payload::Int:
+            return static_cast<double>(load<int64_t>());
+        case Payload::Float:
+            return load<double>();
+        default:
+            return 0.0;
     }
-    if (std::holds_alternative<int64_t>(data_)) {
-        return static_cast<double>(std::get<int64_t>(data_));
-    }
-    if (std::holds_alternative<bool>(data_)) {
-        return std::get<bool>(data_) ? 1.0 : 0.0;
-    }
-    return 0.0;
 }
 
 inline std::string Value::to_string() const {
-    if (std::holds_alternative<std::monostate>(data_)) {
-        return "NULL";
-    }
-    if (std::holds_alternative<bool>(data_)) {
-        return std::get<bool>(data_) ? "TRUE" : "FALSE";
-    }
-    if (std::holds_alternative<int64_t>(data_)) {
-        return std::to_string(std::get<int64_t>(data_));
-    }
-    if (std::holds_alternative<double>(data_)) {
-        static constexpr int STRING_BUF_SIZE = 64;
-        std::array<char, STRING_BUF_SIZE> buf{};
-        std::snprintf(buf.data(), buf.size(), "%.10g", std::get<double>(data_));
-        return buf.data();
-    }
-    if (std::holds_alternative<std::string>(data_)) {
-        return std::get<std::string>(data_);
+    switch (payload()) {
+        case Payload::None:
+            return "NULL";
+        case Payload::Bool:
+            return load<int64_t>() != 0 ? "TRUE" : "FALSE";
+        case Payload::Int:
+            return std::to_string(load<int64_t>());
+        case Payload::Float: {
+            static constexpr int STRING_BUF_SIZE = 64;
+            std::array<char, STRING_BUF_SIZE> buf{};
+            std::snprintf(buf.data(), buf.size(), "%.10g", load<double>());
+            return buf.data();
+        }
+        case Payload::Text:
+            return std::string(text());
     }
     return "<unknown>";
 }
@@ -298,22 +410,32 @@ inline bool Value::operator==(const Value& other) const {
         }
         return false;
     }
-    return data_ == other.data_;
+    switch (payload()) {
+        case Payload::None:
+            return true;
+        case Payload::Bool:
+        case Payload::Int:
+            return load<int64_t>() == other.load<int64_t>();
+        case Payload::Float:
+            return load<double>() == other.load<double>();
+        case Payload::Text:
+            return text() == other.text();
+    }
+    return false;
 }
 
 inline bool Value::operator<(const Value& other) const {
-    if (std::holds_alternative<std::monostate>(data_)) {
+    if (payload() == Payload::None) {
         return false; /* NULL is not less than anything */
     }
-    if (std::holds_alternative<std::monostate>(other.data_)) {
+    if (other.payload() == Payload::None) {
         return true; /* non-NULL is less than NULL */
     }
     if (is_numeric() && other.is_numeric()) {
         return to_float64() < other.to_float64();
     }
-    if (std::holds_alternative<std::string>(data_) &&
-        std::holds_alternative<std::string>(other.data_)) {
-        return std::get<std::string>(data_) < std::get<std::string>(other.data_);
+    if (payload() == Payload::Text && other.payload() == Payload::Text) {
+        return text() < other.text();
     }
     return false;
 }
@@ -323,25 +445,30 @@ inline std::string Value::to_debug_string() const {
 }
 
 inline std::size_t Value::Hash::operator()(const Value& v) const noexcept {
-    try {
-        std::size_t h = std::hash<int>{}(static_cast<int>(v.type_));
-        static constexpr std::size_t GOLDEN_RATIO = 0x9e3779b9U;
-        static constexpr unsigned int SHIFT_L = 6;
-        static constexpr unsigned int SHIFT_R = 2;
-
-        std::visit(
-            [&h](auto&& arg) {
-                using T = std::decay_t<decltype(arg)>;
-                if constexpr (!std::is_same_v<T, std::monostate>) {
-                    h ^= std::hash<T>{}(arg) + GOLDEN_RATIO + (h << SHIFT_L) + (h >> SHIFT_R);
-                }
-            },
-            v.data_);
-        return h;
-    } catch (...) {
-        /* This should not happen as we maintain type invariants and use standard hashes. */
-        return 0;
+    std::size_t h = std::hash<int>{}(static_cast<int>(v.type_));
+    static constexpr std::size_t GOLDEN_RATIO = 0x9e3779b9U;
+    static constexpr unsigned int SHIFT_L = 6;
+    static constexpr unsigned int SHIFT_R = 2;
+
+    std::size_t data = 0;
+    switch (v.payload()) {
+        case Payload::None:
+            return h;
+        case Payload::Bool:
+            data = std::hash<bool>{}(v.load<int64_t>() != 0);
+            break;
+        case Payload::Int:
+            data = std::hash<int64_t>{}(v.load<int64_t>());
+            break;
+        case Payload::Float:
+            data = std::hash<double>{}(v.load<double>());
+            break;
+        case Payload::Text:
+            data = std::hash<std::string_view>{}(v.text());
+            break;
     }
+    h ^= data + GOLDEN_RATIO + (h << SHIFT_L) + (h >> SHIFT_R);
+    return h;
 }
 
 }  // namespace cloudsql::common
@@ -5,12 +5,16 @@
 #ifndef SQL_ENGINE_DISTRIBUTED_EXECUTOR_HPP
 #define SQL_ENGINE_DISTRIBUTED_EXECUTOR_HPP
 
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "catalog/catalog.hpp"
 #include "common/cluster_manager.hpp"
 #include "executor/query_executor.hpp"
+#include "executor/result_cache.hpp"
+#include "network/rpc_message.hpp"
 #include "parser/statement.hpp"
 
 namespace cloudsql::executor {
@@ -20,6 +24,9 @@ namespace cloudsql::executor {
  */
 class DistributedExecutor {
    public:
+    /** @brief Receives the result of execute_async() */
+    using Completion = std::function<void(QueryResult)>;
+
     DistributedExecutor(Catalog& catalog, cluster::ClusterManager& cm);
 
     /**
@@ -27,14 +34,103 @@ class DistributedExecutor {
      */
     QueryResult execute(const parser::Statement& stmt, const std::string& raw_sql);
 
+    /**
+     * @brief Start a statement across the cluster; `done` gets its result
+     *
+     * A SELECT is planned and its fragments are sent on the calling thread,
+     * which then returns without waiting: the replies are collected by the RPC
+     * callbacks, and the thread that delivers the last one merges them and
+     * runs `done`. A session thread is so only busy while there is local work,
+     * and one thread can have many distributed queries in flight. Other
+     * statements, and SELECTs answered from the result cache or failing while
+     * planned, run `done` before returning.
+     *
+     * `stmt` must stay alive, and no other statement be run on this executor,
+     * until `done` has run. `done` runs exactly once and should not block.
+     */
+    void execute_async(const parser::Statement& stmt, const std::string& raw_sql,
+                       Completion done);
+
     /**
      * @brief Fetch data for a table from all nodes and broadcast it to all nodes
+     *
+     * Tables created WITH (DISTRIBUTION = REPLICATED) are already whole on
+     * every node, and joins with them move no rows.
      */
     bool broadcast_table(const std::string& table_name);
 
+    /**
+     * @brief Place shard keys on the current data nodes, moving rows online
+     *
+     * Builds a ring over the data nodes and stores it in the catalog, marked
+     * migrating: new rows go to their new owners while key lookups still go
+     * to every node. Each node's rows that now belong elsewhere are copied to
+     * their owner in batches and then deleted. Once every table has moved the
+     * ring is marked settled and lookups prune again. Replicated tables are not
+     * split; nodes missing rows of one, such as new nodes, get a whole copy.
+     *
+     * @return rows_affected is the number of rows moved or copied; on error the ring
+     * stays migrating, so no row is missed, and rebalance() may be rerun
+     */
+    QueryResult rebalance();
+
+    /** @brief Read settings of the session; SET changes them and SELECT fragments carry them */
+    [[nodiscard]] const ReadSettings& read_settings() const { return read_settings_; }
+
+    /**
+     * @brief Cache merged SELECT results may be kept in, for sessions with
+     * result_cache on; nullptr for none
+     *
+     * Writes routed through this executor move the data versions of their
+     * tables in the coordinator's catalog, which is what invalidates entries:
+     * rows changed on a data node some other way are not noticed.
+     */
+    void set_result_cache(ResultCache* cache) { result_cache_ = cache; }
+
    private:
+    /**
+     * @brief execute() for everything but EXPLAIN
+     * @param explain Set when `stmt` is the SELECT of an EXPLAIN: the fragments
+     * are explained instead of run, and their plans are returned per node
+     * @param detach If set, a statement that ends in a fan-out of fragments
+     * returns once they are sent, moving *detach to run with the merged result;
+     * *detach is left empty then and the result returned means nothing
+     */
+    QueryResult execute_statement(const parser::Statement& stmt, const std::string& raw_sql,
+                                  const parser::ExplainStatement* explain,
+                                  Completion* detach = nullptr);
+
+    /** @brief Where the result of `stmt` is cached; an empty key if it is not */
+    [[nodiscard]] ResultCache::Probe probe_cache(const parser::Statement& stmt) const;
+
+    /** @brief Have the data nodes read as the session's settings ask */
+    void set_read_options(network::ExecuteFragmentArgs& args) const;
+
+    /** @brief A node the open transaction ran statements on */
+    struct Participant {
+        cluster::NodeInfo node;
+        bool wrote = false; /**< Read-only participants need no prepare */
+    };
+
+    /** @brief Records that the open transaction ran a statement on `node` */
+    void add_participant(const cluster::NodeInfo& node, bool writes);
+
+    /**
+     * @brief The nodes to commit or roll back on, forgetting them for the next transaction
+     * @return All of `data_nodes`, as writers, if neither BEGIN nor any statement
+     * went through this executor; none if BEGIN did and nothing ran since
+     */
+    std::vector<Participant> take_participants(const std::vector<cluster::NodeInfo>& data_nodes);
+
     Catalog& catalog_;
     cluster::ClusterManager& cluster_manager_;
+    /** Nodes the statements since the last BEGIN, COMMIT or ROLLBACK ran on */
+    std::vector<Participant> participants_;
+    bool begun_ = false; /**< BEGIN went through this executor */
+    /** Tables written since BEGIN, whose data versions move again as it ends */
+    std::vector<std::string> written_tables_;
+    ReadSettings read_settings_;
+    ResultCache* result_cache_ = nullptr;
 };
 
 }  // namespace cloudsql::executor
@@ -0,0 +1,59 @@
+/**
+ * @file ordered_merge.hpp
+ * @brief Pushes ORDER BY and LIMIT into fragments and merges the sorted node results
+ */
+
+#ifndef SQL_ENGINE_DISTRIBUTED_ORDERED_MERGE_HPP
+#define SQL_ENGINE_DISTRIBUTED_ORDERED_MERGE_HPP
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "executor/types.hpp"
+#include "parser/statement.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief Distributed plan of a plain SELECT with ORDER BY or LIMIT
+ *
+ * Each data node runs fragment_sql(): the statement with its ORDER BY, and
+ * with LIMIT offset + limit in place of LIMIT/OFFSET, so no node ships more
+ * rows than the result can use. Sort keys that are not in the SELECT list
+ * travel as extra trailing columns. finish() merges the node results, each
+ * already sorted, in one k-way pass that stops once LIMIT rows are out.
+ */
+class OrderedMerge {
+   public:
+    /**
+     * @return The plan, or nullopt without ORDER BY and LIMIT, or when the
+     * statement groups or aggregates: partial groups do not sort or limit
+     * on their own
+     */
+    static std::optional<OrderedMerge> plan(const parser::SelectStatement& stmt);
+
+    [[nodiscard]] const std::string& fragment_sql() const { return fragment_sql_; }
+
+    /**
+     * @brief Merge the sorted results of every node and apply OFFSET/LIMIT
+     * @param fragment_schema Schema of the fragment_sql() results
+     * @param node_rows Rows of each node, in the order fragment_sql() returned them
+     */
+    [[nodiscard]] QueryResult finish(const Schema& fragment_schema,
+                                     std::vector<std::vector<Tuple>> node_rows) const;
+
+   private:
+    explicit OrderedMerge(const parser::SelectStatement& stmt) : stmt_(&stmt) {}
+
+    const parser::SelectStatement* stmt_;
+    std::string fragment_sql_;
+    size_t width_ = 0; /**< Columns of the result; extra sort key columns follow */
+    /** Fragment column of each sort key, or npos to evaluate it on the result row */
+    std::vector<size_t> key_columns_;
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // SQL_ENGINE_DISTRIBUTED_ORDERED_MERGE_HPP
@@ -0,0 +1,65 @@
+/**
+ * @file partial_aggregation.hpp
+ * @brief Splits an aggregate SELECT into per-node partial aggregation and a final merge
+ */
+
+#ifndef SQL_ENGINE_DISTRIBUTED_PARTIAL_AGGREGATION_HPP
+#define SQL_ENGINE_DISTRIBUTED_PARTIAL_AGGREGATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "executor/types.hpp"
+#include "parser/statement.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief Two-phase plan of a SELECT with GROUP BY or aggregates
+ *
+ * Each data node runs partial_sql(): the group keys, then one partial column
+ * per aggregate (two for AVG, which travels as SUM and COUNT), grouped but
+ * without HAVING, ORDER BY or LIMIT. The coordinator merges the partial
+ * groups of all nodes in finish() and applies the rest of the statement.
+ */
+class PartialAggregation {
+   public:
+    /**
+     * @return The plan, or nullopt if the statement does not split: SELECT
+     * DISTINCT, DISTINCT aggregates, GROUP BY on an expression, or a
+     * reference to a column that is not a group key
+     */
+    static std::optional<PartialAggregation> plan(const parser::SelectStatement& stmt);
+
+    [[nodiscard]] const std::string& partial_sql() const { return partial_sql_; }
+
+    /**
+     * @brief Merge partial groups and finish the statement
+     * @param partial_schema Schema of the partial_sql() results, for the key types
+     */
+    [[nodiscard]] QueryResult finish(const Schema& partial_schema,
+                                     const std::vector<Tuple>& partial_rows) const;
+
+   private:
+    enum class Merge : uint8_t { Count, Sum, Min, Max, Avg };
+
+    struct Aggregate {
+        std::string name; /**< Text of the call, which names its column for evaluation */
+        Merge merge = Merge::Count;
+        size_t partial = 0; /**< First partial column; AVG's COUNT follows its SUM */
+    };
+
+    explicit PartialAggregation(const parser::SelectStatement& stmt) : stmt_(&stmt) {}
+
+    const parser::SelectStatement* stmt_;
+    std::string partial_sql_;
+    size_t key_count_ = 0;
+    std::vector<Aggregate> aggregates_;
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // SQL_ENGINE_DISTRIBUTED_PARTIAL_AGGREGATION_HPP
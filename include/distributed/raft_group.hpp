@@ -12,9 +12,15 @@
 #include <memory>
 #include <mutex>
 #include <random>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "common/cluster_manager.hpp"
+#include "common/metrics.hpp"
+#include "distributed/raft_log.hpp"
 #include "distributed/raft_types.hpp"
 #include "network/rpc_client.hpp"
 #include "network/rpc_server.hpp"
@@ -23,11 +29,45 @@ namespace cloudsql::raft {
 
 /**
  * @brief Implementation of a Raft consensus group
+ *
+ * Term and vote, log segments and snapshot live under storage_dir as
+ * raft_group_<id>.state, raft_group_<id>.log/ and raft_group_<id>.snap.
+ * Once snapshot_threshold entries have been applied since the last
+ * snapshot, a follower asks its state machine for an image and drops the
+ * log it covers. Only followers cut snapshots: the leader's proposers apply
+ * their own commands outside the log, so its image could run ahead of any
+ * index. A leader streams the last snapshot it has, in chunks, to followers
+ * that need entries it no longer holds.
+ *
+ * The group is a state machine advanced by tick(). start() gives it a thread
+ * of its own; a RaftManager instead drives many groups from a shared pool
+ * through attach(), and sends their heartbeats to caught-up followers
+ * coalesced per node. A leader with nothing left to replicate then tells its
+ * followers to go dormant: neither side ticks until a write, a read, or the
+ * leader's node falling silent wakes the group.
  */
 class RaftGroup {
    public:
+    static constexpr uint64_t DEFAULT_SNAPSHOT_THRESHOLD = 10000;
+    static constexpr int HEARTBEAT_INTERVAL_MS = 50;
+    static constexpr int ELECTION_TIMEOUT_MIN_MS = 150;
+
+    /** @brief Drives attached groups in place of a thread of their own */
+    class Driver {
+       public:
+        virtual ~Driver() = default;
+        /** @brief Tick the group soon; called with the group's lock held, so must not block */
+        virtual void wake(uint16_t group_id) = 0;
+        /** @brief When this node last heard a coalesced heartbeat from `node_id` */
+        [[nodiscard]] virtual std::chrono::steady_clock::time_point last_heard(
+            const std::string& node_id) const = 0;
+    };
+
+    /**
+     * @param storage_dir Where the group keeps its files; empty for the working directory
+     */
     RaftGroup(uint16_t group_id, std::string node_id, cluster::ClusterManager& cluster_manager,
-              network::RpcServer& rpc_server);
+              network::RpcServer& rpc_server, const std::string& storage_dir = "");
     ~RaftGroup();
 
     // Prevent copying and moving
@@ -36,57 +76,217 @@ class RaftGroup {
     RaftGroup(RaftGroup&&) = delete;
     RaftGroup& operator=(RaftGroup&&) = delete;
 
+    /** @brief Run the group on a thread of its own */
     void start();
+    /** @brief Run the group from `driver`, which calls tick() when it is due */
+    void attach(Driver* driver);
+    /** @brief Stop ticking; an attached group forgets its driver */
     void stop();
 
+    /**
+     * @brief Advance timers, elections and replication
+     * @return When to tick next, or time_point::max() while dormant
+     */
+    std::chrono::steady_clock::time_point tick();
+
+    // Coalesced heartbeats (called by RaftManager)
+
+    /**
+     * @brief Add a heartbeat for each caught-up follower of this leader,
+     * keyed by the follower's node; the others get AppendEntries instead
+     */
+    void collect_heartbeats(std::unordered_map<std::string, std::vector<GroupHeartbeat>>& out);
+    GroupHeartbeatAck handle_heartbeat(const std::string& leader_id, const GroupHeartbeat& beat);
+    void handle_heartbeat_ack(const std::string& peer_id, const GroupHeartbeat& beat,
+                              const GroupHeartbeatAck& ack,
+                              std::chrono::steady_clock::time_point sent_at);
+    /** @brief The leader's node stopped sending heartbeats: a dormant follower wakes */
+    void leader_silent(const std::string& node_id);
+    [[nodiscard]] bool dormant() const;
+
     /**
      * @brief Set the state machine to apply committed entries to
+     *
+     * If the group restarted from a snapshot, the state machine is first
+     * loaded from it; the entries after it are then applied as they commit.
      */
-    void set_state_machine(RaftStateMachine* state_machine) { state_machine_ = state_machine; }
+    void set_state_machine(RaftStateMachine* state_machine);
+
+    /** @brief Entries applied between snapshots; 0 turns snapshots off */
+    void set_snapshot_threshold(uint64_t entries);
 
     // Raft RPC Handlers (called by RaftManager)
     void handle_request_vote(const network::RpcHeader& header, const std::vector<uint8_t>& payload,
                              int client_fd);
     void handle_append_entries(const network::RpcHeader& header,
                                const std::vector<uint8_t>& payload, int client_fd);
+    void handle_install_snapshot(const network::RpcHeader& header,
+                                 const std::vector<uint8_t>& payload, int client_fd);
+    /** @brief A follower asks for the commit index it must apply before serving a read */
+    void handle_read_index(const network::RpcHeader& header, const std::vector<uint8_t>& payload,
+                           int client_fd);
 
     // Client interface
+
+    /**
+     * @brief Append a command to the leader's log and start replicating it now
+     *
+     * Returns once the entry is in the local log; followers receive it in
+     * the next AppendEntries batch, without waiting for a heartbeat. The
+     * caller applies its own command; entries are applied, on the leader,
+     * only if an earlier leader proposed them.
+     */
     bool replicate(const std::vector<uint8_t>& data);
     [[nodiscard]] bool is_leader() const { return state_.load() == NodeState::Leader; }
+
+    /**
+     * @brief Wait until this replica's state machine may serve a read at `level`
+     *
+     * Leader and lease reads need this node to lead; follower reads make the
+     * leader confirm its commit index and wait until it is applied here. A
+     * stale read only needs a leader to have been heard from within
+     * max_staleness; zero leaves it unbounded.
+     *
+     * @return false if this node cannot serve the read, or not in time
+     */
+    bool prepare_read(ReadConsistency level,
+                      std::chrono::milliseconds max_staleness = std::chrono::milliseconds(0));
     [[nodiscard]] uint16_t group_id() const { return group_id_; }
+    [[nodiscard]] index_t commit_index() const;
+    /** @brief Last entry covered by the snapshot on disk, 0 without one */
+    [[nodiscard]] index_t snapshot_index() const;
+    [[nodiscard]] index_t first_log_index() const;
+    [[nodiscard]] ReplicationStats replication_stats() const;
 
    private:
     void run_loop();
-    void do_follower();
-    void do_candidate();
-    void do_leader();
+    std::chrono::steady_clock::time_point tick_follower();
+    std::chrono::steady_clock::time_point tick_candidate();
+    std::chrono::steady_clock::time_point tick_leader();
+    /** @brief Start a new term and ask every peer for its vote, without waiting */
+    void start_election();
+    void handle_vote_reply(const std::string& peer_id, term_t term,
+                           const network::RpcResult& result);
+
+    /** @brief One AppendEntries, or InstallSnapshot chunk, in flight to a follower */
+    struct SentBatch {
+        term_t term = 0;
+        uint64_t epoch = 0;
+        index_t prev_log_index = 0;  // For a snapshot chunk, the last entry it covers
+        size_t count = 0;
+        bool snapshot = false;
+        uint64_t offset = 0;  // Where the chunk starts in the snapshot file
+        std::chrono::steady_clock::time_point sent_at;
+    };
+
+    /** @brief Lets replies that outlive the group find out it is gone */
+    struct ReplyLink {
+        std::mutex mutex;
+        RaftGroup* group = nullptr;
+    };
+
+    /**
+     * @brief Fill every follower's window with batches of new entries, and
+     * send a heartbeat to followers that are caught up once one is due
+     */
+    void send_append_entries();
+    void handle_append_reply(const std::string& peer_id, const SentBatch& sent,
+                             const network::RpcResult& result);
+    /** @brief Cut a snapshot if enough has been applied since the last; runs on the raft thread */
+    void maybe_snapshot();
+
+    // The helpers below run with mutex_ held
+    /**
+     * @brief The commit index reads may be served at, once leadership is confirmed,
+     * by the lease if allowed and valid or else by a heartbeat round
+     */
+    bool read_index(std::unique_lock<std::mutex>& lock, bool allow_lease, index_t& index);
+    bool wait_applied(std::unique_lock<std::mutex>& lock, index_t index);
+    void record_ack(const std::string& peer_id, std::chrono::steady_clock::time_point sent_at);
+    /** @brief Oldest send time that a majority, this node included, has answered */
+    [[nodiscard]] std::chrono::steady_clock::time_point quorum_ack_time() const;
+    /** @brief Last sign of life from the leader, which a dormant follower gets per node */
+    [[nodiscard]] std::chrono::steady_clock::time_point leader_heard_at() const;
+    void restart_pipeline(const std::string& peer_id, std::chrono::steady_clock::time_point now);
+    void handle_snapshot_reply(const std::string& peer_id, const SentBatch& sent,
+                               const network::RpcResult& result);
+    /** @brief Read the chunk of the snapshot file a follower needs next */
+    bool read_snapshot_chunk(uint64_t offset, InstallSnapshotArgs& args) const;
+    /** @brief Load the received snapshot file and drop the log it covers */
+    bool install_received_snapshot(const InstallSnapshotArgs& args);
+    /** @brief Load the state machine from the snapshot file */
+    bool restore_snapshot();
+    void advance_commit_index();
+    void apply_committed();
+    [[nodiscard]] index_t last_log_index() const;
+    [[nodiscard]] term_t term_at(index_t index) const;
 
+    void become_leader();
     void step_down(term_t new_term);
+    /** @brief Have the group ticked now, by its driver or its own thread */
+    void wake();
+    /** @brief Write the term and vote; the log persists on its own through log_ */
     void persist_state();
     void load_state();
+    [[nodiscard]] std::string storage_path(const char* suffix) const;
 
     // Helpers
     [[nodiscard]] std::chrono::milliseconds get_random_timeout() const;
 
+    /** @brief Report term, indexes and follower lag to the metrics registry */
+    void collect_metrics(common::MetricsSnapshot& out) const;
+
     uint16_t group_id_;
     std::string node_id_;
+    std::string storage_prefix_;  // storage_dir/raft_group_<id>
     cluster::ClusterManager& cluster_manager_;
     network::RpcServer& rpc_server_;
     RaftStateMachine* state_machine_ = nullptr;
 
     // State
     std::atomic<NodeState> state_{NodeState::Follower};
-    RaftPersistentState persistent_state_;
+    RaftPersistentState persistent_state_;  // Term and vote, in raft_group_<id>.state
+    RaftLog log_;                           // Segments in raft_group_<id>.log/
+    index_t snapshot_index_ = 0;            // Covered by raft_group_<id>.snap
+    term_t snapshot_term_ = 0;
+    uint64_t snapshot_threshold_ = DEFAULT_SNAPSHOT_THRESHOLD;
+    bool snapshots_supported_ = true;  // Until the state machine declines to save one
+    bool snapshotting_ = false;        // An image is being written; applies wait for it
+    bool restore_pending_ = false;     // The snapshot is not yet loaded into a state machine
+    index_t receiving_index_ = 0;      // Snapshot being received from the leader
+    uint64_t receiving_bytes_ = 0;
     RaftVolatileState volatile_state_;
     LeaderState leader_state_;
+    index_t term_start_index_ = 0;      // First entry proposed by this node as leader
+    bool replication_pending_ = false;  // New entries or free window slots to send into
+    std::chrono::steady_clock::time_point last_broadcast_;
+    std::unordered_set<std::string> unreachable_;  // Failed sends; retried at the next heartbeat
+    std::unordered_set<std::string> heartbeat_owed_;  // Followers a read waits to hear from
+    std::chrono::steady_clock::time_point last_leader_contact_;  // Last RPC from a current leader
+    std::string leader_id_;                                      // Who sent it
+    ReplicationStats stats_;
+    std::shared_ptr<ReplyLink> reply_link_;
+
+    // Election
+    std::unordered_set<std::string> votes_;  // Granted in the current term, this node's first
+    size_t votes_needed_ = 0;
+    std::vector<std::string> election_peers_;  // Members when the election started
+    std::chrono::steady_clock::time_point election_deadline_;  // Retry in a new term after
 
     mutable std::mutex mutex_;
     std::condition_variable cv_;
     std::atomic<bool> running_{false};
     std::thread raft_thread_;
+    Driver* driver_ = nullptr;
+    bool wake_pending_ = false;  // Ticks are owed before the next timer
+    bool dormant_ = false;
 
-    std::chrono::system_clock::time_point last_heartbeat_;
+    std::chrono::steady_clock::time_point last_heartbeat_;
+    std::chrono::milliseconds election_timeout_;  // Of the current follower wait
     std::mt19937 rng_;
+
+    // Last, so the collector is unregistered before the state it reads
+    common::MetricsRegistry::Registration metrics_;
 };
 
 }  // namespace cloudsql::raft
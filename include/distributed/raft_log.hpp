@@ -0,0 +1,133 @@
+/**
+ * @file raft_log.hpp
+ * @brief Segmented, append-only on-disk Raft log
+ */
+
+#ifndef SQL_ENGINE_DISTRIBUTED_RAFT_LOG_HPP
+#define SQL_ENGINE_DISTRIBUTED_RAFT_LOG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "distributed/raft_types.hpp"
+
+namespace cloudsql::raft {
+
+/**
+ * @brief Raft log kept in append-only segment files
+ *
+ * Entries are appended to the newest segment of `directory`, named after its
+ * first index; a segment is sealed once it passes segment_bytes. Appends only
+ * write: sync() makes every entry appended since the last sync durable with
+ * one fdatasync, so a tick's worth of entries shares a single flush. Memory
+ * holds an index of (segment, offset, term) per entry and the newest
+ * cache_entries entries; older ones are read back from their segment.
+ *
+ * Not thread-safe; RaftGroup calls it with its mutex held.
+ */
+class RaftLog {
+   public:
+    static constexpr size_t DEFAULT_SEGMENT_BYTES = 4 * 1024 * 1024;
+    static constexpr size_t DEFAULT_CACHE_ENTRIES = 1024;
+
+    explicit RaftLog(std::string directory, size_t segment_bytes = DEFAULT_SEGMENT_BYTES,
+                     size_t cache_entries = DEFAULT_CACHE_ENTRIES);
+    ~RaftLog();
+
+    RaftLog(const RaftLog&) = delete;
+    RaftLog& operator=(const RaftLog&) = delete;
+    RaftLog(RaftLog&&) = delete;
+    RaftLog& operator=(RaftLog&&) = delete;
+
+    /**
+     * @brief Create the directory or load the segments already in it
+     *
+     * A torn record at the end of the log, from a crash mid-append, is cut off.
+     */
+    bool open();
+
+    /** @brief Index of the first entry held, or last_index() + 1 when empty */
+    [[nodiscard]] index_t first_index() const { return first_index_; }
+    [[nodiscard]] index_t last_index() const { return first_index_ + index_.size() - 1; }
+    /** @brief Last entry known to be on stable storage */
+    [[nodiscard]] index_t durable_index() const { return durable_index_; }
+    [[nodiscard]] bool empty() const { return index_.empty(); }
+
+    /** @return The entry's term, or 0 for an index outside the log */
+    [[nodiscard]] term_t term_at(index_t index) const;
+
+    /**
+     * @brief Append an entry; its index must be last_index() + 1
+     * @return false on an I/O error or an out-of-order index
+     */
+    bool append(const LogEntry& entry);
+
+    /**
+     * @brief Read up to max_entries entries starting at `from`
+     * @return false if an entry could not be read back
+     */
+    bool read(index_t from, size_t max_entries, std::vector<LogEntry>& out) const;
+
+    /** @brief Drop every entry from index `from` on */
+    bool truncate_suffix(index_t from);
+
+    /**
+     * @brief Drop every entry up to and including `upto`, which a snapshot covers
+     *
+     * Whole segments are deleted; the segment holding upto + 1 is rewritten
+     * from that entry on, so the log starts exactly after the snapshot.
+     */
+    bool compact(index_t upto);
+
+    /** @brief Drop every entry; the next one appended is `next` */
+    bool reset(index_t next);
+
+    /** @brief Flush the entries appended since the last sync */
+    bool sync();
+
+    [[nodiscard]] uint64_t syncs() const { return syncs_; }
+    [[nodiscard]] uint64_t synced_entries() const { return synced_entries_; }
+    [[nodiscard]] size_t segment_count() const { return segments_.size(); }
+
+   private:
+    struct Segment {
+        index_t first = 0;
+        std::string path;
+        uint64_t size = 0;
+    };
+
+    /** @brief Where an entry is on disk */
+    struct Slot {
+        uint32_t segment = 0; /**< Position in segments_ */
+        uint64_t offset = 0;
+        term_t term = 0;
+    };
+
+    bool load_segment(size_t position);
+    bool open_active();
+    bool start_segment(index_t first);
+    void close_active();
+    bool read_from_disk(index_t index, LogEntry& out) const;
+    void remove_segments(size_t from, size_t to);
+
+    std::string directory_;
+    size_t segment_bytes_;
+    size_t cache_entries_;
+
+    std::vector<Segment> segments_;
+    std::deque<Slot> index_;
+    index_t first_index_ = 1;
+    index_t durable_index_ = 0;
+    std::deque<LogEntry> cache_; /**< The newest entries, through last_index() */
+    int active_fd_ = -1;         /**< The newest segment, open for appends */
+    bool dirty_ = false;
+    uint64_t syncs_ = 0;
+    uint64_t synced_entries_ = 0;
+};
+
+}  // namespace cloudsql::raft
+
+#endif  // SQL_ENGINE_DISTRIBUTED_RAFT_LOG_HPP
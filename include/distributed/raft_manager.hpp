@@ -6,28 +6,52 @@
 #ifndef SQL_ENGINE_DISTRIBUTED_RAFT_MANAGER_HPP
 #define SQL_ENGINE_DISTRIBUTED_RAFT_MANAGER_HPP
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "distributed/raft_group.hpp"
+#include "distributed/tick_scheduler.hpp"
 #include "network/rpc_server.hpp"
 
 namespace cloudsql::raft {
 
 /**
  * @brief Manager for Multi-Raft implementation
+ *
+ * Every group on the node is ticked from one pool of tick_threads threads,
+ * however many groups there are. Each heartbeat interval the manager sends
+ * each peer node a single GroupHeartbeat carrying the term and commit index
+ * of every group led here that has a caught-up replica there. The message
+ * goes out even when it carries no group, so that peers can tell the node is
+ * alive while all its groups are dormant; when a node falls silent for an
+ * election timeout, the dormant groups it led wake up to elect a new leader.
  */
-class RaftManager {
+class RaftManager : private RaftGroup::Driver {
    public:
+    static constexpr size_t DEFAULT_TICK_THREADS = 2;
+
+    /**
+     * @param storage_dir Where the groups keep their logs and snapshots; empty for the
+     * working directory
+     * @param tick_threads Threads that tick the groups
+     */
     RaftManager(std::string node_id, cluster::ClusterManager& cluster_manager,
-                network::RpcServer& rpc_server);
-    ~RaftManager() = default;
+                network::RpcServer& rpc_server, std::string storage_dir = "",
+                size_t tick_threads = DEFAULT_TICK_THREADS);
+    ~RaftManager() override;
 
-    // Prevent copying
+    // Prevent copying and moving
     RaftManager(const RaftManager&) = delete;
     RaftManager& operator=(const RaftManager&) = delete;
+    RaftManager(RaftManager&&) = delete;
+    RaftManager& operator=(RaftManager&&) = delete;
 
     void start();
     void stop();
@@ -42,7 +66,20 @@ class RaftManager {
      */
     std::shared_ptr<RaftGroup> get_group(uint16_t group_id);
 
+    [[nodiscard]] HeartbeatStats heartbeat_stats() const;
+    [[nodiscard]] size_t tick_threads() const { return scheduler_.threads(); }
+
    private:
+    void wake(uint16_t group_id) override;
+    [[nodiscard]] std::chrono::steady_clock::time_point last_heard(
+        const std::string& node_id) const override;
+
+    /** @brief The heartbeat task: one GroupHeartbeat per peer node, then a silence check */
+    std::chrono::steady_clock::time_point send_heartbeats();
+    void handle_group_heartbeat(const network::RpcHeader& header,
+                                const std::vector<uint8_t>& payload, int client_fd);
+    [[nodiscard]] std::vector<std::shared_ptr<RaftGroup>> groups() const;
+
     /**
      * @brief Route incoming Raft RPCs to the correct group
      */
@@ -52,9 +89,18 @@ class RaftManager {
     std::string node_id_;
     cluster::ClusterManager& cluster_manager_;
     network::RpcServer& rpc_server_;
+    std::string storage_dir_;
 
-    std::mutex mutex_;
+    mutable std::mutex mutex_;
     std::unordered_map<uint16_t, std::shared_ptr<RaftGroup>> groups_;
+    bool started_ = false;
+
+    mutable std::mutex heartbeat_mutex_;
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> last_heard_;
+    std::unordered_set<std::string> silent_;  // Heard from once, not within a timeout since
+    HeartbeatStats heartbeat_stats_;
+
+    TickScheduler scheduler_;  // Last: stopped before the groups it ticks go away
 };
 
 }  // namespace cloudsql::raft
@@ -6,8 +6,11 @@
 #ifndef SQL_ENGINE_DISTRIBUTED_RAFT_TYPES_HPP
 #define SQL_ENGINE_DISTRIBUTED_RAFT_TYPES_HPP
 
+#include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <istream>
+#include <ostream>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -24,6 +27,16 @@ using index_t = uint64_t;
  */
 enum class NodeState : uint8_t { Follower, Candidate, Leader, Shutdown };
 
+/**
+ * @brief How up to date a read served by a replica must be
+ */
+enum class ReadConsistency : uint8_t {
+    Leader,    // On the leader, after a heartbeat round confirms it still leads
+    Lease,     // On the leader, skipping that round while its lease holds
+    Follower,  // On any replica, once it has applied the leader's commit index
+    Stale      // On any replica that heard from a leader within a bound
+};
+
 /**
  * @brief A single entry in the Raft log
  */
@@ -44,6 +57,23 @@ class RaftStateMachine {
      * @brief Apply a committed log entry to the state machine
      */
     virtual void apply(const LogEntry& entry) = 0;
+
+    /**
+     * @brief Write an image of the state that covers every entry applied so far
+     * @return false if the state machine does not take snapshots; its log is then kept whole
+     */
+    virtual bool save_snapshot(std::ostream& out) {
+        static_cast<void>(out);
+        return false;
+    }
+
+    /**
+     * @brief Replace the state with an image written by save_snapshot()
+     */
+    virtual bool load_snapshot(std::istream& in) {
+        static_cast<void>(in);
+        return false;
+    }
 };
 
 /**
@@ -95,15 +125,69 @@ struct AppendEntriesArgs {
 struct AppendEntriesReply {
     term_t term = 0;
     bool success = false;
+    index_t last_log_index = 0;  // Follower's last entry, where a rejected leader resumes
+};
+
+/**
+ * @brief InstallSnapshot RPC arguments: one chunk of the leader's snapshot file
+ */
+struct InstallSnapshotArgs {
+    term_t term = 0;
+    std::string leader_id;
+    index_t last_included_index = 0;  // Last entry the snapshot covers
+    term_t last_included_term = 0;
+    uint64_t offset = 0;  // Where the chunk goes in the file
+    bool done = false;    // The chunk is the file's last
+    std::vector<uint8_t> data;
+};
+
+/**
+ * @brief InstallSnapshot RPC response
+ */
+struct InstallSnapshotReply {
+    term_t term = 0;
+    bool installed = false;  // The follower's state now covers last_included_index
+    uint64_t stored = 0;     // Bytes of the file the follower holds, where the leader resumes
+};
+
+/**
+ * @brief One group's entry in a GroupHeartbeat, which carries those of every
+ * group the sender leads with a replica on the receiving node
+ */
+struct GroupHeartbeat {
+    uint16_t group_id = 0;
+    term_t term = 0;
+    index_t commit = 0;    // Leader's commit index, capped at what this follower holds
+    bool quiesce = false;  // Nothing left to replicate: the follower may go dormant
+};
+
+/**
+ * @brief A follower's answer to one GroupHeartbeat entry
+ */
+struct GroupHeartbeatAck {
+    uint16_t group_id = 0;
+    term_t term = 0;
+    bool accepted = false;  // The sender leads the group in that term
+};
+
+/**
+ * @brief Heartbeat traffic of one node's RaftManager, since it started
+ */
+struct HeartbeatStats {
+    uint64_t messages_sent = 0;      // GroupHeartbeat messages, at most one per peer per interval
+    uint64_t groups_carried = 0;     // Group entries across those messages
+    uint64_t messages_received = 0;
+    uint64_t dormant_groups = 0;     // Replicas dormant now, leaders and followers
 };
 
 /**
  * @brief Persistent state that must be saved to stable storage before responding to RPCs
+ *
+ * The log itself lives in a RaftLog next to this metadata.
  */
 struct RaftPersistentState {
     term_t current_term = 0;
     std::string voted_for;  // Node ID of the candidate that received vote in current term
-    std::vector<LogEntry> log;
 };
 
 /**
@@ -122,6 +206,52 @@ struct LeaderState {
     std::unordered_map<std::string, index_t> next_index;
     // For each server, index of highest log entry known to be replicated on server
     std::unordered_map<std::string, index_t> match_index;
+    // For each server, AppendEntries requests sent and not yet answered
+    std::unordered_map<std::string, size_t> in_flight;
+    // For each server, bumped when its pipeline restarts so older replies are ignored
+    std::unordered_map<std::string, uint64_t> epoch;
+    // For each server, when it last answered (or its pipeline last restarted)
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> last_reply;
+    // For each server being sent the snapshot, bytes of it the server has stored
+    std::unordered_map<std::string, uint64_t> snapshot_offset;
+    // For each server, send time of the newest request it answered in this term
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> acked_sent_at;
+    // For each server, commit index it acknowledged in a coalesced heartbeat
+    std::unordered_map<std::string, index_t> acked_commit;
+};
+
+/**
+ * @brief Replication counters of one group, since it started
+ */
+struct ReplicationStats {
+    uint64_t batches_sent = 0;     // AppendEntries carrying at least one entry
+    uint64_t entries_sent = 0;     // Entries across those batches
+    uint64_t max_batch = 0;        // Most entries in one AppendEntries
+    uint64_t batches_acked = 0;    // Batches a follower accepted
+    uint64_t total_latency_us = 0; // Send to acceptance, summed over acked batches
+    uint64_t max_latency_us = 0;
+    uint64_t log_syncs = 0;        // fdatasync calls on the log, each covering a tick's appends
+    uint64_t entries_synced = 0;   // Entries made durable by those syncs
+    uint64_t snapshots_taken = 0;      // Snapshots cut here, each compacting the log
+    uint64_t snapshots_sent = 0;       // Snapshots a lagging follower installed from us
+    uint64_t snapshot_bytes_sent = 0;  // InstallSnapshot chunk bytes sent
+    uint64_t snapshots_installed = 0;  // Snapshots installed here from a leader
+    uint64_t lease_reads = 0;          // Reads the leader served on its lease alone
+    uint64_t read_index_rounds = 0;    // Heartbeat rounds a read waited on to confirm leadership
+    uint64_t follower_reads = 0;       // Reads here that asked the leader for its commit index
+    uint64_t heartbeats_coalesced = 0; // Heartbeats sent inside a node's GroupHeartbeat message
+    uint64_t quiesces = 0;             // Times this group went dormant as leader
+
+    [[nodiscard]] double mean_batch() const {
+        return batches_sent == 0 ? 0.0
+                                 : static_cast<double>(entries_sent) /
+                                       static_cast<double>(batches_sent);
+    }
+    [[nodiscard]] double mean_latency_us() const {
+        return batches_acked == 0 ? 0.0
+                                  : static_cast<double>(total_latency_us) /
+                                        static_cast<double>(batches_acked);
+    }
 };
 
 }  // namespace cloudsql::raft
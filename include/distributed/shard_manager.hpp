@@ -6,13 +6,17 @@
 #ifndef SQL_ENGINE_DISTRIBUTED_SHARD_MANAGER_HPP
 #define SQL_ENGINE_DISTRIBUTED_SHARD_MANAGER_HPP
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "catalog/catalog.hpp"
 #include "common/value.hpp"
+#include "executor/vector_hash.hpp"
 
 namespace cloudsql::cluster {
 
@@ -21,6 +25,9 @@ namespace cloudsql::cluster {
  */
 class ShardManager {
    public:
+    /** Tokens each data node owns on the shard ring */
+    static constexpr uint32_t VIRTUAL_NODES = 64;
+
     /**
      * @brief Stable hash function (DJB2) to ensure consistent sharding across processes
      */
@@ -32,6 +39,56 @@ class ShardManager {
         return hash;
     }
 
+    /** @brief FNV-1a over `bytes`: the same in every process and build */
+    static uint64_t stable_hash64(std::string_view bytes) {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (const char c : bytes) {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+        }
+        return executor::hashing::mix(hash);
+    }
+
+    /**
+     * @brief Stable hash of a shard key, computed from the value itself
+     *
+     * Values that compare equal hash equally whatever their width: INT32 5,
+     * INT64 5 and FLOAT64 5.0 land on the same shard. Text hashes its bytes.
+     */
+    static uint64_t hash_value(const common::Value& value) {
+        constexpr uint64_t INTEGER_SEED = 0x9ae16a3b2f90404fULL;
+        constexpr uint64_t FLOAT_SEED = 0xc3a5c85c97cb3127ULL;
+        switch (value.type()) {
+            case common::ValueType::TYPE_NULL:
+                return executor::hashing::NULL_HASH;
+            case common::ValueType::TYPE_BOOL:
+            case common::ValueType::TYPE_INT8:
+            case common::ValueType::TYPE_INT16:
+            case common::ValueType::TYPE_INT32:
+            case common::ValueType::TYPE_INT64:
+                return executor::hashing::combine(INTEGER_SEED,
+                                                  static_cast<uint64_t>(value.to_int64()));
+            case common::ValueType::TYPE_FLOAT32:
+            case common::ValueType::TYPE_FLOAT64:
+            case common::ValueType::TYPE_DECIMAL: {
+                const double d = value.to_float64();
+                /* Whole numbers hash as the integer they equal */
+                if (std::isfinite(d) && std::trunc(d) == d && std::fabs(d) < 9.2e18) {
+                    return executor::hashing::combine(
+                        INTEGER_SEED, static_cast<uint64_t>(static_cast<int64_t>(d)));
+                }
+                return executor::hashing::combine(FLOAT_SEED, executor::hashing::double_bits(d));
+            }
+            case common::ValueType::TYPE_CHAR:
+            case common::ValueType::TYPE_VARCHAR:
+            case common::ValueType::TYPE_TEXT:
+            case common::ValueType::TYPE_JSON:
+            case common::ValueType::TYPE_BLOB:
+                return stable_hash64(value.text_view());
+            default:
+                return stable_hash64(value.to_string());
+        }
+    }
+
     /**
      * @brief Compute destination shard index for a given key
      */
@@ -39,11 +96,37 @@ class ShardManager {
         if (num_shards == 0) {
             return 0;
         }
+        return static_cast<uint32_t>(hash_value(pk_value) % num_shards);
+    }
+
+    /**
+     * @brief Ring of `vnodes` tokens per node; a node's tokens depend only on its id
+     */
+    static ShardRing build_ring(const std::vector<std::string>& node_ids,
+                                uint32_t vnodes = VIRTUAL_NODES) {
+        ShardRing ring;
+        ring.tokens.reserve(node_ids.size() * vnodes);
+        for (const auto& id : node_ids) {
+            for (uint32_t i = 0; i < vnodes; ++i) {
+                ring.tokens.push_back({stable_hash64(id + "#" + std::to_string(i)), id});
+            }
+        }
+        std::sort(ring.tokens.begin(), ring.tokens.end(),
+                  [](const auto& a, const auto& b) { return a.token < b.token; });
+        return ring;
+    }
 
-        // Use stable hash instead of std::hash which can vary per process/implementation
-        const std::string s = pk_value.to_string();
-        const uint32_t hash = stable_hash(s);
-        return hash % num_shards;
+    /**
+     * @brief Node that owns `key` on a non-empty ring
+     */
+    static const std::string& owner(const ShardRing& ring, const common::Value& key) {
+        const uint64_t hash = hash_value(key);
+        auto it = std::lower_bound(ring.tokens.begin(), ring.tokens.end(), hash,
+                                   [](const auto& vnode, uint64_t h) { return vnode.token < h; });
+        if (it == ring.tokens.end()) {
+            it = ring.tokens.begin(); /* Past the last token the ring wraps around */
+        }
+        return it->node_id;
     }
 
     /**
@@ -0,0 +1,91 @@
+/**
+ * @file shuffle_writer.hpp
+ * @brief Streams a table's rows to the nodes that own them, one chunk at a time
+ */
+
+#ifndef SQL_ENGINE_DISTRIBUTED_SHUFFLE_WRITER_HPP
+#define SQL_ENGINE_DISTRIBUTED_SHUFFLE_WRITER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/cluster_manager.hpp"
+#include "executor/types.hpp"
+#include "network/rpc_client.hpp"
+
+namespace cloudsql::cluster {
+
+/**
+ * @brief Sender half of a streaming shuffle
+ *
+ * Rows added for a destination are sent as PushData chunks of `chunk_rows`
+ * while the scan goes on. At most MAX_IN_FLIGHT chunks per destination go
+ * unacknowledged; receivers hold back acknowledgements while their buffer is
+ * full, which stalls add() until the consumer catches up. finish() sends
+ * every destination its final chunk, marked `last`.
+ */
+class ShuffleWriter {
+   public:
+    static constexpr size_t DEFAULT_CHUNK_ROWS = 1024;
+    static constexpr size_t MAX_IN_FLIGHT = 4;
+    /** How long a destination may withhold credit before the shuffle fails */
+    static constexpr std::chrono::milliseconds CREDIT_TIMEOUT{30000};
+
+    ShuffleWriter(ClusterManager& cm, std::vector<NodeInfo> destinations, std::string context_id,
+                  std::string table_name, size_t chunk_rows = DEFAULT_CHUNK_ROWS);
+    ~ShuffleWriter() = default;
+
+    ShuffleWriter(const ShuffleWriter&) = delete;
+    ShuffleWriter& operator=(const ShuffleWriter&) = delete;
+    ShuffleWriter(ShuffleWriter&&) = delete;
+    ShuffleWriter& operator=(ShuffleWriter&&) = delete;
+
+    /**
+     * @brief Queue `row` for `destination` (an index into the destinations)
+     * @return false once the shuffle has failed; further rows are dropped
+     */
+    bool add(size_t destination, executor::Tuple row);
+
+    /**
+     * @brief Send the final chunks and wait until every chunk is acknowledged
+     * @return false if any chunk was not delivered, with the reasons in `error`
+     */
+    bool finish(std::string& error);
+
+   private:
+    struct Destination {
+        NodeInfo node;
+        std::shared_ptr<network::RpcClient> client;
+        std::vector<executor::Tuple> rows;
+    };
+
+    /** Delivery progress, shared with the callbacks of chunks still in flight */
+    struct Progress {
+        std::mutex mutex;
+        std::condition_variable acked_cv;
+        std::vector<size_t> in_flight; /**< Unacknowledged chunks per destination */
+        std::atomic<bool> failed{false};
+        std::string errors; /**< Guarded by mutex */
+
+        void fail(const std::string& reason);
+    };
+
+    /** @brief Send the rows queued for destination `index` as one chunk */
+    void flush(size_t index, bool last);
+
+    std::string context_id_;
+    std::string table_name_;
+    size_t chunk_rows_;
+    std::vector<Destination> destinations_;
+    std::shared_ptr<Progress> progress_;
+};
+
+}  // namespace cloudsql::cluster
+
+#endif  // SQL_ENGINE_DISTRIBUTED_SHUFFLE_WRITER_HPP
@@ -0,0 +1,82 @@
+/**
+ * @file tick_scheduler.hpp
+ * @brief Runs many periodic tasks on a small, fixed pool of threads
+ */
+
+#ifndef SQL_ENGINE_DISTRIBUTED_TICK_SCHEDULER_HPP
+#define SQL_ENGINE_DISTRIBUTED_TICK_SCHEDULER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cloudsql::raft {
+
+/**
+ * @brief Queue of timed tasks, each run again when the time it returned comes
+ *
+ * A task returns when it next wants to run, or time_point::max() to sleep
+ * until wake(). A task never runs on two threads at once: a wake() that
+ * arrives while it runs makes it run again right after. Tasks are called
+ * without the scheduler's lock, so they may call wake() themselves.
+ */
+class TickScheduler {
+   public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<Clock::time_point()>;
+
+    explicit TickScheduler(size_t threads);
+    ~TickScheduler();
+
+    TickScheduler(const TickScheduler&) = delete;
+    TickScheduler& operator=(const TickScheduler&) = delete;
+    TickScheduler(TickScheduler&&) = delete;
+    TickScheduler& operator=(TickScheduler&&) = delete;
+
+    void start();
+    /** @brief Join the workers; a task running at the time finishes first */
+    void stop();
+
+    /** @brief Add a task, due now; an existing task under the id is replaced */
+    void add(uint32_t id, Task task);
+    /** @brief Run the task as soon as a worker is free; unknown ids are ignored */
+    void wake(uint32_t id);
+
+    [[nodiscard]] size_t threads() const { return threads_; }
+    /** @brief Task runs since start */
+    [[nodiscard]] uint64_t runs() const;
+
+   private:
+    struct Entry {
+        Task task;
+        Clock::time_point due;
+        bool queued = false;
+        bool running = false;
+        bool woken = false;  // Woken while running: due again once it returns
+    };
+
+    void worker();
+    /** @brief (Re)queue an entry at `due`; called with mutex_ held */
+    void schedule(uint32_t id, Entry& entry, Clock::time_point due);
+
+    size_t threads_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::set<std::pair<Clock::time_point, uint32_t>> queue_;
+    std::unordered_map<uint32_t, Entry> entries_;
+    std::vector<std::thread> workers_;
+    bool running_ = false;
+    uint64_t runs_ = 0;
+};
+
+}  // namespace cloudsql::raft
+
+#endif  // SQL_ENGINE_DISTRIBUTED_TICK_SCHEDULER_HPP
@@ -0,0 +1,139 @@
+/**
+ * @file aggregate_hash_table.hpp
+ * @brief Vectorized GROUP BY state: typed group keys and mergeable aggregates
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_AGGREGATE_HASH_TABLE_HPP
+#define CLOUDSQL_EXECUTOR_AGGREGATE_HASH_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "executor/types.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief Aggregate specification for vectorized operator
+ */
+struct VectorizedAggregateInfo {
+    AggregateType type;
+    int32_t input_col_idx;  // -1 for COUNT(*)
+    bool is_distinct = false;
+};
+
+/**
+ * @brief Hash table from group keys to aggregate states, fed a batch at a time
+ *
+ * Keys and states are stored column-wise, one entry per group, and found
+ * through an open-addressing index of 8-byte slots (hash tag + group id) with
+ * linear probing. A batch is hashed column by column before any probing, and
+ * states are then updated one aggregate at a time over the batch.
+ *
+ * NULL keys form their own group. Aggregates ignore NULL inputs; COUNT(*)
+ * counts rows. Tables that share a layout can be merged, so partial tables
+ * built on separate threads or nodes combine into the final result.
+ */
+class AggregateHashTable {
+   public:
+    /**
+     * @param input_schema Schema of the batches passed to add_batch()
+     * @param group_columns Input columns forming the group key, in output order
+     * @throws std::runtime_error for a type an aggregate or key cannot handle
+     */
+    AggregateHashTable(const Schema& input_schema, std::vector<size_t> group_columns,
+                       std::vector<VectorizedAggregateInfo> aggregates);
+
+    /**
+     * @brief Fold the live rows of `batch` (its selection, if any) into the table
+     */
+    void add_batch(const VectorBatch& batch);
+
+    /**
+     * @brief Fold another table's partial states into this one
+     * @throws std::runtime_error if the tables were built for different layouts
+     */
+    void merge(const AggregateHashTable& other);
+
+    [[nodiscard]] size_t group_count() const { return group_hashes_.size(); }
+
+    /** @return Estimated bytes held by the groups, strings at their inline size */
+    [[nodiscard]] size_t memory_bytes() const;
+
+    /** @return Input columns the group key and the aggregates read */
+    [[nodiscard]] std::vector<size_t> input_columns() const {
+        std::vector<size_t> columns;
+        for (const auto& key : keys_) {
+            columns.push_back(key.input);
+        }
+        for (const auto& aggregate : aggregates_) {
+            if (aggregate.info.input_col_idx >= 0) {
+                columns.push_back(static_cast<size_t>(aggregate.info.input_col_idx));
+            }
+        }
+        return columns;
+    }
+
+    /**
+     * @brief Write groups [begin, begin + count) to `out`: keys, then one column
+     * per aggregate. `out` is laid out for the output schema; numeric results
+     * convert to the column types it declares.
+     */
+    void emit(size_t begin, size_t count, VectorBatch& out) const;
+
+   private:
+    enum class DataKind : uint8_t { Int, Bool, Float, String };
+
+    struct KeyColumn {
+        size_t input;
+        DataKind kind;
+        std::vector<int64_t> ints; /**< Int and Bool keys */
+        std::vector<double> floats;
+        std::vector<std::string> strings;
+        std::vector<uint8_t> nulls;
+    };
+
+    /** Distinct (group, value) pairs of one DISTINCT aggregate */
+    struct DistinctSet {
+        std::vector<uint64_t> slots; /**< (hash tag << 32) | (entry + 1); 0 = empty */
+        std::vector<uint64_t> hashes;
+        std::vector<uint32_t> groups;
+        std::vector<int64_t> ints;
+        std::vector<double> floats;
+        std::vector<std::string> strings;
+    };
+
+    struct AggregateState {
+        VectorizedAggregateInfo info;
+        DataKind kind;
+        std::vector<int64_t> counts; /**< Non-NULL inputs (rows for COUNT(*)) */
+        std::vector<int64_t> ints;   /**< SUM / MIN / MAX of integer inputs */
+        std::vector<double> floats;  /**< SUM / MIN / MAX of double inputs */
+        std::vector<std::string> strings;
+        DistinctSet distinct;
+    };
+
+    std::vector<KeyColumn> keys_;
+    std::vector<AggregateState> aggregates_;
+    std::vector<uint64_t> group_hashes_;
+    std::vector<uint64_t> slots_; /**< (hash tag << 32) | (group + 1); 0 = empty */
+
+    /* Per-batch scratch, kept to avoid reallocating */
+    std::vector<uint64_t> row_hashes_;
+    std::vector<uint32_t> row_groups_;
+
+    void grow();
+    uint32_t add_group(uint64_t hash);
+    void init_states(uint32_t group);
+    void accumulate(AggregateState& agg, uint32_t group, int64_t int_value, double float_value,
+                    const std::string* string_value);
+    bool insert_distinct(AggregateState& agg, uint32_t group, uint64_t value_hash,
+                         int64_t int_value, double float_value, const std::string* string_value);
+    void update_aggregate(AggregateState& agg, const VectorBatch& batch);
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_AGGREGATE_HASH_TABLE_HPP
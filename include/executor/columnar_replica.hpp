@@ -0,0 +1,175 @@
+/**
+ * @file columnar_replica.hpp
+ * @brief Columnar replicas of heap tables, kept current from the write-ahead log
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_COLUMNAR_REPLICA_HPP
+#define CLOUDSQL_EXECUTOR_COLUMNAR_REPLICA_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "catalog/catalog.hpp"
+#include "executor/types.hpp"
+#include "recovery/log_manager.hpp"
+#include "recovery/log_record.hpp"
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/columnar_table.hpp"
+#include "storage/delta_compactor.hpp"
+#include "storage/heap_table.hpp"
+#include "transaction/transaction_manager.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @class ColumnarReplicaManager
+ * @brief Keeps a ColumnarTable copy of each attached heap table, fed from the WAL
+ *
+ * attach() copies the committed rows of a table into a columnar table named
+ * `<table>.replica`. From then on each pass reads the records the LogManager
+ * has made durable since the last one, holds a transaction's inserts and
+ * deletes of attached tables until its COMMIT and applies them in commit
+ * order; an ABORT drops them. Heap tuple ids are mapped to replica row ids, so
+ * a delete masks the row it names and an update, logged as a delete and an
+ * insert, adds a new row. Inserts go to the replica's delta, which a
+ * DeltaCompactor seals into chunks.
+ *
+ * Reads are stale by a bounded amount: snapshot() hands out a copy of the
+ * replica as of the last pass, first running a pass itself if the last one to
+ * reach the end of the durable log started more than max_lag ago. A copy
+ * holds whole transactions only and does not change while a query scans it.
+ *
+ * Replicas are derived data and are not recovered; attach() rebuilds one
+ * from the heap, as the server does for every table marked for a replica when
+ * it starts. Only changes logged through this node's WAL reach them.
+ */
+class ColumnarReplicaManager {
+   public:
+    struct Options {
+        std::chrono::milliseconds naptime{100};  /**< Between passes over new log records */
+        std::chrono::milliseconds max_lag{1000}; /**< Oldest pass a read may be served from */
+    };
+
+    struct Stats {
+        std::atomic<uint64_t> passes{0};
+        std::atomic<uint64_t> records_read{0};
+        std::atomic<uint64_t> rows_inserted{0}; /**< Into replicas, by committed transactions */
+        std::atomic<uint64_t> rows_deleted{0};
+    };
+
+    /** @param log WAL whose durable records feed the replicas; reading starts at its end */
+    ColumnarReplicaManager(storage::BufferPoolManager& bpm,
+                           transaction::TransactionManager& transaction_manager,
+                           recovery::LogManager& log);
+    ~ColumnarReplicaManager();
+
+    ColumnarReplicaManager(const ColumnarReplicaManager&) = delete;
+    ColumnarReplicaManager& operator=(const ColumnarReplicaManager&) = delete;
+    ColumnarReplicaManager(ColumnarReplicaManager&&) = delete;
+    ColumnarReplicaManager& operator=(ColumnarReplicaManager&&) = delete;
+
+    /**
+     * @brief Build a replica of `table` from its committed rows and keep it current
+     *
+     * Waits for the transactions running at the call to end, so it must not
+     * run inside one. Attaching a table twice does nothing.
+     * @return false if the replica could not be written
+     */
+    bool attach(const TableInfo& table);
+
+    /** @brief Stop maintaining the replica of `table` and delete its files */
+    void detach(const std::string& table);
+
+    [[nodiscard]] bool attached(const std::string& table);
+
+    /**
+     * @brief A copy of the replica of `table`, at most max_lag behind the durable log
+     * @return null if `table` has no replica, it is still being built or it failed
+     */
+    [[nodiscard]] std::shared_ptr<storage::ColumnarTable> snapshot(const std::string& table);
+
+    /**
+     * @brief Apply every record durable now
+     * @return false if the log could not be read
+     */
+    bool catch_up();
+
+    /** @return Time since the start of the last pass that reached the end of the durable log */
+    [[nodiscard]] std::chrono::milliseconds lag() const;
+
+    /** @brief Start the worker; does nothing if it is running */
+    void start(const Options& options);
+
+    /** @brief Stop the worker, letting it finish its pass */
+    void stop();
+
+    [[nodiscard]] const Stats& get_stats() const { return stats_; }
+
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    /** @brief One row change of an attached table, as logged */
+    struct Change {
+        std::string table;
+        bool insert;
+        storage::HeapTable::TupleId rid;
+        Tuple row;
+    };
+
+    struct Replica {
+        std::shared_ptr<storage::ColumnarTable> table;
+        std::unordered_map<uint64_t, uint64_t> rows; /**< Heap tuple id -> replica row */
+        transaction::txn_id_t first_txn = 0; /**< Earlier transactions are in the initial copy */
+        bool ready = false;                  /**< Initial copy done */
+        bool failed = false;                 /**< A change could not be applied */
+        std::vector<Change> pending;         /**< Committed during the initial copy */
+    };
+
+    [[nodiscard]] static uint64_t row_key(const storage::HeapTable::TupleId& rid) {
+        return (static_cast<uint64_t>(rid.page_num) << 16) | rid.slot_num;
+    }
+
+    /** @brief One pass over the durable log; called with feed_mutex_ held */
+    bool read_log();
+
+    /** @brief Buffer the changes of `record` to attached tables, or end its transaction */
+    void handle(const recovery::LogRecord& record, std::vector<Change>& committed);
+
+    /** @brief Apply committed `changes` to `replica` in order */
+    bool apply(Replica& replica, std::vector<Change>& changes);
+
+    void run();
+
+    storage::BufferPoolManager& bpm_;
+    transaction::TransactionManager& transaction_manager_;
+    recovery::LogManager& log_;
+    storage::DeltaCompactor compactor_;
+    Stats stats_;
+
+    /* Serializes passes; guards everything below up to the worker's fields */
+    std::mutex feed_mutex_;
+    std::unordered_map<std::string, std::shared_ptr<Replica>> replicas_;
+    std::unordered_map<transaction::txn_id_t, std::vector<Change>> open_txns_;
+    uint64_t offset_ = 0;                     /**< Log file offset of the next record to read */
+    recovery::lsn_t last_lsn_ = recovery::INVALID_LSN;
+    std::atomic<Clock::rep> caught_up_at_;  /**< Start of the last pass that read it all */
+    Options options_;
+
+    std::mutex worker_latch_;
+    std::condition_variable worker_cv_;
+    std::chrono::milliseconds naptime_{0};
+    bool worker_stop_ = false;
+    std::thread worker_;
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_COLUMNAR_REPLICA_HPP
@@ -0,0 +1,61 @@
+/**
+ * @file compiled_expression.hpp
+ * @brief Expressions bound to a schema and compiled for per-tuple evaluation
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_COMPILED_EXPRESSION_HPP
+#define CLOUDSQL_EXECUTOR_COMPILED_EXPRESSION_HPP
+
+#include <functional>
+#include <utility>
+
+#include "common/value.hpp"
+#include "executor/types.hpp"
+#include "parser/expression.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief A parser::Expression bound to its input schema and compiled into a
+ * tree of closures
+ *
+ * Column (and aggregate result) references are resolved to tuple indices once,
+ * and leaves are read from the tuple in place rather than copied into a Value
+ * at every node. Comparisons and boolean connectives evaluate to plain bools;
+ * a comparison of a column with an integer or float constant runs as a typed
+ * fast path. Results are exactly those of Expression::evaluate() against the
+ * same schema, including its treatment of NULLs.
+ */
+class CompiledExpression {
+   public:
+    /**
+     * Evaluates the node for a tuple. Returns a reference to the tuple's own
+     * value, to a constant of the plan, or to `scratch` when it computes one.
+     */
+    using ValueFn =
+        std::function<const common::Value&(const Tuple& tuple, common::Value& scratch)>;
+    using PredicateFn = std::function<bool(const Tuple& tuple)>;
+
+    CompiledExpression(const parser::Expression& expr, const Schema& schema);
+
+    /** @return The same value as expr.evaluate(&tuple, &schema) */
+    [[nodiscard]] common::Value evaluate(const Tuple& tuple) const {
+        common::Value scratch;
+        const common::Value& result = value_(tuple, scratch);
+        return &result == &scratch ? std::move(scratch) : result;
+    }
+
+    /**
+     * @brief Evaluate as a WHERE condition: evaluate(tuple).as_bool()
+     * @throws std::runtime_error if the expression does not yield a boolean
+     */
+    [[nodiscard]] bool test(const Tuple& tuple) const { return predicate_(tuple); }
+
+   private:
+    ValueFn value_;
+    PredicateFn predicate_;
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_COMPILED_EXPRESSION_HPP
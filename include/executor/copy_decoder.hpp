@@ -0,0 +1,75 @@
+/**
+ * @file copy_decoder.hpp
+ * @brief Parses COPY FROM STDIN data in the text, CSV and binary formats
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_COPY_DECODER_HPP
+#define CLOUDSQL_EXECUTOR_COPY_DECODER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "common/value.hpp"
+#include "executor/types.hpp"
+#include "parser/statement.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief Incremental decoder of COPY data into rows of a schema
+ *
+ * Data may arrive in chunks split anywhere, as CopyData messages are; a
+ * partial row waits for the next chunk. Text fields are converted to the
+ * column type: integers, floats and booleans are parsed, everything else is
+ * kept as text. Malformed input throws std::runtime_error naming the row.
+ */
+class CopyDecoder {
+   public:
+    /* Signature that opens binary COPY data */
+    static constexpr std::string_view BINARY_SIGNATURE{"PGCOPY\n\377\r\n\0", 11};
+
+    CopyDecoder(Schema schema, parser::CopyOptions options)
+        : schema_(std::move(schema)), options_(options) {}
+
+    /** @brief Appends `data` and decodes the rows it completes into `rows` */
+    void feed(const char* data, size_t size, std::vector<Tuple>& rows);
+
+    /**
+     * @brief End of data: decodes a last row that lacks its line terminator
+     * @throws std::runtime_error if the data stops inside a row
+     */
+    void finish(std::vector<Tuple>& rows);
+
+    /** @return Whether the end marker (`\.` or the binary trailer) was seen */
+    [[nodiscard]] bool ended() const { return ended_; }
+
+   private:
+    /* Each decodes one row starting at pos_, or returns false if it is incomplete */
+    bool next_text_row(std::vector<Tuple>& rows);
+    bool next_csv_row(std::vector<Tuple>& rows, bool at_end);
+    bool next_binary_row(std::vector<Tuple>& rows);
+
+    /** @brief Converts fields_ into a row of the schema */
+    void add_text_row(std::vector<Tuple>& rows);
+    [[nodiscard]] common::Value parse_text(size_t column, std::string_view text) const;
+    [[nodiscard]] common::Value parse_binary(size_t column, const char* data, size_t size) const;
+    [[noreturn]] void fail(const std::string& message) const;
+
+    Schema schema_;
+    parser::CopyOptions options_;
+    std::string pending_; /**< Undecoded data; rows start at pos_ */
+    std::vector<std::string> fields_; /**< Fields of the text or CSV row being decoded */
+    std::vector<bool> nulls_;
+    size_t pos_ = 0;
+    uint64_t line_ = 0; /**< Rows (lines in text and CSV) consumed, for error messages */
+    bool started_ = false; /**< Header line or binary header consumed */
+    bool ended_ = false;
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_COPY_DECODER_HPP
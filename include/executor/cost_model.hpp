@@ -0,0 +1,97 @@
+/**
+ * @file cost_model.hpp
+ * @brief Selectivity and cost estimates the planner compares plans with
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_COST_MODEL_HPP
+#define CLOUDSQL_EXECUTOR_COST_MODEL_HPP
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "catalog/catalog.hpp"
+#include "common/value.hpp"
+#include "storage/btree_index.hpp"
+
+namespace cloudsql::executor::cost {
+
+/* Costs are in units of one sequential page read */
+constexpr double SEQ_PAGE_COST = 1.0;
+constexpr double RANDOM_PAGE_COST = 4.0;
+constexpr double CPU_TUPLE_COST = 0.01;
+constexpr double CPU_INDEX_TUPLE_COST = 0.005;
+constexpr double HASH_BUILD_COST = 0.02; /**< Per build row: hash, copy and insert */
+constexpr double HASH_PROBE_COST = 0.01; /**< Per probe row */
+/** Hash index lookup: a directory slot and one bucket, against a whole tree descent */
+constexpr double HASH_INDEX_PROBE_COST = 2.0;
+
+/* Selectivity of a range the statistics cannot place, e.g. without a histogram */
+constexpr double DEFAULT_RANGE_SELECTIVITY = 1.0 / 3.0;
+
+/** Joins of more relations than this keep their written order */
+constexpr size_t MAX_REORDERED_JOINS = 10;
+
+/** @return Fraction of rows whose column equals `value`; NULL matches nothing */
+[[nodiscard]] double equality_selectivity(const ColumnStats& stats, const common::Value& value);
+
+/**
+ * @return Fraction of rows between the bounds under Value ordering, where
+ * NULL sorts after every value; an absent bound leaves that end open
+ */
+[[nodiscard]] double range_selectivity(const ColumnStats& stats,
+                                       const std::optional<storage::BTreeIndex::Bound>& lower,
+                                       const std::optional<storage::BTreeIndex::Bound>& upper);
+
+/** @return Selectivity of `left = right` between two columns */
+[[nodiscard]] double join_selectivity(const ColumnStats& left, const ColumnStats& right);
+
+[[nodiscard]] double seq_scan_cost(const TableStats& stats);
+
+/** @brief Index descent plus one heap fetch per match, on pages in random order */
+[[nodiscard]] double index_scan_cost(const TableStats& stats, double selectivity);
+
+/** @brief Hash index probe for one key plus one heap fetch per match */
+[[nodiscard]] double hash_index_scan_cost(const TableStats& stats, double selectivity);
+
+/**
+ * @brief Bitmap heap scan of `heap_pages` pages in `runs` contiguous runs, each
+ * read sequentially after a seek, and every row on them checked
+ */
+[[nodiscard]] double bitmap_heap_scan_cost(const TableStats& stats, double heap_pages,
+                                           double runs);
+
+[[nodiscard]] double hash_join_cost(double build_rows, double probe_rows, double output_rows);
+
+/**
+ * @brief Equality join predicate between two relations of a join
+ */
+struct JoinEdge {
+    size_t left;
+    size_t right;
+    double selectivity;
+};
+
+/**
+ * @return Cost of joining `rows.size()` relations in `order` as a left-deep
+ * chain of hash joins that build on the smaller input, or infinity if some
+ * relation has no edge to those before it
+ */
+[[nodiscard]] double join_order_cost(const std::vector<double>& rows,
+                                     const std::vector<JoinEdge>& edges,
+                                     const std::vector<size_t>& order);
+
+/**
+ * @brief Cheapest join order by dynamic programming over subsets
+ *
+ * Relation 0 stays first; every later relation must be connected by an edge
+ * to one before it, so no cross products are planned.
+ * @return Relation indices in join order, or empty when there are more than
+ * MAX_REORDERED_JOINS relations or they are not connected
+ */
+[[nodiscard]] std::vector<size_t> order_joins(const std::vector<double>& rows,
+                                              const std::vector<JoinEdge>& edges);
+
+}  // namespace cloudsql::executor::cost
+
+#endif  // CLOUDSQL_EXECUTOR_COST_MODEL_HPP
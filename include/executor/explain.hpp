@@ -0,0 +1,126 @@
+/**
+ * @file explain.hpp
+ * @brief Plan trees and per-operator statistics for EXPLAIN [ANALYZE]
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_EXPLAIN_HPP
+#define CLOUDSQL_EXECUTOR_EXPLAIN_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "executor/types.hpp"
+#include "storage/io_counters.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief What one operator did while EXPLAIN ANALYZE ran it
+ *
+ * Time and I/O are inclusive: an operator's figures contain those of the
+ * children it pulled from, as in PostgreSQL.
+ */
+struct OperatorStats {
+    uint64_t loops = 0;   /**< open() calls */
+    uint64_t batches = 0; /**< Batches returned (vectorized operators) */
+    uint64_t rows = 0;
+    uint64_t time_ns = 0;
+    uint64_t buffer_hits = 0;
+    uint64_t buffer_misses = 0;
+    uint64_t pages_read = 0;
+};
+
+/**
+ * @class InstrumentScope
+ * @brief While it lives, operators constructed on this thread keep OperatorStats
+ *
+ * Operators made outside a scope have no statistics, and their open() and
+ * next() cost one extra null test.
+ */
+class InstrumentScope {
+   public:
+    InstrumentScope();
+    ~InstrumentScope();
+
+    InstrumentScope(const InstrumentScope&) = delete;
+    InstrumentScope& operator=(const InstrumentScope&) = delete;
+    InstrumentScope(InstrumentScope&&) = delete;
+    InstrumentScope& operator=(InstrumentScope&&) = delete;
+
+    /** @return Whether a scope is open on this thread */
+    [[nodiscard]] static bool active();
+
+    /** @return Fresh statistics inside a scope, null outside one */
+    [[nodiscard]] static std::unique_ptr<OperatorStats> make_stats() {
+        return active() ? std::make_unique<OperatorStats>() : nullptr;
+    }
+
+   private:
+    bool previous_;
+};
+
+/**
+ * @brief Adds the time and I/O of its lifetime to an OperatorStats
+ */
+class StatsTimer {
+   public:
+    explicit StatsTimer(OperatorStats& stats)
+        : stats_(stats),
+          io_(storage::thread_io_counters()),
+          start_(std::chrono::steady_clock::now()) {}
+
+    ~StatsTimer() {
+        const auto elapsed = std::chrono::steady_clock::now() - start_;
+        stats_.time_ns += static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        const storage::IoCounters& io = storage::thread_io_counters();
+        stats_.buffer_hits += io.buffer_hits - io_.buffer_hits;
+        stats_.buffer_misses += io.buffer_misses - io_.buffer_misses;
+        stats_.pages_read += io.pages_read - io_.pages_read;
+    }
+
+    StatsTimer(const StatsTimer&) = delete;
+    StatsTimer& operator=(const StatsTimer&) = delete;
+    StatsTimer(StatsTimer&&) = delete;
+    StatsTimer& operator=(StatsTimer&&) = delete;
+
+   private:
+    OperatorStats& stats_;
+    storage::IoCounters io_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * @brief One operator of a plan as EXPLAIN prints it
+ */
+struct ExplainNode {
+    std::string label;                    /**< e.g. "Seq Scan on users" */
+    std::vector<std::string> details;     /**< Extra lines, e.g. "Filter: (age > 30)" */
+    const OperatorStats* stats = nullptr; /**< Null unless the plan ran under ANALYZE */
+    std::vector<ExplainNode> children;
+
+    ExplainNode& add_child() { return children.emplace_back(); }
+};
+
+/**
+ * @brief Formats a plan tree, one line per operator and detail
+ *
+ * Children are indented under their parent behind "->", PostgreSQL style.
+ * With statistics each operator line ends in
+ * "(actual time=T ms rows=R loops=L)", followed by a "Buffers:" line when
+ * it touched any page.
+ */
+std::vector<std::string> render_explain(const ExplainNode& root);
+
+/** @return `elapsed` in milliseconds with three decimals, e.g. "12.345" */
+std::string format_ms(std::chrono::nanoseconds elapsed);
+
+/** @return "Inner", "Left", ... as a join label spells it */
+const char* join_type_name(JoinType type);
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_EXPLAIN_HPP
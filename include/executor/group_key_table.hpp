@@ -0,0 +1,70 @@
+/**
+ * @file group_key_table.hpp
+ * @brief Hash table from encoded row keys to dense ids, for the row executor
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_GROUP_KEY_TABLE_HPP
+#define CLOUDSQL_EXECUTOR_GROUP_KEY_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "common/value.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief Open-addressing map from encoded keys to ids 0, 1, 2, ... in insertion order
+ *
+ * A key is the concatenation of append_key() encodings, one per key column.
+ * Key bytes are copied into one arena; the slot array holds ids, is probed
+ * linearly and is kept at most half full.
+ */
+class GroupKeyTable {
+   public:
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    /**
+     * @brief Appends the encoding of one key column
+     *
+     * Encodings are equal exactly when the values are equal under SQL '='
+     * (integers and integral floats alike), except that NULLs equal each other
+     * and all NaNs are one value, as GROUP BY and DISTINCT need.
+     */
+    static void append_key(const common::Value& value, std::string& out);
+
+    [[nodiscard]] static uint64_t hash_key(std::string_view key);
+
+    /** @return Id of `key`, and whether this call inserted it */
+    std::pair<uint32_t, bool> insert(std::string_view key, uint64_t hash);
+
+    /** @return Id of `key`, or NOT_FOUND */
+    [[nodiscard]] uint32_t find(std::string_view key, uint64_t hash) const;
+
+    [[nodiscard]] size_t size() const { return hashes_.size(); }
+    [[nodiscard]] std::string_view key(uint32_t id) const {
+        return std::string_view(arena_).substr(offsets_[id], offsets_[id + 1] - offsets_[id]);
+    }
+
+    /** @return Bytes of keys and index held by the table */
+    [[nodiscard]] size_t memory_bytes() const;
+
+    void clear();
+
+   private:
+    std::vector<uint32_t> slots_;  /**< id + 1 per slot; 0 = empty */
+    std::vector<uint64_t> hashes_; /**< Per id */
+    std::vector<size_t> offsets_ = {0}; /**< Per id, into arena_; one extra for the end */
+    std::string arena_;
+
+    [[nodiscard]] size_t probe(std::string_view key, uint64_t hash) const;
+    void grow();
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_GROUP_KEY_TABLE_HPP
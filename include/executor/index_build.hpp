@@ -0,0 +1,133 @@
+/**
+ * @file index_build.hpp
+ * @brief Parallel backfill of a new index and the side log of CREATE INDEX CONCURRENTLY
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_INDEX_BUILD_HPP
+#define CLOUDSQL_EXECUTOR_INDEX_BUILD_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "common/value.hpp"
+#include "executor/thread_pool.hpp"
+#include "executor/types.hpp"
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/heap_table.hpp"
+#include "storage/index.hpp"
+
+namespace cloudsql::executor {
+
+/** @brief Options of collect_index_entries() */
+struct IndexBuildOptions {
+    static constexpr uint32_t DEFAULT_PAGES_PER_TASK = 64;
+    static constexpr uint32_t DEFAULT_MIN_PARALLEL_PAGES = 128;
+
+    size_t parallelism = 0; /**< Worker threads; 0 = MorselScheduler::default_parallelism() */
+    uint32_t pages_per_task = DEFAULT_PAGES_PER_TASK;
+    uint32_t min_parallel_pages = DEFAULT_MIN_PARALLEL_PAGES; /**< Smaller heaps: one thread */
+    bool sorted = true; /**< Order the entries by key, then tuple id */
+};
+
+/**
+ * @brief The index entries of every row of `table` no deleter has marked
+ *
+ * Workers of `pool` (default: the shared WorkStealingPool) each scan disjoint page ranges of
+ * the heap, extract the key in `column` of every row and sort their range's
+ * entries into a run; the runs are then merged. BTreeIndex::bulk_load() takes
+ * the merged entries as they are and builds its leaves bottom-up without
+ * sorting again. The last range runs to the end of the heap, so pages added
+ * while the scan runs are read as well.
+ */
+[[nodiscard]] std::vector<storage::Index::Entry> collect_index_entries(
+    storage::BufferPoolManager& bpm, const std::string& table_name, const Schema& schema,
+    uint16_t column, const IndexBuildOptions& options = {}, WorkStealingPool* pool = nullptr);
+
+/**
+ * @brief A CREATE INDEX CONCURRENTLY in progress, and the side log of the
+ * writes to its table that it still has to apply
+ *
+ * The index is not in the Catalog while it is built, so writers do not
+ * maintain it. Instead every place that changes a table's index entries (DML
+ * and transaction rollback) reports the change with record_insert() or
+ * record_remove() right after changing the heap; while a build of that table
+ * is registered, the change is appended to its log. A row is therefore either
+ * changed before the build registers, and its new state is what the backfill
+ * scan reads, or its change is in the log. Changes of one row are applied in
+ * the order they were made, and an index insert or remove that is already
+ * done is a no-op, so it does not matter whether the scan saw the row before
+ * or after a logged change.
+ *
+ * catch_up() applies the log while writers carry on. publish() applies what
+ * is left with writers held off, then runs the caller's catalog update; from
+ * then on record_*() writes the index directly, for statements still using
+ * table handles opened before the index was published. The build stays
+ * registered until it is destroyed, which should wait for those statements'
+ * transactions (TransactionManager::wait_for_running()).
+ */
+class ConcurrentIndexBuild {
+   public:
+    ConcurrentIndexBuild(const storage::BufferPoolManager& bpm, std::string table_name,
+                         uint16_t column, storage::Index& index);
+    ~ConcurrentIndexBuild();
+
+    ConcurrentIndexBuild(const ConcurrentIndexBuild&) = delete;
+    ConcurrentIndexBuild& operator=(const ConcurrentIndexBuild&) = delete;
+    ConcurrentIndexBuild(ConcurrentIndexBuild&&) = delete;
+    ConcurrentIndexBuild& operator=(ConcurrentIndexBuild&&) = delete;
+
+    /** @brief Applies the changes logged so far; @return false if the index refused one */
+    bool catch_up();
+
+    /**
+     * @brief Applies the rest of the log and runs `publish` before any writer logs again
+     * @return false if the index refused a change or `publish` returned false
+     */
+    bool publish(const std::function<bool()>& publish);
+
+    /** @return Changes logged since the build registered */
+    [[nodiscard]] uint64_t logged() const;
+
+    /** @brief `row` was placed at `tid` of `table`, or its delete was undone */
+    static void record_insert(const storage::BufferPoolManager& bpm, const std::string& table,
+                              const storage::HeapTable::TupleId& tid, const Tuple& row) {
+        if (active_.load() != 0) record(bpm, table, tid, row, true);
+    }
+
+    /** @brief `row` at `tid` of `table` was deleted, or its insert was undone */
+    static void record_remove(const storage::BufferPoolManager& bpm, const std::string& table,
+                              const storage::HeapTable::TupleId& tid, const Tuple& row) {
+        if (active_.load() != 0) record(bpm, table, tid, row, false);
+    }
+
+   private:
+    struct Change {
+        bool insert;
+        storage::HeapTable::TupleId tid;
+        common::Value key;
+    };
+
+    static void record(const storage::BufferPoolManager& bpm, const std::string& table,
+                       const storage::HeapTable::TupleId& tid, const Tuple& row, bool insert);
+
+    /** @brief Applies `changes` in order; @return false if the index refused one */
+    bool apply(const std::vector<Change>& changes);
+
+    static std::atomic<size_t> active_; /**< Builds registered in the whole process */
+
+    const storage::BufferPoolManager* bpm_;
+    std::string table_name_;
+    uint16_t column_;
+    storage::Index& index_;
+    std::vector<Change> log_; /**< Guarded by the registry's mutex */
+    bool published_ = false;  /**< Guarded by the registry's mutex */
+    uint64_t logged_ = 0;     /**< Guarded by the registry's mutex */
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_INDEX_BUILD_HPP
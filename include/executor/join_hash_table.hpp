@@ -0,0 +1,101 @@
+/**
+ * @file join_hash_table.hpp
+ * @brief Build side of the vectorized hash join
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_JOIN_HASH_TABLE_HPP
+#define CLOUDSQL_EXECUTOR_JOIN_HASH_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "executor/types.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief Columnar copy of the build input, indexed by the hash of its key
+ *
+ * Build rows are appended to one VectorBatch and chained per bucket: `heads_`
+ * holds the first row of each bucket and `next_` the following row of the
+ * same bucket. Rows with a NULL in any key column can never match and are
+ * dropped while building.
+ *
+ * Probing works a batch at a time: begin_probe() hashes the probe keys of the
+ * whole batch, then first_match() / next_match() walk the matching build rows
+ * of one probe row.
+ */
+class JoinHashTable {
+   public:
+    static constexpr uint32_t NO_MATCH = UINT32_MAX;
+
+    /**
+     * @throws std::runtime_error if the key lists differ in length or a probe
+     * key cannot be compared with its build key
+     */
+    JoinHashTable(const Schema& build_schema, std::vector<size_t> build_keys,
+                  const Schema& probe_schema, std::vector<size_t> probe_keys);
+
+    /** @brief Copies the live rows of a build-side batch into the table */
+    void add_batch(const VectorBatch& batch);
+
+    [[nodiscard]] size_t row_count() const { return rows_->row_count(); }
+
+    /** @return Estimated bytes held by the stored rows and the bucket chains */
+    [[nodiscard]] size_t memory_bytes() const;
+
+    /** @return The stored build rows, laid out like the build schema */
+    [[nodiscard]] const VectorBatch& rows() const { return *rows_; }
+
+    /** @brief Hashes the key columns of `batch`; it must outlive the match calls that follow */
+    void begin_probe(const VectorBatch& batch);
+
+    /** @return First build row whose key equals that of probe row `row`, or NO_MATCH */
+    [[nodiscard]] uint32_t first_match(size_t row) const;
+
+    /** @return Build row after `build_row` matching probe row `row`, or NO_MATCH */
+    [[nodiscard]] uint32_t next_match(uint32_t build_row, size_t row) const;
+
+   private:
+    enum class KeyKind : uint8_t { Int, Bool, Float, String };
+
+    /* Typed pointers into one key column */
+    struct KeyView {
+        const int64_t* ints = nullptr;
+        const uint8_t* bools = nullptr;
+        const double* floats = nullptr;
+        const std::string* strings = nullptr;
+        const uint8_t* nulls = nullptr;
+    };
+
+    std::vector<size_t> build_keys_;
+    std::vector<size_t> probe_keys_;
+    std::vector<KeyKind> kinds_;
+    std::unique_ptr<VectorBatch> rows_;
+    std::vector<uint64_t> hashes_;  /**< Per build row */
+    std::vector<uint32_t> next_;    /**< Per build row: next row in the bucket + 1; 0 = end */
+    std::vector<uint32_t> heads_;   /**< Per bucket: first row + 1; 0 = empty */
+    size_t row_width_ = 0;          /**< Bytes of a stored row, strings at their inline size */
+    size_t text_bytes_ = 0;         /**< Heap bytes of stored strings too long to be inline */
+
+    /* Probe state for the current batch */
+    std::vector<KeyView> build_views_;
+    std::vector<KeyView> probe_views_;
+    std::vector<uint64_t> probe_hashes_;
+    std::vector<uint32_t> scratch_rows_;
+
+    static KeyKind kind_of(common::ValueType type);
+    void bind_views(const VectorBatch& batch, const std::vector<size_t>& columns,
+                    std::vector<KeyView>& views) const;
+    void hash_rows(const std::vector<KeyView>& views, size_t rows, uint64_t* hashes) const;
+    [[nodiscard]] bool keys_equal(uint32_t build_row, size_t probe_row) const;
+    [[nodiscard]] uint32_t scan_chain(uint32_t entry, size_t row) const;
+    void rebuild_buckets(size_t bucket_count);
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_JOIN_HASH_TABLE_HPP
@@ -0,0 +1,182 @@
+/**
+ * @file morsel_scheduler.hpp
+ * @brief Morsel-driven parallel execution of vectorized pipelines
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_MORSEL_SCHEDULER_HPP
+#define CLOUDSQL_EXECUTOR_MORSEL_SCHEDULER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/memory_tracker.hpp"
+#include "executor/aggregate_hash_table.hpp"
+#include "executor/thread_pool.hpp"
+#include "executor/vectorized_operator.hpp"
+#include "storage/columnar_table.hpp"
+
+namespace cloudsql::executor {
+
+/** Row range [begin, end) of a table, processed by one worker at a time */
+struct Morsel {
+    uint64_t begin;
+    uint64_t end;
+};
+
+struct MorselOptions {
+    static constexpr uint64_t DEFAULT_MORSEL_ROWS = 64 * 1024;
+
+    size_t parallelism = 0; /**< Worker threads; 0 = MorselScheduler::default_parallelism() */
+    uint64_t morsel_rows = DEFAULT_MORSEL_ROWS; /**< Rounded up to whole chunks */
+};
+
+/**
+ * @brief Splits a ColumnarTable into morsels and runs a pipeline over each on
+ * a WorkStealingPool
+ *
+ * The pipeline is given as a factory that stacks operators (filter, project,
+ * ...) on a scan of one morsel; it is instantiated once per morsel, so filter
+ * predicates are still pushed into every scan. Morsels end on chunk
+ * boundaries, so zone-map skipping and zero-copy reads work as in a serial
+ * scan. Pipelines are built under the MemoryTracker current when the
+ * scheduler was made, so workers charge the query that owns them.
+ */
+class MorselScheduler {
+   public:
+    using PipelineFactory = std::function<std::unique_ptr<VectorizedOperator>(
+        std::unique_ptr<VectorizedSeqScanOperator> scan)>;
+
+    /** Receives every output batch; one worker's batches arrive in order on its thread */
+    using BatchSink = std::function<void(size_t worker, VectorBatch& batch)>;
+
+    /** @param pool Pool to run on; nullptr uses WorkStealingPool::shared() */
+    MorselScheduler(std::string table_name, std::shared_ptr<storage::ColumnarTable> table,
+                    MorselOptions options = {}, WorkStealingPool* pool = nullptr);
+
+    /** @brief Sets the parallelism of queries that do not choose their own (0 = all cores) */
+    static void set_default_parallelism(size_t parallelism);
+    [[nodiscard]] static size_t default_parallelism();
+
+    /** @return Number of workers the pipelines run on */
+    [[nodiscard]] size_t parallelism() const;
+    [[nodiscard]] const std::vector<Morsel>& morsels() const { return morsels_; }
+    [[nodiscard]] const std::string& table_name() const { return table_name_; }
+
+    /**
+     * @brief Runs the pipeline over every morsel and hands its output to `sink`
+     * @return false if a pipeline failed; see error()
+     */
+    bool run(const PipelineFactory& pipeline, const BatchSink& sink);
+
+    /**
+     * @brief Aggregates the pipeline's output: one partial AggregateHashTable
+     * per worker, merged once every morsel is done
+     * @return The merged table, or nullptr if a pipeline failed
+     */
+    std::unique_ptr<AggregateHashTable> aggregate(
+        const PipelineFactory& pipeline, const std::vector<size_t>& group_by,
+        const std::vector<VectorizedAggregateInfo>& aggs);
+
+    [[nodiscard]] const std::string& error() const { return error_; }
+
+    /** @return Zone-map counters summed over every morsel scan of the last run */
+    [[nodiscard]] const ScanStats& scan_stats() const { return stats_; }
+
+   private:
+    std::string table_name_;
+    std::shared_ptr<storage::ColumnarTable> table_;
+    MorselOptions options_;
+    WorkStealingPool* pool_;
+    common::MemoryTracker* memory_; /**< Parent of the workers' operator trackers */
+    std::vector<Morsel> morsels_;
+    std::string error_;
+    ScanStats stats_;
+    std::mutex result_mutex_; /**< Guards error_ and stats_ while workers run */
+
+    static std::atomic<size_t> default_parallelism_;
+
+    std::unique_ptr<VectorizedOperator> instantiate(const PipelineFactory& pipeline,
+                                                    const Morsel& morsel) const;
+    void record_error(const std::string& message);
+    bool execute(const PipelineFactory& pipeline, const BatchSink& sink, bool selected);
+};
+
+/**
+ * @brief GROUP BY over a morsel-parallel pipeline
+ *
+ * The first next_batch() runs MorselScheduler::aggregate(); the merged groups
+ * are then emitted like VectorizedHashAggregateOperator does.
+ */
+class ParallelHashAggregateOperator : public VectorizedOperator {
+   private:
+    static constexpr size_t EMIT_BATCH_SIZE = 1024;
+
+    MorselScheduler scheduler_;
+    MorselScheduler::PipelineFactory pipeline_;
+    std::vector<size_t> group_by_;
+    std::vector<VectorizedAggregateInfo> aggregates_;
+    std::unique_ptr<AggregateHashTable> table_;
+    size_t next_group_ = 0;
+
+   public:
+    ParallelHashAggregateOperator(std::string table_name,
+                                  std::shared_ptr<storage::ColumnarTable> table,
+                                  MorselScheduler::PipelineFactory pipeline,
+                                  std::vector<size_t> group_by, Schema out_schema,
+                                  std::vector<VectorizedAggregateInfo> aggregates,
+                                  MorselOptions options = {})
+        : VectorizedOperator(std::move(out_schema)),
+          scheduler_(std::move(table_name), std::move(table), options),
+          pipeline_(std::move(pipeline)),
+          group_by_(std::move(group_by)),
+          aggregates_(std::move(aggregates)) {}
+
+    [[nodiscard]] const MorselScheduler& scheduler() const { return scheduler_; }
+
+    void collect_scan_stats(ScanStats& stats) const override {
+        stats.chunks_scanned += scheduler_.scan_stats().chunks_scanned;
+        stats.chunks_skipped += scheduler_.scan_stats().chunks_skipped;
+    }
+
+    /** Worker pipelines are built on the pool's threads, so they carry no statistics */
+    void explain(ExplainNode& node) const override {
+        node.label = "Parallel HashAggregate on " + scheduler_.table_name();
+        node.stats = stats();
+        node.details.push_back("Workers: " + std::to_string(scheduler_.parallelism()) +
+                               " Morsels: " + std::to_string(scheduler_.morsels().size()));
+    }
+
+    bool next_batch_impl(VectorBatch& out_batch) override {
+        if (!table_) {
+            table_ = scheduler_.aggregate(pipeline_, group_by_, aggregates_);
+            if (!table_) {
+                set_error(scheduler_.error());
+                return false;
+            }
+            track_memory(table_->memory_bytes(), "Parallel HashAggregate");
+        }
+        if (next_group_ >= table_->group_count()) return false;
+
+        if (out_batch.column_count() == 0) {
+            out_batch.init_from_schema(output_schema_);
+        }
+        try {
+            table_->emit(next_group_, EMIT_BATCH_SIZE, out_batch);
+        } catch (const std::runtime_error& e) {
+            set_error(e.what());
+            return false;
+        }
+        next_group_ += out_batch.row_count();
+        return true;
+    }
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_MORSEL_SCHEDULER_HPP
@@ -6,16 +6,34 @@
 #ifndef CLOUDSQL_EXECUTOR_OPERATOR_HPP
 #define CLOUDSQL_EXECUTOR_OPERATOR_HPP
 
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
-#include <unordered_map>
+#include <thread>
 #include <vector>
 
+#include "common/memory_tracker.hpp"
+#include "executor/compiled_expression.hpp"
+#include "executor/explain.hpp"
+#include "executor/group_key_table.hpp"
+#include "executor/parallel_scan.hpp"
+#include "executor/runtime_filter.hpp"
+#include "executor/spill_file.hpp"
 #include "executor/types.hpp"
+#include "executor/vectorized_operator.hpp"
 #include "parser/expression.hpp"
+#include "storage/brin_index.hpp"
 #include "storage/btree_index.hpp"
 #include "storage/heap_table.hpp"
+#include "storage/index.hpp"
 #include "transaction/lock_manager.hpp"
 #include "transaction/transaction.hpp"
 
@@ -39,7 +57,10 @@ enum class OperatorType : uint8_t {
     Limit,
     Materialize,
     Result,
-    BufferScan
+    BufferScan,
+    ExchangeScan,
+    BitmapHeapScan,
+    Gather
 };
 
 /**
@@ -52,11 +73,17 @@ class Operator {
     std::string error_message_;
     Transaction* txn_;
     LockManager* lock_manager_;
+    std::unique_ptr<OperatorStats> stats_; /**< Kept when built inside an InstrumentScope */
+    std::unique_ptr<common::MemoryTracker> memory_; /**< Made inside a MemoryTracker::Scope */
 
    public:
     explicit Operator(OperatorType type, Transaction* txn = nullptr,
                       LockManager* lock_manager = nullptr)
-        : type_(type), txn_(txn), lock_manager_(lock_manager) {}
+        : type_(type),
+          txn_(txn),
+          lock_manager_(lock_manager),
+          stats_(InstrumentScope::make_stats()),
+          memory_(common::MemoryTracker::make_child("operator")) {}
     virtual ~Operator() = default;
 
     // Disable copy/move for base operator
@@ -72,17 +99,54 @@ class Operator {
     [[nodiscard]] LockManager* get_lock_manager() const { return lock_manager_; }
 
     virtual bool init() { return true; }
-    virtual bool open() { return true; }
-    virtual bool next(Tuple& out_tuple) {
-        (void)out_tuple;
-        state_ = ExecState::Done;
-        return false;
+
+    /** @brief Starts (or restarts) the operator; see open_impl() */
+    bool open() {
+        if (!stats_) return open_impl();
+        const StatsTimer timer(*stats_);
+        stats_->loops++;
+        return open_impl();
     }
+
+    /** @brief Produces the next row; see next_impl() */
+    bool next(Tuple& out_tuple) {
+        if (!stats_) return next_impl(out_tuple);
+        const StatsTimer timer(*stats_);
+        if (!next_impl(out_tuple)) return false;
+        stats_->rows++;
+        return true;
+    }
+
     virtual void close() {}
 
     [[nodiscard]] virtual Schema& output_schema() = 0;
 
+    /** @return What EXPLAIN ANALYZE measured, or null outside an InstrumentScope */
+    [[nodiscard]] const OperatorStats* stats() const { return stats_.get(); }
+
+    /** @return The tracker this operator charges, or null when built outside a query's scope */
+    [[nodiscard]] const common::MemoryTracker* memory_tracker() const { return memory_.get(); }
+
+    /** @brief Describes this operator and, recursively, its children into `node` */
+    virtual void explain(ExplainNode& node) const;
+
     virtual void add_child(std::unique_ptr<Operator> child) { (void)child; }
+
+    /**
+     * @brief Offers a join's runtime filter on output column `column` to the
+     * scan that produces it
+     *
+     * Operators that pass the column through unchanged forward the offer; a
+     * scan that takes it may drop rows whose value the filter rules out.
+     * Offered before the first next() after open().
+     * @return true if a scan took the filter
+     */
+    virtual bool push_runtime_filter(std::shared_ptr<const RuntimeFilter> filter, size_t column) {
+        static_cast<void>(filter);
+        static_cast<void>(column);
+        return false;
+    }
+
     [[nodiscard]] virtual const std::vector<std::unique_ptr<Operator>>& children() const {
         static const std::vector<std::unique_ptr<Operator>> empty;
         return empty;
@@ -92,11 +156,36 @@ class Operator {
     [[nodiscard]] bool has_error() const { return state_ == ExecState::Error; }
 
    protected:
+    /* What open() and next() do; they wrap these to keep stats() */
+    virtual bool open_impl() { return true; }
+    virtual bool next_impl(Tuple& out_tuple) {
+        (void)out_tuple;
+        state_ = ExecState::Done;
+        return false;
+    }
+
     void set_state(ExecState s) { state_ = s; }
     void set_error(std::string msg) {
         error_message_ = std::move(msg);
         state_ = ExecState::Error;
     }
+
+    /**
+     * @brief Moves the memory this operator holds to `bytes`
+     * @return false, keeping the previous charge, if the query's limits refuse
+     * it; an operator that can spill then should
+     */
+    [[nodiscard]] bool try_track_memory(size_t bytes) {
+        return !memory_ || memory_->try_resize(bytes);
+    }
+
+    /**
+     * @brief Moves the memory this operator holds to `bytes`
+     * @throws common::MemoryLimitError naming `consumer` if the query's limits refuse it
+     */
+    void track_memory(size_t bytes, const std::string& consumer) {
+        if (memory_) memory_->resize(bytes, consumer);
+    }
 };
 
 /**
@@ -104,21 +193,107 @@ class Operator {
  */
 class SeqScanOperator : public Operator {
    private:
+    /** @brief A runtime filter taken from a join, and the column it tests */
+    struct ColumnFilter {
+        std::shared_ptr<const RuntimeFilter> filter;
+        size_t column;
+    };
+
     std::string table_name_;
     std::unique_ptr<storage::HeapTable> table_;
     std::unique_ptr<storage::HeapTable::Iterator> iterator_;
+    storage::HeapTable::TupleMeta meta_; /**< Decode buffer of the iterator */
     Schema schema_;
+    std::vector<ColumnFilter> runtime_filters_;
+    uint64_t filtered_rows_ = 0;
+    std::shared_ptr<ParallelHeapScan> parallel_; /**< Ranges shared with other workers, if any */
+
+    /** @brief Moves the iterator to the next range claimed from parallel_ */
+    bool claim_range();
 
    public:
     explicit SeqScanOperator(std::unique_ptr<storage::HeapTable> table, Transaction* txn = nullptr,
                              LockManager* lock_manager = nullptr);
 
+    /**
+     * @brief Reads only the page ranges claimed from `scan`, as one worker of
+     * a parallel plan; the GatherOperator above resets it
+     */
+    void set_parallel_scan(std::shared_ptr<ParallelHeapScan> scan) { parallel_ = std::move(scan); }
+
     bool init() override;
-    bool open() override;
-    bool next(Tuple& out_tuple) override;
+    bool open_impl() override;
+    bool next_impl(Tuple& out_tuple) override;
     void close() override;
     [[nodiscard]] Schema& output_schema() override;
+    void explain(ExplainNode& node) const override;
+    bool push_runtime_filter(std::shared_ptr<const RuntimeFilter> filter, size_t column) override;
     [[nodiscard]] const std::string& table_name() const { return table_name_; }
+
+    /** @return Visible rows the runtime filters dropped since open() */
+    [[nodiscard]] uint64_t filtered_rows() const { return filtered_rows_; }
+};
+
+/**
+ * @brief Runs copies of a pipeline on worker threads and returns all their rows
+ *
+ * Every worker pipeline reads its own share of a heap through one
+ * ParallelHeapScan, e.g. scan, filter and partial aggregate. The first next()
+ * starts one thread per worker; they hand their rows over in chunks through a
+ * bounded queue, so a slow parent holds the workers back rather than the rows
+ * piling up. Rows of one worker keep their order; those of different workers
+ * interleave. The workers have threads of their own rather than the shared
+ * WorkStealingPool, which runs one loop at a time, so a gather waiting on its
+ * parent never holds up another query's loop.
+ *
+ * A worker's error or exception ends the gather with it once the rows before
+ * it are returned; close() stops the workers early, e.g. under a LIMIT.
+ * EXPLAIN shows the pipeline of the first worker.
+ */
+class GatherOperator : public Operator {
+   public:
+    static constexpr size_t CHUNK_ROWS = 256;       /**< Rows handed over at once */
+    static constexpr size_t CHUNKS_PER_WORKER = 4; /**< Queue bound, per worker */
+
+    GatherOperator(std::vector<std::unique_ptr<Operator>> workers,
+                   std::shared_ptr<ParallelHeapScan> scan);
+    ~GatherOperator() override;
+
+    GatherOperator(const GatherOperator&) = delete;
+    GatherOperator& operator=(const GatherOperator&) = delete;
+    GatherOperator(GatherOperator&&) = delete;
+    GatherOperator& operator=(GatherOperator&&) = delete;
+
+    [[nodiscard]] size_t worker_count() const { return workers_.size(); }
+
+    bool init() override;
+    bool open_impl() override;
+    bool next_impl(Tuple& out_tuple) override;
+    void close() override;
+    [[nodiscard]] Schema& output_schema() override;
+    void explain(ExplainNode& node) const override;
+
+   private:
+    void run_worker(size_t worker);
+    void stop_workers();
+    /** @return false if the gather was stopped while the queue was full */
+    bool push_chunk(std::vector<Tuple>& chunk);
+
+    std::vector<std::unique_ptr<Operator>> workers_;
+    std::shared_ptr<ParallelHeapScan> scan_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable ready_cv_; /**< A chunk arrived or a worker finished */
+    std::condition_variable space_cv_; /**< The queue has room or the gather stopped */
+    std::deque<std::vector<Tuple>> queue_;
+    size_t running_ = 0;
+    bool stopping_ = false;
+    std::string worker_error_;
+    std::exception_ptr worker_exception_;
+
+    std::vector<Tuple> chunk_; /**< Being returned; only touched by the parent */
+    size_t chunk_pos_ = 0;
 };
 
 /**
@@ -137,39 +312,130 @@ class BufferScanOperator : public Operator {
                        Schema schema);
 
     bool init() override { return true; }
-    bool open() override {
+    bool open_impl() override {
         current_index_ = 0;
         return true;
     }
-    bool next(Tuple& out_tuple) override;
+    bool next_impl(Tuple& out_tuple) override;
     void close() override {}
     [[nodiscard]] Schema& output_schema() override;
+    void explain(ExplainNode& node) const override;
 };
 
 /**
- * @brief Index scan operator (point lookup)
+ * @brief Exchange scan operator: rows of a shuffle stream, returned while it is still arriving
+ *
+ * Pulls one chunk at a time from `source`, so whatever consumes the rows (a
+ * hash join build, typically) runs alongside the senders instead of after
+ * the whole shuffle. A stream that fails throws from next().
+ */
+class ExchangeScanOperator : public Operator {
+   public:
+    /**
+     * Fills `chunk` with the next rows and returns true; returns false at the
+     * end of the stream, with `error` set if the stream did not complete
+     */
+    using Source = std::function<bool(std::vector<Tuple>& chunk, std::string& error)>;
+
+   private:
+    std::string table_name_;
+    Source source_;
+    std::vector<Tuple> chunk_;
+    size_t current_index_ = 0;
+    Schema schema_;
+
+   public:
+    ExchangeScanOperator(std::string table_name, Source source, Schema schema);
+
+    bool next_impl(Tuple& out_tuple) override;
+    [[nodiscard]] Schema& output_schema() override;
+    void explain(ExplainNode& node) const override;
+};
+
+/**
+ * @brief Key range and output shape of an IndexScanOperator
+ */
+struct IndexScanOptions {
+    std::optional<storage::BTreeIndex::Bound> lower; /**< Absent: from the first key */
+    std::optional<storage::BTreeIndex::Bound> upper; /**< Absent: to the last key, NULLs included */
+
+    /**
+     * Build rows from the index key alone, reading only the record header for
+     * visibility; every column but `key_column` is NULL
+     */
+    bool key_only = false;
+    size_t key_column = 0; /**< Position of the key in the table schema */
+};
+
+/**
+ * @brief Index scan operator (point lookup or key range, in key order)
+ *
+ * An unordered index (HashIndex) answers point lookups only: `lower` must be
+ * the inclusive bound equal to `upper`.
  */
 class IndexScanOperator : public Operator {
    private:
     std::string table_name_;
     std::string index_name_;
     std::unique_ptr<storage::HeapTable> table_;
-    std::unique_ptr<storage::BTreeIndex> index_;
-    common::Value search_key_;
-    std::vector<storage::HeapTable::TupleId> matching_ids_;
-    size_t current_match_index_ = 0;
+    std::unique_ptr<storage::Index> index_;
+    IndexScanOptions options_;
+    std::optional<storage::BTreeIndex::Iterator> iterator_; /**< Ordered index */
+    std::vector<storage::HeapTable::TupleId> matches_;      /**< Unordered index lookup */
+    size_t next_match_ = 0;
+    storage::HeapTable::TupleMeta meta_; /**< Decode buffer for heap records */
     Schema schema_;
 
+    bool next_entry(storage::Index::Entry& entry);
+
    public:
+    /** @brief Point lookup of `search_key` */
     IndexScanOperator(std::unique_ptr<storage::HeapTable> table,
-                      std::unique_ptr<storage::BTreeIndex> index, common::Value search_key,
+                      std::unique_ptr<storage::Index> index, common::Value search_key,
+                      Transaction* txn = nullptr, LockManager* lock_manager = nullptr);
+    IndexScanOperator(std::unique_ptr<storage::HeapTable> table,
+                      std::unique_ptr<storage::Index> index, IndexScanOptions options,
                       Transaction* txn = nullptr, LockManager* lock_manager = nullptr);
 
     bool init() override;
-    bool open() override;
-    bool next(Tuple& out_tuple) override;
+    bool open_impl() override;
+    bool next_impl(Tuple& out_tuple) override;
     void close() override;
     [[nodiscard]] Schema& output_schema() override;
+    void explain(ExplainNode& node) const override;
+};
+
+/**
+ * @brief Bitmap heap scan: reads only the heap pages a BRIN index selects
+ *
+ * Every visible row of those pages is returned, inside the key range or not;
+ * the planner keeps the WHERE clause above the scan to recheck them.
+ */
+class BitmapHeapScanOperator : public Operator {
+   private:
+    std::string table_name_;
+    std::unique_ptr<storage::HeapTable> table_;
+    std::unique_ptr<storage::BrinIndex> index_;
+    std::optional<storage::BTreeIndex::Bound> lower_;
+    std::optional<storage::BTreeIndex::Bound> upper_;
+    std::unique_ptr<storage::HeapTable::Iterator> iterator_;
+    size_t ranges_selected_ = 0; /**< Page ranges of the last open(), for EXPLAIN ANALYZE */
+    storage::HeapTable::TupleMeta meta_;
+    Schema schema_;
+
+   public:
+    BitmapHeapScanOperator(std::unique_ptr<storage::HeapTable> table,
+                           std::unique_ptr<storage::BrinIndex> index,
+                           std::optional<storage::BTreeIndex::Bound> lower,
+                           std::optional<storage::BTreeIndex::Bound> upper,
+                           Transaction* txn = nullptr, LockManager* lock_manager = nullptr);
+
+    bool init() override;
+    bool open_impl() override;
+    bool next_impl(Tuple& out_tuple) override;
+    void close() override;
+    [[nodiscard]] Schema& output_schema() override;
+    void explain(ExplainNode& node) const override;
 };
 
 /**
@@ -179,17 +445,20 @@ class FilterOperator : public Operator {
    private:
     std::unique_ptr<Operator> child_;
     std::unique_ptr<parser::Expression> condition_;
+    std::unique_ptr<CompiledExpression> compiled_; /**< condition_ bound to schema_ */
     Schema schema_;
 
    public:
     FilterOperator(std::unique_ptr<Operator> child, std::unique_ptr<parser::Expression> condition);
 
     bool init() override;
-    bool open() override;
-    bool next(Tuple& out_tuple) override;
+    bool open_impl() override;
+    bool next_impl(Tuple& out_tuple) override;
     void close() override;
     [[nodiscard]] Schema& output_schema() override;
+    void explain(ExplainNode& node) const override;
     void add_child(std::unique_ptr<Operator> child) override;
+    bool push_runtime_filter(std::shared_ptr<const RuntimeFilter> filter, size_t column) override;
 };
 
 /**
@@ -199,6 +468,8 @@ class ProjectOperator : public Operator {
    private:
     std::unique_ptr<Operator> child_;
     std::vector<std::unique_ptr<parser::Expression>> columns_;
+    std::vector<CompiledExpression> compiled_; /**< columns_ bound to the child's schema */
+    Tuple input_;                              /**< Child row, reused across next() calls */
     Schema schema_;
 
    public:
@@ -206,35 +477,106 @@ class ProjectOperator : public Operator {
                     std::vector<std::unique_ptr<parser::Expression>> columns);
 
     bool init() override;
-    bool open() override;
-    bool next(Tuple& out_tuple) override;
+    bool open_impl() override;
+    bool next_impl(Tuple& out_tuple) override;
     void close() override;
     [[nodiscard]] Schema& output_schema() override;
+    void explain(ExplainNode& node) const override;
     void add_child(std::unique_ptr<Operator> child) override;
 };
 
 /**
- * @brief Sort operator (ORDER BY)
+ * @brief Sort operator configuration
+ */
+struct SortOptions {
+    size_t limit = 0;         /**< Only the first `limit` rows are needed; 0 = all */
+    size_t memory_budget = 0; /**< Bytes of rows held in memory; 0 = default_memory_budget() */
+    std::string spill_dir;    /**< Directory for sorted runs; empty = system temp directory */
+};
+
+/**
+ * @brief Sort operator
+ *
+ * Every row's sort key is encoded once into a byte string whose memcmp order
+ * is the ORDER BY order (see encode_sort_key()), and rows are compared on
+ * those strings alone. Rows with equal keys keep their input order.
+ *
+ * With a limit, only the first `limit` rows are kept, in a bounded heap. Without
+ * one, rows are buffered until they exceed the memory budget; the buffer is then
+ * sorted and written to a temporary run file, and once the input is exhausted
+ * the runs are k-way merged (in several passes if there are more than
+ * MERGE_FANIN of them).
  */
 class SortOperator : public Operator {
+   public:
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = static_cast<size_t>(256) * 1024 * 1024;
+    static constexpr size_t MERGE_FANIN = 64;
+
    private:
+    struct SortRow {
+        std::string key;
+        Tuple tuple;
+    };
+
+    /* One sorted run being merged: the file and its current row */
+    struct MergeInput {
+        std::unique_ptr<SpillFile> file;
+        SortRow row;
+    };
+
     std::unique_ptr<Operator> child_;
     std::vector<std::unique_ptr<parser::Expression>> sort_keys_;
     std::vector<bool> ascending_;
-    std::vector<Tuple> sorted_tuples_;
+    std::vector<CompiledExpression> compiled_keys_; /**< sort_keys_ bound to schema_ */
+    SortOptions options_;
+    std::vector<SortRow> sorted_rows_;
     size_t current_index_ = 0;
     Schema schema_;
 
+    /* External sort: runs on disk, then the inputs of the final merge */
+    std::vector<std::unique_ptr<SpillFile>> runs_;
+    std::vector<MergeInput> merge_inputs_;
+    std::vector<size_t> merge_heap_; /**< Indices into merge_inputs_, smallest row first */
+    size_t spilled_runs_ = 0;
+
+    static std::atomic<size_t> default_memory_budget_;
+
+    [[nodiscard]] std::string make_key(const Tuple& tuple) const;
+    void collect_top_n();
+    void collect_all();
+    void spill_run();
+    void merge_pass();
+    void start_merge(std::vector<std::unique_ptr<SpillFile>> runs);
+    bool pop_merged(SortRow& row);
+    [[nodiscard]] bool merge_before(size_t a, size_t b) const;
+
    public:
     SortOperator(std::unique_ptr<Operator> child,
                  std::vector<std::unique_ptr<parser::Expression>> sort_keys,
-                 std::vector<bool> ascending);
+                 std::vector<bool> ascending, SortOptions options = {});
+
+    /** @brief Sets the budget of sorts that do not choose their own */
+    static void set_default_memory_budget(size_t bytes);
+    [[nodiscard]] static size_t default_memory_budget();
+
+    /**
+     * @brief Appends the memcmp-comparable encoding of one sort key value
+     *
+     * Numbers of every type sort by value (as Value::operator< compares them),
+     * strings bytewise, and NULLs after everything else; a descending key is
+     * the bitwise complement of its ascending encoding.
+     */
+    static void encode_sort_key(const common::Value& value, bool ascending, std::string& out);
+
+    /** @return Sorted runs written to disk by the last open() */
+    [[nodiscard]] size_t spilled_runs() const { return spilled_runs_; }
 
     bool init() override;
-    bool open() override;
-    bool next(Tuple& out_tuple) override;
+    bool open_impl() override;
+    bool next_impl(Tuple& out_tuple) override;
     void close() override;
     [[nodiscard]] Schema& output_schema() override;
+    void explain(ExplainNode& node) const override;
 };
 
 /**
@@ -247,77 +589,311 @@ struct AggregateInfo {
     bool is_distinct = false;
 };
 
+/**
+ * @brief What an AggregateOperator reads and returns
+ *
+ * A parallel plan aggregates each worker's rows in Partial mode and merges the
+ * workers' groups in Final mode. A partial row holds the GROUP BY values, then
+ * one state column per aggregate: the count, sum, minimum or maximum, and for
+ * AVG its sum followed by its count. DISTINCT aggregates do not split.
+ */
+enum class AggregateMode : uint8_t {
+    Complete, /**< Rows in, finished aggregates out */
+    Partial,  /**< Rows in, partial states out */
+    Final     /**< Partial rows in, finished aggregates out */
+};
+
+/**
+ * @brief AggregateOperator configuration
+ */
+struct AggregateOptions {
+    size_t memory_budget = 0; /**< Bytes of group state held in memory; 0 = default */
+    std::string spill_dir;    /**< Directory for spilled rows; empty = system temp directory */
+    bool input_grouped = false; /**< Rows of each group arrive together (e.g. from an index) */
+    AggregateMode mode = AggregateMode::Complete;
+};
+
 /**
  * @brief Aggregate operator (GROUP BY)
+ *
+ * Groups are found in a GroupKeyTable keyed on the encoded GROUP BY values;
+ * DISTINCT arguments are tracked in one such table per aggregate, keyed on
+ * the group id and the encoded argument. Groups come out ordered by the text
+ * of their keys.
+ *
+ * Past the memory budget no new groups are created: rows of groups already in
+ * memory keep being aggregated, while the others are written, already
+ * evaluated, to one of SPILL_PARTITIONS files by key hash. Each file is then
+ * aggregated on its own after the in-memory groups have been emitted (and
+ * partitioned again on further hash bits if it still does not fit), so a
+ * spilled aggregation orders its groups only within each partition.
+ *
+ * With input_grouped, groups are aggregated and emitted one at a time as the
+ * input streams by, without a hash table, in input order.
  */
 class AggregateOperator : public Operator {
+   public:
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = static_cast<size_t>(256) * 1024 * 1024;
+    static constexpr size_t SPILL_PARTITIONS = 16;
+
    private:
+    struct GroupState {
+        std::vector<common::Value> group_values;
+        std::vector<int64_t> counts;
+        std::vector<double> sums;
+        std::vector<common::Value> mins;
+        std::vector<common::Value> maxes;
+    };
+
+    /* Rows spilled by one pass, aggregated by a later one */
+    struct SpilledPartition {
+        std::unique_ptr<SpillFile> file;
+        unsigned level; /**< Partitioning passes the rows went through */
+    };
+
     std::unique_ptr<Operator> child_;
     std::vector<std::unique_ptr<parser::Expression>> group_by_;
     std::vector<AggregateInfo> aggregates_;
+    AggregateOptions options_;
     std::vector<Tuple> groups_;
     size_t current_group_ = 0;
     Schema schema_;
 
+    /* GROUP BY values and aggregate arguments bound to the child's schema */
+    std::vector<std::unique_ptr<CompiledExpression>> compiled_group_by_;
+    std::vector<std::unique_ptr<CompiledExpression>> compiled_args_;
+
+    /* State of the pass being aggregated */
+    GroupKeyTable group_table_;
+    std::vector<GroupState> group_states_;
+    std::vector<GroupKeyTable> distinct_seen_; /**< Per aggregate; used by DISTINCT ones */
+    size_t memory_used_ = 0; /**< Estimated bytes of group_states_ */
+    unsigned pass_level_ = 0;
+    std::vector<std::unique_ptr<SpillFile>> pass_spill_; /**< Non-empty once the pass spills */
+    std::vector<SpilledPartition> pending_;
+    size_t spilled_partitions_ = 0;
+
+    /* Scratch for one input row: GROUP BY values, then one argument per aggregate */
+    Tuple inputs_;
+    std::string key_;
+
+    /* Streaming (input_grouped) state */
+    std::string stream_key_;
+    bool stream_has_group_ = false;
+    bool stream_done_ = false;
+
+    static std::atomic<size_t> default_memory_budget_;
+
+    [[nodiscard]] size_t budget() const;
+    [[nodiscard]] bool streaming() const { return options_.input_grouped && !group_by_.empty(); }
+    [[nodiscard]] size_t pass_memory() const;
+    void evaluate_row(const Tuple& tuple);
+    void encode_group_key(const Tuple& inputs);
+    void reset_pass();
+    uint32_t add_group(uint64_t hash, const Tuple& inputs);
+    /** @return Whether a DISTINCT set took a new value */
+    bool accumulate(uint32_t group, const Tuple& inputs);
+    void merge_partial(GroupState& state, const Tuple& inputs) const;
+    void aggregate_row(const Tuple& inputs);
+    void finish_pass();
+    [[nodiscard]] Tuple finish_group(GroupState& state) const;
+    bool run_pending_pass();
+    bool next_streaming(Tuple& out_tuple);
+
    public:
     AggregateOperator(std::unique_ptr<Operator> child,
                       std::vector<std::unique_ptr<parser::Expression>> group_by,
-                      std::vector<AggregateInfo> aggregates);
+                      std::vector<AggregateInfo> aggregates, AggregateOptions options = {});
+
+    /** @brief Sets the budget of aggregations that do not choose their own */
+    static void set_default_memory_budget(size_t bytes);
+    [[nodiscard]] static size_t default_memory_budget();
+
+    /** @return Partition files written since the last open() */
+    [[nodiscard]] size_t spilled_partitions() const { return spilled_partitions_; }
+
+    bool init() override;
+    bool open_impl() override;
+    bool next_impl(Tuple& out_tuple) override;
+    void close() override;
+    [[nodiscard]] Schema& output_schema() override;
+    void explain(ExplainNode& node) const override;
+};
+
+/**
+ * @brief Runs a vectorized aggregation pipeline and returns its groups as rows
+ *
+ * The planner puts it in place of AggregateOperator when the input can be
+ * scanned batch-at-a-time. The rows match AggregateOperator's: groups ordered
+ * by the text of their keys, and SUM is 0 rather than NULL over no input.
+ */
+class BatchAggregateOperator : public Operator {
+   private:
+    std::unique_ptr<VectorizedOperator> pipeline_;
+    std::vector<AggregateType> aggregate_types_;
+    std::vector<Tuple> groups_;
+    size_t current_group_ = 0;
+    Schema schema_;
+
+   public:
+    /**
+     * @param pipeline Emits the group keys followed by one column per aggregate
+     * @param schema Row schema to present, as AggregateOperator would build it
+     */
+    BatchAggregateOperator(std::unique_ptr<VectorizedOperator> pipeline, Schema schema,
+                           std::vector<AggregateType> aggregate_types,
+                           Transaction* txn = nullptr);
 
     bool init() override;
-    bool open() override;
-    bool next(Tuple& out_tuple) override;
+    bool open_impl() override;
+    bool next_impl(Tuple& out_tuple) override;
     void close() override;
     [[nodiscard]] Schema& output_schema() override;
+    void explain(ExplainNode& node) const override;
 };
 
 /**
  * @brief Hash join operator
+ *
+ * The build (right) side is kept in a flat table: rows live in one vector per
+ * partition and are chained per bucket on the hash of their normalized key
+ * (integers and integral floats as INT64, other floats as FLOAT64, strings as
+ * TEXT), so keys are matched with Value equality instead of being formatted.
+ * NULL keys never match.
+ *
+ * Rows are hashed into SPILL_PARTITIONS partitions. While the build side fits
+ * in the memory budget every partition stays in memory. Past the budget the
+ * largest partitions are written to temporary files, and probe rows that hash
+ * to a spilled partition follow them; once the in-memory partitions are
+ * joined, each spilled partition is loaded and joined in turn (a hybrid hash
+ * join). A spilled partition is loaded whole, so a single key whose rows
+ * exceed the budget still joins, just over budget.
+ *
+ * With `build_left` the left child is built and the right one probes, for
+ * when the left input is the smaller; output columns stay left then right.
+ *
+ * When no probe row without a match is output (inner and right joins), a
+ * RuntimeFilter of the build keys is offered to the scan under the probe key
+ * once the build side is in memory, so probe rows that cannot match are
+ * dropped where they are read. A build side that spilled has no filter.
  */
 class HashJoinOperator : public Operator {
    public:
     using JoinType = cloudsql::executor::JoinType;
 
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = static_cast<size_t>(256) * 1024 * 1024;
+    static constexpr size_t SPILL_PARTITIONS = 16;
+
    private:
-    struct BuildTuple {
+    static constexpr uint32_t NO_MATCH = UINT32_MAX;
+
+    struct BuildEntry {
         Tuple tuple;
+        common::Value key; /**< Normalized join key */
+        uint64_t hash;
+        uint32_t next; /**< Next entry of the same bucket + 1; 0 = end */
         bool matched = false;
     };
 
+    /* One partition of the build side */
+    struct BuildTable {
+        std::vector<BuildEntry> entries;
+        std::vector<uint32_t> heads; /**< Per bucket: first entry + 1; 0 = empty */
+        size_t bytes = 0;            /**< Estimated memory held by the entries */
+        bool spilled = false;
+
+        void insert(Tuple tuple, common::Value key, uint64_t hash);
+        [[nodiscard]] uint32_t find(const common::Value& key, uint64_t hash, uint32_t link) const;
+        [[nodiscard]] uint32_t first_match(const common::Value& key, uint64_t hash) const;
+        [[nodiscard]] uint32_t next_match(uint32_t entry) const;
+        void clear();
+    };
+
     std::unique_ptr<Operator> left_;
     std::unique_ptr<Operator> right_;
     std::unique_ptr<parser::Expression> left_key_;
     std::unique_ptr<parser::Expression> right_key_;
-    JoinType join_type_;
+    JoinType join_type_; /**< In terms of the probe (left_) and build (right_) sides */
     Schema schema_;
-
-    /* In-memory hash table for the right side */
-    std::unordered_multimap<std::string, BuildTuple> hash_table_;
+    size_t memory_budget_;
+    bool build_left_; /**< Children were swapped: output columns are build, then probe */
+
+    /* Keys bound to the children's schemas by open() */
+    std::unique_ptr<CompiledExpression> left_key_compiled_;
+    std::unique_ptr<CompiledExpression> right_key_compiled_;
+
+    /* Build side: in-memory partitions and the temp files of spilled ones */
+    std::vector<BuildTable> partitions_;
+    std::vector<std::unique_ptr<SpillFile>> build_spill_;
+    std::vector<std::unique_ptr<SpillFile>> probe_spill_;
+    size_t memory_used_ = 0;
+    size_t spilled_partitions_ = 0;
+
+    /* Spilled partition being joined, once the in-memory ones are done */
+    bool replaying_ = false;
+    size_t replay_partition_ = 0;
+    size_t next_spilled_ = 0;
+    BuildTable replay_table_;
 
     /* Probe phase state */
     std::optional<Tuple> left_tuple_;
     bool left_had_match_ = false;
-    struct MatchIterator {
-        std::unordered_multimap<std::string, BuildTuple>::iterator current;
-        std::unordered_multimap<std::string, BuildTuple>::iterator end;
-    };
-    std::optional<MatchIterator> match_iter_;
+    BuildTable* probe_table_ = nullptr;
+    uint32_t match_ = NO_MATCH;
+    bool probe_done_ = false;
 
     /* Final phase for RIGHT/FULL joins */
-    std::optional<std::unordered_multimap<std::string, BuildTuple>::iterator> right_idx_iter_;
+    size_t unmatched_table_ = 0;
+    size_t unmatched_entry_ = 0;
+
+    /* Keys of the build side, pushed into the probe side's scan by the last open() */
+    std::shared_ptr<const RuntimeFilter> runtime_filter_;
+
+    static std::atomic<size_t> default_memory_budget_;
+
+    [[nodiscard]] bool keeps_unmatched_build() const;
+    [[nodiscard]] bool keeps_unmatched_probe() const;
+    void spill_largest_partition();
+    bool next_probe_tuple();
+    bool next_unmatched_build(Tuple& out_tuple);
+    void join_values(Tuple& out_tuple, const Tuple* probe, const Tuple* build) const;
+    bool load_next_spilled();
+    void reset_state();
+    /** @brief Builds a filter of the build keys and offers it to the probe side */
+    void push_build_filter();
 
    public:
+    /**
+     * @param memory_budget Bytes of build rows held in memory; 0 = default_memory_budget()
+     * @param build_left Build the hash table on the left child instead of the right
+     */
     HashJoinOperator(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right,
                      std::unique_ptr<parser::Expression> left_key,
                      std::unique_ptr<parser::Expression> right_key,
-                     JoinType join_type = JoinType::Inner);
+                     JoinType join_type = JoinType::Inner, size_t memory_budget = 0,
+                     bool build_left = false);
+    ~HashJoinOperator() override;
+
+    HashJoinOperator(const HashJoinOperator&) = delete;
+    HashJoinOperator& operator=(const HashJoinOperator&) = delete;
+    HashJoinOperator(HashJoinOperator&&) = delete;
+    HashJoinOperator& operator=(HashJoinOperator&&) = delete;
+
+    /** @brief Sets the budget of joins that do not choose their own */
+    static void set_default_memory_budget(size_t bytes);
+    [[nodiscard]] static size_t default_memory_budget();
+
+    /** @return Build partitions written to disk by the last open() */
+    [[nodiscard]] size_t spilled_partitions() const { return spilled_partitions_; }
 
     bool init() override;
-    bool open() override;
-    bool next(Tuple& out_tuple) override;
+    bool open_impl() override;
+    bool next_impl(Tuple& out_tuple) override;
     void close() override;
     [[nodiscard]] Schema& output_schema() override;
+    void explain(ExplainNode& node) const override;
     void add_child(std::unique_ptr<Operator> child) override;
+    bool push_runtime_filter(std::shared_ptr<const RuntimeFilter> filter, size_t column) override;
 };
 
 /**
@@ -335,10 +911,11 @@ class LimitOperator : public Operator {
     LimitOperator(std::unique_ptr<Operator> child, int64_t limit, int64_t offset = 0);
 
     bool init() override;
-    bool open() override;
-    bool next(Tuple& out_tuple) override;
+    bool open_impl() override;
+    bool next_impl(Tuple& out_tuple) override;
     void close() override;
     [[nodiscard]] Schema& output_schema() override;
+    void explain(ExplainNode& node) const override;
     void add_child(std::unique_ptr<Operator> child) override;
 };
 
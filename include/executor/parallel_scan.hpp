@@ -0,0 +1,62 @@
+/**
+ * @file parallel_scan.hpp
+ * @brief Page ranges of one heap scan shared out among parallel workers
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_PARALLEL_SCAN_HPP
+#define CLOUDSQL_EXECUTOR_PARALLEL_SCAN_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "storage/heap_table.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief Hands out the pages of a heap to the SeqScanOperators of a parallel plan
+ *
+ * Each worker's scan claims the next range of pages whenever it finishes one,
+ * so a worker held up by I/O or by a selective filter just claims fewer
+ * ranges. The last range runs to the end of the heap, so pages added while the
+ * scan runs are read as well; every page is read by exactly one worker.
+ */
+class ParallelHeapScan {
+   public:
+    static constexpr uint32_t DEFAULT_PAGES_PER_RANGE = 32;
+    static constexpr uint32_t PAGES_PER_WORKER = 256; /**< Smallest share worth a thread */
+
+    explicit ParallelHeapScan(uint32_t page_count,
+                              uint32_t pages_per_range = DEFAULT_PAGES_PER_RANGE);
+
+    /**
+     * @brief Claims the next unread range
+     * @return false once every range is claimed
+     */
+    bool next_range(storage::HeapTable::PageRange& range);
+
+    /** @brief Starts handing out ranges from the first page again */
+    void reset() { next_.store(0, std::memory_order_relaxed); }
+
+    [[nodiscard]] uint32_t page_count() const { return page_count_; }
+
+    /** @brief Caps the workers of every parallel scan planned from now on (0 = one per core) */
+    static void set_max_workers(size_t workers);
+    [[nodiscard]] static size_t max_workers();
+
+    /** @return Workers a scan of `pages` pages is planned with: 1 when not worth splitting */
+    [[nodiscard]] static size_t plan_workers(uint32_t pages);
+
+   private:
+    uint32_t page_count_;
+    uint32_t pages_per_range_;
+    uint32_t range_count_;
+    std::atomic<uint32_t> next_{0}; /**< Index of the next range to claim */
+
+    static std::atomic<size_t> max_workers_;
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_PARALLEL_SCAN_HPP
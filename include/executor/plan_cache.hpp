@@ -0,0 +1,83 @@
+/**
+ * @file plan_cache.hpp
+ * @brief Prepared statements and the per-session cache that reuses them
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_PLAN_CACHE_HPP
+#define CLOUDSQL_EXECUTOR_PLAN_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "catalog/catalog.hpp"
+#include "common/value.hpp"
+#include "parser/statement.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief A parsed statement whose `$n` placeholders are bound before each execution
+ */
+struct PreparedStatement {
+    std::string sql;
+    std::vector<uint32_t> parameter_types; /**< Type OIDs given at prepare time; 0 = unspecified */
+    std::unique_ptr<parser::Statement> statement;
+    std::vector<std::shared_ptr<common::Value>> parameters; /**< Slot of `$n` at n - 1 */
+    uint64_t catalog_version = 0;                          /**< Catalog it was parsed against */
+
+    /**
+     * @brief Binds `values` to the placeholders; missing values bind NULL
+     *
+     * The statement is not reentrant: bind right before each execution.
+     */
+    void bind(const std::vector<common::Value>& values) const;
+};
+
+/**
+ * @brief LRU cache of prepared statements keyed by SQL text and parameter types
+ *
+ * Saves the lexer and parser on repeated statements. An entry parsed before
+ * the catalog version changed (DDL, ANALYZE) is parsed again on its next use.
+ * Entries share parameter slots with their users, so a cache belongs to one
+ * session.
+ */
+class PlanCache {
+   public:
+    static constexpr size_t DEFAULT_CAPACITY = 256;
+
+    explicit PlanCache(const Catalog& catalog, size_t capacity = DEFAULT_CAPACITY)
+        : catalog_(catalog), capacity_(capacity) {}
+
+    /**
+     * @return The prepared statement of `sql`, parsing it on a miss, or nullptr
+     * if it does not parse
+     */
+    [[nodiscard]] std::shared_ptr<const PreparedStatement> prepare(
+        const std::string& sql, const std::vector<uint32_t>& parameter_types = {});
+
+    void clear();
+
+    [[nodiscard]] size_t size() const { return entries_.size(); }
+    [[nodiscard]] uint64_t hits() const { return hits_; }
+    [[nodiscard]] uint64_t misses() const { return misses_; }
+
+   private:
+    using Entry = std::pair<std::string, std::shared_ptr<const PreparedStatement>>;
+
+    const Catalog& catalog_;
+    size_t capacity_;
+    std::list<Entry> entries_; /**< Most recently used first */
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_PLAN_CACHE_HPP
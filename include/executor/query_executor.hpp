@@ -6,14 +6,31 @@
 #ifndef CLOUDSQL_EXECUTOR_QUERY_EXECUTOR_HPP
 #define CLOUDSQL_EXECUTOR_QUERY_EXECUTOR_HPP
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "catalog/catalog.hpp"
+#include "common/arena.hpp"
 #include "common/cluster_manager.hpp"
+#include "common/memory_tracker.hpp"
 #include "distributed/raft_types.hpp"
+#include "executor/columnar_replica.hpp"
+#include "executor/copy_decoder.hpp"
 #include "executor/operator.hpp"
+#include "executor/result_cache.hpp"
+#include "executor/table_handles.hpp"
 #include "executor/types.hpp"
 #include "parser/statement.hpp"
 #include "recovery/log_manager.hpp"
 #include "storage/buffer_pool_manager.hpp"
+#include "storage/columnar_table.hpp"
 #include "transaction/transaction_manager.hpp"
 
 namespace cloudsql::executor {
@@ -28,17 +45,175 @@ class ShardStateMachine : public raft::RaftStateMachine {
 
     void apply(const raft::LogEntry& entry) override;
 
+    /**
+     * @brief Write the page images of every table's heap, free space map and index files
+     *
+     * DELETE entries name rows by page and slot, so the entries after the
+     * snapshot only replay correctly onto the same physical pages.
+     */
+    bool save_snapshot(std::ostream& out) override;
+
+    /**
+     * @brief Rewrite each file in the snapshot with its pages, dropping their cached copies
+     */
+    bool load_snapshot(std::istream& in) override;
+
    private:
     std::string table_name_;
     storage::BufferPoolManager& bpm_;
     Catalog& catalog_;
 };
 
+/**
+ * @brief Rows of a SELECT pulled from its operator tree on demand
+ *
+ * Keeps the plan open between calls to next(), so a caller can send rows as
+ * they are produced instead of holding the whole result. A stream started
+ * outside an explicit transaction runs in a transaction of its own, committed
+ * when the rows run out or the stream is destroyed. A stream inside an
+ * explicit transaction must be destroyed before that transaction ends.
+ */
+class ResultStream {
+   public:
+    ~ResultStream();
+
+    ResultStream(const ResultStream&) = delete;
+    ResultStream& operator=(const ResultStream&) = delete;
+    ResultStream(ResultStream&&) = delete;
+    ResultStream& operator=(ResultStream&&) = delete;
+
+    [[nodiscard]] bool success() const { return error_.empty(); }
+    [[nodiscard]] const std::string& error() const { return error_; }
+    [[nodiscard]] const Schema& schema() const { return schema_; }
+
+    /** @return false once the rows are exhausted or an error occurred */
+    bool next(Tuple& row);
+
+    [[nodiscard]] bool done() const { return root_ == nullptr; }
+    [[nodiscard]] uint64_t row_count() const { return row_count_; }
+
+   private:
+    friend class QueryExecutor;
+
+    ResultStream(transaction::TransactionManager& transaction_manager,
+                 transaction::Transaction* owned_txn)
+        : transaction_manager_(transaction_manager), owned_txn_(owned_txn) {}
+
+    /** @brief Closes the plan and ends the stream's own transaction, if any */
+    void finish(bool commit);
+
+    transaction::TransactionManager& transaction_manager_;
+    transaction::Transaction* owned_txn_;
+    std::unique_ptr<common::MemoryTracker> memory_; /**< The query's; outlives the plan */
+    std::unique_ptr<Operator> root_;
+    Schema schema_;
+    std::string error_;
+    uint64_t row_count_ = 0;
+    std::chrono::steady_clock::time_point started_ = std::chrono::steady_clock::now();
+    bool recorded_ = false; /**< Latency and rows already counted in the executor metrics */
+};
+
+/**
+ * @brief A COPY FROM STDIN in progress
+ *
+ * Decodes the data it is handed and inserts the rows in batches as they
+ * complete, so memory stays bounded however much is loaded. Like a
+ * ResultStream, a copy started outside an explicit transaction runs in a
+ * transaction of its own: finish() commits it, while abort() or destroying
+ * an unfinished copy rolls it back.
+ */
+class CopyIn {
+   public:
+    ~CopyIn();
+
+    CopyIn(const CopyIn&) = delete;
+    CopyIn& operator=(const CopyIn&) = delete;
+    CopyIn(CopyIn&&) = delete;
+    CopyIn& operator=(CopyIn&&) = delete;
+
+    [[nodiscard]] bool success() const { return error_.empty(); }
+    [[nodiscard]] const std::string& error() const { return error_; }
+    [[nodiscard]] const Schema& schema() const { return schema_; }
+    [[nodiscard]] const parser::CopyOptions& options() const { return options_; }
+    [[nodiscard]] uint64_t row_count() const { return row_count_; }
+
+    /**
+     * @brief Decodes `size` more bytes of data, inserting every full batch
+     * @return false once an error occurred; the copy is then rolled back
+     */
+    bool write(const char* data, size_t size);
+
+    /** @brief Inserts the remaining rows and commits; @return false on error */
+    bool finish();
+
+    /** @brief Ends the copy without loading the rest, e.g. on CopyFail */
+    void abort(const std::string& reason);
+
+   private:
+    friend class QueryExecutor;
+
+    using Sink = std::function<void(const std::vector<Tuple>&)>;
+
+    CopyIn(transaction::TransactionManager& transaction_manager,
+           transaction::Transaction* owned_txn, const Schema& schema,
+           const parser::CopyOptions& options)
+        : transaction_manager_(transaction_manager),
+          owned_txn_(owned_txn),
+          schema_(schema),
+          options_(options),
+          decoder_(schema, options) {}
+
+    /** @brief Hands the decoded rows to the sink once there are `min_rows` of them */
+    void flush(size_t min_rows);
+
+    /** @brief Ends the copy's own transaction, if any */
+    void end(bool commit);
+
+    transaction::TransactionManager& transaction_manager_;
+    transaction::Transaction* owned_txn_;
+    Schema schema_;
+    parser::CopyOptions options_;
+    CopyDecoder decoder_;
+    Sink sink_;
+    std::vector<Tuple> rows_; /**< Decoded rows not yet handed to the sink */
+    std::string error_;
+    uint64_t row_count_ = 0;
+    bool open_ = true;
+};
+
+/**
+ * @brief How current the reads of a session must be, chosen with SET
+ *
+ * read_consistency takes leader, lease, follower or stale; max_staleness bounds
+ * a stale read, in milliseconds, with 0 for no bound. The defaults read
+ * whatever the node holds. result_cache (on or off) lets SELECTs outside a
+ * transaction be answered from the server's ResultCache; only unconstrained
+ * reads use it.
+ */
+struct ReadSettings {
+    raft::ReadConsistency consistency = raft::ReadConsistency::Stale;
+    std::chrono::milliseconds max_staleness{0};
+    bool result_cache = false;
+
+    /** @brief Whether reads have to wait on the shard's Raft group */
+    [[nodiscard]] bool constrained() const {
+        return consistency != raft::ReadConsistency::Stale || max_staleness.count() != 0;
+    }
+
+    /** @return An error for an unknown setting or value; empty once applied */
+    std::string apply(const parser::SetStatement& stmt);
+
+    [[nodiscard]] static const char* name(raft::ReadConsistency consistency);
+};
+
 /**
  * @brief Top-level executor that coordinates planning and operator execution
  */
 class QueryExecutor {
    public:
+    /** @brief Raft group that replicates the shard data between the data nodes */
+    static constexpr uint16_t SHARD_GROUP_ID = 1;
+
     QueryExecutor(Catalog& catalog, storage::BufferPoolManager& bpm,
                   transaction::LockManager& lock_manager,
                   transaction::TransactionManager& transaction_manager,
@@ -62,11 +237,94 @@ class QueryExecutor {
      */
     void set_local_only(bool local) { is_local_only_ = local; }
 
+    /**
+     * @brief Flag that, once set from another thread, stops the running SELECT
+     *
+     * Checked between result rows; the SELECT then fails with a cancellation
+     * error. Pass nullptr to clear.
+     */
+    void set_cancel_flag(const std::atomic<bool>* canceled) { canceled_ = canceled; }
+
+    /**
+     * @brief Read `tables` as shuffle streams from `senders` nodes each
+     *
+     * Scans of these tables consume the context's shuffle data while it is
+     * still arriving rather than waiting for the shuffle to finish.
+     */
+    void set_exchange(std::vector<std::string> tables, size_t senders) {
+        exchange_tables_ = std::move(tables);
+        exchange_senders_ = senders;
+    }
+
+    /** @brief Read settings of the session; SET changes them too */
+    void set_read_settings(const ReadSettings& settings) { read_settings_ = settings; }
+    [[nodiscard]] const ReadSettings& read_settings() const { return read_settings_; }
+
+    /**
+     * @brief Cache SELECT results may be kept in and answered from, shared
+     * with other sessions; nullptr for none
+     */
+    void set_result_cache(ResultCache* cache) { result_cache_ = cache; }
+    [[nodiscard]] ResultCache* result_cache() const { return result_cache_; }
+
+    /**
+     * @brief Replicas that CREATE TABLE ... WITH (COLUMNAR_REPLICA = ON) attaches
+     * and aggregates outside an explicit transaction read; nullptr for none
+     */
+    void set_columnar_replicas(ColumnarReplicaManager* replicas) { replicas_ = replicas; }
+
+    /** @return Whether a SELECT run now by execute() would go through the result cache */
+    [[nodiscard]] bool caches_results() const {
+        return result_cache_ != nullptr && read_settings_.result_cache &&
+               !read_settings_.constrained() && current_txn_ == nullptr;
+    }
+
     /**
      * @brief Execute a SQL statement and return results
      */
     QueryResult execute(const parser::Statement& stmt);
 
+    /**
+     * @brief Start a SELECT whose rows are pulled one at a time
+     * @return A stream; check success() for planning errors
+     */
+    [[nodiscard]] std::unique_ptr<ResultStream> stream(const parser::SelectStatement& stmt);
+
+    /**
+     * @brief Start a COPY FROM STDIN into a catalog table
+     * @return A copy to feed the data to; check success() for errors
+     */
+    [[nodiscard]] std::unique_ptr<CopyIn> copy_from(const parser::CopyStatement& stmt);
+
+    /**
+     * @brief Start a COPY FROM STDIN appending to a columnar table
+     *
+     * Each batch is appended as one set of column chunks.
+     */
+    [[nodiscard]] std::unique_ptr<CopyIn> copy_from(storage::ColumnarTable& table,
+                                                    const parser::CopyOptions& options);
+
+    /**
+     * @brief Sets the memory limit of each query, in bytes (0 = none)
+     *
+     * A query's operators and its buffered result charge a tracker under the
+     * session's; past the limit they spill where they can and fail otherwise.
+     */
+    static void set_default_query_memory_limit(size_t bytes);
+    [[nodiscard]] static size_t default_query_memory_limit();
+
+    /** @brief Memory of this session's queries and connection buffers, under the global tracker */
+    [[nodiscard]] common::MemoryTracker& session_memory() { return session_memory_; }
+
+    /** @return Whether an explicit transaction (BEGIN) is open */
+    [[nodiscard]] bool in_transaction() const { return current_txn_ != nullptr; }
+
+    /**
+     * @brief Result columns of `stmt` without running it
+     * @return An empty schema for statements that return no rows
+     */
+    [[nodiscard]] Schema describe(const parser::Statement& stmt);
+
    private:
     Catalog& catalog_;
     storage::BufferPoolManager& bpm_;
@@ -77,6 +335,27 @@ class QueryExecutor {
     std::string context_id_;
     transaction::Transaction* current_txn_ = nullptr;
     bool is_local_only_ = false;
+    const std::atomic<bool>* canceled_ = nullptr;
+    std::vector<std::string> exchange_tables_;
+    size_t exchange_senders_ = 0;
+    std::string exchange_error_; /**< Why a shuffle stream of the running plan failed */
+    std::shared_ptr<common::Arena> result_arena_; /**< Reused once its last result is gone */
+    TableHandleCache table_handles_;              /**< Heaps and indexes of the DML path */
+    ReadSettings read_settings_;
+    ResultCache* result_cache_ = nullptr;
+    ColumnarReplicaManager* replicas_ = nullptr;
+    common::MemoryTracker session_memory_{"session", 0, &common::MemoryTracker::global()};
+
+    static std::atomic<size_t> default_query_memory_limit_;
+
+    /** @return A tracker for the next query's memory, under the session's */
+    [[nodiscard]] std::unique_ptr<common::MemoryTracker> make_query_memory();
+
+    /**
+     * @brief Wait until the shard may be read at the session's consistency
+     * @return An error if this node cannot serve it; empty without a replicated shard
+     */
+    std::string prepare_shard_read() const;
 
     QueryResult execute_select(const parser::SelectStatement& stmt, transaction::Transaction* txn);
     QueryResult execute_create_table(const parser::CreateTableStatement& stmt);
@@ -85,8 +364,45 @@ class QueryExecutor {
     QueryResult execute_drop_index(const parser::DropIndexStatement& stmt);
     QueryResult execute_insert(const parser::InsertStatement& stmt, transaction::Transaction* txn);
     QueryResult execute_update(const parser::UpdateStatement& stmt, transaction::Transaction* txn);
+    QueryResult execute_analyze(const parser::AnalyzeStatement& stmt,
+                                transaction::Transaction* txn);
     QueryResult execute_delete(const parser::DeleteStatement& stmt, transaction::Transaction* txn);
 
+    /** @brief Runs outside any transaction, which would hold back what it may remove */
+    QueryResult execute_vacuum(const parser::VacuumStatement& stmt);
+
+    /**
+     * @brief Shows the plan build_plan() picks for a SELECT; with ANALYZE, runs
+     * it and shows the rows, time and I/O of every operator
+     */
+    QueryResult execute_explain(const parser::ExplainStatement& stmt,
+                                transaction::Transaction* txn);
+
+    /**
+     * @brief Inserts rows into a local heap and its indexes as one batch
+     *
+     * Fills heap pages a page at a time, writes one WAL record per page,
+     * applies each index's keys in sorted order and takes the row locks
+     * together.
+     * @throws std::runtime_error if a row or index entry cannot be written
+     */
+    void insert_batch(const TableInfo& table_meta, const std::vector<Tuple>& rows,
+                      transaction::Transaction* txn);
+
+    /**
+     * @brief Take the lock a scan of `table` needs; one table S lock under SERIALIZABLE
+     * @throws std::runtime_error if the lock cannot be acquired
+     */
+    void lock_for_scan(const TableInfo& table, transaction::Transaction* txn);
+
+    /**
+     * @brief Lock rows about to be changed, under IX locks on their table and pages
+     * @throws std::runtime_error if the locks cannot be acquired
+     */
+    void lock_for_write(const TableInfo& table,
+                        const std::vector<storage::HeapTable::TupleId>& tids,
+                        transaction::Transaction* txn);
+
     /* Transaction control */
     QueryResult execute_begin();
     QueryResult execute_commit();
@@ -95,6 +411,12 @@ class QueryExecutor {
     /* Helper to build operator tree from SELECT */
     std::unique_ptr<Operator> build_plan(const parser::SelectStatement& stmt,
                                          transaction::Transaction* txn);
+
+    /** @return A scan of the shuffled rows of `table` in this context, or nullptr if none */
+    std::unique_ptr<Operator> shuffle_scan(const std::string& table);
+
+    /** @return Why opening the plan under `root` failed */
+    [[nodiscard]] std::string open_error(const Operator& root) const;
 };
 
 }  // namespace cloudsql::executor
@@ -0,0 +1,125 @@
+/**
+ * @file result_cache.hpp
+ * @brief Results of read-only queries, reused until a table they read changes
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_RESULT_CACHE_HPP
+#define CLOUDSQL_EXECUTOR_RESULT_CACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "catalog/catalog.hpp"
+#include "common/metrics.hpp"
+#include "executor/types.hpp"
+#include "parser/statement.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief Memory-bounded LRU cache of SELECT results, shared by a server's sessions
+ *
+ * An entry is keyed by the statement as parsed, bound parameters included, so
+ * spacing and keyword case do not matter. It is tagged with the catalog
+ * version and the data version of every table it read (see
+ * Catalog::data_version()); once any of them moves, the entry is stale and
+ * goes on its next lookup. Callers take the versions before the query's
+ * snapshot, so an entry is never tagged newer than its rows.
+ *
+ * Entries are charged an estimate of the memory their rows take, and adding
+ * one past capacity evicts the least recently used. A result of more than
+ * MAX_ENTRY_SHARE of the capacity is not kept. Safe to use from any thread.
+ */
+class ResultCache {
+   public:
+    static constexpr size_t DEFAULT_CAPACITY_BYTES = static_cast<size_t>(64) * 1024 * 1024;
+    static constexpr size_t MAX_ENTRY_SHARE = 4; /**< Largest entry: capacity / 4 */
+
+    /** @brief Versions a result was read at */
+    struct Versions {
+        uint64_t catalog = 0;
+        std::vector<std::pair<std::string, uint64_t>> tables; /**< Name, data version */
+
+        [[nodiscard]] bool operator==(const Versions& other) const {
+            return catalog == other.catalog && tables == other.tables;
+        }
+    };
+
+    /** @brief Where a SELECT's result is, or would be, cached */
+    struct Probe {
+        std::string key; /**< Empty if the result cannot be cached */
+        Versions versions;
+    };
+
+    explicit ResultCache(size_t capacity_bytes = DEFAULT_CAPACITY_BYTES);
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+    ResultCache(ResultCache&&) = delete;
+    ResultCache& operator=(ResultCache&&) = delete;
+    ~ResultCache() = default;
+
+    /**
+     * @brief The key of `stmt` and the versions of what it reads, as of now
+     *
+     * A statement that reads no table, or one the catalog does not hold, such
+     * as a system view, gets an empty key.
+     */
+    [[nodiscard]] static Probe probe(Catalog& catalog, const parser::SelectStatement& stmt);
+
+    /** @return A copy of the cached result, if there is one read at `probe`'s versions */
+    [[nodiscard]] std::optional<QueryResult> lookup(const Probe& probe);
+
+    /** @brief Keeps the rows of `result`, read at `probe`'s versions */
+    void insert(const Probe& probe, const QueryResult& result);
+
+    void clear();
+
+    [[nodiscard]] size_t capacity() const { return capacity_; }
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] size_t bytes() const;
+    [[nodiscard]] uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t evictions() const { return evictions_.load(std::memory_order_relaxed); }
+
+    /** @return Entries dropped because a table they read, or the catalog, changed */
+    [[nodiscard]] uint64_t invalidations() const {
+        return invalidations_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    struct Entry {
+        std::string key;
+        Versions versions;
+        QueryResult result;
+        size_t bytes = 0;
+    };
+
+    /** @brief Drops `it`; the caller holds mutex_ */
+    void erase(std::list<Entry>::iterator it);
+
+    size_t capacity_;
+    mutable std::mutex mutex_;
+    std::list<Entry> entries_; /**< Most recently used first */
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t bytes_ = 0;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<uint64_t> invalidations_{0};
+
+    // Last, so the collector is unregistered before the state it reads
+    common::MetricsRegistry::Registration metrics_;
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_RESULT_CACHE_HPP
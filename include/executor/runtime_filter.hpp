@@ -0,0 +1,80 @@
+/**
+ * @file runtime_filter.hpp
+ * @brief Join key filters built from a hash join's build side while the query runs
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_RUNTIME_FILTER_HPP
+#define CLOUDSQL_EXECUTOR_RUNTIME_FILTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "common/value.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief The keys of a join's build side, as a Bloom filter and their range
+ *
+ * A hash join builds one once its build side is complete and hands it to the
+ * scans of its probe side, which drop rows whose key may_contain() rules out
+ * before they reach the join; across the cluster a shuffle drops them before
+ * they are sent. A key that was added always passes. Any other key passes the
+ * [min, max] range check and then the Bloom filter with a false positive rate
+ * of about 1%. NULL never passes, since it matches nothing.
+ *
+ * Keys compare as the hash join compares them, so 2 and 2.0 are the same key.
+ * The bit count is a power of two, and each key sets HASH_COUNT bits derived
+ * from one 64-bit hash. Filters built apart can therefore be merged even when
+ * their sizes differ: the larger is folded down to the smaller.
+ */
+class RuntimeFilter {
+   public:
+    static constexpr size_t BITS_PER_KEY = 10;
+    static constexpr size_t HASH_COUNT = 7;
+    static constexpr size_t MIN_BITS = 512;
+    static constexpr size_t MAX_BITS = static_cast<size_t>(1) << 27; /**< 16 MiB */
+
+    /** @param expected_keys Keys the filter is sized for; more still work, less precisely */
+    explicit RuntimeFilter(size_t expected_keys);
+
+    /** @brief Rebuilds a filter from its parts, as sent between nodes */
+    RuntimeFilter(std::vector<uint64_t> words, uint64_t key_count, common::Value min,
+                  common::Value max);
+
+    /** @brief Adds a key; NULL is ignored */
+    void add(const common::Value& key);
+
+    /** @return false only if `key` was never added */
+    [[nodiscard]] bool may_contain(const common::Value& key) const;
+
+    /** @brief Makes this filter pass the keys of `other` as well */
+    void merge(const RuntimeFilter& other);
+
+    /** @return Keys added, counting repeats */
+    [[nodiscard]] uint64_t key_count() const { return key_count_; }
+    [[nodiscard]] size_t bit_count() const { return words_.size() * 64; }
+    [[nodiscard]] const std::vector<uint64_t>& words() const { return words_; }
+
+    /** @return Smallest / largest key added (NULL while empty) */
+    [[nodiscard]] const common::Value& min() const { return min_; }
+    [[nodiscard]] const common::Value& max() const { return max_; }
+
+    /** @return The hash a key is filtered by; equal keys of any numeric type agree */
+    [[nodiscard]] static uint64_t key_hash(const common::Value& key);
+
+   private:
+    std::vector<uint64_t> words_;
+    uint64_t mask_; /**< bit_count() - 1 */
+    uint64_t key_count_ = 0;
+    common::Value min_;
+    common::Value max_;
+
+    /** @brief Halves the filter, OR-ing the upper half into the lower */
+    void fold();
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_RUNTIME_FILTER_HPP
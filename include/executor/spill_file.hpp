@@ -0,0 +1,69 @@
+/**
+ * @file spill_file.hpp
+ * @brief Temporary files operators spill tuples to when they exceed memory
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_SPILL_FILE_HPP
+#define CLOUDSQL_EXECUTOR_SPILL_FILE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "common/value.hpp"
+#include "executor/types.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief Temporary file of tuples, written once and then read back in order
+ *
+ * Each record is a tuple, optionally preceded by an opaque key (e.g. a sort
+ * key). The file is unlinked as soon as it is created, so it disappears once
+ * closed even if the process dies. Strings are read back as TEXT.
+ */
+class SpillFile {
+   public:
+    /**
+     * @param directory Where to create the file; empty uses the system temp directory
+     * @throws std::runtime_error if the file cannot be created
+     */
+    explicit SpillFile(const std::string& directory = "");
+    ~SpillFile();
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+    SpillFile(SpillFile&&) = delete;
+    SpillFile& operator=(SpillFile&&) = delete;
+
+    /** @throws std::runtime_error on I/O errors or values that cannot be spilled */
+    void write(const Tuple& tuple) { write(std::string(), tuple); }
+    void write(const std::string& key, const Tuple& tuple);
+
+    /** @brief Switches from writing to reading from the first record */
+    void rewind();
+
+    /** @return false at the end of the file */
+    bool read(Tuple& tuple);
+    bool read(std::string& key, Tuple& tuple);
+
+    [[nodiscard]] uint64_t records() const { return records_; }
+    [[nodiscard]] uint64_t bytes_written() const { return bytes_written_; }
+
+   private:
+    std::FILE* file_;
+    std::vector<char> record_; /**< Serialized record being written */
+    std::string discarded_key_;
+    uint64_t records_ = 0;
+    uint64_t bytes_written_ = 0;
+
+    void read_raw(void* out, size_t size);
+    template <typename T>
+    T read_raw();
+    common::Value read_value();
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_SPILL_FILE_HPP
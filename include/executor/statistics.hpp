@@ -0,0 +1,73 @@
+/**
+ * @file statistics.hpp
+ * @brief Row sampling and column statistics for ANALYZE
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_STATISTICS_HPP
+#define CLOUDSQL_EXECUTOR_STATISTICS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "catalog/catalog.hpp"
+#include "executor/types.hpp"
+#include "storage/columnar_table.hpp"
+#include "storage/heap_table.hpp"
+#include "transaction/transaction.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief Turns a stream of rows into TableStats
+ *
+ * Keeps a uniform sample of at most `sample_rows` rows (reservoir sampling),
+ * so memory stays bounded however large the table is. The number of distinct
+ * values is scaled up from the sample with the Duj1 estimator of Haas and
+ * Stokes; it is exact when the whole table fits in the sample.
+ */
+class StatsBuilder {
+   public:
+    static constexpr size_t DEFAULT_SAMPLE_ROWS = 30000;
+    static constexpr size_t MAX_COMMON_VALUES = 16;
+    static constexpr size_t HISTOGRAM_BUCKETS = 32;
+
+    explicit StatsBuilder(size_t column_count, size_t sample_rows = DEFAULT_SAMPLE_ROWS,
+                          uint64_t seed = 0);
+
+    void add_row(const Tuple& row);
+
+    /** @brief Records one more page of the table, for scan costs */
+    void add_page() { ++page_count_; }
+
+    [[nodiscard]] TableStats build() const;
+
+   private:
+    size_t column_count_;
+    size_t sample_rows_;
+    uint64_t rows_seen_ = 0;
+    uint64_t page_count_ = 0;
+    std::vector<Tuple> sample_;
+    std::mt19937_64 rng_;
+
+    [[nodiscard]] ColumnStats build_column(size_t column) const;
+};
+
+/**
+ * @brief Statistics of the rows of a heap table visible to `txn`
+ * @param txn Snapshot to sample; nullptr samples every row not deleted
+ */
+[[nodiscard]] TableStats analyze_table(storage::HeapTable& table,
+                                       const transaction::Transaction* txn,
+                                       size_t sample_rows = StatsBuilder::DEFAULT_SAMPLE_ROWS);
+
+/**
+ * @brief Statistics of a columnar table; page_count counts its chunks
+ */
+[[nodiscard]] TableStats analyze_table(storage::ColumnarTable& table,
+                                       size_t sample_rows = StatsBuilder::DEFAULT_SAMPLE_ROWS);
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_STATISTICS_HPP
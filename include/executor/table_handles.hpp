@@ -0,0 +1,79 @@
+/**
+ * @file table_handles.hpp
+ * @brief Opened heap tables and indexes reused across DML statements
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_TABLE_HANDLES_HPP
+#define CLOUDSQL_EXECUTOR_TABLE_HANDLES_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "catalog/catalog.hpp"
+#include "common/value.hpp"
+#include "executor/types.hpp"
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/heap_table.hpp"
+#include "storage/index.hpp"
+
+namespace cloudsql::executor {
+
+/**
+ * @brief The access method object for an index: a HashIndex, BrinIndex or BTreeIndex
+ */
+std::unique_ptr<storage::Index> open_index(const IndexInfo& info, common::ValueType key_type,
+                                           storage::BufferPoolManager& bpm);
+
+/**
+ * @brief A single-column index of a table and the column it keys on
+ */
+struct IndexHandle {
+    std::unique_ptr<storage::Index> index;
+    uint16_t column;
+};
+
+/**
+ * @brief Everything the DML path touches for one table: its schema, heap and indexes
+ */
+struct TableHandle {
+    Schema schema;
+    storage::HeapTable table;
+    std::vector<IndexHandle> indexes; /**< Index keys are read from `column` of each row */
+
+    TableHandle(const TableInfo& info, storage::BufferPoolManager& bpm);
+};
+
+/**
+ * @brief Per-executor cache of TableHandles keyed by table oid
+ *
+ * Saves rebuilding the schema, heap and index objects for every statement and
+ * every row. The whole cache is dropped when the catalog version changes, so
+ * a handle never outlives the DDL that would alter its columns or indexes.
+ * Handles hold no page state of their own; the index root is still found
+ * through the meta page on every operation, which keeps concurrent splits safe.
+ */
+class TableHandleCache {
+   public:
+    TableHandleCache(const Catalog& catalog, storage::BufferPoolManager& bpm)
+        : catalog_(catalog), bpm_(bpm) {}
+
+    /** @return The handle of `info`, opening it on first use */
+    [[nodiscard]] TableHandle& get(const TableInfo& info);
+
+    void clear() { handles_.clear(); }
+
+    [[nodiscard]] size_t size() const { return handles_.size(); }
+
+   private:
+    const Catalog& catalog_;
+    storage::BufferPoolManager& bpm_;
+    uint64_t version_ = 0; /**< Catalog version the cached handles were opened at */
+    std::unordered_map<oid_t, std::unique_ptr<TableHandle>> handles_;
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_TABLE_HANDLES_HPP
@@ -0,0 +1,88 @@
+/**
+ * @file thread_pool.hpp
+ * @brief Work-stealing thread pool for parallel query execution
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_THREAD_POOL_HPP
+#define CLOUDSQL_EXECUTOR_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cloudsql::executor {
+
+/**
+ * @brief Fixed set of worker threads running one parallel loop at a time
+ *
+ * parallel_for() deals the task indices out in contiguous blocks, one block
+ * per participating worker, so neighbouring tasks (e.g. adjacent morsels of a
+ * table) run on the same thread. A worker works through its own block from
+ * the front; once it is empty it steals from the back of the other blocks, so
+ * a slow block does not hold up the whole loop.
+ */
+class WorkStealingPool {
+   public:
+    /** fn(worker, task): `worker` is in [0, workers) and stable for the thread */
+    using TaskFn = std::function<void(size_t worker, size_t task)>;
+
+    explicit WorkStealingPool(size_t threads);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    WorkStealingPool(WorkStealingPool&&) = delete;
+    WorkStealingPool& operator=(WorkStealingPool&&) = delete;
+
+    [[nodiscard]] size_t thread_count() const { return threads_.size(); }
+
+    /**
+     * @brief Runs fn for every task in [0, task_count) on up to `workers`
+     * threads (0 = all) and waits for them
+     *
+     * A single worker runs the loop on the calling thread. Concurrent calls
+     * wait for each other. After the first task throws, the remaining tasks
+     * are skipped and the exception is rethrown here.
+     */
+    void parallel_for(size_t task_count, size_t workers, const TaskFn& fn);
+
+    /** @return Process-wide pool with one thread per hardware thread */
+    static WorkStealingPool& shared();
+
+   private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex job_mutex_; /**< Held for the whole of a parallel_for() */
+    std::mutex state_mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    uint64_t generation_ = 0;
+    size_t job_workers_ = 0;
+    size_t active_workers_ = 0;
+    const TaskFn* job_fn_ = nullptr;
+    std::exception_ptr error_;
+    std::atomic<bool> failed_{false};
+    bool stop_ = false;
+
+    void worker_loop(size_t id);
+    bool pop_task(size_t id, size_t* task);
+    void run_task(size_t id, size_t task, const TaskFn& fn);
+};
+
+}  // namespace cloudsql::executor
+
+#endif  // CLOUDSQL_EXECUTOR_THREAD_POOL_HPP
@@ -10,12 +10,18 @@
 #ifndef CLOUDSQL_EXECUTOR_TYPES_HPP
 #define CLOUDSQL_EXECUTOR_TYPES_HPP
 
+#include <algorithm>
 #include <cstdint>
+#include <initializer_list>
+#include <iterator>
 #include <memory>
+#include <memory_resource>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "common/arena.hpp"
 #include "common/value.hpp"
 
 namespace cloudsql::executor {
@@ -27,8 +33,11 @@ enum class ExecState : uint8_t { Init, Open, Executing, Done, Error };
 
 /**
  * @brief Supported join types for relation merging.
+ *
+ * Semi and Anti keep the left rows with / without a match and output only
+ * the left columns; only the vectorized hash join implements them.
  */
-enum class JoinType : uint8_t { Inner, Left, Right, Full };
+enum class JoinType : uint8_t { Inner, Left, Right, Full, Semi, Anti };
 
 /**
  * @brief Supported aggregation functions for analytical queries.
@@ -120,14 +129,27 @@ class Schema {
 
 /**
  * @brief A single data row used in the row-oriented (Volcano) execution model.
+ *
+ * Values live in a std::pmr vector on the default heap unless the tuple is
+ * built on another memory resource, such as the arena of a QueryResult.
+ * Copies always go to the default heap; moves keep the source's resource.
  */
 class Tuple {
    private:
-    std::vector<common::Value> values_;
+    std::pmr::vector<common::Value> values_;
 
    public:
     Tuple() = default;
-    explicit Tuple(std::vector<common::Value> values) : values_(std::move(values)) {}
+    explicit Tuple(std::pmr::vector<common::Value> values) : values_(std::move(values)) {}
+    explicit Tuple(std::vector<common::Value> values)
+        : values_(std::make_move_iterator(values.begin()), std::make_move_iterator(values.end())) {}
+    Tuple(std::initializer_list<common::Value> values) : values_(values) {}
+
+    /**
+     * @brief Copies `other` into memory from `resource`, which must outlive the tuple
+     */
+    Tuple(const Tuple& other, std::pmr::memory_resource* resource)
+        : values_(other.values_, resource) {}
 
     Tuple(const Tuple& other) = default;
     Tuple(Tuple&& other) noexcept = default;
@@ -159,8 +181,8 @@ class Tuple {
     [[nodiscard]] size_t size() const { return values_.size(); }
     [[nodiscard]] bool empty() const { return values_.empty(); }
 
-    [[nodiscard]] const std::vector<common::Value>& values() const { return values_; }
-    [[nodiscard]] std::vector<common::Value>& values() { return values_; }
+    [[nodiscard]] const std::pmr::vector<common::Value>& values() const { return values_; }
+    [[nodiscard]] std::pmr::vector<common::Value>& values() { return values_; }
 
     [[nodiscard]] std::string to_string() const;
 };
@@ -172,7 +194,7 @@ class ColumnVector {
    protected:
     common::ValueType type_;
     size_t size_ = 0;
-    std::vector<bool> null_bitmap_;
+    std::vector<uint8_t> null_bitmap_; /**< One byte per row, 1 = NULL */
 
    public:
     explicit ColumnVector(common::ValueType type) : type_(type) {}
@@ -188,15 +210,21 @@ class ColumnVector {
         if (index >= size_) {
             return true;
         }
-        return null_bitmap_[index];
+        return null_bitmap_[index] != 0;
     }
 
+    /**
+     * @brief Raw NULL flags, one byte per element (1 = NULL), for typed kernels.
+     */
+    [[nodiscard]] const uint8_t* null_data() const { return null_bitmap_.data(); }
+    uint8_t* null_data_mut() { return null_bitmap_.data(); }
+
     /**
      * @brief Updates the nullability status of an existing element.
      */
     virtual void set_null(size_t index, bool is_null) {
         if (index < size_) {
-            null_bitmap_[index] = is_null;
+            null_bitmap_[index] = is_null ? 1 : 0;
         }
     }
 
@@ -210,6 +238,19 @@ class ColumnVector {
      */
     virtual common::Value get(size_t index) const = 0;
 
+    /**
+     * @brief Appends `count` rows of `source` without boxing them into Values.
+     * @param indices Rows to copy, or null for the first `count` rows.
+     * @return false (and appends nothing) if `source` stores its values differently.
+     */
+    virtual bool gather_from(const ColumnVector& source, const uint32_t* indices,
+                             size_t count) = 0;
+
+    /**
+     * @brief Keeps only the rows at `indices` (ascending), compacted in order.
+     */
+    virtual void retain(const uint32_t* indices, size_t count) = 0;
+
     /**
      * @brief Resets the vector, clearing all data and nullability information.
      */
@@ -227,6 +268,19 @@ class NumericVector : public ColumnVector {
    private:
     using InternalType = std::conditional_t<std::is_same_v<T, bool>, uint8_t, T>;
     std::vector<InternalType> data_;
+    const InternalType* view_ = nullptr;     /**< Borrowed values (zero-copy), if set */
+    std::shared_ptr<const void> view_owner_; /**< Keeps the borrowed values alive */
+
+    /**
+     * @brief Copies borrowed values into owned storage before any mutation.
+     */
+    void materialize() {
+        if (view_ != nullptr) {
+            data_.assign(view_, view_ + size_);
+            view_ = nullptr;
+            view_owner_.reset();
+        }
+    }
 
    public:
     explicit NumericVector(common::ValueType type) : ColumnVector(type) {}
@@ -235,11 +289,12 @@ class NumericVector : public ColumnVector {
      * @brief Appends a Value, handling type conversions and nullability.
      */
     void append(const common::Value& val) override {
+        materialize();
         if (val.is_null()) {
-            null_bitmap_.push_back(true);
+            null_bitmap_.push_back(1);
             data_.push_back(InternalType{});
         } else {
-            null_bitmap_.push_back(false);
+            null_bitmap_.push_back(0);
             if constexpr (std::is_same_v<T, int64_t>) {
                 data_.push_back(val.to_int64());
             } else if constexpr (std::is_same_v<T, double>) {
@@ -255,11 +310,12 @@ class NumericVector : public ColumnVector {
      * @brief Materializes a common::Value for the element at the specified index.
      */
     common::Value get(size_t index) const override {
-        if (index >= size_ || null_bitmap_[index]) return common::Value::make_null();
-        if constexpr (std::is_same_v<T, int64_t>) return common::Value::make_int64(data_[index]);
-        if constexpr (std::is_same_v<T, double>) return common::Value::make_float64(data_[index]);
+        if (index >= size_ || null_bitmap_[index] != 0) return common::Value::make_null();
+        const InternalType* const values = raw_data();
+        if constexpr (std::is_same_v<T, int64_t>) return common::Value::make_int64(values[index]);
+        if constexpr (std::is_same_v<T, double>) return common::Value::make_float64(values[index]);
         if constexpr (std::is_same_v<T, bool>)
-            return common::Value::make_bool(static_cast<bool>(data_[index]));
+            return common::Value::make_bool(static_cast<bool>(values[index]));
         return common::Value::make_null();
     }
 
@@ -271,33 +327,184 @@ class NumericVector : public ColumnVector {
         if (index >= size_) {
             resize(index + 1);
         }
+        materialize();
         if constexpr (std::is_same_v<T, bool>) {
             data_[index] = static_cast<uint8_t>(val);
         } else {
             data_[index] = val;
         }
-        null_bitmap_[index] = false;
+        null_bitmap_[index] = 0;
     }
 
     /**
      * @brief Provides read-only access to the underlying raw data buffer.
      */
-    const InternalType* raw_data() const { return data_.data(); }
+    const InternalType* raw_data() const { return view_ != nullptr ? view_ : data_.data(); }
 
     /**
      * @brief Provides mutable access to the underlying raw data buffer.
+     * A borrowed buffer is copied first.
      */
-    InternalType* raw_data_mut() { return data_.data(); }
+    InternalType* raw_data_mut() {
+        materialize();
+        return data_.data();
+    }
 
     /**
      * @brief Resizes the underlying buffers to the specified capacity.
      */
+    void resize(size_t new_size) {
+        materialize();
+        data_.resize(new_size);
+        null_bitmap_.resize(new_size, 0);
+        size_ = new_size;
+    }
+
+    /**
+     * @brief Borrows `count` non-null values from an external buffer instead of copying them.
+     * @param owner Kept alive for as long as the vector references the buffer.
+     */
+    void reference(const InternalType* values, size_t count, std::shared_ptr<const void> owner) {
+        data_.clear();
+        view_ = values;
+        view_owner_ = std::move(owner);
+        null_bitmap_.assign(count, 0);
+        size_ = count;
+    }
+
+    /**
+     * @brief Returns true if the values are borrowed rather than owned.
+     */
+    [[nodiscard]] bool is_view() const { return view_ != nullptr; }
+
+    bool gather_from(const ColumnVector& source, const uint32_t* indices,
+                     size_t count) override {
+        const auto* typed = dynamic_cast<const NumericVector<T>*>(&source);
+        if (typed == nullptr) return false;
+
+        // A whole borrowed column is shared rather than copied
+        if (size_ == 0 && indices == nullptr && typed->is_view() && count == typed->size_) {
+            reference(typed->view_, count, typed->view_owner_);
+            null_bitmap_ = typed->null_bitmap_;
+            return true;
+        }
+
+        materialize();
+        const InternalType* const src = typed->raw_data();
+        const size_t base = size_;
+        data_.resize(base + count);
+        null_bitmap_.resize(base + count, 0);
+        InternalType* const dst = data_.data() + base;
+        if (indices == nullptr) {
+            std::copy_n(src, count, dst);
+            std::copy_n(typed->null_bitmap_.data(), count, null_bitmap_.data() + base);
+        } else {
+            for (size_t i = 0; i < count; ++i) dst[i] = src[indices[i]];
+            for (size_t i = 0; i < count; ++i) {
+                null_bitmap_[base + i] = typed->null_bitmap_[indices[i]];
+            }
+        }
+        size_ += count;
+        return true;
+    }
+
+    void retain(const uint32_t* indices, size_t count) override {
+        if (view_ != nullptr) {
+            // Gather straight out of the borrowed buffer instead of copying it first
+            data_.resize(count);
+            for (size_t i = 0; i < count; ++i) data_[i] = view_[indices[i]];
+            view_ = nullptr;
+            view_owner_.reset();
+        } else {
+            for (size_t i = 0; i < count; ++i) data_[i] = data_[indices[i]];
+            data_.resize(count);
+        }
+        for (size_t i = 0; i < count; ++i) null_bitmap_[i] = null_bitmap_[indices[i]];
+        null_bitmap_.resize(count);
+        size_ = count;
+    }
+
+    void clear() override {
+        ColumnVector::clear();
+        data_.clear();
+        view_ = nullptr;
+        view_owner_.reset();
+    }
+};
+
+/**
+ * @brief Variable-width column of strings (CHAR, VARCHAR, TEXT).
+ */
+class StringVector : public ColumnVector {
+   private:
+    std::vector<std::string> data_;
+
+   public:
+    explicit StringVector(common::ValueType type) : ColumnVector(type) {}
+
+    void append(const common::Value& val) override {
+        null_bitmap_.push_back(val.is_null() ? 1 : 0);
+        data_.push_back(val.is_null() ? std::string() : val.to_string());
+        size_++;
+    }
+
+    common::Value get(size_t index) const override {
+        if (index >= size_ || null_bitmap_[index] != 0) return common::Value::make_null();
+        return common::Value::make_text(data_[index]);
+    }
+
+    void set(size_t index, std::string val) {
+        if (index >= size_) {
+            resize(index + 1);
+        }
+        data_[index] = std::move(val);
+        null_bitmap_[index] = 0;
+    }
+
+    /**
+     * @brief Provides read-only access to the underlying strings.
+     */
+    const std::string* raw_data() const { return data_.data(); }
+
+    /**
+     * @brief Provides mutable access to the underlying strings.
+     */
+    std::string* raw_data_mut() { return data_.data(); }
+
     void resize(size_t new_size) {
         data_.resize(new_size);
-        null_bitmap_.resize(new_size, false);
+        null_bitmap_.resize(new_size, 0);
         size_ = new_size;
     }
 
+    bool gather_from(const ColumnVector& source, const uint32_t* indices,
+                     size_t count) override {
+        const auto* typed = dynamic_cast<const StringVector*>(&source);
+        if (typed == nullptr) return false;
+        const size_t base = size_;
+        data_.resize(base + count);
+        null_bitmap_.resize(base + count, 0);
+        for (size_t i = 0; i < count; ++i) {
+            const size_t row = indices == nullptr ? i : indices[i];
+            data_[base + i] = typed->data_[row];
+            null_bitmap_[base + i] = typed->null_bitmap_[row];
+        }
+        size_ += count;
+        return true;
+    }
+
+    void retain(const uint32_t* indices, size_t count) override {
+        for (size_t i = 0; i < count; ++i) {
+            if (indices[i] != i) {
+                data_[i] = std::move(data_[indices[i]]);
+                null_bitmap_[i] = null_bitmap_[indices[i]];
+            }
+        }
+        data_.resize(count);
+        null_bitmap_.resize(count);
+        size_ = count;
+    }
+
     void clear() override {
         ColumnVector::clear();
         data_.clear();
@@ -306,11 +513,17 @@ class NumericVector : public ColumnVector {
 
 /**
  * @brief Represents a set of data blocks (batches) in a columnar format for vectorized processing.
+ *
+ * A batch may carry a selection vector: ascending indices of the rows that are
+ * still live. Filters narrow the selection instead of copying rows; columns keep
+ * all row_count() physical rows until flatten() compacts them.
  */
 class VectorBatch {
    private:
     std::vector<std::unique_ptr<ColumnVector>> columns_;
     size_t row_count_ = 0;
+    std::vector<uint32_t> selection_;
+    bool has_selection_ = false;
 
    public:
     VectorBatch() = default;
@@ -326,9 +539,82 @@ class VectorBatch {
      * @brief Retrieves a mutable reference to a column by its index.
      */
     ColumnVector& get_column(size_t index) { return *columns_.at(index); }
+    [[nodiscard]] const ColumnVector& get_column(size_t index) const { return *columns_.at(index); }
 
     void set_row_count(size_t count) { row_count_ = count; }
 
+    /** @return true if only the rows in selection() are live */
+    [[nodiscard]] bool has_selection() const { return has_selection_; }
+    [[nodiscard]] const std::vector<uint32_t>& selection() const { return selection_; }
+
+    /** @return Number of live rows */
+    [[nodiscard]] size_t selected_count() const {
+        return has_selection_ ? selection_.size() : row_count_;
+    }
+
+    /**
+     * @brief Restricts the live rows to `selection` (ascending physical row indices).
+     */
+    void set_selection(std::vector<uint32_t> selection) {
+        selection_ = std::move(selection);
+        has_selection_ = true;
+    }
+
+    /**
+     * @brief Calls `fn(row)` with the physical index of every live row, in order.
+     */
+    template <typename F>
+    void for_each_selected(F&& fn) const {
+        if (has_selection_) {
+            for (const uint32_t row : selection_) fn(static_cast<size_t>(row));
+        } else {
+            for (size_t row = 0; row < row_count_; ++row) fn(row);
+        }
+    }
+
+    /**
+     * @brief Narrows the live rows to those where `mask` is true; NULL counts as false.
+     * @return Number of rows still live.
+     */
+    size_t select_where(const NumericVector<bool>& mask) {
+        const uint8_t* const values = mask.raw_data();
+        const size_t limit = std::min(row_count_, mask.size());
+        const auto keep = [&](size_t row) { return !mask.is_null(row) && values[row] != 0; };
+
+        if (has_selection_) {
+            size_t kept = 0;
+            for (const uint32_t row : selection_) {
+                if (row < limit && keep(row)) selection_[kept++] = row;
+            }
+            selection_.resize(kept);
+        } else {
+            selection_.clear();
+            for (size_t row = 0; row < limit; ++row) {
+                if (keep(row)) selection_.push_back(static_cast<uint32_t>(row));
+            }
+            has_selection_ = true;
+        }
+
+        // Everything survived: stay dense so nothing downstream pays for indirection
+        if (selection_.size() == row_count_) {
+            selection_.clear();
+            has_selection_ = false;
+            return row_count_;
+        }
+        return selection_.size();
+    }
+
+    /**
+     * @brief Compacts every column to the live rows and drops the selection.
+     */
+    void flatten() {
+        if (!has_selection_) return;
+        for (auto& col : columns_) col->retain(selection_.data(), selection_.size());
+        row_count_ = selection_.size();
+        selection_.clear();
+        has_selection_ = false;
+    }
+
     /**
      * @brief Initializes the batch's column structure based on the provided schema.
      * @param schema The schema to match.
@@ -352,8 +638,11 @@ class VectorBatch {
                 case common::ValueType::TYPE_BOOL:
                     add_column(std::make_unique<NumericVector<bool>>(col.type()));
                     break;
+                case common::ValueType::TYPE_CHAR:
+                case common::ValueType::TYPE_VARCHAR:
                 case common::ValueType::TYPE_TEXT:
-                    throw std::runtime_error("Vectorized StringVector implementation is pending.");
+                    add_column(std::make_unique<StringVector>(col.type()));
+                    break;
                 default:
                     throw std::runtime_error("Unsupported column type for vectorized execution: " +
                                              std::to_string(static_cast<int>(col.type())));
@@ -387,11 +676,13 @@ class VectorBatch {
     }
 
     /**
-     * @brief Resets all column vectors and the row count to zero.
+     * @brief Resets all column vectors, the row count and the selection.
      */
     void clear() {
         for (auto& col : columns_) col->clear();
         row_count_ = 0;
+        selection_.clear();
+        has_selection_ = false;
     }
 };
 
@@ -401,14 +692,41 @@ class VectorBatch {
 class QueryResult {
    private:
     Schema schema_;
+    std::shared_ptr<common::Arena> arena_; /**< Backs rows added by copy; outlives rows_ */
     std::vector<Tuple> rows_;
     uint64_t execution_time_us_ = 0;
     uint64_t rows_affected_ = 0;
+    uint64_t chunks_scanned_ = 0;
+    uint64_t chunks_skipped_ = 0;
     std::string error_message_;
     bool has_error_ = false;
 
    public:
     QueryResult() = default;
+    ~QueryResult() = default;
+    QueryResult(const QueryResult& other) = default;
+    QueryResult(QueryResult&& other) noexcept = default;
+    QueryResult& operator=(const QueryResult& other) {
+        if (this != &other) *this = QueryResult(other);
+        return *this;
+    }
+
+    /* Member-wise, except that the old rows go before the arena they may live in */
+    QueryResult& operator=(QueryResult&& other) noexcept {
+        if (this != &other) {
+            rows_.clear();
+            schema_ = std::move(other.schema_);
+            rows_ = std::move(other.rows_);
+            arena_ = std::move(other.arena_);
+            execution_time_us_ = other.execution_time_us_;
+            rows_affected_ = other.rows_affected_;
+            chunks_scanned_ = other.chunks_scanned_;
+            chunks_skipped_ = other.chunks_skipped_;
+            error_message_ = std::move(other.error_message_);
+            has_error_ = other.has_error_;
+        }
+        return *this;
+    }
 
     [[nodiscard]] bool success() const { return !has_error_; }
     [[nodiscard]] const std::string& error() const { return error_message_; }
@@ -420,7 +738,21 @@ class QueryResult {
     void set_schema(const Schema& schema) { schema_ = schema; }
     [[nodiscard]] const Schema& schema() const { return schema_; }
 
-    void add_row(const Tuple& row) { rows_.push_back(row); }
+    /**
+     * @brief Copies rows passed to add_row(const Tuple&) into `arena` rather than the heap
+     *
+     * The result shares ownership of the arena. Rows copied out of rows() are
+     * independent; rows moved out must not outlive the result.
+     */
+    void set_arena(std::shared_ptr<common::Arena> arena) { arena_ = std::move(arena); }
+
+    void add_row(const Tuple& row) {
+        if (arena_) {
+            rows_.emplace_back(row, arena_.get());
+        } else {
+            rows_.push_back(row);
+        }
+    }
     void add_row(Tuple&& row) { rows_.push_back(std::move(row)); }
     void add_rows(const std::vector<Tuple>& new_rows) {
         rows_.insert(rows_.end(), new_rows.begin(), new_rows.end());
@@ -435,6 +767,14 @@ class QueryResult {
 
     [[nodiscard]] uint64_t rows_affected() const { return rows_affected_; }
     void set_rows_affected(uint64_t count) { rows_affected_ = count; }
+
+    /** Columnar chunks read and skipped by zone maps while producing the result */
+    [[nodiscard]] uint64_t chunks_scanned() const { return chunks_scanned_; }
+    [[nodiscard]] uint64_t chunks_skipped() const { return chunks_skipped_; }
+    void set_chunk_stats(uint64_t scanned, uint64_t skipped) {
+        chunks_scanned_ = scanned;
+        chunks_skipped_ = skipped;
+    }
 };
 
 }  // namespace cloudsql::executor
@@ -0,0 +1,52 @@
+/**
+ * @file vector_hash.hpp
+ * @brief Hash functions shared by the vectorized hash tables
+ *
+ * Values that compare equal hash equally: -0.0 hashes as 0.0 and every NaN
+ * hashes alike. Multi-column keys fold column hashes together with combine().
+ */
+
+#ifndef CLOUDSQL_EXECUTOR_VECTOR_HASH_HPP
+#define CLOUDSQL_EXECUTOR_VECTOR_HASH_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+
+namespace cloudsql::executor::hashing {
+
+/** Stand-in hash for a NULL key column */
+constexpr uint64_t NULL_HASH = 0x6a09e667f3bcc909ULL;
+
+/** 64-bit finalizer (MurmurHash3 fmix64) */
+inline uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+inline uint64_t combine(uint64_t seed, uint64_t value) {
+    return mix(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+/** @return Bit pattern of `value` with -0.0 and all NaNs canonicalized */
+inline uint64_t double_bits(double value) {
+    if (value == 0.0) value = 0.0;
+    if (std::isnan(value)) return 0x7ff8000000000000ULL;
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline uint64_t string_hash(const std::string& value) {
+    return mix(std::hash<std::string>{}(value));
+}
+
+}  // namespace cloudsql::executor::hashing
+
+#endif  // CLOUDSQL_EXECUTOR_VECTOR_HASH_HPP
@@ -6,17 +6,34 @@
 #ifndef CLOUDSQL_EXECUTOR_VECTORIZED_OPERATOR_HPP
 #define CLOUDSQL_EXECUTOR_VECTORIZED_OPERATOR_HPP
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "common/memory_tracker.hpp"
+#include "executor/aggregate_hash_table.hpp"
+#include "executor/explain.hpp"
+#include "executor/join_hash_table.hpp"
+#include "executor/runtime_filter.hpp"
 #include "executor/types.hpp"
 #include "parser/expression.hpp"
 #include "storage/columnar_table.hpp"
+#include "storage/heap_table.hpp"
+#include "transaction/transaction.hpp"
 
 namespace cloudsql::executor {
 
+/**
+ * @brief Chunk pruning counters of the scans below an operator
+ */
+struct ScanStats {
+    uint64_t chunks_scanned = 0;
+    uint64_t chunks_skipped = 0;
+};
+
 /**
  * @brief Base class for vectorized operators (Batch-at-a-time)
  */
@@ -26,8 +43,15 @@ class VectorizedOperator {
     std::string error_message_;
     Schema output_schema_;
 
+   private:
+    std::unique_ptr<OperatorStats> stats_; /**< Kept when built inside an InstrumentScope */
+    std::unique_ptr<common::MemoryTracker> memory_; /**< Made inside a MemoryTracker::Scope */
+
    public:
-    explicit VectorizedOperator(Schema schema) : output_schema_(std::move(schema)) {}
+    explicit VectorizedOperator(Schema schema)
+        : output_schema_(std::move(schema)),
+          stats_(InstrumentScope::make_stats()),
+          memory_(common::MemoryTracker::make_child("operator")) {}
     virtual ~VectorizedOperator() = default;
 
     virtual bool init() { return true; }
@@ -37,30 +61,263 @@ class VectorizedOperator {
      * @brief Produce the next batch of results
      * @return true if a batch was produced, false if EOF or error
      */
-    virtual bool next_batch(VectorBatch& out_batch) = 0;
+    bool next_batch(VectorBatch& out_batch) {
+        if (!stats_) return next_batch_impl(out_batch);
+        const StatsTimer timer(*stats_);
+        if (!next_batch_impl(out_batch)) return false;
+        count_batch(out_batch);
+        return true;
+    }
+
+    /**
+     * @brief Produce the next batch, which may carry a selection vector
+     *
+     * Operators pulling from a child call this so a filter's selection reaches
+     * them unmaterialized; next_batch() is the pipeline boundary and returns
+     * dense batches.
+     */
+    bool next_selected_batch(VectorBatch& out_batch) {
+        if (!stats_) return next_selected_batch_impl(out_batch);
+        const StatsTimer timer(*stats_);
+        if (!next_selected_batch_impl(out_batch)) return false;
+        count_batch(out_batch);
+        return true;
+    }
 
     virtual void close() {}
 
+    /** @brief Add the counters of every scan in this subtree to `stats` */
+    virtual void collect_scan_stats(ScanStats& stats) const { static_cast<void>(stats); }
+
+    /**
+     * @brief Offers a join's runtime filter on output column `column` to the
+     * scan producing it, as Operator::push_runtime_filter() does
+     * @return true if a scan took the filter
+     */
+    virtual bool push_runtime_filter(std::shared_ptr<const RuntimeFilter> filter, size_t column) {
+        static_cast<void>(filter);
+        static_cast<void>(column);
+        return false;
+    }
+
+    /**
+     * @brief Tells the scan below that only output columns `columns` are read
+     * from this operator, so it can leave the others unread
+     *
+     * Operators that replace their child's columns (projections, aggregates)
+     * call it on their child. One that passes its child's columns through
+     * forwards the request, adding the columns it reads itself.
+     */
+    virtual void require_columns(const std::vector<size_t>& columns) {
+        static_cast<void>(columns);
+    }
+
+    /**
+     * @brief Adds the columns of `schema` that `expr` refers to to `out`
+     * @return false if `expr` names an unknown column or a kind of
+     * expression whose columns cannot be listed
+     */
+    static bool referenced_columns(  // NOLINT(misc-no-recursion)
+        const parser::Expression& expr, const Schema& schema, std::vector<size_t>& out) {
+        switch (expr.type()) {
+            case parser::ExprType::Constant:
+                return true;
+            case parser::ExprType::Column: {
+                const auto& column = dynamic_cast<const parser::ColumnExpr&>(expr);
+                size_t index = schema.find_column(column.to_string());
+                if (index == static_cast<size_t>(-1) && column.has_table()) {
+                    index = schema.find_column(column.name());
+                }
+                if (index == static_cast<size_t>(-1)) return false;
+                out.push_back(index);
+                return true;
+            }
+            case parser::ExprType::Binary: {
+                const auto& binary = dynamic_cast<const parser::BinaryExpr&>(expr);
+                return referenced_columns(binary.left(), schema, out) &&
+                       referenced_columns(binary.right(), schema, out);
+            }
+            case parser::ExprType::Unary:
+                return referenced_columns(dynamic_cast<const parser::UnaryExpr&>(expr).expr(),
+                                          schema, out);
+            case parser::ExprType::IsNull:
+                return referenced_columns(dynamic_cast<const parser::IsNullExpr&>(expr).expr(),
+                                          schema, out);
+            case parser::ExprType::In: {
+                const auto& in = dynamic_cast<const parser::InExpr&>(expr);
+                if (!referenced_columns(in.column(), schema, out)) return false;
+                return std::all_of(in.values().begin(), in.values().end(), [&](const auto& v) {
+                    return referenced_columns(*v, schema, out);
+                });
+            }
+            case parser::ExprType::Function: {
+                const auto& func = dynamic_cast<const parser::FunctionExpr&>(expr);
+                return std::all_of(func.args().begin(), func.args().end(), [&](const auto& arg) {
+                    return referenced_columns(*arg, schema, out);
+                });
+            }
+            default:
+                return false;
+        }
+    }
+
+    /** @return What EXPLAIN ANALYZE measured, or null outside an InstrumentScope */
+    [[nodiscard]] const OperatorStats* stats() const { return stats_.get(); }
+
+    /** @brief Describes this operator and, recursively, its children into `node` */
+    virtual void explain(ExplainNode& node) const {
+        node.label = "Vectorized Operator";
+        node.stats = stats();
+    }
+
     [[nodiscard]] Schema& output_schema() { return output_schema_; }
     [[nodiscard]] ExecState state() const { return state_; }
     [[nodiscard]] const std::string& error() const { return error_message_; }
 
    protected:
+    /*
+     * What next_batch() and next_selected_batch() do; they wrap these to keep
+     * stats(). An operator serving one from the other calls the _impl
+     * directly, so the batch is counted once.
+     */
+    virtual bool next_batch_impl(VectorBatch& out_batch) = 0;
+    virtual bool next_selected_batch_impl(VectorBatch& out_batch) {
+        return next_batch_impl(out_batch);
+    }
+
     void set_error(std::string msg) {
         error_message_ = std::move(msg);
         state_ = ExecState::Error;
     }
+
+    /**
+     * @brief Moves the memory this operator holds to `bytes`, as Operator::track_memory()
+     * @throws common::MemoryLimitError naming `consumer` if the query's limits refuse it
+     */
+    void track_memory(size_t bytes, const std::string& consumer) {
+        if (memory_) memory_->resize(bytes, consumer);
+    }
+
+   private:
+    void count_batch(const VectorBatch& batch) {
+        stats_->batches++;
+        stats_->rows += batch.selected_count();
+    }
 };
 
 /**
  * @brief Vectorized sequential scan operator for ColumnarTable
+ *
+ * Predicates pushed into the scan are tested against each chunk's zone maps;
+ * chunks that cannot match are skipped without being read. Rows of chunks that
+ * may match are returned unfiltered, so the pushed predicates are only a hint
+ * and a filter above the scan still has to evaluate them.
+ *
+ * A join's runtime filter, unlike a predicate, does drop rows: its key range
+ * is pushed as two predicates for chunk skipping, and rows of the chunks read
+ * whose key the filter rules out are deselected.
+ *
+ * set_row_range() limits the scan to a slice of the table, which is how the
+ * morsel scheduler hands a table out to several workers.
  */
 class VectorizedSeqScanOperator : public VectorizedOperator {
    private:
     std::string table_name_;
     std::shared_ptr<storage::ColumnarTable> table_;
     uint64_t current_row_ = 0;
+    uint64_t end_row_ = UINT64_MAX;
     uint32_t batch_size_ = 1024;
+    std::vector<storage::ColumnPredicate> predicates_;
+    size_t last_chunk_ = static_cast<size_t>(-1); /**< Chunk the previous batch ended in */
+    ScanStats stats_;
+    std::vector<std::pair<std::shared_ptr<const RuntimeFilter>, size_t>> runtime_filters_;
+    std::unique_ptr<NumericVector<bool>> filter_mask_;
+    uint64_t filtered_rows_ = 0;
+    NumericVector<bool> live_mask_{common::ValueType::TYPE_BOOL}; /**< Rows not deleted */
+
+    /* Late materialization: the filter's columns are read first, the rest at its survivors */
+    std::unique_ptr<parser::Expression> filter_;
+    std::vector<size_t> filter_columns_;
+    std::vector<bool> required_; /**< Columns read for the parent; empty = all */
+    std::vector<size_t> early_columns_;
+    std::vector<size_t> late_columns_;
+    uint64_t batch_start_ = 0;
+    uint64_t late_batches_skipped_ = 0;
+
+    /** @return true if batches are read in two steps rather than by read_batch() */
+    [[nodiscard]] bool late() const { return filter_ != nullptr || !required_.empty(); }
+
+    /** @brief Splits the columns read into those needed before and after filtering */
+    void plan_columns() {
+        const size_t count = output_schema_.column_count();
+        std::vector<bool> early(count, false);
+        for (const size_t column : filter_columns_) {
+            early[column] = true;
+        }
+        for (const auto& entry : runtime_filters_) {
+            early[entry.second] = true;
+        }
+        early_columns_.clear();
+        late_columns_.clear();
+        for (size_t column = 0; column < count; ++column) {
+            if (early[column]) {
+                early_columns_.push_back(column);
+            } else if (required_.empty() || required_[column]) {
+                late_columns_.push_back(column);
+            }
+        }
+    }
+
+    bool read_next(VectorBatch& out_batch) {
+        const uint64_t end_row = std::min(end_row_, table_->row_count());
+        while (current_row_ < end_row) {
+            const size_t chunk = table_->chunk_index(current_row_);
+            auto rows =
+                static_cast<uint32_t>(std::min<uint64_t>(batch_size_, end_row - current_row_));
+            if (!predicates_.empty()) {
+                if (chunk != last_chunk_ && !table_->chunk_may_match(chunk, predicates_)) {
+                    stats_.chunks_skipped++;
+                    last_chunk_ = chunk;
+                    current_row_ = table_->chunk_end_row(chunk);
+                    continue;
+                }
+                // Stop at the chunk boundary so the next chunk gets its own check
+                rows = static_cast<uint32_t>(std::min<uint64_t>(
+                    rows, table_->chunk_end_row(chunk) - current_row_));
+            }
+
+            const bool read = late() ? table_->read_columns(current_row_, rows, early_columns_,
+                                                            out_batch)
+                                     : table_->read_batch(current_row_, rows, out_batch);
+            if (!read) {
+                return false;
+            }
+            batch_start_ = current_row_;
+            const size_t last = table_->chunk_index(current_row_ + out_batch.row_count() - 1);
+            stats_.chunks_scanned += last - chunk + (chunk == last_chunk_ ? 0 : 1);
+            last_chunk_ = last;
+            current_row_ += out_batch.row_count();
+            return true;
+        }
+        return false;
+    }
+
+    /** @return Rows of `batch` left live after the runtime filters */
+    size_t apply_runtime_filters(VectorBatch& batch) {
+        const size_t before = batch.selected_count();
+        for (const auto& [filter, column] : runtime_filters_) {
+            const ColumnVector& keys = batch.get_column(column);
+            filter_mask_->clear();
+            filter_mask_->resize(batch.row_count());
+            uint8_t* const keep = filter_mask_->raw_data_mut();
+            batch.for_each_selected([&](size_t r) {
+                keep[r] = static_cast<uint8_t>(filter->may_contain(keys.get(r)));
+            });
+            if (batch.select_where(*filter_mask_) == 0) break;
+        }
+        filtered_rows_ += before - batch.selected_count();
+        return batch.selected_count();
+    }
 
    public:
     VectorizedSeqScanOperator(std::string table_name, std::shared_ptr<storage::ColumnarTable> table)
@@ -68,28 +325,305 @@ class VectorizedSeqScanOperator : public VectorizedOperator {
           table_name_(std::move(table_name)),
           table_(std::move(table)) {}
 
-    bool next_batch(VectorBatch& out_batch) override {
-        if (current_row_ >= table_->row_count()) {
+    /** @brief Restrict the scan to rows [begin, end) */
+    void set_row_range(uint64_t begin, uint64_t end) {
+        current_row_ = begin;
+        end_row_ = end;
+        last_chunk_ = static_cast<size_t>(-1);
+    }
+
+    void push_predicate(storage::ColumnPredicate predicate) {
+        predicates_.push_back(std::move(predicate));
+    }
+
+    [[nodiscard]] const std::vector<storage::ColumnPredicate>& predicates() const {
+        return predicates_;
+    }
+    [[nodiscard]] const ScanStats& scan_stats() const { return stats_; }
+
+    /** @return Rows the runtime filters dropped */
+    [[nodiscard]] uint64_t filtered_rows() const { return filtered_rows_; }
+
+    /** @return Batches the filter emptied before their other columns were read */
+    [[nodiscard]] uint64_t late_batches_skipped() const { return late_batches_skipped_; }
+
+    /**
+     * @brief Evaluates `filter` in the scan, between reading the columns it
+     * needs and the rest
+     *
+     * The other columns are then read only at the rows that pass, and not at
+     * all for a batch none pass. The batches returned carry the filter's
+     * selection, so the caller does not evaluate it again.
+     *
+     * @return false, leaving the scan as it was, if the columns `filter`
+     * reads cannot be listed
+     */
+    bool set_filter(std::unique_ptr<parser::Expression> filter) {
+        std::vector<size_t> columns;
+        if (!filter || filter_ || !referenced_columns(*filter, output_schema_, columns)) {
             return false;
         }
+        filter_ = std::move(filter);
+        filter_columns_ = std::move(columns);
+        if (!filter_mask_) {
+            filter_mask_ = std::make_unique<NumericVector<bool>>(common::ValueType::TYPE_BOOL);
+        }
+        plan_columns();
+        return true;
+    }
 
-        if (table_->read_batch(current_row_, batch_size_, out_batch)) {
-            current_row_ += out_batch.row_count();
+    /** @brief Columns not named by any call are left unread, holding default values */
+    void require_columns(const std::vector<size_t>& columns) override {
+        required_.resize(output_schema_.column_count(), false);
+        for (const size_t column : columns) {
+            if (column < required_.size()) required_[column] = true;
+        }
+        plan_columns();
+    }
+
+    bool push_runtime_filter(std::shared_ptr<const RuntimeFilter> filter,
+                             size_t column) override {
+        if (!filter || column >= output_schema_.column_count()) return false;
+        if (filter->key_count() > 0 && !filter->min().is_null()) {
+            push_predicate({column, storage::CompareOp::Ge, filter->min()});
+            push_predicate({column, storage::CompareOp::Le, filter->max()});
+        }
+        if (!filter_mask_) {
+            filter_mask_ = std::make_unique<NumericVector<bool>>(common::ValueType::TYPE_BOOL);
+        }
+        runtime_filters_.emplace_back(std::move(filter), column);
+        plan_columns();
+        return true;
+    }
+
+    void collect_scan_stats(ScanStats& stats) const override {
+        stats.chunks_scanned += stats_.chunks_scanned;
+        stats.chunks_skipped += stats_.chunks_skipped;
+    }
+
+    void explain(ExplainNode& node) const override {
+        node.label = "Vectorized Seq Scan on " + table_name_;
+        node.stats = stats();
+        if (!predicates_.empty()) {
+            node.details.push_back("Pushed Predicates: " + std::to_string(predicates_.size()));
+        }
+        if (table_->delta_rows() != 0 || table_->deleted_count() != 0) {
+            node.details.push_back("Delta Rows: " + std::to_string(table_->delta_rows()) +
+                                   " Deleted Rows: " + std::to_string(table_->deleted_count()));
+        }
+        if (stats() != nullptr) {
+            node.details.push_back("Chunks: scanned=" + std::to_string(stats_.chunks_scanned) +
+                                   " skipped=" + std::to_string(stats_.chunks_skipped));
+        }
+        if (filter_) {
+            node.details.push_back("Filter: " + filter_->to_string());
+        }
+        if (late()) {
+            node.details.push_back("Columns Read: " +
+                                   std::to_string(early_columns_.size() + late_columns_.size()) +
+                                   " of " + std::to_string(output_schema_.column_count()));
+            if (stats() != nullptr) {
+                node.details.push_back("Batches Skipped by Filter: " +
+                                       std::to_string(late_batches_skipped_));
+            }
+        }
+        if (!runtime_filters_.empty()) {
+            node.details.push_back("Runtime Filters: " + std::to_string(runtime_filters_.size()));
+            if (stats() != nullptr) {
+                node.details.push_back("Rows Removed by Runtime Filter: " +
+                                       std::to_string(filtered_rows_));
+            }
+        }
+    }
+
+    bool next_batch_impl(VectorBatch& out_batch) override {
+        if (!next_selected_batch_impl(out_batch)) return false;
+        out_batch.flatten();
+        return true;
+    }
+
+    /**
+     * @brief Reads the next batch, its selection narrowed by the runtime
+     * filters and the filter set by set_filter()
+     */
+    bool next_selected_batch_impl(VectorBatch& out_batch) override {
+        while (read_next(out_batch)) {
+            // Deleted rows keep their ids until the table is rebuilt; they are only masked
+            if (table_->live_mask(batch_start_, out_batch.row_count(), live_mask_) &&
+                out_batch.select_where(live_mask_) == 0) {
+                continue;
+            }
+            if (!runtime_filters_.empty() && apply_runtime_filters(out_batch) == 0) continue;
+            if (!late()) return true;
+
+            if (filter_) {
+                filter_mask_->clear();
+                filter_->evaluate_vectorized(out_batch, output_schema_, *filter_mask_);
+                if (out_batch.select_where(*filter_mask_) == 0) {
+                    late_batches_skipped_++;
+                    continue;
+                }
+            }
+            if (!late_columns_.empty() &&
+                !table_->fetch_columns(
+                    batch_start_, late_columns_,
+                    out_batch.has_selection() ? &out_batch.selection() : nullptr, out_batch)) {
+                return false;
+            }
             return true;
         }
         return false;
     }
 };
 
+/**
+ * @brief Vectorized sequential scan operator for a row-format HeapTable
+ *
+ * Pages are decoded straight into the column vectors of the batch (see
+ * HeapTable::Iterator::next_batch()) and each tuple version is checked for
+ * MVCC visibility against the transaction, as SeqScanOperator does. Columns
+ * are qualified with the table name, like the row scan's.
+ */
+class VectorizedHeapScanOperator : public VectorizedOperator {
+   private:
+    std::unique_ptr<storage::HeapTable> table_;
+    storage::HeapTable::Iterator iterator_;
+    storage::HeapTable::Iterator::VisibilityFn visible_;
+    size_t batch_size_ = 1024;
+
+    static Schema qualified_schema(const storage::HeapTable& table) {
+        Schema schema;
+        for (const auto& col : table.schema().columns()) {
+            schema.add_column(table.table_name() + "." + col.name(), col.type(), col.nullable());
+        }
+        return schema;
+    }
+
+   public:
+    /** @param txn Reader whose snapshot decides visibility; null shows only active tuples */
+    explicit VectorizedHeapScanOperator(std::unique_ptr<storage::HeapTable> table,
+                                        const transaction::Transaction* txn = nullptr)
+        : VectorizedOperator(qualified_schema(*table)),
+          table_(std::move(table)),
+          iterator_(*table_) {
+        if (txn != nullptr) {
+            visible_ = [txn](uint64_t xmin, uint64_t xmax) { return txn->can_see(xmin, xmax); };
+        } else {
+            visible_ = [](uint64_t xmin, uint64_t xmax) {
+                static_cast<void>(xmin);
+                return xmax == 0;
+            };
+        }
+    }
+
+    void explain(ExplainNode& node) const override {
+        node.label = "Vectorized Heap Scan on " + table_->table_name();
+        node.stats = stats();
+    }
+
+    bool next_batch_impl(VectorBatch& out_batch) override {
+        if (out_batch.column_count() == 0) {
+            out_batch.init_from_schema(output_schema_);
+        }
+        out_batch.clear();
+        try {
+            return iterator_.next_batch(out_batch, batch_size_, visible_);
+        } catch (const std::runtime_error& e) {
+            set_error(e.what());
+            return false;
+        }
+    }
+};
+
 /**
  * @brief Vectorized filter operator
+ *
+ * When the child is a VectorizedSeqScanOperator, the AND-ed column / constant
+ * comparisons and IS [NOT] NULL tests of the condition are pushed into it so
+ * it can skip chunks by their zone maps, and the whole condition is handed to
+ * it (VectorizedSeqScanOperator::set_filter()) so the columns the condition
+ * does not read are loaded only for the rows that pass.
  */
 class VectorizedFilterOperator : public VectorizedOperator {
    private:
     std::unique_ptr<VectorizedOperator> child_;
     std::unique_ptr<parser::Expression> condition_;
-    std::unique_ptr<VectorBatch> input_batch_;
-    std::unique_ptr<ColumnVector> selection_mask_;
+    std::unique_ptr<NumericVector<bool>> selection_mask_;
+    bool evaluated_by_child_ = false;
+
+    static bool to_compare_op(parser::TokenType token, bool flipped, storage::CompareOp* op) {
+        switch (token) {
+            case parser::TokenType::Eq:
+                *op = storage::CompareOp::Eq;
+                return true;
+            case parser::TokenType::Ne:
+                *op = storage::CompareOp::Ne;
+                return true;
+            case parser::TokenType::Lt:
+                *op = flipped ? storage::CompareOp::Gt : storage::CompareOp::Lt;
+                return true;
+            case parser::TokenType::Le:
+                *op = flipped ? storage::CompareOp::Ge : storage::CompareOp::Le;
+                return true;
+            case parser::TokenType::Gt:
+                *op = flipped ? storage::CompareOp::Lt : storage::CompareOp::Gt;
+                return true;
+            case parser::TokenType::Ge:
+                *op = flipped ? storage::CompareOp::Le : storage::CompareOp::Ge;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static size_t resolve_column(const parser::ColumnExpr& column, const Schema& schema) {
+        size_t index = schema.find_column(column.to_string());
+        if (index == static_cast<size_t>(-1) && column.has_table()) {
+            index = schema.find_column(column.name());
+        }
+        return index;
+    }
+
+    static void push_down(const parser::Expression& expr, VectorizedSeqScanOperator& scan) {
+        const Schema& schema = scan.output_schema();
+        if (expr.type() == parser::ExprType::IsNull) {
+            const auto& is_null = dynamic_cast<const parser::IsNullExpr&>(expr);
+            if (is_null.expr().type() != parser::ExprType::Column) return;
+            const size_t index =
+                resolve_column(dynamic_cast<const parser::ColumnExpr&>(is_null.expr()), schema);
+            if (index == static_cast<size_t>(-1)) return;
+            scan.push_predicate({index,
+                                 is_null.not_flag() ? storage::CompareOp::IsNotNull
+                                                    : storage::CompareOp::IsNull,
+                                 common::Value::make_null()});
+            return;
+        }
+        if (expr.type() != parser::ExprType::Binary) return;
+
+        const auto& binary = dynamic_cast<const parser::BinaryExpr&>(expr);
+        if (binary.op() == parser::TokenType::And) {
+            push_down(binary.left(), scan);
+            push_down(binary.right(), scan);
+            return;
+        }
+
+        const bool flipped = binary.left().type() == parser::ExprType::Constant &&
+                             binary.right().type() == parser::ExprType::Column;
+        const parser::Expression& col_side = flipped ? binary.right() : binary.left();
+        const parser::Expression& const_side = flipped ? binary.left() : binary.right();
+        if (col_side.type() != parser::ExprType::Column ||
+            const_side.type() != parser::ExprType::Constant) {
+            return;
+        }
+
+        storage::CompareOp op = storage::CompareOp::Eq;
+        if (!to_compare_op(binary.op(), flipped, &op)) return;
+        const size_t index =
+            resolve_column(dynamic_cast<const parser::ColumnExpr&>(col_side), schema);
+        if (index == static_cast<size_t>(-1)) return;
+        scan.push_predicate(
+            {index, op, static_cast<const parser::ConstantExpr&>(const_side).value()});
+    }
 
    public:
     VectorizedFilterOperator(std::unique_ptr<VectorizedOperator> child,
@@ -97,44 +631,60 @@ class VectorizedFilterOperator : public VectorizedOperator {
         : VectorizedOperator(child->output_schema()),
           child_(std::move(child)),
           condition_(std::move(condition)) {
-        input_batch_ = VectorBatch::create(child_->output_schema());
         selection_mask_ = std::make_unique<NumericVector<bool>>(common::ValueType::TYPE_BOOL);
+        if (auto* scan = dynamic_cast<VectorizedSeqScanOperator*>(child_.get())) {
+            push_down(*condition_, *scan);
+            evaluated_by_child_ = scan->set_filter(condition_->clone());
+        }
     }
 
-    bool next_batch(VectorBatch& out_batch) override {
-        out_batch.clear();
-        if (out_batch.column_count() == 0) {
-            out_batch.init_from_schema(output_schema_);
+    void collect_scan_stats(ScanStats& stats) const override { child_->collect_scan_stats(stats); }
+
+    /** @brief Forwards `columns` with those the condition reads */
+    void require_columns(const std::vector<size_t>& columns) override {
+        std::vector<size_t> needed = columns;
+        if (referenced_columns(*condition_, output_schema_, needed)) {
+            child_->require_columns(needed);
         }
+    }
 
-        while (child_->next_batch(*input_batch_)) {
-            selection_mask_->clear();
-            condition_->evaluate_vectorized(*input_batch_, child_->output_schema(),
-                                            *selection_mask_);
+    bool push_runtime_filter(std::shared_ptr<const RuntimeFilter> filter,
+                             size_t column) override {
+        return child_->push_runtime_filter(std::move(filter), column);
+    }
 
-            std::vector<size_t> selection;
-            for (size_t r = 0; r < input_batch_->row_count(); ++r) {
-                common::Value val = selection_mask_->get(r);
-                if (!val.is_null() && val.as_bool()) {
-                    selection.push_back(r);
-                }
-            }
+    void explain(ExplainNode& node) const override {
+        node.label = "Vectorized Filter";
+        node.stats = stats();
+        node.details.push_back("Condition: " + condition_->to_string());
+        child_->explain(node.add_child());
+    }
 
-            if (!selection.empty()) {
-                // Batch-level append optimization: iterate columns once
-                for (size_t c = 0; c < input_batch_->column_count(); ++c) {
-                    auto& src_col = input_batch_->get_column(c);
-                    auto& dest_col = out_batch.get_column(c);
-                    for (size_t r : selection) {
-                        dest_col.append(src_col.get(r));
-                    }
-                }
-                out_batch.set_row_count(out_batch.row_count() + selection.size());
-                input_batch_->clear();
+    bool next_batch_impl(VectorBatch& out_batch) override {
+        if (!next_selected_batch_impl(out_batch)) return false;
+        out_batch.flatten();
+        return true;
+    }
+
+    /**
+     * @brief Reads the child's batch into `out_batch` and narrows its selection
+     *
+     * The condition is evaluated over every physical row; rows are never copied.
+     * A scan that took the condition has already applied it.
+     */
+    bool next_selected_batch_impl(VectorBatch& out_batch) override {
+        while (child_->next_selected_batch(out_batch)) {
+            if (evaluated_by_child_) {
+                return true;
+            }
+            selection_mask_->clear();
+            condition_->evaluate_vectorized(out_batch, child_->output_schema(),
+                                            *selection_mask_);
+            if (out_batch.select_where(*selection_mask_) > 0) {
                 return true;
             }
-            input_batch_->clear();
         }
+        out_batch.clear();
         return false;
     }
 };
@@ -155,11 +705,40 @@ class VectorizedProjectOperator : public VectorizedOperator {
           child_(std::move(child)),
           expressions_(std::move(exprs)) {
         input_batch_ = VectorBatch::create(child_->output_schema());
+        std::vector<size_t> columns;
+        const bool listed = std::all_of(expressions_.begin(), expressions_.end(), [&](auto& e) {
+            return referenced_columns(*e, child_->output_schema(), columns);
+        });
+        if (listed) child_->require_columns(columns);
     }
 
-    bool next_batch(VectorBatch& out_batch) override {
+    void collect_scan_stats(ScanStats& stats) const override { child_->collect_scan_stats(stats); }
+
+    void explain(ExplainNode& node) const override {
+        node.label = "Vectorized Project";
+        node.stats = stats();
+        std::string output;
+        for (const auto& expr : expressions_) {
+            if (!output.empty()) output += ", ";
+            output += expr->to_string();
+        }
+        node.details.push_back("Output: " + output);
+        child_->explain(node.add_child());
+    }
+
+    bool next_batch_impl(VectorBatch& out_batch) override {
+        if (!next_selected_batch_impl(out_batch)) return false;
+        out_batch.flatten();
+        return true;
+    }
+
+    /**
+     * @brief Evaluates the projections over the child's physical rows and
+     * passes its selection through
+     */
+    bool next_selected_batch_impl(VectorBatch& out_batch) override {
         out_batch.clear();
-        if (child_->next_batch(*input_batch_)) {
+        if (child_->next_selected_batch(*input_batch_)) {
             // Pre-allocate result columns if out_batch is empty
             if (out_batch.column_count() == 0) {
                 out_batch.init_from_schema(output_schema_);
@@ -170,6 +749,9 @@ class VectorizedProjectOperator : public VectorizedOperator {
                                                      out_batch.get_column(i));
             }
             out_batch.set_row_count(input_batch_->row_count());
+            if (input_batch_->has_selection()) {
+                out_batch.set_selection(input_batch_->selection());
+            }
             input_batch_->clear();
             return true;
         }
@@ -177,14 +759,6 @@ class VectorizedProjectOperator : public VectorizedOperator {
     }
 };
 
-/**
- * @brief Aggregate specification for vectorized operator
- */
-struct VectorizedAggregateInfo {
-    AggregateType type;
-    int32_t input_col_idx;  // -1 for COUNT(*)
-};
-
 /**
  * @brief Vectorized global aggregate operator (no GROUP BY)
  */
@@ -208,38 +782,54 @@ class VectorizedAggregateOperator : public VectorizedOperator {
         results_double_.assign(aggregates_.size(), 0.0);
         has_value_.assign(aggregates_.size(), false);
         input_batch_ = VectorBatch::create(child_->output_schema());
+        std::vector<size_t> columns;
+        for (const auto& aggregate : aggregates_) {
+            if (aggregate.input_col_idx >= 0) {
+                columns.push_back(static_cast<size_t>(aggregate.input_col_idx));
+            }
+        }
+        child_->require_columns(columns);
     }
 
-    bool next_batch(VectorBatch& out_batch) override {
+    void collect_scan_stats(ScanStats& stats) const override { child_->collect_scan_stats(stats); }
+
+    void explain(ExplainNode& node) const override {
+        node.label = "Vectorized Aggregate";
+        node.stats = stats();
+        child_->explain(node.add_child());
+    }
+
+    bool next_batch_impl(VectorBatch& out_batch) override {
         if (done_) return false;
 
         // Process all input batches
-        while (child_->next_batch(*input_batch_)) {
+        while (child_->next_selected_batch(*input_batch_)) {
+            const VectorBatch& input = *input_batch_;
             for (size_t i = 0; i < aggregates_.size(); ++i) {
                 const auto& agg = aggregates_[i];
                 if (agg.type == AggregateType::Count) {
-                    results_int_[i] += input_batch_->row_count();
+                    results_int_[i] += input.selected_count();
                     has_value_[i] = true;
                 } else if (agg.type == AggregateType::Sum && agg.input_col_idx >= 0) {
                     auto& col = input_batch_->get_column(agg.input_col_idx);
                     if (col.type() == common::ValueType::TYPE_INT64) {
                         auto& num_col = dynamic_cast<NumericVector<int64_t>&>(col);
                         const int64_t* raw = num_col.raw_data();
-                        for (size_t r = 0; r < input_batch_->row_count(); ++r) {
+                        input.for_each_selected([&](size_t r) {
                             if (!num_col.is_null(r)) {
                                 results_int_[i] += raw[r];
                                 has_value_[i] = true;
                             }
-                        }
+                        });
                     } else if (col.type() == common::ValueType::TYPE_FLOAT64) {
                         auto& num_col = dynamic_cast<NumericVector<double>&>(col);
                         const double* raw = num_col.raw_data();
-                        for (size_t r = 0; r < input_batch_->row_count(); ++r) {
+                        input.for_each_selected([&](size_t r) {
                             if (!num_col.is_null(r)) {
                                 results_double_[i] += raw[r];
                                 has_value_[i] = true;
                             }
-                        }
+                        });
                     } else {
                         set_error("SUM: Unsupported column type " +
                                   std::to_string(static_cast<int>(col.type())));
@@ -277,6 +867,356 @@ class VectorizedAggregateOperator : public VectorizedOperator {
     }
 };
 
+/**
+ * @brief Vectorized hash aggregate operator (GROUP BY)
+ *
+ * Drains the child into an AggregateHashTable, then emits up to 1024 groups
+ * per batch: group keys followed by one column per aggregate. With no group
+ * columns it yields exactly one row. The table has no spill path: past the
+ * query's memory limit the query fails with a common::MemoryLimitError.
+ */
+class VectorizedHashAggregateOperator : public VectorizedOperator {
+   private:
+    static constexpr size_t EMIT_BATCH_SIZE = 1024;
+
+    std::unique_ptr<VectorizedOperator> child_;
+    AggregateHashTable table_;
+    std::unique_ptr<VectorBatch> input_batch_;
+    size_t next_group_ = 0;
+    bool built_ = false;
+
+   public:
+    VectorizedHashAggregateOperator(std::unique_ptr<VectorizedOperator> child,
+                                    std::vector<size_t> group_by, Schema out_schema,
+                                    std::vector<VectorizedAggregateInfo> aggregates)
+        : VectorizedOperator(std::move(out_schema)),
+          child_(std::move(child)),
+          table_(child_->output_schema(), std::move(group_by), std::move(aggregates)) {
+        input_batch_ = VectorBatch::create(child_->output_schema());
+        child_->require_columns(table_.input_columns());
+    }
+
+    /** @brief The table built so far; complete once next_batch() has returned true */
+    [[nodiscard]] const AggregateHashTable& table() const { return table_; }
+
+    void collect_scan_stats(ScanStats& stats) const override { child_->collect_scan_stats(stats); }
+
+    void explain(ExplainNode& node) const override {
+        node.label = "Vectorized HashAggregate";
+        node.stats = stats();
+        if (built_) {
+            node.details.push_back("Groups: " + std::to_string(table_.group_count()));
+        }
+        child_->explain(node.add_child());
+    }
+
+    bool next_batch_impl(VectorBatch& out_batch) override {
+        if (!built_) {
+            try {
+                while (child_->next_selected_batch(*input_batch_)) {
+                    table_.add_batch(*input_batch_);
+                    input_batch_->clear();
+                    track_memory(table_.memory_bytes(), "Vectorized HashAggregate");
+                }
+            } catch (const common::MemoryLimitError&) {
+                throw;
+            } catch (const std::runtime_error& e) {
+                set_error(e.what());
+                return false;
+            }
+            built_ = true;
+        }
+        if (next_group_ >= table_.group_count()) return false;
+
+        if (out_batch.column_count() == 0) {
+            out_batch.init_from_schema(output_schema_);
+        }
+        try {
+            table_.emit(next_group_, EMIT_BATCH_SIZE, out_batch);
+        } catch (const std::runtime_error& e) {
+            set_error(e.what());
+            return false;
+        }
+        next_group_ += out_batch.row_count();
+        return true;
+    }
+};
+
+/**
+ * @brief Vectorized equi-join: builds a JoinHashTable from the right child and
+ * probes it with whole batches of the left child
+ *
+ * Inner and left joins gather the matching (probe, build) row pairs into
+ * dense output batches of up to 1024 rows: left columns, then right columns
+ * (nullable for a left join). Semi and anti joins output only the left
+ * columns and pass the probe batch through with a narrowed selection. An
+ * anti join keeps left rows with a NULL key, as NOT EXISTS does. Right and
+ * full joins are not supported.
+ *
+ * Inner and semi joins on one key column offer a RuntimeFilter of the build
+ * keys to the probe side once the table is built, which lets a columnar scan
+ * skip chunks outside the keys' range and drop rows that cannot match.
+ *
+ * The build side is held in memory whole; past the query's memory limit the
+ * query fails with a common::MemoryLimitError.
+ */
+class VectorizedHashJoinOperator : public VectorizedOperator {
+   private:
+    static constexpr size_t OUTPUT_BATCH_SIZE = 1024;
+    static constexpr size_t NO_KEY = static_cast<size_t>(-1);
+
+    std::unique_ptr<VectorizedOperator> probe_;
+    std::unique_ptr<VectorizedOperator> build_;
+    JoinType join_type_;
+    size_t probe_key_; /**< The key column of a single-column join, else NO_KEY */
+    size_t build_key_;
+    JoinHashTable table_;
+    bool built_ = false;
+    std::shared_ptr<const RuntimeFilter> runtime_filter_;
+
+    /* Inner / left probe state: the current probe batch and the position in it */
+    std::unique_ptr<VectorBatch> probe_batch_;
+    std::vector<uint32_t> live_rows_;
+    size_t live_pos_ = 0;
+    uint32_t match_ = JoinHashTable::NO_MATCH;
+    bool row_started_ = false;
+    bool row_matched_ = false;
+    bool have_probe_batch_ = false;
+    std::vector<uint32_t> probe_rows_;
+    std::vector<uint32_t> build_rows_;
+    std::unique_ptr<NumericVector<bool>> keep_mask_;
+
+    static Schema join_schema(const Schema& probe, const Schema& build, JoinType type) {
+        if (type == JoinType::Right || type == JoinType::Full) {
+            throw std::runtime_error("VectorizedHashJoin: RIGHT and FULL joins are not supported");
+        }
+        Schema schema;
+        for (const auto& col : probe.columns()) schema.add_column(col);
+        if (type == JoinType::Semi || type == JoinType::Anti) return schema;
+        for (const auto& col : build.columns()) {
+            auto col_meta = col;
+            if (type == JoinType::Left) col_meta.set_nullable(true);
+            schema.add_column(col_meta);
+        }
+        return schema;
+    }
+
+    bool build_table() {
+        if (built_) return true;
+        auto batch = VectorBatch::create(build_->output_schema());
+        try {
+            while (build_->next_selected_batch(*batch)) {
+                table_.add_batch(*batch);
+                batch->clear();
+                track_memory(table_.memory_bytes(), "Vectorized Hash Join");
+            }
+        } catch (const common::MemoryLimitError&) {
+            throw;
+        } catch (const std::runtime_error& e) {
+            set_error(e.what());
+            return false;
+        }
+        built_ = true;
+        push_build_filter();
+        return true;
+    }
+
+    void push_build_filter() {
+        if ((join_type_ != JoinType::Inner && join_type_ != JoinType::Semi) ||
+            probe_key_ == NO_KEY) {
+            return;
+        }
+        auto filter = std::make_shared<RuntimeFilter>(table_.row_count());
+        if (table_.row_count() > 0) {
+            const ColumnVector& keys = table_.rows().get_column(build_key_);
+            for (size_t r = 0; r < table_.row_count(); ++r) filter->add(keys.get(r));
+        }
+        if (probe_->push_runtime_filter(filter, probe_key_)) {
+            runtime_filter_ = std::move(filter);
+        }
+    }
+
+    /** @brief Pairs up rows of the current probe batch until the output batch is full */
+    void collect_pairs() {
+        while (live_pos_ < live_rows_.size() && probe_rows_.size() < OUTPUT_BATCH_SIZE) {
+            const uint32_t row = live_rows_[live_pos_];
+            if (!row_started_) {
+                match_ = table_.first_match(row);
+                row_started_ = true;
+                row_matched_ = false;
+            }
+            while (match_ != JoinHashTable::NO_MATCH && probe_rows_.size() < OUTPUT_BATCH_SIZE) {
+                probe_rows_.push_back(row);
+                build_rows_.push_back(match_);
+                row_matched_ = true;
+                match_ = table_.next_match(match_, row);
+            }
+            if (match_ != JoinHashTable::NO_MATCH) return;
+            if (join_type_ == JoinType::Left && !row_matched_) {
+                if (probe_rows_.size() >= OUTPUT_BATCH_SIZE) return;
+                probe_rows_.push_back(row);
+                build_rows_.push_back(JoinHashTable::NO_MATCH);
+            }
+            row_started_ = false;
+            ++live_pos_;
+        }
+    }
+
+    void emit_pairs(VectorBatch& out_batch) {
+        const size_t count = probe_rows_.size();
+        const size_t probe_columns = probe_batch_->column_count();
+        for (size_t c = 0; c < probe_columns; ++c) {
+            static_cast<void>(out_batch.get_column(c).gather_from(probe_batch_->get_column(c),
+                                                                  probe_rows_.data(), count));
+        }
+
+        // Unmatched left rows gather build row 0 and are then masked as NULL
+        const bool any_missing =
+            std::find(build_rows_.begin(), build_rows_.end(), JoinHashTable::NO_MATCH) !=
+            build_rows_.end();
+        const VectorBatch& build_rows = table_.rows();
+        for (size_t c = 0; c < build_rows.column_count(); ++c) {
+            ColumnVector& target = out_batch.get_column(probe_columns + c);
+            if (table_.row_count() == 0) {
+                for (size_t i = 0; i < count; ++i) target.append(common::Value::make_null());
+                continue;
+            }
+            if (!any_missing) {
+                static_cast<void>(
+                    target.gather_from(build_rows.get_column(c), build_rows_.data(), count));
+                continue;
+            }
+            std::vector<uint32_t> indices(build_rows_);
+            for (auto& index : indices) {
+                if (index == JoinHashTable::NO_MATCH) index = 0;
+            }
+            static_cast<void>(
+                target.gather_from(build_rows.get_column(c), indices.data(), count));
+            for (size_t i = 0; i < count; ++i) {
+                if (build_rows_[i] == JoinHashTable::NO_MATCH) target.set_null(i, true);
+            }
+        }
+        out_batch.set_row_count(count);
+        probe_rows_.clear();
+        build_rows_.clear();
+    }
+
+   public:
+    /**
+     * @param probe Left input, streamed
+     * @param build Right input, materialized into the hash table
+     * @param probe_keys / build_keys Equi-join key columns, pairwise
+     * @throws std::runtime_error for RIGHT / FULL joins or mismatched keys
+     */
+    VectorizedHashJoinOperator(std::unique_ptr<VectorizedOperator> probe,
+                               std::unique_ptr<VectorizedOperator> build,
+                               std::vector<size_t> probe_keys, std::vector<size_t> build_keys,
+                               JoinType join_type = JoinType::Inner)
+        : VectorizedOperator(
+              join_schema(probe->output_schema(), build->output_schema(), join_type)),
+          probe_(std::move(probe)),
+          build_(std::move(build)),
+          join_type_(join_type),
+          probe_key_(probe_keys.size() == 1 ? probe_keys[0] : NO_KEY),
+          build_key_(build_keys.size() == 1 ? build_keys[0] : NO_KEY),
+          table_(build_->output_schema(), std::move(build_keys), probe_->output_schema(),
+                 std::move(probe_keys)) {
+        probe_batch_ = VectorBatch::create(probe_->output_schema());
+        keep_mask_ = std::make_unique<NumericVector<bool>>(common::ValueType::TYPE_BOOL);
+    }
+
+    [[nodiscard]] JoinType join_type() const { return join_type_; }
+
+    void collect_scan_stats(ScanStats& stats) const override {
+        probe_->collect_scan_stats(stats);
+        build_->collect_scan_stats(stats);
+    }
+
+    /** @brief Forwards filters on probe columns, which lead the output */
+    bool push_runtime_filter(std::shared_ptr<const RuntimeFilter> filter,
+                             size_t column) override {
+        if (column >= probe_->output_schema().column_count()) return false;
+        return probe_->push_runtime_filter(std::move(filter), column);
+    }
+
+    void explain(ExplainNode& node) const override {
+        node.label = std::string("Vectorized Hash ") + join_type_name(join_type_) + " Join";
+        node.stats = stats();
+        if (built_) {
+            node.details.push_back("Build Rows: " + std::to_string(table_.row_count()));
+        }
+        if (runtime_filter_) {
+            node.details.push_back("Runtime Filter: " +
+                                   probe_->output_schema().get_column(probe_key_).name());
+        }
+        probe_->explain(node.add_child());
+        build_->explain(node.add_child());
+    }
+
+    bool next_batch_impl(VectorBatch& out_batch) override {
+        if (join_type_ == JoinType::Semi || join_type_ == JoinType::Anti) {
+            if (!next_selected_batch_impl(out_batch)) return false;
+            out_batch.flatten();
+            return true;
+        }
+        if (!build_table()) return false;
+
+        out_batch.clear();
+        if (out_batch.column_count() == 0) {
+            out_batch.init_from_schema(output_schema_);
+        }
+        while (true) {
+            if (!have_probe_batch_) {
+                probe_batch_->clear();
+                if (!probe_->next_selected_batch(*probe_batch_)) return false;
+                table_.begin_probe(*probe_batch_);
+                live_rows_.clear();
+                probe_batch_->for_each_selected(
+                    [this](size_t r) { live_rows_.push_back(static_cast<uint32_t>(r)); });
+                live_pos_ = 0;
+                row_started_ = false;
+                have_probe_batch_ = true;
+            }
+            collect_pairs();
+            const bool exhausted = live_pos_ >= live_rows_.size();
+            if (!probe_rows_.empty()) {
+                emit_pairs(out_batch);
+                have_probe_batch_ = !exhausted;
+                return true;
+            }
+            if (exhausted) have_probe_batch_ = false;
+        }
+    }
+
+    /**
+     * @brief Semi / anti joins: reads the probe batch into `out_batch` and
+     * keeps the rows with (without) a match as its selection
+     */
+    bool next_selected_batch_impl(VectorBatch& out_batch) override {
+        if (join_type_ != JoinType::Semi && join_type_ != JoinType::Anti) {
+            return next_batch_impl(out_batch);
+        }
+        if (!build_table()) return false;
+
+        const bool want_match = join_type_ == JoinType::Semi;
+        while (probe_->next_selected_batch(out_batch)) {
+            table_.begin_probe(out_batch);
+            keep_mask_->clear();
+            keep_mask_->resize(out_batch.row_count());
+            uint8_t* const keep = keep_mask_->raw_data_mut();
+            out_batch.for_each_selected([&](size_t r) {
+                const bool matched = table_.first_match(r) != JoinHashTable::NO_MATCH;
+                keep[r] = static_cast<uint8_t>(matched == want_match);
+            });
+            if (out_batch.select_where(*keep_mask_) > 0) {
+                return true;
+            }
+        }
+        out_batch.clear();
+        return false;
+    }
+};
+
 }  // namespace cloudsql::executor
 
 #endif  // CLOUDSQL_EXECUTOR_VECTORIZED_OPERATOR_HPP
@@ -0,0 +1,53 @@
+/**
+ * @file columnar_codec.hpp
+ * @brief Column-at-a-time wire encoding of result rows
+ *
+ * Rows are transposed into the layout VectorBatch uses: each column is sent
+ * as one run of values plus a null bitmap, instead of a type tag in front of
+ * every value. Per column:
+ *
+ *   uint8 kind, uint8 has_nulls, [null bitmap, one bit per row, set = NULL]
+ *   Int64 / Float64  row_count 8-byte values (0 in NULL rows)
+ *   Bool             row_count bytes
+ *   Text             row_count + 1 uint32 offsets, then the string bytes
+ *   Null             nothing
+ *   Mixed            one Serializer value per row, for columns without a common kind
+ *
+ * Values come back as the row format returns them: integers and decimals as
+ * INT64, floats as FLOAT64 and character types as TEXT.
+ */
+
+#ifndef SQL_ENGINE_NETWORK_COLUMNAR_CODEC_HPP
+#define SQL_ENGINE_NETWORK_COLUMNAR_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "executor/types.hpp"
+
+namespace cloudsql::network {
+
+/**
+ * First four bytes of a payload in the columnar format. No row-format payload
+ * starts with them: those open with a status byte or a string length.
+ */
+constexpr uint32_t COLUMNAR_MARKER = 0xFFFFFFFFU;
+
+/**
+ * @brief Appends `rows` in the columnar encoding
+ *
+ * Rows shorter than the widest one are padded with NULLs.
+ */
+void encode_columnar_rows(const std::vector<executor::Tuple>& rows, std::vector<uint8_t>& out);
+
+/**
+ * @brief Decodes rows written by encode_columnar_rows() starting at `offset`
+ * @return false if the data is truncated or malformed; `offset` is then unspecified
+ */
+[[nodiscard]] bool decode_columnar_rows(const uint8_t* data, size_t& offset, size_t size,
+                                        std::vector<executor::Tuple>& rows);
+
+}  // namespace cloudsql::network
+
+#endif  // SQL_ENGINE_NETWORK_COLUMNAR_CODEC_HPP
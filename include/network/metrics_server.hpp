@@ -0,0 +1,57 @@
+/**
+ * @file metrics_server.hpp
+ * @brief HTTP endpoint serving the metrics registry and trace buffer
+ */
+
+#ifndef SQL_ENGINE_NETWORK_METRICS_SERVER_HPP
+#define SQL_ENGINE_NETWORK_METRICS_SERVER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace cloudsql::network {
+
+/**
+ * @brief Minimal HTTP/1.0 server for `GET /metrics` and `GET /traces`
+ *
+ * One thread accepts connections and answers each in turn, closing it after
+ * the response: scrapes are infrequent and small, so there is nothing to gain
+ * from keep-alive or concurrency. `/metrics` is MetricsRegistry::global() in
+ * the Prometheus text format and `/traces` the node's buffered spans as
+ * OTLP/JSON, for a collector to pull; any other path gets a 404.
+ */
+class MetricsServer {
+   public:
+    /** @param port Port to listen on; 0 picks a free one, reported by port() */
+    explicit MetricsServer(uint16_t port) : port_(port) {}
+    ~MetricsServer() { stop(); }
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+    MetricsServer(MetricsServer&&) = delete;
+    MetricsServer& operator=(MetricsServer&&) = delete;
+
+    bool start();
+    void stop();
+
+    [[nodiscard]] uint16_t port() const { return port_; }
+
+    /** @brief The full HTTP response to a request line such as "GET /metrics HTTP/1.1" */
+    [[nodiscard]] static std::string respond(const std::string& request_line);
+
+   private:
+    void accept_loop();
+    void serve(int fd) const;
+
+    uint16_t port_;
+    int listen_fd_ = -1;
+    int wake_fd_ = -1; /**< eventfd that interrupts the accept wait on stop() */
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+}  // namespace cloudsql::network
+
+#endif  // SQL_ENGINE_NETWORK_METRICS_SERVER_HPP
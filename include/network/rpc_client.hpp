@@ -6,42 +6,137 @@
 #ifndef SQL_ENGINE_NETWORK_RPC_CLIENT_HPP
 #define SQL_ENGINE_NETWORK_RPC_CLIENT_HPP
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "common/trace.hpp"
 #include "network/rpc_message.hpp"
 
 namespace cloudsql::network {
 
+/**
+ * @brief Outcome of an asynchronous call
+ */
+struct RpcResult {
+    bool ok = false; /**< false if the request could not be sent or the connection broke */
+    std::vector<uint8_t> response;
+};
+
+using RpcCallback = std::function<void(RpcResult)>;
+
 /**
  * @brief Client for sending internal cluster RPCs
+ *
+ * Thread-safe: calls from several threads share the connection and are in
+ * flight together. Each request carries an id that the server echoes; one of
+ * the waiting callers reads responses off the socket and hands every one to
+ * the call it answers. Asynchronous calls start a reader thread of their own
+ * the first time one is made.
  */
 class RpcClient {
    public:
     RpcClient(const std::string& address, uint16_t port);
     ~RpcClient();
 
+    // Prevent copying
+    RpcClient(const RpcClient&) = delete;
+    RpcClient& operator=(const RpcClient&) = delete;
+
     bool connect();
     void disconnect();
     bool is_connected() const { return fd_ >= 0; }
 
+    /**
+     * @brief Whether the connection is up and the peer has not closed it
+     */
+    [[nodiscard]] bool healthy() const;
+
+    /**
+     * @brief Whether the server offered `capability` (an RpcHeader::FLAG_ACCEPT_* bit)
+     *
+     * Known once a response has come back on the current connection; until
+     * then nothing is offered. Requests are compressed once the server accepts
+     * LZ4; payload encodings are up to the caller.
+     */
+    [[nodiscard]] bool peer_accepts(uint8_t capability) const;
+
     /**
      * @brief Send a request and wait for a response
      */
     bool call(RpcType type, const std::vector<uint8_t>& payload, std::vector<uint8_t>& response_out,
               uint16_t group_id = 0);
 
+    /**
+     * @brief Send a request now and run `callback` with the response
+     *
+     * The callback runs on whichever thread reads the response, or on the
+     * calling thread if the request cannot be sent; it should not block.
+     */
+    void call_async(RpcType type, const std::vector<uint8_t>& payload, RpcCallback callback,
+                    uint16_t group_id = 0);
+
+    /**
+     * @brief Send a request now; the future is ready once the response is in
+     */
+    std::future<RpcResult> call_async(RpcType type, const std::vector<uint8_t>& payload,
+                                      uint16_t group_id = 0);
+
     /**
      * @brief Send a request without waiting for a response
      */
     bool send_only(RpcType type, const std::vector<uint8_t>& payload, uint16_t group_id = 0);
 
    private:
+    struct PendingCall {
+        std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+        bool done = false;
+        bool failed = false;
+        std::vector<uint8_t> response;
+        RpcCallback callback; /**< Set for asynchronous calls, which nobody waits on */
+        common::SpanRecord span; /**< The call's span if it is traced, recorded when it ends */
+    };
+
+    using Completions = std::vector<std::pair<RpcCallback, RpcResult>>;
+
+    bool connect_locked();
+    /** @brief Assigns a free request id and writes the request frame; mutex_ is held */
+    bool send_request(RpcHeader& header, const std::vector<uint8_t>& payload);
+    /** @brief Sends a request expecting a response and records it in pending_; mutex_ is held */
+    std::shared_ptr<PendingCall> start_call(RpcType type, const std::vector<uint8_t>& payload,
+                                            uint16_t group_id);
+    /**
+     * @brief Receives one response and completes its call; `lock` holds mutex_
+     * @param done Asynchronous calls completed, to run once the lock is released
+     */
+    void read_response(std::unique_lock<std::mutex>& lock, Completions& done);
+    /** @brief Fails every call in flight after the connection broke; mutex_ is held */
+    void fail_pending(Completions& done);
+    /** @brief Records the span of a traced call that has ended */
+    static void end_span(PendingCall& call, bool ok);
+    void reader_loop();
+    static void run(Completions& done);
+
     std::string address_;
     uint16_t port_;
     int fd_ = -1;
     mutable std::mutex mutex_;
+    std::condition_variable response_cv_;
+    uint16_t next_request_id_ = 0;
+    /** Calls in flight, oldest first */
+    std::vector<std::pair<uint16_t, std::shared_ptr<PendingCall>>> pending_;
+    bool reading_ = false; /**< A thread is receiving on behalf of all of pending_ */
+    std::thread reader_;    /**< Started by the first asynchronous call */
+    bool reader_stop_ = false;
+    uint8_t peer_flags_ = 0; /**< FLAG_ACCEPT_* bits of the server's last response */
 };
 
 }  // namespace cloudsql::network
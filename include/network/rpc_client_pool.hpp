@@ -0,0 +1,79 @@
+/**
+ * @file rpc_client_pool.hpp
+ * @brief Per-node pool of connected RPC clients
+ */
+
+#ifndef SQL_ENGINE_NETWORK_RPC_CLIENT_POOL_HPP
+#define SQL_ENGINE_NETWORK_RPC_CLIENT_POOL_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "network/rpc_client.hpp"
+
+namespace cloudsql::network {
+
+/**
+ * @brief Keeps connections to other nodes open between calls
+ *
+ * Each node gets up to `clients_per_node` connections, handed out in turn.
+ * RpcClient multiplexes, so callers share a connection rather than borrow it;
+ * more than one only keeps a large response from holding up everything else
+ * to that node. A connection is checked before it is handed out and replaced
+ * if it broke or the peer closed it; connections unused for `idle_timeout`
+ * are closed.
+ */
+class RpcClientPool {
+   public:
+    static constexpr size_t DEFAULT_CLIENTS_PER_NODE = 2;
+    static constexpr std::chrono::seconds DEFAULT_IDLE_TIMEOUT{60};
+
+    explicit RpcClientPool(size_t clients_per_node = DEFAULT_CLIENTS_PER_NODE,
+                           std::chrono::milliseconds idle_timeout = DEFAULT_IDLE_TIMEOUT)
+        : clients_per_node_(clients_per_node == 0 ? 1 : clients_per_node),
+          idle_timeout_(idle_timeout) {}
+
+    /**
+     * @return A connected client for `address`:`port`, or nullptr if the node
+     * cannot be reached
+     */
+    [[nodiscard]] std::shared_ptr<RpcClient> get(const std::string& address, uint16_t port);
+
+    /** @brief Closes the connections to one node, e.g. when it leaves the cluster */
+    void remove(const std::string& address, uint16_t port);
+
+    void clear();
+
+    /** @return Number of open connections, over all nodes */
+    [[nodiscard]] size_t size() const;
+
+   private:
+    struct Slot {
+        std::shared_ptr<RpcClient> client;
+        std::chrono::steady_clock::time_point last_used;
+    };
+
+    struct Node {
+        std::vector<Slot> slots;
+        size_t next = 0; /**< Slot to hand out next */
+    };
+
+    /** @brief Moves out connections nobody holds that went unused for idle_timeout_ */
+    void prune_idle(std::chrono::steady_clock::time_point now,
+                    std::vector<std::shared_ptr<RpcClient>>& expired);
+
+    size_t clients_per_node_;
+    std::chrono::milliseconds idle_timeout_;
+    std::unordered_map<std::string, Node> nodes_; /**< By "address:port" */
+    mutable std::mutex mutex_;
+};
+
+}  // namespace cloudsql::network
+
+#endif  // SQL_ENGINE_NETWORK_RPC_CLIENT_POOL_HPP
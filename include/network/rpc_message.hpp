@@ -8,13 +8,20 @@
 
 #include <arpa/inet.h>
 
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "common/lz4.hpp"
 #include "common/value.hpp"
+#include "distributed/raft_types.hpp"
+#include "executor/runtime_filter.hpp"
 #include "executor/types.hpp"
+#include "network/columnar_codec.hpp"
 
 namespace cloudsql::network {
 
@@ -33,9 +40,55 @@ enum class RpcType : uint8_t {
     TxnAbort = 8,
     PushData = 9,
     ShuffleFragment = 10,
+    CancelFragment = 11,
+    InstallSnapshot = 12,
+    ReadIndex = 13,
+    GroupHeartbeat = 14,
+    KeyFilter = 15,
     Error = 255
 };
 
+/** @return The name of `type`, as traces label RPCs */
+inline const char* rpc_type_name(RpcType type) {
+    switch (type) {
+        case RpcType::Heartbeat:
+            return "Heartbeat";
+        case RpcType::RegisterNode:
+            return "RegisterNode";
+        case RpcType::RequestVote:
+            return "RequestVote";
+        case RpcType::AppendEntries:
+            return "AppendEntries";
+        case RpcType::ExecuteFragment:
+            return "ExecuteFragment";
+        case RpcType::QueryResults:
+            return "QueryResults";
+        case RpcType::TxnPrepare:
+            return "TxnPrepare";
+        case RpcType::TxnCommit:
+            return "TxnCommit";
+        case RpcType::TxnAbort:
+            return "TxnAbort";
+        case RpcType::PushData:
+            return "PushData";
+        case RpcType::ShuffleFragment:
+            return "ShuffleFragment";
+        case RpcType::CancelFragment:
+            return "CancelFragment";
+        case RpcType::InstallSnapshot:
+            return "InstallSnapshot";
+        case RpcType::ReadIndex:
+            return "ReadIndex";
+        case RpcType::GroupHeartbeat:
+            return "GroupHeartbeat";
+        case RpcType::KeyFilter:
+            return "KeyFilter";
+        case RpcType::Error:
+            return "Error";
+    }
+    return "Unknown";
+}
+
 /**
  * @brief Serialization utilities for Common types
  */
@@ -158,6 +211,111 @@ class Serializer {
         return executor::Tuple(std::move(values));
     }
 
+    /**
+     * @brief Appends a count and the rows, tuple by tuple or in the columnar encoding
+     */
+    static void serialize_rows(const std::vector<executor::Tuple>& rows, std::vector<uint8_t>& out,
+                               bool columnar) {
+        if (columnar) {
+            encode_columnar_rows(rows, out);
+            return;
+        }
+        const auto row_count = static_cast<uint32_t>(rows.size());
+        const size_t offset = out.size();
+        out.resize(offset + VAL_SIZE_32);
+        std::memcpy(out.data() + offset, &row_count, VAL_SIZE_32);
+        for (const auto& row : rows) {
+            serialize_tuple(row, out);
+        }
+    }
+
+    static std::vector<executor::Tuple> deserialize_rows(const uint8_t* data, size_t& offset,
+                                                         size_t size, bool columnar) {
+        std::vector<executor::Tuple> rows;
+        if (columnar) {
+            if (!decode_columnar_rows(data, offset, size, rows)) {
+                rows.clear();
+            }
+            return rows;
+        }
+        uint32_t row_count = 0;
+        if (offset + VAL_SIZE_32 <= size) {
+            std::memcpy(&row_count, data + offset, VAL_SIZE_32);
+            offset += VAL_SIZE_32;
+        }
+        rows.reserve(row_count);
+        for (uint32_t i = 0; i < row_count; ++i) {
+            rows.push_back(deserialize_tuple(data, offset, size));
+        }
+        return rows;
+    }
+
+    /** @brief Writes COLUMNAR_MARKER, which opens a payload in the columnar format */
+    static void serialize_columnar_marker(std::vector<uint8_t>& out) {
+        const size_t offset = out.size();
+        out.resize(offset + VAL_SIZE_32);
+        std::memcpy(out.data() + offset, &COLUMNAR_MARKER, VAL_SIZE_32);
+    }
+
+    /** @return Whether `in` opens with COLUMNAR_MARKER; `offset` is moved past it if so */
+    static bool deserialize_columnar_marker(const std::vector<uint8_t>& in, size_t& offset) {
+        if (in.size() < VAL_SIZE_32 || std::memcmp(in.data(), &COLUMNAR_MARKER, VAL_SIZE_32) != 0) {
+            return false;
+        }
+        offset = VAL_SIZE_32;
+        return true;
+    }
+
+    static void serialize_u32(uint32_t v, std::vector<uint8_t>& out) {
+        const size_t offset = out.size();
+        out.resize(offset + VAL_SIZE_32);
+        std::memcpy(out.data() + offset, &v, VAL_SIZE_32);
+    }
+
+    static uint32_t deserialize_u32(const uint8_t* data, size_t& offset, size_t size) {
+        uint32_t v = 0;
+        if (offset + VAL_SIZE_32 <= size) {
+            std::memcpy(&v, data + offset, VAL_SIZE_32);
+            offset += VAL_SIZE_32;
+        }
+        return v;
+    }
+
+    /** @brief Writes a RuntimeFilter: key count, bit words, then the key range */
+    static void serialize_runtime_filter(const executor::RuntimeFilter& filter,
+                                         std::vector<uint8_t>& out) {
+        const uint64_t keys = filter.key_count();
+        const auto& words = filter.words();
+        size_t offset = out.size();
+        out.resize(offset + VAL_SIZE_64);
+        std::memcpy(out.data() + offset, &keys, VAL_SIZE_64);
+        serialize_u32(static_cast<uint32_t>(words.size()), out);
+        offset = out.size();
+        out.resize(offset + words.size() * VAL_SIZE_64);
+        std::memcpy(out.data() + offset, words.data(), words.size() * VAL_SIZE_64);
+        serialize_value(filter.min(), out);
+        serialize_value(filter.max(), out);
+    }
+
+    static executor::RuntimeFilter deserialize_runtime_filter(const uint8_t* data, size_t& offset,
+                                                             size_t size) {
+        uint64_t keys = 0;
+        if (offset + VAL_SIZE_64 <= size) {
+            std::memcpy(&keys, data + offset, VAL_SIZE_64);
+            offset += VAL_SIZE_64;
+        }
+        const uint32_t count = deserialize_u32(data, offset, size);
+        std::vector<uint64_t> words;
+        if (offset + static_cast<size_t>(count) * VAL_SIZE_64 <= size) {
+            words.resize(count);
+            std::memcpy(words.data(), data + offset, words.size() * VAL_SIZE_64);
+            offset += words.size() * VAL_SIZE_64;
+        }
+        common::Value min = deserialize_value(data, offset, size);
+        common::Value max = deserialize_value(data, offset, size);
+        return {std::move(words), keys, std::move(min), std::move(max)};
+    }
+
     static void serialize_string(const std::string& s, std::vector<uint8_t>& out) {
         const auto len = static_cast<uint32_t>(s.size());
         const size_t offset = out.size();
@@ -209,37 +367,90 @@ class Serializer {
 };
 
 /**
- * @brief Header for all internal RPC messages (fixed 12 bytes)
+ * @brief Header for all internal RPC messages (12 bytes)
+ *
+ * Every frame also advertises, through the FLAG_ACCEPT_* bits, what its sender
+ * can decode; a peer uses an encoding only once the other side has offered
+ * it, so the wire format is settled per connection and older peers keep
+ * getting the row format uncompressed. Payloads of 64 KB and more set
+ * FLAG_LONG_PAYLOAD and carry their length in 4 more bytes after the header.
+ * Requests made inside a sampled trace set FLAG_TRACE and carry the trace id
+ * and the calling span's id in 16 more bytes after that; untraced traffic
+ * never has them, so only traced requests need a peer that knows the flag.
  */
 struct RpcHeader {
     static constexpr uint32_t MAGIC = 0x4353514C;  // 'CSQL'
     static constexpr size_t HEADER_SIZE = 12;
+    static constexpr size_t LONG_LENGTH_SIZE = 4;
+    static constexpr uint8_t FLAG_NO_REPLY = 0x01;         // Sender will not read a response
+    static constexpr uint8_t FLAG_ACCEPT_COLUMNAR = 0x02;  // Sender decodes columnar rows
+    static constexpr uint8_t FLAG_ACCEPT_LZ4 = 0x04;       // Sender decodes compressed payloads
+    static constexpr uint8_t FLAG_LZ4 = 0x08;  // Payload: uint32 raw size, then an LZ4 block
+    static constexpr uint8_t FLAG_LONG_PAYLOAD = 0x10;
+    static constexpr uint8_t FLAG_TRACE = 0x20;  // Trace context follows the length
+    static constexpr size_t TRACE_CONTEXT_SIZE = 16;
+    /* The most bytes encode() writes */
+    static constexpr size_t MAX_HEADER_SIZE = HEADER_SIZE + LONG_LENGTH_SIZE + TRACE_CONTEXT_SIZE;
+    /* The capabilities this build offers on every frame it sends */
+    static constexpr uint8_t FLAGS_ACCEPTED = FLAG_ACCEPT_COLUMNAR | FLAG_ACCEPT_LZ4;
 
     uint32_t magic = MAGIC;
     RpcType type = RpcType::Error;
     uint8_t flags = 0;
     uint16_t group_id = 0;  // For Multi-Group Raft
-    uint16_t reserved = 0;
-    uint16_t payload_len = 0;
+    /* Echoed in the response so several requests can be in flight on one connection;
+     * 0 means the sender expects responses in request order */
+    uint16_t request_id = 0;
+    uint32_t payload_len = 0;
+    uint64_t trace_id = 0;       // 0 when the request is not traced
+    uint64_t parent_span_id = 0;  // The caller's span
+
+    /** @return Whether the sender of this frame can decode what `capability` names */
+    [[nodiscard]] bool accepts(uint8_t capability) const { return (flags & capability) != 0; }
+
+    /** @return Bytes encode() writes */
+    [[nodiscard]] size_t encoded_size() const {
+        return HEADER_SIZE + (payload_len > UINT16_MAX ? LONG_LENGTH_SIZE : 0) +
+               (trace_id != 0 ? TRACE_CONTEXT_SIZE : 0);
+    }
 
     void encode(char* out) const {
+        const bool long_payload = payload_len > UINT16_MAX;
         uint32_t n_magic = htonl(magic);
         uint16_t n_group = htons(group_id);
-        uint16_t n_reserved = htons(reserved);
-        uint16_t n_len = htons(payload_len);
+        uint16_t n_request = htons(request_id);
+        uint16_t n_len = htons(long_payload ? 0 : static_cast<uint16_t>(payload_len));
         std::memcpy(out, &n_magic, 4);
         out[4] = static_cast<char>(type);
-        out[5] = static_cast<char>(flags);
+        uint8_t wire_flags = flags & ~(FLAG_LONG_PAYLOAD | FLAG_TRACE);
+        wire_flags |= (long_payload ? FLAG_LONG_PAYLOAD : 0) | (trace_id != 0 ? FLAG_TRACE : 0);
+        out[5] = static_cast<char>(wire_flags);
         std::memcpy(out + 6, &n_group, 2);
-        std::memcpy(out + 8, &n_reserved, 2);
+        std::memcpy(out + 8, &n_request, 2);
         std::memcpy(out + 10, &n_len, 2);
+        size_t pos = HEADER_SIZE;
+        if (long_payload) {
+            uint32_t n_long = htonl(payload_len);
+            std::memcpy(out + pos, &n_long, LONG_LENGTH_SIZE);
+            pos += LONG_LENGTH_SIZE;
+        }
+        if (trace_id != 0) {
+            encode_u64(trace_id, out + pos);
+            encode_u64(parent_span_id, out + pos + 8);
+        }
     }
 
+    /**
+     * @brief Decodes the fixed 12 bytes
+     *
+     * If the frame has FLAG_LONG_PAYLOAD, the length is only known once the
+     * extension_size() bytes that follow are passed to decode_extension().
+     */
     static RpcHeader decode(const char* in) {
         RpcHeader h;
         uint32_t n_magic = 0;
         uint16_t n_group = 0;
-        uint16_t n_reserved = 0;
+        uint16_t n_request = 0;
         uint16_t n_len = 0;
         std::memcpy(&n_magic, in, 4);
         h.magic = ntohl(n_magic);
@@ -247,14 +458,103 @@ struct RpcHeader {
         h.flags = static_cast<uint8_t>(in[5]);
         std::memcpy(&n_group, in + 6, 2);
         h.group_id = ntohs(n_group);
-        std::memcpy(&n_reserved, in + 8, 2);
-        h.reserved = ntohs(n_reserved);
+        std::memcpy(&n_request, in + 8, 2);
+        h.request_id = ntohs(n_request);
         std::memcpy(&n_len, in + 10, 2);
         h.payload_len = ntohs(n_len);
         return h;
     }
+
+    /** @return Header bytes that follow the fixed 12 */
+    [[nodiscard]] size_t extension_size() const {
+        return (accepts(FLAG_LONG_PAYLOAD) ? LONG_LENGTH_SIZE : 0) +
+               (accepts(FLAG_TRACE) ? TRACE_CONTEXT_SIZE : 0);
+    }
+
+    void decode_extension(const char* in) {
+        if (accepts(FLAG_LONG_PAYLOAD)) {
+            uint32_t n_long = 0;
+            std::memcpy(&n_long, in, LONG_LENGTH_SIZE);
+            payload_len = ntohl(n_long);
+            in += LONG_LENGTH_SIZE;
+        }
+        if (accepts(FLAG_TRACE)) {
+            trace_id = decode_u64(in);
+            parent_span_id = decode_u64(in + 8);
+        }
+    }
+
+   private:
+    /* Big-endian, like the rest of the header */
+    static void encode_u64(uint64_t v, char* out) {
+        for (int i = 7; i >= 0; --i) {
+            out[i] = static_cast<char>(v & 0xFFU);
+            v >>= 8U;
+        }
+    }
+
+    static uint64_t decode_u64(const char* in) {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i) {
+            v = (v << 8U) | static_cast<uint8_t>(in[i]);
+        }
+        return v;
+    }
 };
 
+/** Payloads smaller than this are never compressed: the saving would not pay for the work */
+constexpr size_t COMPRESS_MIN_PAYLOAD = 512;
+
+/**
+ * @brief The payload to send in a frame to a peer that accepts LZ4
+ * @return `payload`, or its compressed form built in `scratch` with FLAG_LZ4
+ * set on `header` when that is smaller
+ */
+inline const std::vector<uint8_t>& compress_payload(RpcHeader& header,
+                                                    const std::vector<uint8_t>& payload,
+                                                    std::vector<uint8_t>& scratch) {
+    if (payload.size() < COMPRESS_MIN_PAYLOAD) {
+        return payload;
+    }
+    scratch.resize(Serializer::VAL_SIZE_32);
+    const auto raw_size = static_cast<uint32_t>(payload.size());
+    std::memcpy(scratch.data(), &raw_size, Serializer::VAL_SIZE_32);
+    common::lz4::compress(payload.data(), payload.size(), scratch);
+    if (scratch.size() >= payload.size()) {
+        return payload;
+    }
+    header.flags |= RpcHeader::FLAG_LZ4;
+    return scratch;
+}
+
+/**
+ * @brief Restores a payload received with FLAG_LZ4, in place
+ * @return false if it does not decompress
+ */
+inline bool decompress_payload(RpcHeader& header, std::vector<uint8_t>& payload) {
+    if (!header.accepts(RpcHeader::FLAG_LZ4)) {
+        return true;
+    }
+    uint32_t raw_size = 0;
+    if (payload.size() < Serializer::VAL_SIZE_32) {
+        return false;
+    }
+    std::memcpy(&raw_size, payload.data(), Serializer::VAL_SIZE_32);
+    if (raw_size / 255 > payload.size()) {
+        return false; /* More than LZ4 can expand to */
+    }
+    std::vector<uint8_t> raw(raw_size);
+    if (!common::lz4::decompress(payload.data() + Serializer::VAL_SIZE_32,
+                                 payload.size() - Serializer::VAL_SIZE_32, raw.data(),
+                                 raw.size())) {
+        return false;
+    }
+    payload = std::move(raw);
+    header.flags &= static_cast<uint8_t>(~RpcHeader::FLAG_LZ4);
+    header.payload_len = raw_size;
+    return true;
+}
+
 /**
  * @brief Arguments for RegisterNode RPC
  */
@@ -301,12 +601,31 @@ struct ExecuteFragmentArgs {
     std::string sql;
     std::string context_id;
     bool is_fetch_all = false;
+    /** Tables read as shuffle streams, consumed while the shuffle is still running */
+    std::vector<std::string> exchange_tables;
+    uint32_t exchange_senders = 0; /**< Nodes each exchange table streams in from */
+    /** How current the node's read of the shard must be; sent only when not the default */
+    raft::ReadConsistency read_consistency = raft::ReadConsistency::Stale;
+    uint32_t max_staleness_ms = 0; /**< Bound of a stale read; 0 for none */
 
     [[nodiscard]] std::vector<uint8_t> serialize() const {
         std::vector<uint8_t> out;
         Serializer::serialize_string(sql, out);
         Serializer::serialize_string(context_id, out);
         out.push_back(is_fetch_all ? 1 : 0);
+        const bool read_options =
+            read_consistency != raft::ReadConsistency::Stale || max_staleness_ms != 0;
+        if (!exchange_tables.empty() || read_options) {
+            Serializer::serialize_u32(static_cast<uint32_t>(exchange_tables.size()), out);
+            for (const auto& table : exchange_tables) {
+                Serializer::serialize_string(table, out);
+            }
+            Serializer::serialize_u32(exchange_senders, out);
+        }
+        if (read_options) {
+            out.push_back(static_cast<uint8_t>(read_consistency));
+            Serializer::serialize_u32(max_staleness_ms, out);
+        }
         return out;
     }
 
@@ -316,7 +635,20 @@ struct ExecuteFragmentArgs {
         args.sql = Serializer::deserialize_string(in.data(), offset, in.size());
         args.context_id = Serializer::deserialize_string(in.data(), offset, in.size());
         if (offset < in.size()) {
-            args.is_fetch_all = in[offset] != 0;
+            args.is_fetch_all = in[offset++] != 0;
+        }
+        if (offset < in.size()) {
+            const uint32_t count = Serializer::deserialize_u32(in.data(), offset, in.size());
+            for (uint32_t i = 0; i < count && offset < in.size(); ++i) {
+                args.exchange_tables.push_back(
+                    Serializer::deserialize_string(in.data(), offset, in.size()));
+            }
+            args.exchange_senders = Serializer::deserialize_u32(in.data(), offset, in.size());
+        }
+        if (offset < in.size() &&
+            in[offset] <= static_cast<uint8_t>(raft::ReadConsistency::Stale)) {
+            args.read_consistency = static_cast<raft::ReadConsistency>(in[offset++]);
+            args.max_staleness_ms = Serializer::deserialize_u32(in.data(), offset, in.size());
         }
         return args;
     }
@@ -331,44 +663,35 @@ struct QueryResultsReply {
     executor::Schema schema;
     std::vector<executor::Tuple> rows;
 
-    [[nodiscard]] std::vector<uint8_t> serialize() const {
+    /**
+     * @param columnar Send the rows in the columnar encoding; only for peers that
+     * set RpcHeader::FLAG_ACCEPT_COLUMNAR
+     */
+    [[nodiscard]] std::vector<uint8_t> serialize(bool columnar = false) const {
         std::vector<uint8_t> out;
+        if (columnar) {
+            Serializer::serialize_columnar_marker(out);
+        }
         out.push_back(success ? 1 : 0);
         Serializer::serialize_string(error_msg, out);
         Serializer::serialize_schema(schema, out);
-
-        const auto row_count = static_cast<uint32_t>(rows.size());
-        const size_t offset = out.size();
-        out.resize(offset + Serializer::VAL_SIZE_32);
-        std::memcpy(out.data() + offset, &row_count, Serializer::VAL_SIZE_32);
-
-        for (const auto& row : rows) {
-            Serializer::serialize_tuple(row, out);
-        }
-
+        Serializer::serialize_rows(rows, out, columnar);
         return out;
     }
 
+    /** @brief Decodes either format */
     static QueryResultsReply deserialize(const std::vector<uint8_t>& in) {
         QueryResultsReply reply;
-        if (in.empty()) {
+        size_t offset = 0;
+        const bool columnar = Serializer::deserialize_columnar_marker(in, offset);
+        if (offset >= in.size()) {
             return reply;
         }
 
-        reply.success = in[0] != 0;
-        size_t offset = 1;
+        reply.success = in[offset++] != 0;
         reply.error_msg = Serializer::deserialize_string(in.data(), offset, in.size());
         reply.schema = Serializer::deserialize_schema(in.data(), offset, in.size());
-
-        uint32_t row_count = 0;
-        if (offset + Serializer::VAL_SIZE_32 <= in.size()) {
-            std::memcpy(&row_count, in.data() + offset, Serializer::VAL_SIZE_32);
-            offset += Serializer::VAL_SIZE_32;
-        }
-        for (uint32_t i = 0; i < row_count; ++i) {
-            reply.rows.push_back(Serializer::deserialize_tuple(in.data(), offset, in.size()));
-        }
-
+        reply.rows = Serializer::deserialize_rows(in.data(), offset, in.size(), columnar);
         return reply;
     }
 };
@@ -380,34 +703,31 @@ struct PushDataArgs {
     std::string context_id;
     std::string table_name;
     std::vector<executor::Tuple> rows;
+    bool last = false; /**< The sender's final chunk of this table for the receiver */
 
-    [[nodiscard]] std::vector<uint8_t> serialize() const {
+    /** @param columnar As for QueryResultsReply::serialize() */
+    [[nodiscard]] std::vector<uint8_t> serialize(bool columnar = false) const {
         std::vector<uint8_t> out;
+        if (columnar) {
+            Serializer::serialize_columnar_marker(out);
+        }
         Serializer::serialize_string(context_id, out);
         Serializer::serialize_string(table_name, out);
-
-        const auto row_count = static_cast<uint32_t>(rows.size());
-        const size_t offset = out.size();
-        out.resize(offset + Serializer::VAL_SIZE_32);
-        std::memcpy(out.data() + offset, &row_count, Serializer::VAL_SIZE_32);
-        for (const auto& row : rows) {
-            Serializer::serialize_tuple(row, out);
-        }
+        Serializer::serialize_rows(rows, out, columnar);
+        out.push_back(last ? 1 : 0);
         return out;
     }
 
+    /** @brief Decodes either format */
     static PushDataArgs deserialize(const std::vector<uint8_t>& in) {
         PushDataArgs args;
         size_t offset = 0;
+        const bool columnar = Serializer::deserialize_columnar_marker(in, offset);
         args.context_id = Serializer::deserialize_string(in.data(), offset, in.size());
         args.table_name = Serializer::deserialize_string(in.data(), offset, in.size());
-        uint32_t row_count = 0;
-        if (offset + Serializer::VAL_SIZE_32 <= in.size()) {
-            std::memcpy(&row_count, in.data() + offset, Serializer::VAL_SIZE_32);
-            offset += Serializer::VAL_SIZE_32;
-        }
-        for (uint32_t i = 0; i < row_count; ++i) {
-            args.rows.push_back(Serializer::deserialize_tuple(in.data(), offset, in.size()));
+        args.rows = Serializer::deserialize_rows(in.data(), offset, in.size(), columnar);
+        if (offset < in.size()) {
+            args.last = in[offset] != 0;
         }
         return args;
     }
@@ -420,12 +740,24 @@ struct ShuffleFragmentArgs {
     std::string context_id;
     std::string table_name;
     std::string join_key_col;
+    /** Keys of the inner join's other side: rows whose key it rules out are not sent */
+    std::optional<executor::RuntimeFilter> key_filter;
+    /**
+     * The table is replicated: every node holds all of its rows, so each node
+     * keeps the rows of its own partition and sends nothing
+     */
+    bool replicated = false;
 
     [[nodiscard]] std::vector<uint8_t> serialize() const {
         std::vector<uint8_t> out;
         Serializer::serialize_string(context_id, out);
         Serializer::serialize_string(table_name, out);
         Serializer::serialize_string(join_key_col, out);
+        out.push_back(key_filter ? 1 : 0);
+        if (key_filter) {
+            Serializer::serialize_runtime_filter(*key_filter, out);
+        }
+        out.push_back(replicated ? 1 : 0);
         return out;
     }
 
@@ -435,6 +767,94 @@ struct ShuffleFragmentArgs {
         args.context_id = Serializer::deserialize_string(in.data(), offset, in.size());
         args.table_name = Serializer::deserialize_string(in.data(), offset, in.size());
         args.join_key_col = Serializer::deserialize_string(in.data(), offset, in.size());
+        if (offset < in.size() && in[offset++] != 0) {
+            args.key_filter =
+                Serializer::deserialize_runtime_filter(in.data(), offset, in.size());
+        }
+        if (offset < in.size()) {
+            args.replicated = in[offset++] != 0;
+        }
+        return args;
+    }
+};
+
+/**
+ * @brief Arguments for KeyFilter RPC: summarize the join keys of a node's rows of a table
+ */
+struct KeyFilterArgs {
+    std::string table_name;
+    std::string key_col;
+    /** Nodes whose filters will be merged; each sizes its filter for that many times its rows */
+    uint32_t node_count = 1;
+
+    [[nodiscard]] std::vector<uint8_t> serialize() const {
+        std::vector<uint8_t> out;
+        Serializer::serialize_string(table_name, out);
+        Serializer::serialize_string(key_col, out);
+        Serializer::serialize_u32(node_count, out);
+        return out;
+    }
+
+    static KeyFilterArgs deserialize(const std::vector<uint8_t>& in) {
+        KeyFilterArgs args;
+        size_t offset = 0;
+        args.table_name = Serializer::deserialize_string(in.data(), offset, in.size());
+        args.key_col = Serializer::deserialize_string(in.data(), offset, in.size());
+        args.node_count = Serializer::deserialize_u32(in.data(), offset, in.size());
+        return args;
+    }
+};
+
+/**
+ * @brief Reply to KeyFilter: the node's filter, or why there is none
+ */
+struct KeyFilterReply {
+    bool success = false;
+    std::string error_msg;
+    std::optional<executor::RuntimeFilter> filter;
+
+    [[nodiscard]] std::vector<uint8_t> serialize() const {
+        std::vector<uint8_t> out;
+        out.push_back(success && filter ? 1 : 0);
+        Serializer::serialize_string(error_msg, out);
+        if (success && filter) {
+            Serializer::serialize_runtime_filter(*filter, out);
+        }
+        return out;
+    }
+
+    /** @brief An empty payload (e.g. a node without the handler) decodes as a failure */
+    static KeyFilterReply deserialize(const std::vector<uint8_t>& in) {
+        KeyFilterReply reply;
+        if (in.empty()) {
+            return reply;
+        }
+        size_t offset = 0;
+        reply.success = in[offset++] != 0;
+        reply.error_msg = Serializer::deserialize_string(in.data(), offset, in.size());
+        if (reply.success) {
+            reply.filter = Serializer::deserialize_runtime_filter(in.data(), offset, in.size());
+        }
+        return reply;
+    }
+};
+
+/**
+ * @brief Arguments for CancelFragment RPC: stops the fragments running for a context
+ */
+struct CancelFragmentArgs {
+    std::string context_id;
+
+    [[nodiscard]] std::vector<uint8_t> serialize() const {
+        std::vector<uint8_t> out;
+        Serializer::serialize_string(context_id, out);
+        return out;
+    }
+
+    static CancelFragmentArgs deserialize(const std::vector<uint8_t>& in) {
+        CancelFragmentArgs args;
+        size_t offset = 0;
+        args.context_id = Serializer::deserialize_string(in.data(), offset, in.size());
         return args;
     }
 };
@@ -9,7 +9,13 @@
 #include <netinet/in.h>
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
 #include <functional>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <unordered_map>
@@ -26,10 +32,28 @@ using RpcHandler = std::function<void(const RpcHeader&, const std::vector<uint8_
 
 /**
  * @brief Server for handling internal cluster RPCs
+ *
+ * A single I/O thread accepts connections and reads request frames from all
+ * of them; a fixed pool of handler threads runs the requests. Requests wait in
+ * one queue per RpcType. One handler thread is kept for Raft traffic,
+ * CancelFragment and PushData only, and the others take those requests first
+ * and then the remaining queues in turn, so heartbeats, votes, cancellations
+ * and shuffle chunks are never stuck behind long-running fragments. Handlers
+ * of these types must not block.
+ *
+ * A request that carries a trace context runs inside an `rpc.server` span, so
+ * whatever its handler records joins the caller's trace.
+ *
+ * Several requests of one connection may run at once. Handlers reply with
+ * send_response(), which echoes the request id and writes each response
+ * whole, so replies on a connection never interleave.
  */
 class RpcServer {
    public:
-    explicit RpcServer(uint16_t port) : port_(port) {}
+    static constexpr size_t DEFAULT_HANDLER_THREADS = 4;
+
+    explicit RpcServer(uint16_t port, size_t handler_threads = DEFAULT_HANDLER_THREADS)
+        : port_(port), handler_threads_(handler_threads) {}
     ~RpcServer() { stop(); }
 
     // Prevent copying
@@ -40,6 +64,14 @@ class RpcServer {
     void stop();
     void set_handler(RpcType type, RpcHandler handler);
 
+    /**
+     * @brief Sends the response to `request` on the connection `fd` it came from
+     * @return false if the connection is gone or the write failed; nothing is
+     * sent, successfully, when the request was sent with FLAG_NO_REPLY
+     */
+    bool send_response(int fd, const RpcHeader& request, RpcType type,
+                       const std::vector<uint8_t>& payload);
+
     /**
      * @brief Get a handler for a specific type (for testing)
      */
@@ -52,15 +84,40 @@ class RpcServer {
     }
 
    private:
-    void accept_loop();
-    void handle_client(int client_fd);
+    struct Connection;
+
+    struct Request {
+        std::shared_ptr<Connection> conn;
+        RpcHeader header;
+        std::vector<uint8_t> payload;
+        std::chrono::steady_clock::time_point received; /**< When the I/O thread queued it */
+    };
+
+    void io_loop();
+    /** @brief Reads what `conn` has and queues its complete requests; false on EOF or error */
+    bool read_requests(const std::shared_ptr<Connection>& conn);
+    void handler_loop(bool control_only);
+    /** @brief Takes the next request a handler thread should run; false when stopping */
+    bool next_request(bool control_only, Request& out);
+    void forget_connection(int fd);
 
     uint16_t port_;
+    size_t handler_threads_;
     int listen_fd_ = -1;
+    int wake_fd_ = -1; /**< eventfd that interrupts the I/O thread on stop() */
     std::atomic<bool> running_{false};
-    std::thread accept_thread_;
-    std::vector<std::thread> worker_threads_;
-    std::mutex worker_mutex_;
+    std::thread io_thread_;
+    std::vector<std::thread> handler_pool_;
+
+    std::unordered_map<int, std::weak_ptr<Connection>> connections_; /**< By socket */
+    std::mutex connections_mutex_;
+
+    std::map<RpcType, std::deque<Request>> queues_;
+    RpcType last_served_ = RpcType::Heartbeat; /**< Last other queue served, for turns */
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    bool handlers_stop_ = false;
+
     std::unordered_map<RpcType, RpcHandler> handlers_;
     std::mutex handlers_mutex_;
 };
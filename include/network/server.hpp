@@ -11,23 +11,31 @@
 #include <unistd.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "catalog/catalog.hpp"
 #include "common/cluster_manager.hpp"
 #include "common/config.hpp"
+#include "common/metrics.hpp"
+#include "executor/columnar_replica.hpp"
 #include "executor/query_executor.hpp"
+#include "executor/result_cache.hpp"
 #include "storage/buffer_pool_manager.hpp"
 #include "transaction/lock_manager.hpp"
 #include "transaction/transaction_manager.hpp"
+#include "transaction/vacuum_manager.hpp"
 
 namespace cloudsql::network {
 
@@ -51,10 +59,19 @@ enum class ServerStatus : uint8_t { Stopped, Starting, Running, Stopping, Error
 
 /**
  * @brief Network Server class
+ *
+ * Connections are served by an event loop rather than a thread each. An
+ * acceptor thread hands new sockets, made non-blocking, round-robin to
+ * `io_threads` epoll loops. A loop reads whatever a connection has sent into
+ * its input buffer and, once that holds a complete message, queues the
+ * connection for the `worker_threads` pool, which runs the messages and
+ * writes the replies. Connections are registered EPOLLONESHOT, so exactly
+ * one thread owns a connection at a time and an idle one costs its socket,
+ * an epoll entry and its (shrunk) buffers and session state.
  */
 class Server {
    public:
-    static constexpr int BACKLOG = 10;
+    static constexpr int BACKLOG = SOMAXCONN;
 
     /**
      * @brief Constructor
@@ -65,16 +82,7 @@ class Server {
     /**
      * @brief Destructor
      */
-    ~Server() noexcept {
-        try {
-            static_cast<void>(stop());
-        } catch (...) {
-            static_cast<void>(0);  // Destructors should not throw
-        }
-        if (listen_fd_ >= 0) {
-            static_cast<void>(close(listen_fd_));
-        }
-    }
+    ~Server() noexcept;
 
     // Disable copy/move for server
     Server(const Server&) = delete;
@@ -113,8 +121,31 @@ class Server {
     [[nodiscard]] std::string get_status_string() const;
 
    private:
+    struct Connection; /**< Socket, buffers and protocol session of one client */
+
+    /** @brief One reactor thread and the epoll set it waits on */
+    struct IoLoop {
+        int epoll_fd = -1;
+        int wake_fd = -1; /**< eventfd that interrupts the wait on stop() */
+        std::thread thread;
+    };
+
     void accept_connections();
-    void handle_connection(int client_fd);
+    void run_io_loop(IoLoop& loop);
+    void run_worker();
+
+    /** @brief Reads what the socket has; queues the connection once a message is complete */
+    void read_connection(Connection& conn);
+
+    /** @brief Hands `conn` to the workers, to run its messages or answer its remote query */
+    void queue_connection(Connection& conn);
+
+    /** @brief Runs the buffered messages of `conn` on a worker thread */
+    void serve_connection(Connection& conn);
+
+    /** @brief Hands `conn` back to its loop to wait for more input */
+    void rearm_connection(Connection& conn);
+    void close_connection(Connection& conn);
 
     uint16_t port_;
     int listen_fd_ = -1;
@@ -128,13 +159,30 @@ class Server {
 
     transaction::LockManager lock_manager_;
     transaction::TransactionManager transaction_manager_;
+    transaction::VacuumManager vacuum_; /**< Autovacuum over this server's transactions */
+    /** SELECT results shared by the sessions that SET result_cache; null if result_cache_mb is 0 */
+    std::unique_ptr<executor::ResultCache> result_cache_;
+    /** Columnar replicas of tables created WITH (COLUMNAR_REPLICA = ON); null without a WAL */
+    std::unique_ptr<executor::ColumnarReplicaManager> replicas_;
 
     ServerStats stats_;
     std::thread accept_thread_;
+    int accept_wake_fd_ = -1;
+    std::vector<std::unique_ptr<IoLoop>> io_loops_;
+    size_t next_loop_ = 0; /**< Loop the next accepted connection goes to */
     std::vector<std::thread> worker_threads_;
-    std::vector<int> client_fds_;
-    std::mutex thread_mutex_;
+
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_; /**< By socket */
+    std::mutex thread_mutex_; /**< Guards connections_ and the thread lists */
+
+    std::deque<Connection*> ready_; /**< Connections with complete messages, for the workers */
+    std::mutex ready_mutex_;
+    std::condition_variable ready_cv_;
+    bool workers_stop_ = false;
     mutable std::mutex state_mutex_;
+
+    // Last, so the collector is unregistered before stats_ is destroyed
+    common::MetricsRegistry::Registration metrics_;
 };
 
 }  // namespace cloudsql::network
@@ -0,0 +1,57 @@
+/**
+ * @file ast_arena.hpp
+ * @brief Arena allocation of AST nodes
+ */
+
+#ifndef CLOUDSQL_PARSER_AST_ARENA_HPP
+#define CLOUDSQL_PARSER_AST_ARENA_HPP
+
+#include <cstddef>
+
+#include "common/arena.hpp"
+
+namespace cloudsql::parser {
+
+/**
+ * @class AstArenaScope
+ * @brief While it lives, AST nodes made on this thread come from an arena
+ *
+ * Meant for statements that are parsed, run once and dropped. Parse inside the
+ * scope, run the statement, destroy it, then reset the arena to release every
+ * node at once. Destroying a node still runs its destructor but frees nothing,
+ * so the arena must outlive the nodes made in the scope. Nodes made outside a
+ * scope (clones made while executing, statements the plan cache keeps) come
+ * from the heap as before.
+ */
+class AstArenaScope {
+   public:
+    explicit AstArenaScope(common::Arena& arena);
+    ~AstArenaScope();
+
+    AstArenaScope(const AstArenaScope&) = delete;
+    AstArenaScope& operator=(const AstArenaScope&) = delete;
+    AstArenaScope(AstArenaScope&&) = delete;
+    AstArenaScope& operator=(AstArenaScope&&) = delete;
+
+    /** @return The arena of the innermost scope on this thread, or null */
+    [[nodiscard]] static common::Arena* current();
+
+   private:
+    common::Arena* previous_;
+};
+
+/**
+ * @brief Base of Expression and Statement; allocates nodes as AstArenaScope says
+ *
+ * Each node is preceded by a word recording its arena, or null for the heap,
+ * which tells operator delete whether there is anything to free.
+ */
+class AstNode {
+   public:
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr) noexcept;
+};
+
+}  // namespace cloudsql::parser
+
+#endif  // CLOUDSQL_PARSER_AST_ARENA_HPP
@@ -6,11 +6,13 @@
 #ifndef CLOUDSQL_PARSER_EXPRESSION_HPP
 #define CLOUDSQL_PARSER_EXPRESSION_HPP
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "common/value.hpp"
+#include "parser/ast_arena.hpp"
 #include "parser/token.hpp"
 
 /* Forward declarations */
@@ -41,7 +43,7 @@ enum class ExprType : uint8_t {
 /**
  * @brief Base class for all SQL expressions
  */
-class Expression {
+class Expression : public AstNode {
    public:
     Expression() = default;
     virtual ~Expression() = default;
@@ -117,6 +119,9 @@ class UnaryExpr : public Expression {
                              executor::ColumnVector& result) const override;
     [[nodiscard]] std::string to_string() const override;
     [[nodiscard]] std::unique_ptr<Expression> clone() const override;
+
+    [[nodiscard]] TokenType op() const { return op_; }
+    [[nodiscard]] const Expression& expr() const { return *expr_; }
 };
 
 /**
@@ -151,10 +156,21 @@ class ColumnExpr : public Expression {
 class ConstantExpr : public Expression {
    private:
     common::Value value_;
+    std::shared_ptr<const common::Value> parameter_; /**< Bound value of a `$n` placeholder */
+    uint32_t parameter_index_ = 0;
 
    public:
     explicit ConstantExpr(common::Value val) : value_(std::move(val)) {}
 
+    /**
+     * @brief Placeholder `$index` of a prepared statement
+     *
+     * Reads whatever value is in `slot` when evaluated, so that every copy of
+     * the expression sees the parameters bound for the current execution.
+     */
+    ConstantExpr(uint32_t index, std::shared_ptr<const common::Value> slot)
+        : parameter_(std::move(slot)), parameter_index_(index) {}
+
     [[nodiscard]] ExprType type() const override { return ExprType::Constant; }
     [[nodiscard]] common::Value evaluate(const executor::Tuple* tuple = nullptr,
                                          const executor::Schema* schema = nullptr) const override;
@@ -163,7 +179,10 @@ class ConstantExpr : public Expression {
     [[nodiscard]] std::string to_string() const override;
     [[nodiscard]] std::unique_ptr<Expression> clone() const override;
 
-    [[nodiscard]] const common::Value& value() const { return value_; }
+    [[nodiscard]] const common::Value& value() const { return parameter_ ? *parameter_ : value_; }
+
+    /** @return The placeholder number, 0 for a literal */
+    [[nodiscard]] uint32_t parameter_index() const { return parameter_index_; }
 };
 
 /**
@@ -214,6 +233,12 @@ class InExpr : public Expression {
                              executor::ColumnVector& result) const override;
     [[nodiscard]] std::string to_string() const override;
     [[nodiscard]] std::unique_ptr<Expression> clone() const override;
+
+    [[nodiscard]] const Expression& column() const { return *column_; }
+    [[nodiscard]] const std::vector<std::unique_ptr<Expression>>& values() const {
+        return values_;
+    }
+    [[nodiscard]] bool not_flag() const { return not_flag_; }
 };
 
 /**
@@ -229,6 +254,8 @@ class IsNullExpr : public Expression {
         : expr_(std::move(expr)), not_flag_(not_flag) {}
 
     [[nodiscard]] ExprType type() const override { return ExprType::IsNull; }
+    [[nodiscard]] const Expression& expr() const { return *expr_; }
+    [[nodiscard]] bool not_flag() const { return not_flag_; }
     [[nodiscard]] common::Value evaluate(const executor::Tuple* tuple = nullptr,
                                          const executor::Schema* schema = nullptr) const override;
     void evaluate_vectorized(const executor::VectorBatch& batch, const executor::Schema& schema,
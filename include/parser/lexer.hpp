@@ -7,7 +7,6 @@
 #define CLOUDSQL_PARSER_LEXER_HPP
 
 #include <cstdint>
-#include <map>
 #include <string>
 #include <vector>
 
@@ -18,7 +17,8 @@ namespace cloudsql::parser {
 /**
  * @brief SQL Lexer class
  *
- * Converts SQL text into a stream of tokens.
+ * Converts SQL text into a stream of tokens. Tokens view the lexer's copy of
+ * the text rather than owning theirs, so they must not outlive the lexer.
  */
 class Lexer {
    private:
@@ -28,12 +28,6 @@ class Lexer {
     uint32_t column_ = 1;
     char current_char_ = '\0';
 
-    // Keyword lookup table
-    static const std::map<std::string, TokenType> keywords_;
-
-    // Initialize keywords
-    [[nodiscard]] static std::map<std::string, TokenType> init_keywords();
-
    public:
     /**
      * @brief Construct a lexer
@@ -2,6 +2,7 @@
 #define CLOUDSQL_PARSER_PARSER_HPP
 
 #include <memory>
+#include <vector>
 
 #include "parser/expression.hpp"
 #include "parser/lexer.hpp"
@@ -14,10 +15,21 @@ class Parser {
     explicit Parser(std::unique_ptr<Lexer> lexer);
     std::unique_ptr<Statement> parse_statement();
 
+    /**
+     * @brief Value slots of the `$n` placeholders parsed so far
+     *
+     * parameters()[n - 1] holds the value of `$n`; every occurrence of a
+     * placeholder reads its slot, so writing the slots binds the statement.
+     */
+    [[nodiscard]] const std::vector<std::shared_ptr<common::Value>>& parameters() const {
+        return parameters_;
+    }
+
    private:
     std::unique_ptr<Lexer> lexer_;
     Token current_token_;
     bool has_current_ = false;
+    std::vector<std::shared_ptr<common::Value>> parameters_;
 
     Token next_token();
     Token peek_token();
@@ -30,6 +42,8 @@ class Parser {
     std::unique_ptr<Statement> parse_update();
     std::unique_ptr<Statement> parse_delete();
     std::unique_ptr<Statement> parse_drop();
+    std::unique_ptr<Statement> parse_copy();
+    std::unique_ptr<Statement> parse_set();
 
     std::unique_ptr<Expression> parse_expression();
     std::unique_ptr<Expression> parse_or();
@@ -10,6 +10,7 @@
 #include <string>
 #include <vector>
 
+#include "parser/ast_arena.hpp"
 #include "parser/expression.hpp"
 
 namespace cloudsql::parser {
@@ -30,13 +31,17 @@ enum class StmtType : uint8_t {
     TransactionBegin,
     TransactionCommit,
     TransactionRollback,
-    Explain
+    Explain,
+    Analyze,
+    Copy,
+    Set,
+    Vacuum
 };
 
 /**
  * @brief Base statement class
  */
-class Statement {
+class Statement : public AstNode {
    public:
     virtual ~Statement() = default;
 
@@ -221,6 +226,9 @@ class CreateTableStatement : public Statement {
    private:
     std::string table_name_;
     std::vector<ColumnDef> columns_;
+    std::string compression_; /**< WITH (COMPRESSION = ...); empty if not given */
+    bool replicated_ = false; /**< WITH (DISTRIBUTION = REPLICATED) */
+    bool columnar_replica_ = false; /**< WITH (COLUMNAR_REPLICA = ON) */
 
    public:
     CreateTableStatement() = default;
@@ -236,6 +244,15 @@ class CreateTableStatement : public Statement {
     [[nodiscard]] const std::string& table_name() const { return table_name_; }
     [[nodiscard]] const std::vector<ColumnDef>& columns() const { return columns_; }
 
+    void set_compression(std::string method) { compression_ = std::move(method); }
+    [[nodiscard]] const std::string& compression() const { return compression_; }
+
+    void set_replicated(bool replicated) { replicated_ = replicated; }
+    [[nodiscard]] bool replicated() const { return replicated_; }
+
+    void set_columnar_replica(bool replica) { columnar_replica_ = replica; }
+    [[nodiscard]] bool columnar_replica() const { return columnar_replica_; }
+
     [[nodiscard]] std::string to_string() const override;
 };
 
@@ -248,6 +265,8 @@ class CreateIndexStatement : public Statement {
     std::string table_name_;
     std::vector<std::string> columns_;
     bool unique_ = false;
+    bool concurrently_ = false; /**< Built without holding writers off */
+    std::string method_;        /**< USING ...; empty if not given */
 
    public:
     CreateIndexStatement() = default;
@@ -258,16 +277,24 @@ class CreateIndexStatement : public Statement {
     void set_table_name(std::string name) { table_name_ = std::move(name); }
     void add_column(std::string col) { columns_.push_back(std::move(col)); }
     void set_unique(bool unique) { unique_ = unique; }
+    void set_concurrently(bool concurrently) { concurrently_ = concurrently; }
+    void set_method(std::string method) { method_ = std::move(method); }
 
     [[nodiscard]] const std::string& index_name() const { return index_name_; }
     [[nodiscard]] const std::string& table_name() const { return table_name_; }
     [[nodiscard]] const std::vector<std::string>& columns() const { return columns_; }
     [[nodiscard]] bool unique() const { return unique_; }
+    [[nodiscard]] bool concurrently() const { return concurrently_; }
+    [[nodiscard]] const std::string& method() const { return method_; }
 
     [[nodiscard]] std::string to_string() const override {
         std::string s = "CREATE ";
         if (unique_) s += "UNIQUE ";
-        s += "INDEX " + index_name_ + " ON " + table_name_ + " (";
+        s += "INDEX ";
+        if (concurrently_) s += "CONCURRENTLY ";
+        s += index_name_ + " ON " + table_name_ + " ";
+        if (!method_.empty()) s += "USING " + method_ + " ";
+        s += "(";
         for (size_t i = 0; i < columns_.size(); ++i) {
             s += columns_[i] + (i == columns_.size() - 1 ? "" : ", ");
         }
@@ -314,6 +341,130 @@ class DropIndexStatement : public Statement {
     }
 };
 
+/**
+ * @brief ANALYZE statement: collect planner statistics of one table or all of them
+ */
+class AnalyzeStatement : public Statement {
+   private:
+    std::string table_name_; /**< Empty: every table */
+
+   public:
+    AnalyzeStatement() = default;
+    explicit AnalyzeStatement(std::string table) : table_name_(std::move(table)) {}
+    [[nodiscard]] StmtType type() const override { return StmtType::Analyze; }
+    [[nodiscard]] const std::string& table_name() const { return table_name_; }
+    [[nodiscard]] std::string to_string() const override {
+        return table_name_.empty() ? "ANALYZE" : "ANALYZE " + table_name_;
+    }
+};
+
+/**
+ * @brief VACUUM statement: reclaim dead row versions of one table or all of them
+ */
+class VacuumStatement : public Statement {
+   private:
+    std::string table_name_; /**< Empty: every table */
+
+   public:
+    VacuumStatement() = default;
+    explicit VacuumStatement(std::string table) : table_name_(std::move(table)) {}
+    [[nodiscard]] StmtType type() const override { return StmtType::Vacuum; }
+    [[nodiscard]] const std::string& table_name() const { return table_name_; }
+    [[nodiscard]] std::string to_string() const override {
+        return table_name_.empty() ? "VACUUM" : "VACUUM " + table_name_;
+    }
+};
+
+/**
+ * @brief EXPLAIN [ANALYZE] statement: show the plan of a statement, or run it and
+ * show what each operator did
+ */
+class ExplainStatement : public Statement {
+   private:
+    bool analyze_;
+    std::unique_ptr<Statement> stmt_;
+
+   public:
+    ExplainStatement(bool analyze, std::unique_ptr<Statement> stmt)
+        : analyze_(analyze), stmt_(std::move(stmt)) {}
+    [[nodiscard]] StmtType type() const override { return StmtType::Explain; }
+    [[nodiscard]] bool analyze() const { return analyze_; }
+    [[nodiscard]] const Statement& statement() const { return *stmt_; }
+    [[nodiscard]] std::string to_string() const override {
+        return std::string(analyze_ ? "EXPLAIN ANALYZE " : "EXPLAIN ") + stmt_->to_string();
+    }
+};
+
+/**
+ * @brief Data format of COPY
+ */
+enum class CopyFormat : uint8_t { Text, Csv, Binary };
+
+/**
+ * @brief Options of COPY ... FROM STDIN
+ */
+struct CopyOptions {
+    CopyFormat format = CopyFormat::Text;
+    char delimiter = '\t'; /**< Field separator of text and CSV; CSV defaults to ',' */
+    bool header = false;   /**< CSV: the first line holds column names and is skipped */
+};
+
+/**
+ * @brief COPY table FROM STDIN [WITH] [(FORMAT text|csv|binary, DELIMITER 'c', HEADER)]
+ */
+class CopyStatement : public Statement {
+   private:
+    std::string table_name_;
+    CopyOptions options_;
+
+   public:
+    CopyStatement(std::string table, CopyOptions options)
+        : table_name_(std::move(table)), options_(options) {}
+    [[nodiscard]] StmtType type() const override { return StmtType::Copy; }
+    [[nodiscard]] const std::string& table_name() const { return table_name_; }
+    [[nodiscard]] const CopyOptions& options() const { return options_; }
+    [[nodiscard]] std::string to_string() const override {
+        std::string result = "COPY " + table_name_ + " FROM STDIN WITH (FORMAT ";
+        switch (options_.format) {
+            case CopyFormat::Text:
+                result += "text";
+                break;
+            case CopyFormat::Csv:
+                result += "csv";
+                break;
+            case CopyFormat::Binary:
+                result += "binary";
+                break;
+        }
+        if (options_.format != CopyFormat::Binary) {
+            result += ", DELIMITER '" + std::string(1, options_.delimiter) + "'";
+        }
+        if (options_.header) {
+            result += ", HEADER";
+        }
+        return result + ")";
+    }
+};
+
+/**
+ * @brief SET name = value: changes a setting of the session
+ */
+class SetStatement : public Statement {
+   private:
+    std::string name_;  /**< Lower case */
+    std::string value_; /**< As written, without quotes */
+
+   public:
+    SetStatement(std::string name, std::string value)
+        : name_(std::move(name)), value_(std::move(value)) {}
+    [[nodiscard]] StmtType type() const override { return StmtType::Set; }
+    [[nodiscard]] const std::string& name() const { return name_; }
+    [[nodiscard]] const std::string& value() const { return value_; }
+    [[nodiscard]] std::string to_string() const override {
+        return "SET " + name_ + " = '" + value_ + "'";
+    }
+};
+
 /**
  * @brief BEGIN statement
  */
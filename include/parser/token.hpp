@@ -8,6 +8,7 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <variant>
 
 namespace cloudsql::parser {
@@ -38,6 +39,7 @@ enum class TokenType : uint8_t {
     Not,
     In,
     Like,
+    Between,
     Is,
     Null,
     True,
@@ -75,6 +77,10 @@ enum class TokenType : uint8_t {
     Unique,
     Check,
     Default,
+    Analyze,
+    Copy,
+    Vacuum,
+    Explain,
 
     /* Data Types */
     TypeInt,
@@ -120,27 +126,32 @@ enum class TokenType : uint8_t {
 
 /**
  * @brief Token class with std::variant
+ *
+ * Lexemes and string values are views into the text being lexed (or into
+ * string literals), so a token never allocates; it is valid only while that
+ * text is, which for tokens of a Lexer means while the Lexer lives.
  */
 class Token {
    private:
     TokenType type_;
-    std::string lexeme_;
+    std::string_view lexeme_;
     uint32_t line_;
     uint32_t column_;
 
     /* Type-safe value storage */
-    std::variant<std::monostate, bool, int64_t, double, std::string> value_;
+    std::variant<std::monostate, bool, int64_t, double, std::string_view> value_;
 
    public:
     Token();
     explicit Token(TokenType type);
-    Token(TokenType type, std::string lexeme);
+    Token(TokenType type, std::string_view lexeme);
     Token(TokenType type, const char* lexeme);
-    Token(TokenType type, std::string lexeme, uint32_t line, uint32_t column);
+    Token(TokenType type, std::string_view lexeme, uint32_t line, uint32_t column);
     Token(TokenType type, bool value);
-    Token(TokenType type, int64_t value);
-    Token(TokenType type, double value);
-    Token(TokenType type, std::string value, bool is_string);
+    Token(TokenType type, std::string_view lexeme, int64_t value);
+    Token(TokenType type, std::string_view lexeme, double value);
+    /** @brief A string literal: `lexeme` is quoted, `value` is what the quotes enclose */
+    Token(TokenType type, std::string_view lexeme, std::string_view value);
 
     ~Token() = default;
     Token(const Token& other) = default;
@@ -150,7 +161,7 @@ class Token {
 
     /* Accessors */
     [[nodiscard]] TokenType type() const { return type_; }
-    [[nodiscard]] const std::string& lexeme() const { return lexeme_; }
+    [[nodiscard]] std::string_view lexeme() const { return lexeme_; }
     [[nodiscard]] uint32_t line() const { return line_; }
     [[nodiscard]] uint32_t column() const { return column_; }
 
@@ -182,12 +193,11 @@ class Token {
         }
         return 0.0;
     }
-    [[nodiscard]] const std::string& as_string() const {
-        if (std::holds_alternative<std::string>(value_)) {
-            return std::get<std::string>(value_);
+    [[nodiscard]] std::string_view as_string() const {
+        if (std::holds_alternative<std::string_view>(value_)) {
+            return std::get<std::string_view>(value_);
         }
-        static const std::string empty;
-        return empty;
+        return {};
     }
 
     /* Type queries */
@@ -203,36 +213,26 @@ inline Token::Token() : type_(TokenType::End), line_(0), column_(0), value_(std:
 
 inline Token::Token(TokenType type) : type_(type), line_(0), column_(0), value_(std::monostate{}) {}
 
-inline Token::Token(TokenType type, std::string lexeme)
-    : type_(type), lexeme_(std::move(lexeme)), line_(0), column_(0), value_(std::monostate{}) {}
+inline Token::Token(TokenType type, std::string_view lexeme)
+    : type_(type), lexeme_(lexeme), line_(0), column_(0), value_(std::monostate{}) {}
 
 inline Token::Token(TokenType type, const char* lexeme)
     : type_(type), lexeme_(lexeme), line_(0), column_(0), value_(std::monostate{}) {}
 
-inline Token::Token(TokenType type, std::string lexeme, uint32_t line, uint32_t column)
-    : type_(type),
-      lexeme_(std::move(lexeme)),
-      line_(line),
-      column_(column),
-      value_(std::monostate{}) {}
+inline Token::Token(TokenType type, std::string_view lexeme, uint32_t line, uint32_t column)
+    : type_(type), lexeme_(lexeme), line_(line), column_(column), value_(std::monostate{}) {}
 
 inline Token::Token(TokenType type, bool value)
     : type_(type), lexeme_(value ? "TRUE" : "FALSE"), line_(0), column_(0), value_(value) {}
 
-inline Token::Token(TokenType type, int64_t value)
-    : type_(type), lexeme_(std::to_string(value)), line_(0), column_(0), value_(value) {}
+inline Token::Token(TokenType type, std::string_view lexeme, int64_t value)
+    : type_(type), lexeme_(lexeme), line_(0), column_(0), value_(value) {}
 
-inline Token::Token(TokenType type, double value)
-    : type_(type), lexeme_(std::to_string(value)), line_(0), column_(0), value_(value) {}
+inline Token::Token(TokenType type, std::string_view lexeme, double value)
+    : type_(type), lexeme_(lexeme), line_(0), column_(0), value_(value) {}
 
-inline Token::Token(TokenType type, std::string value, bool is_string)
-    : type_(type),
-      lexeme_(is_string ? "'" + value + "'" : value),
-      line_(0),
-      column_(0),
-      value_(is_string ? std::variant<std::monostate, bool, int64_t, double, std::string>(
-                             std::move(value))
-                       : std::monostate{}) {}
+inline Token::Token(TokenType type, std::string_view lexeme, std::string_view value)
+    : type_(type), lexeme_(lexeme), line_(0), column_(0), value_(value) {}
 
 inline bool Token::is_keyword() const {
     return type_ >= TokenType::Select && type_ <= TokenType::TypeBool;
@@ -251,7 +251,8 @@ inline bool Token::is_identifier() const {
 }
 
 inline std::string Token::to_string() const {
-    return "Token(type=" + std::to_string(static_cast<int>(type_)) + ", lexeme='" + lexeme_ + "')";
+    return "Token(type=" + std::to_string(static_cast<int>(type_)) + ", lexeme='" +
+           std::string(lexeme_) + "')";
 }
 
 }  // namespace cloudsql::parser
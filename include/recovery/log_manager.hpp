@@ -6,14 +6,23 @@
 #ifndef CLOUDSQL_RECOVERY_LOG_MANAGER_HPP
 #define CLOUDSQL_RECOVERY_LOG_MANAGER_HPP
 
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
-#include <fstream>
+#include <cstddef>
+#include <cstdint>
+#include <map>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#include "common/latency_histogram.hpp"
+#include "common/metrics.hpp"
 #include "recovery/log_record.hpp"
+#include "storage/page.hpp"
 
 namespace cloudsql::recovery {
 
@@ -21,12 +30,39 @@ static constexpr lsn_t INVALID_LSN = -1;
 
 /**
  * @brief Manages the WAL buffer and flushing to disk
+ *
+ * Appenders never take latch_ to insert: one fetch_add on the active
+ * buffer's reservation word both assigns the LSN and claims the bytes, so
+ * records are serialized in parallel. Each appender then publishes its
+ * record's size in a per-record link; the flusher writes only the prefix
+ * whose links are all set, with the latch released, and makes it durable
+ * with a single fdatasync. The first claim that no longer fits switches
+ * appenders to the other buffer once the flusher is done with it.
+ *
+ * Group commit: every committer waiting when a flush starts is released by
+ * it. With a commit delay set, the flush thread holds a flush back for up
+ * to that long so later committers can join, unless group_size of them are
+ * waiting already.
  */
 class LogManager {
    public:
-    static constexpr uint32_t PAGE_SIZE = 4096;
+    /* Log records are logical, so the buffer is sized in default pages whatever the data's */
     static constexpr uint32_t BUFFER_PAGES = 16;
-    static constexpr uint32_t DEFAULT_BUFFER_SIZE = PAGE_SIZE * BUFFER_PAGES;
+    static constexpr uint32_t DEFAULT_BUFFER_SIZE =
+        storage::Page::DEFAULT_PAGE_SIZE * BUFFER_PAGES;
+    static constexpr std::chrono::microseconds DEFAULT_COMMIT_DELAY{0};
+    static constexpr size_t DEFAULT_GROUP_SIZE = 16;
+
+    struct Stats {
+        std::atomic<uint64_t> flushes{0};        /**< fdatasync calls, one per group */
+        std::atomic<uint64_t> records_flushed{0};
+        std::atomic<uint64_t> bytes_flushed{0};
+        std::atomic<uint64_t> commits_waited{0}; /**< Committers that waited on a flush */
+        std::atomic<uint64_t> appends_waited{0}; /**< Appenders stalled on a buffer switch */
+        common::LatencyHistogram fsync_latency;  /**< Write plus fdatasync of a group (us) */
+        common::LatencyHistogram group_records;  /**< Records made durable per flush */
+        common::LatencyHistogram group_commits;  /**< Committers released per flush */
+    };
 
     explicit LogManager(std::string log_file_path);
     ~LogManager();
@@ -43,23 +79,40 @@ class LogManager {
     void run_flush_thread();
 
     /**
-     * @brief Stop the flush thread
+     * @brief Stop the flush thread, once everything appended is durable
      */
     void stop_flush_thread();
 
     /**
      * @brief Append a log record to the buffer
+     *
+     * Safe to call from any number of threads at once; only a full buffer
+     * makes an appender wait.
      * @param log_record The record to append (LSN will be set)
      * @return The LSN of the appended record
      */
     lsn_t append_log_record(LogRecord& log_record);
 
     /**
-     * @brief Flush log buffer to disk
-     * @param force If true, force flush even if buffer is not full
+     * @brief Make every record appended so far durable
+     * @param force If true, flush now rather than waiting out the commit delay
      */
     void flush(bool force = false);
 
+    /**
+     * @brief Wait until the record at `lsn` is on stable storage
+     *
+     * Joins the group being formed; without a flush thread, flushes inline.
+     * @return false if the log could not be written or synced
+     */
+    [[nodiscard]] bool wait_durable(lsn_t lsn, bool force = false);
+
+    /** @brief Longest a flush is held back for more committers to join; 0 for none */
+    void set_commit_delay(std::chrono::microseconds delay);
+
+    /** @brief Committers waiting at which a flush goes out without the rest of the delay */
+    void set_group_size(size_t committers);
+
     /**
      * @brief Get the persistent LSN (flushed to disk)
      */
@@ -68,29 +121,115 @@ class LogManager {
     /**
      * @brief Get the next LSN to be assigned
      */
-    lsn_t get_next_lsn() { return next_lsn_.load(); }
+    lsn_t get_next_lsn() const;
+
+    /**
+     * @brief Continue numbering at `lsn`, after the records already in the file
+     *
+     * Only takes effect before the first append; recovery calls it.
+     */
+    void set_next_lsn(lsn_t lsn);
+
+    /**
+     * @brief Cut the log file back to `size` bytes, dropping a torn tail
+     *
+     * Only before the first append; recovery calls it.
+     */
+    [[nodiscard]] bool truncate(uint64_t size);
+
+    /**
+     * @brief File offset at which reading finds every record from `lsn` on
+     *
+     * Exact to within one flush group for records written by this process;
+     * 0 (the start of the file) when nothing earlier is known.
+     */
+    [[nodiscard]] uint64_t offset_before(lsn_t lsn);
+
+    /** @brief Note that the record at `lsn` starts at file offset `offset` */
+    void mark_offset(lsn_t lsn, uint64_t offset);
+
+    /** @brief Forget offsets no longer needed to find `lsn` and later records */
+    void trim_offsets(lsn_t lsn);
+
+    [[nodiscard]] const std::string& log_file_path() const { return log_file_path_; }
+
+    [[nodiscard]] const Stats& get_stats() const { return stats_; }
 
    private:
+    /** Records at least this large are kept out of the buffer, in Buffer::large */
+    static constexpr uint32_t LARGE_RECORD_SIZE = DEFAULT_BUFFER_SIZE / 4;
+    /** At most this many claims fit a buffer, whatever their size */
+    static constexpr uint32_t BUFFER_RECORDS = DEFAULT_BUFFER_SIZE / LogRecord::HEADER_SIZE;
+
+    /**
+     * @brief One of the two insertion buffers; slots_[gen % 2] holds generation `gen`
+     *
+     * Claims are fetch_adds of ((1 << 32) | bytes) on `reserved`, so the
+     * high half numbers the record (LSN = base_lsn + index) and the low half
+     * is its offset. Claims past either limit do not fit; the first of them
+     * closes the buffer.
+     */
+    struct Buffer {
+        std::vector<char> data;
+        std::vector<std::atomic<uint32_t>> links;  /**< Record size once filled, 0 before */
+        std::vector<std::vector<char>> large;      /**< Out-of-buffer large records */
+        std::atomic<uint64_t> reserved{0};
+        std::atomic<uint64_t> gen{0};
+        std::atomic<lsn_t> base_lsn{0};
+        // Under latch_
+        bool closed = false;
+        uint32_t valid_records = 0; /**< Claims that fit, once closed */
+        uint32_t flushed_records = 0;
+        uint32_t flushed_bytes = 0;
+    };
+
     std::string log_file_path_;
-    std::ofstream log_stream_;
+    int log_fd_ = -1;
 
-    uint32_t log_buffer_size_ = DEFAULT_BUFFER_SIZE;
-    char* log_buffer_;
-    uint32_t log_buffer_offset_ = 0;
+    std::array<Buffer, 2> slots_;
+    std::atomic<uint64_t> active_gen_{0};  /**< Generation appenders claim from */
+    uint64_t flush_gen_ = 0;               /**< Oldest generation not fully durable */
+    std::vector<std::pair<const char*, size_t>> pieces_;  /**< Runs being written */
+    uint64_t log_end_ = 0;                 /**< File size once durable writes land */
+    std::map<lsn_t, uint64_t> offsets_;    /**< Sparse: flush group's first LSN -> file offset */
 
     std::mutex latch_;
     std::thread flush_thread_;
-    std::condition_variable cv_;
+    std::condition_variable cv_;          /**< Wakes the flush thread */
+    std::condition_variable durable_cv_;  /**< Wakes committers and appenders after a flush */
+    bool flushing_ = false;               /**< A flush is writing with the latch released */
+    bool io_failed_ = false;
+    size_t waiters_ = 0;                  /**< Committers waiting for the next flush */
+    size_t urgent_waiters_ = 0;           /**< Those of them that skip the commit delay */
+    std::chrono::microseconds commit_delay_ = DEFAULT_COMMIT_DELAY;
+    size_t group_size_ = DEFAULT_GROUP_SIZE;
     std::atomic<bool> enable_flushing_{false};
     std::atomic<bool> stop_flush_thread_flag_{false};
 
-    std::atomic<lsn_t> next_lsn_{0};
     std::atomic<lsn_t> persistent_lsn_{INVALID_LSN};
+    Stats stats_;
+    common::MetricsRegistry::Registration metrics_; /**< Last data member: reads stats_ */
+
+    /**
+     * @brief Close `buf` at the claim that did not fit and open the other buffer
+     *
+     * Called with latch_ held by the appender holding that claim.
+     */
+    void switch_buffer(std::unique_lock<std::mutex>& lock, Buffer& buf, uint32_t records);
+
+    /** @brief Whether the oldest buffer has filled records, or is closed and fully written */
+    [[nodiscard]] bool flush_ready() const;
+
+    /** @brief Flush inline, or wait for the flush in progress; called with latch_ held */
+    void flush_step(std::unique_lock<std::mutex>& lock);
 
     /**
-     * @brief Internal flush implementation without locking
+     * @brief Make the filled prefix of the oldest buffer durable, releasing the latch meanwhile
+     *
+     * Called with latch_ held.
+     * @return false if there was nothing to write, or it could not be written
      */
-    void flush_internal();
+    bool flush_internal(std::unique_lock<std::mutex>& lock);
 
     void flush_thread_loop();
 };
@@ -10,9 +10,11 @@
 #include <cstring>
 #include <iostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "executor/types.hpp"
+#include "storage/buffer_pool_manager.hpp"
 #include "storage/heap_table.hpp"
 
 namespace cloudsql::recovery {
@@ -34,7 +36,21 @@ enum class LogRecordType : uint8_t {
     PREPARE,
     COMMIT,
     ABORT,
-    NEW_PAGE
+    NEW_PAGE,
+    INSERT_BATCH,    /**< Tuples inserted together, one record per heap page */
+    CLR,             /**< Compensation: the undo of one change, never undone itself */
+    CHECKPOINT_BEGIN,
+    CHECKPOINT_END   /**< Active transactions and dirty pages as of the matching BEGIN */
+};
+
+/**
+ * @brief An active transaction as listed in a CHECKPOINT_END record
+ */
+struct CheckpointTxn {
+    txn_id_t txn_id = 0;
+    lsn_t first_lsn = -1; /**< Its BEGIN record */
+    lsn_t last_lsn = -1;  /**< Its latest record */
+    bool prepared = false;
 };
 
 /**
@@ -76,6 +92,18 @@ class LogRecord {
     // For NEW_PAGE:
     uint32_t page_id_ = 0;
 
+    // For INSERT_BATCH: tuples_[i] was inserted at rids_[i]
+    std::vector<storage::HeapTable::TupleId> rids_;
+    std::vector<executor::Tuple> tuples_;
+
+    // For CLR: the change to rids_ that was undone, and the next record left to undo
+    LogRecordType undone_type_ = LogRecordType::INVALID;
+    lsn_t undo_next_lsn_ = -1;
+
+    // For CHECKPOINT_END
+    std::vector<CheckpointTxn> checkpoint_txns_;
+    std::vector<storage::BufferPoolManager::DirtyPage> checkpoint_pages_;
+
     /**
      * @brief Default constructor
      */
@@ -118,6 +146,42 @@ class LogRecord {
           tuple_(std::move(new_tuple)),
           old_tuple_(std::move(old_tuple)) {}
 
+    /**
+     * @brief Constructor for INSERT_BATCH
+     */
+    LogRecord(txn_id_t txn_id, lsn_t prev_lsn, std::string table_name,
+              std::vector<storage::HeapTable::TupleId> rids, std::vector<executor::Tuple> tuples)
+        : prev_lsn_(prev_lsn),
+          txn_id_(txn_id),
+          type_(LogRecordType::INSERT_BATCH),
+          table_name_(std::move(table_name)),
+          rids_(std::move(rids)),
+          tuples_(std::move(tuples)) {}
+
+    /**
+     * @brief Constructor for CLR; `rids` all lie on one heap page
+     * @param undo_next LSN of the transaction's next record to undo, -1 once none is left
+     */
+    LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType undone_type, std::string table_name,
+              std::vector<storage::HeapTable::TupleId> rids, lsn_t undo_next)
+        : prev_lsn_(prev_lsn),
+          txn_id_(txn_id),
+          type_(LogRecordType::CLR),
+          table_name_(std::move(table_name)),
+          rids_(std::move(rids)),
+          undone_type_(undone_type),
+          undo_next_lsn_(undo_next) {}
+
+    /**
+     * @brief Constructor for CHECKPOINT_END
+     */
+    LogRecord(lsn_t prev_lsn, std::vector<CheckpointTxn> txns,
+              std::vector<storage::BufferPoolManager::DirtyPage> pages)
+        : prev_lsn_(prev_lsn),
+          type_(LogRecordType::CHECKPOINT_END),
+          checkpoint_txns_(std::move(txns)),
+          checkpoint_pages_(std::move(pages)) {}
+
     /**
      * @brief Constructor for NEW_PAGE
      */
@@ -155,6 +219,14 @@ class LogRecord {
                 return "ABORT";
             case LogRecordType::NEW_PAGE:
                 return "NEW_PAGE";
+            case LogRecordType::INSERT_BATCH:
+                return "INSERT_BATCH";
+            case LogRecordType::CLR:
+                return "CLR";
+            case LogRecordType::CHECKPOINT_BEGIN:
+                return "CHECKPOINT_BEGIN";
+            case LogRecordType::CHECKPOINT_END:
+                return "CHECKPOINT_END";
             default:
                 return "UNKNOWN";
         }
@@ -171,6 +243,14 @@ class LogRecord {
             log.type_ == LogRecordType::MARK_DELETE || log.type_ == LogRecordType::APPLY_DELETE ||
             log.type_ == LogRecordType::ROLLBACK_DELETE) {
             os << " Table: " << log.table_name_ << " RID: " << log.rid_.to_string();
+        } else if (log.type_ == LogRecordType::INSERT_BATCH) {
+            os << " Table: " << log.table_name_ << " Tuples: " << log.tuples_.size();
+        } else if (log.type_ == LogRecordType::CLR) {
+            os << " Table: " << log.table_name_ << " Tuples: " << log.rids_.size()
+               << " UndoNext: " << log.undo_next_lsn_;
+        } else if (log.type_ == LogRecordType::CHECKPOINT_END) {
+            os << " Txns: " << log.checkpoint_txns_.size()
+               << " DirtyPages: " << log.checkpoint_pages_.size();
         }
 
         return os;
@@ -6,8 +6,15 @@
 #ifndef CLOUDSQL_RECOVERY_RECOVERY_MANAGER_HPP
 #define CLOUDSQL_RECOVERY_RECOVERY_MANAGER_HPP
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "catalog/catalog.hpp"
@@ -20,11 +27,46 @@ namespace cloudsql::recovery {
 /**
  * @class RecoveryManager
  * @brief Manages ARIES-style crash recovery (Analysis, Redo, Undo)
+ *
+ * Recovery reads the log from the point the last complete checkpoint says is
+ * enough: the earliest of the checkpoint's BEGIN record, the oldest change a
+ * dirty page lacked on disk, and the first record of every transaction then
+ * active. That point is kept in a master file next to the log
+ * ("<log>.ckpt"), replaced atomically once a checkpoint's END record is durable.
+ *
+ * Redo repeats history: records of every transaction are replayed by
+ * workers that each own a set of heap pages, in log order, skipping those
+ * the page LSN shows already applied. Undo then rolls back transactions
+ * without a COMMIT, ABORT or PREPARE, one worker per group of them, writing a
+ * CLR per undone change so a repeated crash never undoes anything twice.
+ * Prepared transactions are left in doubt for their coordinator.
+ *
+ * Indexes are not logged, so they are not recovered here.
  */
 class RecoveryManager {
    public:
-    RecoveryManager(storage::BufferPoolManager& bpm, Catalog& catalog, LogManager& log_manager)
-        : bpm_(bpm), catalog_(catalog), log_manager_(log_manager) {}
+    struct Stats {
+        uint64_t records_scanned = 0;
+        uint64_t bytes_ignored = 0; /**< Torn or unreadable log tail, truncated */
+        lsn_t scan_lsn = INVALID_LSN;
+        lsn_t redo_lsn = INVALID_LSN;
+        uint64_t dirty_pages = 0;
+        uint64_t redo_applied = 0;
+        uint64_t redo_skipped = 0; /**< Already on the page, by its page LSN */
+        uint64_t losers = 0;
+        uint64_t clrs_written = 0;
+        uint64_t in_doubt = 0;
+        uint64_t unknown_tables = 0; /**< Records for tables the catalog lacks */
+        uint64_t analysis_us = 0;
+        uint64_t redo_us = 0;
+        uint64_t undo_us = 0;
+    };
+
+    /**
+     * @param threads Redo and undo workers; 0 for one per hardware thread
+     */
+    RecoveryManager(storage::BufferPoolManager& bpm, Catalog& catalog, LogManager& log_manager,
+                    size_t threads = 0);
 
     ~RecoveryManager() = default;
 
@@ -36,22 +78,75 @@ class RecoveryManager {
 
     /**
      * @brief Perform crash recovery
+     *
+     * Must run before anything else appends to the log. Ends with a
+     * checkpoint, so the next recovery starts after this one.
      * @return true if successful
      */
     bool recover();
 
+    /**
+     * @brief Take a fuzzy checkpoint without pausing transactions
+     * @param active_txns Called after the BEGIN record is logged for the
+     *        transactions then active
+     * @param spread If nonzero, first write the pages already dirty, paced over this
+     *        long, so the new checkpoint's redo point is close to its BEGIN record
+     * @return true once the checkpoint is durable and the master file points to it
+     */
+    bool checkpoint(const std::function<std::vector<CheckpointTxn>()>& active_txns,
+                    std::chrono::milliseconds spread = std::chrono::milliseconds(0));
+
+    /** @brief Prepared transactions found by the last recover(), awaiting their outcome */
+    [[nodiscard]] const std::vector<CheckpointTxn>& in_doubt() const { return in_doubt_; }
+
+    /**
+     * @brief Heap changes of a transaction in doubt, in log order
+     *
+     * Lets TransactionManager::restore_prepared() rebuild its undo log and row locks.
+     */
+    [[nodiscard]] std::vector<LogRecord> changes_of(txn_id_t txn_id) const;
+
+    /** @brief Highest transaction id in the log, 0 if none */
+    [[nodiscard]] txn_id_t max_txn_id() const { return max_txn_id_; }
+
+    [[nodiscard]] const Stats& get_stats() const { return stats_; }
+
+    /** @brief Path of the master file recording where recovery starts */
+    [[nodiscard]] std::string master_path() const;
+
    private:
+    using PageKey = std::pair<std::string, uint32_t>; /**< Heap file name, page */
+
+    struct Master {
+        lsn_t begin_lsn = INVALID_LSN;
+        uint64_t scan_offset = 0;
+    };
+
+    [[nodiscard]] bool read_master(Master& out) const;
+    [[nodiscard]] bool write_master(const Master& master) const;
+
+    /** @brief Read every intact record from `offset` on, truncating a torn tail */
+    bool load(uint64_t offset);
     void analyze();
     void redo();
     void undo();
 
+    [[nodiscard]] size_t workers_for(size_t tasks) const;
+
     storage::BufferPoolManager& bpm_;
     Catalog& catalog_;
     LogManager& log_manager_;
+    size_t threads_;
 
     // Recovery states
-    std::unordered_map<txn_id_t, lsn_t> active_txns_;
-    lsn_t max_lsn_{0};
+    std::vector<LogRecord> records_;                   /**< From the scan start, in LSN order */
+    std::unordered_map<lsn_t, size_t> by_lsn_;         /**< LSN -> index in records_ */
+    std::unordered_map<txn_id_t, CheckpointTxn> att_;  /**< Active transaction table */
+    std::map<PageKey, lsn_t> dpt_;                     /**< Dirty page table: page -> rec_lsn */
+    std::vector<CheckpointTxn> in_doubt_;
+    txn_id_t max_txn_id_ = 0;
+    lsn_t max_lsn_{INVALID_LSN};
+    Stats stats_;
 };
 
 }  // namespace cloudsql::recovery
@@ -0,0 +1,152 @@
+/**
+ * @file brin_index.hpp
+ * @brief Block-range index: key bounds per range of heap pages
+ */
+
+#ifndef CLOUDSQL_STORAGE_BRIN_INDEX_HPP
+#define CLOUDSQL_STORAGE_BRIN_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common/value.hpp"
+#include "storage/btree_index.hpp"
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/heap_table.hpp"
+#include "storage/index.hpp"
+
+namespace cloudsql::storage {
+
+/**
+ * @brief On-disk BRIN index
+ *
+ * Summarizes every pages_per_range consecutive heap pages by the smallest and
+ * largest key inserted into them and whether any key was NULL. Page 0 is a
+ * meta page; summaries follow, a fixed-size RangeSummary per range. On a table
+ * whose key grows with insertion order, such as an event time, each range
+ * covers a narrow band of keys, and a range predicate reads only the ranges
+ * that overlap it, for an index a few thousandths the size of a B-tree.
+ *
+ * Summaries only widen. Removing an entry leaves its range's bounds as they
+ * are, which keeps them correct, if looser, until the index is rebuilt. A
+ * range with no summary yet always matches.
+ */
+class BrinIndex : public Index {
+   public:
+    using Bound = BTreeIndex::Bound;
+
+    /**
+     * @brief Contents of page 0
+     */
+    struct MetaPage {
+        uint32_t magic;
+        uint32_t pages_per_range;
+        uint32_t range_count; /**< Ranges with a summary slot; later ones have none */
+    };
+
+    /** Bytes of a text bound kept in a summary; longer keys are cut to a prefix */
+    static constexpr size_t BOUND_BYTES = 28;
+
+    /**
+     * @brief Bounds of one page range. Numbers are stored as int64 or double
+     * by column type, text as a prefix of at most BOUND_BYTES
+     */
+    struct RangeSummary {
+        uint8_t flags;
+        uint8_t min_len;
+        uint8_t max_len;
+        uint8_t reserved[5];
+        char min[BOUND_BYTES];
+        char max[BOUND_BYTES];
+    };
+
+    static constexpr uint8_t SUMMARIZED = 0x01;
+    static constexpr uint8_t HAS_VALUES = 0x02;
+    static constexpr uint8_t HAS_NULLS = 0x04;
+    static constexpr uint8_t MAX_UNBOUNDED = 0x08; /**< A text key too long to bound from above */
+
+    static constexpr uint32_t META_PAGE = 0;
+    static constexpr uint32_t META_MAGIC = 0x4E495242; /* "BRIN" */
+    static constexpr uint32_t DEFAULT_PAGES_PER_RANGE = 16;
+
+    /** @return true for the key types a BRIN index can bound (numbers and text) */
+    [[nodiscard]] static bool supports(common::ValueType type);
+
+    /**
+     * @param pages_per_range Range size of an index create() makes; an existing
+     * index keeps the size it was created with
+     */
+    BrinIndex(std::string index_name, BufferPoolManager& bpm, common::ValueType key_type,
+              uint32_t pages_per_range = DEFAULT_PAGES_PER_RANGE);
+    ~BrinIndex() override = default;
+
+    BrinIndex(const BrinIndex&) = delete;
+    BrinIndex& operator=(const BrinIndex&) = delete;
+    BrinIndex(BrinIndex&&) noexcept = default;
+    BrinIndex& operator=(BrinIndex&&) noexcept = delete;
+
+    [[nodiscard]] const std::string& index_name() const override { return index_name_; }
+    [[nodiscard]] const std::string& filename() const override { return filename_; }
+    [[nodiscard]] common::ValueType key_type() const override { return key_type_; }
+    [[nodiscard]] bool ordered() const override { return false; }
+    [[nodiscard]] bool summarizing() const override { return true; }
+
+    bool create() override;
+    bool open() override;
+    void close() override;
+    bool drop() override;
+
+    /** @brief Widen the summary of the range holding `tuple_id` to cover `key` */
+    bool insert(const common::Value& key, HeapTable::TupleId tuple_id) override;
+
+    /** @brief A no-op: summaries stay as wide as they are */
+    bool remove(const common::Value& key, HeapTable::TupleId tuple_id) override;
+
+    /** @brief Summarize a batch in memory, writing each summary page once */
+    bool bulk_load(std::vector<Entry> entries) override;
+
+    /** @return Nothing: the index holds no tuple ids */
+    [[nodiscard]] std::vector<HeapTable::TupleId> search(const common::Value& key) override;
+
+    /**
+     * @return Heap pages that may hold keys within the bounds, in page order
+     * with adjacent ranges merged; pages past the last summary are included, up
+     * to the end of the heap. An absent upper bound also matches NULL keys.
+     */
+    [[nodiscard]] std::vector<HeapTable::PageRange> matching_ranges(
+        const std::optional<Bound>& lower, const std::optional<Bound>& upper);
+
+    /** @return The meta page; magic is 0 if the index is unreadable */
+    [[nodiscard]] MetaPage meta();
+
+   private:
+    [[nodiscard]] common::Value bound_value(const RangeSummary& summary, bool max) const;
+    void store_bound(RangeSummary& summary, const common::Value& key, bool max) const;
+    /** @brief Widen `summary` to cover `key` */
+    void merge(RangeSummary& summary, const common::Value& key) const;
+    /** @brief Widen `into` to cover everything `from` does */
+    void merge(RangeSummary& into, const RangeSummary& from) const;
+    [[nodiscard]] bool overlaps(const RangeSummary& summary, const std::optional<Bound>& lower,
+                                const std::optional<Bound>& upper) const;
+
+    /** @brief Give the first `range_count` ranges summary slots, clearing new ones */
+    bool extend(uint32_t range_count);
+
+    [[nodiscard]] uint32_t summary_page(uint32_t range) const;
+    [[nodiscard]] size_t summary_offset(uint32_t range) const;
+
+    std::string index_name_;
+    std::string filename_;
+    BufferPoolManager& bpm_;
+    size_t page_size_;
+    common::ValueType key_type_;
+    uint32_t pages_per_range_;
+    uint32_t summaries_per_page_;
+};
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_BRIN_INDEX_HPP
@@ -8,24 +8,49 @@
 
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "common/value.hpp"
 #include "storage/buffer_pool_manager.hpp"
 #include "storage/heap_table.hpp"
+#include "storage/index.hpp"
+#include "storage/page_guard.hpp"
 
 namespace cloudsql::storage {
 
 /**
  * @brief B+ Tree index for fast lookups
+ *
+ * Page 0 of the index file is a meta page naming the root; every other page is a
+ * node. Nodes are slotted: a sorted array of uint16 cell offsets follows the
+ * NodeHeader and cells grow down from the end of the page. Entries are ordered
+ * by (key, tuple id), which makes duplicate keys and exact deletes well defined
+ * and lets internal separators carry the same pair.
+ *
+ *   leaf cell:     uint16 key_len | key | uint32 tid.page | uint16 tid.slot
+ *   internal cell: leaf cell | uint32 child (subtree with entries >= the cell)
+ *
+ * Keys are stored as a type byte followed by a fixed-width integer/float/bool or
+ * the raw bytes of a string, and compare without materialising a Value.
+ *
+ * Concurrency uses latch crabbing on the page latches. Readers descend with shared
+ * latches and release a parent once its child is latched. Writers first try an
+ * optimistic descent: they hold the meta page shared, take shared latches all the
+ * way down and an exclusive latch on the leaf only. If the leaf would split (or
+ * underflow on delete), the writer lets go and restarts pessimistically. The
+ * restart takes the meta page exclusively and holds exclusive latches on the
+ * whole root-to-leaf path until the structure change is complete. Only
+ * pessimistic writers change the shape of the tree, so optimistic writers never
+ * see a node move under them.
  */
-class BTreeIndex {
+class BTreeIndex : public Index {
    public:
     /**
      * @brief Node types in the B+ Tree
      */
-    enum class NodeType : uint8_t { Leaf = 0, Internal = 1 };
+    enum class NodeType : uint8_t { Leaf = 0, Internal = 1, Free = 2 };
 
     /**
      * @brief Page header for B-tree nodes
@@ -33,30 +58,55 @@ class BTreeIndex {
     struct NodeHeader {
         NodeType type;
         uint16_t num_keys;
-        uint32_t parent_page;
-        uint32_t next_leaf;  // For leaf nodes
+        uint16_t free_space_offset; /**< Start of the cell area */
+        uint32_t next_leaf;         /**< Right sibling of a leaf (0 = none) */
+        uint32_t first_child;       /**< Leftmost child of an internal node; next free page */
     };
 
     /**
-     * @brief Index entry (Key + TupleId)
+     * @brief Contents of page 0
      */
-    struct Entry {
-        common::Value key;
-        HeapTable::TupleId tuple_id;
+    struct MetaPage {
+        uint32_t magic;
+        uint32_t root_page;
+        uint32_t page_count; /**< Pages allocated so far, including the meta page */
+        uint32_t free_list;  /**< First page released by a merge (0 = none) */
+        uint32_t height;     /**< Levels including the leaves */
+    };
+
+    static constexpr uint32_t META_PAGE = 0;
+    static constexpr uint32_t META_MAGIC = 0x42505431; /* "BPT1" */
 
-        Entry() = default;
-        Entry(common::Value k, HeapTable::TupleId tid) : key(std::move(k)), tuple_id(tid) {}
+    /** Encoded keys longer than this are rejected so every node can hold four cells */
+    static constexpr size_t MAX_KEY_SIZE = 512;
+
+    using Entry = Index::Entry;
+
+    /**
+     * @brief One end of a key range
+     */
+    struct Bound {
+        common::Value key;
+        bool inclusive = true;
     };
 
     /**
      * @brief Scan iterator for index
+     *
+     * Walks the leaf chain in (key, tuple id) order, stopping past the upper
+     * bound of a range scan.
      */
     class Iterator {
        private:
+        friend class BTreeIndex;
+
         BTreeIndex& index_;
         uint32_t current_page_;
         uint16_t current_slot_;
         bool eof_ = false;
+        bool has_upper_ = false;
+        bool upper_inclusive_ = true;
+        std::string upper_; /**< Encoded upper bound */
 
        public:
         Iterator(BTreeIndex& index, uint32_t page, uint16_t slot);
@@ -69,13 +119,13 @@ class BTreeIndex {
     std::string index_name_;
     std::string filename_;
     BufferPoolManager& bpm_;
+    size_t page_size_; /**< Node size; the fan-out follows from it */
     common::ValueType key_type_;
-    uint32_t root_page_ = 0;
 
    public:
     BTreeIndex(std::string index_name, BufferPoolManager& bpm, common::ValueType key_type);
 
-    ~BTreeIndex() = default;
+    ~BTreeIndex() override = default;
 
     /* Non-copyable */
     BTreeIndex(const BTreeIndex&) = delete;
@@ -85,30 +135,85 @@ class BTreeIndex {
     BTreeIndex(BTreeIndex&&) noexcept = default;
     BTreeIndex& operator=(BTreeIndex&&) noexcept = delete;
 
-    [[nodiscard]] const std::string& index_name() const { return index_name_; }
-    [[nodiscard]] common::ValueType key_type() const { return key_type_; }
+    [[nodiscard]] const std::string& index_name() const override { return index_name_; }
+    [[nodiscard]] const std::string& filename() const override { return filename_; }
+    [[nodiscard]] common::ValueType key_type() const override { return key_type_; }
+    [[nodiscard]] bool ordered() const override { return true; }
+
+    bool create() override;
+    bool open() override;
+    void close() override;
+    bool drop() override;
+
+    /**
+     * @brief Insert an entry; inserting an entry that is already present is a no-op
+     * @return false if the key is too large or the tree cannot be updated
+     */
+    bool insert(const common::Value& key, HeapTable::TupleId tuple_id) override;
 
-    bool create();
-    bool open();
-    void close();
-    bool drop();
+    /**
+     * @brief Remove an exact (key, tuple id) entry, merging or redistributing
+     *        underfull nodes; removing an absent entry is a no-op
+     */
+    bool remove(const common::Value& key, HeapTable::TupleId tuple_id) override;
 
-    bool insert(const common::Value& key, HeapTable::TupleId tuple_id);
-    bool remove(const common::Value& key, HeapTable::TupleId tuple_id);
+    /**
+     * @brief Build the tree bottom-up from a batch of entries
+     *
+     * Entries are sorted if necessary, packed into leaves left to right and then
+     * into internal levels until a single root remains. Only an empty index is
+     * bulk loaded; otherwise the entries are inserted one by one.
+     * @return false if any entry could not be added
+     */
+    bool bulk_load(std::vector<Entry> entries) override;
 
-    [[nodiscard]] std::vector<HeapTable::TupleId> search(const common::Value& key);
+    [[nodiscard]] std::vector<HeapTable::TupleId> search(const common::Value& key) override;
 
     [[nodiscard]] Iterator scan();
 
+    /**
+     * @brief Iterate the entries with keys between `lower` and `upper` in key order
+     *
+     * An absent bound leaves that end open. NULL keys sort after all others, as
+     * NULL does in Value's ordering, so an open upper end includes them. A string
+     * bound too long to be a key widens the range rather than narrowing it.
+     */
+    [[nodiscard]] Iterator scan_range(const std::optional<Bound>& lower,
+                                      const std::optional<Bound>& upper);
+
+    /** @return Number of levels, including the leaf level (0 if the index is unreadable) */
+    [[nodiscard]] uint32_t height();
+
    private:
     /* Internal B-tree logic */
-    [[nodiscard]] uint32_t find_leaf(const common::Value& key) const;
-    void split_leaf(uint32_t page_num, char* buffer);
-    // void split_internal(...) // TODO phase 2
+    struct PathStep {
+        WritePageGuard guard; /**< Exclusive latch held until the structure change ends */
+        uint32_t page;
+        uint16_t child_index; /**< Which child of `page` the descent took (0 = first_child) */
+    };
 
-    bool read_page(uint32_t page_num, char* buffer) const;
-    bool write_page(uint32_t page_num, const char* buffer);
-    [[nodiscard]] uint32_t allocate_page();
+    bool read_meta(MetaPage* out);
+    [[nodiscard]] ReadPageGuard find_leaf_read(ReadPageGuard meta_guard, const std::string& key,
+                                               HeapTable::TupleId tuple_id);
+    /** @brief Iterator positioned at the first entry within `lower`, unbounded above */
+    [[nodiscard]] Iterator seek(const Bound& lower);
+    [[nodiscard]] WritePageGuard find_leaf_optimistic(const MetaPage& meta,
+                                                      const std::string& key,
+                                                      HeapTable::TupleId tuple_id);
+    [[nodiscard]] WritePageGuard find_leaf_pessimistic(const MetaPage& meta,
+                                                       const std::string& key,
+                                                       HeapTable::TupleId tuple_id,
+                                                       std::vector<PathStep>* path);
+    void split_leaf(MetaPage& meta, char* buffer, const NodeHeader& header,
+                    const std::vector<std::string>& cells, std::string* separator);
+    void split_internal(MetaPage& meta, char* buffer, const NodeHeader& header,
+                        const std::vector<std::string>& cells, std::string* separator);
+    bool insert_into_parent(MetaPage& meta, std::vector<PathStep>& path, uint32_t left_page,
+                            std::string separator);
+    void rebalance(MetaPage& meta, std::vector<PathStep>& path, WritePageGuard node);
+
+    [[nodiscard]] uint32_t allocate_page(MetaPage& meta);
+    void free_page(MetaPage& meta, uint32_t page_num);
 };
 
 }  // namespace cloudsql::storage
@@ -6,15 +6,24 @@
 #ifndef CLOUDSQL_STORAGE_BUFFER_POOL_MANAGER_HPP
 #define CLOUDSQL_STORAGE_BUFFER_POOL_MANAGER_HPP
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <list>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
-#include "storage/lru_replacer.hpp"
+#include "common/metrics.hpp"
+#include "storage/frame_memory.hpp"
 #include "storage/page.hpp"
+#include "storage/replacer.hpp"
+#include "storage/page_guard.hpp"
 #include "storage/storage_manager.hpp"
 
 namespace cloudsql::recovery {
@@ -23,20 +32,71 @@ class LogManager;
 
 namespace cloudsql::storage {
 
+/**
+ * @brief How a page is being accessed, used to keep scans out of the hot set
+ */
+enum class AccessType : uint8_t {
+    Normal, /**< Point lookups, index traversal, writes */
+    Scan    /**< Sequential scans; pages loaded only by scans are evicted first */
+};
+
 /**
  * @class BufferPoolManager
  * @brief Wraps StorageManager to provide an in-memory cache of disk pages
+ *
+ * Frames are split into independently latched partitions. A page always maps to the
+ * same partition (by hashing its (file_id, page_id) key), so fetch/unpin traffic on
+ * different pages rarely contends on the same latch.
+ *
+ * Frame data sits in one contiguous region, huge-page backed when large enough,
+ * apart from the Page metadata array. With FrameOptions::numa the partitions are
+ * divided evenly among the NUMA nodes and each node's frames are allocated on
+ * it, so a large pool is spread across the nodes' memory instead of landing on
+ * whichever node happened to touch it first.
  */
 class BufferPoolManager {
    public:
+    static constexpr size_t MAX_PARTITIONS = 16;
+    static constexpr size_t MIN_FRAMES_PER_PARTITION = 64;
+
+    struct Stats {
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> evictions{0};
+        std::atomic<uint64_t> dirty_evictions{0};
+        std::atomic<uint64_t> prefetched{0};    /**< Pages loaded by read-ahead */
+        std::atomic<uint64_t> prefetch_hits{0}; /**< Read-ahead pages later fetched */
+        std::atomic<uint64_t> background_writes{0}; /**< Written ahead of eviction */
+        std::atomic<uint64_t> checkpoint_writes{0}; /**< Written by flush_dirty_pages */
+    };
+
+    /** @brief Background writer tuning */
+    struct WriterOptions {
+        std::chrono::milliseconds interval{200}; /**< Pause between cleaning rounds */
+        size_t clean_target = 0; /**< Clean evictable frames kept across the pool */
+        size_t max_pages = 100;  /**< Pages written per round */
+    };
+
+    /** @brief A page with changes not yet on disk, for fuzzy checkpoints */
+    struct DirtyPage {
+        std::string file_name;
+        uint32_t page_id = 0;
+        int32_t rec_lsn = -1; /**< Earliest logged change the disk copy may lack */
+    };
+
     /**
      * @brief Creates a new Buffer Pool Manager
      * @param pool_size Size of the buffer pool in number of pages
      * @param storage_manager Reference to the underlying storage manager
      * @param log_manager Pointer to the log manager (can be null if WAL is disabled)
+     * @param num_partitions Number of latch partitions (0 picks one from pool_size)
+     * @param policy Frame replacement policy used by every partition
+     * @param frame_options Huge page and NUMA placement of the frame memory
      */
     BufferPoolManager(size_t pool_size, StorageManager& storage_manager,
-                      recovery::LogManager* log_manager = nullptr);
+                      recovery::LogManager* log_manager = nullptr, size_t num_partitions = 0,
+                      ReplacerPolicy policy = ReplacerPolicy::Lru,
+                      const FrameOptions& frame_options = {});
 
     ~BufferPoolManager();
 
@@ -50,9 +110,39 @@ class BufferPoolManager {
      * @brief Fetch the requested page from the buffer pool
      * @param file_name The file the page belongs to
      * @param page_id The id of the page
+     * @param access Access pattern hint for the replacement policy
      * @return Pointer to the Page, or nullptr if cannot fetch
      */
-    Page* fetch_page(const std::string& file_name, uint32_t page_id);
+    Page* fetch_page(const std::string& file_name, uint32_t page_id,
+                     AccessType access = AccessType::Normal);
+
+    /**
+     * @brief Fetch a page pinned and share-latched for in-place reads
+     * @return Guard that is invalid if the page cannot be fetched
+     */
+    [[nodiscard]] ReadPageGuard fetch_page_read(const std::string& file_name, uint32_t page_id,
+                                                AccessType access = AccessType::Normal);
+
+    /**
+     * @brief Fetch a page pinned and exclusively latched; it is unpinned dirty on release
+     * @return Guard that is invalid if the page cannot be fetched
+     */
+    [[nodiscard]] WritePageGuard fetch_page_write(const std::string& file_name, uint32_t page_id);
+
+    /**
+     * @brief Asynchronously load a run of pages ahead of a sequential reader
+     *
+     * Non-resident pages in [first_page, first_page + count) are claimed, read in
+     * one batched submission by a background thread, and left unpinned for the
+     * reader to hit. Pages past end of file are skipped. A fetch that races with
+     * the read waits on the page latch until the data is in place.
+     */
+    void prefetch_pages(const std::string& file_name, uint32_t first_page, uint32_t count);
+
+    /**
+     * @brief Block until all queued read-ahead requests have completed
+     */
+    void wait_for_prefetch();
 
     /**
      * @brief Unpin the target page
@@ -96,37 +186,205 @@ class BufferPoolManager {
      */
     void flush_all_pages();
 
+    /**
+     * @brief Start a thread that keeps the coldest frames clean ahead of demand
+     *
+     * Each round walks every partition's replacer in eviction order and writes the
+     * dirty, unpinned frames among the next clean_target / partitions victims, so a
+     * fetch that has to evict usually finds a clean frame. Frames stay where they are
+     * in the replacer while being written. Restarting replaces the options.
+     */
+    void start_background_writer(const WriterOptions& options);
+
+    /**
+     * @brief Stop the background writer, if running
+     */
+    void stop_background_writer();
+
+    /**
+     * @brief Write every page whose changes since its last write began at or before an LSN
+     *
+     * Used by checkpoints to move the redo point forward. Writes go out in small batches
+     * paced to finish about `spread` after the call, so they do not compete with
+     * foreground I/O in one burst. Pages pinned when their turn comes are skipped.
+     * @return Number of pages written
+     */
+    size_t flush_dirty_pages(int32_t max_rec_lsn, std::chrono::milliseconds spread);
+
+    /**
+     * @brief Pages changed by logged operations and not written since
+     *
+     * Taken partition by partition, without stopping writers.
+     */
+    [[nodiscard]] std::vector<DirtyPage> dirty_page_table() const;
+
     /**
      * @brief Get pointer to log manager
      */
     [[nodiscard]] recovery::LogManager* get_log_manager() const { return log_manager_; }
 
+    /**
+     * @brief Get the storage manager the pool reads and writes through
+     */
+    [[nodiscard]] StorageManager& get_storage_manager() const { return storage_manager_; }
+
+    /**
+     * @brief Number of independently latched page table partitions
+     */
+    [[nodiscard]] size_t partition_count() const { return partitions_.size(); }
+
+    /**
+     * @brief Replacement policy in use
+     */
+    [[nodiscard]] ReplacerPolicy policy() const { return policy_; }
+
+    /**
+     * @brief Bytes per page, as fixed for the database by the storage manager
+     */
+    [[nodiscard]] uint32_t page_size() const { return storage_manager_.page_size(); }
+
+    /**
+     * @brief Kind of memory page backing the frame region
+     */
+    [[nodiscard]] FrameBacking frame_backing() const { return frame_memory_.backing(); }
+
+    /**
+     * @brief NUMA nodes the partitions are spread over (1 unless FrameOptions::numa)
+     */
+    [[nodiscard]] int numa_node_count() const { return numa_nodes_; }
+
+    /**
+     * @brief NUMA node whose memory holds a partition's frames
+     */
+    [[nodiscard]] int partition_node(size_t partition) const {
+        return partitions_[partition]->numa_node;
+    }
+
+    /**
+     * @brief Hit/miss/eviction counters
+     */
+    [[nodiscard]] const Stats& get_stats() const { return stats_; }
+
    private:
+    friend class ReadPageGuard;
+    friend class WritePageGuard;
+
+    /**
+     * @brief Unpin a frame handed out by a page guard
+     */
+    bool unpin_page(Page* page, bool is_dirty);
+
+    /**
+     * @brief A slice of the pool's frames with its own latch, page table and replacer
+     */
+    struct Partition {
+        Partition(ReplacerPolicy policy, size_t num_frames, uint32_t first_frame)
+            : replacer(make_replacer(policy, num_frames, first_frame)) {}
+
+        // Node the partition's frame memory was placed on
+        int numa_node = 0;
+
+        // To protect concurrent accesses to page_table, free_list and replacer
+        std::mutex latch;
+
+        // Replacer over this partition's frames
+        std::unique_ptr<Replacer> replacer;
+
+        // List of free frame IDs
+        std::list<uint32_t> free_list;
+
+        // Maps page keys (file_id << 32 | page_id) to frame IDs
+        std::unordered_map<uint64_t, uint32_t> page_table;
+    };
+
     /**
-     * @brief Generates a unique string key for file and page mapping
+     * @brief Packs an interned file id and a page id into a single table key
      */
-    static std::string make_page_key(const std::string& file_name, uint32_t page_id) {
-        return file_name + "_" + std::to_string(page_id);
+    static uint64_t make_page_key(uint32_t file_id, uint32_t page_id) {
+        return (static_cast<uint64_t>(file_id) << 32U) | page_id;
     }
 
+    [[nodiscard]] Partition& partition_for(uint64_t key) const;
+
+    /**
+     * @brief Grab a free or evictable frame of the partition (caller holds its latch)
+     */
+    bool acquire_frame(Partition& part, uint32_t* frame_id);
+
+    bool unpin_key(uint64_t key, bool is_dirty);
+
+    /**
+     * @brief Write a frame back, after making the log durable up to its page LSN
+     * @return true if the write succeeded
+     */
+    bool write_back(Page* page);
+
+    /**
+     * @brief Pin a dirty, unpinned frame for a write outside the latch (caller holds it)
+     *
+     * The frame is left in the replacer; acquire_frame() skips it until released.
+     * @return false if the frame is pinned, clean or still being read in
+     */
+    bool claim_for_write(uint32_t frame_id);
+
+    /**
+     * @brief Write frames claimed from `part` as one batch and release them
+     * @return Number of pages written
+     */
+    size_t write_claimed(Partition& part, const std::vector<uint32_t>& frames);
+
+    void background_writer();
+
+    /** @brief Export stats_ to the metrics registry, labelled with a per-process pool number */
+    void register_metrics();
+
+    /** @brief Forget a written frame's rec_lsn, unless a change raced the write */
+    static void mark_written(Page* page, int32_t rec_lsn);
+
+    /** @brief Reset the LSNs of a frame just given a new page */
+    static void reset_lsns(Page* page);
+
+    struct PrefetchRequest {
+        std::string file_name;
+        uint32_t first_page = 0;
+        uint32_t count = 0;
+    };
+
+    void prefetch_worker();
+    void read_ahead(const PrefetchRequest& request);
+
     size_t pool_size_;
     StorageManager& storage_manager_;
     recovery::LogManager* log_manager_;
+    ReplacerPolicy policy_;
+    Stats stats_;
 
-    // To protect concurrent accesses to page_table_ and replacer_
-    std::mutex latch_;
-
-    // The actual array of pages
+    // Frame data, page_size() bytes per frame, and the per-frame metadata pointing into it
+    FrameMemory frame_memory_;
     std::unique_ptr<Page[]> pages_;
+    int numa_nodes_ = 1;
+
+    // Page table partitions, each owning a contiguous range of frames
+    std::vector<std::unique_ptr<Partition>> partitions_;
 
-    // Replacer instance
-    LRUReplacer replacer_;
+    // Read-ahead queue, drained by a lazily started background thread
+    std::mutex prefetch_latch_;
+    std::condition_variable prefetch_cv_;
+    std::condition_variable prefetch_idle_cv_;
+    std::deque<PrefetchRequest> prefetch_queue_;
+    size_t prefetch_active_ = 0;
+    bool prefetch_stop_ = false;
+    std::thread prefetch_thread_;
 
-    // List of free frame IDs
-    std::list<uint32_t> free_list_;
+    // Background writer, started on request
+    std::mutex writer_latch_;
+    std::condition_variable writer_cv_;
+    WriterOptions writer_options_;
+    bool writer_stop_ = false;
+    std::thread writer_thread_;
 
-    // Maps page keys (file+pageId) to frame IDs
-    std::unordered_map<std::string, uint32_t> page_table_;
+    // Last, so the collector is unregistered before anything it reads is destroyed
+    common::MetricsRegistry::Registration metrics_;
 };
 
 }  // namespace cloudsql::storage
@@ -0,0 +1,67 @@
+/**
+ * @file clock_replacer.hpp
+ * @brief CLOCK (second-chance) replacement policy for the buffer pool
+ */
+
+#ifndef CLOUDSQL_STORAGE_CLOCK_REPLACER_HPP
+#define CLOUDSQL_STORAGE_CLOCK_REPLACER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "storage/replacer.hpp"
+
+namespace cloudsql::storage {
+
+/**
+ * @class ClockReplacer
+ * @brief Approximates LRU with a reference bit per frame and a sweeping hand
+ *
+ * Unlike LRUReplacer, pinning and unpinning only flip flags in fixed arrays, so hot
+ * frames never move between lists.
+ */
+class ClockReplacer : public Replacer {
+   public:
+    /**
+     * @param num_frames Number of frames tracked
+     * @param first_frame Frame id of the first tracked frame
+     */
+    explicit ClockReplacer(size_t num_frames, uint32_t first_frame = 0);
+
+    ~ClockReplacer() override = default;
+
+    // Disable copy/move
+    ClockReplacer(const ClockReplacer&) = delete;
+    ClockReplacer& operator=(const ClockReplacer&) = delete;
+    ClockReplacer(ClockReplacer&&) = delete;
+    ClockReplacer& operator=(ClockReplacer&&) = delete;
+
+    bool victim(uint32_t* frame_id) override;
+    void pin(uint32_t frame_id) override;
+    void unpin(uint32_t frame_id) override;
+    void unpin_cold(uint32_t frame_id) override;
+    void peek_victims(size_t max_frames, std::vector<uint32_t>* frames) const override;
+    [[nodiscard]] size_t size() const override;
+
+   private:
+    [[nodiscard]] bool owns(uint32_t frame_id) const {
+        return frame_id >= first_frame_ && frame_id - first_frame_ < num_frames_;
+    }
+
+    size_t num_frames_;
+    uint32_t first_frame_;
+    mutable std::mutex latch_;
+    std::vector<bool> present_;    /* Frame is unpinned and evictable */
+    std::vector<bool> reference_;  /* Second-chance bit */
+    std::vector<bool> cold_;       /* Frame was unpinned by a scan */
+    std::deque<uint32_t> cold_queue_;
+    size_t hand_ = 0;
+    size_t count_ = 0;
+};
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_CLOCK_REPLACER_HPP
@@ -0,0 +1,103 @@
+/**
+ * @file column_encoding.hpp
+ * @brief Lightweight per-chunk encodings for columnar storage
+ *
+ * A column file is a sequence of chunks, each a ChunkHeader followed by an
+ * optional null bitmap (one bit per row, set = NULL) and the encoded values.
+ * Chunks start on 8-byte boundaries and their values are 8-byte aligned, so
+ * plain fixed-width values can be used in place from a memory mapping.
+ * The encoder tries every encoding that applies to the chunk and keeps the
+ * smallest, so a chunk never grows beyond its plain form:
+ *
+ *   Plain      fixed 8-byte values, or uint32 lengths followed by string bytes
+ *   Rle        (int64 value, uint32 run length) pairs
+ *   BitPacked  frame of reference: int64 minimum, width byte, packed offsets
+ *   Delta      int64 first value, int64 minimum delta, width byte, packed deltas
+ *   Dictionary uint32 entry count, length-prefixed entries, packed codes
+ *
+ * Floating point values are encoded through their bit patterns, so every
+ * encoding is lossless for them too. Values in NULL rows are not significant;
+ * writers should repeat a neighbouring value there to keep runs and deltas short.
+ */
+
+#ifndef CLOUDSQL_STORAGE_COLUMN_ENCODING_HPP
+#define CLOUDSQL_STORAGE_COLUMN_ENCODING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cloudsql::storage {
+
+enum class ColumnEncoding : uint8_t {
+    Plain = 0,
+    Rle = 1,
+    BitPacked = 2,
+    Delta = 3,
+    Dictionary = 4
+};
+
+/**
+ * @struct ChunkHeader
+ * @brief On-disk header preceding every chunk of a column file
+ */
+struct ChunkHeader {
+    uint32_t row_count;
+    uint32_t payload_size;  /**< Bytes after the header, null bitmap and padding included */
+    uint32_t values_offset; /**< Start of the encoded values within the payload */
+    ColumnEncoding encoding;
+    uint8_t has_nulls; /**< A null bitmap of (row_count + 7) / 8 bytes leads the payload */
+    uint16_t reserved;
+};
+
+/** Alignment of chunks within a column file and of the values within a chunk */
+constexpr size_t CHUNK_ALIGNMENT = sizeof(int64_t);
+static_assert(sizeof(ChunkHeader) % CHUNK_ALIGNMENT == 0, "chunk headers must keep alignment");
+
+/** @return Human-readable encoding name */
+[[nodiscard]] const char* column_encoding_name(ColumnEncoding encoding);
+
+/**
+ * @brief Encode integers (or bit-cast doubles) with the smallest applicable encoding
+ * @param out Receives the encoded bytes (appended)
+ */
+ColumnEncoding encode_int_chunk(const int64_t* values, size_t count, std::string* out);
+
+/**
+ * @brief Encode strings as Plain or Dictionary, whichever is smaller
+ * @param out Receives the encoded bytes (appended)
+ */
+ColumnEncoding encode_string_chunk(const std::string* values, size_t count, std::string* out);
+
+/**
+ * @brief Decode rows [begin, begin + count) of an integer chunk of `rows` values
+ * @return false if the data is malformed
+ */
+bool decode_int_chunk(ColumnEncoding encoding, const char* data, size_t size, size_t rows,
+                      size_t begin, size_t count, int64_t* out);
+
+/**
+ * @brief Decode rows [begin, begin + count) of a string chunk of `rows` values
+ * @return false if the data is malformed
+ */
+bool decode_string_chunk(ColumnEncoding encoding, const char* data, size_t size, size_t rows,
+                         size_t begin, size_t count, std::string* out);
+
+/**
+ * @brief Decode only the rows at `positions` (ascending) of an integer chunk
+ *
+ * `out[i]` receives row `positions[i]`. Plain and bit-packed data is read at
+ * those rows alone; run-length and delta data is walked once, up to the last
+ * of them.
+ * @return false if the data is malformed
+ */
+bool decode_int_rows(ColumnEncoding encoding, const char* data, size_t size, size_t rows,
+                     const uint32_t* positions, size_t count, int64_t* out);
+
+/** @brief decode_int_rows() for a string chunk; plain lengths are summed up to the last row */
+bool decode_string_rows(ColumnEncoding encoding, const char* data, size_t size, size_t rows,
+                        const uint32_t* positions, size_t count, std::string* out);
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_COLUMN_ENCODING_HPP
@@ -6,44 +6,281 @@
 #ifndef CLOUDSQL_STORAGE_COLUMNAR_TABLE_HPP
 #define CLOUDSQL_STORAGE_COLUMNAR_TABLE_HPP
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <vector>
 
 #include "executor/types.hpp"
+#include "storage/column_encoding.hpp"
+#include "storage/mapped_file.hpp"
+#include "storage/page.hpp"
 #include "storage/storage_manager.hpp"
 
 namespace cloudsql::storage {
 
+/** Comparison a ColumnPredicate applies between a column and its constant */
+enum class CompareOp : uint8_t { Eq, Ne, Lt, Le, Gt, Ge, IsNull, IsNotNull };
+
+/**
+ * @brief A single-column condition a scan can test against chunk statistics
+ *
+ * The value is ignored for IsNull / IsNotNull.
+ */
+struct ColumnPredicate {
+    size_t column;
+    CompareOp op;
+    common::Value value;
+};
+
 /**
  * @brief A table implementation that stores data by column
+ *
+ * Each column lives in `<table>.col<i>.data.bin` as a sequence of independently
+ * encoded chunks of at most chunk_rows() rows (see column_encoding.hpp). The chunk
+ * directory is rebuilt from the chunk headers on open() and extended by appends.
+ *
+ * Reads go through one read-only mapping per column file, created by open() and
+ * refreshed after an append. A batch that lies inside one plain-encoded chunk
+ * of a fixed-width column references the mapping instead of being copied.
+ *
+ * Every column is chunked at the same row boundaries. For each chunk the meta
+ * file keeps a zone map (min / max / NULL count per column) so scans can skip
+ * chunks that cannot satisfy their predicates without touching the data files.
+ *
+ * append_batch() is the bulk path: it encodes the batch straight into chunks.
+ * Small writes go to the delta instead. insert_batch() adds rows to an
+ * in-memory columnar buffer that follows the sealed chunks, and delete_rows()
+ * marks rows of either part in a delete bitmap. Both first append a record to
+ * `<table>.delta.log` and sync it, and open() replays the log. compact() seals
+ * whole chunks of the delta into encoded chunks (a DeltaCompactor does so in
+ * the background) and then rewrites the log to what is still in memory.
+ *
+ * Row ids are stable: a delta row keeps its id when sealed, and a deleted row
+ * keeps its place, masked by live_mask(). A reader therefore sees the same
+ * rows whether or not a compaction ran between two of its calls, so reads,
+ * writes and compaction may run on different threads. Writers are serialized
+ * among themselves; readers wait only while a change is published.
  */
 class ColumnarTable {
+   public:
+    /** Rows per chunk at Page::DEFAULT_PAGE_SIZE; chunks grow with the database's pages */
+    static constexpr uint32_t CHUNK_ROWS = 4096;
+
+    /**
+     * @brief Statistics of one chunk of a column
+     *
+     * Bounds are kept in the encoder representation: integers as-is, booleans
+     * as 0 / 1 and doubles as their bit patterns (compare after bit-casting).
+     */
+    struct ZoneMap {
+        int64_t min = 0;
+        int64_t max = 0;
+        uint32_t null_count = 0;
+        uint8_t has_bounds = 0; /**< min / max hold at least one non-NULL, non-NaN value */
+        uint8_t known = 0;      /**< 0 for chunks written before zone maps were recorded */
+        uint16_t reserved = 0;
+    };
+
+    /**
+     * @brief Location of one chunk of a column file
+     */
+    struct ChunkInfo {
+        uint64_t first_row;
+        uint64_t offset; /**< File offset of the ChunkHeader */
+        ChunkHeader header;
+        ZoneMap zone;
+    };
+
    private:
     std::string name_;
     StorageManager& storage_manager_;
     executor::Schema schema_;
-    uint64_t row_count_ = 0;
+    std::atomic<uint64_t> row_count_{0}; /**< Sealed rows, then delta rows */
+    uint64_t sealed_rows_ = 0;           /**< Rows in chunks */
+    std::vector<std::vector<ChunkInfo>> chunks_; /**< Per column, ordered by first_row */
+    std::vector<std::shared_ptr<const MappedFile>> mappings_; /**< Per column; null = stale */
+    std::mutex mappings_mutex_; /**< Lets concurrent read_batch() calls map lazily */
+
+    std::unique_ptr<executor::VectorBatch> delta_; /**< Rows [sealed_rows_, row_count_) */
+    std::vector<bool> deleted_; /**< Per row; empty until the first delete */
+    uint64_t deleted_count_ = 0;
+    int log_fd_ = -1; /**< `<table>.delta.log`, opened for appending */
+
+    /* Readers share state_mutex_; writers hold write_mutex_ throughout and
+       state_mutex_ only while they publish a change */
+    mutable std::shared_mutex state_mutex_;
+    std::mutex write_mutex_;
+
+    [[nodiscard]] std::string column_path(size_t column) const;
+    [[nodiscard]] std::string log_path() const;
+    [[nodiscard]] std::shared_ptr<const MappedFile> column_mapping(size_t column);
+
+    /**
+     * @brief Decode rows [start_row, start_row + rows) of `column` into its batch column
+     * @param selection Batch positions to decode (ascending), or null for all rows
+     */
+    bool read_column(size_t column, uint64_t start_row, uint32_t rows,
+                     const std::vector<uint32_t>* selection, executor::VectorBatch& out_batch);
+
+    /** @brief Copy rows of `column` in the delta, from `start_row` on, into its batch column */
+    bool read_delta_column(size_t column, uint64_t start_row, uint32_t rows,
+                           executor::VectorBatch& out_batch);
+
+    /**
+     * @brief Encode rows [begin, begin + rows) of `batch` as chunks after the
+     * sealed ones and append them to the column files
+     * @param directories Receives the new chunks of each column, not yet published
+     */
+    bool write_chunks(const executor::VectorBatch& batch, size_t begin, size_t rows,
+                      std::vector<std::vector<ChunkInfo>>& directories);
+
+    /** @brief Adds chunks written by write_chunks() to the directory */
+    void publish_chunks(std::vector<std::vector<ChunkInfo>>& directories, uint64_t rows);
+
+    /** @brief compact() with write_mutex_ held */
+    bool compact_locked(bool seal_all);
+
+    bool write_meta();
+
+    /** @brief Appends one record to the delta log and syncs it */
+    bool log_record(const std::string& record);
+
+    /** @brief Replaces the delta log with the delta and its deletes, which meta lacks */
+    bool rewrite_log();
+
+    /** @brief Opens the delta log, replays what meta does not cover and cuts a torn tail */
+    bool replay_log();
 
    public:
     ColumnarTable(std::string name, StorageManager& storage, executor::Schema schema)
         : name_(std::move(name)), storage_manager_(storage), schema_(std::move(schema)) {}
 
+    /**
+     * Copies share the mapped column files and snapshot the delta; each has its
+     * own locks. Only one of them should take writes.
+     */
+    ColumnarTable(const ColumnarTable& other);
+    ColumnarTable& operator=(const ColumnarTable&) = delete;
+    ColumnarTable(ColumnarTable&&) = delete;
+    ColumnarTable& operator=(ColumnarTable&&) = delete;
+    ~ColumnarTable();
+
     bool create();
     bool open();
 
+    /**
+     * @brief Delete the table's files
+     *
+     * Copies keep reading the columns they have mapped; the table itself must
+     * not be used afterwards.
+     */
+    bool drop();
+
+    /** @return Rows per chunk written by append_batch() */
+    [[nodiscard]] uint32_t chunk_rows() const {
+        return CHUNK_ROWS * (storage_manager_.page_size() / Page::DEFAULT_PAGE_SIZE);
+    }
+
     /**
      * @brief Load a batch of data from the table
+     *
+     * Safe to call from several threads at once, and while writes run. A
+     * batch does not cross from the sealed rows into the delta, so it may be
+     * shorter than asked for. Deleted rows are included; see live_mask().
      */
     bool read_batch(uint64_t start_row, uint32_t batch_size, executor::VectorBatch& out_batch);
 
     /**
-     * @brief Append a batch of data to the table
+     * @brief Load only `columns` of a batch, as read_batch() would
+     *
+     * The other columns of the batch are sized to the rows read but hold
+     * default values, so their files are not touched. A scan reads the
+     * columns its filter needs this way, then fetch_columns() the rest.
+     */
+    bool read_columns(uint64_t start_row, uint32_t batch_size, const std::vector<size_t>& columns,
+                      executor::VectorBatch& out_batch);
+
+    /**
+     * @brief Load `columns` of a batch shaped by read_columns() at `selection` only
+     *
+     * `selection` holds ascending positions within the batch that starts at
+     * `start_row`, or is null when every row is wanted; the other rows of
+     * those columns keep default values. A
+     * batch inside one plain chunk of a fixed-width column still references
+     * the whole range, which costs less than decoding any of it.
+     */
+    bool fetch_columns(uint64_t start_row, const std::vector<size_t>& columns,
+                       const std::vector<uint32_t>* selection, executor::VectorBatch& out_batch);
+
+    /**
+     * @brief Append a batch of data to the table as chunks of its own
+     *
+     * For bulk loads; the delta is sealed first so rows keep their order.
      */
     bool append_batch(const executor::VectorBatch& batch);
 
-    [[nodiscard]] uint64_t row_count() const { return row_count_; }
+    /**
+     * @brief Add the rows of `batch` to the delta, logged and synced first
+     * @param first_row Set to the id of the first row added
+     */
+    bool insert_batch(const executor::VectorBatch& batch, uint64_t* first_row = nullptr);
+
+    /**
+     * @brief Mark `rows` deleted, logged and synced first
+     * @return false, deleting nothing, if a row id is not below row_count()
+     */
+    bool delete_rows(const std::vector<uint64_t>& rows);
+
+    /**
+     * @brief Seal the delta into encoded chunks
+     * @param seal_all Also seal a last partial chunk; otherwise only whole
+     * chunks of chunk_rows() rows are sealed and the rest stays in the delta
+     * @return false on I/O errors; the delta then stays as it was
+     */
+    bool compact(bool seal_all = false);
+
+    /**
+     * @brief Clear `keep` at the deleted rows of [start_row, start_row + rows)
+     * @return false, leaving `keep` untouched, if none of them is deleted
+     */
+    bool live_mask(uint64_t start_row, size_t rows, executor::NumericVector<bool>& keep) const;
+
+    [[nodiscard]] bool is_deleted(uint64_t row) const;
+
+    [[nodiscard]] uint64_t row_count() const { return row_count_.load(); }
+    [[nodiscard]] uint64_t sealed_rows() const;
+    [[nodiscard]] uint64_t delta_rows() const;
+    [[nodiscard]] uint64_t deleted_count() const;
+
+    /** @brief Directory of `column`; not to be held across writes to the table */
+    [[nodiscard]] const std::vector<ChunkInfo>& chunks(size_t column) const {
+        return chunks_.at(column);
+    }
+    [[nodiscard]] const std::string& name() const { return name_; }
     [[nodiscard]] const executor::Schema& schema() const { return schema_; }
+
+    /** @return Number of sealed chunks, identical for every column */
+    [[nodiscard]] size_t chunk_count() const;
+
+    /**
+     * @return Index of the chunk holding `row` (row < row_count()); rows of the
+     * delta all belong to one more chunk, index chunk_count(), that has no zone map
+     */
+    [[nodiscard]] size_t chunk_index(uint64_t row) const;
+
+    /** @return One past the last row of chunk `index` */
+    [[nodiscard]] uint64_t chunk_end_row(size_t index) const;
+
+    /**
+     * @brief Test the AND of `predicates` against the zone maps of a chunk
+     * @return false only if no row of the chunk can satisfy all predicates
+     */
+    [[nodiscard]] bool chunk_may_match(size_t index,
+                                       const std::vector<ColumnPredicate>& predicates) const;
 };
 
 }  // namespace cloudsql::storage
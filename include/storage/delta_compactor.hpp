@@ -0,0 +1,87 @@
+/**
+ * @file delta_compactor.hpp
+ * @brief Background sealing of ColumnarTable deltas into encoded chunks
+ */
+
+#ifndef CLOUDSQL_STORAGE_DELTA_COMPACTOR_HPP
+#define CLOUDSQL_STORAGE_DELTA_COMPACTOR_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "storage/columnar_table.hpp"
+
+namespace cloudsql::storage {
+
+/**
+ * @class DeltaCompactor
+ * @brief Seals the deltas of registered columnar tables once they fill a chunk
+ *
+ * ColumnarTable::insert_batch() only logs rows and keeps them in memory. The
+ * worker wakes every naptime and compacts each table whose delta holds at
+ * least chunk_rows() rows, sealing whole chunks and leaving the remainder for
+ * later, so small inserts still end up in full, well-compressed chunks.
+ * Scans go on during a compaction; row ids do not change.
+ *
+ * Tables are held weakly and forgotten once nothing else owns them.
+ */
+class DeltaCompactor {
+   public:
+    struct Options {
+        std::chrono::milliseconds naptime{1000}; /**< Between checks for full deltas */
+    };
+
+    DeltaCompactor() = default;
+    ~DeltaCompactor();
+
+    DeltaCompactor(const DeltaCompactor&) = delete;
+    DeltaCompactor& operator=(const DeltaCompactor&) = delete;
+    DeltaCompactor(DeltaCompactor&&) = delete;
+    DeltaCompactor& operator=(DeltaCompactor&&) = delete;
+
+    void add_table(const std::shared_ptr<ColumnarTable>& table);
+
+    /**
+     * @brief Compact every table whose delta fills a chunk now
+     * @return Tables compacted
+     */
+    size_t compact_all();
+
+    /**
+     * @brief Start the worker; does nothing if it is running
+     */
+    void start(const Options& options);
+
+    /**
+     * @brief Stop the worker, letting it finish the table it is on
+     */
+    void stop();
+
+    /** @return Compactions done so far, by the worker or compact_all() */
+    [[nodiscard]] uint64_t compactions() const {
+        return compactions_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    void run();
+
+    std::mutex tables_mutex_;
+    std::vector<std::weak_ptr<ColumnarTable>> tables_;
+
+    Options options_;
+    std::atomic<uint64_t> compactions_{0};
+    std::mutex worker_latch_;
+    std::condition_variable worker_cv_;
+    bool worker_stop_ = false;
+    std::thread worker_;
+};
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_DELTA_COMPACTOR_HPP
@@ -0,0 +1,91 @@
+/**
+ * @file frame_memory.hpp
+ * @brief Contiguous, huge-page-backed memory for buffer pool frames
+ */
+
+#ifndef CLOUDSQL_STORAGE_FRAME_MEMORY_HPP
+#define CLOUDSQL_STORAGE_FRAME_MEMORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cloudsql::storage {
+
+/**
+ * @brief How the buffer pool lays out its frame memory
+ */
+struct FrameOptions {
+    bool huge_pages = true; /**< Back pools of 2 MB or more with huge pages */
+    bool numa = false;      /**< Partition the pool per NUMA node, each node-local */
+};
+
+/**
+ * @brief What the frame region ended up backed by
+ */
+enum class FrameBacking : uint8_t {
+    Pages = 0,           /**< Ordinary base pages */
+    TransparentHuge = 1, /**< Base-page mapping the kernel is asked to back with THP */
+    HugeTlb = 2          /**< Reserved 2 MB pages (MAP_HUGETLB) */
+};
+
+/** @return "pages", "thp" or "hugetlb" */
+[[nodiscard]] const char* frame_backing_name(FrameBacking backing);
+
+/**
+ * @class FrameMemory
+ * @brief One anonymous mapping holding every frame of a pool, back to back
+ *
+ * Keeping frame data apart from the frame metadata means a scan over the pool
+ * touches a dense run of pages, and a 64 GB pool needs 32K TLB entries rather
+ * than 16M. Huge pages come from the reserved hugetlb pool when the system has
+ * enough, otherwise the region is 2 MB-aligned and advised for transparent huge
+ * pages; regions smaller than one huge page use base pages. The memory is zero
+ * and not yet faulted in, so bind() can still choose where it lands.
+ */
+class FrameMemory {
+   public:
+    static constexpr size_t HUGE_PAGE_SIZE = 2UL * 1024 * 1024;
+
+    /**
+     * @brief Map frame_count * frame_size bytes
+     * @throws std::bad_alloc if the region cannot be mapped
+     */
+    FrameMemory(size_t frame_count, size_t frame_size, bool huge_pages);
+    ~FrameMemory();
+
+    // Disable copy/move
+    FrameMemory(const FrameMemory&) = delete;
+    FrameMemory& operator=(const FrameMemory&) = delete;
+    FrameMemory(FrameMemory&&) = delete;
+    FrameMemory& operator=(FrameMemory&&) = delete;
+
+    [[nodiscard]] char* frame(size_t frame_id) const { return base_ + frame_id * frame_size_; }
+
+    [[nodiscard]] FrameBacking backing() const { return backing_; }
+
+    /** @brief Bytes mapped, rounded up to the backing page size */
+    [[nodiscard]] size_t mapped_bytes() const { return length_; }
+
+    /**
+     * @brief Prefer NUMA node `node` for the frames [first_frame, first_frame + count)
+     *
+     * Range ends are rounded to the nearest backing page, so binding consecutive
+     * ranges gives every page exactly one node. Must be called before the frames
+     * are first touched.
+     * @return false if the kernel refused the policy (the memory stays usable)
+     */
+    bool bind(size_t first_frame, size_t count, int node);
+
+    /** @return Online NUMA nodes, 1 on non-NUMA systems */
+    [[nodiscard]] static int numa_node_count();
+
+   private:
+    char* base_ = nullptr;
+    size_t length_ = 0;
+    size_t frame_size_;
+    FrameBacking backing_ = FrameBacking::Pages;
+};
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_FRAME_MEMORY_HPP
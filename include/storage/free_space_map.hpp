@@ -0,0 +1,98 @@
+/**
+ * @file free_space_map.hpp
+ * @brief Per-table map of approximate free space, persisted in a ".fsm" fork file
+ *
+ * Each heap page is summarised by one byte: its free bytes divided by
+ * granule() (1/256 of a page), rounded down, so the map may understate but never overstate the
+ * room on a page. Map pages start with a small header whose max_category is an
+ * upper bound over the page's entries, letting a search skip pages with no
+ * candidate; the bound is tightened whenever a full scan of the page fails.
+ * Map page 0 also records how many heap pages are tracked and where the last
+ * successful search ended, so append-heavy tables resume at the tail.
+ */
+
+#ifndef CLOUDSQL_STORAGE_FREE_SPACE_MAP_HPP
+#define CLOUDSQL_STORAGE_FREE_SPACE_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cloudsql::storage {
+
+class BufferPoolManager;
+
+/**
+ * @class FreeSpaceMap
+ * @brief Finds heap pages with room for a record without walking the heap
+ *
+ * The map is advisory: callers re-check the page itself and call record() with
+ * the true value when it disagrees.
+ */
+class FreeSpaceMap {
+   public:
+    static constexpr uint32_t INVALID_PAGE = UINT32_MAX;
+
+    /**
+     * @struct MapPageHeader
+     * @brief Header at the start of every map page
+     */
+    struct MapPageHeader {
+        uint32_t tracked_pages; /**< Heap pages covered by the map (page 0 only) */
+        uint32_t search_hint;   /**< Heap page where the next search starts (page 0 only) */
+        uint8_t max_category;   /**< Upper bound of the entries on this map page */
+    };
+
+    /**
+     * @brief Constructor
+     * @param filename Name of the fork file (e.g. "users.fsm")
+     * @param bpm Buffer pool through which map pages are cached
+     */
+    FreeSpaceMap(std::string filename, BufferPoolManager& bpm);
+
+    /** @return Name of the fork file */
+    [[nodiscard]] const std::string& filename() const { return filename_; }
+
+    /**
+     * @brief Find a heap page believed to have at least `needed` free bytes
+     * @return Heap page number, or INVALID_PAGE if no tracked page qualifies
+     */
+    [[nodiscard]] uint32_t find_page(size_t needed);
+
+    /**
+     * @brief Record the current free bytes of a heap page
+     */
+    void record(uint32_t page_num, size_t free_bytes);
+
+    /**
+     * @brief Forget all tracked pages (the heap is being recreated)
+     */
+    void reset();
+
+    /** @return Number of heap pages tracked; the first page past them is where to extend */
+    [[nodiscard]] uint32_t page_count();
+
+    /** @return Map category for a free byte count (rounded down) */
+    [[nodiscard]] uint8_t category_for(size_t free_bytes) const;
+
+    /** @return Free bytes per map category */
+    [[nodiscard]] size_t granule() const { return granule_; }
+
+    /** @return Heap pages summarised by one map page */
+    [[nodiscard]] size_t entries_per_page() const { return entries_per_page_; }
+
+   private:
+    /** @brief Search heap pages [begin, end) for an entry of at least `want` */
+    uint32_t search(uint32_t begin, uint32_t end, uint8_t want);
+
+    void set_search_hint(uint32_t page_num);
+
+    std::string filename_;
+    BufferPoolManager& bpm_;
+    size_t granule_;
+    size_t entries_per_page_;
+};
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_FREE_SPACE_MAP_HPP
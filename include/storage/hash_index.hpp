@@ -0,0 +1,143 @@
+/**
+ * @file hash_index.hpp
+ * @brief Extendible hash index for equality lookups
+ */
+
+#ifndef CLOUDSQL_STORAGE_HASH_INDEX_HPP
+#define CLOUDSQL_STORAGE_HASH_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/value.hpp"
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/heap_table.hpp"
+#include "storage/index.hpp"
+#include "storage/page_guard.hpp"
+
+namespace cloudsql::storage {
+
+/**
+ * @brief On-disk extendible hash index
+ *
+ * Page 0 is a meta page holding the global depth and the list of directory
+ * pages. The directory has 2^global_depth slots, each naming the bucket page
+ * for the hashes whose low global_depth bits are the slot number; a bucket of
+ * local depth d is named by the 2^(global_depth - d) slots that agree on its
+ * low d bits. A full bucket splits on its next hash bit, doubling the
+ * directory first if its depth is already the global depth. Entries that hash
+ * alike cannot be told apart by any split and go to overflow pages chained
+ * from the bucket. Buckets never merge; removing entries only frees room.
+ *
+ *   cell: uint32 hash | uint16 key_len | key | uint32 tid.page | uint16 tid.slot
+ *
+ * Keys are encoded so that values Value compares equal encode alike (2 and
+ * 2.0 both as an integer), and a lookup compares the stored hash before any
+ * key bytes.
+ *
+ * A bucket's own latch guards its whole overflow chain. Lookups and writes
+ * that fit hold the meta page shared until the bucket is latched; a write
+ * that must split or chain restarts holding the meta page exclusively, which
+ * keeps every other operation out of the directory while it changes.
+ */
+class HashIndex : public Index {
+   public:
+    /**
+     * @brief Contents of page 0, followed by the uint32 page ids of the directory
+     */
+    struct MetaPage {
+        uint32_t magic;
+        uint32_t global_depth;
+        uint32_t page_count;      /**< Pages allocated so far, including the meta page */
+        uint32_t free_list;       /**< First page released by a split (0 = none) */
+        uint32_t directory_pages; /**< Directory pages listed after this header */
+    };
+
+    /**
+     * @brief Header of a bucket or overflow page; cells follow it back to back
+     */
+    struct BucketHeader {
+        uint32_t magic;
+        uint16_t local_depth;
+        uint16_t num_entries;
+        uint32_t used;     /**< Bytes of cells */
+        uint32_t overflow; /**< Next page of the chain (0 = none); next free page */
+    };
+
+    static constexpr uint32_t META_PAGE = 0;
+    static constexpr uint32_t META_MAGIC = 0x48534831;   /* "HSH1" */
+    static constexpr uint32_t BUCKET_MAGIC = 0x48534b42; /* "HSKB" */
+
+    /** Encoded keys longer than this are rejected so every bucket holds several */
+    static constexpr size_t MAX_KEY_SIZE = 512;
+
+    HashIndex(std::string index_name, BufferPoolManager& bpm, common::ValueType key_type);
+    ~HashIndex() override = default;
+
+    HashIndex(const HashIndex&) = delete;
+    HashIndex& operator=(const HashIndex&) = delete;
+    HashIndex(HashIndex&&) noexcept = default;
+    HashIndex& operator=(HashIndex&&) noexcept = delete;
+
+    [[nodiscard]] const std::string& index_name() const override { return index_name_; }
+    [[nodiscard]] const std::string& filename() const override { return filename_; }
+    [[nodiscard]] common::ValueType key_type() const override { return key_type_; }
+    [[nodiscard]] bool ordered() const override { return false; }
+
+    bool create() override;
+    bool open() override;
+    void close() override;
+    bool drop() override;
+
+    bool insert(const common::Value& key, HeapTable::TupleId tuple_id) override;
+    bool remove(const common::Value& key, HeapTable::TupleId tuple_id) override;
+
+    /**
+     * @brief Insert a batch, sizing the directory for it first if the index is empty
+     */
+    bool bulk_load(std::vector<Entry> entries) override;
+
+    [[nodiscard]] std::vector<HeapTable::TupleId> search(const common::Value& key) override;
+
+    /** @return Hash bits the directory is indexed by (0 if the index is unreadable) */
+    [[nodiscard]] uint32_t global_depth();
+
+    /** @return Deepest directory the page size allows */
+    [[nodiscard]] uint32_t max_global_depth() const { return max_depth_; }
+
+   private:
+    enum class Placement : uint8_t { Added, Present, Full, Failed };
+
+    [[nodiscard]] uint32_t directory_slot(const char* meta_page, uint32_t slot);
+    bool set_directory_slot(const char* meta_page, uint32_t slot, uint32_t bucket);
+    bool double_directory(char* meta_page, MetaPage& meta);
+    /** @brief Turn an empty depth-0 index into 2^depth empty buckets */
+    bool presize(char* meta_page, MetaPage& meta, uint32_t depth);
+
+    /** @brief Add `cell` to the first page of the chain with room, unless already there */
+    Placement place(WritePageGuard& bucket, const std::string& cell);
+    /** @brief Split a full bucket on its next hash bit */
+    bool split(char* meta_page, MetaPage& meta, uint32_t slot, WritePageGuard& bucket,
+               uint32_t incoming_hash);
+    /** @brief Lay `cells` out from `first` on, taking overflow pages from `spare` */
+    bool write_chain(char* first, const std::vector<std::string>& cells, uint16_t depth,
+                     MetaPage& meta, std::vector<uint32_t>& spare);
+    bool append_overflow(MetaPage& meta, WritePageGuard& bucket, const std::string& cell);
+
+    [[nodiscard]] uint32_t allocate_page(MetaPage& meta);
+    void free_page(MetaPage& meta, uint32_t page_num);
+
+    std::string index_name_;
+    std::string filename_;
+    BufferPoolManager& bpm_;
+    size_t page_size_;
+    common::ValueType key_type_;
+    uint32_t slots_per_page_; /**< Directory slots in one directory page */
+    uint32_t max_depth_;
+};
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_HASH_INDEX_HPP
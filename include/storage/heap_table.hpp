@@ -5,6 +5,23 @@
  * This implementation uses a slotted page structure to manage variable-length
  * records within fixed-size database pages.
  *
+ * Binary pages (PAGE_FLAG_BINARY_TUPLES) grow the slot directory forward from the
+ * header and tuple data backward from the end of the page. Each record is:
+ *
+ *   TupleHeader | uint16 length | uint16 num_columns | null bitmap | fixed area | varlena
+ *
+ * Fixed-width columns (integers, floats, bool) live at offsets computed from the
+ * schema; variable-length columns store a (uint16 offset, uint16 length) descriptor
+ * in the fixed area pointing into the varlena tail. Pages without the flag use the
+ * legacy pipe-delimited text layout and remain readable.
+ *
+ * Inserts are placed through a FreeSpaceMap kept in a "<table>.fsm" fork file.
+ *
+ * Binary pages initialised with PAGE_FLAG_PAGE_LSN end in the int32 LSN of
+ * the latest logged change applied to them, which crash recovery compares
+ * against before redoing a record. Binary pages written before the flag
+ * existed have no trailer and report no page LSN.
+ *
  * @defgroup storage Storage Engine
  * @{
  */
@@ -12,13 +29,17 @@
 #ifndef CLOUDSQL_STORAGE_HEAP_TABLE_HPP
 #define CLOUDSQL_STORAGE_HEAP_TABLE_HPP
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "executor/types.hpp"
 #include "storage/buffer_pool_manager.hpp"
+#include "storage/free_space_map.hpp"
 
 namespace cloudsql::storage {
 
@@ -63,6 +84,15 @@ class HeapTable {
         uint16_t flags;             /**< Page-level metadata flags */
     };
 
+    /** PageHeader::flags bit marking the binary tuple layout */
+    /** Appended to the table name to name its heap file */
+    static constexpr const char* FILE_EXTENSION = ".heap";
+    static constexpr uint16_t PAGE_FLAG_BINARY_TUPLES = 0x0001;
+    /** PageHeader::flags bit: the last bytes of the page hold its page LSN */
+    static constexpr uint16_t PAGE_FLAG_PAGE_LSN = 0x0002;
+    /** Page LSN of pages that have none, or have seen no logged change */
+    static constexpr int32_t NO_PAGE_LSN = -1;
+
     /**
      * @struct TupleHeader
      * @brief MVCC metadata prepended to every tuple
@@ -82,9 +112,24 @@ class HeapTable {
         uint64_t xmax = 0;
     };
 
+    /**
+     * @struct PageRange
+     * @brief Pages [first, end) of the heap
+     */
+    struct PageRange {
+        /** `end` of a range that runs to the end of the heap */
+        static constexpr uint32_t TO_END = UINT32_MAX;
+
+        uint32_t first;
+        uint32_t end;
+    };
+
     /**
      * @class Iterator
      * @brief Forward-only iterator for scanning heap table records
+     *
+     * Once a scan has moved past its first pages it asks the buffer pool to read
+     * ahead, doubling the window each time the scan consumes half of it.
      */
     class Iterator {
        private:
@@ -92,10 +137,33 @@ class HeapTable {
         TupleId next_id_;  /**< ID of the next record to be checked */
         TupleId last_id_;  /**< ID of the record returned by the last next() call */
         bool eof_ = false; /**< End-of-file indicator */
+        uint32_t read_ahead_window_ = 0; /**< Current read-ahead size in pages */
+        uint32_t read_ahead_until_ = 0;  /**< First page not yet requested for read-ahead */
+        bool ranged_ = false;            /**< Only the pages of ranges_ are read */
+        std::vector<PageRange> ranges_;
+        size_t range_ = 0; /**< Range holding next_id_ */
+
+        /** @brief Grow and issue read-ahead as the scan enters a new page */
+        void read_ahead();
+
+        /** @brief Step to the first slot of the next page the scan covers */
+        void next_page();
+
+        /** @brief Start range `range_`, or end the scan past the last one */
+        void enter_range();
 
        public:
+        /** Decides from a record's MVCC header whether next_batch() keeps it */
+        using VisibilityFn = std::function<bool(uint64_t xmin, uint64_t xmax)>;
+
         explicit Iterator(HeapTable& table);
 
+        /**
+         * @brief Scan of the given pages only
+         * @param ranges Ascending and disjoint; the scan still ends at the end of the heap
+         */
+        Iterator(HeapTable& table, std::vector<PageRange> ranges);
+
         /**
          * @brief Fetches the next non-deleted record from the heap
          * @param[out] out_tuple Container for the retrieved record
@@ -110,6 +178,20 @@ class HeapTable {
          */
         bool next_meta(TupleMeta& out_meta);
 
+        /**
+         * @brief Decodes up to `max_rows` visible records into the columns of `out`
+         *
+         * Fields of binary pages are copied straight into the typed column
+         * vectors, without building a Tuple per record; legacy text pages are
+         * decoded record by record. Rows are appended, so `out` must have been
+         * initialized from the table schema (VectorBatch::init_from_schema).
+         * @param visible Filter on (xmin, xmax); null keeps every record
+         * @return true if at least one row was appended, false on EOF
+         * @throws std::runtime_error if the columns of `out` do not match the schema
+         */
+        bool next_batch(executor::VectorBatch& out, size_t max_rows,
+                        const VisibilityFn& visible);
+
         /** @return true if the scan has reached the end of the table */
         [[nodiscard]] bool is_done() const { return eof_; }
 
@@ -122,6 +204,10 @@ class HeapTable {
     std::string filename_;
     BufferPoolManager& bpm_;
     executor::Schema schema_;
+    FreeSpaceMap fsm_;
+    std::vector<uint16_t> column_offsets_; /**< Offset of each column in the fixed area */
+    uint16_t fixed_size_ = 0;              /**< Size of the fixed area in bytes */
+    std::vector<bool> read_columns_;       /**< Columns records are decoded into; empty: all */
 
    public:
     /**
@@ -145,9 +231,22 @@ class HeapTable {
     /** @return Logical table name */
     [[nodiscard]] const std::string& table_name() const { return table_name_; }
 
+    /** @return Name of the heap file */
+    [[nodiscard]] const std::string& filename() const { return filename_; }
+
     /** @return Schema definition */
     [[nodiscard]] const executor::Schema& schema() const { return schema_; }
 
+    /**
+     * @brief Restricts the columns that get(), get_meta() and the Iterator decode
+     *
+     * The other columns of the rows they return are NULL, so a scan feeding a
+     * projection skips converting fields nobody reads. MVCC headers are always
+     * read, and next_batch() still decodes every column.
+     * @param columns One flag per schema column; empty decodes every column
+     */
+    void set_read_columns(std::vector<bool> columns) { read_columns_ = std::move(columns); }
+
     /**
      * @brief Inserts a new record into the heap
      * @param tuple The data to insert
@@ -156,6 +255,18 @@ class HeapTable {
      */
     TupleId insert(const executor::Tuple& tuple, uint64_t xmin = 0);
 
+    /**
+     * @brief Inserts records a page at a time
+     *
+     * Each page is latched once and filled with as many of the records, in
+     * order, as fit before moving on, and its free space is recorded once.
+     * @return Identifiers of the records inserted, in order. Fewer than
+     * `tuples` when a record is too large for a page or the buffer pool is
+     * exhausted; the records from that one on are not inserted.
+     */
+    std::vector<TupleId> insert_batch(const std::vector<executor::Tuple>& tuples,
+                                      uint64_t xmin = 0);
+
     /**
      * @brief Logically deletes a record by setting xmax
      * @param tuple_id The record to delete
@@ -176,6 +287,30 @@ class HeapTable {
      */
     bool undo_remove(const TupleId& tuple_id);
 
+    /**
+     * @brief Places a record at a given slot, for redo during crash recovery
+     *
+     * Does nothing if the slot already holds a record. Slots between the
+     * page's last one and `tuple_id` are created empty, and a page past the
+     * end of the heap is initialised first.
+     * @return true if the record is in place
+     */
+    bool insert_at(const TupleId& tuple_id, const executor::Tuple& tuple, uint64_t xmin);
+
+    /**
+     * @return LSN of the latest logged change applied to a page, NO_PAGE_LSN if
+     * it carries none
+     */
+    [[nodiscard]] int32_t page_lsn(uint32_t page_num) const;
+
+    /**
+     * @brief Records that the change logged at `lsn` has been applied to a page
+     *
+     * The page LSN only moves forward, so changes may be stamped out of order.
+     * @return false if the page has no room for a page LSN
+     */
+    bool set_page_lsn(uint32_t page_num, int32_t lsn);
+
     /**
      * @brief Replaces an existing record with new data
      * @param tuple_id The record to update
@@ -197,12 +332,46 @@ class HeapTable {
      */
     bool get_meta(const TupleId& tuple_id, TupleMeta& out_meta) const;
 
+    /**
+     * @brief Reads only the MVCC header of a record, without decoding its values
+     * @return true if the record exists
+     */
+    bool get_versions(const TupleId& tuple_id, uint64_t* xmin, uint64_t* xmax) const;
+
+    /** Receives each dead record vacuum_page() is about to remove, e.g. to drop its index entries */
+    using DeadTupleFn = std::function<void(const TupleId& tuple_id, const executor::Tuple& tuple)>;
+
+    /** Decides from a deleted record's xmax whether no snapshot can see it any more */
+    using DeadFn = std::function<bool(uint64_t xmax)>;
+
+    /**
+     * @brief Removes the dead record versions of one page and compacts it
+     *
+     * Records with a non-zero xmax that `is_dead` accepts are removed. `on_dead`
+     * runs for every such record under the page's write latch, before its slot is
+     * freed, so no insert can reuse the slot while an index still points at it; it
+     * must not touch this heap's pages. Trailing empty slots are dropped and the
+     * page's free space is recorded. Legacy text pages are left as they are.
+     * @param[out] removed Number of records removed
+     * @return false past the end of the heap
+     */
+    bool vacuum_page(uint32_t page_num, const DeadFn& is_dead, const DeadTupleFn& on_dead,
+                     size_t* removed);
+
     /** @return Total count of non-deleted records in the table */
     [[nodiscard]] uint64_t tuple_count() const;
 
+    /** @return Pages of the heap, counting those still only in the buffer pool */
+    [[nodiscard]] uint32_t page_count();
+
     /** @return An iterator starting at the first page */
     [[nodiscard]] Iterator scan() { return Iterator(*this); }
 
+    /** @return An iterator over the records of `ranges`, e.g. those a BRIN index selects */
+    [[nodiscard]] Iterator scan_ranges(std::vector<PageRange> ranges) {
+        return Iterator(*this, std::move(ranges));
+    }
+
     /** @brief Initializes the physical heap file */
     bool create();
 
@@ -210,8 +379,27 @@ class HeapTable {
     bool drop();
 
    private:
-    bool read_page(uint32_t page_num, char* buffer) const;
-    bool write_page(uint32_t page_num, const char* buffer);
+    void compute_layout();
+    [[nodiscard]] std::vector<char> serialize(const executor::Tuple& tuple, uint64_t xmin) const;
+    void deserialize(const char* record, TupleMeta& out_meta) const;
+    bool legacy_deserialize(const char* record, TupleMeta& out_meta) const;
+    bool legacy_remove(char* buffer, const PageHeader& header, const TupleId& tuple_id,
+                       uint16_t offset, uint64_t xmax) const;
+
+    bool get_meta(const TupleId& tuple_id, TupleMeta& out_meta, AccessType access) const;
+
+    /**
+     * @brief Decode the visible records of page slots [*slot, num_slots) into
+     * `out`, stopping after `max_rows` rows; advances *slot past the last slot read
+     * @return Number of rows appended
+     */
+    size_t read_page_batch(const char* page_data, const PageHeader& header, uint16_t* slot,
+                           size_t max_rows, const Iterator::VisibilityFn& visible,
+                           executor::VectorBatch& out) const;
+
+    /** @brief Decode one slot of a latched page in place */
+    bool read_record(const char* page_data, const PageHeader& header, uint16_t slot,
+                     TupleMeta& out_meta) const;
 };
 
 }  // namespace cloudsql::storage
@@ -0,0 +1,88 @@
+/**
+ * @file index.hpp
+ * @brief Interface of the secondary index access methods
+ */
+
+#ifndef CLOUDSQL_STORAGE_INDEX_HPP
+#define CLOUDSQL_STORAGE_INDEX_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/value.hpp"
+#include "storage/heap_table.hpp"
+
+namespace cloudsql::storage {
+
+/**
+ * @brief A single-column index mapping keys to the tuple ids of rows holding them
+ *
+ * A key may have any number of entries, and an (key, tuple id) entry is held at
+ * most once. Every index but a summarizing one answers point lookups;
+ * BTreeIndex also scans in key order, which ordered() reports.
+ */
+class Index {
+   public:
+    /**
+     * @brief Index entry (Key + TupleId)
+     */
+    struct Entry {
+        common::Value key;
+        HeapTable::TupleId tuple_id;
+
+        Entry() = default;
+        Entry(common::Value k, HeapTable::TupleId tid) : key(std::move(k)), tuple_id(tid) {}
+    };
+
+    Index() = default;
+    virtual ~Index() = default;
+
+    Index(const Index&) = delete;
+    Index& operator=(const Index&) = delete;
+    Index& operator=(Index&&) noexcept = delete;
+
+    [[nodiscard]] virtual const std::string& index_name() const = 0;
+    [[nodiscard]] virtual const std::string& filename() const = 0;
+    [[nodiscard]] virtual common::ValueType key_type() const = 0;
+
+    /** @return true if the index can be scanned in key order */
+    [[nodiscard]] virtual bool ordered() const = 0;
+
+    /**
+     * @return true if the index keeps only summaries of heap page ranges
+     * (BrinIndex); search() then finds nothing and readers scan the heap pages
+     * the summaries select instead
+     */
+    [[nodiscard]] virtual bool summarizing() const { return false; }
+
+    virtual bool create() = 0;
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    virtual bool drop() = 0;
+
+    /**
+     * @brief Insert an entry; inserting an entry that is already present is a no-op
+     * @return false if the key is too large or the index cannot be updated
+     */
+    virtual bool insert(const common::Value& key, HeapTable::TupleId tuple_id) = 0;
+
+    /** @brief Remove an exact (key, tuple id) entry; removing an absent entry is a no-op */
+    virtual bool remove(const common::Value& key, HeapTable::TupleId tuple_id) = 0;
+
+    /**
+     * @brief Add a batch of entries, faster than inserting them one by one
+     * @return false if any entry could not be added
+     */
+    virtual bool bulk_load(std::vector<Entry> entries) = 0;
+
+    /** @return Tuple ids of every entry whose key equals `key` */
+    [[nodiscard]] virtual std::vector<HeapTable::TupleId> search(const common::Value& key) = 0;
+
+   protected:
+    Index(Index&&) noexcept = default;
+};
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_INDEX_HPP
@@ -0,0 +1,34 @@
+/**
+ * @file io_counters.hpp
+ * @brief Per-thread buffer and page read counters
+ */
+
+#ifndef CLOUDSQL_STORAGE_IO_COUNTERS_HPP
+#define CLOUDSQL_STORAGE_IO_COUNTERS_HPP
+
+#include <cstdint>
+
+namespace cloudsql::storage {
+
+/**
+ * @brief Buffer pool and disk activity of one thread
+ *
+ * The counters only ever grow; whoever wants the I/O of a piece of work takes
+ * the difference across it, as EXPLAIN ANALYZE does around each operator call.
+ * They are plain thread-locals, so counting costs an increment and no atomic.
+ */
+struct IoCounters {
+    uint64_t buffer_hits = 0;
+    uint64_t buffer_misses = 0;
+    uint64_t pages_read = 0;
+};
+
+/** @return The counters of the calling thread */
+inline IoCounters& thread_io_counters() {
+    thread_local IoCounters counters;
+    return counters;
+}
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_IO_COUNTERS_HPP
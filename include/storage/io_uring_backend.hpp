@@ -0,0 +1,73 @@
+/**
+ * @file io_uring_backend.hpp
+ * @brief Linux io_uring I/O backend built on the raw kernel interface
+ */
+
+#ifndef CLOUDSQL_STORAGE_IO_URING_BACKEND_HPP
+#define CLOUDSQL_STORAGE_IO_URING_BACKEND_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "storage/io_backend.hpp"
+
+namespace cloudsql::storage {
+
+/**
+ * @brief Batches requests through one shared submission/completion ring
+ *
+ * Single reads and writes go straight to pread/pwrite, where a ring round trip
+ * buys nothing. submit() places up to ring-size requests in the SQ, enters the
+ * kernel once, and reaps all completions, so the device sees the whole batch
+ * at once. Opcodes the kernel rejects are retried synchronously.
+ */
+class IoUringBackend : public IoBackend {
+   public:
+    static constexpr uint32_t DEFAULT_QUEUE_DEPTH = 64;
+
+    explicit IoUringBackend(uint32_t queue_depth = DEFAULT_QUEUE_DEPTH);
+    ~IoUringBackend() override;
+
+    // Disable copy/move
+    IoUringBackend(const IoUringBackend&) = delete;
+    IoUringBackend& operator=(const IoUringBackend&) = delete;
+    IoUringBackend(IoUringBackend&&) = delete;
+    IoUringBackend& operator=(IoUringBackend&&) = delete;
+
+    /** @return true if the ring was set up (false when the kernel refuses io_uring) */
+    [[nodiscard]] bool is_valid() const { return ring_fd_ >= 0; }
+
+    void submit(std::vector<IoRequest>& batch) override;
+
+    [[nodiscard]] const char* name() const override { return "io_uring"; }
+
+   private:
+    /** @brief Submit and reap batch[begin, begin + count); returns false on ring failure */
+    bool submit_chunk(std::vector<IoRequest>& batch, size_t begin, size_t count);
+
+    int ring_fd_ = -1;
+
+    void* sq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    void* cq_ring_ = nullptr;
+    size_t cq_ring_size_ = 0;
+    void* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    uint32_t sq_entries_ = 0;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_mask_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned* cq_mask_ = nullptr;
+    void* cqes_ = nullptr;
+
+    std::mutex ring_latch_;
+};
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_IO_URING_BACKEND_HPP
@@ -0,0 +1,93 @@
+/**
+ * @file lru_k_replacer.hpp
+ * @brief LRU-K replacement policy for the buffer pool
+ */
+
+#ifndef CLOUDSQL_STORAGE_LRU_K_REPLACER_HPP
+#define CLOUDSQL_STORAGE_LRU_K_REPLACER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include "storage/replacer.hpp"
+
+namespace cloudsql::storage {
+
+/**
+ * @class LRUKReplacer
+ * @brief Evicts the frame whose K-th most recent access is furthest in the past
+ *
+ * Frames with fewer than K recorded accesses have infinite backward distance and are
+ * evicted first (oldest first access wins), so pages touched once by a scan cannot
+ * displace pages that are read repeatedly such as B-tree inner nodes. Evictable
+ * frames are kept ordered by that distance, so victim() costs O(log n) rather than
+ * a pass over the pool.
+ */
+class LRUKReplacer : public Replacer {
+   public:
+    static constexpr size_t DEFAULT_K = 2;
+
+    /**
+     * @param num_frames Number of frames tracked
+     * @param first_frame Frame id of the first tracked frame
+     * @param k Number of accesses remembered per frame
+     */
+    explicit LRUKReplacer(size_t num_frames, uint32_t first_frame = 0, size_t k = DEFAULT_K);
+
+    ~LRUKReplacer() override = default;
+
+    // Disable copy/move
+    LRUKReplacer(const LRUKReplacer&) = delete;
+    LRUKReplacer& operator=(const LRUKReplacer&) = delete;
+    LRUKReplacer(LRUKReplacer&&) = delete;
+    LRUKReplacer& operator=(LRUKReplacer&&) = delete;
+
+    bool victim(uint32_t* frame_id) override;
+    void pin(uint32_t frame_id) override;
+    void unpin(uint32_t frame_id) override;
+    void unpin_cold(uint32_t frame_id) override;
+    void remove(uint32_t frame_id) override;
+    void peek_victims(size_t max_frames, std::vector<uint32_t>* frames) const override;
+    [[nodiscard]] size_t size() const override;
+
+   private:
+    static constexpr int CLASS_COLD = 0;
+    static constexpr int CLASS_INFINITE = 1;
+    static constexpr int CLASS_FINITE = 2;
+
+    /** Eviction order of an evictable frame: (class, timestamp, index); lower goes first */
+    using Rank = std::tuple<int, uint64_t, size_t>;
+
+    /** @brief Eviction order key of frame `idx` from its current history (caller holds latch_) */
+    [[nodiscard]] Rank rank(size_t idx) const;
+
+    /** @brief Make frame `idx` evictable, ranked as it is now (caller holds latch_) */
+    void add_evictable(size_t idx);
+
+    /** @brief Take frame `idx` out of the eviction order, if it is in it (caller holds latch_) */
+    void remove_evictable(size_t idx);
+
+    [[nodiscard]] bool owns(uint32_t frame_id) const {
+        return frame_id >= first_frame_ && frame_id - first_frame_ < num_frames_;
+    }
+
+    size_t num_frames_;
+    uint32_t first_frame_;
+    size_t k_;
+    mutable std::mutex latch_;
+    uint64_t current_ts_ = 0;
+    std::vector<std::deque<uint64_t>> history_; /* Last k access timestamps, oldest first */
+    std::vector<bool> present_;
+    std::vector<bool> cold_;
+    std::vector<Rank> ranks_; /* Key each present frame is filed under in evictable_ */
+    std::set<Rank> evictable_; /* Present frames, next victim first */
+};
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_LRU_K_REPLACER_HPP
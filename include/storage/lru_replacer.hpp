@@ -11,6 +11,8 @@
 #include <unordered_map>
 #include <vector>
 
+#include "storage/replacer.hpp"
+
 namespace cloudsql::storage {
 
 /**
@@ -20,7 +22,7 @@ namespace cloudsql::storage {
  * Implements a thread-safe LRU policy. Pages that are pinned are
  * removed from the replacer. When unpinned, they are added back.
  */
-class LRUReplacer {
+class LRUReplacer : public Replacer {
    public:
     /**
      * @brief Create a new LRUReplacer
@@ -28,7 +30,7 @@ class LRUReplacer {
      */
     explicit LRUReplacer(size_t num_pages);
 
-    ~LRUReplacer() = default;
+    ~LRUReplacer() override = default;
 
     // Disable copy/move
     LRUReplacer(const LRUReplacer&) = delete;
@@ -41,25 +43,36 @@ class LRUReplacer {
      * @param[out] frame_id The ID of the evicted frame
      * @return true if a frame was evicted, false if no frames are available
      */
-    bool victim(uint32_t* frame_id);
+    bool victim(uint32_t* frame_id) override;
 
     /**
      * @brief Pin a frame, removing it from the replacer
      * @param frame_id The ID of the frame to pin
      */
-    void pin(uint32_t frame_id);
+    void pin(uint32_t frame_id) override;
 
     /**
      * @brief Unpin a frame, adding it to the replacer
      * @param frame_id The ID of the frame to unpin (becomes a candidate for eviction)
      */
-    void unpin(uint32_t frame_id);
+    void unpin(uint32_t frame_id) override;
+
+    /**
+     * @brief Unpin a frame at the LRU end so it is the next victim
+     * @param frame_id The ID of the frame to unpin
+     */
+    void unpin_cold(uint32_t frame_id) override;
+
+    /**
+     * @brief Frames from the LRU end, least recently used first
+     */
+    void peek_victims(size_t max_frames, std::vector<uint32_t>* frames) const override;
 
     /**
      * @brief Get the number of frames currently in the replacer
      * @return Size of the replacer
      */
-    [[nodiscard]] size_t size() const;
+    [[nodiscard]] size_t size() const override;
 
    private:
     size_t capacity_;
@@ -0,0 +1,53 @@
+/**
+ * @file mapped_file.hpp
+ * @brief Read-only memory mapping of a whole file
+ */
+
+#ifndef CLOUDSQL_STORAGE_MAPPED_FILE_HPP
+#define CLOUDSQL_STORAGE_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace cloudsql::storage {
+
+/**
+ * @class MappedFile
+ * @brief Maps a file read-only for its lifetime
+ *
+ * Shared ownership lets readers hand out pointers into the mapping (e.g. as
+ * zero-copy column vectors) that stay valid after the owner remaps or closes.
+ * The mapping reflects the file size at map time; appends need a new mapping.
+ */
+class MappedFile {
+   public:
+    /**
+     * @brief Map `path`; an empty file yields an empty mapping
+     * @param sequential Hint the kernel for sequential access (aggressive read-ahead)
+     * @return nullptr if the file cannot be opened or mapped
+     */
+    [[nodiscard]] static std::shared_ptr<const MappedFile> map(const std::string& path,
+                                                               bool sequential);
+
+    ~MappedFile();
+
+    // Disable copy/move
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    [[nodiscard]] const char* data() const { return static_cast<const char*>(addr_); }
+    [[nodiscard]] size_t size() const { return size_; }
+
+   private:
+    MappedFile(void* addr, size_t size) : addr_(addr), size_(size) {}
+
+    void* addr_;
+    size_t size_;
+};
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_MAPPED_FILE_HPP
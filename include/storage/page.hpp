@@ -6,7 +6,8 @@
 #ifndef CLOUDSQL_STORAGE_PAGE_HPP
 #define CLOUDSQL_STORAGE_PAGE_HPP
 
-#include <array>
+#include <atomic>
+#include <cstdint>
 #include <cstring>
 #include <shared_mutex>
 #include <string>
@@ -16,12 +17,26 @@ namespace cloudsql::storage {
 /**
  * @class Page
  * @brief Represents a single page in memory managed by the Buffer Pool
+ *
+ * A Page is the frame's metadata; the data it points at lives in the pool's
+ * contiguous frame region (see FrameMemory), so the metadata array stays small
+ * and the data stays dense. Pages are the database's page size, fixed when
+ * it was created (see StorageManager::page_size()).
  */
 class Page {
    public:
-    static constexpr uint32_t PAGE_SIZE = 4096;
+    /** Size of databases created without choosing one, and of those that predate the choice */
+    static constexpr uint32_t DEFAULT_PAGE_SIZE = 4096;
+    static constexpr uint32_t MIN_PAGE_SIZE = 4096;
+    /** Heap and B-tree pages address their bytes with 16-bit offsets */
+    static constexpr uint32_t MAX_PAGE_SIZE = 32768;
 
-    Page() { reset_memory(); }
+    /** @return Whether `size` is a power of two in [MIN_PAGE_SIZE, MAX_PAGE_SIZE] */
+    [[nodiscard]] static constexpr bool valid_page_size(uint32_t size) {
+        return size >= MIN_PAGE_SIZE && size <= MAX_PAGE_SIZE && (size & (size - 1)) == 0;
+    }
+
+    Page() = default;
 
     Page(const Page&) = delete;
     Page& operator=(const Page&) = delete;
@@ -30,7 +45,7 @@ class Page {
     virtual ~Page() = default;
 
     // Output raw pointer
-    [[nodiscard]] char* get_data() { return data_.data(); }
+    [[nodiscard]] char* get_data() { return data_; }
 
     [[nodiscard]] uint32_t get_page_id() const { return page_id_; }
 
@@ -46,25 +61,41 @@ class Page {
     void w_lock() { rwlatch_.lock(); }
     void w_unlock() { rwlatch_.unlock(); }
 
-    // Get Page LSN (for recovery/WAL)
-    // Assuming page layout reserves first 8 bytes (or 4 bytes) for PageLSN depending on
-    // implementation We will store LSN explicitly here to avoid parsing the header if not strictly
-    // needed, but typically it's written in the first 4 bytes of data_.
-    [[nodiscard]] int32_t get_lsn() const { return lsn_; }
-    void set_lsn(int32_t lsn) { lsn_ = lsn; }
+    /**
+     * @brief LSN of the latest logged change made to the page since it was read in
+     *
+     * The buffer pool makes the log durable up to it before writing the page.
+     * Page formats that need it on disk (heap pages) also keep it in their data.
+     */
+    [[nodiscard]] int32_t get_lsn() const { return lsn_.load(std::memory_order_acquire); }
+
+    /** @brief Record a logged change; the first since the page was last written sets rec_lsn */
+    void set_lsn(int32_t lsn) {
+        int32_t cur = lsn_.load(std::memory_order_relaxed);
+        while (cur < lsn && !lsn_.compare_exchange_weak(cur, lsn, std::memory_order_acq_rel)) {
+        }
+        int32_t none = -1;
+        static_cast<void>(rec_lsn_.compare_exchange_strong(none, lsn, std::memory_order_acq_rel));
+    }
+
+    /** @brief Earliest logged change the page may lack on disk; -1 when clean */
+    [[nodiscard]] int32_t get_rec_lsn() const { return rec_lsn_.load(std::memory_order_acquire); }
 
    private:
     friend class BufferPoolManager;
 
-    void reset_memory() { data_.fill(0); }
-
-    std::array<char, PAGE_SIZE> data_{};  // Fixed size page array
+    char* data_ = nullptr;                // One page of the pool's frame region
     uint32_t page_id_ = 0;                // The logical page id within the file
     std::string file_name_;               // File this page belongs to
+    uint32_t file_id_ = 0;                // Interned id of file_name_ (0 = unused frame)
 
     int pin_count_ = 0;      // Number of concurrent accesses
     bool is_dirty_ = false;  // Whether page has been modified
-    int32_t lsn_ = -1;       // Page LSN, last modified operation
+    bool scan_only_ = false; // Loaded by a sequential scan and not touched since
+    bool prefetched_ = false; // Loaded by read-ahead and not yet fetched
+    std::atomic<bool> io_pending_{false}; // Read-ahead I/O in flight; data not yet valid
+    std::atomic<int32_t> lsn_{-1};     // Page LSN, last modified operation
+    std::atomic<int32_t> rec_lsn_{-1}; // First change since the page was last written
 
     std::shared_mutex rwlatch_;
 };
@@ -0,0 +1,88 @@
+/**
+ * @file page_guard.hpp
+ * @brief RAII guards that pin and latch a buffer pool frame
+ */
+
+#ifndef CLOUDSQL_STORAGE_PAGE_GUARD_HPP
+#define CLOUDSQL_STORAGE_PAGE_GUARD_HPP
+
+#include <cstdint>
+
+#include "storage/page.hpp"
+
+namespace cloudsql::storage {
+
+class BufferPoolManager;
+
+/**
+ * @class ReadPageGuard
+ * @brief Holds a pin and the shared latch of a page; both are released on destruction
+ *
+ * Callers read the frame in place instead of copying it out of the pool.
+ */
+class ReadPageGuard {
+   public:
+    ReadPageGuard() = default;
+    ReadPageGuard(BufferPoolManager* bpm, Page* page);
+    ~ReadPageGuard() { release(); }
+
+    // Disable copy, allow move
+    ReadPageGuard(const ReadPageGuard&) = delete;
+    ReadPageGuard& operator=(const ReadPageGuard&) = delete;
+    ReadPageGuard(ReadPageGuard&& other) noexcept;
+    ReadPageGuard& operator=(ReadPageGuard&& other) noexcept;
+
+    /** @return true if the guard holds a page */
+    [[nodiscard]] bool valid() const { return page_ != nullptr; }
+
+    /** @return Read-only view of the frame's data */
+    [[nodiscard]] const char* data() const { return page_->get_data(); }
+
+    [[nodiscard]] uint32_t page_id() const { return page_->get_page_id(); }
+
+    /** @brief Unlatch and unpin early */
+    void release();
+
+   private:
+    BufferPoolManager* bpm_ = nullptr;
+    Page* page_ = nullptr;
+};
+
+/**
+ * @class WritePageGuard
+ * @brief Holds a pin and the exclusive latch of a page; unpins it dirty on destruction
+ */
+class WritePageGuard {
+   public:
+    WritePageGuard() = default;
+    WritePageGuard(BufferPoolManager* bpm, Page* page);
+    ~WritePageGuard() { release(); }
+
+    // Disable copy, allow move
+    WritePageGuard(const WritePageGuard&) = delete;
+    WritePageGuard& operator=(const WritePageGuard&) = delete;
+    WritePageGuard(WritePageGuard&& other) noexcept;
+    WritePageGuard& operator=(WritePageGuard&& other) noexcept;
+
+    /** @return true if the guard holds a page */
+    [[nodiscard]] bool valid() const { return page_ != nullptr; }
+
+    /** @return Mutable view of the frame's data */
+    [[nodiscard]] char* data() { return page_->get_data(); }
+    [[nodiscard]] const char* data() const { return page_->get_data(); }
+
+    [[nodiscard]] uint32_t page_id() const { return page_->get_page_id(); }
+
+    [[nodiscard]] Page* page() { return page_; }
+
+    /** @brief Unlatch and unpin (dirty) early */
+    void release();
+
+   private:
+    BufferPoolManager* bpm_ = nullptr;
+    Page* page_ = nullptr;
+};
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_PAGE_GUARD_HPP
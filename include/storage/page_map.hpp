@@ -0,0 +1,117 @@
+/**
+ * @file page_map.hpp
+ * @brief Page map for files stored as compressed, variable-size extents
+ */
+
+#ifndef CLOUDSQL_STORAGE_PAGE_MAP_HPP
+#define CLOUDSQL_STORAGE_PAGE_MAP_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cloudsql::storage {
+
+/**
+ * @brief How a file's pages are stored on disk
+ */
+enum class PageCompression : uint8_t {
+    None = 0, /**< Page n at offset n * page size */
+    Lz4 = 1   /**< Each page an LZ4 block in its own extent, located by a PageMap */
+};
+
+/**
+ * @brief Parse a compression name ("none", "lz4")
+ * @return false if the name is not recognised
+ */
+bool parse_page_compression(const std::string& name, PageCompression* out);
+
+/** @return Canonical name for a compression method */
+const char* page_compression_name(PageCompression compression);
+
+/**
+ * @brief Where one page's stored bytes live in the data file
+ */
+struct PageExtent {
+    uint64_t offset = 0;
+    uint32_t length = 0;   /**< Stored bytes; 0 if the page was never written */
+    uint32_t capacity = 0; /**< Bytes reserved, a multiple of EXTENT_ALIGNMENT */
+};
+
+/**
+ * @class PageMap
+ * @brief Persistent page-number-to-extent map of a compressed data file
+ *
+ * Lives next to the data file as `<file>.pmap`: a header naming the
+ * compression method, then one PageExtent per page. A rewritten page stays in
+ * its extent while it fits; one that outgrows it moves to the first free gap
+ * or the end of the file, and its old extent is reused once the map no longer
+ * points at it. Gaps are found again from the map when it is opened, so space
+ * reserved by a write that never committed is not lost for good.
+ */
+class PageMap {
+   public:
+    static constexpr const char* FILE_SUFFIX = ".pmap";
+    /** Extents start on sector boundaries so a rewrite touches whole sectors */
+    static constexpr uint32_t EXTENT_ALIGNMENT = 512;
+
+    ~PageMap();
+
+    PageMap(const PageMap&) = delete;
+    PageMap& operator=(const PageMap&) = delete;
+    PageMap(PageMap&&) = delete;
+    PageMap& operator=(PageMap&&) = delete;
+
+    /** @brief Write an empty map for a new file */
+    static bool create(const std::string& path, PageCompression compression);
+
+    /** @return The map at `path`, or nullptr if there is none or it is unreadable */
+    static std::unique_ptr<PageMap> open(const std::string& path);
+
+    [[nodiscard]] PageCompression compression() const { return compression_; }
+
+    /** @return The page's extent; length 0 if it has not been written */
+    [[nodiscard]] PageExtent lookup(uint32_t page_num) const;
+
+    /**
+     * @brief Reserve room for `length` stored bytes of a page
+     *
+     * The page keeps its current extent if it fits. Otherwise the new extent
+     * is held back from other writers until commit() or the map is reopened.
+     */
+    [[nodiscard]] PageExtent place(uint32_t page_num, uint32_t length);
+
+    /** @brief Point the page at `extent`, written by now, and persist the entry */
+    bool commit(uint32_t page_num, const PageExtent& extent);
+
+    /** @return One past the highest page written */
+    [[nodiscard]] uint32_t page_count() const;
+
+    /** @return Bytes the written pages occupy in the data file */
+    [[nodiscard]] uint64_t stored_bytes() const;
+
+    /** @brief Forget every page; the caller truncates the data file */
+    bool clear();
+
+   private:
+    PageMap(int fd, PageCompression compression) : fd_(fd), compression_(compression) {}
+
+    /** @brief First free gap of at least `capacity` bytes, else the end of the file */
+    uint64_t allocate(uint32_t capacity);
+    void release(uint64_t offset, uint32_t capacity);
+
+    int fd_;
+    PageCompression compression_;
+
+    mutable std::mutex latch_; /**< Guards everything below */
+    std::vector<PageExtent> extents_;
+    std::vector<std::pair<uint64_t, uint64_t>> free_; /**< (offset, bytes), by offset */
+    uint64_t end_ = 0;                                /**< End of the last extent */
+};
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_PAGE_MAP_HPP
@@ -0,0 +1,104 @@
+/**
+ * @file replacer.hpp
+ * @brief Page replacement policy interface for the buffer pool
+ */
+
+#ifndef CLOUDSQL_STORAGE_REPLACER_HPP
+#define CLOUDSQL_STORAGE_REPLACER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cloudsql::storage {
+
+/**
+ * @brief Available frame replacement policies
+ */
+enum class ReplacerPolicy : uint8_t {
+    Lru,   /**< Exact least-recently-used list */
+    Clock, /**< CLOCK second-chance sweep */
+    LruK   /**< LRU-K (K = 2) backward k-distance */
+};
+
+/**
+ * @class Replacer
+ * @brief Tracks unpinned frames and picks eviction victims
+ *
+ * Pinned frames are never candidates. Frames unpinned via unpin_cold() were only
+ * touched by a sequential scan and are evicted before any other frame, so a large
+ * scan recycles a small ring of its own frames instead of flushing the hot set.
+ */
+class Replacer {
+   public:
+    Replacer() = default;
+    virtual ~Replacer() = default;
+
+    // Disable copy/move
+    Replacer(const Replacer&) = delete;
+    Replacer& operator=(const Replacer&) = delete;
+    Replacer(Replacer&&) = delete;
+    Replacer& operator=(Replacer&&) = delete;
+
+    /**
+     * @brief Choose a frame to evict and remove it from the replacer
+     * @param[out] frame_id The ID of the evicted frame
+     * @return true if a frame was evicted, false if no frames are available
+     */
+    virtual bool victim(uint32_t* frame_id) = 0;
+
+    /**
+     * @brief Pin (access) a frame, removing it from the candidate set
+     */
+    virtual void pin(uint32_t frame_id) = 0;
+
+    /**
+     * @brief Unpin a frame, making it a candidate for eviction
+     */
+    virtual void unpin(uint32_t frame_id) = 0;
+
+    /**
+     * @brief Unpin a frame that should be evicted ahead of regular frames
+     */
+    virtual void unpin_cold(uint32_t frame_id) { unpin(frame_id); }
+
+    /**
+     * @brief Forget a frame entirely (page deleted, frame returned to the free list)
+     */
+    virtual void remove(uint32_t frame_id) { pin(frame_id); }
+
+    /**
+     * @brief Frames the next victim() calls would pick, in eviction order, without evicting
+     * @param max_frames Stop after this many frames
+     * @param[out] frames Appended with the candidates
+     */
+    virtual void peek_victims(size_t max_frames, std::vector<uint32_t>* frames) const = 0;
+
+    /**
+     * @brief Get the number of frames currently in the replacer
+     */
+    [[nodiscard]] virtual size_t size() const = 0;
+};
+
+/**
+ * @brief Create a replacer for the frame range [first_frame, first_frame + num_frames)
+ */
+[[nodiscard]] std::unique_ptr<Replacer> make_replacer(ReplacerPolicy policy, size_t num_frames,
+                                                      uint32_t first_frame = 0);
+
+/**
+ * @brief Parse a policy name ("lru", "clock", "lru-k")
+ * @return true if the name was recognised
+ */
+bool parse_replacer_policy(const std::string& name, ReplacerPolicy* policy);
+
+/**
+ * @brief Canonical name of a policy
+ */
+[[nodiscard]] const char* replacer_policy_name(ReplacerPolicy policy);
+
+}  // namespace cloudsql::storage
+
+#endif  // CLOUDSQL_STORAGE_REPLACER_HPP
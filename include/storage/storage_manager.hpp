@@ -7,21 +7,39 @@
 #define CLOUDSQL_STORAGE_STORAGE_MANAGER_HPP
 
 #include <atomic>
-#include <fstream>
+#include <cstdint>
 #include <memory>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "common/latency_histogram.hpp"
+#include "common/metrics.hpp"
+#include "storage/io_backend.hpp"
+#include "storage/page.hpp"
+#include "storage/page_map.hpp"
+
 namespace cloudsql::storage {
 
 /**
  * @brief Manages low-level disk I/O and page-level access
+ *
+ * Files are held as raw descriptors and accessed with positioned I/O through
+ * the configured IoBackend, so concurrent page reads and writes proceed under a
+ * shared latch without serialising on a seek cursor.
+ *
+ * A file can instead be stored compressed (set_compression()): each page is
+ * compressed on write into an extent of its own size, found through the
+ * file's PageMap, and decompressed on read, so callers still see whole pages.
+ * Compressed files always use buffered I/O, as their extents are not aligned.
  */
 class StorageManager {
    public:
-    static constexpr uint32_t PAGE_SIZE = 4096;
     static constexpr int DEFAULT_DIR_MODE = 0755;
+    static constexpr uint32_t INVALID_FILE_ID = 0;
+    /** Header in the data directory recording the database's page size */
+    static constexpr const char* CONTROL_FILE = "storage.control";
 
     struct Stats {
         std::atomic<uint64_t> pages_read{0};
@@ -29,9 +47,33 @@ class StorageManager {
         std::atomic<uint64_t> bytes_read{0};
         std::atomic<uint64_t> bytes_written{0};
         std::atomic<uint32_t> files_opened{0};
+        std::atomic<uint64_t> batches_submitted{0};
+        std::atomic<uint64_t> compression_saved_bytes{0}; /**< Page bytes not written */
+        common::LatencyHistogram read_latency;  /**< Per-page read latency (us) */
+        common::LatencyHistogram write_latency; /**< Per-page write latency (us) */
+    };
+
+    /**
+     * @brief One page transfer in a batch submitted through submit_batch()
+     */
+    struct PageIo {
+        IoRequest::Op op = IoRequest::Op::Read;
+        std::string filename;
+        uint32_t page_num = 0;
+        char* buffer = nullptr; /**< At least page_size() bytes */
+        bool ok = false;        /**< Set by submit_batch() */
     };
 
-    explicit StorageManager(std::string data_dir);
+    /**
+     * @brief Constructor
+     * @param data_dir Directory holding the database files
+     * @param backend I/O backend; io_uring falls back to POSIX if unavailable
+     * @param direct_io Open files with O_DIRECT where the filesystem supports it
+     * @param page_size Page size for a new database (0 = Page::DEFAULT_PAGE_SIZE); an
+     *        existing one keeps the size recorded in its CONTROL_FILE
+     */
+    explicit StorageManager(std::string data_dir, IoBackendType backend = IoBackendType::Posix,
+                            bool direct_io = false, uint32_t page_size = 0);
     ~StorageManager();
 
     // Disable copy/move for storage manager (due to atomic stats)
@@ -50,6 +92,13 @@ class StorageManager {
      */
     bool open_file(const std::string& filename);
 
+    /**
+     * @brief Intern a file name into a compact, process-stable identifier
+     * @param filename Name of the database file
+     * @return Non-zero id; repeated calls with the same name return the same id
+     */
+    [[nodiscard]] uint32_t get_file_id(const std::string& filename);
+
     /**
      * @brief Close a database file
      */
@@ -59,7 +108,7 @@ class StorageManager {
      * @brief Read a page from disk into buffer
      * @param filename Name of the database file
      * @param page_num Page index
-     * @param buffer Pre-allocated buffer of at least PAGE_SIZE
+     * @param buffer Pre-allocated buffer of at least page_size()
      * @return true on success
      */
     bool read_page(const std::string& filename, uint32_t page_num, char* buffer);
@@ -73,6 +122,35 @@ class StorageManager {
      */
     bool write_page(const std::string& filename, uint32_t page_num, const char* buffer);
 
+    /**
+     * @brief Issue a batch of page reads and writes in one backend submission
+     *
+     * Reads past end of file are zero-filled, as with read_page().
+     * @return Number of requests that completed successfully
+     */
+    size_t submit_batch(std::vector<PageIo>& batch);
+
+    /**
+     * @brief Choose how a file's pages are stored, before any are written
+     *
+     * The choice is recorded beside the file and holds when the database is
+     * reopened.
+     * @return false if the file already holds pages stored another way, or the
+     *         page map cannot be written
+     */
+    bool set_compression(const std::string& filename, PageCompression compression);
+
+    /** @return How the file's pages are stored */
+    [[nodiscard]] PageCompression compression(const std::string& filename);
+
+    /**
+     * @brief Remove every page of a file
+     */
+    bool truncate_file(const std::string& filename);
+
+    /** @return Name of the active I/O backend */
+    [[nodiscard]] const char* io_backend_name() const { return backend_->name(); }
+
     /**
      * @brief Allocate a new page in the database file
      * @param filename Name of the database file
@@ -80,6 +158,11 @@ class StorageManager {
      */
     uint32_t allocate_page(const std::string& filename);
 
+    /**
+     * @brief Number of whole pages currently on disk for a file
+     */
+    [[nodiscard]] uint32_t page_count(const std::string& filename);
+
     /**
      * @brief Deallocate a page (stub for future use)
      */
@@ -92,6 +175,12 @@ class StorageManager {
      */
     [[nodiscard]] std::string get_full_path(const std::string& filename) const;
 
+    /** @return Bytes per page of every file in this database */
+    [[nodiscard]] uint32_t page_size() const { return page_size_; }
+
+    /** @return Directory holding the database files */
+    [[nodiscard]] const std::string& data_dir() const { return data_dir_; }
+
     /**
      * @brief Check if a file exists
      */
@@ -103,9 +192,42 @@ class StorageManager {
     bool create_dir_if_not_exists();
 
    private:
+    struct OpenFile {
+        int fd = -1;
+        bool direct = false; /**< Opened with O_DIRECT; buffers must be page-aligned */
+        std::shared_ptr<PageMap> map; /**< Set when the file is stored compressed */
+    };
+
+    bool open_file_unlocked(const std::string& filename);
+    void load_control(uint32_t requested);
+    /**
+     * @brief Resolve (opening on first use) a file's descriptor
+     * @return Shared lock on files_latch_ that keeps the descriptor alive; it does
+     *         not own the latch if the file could not be opened
+     */
+    std::shared_lock<std::shared_mutex> acquire_file(const std::string& filename, OpenFile* out);
+    /** @brief Page transfers for compressed files; the caller keeps the descriptor alive */
+    bool read_extent(const OpenFile& file, uint32_t page_num, char* buffer);
+    bool write_extent(const OpenFile& file, uint32_t page_num, const char* buffer);
+
     std::string data_dir_;
-    std::unordered_map<std::string, std::unique_ptr<std::fstream>> open_files_;
+    std::unique_ptr<IoBackend> backend_;
+    bool direct_io_ = false;
+    uint32_t page_size_ = Page::DEFAULT_PAGE_SIZE;
+
+    // Guards the descriptor map only; I/O runs under the shared lock
+    std::shared_mutex files_latch_;
+    std::unordered_map<std::string, OpenFile> open_files_;
+
+    // Interned file ids, read-mostly so lookups take a shared lock
+    std::shared_mutex file_ids_latch_;
+    std::unordered_map<std::string, uint32_t> file_ids_;
+    uint32_t next_file_id_ = INVALID_FILE_ID + 1;
+
     Stats stats_;
+
+    // Last, so the collector is unregistered before stats_ is destroyed
+    common::MetricsRegistry::Registration metrics_;
 };
 
 }  // namespace cloudsql::storage
@@ -0,0 +1,130 @@
+/**
+ * @file commit_log.hpp
+ * @brief Commit sequence numbers of transactions, for MVCC visibility
+ */
+
+#ifndef CLOUDSQL_TRANSACTION_COMMIT_LOG_HPP
+#define CLOUDSQL_TRANSACTION_COMMIT_LOG_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace cloudsql::transaction {
+
+using txn_id_t = uint64_t;
+using csn_t = uint64_t; /**< Commit sequence number: the order transactions committed in */
+
+/**
+ * @class CommitLog
+ * @brief Lock-free map from transaction id to commit sequence number
+ *
+ * Every commit takes the next CSN from a global counter, and a snapshot is just
+ * the latest CSN handed out: a transaction is visible to it if it committed
+ * with a CSN no higher. Snapshots therefore cost one atomic load however many
+ * transactions are running, and a visibility check is a lookup here.
+ *
+ * Entries live in segments of SEGMENT_SIZE ids, held in a ring of MAX_SEGMENTS
+ * slots. Once every id of a segment has ended and its commits are visible to
+ * every snapshot, truncate() moves truncated_below() past it and those ids read
+ * as FROZEN; the segment is then recycled for ids one ring further on. Readers
+ * need no latch: a reader checks that the segment still holds its id's range
+ * after reading the entry. Memory is bounded by the ids between the truncation
+ * point and the newest transaction; reserve() fails if they outgrow the ring.
+ *
+ * A commit marks its entry COMMITTING before drawing its CSN; a reader that
+ * finds the mark waits for the number, so no snapshot can see the commit appear
+ * after the fact.
+ */
+class CommitLog {
+   public:
+    static constexpr csn_t IN_PROGRESS = 0; /**< Also unknown ids, and aborts not yet recorded */
+    static constexpr csn_t FROZEN = 1;      /**< Ids below frozen_below(): committed before any snapshot */
+    static constexpr csn_t COMMITTING = UINT64_MAX - 1;
+    static constexpr csn_t ABORTED = UINT64_MAX;
+
+    static constexpr size_t SEGMENT_BITS = 16;
+    static constexpr size_t SEGMENT_SIZE = size_t{1} << SEGMENT_BITS;
+    static constexpr size_t MAX_SEGMENTS = size_t{1} << 16; /**< Live ids up to 2^32 */
+
+    CommitLog();
+    ~CommitLog();
+
+    CommitLog(const CommitLog&) = delete;
+    CommitLog& operator=(const CommitLog&) = delete;
+    CommitLog(CommitLog&&) = delete;
+    CommitLog& operator=(CommitLog&&) = delete;
+
+    /** @return CSN a snapshot taken now sees up to */
+    [[nodiscard]] csn_t snapshot() const { return last_csn_.load(); }
+
+    /**
+     * @brief Make room for the entry of a new transaction
+     * @return false if the ids not yet truncated already fill the ring
+     */
+    [[nodiscard]] bool reserve(txn_id_t txn_id) { return entry(txn_id) != nullptr; }
+
+    /**
+     * @brief Record a commit
+     * @return The CSN it was given
+     * @throws std::runtime_error if the entry has no room; the commit then has no CSN
+     */
+    csn_t commit(txn_id_t txn_id);
+
+    /** @brief Record an abort */
+    void abort(txn_id_t txn_id);
+
+    /**
+     * @brief Treat ids below `txn_id` as committed before every snapshot, except `in_doubt`
+     *
+     * Called after recovery: the log only knows transactions of this run, and
+     * recovery leaves the heap holding committed work of earlier ones only, apart
+     * from prepared transactions still waiting for their outcome. Those stay in
+     * progress; the ids between them are frozen entry by entry.
+     */
+    void set_frozen_below(txn_id_t txn_id, const std::vector<txn_id_t>& in_doubt = {});
+    [[nodiscard]] txn_id_t frozen_below() const { return frozen_below_.load(); }
+
+    /**
+     * @brief Release the segments wholly below `oldest_running` whose commits are
+     * all visible at CSN `horizon`
+     *
+     * `oldest_running` must be at most the lowest id still running and `horizon`
+     * the oldest running snapshot, so no reader can tell the ids from FROZEN any
+     * more; aborted ones have been rolled back. Callers serialize calls.
+     */
+    void truncate(txn_id_t oldest_running, csn_t horizon);
+    [[nodiscard]] txn_id_t truncated_below() const { return truncated_below_.load(); }
+
+    /** @return CSN of a transaction, IN_PROGRESS or ABORTED; never COMMITTING */
+    [[nodiscard]] csn_t csn(txn_id_t txn_id) const;
+
+    /** @return true if the transaction committed at or before CSN `snapshot` */
+    [[nodiscard]] bool is_visible(txn_id_t txn_id, csn_t snapshot) const {
+        const csn_t committed = csn(txn_id);
+        return committed != IN_PROGRESS && committed != ABORTED && committed <= snapshot;
+    }
+
+   private:
+    static constexpr uint64_t RECYCLING = UINT64_MAX;
+
+    struct Segment {
+        std::atomic<uint64_t> number; /**< Of its ids (id >> SEGMENT_BITS); RECYCLING in reset */
+        std::array<std::atomic<csn_t>, SEGMENT_SIZE> entries;
+    };
+
+    /** @return The entry of an id, allocating or recycling its segment; null if the ring is full */
+    std::atomic<csn_t>* entry(txn_id_t txn_id);
+
+    std::unique_ptr<std::atomic<Segment*>[]> segments_; /**< Ring indexed by segment number */
+    std::atomic<csn_t> last_csn_{FROZEN};
+    std::atomic<txn_id_t> frozen_below_{0};
+    std::atomic<txn_id_t> truncated_below_{0}; /**< Segment aligned */
+};
+
+}  // namespace cloudsql::transaction
+
+#endif  // CLOUDSQL_TRANSACTION_COMMIT_LOG_HPP
@@ -6,38 +6,55 @@
 #ifndef CLOUDSQL_TRANSACTION_LOCK_MANAGER_HPP
 #define CLOUDSQL_TRANSACTION_LOCK_MANAGER_HPP
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
+#include "common/latency_histogram.hpp"
+#include "common/metrics.hpp"
+#include "storage/heap_table.hpp"
 #include "transaction/transaction.hpp"
 
 namespace cloudsql::transaction {
 
-enum class LockMode : uint8_t { SHARED, EXCLUSIVE };
-
+/**
+ * @class LockManager
+ * @brief Multi-granularity 2PL locks with FIFO queues and background deadlock detection
+ *
+ * Lock targets are packed 64-bit keys naming a table, a page or a row (see
+ * table_key(), page_key() and row_key()). lock_row() takes the intention locks above
+ * a row first and escalates to a single table lock once a transaction holds
+ * escalation_threshold() row locks in that table.
+ *
+ * The table of queues is split into hash partitions whose latch is held only to find
+ * a queue; waiting and granting happen under each queue's own latch. A detector
+ * thread periodically builds the waits-for graph and, for every cycle, wakes the
+ * youngest waiting transaction in it with a failed acquire instead of letting the
+ * cycle run into the lock timeout.
+ */
 class LockManager {
-   private:
-    struct LockRequest {
-        txn_id_t txn_id = 0;
-        LockMode mode = LockMode::SHARED;
-        bool granted = false;
-    };
-
-    struct LockQueue {
-        std::list<LockRequest> request_queue;
-        std::condition_variable cv;
-        bool upgrading = false;  // Prevents starvation during upgrade (not fully impl yet)
-    };
-
-    std::mutex latch_;
-    std::unordered_map<std::string, LockQueue> lock_table_;  // RID -> LockQueue
-
    public:
-    LockManager() = default;
-    ~LockManager() = default;
+    static constexpr size_t NUM_PARTITIONS = 64;
+    static constexpr auto DEFAULT_DETECTION_INTERVAL = std::chrono::milliseconds(10);
+    static constexpr auto DEFAULT_LOCK_TIMEOUT = std::chrono::milliseconds(1000);
+
+    /**
+     * @param detection_interval Pause between waits-for graph scans
+     * @param lock_timeout Longest a request waits before giving up anyway
+     */
+    explicit LockManager(std::chrono::milliseconds detection_interval = DEFAULT_DETECTION_INTERVAL,
+                         std::chrono::milliseconds lock_timeout = DEFAULT_LOCK_TIMEOUT);
+    ~LockManager();
 
     // Disable copy/move for lock manager
     LockManager(const LockManager&) = delete;
@@ -45,20 +62,196 @@ class LockManager {
     LockManager(LockManager&&) = delete;
     LockManager& operator=(LockManager&&) = delete;
 
+    static constexpr size_t DEFAULT_ESCALATION_THRESHOLD = 5000;
+
+    /**
+     * @brief Lock key of a tuple
+     *
+     * The top two bits give the level, then the low 14 bits of the table oid, the
+     * page and the slot. Tables whose oids agree in the low bits share keys, which
+     * only makes locking more conservative.
+     */
+    [[nodiscard]] static lock_key_t row_key(uint32_t table_oid,
+                                            const storage::HeapTable::TupleId& tid) {
+        return table_bits(table_oid) | (static_cast<uint64_t>(tid.page_num) << 16U) |
+               tid.slot_num;
+    }
+
+    /** @brief Lock key of a heap page */
+    [[nodiscard]] static lock_key_t page_key(uint32_t table_oid, uint32_t page_num) {
+        return LEVEL_PAGE | table_bits(table_oid) | (static_cast<uint64_t>(page_num) << 16U);
+    }
+
+    /** @brief Lock key of a whole table */
+    [[nodiscard]] static lock_key_t table_key(uint32_t table_oid) {
+        return LEVEL_TABLE | table_bits(table_oid);
+    }
+
+    /**
+     * @brief Acquire a lock in any mode on a key
+     *
+     * A lock the transaction already holds is converted in place to the weakest mode
+     * covering both. Only one conversion per key may wait at a time; a second one
+     * could deadlock with it and fails at once.
+     * @param wait false to fail rather than wait for conflicting holders
+     */
+    bool acquire(Transaction* txn, lock_key_t key, LockMode mode, bool wait = true);
+
+    /**
+     * @brief Lock a table in any mode
+     */
+    bool lock_table(Transaction* txn, uint32_t table_oid, LockMode mode) {
+        return acquire(txn, table_key(table_oid), mode);
+    }
+
+    /**
+     * @brief Lock a row SHARED or EXCLUSIVE under IS/IX locks on its table and page
+     *
+     * Free if a table lock the transaction holds already covers the row. Reaching
+     * the escalation threshold tries, without waiting, to trade the transaction's row
+     * and page locks in the table for one table lock.
+     */
+    bool lock_row(Transaction* txn, uint32_t table_oid, const storage::HeapTable::TupleId& tid,
+                  LockMode mode);
+
+    /**
+     * @brief Lock rows of one table, e.g. those a statement is about to change
+     * @return false if any lock could not be acquired
+     */
+    bool lock_rows(Transaction* txn, uint32_t table_oid,
+                   const std::vector<storage::HeapTable::TupleId>& tids, LockMode mode);
+
+    /**
+     * @brief Row locks per table at which a transaction escalates (0 = never)
+     */
+    void set_escalation_threshold(size_t rows) { escalation_threshold_ = rows; }
+    [[nodiscard]] size_t escalation_threshold() const { return escalation_threshold_; }
+
+    /**
+     * @brief Acquire a shared (read) lock on a key
+     */
+    bool acquire_shared(Transaction* txn, lock_key_t rid) {
+        return acquire(txn, rid, LockMode::SHARED);
+    }
+
+    /**
+     * @brief Acquire an exclusive (write) lock on a key, upgrading a shared one
+     */
+    bool acquire_exclusive(Transaction* txn, lock_key_t rid) {
+        return acquire(txn, rid, LockMode::EXCLUSIVE);
+    }
+
+    /**
+     * @brief Acquire exclusive locks on several tuples, e.g. rows just inserted
+     *
+     * Locks nobody else holds or waits for are granted without waiting; the rest
+     * are acquired one at a time.
+     * @return false if any lock could not be acquired
+     */
+    bool acquire_exclusive(Transaction* txn, const std::vector<lock_key_t>& rids);
+
+    /**
+     * @brief Release a lock in whatever mode it is held
+     */
+    bool unlock(Transaction* txn, lock_key_t rid);
+
     /**
-     * @brief Acquire a shared (read) lock on a tuple
+     * @brief Number of waiting transactions chosen as deadlock victims so far
      */
-    bool acquire_shared(Transaction* txn, const std::string& rid);
+    [[nodiscard]] uint64_t deadlocks() const { return deadlocks_.load(std::memory_order_relaxed); }
 
     /**
-     * @brief Acquire an exclusive (write) lock on a tuple
+     * @brief Number of times a transaction's row locks were replaced by a table lock
      */
-    bool acquire_exclusive(Transaction* txn, const std::string& rid);
+    [[nodiscard]] uint64_t escalations() const {
+        return escalations_.load(std::memory_order_relaxed);
+    }
 
     /**
-     * @brief Unlock a tuple
+     * @brief Number of requests that had to wait for a conflicting lock
      */
-    bool unlock(Transaction* txn, const std::string& rid);
+    [[nodiscard]] uint64_t waits() const { return waits_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Time requests spent waiting, granted or not (us)
+     */
+    [[nodiscard]] const common::LatencyHistogram& wait_latency() const { return wait_latency_; }
+
+   private:
+    static constexpr txn_id_t NO_TXN = 0;
+    static constexpr uint64_t LEVEL_PAGE = 1ULL << 62U;
+    static constexpr uint64_t LEVEL_TABLE = 2ULL << 62U;
+    static constexpr uint64_t LEVEL_MASK = 3ULL << 62U;
+    static constexpr uint64_t TABLE_MASK = 0x3FFFULL << 48U;
+
+    [[nodiscard]] static uint64_t table_bits(uint32_t table_oid) {
+        return static_cast<uint64_t>(table_oid & 0x3FFFU) << 48U;
+    }
+
+    struct LockRequest {
+        txn_id_t txn_id = 0;
+        LockMode mode = LockMode::SHARED;
+        bool granted = false;
+        bool victim = false; /**< Chosen to break a deadlock; the waiter gives up */
+    };
+
+    struct LockQueue {
+        std::mutex latch;
+        std::condition_variable cv;
+        std::list<LockRequest> request_queue;
+        txn_id_t upgrading = NO_TXN; /**< Holder waiting to convert its lock to upgrade_mode */
+        LockMode upgrade_mode = LockMode::EXCLUSIVE;
+        size_t refs = 0;             /**< Threads using the queue; guarded by the partition latch */
+    };
+
+    struct Partition {
+        std::mutex latch;
+        std::unordered_map<lock_key_t, std::unique_ptr<LockQueue>> queues;
+    };
+
+    [[nodiscard]] Partition& partition_for(lock_key_t rid) {
+        return partitions_[(rid * 0x9E3779B97F4A7C15ULL) >> 58U];
+    }
+
+    /** @brief Find or create the queue for a key and hold a reference to it */
+    LockQueue& pin_queue(lock_key_t rid);
+
+    /** @brief Drop a reference, freeing the queue once unused and empty */
+    void unpin_queue(lock_key_t rid);
+
+    /** @brief Whether a waiting request can be granted (caller holds queue.latch) */
+    static bool grantable(const LockQueue& queue, std::list<LockRequest>::const_iterator req);
+
+    /** @brief Whether no other granted request conflicts with `mode` (caller holds latch) */
+    static bool compatible_with_granted(const LockQueue& queue, txn_id_t txn_id, LockMode mode);
+
+    /** @brief Trade a transaction's row and page locks in a table for a table lock */
+    void escalate(Transaction* txn, lock_key_t table);
+
+    /** @brief Wait in queue for `req` to be granted or the upgrade to go through */
+    bool wait_for_grant(std::unique_lock<std::mutex>& lock, LockQueue& queue, Transaction* txn,
+                        const std::function<bool()>& ready, LockRequest& req);
+
+    void detector();
+    void detect_deadlocks();
+
+    std::array<Partition, NUM_PARTITIONS> partitions_;
+    std::chrono::milliseconds detection_interval_;
+    std::chrono::milliseconds lock_timeout_;
+    std::atomic<size_t> escalation_threshold_{DEFAULT_ESCALATION_THRESHOLD};
+    std::atomic<uint64_t> deadlocks_{0};
+    std::atomic<uint64_t> escalations_{0};
+    std::atomic<uint64_t> waits_{0};
+    std::atomic<uint64_t> timeouts_{0};
+    common::LatencyHistogram wait_latency_;
+
+    std::mutex detector_latch_;
+    std::condition_variable detector_cv_;
+    bool detector_stop_ = false;
+    std::thread detector_thread_;
+
+    // Last, so the collector is unregistered before the counters it reads
+    common::MetricsRegistry::Registration metrics_;
 };
 
 }  // namespace cloudsql::transaction
@@ -8,17 +8,33 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <mutex>
 #include <optional>
-#include <unordered_set>
+#include <unordered_map>
 #include <vector>
 
 #include "common/config.hpp"
 #include "storage/heap_table.hpp"
+#include "transaction/commit_log.hpp"
 
 namespace cloudsql::transaction {
 
-using txn_id_t = uint64_t;
+using lock_key_t = uint64_t; /**< Packed lock target, see LockManager::row_key() */
+
+/**
+ * @brief Lock modes of multi-granularity locking
+ *
+ * Intention modes on a table or page announce row (or page) locks below it.
+ */
+enum class LockMode : uint8_t {
+    SHARED,
+    EXCLUSIVE,
+    INTENTION_SHARED,
+    INTENTION_EXCLUSIVE,
+    SHARED_INTENTION_EXCLUSIVE
+};
 
 enum class TransactionState : uint8_t { RUNNING, PREPARED, COMMITTED, ABORTED };
 
@@ -31,21 +47,15 @@ enum class IsolationLevel : uint8_t {
 
 /**
  * @brief Represents a snapshot of the system state for MVCC
+ *
+ * The commits it sees are those numbered up to its CSN in the commit log.
  */
 struct TransactionSnapshot {
-    txn_id_t xmin = 0;  // Lower water mark (all txns < xmin are finished)
-    txn_id_t xmax = 0;  // Upper water mark (all txns >= xmax are in the future)
-    std::unordered_set<txn_id_t>
-        active_txns;  // Set of txns between xmin and xmax that are still running
+    csn_t csn = 0;                          // Latest commit visible
+    const CommitLog* commit_log = nullptr;  // Where commits are looked up; null sees none
 
     [[nodiscard]] bool is_visible(txn_id_t id) const {
-        if (id < xmin) {
-            return true;
-        }
-        if (id >= xmax) {
-            return false;
-        }
-        return active_txns.find(id) == active_txns.end();
+        return commit_log != nullptr && commit_log->is_visible(id, csn);
     }
 };
 
@@ -58,6 +68,7 @@ struct UndoLog {
     std::string table_name;
     storage::HeapTable::TupleId rid;
     std::optional<storage::HeapTable::TupleId> old_rid;
+    int32_t lsn = -1;  // WAL record of the change, -1 if it was not logged
 };
 
 /**
@@ -69,12 +80,13 @@ class Transaction {
     std::atomic<TransactionState> state_;
     IsolationLevel isolation_level_;
     TransactionSnapshot snapshot_;
-    int32_t prev_lsn_ = -1;  // Last LSN for this transaction
+    std::atomic<int32_t> prev_lsn_{-1};   // Last LSN for this transaction
+    std::atomic<int32_t> first_lsn_{-1};  // Its BEGIN record, read by checkpoints
 
     // Locks held by this transaction (for auto-release on commit/abort)
-    std::mutex lock_set_mutex_;
-    std::unordered_set<std::string> shared_locks_;  // RID string
-    std::unordered_set<std::string> exclusive_locks_;
+    mutable std::mutex lock_set_mutex_;
+    std::unordered_map<lock_key_t, LockMode> locks_;
+    std::unordered_map<lock_key_t, size_t> row_locks_;  // Table key -> row locks under it
 
     // Changes to undo on rollback
     std::vector<UndoLog> undo_logs_;
@@ -97,35 +109,69 @@ class Transaction {
     [[nodiscard]] IsolationLevel get_isolation_level() const { return isolation_level_; }
 
     [[nodiscard]] const TransactionSnapshot& get_snapshot() const { return snapshot_; }
+
+    /** @return true if the tuple version created by xmin and deleted by xmax is visible */
+    [[nodiscard]] bool can_see(uint64_t xmin, uint64_t xmax) const {
+        const bool xmin_visible = xmin == txn_id_ || xmin == 0 || snapshot_.is_visible(xmin);
+        const bool xmax_visible =
+            xmax == 0 || (xmax != txn_id_ && !snapshot_.is_visible(xmax));
+        return xmin_visible && xmax_visible;
+    }
     void set_snapshot(TransactionSnapshot snapshot) { snapshot_ = std::move(snapshot); }
 
-    [[nodiscard]] int32_t get_prev_lsn() const { return prev_lsn_; }
-    void set_prev_lsn(int32_t lsn) { prev_lsn_ = lsn; }
+    [[nodiscard]] int32_t get_prev_lsn() const { return prev_lsn_.load(); }
+    void set_prev_lsn(int32_t lsn) { prev_lsn_.store(lsn); }
+    [[nodiscard]] int32_t get_first_lsn() const { return first_lsn_.load(); }
+    void set_first_lsn(int32_t lsn) { first_lsn_.store(lsn); }
 
-    void add_shared_lock(const std::string& rid) {
+    /** @brief Record the mode now held on a key */
+    void add_lock(lock_key_t key, LockMode mode) {
         const std::scoped_lock<std::mutex> lock(lock_set_mutex_);
-        shared_locks_.insert(rid);
+        locks_[key] = mode;
     }
 
-    void add_exclusive_lock(const std::string& rid) {
+    void remove_lock(lock_key_t key) {
         const std::scoped_lock<std::mutex> lock(lock_set_mutex_);
-        exclusive_locks_.insert(rid);
+        locks_.erase(key);
     }
 
-    [[nodiscard]] std::unordered_set<std::string> get_shared_lock_set() {
+    /** @return The mode held on a key, if any */
+    [[nodiscard]] std::optional<LockMode> held_lock(lock_key_t key) const {
         const std::scoped_lock<std::mutex> lock(lock_set_mutex_);
-        return shared_locks_;
+        const auto it = locks_.find(key);
+        if (it == locks_.end()) {
+            return std::nullopt;
+        }
+        return it->second;
     }
-    [[nodiscard]] std::unordered_set<std::string> get_exclusive_lock_set() {
+
+    [[nodiscard]] std::vector<lock_key_t> get_lock_set() const {
         const std::scoped_lock<std::mutex> lock(lock_set_mutex_);
-        return exclusive_locks_;
+        std::vector<lock_key_t> keys;
+        keys.reserve(locks_.size());
+        for (const auto& [key, mode] : locks_) {
+            keys.push_back(key);
+        }
+        return keys;
+    }
+
+    /** @return Distinct row locks now held under a table, counting the one just granted */
+    size_t count_row_lock(lock_key_t table_key) {
+        const std::scoped_lock<std::mutex> lock(lock_set_mutex_);
+        return ++row_locks_[table_key];
+    }
+
+    /** @brief Forget the row lock count of a table whose row locks were escalated */
+    void clear_row_locks(lock_key_t table_key) {
+        const std::scoped_lock<std::mutex> lock(lock_set_mutex_);
+        row_locks_.erase(table_key);
     }
 
     void add_undo_log(UndoLog::Type type, const std::string& table_name,
                       const storage::HeapTable::TupleId& rid) {
         /* Enforce invariant: non-UPDATE types should not provide old_rid through this overload */
         assert(type != UndoLog::Type::UPDATE);
-        undo_logs_.push_back({type, table_name, rid, std::nullopt});
+        undo_logs_.push_back({type, table_name, rid, std::nullopt, prev_lsn_.load()});
     }
 
     void add_undo_log(UndoLog::Type type, const std::string& table_name,
@@ -133,9 +179,22 @@ class Transaction {
                       const storage::HeapTable::TupleId& old_rid) {
         /* Enforce invariant: this overload is primarily for UPDATE types providing old_rid */
         assert(type == UndoLog::Type::UPDATE);
-        undo_logs_.push_back({type, table_name, rid, old_rid});
+        undo_logs_.push_back({type, table_name, rid, old_rid, prev_lsn_.load()});
     }
 
+    /**
+     * @brief Attach the WAL record of a change to undo entries [first, last)
+     *
+     * For entries added before their change was logged.
+     */
+    void set_undo_lsn(size_t first, size_t last, int32_t lsn) {
+        for (size_t i = first; i < last && i < undo_logs_.size(); ++i) {
+            undo_logs_[i].lsn = lsn;
+        }
+    }
+
+    [[nodiscard]] size_t undo_log_count() const { return undo_logs_.size(); }
+
     [[nodiscard]] const std::vector<UndoLog>& get_undo_logs() const { return undo_logs_; }
 };
 
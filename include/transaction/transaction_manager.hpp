@@ -7,14 +7,18 @@
 #define CLOUDSQL_TRANSACTION_TRANSACTION_MANAGER_HPP
 
 #include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "catalog/catalog.hpp"
+#include "recovery/log_record.hpp"
 #include "storage/buffer_pool_manager.hpp"
+#include "transaction/commit_log.hpp"
 #include "transaction/lock_manager.hpp"
 #include "transaction/transaction.hpp"
 
@@ -41,6 +45,7 @@ class TransactionManager {
      * @brief Start a new transaction
      * @param level Isolation level
      * @return Pointer to the new transaction
+     * @throws std::runtime_error if the commit log has no room for its id
      */
     Transaction* begin(IsolationLevel level = IsolationLevel::REPEATABLE_READ);
 
@@ -64,6 +69,70 @@ class TransactionManager {
      */
     Transaction* get_transaction(txn_id_t txn_id);
 
+    /**
+     * @brief Number new transactions from `txn_id` on, if that is higher than now
+     *
+     * Called after recovery so ids stay above every id in the log and heap.
+     * Transactions below `txn_id` are taken as committed before every snapshot,
+     * except those restore_prepared() has registered.
+     */
+    void set_next_txn_id(txn_id_t txn_id);
+
+    /**
+     * @brief Register a transaction recovery left prepared, awaiting its coordinator
+     *
+     * Rebuilds its undo log and exclusive row locks from `changes`, its heap
+     * records in log order, so commit() or abort() resolves it like any other.
+     * Call before set_next_txn_id().
+     * @return The transaction, or null if a row lock could not be taken
+     */
+    Transaction* restore_prepared(const recovery::CheckpointTxn& prepared,
+                                  const std::vector<recovery::LogRecord>& changes);
+
+    /** @return Id the next transaction to begin will get */
+    [[nodiscard]] txn_id_t next_txn_id() const { return next_txn_id_.load(); }
+
+    /**
+     * @brief Logged transactions still active, for a checkpoint's transaction table
+     */
+    [[nodiscard]] std::vector<recovery::CheckpointTxn> checkpoint_txns();
+
+    /**
+     * @brief CSN of the oldest running snapshot, or the latest CSN if none runs
+     *
+     * A record version whose deleting transaction is visible at this CSN is
+     * invisible to every current and future snapshot, so vacuum may remove it.
+     */
+    [[nodiscard]] csn_t vacuum_horizon();
+
+    /** @return Commit sequence numbers of this manager's transactions */
+    [[nodiscard]] const CommitLog& commit_log() const { return commit_log_; }
+
+    /**
+     * @brief Versions deleted by committed transactions per table, since the table's
+     * last vacuum took them into account
+     */
+    [[nodiscard]] std::unordered_map<std::string, uint64_t> dead_tuple_counts();
+
+    /** @brief Forget `count` of a table's dead versions once vacuum has dealt with them */
+    void clear_dead_tuples(const std::string& table, uint64_t count);
+
+    /**
+     * @brief Latch that keeps vacuums of `table` from overlapping
+     *
+     * Every VacuumManager, manual or autovacuum, shares this manager, so holding
+     * the latch for the whole of a table's vacuum serializes them.
+     */
+    [[nodiscard]] std::mutex& vacuum_latch(const std::string& table);
+
+    /**
+     * @brief Blocks until every transaction begun before the call has committed or aborted
+     *
+     * CREATE INDEX CONCURRENTLY waits so after publishing its index, for
+     * statements still writing through handles opened before the index existed.
+     */
+    void wait_for_running();
+
    private:
     LockManager& lock_manager_;
     Catalog& catalog_;
@@ -71,7 +140,9 @@ class TransactionManager {
     recovery::LogManager* log_manager_;
 
     std::atomic<txn_id_t> next_txn_id_{1};
+    CommitLog commit_log_;
     std::mutex manager_latch_;
+    std::condition_variable txn_ended_; /**< Notified as transactions leave active_transactions_ */
 
     // All active transactions
     std::unordered_map<txn_id_t, std::unique_ptr<Transaction>> active_transactions_;
@@ -79,6 +150,15 @@ class TransactionManager {
     // Transactions that have recently finished (for cleanup/safety)
     std::deque<std::unique_ptr<Transaction>> completed_transactions_;
 
+    // Committed deletions per table not yet vacuumed
+    std::unordered_map<std::string, uint64_t> dead_tuples_;
+
+    // One latch per table ever vacuumed, never freed so references stay valid
+    std::unordered_map<std::string, std::unique_ptr<std::mutex>> vacuum_latches_;
+
+    /** @brief Release commit log segments no snapshot needs; called with manager_latch_ held */
+    void truncate_commit_log();
+
     /**
      * @brief Undo changes made by a transaction
      */
@@ -0,0 +1,109 @@
+/**
+ * @file vacuum_manager.hpp
+ * @brief Garbage collection of dead MVCC record versions
+ */
+
+#ifndef CLOUDSQL_TRANSACTION_VACUUM_MANAGER_HPP
+#define CLOUDSQL_TRANSACTION_VACUUM_MANAGER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "catalog/catalog.hpp"
+#include "storage/buffer_pool_manager.hpp"
+#include "transaction/transaction_manager.hpp"
+
+namespace cloudsql::transaction {
+
+/**
+ * @brief What one vacuum of a table or of every table did
+ */
+struct VacuumStats {
+    uint64_t pages_scanned = 0;
+    uint64_t tuples_removed = 0;
+};
+
+/**
+ * @class VacuumManager
+ * @brief Reclaims record versions no snapshot can see any more
+ *
+ * DELETE and UPDATE only stamp xmax on the old version. Vacuum walks a table's
+ * pages, drops the index entries left for versions whose deletion the oldest
+ * running snapshot already sees (TransactionManager::vacuum_horizon()), removes
+ * the versions and compacts each page, handing the space back to the
+ * free-space map.
+ *
+ * The autovacuum worker wakes every naptime and vacuums the tables whose
+ * committed deletions since their last vacuum reach a threshold, pausing after
+ * every cost_limit pages so it does not crowd queries out of the buffer pool
+ * and the disk. A manual vacuum runs unthrottled.
+ */
+class VacuumManager {
+   public:
+    struct Options {
+        std::chrono::milliseconds naptime{1000};   /**< Between checks for tables due */
+        uint64_t threshold = 500;                  /**< Dead versions that make a table due */
+        size_t cost_limit = 200;                   /**< Pages vacuumed between pauses */
+        std::chrono::milliseconds cost_delay{20};  /**< Length of each pause; 0 = none */
+    };
+
+    VacuumManager(Catalog& catalog, storage::BufferPoolManager& bpm,
+                  TransactionManager& transaction_manager);
+    ~VacuumManager();
+
+    VacuumManager(const VacuumManager&) = delete;
+    VacuumManager& operator=(const VacuumManager&) = delete;
+    VacuumManager(VacuumManager&&) = delete;
+    VacuumManager& operator=(VacuumManager&&) = delete;
+
+    /**
+     * @brief Vacuum one table now
+     */
+    VacuumStats vacuum_table(const TableInfo& table);
+
+    /**
+     * @brief Vacuum every table now
+     */
+    VacuumStats vacuum_all();
+
+    /**
+     * @brief Start the autovacuum worker; does nothing if it is running
+     */
+    void start(const Options& options);
+
+    /**
+     * @brief Stop the autovacuum worker, letting it finish the page it is on
+     */
+    void stop();
+
+    /** @return Tables the autovacuum worker has vacuumed so far */
+    [[nodiscard]] uint64_t autovacuum_runs() const {
+        return autovacuum_runs_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    /** @brief Vacuum `table`, pausing as `throttle` says unless it is null */
+    VacuumStats vacuum_table(const TableInfo& table, const Options* throttle);
+
+    void run();
+
+    Catalog& catalog_;
+    storage::BufferPoolManager& bpm_;
+    TransactionManager& transaction_manager_;
+
+    Options options_;
+    std::atomic<uint64_t> autovacuum_runs_{0};
+    std::mutex worker_latch_;
+    std::condition_variable worker_cv_;
+    bool worker_stop_ = false;
+    std::thread worker_;
+};
+
+}  // namespace cloudsql::transaction
+
+#endif  // CLOUDSQL_TRANSACTION_VACUUM_MANAGER_HPP
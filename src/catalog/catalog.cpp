@@ -5,13 +5,22 @@
 
 #include "catalog/catalog.hpp"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <ctime>
-#include <fstream>
 #include <iostream>
+#include <istream>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <ostream>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -19,9 +28,162 @@
 
 #include "common/cluster_manager.hpp"
 #include "distributed/raft_group.hpp"
+#include "storage/mapped_file.hpp"
 
 namespace cloudsql {
 
+namespace {
+
+void append_bytes(std::vector<uint8_t>& cmd, const void* src, size_t len) {
+    const size_t offset = cmd.size();
+    cmd.resize(offset + len);
+    std::memcpy(cmd.data() + offset, src, len);
+}
+
+/**
+ * @brief Serialize a CreateTable command:
+ * [Type:1][NameLen:4][Name][ColCount:4][Cols...][ShardCount:4][Shards...][Flags:4]
+ *
+ * Commands written before tables had flags end after the shards.
+ */
+std::vector<uint8_t> encode_create_table(const std::string& table_name,
+                                         const std::vector<ColumnInfo>& columns,
+                                         const std::vector<ShardInfo>& shards, uint32_t flags) {
+    std::vector<uint8_t> cmd;
+    cmd.push_back(1);  // Type 1: CreateTable
+
+    uint32_t name_len = static_cast<uint32_t>(table_name.size());
+    size_t offset = cmd.size();
+    cmd.resize(offset + 4 + table_name.size());
+    std::memcpy(cmd.data() + offset, &name_len, 4);
+    std::memcpy(cmd.data() + offset + 4, table_name.data(), name_len);
+
+    uint32_t col_count = static_cast<uint32_t>(columns.size());
+    offset = cmd.size();
+    cmd.resize(offset + 4);
+    std::memcpy(cmd.data() + offset, &col_count, 4);
+
+    for (const auto& col : columns) {
+        uint32_t cname_len = static_cast<uint32_t>(col.name.size());
+        offset = cmd.size();
+        cmd.resize(offset + 4 + col.name.size() + 1 + 2);  // len + name + type + pos
+        std::memcpy(cmd.data() + offset, &cname_len, 4);
+        std::memcpy(cmd.data() + offset + 4, col.name.data(), cname_len);
+        cmd[offset + 4 + cname_len] = static_cast<uint8_t>(col.type);
+        std::memcpy(cmd.data() + offset + 4 + cname_len + 1, &col.position, 2);
+    }
+
+    uint32_t shard_count = static_cast<uint32_t>(shards.size());
+    offset = cmd.size();
+    cmd.resize(offset + 4);
+    std::memcpy(cmd.data() + offset, &shard_count, 4);
+
+    for (const auto& shard : shards) {
+        uint32_t addr_len = static_cast<uint32_t>(shard.node_address.size());
+        offset = cmd.size();
+        cmd.resize(offset + 4 + addr_len + 4 + 2);
+        std::memcpy(cmd.data() + offset, &addr_len, 4);
+        std::memcpy(cmd.data() + offset + 4, shard.node_address.data(), addr_len);
+        std::memcpy(cmd.data() + offset + 4 + addr_len, &shard.shard_id, 4);
+        std::memcpy(cmd.data() + offset + 4 + addr_len + 4, &shard.port, 2);
+    }
+    append_bytes(cmd, &flags, 4);
+    return cmd;
+}
+
+/**
+ * @brief Serialize a SetShardRing command:
+ * [Type:1][Migrating:1][TokenCount:4][[Token:8][IdLen:4][Id]...]
+ */
+std::vector<uint8_t> encode_shard_ring(const ShardRing& ring) {
+    std::vector<uint8_t> cmd;
+    cmd.push_back(3);  // Type 3: SetShardRing
+    cmd.push_back(ring.migrating ? 1 : 0);
+
+    uint32_t token_count = static_cast<uint32_t>(ring.tokens.size());
+    size_t offset = cmd.size();
+    cmd.resize(offset + 4);
+    std::memcpy(cmd.data() + offset, &token_count, 4);
+
+    for (const auto& vnode : ring.tokens) {
+        uint32_t id_len = static_cast<uint32_t>(vnode.node_id.size());
+        offset = cmd.size();
+        cmd.resize(offset + 8 + 4 + id_len);
+        std::memcpy(cmd.data() + offset, &vnode.token, 8);
+        std::memcpy(cmd.data() + offset + 8, &id_len, 4);
+        std::memcpy(cmd.data() + offset + 12, vnode.node_id.data(), id_len);
+    }
+    return cmd;
+}
+
+/**
+ * @brief Serialize a DropTable (type 2) or DropIndex (type 5) command: [Type:1][Oid:4]
+ */
+std::vector<uint8_t> encode_drop(uint8_t type, oid_t id) {
+    std::vector<uint8_t> cmd{type};
+    append_bytes(cmd, &id, 4);
+    return cmd;
+}
+
+/**
+ * @brief Serialize a CreateIndex command:
+ * [Type:1][TableId:4][NameLen:4][Name][ColCount:4][[Pos:2]...][IndexType:1][Unique:1]
+ */
+std::vector<uint8_t> encode_create_index(const IndexInfo& index) {
+    std::vector<uint8_t> cmd{4};  // Type 4: CreateIndex
+    append_bytes(cmd, &index.table_id, 4);
+    const auto name_len = static_cast<uint32_t>(index.name.size());
+    append_bytes(cmd, &name_len, 4);
+    append_bytes(cmd, index.name.data(), name_len);
+    const auto col_count = static_cast<uint32_t>(index.column_positions.size());
+    append_bytes(cmd, &col_count, 4);
+    append_bytes(cmd, index.column_positions.data(), size_t{col_count} * 2);
+    cmd.push_back(static_cast<uint8_t>(index.index_type));
+    cmd.push_back(index.is_unique ? 1 : 0);
+    return cmd;
+}
+
+/**
+ * @brief Serialize a SetNextOid command, which images use to keep ids: [Type:1][Oid:4]
+ */
+std::vector<uint8_t> encode_next_oid(oid_t oid) {
+    std::vector<uint8_t> cmd{6};  // Type 6: SetNextOid
+    append_bytes(cmd, &oid, 4);
+    return cmd;
+}
+
+constexpr std::array<char, 8> FILE_MAGIC = {'C', 'S', 'Q', 'L', 'C', 'A', 'T', '\0'};
+constexpr size_t FILE_HEADER_SIZE = FILE_MAGIC.size() + 4;  // [Magic:8][Version:4]
+
+/** @brief Write all of `len` bytes, retrying short writes */
+bool write_all(int fd, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        const ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/** @brief Frame a command as a catalog file record: [Len:4][Cmd] */
+void append_record(std::vector<uint8_t>& out, const std::vector<uint8_t>& cmd) {
+    const auto len = static_cast<uint32_t>(cmd.size());
+    append_bytes(out, &len, 4);
+    append_bytes(out, cmd.data(), cmd.size());
+}
+
+}  // namespace
+
+Catalog::~Catalog() {
+    if (file_fd_ >= 0) {
+        static_cast<void>(::close(file_fd_));
+    }
+}
+
 /**
  * @brief Create a new catalog
  */
@@ -30,47 +192,142 @@ std::unique_ptr<Catalog> Catalog::create() {
 }
 
 /**
- * @brief Load catalog from file
+ * @brief Replay the catalog file and keep appending to it
  */
 bool Catalog::load(const std::string& filename) {
-    (void)database_;  // Use instance member to satisfy linter
-    std::ifstream file(filename);
-    if (!file.is_open()) {
+    if (::access(filename.c_str(), F_OK) != 0) {
+        return save(filename);
+    }
+    const auto mapping = storage::MappedFile::map(filename, true);
+    if (!mapping) {
         std::cerr << "Cannot open catalog file: " << filename << "\n";
         return false;
     }
-    // Simplified - just read database name
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty() || line[0] == '#') {
-            continue;
+    const auto* data = reinterpret_cast<const uint8_t*>(mapping->data());
+    const size_t size = mapping->size();
+    uint32_t format = 0;
+    if (size < FILE_HEADER_SIZE ||
+        std::memcmp(data, FILE_MAGIC.data(), FILE_MAGIC.size()) != 0) {
+        std::cerr << "Not a catalog file: " << filename << "\n";
+        return false;
+    }
+    std::memcpy(&format, data + FILE_MAGIC.size(), 4);
+    if (format != FILE_FORMAT_VERSION) {
+        std::cerr << "Unsupported catalog file version " << format << ": " << filename << "\n";
+        return false;
+    }
+
+    tables_.clear();
+    table_names_.clear();
+    index_tables_.clear();
+    shard_ring_ = ShardRing();
+    next_oid_ = 1;
+
+    replaying_ = true;
+    size_t offset = FILE_HEADER_SIZE;
+    size_t records = 0;
+    while (offset + 4 <= size) {
+        uint32_t len = 0;
+        std::memcpy(&len, data + offset, 4);
+        if (offset + 4 + len > size) {
+            break; /* Cut short by a crash; the change never completed */
         }
-        // Parse catalog entries
+        apply_command(data + offset + 4, len);
+        offset += 4 + len;
+        records++;
+    }
+    replaying_ = false;
+    version_++;
+
+    if (file_fd_ >= 0) {
+        static_cast<void>(::close(file_fd_));
+    }
+    file_fd_ = ::open(filename.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    file_path_ = filename;
+    if (file_fd_ < 0 || (offset < size && ::ftruncate(file_fd_, static_cast<off_t>(offset)) != 0)) {
+        std::cerr << "Cannot open catalog file for writing: " << filename << "\n";
+        return false;
+    }
+
+    /* Dropped and replaced objects leave records behind; rewrite once they dominate */
+    if (records > (2 * image_commands().size()) + 64) {
+        return save(filename);
     }
-    file.close();
     return true;
 }
 
 /**
- * @brief Save catalog to file
+ * @brief Write a compact image and keep appending to it
  */
-bool Catalog::save(const std::string& filename) const {
-    (void)database_;  // Use instance member to satisfy linter
-    std::ofstream file(filename);
-    if (!file.is_open()) {
+bool Catalog::save(const std::string& filename) {
+    std::vector<uint8_t> image(FILE_MAGIC.begin(), FILE_MAGIC.end());
+    append_bytes(image, &FILE_FORMAT_VERSION, 4);
+    for (const auto& cmd : image_commands()) {
+        append_record(image, cmd);
+    }
+
+    const std::string tmp = filename + ".tmp";
+    const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
         std::cerr << "Cannot open catalog file for writing: " << filename << "\n";
         return false;
     }
-    file << "# System Catalog\n";
-    file << "# Auto-generated\n\n";
-    file.close();
-    return true;
+    const bool written = write_all(fd, image.data(), image.size()) && ::fdatasync(fd) == 0;
+    static_cast<void>(::close(fd));
+    if (!written || std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Cannot write catalog file: " << filename << "\n";
+        static_cast<void>(std::remove(tmp.c_str()));
+        return false;
+    }
+
+    if (file_fd_ >= 0) {
+        static_cast<void>(::close(file_fd_));
+    }
+    file_fd_ = ::open(filename.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    file_path_ = filename;
+    return file_fd_ >= 0;
+}
+
+std::vector<std::vector<uint8_t>> Catalog::image_commands() const {
+    std::vector<oid_t> ids;
+    ids.reserve(tables_.size());
+    for (const auto& [id, table] : tables_) {
+        ids.push_back(id);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    std::vector<std::vector<uint8_t>> cmds;
+    for (const oid_t id : ids) {
+        const auto& table = *tables_.at(id);
+        cmds.push_back(encode_next_oid(id));
+        cmds.push_back(encode_create_table(table.name, table.columns, table.shards, table.flags));
+        for (const auto& index : table.indexes) {
+            cmds.push_back(encode_next_oid(index.index_id));
+            cmds.push_back(encode_create_index(index));
+        }
+    }
+    cmds.push_back(encode_shard_ring(shard_ring_));
+    cmds.push_back(encode_next_oid(next_oid_));
+    return cmds;
+}
+
+void Catalog::record(const std::vector<uint8_t>& cmd) {
+    if (file_fd_ < 0 || replaying_) {
+        return;
+    }
+    std::vector<uint8_t> rec;
+    append_record(rec, cmd);
+    if (!write_all(file_fd_, rec.data(), rec.size()) || ::fdatasync(file_fd_) != 0) {
+        std::cerr << "--- [Catalog] Failed to record change in " << file_path_ << " ---"
+                  << std::endl;
+    }
 }
 
 /**
  * @brief Create a new table
  */
-oid_t Catalog::create_table(const std::string& table_name, std::vector<ColumnInfo> columns) {
+oid_t Catalog::create_table(const std::string& table_name, std::vector<ColumnInfo> columns,
+                            uint32_t flags) {
     std::cerr << "--- [Catalog] create_table CALLED for " << table_name << " ---" << std::endl;
 
     // Compute shards from ClusterManager for serialization
@@ -93,57 +350,17 @@ oid_t Catalog::create_table(const std::string& table_name, std::vector<ColumnInf
 
     if (raft_group_ != nullptr) {
         // Multi-Raft: Replicate DDL via Catalog Raft Group (ID 0)
-        // Serialize command:
-        // [Type:1][NameLen:4][Name][ColCount:4][Cols...][ShardCount:4][Shards...]
-        std::vector<uint8_t> cmd;
-        cmd.push_back(1);  // Type 1: CreateTable
-
-        uint32_t name_len = static_cast<uint32_t>(table_name.size());
-        size_t offset = cmd.size();
-        cmd.resize(offset + 4 + table_name.size());
-        std::memcpy(cmd.data() + offset, &name_len, 4);
-        std::memcpy(cmd.data() + offset + 4, table_name.data(), name_len);
-
-        uint32_t col_count = static_cast<uint32_t>(columns.size());
-        offset = cmd.size();
-        cmd.resize(offset + 4);
-        std::memcpy(cmd.data() + offset, &col_count, 4);
-
-        for (const auto& col : columns) {
-            uint32_t cname_len = static_cast<uint32_t>(col.name.size());
-            offset = cmd.size();
-            cmd.resize(offset + 4 + col.name.size() + 1 + 2);  // len + name + type + pos
-            std::memcpy(cmd.data() + offset, &cname_len, 4);
-            std::memcpy(cmd.data() + offset + 4, col.name.data(), cname_len);
-            cmd[offset + 4 + cname_len] = static_cast<uint8_t>(col.type);
-            std::memcpy(cmd.data() + offset + 4 + cname_len + 1, &col.position, 2);
-        }
-
-        uint32_t shard_count = static_cast<uint32_t>(shards.size());
-        offset = cmd.size();
-        cmd.resize(offset + 4);
-        std::memcpy(cmd.data() + offset, &shard_count, 4);
-
-        for (const auto& shard : shards) {
-            uint32_t addr_len = static_cast<uint32_t>(shard.node_address.size());
-            offset = cmd.size();
-            cmd.resize(offset + 4 + addr_len + 4 + 2);
-            std::memcpy(cmd.data() + offset, &addr_len, 4);
-            std::memcpy(cmd.data() + offset + 4, shard.node_address.data(), addr_len);
-            std::memcpy(cmd.data() + offset + 4 + addr_len, &shard.shard_id, 4);
-            std::memcpy(cmd.data() + offset + 4 + addr_len + 4, &shard.port, 2);
-        }
-
+        const std::vector<uint8_t> cmd = encode_create_table(table_name, columns, shards, flags);
         if (raft_group_->replicate(cmd)) {
-            return create_table_local(table_name, std::move(columns), std::move(shards));
+            return create_table_local(table_name, std::move(columns), std::move(shards), flags);
         }
     }
 
-    return create_table_local(table_name, std::move(columns), std::move(shards));
+    return create_table_local(table_name, std::move(columns), std::move(shards), flags);
 }
 
 oid_t Catalog::create_table_local(const std::string& table_name, std::vector<ColumnInfo> columns,
-                                  std::vector<ShardInfo> shards) {
+                                  std::vector<ShardInfo> shards, uint32_t flags) {
     if (table_exists_by_name(table_name)) {
         throw std::runtime_error("Table already exists: " + table_name);
     }
@@ -154,6 +371,7 @@ oid_t Catalog::create_table_local(const std::string& table_name, std::vector<Col
     table->columns = std::move(columns);
     table->created_at = get_current_time();
     table->shards = std::move(shards);
+    table->flags = flags;
 
     if (table->shards.empty() && cluster_manager_ != nullptr) {
         auto data_nodes = cluster_manager_->get_data_nodes();
@@ -183,6 +401,8 @@ oid_t Catalog::create_table_local(const std::string& table_name, std::vector<Col
               << table->shards.size() << " shards ---" << std::endl;
 
     const oid_t id = table->table_id;
+    record(encode_create_table(table->name, table->columns, table->shards, table->flags));
+    table_names_[table->name] = id;
     tables_[id] = std::move(table);
     version_++;
     return id;
@@ -193,11 +413,7 @@ oid_t Catalog::create_table_local(const std::string& table_name, std::vector<Col
  */
 bool Catalog::drop_table(oid_t table_id) {
     if (raft_group_ != nullptr) {
-        std::vector<uint8_t> cmd;
-        cmd.push_back(2);  // Type 2: DropTable
-        cmd.resize(cmd.size() + 4);
-        std::memcpy(cmd.data() + 1, &table_id, 4);
-
+        const std::vector<uint8_t> cmd = encode_drop(2, table_id);  // Type 2: DropTable
         if (raft_group_->replicate(cmd)) {
             return drop_table_local(table_id);
         }
@@ -208,6 +424,11 @@ bool Catalog::drop_table(oid_t table_id) {
 bool Catalog::drop_table_local(oid_t table_id) {
     auto it = tables_.find(table_id);
     if (it != tables_.end()) {
+        record(encode_drop(2, table_id));
+        table_names_.erase(it->second->name);
+        for (const auto& index : it->second->indexes) {
+            index_tables_.erase(index.index_id);
+        }
         tables_.erase(it);
         version_++;
         return true;
@@ -215,68 +436,190 @@ bool Catalog::drop_table_local(oid_t table_id) {
     return false;
 }
 
+void Catalog::set_shard_ring(ShardRing ring) {
+    if (raft_group_ != nullptr) {
+        const std::vector<uint8_t> cmd = encode_shard_ring(ring);
+        if (raft_group_->replicate(cmd)) {
+            set_shard_ring_local(std::move(ring));
+            return;
+        }
+    }
+    set_shard_ring_local(std::move(ring));
+}
+
+void Catalog::set_shard_ring_local(ShardRing ring) {
+    std::sort(ring.tokens.begin(), ring.tokens.end(),
+              [](const auto& a, const auto& b) { return a.token < b.token; });
+    shard_ring_ = std::move(ring);
+    record(encode_shard_ring(shard_ring_));
+    version_++;
+}
+
 void Catalog::apply(const raft::LogEntry& entry) {
     if (entry.data.empty()) return;
     std::cerr << "--- [Catalog] apply CALLED for entry type " << (int)entry.data[0] << " ---"
               << std::endl;
+    apply_command(entry.data.data(), entry.data.size());
+}
 
-    uint8_t type = entry.data[0];
+void Catalog::apply_command(const uint8_t* data, size_t len) {
+    if (len == 0) return;
+    uint8_t type = data[0];
     if (type == 1) {  // CreateTable
         size_t offset = 1;
 
         uint32_t name_len = 0;
-        std::memcpy(&name_len, entry.data.data() + offset, 4);
+        std::memcpy(&name_len, data + offset, 4);
         offset += 4;
-        std::string table_name(reinterpret_cast<const char*>(entry.data.data() + offset), name_len);
+        std::string table_name(reinterpret_cast<const char*>(data + offset), name_len);
         offset += name_len;
 
         uint32_t col_count = 0;
-        std::memcpy(&col_count, entry.data.data() + offset, 4);
+        std::memcpy(&col_count, data + offset, 4);
         offset += 4;
 
         std::vector<ColumnInfo> columns;
         for (uint32_t i = 0; i < col_count; ++i) {
             uint32_t cname_len = 0;
-            std::memcpy(&cname_len, entry.data.data() + offset, 4);
+            std::memcpy(&cname_len, data + offset, 4);
             offset += 4;
-            std::string cname(reinterpret_cast<const char*>(entry.data.data() + offset), cname_len);
+            std::string cname(reinterpret_cast<const char*>(data + offset), cname_len);
             offset += cname_len;
-            common::ValueType ctype = static_cast<common::ValueType>(entry.data[offset++]);
+            common::ValueType ctype = static_cast<common::ValueType>(data[offset++]);
             uint16_t cpos = 0;
-            std::memcpy(&cpos, entry.data.data() + offset, 2);
+            std::memcpy(&cpos, data + offset, 2);
             offset += 2;
             columns.emplace_back(cname, ctype, cpos);
         }
 
         uint32_t shard_count = 0;
-        std::memcpy(&shard_count, entry.data.data() + offset, 4);
+        std::memcpy(&shard_count, data + offset, 4);
         offset += 4;
 
         std::vector<ShardInfo> shards;
         for (uint32_t i = 0; i < shard_count; ++i) {
             uint32_t addr_len = 0;
-            std::memcpy(&addr_len, entry.data.data() + offset, 4);
+            std::memcpy(&addr_len, data + offset, 4);
             offset += 4;
-            std::string addr(reinterpret_cast<const char*>(entry.data.data() + offset), addr_len);
+            std::string addr(reinterpret_cast<const char*>(data + offset), addr_len);
             offset += addr_len;
             ShardInfo shard;
             shard.node_address = addr;
-            std::memcpy(&shard.shard_id, entry.data.data() + offset, 4);
-            std::memcpy(&shard.port, entry.data.data() + offset + 4, 2);
+            std::memcpy(&shard.shard_id, data + offset, 4);
+            std::memcpy(&shard.port, data + offset + 4, 2);
             offset += 6;
             shards.push_back(shard);
         }
+        uint32_t flags = 0;
+        if (offset + 4 <= len) {
+            std::memcpy(&flags, data + offset, 4);
+        }
 
         try {
-            create_table_local(table_name, std::move(columns), std::move(shards));
+            create_table_local(table_name, std::move(columns), std::move(shards), flags);
         } catch (const std::exception& e) {
             // Ignore duplicate table errors during Raft replay
         }
     } else if (type == 2) {  // DropTable
         oid_t table_id = 0;
-        std::memcpy(&table_id, entry.data.data() + 1, 4);
+        std::memcpy(&table_id, data + 1, 4);
         drop_table_local(table_id);
+    } else if (type == 3 && len >= 6) {  // SetShardRing
+        ShardRing ring;
+        ring.migrating = data[1] != 0;
+        uint32_t token_count = 0;
+        std::memcpy(&token_count, data + 2, 4);
+        size_t offset = 6;
+        for (uint32_t i = 0; i < token_count && offset + 12 <= len; ++i) {
+            ShardRing::VirtualNode vnode;
+            uint32_t id_len = 0;
+            std::memcpy(&vnode.token, data + offset, 8);
+            std::memcpy(&id_len, data + offset + 8, 4);
+            offset += 12;
+            if (offset + id_len > len) {
+                break;
+            }
+            vnode.node_id.assign(reinterpret_cast<const char*>(data + offset), id_len);
+            offset += id_len;
+            ring.tokens.push_back(std::move(vnode));
+        }
+        set_shard_ring_local(std::move(ring));
+    } else if (type == 4 && len >= 9) {  // CreateIndex
+        oid_t table_id = 0;
+        uint32_t name_len = 0;
+        std::memcpy(&table_id, data + 1, 4);
+        std::memcpy(&name_len, data + 5, 4);
+        size_t offset = 9;
+        if (offset + name_len + 4 > len) return;
+        std::string index_name(reinterpret_cast<const char*>(data + offset), name_len);
+        offset += name_len;
+        uint32_t col_count = 0;
+        std::memcpy(&col_count, data + offset, 4);
+        offset += 4;
+        if (offset + (size_t{col_count} * 2) + 2 > len) return;
+        std::vector<uint16_t> positions(col_count);
+        std::memcpy(positions.data(), data + offset, size_t{col_count} * 2);
+        offset += size_t{col_count} * 2;
+        const auto index_type = static_cast<IndexType>(data[offset]);
+        const bool is_unique = data[offset + 1] != 0;
+        try {
+            create_index_local(index_name, table_id, std::move(positions), index_type,
+                               is_unique);
+        } catch (const std::exception& e) {
+            // Ignore duplicate index errors during Raft replay
+        }
+    } else if (type == 5 && len >= 5) {  // DropIndex
+        oid_t index_id = 0;
+        std::memcpy(&index_id, data + 1, 4);
+        drop_index_local(index_id);
+    } else if (type == 6 && len >= 5) {  // SetNextOid
+        std::memcpy(&next_oid_, data + 1, 4);
+    }
+}
+
+bool Catalog::save_snapshot(std::ostream& out) {
+    /* What replaying the log would rebuild, under the same ids so that later
+     * DropTable and DropIndex entries still find their objects */
+    // [CmdCount:4][[CmdLen:4][Cmd]...]
+    const auto cmds = image_commands();
+    const auto count = static_cast<uint32_t>(cmds.size());
+    out.write(reinterpret_cast<const char*>(&count), 4);
+    for (const auto& cmd : cmds) {
+        const auto len = static_cast<uint32_t>(cmd.size());
+        out.write(reinterpret_cast<const char*>(&len), 4);
+        out.write(reinterpret_cast<const char*>(cmd.data()), len);
+    }
+    return static_cast<bool>(out);
+}
+
+bool Catalog::load_snapshot(std::istream& in) {
+    uint32_t count = 0;
+    in.read(reinterpret_cast<char*>(&count), 4);
+    if (!in) return false;
+    std::vector<std::vector<uint8_t>> cmds(count);
+    for (auto& cmd : cmds) {
+        uint32_t len = 0;
+        in.read(reinterpret_cast<char*>(&len), 4);
+        cmd.resize(in ? len : 0);
+        in.read(reinterpret_cast<char*>(cmd.data()), len);
+        if (!in) return false;
+    }
+
+    tables_.clear();
+    table_names_.clear();
+    index_tables_.clear();
+    shard_ring_ = ShardRing();
+    replaying_ = true;
+    for (const auto& cmd : cmds) {
+        apply_command(cmd.data(), cmd.size());
+    }
+    replaying_ = false;
+    version_++;
+    /* The catalog file's records describe the state just replaced */
+    if (file_fd_ >= 0 && !save(file_path_)) {
+        return false;
     }
+    return true;
 }
 
 /**
@@ -294,18 +637,11 @@ std::optional<TableInfo*> Catalog::get_table(oid_t table_id) {
  * @brief Get table by name
  */
 std::optional<TableInfo*> Catalog::get_table_by_name(const std::string& table_name) {
-    for (auto& pair : tables_) {
-        if (pair.second->name == table_name) {
-            return pair.second.get();
-        }
+    const auto it = table_names_.find(table_name);
+    if (it != table_names_.end()) {
+        return tables_.at(it->second).get();
     }
-
-    std::cerr << "--- [Catalog] Table NOT FOUND: " << table_name << ". Catalog contains: ";
-    for (auto& pair : tables_) {
-        std::cerr << pair.second->name << ", ";
-    }
-    std::cerr << " ---" << std::endl;
-
+    std::cerr << "--- [Catalog] Table NOT FOUND: " << table_name << " ---" << std::endl;
     return std::nullopt;
 }
 
@@ -327,6 +663,22 @@ std::vector<TableInfo*> Catalog::get_all_tables() {
 oid_t Catalog::create_index(const std::string& index_name, oid_t table_id,
                             std::vector<uint16_t> column_positions, IndexType index_type,
                             bool is_unique) {
+    if (raft_group_ != nullptr && table_exists(table_id)) {
+        IndexInfo index;
+        index.name = index_name;
+        index.table_id = table_id;
+        index.column_positions = column_positions;
+        index.index_type = index_type;
+        index.is_unique = is_unique;
+        static_cast<void>(raft_group_->replicate(encode_create_index(index)));
+    }
+    return create_index_local(index_name, table_id, std::move(column_positions), index_type,
+                              is_unique);
+}
+
+oid_t Catalog::create_index_local(const std::string& index_name, oid_t table_id,
+                                  std::vector<uint16_t> column_positions, IndexType index_type,
+                                  bool is_unique) {
     auto table_opt = get_table(table_id);
     if (!table_opt.has_value()) {
         return 0;
@@ -348,6 +700,8 @@ oid_t Catalog::create_index(const std::string& index_name, oid_t table_id,
     index.is_unique = is_unique;
 
     const oid_t id = index.index_id;
+    record(encode_create_index(index));
+    index_tables_[id] = table_id;
     table.indexes.push_back(std::move(index));
     version_++;
     return id;
@@ -357,15 +711,25 @@ oid_t Catalog::create_index(const std::string& index_name, oid_t table_id,
  * @brief Drop an index
  */
 bool Catalog::drop_index(oid_t index_id) {
-    // Search through all tables to find and remove the index
-    for (auto& pair : tables_) {
-        auto& indexes = pair.second->indexes;
-        for (auto it = indexes.begin(); it != indexes.end(); ++it) {
-            if (it->index_id == index_id) {
-                indexes.erase(it);
-                version_++;
-                return true;
-            }
+    if (raft_group_ != nullptr && index_tables_.count(index_id) != 0) {
+        static_cast<void>(raft_group_->replicate(encode_drop(5, index_id)));  // Type 5: DropIndex
+    }
+    return drop_index_local(index_id);
+}
+
+bool Catalog::drop_index_local(oid_t index_id) {
+    const auto owner = index_tables_.find(index_id);
+    if (owner == index_tables_.end()) {
+        return false;
+    }
+    auto& indexes = tables_.at(owner->second)->indexes;
+    for (auto it = indexes.begin(); it != indexes.end(); ++it) {
+        if (it->index_id == index_id) {
+            record(encode_drop(5, index_id));
+            indexes.erase(it);
+            index_tables_.erase(owner);
+            version_++;
+            return true;
         }
     }
     return false;
@@ -375,11 +739,14 @@ bool Catalog::drop_index(oid_t index_id) {
  * @brief Get index by ID
  */
 std::optional<std::pair<TableInfo*, IndexInfo*>> Catalog::get_index(oid_t index_id) {
-    for (auto& pair : tables_) {
-        for (auto& index : pair.second->indexes) {
-            if (index.index_id == index_id) {
-                return std::make_pair(pair.second.get(), &index);
-            }
+    const auto owner = index_tables_.find(index_id);
+    if (owner == index_tables_.end()) {
+        return std::nullopt;
+    }
+    auto* table = tables_.at(owner->second).get();
+    for (auto& index : table->indexes) {
+        if (index.index_id == index_id) {
+            return std::make_pair(table, &index);
         }
     }
     return std::nullopt;
@@ -414,6 +781,21 @@ bool Catalog::update_table_stats(oid_t table_id, uint64_t num_rows) {
     return false;
 }
 
+/**
+ * @brief Replace table statistics
+ */
+bool Catalog::set_table_stats(oid_t table_id, TableStats stats) {
+    auto table_opt = get_table(table_id);
+    if (table_opt.has_value()) {
+        (*table_opt)->num_rows = stats.row_count;
+        (*table_opt)->stats = std::move(stats);
+        (*table_opt)->modified_at = get_current_time();
+        version_++;
+        return true;
+    }
+    return false;
+}
+
 /**
  * @brief Check if table exists
  */
@@ -425,8 +807,7 @@ bool Catalog::table_exists(oid_t table_id) const {
  * @brief Check if table exists by name
  */
 bool Catalog::table_exists_by_name(const std::string& table_name) const {
-    return std::any_of(tables_.begin(), tables_.end(),
-                       [&table_name](const auto& pair) { return pair.second->name == table_name; });
+    return table_names_.count(table_name) != 0;
 }
 
 /**
@@ -448,6 +829,17 @@ void Catalog::print() const {
     std::cout << "======================\n";
 }
 
+void Catalog::note_data_change(const std::string& table_name) {
+    const std::scoped_lock<std::mutex> lock(data_versions_mutex_);
+    data_versions_[table_name] = ++data_epoch_;
+}
+
+uint64_t Catalog::data_version(const std::string& table_name) const {
+    const std::scoped_lock<std::mutex> lock(data_versions_mutex_);
+    const auto it = data_versions_.find(table_name);
+    return it == data_versions_.end() ? 0 : it->second;
+}
+
 uint64_t Catalog::get_current_time() {
     return static_cast<uint64_t>(std::time(nullptr));
 }
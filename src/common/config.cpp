@@ -14,6 +14,8 @@
 #include <iostream>
 #include <string>
 
+#include "storage/page.hpp"
+
 namespace cloudsql::config {
 
 /**
@@ -55,14 +57,80 @@ bool Config::load(const std::string& filename) {
             port = static_cast<uint16_t>(std::stoi(value));
         } else if (key == "cluster_port") {
             cluster_port = static_cast<uint16_t>(std::stoi(value));
+        } else if (key == "metrics_port") {
+            metrics_port = static_cast<uint16_t>(std::stoi(value));
         } else if (key == "data_dir") {
             data_dir = value;
         } else if (key == "max_connections") {
             max_connections = std::stoi(value);
         } else if (key == "buffer_pool_size") {
             buffer_pool_size = std::stoi(value);
+        } else if (key == "buffer_replacer") {
+            buffer_replacer = value;
+        } else if (key == "buffer_huge_pages") {
+            buffer_huge_pages = (value == "true" || value == "1");
+        } else if (key == "buffer_numa") {
+            buffer_numa = (value == "true" || value == "1");
+        } else if (key == "io_backend") {
+            io_backend = value;
+        } else if (key == "direct_io") {
+            direct_io = (value == "true" || value == "1");
         } else if (key == "page_size") {
             page_size = std::stoi(value);
+        } else if (key == "parallelism") {
+            parallelism = std::stoi(value);
+        } else if (key == "scan_workers") {
+            scan_workers = std::stoi(value);
+        } else if (key == "join_memory_mb") {
+            join_memory_mb = std::stoi(value);
+        } else if (key == "sort_memory_mb") {
+            sort_memory_mb = std::stoi(value);
+        } else if (key == "aggregate_memory_mb") {
+            aggregate_memory_mb = std::stoi(value);
+        } else if (key == "max_memory_mb") {
+            max_memory_mb = std::stoi(value);
+        } else if (key == "query_memory_mb") {
+            query_memory_mb = std::stoi(value);
+        } else if (key == "stream_batch_rows") {
+            stream_batch_rows = std::stoi(value);
+        } else if (key == "result_cache_mb") {
+            result_cache_mb = std::stoi(value);
+        } else if (key == "io_threads") {
+            io_threads = std::stoi(value);
+        } else if (key == "worker_threads") {
+            worker_threads = std::stoi(value);
+        } else if (key == "commit_delay_us") {
+            commit_delay_us = std::stoi(value);
+        } else if (key == "commit_group_size") {
+            commit_group_size = std::stoi(value);
+        } else if (key == "recovery_threads") {
+            recovery_threads = std::stoi(value);
+        } else if (key == "checkpoint_interval_s") {
+            checkpoint_interval_s = std::stoi(value);
+        } else if (key == "checkpoint_spread_pct") {
+            checkpoint_spread_pct = std::stoi(value);
+        } else if (key == "bgwriter_delay_ms") {
+            bgwriter_delay_ms = std::stoi(value);
+        } else if (key == "bgwriter_max_pages") {
+            bgwriter_max_pages = std::stoi(value);
+        } else if (key == "bgwriter_clean_pct") {
+            bgwriter_clean_pct = std::stoi(value);
+        } else if (key == "autovacuum_naptime_ms") {
+            autovacuum_naptime_ms = std::stoi(value);
+        } else if (key == "autovacuum_threshold") {
+            autovacuum_threshold = std::stoi(value);
+        } else if (key == "vacuum_cost_limit") {
+            vacuum_cost_limit = std::stoi(value);
+        } else if (key == "vacuum_cost_delay_ms") {
+            vacuum_cost_delay_ms = std::stoi(value);
+        } else if (key == "replica_naptime_ms") {
+            replica_naptime_ms = std::stoi(value);
+        } else if (key == "replica_max_lag_ms") {
+            replica_max_lag_ms = std::stoi(value);
+        } else if (key == "trace_sample_rate") {
+            trace_sample_rate = std::stod(value);
+        } else if (key == "trace_buffer_spans") {
+            trace_buffer_spans = std::stoi(value);
         } else if (key == "mode") {
             if (value == "distributed" || value == "coordinator") {
                 mode = RunMode::Coordinator;
@@ -103,10 +171,43 @@ bool Config::save(const std::string& filename) const {
 
     file << "port=" << port << "\n";
     file << "cluster_port=" << cluster_port << "\n";
+    file << "metrics_port=" << metrics_port << "\n";
     file << "data_dir=" << data_dir << "\n";
     file << "max_connections=" << max_connections << "\n";
     file << "buffer_pool_size=" << buffer_pool_size << "\n";
+    file << "buffer_replacer=" << buffer_replacer << "\n";
+    file << "buffer_huge_pages=" << (buffer_huge_pages ? "true" : "false") << "\n";
+    file << "buffer_numa=" << (buffer_numa ? "true" : "false") << "\n";
+    file << "io_backend=" << io_backend << "\n";
+    file << "direct_io=" << (direct_io ? "true" : "false") << "\n";
     file << "page_size=" << page_size << "\n";
+    file << "parallelism=" << parallelism << "\n";
+    file << "scan_workers=" << scan_workers << "\n";
+    file << "join_memory_mb=" << join_memory_mb << "\n";
+    file << "sort_memory_mb=" << sort_memory_mb << "\n";
+    file << "aggregate_memory_mb=" << aggregate_memory_mb << "\n";
+    file << "max_memory_mb=" << max_memory_mb << "\n";
+    file << "query_memory_mb=" << query_memory_mb << "\n";
+    file << "stream_batch_rows=" << stream_batch_rows << "\n";
+    file << "result_cache_mb=" << result_cache_mb << "\n";
+    file << "io_threads=" << io_threads << "\n";
+    file << "worker_threads=" << worker_threads << "\n";
+    file << "commit_delay_us=" << commit_delay_us << "\n";
+    file << "commit_group_size=" << commit_group_size << "\n";
+    file << "recovery_threads=" << recovery_threads << "\n";
+    file << "checkpoint_interval_s=" << checkpoint_interval_s << "\n";
+    file << "checkpoint_spread_pct=" << checkpoint_spread_pct << "\n";
+    file << "bgwriter_delay_ms=" << bgwriter_delay_ms << "\n";
+    file << "bgwriter_max_pages=" << bgwriter_max_pages << "\n";
+    file << "bgwriter_clean_pct=" << bgwriter_clean_pct << "\n";
+    file << "autovacuum_naptime_ms=" << autovacuum_naptime_ms << "\n";
+    file << "autovacuum_threshold=" << autovacuum_threshold << "\n";
+    file << "vacuum_cost_limit=" << vacuum_cost_limit << "\n";
+    file << "vacuum_cost_delay_ms=" << vacuum_cost_delay_ms << "\n";
+    file << "replica_naptime_ms=" << replica_naptime_ms << "\n";
+    file << "replica_max_lag_ms=" << replica_max_lag_ms << "\n";
+    file << "trace_sample_rate=" << trace_sample_rate << "\n";
+    file << "trace_buffer_spans=" << trace_buffer_spans << "\n";
 
     std::string mode_str = "standalone";
     if (mode == RunMode::Coordinator) {
@@ -147,9 +248,166 @@ bool Config::validate() const {
         return false;
     }
 
-    if (page_size < MIN_PAGE_SIZE || page_size > MAX_PAGE_SIZE) {
-        std::cerr << "Invalid page size: " << page_size << " (must be between " << MIN_PAGE_SIZE
-                  << " and " << MAX_PAGE_SIZE << ")\n";
+    if (buffer_replacer != "lru" && buffer_replacer != "clock" && buffer_replacer != "lru-k") {
+        std::cerr << "Invalid buffer replacer: " << buffer_replacer
+                  << " (must be lru, clock or lru-k)\n";
+        return false;
+    }
+
+    if (io_backend != "posix" && io_backend != "io_uring") {
+        std::cerr << "Invalid I/O backend: " << io_backend << " (must be posix or io_uring)\n";
+        return false;
+    }
+
+    if (page_size <= 0 || !storage::Page::valid_page_size(static_cast<uint32_t>(page_size))) {
+        std::cerr << "Invalid page size: " << page_size << " (must be a power of two between "
+                  << storage::Page::MIN_PAGE_SIZE << " and " << storage::Page::MAX_PAGE_SIZE
+                  << ")\n";
+        return false;
+    }
+
+    if (parallelism < 0) {
+        std::cerr << "Invalid parallelism: " << parallelism << " (0 means one per core)\n";
+        return false;
+    }
+
+    if (scan_workers < 0) {
+        std::cerr << "Invalid scan workers: " << scan_workers << " (0 means one per core)\n";
+        return false;
+    }
+
+    if (join_memory_mb < 0) {
+        std::cerr << "Invalid join memory: " << join_memory_mb << " MB (0 means never spill)\n";
+        return false;
+    }
+
+    if (sort_memory_mb < 0) {
+        std::cerr << "Invalid sort memory: " << sort_memory_mb << " MB (0 means never spill)\n";
+        return false;
+    }
+
+    if (aggregate_memory_mb < 0) {
+        std::cerr << "Invalid aggregate memory: " << aggregate_memory_mb
+                  << " MB (0 means never spill)\n";
+        return false;
+    }
+
+    if (max_memory_mb < 0) {
+        std::cerr << "Invalid max memory: " << max_memory_mb << " MB (0 means no limit)\n";
+        return false;
+    }
+
+    if (query_memory_mb < 0) {
+        std::cerr << "Invalid query memory: " << query_memory_mb << " MB (0 means no limit)\n";
+        return false;
+    }
+
+    if (stream_batch_rows < 0) {
+        std::cerr << "Invalid stream batch: " << stream_batch_rows
+                  << " rows (0 means buffer the whole result)\n";
+        return false;
+    }
+
+    if (result_cache_mb < 0) {
+        std::cerr << "Invalid result cache: " << result_cache_mb << " MB (0 means off)\n";
+        return false;
+    }
+
+    if (io_threads < 1) {
+        std::cerr << "Invalid I/O threads: " << io_threads << "\n";
+        return false;
+    }
+
+    if (worker_threads < 0) {
+        std::cerr << "Invalid worker threads: " << worker_threads << " (0 means one per core)\n";
+        return false;
+    }
+
+    if (commit_delay_us < 0) {
+        std::cerr << "Invalid commit delay: " << commit_delay_us << " us (0 means none)\n";
+        return false;
+    }
+
+    if (commit_group_size < 1) {
+        std::cerr << "Invalid commit group size: " << commit_group_size << "\n";
+        return false;
+    }
+
+    if (recovery_threads < 0) {
+        std::cerr << "Invalid recovery threads: " << recovery_threads
+                  << " (0 means one per core)\n";
+        return false;
+    }
+
+    if (checkpoint_interval_s < 0) {
+        std::cerr << "Invalid checkpoint interval: " << checkpoint_interval_s
+                  << " s (0 means never)\n";
+        return false;
+    }
+
+    if (checkpoint_spread_pct < 0 || checkpoint_spread_pct > 100) {
+        std::cerr << "Invalid checkpoint spread: " << checkpoint_spread_pct
+                  << "% (0 writes all pages at once)\n";
+        return false;
+    }
+
+    if (bgwriter_delay_ms < 0) {
+        std::cerr << "Invalid background writer delay: " << bgwriter_delay_ms
+                  << " ms (0 means off)\n";
+        return false;
+    }
+
+    if (bgwriter_max_pages < 1) {
+        std::cerr << "Invalid background writer page limit: " << bgwriter_max_pages << "\n";
+        return false;
+    }
+
+    if (bgwriter_clean_pct < 0 || bgwriter_clean_pct > 100) {
+        std::cerr << "Invalid background writer clean target: " << bgwriter_clean_pct << "%\n";
+        return false;
+    }
+
+    if (autovacuum_naptime_ms < 0) {
+        std::cerr << "Invalid autovacuum naptime: " << autovacuum_naptime_ms
+                  << " ms (0 means off)\n";
+        return false;
+    }
+
+    if (autovacuum_threshold < 1) {
+        std::cerr << "Invalid autovacuum threshold: " << autovacuum_threshold << "\n";
+        return false;
+    }
+
+    if (vacuum_cost_limit < 1) {
+        std::cerr << "Invalid vacuum cost limit: " << vacuum_cost_limit << "\n";
+        return false;
+    }
+
+    if (vacuum_cost_delay_ms < 0) {
+        std::cerr << "Invalid vacuum cost delay: " << vacuum_cost_delay_ms
+                  << " ms (0 means no pauses)\n";
+        return false;
+    }
+
+    if (replica_naptime_ms < 1) {
+        std::cerr << "Invalid columnar replica naptime: " << replica_naptime_ms << " ms\n";
+        return false;
+    }
+
+    if (replica_max_lag_ms < 0) {
+        std::cerr << "Invalid columnar replica lag: " << replica_max_lag_ms
+                  << " ms (0 means none)\n";
+        return false;
+    }
+
+    if (trace_sample_rate < 0 || trace_sample_rate > 1) {
+        std::cerr << "Invalid trace sample rate: " << trace_sample_rate
+                  << " (must be between 0 and 1)\n";
+        return false;
+    }
+
+    if (trace_buffer_spans < 1) {
+        std::cerr << "Invalid trace buffer size: " << trace_buffer_spans << " spans\n";
         return false;
     }
 
@@ -175,11 +433,79 @@ void Config::print() const {
     std::cout << "Mode:         " << mode_str << "\n";
     std::cout << "Port:         " << port << "\n";
     std::cout << "Cluster Port: " << cluster_port << "\n";
+    std::cout << "Metrics Port: " << (metrics_port == 0 ? "off" : std::to_string(metrics_port))
+              << "\n";
     std::cout << "Data dir:     " << data_dir << "\n";
     std::cout << "Seed Nodes:   " << seed_nodes << "\n";
     std::cout << "Max conns:    " << max_connections << "\n";
-    std::cout << "Buffer pool:  " << buffer_pool_size << " pages\n";
+    std::cout << "Buffer pool:  " << buffer_pool_size << " pages (" << buffer_replacer
+              << (buffer_huge_pages ? ", huge pages" : "") << (buffer_numa ? ", per NUMA node" : "")
+              << ")\n";
+    std::cout << "I/O backend:  " << io_backend << (direct_io ? " (O_DIRECT)" : "") << "\n";
     std::cout << "Page size:    " << page_size << " bytes\n";
+    std::cout << "Parallelism:  " << (parallelism == 0 ? "all cores" : std::to_string(parallelism))
+              << "\n";
+    std::cout << "Scan workers: "
+              << (scan_workers == 0 ? "all cores" : std::to_string(scan_workers)) << "\n";
+    std::cout << "Join memory:  "
+              << (join_memory_mb == 0 ? "unlimited" : std::to_string(join_memory_mb) + " MB")
+              << "\n";
+    std::cout << "Sort memory:  "
+              << (sort_memory_mb == 0 ? "unlimited" : std::to_string(sort_memory_mb) + " MB")
+              << "\n";
+    std::cout << "Agg memory:   "
+              << (aggregate_memory_mb == 0 ? "unlimited"
+                                           : std::to_string(aggregate_memory_mb) + " MB")
+              << "\n";
+    std::cout << "Max memory:   "
+              << (max_memory_mb == 0 ? "unlimited" : std::to_string(max_memory_mb) + " MB")
+              << "\n";
+    std::cout << "Query memory: "
+              << (query_memory_mb == 0 ? "unlimited" : std::to_string(query_memory_mb) + " MB")
+              << "\n";
+    std::cout << "Stream batch: "
+              << (stream_batch_rows == 0 ? "whole result"
+                                         : std::to_string(stream_batch_rows) + " rows")
+              << "\n";
+    std::cout << "Result cache: "
+              << (result_cache_mb == 0 ? "off" : std::to_string(result_cache_mb) + " MB") << "\n";
+    std::cout << "I/O threads:  " << io_threads << "\n";
+    std::cout << "Workers:      "
+              << (worker_threads == 0 ? "one per core" : std::to_string(worker_threads)) << "\n";
+    std::cout << "Group commit: " << commit_delay_us << " us delay, groups of "
+              << commit_group_size << "\n";
+    std::cout << "Recovery:     "
+              << (recovery_threads == 0 ? "one worker per core"
+                                        : std::to_string(recovery_threads) + " workers")
+              << ", checkpoint "
+              << (checkpoint_interval_s == 0 ? "never"
+                                             : "every " + std::to_string(checkpoint_interval_s) +
+                                                   " s, writes spread over " +
+                                                   std::to_string(checkpoint_spread_pct) + "%")
+              << "\n";
+    std::cout << "BG writer:    "
+              << (bgwriter_delay_ms == 0
+                      ? "off"
+                      : "every " + std::to_string(bgwriter_delay_ms) + " ms, up to " +
+                            std::to_string(bgwriter_max_pages) + " pages, " +
+                            std::to_string(bgwriter_clean_pct) + "% kept clean")
+              << "\n";
+    std::cout << "Autovacuum:   "
+              << (autovacuum_naptime_ms == 0
+                      ? "off"
+                      : "every " + std::to_string(autovacuum_naptime_ms) + " ms, at " +
+                            std::to_string(autovacuum_threshold) + " dead rows, " +
+                            std::to_string(vacuum_cost_delay_ms) + " ms pause per " +
+                            std::to_string(vacuum_cost_limit) + " pages")
+              << "\n";
+    std::cout << "Replicas:     WAL read every " << replica_naptime_ms << " ms, reads at most "
+              << replica_max_lag_ms << " ms behind\n";
+    std::cout << "Tracing:      "
+              << (trace_sample_rate == 0
+                      ? "off"
+                      : std::to_string(trace_sample_rate * 100) + "% of statements, " +
+                            std::to_string(trace_buffer_spans) + " spans kept")
+              << "\n";
     std::cout << "Debug:        " << (debug ? "enabled" : "disabled") << "\n";
     std::cout << "Verbose:      " << (verbose ? "enabled" : "disabled") << "\n";
     std::cout << "================================\n";
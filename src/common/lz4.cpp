@@ -0,0 +1,153 @@
+/**
+ * @file lz4.cpp
+ * @brief LZ4 block compression
+ */
+
+#include "common/lz4.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace cloudsql::common::lz4 {
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t LAST_LITERALS = 5; /* A block always ends with this many literals */
+constexpr size_t MATCH_LIMIT = 12;  /* The last match starts at least this far from the end */
+constexpr size_t MAX_OFFSET = 65535;
+constexpr unsigned HASH_BITS = 12;
+constexpr uint32_t NO_POSITION = UINT32_MAX;
+
+uint32_t read32(const uint8_t* p) {
+    uint32_t v = 0;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t hash(uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32U - HASH_BITS);
+}
+
+/** @brief Writes the 255-byte continuation of a length whose nibble was saturated */
+void put_length(size_t length, std::vector<uint8_t>& out) {
+    for (; length >= 255; length -= 255) {
+        out.push_back(255);
+    }
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+void put_sequence(const uint8_t* literals, size_t literal_len, size_t offset, size_t match_len,
+                  std::vector<uint8_t>& out) {
+    const size_t match_code = match_len == 0 ? 0 : match_len - MIN_MATCH;
+    const auto lit_nibble = static_cast<uint8_t>(literal_len < 15 ? literal_len : 15);
+    const auto match_nibble = static_cast<uint8_t>(match_code < 15 ? match_code : 15);
+    out.push_back(static_cast<uint8_t>((lit_nibble << 4U) | match_nibble));
+    if (literal_len >= 15) {
+        put_length(literal_len - 15, out);
+    }
+    out.insert(out.end(), literals, literals + literal_len);
+    if (match_len == 0) {
+        return; /* Final, literals-only sequence */
+    }
+    out.push_back(static_cast<uint8_t>(offset & 0xFFU));
+    out.push_back(static_cast<uint8_t>(offset >> 8U));
+    if (match_code >= 15) {
+        put_length(match_code - 15, out);
+    }
+}
+
+/** @brief Reads the continuation of a saturated length nibble; false if the input ends */
+bool get_length(const uint8_t* data, size_t size, size_t& pos, size_t& length) {
+    uint8_t b = 0;
+    do {
+        if (pos >= size) {
+            return false;
+        }
+        b = data[pos++];
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+}  // namespace
+
+void compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    out.reserve(out.size() + max_compressed_size(size));
+    size_t anchor = 0;
+    if (size > MATCH_LIMIT) {
+        std::array<uint32_t, 1U << HASH_BITS> table;
+        table.fill(NO_POSITION);
+        size_t pos = 0;
+        while (pos < size - MATCH_LIMIT) {
+            const uint32_t sequence = read32(data + pos);
+            const uint32_t h = hash(sequence);
+            const uint32_t candidate = table[h];
+            table[h] = static_cast<uint32_t>(pos);
+            if (candidate == NO_POSITION || pos - candidate > MAX_OFFSET ||
+                read32(data + candidate) != sequence) {
+                ++pos;
+                continue;
+            }
+            size_t match_len = MIN_MATCH;
+            while (pos + match_len < size - LAST_LITERALS &&
+                   data[candidate + match_len] == data[pos + match_len]) {
+                ++match_len;
+            }
+            put_sequence(data + anchor, pos - anchor, pos - candidate, match_len, out);
+            pos += match_len;
+            anchor = pos;
+        }
+    }
+    put_sequence(data + anchor, size - anchor, 0, 0, out);
+}
+
+bool decompress(const uint8_t* data, size_t size, uint8_t* out, size_t out_size) {
+    size_t in = 0;
+    size_t written = 0;
+    while (in < size) {
+        const uint8_t token = data[in++];
+        size_t literal_len = token >> 4U;
+        if (literal_len == 15 && !get_length(data, size, in, literal_len)) {
+            return false;
+        }
+        if (literal_len > size - in || literal_len > out_size - written) {
+            return false;
+        }
+        std::memcpy(out + written, data + in, literal_len);
+        in += literal_len;
+        written += literal_len;
+        if (in == size) {
+            break; /* The last sequence has no match */
+        }
+
+        if (size - in < 2) {
+            return false;
+        }
+        const size_t offset = data[in] | (static_cast<size_t>(data[in + 1]) << 8U);
+        in += 2;
+        if (offset == 0 || offset > written) {
+            return false;
+        }
+        size_t match_len = token & 0x0FU;
+        if (match_len == 15 && !get_length(data, size, in, match_len)) {
+            return false;
+        }
+        match_len += MIN_MATCH;
+        if (match_len > out_size - written) {
+            return false;
+        }
+        /* Byte by byte: a match may overlap the bytes it is producing */
+        const uint8_t* from = out + written - offset;
+        for (size_t i = 0; i < match_len; ++i) {
+            out[written + i] = from[i];
+        }
+        written += match_len;
+    }
+    return written == out_size;
+}
+
+}  // namespace cloudsql::common::lz4
@@ -0,0 +1,130 @@
+/**
+ * @file memory_tracker.cpp
+ * @brief Hierarchical memory accounting implementation
+ */
+
+#include "common/memory_tracker.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace cloudsql::common {
+
+namespace {
+
+thread_local MemoryTracker* current_tracker = nullptr;
+
+constexpr size_t MIB = static_cast<size_t>(1024) * 1024;
+
+std::string format_bytes(size_t bytes) {
+    if (bytes >= MIB && bytes % MIB == 0) {
+        return std::to_string(bytes / MIB) + " MB";
+    }
+    return std::to_string(bytes) + " bytes";
+}
+
+}  // namespace
+
+MemoryTracker::Scope::Scope(MemoryTracker* tracker) : previous_(current_tracker) {
+    current_tracker = tracker;
+}
+
+MemoryTracker::Scope::~Scope() {
+    current_tracker = previous_;
+}
+
+MemoryTracker::MemoryTracker(std::string label, size_t limit, MemoryTracker* parent)
+    : label_(std::move(label)), parent_(parent), limit_(limit) {}
+
+MemoryTracker::~MemoryTracker() {
+    const size_t held = consumed();
+    if (held != 0 && parent_ != nullptr) {
+        parent_->release(held);
+    }
+}
+
+MemoryTracker& MemoryTracker::global() {
+    static MemoryTracker instance("process");
+    return instance;
+}
+
+MemoryTracker* MemoryTracker::current() {
+    return current_tracker;
+}
+
+std::unique_ptr<MemoryTracker> MemoryTracker::make_child(std::string label) {
+    MemoryTracker* const parent = current();
+    if (parent == nullptr) {
+        return nullptr;
+    }
+    return std::make_unique<MemoryTracker>(std::move(label), 0, parent);
+}
+
+bool MemoryTracker::try_consume(size_t bytes, const MemoryTracker** refused) {
+    if (bytes == 0) {
+        return true;
+    }
+    for (MemoryTracker* level = this; level != nullptr; level = level->parent_) {
+        const size_t consumed = level->consumed_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        const size_t limit = level->limit();
+        if (limit != 0 && consumed > limit) {
+            /* Undo this level and every one below it */
+            for (MemoryTracker* undo = this; undo != level->parent_; undo = undo->parent_) {
+                undo->consumed_.fetch_sub(bytes, std::memory_order_relaxed);
+            }
+            level->refusals_.fetch_add(1, std::memory_order_relaxed);
+            if (refused != nullptr) {
+                *refused = level;
+            }
+            return false;
+        }
+        level->raise_peak(consumed);
+    }
+    return true;
+}
+
+void MemoryTracker::consume(size_t bytes) {
+    for (MemoryTracker* level = this; level != nullptr; level = level->parent_) {
+        level->raise_peak(level->consumed_.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    }
+}
+
+void MemoryTracker::release(size_t bytes) {
+    for (MemoryTracker* level = this; level != nullptr; level = level->parent_) {
+        level->consumed_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+}
+
+bool MemoryTracker::try_resize(size_t bytes, const MemoryTracker** refused) {
+    const size_t held = consumed();
+    if (bytes <= held) {
+        release(held - bytes);
+        return true;
+    }
+    return try_consume(bytes - held, refused);
+}
+
+void MemoryTracker::resize(size_t bytes, const std::string& consumer) {
+    const MemoryTracker* refused = nullptr;
+    if (!try_resize(bytes, &refused)) {
+        throw MemoryLimitError(limit_message(*refused, consumer));
+    }
+}
+
+std::string MemoryTracker::limit_message(const MemoryTracker& refused,
+                                         const std::string& consumer) {
+    return "out of memory: " + consumer + " would exceed the " + refused.label() +
+           " memory limit of " + format_bytes(refused.limit());
+}
+
+void MemoryTracker::raise_peak(size_t consumed) {
+    size_t peak = peak_.load(std::memory_order_relaxed);
+    while (consumed > peak &&
+           !peak_.compare_exchange_weak(peak, consumed, std::memory_order_relaxed)) {
+    }
+}
+
+}  // namespace cloudsql::common
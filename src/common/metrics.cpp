@@ -0,0 +1,276 @@
+/**
+ * @file metrics.cpp
+ * @brief Metrics registry and Prometheus text rendering
+ */
+
+#include "common/metrics.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/latency_histogram.hpp"
+
+namespace cloudsql::common {
+
+namespace {
+
+constexpr double US_PER_SECOND = 1e6;
+constexpr double MAX_EXACT_INTEGER = 9007199254740992.0; /* 2^53 */
+
+std::string format_value(double value) {
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    std::array<char, 32> buf{};
+    if (value == std::floor(value) && std::fabs(value) < MAX_EXACT_INTEGER) {
+        static_cast<void>(
+            std::snprintf(buf.data(), buf.size(), "%lld", static_cast<long long>(value)));
+    } else {
+        static_cast<void>(std::snprintf(buf.data(), buf.size(), "%.9g", value));
+    }
+    return buf.data();
+}
+
+const char* type_name(MetricType type) {
+    switch (type) {
+        case MetricType::Counter:
+            return "counter";
+        case MetricType::Gauge:
+            return "gauge";
+        case MetricType::Histogram:
+            return "histogram";
+    }
+    return "untyped";
+}
+
+/** @return `name{labels}`, joining `extra` onto the series' own labels */
+std::string series_name(const std::string& name, const std::string& labels,
+                        const std::string& extra = "") {
+    std::string joined = labels;
+    if (!extra.empty()) {
+        joined += (joined.empty() ? "" : ",") + extra;
+    }
+    return joined.empty() ? name : name + "{" + joined + "}";
+}
+
+/** @return Upper bound, in microseconds, of the bucket holding the pct-th percentile */
+double bucket_percentile(const std::array<uint64_t, LatencyHistogram::NUM_BUCKETS>& buckets,
+                         uint64_t count, double pct) {
+    if (count == 0) {
+        return 0;
+    }
+    const auto target = static_cast<uint64_t>(static_cast<double>(count) * pct);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen > target || seen == count) {
+            return static_cast<double>(LatencyHistogram::bucket_upper_bound(i));
+        }
+    }
+    return static_cast<double>(LatencyHistogram::bucket_upper_bound(buckets.size() - 1));
+}
+
+}  // namespace
+
+std::string metric_label(const std::string& key, const std::string& value) {
+    std::string out = key + "=\"";
+    for (const char c : value) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+MetricsSnapshot::Series& MetricsSnapshot::series(const std::string& name, const std::string& help,
+                                                 MetricType type, const std::string& labels) {
+    Family& family = families_[name];
+    if (family.series.empty()) {
+        family.help = help;
+        family.type = type;
+    }
+    return family.series[labels];
+}
+
+void MetricsSnapshot::add_counter(const std::string& name, const std::string& help, double value,
+                                  const std::string& labels) {
+    series(name, help, MetricType::Counter, labels).value += value;
+}
+
+void MetricsSnapshot::add_gauge(const std::string& name, const std::string& help, double value,
+                                const std::string& labels) {
+    series(name, help, MetricType::Gauge, labels).value += value;
+}
+
+void MetricsSnapshot::add_histogram(const std::string& name, const std::string& help,
+                                    const LatencyHistogram& histogram,
+                                    const std::string& labels) {
+    Series& s = series(name, help, MetricType::Histogram, labels);
+    for (size_t i = 0; i < LatencyHistogram::NUM_BUCKETS; ++i) {
+        s.buckets[i] += histogram.bucket_count(i);
+    }
+    s.count += histogram.count();
+    s.sum_us += histogram.sum();
+}
+
+std::string MetricsSnapshot::to_prometheus() const {
+    std::string out;
+    for (const auto& [name, family] : families_) {
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name + " " + type_name(family.type) + "\n";
+        for (const auto& [labels, s] : family.series) {
+            if (family.type != MetricType::Histogram) {
+                out += series_name(name, labels) + " " + format_value(s.value) + "\n";
+                continue;
+            }
+            /* Buckets are cumulative; the last one is open-ended */
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < s.buckets.size(); ++i) {
+                cumulative += s.buckets[i];
+                const std::string le =
+                    i + 1 == s.buckets.size()
+                        ? "+Inf"
+                        : format_value(static_cast<double>(LatencyHistogram::bucket_upper_bound(i)) /
+                                       US_PER_SECOND);
+                out += series_name(name + "_bucket", labels, "le=\"" + le + "\"") + " " +
+                       std::to_string(cumulative) + "\n";
+            }
+            out += series_name(name + "_sum", labels) + " " +
+                   format_value(static_cast<double>(s.sum_us) / US_PER_SECOND) + "\n";
+            out += series_name(name + "_count", labels) + " " + std::to_string(s.count) + "\n";
+        }
+    }
+    return out;
+}
+
+std::vector<MetricsSnapshot::Row> MetricsSnapshot::rows() const {
+    std::vector<Row> out;
+    for (const auto& [name, family] : families_) {
+        for (const auto& [labels, s] : family.series) {
+            if (family.type != MetricType::Histogram) {
+                out.push_back({name, labels, family.type, s.value});
+                continue;
+            }
+            const auto with = [&labels](const std::string& extra) {
+                return labels.empty() ? extra : labels + "," + extra;
+            };
+            out.push_back({name + "_count", labels, family.type, static_cast<double>(s.count)});
+            out.push_back({name + "_sum", labels, family.type,
+                           static_cast<double>(s.sum_us) / US_PER_SECOND});
+            for (const double q : {0.5, 0.99}) {
+                out.push_back({name, with(metric_label("quantile", format_value(q))), family.type,
+                               bucket_percentile(s.buckets, s.count, q) / US_PER_SECOND});
+            }
+        }
+    }
+    return out;
+}
+
+void MetricsRegistry::Registration::reset() {
+    if (registry_ != nullptr) {
+        registry_->remove_collector(id_);
+        registry_ = nullptr;
+    }
+}
+
+MetricsRegistry& MetricsRegistry::global() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::Owned& MetricsRegistry::find_or_add(const std::string& name,
+                                                     const std::string& help, MetricType type,
+                                                     const std::string& labels) {
+    const std::scoped_lock<std::mutex> lock(metrics_latch_);
+    auto [it, inserted] = owned_.try_emplace({name, labels});
+    Owned& metric = it->second;
+    if (inserted) {
+        metric.name = name;
+        metric.labels = labels;
+        metric.help = help;
+        metric.type = type;
+        switch (type) {
+            case MetricType::Counter:
+                metric.counter = std::make_unique<Counter>();
+                break;
+            case MetricType::Gauge:
+                metric.gauge = std::make_unique<Gauge>();
+                break;
+            case MetricType::Histogram:
+                metric.histogram = std::make_unique<LatencyHistogram>();
+                break;
+        }
+    }
+    return metric;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help,
+                                  const std::string& labels) {
+    return *find_or_add(name, help, MetricType::Counter, labels).counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help,
+                              const std::string& labels) {
+    return *find_or_add(name, help, MetricType::Gauge, labels).gauge;
+}
+
+LatencyHistogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                             const std::string& labels) {
+    return *find_or_add(name, help, MetricType::Histogram, labels).histogram;
+}
+
+MetricsRegistry::Registration MetricsRegistry::add_collector(Collector collector) {
+    const std::scoped_lock<std::mutex> lock(collectors_latch_);
+    const uint64_t id = next_collector_++;
+    collectors_.emplace(id, std::move(collector));
+    return Registration(this, id);
+}
+
+void MetricsRegistry::remove_collector(uint64_t id) {
+    const std::scoped_lock<std::mutex> lock(collectors_latch_);
+    collectors_.erase(id);
+}
+
+MetricsSnapshot MetricsRegistry::collect() const {
+    MetricsSnapshot snapshot;
+    {
+        const std::scoped_lock<std::mutex> lock(metrics_latch_);
+        for (const auto& [key, metric] : owned_) {
+            switch (metric.type) {
+                case MetricType::Counter:
+                    snapshot.add_counter(metric.name, metric.help,
+                                         static_cast<double>(metric.counter->value()),
+                                         metric.labels);
+                    break;
+                case MetricType::Gauge:
+                    snapshot.add_gauge(metric.name, metric.help,
+                                       static_cast<double>(metric.gauge->value()), metric.labels);
+                    break;
+                case MetricType::Histogram:
+                    snapshot.add_histogram(metric.name, metric.help, *metric.histogram,
+                                           metric.labels);
+                    break;
+            }
+        }
+    }
+    const std::scoped_lock<std::mutex> lock(collectors_latch_);
+    for (const auto& [id, collector] : collectors_) {
+        collector(snapshot);
+    }
+    return snapshot;
+}
+
+}  // namespace cloudsql::common
@@ -0,0 +1,262 @@
+/**
+ * @file trace.cpp
+ * @brief Span recording and OTLP/JSON export
+ */
+
+#include "common/trace.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cloudsql::common {
+
+namespace {
+
+thread_local TraceContext current_context;
+
+std::mt19937_64& thread_rng() {
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+    return rng;
+}
+
+void append_json_string(const std::string& s, std::string& out) {
+    out += '"';
+    for (const char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            std::array<char, 8> buf{};
+            static_cast<void>(std::snprintf(buf.data(), buf.size(), "\\u%04x", c));
+            out += buf.data();
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+void append_attribute(const std::string& key, const std::string& value, std::string& out) {
+    out += "{\"key\":";
+    append_json_string(key, out);
+    out += ",\"value\":{\"stringValue\":";
+    append_json_string(value, out);
+    out += "}}";
+}
+
+}  // namespace
+
+std::string SpanRecord::attributes_text() const {
+    std::string out;
+    for (const auto& [key, value] : attributes) {
+        if (!out.empty()) {
+            out += ", ";
+        }
+        out += key + "=" + value;
+    }
+    return out;
+}
+
+Tracer& Tracer::global() {
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::set_sample_rate(double rate) {
+    sample_rate_.store(rate < 0 ? 0 : (rate > 1 ? 1 : rate), std::memory_order_relaxed);
+}
+
+void Tracer::set_capacity(size_t capacity) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    ring_.assign(capacity == 0 ? 1 : capacity, SpanRecord{});
+    next_ = 0;
+    wrapped_ = false;
+}
+
+size_t Tracer::capacity() const {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    return ring_.size();
+}
+
+void Tracer::set_node(const std::string& node) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    node_ = node;
+}
+
+TraceContext Tracer::start_trace() const {
+    const double rate = sample_rate();
+    if (rate <= 0) {
+        return {};
+    }
+    /* 53 random bits as a fraction in [0, 1) */
+    constexpr double FRACTION_SCALE = 1.0 / static_cast<double>(1ULL << 53);
+    if (rate < 1 && static_cast<double>(thread_rng()() >> 11) * FRACTION_SCALE >= rate) {
+        return {};
+    }
+    return {new_id(), 0};
+}
+
+void Tracer::record(SpanRecord span) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    if (span.node.empty()) {
+        span.node = node_;
+    }
+    ring_[next_] = std::move(span);
+    if (++next_ == ring_.size()) {
+        next_ = 0;
+        wrapped_ = true;
+    }
+}
+
+std::vector<SpanRecord> Tracer::spans() const {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    std::vector<SpanRecord> out;
+    if (wrapped_) {
+        out.insert(out.end(), ring_.begin() + static_cast<std::ptrdiff_t>(next_), ring_.end());
+    }
+    out.insert(out.end(), ring_.begin(), ring_.begin() + static_cast<std::ptrdiff_t>(next_));
+    return out;
+}
+
+void Tracer::clear() {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    ring_.assign(ring_.size(), SpanRecord{});
+    next_ = 0;
+    wrapped_ = false;
+}
+
+std::string Tracer::to_otlp_json() const {
+    /* One resource per node; OTLP ids are hex, trace ids 128 bits wide */
+    std::map<std::string, std::vector<SpanRecord>> by_node;
+    for (auto& span : spans()) {
+        by_node[span.node].push_back(std::move(span));
+    }
+
+    constexpr uint64_t NS_PER_US = 1000;
+    constexpr int SPAN_KIND_INTERNAL = 1;
+    std::string out = "{\"resourceSpans\":[";
+    bool first_resource = true;
+    for (const auto& [node, spans] : by_node) {
+        out += first_resource ? "" : ",";
+        first_resource = false;
+        out += "{\"resource\":{\"attributes\":[";
+        append_attribute("service.name", "cloudsql", out);
+        out += ",";
+        append_attribute("service.instance.id", node, out);
+        out += "]},\"scopeSpans\":[{\"scope\":{\"name\":\"cloudsql\"},\"spans\":[";
+        for (size_t i = 0; i < spans.size(); ++i) {
+            const SpanRecord& span = spans[i];
+            const auto start_ns = static_cast<uint64_t>(span.start_us) * NS_PER_US;
+            out += i == 0 ? "{" : ",{";
+            out += "\"traceId\":\"" + std::string(16, '0') + id_hex(span.trace_id) + "\"";
+            out += ",\"spanId\":\"" + id_hex(span.span_id) + "\"";
+            if (span.parent_id != 0) {
+                out += ",\"parentSpanId\":\"" + id_hex(span.parent_id) + "\"";
+            }
+            out += ",\"name\":";
+            append_json_string(span.name, out);
+            out += ",\"kind\":" + std::to_string(SPAN_KIND_INTERNAL);
+            out += ",\"startTimeUnixNano\":\"" + std::to_string(start_ns) + "\"";
+            out += ",\"endTimeUnixNano\":\"" +
+                   std::to_string(start_ns + span.duration_us * NS_PER_US) + "\"";
+            out += ",\"attributes\":[";
+            for (size_t a = 0; a < span.attributes.size(); ++a) {
+                out += a == 0 ? "" : ",";
+                append_attribute(span.attributes[a].first, span.attributes[a].second, out);
+            }
+            out += "]}";
+        }
+        out += "]}]}";
+    }
+    out += "]}";
+    return out;
+}
+
+TraceContext Tracer::current() {
+    return current_context;
+}
+
+uint64_t Tracer::new_id() {
+    uint64_t id = 0;
+    while (id == 0) {
+        id = thread_rng()();
+    }
+    return id;
+}
+
+int64_t Tracer::wall_clock_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+std::string Tracer::id_hex(uint64_t id) {
+    std::array<char, 17> buf{};
+    static_cast<void>(std::snprintf(buf.data(), buf.size(), "%016llx",
+                                    static_cast<unsigned long long>(id)));
+    return buf.data();
+}
+
+TraceScope::TraceScope(TraceContext context) : saved_(current_context) {
+    current_context = context;
+}
+
+TraceScope::~TraceScope() {
+    current_context = saved_;
+}
+
+Span::Span(const char* name, Start start) {
+    TraceContext parent = current_context;
+    if (!parent.traced() && start == Start::RootIfSampled) {
+        parent = Tracer::global().start_trace();
+    }
+    begin(name, parent);
+}
+
+Span::Span(const char* name, TraceContext parent) {
+    begin(name, parent);
+}
+
+void Span::begin(const char* name, TraceContext parent) {
+    if (!parent.traced()) {
+        return;
+    }
+    record_.trace_id = parent.trace_id;
+    record_.parent_id = parent.span_id;
+    record_.span_id = Tracer::new_id();
+    record_.name = name;
+    record_.start_us = Tracer::wall_clock_us();
+    started_ = std::chrono::steady_clock::now();
+    saved_ = current_context;
+    current_context = context();
+}
+
+void Span::set_attribute(const std::string& key, const std::string& value) {
+    if (active()) {
+        record_.attributes.emplace_back(key, value);
+    }
+}
+
+void Span::end() {
+    if (!active()) {
+        return;
+    }
+    record_.duration_us = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                              started_)
+            .count());
+    current_context = saved_;
+    Tracer::global().record(std::move(record_));
+    record_ = SpanRecord{};
+}
+
+}  // namespace cloudsql::common
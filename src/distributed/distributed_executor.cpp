@@ -6,17 +6,34 @@
 #include "distributed/distributed_executor.hpp"
 
 #include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
 #include <future>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <string>
-#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "catalog/catalog.hpp"
 #include "common/cluster_manager.hpp"
+#include "common/trace.hpp"
 #include "common/value.hpp"
+#include "distributed/ordered_merge.hpp"
+#include "distributed/partial_aggregation.hpp"
 #include "distributed/shard_manager.hpp"
+#include "executor/compiled_expression.hpp"
+#include "executor/explain.hpp"
 #include "network/rpc_client.hpp"
 #include "network/rpc_message.hpp"
 #include "parser/expression.hpp"
@@ -27,40 +44,304 @@ namespace cloudsql::executor {
 namespace {
 
 /**
- * @brief Simple helper to extract sharding key from WHERE clause
- * Currently handles only "id = constant" format for POC
+ * @brief Where rows live, by the value of their shard key
+ *
+ * A shard is an index into the data nodes sorted by id. With a ring in the
+ * catalog the key's owner on the ring holds it; without one, the key hash
+ * modulo the node count does.
  */
-bool try_extract_sharding_key(const parser::Expression* where, common::Value& out_val) {
-    if (where == nullptr || where->type() != parser::ExprType::Binary) {
-        return false;
+class Placement {
+   public:
+    Placement(const ShardRing& ring, const std::vector<cluster::NodeInfo>& data_nodes)
+        : ring_(ring), shards_(static_cast<uint32_t>(data_nodes.size())) {
+        for (uint32_t i = 0; i < shards_; ++i) {
+            index_.emplace(data_nodes[i].id, i);
+        }
     }
 
-    const auto* bin_expr = dynamic_cast<const parser::BinaryExpr*>(where);
-    if (bin_expr == nullptr || bin_expr->op() != parser::TokenType::Eq) {
-        return false;
+    /** @return The shard a row with `key` is written to; nullopt if its owner is not a data node */
+    [[nodiscard]] std::optional<uint32_t> shard_of(const common::Value& key) const {
+        if (ring_.empty()) {
+            return cluster::ShardManager::compute_shard(key, shards_);
+        }
+        const auto it = index_.find(cluster::ShardManager::owner(ring_, key));
+        if (it == index_.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    /**
+     * @brief Adds the shard holding rows with `key`
+     * @return false if they may be on any shard: rows are being moved, or the owner is gone
+     */
+    [[nodiscard]] bool find(const common::Value& key, std::set<uint32_t>& out) const {
+        if (ring_.migrating) {
+            return false;
+        }
+        const auto shard = shard_of(key);
+        if (!shard) {
+            return false;
+        }
+        out.insert(*shard);
+        return true;
+    }
+
+   private:
+    const ShardRing& ring_;
+    uint32_t shards_;
+    std::unordered_map<std::string, uint32_t> index_;
+};
+
+/** Rows per INSERT and DELETE when rebalance() moves rows between nodes */
+constexpr size_t MOVE_BATCH_ROWS = 1024;
+
+/** @brief `value` as a SQL literal, written as the parser reads it back */
+std::string sql_literal(const common::Value& value) {
+    return parser::ConstantExpr(value).to_string();
+}
+
+/** @return An INSERT of `rows[begin, end)` into `table` */
+std::string insert_sql(const std::string& table, const std::vector<const executor::Tuple*>& rows,
+                       size_t begin, size_t end) {
+    std::string sql = "INSERT INTO " + table + " VALUES ";
+    for (size_t r = begin; r < end; ++r) {
+        const auto& row = *rows[r];
+        sql += r == begin ? "(" : ", (";
+        for (size_t c = 0; c < row.size(); ++c) {
+            sql += (c == 0 ? "" : ", ") + sql_literal(row.get(c));
+        }
+        sql += ")";
+    }
+    return sql;
+}
+
+/** Widest integer range on the shard key that is pruned value by value */
+constexpr int64_t MAX_PRUNED_RANGE = 64;
+
+/** Shards a WHERE clause can match rows on; nullopt when it may match on any */
+using ShardSet = std::optional<std::set<uint32_t>>;
+
+/**
+ * @brief Maps a WHERE clause to the shards holding the rows it can match
+ *
+ * Rows live on the shard of their first column (see the INSERT routing), so
+ * only conditions on that column prune: equality, IN lists and, for integer
+ * keys, closed ranges narrow enough to enumerate. AND intersects and OR
+ * unites; anything else may match on every shard.
+ */
+class ShardPruner {
+   public:
+    ShardPruner(std::string key, bool integer_key, const Placement& placement)
+        : key_(std::move(key)), integer_key_(integer_key), placement_(placement) {}
+
+    [[nodiscard]] ShardSet prune(const parser::Expression& expr) const {
+        if (expr.type() == parser::ExprType::In) {
+            const auto& in = static_cast<const parser::InExpr&>(expr);
+            if (in.not_flag() || !is_key(in.column())) {
+                return std::nullopt;
+            }
+            std::set<uint32_t> out;
+            for (const auto& value : in.values()) {
+                const auto* constant = constant_of(*value);
+                if (constant == nullptr || !add(*constant, out)) {
+                    return std::nullopt;
+                }
+            }
+            return out;
+        }
+        if (expr.type() != parser::ExprType::Binary) {
+            return std::nullopt;
+        }
+        const auto& bin = static_cast<const parser::BinaryExpr&>(expr);
+        switch (bin.op()) {
+            case parser::TokenType::And:
+                return prune_conjunction(bin);
+            case parser::TokenType::Or: {
+                auto left = prune(bin.left());
+                const auto right = prune(bin.right());
+                if (!left || !right) {
+                    return std::nullopt;
+                }
+                left->insert(right->begin(), right->end());
+                return left;
+            }
+            case parser::TokenType::Eq: {
+                const common::Value* constant = nullptr;
+                if (is_key(bin.left())) {
+                    constant = constant_of(bin.right());
+                } else if (is_key(bin.right())) {
+                    constant = constant_of(bin.left());
+                }
+                std::set<uint32_t> out;
+                if (constant == nullptr || !add(*constant, out)) {
+                    return std::nullopt;
+                }
+                return out;
+            }
+            default:
+                return std::nullopt;
+        }
+    }
+
+   private:
+    struct Bounds {
+        std::optional<int64_t> low;
+        std::optional<int64_t> high;
+    };
+
+    [[nodiscard]] bool is_key(const parser::Expression& expr) const {
+        return expr.type() == parser::ExprType::Column &&
+               static_cast<const parser::ColumnExpr&>(expr).name() == key_;
+    }
+
+    static const common::Value* constant_of(const parser::Expression& expr) {
+        if (expr.type() != parser::ExprType::Constant) {
+            return nullptr;
+        }
+        return &static_cast<const parser::ConstantExpr&>(expr).value();
+    }
+
+    static bool is_integer(const common::Value& value) {
+        const auto type = value.type();
+        return type == common::ValueType::TYPE_INT8 || type == common::ValueType::TYPE_INT16 ||
+               type == common::ValueType::TYPE_INT32 || type == common::ValueType::TYPE_INT64;
+    }
+
+    /**
+     * @brief Adds the shard of `value`; NULL equals nothing and adds none
+     * @return false if rows equal to `value` may be on any shard
+     */
+    [[nodiscard]] bool add(const common::Value& value, std::set<uint32_t>& out) const {
+        return value.is_null() || placement_.find(value, out);
+    }
+
+    static void intersect(ShardSet& acc, const ShardSet& other) {
+        if (!other) {
+            return;
+        }
+        if (!acc) {
+            acc = other;
+            return;
+        }
+        std::set<uint32_t> both;
+        std::set_intersection(acc->begin(), acc->end(), other->begin(), other->end(),
+                              std::inserter(both, both.begin()));
+        acc = std::move(both);
+    }
+
+    static void conjuncts(const parser::Expression& expr,
+                          std::vector<const parser::Expression*>& out) {
+        if (expr.type() == parser::ExprType::Binary) {
+            const auto& bin = static_cast<const parser::BinaryExpr&>(expr);
+            if (bin.op() == parser::TokenType::And) {
+                conjuncts(bin.left(), out);
+                conjuncts(bin.right(), out);
+                return;
+            }
+        }
+        out.push_back(&expr);
     }
 
-    // Check if left is Column and right is Constant
-    if (bin_expr->left().type() == parser::ExprType::Column &&
-        bin_expr->right().type() == parser::ExprType::Constant) {
-        const auto* const_expr = dynamic_cast<const parser::ConstantExpr*>(&bin_expr->right());
-        if (const_expr != nullptr) {
-            out_val = const_expr->value();
-            return true;
+    /** @brief Tightens `bounds` if `expr` compares the key with an integer constant */
+    [[nodiscard]] bool add_bound(const parser::Expression& expr, Bounds& bounds) const {
+        if (!integer_key_ || expr.type() != parser::ExprType::Binary) {
+            return false;
+        }
+        const auto& bin = static_cast<const parser::BinaryExpr&>(expr);
+        auto op = bin.op();
+        const common::Value* constant = nullptr;
+        if (is_key(bin.left())) {
+            constant = constant_of(bin.right());
+        } else if (is_key(bin.right())) {
+            constant = constant_of(bin.left());
+            /* c < key is key > c */
+            op = op == parser::TokenType::Lt   ? parser::TokenType::Gt
+                 : op == parser::TokenType::Le ? parser::TokenType::Ge
+                 : op == parser::TokenType::Gt ? parser::TokenType::Lt
+                 : op == parser::TokenType::Ge ? parser::TokenType::Le
+                                               : op;
+        }
+        if (constant == nullptr || !is_integer(*constant)) {
+            return false;
+        }
+        const int64_t c = constant->to_int64();
+        const auto raise = [&bounds](int64_t low) {
+            bounds.low = bounds.low ? std::max(*bounds.low, low) : low;
+        };
+        const auto lower = [&bounds](int64_t high) {
+            bounds.high = bounds.high ? std::min(*bounds.high, high) : high;
+        };
+        switch (op) {
+            case parser::TokenType::Gt:
+                if (c == std::numeric_limits<int64_t>::max()) return false;
+                raise(c + 1);
+                return true;
+            case parser::TokenType::Ge:
+                raise(c);
+                return true;
+            case parser::TokenType::Lt:
+                if (c == std::numeric_limits<int64_t>::min()) return false;
+                lower(c - 1);
+                return true;
+            case parser::TokenType::Le:
+                lower(c);
+                return true;
+            default:
+                return false;
         }
     }
 
-    // Check if right is Column and left is Constant
-    if (bin_expr->right().type() == parser::ExprType::Column &&
-        bin_expr->left().type() == parser::ExprType::Constant) {
-        const auto* const_expr = dynamic_cast<const parser::ConstantExpr*>(&bin_expr->left());
-        if (const_expr != nullptr) {
-            out_val = const_expr->value();
-            return true;
+    [[nodiscard]] ShardSet prune_conjunction(const parser::BinaryExpr& expr) const {
+        std::vector<const parser::Expression*> terms;
+        conjuncts(expr, terms);
+        ShardSet out;
+        Bounds bounds;
+        for (const auto* term : terms) {
+            if (!add_bound(*term, bounds)) {
+                intersect(out, prune(*term));
+            }
         }
+        if (bounds.low && bounds.high) {
+            std::set<uint32_t> range;
+            if (*bounds.low <= *bounds.high) {
+                /* The width may overflow int64 itself; compare unsigned */
+                const auto width = static_cast<uint64_t>(*bounds.high) -
+                                   static_cast<uint64_t>(*bounds.low);
+                if (width >= static_cast<uint64_t>(MAX_PRUNED_RANGE)) {
+                    return out;
+                }
+                for (int64_t v = *bounds.low;; ++v) {
+                    if (!add(common::Value::make_int64(v), range)) {
+                        return out;
+                    }
+                    if (v == *bounds.high) break;
+                }
+            }
+            intersect(out, range);
+        }
+        return out;
     }
 
-    return false;
+    std::string key_;
+    bool integer_key_;
+    const Placement& placement_;
+};
+
+/**
+ * @brief The node a statement on `shard` goes to: the shard's Raft leader if one is known
+ */
+cluster::NodeInfo shard_node(cluster::ClusterManager& cm,
+                             const std::vector<cluster::NodeInfo>& data_nodes, uint32_t shard) {
+    const std::string leader_id = cm.get_leader(shard + 1);
+    if (!leader_id.empty()) {
+        for (const auto& node : data_nodes) {
+            if (node.id == leader_id) {
+                return node;
+            }
+        }
+    }
+    return data_nodes[shard];
 }
 
 /**
@@ -104,6 +385,498 @@ std::string strip_limit_offset(const std::string& sql) {
     return s;
 }
 
+/**
+ * @brief The statement an EXPLAIN [ANALYZE] explains, as the client wrote it
+ */
+std::string strip_explain(const std::string& sql) {
+    size_t pos = 0;
+    const auto skip_word = [&sql, &pos](const char* word) {
+        while (pos < sql.size() && std::isspace(static_cast<unsigned char>(sql[pos])) != 0) ++pos;
+        const size_t len = std::char_traits<char>::length(word);
+        if (sql.size() - pos < len) return false;
+        for (size_t k = 0; k < len; ++k) {
+            if (std::toupper(static_cast<unsigned char>(sql[pos + k])) != word[k]) return false;
+        }
+        if (pos + len < sql.size() && std::isspace(static_cast<unsigned char>(sql[pos + len])) == 0) {
+            return false;
+        }
+        pos += len;
+        return true;
+    };
+    if (skip_word("EXPLAIN")) {
+        static_cast<void>(skip_word("ANALYZE"));
+    }
+    while (pos < sql.size() && std::isspace(static_cast<unsigned char>(sql[pos])) != 0) ++pos;
+    return sql.substr(pos);
+}
+
+/**
+ * @brief A request sent to one node; `connected` is false if the node could not be reached
+ */
+struct NodeCall {
+    bool connected = false;
+    std::shared_ptr<network::RpcClient> client;
+    std::future<network::RpcResult> reply;
+};
+
+/**
+ * @brief Sends the same request to every node at once over the pooled connections
+ */
+std::vector<NodeCall> call_nodes(cluster::ClusterManager& cm,
+                                 const std::vector<cluster::NodeInfo>& nodes,
+                                 network::RpcType type, const std::vector<uint8_t>& payload) {
+    std::vector<NodeCall> calls(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        calls[i].client = cm.get_client(nodes[i]);
+        if (calls[i].client) {
+            calls[i].connected = true;
+            calls[i].reply = calls[i].client->call_async(type, payload);
+        }
+    }
+    return calls;
+}
+
+/**
+ * @brief Waits for every reply of a fan-out whose outcome does not matter
+ */
+void await_calls(std::vector<NodeCall>& calls) {
+    for (auto& call : calls) {
+        if (call.connected) {
+            static_cast<void>(call.reply.get());
+        }
+    }
+}
+
+/**
+ * @brief Asks the nodes that have not answered to stop their fragments of `context_id`
+ */
+void cancel_outstanding(cluster::ClusterManager& cm, const std::vector<cluster::NodeInfo>& nodes,
+                        const std::vector<bool>& answered, const std::string& context_id) {
+    network::CancelFragmentArgs args;
+    args.context_id = context_id;
+    const auto payload = args.serialize();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (answered[i]) {
+            continue;
+        }
+        auto client = cm.get_client(nodes[i]);
+        if (client) {
+            static_cast<void>(client->send_only(network::RpcType::CancelFragment, payload));
+        }
+    }
+}
+
+/**
+ * @brief Collects the replies of a statement's fragments and shuffles, and merges them
+ *
+ * Fed by the RPC callbacks as replies arrive, so no thread waits on the
+ * sockets: whichever thread delivers the last reply merges the rows and hands
+ * the result to `done`, which runs exactly once. Shuffles and fragments of a
+ * join run together: reply i < n is node i's fragment, reply (k + 1) * n + i
+ * node i's shuffle of exchange_tables[k]. The first failure cancels the
+ * fragments still running and completes the statement at once; replies that
+ * come in after it are dropped.
+ */
+class FragmentGather : public std::enable_shared_from_this<FragmentGather> {
+   public:
+    using Done = std::function<void(QueryResult)>;
+
+    /** @brief What the fragments run and how their rows merge; `stmt` outlives `done` */
+    struct Plan {
+        const parser::Statement* stmt = nullptr;
+        const parser::ExplainStatement* explain = nullptr;
+        std::optional<PartialAggregation> aggregation;
+        std::optional<OrderedMerge> ordered;
+        std::string fragment_sql;
+        std::vector<cluster::NodeInfo> target_nodes;
+        std::vector<std::string> exchange_tables;
+        std::string context_id;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    FragmentGather(cluster::ClusterManager& cm, Plan plan, Done done)
+        : cm_(cm),
+          plan_(std::move(plan)),
+          done_(std::move(done)),
+          node_rows_(plan_.target_nodes.size()),
+          answered_(plan_.target_nodes.size(), false),
+          round_trips_(plan_.target_nodes.size()) {}
+
+    /** @brief Sends the fragments and shuffles; a node that cannot be reached fails at once */
+    void start(const std::vector<uint8_t>& fragment_payload,
+               const std::vector<std::vector<uint8_t>>& shuffle_payloads) {
+        const size_t n = plan_.target_nodes.size();
+        expected_ = n * (1 + shuffle_payloads.size());
+        /* The fragments' span ends on the thread that merges, so it is kept by hand */
+        const common::TraceContext parent = common::Tracer::current();
+        if (parent.traced()) {
+            span_.trace_id = parent.trace_id;
+            span_.parent_id = parent.span_id;
+            span_.span_id = common::Tracer::new_id();
+            span_.name = "coordinator.fragments";
+            span_.start_us = common::Tracer::wall_clock_us();
+            span_.attributes = {{"nodes", std::to_string(n)},
+                                {"shuffles", std::to_string(shuffle_payloads.size())}};
+        }
+        const common::TraceScope scope(
+            span_.trace_id != 0 ? common::TraceContext{span_.trace_id, span_.span_id} : parent);
+        sent_ = std::chrono::steady_clock::now();
+        send(network::RpcType::ExecuteFragment, fragment_payload, 0);
+        for (size_t k = 0; k < shuffle_payloads.size(); ++k) {
+            send(network::RpcType::ShuffleFragment, shuffle_payloads[k], (k + 1) * n);
+        }
+    }
+
+   private:
+    /** @brief Sends the same request to every target node, tagging node i's reply first + i */
+    void send(network::RpcType type, const std::vector<uint8_t>& payload, size_t first) {
+        for (size_t i = 0; i < plan_.target_nodes.size(); ++i) {
+            {
+                const std::scoped_lock<std::mutex> lock(mutex_);
+                if (finished_) {
+                    return; /* An earlier node failed; no point starting more */
+                }
+            }
+            const size_t tag = first + i;
+            auto client = cm_.get_client(plan_.target_nodes[i]);
+            if (!client) {
+                on_reply(tag, network::RpcResult{});
+                continue;
+            }
+            client->call_async(type, payload,
+                               [self = shared_from_this(), tag](network::RpcResult result) {
+                                   self->on_reply(tag, std::move(result));
+                               });
+        }
+    }
+
+    void on_reply(size_t tag, network::RpcResult result) {
+        const size_t n = plan_.target_nodes.size();
+        const size_t i = tag % n;
+        network::QueryResultsReply reply;
+        if (result.ok) {
+            reply = network::QueryResultsReply::deserialize(result.response);
+        } else {
+            reply.error_msg = "Failed to contact node " + plan_.target_nodes[i].id;
+        }
+
+        std::vector<bool> answered;
+        {
+            const std::scoped_lock<std::mutex> lock(mutex_);
+            if (finished_) {
+                return;
+            }
+            if (tag < n) {
+                answered_[i] = true;
+                round_trips_[i] = std::chrono::steady_clock::now() - sent_;
+            }
+            if (!reply.success) {
+                errors_ = tag >= n ? "[Shuffle of " + plan_.exchange_tables[tag / n - 1] +
+                                         " failed on node " + plan_.target_nodes[i].id + ": " +
+                                         reply.error_msg + "]; "
+                                   : "[" + reply.error_msg + "]; ";
+                finished_ = true;
+                answered = answered_;
+            } else {
+                if (tag < n) {
+                    if (!schema_captured_) {
+                        schema_ = std::move(reply.schema);
+                        schema_captured_ = true;
+                    }
+                    node_rows_[i] = std::move(reply.rows);
+                }
+                finished_ = ++received_ == expected_;
+                if (!finished_) {
+                    return;
+                }
+            }
+        }
+        /* Only the reply that finished the gather gets here: the rest is no longer shared */
+        if (!errors_.empty()) {
+            cancel_outstanding(cm_, plan_.target_nodes, answered, plan_.context_id);
+        }
+        complete();
+    }
+
+    void complete() {
+        if (span_.trace_id != 0) {
+            span_.duration_us = static_cast<uint64_t>(common::Tracer::wall_clock_us() -
+                                                      span_.start_us);
+            if (!errors_.empty()) {
+                span_.attributes.emplace_back("error", errors_);
+            }
+        }
+        const common::TraceContext parent{span_.trace_id, span_.parent_id};
+        if (span_.trace_id != 0) {
+            common::Tracer::global().record(std::move(span_));
+        }
+
+        QueryResult res;
+        if (!errors_.empty()) {
+            res.set_error(errors_);
+        } else {
+            const common::TraceScope scope(parent);
+            const common::Span merge_span("coordinator.merge");
+            try {
+                res = merge();
+            } catch (const std::exception& e) {
+                /* On an RPC thread nothing else would catch it */
+                res = QueryResult();
+                res.set_error(e.what());
+            }
+        }
+        Done done = std::move(done_);
+        done_ = nullptr;
+        done(std::move(res));
+    }
+
+    /** @brief The statement's result from the rows of every node */
+    QueryResult merge() {
+    const size_t n = plan_.target_nodes.size();
+    if (plan_.explain != nullptr) {
+        /* Each node sent its own plan; list them under the step that merges their rows */
+        QueryResult res;
+        Schema schema;
+        schema.add_column("QUERY PLAN", common::ValueType::TYPE_TEXT);
+        res.set_schema(schema);
+        const auto add_line = [&res](std::string line) {
+            res.add_row(Tuple({common::Value::make_text(line)}));
+        };
+        const char* const step = plan_.aggregation ? "merge partial aggregates"
+                                 : plan_.ordered   ? "merge sorted fragments"
+                                                   : "concatenate fragments";
+        add_line(std::string("Gather (") + step +
+                 ", " + std::to_string(n) + " fragment" + (n == 1 ? "" : "s") + ")");
+        add_line("  Fragment SQL: " + plan_.fragment_sql);
+        for (size_t i = 0; i < n; ++i) {
+            add_line("  ->  Fragment on node " + plan_.target_nodes[i].id +
+                     (plan_.explain->analyze() ? " (round trip=" +
+                                               format_ms(round_trips_[i]) + " ms)"
+                                         : ""));
+            for (const auto& row : node_rows_[i]) {
+                add_line("        " + row.get(0).to_string());
+            }
+        }
+        if (plan_.explain->analyze()) {
+            add_line("Execution Time: " +
+                     format_ms(std::chrono::steady_clock::now() - plan_.started) + " ms");
+        }
+        return res;
+    }
+    if (plan_.ordered) {
+        return plan_.ordered->finish(schema_, std::move(node_rows_));
+    }
+    /* Rows keep the order of the nodes, whichever answered first */
+    std::vector<executor::Tuple> aggregated_rows;
+    for (auto& rows : node_rows_) {
+        aggregated_rows.insert(aggregated_rows.end(), std::make_move_iterator(rows.begin()),
+                               std::make_move_iterator(rows.end()));
+    }
+
+    if (plan_.aggregation) {
+        return plan_.aggregation->finish(schema_, aggregated_rows);
+    }
+    QueryResult res;
+    res.set_schema(std::move(schema_));
+
+    // Step 2: Check for global aggregates (COUNT, SUM, MIN, MAX)
+    bool is_global_aggregate = false;
+    std::vector<std::string> agg_types;
+
+    if (plan_.stmt->type() == parser::StmtType::Select) {
+        const auto* select_stmt = dynamic_cast<const parser::SelectStatement*>(plan_.stmt);
+        if (select_stmt != nullptr && select_stmt->group_by().empty()) {
+            for (const auto& col : select_stmt->columns()) {
+                if (col->type() == parser::ExprType::Function) {
+                    const auto* func = dynamic_cast<const parser::FunctionExpr*>(col.get());
+                    std::string name = func->name();
+                    std::transform(name.begin(), name.end(), name.begin(),
+                                   [](unsigned char c) { return std::toupper(c); });
+                    if (name == "COUNT" || name == "SUM" || name == "MIN" || name == "MAX" ||
+                        name == "AVG") {
+                        is_global_aggregate = true;
+                        agg_types.push_back(name);
+                    } else {
+                        agg_types.push_back("");
+                    }
+                } else {
+                    agg_types.push_back("");
+                }
+            }
+        }
+    }
+
+    if (is_global_aggregate && !aggregated_rows.empty()) {
+        std::vector<common::Value> final_vals(agg_types.size(), common::Value::make_null());
+        std::vector<bool> initialized(agg_types.size(), false);
+
+        for (const auto& row : aggregated_rows) {
+            if (row.size() < agg_types.size()) continue;
+            for (size_t i = 0; i < agg_types.size(); ++i) {
+                if (agg_types[i].empty()) continue;
+
+                const auto& val = row.get(i);
+                if (val.is_null()) continue;
+
+                if (!initialized[i]) {
+                    final_vals[i] = val;
+                    initialized[i] = true;
+                    continue;
+                }
+
+                if (agg_types[i] == "COUNT" || agg_types[i] == "SUM") {
+                    int64_t current = final_vals[i].to_int64();
+                    int64_t added = val.to_int64();
+                    final_vals[i] = common::Value::make_int64(current + added);
+                } else if (agg_types[i] == "MIN") {
+                    if (val < final_vals[i]) final_vals[i] = val;
+                } else if (agg_types[i] == "MAX") {
+                    if (final_vals[i] < val) final_vals[i] = val;
+                }
+            }
+        }
+
+        executor::Tuple merged_tuple;
+        for (auto& v : final_vals) {
+            merged_tuple.values().push_back(std::move(v));
+        }
+        res.add_row(std::move(merged_tuple));
+    } else {
+        // Global Sorting: If ORDER BY present, re-sort the combined results
+        if (plan_.stmt->type() == parser::StmtType::Select) {
+            const auto* select_stmt = dynamic_cast<const parser::SelectStatement*>(plan_.stmt);
+            if (select_stmt != nullptr && !select_stmt->order_by().empty()) {
+                std::vector<executor::CompiledExpression> keys;
+                for (const auto& ob : select_stmt->order_by()) {
+                    keys.emplace_back(*ob, res.schema());
+                }
+                std::stable_sort(aggregated_rows.begin(), aggregated_rows.end(),
+                                 [&keys](const auto& a, const auto& b) {
+                                     for (const auto& k : keys) {
+                                         const auto va = k.evaluate(a);
+                                         const auto vb = k.evaluate(b);
+                                         if (va < vb) return true;
+                                         if (vb < va) return false;
+                                     }
+                                     return false;
+                                 });
+            }
+        }
+
+        // Global Limit/Offset
+        if (plan_.stmt->type() == parser::StmtType::Select) {
+            const auto* sel = dynamic_cast<const parser::SelectStatement*>(plan_.stmt);
+            if (sel && (sel->has_limit() || sel->has_offset())) {
+                int64_t limit = sel->limit();
+                int64_t offset = sel->offset();
+
+                if (offset > 0) {
+                    if (static_cast<size_t>(offset) >= aggregated_rows.size()) {
+                        aggregated_rows.clear();
+                    } else {
+                        aggregated_rows.erase(aggregated_rows.begin(),
+                                              aggregated_rows.begin() + offset);
+                    }
+                }
+
+                if (limit >= 0 && static_cast<size_t>(limit) < aggregated_rows.size()) {
+                    aggregated_rows.resize(limit);
+                }
+            }
+        }
+
+        for (auto& row : aggregated_rows) {
+            res.add_row(std::move(row));
+        }
+    }
+    return res;
+    }
+
+    cluster::ClusterManager& cm_;
+    Plan plan_;
+    Done done_;
+    std::mutex mutex_; /**< Guards the replies until the gather finishes */
+    std::vector<std::vector<executor::Tuple>> node_rows_;
+    std::vector<bool> answered_;
+    std::vector<std::chrono::steady_clock::duration> round_trips_;
+    Schema schema_;
+    bool schema_captured_ = false;
+    size_t expected_ = 0;
+    size_t received_ = 0;
+    bool finished_ = false;
+    std::string errors_;
+    std::chrono::steady_clock::time_point sent_;
+    common::SpanRecord span_; /**< Set while the statement is traced */
+};
+
+/**
+ * @brief Gathers the keys `key_col` holds in `table` across the nodes into one
+ * filter; nullopt if any node cannot send its keys
+ */
+std::optional<executor::RuntimeFilter> gather_key_filter(
+    cluster::ClusterManager& cm, const std::vector<cluster::NodeInfo>& nodes,
+    const std::string& table, const std::string& key_col) {
+    network::KeyFilterArgs args;
+    args.table_name = table;
+    args.key_col = key_col;
+    args.node_count = static_cast<uint32_t>(nodes.size());
+
+    std::optional<executor::RuntimeFilter> merged;
+    bool complete = true;
+    for (auto& call : call_nodes(cm, nodes, network::RpcType::KeyFilter, args.serialize())) {
+        if (!call.connected) {
+            complete = false;
+            continue;
+        }
+        const auto result = call.reply.get();
+        auto reply = result.ok ? network::KeyFilterReply::deserialize(result.response)
+                               : network::KeyFilterReply{};
+        if (!reply.success || !reply.filter) {
+            complete = false;
+        } else if (merged) {
+            merged->merge(*reply.filter);
+        } else {
+            merged = std::move(reply.filter);
+        }
+    }
+    if (!complete) {
+        return std::nullopt;
+    }
+    return merged;
+}
+
+/** @return true if the catalog knows `table` as a replicated table */
+bool is_replicated(Catalog& catalog, const std::string& table) {
+    const auto meta = catalog.get_table_by_name(table);
+    return meta && (*meta)->replicated();
+}
+
+/**
+ * @brief Whether the joins of `select` can run where the rows lie, shuffling nothing
+ *
+ * They can when at most one table is sharded and no join keeps the unmatched
+ * rows of a side made only of replicated tables: each node then joins its
+ * shard against its whole copies of the others, and every result row comes
+ * from exactly one node.
+ * @param sharded Set to the number of sharded tables; with none, one node can
+ * answer alone
+ */
+bool joins_colocated(Catalog& catalog, const parser::SelectStatement& select, size_t& sharded) {
+    using JoinType = parser::SelectStatement::JoinType;
+    sharded = is_replicated(catalog, select.from()->to_string()) ? 0 : 1;
+    bool colocated = true;
+    for (const auto& join : select.joins()) {
+        const bool replicated = is_replicated(catalog, join.table->to_string());
+        const bool keeps_left = join.type == JoinType::Left || join.type == JoinType::Full;
+        const bool keeps_right = join.type == JoinType::Right || join.type == JoinType::Full;
+        if ((keeps_left && sharded == 0) || (keeps_right && replicated)) {
+            colocated = false;
+        }
+        sharded += replicated ? 0 : 1;
+    }
+    return colocated && sharded <= 1;
+}
+
 }  // namespace
 
 DistributedExecutor::DistributedExecutor(Catalog& catalog, cluster::ClusterManager& cm)
@@ -111,10 +884,117 @@ DistributedExecutor::DistributedExecutor(Catalog& catalog, cluster::ClusterManag
 
 namespace {
 static std::atomic<uint64_t> next_context_id{1};
+static std::atomic<uint64_t> next_replica{0};
+
+/** @brief The node to read replicated tables from; successive reads take turns */
+cluster::NodeInfo replica_node(const std::vector<cluster::NodeInfo>& nodes) {
+    return nodes[next_replica.fetch_add(1) % nodes.size()];
+}
+
+/** Characters of a statement kept on its trace */
+constexpr size_t TRACE_SQL_LENGTH = 256;
 }
 
 QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
                                          const std::string& raw_sql) {
+    /* Statements enter the cluster here: this is where a trace starts */
+    common::Span span("coordinator.statement", common::Span::Start::RootIfSampled);
+    if (span.active()) {
+        span.set_attribute("sql", raw_sql.substr(0, TRACE_SQL_LENGTH));
+    }
+    if (stmt.type() != parser::StmtType::Explain) {
+        const auto type = stmt.type();
+        const ResultCache::Probe cache_probe = probe_cache(stmt);
+        if (!cache_probe.key.empty()) {
+            if (auto cached = result_cache_->lookup(cache_probe)) {
+                return std::move(*cached);
+            }
+        }
+        const bool ends_transaction = type == parser::StmtType::TransactionCommit ||
+                                      type == parser::StmtType::TransactionRollback;
+        std::vector<std::string> written;
+        if (ends_transaction) {
+            written.swap(written_tables_);
+        }
+
+        QueryResult res = execute_statement(stmt, raw_sql, nullptr);
+        if (!cache_probe.key.empty()) {
+            result_cache_->insert(cache_probe, res);
+        }
+
+        /* Noted whether or not it worked: a failed write may have changed some nodes */
+        std::string table;
+        if (type == parser::StmtType::Insert) {
+            table = dynamic_cast<const parser::InsertStatement&>(stmt).table()->to_string();
+        } else if (type == parser::StmtType::Update) {
+            table = dynamic_cast<const parser::UpdateStatement&>(stmt).table()->to_string();
+        } else if (type == parser::StmtType::Delete) {
+            table = dynamic_cast<const parser::DeleteStatement&>(stmt).table()->to_string();
+        }
+        if (!table.empty()) {
+            /* Inside a transaction the rows change again, for others, as it commits */
+            if (begun_) {
+                written_tables_.push_back(table);
+            }
+            written.push_back(std::move(table));
+        }
+        for (const auto& name : written) {
+            catalog_.note_data_change(name);
+        }
+        return res;
+    }
+    const auto& explain = dynamic_cast<const parser::ExplainStatement&>(stmt);
+    if (explain.statement().type() != parser::StmtType::Select) {
+        QueryResult res;
+        res.set_error("EXPLAIN supports SELECT statements only");
+        return res;
+    }
+    return execute_statement(explain.statement(), strip_explain(raw_sql), &explain);
+}
+
+void DistributedExecutor::execute_async(const parser::Statement& stmt,
+                                        const std::string& raw_sql, Completion done) {
+    if (stmt.type() != parser::StmtType::Select) {
+        done(execute(stmt, raw_sql));
+        return;
+    }
+    common::Span span("coordinator.statement", common::Span::Start::RootIfSampled);
+    if (span.active()) {
+        span.set_attribute("sql", raw_sql.substr(0, TRACE_SQL_LENGTH));
+    }
+    ResultCache::Probe cache_probe = probe_cache(stmt);
+    if (!cache_probe.key.empty()) {
+        if (auto cached = result_cache_->lookup(cache_probe)) {
+            done(std::move(*cached));
+            return;
+        }
+        Completion uncached = std::move(done);
+        done = [cache = result_cache_, probe = std::move(cache_probe),
+                uncached = std::move(uncached)](QueryResult res) {
+            cache->insert(probe, res);
+            uncached(std::move(res));
+        };
+    }
+    QueryResult res = execute_statement(stmt, raw_sql, nullptr, &done);
+    if (done) {
+        /* Answered without a fan-out, such as an error while planning */
+        done(std::move(res));
+    }
+}
+
+ResultCache::Probe DistributedExecutor::probe_cache(const parser::Statement& stmt) const {
+    if (stmt.type() != parser::StmtType::Select || result_cache_ == nullptr ||
+        !read_settings_.result_cache || read_settings_.constrained() || begun_) {
+        return {};
+    }
+    return ResultCache::probe(catalog_, dynamic_cast<const parser::SelectStatement&>(stmt));
+}
+
+QueryResult DistributedExecutor::execute_statement(const parser::Statement& stmt,
+                                                   const std::string& raw_sql,
+                                                   const parser::ExplainStatement* explain,
+                                                   Completion* detach) {
+    const auto started = std::chrono::steady_clock::now();
     auto data_nodes = cluster_manager_.get_data_nodes();
     // CRUCIAL: Sort data nodes to ensure consistent sharding indices across the cluster
     std::sort(data_nodes.begin(), data_nodes.end(),
@@ -122,6 +1002,16 @@ QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
 
     // 1. Check if it's a DDL (Catalog) operation
     const auto type = stmt.type();
+    if (type == parser::StmtType::Set) {
+        /* Session state of the coordinator; the data nodes get it with each read */
+        QueryResult res;
+        const std::string error =
+            read_settings_.apply(dynamic_cast<const parser::SetStatement&>(stmt));
+        if (!error.empty()) {
+            res.set_error(error);
+        }
+        return res;
+    }
     if (type == parser::StmtType::CreateTable || type == parser::StmtType::DropTable ||
         type == parser::StmtType::CreateIndex || type == parser::StmtType::DropIndex) {
         QueryResult res;
@@ -136,7 +1026,17 @@ QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
                     if (col.type_ == "TEXT") vtype = common::ValueType::TYPE_TEXT;
                     catalog_cols.emplace_back(col.name_, vtype, pos++);
                 }
-                catalog_.create_table(ct.table_name(), std::move(catalog_cols));
+                /* The first table places its keys on a ring; there is no data to move yet */
+                if (catalog_.shard_ring().empty() && catalog_.get_all_tables().empty() &&
+                    !data_nodes.empty()) {
+                    std::vector<std::string> ids;
+                    for (const auto& node : data_nodes) {
+                        ids.push_back(node.id);
+                    }
+                    catalog_.set_shard_ring(cluster::ShardManager::build_ring(ids));
+                }
+                catalog_.create_table(ct.table_name(), std::move(catalog_cols),
+                                      ct.replicated() ? TableInfo::FLAG_REPLICATED : 0);
             } else if (type == parser::StmtType::DropTable) {
                 const auto& dt = dynamic_cast<const parser::DropTableStatement&>(stmt);
                 auto meta = catalog_.get_table_by_name(dt.table_name());
@@ -146,24 +1046,28 @@ QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
             }
 
             // Explicit forward to data nodes to ensure they have metadata IMMEDIATELY (POC
-            // workaround for Raft lag)
+            // workaround for Raft lag). A node's reply means it has applied the change, so
+            // the statement completes once every node has answered.
             network::ExecuteFragmentArgs args;
             args.sql = raw_sql;
             args.context_id = "ddl_sync";
             auto payload = args.serialize();
 
-            for (const auto& node : data_nodes) {
-                network::RpcClient client(node.address, node.cluster_port);
-                if (client.connect()) {
-                    std::vector<uint8_t> resp;
-                    static_cast<void>(
-                        client.call(network::RpcType::ExecuteFragment, payload, resp));
+            std::string unacknowledged;
+            auto calls = call_nodes(cluster_manager_, data_nodes,
+                                    network::RpcType::ExecuteFragment, payload);
+            for (size_t i = 0; i < calls.size(); ++i) {
+                /* A failed reply (e.g. the table already exists there) still acknowledges */
+                if (!calls[i].connected || !calls[i].reply.get().ok) {
+                    unacknowledged += (unacknowledged.empty() ? "" : ", ") + data_nodes[i].id;
                 }
             }
 
-            res.set_rows_affected(1);
-            // Small sleep after DDL to let things settle
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            if (unacknowledged.empty()) {
+                res.set_rows_affected(1);
+            } else {
+                res.set_error("DDL not acknowledged by node(s) " + unacknowledged);
+            }
         } catch (const std::exception& e) {
             res.set_error(e.what());
         }
@@ -179,12 +1083,26 @@ QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
     // Step 2: Advanced Joins: Broadcast or Shuffle Join Orchestration
     std::string context_id = "ctx_" + std::to_string(next_context_id.fetch_add(1));
 
+    /*
+     * Shuffle joins stream: every table is repartitioned on its join key while
+     * the fragments run, and the fragments read the shuffled tables as they
+     * arrive (ExchangeScan) instead of after a shuffle barrier. Build sides go
+     * out first, the FROM table last, in the order the fragments consume them.
+     */
+    std::vector<std::string> exchange_tables;
+    std::vector<std::vector<uint8_t>> shuffle_payloads;
+    /* Set when the statement reads replicated tables only: any one node can answer */
+    bool one_replica = false;
+    size_t sharded_tables = 0;
     if (type == parser::StmtType::Select) {
         const auto* select_stmt = dynamic_cast<const parser::SelectStatement*>(&stmt);
-        if (select_stmt != nullptr && !select_stmt->joins().empty()) {
-            // POC: For multi-shard joins, use Shuffle Join if tables are "large"
+        if (select_stmt != nullptr && !select_stmt->joins().empty() &&
+            joins_colocated(catalog_, *select_stmt, sharded_tables)) {
+            one_replica = sharded_tables == 0;
+        } else if (select_stmt != nullptr && !select_stmt->joins().empty()) {
+            const std::string left_table = select_stmt->from()->to_string();
+            std::string base_key;
             for (const auto& join : select_stmt->joins()) {
-                const std::string left_table = select_stmt->from()->to_string();
                 const std::string right_table = join.table->to_string();
 
                 // Assume join key is in the condition
@@ -204,63 +1122,54 @@ QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
                     res.set_error("Shuffle Join requires equality join condition");
                     return res;
                 }
-
-                // Phase 1: Instruct nodes to shuffle Left Table
-                network::ShuffleFragmentArgs left_args;
-                left_args.context_id = context_id;
-                left_args.table_name = left_table;
-                left_args.join_key_col = left_key;
-                auto left_payload = left_args.serialize();
-
-                for (const auto& node : data_nodes) {
-                    network::RpcClient client(node.address, node.cluster_port);
-                    if (!client.connect()) {
-                        QueryResult res;
-                        res.set_error("Failed to connect to node " + node.id + " for shuffle");
-                        return res;
-                    }
-                    std::vector<uint8_t> resp;
-                    if (!client.call(network::RpcType::ShuffleFragment, left_payload, resp)) {
-                        QueryResult res;
-                        res.set_error("Shuffle RPC failed on node " + node.id);
-                        return res;
-                    }
-                    auto reply = network::QueryResultsReply::deserialize(resp);
-                    if (!reply.success) {
-                        QueryResult res;
-                        res.set_error("Shuffle failed on node " + node.id + ": " + reply.error_msg);
-                        return res;
-                    }
+                if (base_key.empty()) {
+                    base_key = left_key;
                 }
 
-                // Phase 2: Instruct nodes to shuffle Right Table
+                /* A table is shuffled once, however many joins name it */
+                if (right_table == left_table ||
+                    std::find(exchange_tables.begin(), exchange_tables.end(), right_table) !=
+                        exchange_tables.end()) {
+                    continue;
+                }
                 network::ShuffleFragmentArgs right_args;
                 right_args.context_id = context_id;
                 right_args.table_name = right_table;
                 right_args.join_key_col = right_key;
-                auto right_payload = right_args.serialize();
-
-                for (const auto& node : data_nodes) {
-                    network::RpcClient client(node.address, node.cluster_port);
-                    if (!client.connect()) {
-                        QueryResult res;
-                        res.set_error("Failed to connect to node " + node.id + " for shuffle");
-                        return res;
-                    }
-                    std::vector<uint8_t> resp;
-                    if (!client.call(network::RpcType::ShuffleFragment, right_payload, resp)) {
-                        QueryResult res;
-                        res.set_error("Shuffle RPC failed on node " + node.id);
-                        return res;
-                    }
-                    auto reply = network::QueryResultsReply::deserialize(resp);
-                    if (!reply.success) {
-                        QueryResult res;
-                        res.set_error("Shuffle failed on node " + node.id + ": " + reply.error_msg);
-                        return res;
-                    }
+                right_args.replicated = is_replicated(catalog_, right_table);
+                shuffle_payloads.push_back(right_args.serialize());
+                exchange_tables.push_back(right_table);
+            }
+
+            network::ShuffleFragmentArgs left_args;
+            left_args.context_id = context_id;
+            left_args.table_name = left_table;
+            left_args.join_key_col = base_key;
+            left_args.replicated = is_replicated(catalog_, left_table);
+            /*
+             * FROM rows an inner join cannot match are dropped before they are
+             * sent: one round collects the first joined table's keys from every
+             * node (from one, if it is replicated), and the FROM table's shuffle
+             * filters on their union. Plans that are only explained shuffle nothing.
+             */
+            const auto& first_join = select_stmt->joins().front();
+            const std::string first_table = first_join.table->to_string();
+            if (first_join.type == parser::SelectStatement::JoinType::Inner &&
+                first_table != left_table && (explain == nullptr || explain->analyze())) {
+                const common::Span filter_span("coordinator.key_filter");
+                std::string right_key;
+                if (const auto* bin_expr =
+                        dynamic_cast<const parser::BinaryExpr*>(first_join.condition.get())) {
+                    right_key = normalize_key(bin_expr->right());
                 }
+                const auto key_nodes = is_replicated(catalog_, first_table)
+                                           ? std::vector<cluster::NodeInfo>{data_nodes.front()}
+                                           : data_nodes;
+                left_args.key_filter =
+                    gather_key_filter(cluster_manager_, key_nodes, first_table, right_key);
             }
+            shuffle_payloads.push_back(left_args.serialize());
+            exchange_tables.push_back(left_table);
         }
     }
 
@@ -272,20 +1181,12 @@ QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
         args.txn_id = GLOBAL_TXN_ID;
         auto payload = args.serialize();
 
-        std::vector<std::future<void>> rollback_futures;
-        for (const auto& node : data_nodes) {
-            rollback_futures.push_back(std::async(std::launch::async, [node, payload]() {
-                network::RpcClient client(node.address, node.cluster_port);
-                if (client.connect()) {
-                    std::vector<uint8_t> resp_payload;
-                    static_cast<void>(
-                        client.call(network::RpcType::TxnAbort, payload, resp_payload));
-                }
-            }));
-        }
-        for (auto& f : rollback_futures) {
-            f.get();
+        std::vector<cluster::NodeInfo> nodes;
+        for (auto& participant : take_participants(data_nodes)) {
+            nodes.push_back(std::move(participant.node));
         }
+        auto calls = call_nodes(cluster_manager_, nodes, network::RpcType::TxnAbort, payload);
+        await_calls(calls);
         return {};
     }
 
@@ -296,53 +1197,80 @@ QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
         args.txn_id = GLOBAL_TXN_ID;
         auto payload = args.serialize();
 
-        // Phase 1: Prepare (Parallel)
-        std::vector<std::future<std::pair<bool, std::string>>> prepare_futures;
-        for (const auto& node : data_nodes) {
-            prepare_futures.push_back(std::async(std::launch::async, [node, payload]() {
-                network::RpcClient client(node.address, node.cluster_port);
-                if (client.connect()) {
-                    std::vector<uint8_t> resp_payload;
-                    if (client.call(network::RpcType::TxnPrepare, payload, resp_payload)) {
-                        auto reply = network::QueryResultsReply::deserialize(resp_payload);
-                        if (reply.success) {
-                            return std::make_pair(true, std::string(""));
-                        }
-                        return std::make_pair(
-                            false, "[" + node.id + "] Prepare failed: " + reply.error_msg);
-                    }
-                    return std::make_pair(false, "[" + node.id + "] RPC failed during prepare");
+        std::vector<cluster::NodeInfo> writers;
+        std::vector<cluster::NodeInfo> readers;
+        for (auto& participant : take_participants(data_nodes)) {
+            (participant.wrote ? writers : readers).push_back(std::move(participant.node));
+        }
+
+        /*
+         * A node that was only read from has nothing to make durable and no say in the
+         * outcome: it skips the prepare and lets its locks go while the writers decide
+         */
+        auto releases =
+            call_nodes(cluster_manager_, readers, network::RpcType::TxnCommit, payload);
+
+        if (writers.empty()) {
+            await_calls(releases);
+            return {};
+        }
+
+        /* A transaction that wrote on one node has nobody to agree with: it commits in one phase */
+        if (writers.size() == 1) {
+            const common::Span commit_span("2pc.commit_one_phase");
+            auto calls =
+                call_nodes(cluster_manager_, writers, network::RpcType::TxnCommit, payload);
+            const auto& node = writers.front();
+            QueryResult res;
+            if (!calls.front().connected) {
+                res.set_error("[" + node.id + "] Connection failed during commit");
+            } else if (auto result = calls.front().reply.get(); !result.ok) {
+                res.set_error("[" + node.id + "] RPC failed during commit");
+            } else {
+                auto reply = network::QueryResultsReply::deserialize(result.response);
+                if (!reply.success) {
+                    res.set_error("[" + node.id + "] Commit failed: " + reply.error_msg);
                 }
-                return std::make_pair(false, "[" + node.id + "] Connection failed during prepare");
-            }));
+            }
+            await_calls(releases);
+            return res;
         }
 
+        // Phase 1: Prepare (Parallel)
+        common::Span prepare_span("2pc.prepare");
+        auto prepare_calls =
+            call_nodes(cluster_manager_, writers, network::RpcType::TxnPrepare, payload);
         bool all_prepared = true;
-        for (auto& f : prepare_futures) {
-            auto res_p = f.get();
-            if (!res_p.first) {
+        for (size_t i = 0; i < writers.size(); ++i) {
+            const auto& node = writers[i];
+            if (!prepare_calls[i].connected) {
+                all_prepared = false;
+                errors += "[" + node.id + "] Connection failed during prepare; ";
+                continue;
+            }
+            auto result = prepare_calls[i].reply.get();
+            if (!result.ok) {
                 all_prepared = false;
-                errors += res_p.second + "; ";
+                errors += "[" + node.id + "] RPC failed during prepare; ";
+                continue;
+            }
+            auto reply = network::QueryResultsReply::deserialize(result.response);
+            if (!reply.success) {
+                all_prepared = false;
+                errors += "[" + node.id + "] Prepare failed: " + reply.error_msg + "; ";
             }
         }
 
+        prepare_span.end();
+
         // Phase 2: Commit or Abort (Parallel)
         const auto phase2_type =
             all_prepared ? network::RpcType::TxnCommit : network::RpcType::TxnAbort;
 
-        std::vector<std::future<void>> phase2_futures;
-        for (const auto& node : data_nodes) {
-            phase2_futures.push_back(std::async(std::launch::async, [node, payload, phase2_type]() {
-                network::RpcClient client(node.address, node.cluster_port);
-                if (client.connect()) {
-                    std::vector<uint8_t> resp_payload;
-                    static_cast<void>(client.call(phase2_type, payload, resp_payload));
-                }
-            }));
-        }
-        for (auto& f : phase2_futures) {
-            f.get();
-        }
+        const common::Span phase2_span(all_prepared ? "2pc.commit" : "2pc.abort");
+        auto phase2_calls = call_nodes(cluster_manager_, writers, phase2_type, payload);
+        await_calls(phase2_calls);
+        await_calls(releases);
 
         if (all_prepared) {
             return {};
@@ -354,11 +1282,47 @@ QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
 
     // 3. Query Analysis for Routing
     std::vector<cluster::NodeInfo> target_nodes;
+    const Placement placement(catalog_.shard_ring(), data_nodes);
 
     if (type == parser::StmtType::Insert) {
         const auto* insert_stmt = dynamic_cast<const parser::InsertStatement*>(&stmt);
+        if (insert_stmt != nullptr &&
+            is_replicated(catalog_, insert_stmt->table()->to_string())) {
+            /* Every node holds all rows of a replicated table, so each runs the whole INSERT */
+            network::ExecuteFragmentArgs args;
+            args.sql = raw_sql;
+            args.context_id = context_id;
+            std::string errors;
+            auto calls = call_nodes(cluster_manager_, data_nodes,
+                                    network::RpcType::ExecuteFragment, args.serialize());
+            for (size_t i = 0; i < calls.size(); ++i) {
+                add_participant(data_nodes[i], true);
+                if (!calls[i].connected) {
+                    errors += "[" + data_nodes[i].id + "] Connect failed; ";
+                    continue;
+                }
+                auto result = calls[i].reply.get();
+                if (!result.ok) {
+                    errors += "[" + data_nodes[i].id + "] RPC failed; ";
+                    continue;
+                }
+                auto reply = network::QueryResultsReply::deserialize(result.response);
+                if (!reply.success) {
+                    errors += "[" + data_nodes[i].id + "] INSERT failed: " + reply.error_msg +
+                              "; ";
+                }
+            }
+            QueryResult res;
+            if (errors.empty()) {
+                res.set_rows_affected(insert_stmt->values().size());
+            } else {
+                res.set_error(errors);
+            }
+            return res;
+        }
         if (insert_stmt != nullptr && !insert_stmt->values().empty()) {
             std::unordered_map<uint32_t, std::vector<std::vector<std::string>>> partitions;
+            std::string errors;
 
             for (const auto& row_exprs : insert_stmt->values()) {
                 if (row_exprs.empty()) continue;
@@ -367,9 +1331,13 @@ QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
                     const auto* const_expr =
                         dynamic_cast<const parser::ConstantExpr*>(row_exprs[0].get());
                     if (const_expr != nullptr) {
-                        const common::Value pk_val = const_expr->value();
-                        const uint32_t shard_idx = cluster::ShardManager::compute_shard(
-                            pk_val, static_cast<uint32_t>(data_nodes.size()));
+                        const auto shard = placement.shard_of(const_expr->value());
+                        if (!shard) {
+                            errors += "[" + const_expr->to_string() +
+                                      "] Shard owner is not a data node; ";
+                            continue;
+                        }
+                        const uint32_t shard_idx = *shard;
 
                         std::vector<std::string> row_vals;
                         for (const auto& expr : row_exprs) {
@@ -380,13 +1348,21 @@ QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
                 }
             }
 
+            /* Every shard's INSERT goes out first; the replies are collected after */
+            struct ShardInsert {
+                cluster::NodeInfo node;
+                size_t rows;
+                std::shared_ptr<network::RpcClient> client;
+                std::future<network::RpcResult> reply;
+            };
+            std::vector<ShardInsert> inserts;
             uint64_t total_affected = 0;
-            std::string errors;
             for (auto& [shard_idx, rows] : partitions) {
                 if (shard_idx >= data_nodes.size()) continue;
-                const auto& node = data_nodes[shard_idx];
-                network::RpcClient client(node.address, node.cluster_port);
-                if (client.connect()) {
+                const auto node = shard_node(cluster_manager_, data_nodes, shard_idx);
+                add_participant(node, true);
+                auto client = cluster_manager_.get_client(node);
+                if (client) {
                     std::string shard_sql =
                         "INSERT INTO " + insert_stmt->table()->to_string() + " VALUES ";
                     for (size_t i = 0; i < rows.size(); ++i) {
@@ -401,19 +1377,25 @@ QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
                     network::ExecuteFragmentArgs args;
                     args.sql = shard_sql;
                     args.context_id = context_id;
-                    std::vector<uint8_t> resp;
-                    if (client.call(network::RpcType::ExecuteFragment, args.serialize(), resp)) {
-                        auto reply = network::QueryResultsReply::deserialize(resp);
-                        if (reply.success) {
-                            total_affected += rows.size();
-                        } else {
-                            errors += "[" + node.id + "] INSERT failed: " + reply.error_msg + "; ";
-                        }
+                    auto reply =
+                        client->call_async(network::RpcType::ExecuteFragment, args.serialize());
+                    inserts.push_back({node, rows.size(), std::move(client), std::move(reply)});
+                } else {
+                    errors += "[" + node.id + "] Connect failed; ";
+                }
+            }
+            for (auto& insert : inserts) {
+                auto result = insert.reply.get();
+                if (result.ok) {
+                    auto reply = network::QueryResultsReply::deserialize(result.response);
+                    if (reply.success) {
+                        total_affected += insert.rows;
                     } else {
-                        errors += "[" + node.id + "] RPC failed; ";
+                        errors +=
+                            "[" + insert.node.id + "] INSERT failed: " + reply.error_msg + "; ";
                     }
                 } else {
-                    errors += "[" + node.id + "] Connect failed; ";
+                    errors += "[" + insert.node.id + "] RPC failed; ";
                 }
             }
 
@@ -430,36 +1412,53 @@ QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
             if (sel && !sel->joins().empty()) is_join = true;
         }
 
-        // Try shard pruning based on WHERE clause, but ONLY if NOT a join (joins are complex in
-        // POC)
+        /* Shard pruning: joins and tables the catalog does not know go to every node */
         const parser::Expression* where_expr = nullptr;
+        const parser::Expression* table_expr = nullptr;
         if (!is_join) {
             if (type == parser::StmtType::Select) {
-                where_expr = dynamic_cast<const parser::SelectStatement*>(&stmt)->where();
+                const auto& sel = dynamic_cast<const parser::SelectStatement&>(stmt);
+                where_expr = sel.where();
+                table_expr = sel.from();
             } else if (type == parser::StmtType::Update) {
-                where_expr = dynamic_cast<const parser::UpdateStatement*>(&stmt)->where();
+                const auto& upd = dynamic_cast<const parser::UpdateStatement&>(stmt);
+                where_expr = upd.where();
+                table_expr = upd.table();
             } else if (type == parser::StmtType::Delete) {
-                where_expr = dynamic_cast<const parser::DeleteStatement*>(&stmt)->where();
+                const auto& del = dynamic_cast<const parser::DeleteStatement&>(stmt);
+                where_expr = del.where();
+                table_expr = del.table();
             }
-
-            common::Value pk_val;
-            if (try_extract_sharding_key(where_expr, pk_val)) {
-                const uint32_t shard_idx = cluster::ShardManager::compute_shard(
-                    pk_val, static_cast<uint32_t>(data_nodes.size()));
-
-                // Leader-Aware Routing: Route mutations/queries to the current shard leader
-                std::string leader_id = cluster_manager_.get_leader(shard_idx + 1);
-                bool found_leader = false;
-                if (!leader_id.empty()) {
-                    for (const auto& node : data_nodes) {
-                        if (node.id == leader_id) {
-                            target_nodes.push_back(node);
-                            found_leader = true;
-                            break;
-                        }
+        }
+        std::optional<TableInfo*> table_meta;
+        if (table_expr != nullptr && !data_nodes.empty()) {
+            table_meta = catalog_.get_table_by_name(table_expr->to_string());
+        }
+        if (one_replica || (table_meta && (*table_meta)->replicated())) {
+            /* Every node holds the whole table: one reads it, all write it */
+            if (type == parser::StmtType::Select) {
+                target_nodes.push_back(replica_node(data_nodes));
+            }
+        } else if (where_expr != nullptr && table_meta && !(*table_meta)->columns.empty()) {
+            const auto& key = (*table_meta)->columns.front();
+            const auto key_type = key.type;
+            const bool integer_key = key_type == common::ValueType::TYPE_INT8 ||
+                                     key_type == common::ValueType::TYPE_INT16 ||
+                                     key_type == common::ValueType::TYPE_INT32 ||
+                                     key_type == common::ValueType::TYPE_INT64;
+            const ShardPruner pruner(key.name, integer_key, placement);
+            if (const auto shards = pruner.prune(*where_expr)) {
+                /* A contradiction matches nothing; one node still answers with the schema */
+                for (const uint32_t shard : shards->empty() ? std::set<uint32_t>{0} : *shards) {
+                    auto node = shard_node(cluster_manager_, data_nodes, shard);
+                    /* One leader can lead several shards; it runs the statement once */
+                    const bool listed =
+                        std::any_of(target_nodes.begin(), target_nodes.end(),
+                                    [&node](const auto& t) { return t.id == node.id; });
+                    if (!listed) {
+                        target_nodes.push_back(std::move(node));
                     }
                 }
-                if (!found_leader) target_nodes.push_back(data_nodes[shard_idx]);
             }
         }
     }
@@ -468,186 +1467,288 @@ QueryResult DistributedExecutor::execute(const parser::Statement& stmt,
     if (target_nodes.empty()) {
         target_nodes = data_nodes;
     }
+    if (type == parser::StmtType::TransactionBegin) {
+        participants_.clear();
+        begun_ = true;
+    } else {
+        for (const auto& node : target_nodes) {
+            add_participant(node, type != parser::StmtType::Select);
+        }
+    }
+
+    /*
+     * Grouped and aggregate SELECTs aggregate on the data nodes and merge here; sorted and
+     * limited ones sort and cut off their Top-N on the data nodes and are merged here
+     */
+    std::optional<PartialAggregation> aggregation;
+    std::optional<OrderedMerge> ordered;
+    if (type == parser::StmtType::Select) {
+        const auto& select = dynamic_cast<const parser::SelectStatement&>(stmt);
+        aggregation = PartialAggregation::plan(select);
+        if (!aggregation) {
+            ordered = OrderedMerge::plan(select);
+        }
+    }
 
     network::ExecuteFragmentArgs fragment_args;
     // Strip LIMIT/OFFSET from fragment SQL to ensure data nodes return all rows for global
     // processing
-    fragment_args.sql = (type == parser::StmtType::Select) ? strip_limit_offset(raw_sql) : raw_sql;
+    if (aggregation) {
+        fragment_args.sql = aggregation->partial_sql();
+    } else if (ordered) {
+        fragment_args.sql = ordered->fragment_sql();
+    } else {
+        fragment_args.sql =
+            (type == parser::StmtType::Select) ? strip_limit_offset(raw_sql) : raw_sql;
+    }
     fragment_args.context_id = context_id;
-    auto fragment_payload = fragment_args.serialize();
-
-    bool all_success = true;
-    std::string errors;
-    std::vector<executor::Tuple> aggregated_rows;
-    Schema result_schema;
-    bool schema_captured = false;
-
-    std::vector<std::future<std::pair<bool, network::QueryResultsReply>>> query_futures;
-    for (const auto& node : target_nodes) {
-        query_futures.push_back(std::async(std::launch::async, [node, fragment_payload]() {
-            network::RpcClient client(node.address, node.cluster_port);
-            network::QueryResultsReply reply;
-            if (client.connect()) {
-                std::vector<uint8_t> resp_payload;
-                if (client.call(network::RpcType::ExecuteFragment, fragment_payload,
-                                resp_payload)) {
-                    reply = network::QueryResultsReply::deserialize(resp_payload);
-                    return std::make_pair(true, reply);
-                }
-            }
-            reply.success = false;
-            reply.error_msg = "Failed to contact node " + node.id;
-            return std::make_pair(false, reply);
-        }));
-    }
-
-    for (auto& f : query_futures) {
-        auto res_fut = f.get();
-        if (res_fut.first && res_fut.second.success) {
-            if (!schema_captured) {
-                result_schema = res_fut.second.schema;
-                schema_captured = true;
-            }
-            for (auto& row : res_fut.second.rows) {
-                aggregated_rows.push_back(std::move(row));
-            }
-        } else {
-            all_success = false;
-            errors += "[" + res_fut.second.error_msg + "]; ";
+    if (type == parser::StmtType::Select) {
+        set_read_options(fragment_args);
+    }
+    if (explain != nullptr) {
+        fragment_args.sql = (explain->analyze() ? "EXPLAIN ANALYZE " : "EXPLAIN ") + fragment_args.sql;
+        if (!explain->analyze()) {
+            /* Fragments that only plan read no exchange, so nothing is shuffled to them */
+            exchange_tables.clear();
+            shuffle_payloads.clear();
         }
     }
+    fragment_args.exchange_tables = exchange_tables;
+    fragment_args.exchange_senders = static_cast<uint32_t>(data_nodes.size());
+    auto fragment_payload = fragment_args.serialize();
 
-    if (all_success) {
-        QueryResult res;
-        res.set_schema(std::move(result_schema));
+    FragmentGather::Plan plan;
+    plan.stmt = &stmt;
+    plan.explain = explain;
+    plan.aggregation = std::move(aggregation);
+    plan.ordered = std::move(ordered);
+    plan.fragment_sql = fragment_args.sql;
+    plan.target_nodes = std::move(target_nodes);
+    plan.exchange_tables = std::move(exchange_tables);
+    plan.context_id = context_id;
+    plan.started = started;
+    if (detach != nullptr) {
+        /* Nothing waits: the thread that delivers the last reply completes the statement */
+        std::make_shared<FragmentGather>(cluster_manager_, std::move(plan),
+                                         std::exchange(*detach, nullptr))
+            ->start(fragment_payload, shuffle_payloads);
+        return QueryResult();
+    }
+    auto promise = std::make_shared<std::promise<QueryResult>>();
+    auto result = promise->get_future();
+    std::make_shared<FragmentGather>(
+        cluster_manager_, std::move(plan),
+        [promise](QueryResult res) { promise->set_value(std::move(res)); })
+        ->start(fragment_payload, shuffle_payloads);
+    return result.get();
+}
 
-        // Step 2: Check for global aggregates (COUNT, SUM, MIN, MAX)
-        bool is_global_aggregate = false;
-        std::vector<std::string> agg_types;
+QueryResult DistributedExecutor::rebalance() {
+    QueryResult res;
+    auto data_nodes = cluster_manager_.get_data_nodes();
+    if (data_nodes.empty()) {
+        res.set_error("No active data nodes in cluster");
+        return res;
+    }
+    std::sort(data_nodes.begin(), data_nodes.end(),
+              [](const auto& a, const auto& b) { return a.id < b.id; });
+    std::vector<std::string> ids;
+    ids.reserve(data_nodes.size());
+    for (const auto& node : data_nodes) {
+        ids.push_back(node.id);
+    }
 
-        if (type == parser::StmtType::Select) {
-            const auto* select_stmt = dynamic_cast<const parser::SelectStatement*>(&stmt);
-            if (select_stmt != nullptr && select_stmt->group_by().empty()) {
-                for (const auto& col : select_stmt->columns()) {
-                    if (col->type() == parser::ExprType::Function) {
-                        const auto* func = dynamic_cast<const parser::FunctionExpr*>(col.get());
-                        std::string name = func->name();
-                        std::transform(name.begin(), name.end(), name.begin(),
-                                       [](unsigned char c) { return std::toupper(c); });
-                        if (name == "COUNT" || name == "SUM" || name == "MIN" || name == "MAX" ||
-                            name == "AVG") {
-                            is_global_aggregate = true;
-                            agg_types.push_back(name);
-                        } else {
-                            agg_types.push_back("");
-                        }
-                    } else {
-                        agg_types.push_back("");
-                    }
-                }
-            }
+    auto ring = cluster::ShardManager::build_ring(ids);
+    ring.migrating = true;
+    catalog_.set_shard_ring(ring);
+    const Placement placement(catalog_.shard_ring(), data_nodes);
+
+    const std::string context_id = "rebalance_" + std::to_string(next_context_id.fetch_add(1));
+    const auto run_on = [&](const cluster::NodeInfo& node, const std::string& sql,
+                            std::string& error) {
+        network::ExecuteFragmentArgs args;
+        args.sql = sql;
+        args.context_id = context_id;
+        auto calls = call_nodes(cluster_manager_, {node}, network::RpcType::ExecuteFragment,
+                                args.serialize());
+        if (!calls.front().connected) {
+            error += "[" + node.id + "] Connect failed; ";
+            return false;
         }
+        auto result = calls.front().reply.get();
+        if (!result.ok) {
+            error += "[" + node.id + "] RPC failed; ";
+            return false;
+        }
+        auto reply = network::QueryResultsReply::deserialize(result.response);
+        if (!reply.success) {
+            error += "[" + node.id + "] " + reply.error_msg + "; ";
+        }
+        return reply.success;
+    };
 
-        if (is_global_aggregate && !aggregated_rows.empty()) {
-            std::vector<common::Value> final_vals(agg_types.size(), common::Value::make_null());
-            std::vector<bool> initialized(agg_types.size(), false);
-
-            for (const auto& row : aggregated_rows) {
-                if (row.size() < agg_types.size()) continue;
-                for (size_t i = 0; i < agg_types.size(); ++i) {
-                    if (agg_types[i].empty()) continue;
-
-                    const auto& val = row.get(i);
-                    if (val.is_null()) continue;
+    uint64_t moved = 0;
+    std::string errors;
 
-                    if (!initialized[i]) {
-                        final_vals[i] = val;
-                        initialized[i] = true;
-                        continue;
-                    }
+    /*
+     * A replicated table stays whole on every node. Nodes holding fewer rows
+     * than the fullest one, such as nodes added since, get its rows instead.
+     */
+    const auto copy_replicas = [&](const TableInfo& table, std::vector<NodeCall>& scans) {
+        std::vector<std::optional<network::QueryResultsReply>> replies(data_nodes.size());
+        size_t fullest = data_nodes.size();
+        for (size_t i = 0; i < data_nodes.size(); ++i) {
+            auto result = scans[i].connected ? scans[i].reply.get() : network::RpcResult{};
+            auto reply = result.ok ? network::QueryResultsReply::deserialize(result.response)
+                                   : network::QueryResultsReply{};
+            if (!reply.success) {
+                errors += "[" + data_nodes[i].id + "] Scan of " + table.name +
+                          " failed: " + reply.error_msg + "; ";
+                continue;
+            }
+            if (fullest == data_nodes.size() ||
+                reply.rows.size() > replies[fullest]->rows.size()) {
+                fullest = i;
+            }
+            replies[i] = std::move(reply);
+        }
+        if (fullest == data_nodes.size()) {
+            return uint64_t{0};
+        }
 
-                    if (agg_types[i] == "COUNT" || agg_types[i] == "SUM") {
-                        int64_t current = final_vals[i].to_int64();
-                        int64_t added = val.to_int64();
-                        final_vals[i] = common::Value::make_int64(current + added);
-                    } else if (agg_types[i] == "MIN") {
-                        if (val < final_vals[i]) final_vals[i] = val;
-                    } else if (agg_types[i] == "MAX") {
-                        if (final_vals[i] < val) final_vals[i] = val;
-                    }
+        std::vector<const executor::Tuple*> rows;
+        for (const auto& row : replies[fullest]->rows) {
+            rows.push_back(&row);
+        }
+        uint64_t copied = 0;
+        for (size_t dest = 0; dest < data_nodes.size(); ++dest) {
+            if (!replies[dest] || replies[dest]->rows.size() == rows.size() ||
+                !run_on(data_nodes[dest], "DELETE FROM " + table.name, errors)) {
+                continue;
+            }
+            for (size_t begin = 0; begin < rows.size(); begin += MOVE_BATCH_ROWS) {
+                const size_t end = std::min(rows.size(), begin + MOVE_BATCH_ROWS);
+                if (!run_on(data_nodes[dest], insert_sql(table.name, rows, begin, end), errors)) {
+                    break;
                 }
+                copied += end - begin;
             }
+        }
+        return copied;
+    };
 
-            executor::Tuple merged_tuple;
-            for (auto& v : final_vals) {
-                merged_tuple.values().push_back(std::move(v));
-            }
-            res.add_row(std::move(merged_tuple));
-        } else {
-            // Global Sorting: If ORDER BY present, re-sort the combined results
-            if (type == parser::StmtType::Select) {
-                const auto* select_stmt = dynamic_cast<const parser::SelectStatement*>(&stmt);
-                if (select_stmt != nullptr && !select_stmt->order_by().empty()) {
-                    // Simplification: only handles first ORDER BY key for POC
-                    const auto& sort_key = select_stmt->order_by()[0];
-                    std::string col_name = sort_key->to_string();
-                    size_t col_idx = res.schema().find_column(col_name);
-                    if (col_idx == static_cast<size_t>(-1)) {
-                        // try unqualified
-                        size_t dot = col_name.find_last_of('.');
-                        if (dot != std::string::npos)
-                            col_idx = res.schema().find_column(col_name.substr(dot + 1));
-                    }
+    for (const auto* table : catalog_.get_all_tables()) {
+        if (table->columns.empty()) {
+            continue;
+        }
+        std::string select_sql = "SELECT ";
+        for (size_t i = 0; i < table->columns.size(); ++i) {
+            select_sql += (i == 0 ? "" : ", ") + table->columns[i].name;
+        }
+        select_sql += " FROM " + table->name;
+        network::ExecuteFragmentArgs scan_args;
+        scan_args.sql = select_sql;
+        scan_args.context_id = context_id;
+        auto scans = call_nodes(cluster_manager_, data_nodes, network::RpcType::ExecuteFragment,
+                                scan_args.serialize());
+
+        if (table->replicated()) {
+            moved += copy_replicas(*table, scans);
+            continue;
+        }
 
-                    if (col_idx == static_cast<size_t>(-1)) {
-                        // Fallback for POC if ORDER BY key is not in projection
-                        col_idx = 0;
-                    }
+        for (size_t source = 0; source < data_nodes.size(); ++source) {
+            if (!scans[source].connected) {
+                errors += "[" + data_nodes[source].id + "] Connect failed; ";
+                continue;
+            }
+            auto result = scans[source].reply.get();
+            auto reply = result.ok ? network::QueryResultsReply::deserialize(result.response)
+                                   : network::QueryResultsReply{};
+            if (!reply.success) {
+                errors += "[" + data_nodes[source].id + "] Scan of " + table->name +
+                          " failed: " + reply.error_msg + "; ";
+                continue;
+            }
 
-                    if (col_idx != static_cast<size_t>(-1) &&
-                        col_idx < res.schema().columns().size()) {
-                        std::sort(aggregated_rows.begin(), aggregated_rows.end(),
-                                  [col_idx](const auto& a, const auto& b) {
-                                      return a.get(col_idx) < b.get(col_idx);
-                                  });
-                    }
+            /* Rows whose key another node owns now, by destination */
+            std::unordered_map<uint32_t, std::vector<const executor::Tuple*>> outgoing;
+            for (const auto& row : reply.rows) {
+                if (row.empty()) continue;
+                const auto dest = placement.shard_of(row.get(0));
+                if (dest && *dest != source) {
+                    outgoing[*dest].push_back(&row);
                 }
             }
 
-            // Global Limit/Offset
-            if (type == parser::StmtType::Select) {
-                const auto* sel = dynamic_cast<const parser::SelectStatement*>(&stmt);
-                if (sel && (sel->has_limit() || sel->has_offset())) {
-                    int64_t limit = sel->limit();
-                    int64_t offset = sel->offset();
-
-                    if (offset > 0) {
-                        if (static_cast<size_t>(offset) >= aggregated_rows.size()) {
-                            aggregated_rows.clear();
-                        } else {
-                            aggregated_rows.erase(aggregated_rows.begin(),
-                                                  aggregated_rows.begin() + offset);
-                        }
+            for (const auto& [dest, rows] : outgoing) {
+                for (size_t begin = 0; begin < rows.size(); begin += MOVE_BATCH_ROWS) {
+                    const size_t end = std::min(rows.size(), begin + MOVE_BATCH_ROWS);
+                    std::string keys;
+                    for (size_t r = begin; r < end; ++r) {
+                        keys += (r == begin ? "" : ", ") + sql_literal(rows[r]->get(0));
                     }
-
-                    if (limit >= 0 && static_cast<size_t>(limit) < aggregated_rows.size()) {
-                        aggregated_rows.resize(limit);
+                    /* Copy first: until the delete the row is on both nodes, never on neither */
+                    if (!run_on(data_nodes[dest], insert_sql(table->name, rows, begin, end),
+                                errors)) {
+                        break;
+                    }
+                    const std::string delete_sql = "DELETE FROM " + table->name + " WHERE " +
+                                                   table->columns.front().name + " IN (" + keys +
+                                                   ")";
+                    if (!run_on(data_nodes[source], delete_sql, errors)) {
+                        break;
                     }
+                    moved += end - begin;
                 }
             }
-
-            for (auto& row : aggregated_rows) {
-                res.add_row(std::move(row));
-            }
         }
-        return res;
     }
 
-    QueryResult res;
-    res.set_error(errors);
+    if (!errors.empty()) {
+        res.set_error("Rebalance incomplete, shard ring left migrating: " + errors);
+        res.set_rows_affected(moved);
+        return res;
+    }
+    ring.migrating = false;
+    catalog_.set_shard_ring(std::move(ring));
+    std::cerr << "--- [DistributedExecutor] Rebalanced " << moved << " rows over "
+              << data_nodes.size() << " nodes ---" << std::endl;
+    res.set_rows_affected(moved);
     return res;
 }
 
+void DistributedExecutor::set_read_options(network::ExecuteFragmentArgs& args) const {
+    args.read_consistency = read_settings_.consistency;
+    args.max_staleness_ms = static_cast<uint32_t>(read_settings_.max_staleness.count());
+}
+
+void DistributedExecutor::add_participant(const cluster::NodeInfo& node, bool writes) {
+    const auto it = std::find_if(participants_.begin(), participants_.end(),
+                                 [&node](const auto& p) { return p.node.id == node.id; });
+    if (it == participants_.end()) {
+        participants_.push_back({node, writes});
+    } else {
+        it->wrote = it->wrote || writes;
+    }
+}
+
+std::vector<DistributedExecutor::Participant> DistributedExecutor::take_participants(
+    const std::vector<cluster::NodeInfo>& data_nodes) {
+    std::vector<Participant> participants;
+    if (participants_.empty() && !begun_) {
+        /* Nothing is known about the transaction; every node may have written */
+        for (const auto& node : data_nodes) {
+            participants.push_back({node, true});
+        }
+    } else {
+        participants = std::move(participants_);
+    }
+    participants_.clear();
+    begun_ = false;
+    return participants;
+}
+
 bool DistributedExecutor::broadcast_table(const std::string& table_name) {
     auto data_nodes = cluster_manager_.get_data_nodes();
     if (data_nodes.empty()) {
@@ -663,19 +1764,21 @@ bool DistributedExecutor::broadcast_table(const std::string& table_name) {
     fetch_args.sql = "SELECT * FROM " + table_name;
     fetch_args.context_id = context_id;
     fetch_args.is_fetch_all = true;
+    set_read_options(fetch_args);
     auto fetch_payload = fetch_args.serialize();
 
     std::vector<executor::Tuple> all_rows;
-    for (const auto& node : data_nodes) {
-        network::RpcClient client(node.address, node.cluster_port);
-        if (client.connect()) {
-            std::vector<uint8_t> resp_payload;
-            if (client.call(network::RpcType::ExecuteFragment, fetch_payload, resp_payload)) {
-                auto reply = network::QueryResultsReply::deserialize(resp_payload);
-                if (reply.success) {
-                    all_rows.insert(all_rows.end(), std::make_move_iterator(reply.rows.begin()),
-                                    std::make_move_iterator(reply.rows.end()));
-                }
+    for (auto& call : call_nodes(cluster_manager_, data_nodes, network::RpcType::ExecuteFragment,
+                                 fetch_payload)) {
+        if (!call.connected) {
+            continue;
+        }
+        auto result = call.reply.get();
+        if (result.ok) {
+            auto reply = network::QueryResultsReply::deserialize(result.response);
+            if (reply.success) {
+                all_rows.insert(all_rows.end(), std::make_move_iterator(reply.rows.begin()),
+                                std::make_move_iterator(reply.rows.end()));
             }
         }
     }
@@ -689,14 +1792,23 @@ bool DistributedExecutor::broadcast_table(const std::string& table_name) {
     push_args.context_id = context_id;  // Data nodes will look for this context
     push_args.table_name = table_name;
     push_args.rows = std::move(all_rows);
-    auto push_payload = push_args.serialize();
-
+    /* Each node gets the encoding its connection has settled on, built once per encoding */
+    std::array<std::vector<uint8_t>, 2> payloads;
+    std::vector<std::future<network::RpcResult>> pushes;
     for (const auto& node : data_nodes) {
-        network::RpcClient client(node.address, node.cluster_port);
-        if (client.connect()) {
-            std::vector<uint8_t> resp_payload;
-            static_cast<void>(client.call(network::RpcType::PushData, push_payload, resp_payload));
+        auto client = cluster_manager_.get_client(node);
+        if (!client) {
+            continue;
+        }
+        const bool columnar = client->peer_accepts(network::RpcHeader::FLAG_ACCEPT_COLUMNAR);
+        auto& payload = payloads[columnar ? 1 : 0];
+        if (payload.empty()) {
+            payload = push_args.serialize(columnar);
         }
+        pushes.push_back(client->call_async(network::RpcType::PushData, payload));
+    }
+    for (auto& push : pushes) {
+        static_cast<void>(push.get());
     }
 
     return true;
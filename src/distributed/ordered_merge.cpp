@@ -0,0 +1,204 @@
+/**
+ * @file ordered_merge.cpp
+ * @brief Pushes ORDER BY and LIMIT into fragments and merges the sorted node results
+ */
+
+#include "distributed/ordered_merge.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "executor/compiled_expression.hpp"
+#include "executor/group_key_table.hpp"
+#include "executor/operator.hpp"
+#include "executor/types.hpp"
+#include "parser/expression.hpp"
+#include "parser/statement.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+constexpr size_t NPOS = static_cast<size_t>(-1);
+
+bool has_aggregate(const parser::Expression& expr) {
+    switch (expr.type()) {
+        case parser::ExprType::Binary: {
+            const auto& bin = static_cast<const parser::BinaryExpr&>(expr);
+            return has_aggregate(bin.left()) || has_aggregate(bin.right());
+        }
+        case parser::ExprType::Unary:
+            return has_aggregate(static_cast<const parser::UnaryExpr&>(expr).expr());
+        case parser::ExprType::Function: {
+            const auto& func = static_cast<const parser::FunctionExpr&>(expr);
+            std::string name = func.name();
+            std::transform(name.begin(), name.end(), name.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+            if (name == "COUNT" || name == "SUM" || name == "MIN" || name == "MAX" ||
+                name == "AVG") {
+                return true;
+            }
+            return std::any_of(func.args().begin(), func.args().end(),
+                               [](const auto& arg) { return has_aggregate(*arg); });
+        }
+        default:
+            return false;
+    }
+}
+
+/** @brief Head of one node's sorted rows during the merge */
+struct Cursor {
+    std::string key;
+    size_t node = 0;
+    size_t pos = 0;
+
+    /* Min-heap on the key; the node index keeps ties in node order, as a stable sort would */
+    bool operator>(const Cursor& other) const {
+        if (key != other.key) {
+            return key > other.key;
+        }
+        return node > other.node;
+    }
+};
+
+}  // namespace
+
+std::optional<OrderedMerge> OrderedMerge::plan(const parser::SelectStatement& stmt) {
+    if (stmt.order_by().empty() && !stmt.has_limit()) {
+        return std::nullopt;
+    }
+    if (stmt.from() == nullptr || !stmt.group_by().empty() || stmt.having() != nullptr) {
+        return std::nullopt;
+    }
+    const auto aggregates = [](const auto& exprs) {
+        return std::any_of(exprs.begin(), exprs.end(),
+                           [](const auto& e) { return has_aggregate(*e); });
+    };
+    if (aggregates(stmt.columns()) || aggregates(stmt.order_by())) {
+        return std::nullopt;
+    }
+
+    OrderedMerge plan(stmt);
+    parser::SelectStatement fragment;
+    fragment.set_distinct(stmt.distinct());
+    for (const auto& col : stmt.columns()) {
+        fragment.add_column(col->clone());
+    }
+    plan.width_ = stmt.columns().size();
+    for (const auto& key : stmt.order_by()) {
+        size_t column = NPOS;
+        /* Extra columns would change what DISTINCT compares; its keys must be selected */
+        if (!stmt.distinct()) {
+            const std::string text = key->to_string();
+            for (size_t i = 0; i < stmt.columns().size(); ++i) {
+                if (stmt.columns()[i]->to_string() == text) {
+                    column = i;
+                    break;
+                }
+            }
+            if (column == NPOS) {
+                column = fragment.columns().size();
+                fragment.add_column(key->clone());
+            }
+        }
+        plan.key_columns_.push_back(column);
+        fragment.add_order_by(key->clone());
+    }
+
+    fragment.add_from(stmt.from()->clone());
+    for (const auto& join : stmt.joins()) {
+        fragment.add_join(join.type, join.table->clone(),
+                          join.condition ? join.condition->clone() : nullptr);
+    }
+    if (stmt.where() != nullptr) {
+        fragment.set_where(stmt.where()->clone());
+    }
+    /* A node's rows past offset + limit cannot reach the result */
+    if (stmt.has_limit()) {
+        fragment.set_limit(stmt.limit() + std::max<int64_t>(stmt.offset(), 0));
+    }
+    plan.fragment_sql_ = fragment.to_string();
+    return plan;
+}
+
+QueryResult OrderedMerge::finish(const Schema& fragment_schema,
+                                 std::vector<std::vector<Tuple>> node_rows) const {
+    Schema schema;
+    for (size_t i = 0; i < width_ && i < fragment_schema.column_count(); ++i) {
+        const auto& col = fragment_schema.get_column(i);
+        schema.add_column(col.name(), col.type());
+    }
+    std::vector<std::optional<CompiledExpression>> evaluated(key_columns_.size());
+    for (size_t k = 0; k < key_columns_.size(); ++k) {
+        if (key_columns_[k] == NPOS) {
+            evaluated[k].emplace(*stmt_->order_by()[k], schema);
+        }
+    }
+    const auto make_key = [&](const Tuple& row) {
+        std::string key;
+        for (size_t k = 0; k < key_columns_.size(); ++k) {
+            const size_t column = key_columns_[k];
+            const bool present = column != NPOS && column < row.size();
+            SortOperator::encode_sort_key(
+                present ? row.get(column)
+                        : (evaluated[k] ? evaluated[k]->evaluate(row) : common::Value::make_null()),
+                true, key);
+        }
+        return key;
+    };
+
+    std::priority_queue<Cursor, std::vector<Cursor>, std::greater<>> heads;
+    for (size_t node = 0; node < node_rows.size(); ++node) {
+        if (!node_rows[node].empty()) {
+            heads.push(Cursor{make_key(node_rows[node].front()), node, 0});
+        }
+    }
+
+    auto skip = static_cast<size_t>(std::max<int64_t>(stmt_->offset(), 0));
+    const size_t limit = stmt_->has_limit() ? static_cast<size_t>(stmt_->limit()) : NPOS;
+    std::unordered_set<std::string> seen; /* Rows already out, for DISTINCT across nodes */
+    QueryResult result;
+    result.set_schema(schema);
+    size_t emitted = 0;
+    while (!heads.empty() && emitted < limit) {
+        Cursor head = heads.top();
+        heads.pop();
+        auto& rows = node_rows[head.node];
+        Tuple row = std::move(rows[head.pos]);
+        if (++head.pos < rows.size()) {
+            head.key = make_key(rows[head.pos]);
+            heads.push(std::move(head));
+        }
+
+        auto& values = row.values();
+        if (values.size() > width_) {
+            values.resize(width_);
+        }
+        if (stmt_->distinct()) {
+            std::string text;
+            for (const auto& value : values) {
+                GroupKeyTable::append_key(value, text);
+            }
+            if (!seen.insert(std::move(text)).second) {
+                continue;
+            }
+        }
+        if (skip > 0) {
+            --skip;
+            continue;
+        }
+        result.add_row(std::move(row));
+        ++emitted;
+    }
+    return result;
+}
+
+}  // namespace cloudsql::executor
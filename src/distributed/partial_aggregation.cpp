@@ -0,0 +1,343 @@
+/**
+ * @file partial_aggregation.cpp
+ * @brief Splits an aggregate SELECT into per-node partial aggregation and a final merge
+ */
+
+#include "distributed/partial_aggregation.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/value.hpp"
+#include "executor/compiled_expression.hpp"
+#include "executor/group_key_table.hpp"
+#include "executor/types.hpp"
+#include "parser/expression.hpp"
+#include "parser/statement.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+std::string upper(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    return s;
+}
+
+/**
+ * @brief Collects the aggregate calls in `expr` and the columns it reads outside of them
+ * @return false if `expr` holds something the coordinator cannot evaluate after the merge
+ */
+bool collect(const parser::Expression& expr, std::vector<const parser::FunctionExpr*>& aggs,
+             std::vector<const parser::ColumnExpr*>& columns) {
+    switch (expr.type()) {
+        case parser::ExprType::Column:
+            columns.push_back(static_cast<const parser::ColumnExpr*>(&expr));
+            return true;
+        case parser::ExprType::Constant:
+            return true;
+        case parser::ExprType::Binary: {
+            const auto& bin = static_cast<const parser::BinaryExpr&>(expr);
+            return collect(bin.left(), aggs, columns) && collect(bin.right(), aggs, columns);
+        }
+        case parser::ExprType::Unary:
+            return collect(static_cast<const parser::UnaryExpr&>(expr).expr(), aggs, columns);
+        case parser::ExprType::Function: {
+            const auto& func = static_cast<const parser::FunctionExpr&>(expr);
+            const std::string name = upper(func.name());
+            if (name != "COUNT" && name != "SUM" && name != "MIN" && name != "MAX" &&
+                name != "AVG") {
+                return false;
+            }
+            if (func.distinct() || func.args().size() > 1) {
+                return false; /* A distinct count does not add up across nodes */
+            }
+            aggs.push_back(&func);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+std::unique_ptr<parser::FunctionExpr> partial_call(const std::string& name,
+                                                   const parser::FunctionExpr& func) {
+    auto call = std::make_unique<parser::FunctionExpr>(name);
+    for (const auto& arg : func.args()) {
+        call->add_arg(arg->clone());
+    }
+    return call;
+}
+
+/** @brief Folds a partial value into an accumulator; NULL partials count as nothing */
+void merge_value(common::Value& acc, const common::Value& val, bool count, bool sum, bool min) {
+    if (val.is_null()) {
+        return;
+    }
+    if (acc.is_null()) {
+        acc = val;
+    } else if (count) {
+        acc = common::Value::make_int64(acc.to_int64() + val.to_int64());
+    } else if (sum) {
+        acc = common::Value::make_float64(acc.to_float64() + val.to_float64());
+    } else if (min ? val < acc : acc < val) {
+        acc = val;
+    }
+}
+
+}  // namespace
+
+std::optional<PartialAggregation> PartialAggregation::plan(const parser::SelectStatement& stmt) {
+    if (stmt.distinct() || stmt.from() == nullptr) {
+        return std::nullopt;
+    }
+    std::vector<const parser::FunctionExpr*> calls;
+    std::vector<const parser::ColumnExpr*> columns;
+    for (const auto& col : stmt.columns()) {
+        if (!collect(*col, calls, columns)) {
+            return std::nullopt;
+        }
+    }
+    const bool has_aggregates = !calls.empty();
+    if (stmt.having() != nullptr && !collect(*stmt.having(), calls, columns)) {
+        return std::nullopt;
+    }
+    for (const auto& key : stmt.order_by()) {
+        if (!collect(*key, calls, columns)) {
+            return std::nullopt;
+        }
+    }
+    if (!has_aggregates && stmt.group_by().empty()) {
+        return std::nullopt;
+    }
+
+    PartialAggregation plan(stmt);
+    parser::SelectStatement partial;
+    Schema merged; /* Names only: what the remaining clauses resolve against */
+    for (const auto& key : stmt.group_by()) {
+        if (key->type() != parser::ExprType::Column) {
+            return std::nullopt;
+        }
+        partial.add_column(key->clone());
+        partial.add_group_by(key->clone());
+        merged.add_column(key->to_string(), common::ValueType::TYPE_NULL);
+    }
+    plan.key_count_ = stmt.group_by().size();
+    for (const auto* column : columns) {
+        if (merged.find_column(column->to_string()) == static_cast<size_t>(-1) &&
+            merged.find_column(column->name()) == static_cast<size_t>(-1)) {
+            return std::nullopt; /* Not a group key: the selected value differs per row */
+        }
+    }
+
+    size_t next_partial = plan.key_count_;
+    for (const auto* call : calls) {
+        const std::string text = call->to_string();
+        const bool seen = std::any_of(plan.aggregates_.begin(), plan.aggregates_.end(),
+                                      [&text](const Aggregate& a) { return a.name == text; });
+        if (seen) {
+            continue;
+        }
+        Aggregate agg;
+        agg.name = text;
+        agg.partial = next_partial;
+        const std::string name = upper(call->name());
+        if (name == "AVG") {
+            agg.merge = Merge::Avg;
+            partial.add_column(partial_call("SUM", *call));
+            partial.add_column(partial_call("COUNT", *call));
+            next_partial += 2;
+        } else {
+            agg.merge = name == "COUNT" ? Merge::Count
+                        : name == "SUM" ? Merge::Sum
+                        : name == "MIN" ? Merge::Min
+                                        : Merge::Max;
+            partial.add_column(partial_call(name, *call));
+            next_partial++;
+        }
+        plan.aggregates_.push_back(std::move(agg));
+    }
+
+    partial.add_from(stmt.from()->clone());
+    for (const auto& join : stmt.joins()) {
+        partial.add_join(join.type, join.table->clone(),
+                         join.condition ? join.condition->clone() : nullptr);
+    }
+    if (stmt.where() != nullptr) {
+        partial.set_where(stmt.where()->clone());
+    }
+    plan.partial_sql_ = partial.to_string();
+    return plan;
+}
+
+QueryResult PartialAggregation::finish(const Schema& partial_schema,
+                                       const std::vector<Tuple>& partial_rows) const {
+    /* 1. Merge: one accumulator per partial column of every group */
+    const size_t width = aggregates_.empty()
+                             ? key_count_
+                             : aggregates_.back().partial +
+                                   (aggregates_.back().merge == Merge::Avg ? 2 : 1);
+    std::vector<Merge> merges(width, Merge::Min);
+    for (const auto& agg : aggregates_) {
+        merges[agg.partial] = agg.merge == Merge::Avg ? Merge::Sum : agg.merge;
+        if (agg.merge == Merge::Avg) {
+            merges[agg.partial + 1] = Merge::Count;
+        }
+    }
+
+    GroupKeyTable groups;
+    std::vector<std::vector<common::Value>> states;
+    std::string key;
+    for (const auto& row : partial_rows) {
+        if (row.size() < width) {
+            continue;
+        }
+        key.clear();
+        for (size_t i = 0; i < key_count_; ++i) {
+            GroupKeyTable::append_key(row.get(i), key);
+        }
+        const auto [id, inserted] = groups.insert(key, GroupKeyTable::hash_key(key));
+        if (inserted) {
+            states.emplace_back(width, common::Value::make_null());
+            for (size_t i = 0; i < key_count_; ++i) {
+                states[id][i] = row.get(i);
+            }
+        }
+        auto& state = states[id];
+        for (size_t i = key_count_; i < width; ++i) {
+            merge_value(state[i], row.get(i), merges[i] == Merge::Count, merges[i] == Merge::Sum,
+                        merges[i] == Merge::Min);
+        }
+    }
+    /* Without GROUP BY there is exactly one group, even over no rows */
+    if (key_count_ == 0 && states.empty()) {
+        states.emplace_back(width, common::Value::make_null());
+    }
+
+    /* 2. Rows of the grouped relation: keys, then one column per aggregate */
+    Schema merged;
+    for (size_t i = 0; i < key_count_; ++i) {
+        const auto type = i < partial_schema.column_count() ? partial_schema.get_column(i).type()
+                                                             : common::ValueType::TYPE_TEXT;
+        merged.add_column(stmt_->group_by()[i]->to_string(), type);
+    }
+    for (const auto& agg : aggregates_) {
+        common::ValueType type = common::ValueType::TYPE_FLOAT64;
+        if (agg.merge == Merge::Count) {
+            type = common::ValueType::TYPE_INT64;
+        } else if ((agg.merge == Merge::Min || agg.merge == Merge::Max) &&
+                   agg.partial < partial_schema.column_count()) {
+            type = partial_schema.get_column(agg.partial).type();
+        }
+        merged.add_column(agg.name, type);
+    }
+
+    std::vector<Tuple> rows;
+    rows.reserve(states.size());
+    for (auto& state : states) {
+        std::vector<common::Value> values(std::make_move_iterator(state.begin()),
+                                          std::make_move_iterator(state.begin() + key_count_));
+        for (const auto& agg : aggregates_) {
+            auto& acc = state[agg.partial];
+            switch (agg.merge) {
+                case Merge::Count:
+                    values.push_back(acc.is_null() ? common::Value::make_int64(0) : acc);
+                    break;
+                case Merge::Avg: {
+                    const auto& count = state[agg.partial + 1];
+                    if (acc.is_null() || count.is_null() || count.to_int64() == 0) {
+                        values.push_back(common::Value::make_null());
+                    } else {
+                        values.push_back(common::Value::make_float64(
+                            acc.to_float64() / static_cast<double>(count.to_int64())));
+                    }
+                    break;
+                }
+                default:
+                    values.push_back(acc);
+                    break;
+            }
+        }
+        rows.emplace_back(std::move(values));
+    }
+
+    /* 3. HAVING, ORDER BY and LIMIT/OFFSET, as the local plan applies them */
+    if (stmt_->having() != nullptr) {
+        const CompiledExpression having(*stmt_->having(), merged);
+        rows.erase(std::remove_if(rows.begin(), rows.end(),
+                                  [&having](const Tuple& row) { return !having.test(row); }),
+                   rows.end());
+    }
+    if (!stmt_->order_by().empty()) {
+        std::vector<CompiledExpression> keys;
+        for (const auto& ob : stmt_->order_by()) {
+            keys.emplace_back(*ob, merged);
+        }
+        std::stable_sort(rows.begin(), rows.end(), [&keys](const Tuple& a, const Tuple& b) {
+            for (const auto& k : keys) {
+                const common::Value va = k.evaluate(a);
+                const common::Value vb = k.evaluate(b);
+                if (va < vb) return true;
+                if (vb < va) return false;
+            }
+            return false;
+        });
+    } else {
+        /* Groups come out ordered by the text of their keys, like AggregateOperator's */
+        std::vector<std::pair<std::string, size_t>> order;
+        order.reserve(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            std::string text;
+            for (size_t k = 0; k < key_count_; ++k) text += rows[i].get(k).to_string() + "|";
+            order.emplace_back(std::move(text), i);
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::vector<Tuple> sorted;
+        sorted.reserve(rows.size());
+        for (const auto& entry : order) sorted.push_back(std::move(rows[entry.second]));
+        rows = std::move(sorted);
+    }
+    const auto offset = static_cast<size_t>(std::max<int64_t>(stmt_->offset(), 0));
+    rows.erase(rows.begin(), rows.begin() + static_cast<std::ptrdiff_t>(
+                                                std::min(offset, rows.size())));
+    if (stmt_->has_limit() && static_cast<size_t>(stmt_->limit()) < rows.size()) {
+        rows.resize(static_cast<size_t>(stmt_->limit()));
+    }
+
+    /* 4. Project the SELECT list */
+    QueryResult result;
+    Schema schema;
+    std::vector<CompiledExpression> projection;
+    for (const auto& col : stmt_->columns()) {
+        common::ValueType type = common::ValueType::TYPE_FLOAT64;
+        size_t idx = merged.find_column(col->to_string());
+        if (idx == static_cast<size_t>(-1) && col->type() == parser::ExprType::Column) {
+            idx = merged.find_column(static_cast<const parser::ColumnExpr&>(*col).name());
+        }
+        if (idx != static_cast<size_t>(-1)) {
+            type = merged.get_column(idx).type();
+        }
+        schema.add_column(col->to_string(), type);
+        projection.emplace_back(*col, merged);
+    }
+    result.set_schema(schema);
+    for (const auto& row : rows) {
+        std::vector<common::Value> values;
+        values.reserve(projection.size());
+        for (const auto& expr : projection) {
+            values.push_back(expr.evaluate(row));
+        }
+        result.add_row(Tuple(std::move(values)));
+    }
+    return result;
+}
+
+}  // namespace cloudsql::executor
@@ -5,27 +5,50 @@
 
 #include "distributed/raft_group.hpp"
 
-#include <sys/socket.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
 #include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
 #include <cstring>
+#include <functional>
 #include <fstream>
 #include <iostream>
 #include <mutex>
 #include <random>
+#include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 namespace cloudsql::raft {
 
 namespace {
-constexpr int TIMEOUT_MIN_MS = 150;
+constexpr int TIMEOUT_MIN_MS = RaftGroup::ELECTION_TIMEOUT_MIN_MS;
 constexpr int TIMEOUT_MAX_MS = 300;
-constexpr int HEARTBEAT_INTERVAL_MS = 50;
-constexpr int ELECTION_RETRY_MS = 100;
+constexpr int HEARTBEAT_INTERVAL_MS = RaftGroup::HEARTBEAT_INTERVAL_MS;
 constexpr size_t VOTE_REPLY_SIZE = 9;
-constexpr size_t APPEND_REPLY_SIZE = 9;
+constexpr size_t APPEND_REPLY_SIZE = 17;
+constexpr int STATE_FILE_MODE = 0644;
+constexpr size_t APPEND_HEADER_SIZE = 48;
+constexpr size_t ENTRY_HEADER_SIZE = 24;
+constexpr size_t MAX_BATCH_ENTRIES = 64;  // Entries per AppendEntries
+constexpr size_t MAX_IN_FLIGHT = 4;       // AppendEntries outstanding per follower
+constexpr int PIPELINE_TIMEOUT_MS = 1000; // Silence after which a follower's window restarts
+constexpr size_t SNAPSHOT_HEADER_SIZE = 16;             // [last_index][last_term]
+constexpr size_t SNAPSHOT_CHUNK_BYTES = 64 * 1024;      // Per InstallSnapshot
+constexpr size_t INSTALL_HEADER_SIZE = 49;              // Before the id and the chunk
+constexpr size_t INSTALL_REPLY_SIZE = 17;               // [term][installed][stored]
+constexpr int STORAGE_DIR_MODE = 0755;
+/* Followers withhold votes for TIMEOUT_MIN_MS after hearing from the leader; the lease
+ * ends earlier, as bounded clock drift could make theirs run faster */
+constexpr int LEASE_MS = TIMEOUT_MIN_MS * 4 / 5;
+constexpr int READ_TIMEOUT_MS = 1000;
+constexpr size_t READ_INDEX_REPLY_SIZE = 9;  // [ok:1][index]
 
 /**
  * @brief Simple helper to serialize a LogEntry
@@ -58,21 +81,146 @@ LogEntry deserialize_entry(const uint8_t* data, size_t& offset, size_t size) {
     return entry;
 }
 
+/**
+ * @brief Serialize AppendEntries arguments:
+ * [term][id_len][id][prev_log_index][prev_log_term][leader_commit][count][entries...]
+ */
+std::vector<uint8_t> serialize_append_entries(const AppendEntriesArgs& args) {
+    const uint64_t id_len = args.leader_id.size();
+    std::vector<uint8_t> out(APPEND_HEADER_SIZE + id_len);
+    std::memcpy(out.data(), &args.term, 8);
+    std::memcpy(out.data() + 8, &id_len, 8);
+    std::memcpy(out.data() + 16, args.leader_id.data(), id_len);
+    std::memcpy(out.data() + 16 + id_len, &args.prev_log_index, 8);
+    std::memcpy(out.data() + 24 + id_len, &args.prev_log_term, 8);
+    std::memcpy(out.data() + 32 + id_len, &args.leader_commit, 8);
+    const uint64_t count = args.entries.size();
+    std::memcpy(out.data() + 40 + id_len, &count, 8);
+    for (const auto& entry : args.entries) {
+        serialize_entry(entry, out);
+    }
+    return out;
+}
+
+/**
+ * @brief Deserialize AppendEntries arguments
+ * @return false if the payload is shorter than the arguments it announces
+ */
+bool deserialize_append_entries(const std::vector<uint8_t>& payload, AppendEntriesArgs& args) {
+    if (payload.size() < APPEND_HEADER_SIZE) return false;
+    uint64_t id_len = 0;
+    std::memcpy(&args.term, payload.data(), 8);
+    std::memcpy(&id_len, payload.data() + 8, 8);
+    if (payload.size() - APPEND_HEADER_SIZE < id_len) return false;
+
+    args.leader_id.assign(reinterpret_cast<const char*>(payload.data() + 16), id_len);
+    std::memcpy(&args.prev_log_index, payload.data() + 16 + id_len, 8);
+    std::memcpy(&args.prev_log_term, payload.data() + 24 + id_len, 8);
+    std::memcpy(&args.leader_commit, payload.data() + 32 + id_len, 8);
+    uint64_t count = 0;
+    std::memcpy(&count, payload.data() + 40 + id_len, 8);
+
+    size_t offset = APPEND_HEADER_SIZE + id_len;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t data_len = 0;
+        if (payload.size() - offset < ENTRY_HEADER_SIZE) return false;
+        std::memcpy(&data_len, payload.data() + offset + 16, 8);
+        if (payload.size() - offset - ENTRY_HEADER_SIZE < data_len) return false;
+        args.entries.push_back(deserialize_entry(payload.data(), offset, payload.size()));
+    }
+    return true;
+}
+
+/**
+ * @brief Serialize InstallSnapshot arguments:
+ * [term][id_len][id][last_index][last_term][offset][done:1][data_len][data]
+ */
+std::vector<uint8_t> serialize_install_snapshot(const InstallSnapshotArgs& args) {
+    const uint64_t id_len = args.leader_id.size();
+    const uint64_t data_len = args.data.size();
+    std::vector<uint8_t> out(INSTALL_HEADER_SIZE + id_len + data_len);
+    std::memcpy(out.data(), &args.term, 8);
+    std::memcpy(out.data() + 8, &id_len, 8);
+    std::memcpy(out.data() + 16, args.leader_id.data(), id_len);
+    std::memcpy(out.data() + 16 + id_len, &args.last_included_index, 8);
+    std::memcpy(out.data() + 24 + id_len, &args.last_included_term, 8);
+    std::memcpy(out.data() + 32 + id_len, &args.offset, 8);
+    out[40 + id_len] = args.done ? 1 : 0;
+    std::memcpy(out.data() + 41 + id_len, &data_len, 8);
+    if (data_len > 0) {
+        std::memcpy(out.data() + INSTALL_HEADER_SIZE + id_len, args.data.data(), data_len);
+    }
+    return out;
+}
+
+bool deserialize_install_snapshot(const std::vector<uint8_t>& payload,
+                                  InstallSnapshotArgs& args) {
+    if (payload.size() < INSTALL_HEADER_SIZE) return false;
+    uint64_t id_len = 0;
+    std::memcpy(&args.term, payload.data(), 8);
+    std::memcpy(&id_len, payload.data() + 8, 8);
+    if (payload.size() - INSTALL_HEADER_SIZE < id_len) return false;
+
+    args.leader_id.assign(reinterpret_cast<const char*>(payload.data() + 16), id_len);
+    std::memcpy(&args.last_included_index, payload.data() + 16 + id_len, 8);
+    std::memcpy(&args.last_included_term, payload.data() + 24 + id_len, 8);
+    std::memcpy(&args.offset, payload.data() + 32 + id_len, 8);
+    args.done = payload[40 + id_len] != 0;
+    uint64_t data_len = 0;
+    std::memcpy(&data_len, payload.data() + 41 + id_len, 8);
+    if (payload.size() - INSTALL_HEADER_SIZE - id_len != data_len) return false;
+    const uint8_t* data = payload.data() + INSTALL_HEADER_SIZE + id_len;
+    args.data.assign(data, data + data_len);
+    return true;
+}
+
+/** @brief Flush a file written through a stream, which has no descriptor of its own */
+bool sync_file(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    const bool synced = ::fdatasync(fd) == 0;
+    static_cast<void>(::close(fd));
+    return synced;
+}
+
+bool read_snapshot_header(const std::string& path, index_t& index, term_t& term) {
+    std::ifstream in(path, std::ios::binary);
+    in.read(reinterpret_cast<char*>(&index), 8);
+    in.read(reinterpret_cast<char*>(&term), 8);
+    return static_cast<bool>(in);
+}
+
 }  // namespace
 
 RaftGroup::RaftGroup(uint16_t group_id, std::string node_id,
-                     cluster::ClusterManager& cluster_manager, network::RpcServer& rpc_server)
+                     cluster::ClusterManager& cluster_manager, network::RpcServer& rpc_server,
+                     const std::string& storage_dir)
     : group_id_(group_id),
       node_id_(std::move(node_id)),
+      storage_prefix_((storage_dir.empty() ? "" : storage_dir + "/") + "raft_group_" +
+                      std::to_string(group_id)),
       cluster_manager_(cluster_manager),
       rpc_server_(rpc_server),
+      log_(storage_prefix_ + ".log"),
+      reply_link_(std::make_shared<ReplyLink>()),
       rng_(std::random_device{}()) {
-    last_heartbeat_ = std::chrono::system_clock::now();
+    reply_link_->group = this;
+    last_heartbeat_ = std::chrono::steady_clock::now();
+    election_timeout_ = get_random_timeout();
+    if (!storage_dir.empty() && ::mkdir(storage_dir.c_str(), STORAGE_DIR_MODE) != 0 &&
+        errno != EEXIST) {
+        std::cerr << "--- [RaftGroup] cannot create " << storage_dir << " ---" << std::endl;
+    }
     load_state();
+    metrics_ = common::MetricsRegistry::global().add_collector(
+        [this](common::MetricsSnapshot& out) { collect_metrics(out); });
 }
 
 RaftGroup::~RaftGroup() {
     stop();
+    /* Waits out a reply being handled; later ones find the link empty */
+    const std::scoped_lock<std::mutex> lock(reply_link_->mutex);
+    reply_link_->group = nullptr;
 }
 
 void RaftGroup::start() {
@@ -80,8 +228,18 @@ void RaftGroup::start() {
     raft_thread_ = std::thread(&RaftGroup::run_loop, this);
 }
 
+void RaftGroup::attach(Driver* driver) {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    driver_ = driver;
+    running_ = true;
+}
+
 void RaftGroup::stop() {
-    running_ = false;
+    {
+        const std::scoped_lock<std::mutex> lock(mutex_);
+        running_ = false;
+        driver_ = nullptr;
+    }
     cv_.notify_all();
     if (raft_thread_.joinable()) {
         raft_thread_.join();
@@ -90,118 +248,743 @@ void RaftGroup::stop() {
 
 void RaftGroup::run_loop() {
     while (running_) {
-        switch (state_.load()) {
-            case NodeState::Follower:
-                do_follower();
-                break;
-            case NodeState::Candidate:
-                do_candidate();
-                break;
-            case NodeState::Leader:
-                do_leader();
-                break;
-            case NodeState::Shutdown:
-                return;
-        }
+        const auto due = tick();
+        std::unique_lock<std::mutex> lock(mutex_);
+        /* Timers are rechecked at least this often, whatever the tick asked for */
+        const auto limit =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(TIMEOUT_MAX_MS);
+        cv_.wait_until(lock, std::min(due, limit), [this] { return !running_ || wake_pending_; });
+        wake_pending_ = false;
     }
 }
 
-void RaftGroup::do_follower() {
-    const auto timeout = get_random_timeout();
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (!cv_.wait_for(lock, timeout, [this] { return !running_; })) {
-        auto now = std::chrono::system_clock::now();
-        if (now - last_heartbeat_ >= timeout) {
-            state_ = NodeState::Candidate;
-        }
+std::chrono::steady_clock::time_point RaftGroup::tick() {
+    if (!running_) return std::chrono::steady_clock::time_point::max();
+    switch (state_.load()) {
+        case NodeState::Follower:
+            return tick_follower();
+        case NodeState::Candidate:
+            return tick_candidate();
+        case NodeState::Leader:
+            return tick_leader();
+        case NodeState::Shutdown:
+            break;
+    }
+    return std::chrono::steady_clock::time_point::max();
+}
+
+std::chrono::steady_clock::time_point RaftGroup::tick_follower() {
+    maybe_snapshot();
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    const auto now = std::chrono::steady_clock::now();
+    if (state_.load() != NodeState::Follower) return now;
+    if (dormant_) return std::chrono::steady_clock::time_point::max();
+    if (now - last_heartbeat_ >= election_timeout_) {
+        state_ = NodeState::Candidate;
+        election_deadline_ = {};
+        return now;
     }
+    return last_heartbeat_ + election_timeout_;
 }
 
-void RaftGroup::do_candidate() {
+void RaftGroup::maybe_snapshot() {
+    index_t index = 0;
+    term_t term = 0;
+    RaftStateMachine* state_machine = nullptr;
     {
         const std::scoped_lock<std::mutex> lock(mutex_);
-        persistent_state_.current_term++;
-        persistent_state_.voted_for = node_id_;
-        persist_state();
-        last_heartbeat_ = std::chrono::system_clock::now();
+        if (state_.load() != NodeState::Follower || state_machine_ == nullptr ||
+            !snapshots_supported_ || snapshot_threshold_ == 0 || restore_pending_ ||
+            volatile_state_.last_applied < snapshot_index_ + snapshot_threshold_) {
+            return;
+        }
+        /* Applies hold off until the image is written, so it matches `index` exactly */
+        snapshotting_ = true;
+        index = volatile_state_.last_applied;
+        term = term_at(index);
+        state_machine = state_machine_;
+    }
+
+    /* Written without the lock: entries keep arriving and being made durable meanwhile */
+    const std::string path = storage_path(".snap");
+    const std::string temp = path + ".tmp";
+    bool saved = false;
+    bool supported = true;
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&index), 8);
+        out.write(reinterpret_cast<const char*>(&term), 8);
+        supported = state_machine->save_snapshot(out);
+        out.flush();
+        saved = supported && static_cast<bool>(out);
+    }
+    saved = saved && sync_file(temp) && std::rename(temp.c_str(), path.c_str()) == 0;
+    if (!saved) {
+        static_cast<void>(std::remove(temp.c_str()));
     }
 
-    auto peers = cluster_manager_.get_group_members(group_id_);
-    size_t votes = 1;
-    const size_t needed = (peers.size() / 2) + 1;
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    snapshotting_ = false;
+    snapshots_supported_ = supported;
+    if (saved) {
+        snapshot_index_ = index;
+        snapshot_term_ = term;
+        stats_.snapshots_taken++;
+        if (!log_.compact(index)) {
+            std::cerr << "--- [RaftGroup] log compaction FAILED at " << index << " ---"
+                      << std::endl;
+        }
+    } else if (supported) {
+        std::cerr << "--- [RaftGroup] snapshot of group " << group_id_ << " FAILED ---"
+                  << std::endl;
+    }
+    apply_committed();
+}
+
+std::chrono::steady_clock::time_point RaftGroup::tick_candidate() {
+    {
+        const std::scoped_lock<std::mutex> lock(mutex_);
+        const auto now = std::chrono::steady_clock::now();
+        if (state_.load() != NodeState::Candidate) return now;
+        if (now < election_deadline_) return election_deadline_;
+    }
+    start_election();
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    return state_.load() == NodeState::Candidate ? election_deadline_
+                                                 : std::chrono::steady_clock::now();
+}
 
+void RaftGroup::start_election() {
+    const auto peers = cluster_manager_.get_group_members(group_id_);
     RequestVoteArgs args{};
+    bool won = false;
     {
         const std::scoped_lock<std::mutex> lock(mutex_);
+        if (state_.load() != NodeState::Candidate) return;
+        persistent_state_.current_term++;
+        persistent_state_.voted_for = node_id_;
+        persist_state();
+        const auto now = std::chrono::steady_clock::now();
+        last_heartbeat_ = now;
+        /* Randomized like the election timeout, so split candidates do not retry in step */
+        election_deadline_ = now + get_random_timeout();
+        election_timeout_ = get_random_timeout();
+
+        votes_ = {node_id_};
+        votes_needed_ = (peers.size() / 2) + 1;
+        election_peers_.clear();
+        for (const auto& peer : peers) {
+            election_peers_.push_back(peer.id);
+        }
         args.term = persistent_state_.current_term;
         args.candidate_id = node_id_;
-        args.last_log_index =
-            persistent_state_.log.empty() ? 0 : persistent_state_.log.back().index;
-        args.last_log_term = persistent_state_.log.empty() ? 0 : persistent_state_.log.back().term;
+        args.last_log_index = last_log_index();
+        args.last_log_term = term_at(args.last_log_index);
+        if (votes_.size() >= votes_needed_) {
+            become_leader();
+            won = true;
+        }
+    }
+    if (won) {
+        cluster_manager_.set_leader(group_id_, node_id_);
+        return;
     }
 
+    /* Votes are counted as they come back, on the client's reader thread */
+    const auto payload = args.serialize();
     for (const auto& peer : peers) {
         if (peer.id == node_id_) continue;
-
-        network::RpcClient client(peer.address, peer.cluster_port);
-        if (client.connect()) {
-            std::vector<uint8_t> reply_payload;
-            if (client.call(network::RpcType::RequestVote, args.serialize(), reply_payload,
-                            group_id_)) {
-                if (reply_payload.size() >= VOTE_REPLY_SIZE) {
-                    term_t resp_term = 0;
-                    std::memcpy(&resp_term, reply_payload.data(), 8);
-                    const bool granted = reply_payload[8] != 0;
-
-                    if (resp_term > args.term) {
-                        step_down(resp_term);
-                        return;
-                    }
-                    if (granted) votes++;
+        auto client = cluster_manager_.get_client(peer);
+        if (!client) continue;
+        client->call_async(
+            network::RpcType::RequestVote, payload,
+            [link = reply_link_, peer_id = peer.id, term = args.term](network::RpcResult result) {
+                const std::scoped_lock<std::mutex> lock(link->mutex);
+                if (link->group != nullptr) {
+                    link->group->handle_vote_reply(peer_id, term, result);
                 }
-            }
+            },
+            group_id_);
+    }
+}
+
+void RaftGroup::handle_vote_reply(const std::string& peer_id, term_t term,
+                                  const network::RpcResult& result) {
+    if (!result.ok || result.response.size() < VOTE_REPLY_SIZE) return;
+    term_t resp_term = 0;
+    std::memcpy(&resp_term, result.response.data(), 8);
+    const bool granted = result.response[8] != 0;
+    {
+        const std::scoped_lock<std::mutex> lock(mutex_);
+        if (resp_term > persistent_state_.current_term) {
+            step_down(resp_term);
+            return;
+        }
+        /* A leader or a higher term may have turned up while the vote was out */
+        if (!granted || state_.load() != NodeState::Candidate ||
+            persistent_state_.current_term != term) {
+            return;
         }
+        votes_.insert(peer_id);
+        if (votes_.size() < votes_needed_) return;
+        become_leader();
     }
+    cluster_manager_.set_leader(group_id_, node_id_);
+}
 
-    if (votes >= needed) {
-        state_ = NodeState::Leader;
-        cluster_manager_.set_leader(group_id_, node_id_);
+void RaftGroup::become_leader() {
+    const auto now = std::chrono::steady_clock::now();
+    for (const auto& peer : election_peers_) {
+        leader_state_.next_index[peer] = last_log_index() + 1;
+        leader_state_.match_index[peer] = 0;
+        leader_state_.in_flight[peer] = 0;
+        leader_state_.epoch[peer]++;
+        leader_state_.last_reply[peer] = now;
+    }
+    leader_state_.snapshot_offset.clear();
+    leader_state_.acked_sent_at.clear();
+    leader_state_.acked_commit.clear();
+    heartbeat_owed_.clear();
+    term_start_index_ = last_log_index() + 1;
+    last_broadcast_ = {};
+    state_ = NodeState::Leader;
+    wake();
+}
+
+std::chrono::steady_clock::time_point RaftGroup::tick_leader() {
+    send_append_entries();
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    if (state_.load() != NodeState::Leader) return std::chrono::steady_clock::now();
+    if (dormant_) return std::chrono::steady_clock::time_point::max();
+    return last_broadcast_ + std::chrono::milliseconds(HEARTBEAT_INTERVAL_MS);
+}
+
+void RaftGroup::send_append_entries() {
+    const auto peers = cluster_manager_.get_group_members(group_id_);
+    std::vector<std::pair<cluster::NodeInfo, SentBatch>> batches;
+    std::vector<std::vector<uint8_t>> payloads;
+    {
         const std::scoped_lock<std::mutex> lock(mutex_);
+        if (state_.load() != NodeState::Leader) return;
+        replication_pending_ = false;
+
+        /* Group commit: one flush covers everything proposed since the last tick */
+        if (!log_.sync()) {
+            std::cerr << "--- [RaftGroup] log sync FAILED ---" << std::endl;
+        }
+        advance_commit_index();
+
+        const auto now = std::chrono::steady_clock::now();
+        const bool heartbeat_due =
+            now - last_broadcast_ >= std::chrono::milliseconds(HEARTBEAT_INTERVAL_MS);
+        if (heartbeat_due) {
+            last_broadcast_ = now;
+        }
+        const index_t last_index = last_log_index();
+
         for (const auto& peer : peers) {
-            leader_state_.next_index[peer.id] =
-                persistent_state_.log.empty() ? 1 : persistent_state_.log.back().index + 1;
-            leader_state_.match_index[peer.id] = 0;
+            if (peer.id == node_id_) continue;
+            if (unreachable_.count(peer.id) != 0) {
+                if (!heartbeat_due) continue;
+                unreachable_.erase(peer.id);
+            }
+
+            auto& next = leader_state_.next_index[peer.id];
+            if (next == 0) {
+                next = last_index + 1; /* Joined after the election */
+            }
+            if (leader_state_.in_flight[peer.id] > 0 &&
+                now - leader_state_.last_reply[peer.id] >=
+                    std::chrono::milliseconds(PIPELINE_TIMEOUT_MS)) {
+                restart_pipeline(peer.id, now);
+            }
+
+            /* The entries it needs are compacted away: it gets the snapshot, a chunk at a time */
+            if (next < log_.first_index()) {
+                InstallSnapshotArgs args;
+                if (leader_state_.in_flight[peer.id] > 0 ||
+                    !read_snapshot_chunk(leader_state_.snapshot_offset[peer.id], args)) {
+                    continue;
+                }
+                SentBatch sent;
+                sent.term = args.term;
+                sent.epoch = leader_state_.epoch[peer.id];
+                sent.prev_log_index = args.last_included_index;
+                sent.snapshot = true;
+                sent.offset = args.offset;
+                batches.emplace_back(peer, sent);
+                payloads.push_back(serialize_install_snapshot(args));
+                leader_state_.in_flight[peer.id]++;
+                heartbeat_owed_.erase(peer.id);
+                stats_.snapshot_bytes_sent += args.data.size();
+                continue;
+            }
+
+            /* Pipeline batches up to the window; a caught-up follower gets an empty heartbeat,
+             * unless the driver sends it coalesced with those of the node's other groups */
+            const auto match = leader_state_.match_index.find(peer.id);
+            const bool coalesced = driver_ != nullptr &&
+                                   match != leader_state_.match_index.end() &&
+                                   match->second == last_index;
+            bool heartbeat =
+                (heartbeat_due && !coalesced) || heartbeat_owed_.count(peer.id) != 0;
+            auto& in_flight = leader_state_.in_flight[peer.id];
+            while (in_flight < MAX_IN_FLIGHT && (next <= last_index || heartbeat)) {
+                AppendEntriesArgs args;
+                args.term = persistent_state_.current_term;
+                args.leader_id = node_id_;
+                args.prev_log_index = next - 1;
+                args.prev_log_term = term_at(next - 1);
+                args.leader_commit = volatile_state_.commit_index;
+                const size_t count =
+                    next <= last_index ? std::min<size_t>(MAX_BATCH_ENTRIES, last_index + 1 - next)
+                                       : 0;
+                if (!log_.read(next, count, args.entries)) {
+                    std::cerr << "--- [RaftGroup] log read FAILED at " << next << " ---"
+                              << std::endl;
+                    break;
+                }
+
+                SentBatch sent;
+                sent.term = args.term;
+                sent.epoch = leader_state_.epoch[peer.id];
+                sent.prev_log_index = args.prev_log_index;
+                sent.count = count;
+                batches.emplace_back(peer, sent);
+                payloads.push_back(serialize_append_entries(args));
+
+                next += count;
+                in_flight++;
+                heartbeat = false;
+                heartbeat_owed_.erase(peer.id);
+                if (count > 0) {
+                    stats_.batches_sent++;
+                    stats_.entries_sent += count;
+                    stats_.max_batch = std::max<uint64_t>(stats_.max_batch, count);
+                }
+            }
+        }
+    }
+
+    /* Replies come back on the client's reader thread, or here if the send fails */
+    for (size_t i = 0; i < batches.size(); ++i) {
+        auto& [peer, sent] = batches[i];
+        sent.sent_at = std::chrono::steady_clock::now();
+        auto client = cluster_manager_.get_client(peer);
+        if (!client) {
+            handle_append_reply(peer.id, sent, network::RpcResult{});
+            continue;
+        }
+        client->call_async(
+            sent.snapshot ? network::RpcType::InstallSnapshot : network::RpcType::AppendEntries,
+            payloads[i],
+            [link = reply_link_, peer_id = peer.id, sent](network::RpcResult result) {
+                const std::scoped_lock<std::mutex> lock(link->mutex);
+                if (link->group != nullptr) {
+                    link->group->handle_append_reply(peer_id, sent, result);
+                }
+            },
+            group_id_);
+    }
+}
+
+void RaftGroup::handle_append_reply(const std::string& peer_id, const SentBatch& sent,
+                                    const network::RpcResult& result) {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    if (state_.load() != NodeState::Leader || sent.term != persistent_state_.current_term ||
+        sent.epoch != leader_state_.epoch[peer_id]) {
+        return; /* From an earlier term or a window that has since restarted */
+    }
+    const auto now = std::chrono::steady_clock::now();
+    auto& in_flight = leader_state_.in_flight[peer_id];
+    if (in_flight > 0) {
+        in_flight--;
+    }
+    leader_state_.last_reply[peer_id] = now;
+
+    if (sent.snapshot) {
+        handle_snapshot_reply(peer_id, sent, result);
+        return;
+    }
+    if (!result.ok || result.response.size() < APPEND_REPLY_SIZE) {
+        restart_pipeline(peer_id, now);
+        unreachable_.insert(peer_id);
+        return;
+    }
+    AppendEntriesReply reply{};
+    std::memcpy(&reply.term, result.response.data(), 8);
+    reply.success = result.response[8] != 0;
+    std::memcpy(&reply.last_log_index, result.response.data() + 9, 8);
+
+    if (reply.term > persistent_state_.current_term) {
+        step_down(reply.term);
+        return;
+    }
+    record_ack(peer_id, sent.sent_at);
+    if (reply.success) {
+        auto& match = leader_state_.match_index[peer_id];
+        match = std::max<index_t>(match, sent.prev_log_index + sent.count);
+        if (sent.count > 0) {
+            const auto latency = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(now - sent.sent_at)
+                    .count());
+            stats_.batches_acked++;
+            stats_.total_latency_us += latency;
+            stats_.max_latency_us = std::max(stats_.max_latency_us, latency);
         }
+        advance_commit_index();
     } else {
-        std::this_thread::sleep_for(std::chrono::milliseconds(ELECTION_RETRY_MS));
+        /* Resume where the logs may still agree; the batches behind this one fail too */
+        restart_pipeline(peer_id, now);
+        leader_state_.next_index[peer_id] = std::max<index_t>(
+            1, std::min<index_t>(sent.prev_log_index, reply.last_log_index + 1));
+    }
+
+    if (leader_state_.next_index[peer_id] <= last_log_index()) {
+        replication_pending_ = true;
+        wake();
     }
 }
 
-void RaftGroup::do_leader() {
-    auto peers = cluster_manager_.get_group_members(group_id_);
-    for (const auto& peer : peers) {
-        if (peer.id == node_id_) continue;
+void RaftGroup::handle_snapshot_reply(const std::string& peer_id, const SentBatch& sent,
+                                      const network::RpcResult& result) {
+    const auto now = std::chrono::steady_clock::now();
+    if (!result.ok || result.response.size() < INSTALL_REPLY_SIZE) {
+        restart_pipeline(peer_id, now);
+        unreachable_.insert(peer_id);
+        return;
+    }
+    InstallSnapshotReply reply{};
+    std::memcpy(&reply.term, result.response.data(), 8);
+    reply.installed = result.response[8] != 0;
+    std::memcpy(&reply.stored, result.response.data() + 9, 8);
+    if (reply.term > persistent_state_.current_term) {
+        step_down(reply.term);
+        return;
+    }
+    record_ack(peer_id, sent.sent_at);
+
+    if (reply.installed) {
+        auto& match = leader_state_.match_index[peer_id];
+        match = std::max<index_t>(match, sent.prev_log_index);
+        leader_state_.next_index[peer_id] = match + 1;
+        leader_state_.snapshot_offset.erase(peer_id);
+        stats_.snapshots_sent++;
+        advance_commit_index();
+    } else {
+        /* Resume from what the follower holds; without progress, wait for the heartbeat */
+        auto& offset = leader_state_.snapshot_offset[peer_id];
+        const bool progressed = reply.stored > sent.offset;
+        offset = reply.stored;
+        if (!progressed) return;
+    }
+    replication_pending_ = true;
+    wake();
+}
+
+bool RaftGroup::read_snapshot_chunk(uint64_t offset, InstallSnapshotArgs& args) const {
+    const std::string path = storage_path(".snap");
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "--- [RaftGroup] cannot open snapshot " << path << " ---" << std::endl;
+        return false;
+    }
+    struct stat st {};
+    const uint64_t size = ::fstat(fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    offset = std::min(offset, size);
+    args.data.resize(std::min<uint64_t>(SNAPSHOT_CHUNK_BYTES, size - offset));
+    size_t done = 0;
+    while (done < args.data.size()) {
+        const ssize_t n = ::pread(fd, args.data.data() + done, args.data.size() - done,
+                                  static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += static_cast<size_t>(n);
+    }
+    static_cast<void>(::close(fd));
+    if (done < args.data.size()) return false;
+
+    args.term = persistent_state_.current_term;
+    args.leader_id = node_id_;
+    args.last_included_index = snapshot_index_;
+    args.last_included_term = snapshot_term_;
+    args.offset = offset;
+    args.done = offset + done == size;
+    return true;
+}
+
+void RaftGroup::record_ack(const std::string& peer_id,
+                           std::chrono::steady_clock::time_point sent_at) {
+    auto& acked = leader_state_.acked_sent_at[peer_id];
+    acked = std::max(acked, sent_at);
+    cv_.notify_all(); /* Reads may be waiting on a majority */
+}
+
+std::chrono::steady_clock::time_point RaftGroup::quorum_ack_time() const {
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<std::chrono::steady_clock::time_point> acked;
+    for (const auto& [id, match] : leader_state_.match_index) {
+        const auto it = leader_state_.acked_sent_at.find(id);
+        if (id == node_id_) {
+            acked.push_back(now);
+        } else {
+            acked.push_back(it != leader_state_.acked_sent_at.end()
+                                ? it->second
+                                : std::chrono::steady_clock::time_point{});
+        }
+    }
+    if (acked.empty()) return now;
+    std::sort(acked.begin(), acked.end(), std::greater<>());
+    return acked[acked.size() / 2];
+}
 
-        std::vector<uint8_t> payload(32, 0);
-        {
-            const std::scoped_lock<std::mutex> lock(mutex_);
-            std::memcpy(payload.data(), &persistent_state_.current_term, 8);
-            uint64_t id_len = node_id_.size();
-            std::memcpy(payload.data() + 8, &id_len, 8);
+bool RaftGroup::prepare_read(ReadConsistency level, std::chrono::milliseconds max_staleness) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    index_t index = 0;
+    switch (level) {
+        case ReadConsistency::Leader:
+        case ReadConsistency::Lease:
+            if (!read_index(lock, level == ReadConsistency::Lease, index)) return false;
+            break;
+        case ReadConsistency::Follower: {
+            if (state_.load() == NodeState::Leader) {
+                if (!read_index(lock, true, index)) return false;
+                break;
+            }
+            /* The leader confirms its commit index; this replica serves once it applied it */
+            const std::string leader = leader_id_;
+            lock.unlock();
+            std::vector<uint8_t> reply;
+            bool answered = false;
+            for (const auto& peer : cluster_manager_.get_group_members(group_id_)) {
+                if (peer.id != leader || leader.empty()) continue;
+                auto client = cluster_manager_.get_client(peer);
+                answered =
+                    client && client->call(network::RpcType::ReadIndex, {}, reply, group_id_);
+                break;
+            }
+            lock.lock();
+            if (!answered || reply.size() < READ_INDEX_REPLY_SIZE || reply[0] == 0) return false;
+            std::memcpy(&index, reply.data() + 1, 8);
+            stats_.follower_reads++;
+            break;
         }
+        case ReadConsistency::Stale:
+            if (max_staleness.count() == 0 || state_.load() == NodeState::Leader) return true;
+            return std::chrono::steady_clock::now() - leader_heard_at() <= max_staleness;
+    }
+    return wait_applied(lock, index);
+}
 
-        network::RpcClient client(peer.address, peer.cluster_port);
-        if (client.connect()) {
-            static_cast<void>(
-                client.send_only(network::RpcType::AppendEntries, payload, group_id_));
+bool RaftGroup::read_index(std::unique_lock<std::mutex>& lock, bool allow_lease, index_t& index) {
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(READ_TIMEOUT_MS);
+    const term_t term = persistent_state_.current_term;
+    const auto leading = [this, term] {
+        return state_.load() == NodeState::Leader && persistent_state_.current_term == term;
+    };
+    if (!leading()) return false;
+
+    /* Until an entry of its own term commits, a new leader's commit index may lag the
+     * last leader's; an empty entry gets one committed when no proposal is on the way */
+    const auto term_committed = [this, term] {
+        return term_at(volatile_state_.commit_index) == term;
+    };
+    if (!term_committed()) {
+        if (term_at(last_log_index()) != term) {
+            LogEntry entry;
+            entry.term = term;
+            entry.index = last_log_index() + 1;
+            if (!log_.append(entry)) return false;
+            replication_pending_ = true;
+            wake();
         }
+        cv_.wait_until(lock, deadline,
+                       [&] { return !running_ || !leading() || term_committed(); });
+        if (!leading() || !term_committed()) return false;
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(HEARTBEAT_INTERVAL_MS));
+
+    index = volatile_state_.commit_index;
+    const auto start = std::chrono::steady_clock::now();
+    if (allow_lease && start < quorum_ack_time() + std::chrono::milliseconds(LEASE_MS)) {
+        stats_.lease_reads++;
+        return true;
+    }
+
+    /* A majority answering a heartbeat sent after the read arrived proves no newer leader */
+    stats_.read_index_rounds++;
+    for (const auto& [id, match] : leader_state_.match_index) {
+        if (id != node_id_) heartbeat_owed_.insert(id);
+    }
+    replication_pending_ = true;
+    wake();
+    cv_.wait_until(lock, deadline,
+                   [&] { return !running_ || !leading() || quorum_ack_time() >= start; });
+    return leading() && quorum_ack_time() >= start;
+}
+
+bool RaftGroup::wait_applied(std::unique_lock<std::mutex>& lock, index_t index) {
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(READ_TIMEOUT_MS);
+    cv_.wait_until(lock, deadline,
+                   [&] { return !running_ || volatile_state_.last_applied >= index; });
+    return volatile_state_.last_applied >= index;
+}
+
+void RaftGroup::restart_pipeline(const std::string& peer_id,
+                                 std::chrono::steady_clock::time_point now) {
+    leader_state_.in_flight[peer_id] = 0;
+    leader_state_.epoch[peer_id]++;
+    leader_state_.next_index[peer_id] = leader_state_.match_index[peer_id] + 1;
+    leader_state_.last_reply[peer_id] = now;
+}
+
+void RaftGroup::advance_commit_index() {
+    std::vector<index_t> matched;
+    /* The leader counts only what it has flushed itself */
+    for (const auto& [id, match] : leader_state_.match_index) {
+        matched.push_back(id == node_id_ ? log_.durable_index() : match);
+    }
+    if (matched.empty()) {
+        matched.push_back(log_.durable_index());
+    }
+    /* The highest index that a majority holds */
+    std::sort(matched.begin(), matched.end(), std::greater<>());
+    const index_t majority = matched[matched.size() / 2];
+    if (majority > volatile_state_.commit_index &&
+        term_at(majority) == persistent_state_.current_term) {
+        volatile_state_.commit_index = majority;
+        apply_committed();
+    }
+}
+
+void RaftGroup::apply_committed() {
+    if (snapshotting_ || restore_pending_) return; /* Picked up once the image is done */
+    const index_t applied = volatile_state_.last_applied;
+    while (volatile_state_.last_applied < volatile_state_.commit_index) {
+        std::vector<LogEntry> entries;
+        const index_t from = volatile_state_.last_applied + 1;
+        if (!log_.read(from, std::min<index_t>(MAX_BATCH_ENTRIES,
+                                               volatile_state_.commit_index + 1 - from),
+                       entries) ||
+            entries.empty()) {
+            std::cerr << "--- [RaftGroup] cannot read committed entry " << from << " ---"
+                      << std::endl;
+            return;
+        }
+        for (const auto& entry : entries) {
+            volatile_state_.last_applied = entry.index;
+            /* The leader's own proposals were applied by whoever proposed them */
+            const bool proposed_here =
+                state_.load() == NodeState::Leader && entry.index >= term_start_index_;
+            /* Empty entries are a leader's no-ops, committed to settle its term */
+            if (state_machine_ != nullptr && !proposed_here && !entry.data.empty()) {
+                state_machine_->apply(entry);
+            }
+        }
+    }
+    if (volatile_state_.last_applied != applied) {
+        cv_.notify_all(); /* Follower reads wait for their index */
+    }
+}
+
+index_t RaftGroup::last_log_index() const {
+    return log_.last_index();
+}
+
+term_t RaftGroup::term_at(index_t index) const {
+    if (index == snapshot_index_ && index > 0 && index < log_.first_index()) {
+        return snapshot_term_;
+    }
+    return log_.term_at(index);
+}
+
+index_t RaftGroup::commit_index() const {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    return volatile_state_.commit_index;
+}
+
+index_t RaftGroup::snapshot_index() const {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    return snapshot_index_;
+}
+
+index_t RaftGroup::first_log_index() const {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    return log_.first_index();
+}
+
+void RaftGroup::set_state_machine(RaftStateMachine* state_machine) {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    state_machine_ = state_machine;
+    if (state_machine_ != nullptr && restore_pending_ && restore_snapshot()) {
+        restore_pending_ = false;
+        apply_committed();
+    }
+}
+
+void RaftGroup::set_snapshot_threshold(uint64_t entries) {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    snapshot_threshold_ = entries;
+}
+
+bool RaftGroup::restore_snapshot() {
+    std::ifstream in(storage_path(".snap"), std::ios::binary);
+    in.seekg(static_cast<std::streamoff>(SNAPSHOT_HEADER_SIZE));
+    if (!in || !state_machine_->load_snapshot(in)) {
+        std::cerr << "--- [RaftGroup] cannot load snapshot of group " << group_id_ << " ---"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void RaftGroup::collect_metrics(common::MetricsSnapshot& out) const {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    const std::string labels = common::metric_label("node", node_id_) + "," +
+                               common::metric_label("group", std::to_string(group_id_));
+    const bool leader = state_.load() == NodeState::Leader;
+    const index_t last = log_.last_index();
+    out.add_gauge("cloudsql_raft_term", "Current term",
+                  static_cast<double>(persistent_state_.current_term), labels);
+    out.add_gauge("cloudsql_raft_leader", "1 while this replica leads its group", leader ? 1 : 0,
+                  labels);
+    out.add_gauge("cloudsql_raft_last_log_index", "Newest entry in the log",
+                  static_cast<double>(last), labels);
+    out.add_gauge("cloudsql_raft_commit_index", "Newest committed entry",
+                  static_cast<double>(volatile_state_.commit_index), labels);
+    out.add_gauge("cloudsql_raft_applied_index", "Newest entry applied to the state machine",
+                  static_cast<double>(volatile_state_.last_applied), labels);
+    if (leader) {
+        /* Entries the slowest follower still lacks */
+        index_t lag = 0;
+        for (const auto& [peer, match] : leader_state_.match_index) {
+            lag = std::max(lag, last > match ? last - match : 0);
+        }
+        out.add_gauge("cloudsql_raft_replication_lag_entries",
+                      "Entries the slowest follower has yet to store", static_cast<double>(lag),
+                      labels);
+    }
+    out.add_counter("cloudsql_raft_entries_sent_total", "Entries sent in AppendEntries batches",
+                    static_cast<double>(stats_.entries_sent), labels);
+    out.add_counter("cloudsql_raft_batches_acked_total", "Batches a follower accepted",
+                    static_cast<double>(stats_.batches_acked), labels);
+    out.add_counter("cloudsql_raft_log_syncs_total", "fdatasync calls on the Raft log",
+                    static_cast<double>(log_.syncs()), labels);
+    out.add_counter("cloudsql_raft_snapshots_sent_total", "Snapshots installed on a follower",
+                    static_cast<double>(stats_.snapshots_sent), labels);
+}
+
+ReplicationStats RaftGroup::replication_stats() const {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    ReplicationStats stats = stats_;
+    stats.log_syncs = log_.syncs();
+    stats.entries_synced = log_.synced_entries();
+    return stats;
 }
 
 void RaftGroup::handle_request_vote(const network::RpcHeader& header,
                                     const std::vector<uint8_t>& payload, int client_fd) {
-    (void)header;
     if (payload.size() < 16) return;
 
     term_t term = 0;
@@ -222,26 +1005,28 @@ void RaftGroup::handle_request_vote(const network::RpcHeader& header,
     reply.term = persistent_state_.current_term;
     reply.vote_granted = false;
 
-    if (term > persistent_state_.current_term) {
+    /* While a leader is heard from, its lease stands: no term change and no vote */
+    const bool leader_live = state_.load() == NodeState::Follower &&
+                             std::chrono::steady_clock::now() - last_leader_contact_ <
+                                 std::chrono::milliseconds(TIMEOUT_MIN_MS);
+    if (!leader_live && term > persistent_state_.current_term) {
         step_down(term);
     }
 
     // Raft Up-to-Date check
-    const index_t local_last_index =
-        persistent_state_.log.empty() ? 0 : persistent_state_.log.back().index;
-    const term_t local_last_term =
-        persistent_state_.log.empty() ? 0 : persistent_state_.log.back().term;
+    const index_t local_last_index = log_.last_index();
+    const term_t local_last_term = log_.term_at(local_last_index);
 
     const bool up_to_date =
         (last_log_term > local_last_term) ||
         (last_log_term == local_last_term && last_log_index >= local_last_index);
 
-    if (term == persistent_state_.current_term && up_to_date &&
+    if (!leader_live && term == persistent_state_.current_term && up_to_date &&
         (persistent_state_.voted_for.empty() || persistent_state_.voted_for == candidate_id)) {
         persistent_state_.voted_for = candidate_id;
         persist_state();
         reply.vote_granted = true;
-        last_heartbeat_ = std::chrono::system_clock::now();
+        last_heartbeat_ = std::chrono::steady_clock::now();
         cv_.notify_all();
     }
 
@@ -250,76 +1035,292 @@ void RaftGroup::handle_request_vote(const network::RpcHeader& header,
         std::memcpy(out.data(), &reply.term, 8);
         out[8] = reply.vote_granted ? 1 : 0;
 
-        network::RpcHeader resp_h;
-        resp_h.type = network::RpcType::RequestVote;
-        resp_h.group_id = group_id_;
-        resp_h.payload_len = static_cast<uint16_t>(VOTE_REPLY_SIZE);
-        char h_buf[network::RpcHeader::HEADER_SIZE];
-        resp_h.encode(h_buf);
-        if (send(client_fd, h_buf, network::RpcHeader::HEADER_SIZE, 0) < 0) {
-            std::cerr << "--- [RaftGroup] send header FAILED: " << strerror(errno) << " ---"
-                      << std::endl;
-        }
-        if (send(client_fd, out.data(), out.size(), 0) < 0) {
-            std::cerr << "--- [RaftGroup] send payload FAILED: " << strerror(errno) << " ---"
-                      << std::endl;
+        if (!rpc_server_.send_response(client_fd, header, network::RpcType::RequestVote, out)) {
+            std::cerr << "--- [RaftGroup] send reply FAILED ---" << std::endl;
         }
     }
 }
 
 void RaftGroup::handle_append_entries(const network::RpcHeader& header,
                                       const std::vector<uint8_t>& payload, int client_fd) {
-    (void)header;
     if (payload.size() < 8) return;
 
-    term_t term = 0;
-    std::memcpy(&term, payload.data(), 8);
+    /* A payload carrying only the term is a bare heartbeat, without log state to check */
+    AppendEntriesArgs args;
+    const bool has_log_state = deserialize_append_entries(payload, args);
+    std::memcpy(&args.term, payload.data(), 8);
 
     std::scoped_lock<std::mutex> lock(mutex_);
     AppendEntriesReply reply{};
-    reply.term = persistent_state_.current_term;
     reply.success = false;
 
-    if (term >= persistent_state_.current_term) {
-        if (term > persistent_state_.current_term) step_down(term);
+    if (args.term >= persistent_state_.current_term) {
+        if (args.term > persistent_state_.current_term) step_down(args.term);
         state_ = NodeState::Follower;
-        last_heartbeat_ = std::chrono::system_clock::now();
-        cv_.notify_all();
+        last_heartbeat_ = std::chrono::steady_clock::now();
+        last_leader_contact_ = std::chrono::steady_clock::now();
+        if (has_log_state) {
+            leader_id_ = args.leader_id;
+        }
+        if (dormant_) wake(); /* The leader has entries to send again */
         reply.success = true;
 
-        if (state_machine_) {
-            while (volatile_state_.last_applied < volatile_state_.commit_index) {
-                volatile_state_.last_applied++;
-                for (const auto& entry : persistent_state_.log) {
-                    if (entry.index == volatile_state_.last_applied) {
-                        state_machine_->apply(entry);
-                        break;
-                    }
+        if (has_log_state) {
+            /* Raft consistency check: the entry before the batch must match the leader's */
+            /* Entries a snapshot covers are committed, so they match the leader's */
+            reply.success = args.prev_log_index <= snapshot_index_ ||
+                            (args.prev_log_index <= last_log_index() &&
+                             term_at(args.prev_log_index) == args.prev_log_term);
+        }
+        if (has_log_state && reply.success) {
+            for (const auto& entry : args.entries) {
+                if (entry.index <= snapshot_index_) continue;
+                if (entry.index <= last_log_index()) {
+                    if (term_at(entry.index) == entry.term) continue;
+                    /* Conflict: drop the rest */
+                    reply.success = log_.truncate_suffix(entry.index);
+                }
+                if (!reply.success || !log_.append(entry)) {
+                    reply.success = false;
+                    break;
                 }
             }
+            /* One flush for the whole batch, before the leader hears of it */
+            reply.success = log_.sync() && reply.success;
+        }
+        if (has_log_state && reply.success) {
+            const index_t batch_end = args.prev_log_index + args.entries.size();
+            if (args.leader_commit > volatile_state_.commit_index) {
+                volatile_state_.commit_index = std::max(
+                    volatile_state_.commit_index, std::min(args.leader_commit, batch_end));
+            }
+            apply_committed();
         }
     }
+    reply.term = persistent_state_.current_term;
+    reply.last_log_index = last_log_index();
 
     if (client_fd >= 0) {
         std::vector<uint8_t> out(APPEND_REPLY_SIZE);
         std::memcpy(out.data(), &reply.term, 8);
         out[8] = reply.success ? 1 : 0;
+        std::memcpy(out.data() + 9, &reply.last_log_index, 8);
 
-        network::RpcHeader resp_h;
-        resp_h.type = network::RpcType::AppendEntries;
-        resp_h.group_id = group_id_;
-        resp_h.payload_len = static_cast<uint16_t>(APPEND_REPLY_SIZE);
-        char h_buf[network::RpcHeader::HEADER_SIZE];
-        resp_h.encode(h_buf);
-        if (send(client_fd, h_buf, network::RpcHeader::HEADER_SIZE, 0) < 0) {
-            std::cerr << "--- [RaftGroup] send header FAILED: " << strerror(errno) << " ---"
-                      << std::endl;
+        if (!rpc_server_.send_response(client_fd, header, network::RpcType::AppendEntries, out)) {
+            std::cerr << "--- [RaftGroup] send reply FAILED ---" << std::endl;
         }
-        if (send(client_fd, out.data(), out.size(), 0) < 0) {
-            std::cerr << "--- [RaftGroup] send payload FAILED: " << strerror(errno) << " ---"
-                      << std::endl;
+    }
+}
+
+void RaftGroup::handle_install_snapshot(const network::RpcHeader& header,
+                                        const std::vector<uint8_t>& payload, int client_fd) {
+    InstallSnapshotArgs args;
+    if (!deserialize_install_snapshot(payload, args)) return;
+
+    std::scoped_lock<std::mutex> lock(mutex_);
+    InstallSnapshotReply reply{};
+    if (args.term >= persistent_state_.current_term) {
+        if (args.term > persistent_state_.current_term) step_down(args.term);
+        state_ = NodeState::Follower;
+        last_heartbeat_ = std::chrono::steady_clock::now();
+        last_leader_contact_ = std::chrono::steady_clock::now();
+        leader_id_ = args.leader_id;
+        if (dormant_) wake();
+
+        const std::string temp = storage_path(".snap.recv");
+        if (volatile_state_.commit_index >= args.last_included_index) {
+            reply.installed = true; /* Caught up some other way meanwhile */
+        } else if (args.offset == 0 || (args.last_included_index == receiving_index_ &&
+                                        args.offset == receiving_bytes_)) {
+            const int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (args.offset == 0 ? O_TRUNC : 0);
+            const int fd = ::open(temp.c_str(), flags, STATE_FILE_MODE);
+            bool written = fd >= 0;
+            size_t done = 0;
+            while (written && done < args.data.size()) {
+                const ssize_t n = ::pwrite(fd, args.data.data() + done, args.data.size() - done,
+                                           static_cast<off_t>(args.offset + done));
+                if (n < 0 && errno == EINTR) continue;
+                written = n > 0;
+                done += written ? static_cast<size_t>(n) : 0;
+            }
+            /* The last chunk waits while this node writes a snapshot of its own */
+            const bool install = written && args.done && !snapshotting_;
+            written = written && (!install || ::fdatasync(fd) == 0);
+            if (fd >= 0) static_cast<void>(::close(fd));
+
+            receiving_index_ = args.last_included_index;
+            receiving_bytes_ = written ? args.offset + args.data.size() : 0;
+            if (install && written) {
+                reply.installed = install_received_snapshot(args);
+                receiving_bytes_ = 0;
+            } else if (written && args.done) {
+                receiving_bytes_ = args.offset; /* Resent later */
+            }
+        } else if (args.last_included_index != receiving_index_) {
+            receiving_bytes_ = 0; /* A newer snapshot: start over */
+        }
+        reply.stored = receiving_bytes_;
+    }
+    reply.term = persistent_state_.current_term;
+
+    if (client_fd >= 0) {
+        std::vector<uint8_t> out(INSTALL_REPLY_SIZE);
+        std::memcpy(out.data(), &reply.term, 8);
+        out[8] = reply.installed ? 1 : 0;
+        std::memcpy(out.data() + 9, &reply.stored, 8);
+
+        if (!rpc_server_.send_response(client_fd, header, network::RpcType::InstallSnapshot,
+                                       out)) {
+            std::cerr << "--- [RaftGroup] send reply FAILED ---" << std::endl;
+        }
+    }
+}
+
+void RaftGroup::handle_read_index(const network::RpcHeader& header,
+                                  const std::vector<uint8_t>& payload, int client_fd) {
+    static_cast<void>(payload);
+    index_t index = 0;
+    bool ok = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ok = read_index(lock, true, index);
+    }
+    if (client_fd >= 0) {
+        std::vector<uint8_t> out(READ_INDEX_REPLY_SIZE);
+        out[0] = ok ? 1 : 0;
+        std::memcpy(out.data() + 1, &index, 8);
+        if (!rpc_server_.send_response(client_fd, header, network::RpcType::ReadIndex, out)) {
+            std::cerr << "--- [RaftGroup] send reply FAILED ---" << std::endl;
+        }
+    }
+}
+
+void RaftGroup::collect_heartbeats(
+    std::unordered_map<std::string, std::vector<GroupHeartbeat>>& out) {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    if (!running_ || dormant_ || state_.load() != NodeState::Leader) return;
+    const index_t last_index = last_log_index();
+    const index_t commit = volatile_state_.commit_index;
+    /* Settled: every follower holds the whole log and knows it committed, and no write,
+     * read or retry is on the way */
+    bool settled = commit == last_index && !replication_pending_ && heartbeat_owed_.empty() &&
+                   unreachable_.empty();
+    std::vector<std::pair<std::string, GroupHeartbeat>> beats;
+    for (const auto& [id, match] : leader_state_.match_index) {
+        if (id == node_id_) continue;
+        if (match != last_index) {
+            settled = false; /* Still sent AppendEntries */
+            continue;
+        }
+        GroupHeartbeat beat;
+        beat.group_id = group_id_;
+        beat.term = persistent_state_.current_term;
+        beat.commit = std::min(commit, match);
+        settled = settled && leader_state_.acked_commit[id] == commit;
+        beats.emplace_back(id, beat);
+    }
+    if (settled) {
+        for (auto& [id, beat] : beats) {
+            beat.quiesce = true;
         }
+        dormant_ = true;
+        stats_.quiesces++;
+    }
+    for (auto& [id, beat] : beats) {
+        out[id].push_back(beat);
+    }
+    stats_.heartbeats_coalesced += beats.size();
+}
+
+GroupHeartbeatAck RaftGroup::handle_heartbeat(const std::string& leader_id,
+                                              const GroupHeartbeat& beat) {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    GroupHeartbeatAck ack;
+    ack.group_id = group_id_;
+    if (beat.term >= persistent_state_.current_term) {
+        if (beat.term > persistent_state_.current_term) step_down(beat.term);
+        state_ = NodeState::Follower;
+        const auto now = std::chrono::steady_clock::now();
+        last_heartbeat_ = now;
+        last_leader_contact_ = now;
+        leader_id_ = leader_id;
+        /* The leader only sends this follower's whole log, so it holds the commit index */
+        if (beat.commit > volatile_state_.commit_index) {
+            volatile_state_.commit_index = std::min(beat.commit, last_log_index());
+            apply_committed();
+        }
+        if (beat.quiesce) {
+            dormant_ = true;
+        } else if (dormant_) {
+            wake();
+        }
+        ack.accepted = true;
+    }
+    ack.term = persistent_state_.current_term;
+    return ack;
+}
+
+void RaftGroup::handle_heartbeat_ack(const std::string& peer_id, const GroupHeartbeat& beat,
+                                     const GroupHeartbeatAck& ack,
+                                     std::chrono::steady_clock::time_point sent_at) {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    if (state_.load() != NodeState::Leader || beat.term != persistent_state_.current_term) {
+        return;
+    }
+    if (ack.term > persistent_state_.current_term) {
+        step_down(ack.term);
+        return;
+    }
+    if (!ack.accepted) {
+        /* Lost or refused: the follower may not know to go dormant, so neither does the leader */
+        if (dormant_) wake();
+        return;
+    }
+    record_ack(peer_id, sent_at);
+    auto& acked = leader_state_.acked_commit[peer_id];
+    acked = std::max(acked, beat.commit);
+}
+
+void RaftGroup::leader_silent(const std::string& node_id) {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    if (!dormant_ || state_.load() != NodeState::Follower || leader_id_ != node_id) return;
+    /* The election timer starts over from now, randomized as ever */
+    last_heartbeat_ = std::chrono::steady_clock::now();
+    wake();
+}
+
+bool RaftGroup::dormant() const {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    return dormant_;
+}
+
+bool RaftGroup::install_received_snapshot(const InstallSnapshotArgs& args) {
+    const std::string path = storage_path(".snap");
+    const std::string temp = storage_path(".snap.recv");
+    index_t index = 0;
+    term_t term = 0;
+    if (!read_snapshot_header(temp, index, term) || index != args.last_included_index ||
+        term != args.last_included_term || std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::cerr << "--- [RaftGroup] received snapshot is unusable ---" << std::endl;
+        static_cast<void>(std::remove(temp.c_str()));
+        return false;
+    }
+    /* Without a state machine yet, it loads the image when one is set */
+    if (state_machine_ != nullptr && !restore_snapshot()) return false;
+    restore_pending_ = state_machine_ == nullptr;
+    snapshot_index_ = index;
+    snapshot_term_ = term;
+
+    /* A log that agrees past the snapshot keeps that suffix; any other is replaced */
+    const bool kept = log_.term_at(index) == term ? log_.compact(index) : log_.reset(index + 1);
+    if (!kept) {
+        std::cerr << "--- [RaftGroup] log compaction FAILED at " << index << " ---" << std::endl;
     }
+    volatile_state_.commit_index = std::max(volatile_state_.commit_index, index);
+    volatile_state_.last_applied = index;
+    stats_.snapshots_installed++;
+    cv_.notify_all();
+    return true;
 }
 
 void RaftGroup::step_down(term_t new_term) {
@@ -327,6 +1328,24 @@ void RaftGroup::step_down(term_t new_term) {
     persistent_state_.voted_for = "";
     state_ = NodeState::Follower;
     persist_state();
+    wake();
+}
+
+void RaftGroup::wake() {
+    dormant_ = false;
+    wake_pending_ = true;
+    cv_.notify_all();
+    if (driver_ != nullptr) {
+        driver_->wake(group_id_);
+    }
+}
+
+std::chrono::steady_clock::time_point RaftGroup::leader_heard_at() const {
+    /* A dormant follower only hears the coalesced heartbeats of the leader's node */
+    if (dormant_ && driver_ != nullptr && !leader_id_.empty()) {
+        return std::max(last_leader_contact_, driver_->last_heard(leader_id_));
+    }
+    return last_leader_contact_;
 }
 
 std::chrono::milliseconds RaftGroup::get_random_timeout() const {
@@ -335,29 +1354,59 @@ std::chrono::milliseconds RaftGroup::get_random_timeout() const {
     return std::chrono::milliseconds(dist(mutable_rng));
 }
 
+std::string RaftGroup::storage_path(const char* suffix) const {
+    return storage_prefix_ + suffix;
+}
+
 void RaftGroup::persist_state() {
-    std::string filename = "raft_group_" + std::to_string(group_id_) + ".state";
-    std::ofstream out(filename, std::ios::binary);
-    if (out.is_open()) {
-        out.write(reinterpret_cast<const char*>(&persistent_state_.current_term), 8);
-        uint64_t v_len = persistent_state_.voted_for.size();
-        out.write(reinterpret_cast<const char*>(&v_len), 8);
-        out.write(persistent_state_.voted_for.data(), v_len);
+    const std::string filename = storage_path(".state");
+    const std::string temp = filename + ".tmp";
+    std::vector<uint8_t> out(16 + persistent_state_.voted_for.size());
+    const uint64_t v_len = persistent_state_.voted_for.size();
+    std::memcpy(out.data(), &persistent_state_.current_term, 8);
+    std::memcpy(out.data() + 8, &v_len, 8);
+    std::memcpy(out.data() + 16, persistent_state_.voted_for.data(), v_len);
 
-        uint64_t log_size = persistent_state_.log.size();
-        out.write(reinterpret_cast<const char*>(&log_size), 8);
-        for (const auto& entry : persistent_state_.log) {
-            std::vector<uint8_t> serialized;
-            serialize_entry(entry, serialized);
-            uint64_t entry_len = serialized.size();
-            out.write(reinterpret_cast<const char*>(&entry_len), 8);
-            out.write(reinterpret_cast<const char*>(serialized.data()), entry_len);
-        }
+    /* Written aside and renamed over, so a crash leaves the old term and vote or the new */
+    const int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, STATE_FILE_MODE);
+    if (fd < 0) return;
+    const bool written = ::write(fd, out.data(), out.size()) == static_cast<ssize_t>(out.size()) &&
+                         ::fdatasync(fd) == 0;
+    static_cast<void>(::close(fd));
+    if (!written || std::rename(temp.c_str(), filename.c_str()) != 0) {
+        std::cerr << "--- [RaftGroup] persist state FAILED ---" << std::endl;
     }
 }
 
 void RaftGroup::load_state() {
-    std::string filename = "raft_group_" + std::to_string(group_id_) + ".state";
+    if (!log_.open()) {
+        std::cerr << "--- [RaftGroup] cannot open log of group " << group_id_ << " ---"
+                  << std::endl;
+    }
+
+    if (read_snapshot_header(storage_path(".snap"), snapshot_index_, snapshot_term_)) {
+        /* The entries it covers are applied by loading it, once a state machine is set */
+        restore_pending_ = true;
+        volatile_state_.commit_index = snapshot_index_;
+        volatile_state_.last_applied = snapshot_index_;
+        /* Finish a compaction cut short; a log that cannot follow the snapshot is dropped */
+        bool kept = true;
+        if (log_.first_index() <= snapshot_index_ &&
+            log_.term_at(snapshot_index_) == snapshot_term_) {
+            kept = log_.compact(snapshot_index_);
+        } else if (log_.first_index() != snapshot_index_ + 1) {
+            kept = log_.reset(snapshot_index_ + 1);
+        }
+        if (!kept) {
+            std::cerr << "--- [RaftGroup] log compaction FAILED at " << snapshot_index_
+                      << " ---" << std::endl;
+        }
+    } else {
+        snapshot_index_ = 0;
+        snapshot_term_ = 0;
+    }
+
+    const std::string filename = storage_path(".state");
     std::ifstream in(filename, std::ios::binary);
     if (in.is_open()) {
         in.read(reinterpret_cast<char*>(&persistent_state_.current_term), 8);
@@ -366,16 +1415,22 @@ void RaftGroup::load_state() {
         persistent_state_.voted_for.resize(v_len);
         in.read(&persistent_state_.voted_for[0], v_len);
 
+        /* Older state files carry the whole log after the vote: move it into segments */
         uint64_t log_size = 0;
         in.read(reinterpret_cast<char*>(&log_size), 8);
-        for (uint64_t i = 0; i < log_size; ++i) {
+        if (!in || log_size == 0) return;
+        const bool migrate = log_.empty();
+        for (uint64_t i = 0; i < log_size && migrate; ++i) {
             uint64_t entry_len = 0;
             in.read(reinterpret_cast<char*>(&entry_len), 8);
             std::vector<uint8_t> buf(entry_len);
             in.read(reinterpret_cast<char*>(buf.data()), entry_len);
+            if (!in) break;
             size_t offset = 0;
-            persistent_state_.log.push_back(deserialize_entry(buf.data(), offset, entry_len));
+            if (!log_.append(deserialize_entry(buf.data(), offset, entry_len))) break;
         }
+        static_cast<void>(log_.sync());
+        persist_state();
     }
 }
 
@@ -385,10 +1440,14 @@ bool RaftGroup::replicate(const std::vector<uint8_t>& data) {
     std::scoped_lock<std::mutex> lock(mutex_);
     LogEntry entry;
     entry.term = persistent_state_.current_term;
-    entry.index = persistent_state_.log.empty() ? 1 : persistent_state_.log.back().index + 1;
+    entry.index = last_log_index() + 1;
     entry.data = data;
-    persistent_state_.log.push_back(std::move(entry));
-    persist_state();
+    /* Written now, flushed with the rest of the tick by the leader */
+    if (!log_.append(entry)) return false;
+
+    /* Tick the leader to send now rather than at the next heartbeat */
+    replication_pending_ = true;
+    wake();
     return true;
 }
 
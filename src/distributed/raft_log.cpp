@@ -0,0 +1,382 @@
+/**
+ * @file raft_log.cpp
+ * @brief Segmented, append-only on-disk Raft log
+ */
+
+#include "distributed/raft_log.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cloudsql::raft {
+
+namespace {
+
+constexpr int FILE_MODE = 0644;
+constexpr int DIR_MODE = 0755;
+constexpr size_t RECORD_HEADER_SIZE = 24; /* [term:8][index:8][data_len:8] */
+constexpr const char* SEGMENT_SUFFIX = ".seg";
+constexpr size_t SEGMENT_NAME_DIGITS = 20;
+
+bool read_fully(int fd, uint8_t* out, size_t length, uint64_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        const ssize_t n = ::pread(fd, out + done, length - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool write_fully(int fd, const uint8_t* data, size_t length, uint64_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        const ssize_t n =
+            ::pwrite(fd, data + done, length - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/** @brief Make a new or removed directory entry durable */
+void sync_directory(const std::string& directory) {
+    const int fd = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        static_cast<void>(::fsync(fd));
+        static_cast<void>(::close(fd));
+    }
+}
+
+std::string segment_name(index_t first) {
+    char name[SEGMENT_NAME_DIGITS + 1];
+    std::snprintf(name, sizeof(name), "%020llu", static_cast<unsigned long long>(first));
+    return std::string(name) + SEGMENT_SUFFIX;
+}
+
+}  // namespace
+
+RaftLog::RaftLog(std::string directory, size_t segment_bytes, size_t cache_entries)
+    : directory_(std::move(directory)),
+      segment_bytes_(segment_bytes == 0 ? DEFAULT_SEGMENT_BYTES : segment_bytes),
+      cache_entries_(cache_entries == 0 ? 1 : cache_entries) {}
+
+RaftLog::~RaftLog() {
+    static_cast<void>(sync());
+    close_active();
+}
+
+bool RaftLog::open() {
+    if (::mkdir(directory_.c_str(), DIR_MODE) != 0 && errno != EEXIST) {
+        std::cerr << "--- [RaftLog] cannot create " << directory_ << " ---" << std::endl;
+        return false;
+    }
+    DIR* dir = ::opendir(directory_.c_str());
+    if (dir == nullptr) {
+        return false;
+    }
+    while (const dirent* file = ::readdir(dir)) {
+        const std::string name = file->d_name;
+        if (name.size() != SEGMENT_NAME_DIGITS + std::strlen(SEGMENT_SUFFIX) ||
+            name.compare(SEGMENT_NAME_DIGITS, std::string::npos, SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        Segment segment;
+        segment.first = std::strtoull(name.c_str(), nullptr, 10);
+        segment.path = directory_ + "/" + name;
+        segments_.push_back(std::move(segment));
+    }
+    static_cast<void>(::closedir(dir));
+    std::sort(segments_.begin(), segments_.end(),
+              [](const Segment& a, const Segment& b) { return a.first < b.first; });
+
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        if (load_segment(i)) continue;
+
+        /* Torn or out-of-sequence: nothing after this point can be trusted */
+        remove_segments(segments_[i].size > 0 ? i + 1 : i, segments_.size());
+        sync_directory(directory_);
+        break;
+    }
+
+    const size_t cached = std::min(cache_entries_, index_.size());
+    for (index_t i = last_index() + 1 - cached; i <= last_index() && cached > 0; ++i) {
+        LogEntry entry;
+        if (!read_from_disk(i, entry)) return false;
+        cache_.push_back(std::move(entry));
+    }
+    durable_index_ = last_index();
+    return open_active();
+}
+
+bool RaftLog::load_segment(size_t position) {
+    Segment& segment = segments_[position];
+    if (position == 0) {
+        first_index_ = segment.first;
+    }
+    index_t expected = last_index() + 1;
+
+    const int fd = ::open(segment.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st {};
+    const uint64_t file_size = ::fstat(fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+
+    uint64_t offset = 0;
+    if (segment.first == expected) {
+        uint8_t header[RECORD_HEADER_SIZE];
+        while (file_size - offset >= RECORD_HEADER_SIZE &&
+               read_fully(fd, header, RECORD_HEADER_SIZE, offset)) {
+            term_t term = 0;
+            index_t index = 0;
+            uint64_t data_len = 0;
+            std::memcpy(&term, header, 8);
+            std::memcpy(&index, header + 8, 8);
+            std::memcpy(&data_len, header + 16, 8);
+            if (index != expected || file_size - offset - RECORD_HEADER_SIZE < data_len) break;
+
+            index_.push_back(Slot{static_cast<uint32_t>(position), offset, term});
+            offset += RECORD_HEADER_SIZE + data_len;
+            expected++;
+        }
+    }
+    static_cast<void>(::close(fd));
+
+    segment.size = offset;
+    if (offset == file_size) return true;
+    std::cerr << "--- [RaftLog] cutting torn tail of " << segment.path << " at " << offset
+              << " ---" << std::endl;
+    static_cast<void>(::truncate(segment.path.c_str(), static_cast<off_t>(offset)));
+    return false;
+}
+
+bool RaftLog::open_active() {
+    close_active();
+    if (segments_.empty()) return true;
+    active_fd_ = ::open(segments_.back().path.c_str(), O_RDWR | O_CLOEXEC);
+    return active_fd_ >= 0;
+}
+
+bool RaftLog::start_segment(index_t first) {
+    close_active();
+    Segment segment;
+    segment.first = first;
+    segment.path = directory_ + "/" + segment_name(first);
+    active_fd_ =
+        ::open(segment.path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, FILE_MODE);
+    if (active_fd_ < 0) return false;
+    segments_.push_back(std::move(segment));
+    sync_directory(directory_);
+    return true;
+}
+
+void RaftLog::close_active() {
+    if (active_fd_ >= 0) {
+        static_cast<void>(::close(active_fd_));
+        active_fd_ = -1;
+    }
+}
+
+term_t RaftLog::term_at(index_t index) const {
+    if (index < first_index_ || index > last_index()) return 0;
+    return index_[index - first_index_].term;
+}
+
+bool RaftLog::append(const LogEntry& entry) {
+    if (entry.index != last_index() + 1) return false;
+
+    if (active_fd_ < 0 || segments_.back().size >= segment_bytes_) {
+        /* Seal the full segment: its entries are flushed before it is left behind */
+        if (!sync() || !start_segment(entry.index)) return false;
+    }
+
+    std::vector<uint8_t> record(RECORD_HEADER_SIZE + entry.data.size());
+    const uint64_t data_len = entry.data.size();
+    std::memcpy(record.data(), &entry.term, 8);
+    std::memcpy(record.data() + 8, &entry.index, 8);
+    std::memcpy(record.data() + 16, &data_len, 8);
+    if (data_len > 0) {
+        std::memcpy(record.data() + RECORD_HEADER_SIZE, entry.data.data(), data_len);
+    }
+
+    Segment& segment = segments_.back();
+    if (!write_fully(active_fd_, record.data(), record.size(), segment.size)) {
+        static_cast<void>(::ftruncate(active_fd_, static_cast<off_t>(segment.size)));
+        return false;
+    }
+    index_.push_back(
+        Slot{static_cast<uint32_t>(segments_.size() - 1), segment.size, entry.term});
+    segment.size += record.size();
+    cache_.push_back(entry);
+    if (cache_.size() > cache_entries_) {
+        cache_.pop_front();
+    }
+    dirty_ = true;
+    return true;
+}
+
+bool RaftLog::read(index_t from, size_t max_entries, std::vector<LogEntry>& out) const {
+    if (from < first_index_) return false;
+    if (from > last_index()) return true;
+    const index_t cache_first = last_index() + 1 - cache_.size();
+    const index_t end = from + std::min<index_t>(max_entries, last_index() + 1 - from);
+    for (index_t i = from; i < end; ++i) {
+        if (i >= cache_first) {
+            out.push_back(cache_[i - cache_first]);
+            continue;
+        }
+        LogEntry entry;
+        if (!read_from_disk(i, entry)) return false;
+        out.push_back(std::move(entry));
+    }
+    return true;
+}
+
+bool RaftLog::read_from_disk(index_t index, LogEntry& out) const {
+    const Slot& slot = index_[index - first_index_];
+    const Segment& segment = segments_[slot.segment];
+    const bool active = slot.segment + 1 == segments_.size() && active_fd_ >= 0;
+    const int fd = active ? active_fd_ : ::open(segment.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    uint8_t header[RECORD_HEADER_SIZE];
+    bool ok = read_fully(fd, header, RECORD_HEADER_SIZE, slot.offset);
+    if (ok) {
+        uint64_t data_len = 0;
+        std::memcpy(&out.term, header, 8);
+        std::memcpy(&out.index, header + 8, 8);
+        std::memcpy(&data_len, header + 16, 8);
+        out.data.resize(data_len);
+        ok = data_len == 0 ||
+             read_fully(fd, out.data.data(), data_len, slot.offset + RECORD_HEADER_SIZE);
+    }
+    if (!active) {
+        static_cast<void>(::close(fd));
+    }
+    return ok && out.index == index;
+}
+
+bool RaftLog::truncate_suffix(index_t from) {
+    from = std::max(from, first_index_);
+    if (from > last_index()) return true;
+
+    const Slot slot = index_[from - first_index_];
+    /* The segment the first dropped entry starts goes too if nothing comes before it */
+    close_active();
+    remove_segments(slot.offset == 0 ? slot.segment : slot.segment + 1, segments_.size());
+    if (slot.offset > 0) {
+        Segment& segment = segments_.back();
+        if (::truncate(segment.path.c_str(), static_cast<off_t>(slot.offset)) != 0) return false;
+        segment.size = slot.offset;
+    }
+    sync_directory(directory_);
+
+    index_.resize(from - first_index_);
+    while (!cache_.empty() && cache_.back().index >= from) {
+        cache_.pop_back();
+    }
+    durable_index_ = std::min(durable_index_, last_index());
+    dirty_ = true;
+    return open_active();
+}
+
+bool RaftLog::compact(index_t upto) {
+    if (upto < first_index_) return true;
+    if (upto >= last_index()) return reset(upto + 1);
+    if (!sync()) return false;
+
+    const index_t keep_from = upto + 1;
+    /* Older segments go first: a crash part way leaves a log that still starts at a segment */
+    const uint32_t dropped = index_[keep_from - first_index_].segment;
+    remove_segments(0, dropped);
+    sync_directory(directory_);
+    for (auto& slot : index_) {
+        slot.segment -= std::min(slot.segment, dropped);
+    }
+    index_.erase(index_.begin(), index_.begin() + static_cast<ptrdiff_t>(keep_from - first_index_));
+    first_index_ = keep_from;
+    while (!cache_.empty() && cache_.front().index < keep_from) {
+        cache_.pop_front();
+    }
+
+    const Slot head = index_.front();
+    if (head.offset > 0) {
+        /* Copy the kept tail of the segment to one named after its first entry */
+        Segment& segment = segments_[head.segment];
+        std::vector<uint8_t> tail(segment.size - head.offset);
+        const int in = ::open(segment.path.c_str(), O_RDONLY | O_CLOEXEC);
+        const bool read = in >= 0 && read_fully(in, tail.data(), tail.size(), head.offset);
+        if (in >= 0) static_cast<void>(::close(in));
+        if (!read) return false;
+
+        const std::string path = directory_ + "/" + segment_name(keep_from);
+        const std::string temp = path + ".tmp";
+        const int out = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, FILE_MODE);
+        bool written = out >= 0 && write_fully(out, tail.data(), tail.size(), 0) &&
+                       ::fdatasync(out) == 0;
+        if (out >= 0) static_cast<void>(::close(out));
+        /* Until the old segment is gone, a crash loads it and ignores the overlapping copy */
+        written = written && std::rename(temp.c_str(), path.c_str()) == 0;
+        if (!written) {
+            static_cast<void>(::unlink(temp.c_str()));
+            return false;
+        }
+        static_cast<void>(::unlink(segment.path.c_str()));
+        segment.path = path;
+        segment.first = keep_from;
+        segment.size = tail.size();
+        for (auto& slot : index_) {
+            if (slot.segment == head.segment) {
+                slot.offset -= head.offset;
+            }
+        }
+        sync_directory(directory_);
+    }
+    return open_active();
+}
+
+bool RaftLog::reset(index_t next) {
+    close_active();
+    remove_segments(0, segments_.size());
+    sync_directory(directory_);
+    index_.clear();
+    cache_.clear();
+    first_index_ = next;
+    durable_index_ = next - 1;
+    dirty_ = false;
+    return true;
+}
+
+void RaftLog::remove_segments(size_t from, size_t to) {
+    for (size_t i = from; i < to; ++i) {
+        static_cast<void>(::unlink(segments_[i].path.c_str()));
+    }
+    segments_.erase(segments_.begin() + static_cast<ptrdiff_t>(from),
+                    segments_.begin() + static_cast<ptrdiff_t>(to));
+}
+
+bool RaftLog::sync() {
+    if (!dirty_) return true;
+    if (active_fd_ >= 0 && ::fdatasync(active_fd_) != 0) return false;
+    syncs_++;
+    synced_entries_ += last_index() - std::min(durable_index_, last_index());
+    durable_index_ = last_index();
+    dirty_ = false;
+    return true;
+}
+
+}  // namespace cloudsql::raft
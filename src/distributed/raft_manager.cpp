@@ -5,11 +5,113 @@
 
 #include "distributed/raft_manager.hpp"
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 namespace cloudsql::raft {
 
+namespace {
+
+constexpr uint32_t HEARTBEAT_TASK = 1U << 16;  // Past every group id
+constexpr size_t BEAT_SIZE = 19;               // [group:2][term][commit][quiesce:1]
+constexpr size_t ACK_SIZE = 11;                // [group:2][term][accepted:1]
+
+/**
+ * @brief Serialize a GroupHeartbeat: [id_len][leader id][count:4][beats...]
+ */
+std::vector<uint8_t> serialize_beats(const std::string& leader_id,
+                                     const std::vector<GroupHeartbeat>& beats) {
+    const uint64_t id_len = leader_id.size();
+    const auto count = static_cast<uint32_t>(beats.size());
+    std::vector<uint8_t> out(12 + id_len + (beats.size() * BEAT_SIZE));
+    std::memcpy(out.data(), &id_len, 8);
+    std::memcpy(out.data() + 8, leader_id.data(), id_len);
+    std::memcpy(out.data() + 8 + id_len, &count, 4);
+    size_t offset = 12 + id_len;
+    for (const auto& beat : beats) {
+        std::memcpy(out.data() + offset, &beat.group_id, 2);
+        std::memcpy(out.data() + offset + 2, &beat.term, 8);
+        std::memcpy(out.data() + offset + 10, &beat.commit, 8);
+        out[offset + 18] = beat.quiesce ? 1 : 0;
+        offset += BEAT_SIZE;
+    }
+    return out;
+}
+
+bool deserialize_beats(const std::vector<uint8_t>& payload, std::string& leader_id,
+                       std::vector<GroupHeartbeat>& beats) {
+    if (payload.size() < 12) return false;
+    uint64_t id_len = 0;
+    std::memcpy(&id_len, payload.data(), 8);
+    if (payload.size() - 12 < id_len) return false;
+    leader_id.assign(reinterpret_cast<const char*>(payload.data() + 8), id_len);
+    uint32_t count = 0;
+    std::memcpy(&count, payload.data() + 8 + id_len, 4);
+    size_t offset = 12 + id_len;
+    if ((payload.size() - offset) / BEAT_SIZE < count) return false;
+    for (uint32_t i = 0; i < count; ++i, offset += BEAT_SIZE) {
+        GroupHeartbeat beat;
+        std::memcpy(&beat.group_id, payload.data() + offset, 2);
+        std::memcpy(&beat.term, payload.data() + offset + 2, 8);
+        std::memcpy(&beat.commit, payload.data() + offset + 10, 8);
+        beat.quiesce = payload[offset + 18] != 0;
+        beats.push_back(beat);
+    }
+    return true;
+}
+
+/**
+ * @brief Serialize the acks of a GroupHeartbeat, in the order of its beats: [count:4][acks...]
+ */
+std::vector<uint8_t> serialize_acks(const std::vector<GroupHeartbeatAck>& acks) {
+    const auto count = static_cast<uint32_t>(acks.size());
+    std::vector<uint8_t> out(4 + (acks.size() * ACK_SIZE));
+    std::memcpy(out.data(), &count, 4);
+    size_t offset = 4;
+    for (const auto& ack : acks) {
+        std::memcpy(out.data() + offset, &ack.group_id, 2);
+        std::memcpy(out.data() + offset + 2, &ack.term, 8);
+        out[offset + 10] = ack.accepted ? 1 : 0;
+        offset += ACK_SIZE;
+    }
+    return out;
+}
+
+bool deserialize_acks(const std::vector<uint8_t>& payload, std::vector<GroupHeartbeatAck>& acks) {
+    if (payload.size() < 4) return false;
+    uint32_t count = 0;
+    std::memcpy(&count, payload.data(), 4);
+    if ((payload.size() - 4) / ACK_SIZE < count) return false;
+    size_t offset = 4;
+    for (uint32_t i = 0; i < count; ++i, offset += ACK_SIZE) {
+        GroupHeartbeatAck ack;
+        std::memcpy(&ack.group_id, payload.data() + offset, 2);
+        std::memcpy(&ack.term, payload.data() + offset + 2, 8);
+        ack.accepted = payload[offset + 10] != 0;
+        acks.push_back(ack);
+    }
+    return true;
+}
+
+}  // namespace
+
 RaftManager::RaftManager(std::string node_id, cluster::ClusterManager& cluster_manager,
-                         network::RpcServer& rpc_server)
-    : node_id_(std::move(node_id)), cluster_manager_(cluster_manager), rpc_server_(rpc_server) {
+                         network::RpcServer& rpc_server, std::string storage_dir,
+                         size_t tick_threads)
+    : node_id_(std::move(node_id)),
+      cluster_manager_(cluster_manager),
+      rpc_server_(rpc_server),
+      storage_dir_(std::move(storage_dir)),
+      scheduler_(tick_threads) {
     // Register routing handlers
     rpc_server_.set_handler(network::RpcType::RequestVote,
                             [this](const network::RpcHeader& h, const std::vector<uint8_t>& p,
@@ -17,17 +119,38 @@ RaftManager::RaftManager(std::string node_id, cluster::ClusterManager& cluster_m
     rpc_server_.set_handler(network::RpcType::AppendEntries,
                             [this](const network::RpcHeader& h, const std::vector<uint8_t>& p,
                                    int fd) { handle_raft_rpc(h, p, fd); });
+    rpc_server_.set_handler(network::RpcType::InstallSnapshot,
+                            [this](const network::RpcHeader& h, const std::vector<uint8_t>& p,
+                                   int fd) { handle_raft_rpc(h, p, fd); });
+    rpc_server_.set_handler(network::RpcType::ReadIndex,
+                            [this](const network::RpcHeader& h, const std::vector<uint8_t>& p,
+                                   int fd) { handle_raft_rpc(h, p, fd); });
+    rpc_server_.set_handler(network::RpcType::GroupHeartbeat,
+                            [this](const network::RpcHeader& h, const std::vector<uint8_t>& p,
+                                   int fd) { handle_group_heartbeat(h, p, fd); });
+}
+
+RaftManager::~RaftManager() {
+    stop();
 }
 
 void RaftManager::start() {
     const std::scoped_lock<std::mutex> lock(mutex_);
+    if (started_) return;
+    started_ = true;
     for (auto& [id, group] : groups_) {
-        group->start();
+        group->attach(this);
+        scheduler_.add(id, [g = group.get()] { return g->tick(); });
     }
+    scheduler_.add(HEARTBEAT_TASK, [this] { return send_heartbeats(); });
+    scheduler_.start();
 }
 
 void RaftManager::stop() {
+    /* No tick runs past this point, so the groups can let go of the driver */
+    scheduler_.stop();
     const std::scoped_lock<std::mutex> lock(mutex_);
+    started_ = false;
     for (auto& [id, group] : groups_) {
         group->stop();
     }
@@ -40,8 +163,13 @@ std::shared_ptr<RaftGroup> RaftManager::get_or_create_group(uint16_t group_id) {
         return it->second;
     }
 
-    auto group = std::make_shared<RaftGroup>(group_id, node_id_, cluster_manager_, rpc_server_);
+    auto group = std::make_shared<RaftGroup>(group_id, node_id_, cluster_manager_, rpc_server_,
+                                              storage_dir_);
     groups_[group_id] = group;
+    if (started_) {
+        group->attach(this);
+        scheduler_.add(group_id, [g = group.get()] { return g->tick(); });
+    }
     return group;
 }
 
@@ -54,6 +182,148 @@ std::shared_ptr<RaftGroup> RaftManager::get_group(uint16_t group_id) {
     return nullptr;
 }
 
+std::vector<std::shared_ptr<RaftGroup>> RaftManager::groups() const {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    std::vector<std::shared_ptr<RaftGroup>> out;
+    out.reserve(groups_.size());
+    for (const auto& [id, group] : groups_) {
+        out.push_back(group);
+    }
+    return out;
+}
+
+HeartbeatStats RaftManager::heartbeat_stats() const {
+    HeartbeatStats stats;
+    {
+        const std::scoped_lock<std::mutex> lock(heartbeat_mutex_);
+        stats = heartbeat_stats_;
+    }
+    stats.dormant_groups = 0;
+    for (const auto& group : groups()) {
+        stats.dormant_groups += group->dormant() ? 1 : 0;
+    }
+    return stats;
+}
+
+void RaftManager::wake(uint16_t group_id) {
+    scheduler_.wake(group_id);
+}
+
+std::chrono::steady_clock::time_point RaftManager::last_heard(const std::string& node_id) const {
+    const std::scoped_lock<std::mutex> lock(heartbeat_mutex_);
+    const auto it = last_heard_.find(node_id);
+    return it != last_heard_.end() ? it->second : std::chrono::steady_clock::time_point{};
+}
+
+std::chrono::steady_clock::time_point RaftManager::send_heartbeats() {
+    const auto started = std::chrono::steady_clock::now();
+    const auto all = groups();
+
+    /* Every node sharing a group hears from this one, even with nothing to carry */
+    std::unordered_map<std::string, cluster::NodeInfo> peers;
+    std::unordered_map<std::string, std::vector<GroupHeartbeat>> beats;
+    for (const auto& group : all) {
+        for (const auto& member : cluster_manager_.get_group_members(group->group_id())) {
+            if (member.id != node_id_) peers.emplace(member.id, member);
+        }
+        group->collect_heartbeats(beats);
+    }
+
+    std::unordered_map<uint16_t, std::weak_ptr<RaftGroup>> owners;
+    for (const auto& group : all) {
+        owners.emplace(group->group_id(), group);
+    }
+    for (const auto& [peer_id, peer] : peers) {
+        auto& carried = beats[peer_id];
+        {
+            const std::scoped_lock<std::mutex> lock(heartbeat_mutex_);
+            heartbeat_stats_.messages_sent++;
+            heartbeat_stats_.groups_carried += carried.size();
+        }
+        std::vector<std::weak_ptr<RaftGroup>> senders;
+        senders.reserve(carried.size());
+        for (const auto& beat : carried) {
+            senders.push_back(owners[beat.group_id]);
+        }
+        const auto payload = serialize_beats(node_id_, carried);
+        const auto sent_at = std::chrono::steady_clock::now();
+        /* Each group hears its own ack; a lost message acks nothing */
+        auto on_reply = [id = peer_id, sent = carried, senders = std::move(senders),
+                         sent_at](network::RpcResult result) {
+            std::vector<GroupHeartbeatAck> acks;
+            if (result.ok) {
+                static_cast<void>(deserialize_acks(result.response, acks));
+            }
+            for (size_t i = 0; i < sent.size(); ++i) {
+                const auto group = senders[i].lock();
+                if (!group) continue;
+                GroupHeartbeatAck ack;
+                if (i < acks.size() && acks[i].group_id == sent[i].group_id) {
+                    ack = acks[i];
+                }
+                group->handle_heartbeat_ack(id, sent[i], ack, sent_at);
+            }
+        };
+        auto client = cluster_manager_.get_client(peer);
+        if (!client) {
+            on_reply(network::RpcResult{});
+            continue;
+        }
+        client->call_async(network::RpcType::GroupHeartbeat, payload, std::move(on_reply));
+    }
+
+    /* A node silent for an election timeout may be down: the groups it led wake */
+    std::vector<std::string> lost;
+    {
+        const std::scoped_lock<std::mutex> lock(heartbeat_mutex_);
+        for (const auto& [node, heard] : last_heard_) {
+            if (started - heard >= std::chrono::milliseconds(RaftGroup::ELECTION_TIMEOUT_MIN_MS) &&
+                silent_.insert(node).second) {
+                lost.push_back(node);
+            }
+        }
+    }
+    for (const auto& node : lost) {
+        std::cerr << "--- [RaftManager] " << node << " fell silent, waking its groups ---"
+                  << std::endl;
+        for (const auto& group : all) {
+            group->leader_silent(node);
+        }
+    }
+    return started + std::chrono::milliseconds(RaftGroup::HEARTBEAT_INTERVAL_MS);
+}
+
+void RaftManager::handle_group_heartbeat(const network::RpcHeader& header,
+                                         const std::vector<uint8_t>& payload, int client_fd) {
+    std::string leader_id;
+    std::vector<GroupHeartbeat> beats;
+    if (!deserialize_beats(payload, leader_id, beats)) return;
+    {
+        const std::scoped_lock<std::mutex> lock(heartbeat_mutex_);
+        last_heard_[leader_id] = std::chrono::steady_clock::now();
+        silent_.erase(leader_id);
+        heartbeat_stats_.messages_received++;
+    }
+
+    std::vector<GroupHeartbeatAck> acks;
+    acks.reserve(beats.size());
+    for (const auto& beat : beats) {
+        const auto group = get_group(beat.group_id);
+        if (!group) {
+            GroupHeartbeatAck ack;
+            ack.group_id = beat.group_id;
+            acks.push_back(ack);
+            continue;
+        }
+        acks.push_back(group->handle_heartbeat(leader_id, beat));
+    }
+    if (client_fd >= 0 && !rpc_server_.send_response(client_fd, header,
+                                                      network::RpcType::GroupHeartbeat,
+                                                      serialize_acks(acks))) {
+        std::cerr << "--- [RaftManager] send reply FAILED ---" << std::endl;
+    }
+}
+
 void RaftManager::handle_raft_rpc(const network::RpcHeader& header,
                                   const std::vector<uint8_t>& payload, int client_fd) {
     std::shared_ptr<RaftGroup> group;
@@ -73,6 +343,10 @@ void RaftManager::handle_raft_rpc(const network::RpcHeader& header,
         group->handle_request_vote(header, payload, client_fd);
     } else if (header.type == network::RpcType::AppendEntries) {
         group->handle_append_entries(header, payload, client_fd);
+    } else if (header.type == network::RpcType::InstallSnapshot) {
+        group->handle_install_snapshot(header, payload, client_fd);
+    } else if (header.type == network::RpcType::ReadIndex) {
+        group->handle_read_index(header, payload, client_fd);
     }
 }
 
@@ -0,0 +1,124 @@
+/**
+ * @file shuffle_writer.cpp
+ * @brief Streams a table's rows to the nodes that own them, one chunk at a time
+ */
+
+#include "distributed/shuffle_writer.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/cluster_manager.hpp"
+#include "executor/types.hpp"
+#include "network/rpc_client.hpp"
+#include "network/rpc_message.hpp"
+
+namespace cloudsql::cluster {
+
+void ShuffleWriter::Progress::fail(const std::string& reason) {
+    failed = true;
+    errors += reason + "; ";
+}
+
+ShuffleWriter::ShuffleWriter(ClusterManager& cm, std::vector<NodeInfo> destinations,
+                             std::string context_id, std::string table_name, size_t chunk_rows)
+    : context_id_(std::move(context_id)),
+      table_name_(std::move(table_name)),
+      chunk_rows_(chunk_rows == 0 ? 1 : chunk_rows),
+      progress_(std::make_shared<Progress>()) {
+    destinations_.reserve(destinations.size());
+    for (auto& node : destinations) {
+        Destination destination;
+        destination.client = cm.get_client(node);
+        if (!destination.client) {
+            progress_->fail("Connect failed to " + node.id);
+        }
+        destination.node = std::move(node);
+        destinations_.push_back(std::move(destination));
+    }
+    progress_->in_flight.assign(destinations_.size(), 0);
+}
+
+bool ShuffleWriter::add(size_t destination, executor::Tuple row) {
+    if (progress_->failed) {
+        return false;
+    }
+    auto& rows = destinations_[destination].rows;
+    rows.push_back(std::move(row));
+    if (rows.size() >= chunk_rows_) {
+        flush(destination, false);
+    }
+    return true;
+}
+
+bool ShuffleWriter::finish(std::string& error) {
+    for (size_t i = 0; i < destinations_.size(); ++i) {
+        flush(i, true);
+    }
+
+    std::unique_lock<std::mutex> lock(progress_->mutex);
+    const bool acked = progress_->acked_cv.wait_for(lock, CREDIT_TIMEOUT, [this] {
+        for (const size_t n : progress_->in_flight) {
+            if (n > 0) {
+                return false;
+            }
+        }
+        return true;
+    });
+    if (!acked) {
+        progress_->fail("Timed out waiting for shuffle acknowledgements");
+    }
+    error = progress_->errors;
+    return !progress_->failed;
+}
+
+void ShuffleWriter::flush(size_t index, bool last) {
+    auto& destination = destinations_[index];
+    network::PushDataArgs args;
+    args.context_id = context_id_;
+    args.table_name = table_name_;
+    args.rows = std::move(destination.rows);
+    args.last = last;
+    destination.rows.clear();
+
+    {
+        /* Credit: wait for a slot in the destination's window */
+        std::unique_lock<std::mutex> lock(progress_->mutex);
+        const bool credit = progress_->acked_cv.wait_for(lock, CREDIT_TIMEOUT, [&] {
+            return progress_->failed || progress_->in_flight[index] < MAX_IN_FLIGHT;
+        });
+        if (progress_->failed) {
+            return;
+        }
+        if (!credit) {
+            progress_->fail("No shuffle credit from " + destination.node.id);
+            return;
+        }
+        progress_->in_flight[index]++;
+    }
+
+    const bool columnar =
+        destination.client->peer_accepts(network::RpcHeader::FLAG_ACCEPT_COLUMNAR);
+    destination.client->call_async(
+        network::RpcType::PushData, args.serialize(columnar),
+        [progress = progress_, index, node_id = destination.node.id](network::RpcResult result) {
+            const std::scoped_lock<std::mutex> lock(progress->mutex);
+            progress->in_flight[index]--;
+            if (!result.ok) {
+                progress->fail("RPC failed to " + node_id);
+            } else {
+                auto reply = network::QueryResultsReply::deserialize(result.response);
+                if (!reply.success) {
+                    progress->fail("Push failed on " + node_id + ": " + reply.error_msg);
+                }
+            }
+            progress->acked_cv.notify_all();
+        });
+}
+
+}  // namespace cloudsql::cluster
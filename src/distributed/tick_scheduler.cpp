@@ -0,0 +1,114 @@
+/**
+ * @file tick_scheduler.cpp
+ * @brief Runs many periodic tasks on a small, fixed pool of threads
+ */
+
+#include "distributed/tick_scheduler.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace cloudsql::raft {
+
+TickScheduler::TickScheduler(size_t threads) : threads_(std::max<size_t>(1, threads)) {}
+
+TickScheduler::~TickScheduler() {
+    stop();
+}
+
+void TickScheduler::start() {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    if (running_) return;
+    running_ = true;
+    for (size_t i = 0; i < threads_; ++i) {
+        workers_.emplace_back(&TickScheduler::worker, this);
+    }
+}
+
+void TickScheduler::stop() {
+    {
+        const std::scoped_lock<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
+}
+
+void TickScheduler::add(uint32_t id, Task task) {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    Entry& entry = entries_[id];
+    entry.task = std::move(task);
+    if (entry.running) {
+        entry.woken = true;
+    } else {
+        schedule(id, entry, Clock::now());
+    }
+}
+
+void TickScheduler::wake(uint32_t id) {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    const auto it = entries_.find(id);
+    if (it == entries_.end()) return;
+    if (it->second.running) {
+        it->second.woken = true;
+    } else {
+        schedule(id, it->second, Clock::now());
+    }
+}
+
+uint64_t TickScheduler::runs() const {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    return runs_;
+}
+
+void TickScheduler::schedule(uint32_t id, Entry& entry, Clock::time_point due) {
+    if (due == Clock::time_point::max()) return;
+    if (entry.queued) {
+        if (entry.due <= due) return;
+        queue_.erase({entry.due, id});
+    }
+    entry.due = due;
+    entry.queued = true;
+    queue_.emplace(due, id);
+    cv_.notify_one();
+}
+
+void TickScheduler::worker() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        if (queue_.empty()) {
+            cv_.wait(lock);
+            continue;
+        }
+        const auto [due, id] = *queue_.begin();
+        if (due > Clock::now()) {
+            cv_.wait_until(lock, due);
+            continue;
+        }
+        queue_.erase(queue_.begin());
+        Entry& entry = entries_[id]; /* Entries are never erased, so the reference holds */
+        entry.queued = false;
+        entry.running = true;
+        const Task task = entry.task;
+
+        lock.unlock();
+        const Clock::time_point next = task();
+        lock.lock();
+
+        runs_++;
+        entry.running = false;
+        schedule(id, entry, entry.woken ? Clock::now() : next);
+        entry.woken = false;
+    }
+}
+
+}  // namespace cloudsql::raft
@@ -0,0 +1,668 @@
+/**
+ * @file aggregate_hash_table.cpp
+ * @brief Open-addressing GROUP BY table for the vectorized engine
+ */
+
+#include "executor/aggregate_hash_table.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "executor/vector_hash.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+constexpr uint64_t GLOBAL_HASH = 0xbb67ae8584caa73bULL;
+constexpr size_t INITIAL_SLOTS = 64;
+constexpr uint64_t ENTRY_MASK = 0xFFFFFFFFULL;
+
+using hashing::combine;
+using hashing::double_bits;
+using hashing::mix;
+using hashing::NULL_HASH;
+using hashing::string_hash;
+
+uint64_t make_slot(uint64_t hash, uint32_t entry) {
+    return (hash & ~ENTRY_MASK) | (static_cast<uint64_t>(entry) + 1);
+}
+
+/**
+ * @brief Linear probe for `hash`
+ * @return Position of the matching slot, or of the empty slot ending the probe
+ */
+template <typename Eq>
+size_t probe(const std::vector<uint64_t>& slots, uint64_t hash, Eq&& matches) {
+    const size_t mask = slots.size() - 1;
+    size_t pos = static_cast<size_t>(hash) & mask;
+    while (true) {
+        const uint64_t slot = slots[pos];
+        if (slot == 0) return pos;
+        if ((slot & ~ENTRY_MASK) == (hash & ~ENTRY_MASK) &&
+            matches(static_cast<uint32_t>((slot & ENTRY_MASK) - 1))) {
+            return pos;
+        }
+        pos = (pos + 1) & mask;
+    }
+}
+
+/** Rebuild `slots` at twice the size (or at least `minimum`) from per-entry hashes */
+template <typename HashOf>
+void rehash(std::vector<uint64_t>& slots, size_t entries, size_t minimum, HashOf&& hash_of) {
+    size_t capacity = slots.empty() ? INITIAL_SLOTS : slots.size() * 2;
+    while (capacity < minimum) capacity *= 2;
+    slots.assign(capacity, 0);
+    const size_t mask = capacity - 1;
+    for (size_t e = 0; e < entries; ++e) {
+        const uint64_t hash = hash_of(e);
+        size_t pos = static_cast<size_t>(hash) & mask;
+        while (slots[pos] != 0) pos = (pos + 1) & mask;
+        slots[pos] = make_slot(hash, static_cast<uint32_t>(e));
+    }
+}
+
+/* Typed view of one input column for the duration of a batch */
+struct ColumnView {
+    const int64_t* ints = nullptr;
+    const uint8_t* bools = nullptr;
+    const double* floats = nullptr;
+    const std::string* strings = nullptr;
+    const uint8_t* nulls = nullptr;
+};
+
+}  // namespace
+
+AggregateHashTable::AggregateHashTable(const Schema& input_schema,
+                                       std::vector<size_t> group_columns,
+                                       std::vector<VectorizedAggregateInfo> aggregates) {
+    const auto kind_of = [&input_schema](size_t column, const char* what) {
+        if (column >= input_schema.column_count()) {
+            throw std::runtime_error(std::string(what) + ": column " + std::to_string(column) +
+                                     " out of range");
+        }
+        switch (input_schema.get_column(column).type()) {
+            case common::ValueType::TYPE_INT8:
+            case common::ValueType::TYPE_INT16:
+            case common::ValueType::TYPE_INT32:
+            case common::ValueType::TYPE_INT64:
+                return DataKind::Int;
+            case common::ValueType::TYPE_BOOL:
+                return DataKind::Bool;
+            case common::ValueType::TYPE_FLOAT32:
+            case common::ValueType::TYPE_FLOAT64:
+                return DataKind::Float;
+            case common::ValueType::TYPE_CHAR:
+            case common::ValueType::TYPE_VARCHAR:
+            case common::ValueType::TYPE_TEXT:
+                return DataKind::String;
+            default:
+                throw std::runtime_error(
+                    std::string(what) + ": Unsupported column type " +
+                    std::to_string(static_cast<int>(input_schema.get_column(column).type())));
+        }
+    };
+
+    for (const size_t column : group_columns) {
+        keys_.push_back({column, kind_of(column, "GROUP BY"), {}, {}, {}, {}});
+    }
+    for (const auto& info : aggregates) {
+        AggregateState state{info, DataKind::Int, {}, {}, {}, {}, {}};
+        if (info.input_col_idx < 0) {
+            if (info.type != AggregateType::Count) {
+                throw std::runtime_error("Aggregate: only COUNT takes no input column");
+            }
+        } else {
+            state.kind = kind_of(static_cast<size_t>(info.input_col_idx), "Aggregate");
+            const bool numeric = state.kind == DataKind::Int || state.kind == DataKind::Float;
+            const bool ordered = numeric || state.kind == DataKind::String;
+            if (((info.type == AggregateType::Sum || info.type == AggregateType::Avg) &&
+                 !numeric) ||
+                ((info.type == AggregateType::Min || info.type == AggregateType::Max) &&
+                 !ordered)) {
+                throw std::runtime_error("Aggregate: Unsupported input type for column " +
+                                         std::to_string(info.input_col_idx));
+            }
+        }
+        aggregates_.push_back(std::move(state));
+    }
+
+    slots_.assign(INITIAL_SLOTS, 0);
+    // A global aggregate has exactly one group, present even without input
+    if (keys_.empty()) {
+        add_group(GLOBAL_HASH);
+    }
+}
+
+size_t AggregateHashTable::memory_bytes() const {
+    const auto bytes = [](const auto& values) {
+        return values.capacity() * sizeof(values[0]);
+    };
+    size_t total = bytes(group_hashes_) + bytes(slots_);
+    for (const auto& key : keys_) {
+        total += bytes(key.ints) + bytes(key.floats) + bytes(key.strings) + bytes(key.nulls);
+    }
+    for (const auto& state : aggregates_) {
+        total += bytes(state.counts) + bytes(state.ints) + bytes(state.floats) +
+                 bytes(state.strings);
+        const DistinctSet& distinct = state.distinct;
+        total += bytes(distinct.slots) + bytes(distinct.hashes) + bytes(distinct.groups) +
+                 bytes(distinct.ints) + bytes(distinct.floats) + bytes(distinct.strings);
+    }
+    return total;
+}
+
+void AggregateHashTable::grow() {
+    rehash(slots_, group_hashes_.size(), group_hashes_.size() * 2,
+           [this](size_t g) { return group_hashes_[g]; });
+}
+
+uint32_t AggregateHashTable::add_group(uint64_t hash) {
+    const auto group = static_cast<uint32_t>(group_hashes_.size());
+    group_hashes_.push_back(hash);
+    init_states(group);
+
+    // Keep the load factor at or below one half
+    if (group_hashes_.size() * 2 > slots_.size()) {
+        grow();
+    } else {
+        const size_t pos = probe(slots_, hash, [](uint32_t) { return false; });
+        slots_[pos] = make_slot(hash, group);
+    }
+    return group;
+}
+
+void AggregateHashTable::init_states(uint32_t group) {
+    static_cast<void>(group);
+    for (auto& agg : aggregates_) {
+        agg.counts.push_back(0);
+        if (agg.info.type == AggregateType::Count) continue;
+        if (agg.kind == DataKind::Float) {
+            agg.floats.push_back(0.0);
+        } else if (agg.kind == DataKind::String) {
+            agg.strings.emplace_back();
+        } else {
+            agg.ints.push_back(0);
+        }
+    }
+}
+
+void AggregateHashTable::accumulate(AggregateState& agg, uint32_t group, int64_t int_value,
+                                    double float_value, const std::string* string_value) {
+    const bool first = agg.counts[group] == 0;
+    agg.counts[group]++;
+    switch (agg.info.type) {
+        case AggregateType::Count:
+            return;
+        case AggregateType::Sum:
+        case AggregateType::Avg:
+            if (agg.kind == DataKind::Float) {
+                agg.floats[group] += float_value;
+            } else {
+                agg.ints[group] = static_cast<int64_t>(static_cast<uint64_t>(agg.ints[group]) +
+                                                       static_cast<uint64_t>(int_value));
+            }
+            return;
+        case AggregateType::Min:
+        case AggregateType::Max: {
+            const bool is_min = agg.info.type == AggregateType::Min;
+            if (agg.kind == DataKind::Float) {
+                double& cur = agg.floats[group];
+                if (first || (is_min ? float_value < cur : float_value > cur)) cur = float_value;
+            } else if (agg.kind == DataKind::String) {
+                std::string& cur = agg.strings[group];
+                if (first || (is_min ? *string_value < cur : *string_value > cur)) {
+                    cur = *string_value;
+                }
+            } else {
+                int64_t& cur = agg.ints[group];
+                if (first || (is_min ? int_value < cur : int_value > cur)) cur = int_value;
+            }
+            return;
+        }
+    }
+}
+
+bool AggregateHashTable::insert_distinct(AggregateState& agg, uint32_t group,
+                                         uint64_t value_hash, int64_t int_value,
+                                         double float_value, const std::string* string_value) {
+    DistinctSet& set = agg.distinct;
+    if (set.slots.empty()) set.slots.assign(INITIAL_SLOTS, 0);
+
+    const uint64_t hash = combine(mix(group), value_hash);
+    const size_t pos = probe(set.slots, hash, [&](uint32_t e) {
+        if (set.groups[e] != group) return false;
+        switch (agg.kind) {
+            case DataKind::Float:
+                return double_bits(set.floats[e]) == double_bits(float_value);
+            case DataKind::String:
+                return set.strings[e] == *string_value;
+            default:
+                return set.ints[e] == int_value;
+        }
+    });
+    if (set.slots[pos] != 0) return false;
+
+    const auto entry = static_cast<uint32_t>(set.groups.size());
+    set.hashes.push_back(value_hash);
+    set.groups.push_back(group);
+    if (agg.kind == DataKind::Float) {
+        set.floats.push_back(float_value);
+    } else if (agg.kind == DataKind::String) {
+        set.strings.push_back(*string_value);
+    } else {
+        set.ints.push_back(int_value);
+    }
+    if (set.groups.size() * 2 > set.slots.size()) {
+        rehash(set.slots, set.groups.size(), set.groups.size() * 2,
+               [&set](size_t e) { return combine(mix(set.groups[e]), set.hashes[e]); });
+    } else {
+        set.slots[pos] = make_slot(hash, entry);
+    }
+
+    accumulate(agg, group, int_value, float_value, string_value);
+    return true;
+}
+
+void AggregateHashTable::update_aggregate(AggregateState& agg, const VectorBatch& batch) {
+    const uint32_t* const groups = row_groups_.data();
+    if (agg.info.input_col_idx < 0) {
+        batch.for_each_selected([&](size_t r) { agg.counts[groups[r]]++; });
+        return;
+    }
+
+    const ColumnVector& col = batch.get_column(static_cast<size_t>(agg.info.input_col_idx));
+    ColumnView view;
+    view.nulls = col.null_data();
+    switch (agg.kind) {
+        case DataKind::Int:
+            view.ints = dynamic_cast<const NumericVector<int64_t>&>(col).raw_data();
+            break;
+        case DataKind::Bool:
+            view.bools = dynamic_cast<const NumericVector<bool>&>(col).raw_data();
+            break;
+        case DataKind::Float:
+            view.floats = dynamic_cast<const NumericVector<double>&>(col).raw_data();
+            break;
+        case DataKind::String:
+            view.strings = dynamic_cast<const StringVector&>(col).raw_data();
+            break;
+    }
+
+    if (agg.info.is_distinct) {
+        batch.for_each_selected([&](size_t r) {
+            if (view.nulls[r] != 0) return;
+            switch (agg.kind) {
+                case DataKind::Int:
+                    insert_distinct(agg, groups[r], mix(static_cast<uint64_t>(view.ints[r])),
+                                    view.ints[r], 0.0, nullptr);
+                    break;
+                case DataKind::Bool:
+                    insert_distinct(agg, groups[r], mix(view.bools[r]), view.bools[r], 0.0,
+                                    nullptr);
+                    break;
+                case DataKind::Float:
+                    insert_distinct(agg, groups[r], mix(double_bits(view.floats[r])), 0,
+                                    view.floats[r], nullptr);
+                    break;
+                case DataKind::String:
+                    insert_distinct(agg, groups[r], string_hash(view.strings[r]), 0, 0.0,
+                                    &view.strings[r]);
+                    break;
+            }
+        });
+        return;
+    }
+
+    // Tight per-aggregate loops for the common shapes; everything else goes row by row
+    int64_t* const counts = agg.counts.data();
+    if (agg.info.type == AggregateType::Count) {
+        batch.for_each_selected([&](size_t r) { counts[groups[r]] += 1 - view.nulls[r]; });
+        return;
+    }
+    if ((agg.info.type == AggregateType::Sum || agg.info.type == AggregateType::Avg) &&
+        agg.kind == DataKind::Int) {
+        int64_t* const sums = agg.ints.data();
+        batch.for_each_selected([&](size_t r) {
+            if (view.nulls[r] != 0) return;
+            sums[groups[r]] = static_cast<int64_t>(static_cast<uint64_t>(sums[groups[r]]) +
+                                                   static_cast<uint64_t>(view.ints[r]));
+            counts[groups[r]]++;
+        });
+        return;
+    }
+    if ((agg.info.type == AggregateType::Sum || agg.info.type == AggregateType::Avg) &&
+        agg.kind == DataKind::Float) {
+        double* const sums = agg.floats.data();
+        batch.for_each_selected([&](size_t r) {
+            if (view.nulls[r] != 0) return;
+            sums[groups[r]] += view.floats[r];
+            counts[groups[r]]++;
+        });
+        return;
+    }
+    batch.for_each_selected([&](size_t r) {
+        if (view.nulls[r] != 0) return;
+        switch (agg.kind) {
+            case DataKind::Float:
+                accumulate(agg, groups[r], 0, view.floats[r], nullptr);
+                break;
+            case DataKind::String:
+                accumulate(agg, groups[r], 0, 0.0, &view.strings[r]);
+                break;
+            default:
+                accumulate(agg, groups[r], view.ints[r], 0.0, nullptr);
+                break;
+        }
+    });
+}
+
+void AggregateHashTable::add_batch(const VectorBatch& batch) {
+    const size_t rows = batch.row_count();
+    if (rows == 0 || batch.selected_count() == 0) return;
+    row_groups_.resize(rows);
+
+    if (keys_.empty()) {
+        std::fill(row_groups_.begin(), row_groups_.end(), 0);
+    } else {
+        // Hash every key column over the whole batch before probing
+        std::vector<ColumnView> views(keys_.size());
+        row_hashes_.assign(rows, 0);
+        uint64_t* const hashes = row_hashes_.data();
+        for (size_t k = 0; k < keys_.size(); ++k) {
+            const ColumnVector& col = batch.get_column(keys_[k].input);
+            ColumnView& view = views[k];
+            view.nulls = col.null_data();
+            switch (keys_[k].kind) {
+                case DataKind::Int:
+                    view.ints = dynamic_cast<const NumericVector<int64_t>&>(col).raw_data();
+                    for (size_t r = 0; r < rows; ++r) {
+                        hashes[r] = combine(hashes[r], view.nulls[r] != 0
+                                                           ? NULL_HASH
+                                                           : static_cast<uint64_t>(view.ints[r]));
+                    }
+                    break;
+                case DataKind::Bool:
+                    view.bools = dynamic_cast<const NumericVector<bool>&>(col).raw_data();
+                    for (size_t r = 0; r < rows; ++r) {
+                        hashes[r] =
+                            combine(hashes[r], view.nulls[r] != 0 ? NULL_HASH : view.bools[r]);
+                    }
+                    break;
+                case DataKind::Float:
+                    view.floats = dynamic_cast<const NumericVector<double>&>(col).raw_data();
+                    for (size_t r = 0; r < rows; ++r) {
+                        hashes[r] = combine(hashes[r], view.nulls[r] != 0
+                                                           ? NULL_HASH
+                                                           : double_bits(view.floats[r]));
+                    }
+                    break;
+                case DataKind::String:
+                    view.strings = dynamic_cast<const StringVector&>(col).raw_data();
+                    batch.for_each_selected([&](size_t r) {
+                        hashes[r] = combine(hashes[r], view.nulls[r] != 0
+                                                           ? NULL_HASH
+                                                           : string_hash(view.strings[r]));
+                    });
+                    break;
+            }
+        }
+
+        const auto row_matches = [&](size_t r, uint32_t g) {
+            for (size_t k = 0; k < keys_.size(); ++k) {
+                const KeyColumn& key = keys_[k];
+                const ColumnView& view = views[k];
+                const bool is_null = view.nulls[r] != 0;
+                if (is_null != (key.nulls[g] != 0)) return false;
+                if (is_null) continue;
+                switch (key.kind) {
+                    case DataKind::Int:
+                        if (view.ints[r] != key.ints[g]) return false;
+                        break;
+                    case DataKind::Bool:
+                        if (view.bools[r] != key.ints[g]) return false;
+                        break;
+                    case DataKind::Float:
+                        if (double_bits(view.floats[r]) != double_bits(key.floats[g])) {
+                            return false;
+                        }
+                        break;
+                    case DataKind::String:
+                        if (view.strings[r] != key.strings[g]) return false;
+                        break;
+                }
+            }
+            return true;
+        };
+
+        batch.for_each_selected([&](size_t r) {
+            const uint64_t hash = hashes[r];
+            const size_t pos =
+                probe(slots_, hash, [&](uint32_t g) { return row_matches(r, g); });
+            if (slots_[pos] != 0) {
+                row_groups_[r] = static_cast<uint32_t>((slots_[pos] & ENTRY_MASK) - 1);
+                return;
+            }
+            for (size_t k = 0; k < keys_.size(); ++k) {
+                KeyColumn& key = keys_[k];
+                const ColumnView& view = views[k];
+                const bool is_null = view.nulls[r] != 0;
+                key.nulls.push_back(is_null ? 1 : 0);
+                switch (key.kind) {
+                    case DataKind::Int:
+                        key.ints.push_back(is_null ? 0 : view.ints[r]);
+                        break;
+                    case DataKind::Bool:
+                        key.ints.push_back(is_null ? 0 : view.bools[r]);
+                        break;
+                    case DataKind::Float:
+                        key.floats.push_back(is_null ? 0.0 : view.floats[r]);
+                        break;
+                    case DataKind::String:
+                        key.strings.push_back(is_null ? std::string() : view.strings[r]);
+                        break;
+                }
+            }
+            row_groups_[r] = add_group(hash);
+        });
+    }
+
+    for (auto& agg : aggregates_) {
+        update_aggregate(agg, batch);
+    }
+}
+
+void AggregateHashTable::merge(const AggregateHashTable& other) {
+    bool same_layout =
+        keys_.size() == other.keys_.size() && aggregates_.size() == other.aggregates_.size();
+    for (size_t k = 0; same_layout && k < keys_.size(); ++k) {
+        same_layout = keys_[k].kind == other.keys_[k].kind;
+    }
+    for (size_t a = 0; same_layout && a < aggregates_.size(); ++a) {
+        const auto& mine = aggregates_[a];
+        const auto& theirs = other.aggregates_[a];
+        same_layout = mine.kind == theirs.kind && mine.info.type == theirs.info.type &&
+                      mine.info.is_distinct == theirs.info.is_distinct;
+    }
+    if (!same_layout) {
+        throw std::runtime_error("AggregateHashTable::merge: tables have different layouts");
+    }
+
+    // Map every group of `other` onto a group here, creating the missing ones
+    std::vector<uint32_t> mapping(other.group_count());
+    for (size_t og = 0; og < other.group_count(); ++og) {
+        const uint64_t hash = other.group_hashes_[og];
+        const auto group_matches = [&](uint32_t g) {
+            for (size_t k = 0; k < keys_.size(); ++k) {
+                const KeyColumn& mine = keys_[k];
+                const KeyColumn& theirs = other.keys_[k];
+                if (mine.nulls[g] != theirs.nulls[og]) return false;
+                if (mine.nulls[g] != 0) continue;
+                if ((mine.kind == DataKind::Int || mine.kind == DataKind::Bool) &&
+                    mine.ints[g] != theirs.ints[og]) {
+                    return false;
+                }
+                if (mine.kind == DataKind::Float &&
+                    double_bits(mine.floats[g]) != double_bits(theirs.floats[og])) {
+                    return false;
+                }
+                if (mine.kind == DataKind::String && mine.strings[g] != theirs.strings[og]) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        const size_t pos = probe(slots_, hash, group_matches);
+        if (slots_[pos] != 0) {
+            mapping[og] = static_cast<uint32_t>((slots_[pos] & ENTRY_MASK) - 1);
+            continue;
+        }
+        for (size_t k = 0; k < keys_.size(); ++k) {
+            KeyColumn& mine = keys_[k];
+            const KeyColumn& theirs = other.keys_[k];
+            mine.nulls.push_back(theirs.nulls[og]);
+            if (mine.kind == DataKind::Float) {
+                mine.floats.push_back(theirs.floats[og]);
+            } else if (mine.kind == DataKind::String) {
+                mine.strings.push_back(theirs.strings[og]);
+            } else {
+                mine.ints.push_back(theirs.ints[og]);
+            }
+        }
+        mapping[og] = add_group(hash);
+    }
+
+    for (size_t a = 0; a < aggregates_.size(); ++a) {
+        AggregateState& agg = aggregates_[a];
+        const AggregateState& theirs = other.aggregates_[a];
+
+        // Distinct states are the value sets themselves: union them
+        if (agg.info.is_distinct) {
+            const DistinctSet& set = theirs.distinct;
+            for (size_t e = 0; e < set.groups.size(); ++e) {
+                insert_distinct(agg, mapping[set.groups[e]], set.hashes[e],
+                                set.ints.empty() ? 0 : set.ints[e],
+                                set.floats.empty() ? 0.0 : set.floats[e],
+                                set.strings.empty() ? nullptr : &set.strings[e]);
+            }
+            continue;
+        }
+
+        for (size_t og = 0; og < other.group_count(); ++og) {
+            const uint32_t g = mapping[og];
+            const int64_t their_count = theirs.counts[og];
+            if (their_count == 0) continue;
+            switch (agg.info.type) {
+                case AggregateType::Count:
+                    agg.counts[g] += their_count;
+                    break;
+                case AggregateType::Sum:
+                case AggregateType::Avg:
+                    if (agg.kind == DataKind::Float) {
+                        agg.floats[g] += theirs.floats[og];
+                    } else {
+                        agg.ints[g] = static_cast<int64_t>(static_cast<uint64_t>(agg.ints[g]) +
+                                                           static_cast<uint64_t>(theirs.ints[og]));
+                    }
+                    agg.counts[g] += their_count;
+                    break;
+                case AggregateType::Min:
+                case AggregateType::Max:
+                    // Folding their extreme in as one value yields the combined extreme
+                    accumulate(agg, g, theirs.ints.empty() ? 0 : theirs.ints[og],
+                               theirs.floats.empty() ? 0.0 : theirs.floats[og],
+                               theirs.strings.empty() ? nullptr : &theirs.strings[og]);
+                    agg.counts[g] += their_count - 1;
+                    break;
+            }
+        }
+    }
+}
+
+void AggregateHashTable::emit(size_t begin, size_t count, VectorBatch& out) const {
+    out.clear();
+    if (begin >= group_count()) return;
+    count = std::min(count, group_count() - begin);
+
+    const auto write = [count](ColumnVector& target, DataKind kind, const int64_t* ints,
+                               const double* floats, const std::string* strings,
+                               const uint8_t* nulls) {
+        if (auto* iv = dynamic_cast<NumericVector<int64_t>*>(&target)) {
+            iv->resize(count);
+            int64_t* const dst = iv->raw_data_mut();
+            for (size_t i = 0; i < count; ++i) {
+                dst[i] = kind == DataKind::Float ? static_cast<int64_t>(floats[i]) : ints[i];
+            }
+        } else if (auto* dv = dynamic_cast<NumericVector<double>*>(&target)) {
+            dv->resize(count);
+            double* const dst = dv->raw_data_mut();
+            for (size_t i = 0; i < count; ++i) {
+                dst[i] = kind == DataKind::Float ? floats[i] : static_cast<double>(ints[i]);
+            }
+        } else if (auto* bv = dynamic_cast<NumericVector<bool>*>(&target)) {
+            bv->resize(count);
+            uint8_t* const dst = bv->raw_data_mut();
+            for (size_t i = 0; i < count; ++i) {
+                dst[i] = static_cast<uint8_t>(kind == DataKind::Float ? floats[i] != 0.0
+                                                                      : ints[i] != 0);
+            }
+        } else if (auto* sv = dynamic_cast<StringVector*>(&target)) {
+            if (kind != DataKind::String) {
+                throw std::runtime_error("AggregateHashTable::emit: numeric result into a string");
+            }
+            sv->resize(count);
+            std::copy_n(strings, count, sv->raw_data_mut());
+        }
+        if (nulls != nullptr) {
+            for (size_t i = 0; i < count; ++i) {
+                if (nulls[i] != 0) target.set_null(i, true);
+            }
+        }
+    };
+
+    for (size_t k = 0; k < keys_.size(); ++k) {
+        const KeyColumn& key = keys_[k];
+        write(out.get_column(k), key.kind, key.ints.empty() ? nullptr : key.ints.data() + begin,
+              key.floats.empty() ? nullptr : key.floats.data() + begin,
+              key.strings.empty() ? nullptr : key.strings.data() + begin,
+              key.nulls.data() + begin);
+    }
+
+    std::vector<uint8_t> nulls(count);
+    std::vector<double> averages;
+    for (size_t a = 0; a < aggregates_.size(); ++a) {
+        const AggregateState& agg = aggregates_[a];
+        ColumnVector& target = out.get_column(keys_.size() + a);
+        const int64_t* const counts = agg.counts.data() + begin;
+        if (agg.info.type == AggregateType::Count) {
+            write(target, DataKind::Int, counts, nullptr, nullptr, nullptr);
+            continue;
+        }
+
+        // Every other aggregate is NULL over a group without non-NULL input
+        for (size_t i = 0; i < count; ++i) nulls[i] = counts[i] == 0 ? 1 : 0;
+        if (agg.info.type == AggregateType::Avg) {
+            averages.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                const double sum = agg.kind == DataKind::Float
+                                       ? agg.floats[begin + i]
+                                       : static_cast<double>(agg.ints[begin + i]);
+                averages[i] = counts[i] == 0 ? 0.0 : sum / static_cast<double>(counts[i]);
+            }
+            write(target, DataKind::Float, nullptr, averages.data(), nullptr, nulls.data());
+            continue;
+        }
+        write(target, agg.kind == DataKind::Bool ? DataKind::Int : agg.kind,
+              agg.ints.empty() ? nullptr : agg.ints.data() + begin,
+              agg.floats.empty() ? nullptr : agg.floats.data() + begin,
+              agg.strings.empty() ? nullptr : agg.strings.data() + begin, nulls.data());
+    }
+    out.set_row_count(count);
+}
+
+}  // namespace cloudsql::executor
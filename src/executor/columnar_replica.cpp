@@ -0,0 +1,377 @@
+/**
+ * @file columnar_replica.cpp
+ * @brief Columnar replicas of heap tables implementation
+ */
+
+#include "executor/columnar_replica.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cloudsql::executor {
+
+ColumnarReplicaManager::ColumnarReplicaManager(storage::BufferPoolManager& bpm,
+                                               transaction::TransactionManager& transaction_manager,
+                                               recovery::LogManager& log)
+    : bpm_(bpm),
+      transaction_manager_(transaction_manager),
+      log_(log),
+      caught_up_at_(Clock::now().time_since_epoch().count()) {
+    /* Earlier records are history: replicas start from a copy of the heap */
+    last_lsn_ = log_.get_persistent_lsn();
+    std::ifstream file(log_.log_file_path(), std::ios::binary | std::ios::ate);
+    if (file.is_open()) {
+        offset_ = static_cast<uint64_t>(file.tellg());
+    }
+}
+
+ColumnarReplicaManager::~ColumnarReplicaManager() { stop(); }
+
+bool ColumnarReplicaManager::attach(const TableInfo& table) {
+    Schema heap_schema;
+    Schema schema; /* Qualified like the heap scan's output, which plans resolve against */
+    for (const auto& col : table.columns) {
+        heap_schema.add_column(col.name, col.type);
+        schema.add_column(table.name + "." + col.name, col.type);
+    }
+
+    auto replica = std::make_shared<Replica>();
+    replica->table = std::make_shared<storage::ColumnarTable>(
+        table.name + ".replica", bpm_.get_storage_manager(), schema);
+    {
+        /* Transactions from here on are read from the log whole; the rest are copied */
+        const std::scoped_lock<std::mutex> lock(feed_mutex_);
+        if (replicas_.count(table.name) != 0) {
+            return true;
+        }
+        replica->first_txn = transaction_manager_.next_txn_id();
+        replicas_[table.name] = replica;
+    }
+    transaction_manager_.wait_for_running();
+
+    const auto& commit_log = transaction_manager_.commit_log();
+    const transaction::csn_t snapshot = commit_log.snapshot();
+    const auto committed = [&](uint64_t txn) {
+        return txn == 0 ||
+               (txn < replica->first_txn && commit_log.is_visible(txn, snapshot));
+    };
+
+    bool ok = replica->table->create();
+    std::unordered_map<uint64_t, uint64_t> rows;
+    if (ok) {
+        storage::HeapTable heap(table.name, bpm_, heap_schema);
+        auto iter = heap.scan();
+        storage::HeapTable::TupleMeta meta;
+        auto batch = VectorBatch::create(schema);
+        uint64_t row = 0;
+        try {
+            while (ok && iter.next_meta(meta)) {
+                if (!committed(meta.xmin) || (meta.xmax != 0 && committed(meta.xmax))) {
+                    continue;
+                }
+                batch->append_tuple(meta.tuple);
+                rows.emplace(row_key(iter.current_id()), row++);
+                if (batch->row_count() == replica->table->chunk_rows()) {
+                    ok = replica->table->append_batch(*batch);
+                    batch->clear();
+                }
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "--- [ColumnarReplica] " << table.name << ": " << e.what() << " ---"
+                      << std::endl;
+            ok = false;
+        }
+        if (ok && batch->row_count() != 0) {
+            ok = replica->table->append_batch(*batch);
+        }
+    }
+
+    {
+        const std::scoped_lock<std::mutex> lock(feed_mutex_);
+        const auto it = replicas_.find(table.name);
+        if (it == replicas_.end() || it->second != replica) {
+            ok = false; /* Detached meanwhile */
+        } else if (ok) {
+            replica->rows = std::move(rows);
+            ok = apply(*replica, replica->pending);
+            replica->pending.clear();
+            replica->ready = ok;
+        }
+        if (!ok && it != replicas_.end() && it->second == replica) {
+            replicas_.erase(it);
+        }
+    }
+    if (!ok) {
+        std::cerr << "--- [ColumnarReplica] Failed to build the replica of " << table.name
+                  << " ---" << std::endl;
+        static_cast<void>(replica->table->drop());
+        return false;
+    }
+    compactor_.add_table(replica->table);
+    return true;
+}
+
+void ColumnarReplicaManager::detach(const std::string& table) {
+    std::shared_ptr<Replica> replica;
+    {
+        const std::scoped_lock<std::mutex> lock(feed_mutex_);
+        const auto it = replicas_.find(table);
+        if (it == replicas_.end()) {
+            return;
+        }
+        replica = std::move(it->second);
+        replicas_.erase(it);
+    }
+    static_cast<void>(replica->table->drop());
+}
+
+bool ColumnarReplicaManager::attached(const std::string& table) {
+    const std::scoped_lock<std::mutex> lock(feed_mutex_);
+    return replicas_.count(table) != 0;
+}
+
+std::shared_ptr<storage::ColumnarTable> ColumnarReplicaManager::snapshot(const std::string& table) {
+    const std::scoped_lock<std::mutex> lock(feed_mutex_);
+    const auto it = replicas_.find(table);
+    if (it == replicas_.end() || !it->second->ready) {
+        return nullptr;
+    }
+    if (lag() > options_.max_lag && !read_log()) {
+        return nullptr;
+    }
+    const Replica& replica = *it->second;
+    if (replica.failed) {
+        return nullptr;
+    }
+    return std::make_shared<storage::ColumnarTable>(*replica.table);
+}
+
+bool ColumnarReplicaManager::catch_up() {
+    const std::scoped_lock<std::mutex> lock(feed_mutex_);
+    return read_log();
+}
+
+std::chrono::milliseconds ColumnarReplicaManager::lag() const {
+    const Clock::time_point caught_up{Clock::duration(caught_up_at_.load())};
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - caught_up);
+}
+
+bool ColumnarReplicaManager::read_log() {
+    const Clock::time_point started = Clock::now();
+    const recovery::lsn_t durable = log_.get_persistent_lsn();
+    stats_.passes.fetch_add(1, std::memory_order_relaxed);
+
+    std::ifstream file(log_.log_file_path(), std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    const auto file_size = static_cast<uint64_t>(file.tellg());
+    std::vector<char> data(file_size > offset_ ? file_size - offset_ : 0);
+    file.seekg(static_cast<std::streamoff>(offset_));
+    if (!data.empty() && !file.read(data.data(), static_cast<std::streamsize>(data.size()))) {
+        std::cerr << "--- [ColumnarReplica] Could not read " << log_.log_file_path() << " ---"
+                  << std::endl;
+        return false;
+    }
+
+    /* Stop at a record not yet whole or durable; the next pass starts there */
+    std::vector<Change> committed;
+    size_t pos = 0;
+    while (data.size() - pos >= recovery::LogRecord::HEADER_SIZE) {
+        uint32_t size = 0;
+        const char* const bytes = std::next(data.data(), static_cast<std::ptrdiff_t>(pos));
+        std::memcpy(&size, bytes, sizeof(uint32_t));
+        if (size < recovery::LogRecord::HEADER_SIZE || size > data.size() - pos) {
+            break;
+        }
+        const recovery::LogRecord record = recovery::LogRecord::deserialize(bytes);
+        if (record.lsn_ <= last_lsn_ || record.lsn_ > durable) {
+            break;
+        }
+        last_lsn_ = record.lsn_;
+        pos += size;
+        stats_.records_read.fetch_add(1, std::memory_order_relaxed);
+        handle(record, committed);
+    }
+    offset_ += pos;
+
+    /* Each replica's changes in commit order */
+    std::unordered_map<std::string, std::vector<Change>> by_table;
+    for (auto& change : committed) {
+        std::string name = change.table;
+        by_table[name].push_back(std::move(change));
+    }
+    for (auto& [name, changes] : by_table) {
+        const auto it = replicas_.find(name);
+        if (it == replicas_.end()) {
+            continue;
+        }
+        Replica& replica = *it->second;
+        if (!replica.ready) {
+            std::move(changes.begin(), changes.end(), std::back_inserter(replica.pending));
+        } else if (!replica.failed && !apply(replica, changes)) {
+            std::cerr << "--- [ColumnarReplica] Failed to apply changes to the replica of "
+                      << name << "; reads go to the heap ---" << std::endl;
+            replica.failed = true;
+        }
+    }
+
+    if (last_lsn_ >= durable) {
+        caught_up_at_.store(started.time_since_epoch().count());
+    }
+    return true;
+}
+
+void ColumnarReplicaManager::handle(const recovery::LogRecord& record,
+                                    std::vector<Change>& committed) {
+    using recovery::LogRecordType;
+    const auto change = [&](const storage::HeapTable::TupleId& rid, const Tuple& row,
+                            bool insert) {
+        const auto it = replicas_.find(record.table_name_);
+        if (it != replicas_.end() && record.txn_id_ >= it->second->first_txn) {
+            open_txns_[record.txn_id_].push_back({record.table_name_, insert, rid, row});
+        }
+    };
+
+    switch (record.type_) {
+        case LogRecordType::INSERT:
+            change(record.rid_, record.tuple_, true);
+            break;
+        case LogRecordType::INSERT_BATCH:
+            for (size_t i = 0; i < record.rids_.size() && i < record.tuples_.size(); ++i) {
+                change(record.rids_[i], record.tuples_[i], true);
+            }
+            break;
+        case LogRecordType::MARK_DELETE:
+            change(record.rid_, record.old_tuple_, false);
+            break;
+        case LogRecordType::UPDATE:
+            change(record.rid_, record.old_tuple_, false);
+            change(record.rid_, record.tuple_, true);
+            break;
+        case LogRecordType::COMMIT: {
+            const auto it = open_txns_.find(record.txn_id_);
+            if (it != open_txns_.end()) {
+                std::move(it->second.begin(), it->second.end(), std::back_inserter(committed));
+                open_txns_.erase(it);
+            }
+            break;
+        }
+        case LogRecordType::ABORT:
+            open_txns_.erase(record.txn_id_);
+            break;
+        default:
+            break; /* CLRs undo changes of transactions that end in an ABORT */
+    }
+}
+
+bool ColumnarReplicaManager::apply(Replica& replica, std::vector<Change>& changes) {
+    storage::ColumnarTable& table = *replica.table;
+    auto batch = VectorBatch::create(table.schema());
+    std::vector<uint64_t> batch_keys;
+    std::unordered_map<uint64_t, size_t> in_batch; /* Key -> position in batch */
+    std::vector<uint64_t> deletes;
+
+    const auto flush_inserts = [&]() {
+        if (batch->row_count() == 0) return true;
+        uint64_t first = 0;
+        if (!table.insert_batch(*batch, &first)) return false;
+        for (size_t i = 0; i < batch_keys.size(); ++i) {
+            replica.rows[batch_keys[i]] = first + i;
+        }
+        stats_.rows_inserted.fetch_add(batch_keys.size(), std::memory_order_relaxed);
+        batch->clear();
+        batch_keys.clear();
+        in_batch.clear();
+        return true;
+    };
+    const auto remove = [&](uint64_t key) {
+        const auto it = replica.rows.find(key);
+        if (it != replica.rows.end()) {
+            deletes.push_back(it->second);
+            replica.rows.erase(it);
+        }
+    };
+
+    try {
+        for (auto& change : changes) {
+            const uint64_t key = row_key(change.rid);
+            /* A row added by this batch needs its id before it can be deleted */
+            if (in_batch.count(key) != 0 && !flush_inserts()) {
+                return false;
+            }
+            remove(key);
+            if (change.insert) {
+                in_batch[key] = batch->row_count();
+                batch->append_tuple(change.row);
+                batch_keys.push_back(key);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "--- [ColumnarReplica] " << table.name() << ": " << e.what() << " ---"
+                  << std::endl;
+        return false;
+    }
+    if (!flush_inserts()) {
+        return false;
+    }
+    if (!deletes.empty()) {
+        if (!table.delete_rows(deletes)) return false;
+        stats_.rows_deleted.fetch_add(deletes.size(), std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void ColumnarReplicaManager::start(const Options& options) {
+    {
+        const std::scoped_lock<std::mutex> lock(feed_mutex_);
+        options_ = options;
+    }
+    {
+        const std::scoped_lock<std::mutex> lock(worker_latch_);
+        if (worker_.joinable()) {
+            return;
+        }
+        naptime_ = options.naptime;
+        worker_stop_ = false;
+        worker_ = std::thread(&ColumnarReplicaManager::run, this);
+    }
+    compactor_.start({options.naptime});
+}
+
+void ColumnarReplicaManager::stop() {
+    compactor_.stop();
+    {
+        const std::scoped_lock<std::mutex> lock(worker_latch_);
+        if (!worker_.joinable()) {
+            return;
+        }
+        worker_stop_ = true;
+    }
+    worker_cv_.notify_all();
+    worker_.join();
+}
+
+void ColumnarReplicaManager::run() {
+    std::unique_lock<std::mutex> lock(worker_latch_);
+    while (!worker_cv_.wait_for(lock, naptime_, [this] { return worker_stop_; })) {
+        lock.unlock();
+        static_cast<void>(catch_up());
+        lock.lock();
+    }
+}
+
+}  // namespace cloudsql::executor
@@ -0,0 +1,368 @@
+/**
+ * @file compiled_expression.cpp
+ * @brief Compilation of expressions into closure trees
+ */
+
+#include "executor/compiled_expression.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "common/value.hpp"
+#include "executor/types.hpp"
+#include "parser/expression.hpp"
+#include "parser/token.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+using ValueFn = CompiledExpression::ValueFn;
+using PredicateFn = CompiledExpression::PredicateFn;
+using parser::TokenType;
+
+constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+
+ValueFn compile_value(const parser::Expression& expr, const Schema& schema);
+PredicateFn compile_predicate(const parser::Expression& expr, const Schema& schema);
+
+/* Same lookup as ColumnExpr::evaluate(): exact name, then the unqualified name */
+size_t resolve_column(const parser::ColumnExpr& column, const Schema& schema) {
+    size_t index = schema.find_column(column.to_string());
+    if (index == NOT_FOUND && column.has_table()) {
+        index = schema.find_column(column.name());
+    }
+    return index;
+}
+
+ValueFn constant(common::Value value) {
+    return [value = std::move(value)](const Tuple&, common::Value&) -> const common::Value& {
+        return value;
+    };
+}
+
+ValueFn column_ref(size_t index) {
+    if (index == NOT_FOUND) {
+        return constant(common::Value::make_null());
+    }
+    return [index](const Tuple& tuple, common::Value&) -> const common::Value& {
+        return tuple.get(index);
+    };
+}
+
+/* Box a predicate's result, as the interpreter's comparison operators do */
+ValueFn boxed(PredicateFn predicate) {
+    return [predicate = std::move(predicate)](const Tuple& tuple,
+                                              common::Value& scratch) -> const common::Value& {
+        scratch = common::Value(predicate(tuple));
+        return scratch;
+    };
+}
+
+bool is_comparison(TokenType op) {
+    return op == TokenType::Eq || op == TokenType::Ne || op == TokenType::Lt ||
+           op == TokenType::Le || op == TokenType::Gt || op == TokenType::Ge;
+}
+
+/* The comparison `b op a` that is equivalent to `a op b` */
+TokenType mirrored(TokenType op) {
+    switch (op) {
+        case TokenType::Lt:
+            return TokenType::Gt;
+        case TokenType::Le:
+            return TokenType::Ge;
+        case TokenType::Gt:
+            return TokenType::Lt;
+        case TokenType::Ge:
+            return TokenType::Le;
+        default:
+            return op;
+    }
+}
+
+template <TokenType Op>
+bool compare(const common::Value& left, const common::Value& right) {
+    if constexpr (Op == TokenType::Eq) return left == right;
+    if constexpr (Op == TokenType::Ne) return left != right;
+    if constexpr (Op == TokenType::Lt) return left < right;
+    if constexpr (Op == TokenType::Le) return left <= right;
+    if constexpr (Op == TokenType::Gt) return left > right;
+    if constexpr (Op == TokenType::Ge) return left >= right;
+    return false;
+}
+
+template <TokenType Op>
+PredicateFn generic_compare(ValueFn left, ValueFn right) {
+    return [left = std::move(left), right = std::move(right)](const Tuple& tuple) {
+        common::Value left_scratch;
+        common::Value right_scratch;
+        return compare<Op>(left(tuple, left_scratch), right(tuple, right_scratch));
+    };
+}
+
+/**
+ * `column op constant` for an INT64 (T = int64_t) or FLOAT64 (T = double)
+ * constant. Mirrors Value's operators: values of the constant's own type
+ * compare for equality natively, other numeric values through double, and
+ * orderings always go through double with NULL sorting after everything.
+ */
+template <typename T, TokenType Op>
+PredicateFn column_compare(size_t index, const common::Value& constant_value) {
+    const common::ValueType type = constant_value.type();
+    T native{};
+    if constexpr (std::is_same_v<T, int64_t>) {
+        native = constant_value.to_int64();
+    } else {
+        native = constant_value.to_float64();
+    }
+    const double as_double = constant_value.to_float64();
+
+    return [index, type, native, as_double](const Tuple& tuple) {
+        const common::Value& value = tuple.get(index);
+        if constexpr (Op == TokenType::Eq || Op == TokenType::Ne) {
+            bool equal = false;
+            if (value.type() == type) {
+                if constexpr (std::is_same_v<T, int64_t>) {
+                    equal = value.to_int64() == native;
+                } else {
+                    equal = value.to_float64() == native;
+                }
+            } else {
+                equal = value.is_numeric() && value.to_float64() == as_double;
+            }
+            return Op == TokenType::Eq ? equal : !equal;
+        } else {
+            if (value.is_null()) {
+                return Op == TokenType::Gt || Op == TokenType::Ge;
+            }
+            if (!value.is_numeric()) {
+                return Op == TokenType::Le || Op == TokenType::Ge;
+            }
+            const double v = value.to_float64();
+            if constexpr (Op == TokenType::Lt) return v < as_double;
+            if constexpr (Op == TokenType::Le) return !(as_double < v);
+            if constexpr (Op == TokenType::Gt) return as_double < v;
+            return !(v < as_double);
+        }
+    };
+}
+
+template <typename T>
+PredicateFn column_compare(TokenType op, size_t index, const common::Value& value) {
+    switch (op) {
+        case TokenType::Eq:
+            return column_compare<T, TokenType::Eq>(index, value);
+        case TokenType::Ne:
+            return column_compare<T, TokenType::Ne>(index, value);
+        case TokenType::Lt:
+            return column_compare<T, TokenType::Lt>(index, value);
+        case TokenType::Le:
+            return column_compare<T, TokenType::Le>(index, value);
+        case TokenType::Gt:
+            return column_compare<T, TokenType::Gt>(index, value);
+        default:
+            return column_compare<T, TokenType::Ge>(index, value);
+    }
+}
+
+PredicateFn compile_comparison(const parser::BinaryExpr& expr, const Schema& schema) {
+    // Typed fast path: a resolved column against an INT64 / FLOAT64 literal
+    const bool flipped = expr.left().type() == parser::ExprType::Constant &&
+                         expr.right().type() == parser::ExprType::Column;
+    const parser::Expression& col_side = flipped ? expr.right() : expr.left();
+    const parser::Expression& const_side = flipped ? expr.left() : expr.right();
+    if (col_side.type() == parser::ExprType::Column &&
+        const_side.type() == parser::ExprType::Constant) {
+        const size_t index =
+            resolve_column(static_cast<const parser::ColumnExpr&>(col_side), schema);
+        const common::Value& value = static_cast<const parser::ConstantExpr&>(const_side).value();
+        const TokenType op = flipped ? mirrored(expr.op()) : expr.op();
+        if (index != NOT_FOUND && value.type() == common::ValueType::TYPE_INT64) {
+            return column_compare<int64_t>(op, index, value);
+        }
+        if (index != NOT_FOUND && value.type() == common::ValueType::TYPE_FLOAT64) {
+            return column_compare<double>(op, index, value);
+        }
+    }
+
+    ValueFn left = compile_value(expr.left(), schema);
+    ValueFn right = compile_value(expr.right(), schema);
+    switch (expr.op()) {
+        case TokenType::Eq:
+            return generic_compare<TokenType::Eq>(std::move(left), std::move(right));
+        case TokenType::Ne:
+            return generic_compare<TokenType::Ne>(std::move(left), std::move(right));
+        case TokenType::Lt:
+            return generic_compare<TokenType::Lt>(std::move(left), std::move(right));
+        case TokenType::Le:
+            return generic_compare<TokenType::Le>(std::move(left), std::move(right));
+        case TokenType::Gt:
+            return generic_compare<TokenType::Gt>(std::move(left), std::move(right));
+        default:
+            return generic_compare<TokenType::Ge>(std::move(left), std::move(right));
+    }
+}
+
+/* Same promotion rules as BinaryExpr::evaluate() */
+ValueFn compile_arithmetic(const parser::BinaryExpr& expr, const Schema& schema) {
+    const TokenType op = expr.op();
+    return [op, left = compile_value(expr.left(), schema),
+            right = compile_value(expr.right(), schema)](
+               const Tuple& tuple, common::Value& scratch) -> const common::Value& {
+        common::Value left_scratch;
+        common::Value right_scratch;
+        const common::Value& l = left(tuple, left_scratch);
+        const common::Value& r = right(tuple, right_scratch);
+        const bool is_float = l.type() == common::ValueType::TYPE_FLOAT64 ||
+                              r.type() == common::ValueType::TYPE_FLOAT64;
+        switch (op) {
+            case TokenType::Plus:
+                scratch = is_float ? common::Value::make_float64(l.to_float64() + r.to_float64())
+                                   : common::Value::make_int64(l.to_int64() + r.to_int64());
+                break;
+            case TokenType::Minus:
+                scratch = is_float ? common::Value::make_float64(l.to_float64() - r.to_float64())
+                                   : common::Value::make_int64(l.to_int64() - r.to_int64());
+                break;
+            case TokenType::Star:
+                scratch = is_float ? common::Value::make_float64(l.to_float64() * r.to_float64())
+                                   : common::Value::make_int64(l.to_int64() * r.to_int64());
+                break;
+            default:
+                scratch = common::Value::make_float64(l.to_float64() / r.to_float64());
+                break;
+        }
+        return scratch;
+    };
+}
+
+PredicateFn compile_in(const parser::InExpr& expr, const Schema& schema) {
+    std::vector<ValueFn> values;
+    values.reserve(expr.values().size());
+    for (const auto& value : expr.values()) {
+        values.push_back(compile_value(*value, schema));
+    }
+    return [column = compile_value(expr.column(), schema), values = std::move(values),
+            not_flag = expr.not_flag()](const Tuple& tuple) {
+        common::Value column_scratch;
+        const common::Value& column_value = column(tuple, column_scratch);
+        for (const auto& value : values) {
+            common::Value value_scratch;
+            if (column_value == value(tuple, value_scratch)) {
+                return !not_flag;
+            }
+        }
+        return not_flag;
+    };
+}
+
+ValueFn compile_value(const parser::Expression& expr, const Schema& schema) {
+    switch (expr.type()) {
+        case parser::ExprType::Constant:
+            return constant(static_cast<const parser::ConstantExpr&>(expr).value());
+        case parser::ExprType::Column:
+            return column_ref(resolve_column(static_cast<const parser::ColumnExpr&>(expr), schema));
+        case parser::ExprType::Function:
+            // Only aggregate results computed below us can be referenced
+            return column_ref(schema.find_column(expr.to_string()));
+        case parser::ExprType::Binary: {
+            const auto& binary = static_cast<const parser::BinaryExpr&>(expr);
+            switch (binary.op()) {
+                case TokenType::Plus:
+                case TokenType::Minus:
+                case TokenType::Star:
+                case TokenType::Slash:
+                    return compile_arithmetic(binary, schema);
+                default:
+                    if (is_comparison(binary.op()) || binary.op() == TokenType::And ||
+                        binary.op() == TokenType::Or) {
+                        return boxed(compile_predicate(expr, schema));
+                    }
+                    return constant(common::Value::make_null());
+            }
+        }
+        case parser::ExprType::Unary: {
+            const auto& unary = static_cast<const parser::UnaryExpr&>(expr);
+            if (unary.op() == TokenType::Not) {
+                return boxed(compile_predicate(expr, schema));
+            }
+            if (unary.op() != TokenType::Minus) {
+                return constant(common::Value::make_null());
+            }
+            return [operand = compile_value(unary.expr(), schema)](
+                       const Tuple& tuple, common::Value& scratch) -> const common::Value& {
+                common::Value operand_scratch;
+                const common::Value& value = operand(tuple, operand_scratch);
+                scratch = value.is_numeric() ? common::Value(-value.to_float64())
+                                             : common::Value::make_null();
+                return scratch;
+            };
+        }
+        case parser::ExprType::In:
+        case parser::ExprType::IsNull:
+            return boxed(compile_predicate(expr, schema));
+        default: {
+            // Anything else keeps the interpreter
+            std::shared_ptr<const parser::Expression> owned = expr.clone();
+            return [owned = std::move(owned), schema](
+                       const Tuple& tuple, common::Value& scratch) -> const common::Value& {
+                scratch = owned->evaluate(&tuple, &schema);
+                return scratch;
+            };
+        }
+    }
+}
+
+PredicateFn compile_predicate(const parser::Expression& expr, const Schema& schema) {
+    if (expr.type() == parser::ExprType::Binary) {
+        const auto& binary = static_cast<const parser::BinaryExpr&>(expr);
+        if (is_comparison(binary.op())) {
+            return compile_comparison(binary, schema);
+        }
+        if (binary.op() == TokenType::And || binary.op() == TokenType::Or) {
+            PredicateFn left = compile_predicate(binary.left(), schema);
+            PredicateFn right = compile_predicate(binary.right(), schema);
+            if (binary.op() == TokenType::And) {
+                return [left = std::move(left), right = std::move(right)](const Tuple& tuple) {
+                    return left(tuple) && right(tuple);
+                };
+            }
+            return [left = std::move(left), right = std::move(right)](const Tuple& tuple) {
+                return left(tuple) || right(tuple);
+            };
+        }
+    } else if (expr.type() == parser::ExprType::Unary) {
+        const auto& unary = static_cast<const parser::UnaryExpr&>(expr);
+        if (unary.op() == TokenType::Not) {
+            return [operand = compile_predicate(unary.expr(), schema)](const Tuple& tuple) {
+                return !operand(tuple);
+            };
+        }
+    } else if (expr.type() == parser::ExprType::IsNull) {
+        const auto& is_null = static_cast<const parser::IsNullExpr&>(expr);
+        return [operand = compile_value(is_null.expr(), schema),
+                not_flag = is_null.not_flag()](const Tuple& tuple) {
+            common::Value scratch;
+            return operand(tuple, scratch).is_null() != not_flag;
+        };
+    } else if (expr.type() == parser::ExprType::In) {
+        return compile_in(static_cast<const parser::InExpr&>(expr), schema);
+    }
+
+    // Not boolean by construction: test the value like FilterOperator always has
+    return [value = compile_value(expr, schema)](const Tuple& tuple) {
+        common::Value scratch;
+        return value(tuple, scratch).as_bool();
+    };
+}
+
+}  // namespace
+
+CompiledExpression::CompiledExpression(const parser::Expression& expr, const Schema& schema)
+    : value_(compile_value(expr, schema)), predicate_(compile_predicate(expr, schema)) {}
+
+}  // namespace cloudsql::executor
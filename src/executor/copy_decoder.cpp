@@ -0,0 +1,386 @@
+/**
+ * @file copy_decoder.cpp
+ * @brief Parses COPY FROM STDIN data in the text, CSV and binary formats
+ */
+
+#include "executor/copy_decoder.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "common/value.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+/* Binary header: signature, int32 flags, int32 length of the header extension */
+constexpr size_t BINARY_HEADER_SIZE = CopyDecoder::BINARY_SIGNATURE.size() + 8;
+constexpr uint32_t BINARY_FLAG_OIDS = 1U << 16U;
+
+uint64_t read_be(const char* data, size_t bytes) {
+    uint64_t val = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        val = (val << 8U) | static_cast<uint8_t>(data[i]);
+    }
+    return val;
+}
+
+int32_t read_be32(const char* data) {
+    return static_cast<int32_t>(static_cast<uint32_t>(read_be(data, 4)));
+}
+
+bool is_integer_type(common::ValueType type) {
+    return type == common::ValueType::TYPE_INT8 || type == common::ValueType::TYPE_INT16 ||
+           type == common::ValueType::TYPE_INT32 || type == common::ValueType::TYPE_INT64;
+}
+
+bool is_float_type(common::ValueType type) {
+    return type == common::ValueType::TYPE_FLOAT32 || type == common::ValueType::TYPE_FLOAT64;
+}
+
+}  // namespace
+
+void CopyDecoder::feed(const char* data, size_t size, std::vector<Tuple>& rows) {
+    if (ended_) {
+        return; /* Anything after the end marker is ignored */
+    }
+    pending_.append(data, size);
+    bool more = true;
+    while (more && !ended_) {
+        switch (options_.format) {
+            case parser::CopyFormat::Text:
+                more = next_text_row(rows);
+                break;
+            case parser::CopyFormat::Csv:
+                more = next_csv_row(rows, false);
+                break;
+            case parser::CopyFormat::Binary:
+                more = next_binary_row(rows);
+                break;
+        }
+    }
+    pending_.erase(0, pos_);
+    pos_ = 0;
+}
+
+void CopyDecoder::finish(std::vector<Tuple>& rows) {
+    if (!ended_ && pos_ < pending_.size()) {
+        switch (options_.format) {
+            case parser::CopyFormat::Text:
+                pending_.push_back('\n');
+                static_cast<void>(next_text_row(rows));
+                break;
+            case parser::CopyFormat::Csv:
+                static_cast<void>(next_csv_row(rows, true));
+                break;
+            case parser::CopyFormat::Binary:
+                fail("unexpected end of binary COPY data");
+        }
+    }
+    pending_.clear();
+    pos_ = 0;
+}
+
+bool CopyDecoder::next_text_row(std::vector<Tuple>& rows) {
+    const size_t end = pending_.find('\n', pos_);
+    if (end == std::string::npos) {
+        return false;
+    }
+    std::string_view line(pending_.data() + pos_, end - pos_);
+    pos_ = end + 1;
+    ++line_;
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    if (line == "\\.") {
+        ended_ = true;
+        return false;
+    }
+
+    fields_.clear();
+    nulls_.clear();
+    for (size_t i = 0;; ++i) {
+        const size_t start = i;
+        std::string field;
+        for (; i < line.size() && line[i] != options_.delimiter; ++i) {
+            if (line[i] != '\\' || i + 1 == line.size()) {
+                field.push_back(line[i]);
+                continue;
+            }
+            const char c = line[++i];
+            switch (c) {
+                case 'b':
+                    field.push_back('\b');
+                    break;
+                case 'f':
+                    field.push_back('\f');
+                    break;
+                case 'n':
+                    field.push_back('\n');
+                    break;
+                case 'r':
+                    field.push_back('\r');
+                    break;
+                case 't':
+                    field.push_back('\t');
+                    break;
+                case 'v':
+                    field.push_back('\v');
+                    break;
+                default:
+                    field.push_back(c);
+                    break;
+            }
+        }
+        nulls_.push_back(line.substr(start, i - start) == "\\N");
+        fields_.push_back(std::move(field));
+        if (i >= line.size()) {
+            break;
+        }
+    }
+    add_text_row(rows);
+    return true;
+}
+
+bool CopyDecoder::next_csv_row(std::vector<Tuple>& rows, bool at_end) {
+    fields_.clear();
+    nulls_.clear();
+    std::string field;
+    bool quoted = false;
+    bool in_quotes = false;
+    size_t i = pos_;
+    for (; i < pending_.size(); ++i) {
+        const char c = pending_[i];
+        if (in_quotes) {
+            if (c != '"') {
+                field.push_back(c);
+            } else if (i + 1 < pending_.size() && pending_[i + 1] == '"') {
+                field.push_back('"');
+                ++i;
+            } else if (i + 1 == pending_.size() && !at_end) {
+                return false; /* The quote may be the first of a doubled pair */
+            } else {
+                in_quotes = false;
+            }
+        } else if (c == '"') {
+            in_quotes = true;
+            quoted = true;
+        } else if (c == options_.delimiter) {
+            nulls_.push_back(!quoted && field.empty());
+            fields_.push_back(std::move(field));
+            field.clear();
+            quoted = false;
+        } else if (c == '\n') {
+            break;
+        } else if (c != '\r') {
+            field.push_back(c);
+        }
+    }
+    if (i == pending_.size()) {
+        if (!at_end || i == pos_) {
+            return false;
+        }
+        if (in_quotes) {
+            ++line_;
+            fail("unterminated CSV quoted field");
+        }
+    }
+    pos_ = std::min(i + 1, pending_.size());
+    ++line_;
+    nulls_.push_back(!quoted && field.empty());
+    fields_.push_back(std::move(field));
+
+    if (!started_) {
+        started_ = true;
+        if (options_.header) {
+            return true;
+        }
+    }
+    if (fields_.size() == 1 && !quoted && fields_[0] == "\\.") {
+        ended_ = true;
+        return false;
+    }
+    add_text_row(rows);
+    return true;
+}
+
+bool CopyDecoder::next_binary_row(std::vector<Tuple>& rows) {
+    const char* const data = pending_.data() + pos_;
+    const size_t available = pending_.size() - pos_;
+    if (!started_) {
+        if (available < BINARY_HEADER_SIZE) {
+            return false;
+        }
+        if (std::string_view(data, BINARY_SIGNATURE.size()) != BINARY_SIGNATURE) {
+            fail("invalid binary COPY signature");
+        }
+        const auto flags = static_cast<uint32_t>(read_be32(data + BINARY_SIGNATURE.size()));
+        if ((flags & BINARY_FLAG_OIDS) != 0) {
+            fail("binary COPY with OIDs is not supported");
+        }
+        const auto extension = static_cast<uint32_t>(read_be32(data + BINARY_HEADER_SIZE - 4));
+        if (available < BINARY_HEADER_SIZE + extension) {
+            return false;
+        }
+        pos_ += BINARY_HEADER_SIZE + extension;
+        started_ = true;
+        return true;
+    }
+
+    if (available < 2) {
+        return false;
+    }
+    const auto count = static_cast<int16_t>(static_cast<uint16_t>(read_be(data, 2)));
+    if (count == -1) {
+        pos_ += 2;
+        ended_ = true;
+        return false;
+    }
+
+    /* Make sure the whole tuple is here before decoding any of it */
+    size_t size = 2;
+    for (int16_t f = 0; f < count; ++f) {
+        if (available < size + 4) {
+            return false;
+        }
+        const int32_t length = read_be32(data + size);
+        size += 4 + static_cast<size_t>(std::max(length, 0));
+        if (available < size) {
+            return false;
+        }
+    }
+
+    ++line_;
+    if (static_cast<size_t>(count) != schema_.column_count()) {
+        fail("row has " + std::to_string(count) + " fields, expected " +
+             std::to_string(schema_.column_count()));
+    }
+    std::vector<common::Value> values;
+    values.reserve(schema_.column_count());
+    size_t offset = 2;
+    for (size_t column = 0; column < schema_.column_count(); ++column) {
+        const int32_t length = read_be32(data + offset);
+        offset += 4;
+        if (length < 0) {
+            values.push_back(common::Value::make_null());
+            continue;
+        }
+        values.push_back(parse_binary(column, data + offset, static_cast<size_t>(length)));
+        offset += static_cast<size_t>(length);
+    }
+    pos_ += size;
+    rows.emplace_back(std::move(values));
+    return true;
+}
+
+void CopyDecoder::add_text_row(std::vector<Tuple>& rows) {
+    if (fields_.size() < schema_.column_count()) {
+        fail("missing data for column \"" + schema_.get_column(fields_.size()).name() + "\"");
+    }
+    if (fields_.size() > schema_.column_count()) {
+        fail("extra data after last expected column");
+    }
+    std::vector<common::Value> values;
+    values.reserve(fields_.size());
+    for (size_t column = 0; column < fields_.size(); ++column) {
+        values.push_back(nulls_[column] ? common::Value::make_null()
+                                        : parse_text(column, fields_[column]));
+    }
+    rows.emplace_back(std::move(values));
+}
+
+common::Value CopyDecoder::parse_text(size_t column, std::string_view text) const {
+    const auto& col = schema_.get_column(column);
+    const auto invalid = [&](const char* kind) {
+        fail(std::string("invalid ") + kind + " for column \"" + col.name() + "\": \"" +
+             std::string(text) + "\"");
+    };
+
+    if (is_integer_type(col.type())) {
+        int64_t val = 0;
+        const char* const end = text.data() + text.size();
+        const auto [ptr, ec] = std::from_chars(text.data() + (!text.empty() && text[0] == '+'),
+                                               end, val);
+        if (ec != std::errc() || ptr != end || text.empty()) {
+            invalid("integer");
+        }
+        return common::Value::make_int64(val);
+    }
+    if (is_float_type(col.type())) {
+        const std::string copy(text);
+        char* end = nullptr;
+        const double val = std::strtod(copy.c_str(), &end);
+        if (copy.empty() || end != copy.c_str() + copy.size()) {
+            invalid("number");
+        }
+        return common::Value::make_float64(val);
+    }
+    if (col.type() == common::ValueType::TYPE_BOOL) {
+        std::string lower(text);
+        std::transform(lower.begin(), lower.end(), lower.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (lower == "t" || lower == "true" || lower == "1" || lower == "on" || lower == "yes" ||
+            lower == "y") {
+            return common::Value::make_bool(true);
+        }
+        if (lower == "f" || lower == "false" || lower == "0" || lower == "off" || lower == "no" ||
+            lower == "n") {
+            return common::Value::make_bool(false);
+        }
+        invalid("boolean");
+    }
+    return common::Value::make_text(text);
+}
+
+common::Value CopyDecoder::parse_binary(size_t column, const char* data, size_t size) const {
+    const auto& col = schema_.get_column(column);
+    const auto check = [&](bool valid) {
+        if (!valid) {
+            fail("invalid binary field length " + std::to_string(size) + " for column \"" +
+                 col.name() + "\"");
+        }
+    };
+
+    if (is_integer_type(col.type())) {
+        check(size == 2 || size == 4 || size == 8);
+        /* Sign-extend the big-endian value from its width */
+        const uint64_t raw = read_be(data, size);
+        const unsigned shift = 64U - static_cast<unsigned>(size) * 8U;
+        return common::Value::make_int64(static_cast<int64_t>(raw << shift) >> shift);
+    }
+    if (is_float_type(col.type())) {
+        check(size == 4 || size == 8);
+        if (size == 4) {
+            const auto bits = static_cast<uint32_t>(read_be(data, 4));
+            float val = 0;
+            std::memcpy(&val, &bits, sizeof(val));
+            return common::Value::make_float64(val);
+        }
+        const uint64_t bits = read_be(data, 8);
+        double val = 0;
+        std::memcpy(&val, &bits, sizeof(val));
+        return common::Value::make_float64(val);
+    }
+    if (col.type() == common::ValueType::TYPE_BOOL) {
+        check(size == 1);
+        return common::Value::make_bool(data[0] != 0);
+    }
+    return common::Value::make_text(std::string_view(data, size));
+}
+
+void CopyDecoder::fail(const std::string& message) const {
+    throw std::runtime_error("COPY row " + std::to_string(line_) + ": " + message);
+}
+
+}  // namespace cloudsql::executor
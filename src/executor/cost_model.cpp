@@ -0,0 +1,206 @@
+/**
+ * @file cost_model.cpp
+ * @brief Selectivity estimates from column statistics and plan costs
+ */
+
+#include "executor/cost_model.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace cloudsql::executor::cost {
+
+namespace {
+
+constexpr double INFINITE_COST = std::numeric_limits<double>::infinity();
+
+bool within(const common::Value& value, const std::optional<storage::BTreeIndex::Bound>& lower,
+            const std::optional<storage::BTreeIndex::Bound>& upper) {
+    if (lower && (value < lower->key || (!lower->inclusive && !(lower->key < value)))) {
+        return false;
+    }
+    return !upper || !(upper->key < value || (!upper->inclusive && !(value < upper->key)));
+}
+
+/* Fraction of histogram rows below `value`, interpolating inside numeric buckets */
+double histogram_position(const std::vector<common::Value>& bounds, const common::Value& value) {
+    if (value < bounds.front()) return 0.0;
+    if (!(value < bounds.back())) return 1.0;
+    /* First bound above `value`; the bucket is [bounds[i - 1], bounds[i]) */
+    const auto above = std::upper_bound(bounds.begin(), bounds.end(), value);
+    const auto i = static_cast<size_t>(above - bounds.begin());
+    double inside = 0.5;
+    const common::Value& low = bounds[i - 1];
+    const common::Value& high = bounds[i];
+    if (value.is_numeric() && low.is_numeric() && high.is_numeric() &&
+        high.to_float64() > low.to_float64()) {
+        inside = (value.to_float64() - low.to_float64()) / (high.to_float64() - low.to_float64());
+    }
+    return (static_cast<double>(i - 1) + inside) / static_cast<double>(bounds.size() - 1);
+}
+
+double common_fraction(const ColumnStats& stats) {
+    double total = 0.0;
+    for (const double freq : stats.most_common_freqs) total += freq;
+    return total;
+}
+
+/* Rows of a set of relations: the product of their rows and of the selectivity of the
+ * edges between them, the same in whatever order they are joined */
+double joined_rows(const std::vector<double>& rows, const std::vector<JoinEdge>& edges,
+                   uint32_t members) {
+    double result = 1.0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if ((members & (1U << i)) != 0) result *= std::max(rows[i], 1.0);
+    }
+    for (const auto& edge : edges) {
+        if ((members & (1U << edge.left)) != 0 && (members & (1U << edge.right)) != 0) {
+            result *= edge.selectivity;
+        }
+    }
+    return std::max(result, 1.0);
+}
+
+bool connects(const std::vector<JoinEdge>& edges, uint32_t members, size_t relation) {
+    return std::any_of(edges.begin(), edges.end(), [&](const JoinEdge& edge) {
+        return (edge.left == relation && (members & (1U << edge.right)) != 0) ||
+               (edge.right == relation && (members & (1U << edge.left)) != 0);
+    });
+}
+
+double join_step_cost(double left_rows, double right_rows, double output_rows) {
+    return hash_join_cost(std::min(left_rows, right_rows), std::max(left_rows, right_rows),
+                          output_rows);
+}
+
+}  // namespace
+
+double equality_selectivity(const ColumnStats& stats, const common::Value& value) {
+    if (value.is_null()) return 0.0;
+    for (size_t i = 0; i < stats.most_common_values.size(); ++i) {
+        if (stats.most_common_values[i] == value) return stats.most_common_freqs[i];
+    }
+    /* The remaining rows spread evenly over the remaining values */
+    const double rest = std::max(0.0, 1.0 - stats.null_fraction - common_fraction(stats));
+    const double others =
+        stats.distinct_count - static_cast<double>(stats.most_common_values.size());
+    return others >= 1.0 ? rest / others : 0.0;
+}
+
+double range_selectivity(const ColumnStats& stats,
+                         const std::optional<storage::BTreeIndex::Bound>& lower,
+                         const std::optional<storage::BTreeIndex::Bound>& upper) {
+    double result = 0.0;
+    for (size_t i = 0; i < stats.most_common_values.size(); ++i) {
+        if (within(stats.most_common_values[i], lower, upper)) {
+            result += stats.most_common_freqs[i];
+        }
+    }
+
+    const double rest = std::max(0.0, 1.0 - stats.null_fraction - common_fraction(stats));
+    if (stats.histogram_bounds.size() >= 2) {
+        const double from = lower ? histogram_position(stats.histogram_bounds, lower->key) : 0.0;
+        const double to = upper ? histogram_position(stats.histogram_bounds, upper->key) : 1.0;
+        result += std::max(0.0, to - from) * rest;
+    } else {
+        result += rest * DEFAULT_RANGE_SELECTIVITY;
+    }
+
+    if (!upper) result += stats.null_fraction;
+    return std::clamp(result, 0.0, 1.0);
+}
+
+double join_selectivity(const ColumnStats& left, const ColumnStats& right) {
+    const double distinct = std::max({left.distinct_count, right.distinct_count, 1.0});
+    return (1.0 - left.null_fraction) * (1.0 - right.null_fraction) / distinct;
+}
+
+double seq_scan_cost(const TableStats& stats) {
+    return static_cast<double>(stats.page_count) * SEQ_PAGE_COST +
+           static_cast<double>(stats.row_count) * CPU_TUPLE_COST;
+}
+
+double index_scan_cost(const TableStats& stats, double selectivity) {
+    const double rows = selectivity * static_cast<double>(stats.row_count);
+    /* Expected distinct pages touched by `rows` fetches spread over the table */
+    const auto pages = static_cast<double>(std::max<uint64_t>(stats.page_count, 1));
+    const double fetched = pages * (1.0 - std::exp(-rows / pages));
+    return RANDOM_PAGE_COST + fetched * RANDOM_PAGE_COST +
+           rows * (CPU_INDEX_TUPLE_COST + CPU_TUPLE_COST);
+}
+
+double hash_index_scan_cost(const TableStats& stats, double selectivity) {
+    return index_scan_cost(stats, selectivity) - RANDOM_PAGE_COST + HASH_INDEX_PROBE_COST;
+}
+
+double bitmap_heap_scan_cost(const TableStats& stats, double heap_pages, double runs) {
+    const auto pages = static_cast<double>(std::max<uint64_t>(stats.page_count, 1));
+    const double rows = static_cast<double>(stats.row_count) * std::min(1.0, heap_pages / pages);
+    /* One page of summaries, then a seek per run */
+    return SEQ_PAGE_COST + runs * (RANDOM_PAGE_COST - SEQ_PAGE_COST) +
+           heap_pages * SEQ_PAGE_COST + rows * CPU_TUPLE_COST;
+}
+
+double hash_join_cost(double build_rows, double probe_rows, double output_rows) {
+    return build_rows * HASH_BUILD_COST + probe_rows * HASH_PROBE_COST +
+           output_rows * CPU_TUPLE_COST;
+}
+
+double join_order_cost(const std::vector<double>& rows, const std::vector<JoinEdge>& edges,
+                       const std::vector<size_t>& order) {
+    if (order.empty() || rows.size() > MAX_REORDERED_JOINS) return INFINITE_COST;
+    uint32_t members = 1U << order[0];
+    double total = 0.0;
+    for (size_t i = 1; i < order.size(); ++i) {
+        if (!connects(edges, members, order[i])) return INFINITE_COST;
+        const uint32_t next = members | (1U << order[i]);
+        total += join_step_cost(joined_rows(rows, edges, members), std::max(rows[order[i]], 1.0),
+                                joined_rows(rows, edges, next));
+        members = next;
+    }
+    return total;
+}
+
+std::vector<size_t> order_joins(const std::vector<double>& rows,
+                                const std::vector<JoinEdge>& edges) {
+    const size_t n = rows.size();
+    if (n == 0 || n > MAX_REORDERED_JOINS) return {};
+
+    /* best[set]: cheapest left-deep plan of the relations in `set`, all containing relation 0 */
+    const uint32_t full = (1U << n) - 1;
+    std::vector<double> best(full + 1, INFINITE_COST);
+    std::vector<size_t> last(full + 1, 0);
+    best[1] = 0.0;
+    for (uint32_t set = 1; set <= full; set += 2) {
+        if (best[set] == INFINITE_COST) continue;
+        const double set_rows = joined_rows(rows, edges, set);
+        for (size_t r = 1; r < n; ++r) {
+            if ((set & (1U << r)) != 0 || !connects(edges, set, r)) continue;
+            const uint32_t next = set | (1U << r);
+            const double cost =
+                best[set] + join_step_cost(set_rows, std::max(rows[r], 1.0),
+                                           joined_rows(rows, edges, next));
+            if (cost < best[next]) {
+                best[next] = cost;
+                last[next] = r;
+            }
+        }
+    }
+    if (best[full] == INFINITE_COST) return {};
+
+    std::vector<size_t> order(n);
+    uint32_t set = full;
+    for (size_t i = n; i-- > 1;) {
+        order[i] = last[set];
+        set &= ~(1U << last[set]);
+    }
+    order[0] = 0;
+    return order;
+}
+
+}  // namespace cloudsql::executor::cost
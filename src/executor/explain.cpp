@@ -0,0 +1,106 @@
+/**
+ * @file explain.cpp
+ * @brief EXPLAIN plan rendering
+ */
+
+#include "executor/explain.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "executor/types.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+thread_local bool instrumenting = false;
+
+constexpr double NS_PER_MS = 1e6;
+
+std::string format_stats(const OperatorStats& stats) {
+    if (stats.loops == 0 && stats.batches == 0 && stats.rows == 0 && stats.time_ns == 0) {
+        return " (never executed)";
+    }
+    std::string out = " (actual time=" +
+                      format_ms(std::chrono::nanoseconds(stats.time_ns)) +
+                      " ms rows=" + std::to_string(stats.rows);
+    if (stats.batches > 0) {
+        out += " batches=" + std::to_string(stats.batches);
+    } else {
+        out += " loops=" + std::to_string(stats.loops);
+    }
+    out += ")";
+    return out;
+}
+
+void render(const ExplainNode& node, size_t depth, std::vector<std::string>& lines) {
+    /* The root starts at column 0; each level below it adds "->" six columns in */
+    const std::string indent = depth == 0 ? "" : std::string((depth - 1) * 6 + 2, ' ') + "->  ";
+    const std::string detail_indent(depth == 0 ? 2 : (depth - 1) * 6 + 8, ' ');
+
+    lines.push_back(indent + node.label + (node.stats != nullptr ? format_stats(*node.stats) : ""));
+    for (const auto& detail : node.details) {
+        lines.push_back(detail_indent + detail);
+    }
+    if (node.stats != nullptr &&
+        (node.stats->buffer_hits | node.stats->buffer_misses | node.stats->pages_read) != 0) {
+        lines.push_back(detail_indent + "Buffers: hit=" + std::to_string(node.stats->buffer_hits) +
+                        " miss=" + std::to_string(node.stats->buffer_misses) +
+                        " read=" + std::to_string(node.stats->pages_read));
+    }
+    for (const auto& child : node.children) {
+        render(child, depth + 1, lines);
+    }
+}
+
+}  // namespace
+
+InstrumentScope::InstrumentScope() : previous_(instrumenting) {
+    instrumenting = true;
+}
+
+InstrumentScope::~InstrumentScope() {
+    instrumenting = previous_;
+}
+
+bool InstrumentScope::active() {
+    return instrumenting;
+}
+
+std::vector<std::string> render_explain(const ExplainNode& root) {
+    std::vector<std::string> lines;
+    render(root, 0, lines);
+    return lines;
+}
+
+std::string format_ms(std::chrono::nanoseconds elapsed) {
+    std::array<char, 32> buf{};
+    const int n = std::snprintf(buf.data(), buf.size(), "%.3f",
+                                static_cast<double>(elapsed.count()) / NS_PER_MS);
+    return std::string(buf.data(), static_cast<size_t>(n));
+}
+
+const char* join_type_name(JoinType type) {
+    switch (type) {
+        case JoinType::Inner:
+            return "Inner";
+        case JoinType::Left:
+            return "Left";
+        case JoinType::Right:
+            return "Right";
+        case JoinType::Full:
+            return "Full";
+        case JoinType::Semi:
+            return "Semi";
+        case JoinType::Anti:
+            return "Anti";
+    }
+    return "Inner";
+}
+
+}  // namespace cloudsql::executor
@@ -0,0 +1,151 @@
+/**
+ * @file group_key_table.cpp
+ * @brief Key encoding and linear probing of GroupKeyTable
+ */
+
+#include "executor/group_key_table.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "executor/vector_hash.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+constexpr size_t INITIAL_SLOTS = 16;
+
+/* Smallest and one past the largest double that converts to int64_t */
+constexpr double INT64_LOWER = -9223372036854775808.0;
+constexpr double INT64_UPPER = 9223372036854775808.0;
+
+enum KeyTag : char {
+    KEY_NULL = 'N',
+    KEY_BOOL = 'B',
+    KEY_INT = 'I',
+    KEY_FLOAT = 'F',
+    KEY_STRING = 'S',
+    KEY_OTHER = 'O'
+};
+
+template <typename T>
+void append_raw(const T& value, std::string& out) {
+    const size_t offset = out.size();
+    out.resize(offset + sizeof(T));
+    std::memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+void append_bytes(std::string_view bytes, std::string& out) {
+    append_raw(static_cast<uint32_t>(bytes.size()), out);
+    out += bytes;
+}
+
+}  // namespace
+
+void GroupKeyTable::append_key(const common::Value& value, std::string& out) {
+    switch (value.type()) {
+        case common::ValueType::TYPE_NULL:
+            out.push_back(KEY_NULL);
+            break;
+        case common::ValueType::TYPE_BOOL:
+            out.push_back(KEY_BOOL);
+            out.push_back(value.as_bool() ? 1 : 0);
+            break;
+        case common::ValueType::TYPE_INT8:
+        case common::ValueType::TYPE_INT16:
+        case common::ValueType::TYPE_INT32:
+        case common::ValueType::TYPE_INT64:
+            out.push_back(KEY_INT);
+            append_raw(value.to_int64(), out);
+            break;
+        case common::ValueType::TYPE_FLOAT32:
+        case common::ValueType::TYPE_FLOAT64: {
+            const double number = value.to_float64();
+            if (std::trunc(number) == number && number >= INT64_LOWER && number < INT64_UPPER) {
+                out.push_back(KEY_INT);
+                append_raw(static_cast<int64_t>(number), out);
+            } else {
+                out.push_back(KEY_FLOAT);
+                append_raw(hashing::double_bits(number), out);
+            }
+            break;
+        }
+        case common::ValueType::TYPE_CHAR:
+        case common::ValueType::TYPE_VARCHAR:
+        case common::ValueType::TYPE_TEXT:
+            out.push_back(KEY_STRING);
+            append_bytes(value.text_view(), out);
+            break;
+        default:
+            out.push_back(KEY_OTHER);
+            out.push_back(static_cast<char>(value.type()));
+            append_bytes(value.to_string(), out);
+            break;
+    }
+}
+
+uint64_t GroupKeyTable::hash_key(std::string_view key) {
+    return hashing::mix(std::hash<std::string_view>{}(key));
+}
+
+size_t GroupKeyTable::probe(std::string_view key, uint64_t hash) const {
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const uint32_t entry = slots_[slot];
+        if (entry == 0) return slot;
+        if (hashes_[entry - 1] == hash && this->key(entry - 1) == key) return slot;
+    }
+}
+
+std::pair<uint32_t, bool> GroupKeyTable::insert(std::string_view key, uint64_t hash) {
+    if ((hashes_.size() + 1) * 2 > slots_.size()) grow();
+    const size_t slot = probe(key, hash);
+    if (slots_[slot] != 0) return {slots_[slot] - 1, false};
+
+    const auto id = static_cast<uint32_t>(hashes_.size());
+    hashes_.push_back(hash);
+    arena_.append(key.data(), key.size());
+    offsets_.push_back(arena_.size());
+    slots_[slot] = id + 1;
+    return {id, true};
+}
+
+uint32_t GroupKeyTable::find(std::string_view key, uint64_t hash) const {
+    if (slots_.empty()) return NOT_FOUND;
+    const uint32_t entry = slots_[probe(key, hash)];
+    return entry == 0 ? NOT_FOUND : entry - 1;
+}
+
+size_t GroupKeyTable::memory_bytes() const {
+    return slots_.capacity() * sizeof(uint32_t) + hashes_.capacity() * sizeof(uint64_t) +
+           offsets_.capacity() * sizeof(size_t) + arena_.capacity();
+}
+
+void GroupKeyTable::grow() {
+    std::vector<uint32_t> slots(std::max(INITIAL_SLOTS, slots_.size() * 2), 0);
+    const size_t mask = slots.size() - 1;
+    for (size_t id = 0; id < hashes_.size(); ++id) {
+        size_t slot = hashes_[id] & mask;
+        while (slots[slot] != 0) slot = (slot + 1) & mask;
+        slots[slot] = static_cast<uint32_t>(id + 1);
+    }
+    slots_ = std::move(slots);
+}
+
+void GroupKeyTable::clear() {
+    std::vector<uint32_t>().swap(slots_);
+    std::vector<uint64_t>().swap(hashes_);
+    offsets_.assign(1, 0);
+    std::string().swap(arena_);
+}
+
+}  // namespace cloudsql::executor
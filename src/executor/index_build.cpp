@@ -0,0 +1,224 @@
+/**
+ * @file index_build.cpp
+ * @brief Parallel index backfill and CREATE INDEX CONCURRENTLY side log implementation
+ */
+
+#include "executor/index_build.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "executor/morsel_scheduler.hpp"
+#include "executor/thread_pool.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+using Entry = storage::Index::Entry;
+
+/* NULL first, then by key, then by tuple id: the order BTreeIndex keeps within a key class */
+bool entry_less(const Entry& a, const Entry& b) {
+    if (a.key.is_null() != b.key.is_null()) {
+        return a.key.is_null();
+    }
+    if (!a.key.is_null()) {
+        if (a.key < b.key) return true;
+        if (b.key < a.key) return false;
+    }
+    if (a.tuple_id.page_num != b.tuple_id.page_num) {
+        return a.tuple_id.page_num < b.tuple_id.page_num;
+    }
+    return a.tuple_id.slot_num < b.tuple_id.slot_num;
+}
+
+/** @brief Appends the entries of the live rows in `ranges` of the heap to `out` */
+void scan_entries(storage::BufferPoolManager& bpm, const std::string& table_name,
+                  const Schema& schema, uint16_t column,
+                  std::vector<storage::HeapTable::PageRange> ranges, std::vector<Entry>& out) {
+    storage::HeapTable table(table_name, bpm, schema);
+    auto iter = table.scan_ranges(std::move(ranges));
+    storage::HeapTable::TupleMeta meta;
+    while (iter.next_meta(meta)) {
+        if (meta.xmax == 0) {
+            out.emplace_back(meta.tuple.get(column), iter.current_id());
+        }
+    }
+}
+
+/** @brief Merges runs each sorted by entry_less into one sorted vector */
+std::vector<Entry> merge_runs(std::vector<std::vector<Entry>>& runs) {
+    size_t total = 0;
+    for (const auto& run : runs) {
+        total += run.size();
+    }
+    std::vector<Entry> merged;
+    merged.reserve(total);
+
+    /* Heap of (run, position), smallest head entry on top */
+    using Cursor = std::pair<size_t, size_t>;
+    const auto later = [&runs](const Cursor& a, const Cursor& b) {
+        return entry_less(runs[b.first][b.second], runs[a.first][a.second]);
+    };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heads(later);
+    for (size_t i = 0; i < runs.size(); ++i) {
+        if (!runs[i].empty()) heads.emplace(i, 0);
+    }
+    while (!heads.empty()) {
+        const Cursor head = heads.top();
+        heads.pop();
+        merged.push_back(std::move(runs[head.first][head.second]));
+        if (head.second + 1 < runs[head.first].size()) {
+            heads.emplace(head.first, head.second + 1);
+        }
+    }
+    return merged;
+}
+
+/** @brief Builds registered by CREATE INDEX CONCURRENTLY, across every executor */
+struct Registry {
+    std::mutex mutex;
+    std::vector<ConcurrentIndexBuild*> builds;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+}  // namespace
+
+std::vector<storage::Index::Entry> collect_index_entries(storage::BufferPoolManager& bpm,
+                                                         const std::string& table_name,
+                                                         const Schema& schema, uint16_t column,
+                                                         const IndexBuildOptions& options,
+                                                         WorkStealingPool* pool) {
+    using PageRange = storage::HeapTable::PageRange;
+    const uint32_t pages = storage::HeapTable(table_name, bpm, schema).page_count();
+    const uint32_t per_task = std::max<uint32_t>(options.pages_per_task, 1);
+    const size_t wanted =
+        options.parallelism != 0 ? options.parallelism : MorselScheduler::default_parallelism();
+    WorkStealingPool& threads = pool != nullptr ? *pool : WorkStealingPool::shared();
+
+    if (pages < options.min_parallel_pages || wanted <= 1 ||
+        threads.thread_count() <= 1) {
+        std::vector<Entry> entries;
+        scan_entries(bpm, table_name, schema, column, {PageRange{0, PageRange::TO_END}},
+                     entries);
+        if (options.sorted) {
+            std::sort(entries.begin(), entries.end(), entry_less);
+        }
+        return entries;
+    }
+
+    /* One run per task; the last also reads pages added since the count was taken */
+    const size_t task_count = (static_cast<size_t>(pages) + per_task - 1) / per_task;
+    std::vector<std::vector<Entry>> runs(task_count);
+    const size_t workers = std::min({wanted, threads.thread_count(), task_count});
+    threads.parallel_for(task_count, workers, [&](size_t /*worker*/, size_t task) {
+        const auto first = static_cast<uint32_t>(task * per_task);
+        const uint32_t end = task + 1 == task_count ? PageRange::TO_END : first + per_task;
+        scan_entries(bpm, table_name, schema, column, {PageRange{first, end}}, runs[task]);
+        if (options.sorted) {
+            std::sort(runs[task].begin(), runs[task].end(), entry_less);
+        }
+    });
+
+    if (options.sorted) {
+        return merge_runs(runs);
+    }
+    std::vector<Entry> entries;
+    for (auto& run : runs) {
+        std::move(run.begin(), run.end(), std::back_inserter(entries));
+    }
+    return entries;
+}
+
+std::atomic<size_t> ConcurrentIndexBuild::active_{0};
+
+ConcurrentIndexBuild::ConcurrentIndexBuild(const storage::BufferPoolManager& bpm,
+                                           std::string table_name, uint16_t column,
+                                           storage::Index& index)
+    : bpm_(&bpm), table_name_(std::move(table_name)), column_(column), index_(index) {
+    Registry& reg = registry();
+    const std::scoped_lock<std::mutex> lock(reg.mutex);
+    reg.builds.push_back(this);
+    active_.fetch_add(1);
+}
+
+ConcurrentIndexBuild::~ConcurrentIndexBuild() {
+    Registry& reg = registry();
+    const std::scoped_lock<std::mutex> lock(reg.mutex);
+    reg.builds.erase(std::remove(reg.builds.begin(), reg.builds.end(), this), reg.builds.end());
+    active_.fetch_sub(1);
+}
+
+bool ConcurrentIndexBuild::catch_up() {
+    std::vector<Change> changes;
+    {
+        const std::scoped_lock<std::mutex> lock(registry().mutex);
+        changes.swap(log_);
+    }
+    return apply(changes);
+}
+
+bool ConcurrentIndexBuild::publish(const std::function<bool()>& publish) {
+    const std::scoped_lock<std::mutex> lock(registry().mutex);
+    if (!apply(log_)) {
+        return false;
+    }
+    log_.clear();
+    if (!publish()) {
+        return false;
+    }
+    published_ = true;
+    return true;
+}
+
+uint64_t ConcurrentIndexBuild::logged() const {
+    const std::scoped_lock<std::mutex> lock(registry().mutex);
+    return logged_;
+}
+
+bool ConcurrentIndexBuild::apply(const std::vector<Change>& changes) {
+    for (const auto& change : changes) {
+        const bool ok = change.insert ? index_.insert(change.key, change.tid)
+                                      : index_.remove(change.key, change.tid);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ConcurrentIndexBuild::record(const storage::BufferPoolManager& bpm, const std::string& table,
+                                  const storage::HeapTable::TupleId& tid, const Tuple& row,
+                                  bool insert) {
+    Registry& reg = registry();
+    const std::scoped_lock<std::mutex> lock(reg.mutex);
+    for (auto* build : reg.builds) {
+        if (build->bpm_ != &bpm || build->table_name_ != table || build->column_ >= row.size()) {
+            continue;
+        }
+        build->logged_++;
+        Change change{insert, tid, row.get(build->column_)};
+        if (!build->published_) {
+            build->log_.push_back(std::move(change));
+        } else if (!build->apply({change})) {
+            std::cerr << "--- [IndexBuild] Failed to apply a change to "
+                      << build->index_.index_name() << " ---" << std::endl;
+        }
+    }
+}
+
+}  // namespace cloudsql::executor
@@ -0,0 +1,252 @@
+/**
+ * @file join_hash_table.cpp
+ * @brief Chained hash table over the columnar build side of a join
+ */
+
+#include "executor/join_hash_table.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "executor/vector_hash.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+constexpr size_t INITIAL_BUCKETS = 1024;
+
+}  // namespace
+
+JoinHashTable::KeyKind JoinHashTable::kind_of(common::ValueType type) {
+    switch (type) {
+        case common::ValueType::TYPE_INT8:
+        case common::ValueType::TYPE_INT16:
+        case common::ValueType::TYPE_INT32:
+        case common::ValueType::TYPE_INT64:
+            return KeyKind::Int;
+        case common::ValueType::TYPE_BOOL:
+            return KeyKind::Bool;
+        case common::ValueType::TYPE_FLOAT32:
+        case common::ValueType::TYPE_FLOAT64:
+            return KeyKind::Float;
+        case common::ValueType::TYPE_CHAR:
+        case common::ValueType::TYPE_VARCHAR:
+        case common::ValueType::TYPE_TEXT:
+            return KeyKind::String;
+        default:
+            throw std::runtime_error("Join: Unsupported key type " +
+                                     std::to_string(static_cast<int>(type)));
+    }
+}
+
+JoinHashTable::JoinHashTable(const Schema& build_schema, std::vector<size_t> build_keys,
+                             const Schema& probe_schema, std::vector<size_t> probe_keys)
+    : build_keys_(std::move(build_keys)),
+      probe_keys_(std::move(probe_keys)),
+      rows_(VectorBatch::create(build_schema)) {
+    if (build_keys_.empty() || build_keys_.size() != probe_keys_.size()) {
+        throw std::runtime_error("Join: build and probe sides need the same number of keys");
+    }
+    for (size_t k = 0; k < build_keys_.size(); ++k) {
+        if (build_keys_[k] >= build_schema.column_count() ||
+            probe_keys_[k] >= probe_schema.column_count()) {
+            throw std::runtime_error("Join: key column out of range");
+        }
+        const KeyKind build_kind = kind_of(build_schema.get_column(build_keys_[k]).type());
+        const KeyKind probe_kind = kind_of(probe_schema.get_column(probe_keys_[k]).type());
+        if (build_kind != probe_kind) {
+            throw std::runtime_error("Join: key " + std::to_string(k) +
+                                     " compares different types");
+        }
+        kinds_.push_back(build_kind);
+    }
+    heads_.assign(INITIAL_BUCKETS, 0);
+    for (size_t c = 0; c < rows_->column_count(); ++c) {
+        const bool text = dynamic_cast<const StringVector*>(&rows_->get_column(c)) != nullptr;
+        row_width_ += sizeof(uint8_t) + (text ? sizeof(std::string) : sizeof(int64_t));
+    }
+}
+
+size_t JoinHashTable::memory_bytes() const {
+    return row_count() * row_width_ + text_bytes_ + hashes_.capacity() * sizeof(uint64_t) +
+           next_.capacity() * sizeof(uint32_t) + heads_.capacity() * sizeof(uint32_t);
+}
+
+void JoinHashTable::bind_views(const VectorBatch& batch, const std::vector<size_t>& columns,
+                               std::vector<KeyView>& views) const {
+    views.assign(columns.size(), KeyView{});
+    for (size_t k = 0; k < columns.size(); ++k) {
+        const ColumnVector& col = batch.get_column(columns[k]);
+        KeyView& view = views[k];
+        view.nulls = col.null_data();
+        switch (kinds_[k]) {
+            case KeyKind::Int:
+                view.ints = dynamic_cast<const NumericVector<int64_t>&>(col).raw_data();
+                break;
+            case KeyKind::Bool:
+                view.bools = dynamic_cast<const NumericVector<bool>&>(col).raw_data();
+                break;
+            case KeyKind::Float:
+                view.floats = dynamic_cast<const NumericVector<double>&>(col).raw_data();
+                break;
+            case KeyKind::String:
+                view.strings = dynamic_cast<const StringVector&>(col).raw_data();
+                break;
+        }
+    }
+}
+
+void JoinHashTable::hash_rows(const std::vector<KeyView>& views, size_t rows,
+                              uint64_t* hashes) const {
+    for (size_t r = 0; r < rows; ++r) hashes[r] = 0;
+    for (size_t k = 0; k < views.size(); ++k) {
+        const KeyView& view = views[k];
+        switch (kinds_[k]) {
+            case KeyKind::Int:
+                for (size_t r = 0; r < rows; ++r) {
+                    hashes[r] = hashing::combine(hashes[r], static_cast<uint64_t>(view.ints[r]));
+                }
+                break;
+            case KeyKind::Bool:
+                for (size_t r = 0; r < rows; ++r) {
+                    hashes[r] = hashing::combine(hashes[r], view.bools[r]);
+                }
+                break;
+            case KeyKind::Float:
+                for (size_t r = 0; r < rows; ++r) {
+                    hashes[r] = hashing::combine(hashes[r], hashing::double_bits(view.floats[r]));
+                }
+                break;
+            case KeyKind::String:
+                // NULL rows can hold any string, so they get a fixed hash instead
+                for (size_t r = 0; r < rows; ++r) {
+                    const uint64_t value = view.nulls[r] != 0
+                                               ? hashing::NULL_HASH
+                                               : hashing::string_hash(view.strings[r]);
+                    hashes[r] = hashing::combine(hashes[r], value);
+                }
+                break;
+        }
+    }
+}
+
+void JoinHashTable::rebuild_buckets(size_t bucket_count) {
+    heads_.assign(bucket_count, 0);
+    const size_t mask = bucket_count - 1;
+    for (size_t row = 0; row < hashes_.size(); ++row) {
+        uint32_t& head = heads_[hashes_[row] & mask];
+        next_[row] = head;
+        head = static_cast<uint32_t>(row + 1);
+    }
+}
+
+void JoinHashTable::add_batch(const VectorBatch& batch) {
+    const size_t rows = batch.row_count();
+    if (rows == 0) return;
+
+    std::vector<KeyView> views;
+    bind_views(batch, build_keys_, views);
+    probe_hashes_.resize(rows);
+    hash_rows(views, rows, probe_hashes_.data());
+
+    // Rows with a NULL key never match anything, so they are not stored
+    scratch_rows_.clear();
+    batch.for_each_selected([&](size_t r) {
+        for (const KeyView& view : views) {
+            if (view.nulls[r] != 0) return;
+        }
+        scratch_rows_.push_back(static_cast<uint32_t>(r));
+    });
+    if (scratch_rows_.empty()) return;
+
+    const size_t base = rows_->row_count();
+    for (size_t c = 0; c < batch.column_count(); ++c) {
+        if (!rows_->get_column(c).gather_from(batch.get_column(c), scratch_rows_.data(),
+                                              scratch_rows_.size())) {
+            throw std::runtime_error("Join: build batch does not match the build schema");
+        }
+    }
+    rows_->set_row_count(base + scratch_rows_.size());
+    const size_t inline_capacity = std::string().capacity();
+    for (size_t c = 0; c < rows_->column_count(); ++c) {
+        const auto* strings = dynamic_cast<const StringVector*>(&rows_->get_column(c));
+        if (strings == nullptr) continue;
+        for (size_t row = base; row < rows_->row_count(); ++row) {
+            const size_t capacity = strings->raw_data()[row].capacity();
+            if (capacity > inline_capacity) text_bytes_ += capacity;
+        }
+    }
+
+    for (const uint32_t r : scratch_rows_) hashes_.push_back(probe_hashes_[r]);
+    next_.resize(hashes_.size());
+    if (hashes_.size() > heads_.size()) {
+        size_t buckets = heads_.size();
+        while (buckets < hashes_.size()) buckets *= 2;
+        rebuild_buckets(buckets);
+        return;
+    }
+    const size_t mask = heads_.size() - 1;
+    for (size_t row = base; row < hashes_.size(); ++row) {
+        uint32_t& head = heads_[hashes_[row] & mask];
+        next_[row] = head;
+        head = static_cast<uint32_t>(row + 1);
+    }
+}
+
+void JoinHashTable::begin_probe(const VectorBatch& batch) {
+    bind_views(*rows_, build_keys_, build_views_);
+    bind_views(batch, probe_keys_, probe_views_);
+    probe_hashes_.resize(batch.row_count());
+    hash_rows(probe_views_, batch.row_count(), probe_hashes_.data());
+}
+
+bool JoinHashTable::keys_equal(uint32_t build_row, size_t probe_row) const {
+    for (size_t k = 0; k < kinds_.size(); ++k) {
+        const KeyView& build = build_views_[k];
+        const KeyView& probe = probe_views_[k];
+        switch (kinds_[k]) {
+            case KeyKind::Int:
+                if (build.ints[build_row] != probe.ints[probe_row]) return false;
+                break;
+            case KeyKind::Bool:
+                if (build.bools[build_row] != probe.bools[probe_row]) return false;
+                break;
+            case KeyKind::Float:
+                // SQL equality: -0.0 = 0.0, NaN matches nothing
+                if (build.floats[build_row] != probe.floats[probe_row]) return false;
+                break;
+            case KeyKind::String:
+                if (build.strings[build_row] != probe.strings[probe_row]) return false;
+                break;
+        }
+    }
+    return true;
+}
+
+uint32_t JoinHashTable::scan_chain(uint32_t entry, size_t row) const {
+    const uint64_t hash = probe_hashes_[row];
+    while (entry != 0) {
+        const uint32_t build_row = entry - 1;
+        if (hashes_[build_row] == hash && keys_equal(build_row, row)) return build_row;
+        entry = next_[build_row];
+    }
+    return NO_MATCH;
+}
+
+uint32_t JoinHashTable::first_match(size_t row) const {
+    for (const KeyView& view : probe_views_) {
+        if (view.nulls[row] != 0) return NO_MATCH;
+    }
+    return scan_chain(heads_[probe_hashes_[row] & (heads_.size() - 1)], row);
+}
+
+uint32_t JoinHashTable::next_match(uint32_t build_row, size_t row) const {
+    return scan_chain(next_[build_row], row);
+}
+
+}  // namespace cloudsql::executor
@@ -0,0 +1,158 @@
+/**
+ * @file morsel_scheduler.cpp
+ * @brief Morsel-driven parallel execution of vectorized pipelines
+ */
+
+#include "executor/morsel_scheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cloudsql::executor {
+
+std::atomic<size_t> MorselScheduler::default_parallelism_{0};
+
+MorselScheduler::MorselScheduler(std::string table_name,
+                                 std::shared_ptr<storage::ColumnarTable> table,
+                                 MorselOptions options, WorkStealingPool* pool)
+    : table_name_(std::move(table_name)),
+      table_(std::move(table)),
+      options_(options),
+      pool_(pool != nullptr ? pool : &WorkStealingPool::shared()),
+      memory_(common::MemoryTracker::current()) {
+    // Whole chunks only, so no chunk is decoded or zone-checked by two workers
+    const uint64_t target = std::max<uint64_t>(options_.morsel_rows, 1);
+    uint64_t begin = 0;
+    for (size_t chunk = 0; chunk < table_->chunk_count(); ++chunk) {
+        const uint64_t end = table_->chunk_end_row(chunk);
+        if (end - begin >= target || chunk + 1 == table_->chunk_count()) {
+            morsels_.push_back({begin, end});
+            begin = end;
+        }
+    }
+    if (begin < table_->row_count()) morsels_.push_back({begin, table_->row_count()});
+}
+
+void MorselScheduler::set_default_parallelism(size_t parallelism) {
+    default_parallelism_.store(parallelism, std::memory_order_relaxed);
+}
+
+size_t MorselScheduler::default_parallelism() {
+    const size_t configured = default_parallelism_.load(std::memory_order_relaxed);
+    if (configured != 0) return configured;
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+size_t MorselScheduler::parallelism() const {
+    const size_t wanted =
+        options_.parallelism != 0 ? options_.parallelism : default_parallelism();
+    return std::max<size_t>(std::min(wanted, pool_->thread_count()), 1);
+}
+
+std::unique_ptr<VectorizedOperator> MorselScheduler::instantiate(const PipelineFactory& pipeline,
+                                                                 const Morsel& morsel) const {
+    const common::MemoryTracker::Scope scope(memory_);
+    auto scan = std::make_unique<VectorizedSeqScanOperator>(table_name_, table_);
+    scan->set_row_range(morsel.begin, morsel.end);
+    std::unique_ptr<VectorizedOperator> root;
+    if (pipeline) {
+        root = pipeline(std::move(scan));
+    } else {
+        root = std::move(scan);
+    }
+    if (!root) throw std::runtime_error("MorselScheduler: pipeline factory returned no operator");
+    return root;
+}
+
+void MorselScheduler::record_error(const std::string& message) {
+    const std::lock_guard<std::mutex> lock(result_mutex_);
+    if (error_.empty()) error_ = message;
+}
+
+bool MorselScheduler::run(const PipelineFactory& pipeline, const BatchSink& sink) {
+    return execute(pipeline, sink, false);
+}
+
+bool MorselScheduler::execute(const PipelineFactory& pipeline, const BatchSink& sink,
+                              bool selected) {
+    error_.clear();
+    stats_ = ScanStats{};
+    std::atomic<bool> failed{false};
+
+    const auto run_morsel = [&](size_t worker, size_t index) {
+        if (failed.load(std::memory_order_relaxed)) return;
+        try {
+            auto root = instantiate(pipeline, morsels_[index]);
+            auto batch = VectorBatch::create(root->output_schema());
+            while (selected ? root->next_selected_batch(*batch) : root->next_batch(*batch)) {
+                sink(worker, *batch);
+                batch->clear();
+            }
+            ScanStats stats;
+            root->collect_scan_stats(stats);
+            const std::lock_guard<std::mutex> lock(result_mutex_);
+            stats_.chunks_scanned += stats.chunks_scanned;
+            stats_.chunks_skipped += stats.chunks_skipped;
+            if (root->state() == ExecState::Error) {
+                if (error_.empty()) error_ = root->error();
+                failed.store(true, std::memory_order_relaxed);
+            }
+        } catch (const std::exception& e) {
+            record_error(e.what());
+            failed.store(true, std::memory_order_relaxed);
+        }
+    };
+    pool_->parallel_for(morsels_.size(), parallelism(), run_morsel);
+    return !failed.load();
+}
+
+std::unique_ptr<AggregateHashTable> MorselScheduler::aggregate(
+    const PipelineFactory& pipeline, const std::vector<size_t>& group_by,
+    const std::vector<VectorizedAggregateInfo>& aggs) {
+    // The pipeline's output schema types the tables; an empty morsel yields it
+    std::unique_ptr<AggregateHashTable> merged;
+    try {
+        const auto probe = instantiate(pipeline, Morsel{0, 0});
+        merged = std::make_unique<AggregateHashTable>(probe->output_schema(), group_by, aggs);
+    } catch (const std::exception& e) {
+        error_ = e.what();
+        return nullptr;
+    }
+
+    // One partial table per worker; each worker only ever touches its own
+    std::vector<std::unique_ptr<AggregateHashTable>> partials(parallelism());
+    std::vector<std::unique_ptr<common::MemoryTracker>> partial_memory(partials.size());
+    const auto add = [&](size_t worker, VectorBatch& batch) {
+        auto& partial = partials[worker];
+        if (!partial) {
+            partial = std::make_unique<AggregateHashTable>(*merged);
+            if (memory_ != nullptr) {
+                partial_memory[worker] =
+                    std::make_unique<common::MemoryTracker>("worker", 0, memory_);
+            }
+        }
+        partial->add_batch(batch);
+        if (partial_memory[worker]) {
+            partial_memory[worker]->resize(partial->memory_bytes(), "Parallel HashAggregate");
+        }
+    };
+    // Selected batches go straight into the tables without being compacted
+    if (!execute(pipeline, add, true)) return nullptr;
+
+    for (const auto& partial : partials) {
+        if (partial) merged->merge(*partial);
+    }
+    return merged;
+}
+
+}  // namespace cloudsql::executor
@@ -6,21 +6,35 @@
 #include "executor/operator.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <exception>
+#include <functional>
 #include <iostream>
-#include <map>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include "common/memory_tracker.hpp"
 #include "common/value.hpp"
+#include "executor/compiled_expression.hpp"
+#include "executor/explain.hpp"
+#include "executor/parallel_scan.hpp"
+#include "executor/runtime_filter.hpp"
+#include "executor/spill_file.hpp"
 #include "executor/types.hpp"
+#include "executor/vector_hash.hpp"
+#include "executor/vectorized_operator.hpp"
 #include "parser/expression.hpp"
+#include "storage/brin_index.hpp"
 #include "storage/btree_index.hpp"
 #include "storage/heap_table.hpp"
 #include "transaction/lock_manager.hpp"
@@ -28,6 +42,74 @@
 
 namespace cloudsql::executor {
 
+namespace {
+
+/* Estimated heap footprint of the values of a tuple held by an operator that spills */
+template <typename Values>
+size_t tuple_bytes(const Values& values) {
+    size_t bytes = values.size() * sizeof(common::Value);
+    for (const auto& value : values) bytes += value.heap_bytes();
+    return bytes;
+}
+
+/* "a, b, c" of the expressions' SQL text */
+std::string expression_list(const std::vector<std::unique_ptr<parser::Expression>>& exprs) {
+    std::string out;
+    for (const auto& expr : exprs) {
+        if (!out.empty()) out += ", ";
+        out += expr->to_string();
+    }
+    return out;
+}
+
+const char* aggregate_name(AggregateType type) {
+    switch (type) {
+        case AggregateType::Count:
+            return "COUNT";
+        case AggregateType::Sum:
+            return "SUM";
+        case AggregateType::Avg:
+            return "AVG";
+        case AggregateType::Min:
+            return "MIN";
+        case AggregateType::Max:
+            return "MAX";
+    }
+    return "COUNT";
+}
+
+/* ">= 1 AND < 5" of a key range; empty if it has no bounds */
+std::string key_range_text(const std::optional<storage::BTreeIndex::Bound>& lower,
+                           const std::optional<storage::BTreeIndex::Bound>& upper) {
+    std::string cond;
+    if (lower) {
+        cond = (lower->inclusive ? ">= " : "> ") + lower->key.to_string();
+    }
+    if (upper) {
+        if (!cond.empty()) cond += " AND ";
+        cond += (upper->inclusive ? "<= " : "< ") + upper->key.to_string();
+    }
+    return cond;
+}
+
+}  // namespace
+
+/* --- Operator --- */
+
+void Operator::explain(ExplainNode& node) const {
+    /* In OperatorType order */
+    static constexpr const char* NAMES[] = {"Seq Scan",      "Index Scan",  "Filter",
+                                            "Project",       "Nested Loop", "Hash Join",
+                                            "Sort",          "Aggregate",   "HashAggregate",
+                                            "Limit",         "Materialize", "Result",
+                                            "Buffer Scan",   "Exchange Scan", "Bitmap Heap Scan"};
+    node.label = NAMES[static_cast<size_t>(type_)];
+    node.stats = stats_.get();
+    for (const auto& child : children()) {
+        child->explain(node.add_child());
+    }
+}
+
 /* --- SeqScanOperator --- */
 
 SeqScanOperator::SeqScanOperator(std::unique_ptr<storage::HeapTable> table, Transaction* txn,
@@ -47,43 +129,47 @@ bool SeqScanOperator::init() {
     return true;
 }
 
-bool SeqScanOperator::open() {
+bool SeqScanOperator::open_impl() {
     set_state(ExecState::Open);
-    iterator_ = std::make_unique<storage::HeapTable::Iterator>(table_->scan());
+    if (parallel_) {
+        iterator_.reset();
+        static_cast<void>(claim_range());
+    } else {
+        iterator_ = std::make_unique<storage::HeapTable::Iterator>(table_->scan());
+    }
+    /* The joins above offer their filters again once they have rebuilt */
+    runtime_filters_.clear();
+    filtered_rows_ = 0;
     return true;
 }
 
-bool SeqScanOperator::next(Tuple& out_tuple) {
-    if (!iterator_ || iterator_->is_done()) {
+bool SeqScanOperator::next_impl(Tuple& out_tuple) {
+    if (!iterator_ || (!parallel_ && iterator_->is_done())) {
         set_state(ExecState::Done);
         return false;
     }
 
-    storage::HeapTable::TupleMeta meta;
-    while (iterator_->next_meta(meta)) {
-        /* MVCC Visibility Check */
-        bool visible = true;
-        const Transaction* const txn = get_txn();
-        if (txn != nullptr) {
-            const auto& snapshot = txn->get_snapshot();
-            const uint64_t my_id = txn->get_id();
-
-            // 1. Check xmin (creation)
-            const bool xmin_visible =
-                (meta.xmin == my_id) || (meta.xmin == 0) || snapshot.is_visible(meta.xmin);
-
-            // 2. Check xmax (deletion)
-            const bool xmax_visible =
-                (meta.xmax == 0) || (meta.xmax != my_id && !snapshot.is_visible(meta.xmax));
-
-            visible = xmin_visible && xmax_visible;
-        } else {
-            /* No transaction context: only show active tuples */
-            visible = (meta.xmax == 0);
+    for (;;) {
+        if (!iterator_->next_meta(meta_)) {
+            /* A parallel worker goes on with the next range nobody has claimed */
+            if (parallel_ && claim_range()) continue;
+            break;
         }
+        /* MVCC Visibility Check; without a transaction only active tuples are shown */
+        const Transaction* const txn = get_txn();
+        const bool visible =
+            txn != nullptr ? txn->can_see(meta_.xmin, meta_.xmax) : meta_.xmax == 0;
 
         if (visible) {
-            out_tuple = std::move(meta.tuple);
+            const auto rejects = [this](const ColumnFilter& f) {
+                return !f.filter->may_contain(meta_.tuple.get(f.column));
+            };
+            if (std::any_of(runtime_filters_.begin(), runtime_filters_.end(), rejects)) {
+                ++filtered_rows_;
+                continue;
+            }
+            /* The caller's previous buffer is recycled for the next record */
+            std::swap(out_tuple, meta_.tuple);
             return true;
         }
     }
@@ -92,6 +178,24 @@ bool SeqScanOperator::next(Tuple& out_tuple) {
     return false;
 }
 
+bool SeqScanOperator::claim_range() {
+    storage::HeapTable::PageRange range{};
+    if (!parallel_->next_range(range)) {
+        return false;
+    }
+    iterator_ = std::make_unique<storage::HeapTable::Iterator>(table_->scan_ranges({range}));
+    return true;
+}
+
+bool SeqScanOperator::push_runtime_filter(std::shared_ptr<const RuntimeFilter> filter,
+                                          size_t column) {
+    if (!filter || column >= schema_.column_count()) {
+        return false;
+    }
+    runtime_filters_.push_back({std::move(filter), column});
+    return true;
+}
+
 void SeqScanOperator::close() {
     iterator_.reset();
     set_state(ExecState::Done);
@@ -101,6 +205,171 @@ Schema& SeqScanOperator::output_schema() {
     return schema_;
 }
 
+void SeqScanOperator::explain(ExplainNode& node) const {
+    node.label = (parallel_ ? "Parallel Seq Scan on " : "Seq Scan on ") + table_name_;
+    node.stats = stats();
+    for (const auto& f : runtime_filters_) {
+        node.details.push_back("Runtime Filter: " + schema_.get_column(f.column).name() + " (" +
+                               std::to_string(f.filter->key_count()) + " keys)");
+    }
+    if (stats() != nullptr && !runtime_filters_.empty()) {
+        node.details.push_back("Rows Removed by Runtime Filter: " +
+                               std::to_string(filtered_rows_));
+    }
+}
+
+// --- GatherOperator ---
+
+GatherOperator::GatherOperator(std::vector<std::unique_ptr<Operator>> workers,
+                               std::shared_ptr<ParallelHeapScan> scan)
+    : Operator(OperatorType::Gather, workers.front()->get_txn(),
+               workers.front()->get_lock_manager()),
+      workers_(std::move(workers)),
+      scan_(std::move(scan)) {}
+
+GatherOperator::~GatherOperator() {
+    stop_workers();
+}
+
+bool GatherOperator::init() {
+    return std::all_of(workers_.begin(), workers_.end(),
+                       [](const std::unique_ptr<Operator>& worker) { return worker->init(); });
+}
+
+bool GatherOperator::open_impl() {
+    stop_workers();
+    if (scan_) {
+        scan_->reset();
+    }
+    queue_.clear();
+    chunk_.clear();
+    chunk_pos_ = 0;
+    worker_error_.clear();
+    worker_exception_ = nullptr;
+    set_state(ExecState::Open);
+    return true;
+}
+
+bool GatherOperator::next_impl(Tuple& out_tuple) {
+    while (chunk_pos_ >= chunk_.size()) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (threads_.empty()) {
+            /* Workers start with the first row asked for, not at open() */
+            stopping_ = false;
+            running_ = workers_.size();
+            for (size_t i = 0; i < workers_.size(); ++i) {
+                threads_.emplace_back(&GatherOperator::run_worker, this, i);
+            }
+        }
+        ready_cv_.wait(lock, [this] { return !queue_.empty() || running_ == 0; });
+        if (queue_.empty()) {
+            if (worker_exception_) {
+                std::exception_ptr exception = std::exchange(worker_exception_, nullptr);
+                lock.unlock();
+                set_state(ExecState::Error);
+                std::rethrow_exception(exception);
+            }
+            if (!worker_error_.empty()) {
+                set_error(worker_error_);
+                return false;
+            }
+            set_state(ExecState::Done);
+            return false;
+        }
+        chunk_ = std::move(queue_.front());
+        queue_.pop_front();
+        chunk_pos_ = 0;
+        space_cv_.notify_one();
+    }
+    out_tuple = std::move(chunk_[chunk_pos_++]);
+    return true;
+}
+
+void GatherOperator::run_worker(size_t worker) {
+    Operator& op = *workers_[worker];
+    std::string error;
+    std::exception_ptr exception;
+    try {
+        std::vector<Tuple> chunk;
+        chunk.reserve(CHUNK_ROWS);
+        const bool opened = op.open();
+        bool more = opened;
+        Tuple row;
+        while (more && op.next(row)) {
+            chunk.push_back(std::move(row));
+            if (chunk.size() >= CHUNK_ROWS) more = push_chunk(chunk);
+        }
+        if (!opened || op.has_error()) {
+            error = op.error().empty() ? "Gather: a worker failed to open" : op.error();
+        } else if (more && !chunk.empty()) {
+            static_cast<void>(push_chunk(chunk));
+        }
+        op.close();
+    } catch (...) {
+        exception = std::current_exception();
+    }
+
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    if (!error.empty() || exception) {
+        /* The other workers stop at their next chunk; rows already queued are still returned */
+        if (worker_error_.empty()) worker_error_ = error;
+        if (!worker_exception_) worker_exception_ = exception;
+        stopping_ = true;
+        space_cv_.notify_all();
+    }
+    --running_;
+    ready_cv_.notify_all();
+}
+
+bool GatherOperator::push_chunk(std::vector<Tuple>& chunk) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_cv_.wait(lock, [this] {
+        return stopping_ || queue_.size() < CHUNKS_PER_WORKER * workers_.size();
+    });
+    if (stopping_) {
+        return false;
+    }
+    queue_.push_back(std::move(chunk));
+    chunk = std::vector<Tuple>();
+    chunk.reserve(CHUNK_ROWS);
+    ready_cv_.notify_one();
+    return true;
+}
+
+void GatherOperator::stop_workers() {
+    {
+        const std::scoped_lock<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    space_cv_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+}
+
+void GatherOperator::close() {
+    stop_workers();
+    queue_.clear();
+    chunk_.clear();
+    chunk_pos_ = 0;
+    set_state(ExecState::Done);
+}
+
+Schema& GatherOperator::output_schema() {
+    return workers_.front()->output_schema();
+}
+
+void GatherOperator::explain(ExplainNode& node) const {
+    node.label = "Gather";
+    node.stats = stats();
+    node.details.push_back("Workers: " + std::to_string(workers_.size()));
+    if (scan_) {
+        node.details.push_back("Pages: " + std::to_string(scan_->page_count()));
+    }
+    workers_.front()->explain(node.add_child());
+}
+
 // --- BufferScanOperator ---
 
 BufferScanOperator::BufferScanOperator(std::string context_id, std::string table_name,
@@ -115,7 +384,7 @@ BufferScanOperator::BufferScanOperator(std::string context_id, std::string table
     }
 }
 
-bool BufferScanOperator::next(Tuple& out_tuple) {
+bool BufferScanOperator::next_impl(Tuple& out_tuple) {
     if (current_index_ >= data_.size()) {
         set_state(ExecState::Done);
         return false;
@@ -129,18 +398,75 @@ Schema& BufferScanOperator::output_schema() {
     return schema_;
 }
 
+void BufferScanOperator::explain(ExplainNode& node) const {
+    node.label = "Buffer Scan on " + table_name_;
+    node.stats = stats();
+    node.details.push_back("Rows: " + std::to_string(data_.size()));
+}
+
+// --- ExchangeScanOperator ---
+
+ExchangeScanOperator::ExchangeScanOperator(std::string table_name, Source source, Schema schema)
+    : Operator(OperatorType::ExchangeScan),
+      table_name_(std::move(table_name)),
+      source_(std::move(source)) {
+    for (const auto& col : schema.columns()) {
+        schema_.add_column(table_name_ + "." + col.name(), col.type(), col.nullable());
+    }
+}
+
+bool ExchangeScanOperator::next_impl(Tuple& out_tuple) {
+    while (current_index_ >= chunk_.size()) {
+        if (is_done() || has_error()) {
+            return false; /* The source is not asked again once the stream ended */
+        }
+        chunk_.clear();
+        current_index_ = 0;
+        std::string error;
+        if (!source_(chunk_, error)) {
+            if (error.empty()) {
+                set_state(ExecState::Done);
+                return false;
+            }
+            set_error("Exchange " + table_name_ + ": " + error);
+            throw std::runtime_error(this->error());
+        }
+    }
+    set_state(ExecState::Executing);
+    out_tuple = std::move(chunk_[current_index_++]);
+    return true;
+}
+
+Schema& ExchangeScanOperator::output_schema() {
+    return schema_;
+}
+
+void ExchangeScanOperator::explain(ExplainNode& node) const {
+    node.label = "Exchange Scan on " + table_name_;
+    node.stats = stats();
+}
+
 /* --- IndexScanOperator --- */
 
 IndexScanOperator::IndexScanOperator(std::unique_ptr<storage::HeapTable> table,
-                                     std::unique_ptr<storage::BTreeIndex> index,
+                                     std::unique_ptr<storage::Index> index,
                                      common::Value search_key, Transaction* txn,
                                      LockManager* lock_manager)
+    : IndexScanOperator(std::move(table), std::move(index),
+                        IndexScanOptions{storage::BTreeIndex::Bound{search_key, true},
+                                         storage::BTreeIndex::Bound{search_key, true}},
+                        txn, lock_manager) {}
+
+IndexScanOperator::IndexScanOperator(std::unique_ptr<storage::HeapTable> table,
+                                     std::unique_ptr<storage::Index> index,
+                                     IndexScanOptions options, Transaction* txn,
+                                     LockManager* lock_manager)
     : Operator(OperatorType::IndexScan, txn, lock_manager),
       table_name_(table->table_name()),
       index_name_(index->index_name()),
       table_(std::move(table)),
       index_(std::move(index)),
-      search_key_(std::move(search_key)) {
+      options_(std::move(options)) {
     /* Qualify columns in scan schema */
     auto base_schema = table_->schema();
     for (const auto& col : base_schema.columns()) {
@@ -153,48 +479,75 @@ bool IndexScanOperator::init() {
     return true;
 }
 
-bool IndexScanOperator::open() {
+bool IndexScanOperator::open_impl() {
     set_state(ExecState::Open);
-    matching_ids_ = index_->search(search_key_);
-    current_match_index_ = 0;
+    if (index_->ordered()) {
+        iterator_.emplace(
+            static_cast<storage::BTreeIndex&>(*index_).scan_range(options_.lower, options_.upper));
+    } else if (options_.lower) {
+        matches_ = index_->search(options_.lower->key);
+        next_match_ = 0;
+    }
     return true;
 }
 
-bool IndexScanOperator::next(Tuple& out_tuple) {
-    while (current_match_index_ < matching_ids_.size()) {
-        const auto& tid = matching_ids_[current_match_index_++];
-
-        storage::HeapTable::TupleId rid;
-        rid.page_num = tid.page_num;
-        rid.slot_num = tid.slot_num;
-
-        storage::HeapTable::TupleMeta meta;
-        if (table_->get_meta(rid, meta)) {
-            /* MVCC Visibility Check */
-            bool visible = true;
-            const Transaction* const txn = get_txn();
-            if (txn != nullptr) {
-                const auto& snapshot = txn->get_snapshot();
-                const uint64_t my_id = txn->get_id();
+bool IndexScanOperator::next_entry(storage::Index::Entry& entry) {
+    if (iterator_.has_value()) {
+        return iterator_->next(entry);
+    }
+    if (next_match_ >= matches_.size()) {
+        return false;
+    }
+    entry = storage::Index::Entry(options_.lower->key, matches_[next_match_++]);
+    return true;
+}
 
-                // 1. Check xmin (creation)
-                const bool xmin_visible =
-                    (meta.xmin == my_id) || (meta.xmin == 0) || snapshot.is_visible(meta.xmin);
+bool IndexScanOperator::next_impl(Tuple& out_tuple) {
+    storage::Index::Entry entry;
+    while (next_entry(entry)) {
+        const storage::HeapTable::TupleId& rid = entry.tuple_id;
+        uint64_t xmin = 0;
+        uint64_t xmax = 0;
+        if (options_.key_only) {
+            if (!table_->get_versions(rid, &xmin, &xmax)) continue;
+        } else {
+            if (!table_->get_meta(rid, meta_)) continue;
+            xmin = meta_.xmin;
+            xmax = meta_.xmax;
+        }
 
-                // 2. Check xmax (deletion)
-                const bool xmax_visible =
-                    (meta.xmax == 0) || (meta.xmax != my_id && !snapshot.is_visible(meta.xmax));
+        /* MVCC Visibility Check */
+        const Transaction* const txn = get_txn();
+        const bool visible = txn != nullptr ? txn->can_see(xmin, xmax) : xmax == 0;
+        if (!visible) continue;
 
-                visible = xmin_visible && xmax_visible;
-            } else {
-                visible = (meta.xmax == 0);
-            }
+        if (!options_.key_only) {
+            std::swap(out_tuple, meta_.tuple);
+            return true;
+        }
 
-            if (visible) {
-                out_tuple = std::move(meta.tuple);
-                return true;
-            }
+        /* Same value types as a heap decode of the column */
+        auto& values = out_tuple.values();
+        values.assign(schema_.column_count(), common::Value());
+        common::Value& key = values[options_.key_column];
+        switch (schema_.get_column(options_.key_column).type()) {
+            case common::ValueType::TYPE_INT8:
+            case common::ValueType::TYPE_INT16:
+            case common::ValueType::TYPE_INT32:
+            case common::ValueType::TYPE_INT64:
+                key = entry.key.is_null() ? common::Value()
+                                          : common::Value::make_int64(entry.key.to_int64());
+                break;
+            case common::ValueType::TYPE_FLOAT32:
+            case common::ValueType::TYPE_FLOAT64:
+                key = entry.key.is_null() ? common::Value()
+                                          : common::Value::make_float64(entry.key.to_float64());
+                break;
+            default:
+                key = std::move(entry.key);
+                break;
         }
+        return true;
     }
 
     set_state(ExecState::Done);
@@ -202,7 +555,8 @@ bool IndexScanOperator::next(Tuple& out_tuple) {
 }
 
 void IndexScanOperator::close() {
-    matching_ids_.clear();
+    iterator_.reset();
+    matches_.clear();
     set_state(ExecState::Done);
 }
 
@@ -210,6 +564,89 @@ Schema& IndexScanOperator::output_schema() {
     return schema_;
 }
 
+void IndexScanOperator::explain(ExplainNode& node) const {
+    node.label = std::string(options_.key_only ? "Index Only Scan using " : "Index Scan using ") +
+                 index_name_ + " on " + table_name_;
+    node.stats = stats();
+    if (!index_->ordered() && options_.lower) {
+        node.details.push_back("Index Cond: key = " + options_.lower->key.to_string());
+        return;
+    }
+    const std::string cond = key_range_text(options_.lower, options_.upper);
+    if (!cond.empty()) {
+        node.details.push_back("Index Cond: key " + cond);
+    }
+}
+
+/* --- BitmapHeapScanOperator --- */
+
+BitmapHeapScanOperator::BitmapHeapScanOperator(std::unique_ptr<storage::HeapTable> table,
+                                               std::unique_ptr<storage::BrinIndex> index,
+                                               std::optional<storage::BTreeIndex::Bound> lower,
+                                               std::optional<storage::BTreeIndex::Bound> upper,
+                                               Transaction* txn, LockManager* lock_manager)
+    : Operator(OperatorType::BitmapHeapScan, txn, lock_manager),
+      table_name_(table->table_name()),
+      table_(std::move(table)),
+      index_(std::move(index)),
+      lower_(std::move(lower)),
+      upper_(std::move(upper)) {
+    for (const auto& col : table_->schema().columns()) {
+        schema_.add_column(table_name_ + "." + col.name(), col.type(), col.nullable());
+    }
+}
+
+bool BitmapHeapScanOperator::init() {
+    set_state(ExecState::Init);
+    return true;
+}
+
+bool BitmapHeapScanOperator::open_impl() {
+    set_state(ExecState::Open);
+    auto ranges = index_->matching_ranges(lower_, upper_);
+    ranges_selected_ = ranges.size();
+    iterator_ =
+        std::make_unique<storage::HeapTable::Iterator>(table_->scan_ranges(std::move(ranges)));
+    return true;
+}
+
+bool BitmapHeapScanOperator::next_impl(Tuple& out_tuple) {
+    while (iterator_ && iterator_->next_meta(meta_)) {
+        const Transaction* const txn = get_txn();
+        const bool visible =
+            txn != nullptr ? txn->can_see(meta_.xmin, meta_.xmax) : meta_.xmax == 0;
+        if (visible) {
+            std::swap(out_tuple, meta_.tuple);
+            return true;
+        }
+    }
+    set_state(ExecState::Done);
+    return false;
+}
+
+void BitmapHeapScanOperator::close() {
+    iterator_.reset();
+    set_state(ExecState::Done);
+}
+
+Schema& BitmapHeapScanOperator::output_schema() {
+    return schema_;
+}
+
+void BitmapHeapScanOperator::explain(ExplainNode& node) const {
+    node.label = "Bitmap Heap Scan on " + table_name_;
+    node.stats = stats();
+    const std::string cond = key_range_text(lower_, upper_);
+    if (!cond.empty()) {
+        node.details.push_back("Recheck Cond: key " + cond);
+    }
+    ExplainNode& index_node = node.add_child();
+    index_node.label = "Bitmap Index Scan on " + index_->index_name();
+    if (stats() != nullptr) {
+        index_node.details.push_back("Page Ranges: " + std::to_string(ranges_selected_));
+    }
+}
+
 /* --- FilterOperator --- */
 
 FilterOperator::FilterOperator(std::unique_ptr<Operator> child,
@@ -219,6 +656,7 @@ FilterOperator::FilterOperator(std::unique_ptr<Operator> child,
       condition_(std::move(condition)) {
     if (child_) {
         schema_ = child_->output_schema();
+        compiled_ = std::make_unique<CompiledExpression>(*condition_, schema_);
     }
 }
 
@@ -226,7 +664,7 @@ bool FilterOperator::init() {
     return child_->init();
 }
 
-bool FilterOperator::open() {
+bool FilterOperator::open_impl() {
     if (!child_->open()) {
         return false;
     }
@@ -234,13 +672,10 @@ bool FilterOperator::open() {
     return true;
 }
 
-bool FilterOperator::next(Tuple& out_tuple) {
-    Tuple tuple;
-    while (child_->next(tuple)) {
-        /* Evaluate condition against the current tuple context */
-        const common::Value result = condition_->evaluate(&tuple, &schema_);
-        if (result.as_bool()) {
-            out_tuple = std::move(tuple);
+bool FilterOperator::next_impl(Tuple& out_tuple) {
+    /* The child decodes straight into the caller's tuple; rejected rows are overwritten */
+    while (child_->next(out_tuple)) {
+        if (compiled_->test(out_tuple)) {
             return true;
         }
     }
@@ -257,8 +692,22 @@ Schema& FilterOperator::output_schema() {
     return schema_;
 }
 
+void FilterOperator::explain(ExplainNode& node) const {
+    node.label = "Filter";
+    node.stats = stats();
+    node.details.push_back("Condition: " + condition_->to_string());
+    child_->explain(node.add_child());
+}
+
 void FilterOperator::add_child(std::unique_ptr<Operator> child) {
     child_ = std::move(child);
+    schema_ = child_->output_schema();
+    compiled_ = std::make_unique<CompiledExpression>(*condition_, schema_);
+}
+
+bool FilterOperator::push_runtime_filter(std::shared_ptr<const RuntimeFilter> filter,
+                                         size_t column) {
+    return child_ && child_->push_runtime_filter(std::move(filter), column);
 }
 
 /* --- ProjectOperator --- */
@@ -284,6 +733,7 @@ ProjectOperator::ProjectOperator(std::unique_ptr<Operator> child,
                 type = common::ValueType::TYPE_FLOAT64;
             }
             schema_.add_column(col->to_string(), type);
+            compiled_.emplace_back(*col, child_schema);
         }
     }
 }
@@ -292,7 +742,7 @@ bool ProjectOperator::init() {
     return child_->init();
 }
 
-bool ProjectOperator::open() {
+bool ProjectOperator::open_impl() {
     if (!child_->open()) {
         return false;
     }
@@ -300,22 +750,18 @@ bool ProjectOperator::open() {
     return true;
 }
 
-bool ProjectOperator::next(Tuple& out_tuple) {
-    Tuple input;
-    if (!child_->next(input)) {
+bool ProjectOperator::next_impl(Tuple& out_tuple) {
+    if (!child_->next(input_)) {
         set_state(ExecState::Done);
         return false;
     }
 
-    std::vector<common::Value> output_values;
-    output_values.reserve(columns_.size());
-    auto input_schema = child_->output_schema();
-    for (const auto& col : columns_) {
-        /* Evaluate projection expression with input tuple context */
-        common::Value v = col->evaluate(&input, &input_schema);
-        output_values.push_back(std::move(v));
+    /* Both buffers are reused from row to row */
+    auto& output_values = out_tuple.values();
+    output_values.clear();
+    for (const auto& col : compiled_) {
+        output_values.push_back(col.evaluate(input_));
     }
-    out_tuple = Tuple(std::move(output_values));
     return true;
 }
 
@@ -328,231 +774,814 @@ Schema& ProjectOperator::output_schema() {
     return schema_;
 }
 
+void ProjectOperator::explain(ExplainNode& node) const {
+    node.label = "Project";
+    node.stats = stats();
+    node.details.push_back("Output: " + expression_list(columns_));
+    child_->explain(node.add_child());
+}
+
 void ProjectOperator::add_child(std::unique_ptr<Operator> child) {
     child_ = std::move(child);
+    compiled_.clear();
+    for (const auto& col : columns_) {
+        compiled_.emplace_back(*col, child_->output_schema());
+    }
 }
 
 /* --- SortOperator --- */
 
+namespace {
+
+enum SortKeyTag : uint8_t {
+    SORT_KEY_NUMBER = 0x10,
+    SORT_KEY_STRING = 0x20,
+    SORT_KEY_OTHER = 0x30, /**< Values Value::operator< treats as all equal */
+    SORT_KEY_NULL = 0x40
+};
+
+void append_big_endian(uint64_t value, std::string& out) {
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<char>((value >> shift) & 0xFF));
+    }
+}
+
+}  // namespace
+
+std::atomic<size_t> SortOperator::default_memory_budget_{DEFAULT_MEMORY_BUDGET};
+
+void SortOperator::set_default_memory_budget(size_t bytes) {
+    default_memory_budget_.store(bytes, std::memory_order_relaxed);
+}
+
+size_t SortOperator::default_memory_budget() {
+    return default_memory_budget_.load(std::memory_order_relaxed);
+}
+
+void SortOperator::encode_sort_key(const common::Value& value, bool ascending, std::string& out) {
+    const size_t start = out.size();
+    if (value.is_null()) {
+        out.push_back(static_cast<char>(SORT_KEY_NULL));
+    } else if (value.is_numeric()) {
+        /* Order-preserving double: flip the sign bit of positives, every bit of negatives */
+        out.push_back(static_cast<char>(SORT_KEY_NUMBER));
+        uint64_t bits = hashing::double_bits(value.to_float64());
+        bits = (bits >> 63) != 0 ? ~bits : bits ^ (uint64_t{1} << 63);
+        append_big_endian(bits, out);
+    } else if (value.type() == common::ValueType::TYPE_CHAR ||
+               value.type() == common::ValueType::TYPE_VARCHAR ||
+               value.type() == common::ValueType::TYPE_TEXT) {
+        /* 0x00 is escaped as 0x00 0xFF, so the 0x00 0x00 terminator sorts first */
+        out.push_back(static_cast<char>(SORT_KEY_STRING));
+        for (const char c : value.text_view()) {
+            out.push_back(c);
+            if (c == '\0') out.push_back(static_cast<char>(0xFF));
+        }
+        out.append(2, '\0');
+    } else {
+        out.push_back(static_cast<char>(SORT_KEY_OTHER));
+    }
+    if (!ascending) {
+        for (size_t i = start; i < out.size(); ++i) out[i] = static_cast<char>(~out[i]);
+    }
+}
+
 SortOperator::SortOperator(std::unique_ptr<Operator> child,
                            std::vector<std::unique_ptr<parser::Expression>> sort_keys,
-                           std::vector<bool> ascending)
+                           std::vector<bool> ascending, SortOptions options)
     : Operator(OperatorType::Sort, child->get_txn(), child->get_lock_manager()),
       child_(std::move(child)),
       sort_keys_(std::move(sort_keys)),
-      ascending_(std::move(ascending)) {
+      ascending_(std::move(ascending)),
+      options_(std::move(options)) {
     if (child_) {
         schema_ = child_->output_schema();
     }
+    compiled_keys_.reserve(sort_keys_.size());
+    for (const auto& key : sort_keys_) {
+        compiled_keys_.emplace_back(*key, schema_);
+    }
 }
 
 bool SortOperator::init() {
     return child_->init();
 }
 
-bool SortOperator::open() {
-    if (!child_->open()) {
-        return false;
+std::string SortOperator::make_key(const Tuple& tuple) const {
+    std::string key;
+    for (size_t i = 0; i < compiled_keys_.size(); ++i) {
+        encode_sort_key(compiled_keys_[i].evaluate(tuple), ascending_[i], key);
     }
+    return key;
+}
 
-    sorted_tuples_.clear();
+void SortOperator::collect_top_n() {
+    /* Max-heap of the best `limit` rows; the arrival number in each key keeps ties stable */
+    const auto less = [](const SortRow& a, const SortRow& b) { return a.key < b.key; };
+    uint64_t arrival = 0;
+    size_t used = 0;
     Tuple tuple;
     while (child_->next(tuple)) {
-        sorted_tuples_.push_back(std::move(tuple));
-    }
-
-    /* Perform sort using child schema for evaluation */
-    std::stable_sort(sorted_tuples_.begin(), sorted_tuples_.end(),
-                     [this](const Tuple& a, const Tuple& b) {
-                         for (size_t i = 0; i < sort_keys_.size(); ++i) {
-                             const common::Value val_a = sort_keys_[i]->evaluate(&a, &schema_);
-                             const common::Value val_b = sort_keys_[i]->evaluate(&b, &schema_);
-                             const bool asc = ascending_[i];
-                             if (val_a < val_b) {
-                                 return asc;
-                             }
-                             if (val_b < val_a) {
-                                 return !asc;
-                             }
-                         }
-                         return false;
-                     });
-
-    current_index_ = 0;
-    set_state(ExecState::Open);
-    return true;
+        std::string key = make_key(tuple);
+        append_big_endian(arrival++, key);
+        if (sorted_rows_.size() < options_.limit) {
+            used += sizeof(SortRow) + key.capacity() + tuple_bytes(tuple.values());
+            track_memory(used, "Top-N Sort");
+            sorted_rows_.push_back(SortRow{std::move(key), std::move(tuple)});
+            std::push_heap(sorted_rows_.begin(), sorted_rows_.end(), less);
+        } else if (key < sorted_rows_.front().key) {
+            std::pop_heap(sorted_rows_.begin(), sorted_rows_.end(), less);
+            sorted_rows_.back() = SortRow{std::move(key), std::move(tuple)};
+            std::push_heap(sorted_rows_.begin(), sorted_rows_.end(), less);
+        }
+    }
+    std::sort_heap(sorted_rows_.begin(), sorted_rows_.end(), less);
 }
 
-bool SortOperator::next(Tuple& out_tuple) {
-    if (current_index_ >= sorted_tuples_.size()) {
-        set_state(ExecState::Done);
-        return false;
+void SortOperator::collect_all() {
+    const size_t budget =
+        options_.memory_budget != 0 ? options_.memory_budget : default_memory_budget();
+    size_t used = 0;
+    Tuple tuple;
+    while (child_->next(tuple)) {
+        std::string key = make_key(tuple);
+        used += sizeof(SortRow) + key.capacity() + tuple_bytes(tuple.values());
+        sorted_rows_.push_back(SortRow{std::move(key), std::move(tuple)});
+        if (used > budget || !try_track_memory(used)) {
+            spill_run();
+            used = 0;
+            track_memory(0, "Sort");
+        }
     }
-    out_tuple = std::move(sorted_tuples_[current_index_++]);
-    return true;
+
+    if (runs_.empty()) {
+        std::stable_sort(
+            sorted_rows_.begin(), sorted_rows_.end(),
+            [](const SortRow& a, const SortRow& b) { return a.key < b.key; });
+        return;
+    }
+    if (!sorted_rows_.empty()) spill_run();
+    std::vector<SortRow>().swap(sorted_rows_);
+    while (runs_.size() > MERGE_FANIN) merge_pass();
+    start_merge(std::move(runs_));
+    runs_.clear();
 }
 
-void SortOperator::close() {
-    sorted_tuples_.clear();
-    child_->close();
-    set_state(ExecState::Done);
+void SortOperator::spill_run() {
+    std::stable_sort(sorted_rows_.begin(), sorted_rows_.end(),
+                     [](const SortRow& a, const SortRow& b) { return a.key < b.key; });
+    auto run = std::make_unique<SpillFile>(options_.spill_dir);
+    for (const auto& row : sorted_rows_) run->write(row.key, row.tuple);
+    runs_.push_back(std::move(run));
+    sorted_rows_.clear();
+    ++spilled_runs_;
 }
 
-Schema& SortOperator::output_schema() {
-    return schema_;
+void SortOperator::merge_pass() {
+    /* Merges neighbouring runs, so equal keys stay in input order */
+    std::vector<std::unique_ptr<SpillFile>> merged;
+    for (size_t first = 0; first < runs_.size(); first += MERGE_FANIN) {
+        const size_t last = std::min(first + MERGE_FANIN, runs_.size());
+        std::vector<std::unique_ptr<SpillFile>> group(
+            std::make_move_iterator(runs_.begin() + static_cast<std::ptrdiff_t>(first)),
+            std::make_move_iterator(runs_.begin() + static_cast<std::ptrdiff_t>(last)));
+        auto out = std::make_unique<SpillFile>(options_.spill_dir);
+        start_merge(std::move(group));
+        SortRow row;
+        while (pop_merged(row)) out->write(row.key, row.tuple);
+        merged.push_back(std::move(out));
+    }
+    runs_ = std::move(merged);
 }
 
-/* --- AggregateOperator --- */
+bool SortOperator::merge_before(size_t a, size_t b) const {
+    const int order = merge_inputs_[a].row.key.compare(merge_inputs_[b].row.key);
+    return order < 0 || (order == 0 && a < b);
+}
 
-AggregateOperator::AggregateOperator(std::unique_ptr<Operator> child,
-                                     std::vector<std::unique_ptr<parser::Expression>> group_by,
-                                     std::vector<AggregateInfo> aggregates)
-    : Operator(OperatorType::Aggregate, child->get_txn(), child->get_lock_manager()),
-      child_(std::move(child)),
-      group_by_(std::move(group_by)),
-      aggregates_(std::move(aggregates)) {
-    if (child_) {
-        /* Use actual expression string for column name to allow lookup */
-        for (const auto& gb : group_by_) {
-            if (gb) {
-                schema_.add_column(gb->to_string(), common::ValueType::TYPE_TEXT);
-            }
-        }
-        for (const auto& agg : aggregates_) {
-            common::ValueType t = common::ValueType::TYPE_FLOAT64;
-            if (agg.type == AggregateType::Count) {
-                t = common::ValueType::TYPE_INT64;
-            }
-            schema_.add_column(agg.name, t);
+void SortOperator::start_merge(std::vector<std::unique_ptr<SpillFile>> runs) {
+    merge_inputs_.clear();
+    merge_heap_.clear();
+    for (auto& run : runs) {
+        run->rewind();
+        MergeInput input{std::move(run), {}};
+        if (input.file->read(input.row.key, input.row.tuple)) {
+            merge_inputs_.push_back(std::move(input));
         }
     }
+    for (size_t i = 0; i < merge_inputs_.size(); ++i) merge_heap_.push_back(i);
+    std::make_heap(merge_heap_.begin(), merge_heap_.end(),
+                   [this](size_t a, size_t b) { return merge_before(b, a); });
 }
 
-bool AggregateOperator::init() {
-    return child_->init();
+bool SortOperator::pop_merged(SortRow& row) {
+    if (merge_heap_.empty()) return false;
+    const auto after = [this](size_t a, size_t b) { return merge_before(b, a); };
+    std::pop_heap(merge_heap_.begin(), merge_heap_.end(), after);
+    MergeInput& input = merge_inputs_[merge_heap_.back()];
+    row = std::move(input.row);
+    if (input.file->read(input.row.key, input.row.tuple)) {
+        std::push_heap(merge_heap_.begin(), merge_heap_.end(), after);
+    } else {
+        input.file.reset();
+        merge_heap_.pop_back();
+    }
+    return true;
 }
 
-bool AggregateOperator::open() {
+bool SortOperator::open_impl() {
     if (!child_->open()) {
         return false;
     }
 
-    struct GroupState {
-        std::vector<common::Value> group_values;
-        std::vector<int64_t> counts;
-        std::vector<double> sums;
-        std::vector<common::Value> mins;
-        std::vector<common::Value> maxes;
-        std::unordered_map<size_t, std::unordered_set<std::string>> distinct_seen;
-
-        GroupState() = default;
-        explicit GroupState(size_t agg_size) {
-            counts.assign(agg_size, 0);
-            sums.assign(agg_size, 0.0);
-            mins.assign(agg_size, common::Value::make_null());
-            maxes.assign(agg_size, common::Value::make_null());
+    sorted_rows_.clear();
+    runs_.clear();
+    merge_inputs_.clear();
+    merge_heap_.clear();
+    spilled_runs_ = 0;
+    try {
+        if (options_.limit > 0) {
+            collect_top_n();
+        } else {
+            collect_all();
         }
-    };
-
-    std::map<std::string, GroupState> groups_map;
-    const bool is_global = group_by_.empty();
-
-    /* Pre-initialize if global aggregation */
-    if (is_global) {
-        groups_map["GLOBAL"] = GroupState(aggregates_.size());
+    } catch (const common::MemoryLimitError&) {
+        throw; /* Fails the statement, wherever in the plan */
+    } catch (const std::exception& e) {
+        set_error(std::string("Sort: ") + e.what());
+        return false;
     }
 
-    Tuple tuple;
-    auto child_schema = child_->output_schema();
-    while (child_->next(tuple)) {
-        std::string key = "GLOBAL";
-        std::vector<common::Value> gb_vals;
+    current_index_ = 0;
+    set_state(ExecState::Open);
+    return true;
+}
 
-        if (!is_global) {
-            key = "";
-            for (const auto& gb : group_by_) {
-                auto val = gb ? gb->evaluate(&tuple, &child_schema) : common::Value::make_null();
-                key += val.to_string() + "|";
-                gb_vals.push_back(std::move(val));
-            }
+bool SortOperator::next_impl(Tuple& out_tuple) {
+    if (!merge_heap_.empty()) {
+        try {
+            SortRow row;
+            static_cast<void>(pop_merged(row));
+            out_tuple = std::move(row.tuple);
+            return true;
+        } catch (const common::MemoryLimitError&) {
+            throw; /* Fails the statement, wherever in the plan */
+        } catch (const std::exception& e) {
+            set_error(std::string("Sort: ") + e.what());
+            return false;
         }
+    }
+    if (current_index_ >= sorted_rows_.size()) {
+        set_state(ExecState::Done);
+        return false;
+    }
+    out_tuple = std::move(sorted_rows_[current_index_++].tuple);
+    return true;
+}
+
+void SortOperator::close() {
+    sorted_rows_.clear();
+    runs_.clear();
+    merge_inputs_.clear();
+    merge_heap_.clear();
+    track_memory(0, "Sort");
+    child_->close();
+    set_state(ExecState::Done);
+}
 
-        auto it = groups_map.find(key);
-        if (it == groups_map.end()) {
-            it = groups_map.emplace(key, GroupState(aggregates_.size())).first;
-            it->second.group_values = std::move(gb_vals);
+Schema& SortOperator::output_schema() {
+    return schema_;
+}
+
+void SortOperator::explain(ExplainNode& node) const {
+    node.label = options_.limit > 0 ? "Top-N Sort" : "Sort";
+    node.stats = stats();
+    std::string keys;
+    for (size_t i = 0; i < sort_keys_.size(); ++i) {
+        if (i > 0) keys += ", ";
+        keys += sort_keys_[i]->to_string() + (ascending_[i] ? "" : " DESC");
+    }
+    node.details.push_back("Sort Key: " + keys);
+    if (spilled_runs_ > 0) {
+        node.details.push_back("Spilled Runs: " + std::to_string(spilled_runs_));
+    }
+    child_->explain(node.add_child());
+}
+
+/* --- AggregateOperator --- */
+
+namespace {
+
+/* Each partitioning pass takes the next PARTITION_BITS of the key hash, from the top */
+constexpr unsigned PARTITION_BITS = 4;
+constexpr unsigned MAX_SPILL_LEVEL = 64 / PARTITION_BITS - 1;
+static_assert((size_t{1} << PARTITION_BITS) == AggregateOperator::SPILL_PARTITIONS,
+              "partition bits must cover SPILL_PARTITIONS");
+
+size_t spill_partition(uint64_t hash, unsigned level) {
+    const unsigned shift = 64 - PARTITION_BITS * (level + 1);
+    return static_cast<size_t>((hash >> shift) & (AggregateOperator::SPILL_PARTITIONS - 1));
+}
+
+}  // namespace
+
+std::atomic<size_t> AggregateOperator::default_memory_budget_{DEFAULT_MEMORY_BUDGET};
+
+void AggregateOperator::set_default_memory_budget(size_t bytes) {
+    default_memory_budget_.store(bytes, std::memory_order_relaxed);
+}
+
+size_t AggregateOperator::default_memory_budget() {
+    return default_memory_budget_.load(std::memory_order_relaxed);
+}
+
+AggregateOperator::AggregateOperator(std::unique_ptr<Operator> child,
+                                     std::vector<std::unique_ptr<parser::Expression>> group_by,
+                                     std::vector<AggregateInfo> aggregates,
+                                     AggregateOptions options)
+    : Operator(OperatorType::Aggregate, child->get_txn(), child->get_lock_manager()),
+      child_(std::move(child)),
+      group_by_(std::move(group_by)),
+      aggregates_(std::move(aggregates)),
+      options_(std::move(options)) {
+    if (child_) {
+        /* Use actual expression string for column name to allow lookup */
+        for (const auto& gb : group_by_) {
+            if (gb) {
+                schema_.add_column(gb->to_string(), common::ValueType::TYPE_TEXT);
+            }
+        }
+        for (const auto& agg : aggregates_) {
+            common::ValueType t = common::ValueType::TYPE_FLOAT64;
+            if (agg.type == AggregateType::Count) {
+                t = common::ValueType::TYPE_INT64;
+            }
+            schema_.add_column(agg.name, t);
+            if (options_.mode == AggregateMode::Partial && agg.type == AggregateType::Avg) {
+                schema_.add_column(agg.name + " count", common::ValueType::TYPE_INT64);
+            }
         }
-        auto& state = it->second;
 
-        for (size_t i = 0; i < aggregates_.size(); ++i) {
-            common::Value val;
-            if (aggregates_[i].expr) {
-                val = aggregates_[i].expr->evaluate(&tuple, &child_schema);
-            } else {
-                val = common::Value::make_int64(static_cast<int64_t>(1));
+        /* Partial rows are merged column by column; there is nothing to evaluate */
+        const Schema& child_schema = child_->output_schema();
+        if (options_.mode != AggregateMode::Final) {
+            for (const auto& gb : group_by_) {
+                compiled_group_by_.push_back(
+                    gb ? std::make_unique<CompiledExpression>(*gb, child_schema) : nullptr);
+            }
+            for (const auto& agg : aggregates_) {
+                compiled_args_.push_back(agg.expr ? std::make_unique<CompiledExpression>(
+                                                        *agg.expr, child_schema)
+                                                  : nullptr);
             }
+        }
+    }
+    distinct_seen_.resize(aggregates_.size());
+}
+
+bool AggregateOperator::init() {
+    return child_->init();
+}
+
+size_t AggregateOperator::budget() const {
+    return options_.memory_budget != 0 ? options_.memory_budget : default_memory_budget();
+}
+
+size_t AggregateOperator::pass_memory() const {
+    size_t bytes = memory_used_ + group_table_.memory_bytes();
+    for (const auto& seen : distinct_seen_) bytes += seen.memory_bytes();
+    return bytes;
+}
+
+void AggregateOperator::evaluate_row(const Tuple& tuple) {
+    auto& values = inputs_.values();
+    if (options_.mode == AggregateMode::Final) {
+        values = tuple.values();
+        return;
+    }
+    values.clear();
+    for (const auto& gb : compiled_group_by_) {
+        values.push_back(gb ? gb->evaluate(tuple) : common::Value::make_null());
+    }
+    for (const auto& arg : compiled_args_) {
+        /* COUNT(*) counts a non-NULL placeholder per row */
+        values.push_back(arg ? arg->evaluate(tuple)
+                             : common::Value::make_int64(static_cast<int64_t>(1)));
+    }
+}
+
+void AggregateOperator::encode_group_key(const Tuple& inputs) {
+    key_.clear();
+    for (size_t i = 0; i < group_by_.size(); ++i) {
+        GroupKeyTable::append_key(inputs.get(i), key_);
+    }
+}
+
+void AggregateOperator::reset_pass() {
+    group_table_.clear();
+    group_states_.clear();
+    for (auto& seen : distinct_seen_) seen.clear();
+    memory_used_ = 0;
+    pass_spill_.clear();
+    track_memory(0, "Aggregate");
+}
+
+uint32_t AggregateOperator::add_group(uint64_t hash, const Tuple& inputs) {
+    const uint32_t id = group_table_.insert(key_, hash).first;
+    const size_t aggregates = aggregates_.size();
+    GroupState state;
+    const auto first = inputs.values().begin();
+    state.group_values.assign(first, first + static_cast<std::ptrdiff_t>(group_by_.size()));
+    state.counts.assign(aggregates, 0);
+    state.sums.assign(aggregates, 0.0);
+    state.mins.assign(aggregates, common::Value::make_null());
+    state.maxes.assign(aggregates, common::Value::make_null());
+    memory_used_ += sizeof(GroupState) + tuple_bytes(state.group_values) +
+                    aggregates * (sizeof(int64_t) + sizeof(double) + 2 * sizeof(common::Value));
+    group_states_.push_back(std::move(state));
+    return id;
+}
 
-            if (val.is_null()) {
+bool AggregateOperator::accumulate(uint32_t group, const Tuple& inputs) {
+    auto& state = group_states_[group];
+    if (options_.mode == AggregateMode::Final) {
+        merge_partial(state, inputs);
+        return false;
+    }
+    bool distinct_grew = false;
+    for (size_t i = 0; i < aggregates_.size(); ++i) {
+        const common::Value& val = inputs.get(group_by_.size() + i);
+        if (val.is_null()) {
+            continue;
+        }
+
+        /* Handle DISTINCT: the argument counts once per group */
+        if (aggregates_[i].is_distinct) {
+            key_.assign(reinterpret_cast<const char*>(&group), sizeof(group));
+            GroupKeyTable::append_key(val, key_);
+            if (!distinct_seen_[i].insert(key_, GroupKeyTable::hash_key(key_)).second) {
                 continue;
             }
+            distinct_grew = true;
+        }
 
-            /* Handle DISTINCT */
-            if (aggregates_[i].is_distinct) {
-                const std::string val_str = val.to_string();
-                if (state.distinct_seen[i].count(val_str) > 0) {
-                    continue;
+        state.counts[i]++;
+        if (aggregates_[i].type == AggregateType::Count) {
+            continue;
+        }
+        if (val.is_numeric()) {
+            state.sums[i] += val.to_float64();
+        }
+        if (aggregates_[i].type == AggregateType::Min &&
+            (state.mins[i].is_null() || val < state.mins[i])) {
+            state.mins[i] = val;
+        }
+        if (aggregates_[i].type == AggregateType::Max &&
+            (state.maxes[i].is_null() || state.maxes[i] < val)) {
+            state.maxes[i] = val;
+        }
+    }
+    return distinct_grew;
+}
+
+void AggregateOperator::merge_partial(GroupState& state, const Tuple& inputs) const {
+    size_t column = group_by_.size();
+    for (size_t i = 0; i < aggregates_.size(); ++i) {
+        const common::Value& val = inputs.get(column++);
+        switch (aggregates_[i].type) {
+            case AggregateType::Count:
+                state.counts[i] += val.is_null() ? 0 : val.to_int64();
+                break;
+            case AggregateType::Sum:
+                state.sums[i] += val.is_null() ? 0.0 : val.to_float64();
+                break;
+            case AggregateType::Min:
+                if (!val.is_null() && (state.mins[i].is_null() || val < state.mins[i])) {
+                    state.mins[i] = val;
+                }
+                break;
+            case AggregateType::Max:
+                if (!val.is_null() && (state.maxes[i].is_null() || state.maxes[i] < val)) {
+                    state.maxes[i] = val;
                 }
-                state.distinct_seen[i].insert(val_str);
+                break;
+            case AggregateType::Avg: {
+                const common::Value& count = inputs.get(column++);
+                state.sums[i] += val.is_null() ? 0.0 : val.to_float64();
+                state.counts[i] += count.is_null() ? 0 : count.to_int64();
+                break;
             }
+        }
+    }
+}
 
-            if (aggregates_[i].type == AggregateType::Count && !aggregates_[i].expr) {
-                state.counts[i]++;
-                continue;
+void AggregateOperator::aggregate_row(const Tuple& inputs) {
+    encode_group_key(inputs);
+    const uint64_t hash = GroupKeyTable::hash_key(key_);
+    uint32_t group = group_table_.find(key_, hash);
+    const bool added = group == GroupKeyTable::NOT_FOUND;
+    if (added) {
+        if (!pass_spill_.empty()) {
+            /* Over budget: the row waits in its partition for a later pass */
+            auto& file = pass_spill_[spill_partition(hash, pass_level_)];
+            if (!file) {
+                file = std::make_unique<SpillFile>(options_.spill_dir);
+                ++spilled_partitions_;
             }
+            file->write(inputs);
+            return;
+        }
+        group = add_group(hash, inputs);
+    }
+    /* Memory grows with new groups and new DISTINCT values; past the budget, new groups spill */
+    if (!accumulate(group, inputs) && !added) {
+        return;
+    }
+    const size_t used = pass_memory();
+    if (group_by_.empty() || pass_level_ >= MAX_SPILL_LEVEL) {
+        track_memory(used, "Aggregate");
+    } else if (pass_spill_.empty() && (used > budget() || !try_track_memory(used))) {
+        pass_spill_.resize(SPILL_PARTITIONS);
+    }
+}
 
-            state.counts[i]++;
-            if (val.is_numeric()) {
-                state.sums[i] += val.to_float64();
-            }
+Tuple AggregateOperator::finish_group(GroupState& state) const {
+    std::vector<common::Value> row = std::move(state.group_values);
+    for (size_t i = 0; i < aggregates_.size(); ++i) {
+        switch (aggregates_[i].type) {
+            case AggregateType::Count:
+                row.push_back(common::Value::make_int64(state.counts[i]));
+                break;
+            case AggregateType::Sum:
+                row.push_back(common::Value::make_float64(state.sums[i]));
+                break;
+            case AggregateType::Min:
+                row.push_back(std::move(state.mins[i]));
+                break;
+            case AggregateType::Max:
+                row.push_back(std::move(state.maxes[i]));
+                break;
+            case AggregateType::Avg:
+                if (options_.mode == AggregateMode::Partial) {
+                    row.push_back(common::Value::make_float64(state.sums[i]));
+                    row.push_back(common::Value::make_int64(state.counts[i]));
+                } else if (state.counts[i] > 0) {
+                    row.push_back(common::Value::make_float64(
+                        state.sums[i] / static_cast<double>(state.counts[i])));
+                } else {
+                    row.push_back(common::Value::make_null());
+                }
+                break;
+        }
+    }
+    return Tuple(std::move(row));
+}
+
+void AggregateOperator::finish_pass() {
+    /* Groups come out ordered by the text of their keys */
+    std::vector<std::pair<std::string, uint32_t>> order;
+    order.reserve(group_states_.size());
+    for (size_t id = 0; id < group_states_.size(); ++id) {
+        std::string text;
+        for (const auto& value : group_states_[id].group_values) text += value.to_string() + "|";
+        order.emplace_back(std::move(text), static_cast<uint32_t>(id));
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    groups_.clear();
+    groups_.reserve(order.size());
+    for (const auto& entry : order) groups_.push_back(finish_group(group_states_[entry.second]));
+    current_group_ = 0;
+
+    for (auto& file : pass_spill_) {
+        if (file) pending_.push_back(SpilledPartition{std::move(file), pass_level_ + 1});
+    }
+    reset_pass();
+}
+
+bool AggregateOperator::run_pending_pass() {
+    while (!pending_.empty()) {
+        SpilledPartition partition = std::move(pending_.back());
+        pending_.pop_back();
+        reset_pass();
+        pass_level_ = partition.level;
+        partition.file->rewind();
+        Tuple inputs;
+        while (partition.file->read(inputs)) aggregate_row(inputs);
+        partition.file.reset();
+        finish_pass();
+        if (!groups_.empty()) return true;
+    }
+    return false;
+}
 
-            if (state.mins[i].is_null() || val < state.mins[i]) {
-                state.mins[i] = val;
+bool AggregateOperator::open_impl() {
+    if (!child_->open()) {
+        return false;
+    }
+
+    groups_.clear();
+    current_group_ = 0;
+    pending_.clear();
+    spilled_partitions_ = 0;
+    stream_key_.clear();
+    stream_has_group_ = false;
+    stream_done_ = false;
+    reset_pass();
+    pass_level_ = 0;
+    if (streaming()) {
+        set_state(ExecState::Open);
+        return true;
+    }
+
+    try {
+        /* A global aggregation has its one group even over no input */
+        if (group_by_.empty()) {
+            key_.clear();
+            static_cast<void>(add_group(GroupKeyTable::hash_key(key_), inputs_));
+        }
+
+        Tuple tuple;
+        while (child_->next(tuple)) {
+            evaluate_row(tuple);
+            aggregate_row(inputs_);
+        }
+        finish_pass();
+    } catch (const common::MemoryLimitError&) {
+        throw; /* Fails the statement, wherever in the plan */
+    } catch (const std::exception& e) {
+        set_error(std::string("Aggregate: ") + e.what());
+        return false;
+    }
+
+    set_state(ExecState::Open);
+    return true;
+}
+
+bool AggregateOperator::next_streaming(Tuple& out_tuple) {
+    const auto start_group = [this]() {
+        reset_pass();
+        stream_key_ = key_;
+        static_cast<void>(add_group(GroupKeyTable::hash_key(key_), inputs_));
+        stream_has_group_ = true;
+    };
+
+    try {
+        Tuple tuple;
+        while (!stream_done_) {
+            if (!child_->next(tuple)) {
+                stream_done_ = true;
+                break;
             }
-            if (state.maxes[i].is_null() || state.maxes[i] < val) {
-                state.maxes[i] = val;
+            evaluate_row(tuple);
+            encode_group_key(inputs_);
+            if (stream_has_group_ && key_ != stream_key_) {
+                out_tuple = finish_group(group_states_[0]);
+                start_group();
+                accumulate(0, inputs_);
+                return true;
             }
+            if (!stream_has_group_) start_group();
+            accumulate(0, inputs_);
+        }
+    } catch (const common::MemoryLimitError&) {
+        throw; /* Fails the statement, wherever in the plan */
+    } catch (const std::exception& e) {
+        set_error(std::string("Aggregate: ") + e.what());
+        return false;
+    }
+
+    if (stream_has_group_) {
+        stream_has_group_ = false;
+        out_tuple = finish_group(group_states_[0]);
+        return true;
+    }
+    set_state(ExecState::Done);
+    return false;
+}
+
+bool AggregateOperator::next_impl(Tuple& out_tuple) {
+    if (streaming()) {
+        return next_streaming(out_tuple);
+    }
+    while (current_group_ >= groups_.size()) {
+        /* In-memory groups are done; aggregate the next spilled partition */
+        bool more = false;
+        try {
+            more = run_pending_pass();
+        } catch (const common::MemoryLimitError&) {
+            throw; /* Fails the statement, wherever in the plan */
+        } catch (const std::exception& e) {
+            set_error(std::string("Aggregate: ") + e.what());
+            return false;
+        }
+        if (!more) {
+            set_state(ExecState::Done);
+            return false;
         }
     }
+    out_tuple = std::move(groups_[current_group_++]);
+    return true;
+}
 
+void AggregateOperator::close() {
     groups_.clear();
-    for (auto& pair : groups_map) {
-        auto& state = pair.second;
-        std::vector<common::Value> row = std::move(state.group_values);
-        for (size_t i = 0; i < aggregates_.size(); ++i) {
-            switch (aggregates_[i].type) {
-                case AggregateType::Count:
-                    row.push_back(common::Value::make_int64(state.counts[i]));
-                    break;
-                case AggregateType::Sum:
-                    row.push_back(common::Value::make_float64(state.sums[i]));
-                    break;
-                case AggregateType::Min:
-                    row.push_back(std::move(state.mins[i]));
-                    break;
-                case AggregateType::Max:
-                    row.push_back(std::move(state.maxes[i]));
-                    break;
-                case AggregateType::Avg:
-                    if (state.counts[i] > 0) {
-                        row.push_back(common::Value::make_float64(
-                            state.sums[i] / static_cast<double>(state.counts[i])));
-                    } else {
-                        row.push_back(common::Value::make_null());
-                    }
-                    break;
+    pending_.clear();
+    reset_pass();
+    child_->close();
+    set_state(ExecState::Done);
+}
+
+Schema& AggregateOperator::output_schema() {
+    return schema_;
+}
+
+void AggregateOperator::explain(ExplainNode& node) const {
+    if (group_by_.empty()) {
+        node.label = "Aggregate";
+    } else {
+        node.label = streaming() ? "GroupAggregate" : "HashAggregate";
+    }
+    if (options_.mode == AggregateMode::Partial) {
+        node.label = "Partial " + node.label;
+    } else if (options_.mode == AggregateMode::Final) {
+        node.label = "Finalize " + node.label;
+    }
+    node.stats = stats();
+    if (!group_by_.empty()) {
+        node.details.push_back("Group Key: " + expression_list(group_by_));
+    }
+    std::string aggs;
+    for (const auto& agg : aggregates_) {
+        if (!aggs.empty()) aggs += ", ";
+        aggs += std::string(aggregate_name(agg.type)) + "(" + (agg.is_distinct ? "DISTINCT " : "") +
+                (agg.expr ? agg.expr->to_string() : "*") + ")";
+    }
+    if (!aggs.empty()) {
+        node.details.push_back("Aggregates: " + aggs);
+    }
+    if (spilled_partitions_ > 0) {
+        node.details.push_back("Spilled Partitions: " + std::to_string(spilled_partitions_));
+    }
+    child_->explain(node.add_child());
+}
+
+/* --- BatchAggregateOperator --- */
+
+BatchAggregateOperator::BatchAggregateOperator(std::unique_ptr<VectorizedOperator> pipeline,
+                                               Schema schema,
+                                               std::vector<AggregateType> aggregate_types,
+                                               Transaction* txn)
+    : Operator(OperatorType::HashAggregate, txn),
+      pipeline_(std::move(pipeline)),
+      aggregate_types_(std::move(aggregate_types)),
+      schema_(std::move(schema)) {}
+
+bool BatchAggregateOperator::init() {
+    return pipeline_->init();
+}
+
+bool BatchAggregateOperator::open_impl() {
+    if (!pipeline_->open()) {
+        set_error(pipeline_->error());
+        return false;
+    }
+
+    const size_t key_count = schema_.column_count() - aggregate_types_.size();
+    std::vector<std::pair<std::string, Tuple>> rows;
+    auto batch = VectorBatch::create(pipeline_->output_schema());
+    while (pipeline_->next_batch(*batch)) {
+        for (size_t r = 0; r < batch->row_count(); ++r) {
+            std::string key;
+            std::vector<common::Value> row;
+            row.reserve(schema_.column_count());
+            for (size_t k = 0; k < key_count; ++k) {
+                row.push_back(batch->get_column(k).get(r));
+                key += row.back().to_string() + "|";
             }
+            for (size_t a = 0; a < aggregate_types_.size(); ++a) {
+                common::Value val = batch->get_column(key_count + a).get(r);
+                if (aggregate_types_[a] == AggregateType::Sum && val.is_null()) {
+                    val = common::Value::make_float64(0.0);
+                }
+                row.push_back(std::move(val));
+            }
+            rows.emplace_back(std::move(key), Tuple(std::move(row)));
         }
-        groups_.emplace_back(std::move(row));
+        batch->clear();
+    }
+    if (pipeline_->state() == ExecState::Error) {
+        set_error(pipeline_->error());
+        return false;
+    }
+
+    std::sort(rows.begin(), rows.end(),
+              [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    groups_.clear();
+    groups_.reserve(rows.size());
+    for (auto& row : rows) {
+        groups_.push_back(std::move(row.second));
     }
 
     current_group_ = 0;
@@ -560,7 +1589,7 @@ bool AggregateOperator::open() {
     return true;
 }
 
-bool AggregateOperator::next(Tuple& out_tuple) {
+bool BatchAggregateOperator::next_impl(Tuple& out_tuple) {
     if (current_group_ >= groups_.size()) {
         set_state(ExecState::Done);
         return false;
@@ -569,28 +1598,145 @@ bool AggregateOperator::next(Tuple& out_tuple) {
     return true;
 }
 
-void AggregateOperator::close() {
+void BatchAggregateOperator::close() {
     groups_.clear();
-    child_->close();
+    pipeline_->close();
     set_state(ExecState::Done);
 }
 
-Schema& AggregateOperator::output_schema() {
+Schema& BatchAggregateOperator::output_schema() {
     return schema_;
 }
 
+void BatchAggregateOperator::explain(ExplainNode& node) const {
+    node.label = "Batch Aggregate";
+    node.stats = stats();
+    pipeline_->explain(node.add_child());
+}
+
 /* --- HashJoinOperator --- */
 
+namespace {
+
+constexpr size_t INITIAL_JOIN_BUCKETS = 16;
+
+/* Partitions take the top bits of the key hash, buckets the low ones */
+constexpr unsigned PARTITION_SHIFT = 60;
+static_assert((uint64_t{1} << (64 - PARTITION_SHIFT)) == HashJoinOperator::SPILL_PARTITIONS,
+              "partition bits must cover SPILL_PARTITIONS");
+
+/* Smallest and one past the largest double that converts to int64_t */
+constexpr double INT64_LOWER = -9223372036854775808.0;
+constexpr double INT64_UPPER = 9223372036854775808.0;
+
+/**
+ * @brief Canonical form of a join key, so that keys equal under '=' are equal
+ * Values of the same type (and hash alike)
+ */
+common::Value normalize_join_key(const common::Value& key) {
+    switch (key.type()) {
+        case common::ValueType::TYPE_INT8:
+        case common::ValueType::TYPE_INT16:
+        case common::ValueType::TYPE_INT32:
+        case common::ValueType::TYPE_INT64:
+            return common::Value::make_int64(key.to_int64());
+        case common::ValueType::TYPE_FLOAT32:
+        case common::ValueType::TYPE_FLOAT64: {
+            const double value = key.to_float64();
+            if (std::trunc(value) == value && value >= INT64_LOWER && value < INT64_UPPER) {
+                return common::Value::make_int64(static_cast<int64_t>(value));
+            }
+            return common::Value::make_float64(value);
+        }
+        case common::ValueType::TYPE_CHAR:
+        case common::ValueType::TYPE_VARCHAR:
+        case common::ValueType::TYPE_TEXT:
+            return common::Value::make_text(key.text_view());
+        default:
+            return key;
+    }
+}
+
+uint64_t join_key_hash(const common::Value& key) {
+    return hashing::mix(common::Value::Hash{}(key));
+}
+
+size_t partition_of(uint64_t hash) {
+    return static_cast<size_t>(hash >> PARTITION_SHIFT);
+}
+
+}  // namespace
+
+std::atomic<size_t> HashJoinOperator::default_memory_budget_{DEFAULT_MEMORY_BUDGET};
+
+void HashJoinOperator::set_default_memory_budget(size_t bytes) {
+    default_memory_budget_.store(bytes, std::memory_order_relaxed);
+}
+
+size_t HashJoinOperator::default_memory_budget() {
+    return default_memory_budget_.load(std::memory_order_relaxed);
+}
+
+void HashJoinOperator::BuildTable::insert(Tuple tuple, common::Value key, uint64_t hash) {
+    if (entries.size() >= NO_MATCH - 1) {
+        throw std::runtime_error("join partition exceeds " + std::to_string(NO_MATCH - 1) +
+                                 " rows");
+    }
+    if (entries.size() >= heads.size()) {
+        /* Grow to keep at most one entry per bucket, relinking the chains */
+        heads.assign(std::max(INITIAL_JOIN_BUCKETS, heads.size() * 2), 0);
+        const size_t mask = heads.size() - 1;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            uint32_t& head = heads[entries[i].hash & mask];
+            entries[i].next = head;
+            head = static_cast<uint32_t>(i + 1);
+        }
+    }
+    uint32_t& head = heads[hash & (heads.size() - 1)];
+    entries.push_back(BuildEntry{std::move(tuple), std::move(key), hash, head, false});
+    head = static_cast<uint32_t>(entries.size());
+}
+
+uint32_t HashJoinOperator::BuildTable::find(const common::Value& key, uint64_t hash,
+                                            uint32_t link) const {
+    while (link != 0) {
+        const BuildEntry& entry = entries[link - 1];
+        if (entry.hash == hash && entry.key == key) return link - 1;
+        link = entry.next;
+    }
+    return NO_MATCH;
+}
+
+uint32_t HashJoinOperator::BuildTable::first_match(const common::Value& key,
+                                                   uint64_t hash) const {
+    if (heads.empty()) return NO_MATCH;
+    return find(key, hash, heads[hash & (heads.size() - 1)]);
+}
+
+uint32_t HashJoinOperator::BuildTable::next_match(uint32_t entry) const {
+    const BuildEntry& current = entries[entry];
+    return find(current.key, current.hash, current.next);
+}
+
+void HashJoinOperator::BuildTable::clear() {
+    std::vector<BuildEntry>().swap(entries);
+    std::vector<uint32_t>().swap(heads);
+    bytes = 0;
+}
+
 HashJoinOperator::HashJoinOperator(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right,
                                    std::unique_ptr<parser::Expression> left_key,
                                    std::unique_ptr<parser::Expression> right_key,
-                                   executor::JoinType join_type)
+                                   executor::JoinType join_type, size_t memory_budget,
+                                   bool build_left)
     : Operator(OperatorType::HashJoin, left->get_txn(), left->get_lock_manager()),
       left_(std::move(left)),
       right_(std::move(right)),
       left_key_(std::move(left_key)),
       right_key_(std::move(right_key)),
-      join_type_(join_type) {
+      join_type_(join_type),
+      memory_budget_(memory_budget != 0 ? memory_budget : default_memory_budget()),
+      build_left_(build_left) {
     /* Build resulting schema */
     if (left_ && right_) {
         for (const auto& col : left_->output_schema().columns()) {
@@ -608,123 +1754,293 @@ HashJoinOperator::HashJoinOperator(std::unique_ptr<Operator> left, std::unique_p
             schema_.add_column(col_meta);
         }
     }
+
+    /* From here on left_ is the probe side and right_ the build side */
+    if (build_left_) {
+        std::swap(left_, right_);
+        std::swap(left_key_, right_key_);
+        if (join_type_ == JoinType::Left) {
+            join_type_ = JoinType::Right;
+        } else if (join_type_ == JoinType::Right) {
+            join_type_ = JoinType::Left;
+        }
+    }
+}
+
+HashJoinOperator::~HashJoinOperator() = default;
+
+void HashJoinOperator::join_values(Tuple& out_tuple, const Tuple* probe,
+                                   const Tuple* build) const {
+    /* Built in place so the output buffer is reused from row to row */
+    auto& values = out_tuple.values();
+    values.clear();
+    const auto append = [&values](const Tuple* side, const Schema& schema) {
+        if (side != nullptr) {
+            values.insert(values.end(), side->values().begin(), side->values().end());
+        } else {
+            values.resize(values.size() + schema.column_count());
+        }
+    };
+    if (build_left_) {
+        append(build, right_->output_schema());
+        append(probe, left_->output_schema());
+    } else {
+        append(probe, left_->output_schema());
+        append(build, right_->output_schema());
+    }
+}
+
+bool HashJoinOperator::keeps_unmatched_build() const {
+    return join_type_ == JoinType::Right || join_type_ == JoinType::Full;
+}
+
+bool HashJoinOperator::keeps_unmatched_probe() const {
+    return join_type_ == JoinType::Left || join_type_ == JoinType::Full;
+}
+
+void HashJoinOperator::reset_state() {
+    partitions_.clear();
+    build_spill_.clear();
+    probe_spill_.clear();
+    memory_used_ = 0;
+    track_memory(0, "Hash Join");
+    replaying_ = false;
+    replay_partition_ = 0;
+    next_spilled_ = 0;
+    replay_table_.clear();
+    left_tuple_ = std::nullopt;
+    left_had_match_ = false;
+    probe_table_ = nullptr;
+    match_ = NO_MATCH;
+    probe_done_ = false;
+    unmatched_table_ = 0;
+    unmatched_entry_ = 0;
 }
 
 bool HashJoinOperator::init() {
     return left_->init() && right_->init();
 }
 
-bool HashJoinOperator::open() {
+bool HashJoinOperator::open_impl() {
     if (!left_->open() || !right_->open()) {
         return false;
     }
 
-    /* Build phase: scan right side into hash table */
-    hash_table_.clear();
-    Tuple right_tuple;
-    auto right_schema = right_->output_schema();
-    while (right_->next(right_tuple)) {
-        const common::Value key = right_key_->evaluate(&right_tuple, &right_schema);
-        hash_table_.emplace(key.to_string(), BuildTuple{std::move(right_tuple), false});
+    reset_state();
+    spilled_partitions_ = 0;
+    try {
+        left_key_compiled_ = std::make_unique<CompiledExpression>(*left_key_,
+                                                                  left_->output_schema());
+        right_key_compiled_ = std::make_unique<CompiledExpression>(*right_key_,
+                                                                   right_->output_schema());
+        partitions_.resize(SPILL_PARTITIONS);
+        build_spill_.resize(SPILL_PARTITIONS);
+        probe_spill_.resize(SPILL_PARTITIONS);
+
+        /* Build phase: hash the right side, spilling partitions past the budget */
+        Tuple right_tuple;
+        while (right_->next(right_tuple)) {
+            common::Value key = normalize_join_key(right_key_compiled_->evaluate(right_tuple));
+            if (key.is_null() && !keeps_unmatched_build()) continue;
+            const uint64_t hash = join_key_hash(key);
+            const size_t partition = partition_of(hash);
+            BuildTable& table = partitions_[partition];
+            if (table.spilled) {
+                build_spill_[partition]->write(right_tuple);
+                continue;
+            }
+            const size_t bytes =
+                tuple_bytes(right_tuple.values()) + sizeof(BuildEntry) + sizeof(uint32_t);
+            table.insert(std::move(right_tuple), std::move(key), hash);
+            table.bytes += bytes;
+            memory_used_ += bytes;
+            while (memory_used_ > memory_budget_ && spilled_partitions_ < SPILL_PARTITIONS) {
+                spill_largest_partition();
+            }
+            /* Past the query's limit too; with every partition spilled nothing is held */
+            while (!try_track_memory(memory_used_) && spilled_partitions_ < SPILL_PARTITIONS) {
+                spill_largest_partition();
+            }
+        }
+        push_build_filter();
+    } catch (const common::MemoryLimitError&) {
+        throw; /* Fails the statement, wherever in the plan */
+    } catch (const std::exception& e) {
+        set_error(std::string("HashJoin: ") + e.what());
+        return false;
     }
 
-    left_tuple_ = std::nullopt;
-    match_iter_ = std::nullopt;
-    left_had_match_ = false;
-    right_idx_iter_ = std::nullopt;
     set_state(ExecState::Open);
     return true;
 }
 
-bool HashJoinOperator::next(Tuple& out_tuple) {
-    auto left_schema = left_->output_schema();
-    auto right_schema = right_->output_schema();
+void HashJoinOperator::push_build_filter() {
+    runtime_filter_.reset();
+    if (keeps_unmatched_probe() || spilled_partitions_ > 0 ||
+        left_key_->type() != parser::ExprType::Column) {
+        return;
+    }
+    const size_t column = left_->output_schema().find_column(left_key_->to_string());
+    if (column == static_cast<size_t>(-1)) {
+        return;
+    }
+
+    size_t keys = 0;
+    for (const auto& table : partitions_) keys += table.entries.size();
+    auto filter = std::make_shared<RuntimeFilter>(keys);
+    for (const auto& table : partitions_) {
+        for (const auto& entry : table.entries) filter->add(entry.key);
+    }
+    if (left_->push_runtime_filter(filter, column)) {
+        runtime_filter_ = std::move(filter);
+    }
+}
+
+void HashJoinOperator::spill_largest_partition() {
+    size_t largest = SPILL_PARTITIONS;
+    for (size_t i = 0; i < partitions_.size(); ++i) {
+        if (!partitions_[i].spilled &&
+            (largest == SPILL_PARTITIONS || partitions_[i].bytes > partitions_[largest].bytes)) {
+            largest = i;
+        }
+    }
+    if (largest == SPILL_PARTITIONS) return;
+
+    BuildTable& table = partitions_[largest];
+    auto& file = build_spill_[largest];
+    file = std::make_unique<SpillFile>();
+    for (const auto& entry : table.entries) file->write(entry.tuple);
+    memory_used_ -= table.bytes;
+    table.clear();
+    table.spilled = true;
+    ++spilled_partitions_;
+}
 
+bool HashJoinOperator::next_probe_tuple() {
+    if (probe_done_) return false;
+    Tuple tuple;
     while (true) {
-        if (match_iter_.has_value()) {
-            auto& iter_state = match_iter_.value();
-            if (iter_state.current != iter_state.end) {
-                auto& build_tuple = iter_state.current->second;
-                const auto& right_tuple = build_tuple.tuple;
-                std::vector<common::Value> joined_values = left_tuple_->values();
-                joined_values.insert(joined_values.end(), right_tuple.values().begin(),
-                                     right_tuple.values().end());
-
-                out_tuple = Tuple(std::move(joined_values));
-                iter_state.current++;
-                left_had_match_ = true;
-                build_tuple.matched = true;
-                return true;
+        if (replaying_) {
+            SpillFile* file = probe_spill_[replay_partition_].get();
+            if (file == nullptr || !file->read(tuple)) {
+                probe_done_ = true;
+                return false;
             }
+        } else if (!left_->next(tuple)) {
+            probe_done_ = true;
+            return false;
+        }
 
-            /* No more matches for this left tuple. If (LEFT or FULL join) and no matches found,
-             * emit NULLs */
-            match_iter_ = std::nullopt;
-            if ((join_type_ == JoinType::Left || join_type_ == JoinType::Full) &&
-                !left_had_match_) {
-                std::vector<common::Value> joined_values = left_tuple_->values();
-                for (size_t i = 0; i < right_schema.column_count(); ++i) {
-                    joined_values.push_back(common::Value::make_null());
-                }
-                out_tuple = Tuple(std::move(joined_values));
-                left_tuple_ = std::nullopt;
-                return true;
-            }
-            left_tuple_ = std::nullopt;
-        }
-
-        /* Pull next tuple from left side */
-        Tuple next_left;
-        if (left_->next(next_left)) {
-            left_tuple_ = std::move(next_left);
-            left_had_match_ = false;
-            const common::Value key = left_key_->evaluate(&(left_tuple_.value()), &left_schema);
-
-            /* Look up in hash table */
-            auto range = hash_table_.equal_range(key.to_string());
-            if (range.first != range.second) {
-                match_iter_ = {range.first, range.second};
-            } else if (join_type_ == JoinType::Left || join_type_ == JoinType::Full) {
-                /* No match found immediately, emit NULLs if Left/Full join */
-                std::vector<common::Value> joined_values = left_tuple_->values();
-                for (size_t i = 0; i < right_schema.column_count(); ++i) {
-                    joined_values.push_back(common::Value::make_null());
-                }
-                out_tuple = Tuple(std::move(joined_values));
-                left_tuple_ = std::nullopt;
-                return true;
+        const common::Value key = normalize_join_key(left_key_compiled_->evaluate(tuple));
+        uint64_t hash = 0;
+        BuildTable* table = nullptr;
+        if (!key.is_null()) {
+            hash = join_key_hash(key);
+            const size_t partition = partition_of(hash);
+            if (replaying_) {
+                table = &replay_table_;
+            } else if (partitions_[partition].spilled) {
+                /* Joined once its build partition is loaded back */
+                auto& file = probe_spill_[partition];
+                if (!file) file = std::make_unique<SpillFile>();
+                file->write(tuple);
+                continue;
             } else {
-                /* Inner/Right join and no match, skip to next left tuple */
-                left_tuple_ = std::nullopt;
+                table = &partitions_[partition];
             }
-            continue;
         }
 
-        /* Probe phase done. For RIGHT or FULL joins, scan hash table for unmatched right tuples */
-        if (join_type_ == JoinType::Right || join_type_ == JoinType::Full) {
-            if (!right_idx_iter_.has_value()) {
-                right_idx_iter_ = hash_table_.begin();
+        left_tuple_ = std::move(tuple);
+        left_had_match_ = false;
+        probe_table_ = table;
+        match_ = table != nullptr ? table->first_match(key, hash) : NO_MATCH;
+        return true;
+    }
+}
+
+bool HashJoinOperator::next_unmatched_build(Tuple& out_tuple) {
+    if (!keeps_unmatched_build()) return false;
+    const size_t tables = replaying_ ? 1 : partitions_.size();
+    while (unmatched_table_ < tables) {
+        BuildTable& table = replaying_ ? replay_table_ : partitions_[unmatched_table_];
+        while (unmatched_entry_ < table.entries.size()) {
+            BuildEntry& entry = table.entries[unmatched_entry_++];
+            if (!entry.matched) {
+                join_values(out_tuple, nullptr, &entry.tuple);
+                entry.matched = true; /* Mark as emitted */
+                return true;
             }
+        }
+        ++unmatched_table_;
+        unmatched_entry_ = 0;
+    }
+    return false;
+}
+
+bool HashJoinOperator::load_next_spilled() {
+    while (next_spilled_ < partitions_.size() && !partitions_[next_spilled_].spilled) {
+        ++next_spilled_;
+    }
+    if (replaying_) probe_spill_[replay_partition_].reset();
+    if (next_spilled_ == partitions_.size()) return false;
+
+    replaying_ = true;
+    replay_partition_ = next_spilled_++;
+    replay_table_.clear();
+    auto& build = build_spill_[replay_partition_];
+    build->rewind();
+    Tuple tuple;
+    size_t bytes = 0;
+    while (build->read(tuple)) {
+        common::Value key = normalize_join_key(right_key_compiled_->evaluate(tuple));
+        const uint64_t hash = join_key_hash(key);
+        bytes += tuple_bytes(tuple.values()) + sizeof(BuildEntry) + sizeof(uint32_t);
+        track_memory(memory_used_ + bytes, "Hash Join");
+        replay_table_.insert(std::move(tuple), std::move(key), hash);
+    }
+    build.reset();
+    if (probe_spill_[replay_partition_]) probe_spill_[replay_partition_]->rewind();
 
-            auto& it = right_idx_iter_.value();
-            while (it != hash_table_.end()) {
-                if (!it->second.matched) {
-                    std::vector<common::Value> joined_values;
-                    for (size_t i = 0; i < left_schema.column_count(); ++i) {
-                        joined_values.push_back(common::Value::make_null());
-                    }
-                    joined_values.insert(joined_values.end(), it->second.tuple.values().begin(),
-                                         it->second.tuple.values().end());
-                    out_tuple = Tuple(std::move(joined_values));
-                    it->second.matched = true; /* Mark as emitted */
-                    it++;
+    probe_done_ = false;
+    unmatched_table_ = 0;
+    unmatched_entry_ = 0;
+    return true;
+}
+
+bool HashJoinOperator::next_impl(Tuple& out_tuple) {
+    try {
+        while (true) {
+            if (left_tuple_.has_value()) {
+                if (match_ != NO_MATCH) {
+                    BuildEntry& entry = probe_table_->entries[match_];
+                    join_values(out_tuple, &*left_tuple_, &entry.tuple);
+                    entry.matched = true;
+                    left_had_match_ = true;
+                    match_ = probe_table_->next_match(match_);
                     return true;
                 }
-                it++;
+
+                /* No more matches for this left tuple; LEFT and FULL joins pad it with NULLs */
+                const bool pad = keeps_unmatched_probe() && !left_had_match_;
+                if (pad) join_values(out_tuple, &*left_tuple_, nullptr);
+                left_tuple_ = std::nullopt;
+                if (pad) return true;
             }
-        }
 
-        set_state(ExecState::Done);
+            if (next_probe_tuple()) continue;
+
+            /* Probe input done. For RIGHT or FULL joins, emit the unmatched right tuples */
+            if (next_unmatched_build(out_tuple)) return true;
+
+            if (!load_next_spilled()) {
+                set_state(ExecState::Done);
+                return false;
+            }
+        }
+    } catch (const common::MemoryLimitError&) {
+        throw; /* Fails the statement, wherever in the plan */
+    } catch (const std::exception& e) {
+        set_error(std::string("HashJoin: ") + e.what());
         return false;
     }
 }
@@ -732,9 +2048,7 @@ bool HashJoinOperator::next(Tuple& out_tuple) {
 void HashJoinOperator::close() {
     left_->close();
     right_->close();
-    hash_table_.clear();
-    match_iter_ = std::nullopt;
-    left_tuple_ = std::nullopt;
+    reset_state();
     set_state(ExecState::Done);
 }
 
@@ -742,6 +2056,23 @@ Schema& HashJoinOperator::output_schema() {
     return schema_;
 }
 
+void HashJoinOperator::explain(ExplainNode& node) const {
+    node.label = std::string("Hash ") + join_type_name(join_type_) + " Join";
+    node.stats = stats();
+    node.details.push_back("Hash Cond: " + left_key_->to_string() + " = " +
+                           right_key_->to_string());
+    if (spilled_partitions_ > 0) {
+        node.details.push_back("Spilled Partitions: " + std::to_string(spilled_partitions_));
+    }
+    if (runtime_filter_) {
+        node.details.push_back("Runtime Filter: " + left_key_->to_string() + " (" +
+                               std::to_string(runtime_filter_->key_count()) + " keys)");
+    }
+    /* Probe side first, then the side the table is built on */
+    left_->explain(node.add_child());
+    right_->explain(node.add_child());
+}
+
 void HashJoinOperator::add_child(std::unique_ptr<Operator> child) {
     if (!left_) {
         left_ = std::move(child);
@@ -750,6 +2081,21 @@ void HashJoinOperator::add_child(std::unique_ptr<Operator> child) {
     }
 }
 
+bool HashJoinOperator::push_runtime_filter(std::shared_ptr<const RuntimeFilter> filter,
+                                           size_t column) {
+    /*
+     * A column of the probe side carries the probe row's own value in every
+     * output row, so dropping that row early only drops rows the filter would
+     * have. Build rows are already in the table.
+     */
+    const size_t probe_columns = left_->output_schema().column_count();
+    const size_t offset = build_left_ ? right_->output_schema().column_count() : 0;
+    if (column < offset || column >= offset + probe_columns) {
+        return false;
+    }
+    return left_->push_runtime_filter(std::move(filter), column - offset);
+}
+
 /* --- LimitOperator --- */
 
 LimitOperator::LimitOperator(std::unique_ptr<Operator> child, int64_t limit, int64_t offset)
@@ -762,7 +2108,7 @@ bool LimitOperator::init() {
     return child_->init();
 }
 
-bool LimitOperator::open() {
+bool LimitOperator::open_impl() {
     if (!child_->open()) {
         return false;
     }
@@ -772,7 +2118,7 @@ bool LimitOperator::open() {
     return true;
 }
 
-bool LimitOperator::next(Tuple& out_tuple) {
+bool LimitOperator::next_impl(Tuple& out_tuple) {
     while (current_offset_ < static_cast<uint64_t>(offset_)) {
         Tuple t;
         if (!child_->next(t)) {
@@ -805,6 +2151,14 @@ Schema& LimitOperator::output_schema() {
     return child_->output_schema();
 }
 
+void LimitOperator::explain(ExplainNode& node) const {
+    node.label = "Limit";
+    node.stats = stats();
+    node.details.push_back("Limit: " + std::to_string(limit_) +
+                           (offset_ > 0 ? " Offset: " + std::to_string(offset_) : ""));
+    child_->explain(node.add_child());
+}
+
 void LimitOperator::add_child(std::unique_ptr<Operator> child) {
     child_ = std::move(child);
 }
@@ -0,0 +1,50 @@
+/**
+ * @file parallel_scan.cpp
+ * @brief Parallel heap scan page dispenser implementation
+ */
+
+#include "executor/parallel_scan.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "storage/heap_table.hpp"
+
+namespace cloudsql::executor {
+
+std::atomic<size_t> ParallelHeapScan::max_workers_{0};
+
+ParallelHeapScan::ParallelHeapScan(uint32_t page_count, uint32_t pages_per_range)
+    : page_count_(page_count),
+      pages_per_range_(std::max<uint32_t>(pages_per_range, 1)),
+      range_count_(std::max<uint32_t>((page_count + pages_per_range_ - 1) / pages_per_range_, 1)) {}
+
+bool ParallelHeapScan::next_range(storage::HeapTable::PageRange& range) {
+    const uint32_t index = next_.fetch_add(1, std::memory_order_relaxed);
+    if (index >= range_count_) {
+        return false;
+    }
+    range.first = index * pages_per_range_;
+    range.end = index + 1 == range_count_ ? storage::HeapTable::PageRange::TO_END
+                                          : range.first + pages_per_range_;
+    return true;
+}
+
+void ParallelHeapScan::set_max_workers(size_t workers) {
+    max_workers_.store(workers, std::memory_order_relaxed);
+}
+
+size_t ParallelHeapScan::max_workers() {
+    const size_t configured = max_workers_.load(std::memory_order_relaxed);
+    if (configured != 0) return configured;
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+size_t ParallelHeapScan::plan_workers(uint32_t pages) {
+    return std::max<size_t>(std::min<size_t>(max_workers(), pages / PAGES_PER_WORKER), 1);
+}
+
+}  // namespace cloudsql::executor
@@ -0,0 +1,88 @@
+/**
+ * @file plan_cache.cpp
+ * @brief Prepared statement cache
+ */
+
+#include "executor/plan_cache.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "parser/lexer.hpp"
+#include "parser/parser.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+std::string cache_key(const std::string& sql, const std::vector<uint32_t>& parameter_types) {
+    std::string key = sql;
+    key.push_back('\0');
+    const size_t offset = key.size();
+    key.resize(offset + parameter_types.size() * sizeof(uint32_t));
+    if (!parameter_types.empty()) {
+        std::memcpy(key.data() + offset, parameter_types.data(),
+                    parameter_types.size() * sizeof(uint32_t));
+    }
+    return key;
+}
+
+}  // namespace
+
+void PreparedStatement::bind(const std::vector<common::Value>& values) const {
+    for (size_t i = 0; i < parameters.size(); ++i) {
+        *parameters[i] = i < values.size() ? values[i] : common::Value::make_null();
+    }
+}
+
+std::shared_ptr<const PreparedStatement> PlanCache::prepare(
+    const std::string& sql, const std::vector<uint32_t>& parameter_types) {
+    const uint64_t version = catalog_.get_version();
+    std::string key = cache_key(sql, parameter_types);
+
+    const auto found = index_.find(key);
+    if (found != index_.end()) {
+        if (found->second->second->catalog_version == version) {
+            ++hits_;
+            entries_.splice(entries_.begin(), entries_, found->second);
+            return found->second->second;
+        }
+        entries_.erase(found->second);
+        index_.erase(found);
+    }
+    ++misses_;
+
+    parser::Parser parser(std::make_unique<parser::Lexer>(sql));
+    auto statement = parser.parse_statement();
+    if (!statement) {
+        return nullptr;
+    }
+    auto prepared = std::make_shared<PreparedStatement>();
+    prepared->sql = sql;
+    prepared->parameter_types = parameter_types;
+    prepared->statement = std::move(statement);
+    prepared->parameters = parser.parameters();
+    prepared->catalog_version = version;
+
+    if (capacity_ == 0) {
+        return prepared;
+    }
+    if (entries_.size() >= capacity_) {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+    entries_.emplace_front(key, prepared);
+    index_.emplace(std::move(key), entries_.begin());
+    return prepared;
+}
+
+void PlanCache::clear() {
+    entries_.clear();
+    index_.clear();
+}
+
+}  // namespace cloudsql::executor
@@ -6,25 +6,42 @@
 #include "executor/query_executor.hpp"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cctype>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <exception>
+#include <functional>
 #include <iostream>
+#include <istream>
 #include <memory>
+#include <optional>
+#include <ostream>
 #include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "catalog/catalog.hpp"
+#include "common/arena.hpp"
 #include "common/cluster_manager.hpp"
+#include "common/latency_histogram.hpp"
+#include "common/metrics.hpp"
+#include "common/trace.hpp"
 #include "common/value.hpp"
 #include "distributed/raft_group.hpp"
 #include "distributed/raft_manager.hpp"
 #include "distributed/shard_manager.hpp"
+#include "executor/copy_decoder.hpp"
+#include "executor/cost_model.hpp"
+#include "executor/explain.hpp"
+#include "executor/index_build.hpp"
 #include "executor/operator.hpp"
+#include "executor/parallel_scan.hpp"
+#include "executor/statistics.hpp"
+#include "executor/table_handles.hpp"
 #include "executor/types.hpp"
 #include "network/rpc_message.hpp"
 #include "parser/expression.hpp"
@@ -32,22 +49,32 @@
 #include "parser/token.hpp"
 #include "recovery/log_manager.hpp"
 #include "recovery/log_record.hpp"
+#include "storage/brin_index.hpp"
 #include "storage/btree_index.hpp"
 #include "storage/buffer_pool_manager.hpp"
 #include "storage/heap_table.hpp"
+#include "storage/page_map.hpp"
+#include "storage/storage_manager.hpp"
 #include "transaction/lock_manager.hpp"
 #include "transaction/transaction.hpp"
 #include "transaction/transaction_manager.hpp"
+#include "transaction/vacuum_manager.hpp"
 
 namespace cloudsql::executor {
 
 namespace {
 enum class IndexOp { Insert, Remove };
 
+/* Rows INSERT and COPY write to the heap and indexes at a time */
+constexpr size_t INSERT_BATCH_ROWS = 1024;
+
+/* A shuffle stream that goes this long without a chunk fails the query */
+constexpr std::chrono::milliseconds EXCHANGE_IDLE_TIMEOUT{30000};
+
 /**
  * @brief Helper to perform index writes and check for success
  */
-bool apply_index_write(storage::BTreeIndex& index, const common::Value& key,
+bool apply_index_write(storage::Index& index, const common::Value& key,
                        const storage::HeapTable::TupleId& rid, IndexOp op, std::string& error_msg) {
     bool success = false;
     if (op == IndexOp::Insert) {
@@ -62,6 +89,666 @@ bool apply_index_write(storage::BTreeIndex& index, const common::Value& key,
     }
     return true;
 }
+
+bool is_vectorizable_type(common::ValueType type) {
+    switch (type) {
+        case common::ValueType::TYPE_INT8:
+        case common::ValueType::TYPE_INT16:
+        case common::ValueType::TYPE_INT32:
+        case common::ValueType::TYPE_INT64:
+        case common::ValueType::TYPE_FLOAT32:
+        case common::ValueType::TYPE_FLOAT64:
+        case common::ValueType::TYPE_BOOL:
+        case common::ValueType::TYPE_CHAR:
+        case common::ValueType::TYPE_VARCHAR:
+        case common::ValueType::TYPE_TEXT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Resolve a plain column reference against a scan schema
+ * @return The column index, or -1 if `expr` is not a column of the schema
+ */
+size_t resolve_scan_column(const parser::Expression& expr, const Schema& schema) {
+    if (expr.type() != parser::ExprType::Column) {
+        return static_cast<size_t>(-1);
+    }
+    const auto& column = static_cast<const parser::ColumnExpr&>(expr);
+    size_t index = schema.find_column(column.to_string());
+    if (index == static_cast<size_t>(-1) && column.has_table()) {
+        index = schema.find_column(column.name());
+    }
+    return index;
+}
+
+/**
+ * @brief Plan an aggregate over a table scan as a vectorized filter and hash aggregate
+ *
+ * `scan` is a vectorized heap scan, or a scan of the table's columnar replica;
+ * either has the table's columns, qualified with its name. Only plain column
+ * references can be grouped on or aggregated.
+ * @return The plan, or nullptr if the query needs the row-based AggregateOperator
+ */
+std::unique_ptr<Operator> plan_batch_aggregate(const parser::SelectStatement& stmt,
+                                               std::unique_ptr<VectorizedOperator> scan,
+                                               const std::vector<AggregateInfo>& aggs,
+                                               transaction::Transaction* txn) {
+    const Schema& input = scan->output_schema();
+    for (const auto& col : input.columns()) {
+        if (!is_vectorizable_type(col.type())) {
+            return nullptr;
+        }
+    }
+
+    Schema row_schema;
+    Schema batch_schema;
+    std::vector<size_t> group_by;
+    for (const auto& gb : stmt.group_by()) {
+        const size_t index = resolve_scan_column(*gb, input);
+        if (index == static_cast<size_t>(-1)) {
+            return nullptr;
+        }
+        group_by.push_back(index);
+        row_schema.add_column(gb->to_string(), common::ValueType::TYPE_TEXT);
+        batch_schema.add_column(gb->to_string(), input.get_column(index).type());
+    }
+
+    std::vector<VectorizedAggregateInfo> batch_aggs;
+    std::vector<AggregateType> types;
+    for (const auto& agg : aggs) {
+        int32_t input_col = -1;
+        common::ValueType result_type = common::ValueType::TYPE_FLOAT64;
+        if (agg.expr) {
+            const size_t index = resolve_scan_column(*agg.expr, input);
+            if (index == static_cast<size_t>(-1)) {
+                return nullptr;
+            }
+            const common::ValueType type = input.get_column(index).type();
+            const bool numeric = type != common::ValueType::TYPE_BOOL &&
+                                 type != common::ValueType::TYPE_CHAR &&
+                                 type != common::ValueType::TYPE_VARCHAR &&
+                                 type != common::ValueType::TYPE_TEXT;
+            if (((agg.type == AggregateType::Sum || agg.type == AggregateType::Avg) &&
+                 !numeric) ||
+                ((agg.type == AggregateType::Min || agg.type == AggregateType::Max) &&
+                 type == common::ValueType::TYPE_BOOL)) {
+                return nullptr;
+            }
+            input_col = static_cast<int32_t>(index);
+            if (agg.type == AggregateType::Min || agg.type == AggregateType::Max) {
+                result_type = type;
+            }
+        } else if (agg.type != AggregateType::Count) {
+            return nullptr;
+        }
+        if (agg.type == AggregateType::Count) {
+            result_type = common::ValueType::TYPE_INT64;
+        }
+
+        const common::ValueType row_type = agg.type == AggregateType::Count
+                                               ? common::ValueType::TYPE_INT64
+                                               : common::ValueType::TYPE_FLOAT64;
+        row_schema.add_column(agg.name, row_type);
+        batch_schema.add_column(agg.name, result_type);
+        batch_aggs.push_back({agg.type, input_col, agg.is_distinct});
+        types.push_back(agg.type);
+    }
+
+    std::unique_ptr<VectorizedOperator> pipeline = std::move(scan);
+    if (stmt.where()) {
+        pipeline =
+            std::make_unique<VectorizedFilterOperator>(std::move(pipeline), stmt.where()->clone());
+    }
+    pipeline = std::make_unique<VectorizedHashAggregateOperator>(
+        std::move(pipeline), std::move(group_by), std::move(batch_schema), std::move(batch_aggs));
+    return std::make_unique<BatchAggregateOperator>(std::move(pipeline), std::move(row_schema),
+                                                    std::move(types), txn);
+}
+
+/**
+ * @return Whether `expr` is a reference to `column` of `table`, qualified or not
+ */
+bool is_column_ref(const parser::Expression& expr, const std::string& table,
+                   const std::string& column) {
+    if (expr.type() != parser::ExprType::Column) {
+        return false;
+    }
+    const auto& ref = static_cast<const parser::ColumnExpr&>(expr);
+    return ref.name() == column && (!ref.has_table() || ref.table_name() == table);
+}
+
+/* Values an index range can be built from; bounds must be in the same class as the column */
+enum class RangeClass : uint8_t { None, Number, Text };
+
+RangeClass range_class(common::ValueType type) {
+    switch (type) {
+        case common::ValueType::TYPE_INT8:
+        case common::ValueType::TYPE_INT16:
+        case common::ValueType::TYPE_INT32:
+        case common::ValueType::TYPE_INT64:
+        case common::ValueType::TYPE_FLOAT32:
+        case common::ValueType::TYPE_FLOAT64:
+            return RangeClass::Number;
+        case common::ValueType::TYPE_CHAR:
+        case common::ValueType::TYPE_VARCHAR:
+        case common::ValueType::TYPE_TEXT:
+            return RangeClass::Text;
+        default:
+            return RangeClass::None;
+    }
+}
+
+/**
+ * @brief Key range of one column implied by a WHERE clause
+ */
+struct KeyRange {
+    std::optional<storage::BTreeIndex::Bound> lower;
+    std::optional<storage::BTreeIndex::Bound> upper;
+    bool equality = false; /**< Some conjunct fixes the column to one value */
+
+    [[nodiscard]] bool bounded() const { return lower.has_value() || upper.has_value(); }
+
+    /** @return true if the range is a single key, the only kind a hash index answers */
+    [[nodiscard]] bool point() const {
+        return equality && lower && upper && lower->inclusive && upper->inclusive &&
+               lower->key == upper->key;
+    }
+
+    void tighten_lower(const common::Value& key, bool inclusive) {
+        if (!lower || lower->key < key) {
+            lower = storage::BTreeIndex::Bound{key, inclusive};
+        } else if (!(key < lower->key)) {
+            lower->inclusive = lower->inclusive && inclusive;
+        }
+    }
+
+    void tighten_upper(const common::Value& key, bool inclusive) {
+        if (!upper || key < upper->key) {
+            upper = storage::BTreeIndex::Bound{key, inclusive};
+        } else if (!(upper->key < key)) {
+            upper->inclusive = upper->inclusive && inclusive;
+        }
+    }
+};
+
+/**
+ * @brief Collect bounds on `column` from the top-level AND conjuncts of `expr`
+ *
+ * Only comparisons between the column and a constant of the column's class
+ * count. The range may be wider than the condition; the planner still filters
+ * the rows with the full WHERE clause.
+ */
+void collect_key_range(const parser::Expression& expr, const std::string& table,  // NOLINT
+                       const std::string& column, common::ValueType column_type,
+                       KeyRange& range) {
+    if (expr.type() != parser::ExprType::Binary) {
+        return;
+    }
+    const auto& bin = static_cast<const parser::BinaryExpr&>(expr);
+    if (bin.op() == parser::TokenType::And) {
+        collect_key_range(bin.left(), table, column, column_type, range);
+        collect_key_range(bin.right(), table, column, column_type, range);
+        return;
+    }
+
+    parser::TokenType op = bin.op();
+    const parser::Expression* constant = nullptr;
+    if (is_column_ref(bin.left(), table, column) &&
+        bin.right().type() == parser::ExprType::Constant) {
+        constant = &bin.right();
+    } else if (is_column_ref(bin.right(), table, column) &&
+               bin.left().type() == parser::ExprType::Constant) {
+        /* 5 < x is x > 5 */
+        constant = &bin.left();
+        if (op == parser::TokenType::Lt) {
+            op = parser::TokenType::Gt;
+        } else if (op == parser::TokenType::Le) {
+            op = parser::TokenType::Ge;
+        } else if (op == parser::TokenType::Gt) {
+            op = parser::TokenType::Lt;
+        } else if (op == parser::TokenType::Ge) {
+            op = parser::TokenType::Le;
+        }
+    }
+    if (constant == nullptr) {
+        return;
+    }
+    const common::Value& key = static_cast<const parser::ConstantExpr*>(constant)->value();
+    const RangeClass cls = range_class(column_type);
+    if (cls == RangeClass::None || range_class(key.type()) != cls) {
+        return;
+    }
+
+    switch (op) {
+        case parser::TokenType::Eq:
+            range.tighten_lower(key, true);
+            range.tighten_upper(key, true);
+            range.equality = true;
+            break;
+        case parser::TokenType::Lt:
+            range.tighten_upper(key, false);
+            break;
+        case parser::TokenType::Le:
+            range.tighten_upper(key, true);
+            break;
+        case parser::TokenType::Gt:
+            range.tighten_lower(key, false);
+            break;
+        case parser::TokenType::Ge:
+            range.tighten_lower(key, true);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @return Estimated fraction of the rows a key range on a column keeps
+ */
+/**
+ * @return Preference among indexes of an unanalyzed table: an equality before a
+ * range, a hash index before a B-tree, and a BRIN index only when nothing else fits
+ */
+int unanalyzed_rank(const IndexInfo& index, const KeyRange& range) {
+    if (index.index_type == IndexType::BRIN) {
+        return 0;
+    }
+    if (!range.equality) {
+        return 1;
+    }
+    return index.index_type == IndexType::Hash ? 3 : 2;
+}
+
+double key_range_selectivity(const ColumnStats& stats, const KeyRange& range) {
+    if (range.equality && range.lower && range.upper && range.lower->key == range.upper->key) {
+        return cost::equality_selectivity(stats, range.lower->key);
+    }
+    return cost::range_selectivity(stats, range.lower, range.upper);
+}
+
+/**
+ * @return Cost of a bitmap heap scan over the pages a BRIN index selects for
+ * `range`, found from the summaries themselves; they are a few pages at most
+ */
+double brin_scan_cost(storage::BufferPoolManager& bpm, const IndexInfo& info,
+                      common::ValueType key_type, const KeyRange& range, const TableStats& stats) {
+    storage::BrinIndex index(info.name, bpm, key_type);
+    double pages = 0.0;
+    double runs = 0.0;
+    for (const auto& pages_range : index.matching_ranges(range.lower, range.upper)) {
+        const uint64_t end = std::min<uint64_t>(pages_range.end, stats.page_count);
+        if (end > pages_range.first) {
+            pages += static_cast<double>(end - pages_range.first);
+            runs += 1.0;
+        }
+    }
+    return cost::bitmap_heap_scan_cost(stats, pages, runs);
+}
+
+/**
+ * @return Estimated rows of an analyzed table passing the comparisons of its
+ * columns with constants in `where`; other conditions are not counted
+ */
+double estimate_rows(const TableInfo& table, const parser::Expression* where) {
+    const TableStats& stats = *table.stats;
+    double selectivity = 1.0;
+    if (where != nullptr) {
+        for (const auto& col : table.columns) {
+            if (col.position >= stats.columns.size()) continue;
+            KeyRange range;
+            collect_key_range(*where, table.name, col.name, col.type, range);
+            if (range.bounded()) {
+                selectivity *= key_range_selectivity(stats.columns[col.position], range);
+            }
+        }
+    }
+    return std::max(1.0, selectivity * static_cast<double>(stats.row_count));
+}
+
+/**
+ * @brief Tables of a join query and the equality predicates between them
+ */
+struct JoinGraph {
+    std::vector<const TableInfo*> tables; /**< 0: the FROM table; i + 1: joins()[i] */
+    std::vector<double> rows;             /**< Estimated rows after single-table filters */
+    std::vector<cost::JoinEdge> edges;    /**< edges[i] is the condition of joins()[i] */
+};
+
+/**
+ * @brief Finds the table of `graph` a column reference belongs to
+ * @return false if the column cannot be placed in exactly one table
+ */
+bool resolve_join_column(const JoinGraph& graph, const parser::Expression& expr, size_t* table,
+                         uint16_t* position) {
+    if (expr.type() != parser::ExprType::Column) {
+        return false;
+    }
+    const auto& ref = static_cast<const parser::ColumnExpr&>(expr);
+    bool found = false;
+    for (size_t i = 0; i < graph.tables.size(); ++i) {
+        if (ref.has_table() && ref.table_name() != graph.tables[i]->name) continue;
+        for (const auto& col : graph.tables[i]->columns) {
+            if (col.name != ref.name()) continue;
+            if (found) return false;
+            found = true;
+            *table = i;
+            *position = col.position;
+        }
+    }
+    return found;
+}
+
+/**
+ * @return The join graph of `stmt`, or nullopt unless every table is analyzed
+ * and every join condition is one equality between columns of two tables
+ */
+std::optional<JoinGraph> build_join_graph(const parser::SelectStatement& stmt,
+                                          Catalog& catalog) {
+    JoinGraph graph;
+    std::vector<std::string> names = {stmt.from()->to_string()};
+    for (const auto& join : stmt.joins()) names.push_back(join.table->to_string());
+    for (const auto& name : names) {
+        const auto meta = catalog.get_table_by_name(name);
+        if (!meta.has_value() || !(*meta)->stats.has_value()) return std::nullopt;
+        /* A table joined twice is ambiguous without aliases */
+        if (std::find(graph.tables.begin(), graph.tables.end(), *meta) != graph.tables.end()) {
+            return std::nullopt;
+        }
+        graph.tables.push_back(*meta);
+        graph.rows.push_back(estimate_rows(**meta, stmt.where()));
+    }
+
+    for (const auto& join : stmt.joins()) {
+        if (!join.condition || join.condition->type() != parser::ExprType::Binary) {
+            return std::nullopt;
+        }
+        const auto& cond = static_cast<const parser::BinaryExpr&>(*join.condition);
+        size_t left = 0;
+        size_t right = 0;
+        uint16_t left_pos = 0;
+        uint16_t right_pos = 0;
+        if (cond.op() != parser::TokenType::Eq ||
+            !resolve_join_column(graph, cond.left(), &left, &left_pos) ||
+            !resolve_join_column(graph, cond.right(), &right, &right_pos) || left == right) {
+            return std::nullopt;
+        }
+        const auto& left_stats = graph.tables[left]->stats->columns;
+        const auto& right_stats = graph.tables[right]->stats->columns;
+        if (left_pos >= left_stats.size() || right_pos >= right_stats.size()) {
+            return std::nullopt;
+        }
+        graph.edges.push_back(
+            {left, right, cost::join_selectivity(left_stats[left_pos], right_stats[right_pos])});
+    }
+    return graph;
+}
+
+/**
+ * @brief Splits an equality join condition into the key of each input
+ * @return false unless one side reads only `left` and the other only `right`
+ */
+bool split_join_keys(const parser::Expression& condition, const Schema& left, const Schema& right,
+                     std::unique_ptr<parser::Expression>* left_key,
+                     std::unique_ptr<parser::Expression>* right_key) {
+    if (condition.type() != parser::ExprType::Binary) {
+        return false;
+    }
+    const auto& bin_expr = static_cast<const parser::BinaryExpr&>(condition);
+    if (bin_expr.op() != parser::TokenType::Eq) {
+        return false;
+    }
+    /* Check which side of Eq belongs to which table */
+    const std::string left_col_name = bin_expr.left().to_string();
+    const std::string right_col_name = bin_expr.right().to_string();
+    const auto in = [](const Schema& schema, const std::string& name) {
+        return schema.find_column(name) != static_cast<size_t>(-1);
+    };
+    if (in(left, left_col_name) && in(right, right_col_name)) {
+        *left_key = bin_expr.left().clone();
+        *right_key = bin_expr.right().clone();
+        return true;
+    }
+    if (in(right, left_col_name) && in(left, right_col_name)) {
+        *left_key = bin_expr.right().clone();
+        *right_key = bin_expr.left().clone();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @return Whether evaluating `expr` reads no column but `column` of `table`
+ */
+bool reads_only_column(const parser::Expression& expr, const std::string& table,  // NOLINT
+                       const std::string& column) {
+    switch (expr.type()) {
+        case parser::ExprType::Column:
+            return is_column_ref(expr, table, column);
+        case parser::ExprType::Constant:
+            return true;
+        case parser::ExprType::Binary: {
+            const auto& bin = static_cast<const parser::BinaryExpr&>(expr);
+            return reads_only_column(bin.left(), table, column) &&
+                   reads_only_column(bin.right(), table, column);
+        }
+        case parser::ExprType::Unary:
+            return reads_only_column(static_cast<const parser::UnaryExpr&>(expr).expr(), table,
+                                     column);
+        case parser::ExprType::Function:
+            /* COUNT(*) reads no column: the parser hands '*' over as a column */
+            return std::all_of(static_cast<const parser::FunctionExpr&>(expr).args().begin(),
+                               static_cast<const parser::FunctionExpr&>(expr).args().end(),
+                               [&](const std::unique_ptr<parser::Expression>& arg) {
+                                   return (arg->type() == parser::ExprType::Column &&
+                                           arg->to_string() == "*") ||
+                                          reads_only_column(*arg, table, column);
+                               });
+        case parser::ExprType::In: {
+            const auto& in = static_cast<const parser::InExpr&>(expr);
+            return reads_only_column(in.column(), table, column) &&
+                   std::all_of(in.values().begin(), in.values().end(),
+                               [&](const std::unique_ptr<parser::Expression>& value) {
+                                   return reads_only_column(*value, table, column);
+                               });
+        }
+        case parser::ExprType::IsNull:
+            return reads_only_column(static_cast<const parser::IsNullExpr&>(expr).expr(), table,
+                                     column);
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Mark in `needed` the columns of `table` that `expr` reads
+ * @return false if the columns cannot be told apart (`*`, unknown expressions)
+ */
+bool collect_read_columns(const parser::Expression& expr, const std::string& table,  // NOLINT
+                          const std::vector<ColumnInfo>& columns, std::vector<bool>& needed) {
+    switch (expr.type()) {
+        case parser::ExprType::Column: {
+            if (expr.to_string() == "*") {
+                return false;
+            }
+            for (size_t i = 0; i < columns.size(); ++i) {
+                if (is_column_ref(expr, table, columns[i].name)) {
+                    needed[i] = true;
+                }
+            }
+            return true;
+        }
+        case parser::ExprType::Constant:
+            return true;
+        case parser::ExprType::Binary: {
+            const auto& bin = static_cast<const parser::BinaryExpr&>(expr);
+            return collect_read_columns(bin.left(), table, columns, needed) &&
+                   collect_read_columns(bin.right(), table, columns, needed);
+        }
+        case parser::ExprType::Unary:
+            return collect_read_columns(static_cast<const parser::UnaryExpr&>(expr).expr(), table,
+                                        columns, needed);
+        case parser::ExprType::Function:
+            /* COUNT(*) reads no column: the parser hands '*' over as a column */
+            return std::all_of(static_cast<const parser::FunctionExpr&>(expr).args().begin(),
+                               static_cast<const parser::FunctionExpr&>(expr).args().end(),
+                               [&](const std::unique_ptr<parser::Expression>& arg) {
+                                   return (arg->type() == parser::ExprType::Column &&
+                                           arg->to_string() == "*") ||
+                                          collect_read_columns(*arg, table, columns, needed);
+                               });
+        case parser::ExprType::In: {
+            const auto& in = static_cast<const parser::InExpr&>(expr);
+            return collect_read_columns(in.column(), table, columns, needed) &&
+                   std::all_of(in.values().begin(), in.values().end(),
+                               [&](const std::unique_ptr<parser::Expression>& value) {
+                                   return collect_read_columns(*value, table, columns, needed);
+                               });
+        }
+        case parser::ExprType::IsNull:
+            return collect_read_columns(static_cast<const parser::IsNullExpr&>(expr).expr(),
+                                        table, columns, needed);
+        default:
+            return false;
+    }
+}
+
+/**
+ * @return The columns of `table` that any clause of `stmt` reads, one flag per
+ * column; empty when every column has to be decoded
+ */
+std::vector<bool> read_columns(const parser::SelectStatement& stmt, const TableInfo& table) {
+    std::vector<bool> needed(table.columns.size(), false);
+    const auto collect = [&](const parser::Expression& expr) {
+        return collect_read_columns(expr, table.name, table.columns, needed);
+    };
+    const auto collect_all = [&](const std::vector<std::unique_ptr<parser::Expression>>& exprs) {
+        return std::all_of(exprs.begin(), exprs.end(),
+                           [&](const std::unique_ptr<parser::Expression>& expr) {
+                               return collect(*expr);
+                           });
+    };
+
+    const bool known =
+        !stmt.columns().empty() && collect_all(stmt.columns()) && collect_all(stmt.group_by()) &&
+        collect_all(stmt.order_by()) && (!stmt.where() || collect(*stmt.where())) &&
+        (!stmt.having() || collect(*stmt.having())) &&
+        std::all_of(stmt.joins().begin(), stmt.joins().end(), [&](const auto& join) {
+            return !join.condition || collect(*join.condition);
+        });
+    if (!known || std::all_of(needed.begin(), needed.end(), [](bool n) { return n; })) {
+        return {};
+    }
+    return needed;
+}
+
+/** Names of StmtType values, in declaration order, as the `type` label */
+constexpr std::array<const char*, 17> STATEMENT_TYPE_NAMES = {
+    "select",     "insert",       "update",     "delete", "create_table", "drop_table",
+    "alter_table", "create_index", "drop_index", "begin",  "commit",       "rollback",
+    "explain",    "analyze",      "copy",       "set",    "vacuum"};
+
+struct ExecutorMetrics {
+    std::array<common::Counter*, STATEMENT_TYPE_NAMES.size()> statements{};
+    common::Counter* errors = nullptr;
+    common::Counter* rows_returned = nullptr;
+    common::LatencyHistogram* latency = nullptr;
+};
+
+ExecutorMetrics& executor_metrics() {
+    static ExecutorMetrics metrics = [] {
+        auto& registry = common::MetricsRegistry::global();
+        ExecutorMetrics m;
+        for (size_t i = 0; i < STATEMENT_TYPE_NAMES.size(); ++i) {
+            m.statements[i] =
+                &registry.counter("cloudsql_executor_statements_total", "Statements executed",
+                                  common::metric_label("type", STATEMENT_TYPE_NAMES[i]));
+        }
+        m.errors = &registry.counter("cloudsql_executor_errors_total", "Statements that failed");
+        m.rows_returned =
+            &registry.counter("cloudsql_executor_rows_returned_total", "Rows returned by queries");
+        m.latency = &registry.histogram("cloudsql_executor_statement_latency_seconds",
+                                        "Time to execute a statement, or to drain a stream");
+        return m;
+    }();
+    return metrics;
+}
+
+const char* statement_type_name(parser::StmtType type) {
+    const auto index = static_cast<size_t>(type);
+    return index < STATEMENT_TYPE_NAMES.size() ? STATEMENT_TYPE_NAMES[index] : "other";
+}
+
+void count_statement(parser::StmtType type) {
+    const auto index = static_cast<size_t>(type);
+    if (index < STATEMENT_TYPE_NAMES.size()) {
+        executor_metrics().statements[index]->inc();
+    }
+}
+
+const char* const SYS_METRICS_TABLE = "sys_metrics";
+
+/** @brief Rows of the sys_metrics view: every series in the global registry */
+std::unique_ptr<Operator> sys_metrics_scan() {
+    Schema schema;
+    schema.add_column("name", common::ValueType::TYPE_TEXT);
+    schema.add_column("labels", common::ValueType::TYPE_TEXT);
+    schema.add_column("type", common::ValueType::TYPE_TEXT);
+    schema.add_column("value", common::ValueType::TYPE_FLOAT64);
+    std::vector<Tuple> rows;
+    for (const auto& row : common::MetricsRegistry::global().collect().rows()) {
+        const char* type = row.type == common::MetricType::Counter ? "counter"
+                           : row.type == common::MetricType::Gauge ? "gauge"
+                                                                   : "histogram";
+        rows.emplace_back(std::vector<common::Value>{
+            common::Value::make_text(row.name), common::Value::make_text(row.labels),
+            common::Value::make_text(type), common::Value::make_float64(row.value)});
+    }
+    return std::make_unique<BufferScanOperator>("sys", SYS_METRICS_TABLE, std::move(rows),
+                                                std::move(schema));
+}
+
+const char* const SYS_TRACES_TABLE = "sys_traces";
+
+/** @brief Rows of the sys_traces view: the spans in this node's trace buffer */
+std::unique_ptr<Operator> sys_traces_scan() {
+    Schema schema;
+    schema.add_column("trace_id", common::ValueType::TYPE_TEXT);
+    schema.add_column("span_id", common::ValueType::TYPE_TEXT);
+    schema.add_column("parent_id", common::ValueType::TYPE_TEXT);
+    schema.add_column("name", common::ValueType::TYPE_TEXT);
+    schema.add_column("node", common::ValueType::TYPE_TEXT);
+    schema.add_column("start_us", common::ValueType::TYPE_INT64);
+    schema.add_column("duration_us", common::ValueType::TYPE_INT64);
+    schema.add_column("attributes", common::ValueType::TYPE_TEXT);
+    std::vector<Tuple> rows;
+    for (const auto& span : common::Tracer::global().spans()) {
+        rows.emplace_back(std::vector<common::Value>{
+            common::Value::make_text(common::Tracer::id_hex(span.trace_id)),
+            common::Value::make_text(common::Tracer::id_hex(span.span_id)),
+            span.parent_id == 0 ? common::Value::make_null()
+                                : common::Value::make_text(common::Tracer::id_hex(span.parent_id)),
+            common::Value::make_text(span.name), common::Value::make_text(span.node),
+            common::Value::make_int64(span.start_us),
+            common::Value::make_int64(static_cast<int64_t>(span.duration_us)),
+            common::Value::make_text(span.attributes_text())});
+    }
+    return std::make_unique<BufferScanOperator>("sys", SYS_TRACES_TABLE, std::move(rows),
+                                                std::move(schema));
+}
+
+/** @return A scan of the system view `name`, or null if there is none of that name */
+std::unique_ptr<Operator> system_view_scan(const std::string& name) {
+    if (name == SYS_METRICS_TABLE) {
+        return sys_metrics_scan();
+    }
+    if (name == SYS_TRACES_TABLE) {
+        return sys_traces_scan();
+    }
+    return nullptr;
+}
 }  // namespace
 
 void ShardStateMachine::apply(const raft::LogEntry& entry) {
@@ -104,6 +791,134 @@ void ShardStateMachine::apply(const raft::LogEntry& entry) {
         std::memcpy(&rid.slot_num, entry.data.data() + offset + 4, 4);
         table.remove(rid, 0);
     }
+    catalog_.note_data_change(table_name);
+}
+
+bool ShardStateMachine::save_snapshot(std::ostream& out) {
+    // [FileCount:4][[NameLen:4][Name][PageCount:4][Pages...]...]
+    std::vector<std::string> files;
+    for (const auto* table : catalog_.get_all_tables()) {
+        files.push_back(table->name + ".heap");
+        files.push_back(table->name + ".fsm");
+        for (const auto& index : table->indexes) {
+            files.push_back(index.filename.empty() ? index.name + ".idx" : index.filename);
+        }
+    }
+    auto& storage = bpm_.get_storage_manager();
+    files.erase(std::remove_if(files.begin(), files.end(),
+                               [&storage](const auto& f) { return !storage.file_exists(f); }),
+                files.end());
+
+    /* Raft holds applies back while this runs, so the files on disk are the whole state */
+    bpm_.flush_all_pages();
+    const auto file_count = static_cast<uint32_t>(files.size());
+    out.write(reinterpret_cast<const char*>(&file_count), 4);
+    std::vector<char> page(storage.page_size());
+    for (const auto& file : files) {
+        const auto name_len = static_cast<uint32_t>(file.size());
+        const uint32_t pages = storage.page_count(file);
+        out.write(reinterpret_cast<const char*>(&name_len), 4);
+        out.write(file.data(), name_len);
+        out.write(reinterpret_cast<const char*>(&pages), 4);
+        for (uint32_t p = 0; p < pages; ++p) {
+            if (!storage.read_page(file, p, page.data())) return false;
+            out.write(page.data(), static_cast<std::streamsize>(page.size()));
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+bool ShardStateMachine::load_snapshot(std::istream& in) {
+    uint32_t file_count = 0;
+    in.read(reinterpret_cast<char*>(&file_count), 4);
+    if (!in) return false;
+
+    auto& storage = bpm_.get_storage_manager();
+    bpm_.flush_all_pages();
+    std::vector<char> page(storage.page_size());
+    for (uint32_t f = 0; f < file_count; ++f) {
+        uint32_t name_len = 0;
+        in.read(reinterpret_cast<char*>(&name_len), 4);
+        std::string file(in ? name_len : 0, '\0');
+        in.read(file.data(), name_len);
+        uint32_t pages = 0;
+        in.read(reinterpret_cast<char*>(&pages), 4);
+        if (!in || !storage.open_file(file)) return false;
+
+        /* Cached copies of the old pages must not be read, or flushed over the new ones */
+        const uint32_t old_pages = storage.page_count(file);
+        for (uint32_t p = 0; p < old_pages; ++p) {
+            if (!bpm_.delete_page(file, p)) {
+                std::cerr << "--- [ShardStateMachine] page " << p << " of " << file
+                          << " is in use; cannot restore ---" << std::endl;
+                return false;
+            }
+        }
+        if (!storage.truncate_file(file)) return false;
+        for (uint32_t p = 0; p < pages; ++p) {
+            in.read(page.data(), static_cast<std::streamsize>(page.size()));
+            if (!in || !storage.write_page(file, p, page.data())) return false;
+        }
+    }
+    for (const auto* table : catalog_.get_all_tables()) {
+        catalog_.note_data_change(table->name);
+    }
+    return true;
+}
+
+const char* ReadSettings::name(raft::ReadConsistency consistency) {
+    switch (consistency) {
+        case raft::ReadConsistency::Leader:
+            return "leader";
+        case raft::ReadConsistency::Lease:
+            return "lease";
+        case raft::ReadConsistency::Follower:
+            return "follower";
+        case raft::ReadConsistency::Stale:
+            return "stale";
+    }
+    return "stale";
+}
+
+std::string ReadSettings::apply(const parser::SetStatement& stmt) {
+    std::string value = stmt.value();
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (stmt.name() == "read_consistency") {
+        constexpr std::array<raft::ReadConsistency, 4> LEVELS = {
+            raft::ReadConsistency::Leader, raft::ReadConsistency::Lease,
+            raft::ReadConsistency::Follower, raft::ReadConsistency::Stale};
+        for (const auto level : LEVELS) {
+            if (value == name(level)) {
+                consistency = level;
+                return {};
+            }
+        }
+        return "invalid value for read_consistency: \"" + stmt.value() +
+               "\" (leader, lease, follower or stale)";
+    }
+    if (stmt.name() == "max_staleness") {
+        /* Milliseconds, up to about 11 days */
+        constexpr size_t MAX_DIGITS = 9;
+        if (value.empty() || value.size() > MAX_DIGITS ||
+            !std::all_of(value.begin(), value.end(),
+                         [](unsigned char c) { return std::isdigit(c) != 0; })) {
+            return "invalid value for max_staleness: \"" + stmt.value() + "\" (milliseconds)";
+        }
+        max_staleness = std::chrono::milliseconds(std::stoll(value));
+        return {};
+    }
+    if (stmt.name() == "result_cache") {
+        if (value == "on" || value == "true" || value == "1") {
+            result_cache = true;
+        } else if (value == "off" || value == "false" || value == "0") {
+            result_cache = false;
+        } else {
+            return "invalid value for result_cache: \"" + stmt.value() + "\" (on or off)";
+        }
+        return {};
+    }
+    return "unrecognized configuration parameter \"" + stmt.name() + "\"";
 }
 
 QueryExecutor::QueryExecutor(Catalog& catalog, storage::BufferPoolManager& bpm,
@@ -116,7 +931,23 @@ QueryExecutor::QueryExecutor(Catalog& catalog, storage::BufferPoolManager& bpm,
       lock_manager_(lock_manager),
       transaction_manager_(transaction_manager),
       log_manager_(log_manager),
-      cluster_manager_(cluster_manager) {}
+      cluster_manager_(cluster_manager),
+      table_handles_(catalog, bpm) {}
+
+std::atomic<size_t> QueryExecutor::default_query_memory_limit_{0};
+
+void QueryExecutor::set_default_query_memory_limit(size_t bytes) {
+    default_query_memory_limit_.store(bytes, std::memory_order_relaxed);
+}
+
+size_t QueryExecutor::default_query_memory_limit() {
+    return default_query_memory_limit_.load(std::memory_order_relaxed);
+}
+
+std::unique_ptr<common::MemoryTracker> QueryExecutor::make_query_memory() {
+    return std::make_unique<common::MemoryTracker>("query", default_query_memory_limit(),
+                                                   &session_memory_);
+}
 
 QueryExecutor::~QueryExecutor() {
     if (current_txn_ != nullptr) {
@@ -127,6 +958,14 @@ QueryExecutor::~QueryExecutor() {
 QueryResult QueryExecutor::execute(const parser::Statement& stmt) {
     const auto start = std::chrono::high_resolution_clock::now();
     QueryResult result;
+    count_statement(stmt.type());
+    common::Span span("executor.statement", common::Span::Start::RootIfSampled);
+    if (span.active()) {
+        span.set_attribute("statement", statement_type_name(stmt.type()));
+        if (!context_id_.empty()) {
+            span.set_attribute("context_id", context_id_);
+        }
+    }
 
     /* Handle Explicit Transaction Control */
     if (stmt.type() == parser::StmtType::TransactionBegin) {
@@ -139,19 +978,35 @@ QueryResult QueryExecutor::execute(const parser::Statement& stmt) {
         return execute_rollback();
     }
 
+    /* Versions are read before the snapshot, so an entry is never tagged newer than its rows */
+    ResultCache::Probe cache_probe;
+    if (stmt.type() == parser::StmtType::Select && caches_results()) {
+        cache_probe =
+            ResultCache::probe(catalog_, dynamic_cast<const parser::SelectStatement&>(stmt));
+    }
+    std::optional<QueryResult> cached = result_cache_ != nullptr
+                                            ? result_cache_->lookup(cache_probe)
+                                            : std::nullopt;
+
     /* Auto-commit mode if no current transaction */
     const bool is_auto_commit = (current_txn_ == nullptr);
     transaction::Transaction* txn = current_txn_;
 
-    if (is_auto_commit &&
+    if (is_auto_commit && !cached &&
         (stmt.type() == parser::StmtType::Select || stmt.type() == parser::StmtType::Insert ||
-         stmt.type() == parser::StmtType::Update || stmt.type() == parser::StmtType::Delete)) {
+         stmt.type() == parser::StmtType::Update || stmt.type() == parser::StmtType::Delete ||
+         stmt.type() == parser::StmtType::Analyze || stmt.type() == parser::StmtType::Explain)) {
         txn = transaction_manager_.begin();
     }
 
     try {
-        if (stmt.type() == parser::StmtType::Select) {
+        if (cached) {
+            result = std::move(*cached);
+        } else if (stmt.type() == parser::StmtType::Select) {
             result = execute_select(dynamic_cast<const parser::SelectStatement&>(stmt), txn);
+            if (!cache_probe.key.empty()) {
+                result_cache_->insert(cache_probe, result);
+            }
         } else if (stmt.type() == parser::StmtType::CreateTable) {
             result = execute_create_table(dynamic_cast<const parser::CreateTableStatement&>(stmt));
         } else if (stmt.type() == parser::StmtType::CreateIndex) {
@@ -166,6 +1021,20 @@ QueryResult QueryExecutor::execute(const parser::Statement& stmt) {
             result = execute_delete(dynamic_cast<const parser::DeleteStatement&>(stmt), txn);
         } else if (stmt.type() == parser::StmtType::Update) {
             result = execute_update(dynamic_cast<const parser::UpdateStatement&>(stmt), txn);
+        } else if (stmt.type() == parser::StmtType::Analyze) {
+            result = execute_analyze(dynamic_cast<const parser::AnalyzeStatement&>(stmt), txn);
+        } else if (stmt.type() == parser::StmtType::Vacuum) {
+            result = execute_vacuum(dynamic_cast<const parser::VacuumStatement&>(stmt));
+        } else if (stmt.type() == parser::StmtType::Explain) {
+            result = execute_explain(dynamic_cast<const parser::ExplainStatement&>(stmt), txn);
+        } else if (stmt.type() == parser::StmtType::Copy) {
+            result.set_error("COPY FROM STDIN needs the copy protocol to send its data");
+        } else if (stmt.type() == parser::StmtType::Set) {
+            const std::string error =
+                read_settings_.apply(dynamic_cast<const parser::SetStatement&>(stmt));
+            if (!error.empty()) {
+                result.set_error(error);
+            }
         } else {
             result.set_error("Unsupported statement type");
         }
@@ -189,8 +1058,225 @@ QueryResult QueryExecutor::execute(const parser::Statement& stmt) {
     const auto end = std::chrono::high_resolution_clock::now();
     const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
     result.set_execution_time(static_cast<uint64_t>(duration.count()));
+    auto& metrics = executor_metrics();
+    metrics.latency->record(static_cast<uint64_t>(duration.count()));
+    metrics.rows_returned->inc(result.rows().size());
+    if (!result.success()) {
+        metrics.errors->inc();
+        span.set_attribute("error", result.error());
+    }
+    if (span.active()) {
+        span.set_attribute("rows", std::to_string(result.rows().size()));
+    }
+
+    return result;
+}
+
+ResultStream::~ResultStream() {
+    finish(true);
+}
+
+bool ResultStream::next(Tuple& row) {
+    if (root_ == nullptr) {
+        return false;
+    }
+    try {
+        if (root_->next(row)) {
+            ++row_count_;
+            return true;
+        }
+        error_ = root_->error();
+    } catch (const std::exception& e) {
+        error_ = std::string("Execution error: ") + e.what();
+    }
+    finish(error_.empty());
+    return false;
+}
+
+void ResultStream::finish(bool commit) {
+    if (root_ != nullptr) {
+        root_->close();
+        root_.reset();
+    }
+    if (!recorded_) {
+        recorded_ = true;
+        auto& metrics = executor_metrics();
+        metrics.latency->record(std::chrono::steady_clock::now() - started_);
+        metrics.rows_returned->inc(row_count_);
+        if (!error_.empty()) {
+            metrics.errors->inc();
+        }
+    }
+    if (owned_txn_ != nullptr) {
+        if (commit) {
+            transaction_manager_.commit(owned_txn_);
+        } else {
+            transaction_manager_.abort(owned_txn_);
+        }
+        owned_txn_ = nullptr;
+    }
+}
+
+std::unique_ptr<ResultStream> QueryExecutor::stream(const parser::SelectStatement& stmt) {
+    count_statement(stmt.type());
+    transaction::Transaction* txn = current_txn_;
+    std::unique_ptr<ResultStream> result(new ResultStream(
+        transaction_manager_, txn == nullptr ? transaction_manager_.begin() : nullptr));
+    if (txn == nullptr) {
+        txn = result->owned_txn_;
+    }
+
+    try {
+        /* Only the plan is traced; the rows are pulled later, by the caller */
+        const common::Span span("executor.plan", common::Span::Start::RootIfSampled);
+        result->memory_ = make_query_memory();
+        const common::MemoryTracker::Scope memory_scope(result->memory_.get());
+        const std::string unreadable = prepare_shard_read();
+        auto root = unreadable.empty() ? build_plan(stmt, txn) : nullptr;
+        if (!unreadable.empty()) {
+            result->error_ = unreadable;
+        } else if (!root) {
+            result->error_ =
+                "Failed to build execution plan (check table existence and FROM clause)";
+        } else if (!root->init() || !root->open()) {
+            result->error_ = open_error(*root);
+        } else {
+            result->schema_ = root->output_schema();
+            result->root_ = std::move(root);
+        }
+    } catch (const std::exception& e) {
+        result->error_ = std::string("Execution error: ") + e.what();
+    }
+    if (!result->success()) {
+        result->finish(false);
+    }
+    return result;
+}
+
+CopyIn::~CopyIn() {
+    if (open_) {
+        abort("COPY was not finished");
+    }
+}
+
+bool CopyIn::write(const char* data, size_t size) {
+    if (!open_) {
+        return false;
+    }
+    try {
+        decoder_.feed(data, size, rows_);
+        flush(INSERT_BATCH_ROWS);
+    } catch (const std::exception& e) {
+        error_ = e.what();
+        end(false);
+    }
+    return open_;
+}
+
+bool CopyIn::finish() {
+    if (!open_) {
+        return false;
+    }
+    try {
+        decoder_.finish(rows_);
+        flush(1);
+        end(true);
+    } catch (const std::exception& e) {
+        error_ = e.what();
+        end(false);
+    }
+    return success();
+}
+
+void CopyIn::abort(const std::string& reason) {
+    if (open_) {
+        error_ = "COPY aborted: " + reason;
+        end(false);
+    }
+}
+
+void CopyIn::flush(size_t min_rows) {
+    if (!rows_.empty() && rows_.size() >= min_rows) {
+        sink_(rows_);
+        row_count_ += rows_.size();
+        rows_.clear();
+    }
+}
+
+void CopyIn::end(bool commit) {
+    open_ = false;
+    rows_.clear();
+    if (owned_txn_ != nullptr) {
+        if (commit) {
+            transaction_manager_.commit(owned_txn_);
+        } else {
+            transaction_manager_.abort(owned_txn_);
+        }
+        owned_txn_ = nullptr;
+    }
+}
+
+std::unique_ptr<CopyIn> QueryExecutor::copy_from(const parser::CopyStatement& stmt) {
+    const std::string& table_name = stmt.table_name();
+    const auto table_meta = catalog_.get_table_by_name(table_name);
+    Schema schema;
+    if (table_meta.has_value()) {
+        for (const auto& col : table_meta.value()->columns) {
+            schema.add_column(col.name, col.type);
+        }
+    }
+
+    transaction::Transaction* txn = current_txn_;
+    std::unique_ptr<CopyIn> copy(new CopyIn(
+        transaction_manager_, txn == nullptr ? transaction_manager_.begin() : nullptr, schema,
+        stmt.options()));
+    if (txn == nullptr) {
+        txn = copy->owned_txn_;
+    }
+
+    if (!table_meta.has_value()) {
+        copy->error_ = "Table not found: " + table_name;
+        copy->end(false);
+    } else if (!is_local_only_ && cluster_manager_ != nullptr &&
+               !table_meta.value()->shards.empty()) {
+        copy->error_ = "COPY into a sharded table is not supported";
+        copy->end(false);
+    } else {
+        /* Looked up again per batch, in case the table is dropped meanwhile */
+        copy->sink_ = [this, table_name, txn](const std::vector<Tuple>& rows) {
+            const auto meta = catalog_.get_table_by_name(table_name);
+            if (!meta.has_value()) {
+                throw std::runtime_error("Table not found: " + table_name);
+            }
+            insert_batch(*meta.value(), rows, txn);
+        };
+    }
+    return copy;
+}
+
+std::unique_ptr<CopyIn> QueryExecutor::copy_from(storage::ColumnarTable& table,
+                                                 const parser::CopyOptions& options) {
+    std::unique_ptr<CopyIn> copy(
+        new CopyIn(transaction_manager_, nullptr, table.schema(), options));
+    copy->sink_ = [&table](const std::vector<Tuple>& rows) {
+        auto batch = VectorBatch::create(table.schema());
+        for (const auto& row : rows) {
+            batch->append_tuple(row);
+        }
+        if (!table.append_batch(*batch)) {
+            throw std::runtime_error("Failed to append to columnar table");
+        }
+    };
+    return copy;
+}
 
-    return result;
+Schema QueryExecutor::describe(const parser::Statement& stmt) {
+    if (stmt.type() != parser::StmtType::Select) {
+        return {};
+    }
+    /* Operators settle their output schema when constructed; nothing is read */
+    const auto root = build_plan(dynamic_cast<const parser::SelectStatement&>(stmt), current_txn_);
+    return root ? root->output_schema() : Schema();
 }
 
 QueryResult QueryExecutor::execute_begin() {
@@ -228,8 +1314,18 @@ QueryResult QueryExecutor::execute_rollback() {
 QueryResult QueryExecutor::execute_select(const parser::SelectStatement& stmt,
                                           transaction::Transaction* txn) {
     QueryResult result;
+    const std::string unreadable = prepare_shard_read();
+    if (!unreadable.empty()) {
+        result.set_error(unreadable);
+        return result;
+    }
+
+    /* Operators built in the scope charge the query's tracker, which outlives them */
+    const auto memory = make_query_memory();
+    const common::MemoryTracker::Scope memory_scope(memory.get());
 
     /* Build execution plan */
+    common::Span plan_span("executor.plan");
     auto root = build_plan(stmt, txn);
     if (!root) {
         result.set_error("Failed to build execution plan (check table existence and FROM clause)");
@@ -238,26 +1334,83 @@ QueryResult QueryExecutor::execute_select(const parser::SelectStatement& stmt,
 
     /* Initialize and open operators */
     if (!root->init() || !root->open()) {
-        result.set_error(root->error().empty() ? "Failed to open execution plan" : root->error());
+        result.set_error(open_error(*root));
         return result;
     }
+    plan_span.end();
+    const common::Span run_span("executor.run");
 
     /* Set result schema */
     result.set_schema(root->output_schema());
 
-    /* Pull tuples (Volcano model) */
+    /* Result rows are bump-allocated; the arena is recycled once no earlier result holds it */
+    if (!result_arena_ || result_arena_.use_count() > 1) {
+        result_arena_ = std::make_shared<common::Arena>();
+    } else {
+        result_arena_->reset();
+    }
+    result.set_arena(result_arena_);
+
+    /* Pull tuples (Volcano model); operators reuse `tuple`'s buffer from row to row */
+    common::MemoryTracker result_memory("result", 0, memory.get());
     Tuple tuple;
     while (root->next(tuple)) {
-        result.add_row(std::move(tuple));
+        if (canceled_ != nullptr && canceled_->load(std::memory_order_relaxed)) {
+            root->close();
+            QueryResult canceled;
+            canceled.set_error("Query canceled");
+            return canceled;
+        }
+        result.add_row(tuple);
+
+        /* The buffered result cannot spill: past the limit the query fails */
+        const common::MemoryTracker* refused = nullptr;
+        if (!result_memory.try_resize(result_arena_->bytes_used() +
+                                          result.rows().capacity() * sizeof(Tuple),
+                                      &refused)) {
+            root->close();
+            QueryResult failed;
+            failed.set_error(common::MemoryTracker::limit_message(*refused, "query result"));
+            return failed;
+        }
     }
 
     root->close();
     return result;
 }
 
+std::string QueryExecutor::prepare_shard_read() const {
+    if (!read_settings_.constrained() || cluster_manager_ == nullptr ||
+        cluster_manager_->get_raft_manager() == nullptr) {
+        return {};
+    }
+    /* Without a replicated shard, the node's own data is all there is to read */
+    auto shard_group = cluster_manager_->get_raft_manager()->get_group(SHARD_GROUP_ID);
+    if (!shard_group ||
+        shard_group->prepare_read(read_settings_.consistency, read_settings_.max_staleness)) {
+        return {};
+    }
+    return std::string("shard ") + std::to_string(SHARD_GROUP_ID) + " cannot serve a " +
+           ReadSettings::name(read_settings_.consistency) + " read on this node";
+}
+
 QueryResult QueryExecutor::execute_create_table(const parser::CreateTableStatement& stmt) {
     QueryResult result;
 
+    /* Building the replica waits for running transactions, which would include its own */
+    if (stmt.columnar_replica() && replicas_ != nullptr && current_txn_ != nullptr) {
+        result.set_error("CREATE TABLE with a columnar replica cannot run inside a transaction "
+                         "block");
+        return result;
+    }
+
+    storage::PageCompression compression = storage::PageCompression::None;
+    if (!stmt.compression().empty() &&
+        !storage::parse_page_compression(stmt.compression(), &compression)) {
+        result.set_error("Unknown compression method: " + stmt.compression());
+        return result;
+    }
+
     /* Convert parser columns to catalog columns */
     std::vector<ColumnInfo> catalog_cols;
     uint16_t pos = 0;
@@ -277,11 +1430,14 @@ QueryResult QueryExecutor::execute_create_table(const parser::CreateTableStateme
     }
 
     /* Update catalog */
+    const uint32_t flags = (stmt.replicated() ? TableInfo::FLAG_REPLICATED : 0) |
+                           (stmt.columnar_replica() ? TableInfo::FLAG_COLUMNAR_REPLICA : 0);
     oid_t table_id = 0;
     if (is_local_only_) {
-        table_id = catalog_.create_table_local(stmt.table_name(), std::move(catalog_cols));
+        table_id = catalog_.create_table_local(stmt.table_name(), std::move(catalog_cols), {},
+                                               flags);
     } else {
-        table_id = catalog_.create_table(stmt.table_name(), std::move(catalog_cols));
+        table_id = catalog_.create_table(stmt.table_name(), std::move(catalog_cols), flags);
     }
 
     if (table_id == 0) {
@@ -297,11 +1453,23 @@ QueryResult QueryExecutor::execute_create_table(const parser::CreateTableStateme
     }
     const auto* table_info = table_info_opt.value();
     storage::HeapTable table(table_info->name, bpm_, executor::Schema());
+    if (compression != storage::PageCompression::None &&
+        !bpm_.get_storage_manager().set_compression(table.filename(), compression)) {
+        static_cast<void>(catalog_.drop_table(table_id));
+        result.set_error("Failed to set up compression for table file");
+        return result;
+    }
     if (!table.create()) {
         static_cast<void>(catalog_.drop_table(table_id));
         result.set_error("Failed to create table file");
         return result;
     }
+    if (stmt.columnar_replica() && replicas_ != nullptr && !replicas_->attach(*table_info)) {
+        static_cast<void>(table.drop());
+        static_cast<void>(catalog_.drop_table(table_id));
+        result.set_error("Failed to build the columnar replica of " + stmt.table_name());
+        return result;
+    }
 
     result.set_rows_affected(1);
     return result;
@@ -310,6 +1478,12 @@ QueryResult QueryExecutor::execute_create_table(const parser::CreateTableStateme
 QueryResult QueryExecutor::execute_create_index(const parser::CreateIndexStatement& stmt) {
     QueryResult result;
 
+    /* It waits for running transactions, which would include its own */
+    if (stmt.concurrently() && current_txn_ != nullptr) {
+        result.set_error("CREATE INDEX CONCURRENTLY cannot run inside a transaction block");
+        return result;
+    }
+
     /* Reject composite indexes */
     if (stmt.columns().size() != 1) {
         result.set_error("Composite indexes not supported");
@@ -341,43 +1515,101 @@ QueryResult QueryExecutor::execute_create_index(const parser::CreateIndexStateme
         return result;
     }
 
-    /* Update Catalog */
-    const oid_t index_id = catalog_.create_index(stmt.index_name(), table_meta->table_id,
-                                                 col_positions, IndexType::BTree, stmt.unique());
-    if (index_id == 0) {
-        result.set_error("Failed to create index in catalog");
+    IndexType index_type = IndexType::BTree;
+    if (stmt.method() == "HASH") {
+        index_type = IndexType::Hash;
+    } else if (stmt.method() == "BRIN") {
+        if (!storage::BrinIndex::supports(key_type)) {
+            result.set_error("BRIN indexes need a numeric or text column: " + col_name);
+            return result;
+        }
+        index_type = IndexType::BRIN;
+    } else if (!stmt.method().empty() && stmt.method() != "BTREE") {
+        result.set_error("Unsupported index method: " + stmt.method());
         return result;
     }
 
-    /* Create Physical Index File */
-    storage::BTreeIndex index(stmt.index_name(), bpm_, key_type);
+    /* A concurrent build is published in the catalog only once it is complete, so no
+     * writer or reader sees it half built */
+    oid_t index_id = 0;
+    if (stmt.concurrently()) {
+        for (const auto& existing : table_meta->indexes) {
+            if (existing.name == stmt.index_name()) {
+                result.set_error("Index already exists: " + stmt.index_name());
+                return result;
+            }
+        }
+    } else {
+        index_id = catalog_.create_index(stmt.index_name(), table_meta->table_id, col_positions,
+                                         index_type, stmt.unique());
+        if (index_id == 0) {
+            result.set_error("Failed to create index in catalog");
+            return result;
+        }
+    }
+    const auto drop_entry = [this, &index_id] {
+        if (index_id != 0) {
+            static_cast<void>(catalog_.drop_index(index_id));
+        }
+    };
+
+    /* Create Physical Index File, stored the way its table is */
+    IndexInfo index_info;
+    index_info.name = stmt.index_name();
+    index_info.index_type = index_type;
+    const auto index_ptr = open_index(index_info, key_type, bpm_);
+    storage::Index& index = *index_ptr;
+    auto& disk = bpm_.get_storage_manager();
+    const storage::PageCompression compression =
+        disk.compression(stmt.table_name() + storage::HeapTable::FILE_EXTENSION);
+    if (compression != storage::PageCompression::None) {
+        static_cast<void>(disk.set_compression(index.filename(), compression));
+    }
     if (!index.create()) {
-        static_cast<void>(catalog_.drop_index(index_id));
+        drop_entry();
         result.set_error("Failed to create index file");
         return result;
     }
 
-    /* Populate Index with existing data (Backfill) */
+    /* Populate Index with existing data (Backfill): page ranges are read and their entries
+     * sorted in parallel. A B-tree is built bottom-up from the merged runs and a hash index
+     * sizes its directory up front, instead of splitting their way through one insert per row */
     Schema schema;
     for (const auto& col : table_meta->columns) {
         schema.add_column(col.name, col.type);
     }
-    storage::HeapTable table(stmt.table_name(), bpm_, schema);
-    auto iter = table.scan();
-    storage::HeapTable::TupleMeta meta;
-    std::string err;
-    while (iter.next_meta(meta)) {
-        if (meta.xmax == 0) {
-            /* Extract key from tuple */
-            const common::Value& key = meta.tuple.get(col_positions[0]);
-            if (!apply_index_write(index, key, iter.current_id(), IndexOp::Insert, err)) {
-                static_cast<void>(index.drop());
-                static_cast<void>(catalog_.drop_index(index_id));
-                result.set_error(err);
-                return result;
+    IndexBuildOptions options;
+    options.sorted = index.ordered();
+    std::optional<ConcurrentIndexBuild> build;
+    if (stmt.concurrently()) {
+        build.emplace(bpm_, stmt.table_name(), col_positions[0], index);
+    }
+    auto entries =
+        collect_index_entries(bpm_, stmt.table_name(), schema, col_positions[0], options);
+    bool built = index.bulk_load(std::move(entries)) && (!build || build->catch_up());
+    if (built && build) {
+        built = build->publish([&]() {
+            try {
+                index_id = catalog_.create_index(stmt.index_name(), table_meta->table_id,
+                                                 col_positions, index_type, stmt.unique());
+            } catch (const std::exception&) {
+                index_id = 0;
             }
+            return index_id != 0;
+        });
+        if (built) {
+            /* Statements that opened the table before the index was published do not write
+             * it themselves; the build writes for them until their transactions end */
+            transaction_manager_.wait_for_running();
         }
     }
+    build.reset();
+    if (!built) {
+        static_cast<void>(index.drop());
+        drop_entry();
+        result.set_error("Index operation failed while building " + stmt.index_name());
+        return result;
+    }
 
     result.set_rows_affected(1);
     return result;
@@ -400,16 +1632,8 @@ QueryResult QueryExecutor::execute_insert(const parser::InsertStatement& stmt,
     }
     const auto* table_meta = table_meta_opt.value();
 
-    /* Construct Schema */
-    Schema schema;
-    for (const auto& col : table_meta->columns) {
-        schema.add_column(col.name, col.type);
-    }
-
-    storage::HeapTable table(table_name, bpm_, schema);
-
     uint64_t rows_inserted = 0;
-    const uint64_t xmin = (txn != nullptr) ? txn->get_id() : 0;
+    std::vector<Tuple> pending;
 
     for (const auto& row_exprs : stmt.values()) {
         std::vector<common::Value> values;
@@ -418,7 +1642,7 @@ QueryResult QueryExecutor::execute_insert(const parser::InsertStatement& stmt,
             values.push_back(expr->evaluate());
         }
 
-        const Tuple tuple(std::move(values));
+        Tuple tuple(std::move(values));
 
         // Distributed Routing: Skip if is_local_only_
         if (!is_local_only_ && cluster_manager_ != nullptr && !table_meta->shards.empty()) {
@@ -457,43 +1681,109 @@ QueryResult QueryExecutor::execute_insert(const parser::InsertStatement& stmt,
             }
         }
 
-        const auto tid = table.insert(tuple, xmin);
+        /* Local rows are written a batch at a time */
+        pending.push_back(std::move(tuple));
+        if (pending.size() == INSERT_BATCH_ROWS) {
+            insert_batch(*table_meta, pending, txn);
+            rows_inserted += pending.size();
+            pending.clear();
+        }
+    }
+    insert_batch(*table_meta, pending, txn);
+    rows_inserted += pending.size();
 
-        /* Update Indexes */
-        std::string err;
-        for (const auto& idx_info : table_meta->indexes) {
-            if (!idx_info.column_positions.empty()) {
-                uint16_t pos = idx_info.column_positions[0];
-                common::ValueType ktype = table_meta->columns[pos].type;
-                storage::BTreeIndex index(idx_info.name, bpm_, ktype);
-                if (!apply_index_write(index, tuple.get(pos), tid, IndexOp::Insert, err)) {
-                    throw std::runtime_error(err);
-                }
-            }
+    result.set_rows_affected(rows_inserted);
+    return result;
+}
+
+void QueryExecutor::insert_batch(const TableInfo& table_meta, const std::vector<Tuple>& rows,
+                                 transaction::Transaction* txn) {
+    if (rows.empty()) {
+        return;
+    }
+    TableHandle& handle = table_handles_.get(table_meta);
+    const uint64_t xmin = (txn != nullptr) ? txn->get_id() : 0;
+    const auto tids = handle.table.insert_batch(rows, xmin);
+
+    /* Undo entries first, so a failure below still rolls back every row placed */
+    const size_t undo_base = (txn != nullptr) ? txn->undo_log_count() : 0;
+    if (txn != nullptr) {
+        for (const auto& tid : tids) {
+            txn->add_undo_log(transaction::UndoLog::Type::INSERT, table_meta.name, tid);
         }
+    }
+    if (tids.size() < rows.size()) {
+        throw std::runtime_error("Failed to insert row into " + table_meta.name);
+    }
+    for (size_t i = 0; i < tids.size(); ++i) {
+        ConcurrentIndexBuild::record_insert(bpm_, table_meta.name, tids[i], rows[i]);
+    }
 
-        /* Log INSERT */
-        if (log_manager_ != nullptr && txn != nullptr) {
-            recovery::LogRecord log(txn->get_id(), txn->get_prev_lsn(),
-                                    recovery::LogRecordType::INSERT, table_name, tid, tuple);
-            const auto lsn = log_manager_->append_log_record(log);
-            txn->set_prev_lsn(lsn);
+    /* Sorted keys descend to neighbouring leaves, which stay in the buffer pool */
+    std::vector<size_t> order(rows.size());
+    std::string err;
+    for (auto& idx : handle.indexes) {
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return rows[a].get(idx.column) < rows[b].get(idx.column);
+        });
+        for (const size_t i : order) {
+            if (!apply_index_write(*idx.index, rows[i].get(idx.column), tids[i], IndexOp::Insert,
+                                   err)) {
+                throw std::runtime_error(err);
+            }
         }
+    }
 
-        /* Record undo log and Acquire Exclusive Lock if in transaction */
-        if (txn != nullptr) {
-            txn->add_undo_log(transaction::UndoLog::Type::INSERT, table_name, tid);
-            if (!lock_manager_.acquire_exclusive(
-                    txn, std::to_string(tid.page_num) + ":" + std::to_string(tid.slot_num))) {
-                throw std::runtime_error("Failed to acquire exclusive lock");
+    /* One WAL record per heap page; a lone row keeps the plain INSERT record */
+    if (log_manager_ != nullptr && txn != nullptr) {
+        for (size_t first = 0; first < tids.size();) {
+            size_t last = first + 1;
+            while (last < tids.size() && tids[last].page_num == tids[first].page_num) ++last;
+            recovery::lsn_t lsn = recovery::INVALID_LSN;
+            if (last - first == 1) {
+                recovery::LogRecord log(txn->get_id(), txn->get_prev_lsn(),
+                                        recovery::LogRecordType::INSERT, table_meta.name,
+                                        tids[first], rows[first]);
+                lsn = log_manager_->append_log_record(log);
+            } else {
+                const auto offset = static_cast<std::ptrdiff_t>(first);
+                const auto count = static_cast<std::ptrdiff_t>(last - first);
+                recovery::LogRecord log(
+                    txn->get_id(), txn->get_prev_lsn(), table_meta.name,
+                    {tids.begin() + offset, tids.begin() + offset + count},
+                    {rows.begin() + offset, rows.begin() + offset + count});
+                lsn = log_manager_->append_log_record(log);
             }
+            txn->set_prev_lsn(lsn);
+            txn->set_undo_lsn(undo_base + first, undo_base + last, lsn);
+            static_cast<void>(handle.table.set_page_lsn(tids[first].page_num, lsn));
+            first = last;
         }
+    }
+
+    lock_for_write(table_meta, tids, txn);
+}
 
-        rows_inserted++;
+void QueryExecutor::lock_for_scan(const TableInfo& table, transaction::Transaction* txn) {
+    /* Weaker levels read MVCC snapshots without locks */
+    if (txn == nullptr || txn->get_isolation_level() != transaction::IsolationLevel::SERIALIZABLE) {
+        return;
+    }
+    if (!lock_manager_.lock_table(txn, table.table_id, transaction::LockMode::SHARED)) {
+        throw std::runtime_error("Failed to acquire shared lock on " + table.name);
     }
+}
 
-    result.set_rows_affected(rows_inserted);
-    return result;
+void QueryExecutor::lock_for_write(const TableInfo& table,
+                                   const std::vector<storage::HeapTable::TupleId>& tids,
+                                   transaction::Transaction* txn) {
+    if (txn == nullptr) {
+        return;
+    }
+    if (!lock_manager_.lock_rows(txn, table.table_id, tids, transaction::LockMode::EXCLUSIVE)) {
+        throw std::runtime_error("Failed to acquire exclusive lock");
+    }
 }
 
 QueryResult QueryExecutor::execute_delete(const parser::DeleteStatement& stmt,
@@ -507,12 +1797,9 @@ QueryResult QueryExecutor::execute_delete(const parser::DeleteStatement& stmt,
     }
     const auto* table_meta = table_meta_opt.value();
 
-    Schema schema;
-    for (const auto& col : table_meta->columns) {
-        schema.add_column(col.name, col.type);
-    }
-
-    storage::HeapTable table(table_name, bpm_, schema);
+    TableHandle& handle = table_handles_.get(*table_meta);
+    storage::HeapTable& table = handle.table;
+    const Schema& schema = handle.schema;
     const uint64_t xmax = (txn != nullptr) ? txn->get_id() : 0;
     uint64_t rows_deleted = 0;
 
@@ -532,10 +1819,11 @@ QueryResult QueryExecutor::execute_delete(const parser::DeleteStatement& stmt,
     }
 
     /* Phase 2: Apply Deletions */
+    lock_for_write(*table_meta, target_rids, txn);
     for (const auto& rid : target_rids) {
         // POC: Replication Logic
         if (cluster_manager_ != nullptr && cluster_manager_->get_raft_manager() != nullptr) {
-            auto shard_group = cluster_manager_->get_raft_manager()->get_group(1);
+            auto shard_group = cluster_manager_->get_raft_manager()->get_group(SHARD_GROUP_ID);
             if (shard_group && shard_group->is_leader()) {
                 std::vector<uint8_t> cmd;
                 cmd.push_back(2);  // Type 2: DELETE
@@ -566,15 +1854,11 @@ QueryResult QueryExecutor::execute_delete(const parser::DeleteStatement& stmt,
             /* Update Indexes */
             std::string err;
             if (!old_tuple.empty()) {
-                for (const auto& idx_info : table_meta->indexes) {
-                    if (!idx_info.column_positions.empty()) {
-                        uint16_t pos = idx_info.column_positions[0];
-                        common::ValueType ktype = table_meta->columns[pos].type;
-                        storage::BTreeIndex index(idx_info.name, bpm_, ktype);
-                        if (!apply_index_write(index, old_tuple.get(pos), rid, IndexOp::Remove,
-                                               err)) {
-                            throw std::runtime_error(err);
-                        }
+                ConcurrentIndexBuild::record_remove(bpm_, table_meta->name, rid, old_tuple);
+                for (auto& idx : handle.indexes) {
+                    if (!apply_index_write(*idx.index, old_tuple.get(idx.column), rid,
+                                           IndexOp::Remove, err)) {
+                        throw std::runtime_error(err);
                     }
                 }
             }
@@ -586,6 +1870,7 @@ QueryResult QueryExecutor::execute_delete(const parser::DeleteStatement& stmt,
                                         old_tuple);
                 const auto lsn = log_manager_->append_log_record(log);
                 txn->set_prev_lsn(lsn);
+                static_cast<void>(table.set_page_lsn(rid.page_num, lsn));
             }
 
             if (txn != nullptr) {
@@ -610,12 +1895,9 @@ QueryResult QueryExecutor::execute_update(const parser::UpdateStatement& stmt,
     }
     const auto* table_meta = table_meta_opt.value();
 
-    Schema schema;
-    for (const auto& col : table_meta->columns) {
-        schema.add_column(col.name, col.type);
-    }
-
-    storage::HeapTable table(table_name, bpm_, schema);
+    TableHandle& handle = table_handles_.get(*table_meta);
+    storage::HeapTable& table = handle.table;
+    const Schema& schema = handle.schema;
     const uint64_t txn_id = (txn != nullptr) ? txn->get_id() : 0;
     uint64_t rows_updated = 0;
 
@@ -650,19 +1932,21 @@ QueryResult QueryExecutor::execute_update(const parser::UpdateStatement& stmt,
     }
 
     /* Phase 2: Apply Updates */
+    if (txn != nullptr) {
+        std::vector<storage::HeapTable::TupleId> rids;
+        rids.reserve(updates.size());
+        for (const auto& op : updates) rids.push_back(op.rid);
+        lock_for_write(*table_meta, rids, txn);
+    }
     for (const auto& op : updates) {
         if (table.remove(op.rid, txn_id)) {
             /* Update Indexes - Remove old, Insert new */
             std::string err;
-            for (const auto& idx_info : table_meta->indexes) {
-                if (!idx_info.column_positions.empty()) {
-                    uint16_t pos = idx_info.column_positions[0];
-                    common::ValueType ktype = table_meta->columns[pos].type;
-                    storage::BTreeIndex index(idx_info.name, bpm_, ktype);
-                    if (!apply_index_write(index, op.old_tuple.get(pos), op.rid, IndexOp::Remove,
-                                           err)) {
-                        throw std::runtime_error(err);
-                    }
+            ConcurrentIndexBuild::record_remove(bpm_, table_meta->name, op.rid, op.old_tuple);
+            for (auto& idx : handle.indexes) {
+                if (!apply_index_write(*idx.index, op.old_tuple.get(idx.column), op.rid,
+                                       IndexOp::Remove, err)) {
+                    throw std::runtime_error(err);
                 }
             }
 
@@ -673,20 +1957,21 @@ QueryResult QueryExecutor::execute_update(const parser::UpdateStatement& stmt,
                                         op.old_tuple);
                 const auto lsn = log_manager_->append_log_record(log);
                 txn->set_prev_lsn(lsn);
+                static_cast<void>(table.set_page_lsn(op.rid.page_num, lsn));
+            }
+            /* Undone and compensated as a delete and an insert, each with its own record */
+            if (txn != nullptr) {
+                txn->add_undo_log(transaction::UndoLog::Type::DELETE, table_name, op.rid);
             }
 
             const auto new_tid = table.insert(op.new_tuple, txn_id);
+            ConcurrentIndexBuild::record_insert(bpm_, table_meta->name, new_tid, op.new_tuple);
 
             /* Update Indexes - Insert new */
-            for (const auto& idx_info : table_meta->indexes) {
-                if (!idx_info.column_positions.empty()) {
-                    uint16_t pos = idx_info.column_positions[0];
-                    common::ValueType ktype = table_meta->columns[pos].type;
-                    storage::BTreeIndex index(idx_info.name, bpm_, ktype);
-                    if (!apply_index_write(index, op.new_tuple.get(pos), new_tid, IndexOp::Insert,
-                                           err)) {
-                        throw std::runtime_error(err);
-                    }
+            for (auto& idx : handle.indexes) {
+                if (!apply_index_write(*idx.index, op.new_tuple.get(idx.column), new_tid,
+                                       IndexOp::Insert, err)) {
+                    throw std::runtime_error(err);
                 }
             }
 
@@ -697,10 +1982,11 @@ QueryResult QueryExecutor::execute_update(const parser::UpdateStatement& stmt,
                                         op.new_tuple);
                 const auto lsn = log_manager_->append_log_record(log);
                 txn->set_prev_lsn(lsn);
+                static_cast<void>(table.set_page_lsn(new_tid.page_num, lsn));
             }
 
             if (txn != nullptr) {
-                txn->add_undo_log(transaction::UndoLog::Type::UPDATE, table_name, new_tid, op.rid);
+                txn->add_undo_log(transaction::UndoLog::Type::INSERT, table_name, new_tid);
             }
             rows_updated++;
         }
@@ -710,8 +1996,61 @@ QueryResult QueryExecutor::execute_update(const parser::UpdateStatement& stmt,
     return result;
 }
 
+std::string QueryExecutor::open_error(const Operator& root) const {
+    if (!exchange_error_.empty()) {
+        return exchange_error_; /* Operators above the exchange may not pass its error on */
+    }
+    return root.error().empty() ? "Failed to open execution plan" : root.error();
+}
+
+std::unique_ptr<Operator> QueryExecutor::shuffle_scan(const std::string& table) {
+    if (cluster_manager_ == nullptr) {
+        return nullptr;
+    }
+    const bool streamed = std::find(exchange_tables_.begin(), exchange_tables_.end(), table) !=
+                          exchange_tables_.end();
+    if (!streamed && !cluster_manager_->has_shuffle_data(context_id_, table)) {
+        return nullptr;
+    }
+
+    /* Unqualified names; the scan qualifies them with the table name */
+    Schema schema;
+    auto meta_opt = catalog_.get_table_by_name(table);
+    if (meta_opt.has_value()) {
+        for (const auto& col : meta_opt.value()->columns) {
+            schema.add_column(col.name, col.type);
+        }
+    }
+    if (!streamed) {
+        auto data = cluster_manager_->fetch_shuffle_data(context_id_, table);
+        return std::make_unique<BufferScanOperator>(context_id_, table, std::move(data),
+                                                    std::move(schema));
+    }
+
+    auto source = [this, table](std::vector<Tuple>& chunk, std::string& error) {
+        switch (cluster_manager_->next_shuffle_chunk(context_id_, table, exchange_senders_, chunk,
+                                                     canceled_, EXCHANGE_IDLE_TIMEOUT)) {
+            case cluster::ClusterManager::ShuffleWait::Chunk:
+                return true;
+            case cluster::ClusterManager::ShuffleWait::End:
+                return false;
+            case cluster::ClusterManager::ShuffleWait::Canceled:
+                error = "Query canceled";
+                break;
+            case cluster::ClusterManager::ShuffleWait::TimedOut:
+                error = "no shuffle data for " + std::to_string(EXCHANGE_IDLE_TIMEOUT.count()) +
+                        " ms";
+                break;
+        }
+        exchange_error_ = "Exchange " + table + ": " + error;
+        return false;
+    };
+    return std::make_unique<ExchangeScanOperator>(table, std::move(source), std::move(schema));
+}
+
 std::unique_ptr<Operator> QueryExecutor::build_plan(const parser::SelectStatement& stmt,
                                                     transaction::Transaction* txn) {
+    exchange_error_.clear();
     /* 1. Base: Initial table access (Sequential Scan or Index Scan) */
     if (!stmt.from()) {
         return nullptr;
@@ -719,32 +2058,33 @@ std::unique_ptr<Operator> QueryExecutor::build_plan(const parser::SelectStatemen
 
     const std::string base_table_name = stmt.from()->to_string();
     std::unique_ptr<Operator> current_root = nullptr;
+    bool heap_seq_scan = false; /* Base is a full scan of a local heap table */
+    std::string index_column;   /* Column an index scan fixes to one value, if any */
+    std::string order_column;   /* Column the base rows arrive sorted on, if any */
+    Schema heap_scan_schema;
+    std::vector<bool> heap_scan_columns;
+    std::shared_ptr<ParallelHeapScan> parallel_scan; /* Set when the base scan is split */
+    size_t scan_workers = 1;
 
     /* Check if table is in cluster shuffle buffers (e.g. Broadcast or Shuffle Join) */
-    if (cluster_manager_ != nullptr &&
-        cluster_manager_->has_shuffle_data(context_id_, base_table_name)) {
-        auto data = cluster_manager_->fetch_shuffle_data(context_id_, base_table_name);
-        /* We need a schema for the buffered data. Use unqualified names as BufferScan will qualify
-         * them. */
-        auto meta_opt = catalog_.get_table_by_name(base_table_name);
-        Schema buffer_schema;
-        if (meta_opt.has_value()) {
-            for (const auto& col : meta_opt.value()->columns) {
-                buffer_schema.add_column(col.name, col.type);
-            }
-        }
-
+    current_root = shuffle_scan(base_table_name);
+    const bool base_shuffled = current_root != nullptr;
+    /* System views (sys_metrics, sys_traces), unless a real table shadows the name */
+    if (!base_shuffled && !catalog_.get_table_by_name(base_table_name).has_value()) {
+        current_root = system_view_scan(base_table_name);
+    }
+    const bool base_system = !base_shuffled && current_root != nullptr;
+    if (base_shuffled) {
         std::cerr << "--- [BuildPlan] Table " << base_table_name
-                  << " found in SHUFFLE buffer. Schema size=" << buffer_schema.column_count()
-                  << " ---" << std::endl;
-        current_root = std::make_unique<BufferScanOperator>(
-            context_id_, base_table_name, std::move(data), std::move(buffer_schema));
-    } else {
+                  << " found in SHUFFLE buffer. Schema size="
+                  << current_root->output_schema().column_count() << " ---" << std::endl;
+    } else if (!base_system) {
         auto base_table_meta_opt = catalog_.get_table_by_name(base_table_name);
         if (!base_table_meta_opt.has_value()) {
             return nullptr;
         }
         const auto* base_table_meta = base_table_meta_opt.value();
+        lock_for_scan(*base_table_meta, txn);
 
         Schema base_schema;
         for (const auto& col : base_table_meta->columns) {
@@ -752,59 +2092,141 @@ std::unique_ptr<Operator> QueryExecutor::build_plan(const parser::SelectStatemen
         }
 
         /* Index Selection Optimization:
-         * If there's a simple equality filter on an indexed column, use IndexScanOperator.
+         * Comparisons of an indexed column with constants become an index range
+         * scan, preferring an index the WHERE clause fixes to one value. Without
+         * one, a single-column ORDER BY ... LIMIT on an indexed column reads the
+         * index in key order so that the sort can be skipped.
          */
         bool index_used = false;
 
-        if (stmt.where() && stmt.where()->type() == parser::ExprType::Binary &&
-            stmt.joins().empty()) {
-            const auto* bin_expr = dynamic_cast<const parser::BinaryExpr*>(stmt.where());
-            if (bin_expr->op() == parser::TokenType::Eq) {
-                std::string col_name;
-                common::Value const_val;
-                bool eligible = false;
-
-                if (bin_expr->left().type() == parser::ExprType::Column &&
-                    bin_expr->right().type() == parser::ExprType::Constant) {
-                    col_name = bin_expr->left().to_string();
-                    const_val = bin_expr->right().evaluate();
-                    eligible = true;
-                } else if (bin_expr->right().type() == parser::ExprType::Column &&
-                           bin_expr->left().type() == parser::ExprType::Constant) {
-                    col_name = bin_expr->right().to_string();
-                    const_val = bin_expr->left().evaluate();
-                    eligible = true;
+        if (stmt.joins().empty()) {
+            const IndexInfo* chosen = nullptr;
+            KeyRange chosen_range;
+            const auto& stats = base_table_meta->stats;
+            double chosen_cost = stats ? cost::seq_scan_cost(*stats) : 0.0;
+            if (stmt.where()) {
+                for (const auto& idx_info : base_table_meta->indexes) {
+                    if (idx_info.column_positions.empty()) {
+                        continue;
+                    }
+                    const uint16_t pos = idx_info.column_positions[0];
+                    const auto& col = base_table_meta->columns[pos];
+                    KeyRange range;
+                    collect_key_range(*stmt.where(), base_table_name, col.name, col.type, range);
+                    const bool hash = idx_info.index_type == IndexType::Hash;
+                    if (!range.bounded() || (hash && !range.point())) {
+                        continue;
+                    }
+                    if (stats && pos < stats->columns.size()) {
+                        /* Analyzed: the cheapest index, if cheaper than reading the table */
+                        const double selectivity =
+                            key_range_selectivity(stats->columns[pos], range);
+                        double index_cost = 0.0;
+                        if (idx_info.index_type == IndexType::BRIN) {
+                            index_cost = brin_scan_cost(bpm_, idx_info, col.type, range, *stats);
+                        } else if (hash) {
+                            index_cost = cost::hash_index_scan_cost(*stats, selectivity);
+                        } else {
+                            index_cost = cost::index_scan_cost(*stats, selectivity);
+                        }
+                        if (index_cost < chosen_cost) {
+                            chosen = &idx_info;
+                            chosen_range = std::move(range);
+                            chosen_cost = index_cost;
+                        }
+                    } else if (!stats && (chosen == nullptr || unanalyzed_rank(idx_info, range) >
+                                                                   unanalyzed_rank(*chosen,
+                                                                                   chosen_range))) {
+                        chosen = &idx_info;
+                        chosen_range = std::move(range);
+                    }
                 }
+            }
 
-                if (eligible) {
-                    /* Check if col_name is indexed */
-                    for (const auto& idx_info : base_table_meta->indexes) {
-                        if (!idx_info.column_positions.empty()) {
-                            uint16_t pos = idx_info.column_positions[0];
-                            /* Handle both qualified and unqualified names */
-                            if (base_table_meta->columns[pos].name == col_name ||
-                                (base_table_name + "." + base_table_meta->columns[pos].name) ==
-                                    col_name) {
-                                common::ValueType ktype = base_table_meta->columns[pos].type;
-                                current_root = std::make_unique<IndexScanOperator>(
-                                    std::make_unique<storage::HeapTable>(base_table_name, bpm_,
-                                                                         base_schema),
-                                    std::make_unique<storage::BTreeIndex>(idx_info.name, bpm_,
-                                                                          ktype),
-                                    std::move(const_val), txn, &lock_manager_);
-                                index_used = true;
-                                break;
-                            }
-                        }
+            const bool plain_select =
+                stmt.group_by().empty() &&
+                std::none_of(stmt.columns().begin(), stmt.columns().end(),
+                             [](const std::unique_ptr<parser::Expression>& col) {
+                                 return col->type() == parser::ExprType::Function;
+                             });
+            if (chosen == nullptr && plain_select && stmt.order_by().size() == 1 &&
+                stmt.has_limit() && stmt.limit() >= 0) {
+                for (const auto& idx_info : base_table_meta->indexes) {
+                    if (!idx_info.column_positions.empty() &&
+                        idx_info.index_type == IndexType::BTree &&
+                        is_column_ref(
+                            *stmt.order_by()[0], base_table_name,
+                            base_table_meta->columns[idx_info.column_positions[0]].name)) {
+                        chosen = &idx_info;
+                        break;
                     }
                 }
             }
+
+            if (chosen != nullptr && chosen->index_type == IndexType::BRIN) {
+                /* Rows come back in heap order from the selected pages; the filter rechecks */
+                const auto& key_col = base_table_meta->columns[chosen->column_positions[0]];
+                auto table = std::make_unique<storage::HeapTable>(base_table_name, bpm_,
+                                                                  base_schema);
+                table->set_read_columns(read_columns(stmt, *base_table_meta));
+                current_root = std::make_unique<BitmapHeapScanOperator>(
+                    std::move(table),
+                    std::make_unique<storage::BrinIndex>(chosen->name, bpm_, key_col.type),
+                    chosen_range.lower, chosen_range.upper, txn, &lock_manager_);
+                index_used = true;
+            } else if (chosen != nullptr) {
+                const uint16_t pos = chosen->column_positions[0];
+                const auto& key_col = base_table_meta->columns[pos];
+
+                IndexScanOptions options;
+                options.lower = chosen_range.lower;
+                options.upper = chosen_range.upper;
+                options.key_column = pos;
+
+                /* Index-only scan when nothing but the key is read */
+                const auto reads_key = [&](const std::unique_ptr<parser::Expression>& expr) {
+                    return reads_only_column(*expr, base_table_name, key_col.name);
+                };
+                options.key_only =
+                    !stmt.columns().empty() &&
+                    std::all_of(stmt.columns().begin(), stmt.columns().end(), reads_key) &&
+                    std::all_of(stmt.order_by().begin(), stmt.order_by().end(), reads_key) &&
+                    std::all_of(stmt.group_by().begin(), stmt.group_by().end(), reads_key) &&
+                    (!stmt.where() || reads_only_column(*stmt.where(), base_table_name,
+                                                        key_col.name)) &&
+                    (!stmt.having() || reads_only_column(*stmt.having(), base_table_name,
+                                                         key_col.name));
+
+                auto table = std::make_unique<storage::HeapTable>(base_table_name, bpm_,
+                                                                  base_schema);
+                table->set_read_columns(read_columns(stmt, *base_table_meta));
+                current_root = std::make_unique<IndexScanOperator>(
+                    std::move(table),
+                    open_index(*chosen, key_col.type, bpm_),
+                    std::move(options), txn, &lock_manager_);
+                index_used = true;
+                order_column = key_col.name;
+                if (chosen_range.equality) {
+                    index_column = key_col.name;
+                }
+            }
         }
 
         if (!index_used) {
-            current_root = std::make_unique<SeqScanOperator>(
-                std::make_unique<storage::HeapTable>(base_table_name, bpm_, base_schema), txn,
-                &lock_manager_);
+            heap_scan_schema = base_schema;
+            heap_scan_columns = read_columns(stmt, *base_table_meta);
+            heap_seq_scan = true;
+            auto table = std::make_unique<storage::HeapTable>(base_table_name, bpm_, base_schema);
+            table->set_read_columns(heap_scan_columns);
+            /* A large table read on its own is split into page ranges among workers */
+            if (stmt.joins().empty()) {
+                const uint32_t pages = table->page_count();
+                scan_workers = ParallelHeapScan::plan_workers(pages);
+                if (scan_workers > 1) {
+                    parallel_scan = std::make_shared<ParallelHeapScan>(pages);
+                }
+            }
+            current_root = std::make_unique<SeqScanOperator>(std::move(table), txn, &lock_manager_);
         }
     }
 
@@ -813,88 +2235,99 @@ std::unique_ptr<Operator> QueryExecutor::build_plan(const parser::SelectStatemen
     std::cerr << "--- [BuildPlan] Base root schema size="
               << current_root->output_schema().column_count() << " ---" << std::endl;
 
-    /* 2. Add JOINs */
-    for (const auto& join : stmt.joins()) {
+    /* 2. Add JOINs
+     * With statistics on every table, inner joins are reordered: the FROM table
+     * stays first and the cost model picks the order of the rest. Each hash join
+     * builds on the input estimated to be smaller.
+     */
+    const auto& joins = stmt.joins();
+    std::optional<JoinGraph> graph;
+    const bool shuffled =
+        base_shuffled || base_system || !exchange_tables_.empty() ||
+        (cluster_manager_ != nullptr &&
+         std::any_of(joins.begin(), joins.end(), [this](const auto& join) {
+             return cluster_manager_->has_shuffle_data(context_id_, join.table->to_string());
+         }));
+    if (!joins.empty() && !shuffled) {
+        graph = build_join_graph(stmt, catalog_);
+    }
+
+    /* order[i]: the relation joined at step i; relation j + 1 is joins[j] */
+    std::vector<size_t> order(joins.size() + 1);
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    bool reordered = false;
+    const bool all_inner = std::all_of(joins.begin(), joins.end(), [](const auto& join) {
+        return join.type == parser::SelectStatement::JoinType::Inner;
+    });
+    if (graph && all_inner && joins.size() >= 2) {
+        auto best = cost::order_joins(graph->rows, graph->edges);
+        if (!best.empty() && cost::join_order_cost(graph->rows, graph->edges, best) <
+                                 cost::join_order_cost(graph->rows, graph->edges, order)) {
+            order = std::move(best);
+            reordered = true;
+        }
+    }
+
+    /* Join conditions not applied yet; a reordered plan may reach them in any order */
+    std::vector<const parser::Expression*> pending;
+    if (reordered) {
+        for (const auto& join : joins) pending.push_back(join.condition.get());
+    }
+    double joined_rows = graph ? graph->rows[0] : 0.0;
+    uint32_t joined = 1;
+
+    for (size_t step = 1; step < order.size(); ++step) {
+        const size_t relation = order[step];
+        const auto& join = joins[relation - 1];
         const std::string join_table_name = join.table->to_string();
+        if (!reordered) {
+            pending.assign(1, join.condition.get());
+        }
 
         std::unique_ptr<Operator> join_scan = nullptr;
 
-        /* Check if JOIN table is in shuffle buffers */
-        if (cluster_manager_ != nullptr &&
-            cluster_manager_->has_shuffle_data(context_id_, join_table_name)) {
-            auto data = cluster_manager_->fetch_shuffle_data(context_id_, join_table_name);
-            auto meta_opt = catalog_.get_table_by_name(join_table_name);
-            Schema buffer_schema;
-            if (meta_opt.has_value()) {
-                for (const auto& col : meta_opt.value()->columns) {
-                    buffer_schema.add_column(col.name, col.type);
-                }
-            }
-
+        /* Check if JOIN table is in shuffle buffers; as the build side it is hashed on arrival */
+        join_scan = shuffle_scan(join_table_name);
+        if (join_scan) {
             std::cerr << "--- [BuildPlan] JOIN Table " << join_table_name
-                      << " found in SHUFFLE buffer. Schema size=" << buffer_schema.column_count()
-                      << " ---" << std::endl;
-            join_scan = std::make_unique<BufferScanOperator>(
-                context_id_, join_table_name, std::move(data), std::move(buffer_schema));
+                      << " found in SHUFFLE buffer. Schema size="
+                      << join_scan->output_schema().column_count() << " ---" << std::endl;
         } else {
             auto join_table_meta_opt = catalog_.get_table_by_name(join_table_name);
             if (!join_table_meta_opt.has_value()) {
                 return nullptr;
             }
             const auto* join_table_meta = join_table_meta_opt.value();
+            lock_for_scan(*join_table_meta, txn);
 
             Schema join_schema;
             for (const auto& col : join_table_meta->columns) {
                 join_schema.add_column(col.name, col.type);
             }
 
-            join_scan = std::make_unique<SeqScanOperator>(
-                std::make_unique<storage::HeapTable>(join_table_name, bpm_, join_schema), txn,
-                &lock_manager_);
+            auto table = std::make_unique<storage::HeapTable>(join_table_name, bpm_, join_schema);
+            table->set_read_columns(read_columns(stmt, *join_table_meta));
+            join_scan = std::make_unique<SeqScanOperator>(std::move(table), txn, &lock_manager_);
             std::cerr << "--- [BuildPlan] JOIN Table " << join_table_name
                       << " from LOCAL. Schema size=" << join_scan->output_schema().column_count()
                       << " ---" << std::endl;
         }
 
-        bool use_hash_join = false;
+        /* First pending condition with one side in each input becomes the hash key */
         std::unique_ptr<parser::Expression> left_key = nullptr;
         std::unique_ptr<parser::Expression> right_key = nullptr;
-
-        if (join.condition && join.condition->type() == parser::ExprType::Binary) {
-            const auto* bin_expr = dynamic_cast<const parser::BinaryExpr*>(join.condition.get());
-            if (bin_expr != nullptr && bin_expr->op() == parser::TokenType::Eq) {
-                /* Check which side of Eq belongs to which table */
-                const auto left_side_schema = current_root->output_schema();
-                const auto right_side_schema = join_scan->output_schema();
-
-                const std::string left_col_name = bin_expr->left().to_string();
-                const std::string right_col_name = bin_expr->right().to_string();
-
-                const bool left_in_left =
-                    (left_side_schema.find_column(left_col_name) != static_cast<size_t>(-1));
-                const bool right_in_right =
-                    (right_side_schema.find_column(right_col_name) != static_cast<size_t>(-1));
-
-                if (left_in_left && right_in_right) {
-                    use_hash_join = true;
-                    left_key = bin_expr->left().clone();
-                    right_key = bin_expr->right().clone();
-                } else {
-                    const bool left_in_right =
-                        (right_side_schema.find_column(left_col_name) != static_cast<size_t>(-1));
-                    const bool right_in_left =
-                        (left_side_schema.find_column(right_col_name) != static_cast<size_t>(-1));
-
-                    if (left_in_right && right_in_left) {
-                        use_hash_join = true;
-                        left_key = bin_expr->right().clone();
-                        right_key = bin_expr->left().clone();
-                    }
-                }
+        auto key_condition = pending.end();
+        for (auto it = pending.begin(); it != pending.end(); ++it) {
+            if (*it != nullptr &&
+                split_join_keys(**it, current_root->output_schema(), join_scan->output_schema(),
+                                &left_key, &right_key)) {
+                key_condition = it;
+                break;
             }
         }
 
-        if (use_hash_join) {
+        if (key_condition != pending.end()) {
+            pending.erase(key_condition);
             executor::JoinType exec_join_type = executor::JoinType::Inner;
             if (join.type == parser::SelectStatement::JoinType::Left) {
                 exec_join_type = executor::JoinType::Left;
@@ -904,19 +2337,80 @@ std::unique_ptr<Operator> QueryExecutor::build_plan(const parser::SelectStatemen
                 exec_join_type = executor::JoinType::Full;
             }
 
+            bool build_left = false;
+            if (graph) {
+                build_left = joined_rows < graph->rows[relation];
+                joined_rows *= graph->rows[relation];
+                for (const auto& edge : graph->edges) {
+                    const bool links =
+                        (edge.left == relation && (joined & (1U << edge.right)) != 0) ||
+                        (edge.right == relation && (joined & (1U << edge.left)) != 0);
+                    if (links) joined_rows *= edge.selectivity;
+                }
+                joined_rows = std::max(joined_rows, 1.0);
+                joined |= 1U << relation;
+            }
+
             current_root = std::make_unique<HashJoinOperator>(
                 std::move(current_root), std::move(join_scan), std::move(left_key),
-                std::move(right_key), exec_join_type);
+                std::move(right_key), exec_join_type, 0, build_left);
             std::cerr << "--- [BuildPlan] Added HashJoin. Combined schema size="
                       << current_root->output_schema().column_count() << " ---" << std::endl;
         } else {
             /* TODO: Implement NestedLoopJoin for non-equality or missing conditions */
             return nullptr;
         }
+
+        /* Conditions between tables already joined filter the joined rows */
+        for (auto it = pending.begin(); it != pending.end();) {
+            const auto& cond = static_cast<const parser::BinaryExpr&>(**it);
+            const Schema& schema = current_root->output_schema();
+            if (schema.find_column(cond.left().to_string()) != static_cast<size_t>(-1) &&
+                schema.find_column(cond.right().to_string()) != static_cast<size_t>(-1)) {
+                current_root = std::make_unique<FilterOperator>(std::move(current_root),
+                                                                (*it)->clone());
+                it = pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
     }
 
-    /* 3. Filter (WHERE) - Only if not already handled by IndexScan */
-    if (stmt.where()) {
+    /* Restore the written column order, which unqualified names resolve against */
+    if (reordered) {
+        std::vector<std::unique_ptr<parser::Expression>> columns;
+        for (const auto* table : graph->tables) {
+            for (const auto& col : table->columns) {
+                columns.push_back(std::make_unique<parser::ColumnExpr>(table->name, col.name));
+            }
+        }
+        current_root =
+            std::make_unique<ProjectOperator>(std::move(current_root), std::move(columns));
+    }
+
+    /* One copy of scan, WHERE and `stack` per worker of a split base scan, gathered */
+    const auto gather = [&](const std::function<std::unique_ptr<Operator>(
+                                std::unique_ptr<Operator>)>& stack) {
+        std::vector<std::unique_ptr<Operator>> workers;
+        for (size_t i = 0; i < scan_workers; ++i) {
+            auto table =
+                std::make_unique<storage::HeapTable>(base_table_name, bpm_, heap_scan_schema);
+            table->set_read_columns(heap_scan_columns);
+            auto scan = std::make_unique<SeqScanOperator>(std::move(table), txn, &lock_manager_);
+            scan->set_parallel_scan(parallel_scan);
+            std::unique_ptr<Operator> pipeline = std::move(scan);
+            if (stmt.where()) {
+                pipeline =
+                    std::make_unique<FilterOperator>(std::move(pipeline), stmt.where()->clone());
+            }
+            workers.push_back(stack ? stack(std::move(pipeline)) : std::move(pipeline));
+        }
+        return std::make_unique<GatherOperator>(std::move(workers), parallel_scan);
+    };
+
+    /* 3. Filter (WHERE) - Only if not already handled by IndexScan; a split scan filters
+     * in its workers */
+    if (stmt.where() && !parallel_scan) {
         current_root =
             std::make_unique<FilterOperator>(std::move(current_root), stmt.where()->clone());
     }
@@ -951,6 +2445,11 @@ std::unique_ptr<Operator> QueryExecutor::build_plan(const parser::SelectStatemen
                 AggregateInfo info;
                 info.type = type;
                 info.expr = (!func->args().empty()) ? func->args()[0]->clone() : nullptr;
+                /* COUNT(*) counts rows: the parser hands '*' over as a column */
+                if (info.expr && info.expr->type() == parser::ExprType::Column &&
+                    info.expr->to_string() == "*") {
+                    info.expr = nullptr;
+                }
                 info.is_distinct = func->distinct();
 
                 /* Normalize aggregate name for schema lookup */
@@ -966,13 +2465,83 @@ std::unique_ptr<Operator> QueryExecutor::build_plan(const parser::SelectStatemen
         }
     }
 
-    if (!stmt.group_by().empty() || has_aggregates) {
+    const bool aggregating = !stmt.group_by().empty() || has_aggregates;
+    if (parallel_scan && !aggregating) {
+        current_root = gather(nullptr);
+    }
+
+    const auto clone_group_by = [&stmt]() {
         std::vector<std::unique_ptr<parser::Expression>> group_by;
         for (const auto& gb : stmt.group_by()) {
             group_by.push_back(gb->clone());
         }
-        current_root = std::make_unique<AggregateOperator>(std::move(current_root),
-                                                           std::move(group_by), std::move(aggs));
+        return group_by;
+    };
+
+    if (aggregating) {
+        /* Aggregates over a single heap table run batch-at-a-time when they can; over a
+         * split scan each worker aggregates its rows and the groups are merged after */
+        std::unique_ptr<Operator> batch_root = nullptr;
+        /* A columnar replica answers them outside explicit transactions, which read
+         * their own snapshot and writes from the heap */
+        if (heap_seq_scan && stmt.joins().empty() && replicas_ != nullptr &&
+            current_txn_ == nullptr) {
+            if (auto replica = replicas_->snapshot(base_table_name)) {
+                batch_root = plan_batch_aggregate(
+                    stmt,
+                    std::make_unique<VectorizedSeqScanOperator>(
+                        base_table_name + " (columnar replica)", std::move(replica)),
+                    aggs, txn);
+            }
+        }
+        const bool partial =
+            !batch_root && parallel_scan &&
+            std::none_of(aggs.begin(), aggs.end(),
+                         [](const AggregateInfo& agg) { return agg.is_distinct; });
+        if (heap_seq_scan && stmt.joins().empty() && !partial && !batch_root) {
+            batch_root = plan_batch_aggregate(
+                stmt,
+                std::make_unique<VectorizedHeapScanOperator>(
+                    std::make_unique<storage::HeapTable>(base_table_name, bpm_, heap_scan_schema),
+                    txn),
+                aggs, txn);
+        }
+        if (partial) {
+            AggregateOptions options;
+            options.spill_dir = bpm_.get_storage_manager().data_dir();
+            options.mode = AggregateMode::Partial;
+            current_root = gather([&](std::unique_ptr<Operator> input) {
+                std::vector<AggregateInfo> partial_aggs;
+                for (const auto& agg : aggs) {
+                    AggregateInfo info;
+                    info.type = agg.type;
+                    info.expr = agg.expr ? agg.expr->clone() : nullptr;
+                    info.name = agg.name;
+                    partial_aggs.push_back(std::move(info));
+                }
+                return std::make_unique<AggregateOperator>(std::move(input), clone_group_by(),
+                                                           std::move(partial_aggs), options);
+            });
+            options.mode = AggregateMode::Final;
+            current_root = std::make_unique<AggregateOperator>(
+                std::move(current_root), clone_group_by(), std::move(aggs), std::move(options));
+        } else if (batch_root) {
+            current_root = std::move(batch_root);
+        } else {
+            if (parallel_scan) {
+                current_root = gather(nullptr);
+            }
+            /* An index point lookup returns a single group when grouping by its column */
+            AggregateOptions options;
+            options.spill_dir = bpm_.get_storage_manager().data_dir();
+            options.input_grouped =
+                !index_column.empty() && stmt.joins().empty() && stmt.group_by().size() == 1 &&
+                stmt.group_by()[0]->type() == parser::ExprType::Column &&
+                (stmt.group_by()[0]->to_string() == index_column ||
+                 stmt.group_by()[0]->to_string() == base_table_name + "." + index_column);
+            current_root = std::make_unique<AggregateOperator>(
+                std::move(current_root), clone_group_by(), std::move(aggs), std::move(options));
+        }
 
         /* 3.5. Having */
         if (stmt.having()) {
@@ -981,22 +2550,38 @@ std::unique_ptr<Operator> QueryExecutor::build_plan(const parser::SelectStatemen
         }
     }
 
-    /* 4. Sort (ORDER BY) */
-    if (!stmt.order_by().empty()) {
+    /* 4. Sort (ORDER BY), unless the index scan already returns rows in that order */
+    const bool presorted = !order_column.empty() && stmt.joins().empty() &&
+                           stmt.group_by().empty() && !has_aggregates &&
+                           stmt.order_by().size() == 1 &&
+                           is_column_ref(*stmt.order_by()[0], base_table_name, order_column);
+    if (!stmt.order_by().empty() && !presorted) {
         std::vector<std::unique_ptr<parser::Expression>> sort_keys;
         std::vector<bool> ascending;
         for (const auto& ob : stmt.order_by()) {
             sort_keys.push_back(ob->clone());
             ascending.push_back(true); /* Default to ASC */
         }
+        /* Projection keeps rows 1:1, so a LIMIT above it bounds the sort to a top-N */
+        SortOptions options;
+        options.spill_dir = bpm_.get_storage_manager().data_dir();
+        if (stmt.has_limit() && stmt.limit() > 0) {
+            options.limit = static_cast<size_t>(stmt.limit() + std::max<int64_t>(stmt.offset(), 0));
+        }
         current_root = std::make_unique<SortOperator>(std::move(current_root), std::move(sort_keys),
-                                                      std::move(ascending));
+                                                      std::move(ascending), std::move(options));
     }
 
-    /* 5. Project (SELECT columns) */
+    /* 5. Project (SELECT columns); `*` stands for every column of the input */
     if (!stmt.columns().empty()) {
         std::vector<std::unique_ptr<parser::Expression>> projection;
         for (const auto& col : stmt.columns()) {
+            if (col->type() == parser::ExprType::Column && col->to_string() == "*") {
+                for (const auto& input_col : current_root->output_schema().columns()) {
+                    projection.push_back(std::make_unique<parser::ColumnExpr>(input_col.name()));
+                }
+                continue;
+            }
             projection.push_back(col->clone());
         }
         current_root =
@@ -1014,6 +2599,126 @@ std::unique_ptr<Operator> QueryExecutor::build_plan(const parser::SelectStatemen
     return current_root;
 }
 
+QueryResult QueryExecutor::execute_analyze(const parser::AnalyzeStatement& stmt,
+                                           transaction::Transaction* txn) {
+    QueryResult result;
+    std::vector<TableInfo*> tables;
+    if (stmt.table_name().empty()) {
+        tables = catalog_.get_all_tables();
+    } else {
+        auto table_meta_opt = catalog_.get_table_by_name(stmt.table_name());
+        if (!table_meta_opt.has_value()) {
+            result.set_error("Table not found: " + stmt.table_name());
+            return result;
+        }
+        tables.push_back(table_meta_opt.value());
+    }
+
+    for (const auto* table_meta : tables) {
+        Schema schema;
+        for (const auto& col : table_meta->columns) {
+            schema.add_column(col.name, col.type);
+        }
+        storage::HeapTable table(table_meta->name, bpm_, schema);
+        static_cast<void>(
+            catalog_.set_table_stats(table_meta->table_id, analyze_table(table, txn)));
+    }
+
+    result.set_rows_affected(tables.size());
+    return result;
+}
+
+QueryResult QueryExecutor::execute_vacuum(const parser::VacuumStatement& stmt) {
+    QueryResult result;
+    if (current_txn_ != nullptr) {
+        result.set_error("VACUUM cannot run inside a transaction block");
+        return result;
+    }
+
+    transaction::VacuumManager vacuum(catalog_, bpm_, transaction_manager_);
+    transaction::VacuumStats stats;
+    if (stmt.table_name().empty()) {
+        stats = vacuum.vacuum_all();
+    } else {
+        auto table_meta_opt = catalog_.get_table_by_name(stmt.table_name());
+        if (!table_meta_opt.has_value()) {
+            result.set_error("Table not found: " + stmt.table_name());
+            return result;
+        }
+        stats = vacuum.vacuum_table(*table_meta_opt.value());
+    }
+
+    result.set_rows_affected(stats.tuples_removed);
+    return result;
+}
+
+QueryResult QueryExecutor::execute_explain(const parser::ExplainStatement& stmt,
+                                           transaction::Transaction* txn) {
+    QueryResult result;
+    if (stmt.statement().type() != parser::StmtType::Select) {
+        result.set_error("EXPLAIN supports SELECT statements only");
+        return result;
+    }
+    const auto& select = dynamic_cast<const parser::SelectStatement&>(stmt.statement());
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto memory = make_query_memory();
+    const common::MemoryTracker::Scope memory_scope(memory.get());
+    std::unique_ptr<Operator> root;
+    {
+        /* Operators keep statistics only if they are built inside the scope */
+        std::optional<InstrumentScope> scope;
+        if (stmt.analyze()) {
+            scope.emplace();
+        }
+        root = build_plan(select, txn);
+    }
+    if (!root) {
+        result.set_error("Failed to build execution plan (check table existence and FROM clause)");
+        return result;
+    }
+    const auto planned = std::chrono::steady_clock::now();
+
+    if (stmt.analyze()) {
+        const std::string unreadable = prepare_shard_read();
+        if (!unreadable.empty()) {
+            result.set_error(unreadable);
+            return result;
+        }
+        if (!root->init() || !root->open()) {
+            result.set_error(open_error(*root));
+            return result;
+        }
+        Tuple tuple;
+        while (root->next(tuple)) {
+            if (canceled_ != nullptr && canceled_->load(std::memory_order_relaxed)) {
+                root->close();
+                result.set_error("Query canceled");
+                return result;
+            }
+        }
+        root->close();
+    }
+    const auto finished = std::chrono::steady_clock::now();
+
+    ExplainNode plan;
+    root->explain(plan);
+    std::vector<std::string> lines = render_explain(plan);
+    if (stmt.analyze()) {
+        lines.push_back("Planning Time: " + format_ms(planned - start) + " ms");
+        lines.push_back("Execution Time: " + format_ms(finished - planned) + " ms");
+        lines.push_back("Peak Memory: " + std::to_string((memory->peak() + 1023) / 1024) + " kB");
+    }
+
+    Schema schema;
+    schema.add_column("QUERY PLAN", common::ValueType::TYPE_TEXT);
+    result.set_schema(schema);
+    for (const auto& line : lines) {
+        result.add_row(Tuple({common::Value::make_text(line)}));
+    }
+    return result;
+}
+
 QueryResult QueryExecutor::execute_drop_table(const parser::DropTableStatement& stmt) {
     QueryResult result;
     auto table_meta_opt = catalog_.get_table_by_name(stmt.table_name());
@@ -1033,13 +2738,15 @@ QueryResult QueryExecutor::execute_drop_table(const parser::DropTableStatement&
     /* 1. Drop associated indexes from physical storage */
     const auto indexes = catalog_.get_table_indexes(table_id);
     for (const auto& idx_info : indexes) {
-        storage::BTreeIndex idx(idx_info->name, bpm_, common::ValueType::TYPE_NULL);
-        static_cast<void>(idx.drop());
+        static_cast<void>(open_index(*idx_info, common::ValueType::TYPE_NULL, bpm_)->drop());
     }
 
-    /* 2. Drop table physical file */
+    /* 2. Drop table physical file, and the columnar replica's */
     storage::HeapTable table(stmt.table_name(), bpm_, executor::Schema());
     static_cast<void>(table.drop());
+    if (replicas_ != nullptr) {
+        replicas_->detach(stmt.table_name());
+    }
 
     /* 3. Update catalog */
     if (is_local_only_) {
@@ -1063,10 +2770,12 @@ QueryResult QueryExecutor::execute_drop_index(const parser::DropIndexStatement&
 
     /* Find index by name since catalog doesn't have direct get_index_by_name */
     oid_t index_id = 0;
+    IndexInfo index_info;
     for (auto* table : catalog_.get_all_tables()) {
         for (auto& idx : table->indexes) {
             if (idx.name == stmt.index_name()) {
                 index_id = idx.index_id;
+                index_info = idx;
                 break;
             }
         }
@@ -1085,8 +2794,7 @@ QueryResult QueryExecutor::execute_drop_index(const parser::DropIndexStatement&
     }
 
     /* 1. Drop physical file */
-    storage::BTreeIndex idx(stmt.index_name(), bpm_, common::ValueType::TYPE_NULL);
-    static_cast<void>(idx.drop());
+    static_cast<void>(open_index(index_info, common::ValueType::TYPE_NULL, bpm_)->drop());
 
     /* 2. Update catalog */
     if (!catalog_.drop_index(index_id)) {
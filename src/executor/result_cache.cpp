@@ -0,0 +1,314 @@
+/**
+ * @file result_cache.cpp
+ * @brief Query result cache implementation
+ */
+
+#include "executor/result_cache.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "common/value.hpp"
+#include "parser/expression.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+void append_text(std::string& out, std::string_view text) {
+    out += std::to_string(text.size());
+    out.push_back(':');
+    out.append(text);
+}
+
+/** @brief Appends `value` so that values of different type or contents never append alike */
+void append_value(std::string& out, const common::Value& value) {
+    out += std::to_string(static_cast<int>(value.type()));
+    out.push_back('=');
+    if (value.is_null()) {
+        return;
+    }
+    switch (value.type()) {
+        case common::ValueType::TYPE_BOOL:
+        case common::ValueType::TYPE_INT8:
+        case common::ValueType::TYPE_INT16:
+        case common::ValueType::TYPE_INT32:
+        case common::ValueType::TYPE_INT64:
+            out += std::to_string(value.to_int64());
+            break;
+        case common::ValueType::TYPE_FLOAT32:
+        case common::ValueType::TYPE_FLOAT64: {
+            /* Exact bits: printed doubles round */
+            const double v = value.to_float64();
+            uint64_t bits = 0;
+            std::memcpy(&bits, &v, sizeof(bits));
+            out += std::to_string(bits);
+            break;
+        }
+        case common::ValueType::TYPE_CHAR:
+        case common::ValueType::TYPE_VARCHAR:
+        case common::ValueType::TYPE_TEXT:
+            append_text(out, value.text_view());
+            break;
+        default:
+            append_text(out, value.to_string());
+            break;
+    }
+    out.push_back(';');
+}
+
+/**
+ * @brief Appends `expr` fully bracketed, placeholders as their bound values
+ * @return false for an expression the key cannot describe
+ */
+bool append_expr(std::string& out, const parser::Expression& expr) {  // NOLINT(misc-no-recursion)
+    switch (expr.type()) {
+        case parser::ExprType::Binary: {
+            const auto& bin = dynamic_cast<const parser::BinaryExpr&>(expr);
+            out += "(b" + std::to_string(static_cast<int>(bin.op())) + ' ';
+            if (!append_expr(out, bin.left()) || !append_expr(out, bin.right())) {
+                return false;
+            }
+            break;
+        }
+        case parser::ExprType::Unary: {
+            const auto& unary = dynamic_cast<const parser::UnaryExpr&>(expr);
+            out += "(u" + std::to_string(static_cast<int>(unary.op())) + ' ';
+            if (!append_expr(out, unary.expr())) {
+                return false;
+            }
+            break;
+        }
+        case parser::ExprType::Column: {
+            const auto& col = dynamic_cast<const parser::ColumnExpr&>(expr);
+            out += "(c";
+            append_text(out, col.table_name());
+            append_text(out, col.name());
+            break;
+        }
+        case parser::ExprType::Constant:
+            out += "(k";
+            append_value(out, dynamic_cast<const parser::ConstantExpr&>(expr).value());
+            break;
+        case parser::ExprType::Function: {
+            const auto& func = dynamic_cast<const parser::FunctionExpr&>(expr);
+            out += func.distinct() ? "(fd" : "(f";
+            append_text(out, func.name());
+            for (const auto& arg : func.args()) {
+                if (!append_expr(out, *arg)) {
+                    return false;
+                }
+            }
+            break;
+        }
+        case parser::ExprType::In: {
+            const auto& in = dynamic_cast<const parser::InExpr&>(expr);
+            out += in.not_flag() ? "(ni " : "(i ";
+            if (!append_expr(out, in.column())) {
+                return false;
+            }
+            for (const auto& value : in.values()) {
+                if (!append_expr(out, *value)) {
+                    return false;
+                }
+            }
+            break;
+        }
+        case parser::ExprType::IsNull: {
+            const auto& is_null = dynamic_cast<const parser::IsNullExpr&>(expr);
+            out += is_null.not_flag() ? "(nn " : "(n ";
+            if (!append_expr(out, is_null.expr())) {
+                return false;
+            }
+            break;
+        }
+        default:
+            return false;
+    }
+    out.push_back(')');
+    return true;
+}
+
+bool append_list(std::string& out, char tag,
+                 const std::vector<std::unique_ptr<parser::Expression>>& exprs) {
+    out.push_back(tag);
+    for (const auto& expr : exprs) {
+        if (!append_expr(out, *expr)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** @return The statement as a key, or empty if part of it cannot be described */
+std::string statement_key(const parser::SelectStatement& stmt) {
+    std::string key = stmt.distinct() ? "SD" : "S";
+    if (!append_list(key, 'C', stmt.columns()) || !append_expr(key, *stmt.from())) {
+        return {};
+    }
+    for (const auto& join : stmt.joins()) {
+        key += "J" + std::to_string(static_cast<int>(join.type));
+        if (!append_expr(key, *join.table) ||
+            (join.condition && !append_expr(key, *join.condition))) {
+            return {};
+        }
+    }
+    key.push_back('W');
+    if ((stmt.where() != nullptr && !append_expr(key, *stmt.where())) ||
+        !append_list(key, 'G', stmt.group_by())) {
+        return {};
+    }
+    key.push_back('H');
+    if ((stmt.having() != nullptr && !append_expr(key, *stmt.having())) ||
+        !append_list(key, 'O', stmt.order_by())) {
+        return {};
+    }
+    key += "L" + std::to_string(stmt.limit()) + "F" + std::to_string(stmt.offset());
+    return key;
+}
+
+/** @return An estimate of the memory `row` takes */
+size_t row_bytes(const Tuple& row) {
+    size_t bytes = sizeof(Tuple) + row.size() * sizeof(common::Value);
+    for (size_t i = 0; i < row.size(); ++i) {
+        const common::Value& value = row.get(i);
+        if (!value.is_null() && (value.type() == common::ValueType::TYPE_TEXT ||
+                                 value.type() == common::ValueType::TYPE_VARCHAR ||
+                                 value.type() == common::ValueType::TYPE_CHAR)) {
+            const size_t size = value.text_view().size();
+            bytes += size > common::Value::INLINE_TEXT_CAPACITY ? size : 0;
+        }
+    }
+    return bytes;
+}
+
+}  // namespace
+
+ResultCache::ResultCache(size_t capacity_bytes) : capacity_(capacity_bytes) {
+    metrics_ = common::MetricsRegistry::global().add_collector([this](common::MetricsSnapshot& out) {
+        const auto value = [](const std::atomic<uint64_t>& v) {
+            return static_cast<double>(v.load(std::memory_order_relaxed));
+        };
+        out.add_counter("cloudsql_result_cache_hits_total", "SELECTs answered from the cache",
+                        value(hits_));
+        out.add_counter("cloudsql_result_cache_misses_total",
+                        "Cacheable SELECTs that had to run", value(misses_));
+        out.add_counter("cloudsql_result_cache_evictions_total",
+                        "Results evicted to stay within capacity", value(evictions_));
+        out.add_counter("cloudsql_result_cache_invalidations_total",
+                        "Results dropped because a table they read changed",
+                        value(invalidations_));
+        out.add_gauge("cloudsql_result_cache_bytes", "Estimated memory held by cached results",
+                      static_cast<double>(bytes()));
+        out.add_gauge("cloudsql_result_cache_entries", "Results cached",
+                      static_cast<double>(size()));
+    });
+}
+
+ResultCache::Probe ResultCache::probe(Catalog& catalog, const parser::SelectStatement& stmt) {
+    Probe probe;
+    if (stmt.from() == nullptr) {
+        return probe;
+    }
+    std::vector<std::string> names = {stmt.from()->to_string()};
+    for (const auto& join : stmt.joins()) {
+        names.push_back(join.table->to_string());
+    }
+    probe.versions.catalog = catalog.get_version();
+    for (auto& name : names) {
+        if (!catalog.get_table_by_name(name).has_value()) {
+            return Probe{};
+        }
+        const uint64_t version = catalog.data_version(name);
+        probe.versions.tables.emplace_back(std::move(name), version);
+    }
+    probe.key = statement_key(stmt);
+    return probe;
+}
+
+std::optional<QueryResult> ResultCache::lookup(const Probe& probe) {
+    if (probe.key.empty()) {
+        return std::nullopt;
+    }
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    const auto found = index_.find(probe.key);
+    if (found != index_.end()) {
+        if (found->second->versions == probe.versions) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            entries_.splice(entries_.begin(), entries_, found->second);
+            return found->second->result;
+        }
+        invalidations_.fetch_add(1, std::memory_order_relaxed);
+        erase(found->second);
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+}
+
+void ResultCache::insert(const Probe& probe, const QueryResult& result) {
+    if (probe.key.empty() || !result.success()) {
+        return;
+    }
+    size_t bytes = sizeof(Entry) + probe.key.size() * 2;
+    for (const auto& row : result.rows()) {
+        bytes += row_bytes(row);
+    }
+    if (bytes > capacity_ / MAX_ENTRY_SHARE) {
+        return;
+    }
+
+    /* Rows copied off the executor's arena, which is reused */
+    Entry entry{probe.key, probe.versions, QueryResult(), bytes};
+    entry.result.set_schema(result.schema());
+    entry.result.rows().reserve(result.row_count());
+    for (const auto& row : result.rows()) {
+        entry.result.add_row(Tuple(row));
+    }
+
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    const auto found = index_.find(probe.key);
+    if (found != index_.end()) {
+        erase(found->second);
+    }
+    while (!entries_.empty() && bytes_ + bytes > capacity_) {
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+        erase(std::prev(entries_.end()));
+    }
+    entries_.push_front(std::move(entry));
+    index_.emplace(probe.key, entries_.begin());
+    bytes_ += bytes;
+}
+
+void ResultCache::erase(std::list<Entry>::iterator it) {
+    bytes_ -= it->bytes;
+    index_.erase(it->key);
+    entries_.erase(it);
+}
+
+void ResultCache::clear() {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+    bytes_ = 0;
+}
+
+size_t ResultCache::size() const {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t ResultCache::bytes() const {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+}  // namespace cloudsql::executor
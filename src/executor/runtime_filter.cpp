@@ -0,0 +1,169 @@
+/**
+ * @file runtime_filter.cpp
+ * @brief Runtime join filter implementation
+ */
+
+#include "executor/runtime_filter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "common/value.hpp"
+#include "executor/vector_hash.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+constexpr double INT64_LOWER = -9223372036854775808.0;
+constexpr double INT64_UPPER = 9223372036854775808.0;
+constexpr uint64_t BOOL_SEED = 0x243f6a8885a308d3ULL;
+
+bool is_float_type(common::ValueType type) {
+    return type == common::ValueType::TYPE_FLOAT32 || type == common::ValueType::TYPE_FLOAT64 ||
+           type == common::ValueType::TYPE_DECIMAL;
+}
+
+/** @return `key` as the join compares it: integral numbers as int64, text as TEXT */
+common::Value normalize(const common::Value& key) {
+    if (is_float_type(key.type())) {
+        const double value = key.to_float64();
+        if (std::trunc(value) == value && value >= INT64_LOWER && value < INT64_UPPER) {
+            return common::Value::make_int64(static_cast<int64_t>(value));
+        }
+        return common::Value::make_float64(value);
+    }
+    if (key.is_numeric()) {
+        return common::Value::make_int64(key.to_int64());
+    }
+    return key;
+}
+
+}  // namespace
+
+RuntimeFilter::RuntimeFilter(size_t expected_keys) {
+    size_t bits = MIN_BITS;
+    while (bits < MAX_BITS && bits < expected_keys * BITS_PER_KEY) {
+        bits <<= 1U;
+    }
+    words_.assign(bits / 64, 0);
+    mask_ = bits - 1;
+}
+
+RuntimeFilter::RuntimeFilter(std::vector<uint64_t> words, uint64_t key_count, common::Value min,
+                             common::Value max)
+    : words_(std::move(words)), key_count_(key_count), min_(std::move(min)), max_(std::move(max)) {
+    /* A size that is not a power of two cannot be probed; such a filter passes everything */
+    if (words_.empty() || (words_.size() & (words_.size() - 1)) != 0) {
+        words_.assign(1, ~static_cast<uint64_t>(0));
+        min_ = common::Value::make_null();
+        max_ = common::Value::make_null();
+        key_count_ = std::max<uint64_t>(key_count_, 1);
+    }
+    mask_ = words_.size() * 64 - 1;
+}
+
+uint64_t RuntimeFilter::key_hash(const common::Value& key) {
+    const common::Value value = normalize(key);
+    if (value.type() == common::ValueType::TYPE_INT64) {
+        return hashing::mix(static_cast<uint64_t>(value.to_int64()));
+    }
+    if (value.type() == common::ValueType::TYPE_FLOAT64) {
+        return hashing::mix(hashing::double_bits(value.to_float64()));
+    }
+    if (value.type() == common::ValueType::TYPE_BOOL) {
+        return hashing::mix(BOOL_SEED + (value.as_bool() ? 1 : 0));
+    }
+    if (value.type() == common::ValueType::TYPE_TEXT ||
+        value.type() == common::ValueType::TYPE_VARCHAR ||
+        value.type() == common::ValueType::TYPE_CHAR) {
+        return hashing::mix(std::hash<std::string_view>{}(value.text_view()));
+    }
+    return hashing::mix(common::Value::Hash{}(value));
+}
+
+void RuntimeFilter::add(const common::Value& key) {
+    if (key.is_null()) {
+        return;
+    }
+    const uint64_t hash = key_hash(key);
+    const uint64_t step = hashing::mix(hash) | 1U;
+    for (size_t i = 0; i < HASH_COUNT; ++i) {
+        const uint64_t bit = (hash + i * step) & mask_;
+        words_[bit / 64] |= static_cast<uint64_t>(1) << (bit % 64);
+    }
+
+    common::Value value = normalize(key);
+    if (key_count_ == 0 || value < min_) {
+        min_ = value;
+    }
+    if (key_count_ == 0 || max_ < value) {
+        max_ = std::move(value);
+    }
+    ++key_count_;
+}
+
+bool RuntimeFilter::may_contain(const common::Value& key) const {
+    if (key.is_null() || key_count_ == 0) {
+        return false;
+    }
+    if (!min_.is_null() && (key < min_ || max_ < key)) {
+        return false;
+    }
+    const uint64_t hash = key_hash(key);
+    const uint64_t step = hashing::mix(hash) | 1U;
+    for (size_t i = 0; i < HASH_COUNT; ++i) {
+        const uint64_t bit = (hash + i * step) & mask_;
+        if ((words_[bit / 64] & (static_cast<uint64_t>(1) << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RuntimeFilter::fold() {
+    const size_t half = words_.size() / 2;
+    for (size_t i = 0; i < half; ++i) {
+        words_[i] |= words_[half + i];
+    }
+    words_.resize(half);
+    mask_ = words_.size() * 64 - 1;
+}
+
+void RuntimeFilter::merge(const RuntimeFilter& other) {
+    if (other.key_count_ == 0) {
+        return;
+    }
+    /* Bit positions are hashes masked to the size, so halving maps them onto the smaller filter */
+    while (words_.size() > other.words_.size()) {
+        fold();
+    }
+    RuntimeFilter folded = other;
+    while (folded.words_.size() > words_.size()) {
+        folded.fold();
+    }
+    for (size_t i = 0; i < words_.size(); ++i) {
+        words_[i] |= folded.words_[i];
+    }
+
+    if (key_count_ == 0) {
+        min_ = other.min_;
+        max_ = other.max_;
+    } else if (min_.is_null() || other.min_.is_null()) {
+        /* Either side has no range: neither does the union */
+        min_ = common::Value::make_null();
+        max_ = common::Value::make_null();
+    } else {
+        if (other.min_ < min_) min_ = other.min_;
+        if (max_ < other.max_) max_ = other.max_;
+    }
+    key_count_ += other.key_count_;
+}
+
+}  // namespace cloudsql::executor
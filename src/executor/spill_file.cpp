@@ -0,0 +1,174 @@
+/**
+ * @file spill_file.cpp
+ * @brief Record format and file handling of operator spill files
+ */
+
+#include "executor/spill_file.hpp"
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace cloudsql::executor {
+
+namespace {
+
+constexpr size_t SPILL_BUFFER_BYTES = static_cast<size_t>(64) * 1024;
+
+template <typename T>
+void append_raw(std::vector<char>& out, const T& value) {
+    const size_t offset = out.size();
+    out.resize(offset + sizeof(T));
+    std::memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+void append_value(std::vector<char>& out, const common::Value& value) {
+    out.push_back(static_cast<char>(value.type()));
+    switch (value.type()) {
+        case common::ValueType::TYPE_NULL:
+            break;
+        case common::ValueType::TYPE_BOOL:
+            out.push_back(value.as_bool() ? 1 : 0);
+            break;
+        case common::ValueType::TYPE_INT8:
+        case common::ValueType::TYPE_INT16:
+        case common::ValueType::TYPE_INT32:
+        case common::ValueType::TYPE_INT64:
+            append_raw(out, value.to_int64());
+            break;
+        case common::ValueType::TYPE_FLOAT32:
+        case common::ValueType::TYPE_FLOAT64:
+            append_raw(out, value.to_float64());
+            break;
+        case common::ValueType::TYPE_CHAR:
+        case common::ValueType::TYPE_VARCHAR:
+        case common::ValueType::TYPE_TEXT: {
+            const std::string_view text = value.text_view();
+            append_raw(out, static_cast<uint32_t>(text.size()));
+            out.insert(out.end(), text.begin(), text.end());
+            break;
+        }
+        default:
+            throw std::runtime_error("cannot spill a value of type " +
+                                     std::to_string(static_cast<int>(value.type())));
+    }
+}
+
+std::FILE* create_file(const std::string& directory) {
+    if (directory.empty()) return std::tmpfile();
+    std::string path = directory + "/cloudsql_spill_XXXXXX";
+    const int fd = ::mkstemp(path.data());
+    if (fd < 0) return nullptr;
+    static_cast<void>(::unlink(path.c_str()));
+    std::FILE* file = ::fdopen(fd, "w+b");
+    if (file == nullptr) static_cast<void>(::close(fd));
+    return file;
+}
+
+}  // namespace
+
+SpillFile::SpillFile(const std::string& directory) : file_(create_file(directory)) {
+    if (file_ == nullptr) {
+        throw std::runtime_error("cannot create a spill file" +
+                                 (directory.empty() ? std::string() : " in " + directory));
+    }
+    static_cast<void>(std::setvbuf(file_, nullptr, _IOFBF, SPILL_BUFFER_BYTES));
+}
+
+SpillFile::~SpillFile() {
+    static_cast<void>(std::fclose(file_));
+}
+
+void SpillFile::write(const std::string& key, const Tuple& tuple) {
+    record_.clear();
+    append_raw(record_, static_cast<uint32_t>(key.size()));
+    record_.insert(record_.end(), key.begin(), key.end());
+    append_raw(record_, static_cast<uint32_t>(tuple.size()));
+    for (const auto& value : tuple.values()) append_value(record_, value);
+    if (std::fwrite(record_.data(), 1, record_.size(), file_) != record_.size()) {
+        throw std::runtime_error("spill file write failed");
+    }
+    ++records_;
+    bytes_written_ += record_.size();
+}
+
+void SpillFile::rewind() {
+    if (std::fflush(file_) != 0 || std::fseek(file_, 0, SEEK_SET) != 0) {
+        throw std::runtime_error("spill file rewind failed");
+    }
+}
+
+bool SpillFile::read(Tuple& tuple) {
+    return read(discarded_key_, tuple);
+}
+
+bool SpillFile::read(std::string& key, Tuple& tuple) {
+    uint32_t key_size = 0;
+    if (std::fread(&key_size, sizeof(key_size), 1, file_) != 1) {
+        if (std::feof(file_) != 0) return false;
+        throw std::runtime_error("spill file read failed");
+    }
+    key.resize(key_size);
+    read_raw(key.data(), key_size);
+
+    const auto count = read_raw<uint32_t>();
+    std::vector<common::Value> values;
+    values.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) values.push_back(read_value());
+    tuple = Tuple(std::move(values));
+    return true;
+}
+
+void SpillFile::read_raw(void* out, size_t size) {
+    if (std::fread(out, 1, size, file_) != size) {
+        throw std::runtime_error("spill file is truncated");
+    }
+}
+
+template <typename T>
+T SpillFile::read_raw() {
+    T value{};
+    read_raw(&value, sizeof(T));
+    return value;
+}
+
+common::Value SpillFile::read_value() {
+    const auto type = static_cast<common::ValueType>(read_raw<uint8_t>());
+    switch (type) {
+        case common::ValueType::TYPE_NULL:
+            return common::Value::make_null();
+        case common::ValueType::TYPE_BOOL:
+            return common::Value(read_raw<char>() != 0);
+        case common::ValueType::TYPE_INT8:
+            return common::Value(static_cast<int8_t>(read_raw<int64_t>()));
+        case common::ValueType::TYPE_INT16:
+            return common::Value(static_cast<int16_t>(read_raw<int64_t>()));
+        case common::ValueType::TYPE_INT32:
+            return common::Value(static_cast<int32_t>(read_raw<int64_t>()));
+        case common::ValueType::TYPE_INT64:
+            return common::Value(read_raw<int64_t>());
+        case common::ValueType::TYPE_FLOAT32:
+            return common::Value(static_cast<float>(read_raw<double>()));
+        case common::ValueType::TYPE_FLOAT64:
+            return common::Value(read_raw<double>());
+        case common::ValueType::TYPE_CHAR:
+        case common::ValueType::TYPE_VARCHAR:
+        case common::ValueType::TYPE_TEXT: {
+            std::string text(read_raw<uint32_t>(), '\0');
+            read_raw(text.data(), text.size());
+            return common::Value::make_text(text);
+        }
+        default:
+            throw std::runtime_error("spill file is corrupt");
+    }
+}
+
+}  // namespace cloudsql::executor
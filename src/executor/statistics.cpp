@@ -0,0 +1,184 @@
+/**
+ * @file statistics.cpp
+ * @brief Sampling and per-column statistics for ANALYZE
+ */
+
+#include "executor/statistics.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "common/value.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+constexpr uint32_t ANALYZE_BATCH_ROWS = 1024;
+
+/* A value is "common" when it occurs this much more often than the average value */
+constexpr double COMMON_VALUE_FACTOR = 1.25;
+
+}  // namespace
+
+StatsBuilder::StatsBuilder(size_t column_count, size_t sample_rows, uint64_t seed)
+    : column_count_(column_count), sample_rows_(std::max<size_t>(sample_rows, 1)), rng_(seed) {
+    sample_.reserve(std::min<size_t>(sample_rows_, DEFAULT_SAMPLE_ROWS));
+}
+
+void StatsBuilder::add_row(const Tuple& row) {
+    ++rows_seen_;
+    if (sample_.size() < sample_rows_) {
+        sample_.push_back(row);
+        return;
+    }
+    /* Keep the row with probability sample_rows / rows_seen, replacing a random one */
+    const uint64_t slot = std::uniform_int_distribution<uint64_t>(0, rows_seen_ - 1)(rng_);
+    if (slot < sample_rows_) sample_[slot] = row;
+}
+
+TableStats StatsBuilder::build() const {
+    TableStats stats;
+    stats.row_count = rows_seen_;
+    stats.page_count = page_count_;
+    stats.sampled_rows = sample_.size();
+    stats.analyzed_at = static_cast<uint64_t>(std::time(nullptr));
+    stats.columns.reserve(column_count_);
+    for (size_t i = 0; i < column_count_; ++i) stats.columns.push_back(build_column(i));
+    return stats;
+}
+
+ColumnStats StatsBuilder::build_column(size_t column) const {
+    ColumnStats stats;
+    if (sample_.empty()) return stats;
+
+    std::vector<const common::Value*> values;
+    values.reserve(sample_.size());
+    for (const auto& row : sample_) {
+        if (column < row.size() && !row.get(column).is_null()) values.push_back(&row.get(column));
+    }
+    const auto sampled = static_cast<double>(sample_.size());
+    stats.null_fraction = static_cast<double>(sample_.size() - values.size()) / sampled;
+    if (values.empty()) return stats;
+
+    std::sort(values.begin(), values.end(),
+              [](const common::Value* a, const common::Value* b) { return *a < *b; });
+
+    /* Runs of equal values: [begin, end) into `values` */
+    struct Run {
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Run> runs;
+    size_t singletons = 0;
+    for (size_t i = 0; i < values.size();) {
+        size_t j = i + 1;
+        while (j < values.size() && *values[j] == *values[i]) ++j;
+        runs.push_back({i, j});
+        if (j - i == 1) ++singletons;
+        i = j;
+    }
+
+    /* Duj1: D = n * d / (n - f1 + f1 * n / N) for n sampled values, d of them distinct,
+     * f1 seen once, out of N non-NULL values in the table */
+    const auto n = static_cast<double>(values.size());
+    const auto d = static_cast<double>(runs.size());
+    const double total = static_cast<double>(rows_seen_) * (1.0 - stats.null_fraction);
+    if (rows_seen_ <= sample_.size()) {
+        stats.distinct_count = d;
+    } else {
+        const auto f1 = static_cast<double>(singletons);
+        stats.distinct_count = std::clamp(n * d / (n - f1 + f1 * n / total), d, total);
+    }
+
+    /* Most common values: all of them when the sample holds every value at least
+     * twice, otherwise those well above the average frequency */
+    std::vector<size_t> by_count(runs.size());
+    for (size_t i = 0; i < runs.size(); ++i) by_count[i] = i;
+    std::stable_sort(by_count.begin(), by_count.end(), [&runs](size_t a, size_t b) {
+        return runs[a].end - runs[a].begin > runs[b].end - runs[b].begin;
+    });
+    const bool all_common = singletons == 0 && runs.size() <= MAX_COMMON_VALUES;
+    const double threshold = std::max(2.0, COMMON_VALUE_FACTOR * n / d);
+    std::vector<bool> common(runs.size(), false);
+    for (const size_t run : by_count) {
+        const auto count = static_cast<double>(runs[run].end - runs[run].begin);
+        if (stats.most_common_values.size() == MAX_COMMON_VALUES ||
+            (!all_common && count < threshold)) {
+            break;
+        }
+        common[run] = true;
+        stats.most_common_values.push_back(*values[runs[run].begin]);
+        stats.most_common_freqs.push_back(count / sampled);
+    }
+
+    /* Equi-depth histogram over the remaining values */
+    std::vector<const common::Value*> rest;
+    for (size_t i = 0; i < runs.size(); ++i) {
+        if (common[i]) continue;
+        const auto first = std::next(values.begin(), static_cast<std::ptrdiff_t>(runs[i].begin));
+        const auto last = std::next(values.begin(), static_cast<std::ptrdiff_t>(runs[i].end));
+        rest.insert(rest.end(), first, last);
+    }
+    if (rest.size() >= 2) {
+        const size_t buckets = std::min(HISTOGRAM_BUCKETS, rest.size() - 1);
+        stats.histogram_bounds.reserve(buckets + 1);
+        for (size_t i = 0; i <= buckets; ++i) {
+            stats.histogram_bounds.push_back(*rest[i * (rest.size() - 1) / buckets]);
+        }
+    }
+    return stats;
+}
+
+TableStats analyze_table(storage::HeapTable& table, const transaction::Transaction* txn,
+                         size_t sample_rows) {
+    StatsBuilder builder(table.schema().column_count(), sample_rows);
+    auto iter = table.scan();
+    storage::HeapTable::TupleMeta meta;
+    uint32_t last_page = 0;
+    while (iter.next_meta(meta)) {
+        /* Every page holding a record costs a read, visible or not */
+        while (last_page <= iter.current_id().page_num) {
+            builder.add_page();
+            ++last_page;
+        }
+        const bool visible =
+            txn != nullptr ? txn->can_see(meta.xmin, meta.xmax) : meta.xmax == 0;
+        if (visible) builder.add_row(meta.tuple);
+    }
+    return builder.build();
+}
+
+TableStats analyze_table(storage::ColumnarTable& table, size_t sample_rows) {
+    const Schema& schema = table.schema();
+    StatsBuilder builder(schema.column_count(), sample_rows);
+    for (size_t i = 0; i < table.chunk_count(); ++i) builder.add_page();
+
+    auto batch = VectorBatch::create(schema);
+    NumericVector<bool> live(common::ValueType::TYPE_BOOL);
+    Tuple row;
+    for (uint64_t start = 0; table.read_batch(start, ANALYZE_BATCH_ROWS, *batch);
+         start += batch->row_count()) {
+        if (batch->row_count() == 0) break;
+        const bool masked = table.live_mask(start, batch->row_count(), live);
+        for (size_t r = 0; r < batch->row_count(); ++r) {
+            if (masked && !live.raw_data()[r]) continue;
+            auto& values = row.values();
+            values.clear();
+            for (size_t c = 0; c < batch->column_count(); ++c) {
+                values.push_back(batch->get_column(c).get(r));
+            }
+            builder.add_row(row);
+        }
+    }
+    return builder.build();
+}
+
+}  // namespace cloudsql::executor
@@ -0,0 +1,64 @@
+/**
+ * @file table_handles.cpp
+ * @brief Opened heap tables and indexes reused across DML statements
+ */
+
+#include "executor/table_handles.hpp"
+
+#include <memory>
+
+#include "storage/brin_index.hpp"
+#include "storage/btree_index.hpp"
+#include "storage/hash_index.hpp"
+
+namespace cloudsql::executor {
+
+namespace {
+
+Schema table_schema(const TableInfo& info) {
+    Schema schema;
+    for (const auto& col : info.columns) {
+        schema.add_column(col.name, col.type);
+    }
+    return schema;
+}
+
+}  // namespace
+
+std::unique_ptr<storage::Index> open_index(const IndexInfo& info, common::ValueType key_type,
+                                           storage::BufferPoolManager& bpm) {
+    if (info.index_type == IndexType::Hash) {
+        return std::make_unique<storage::HashIndex>(info.name, bpm, key_type);
+    }
+    if (info.index_type == IndexType::BRIN) {
+        return std::make_unique<storage::BrinIndex>(info.name, bpm, key_type);
+    }
+    return std::make_unique<storage::BTreeIndex>(info.name, bpm, key_type);
+}
+
+TableHandle::TableHandle(const TableInfo& info, storage::BufferPoolManager& bpm)
+    : schema(table_schema(info)), table(info.name, bpm, schema) {
+    indexes.reserve(info.indexes.size());
+    for (const auto& idx_info : info.indexes) {
+        if (idx_info.column_positions.empty()) {
+            continue;
+        }
+        const uint16_t pos = idx_info.column_positions[0];
+        indexes.push_back({open_index(idx_info, info.columns[pos].type, bpm), pos});
+    }
+}
+
+TableHandle& TableHandleCache::get(const TableInfo& info) {
+    const uint64_t version = catalog_.get_version();
+    if (version != version_) {
+        handles_.clear();
+        version_ = version;
+    }
+    auto& handle = handles_[info.table_id];
+    if (!handle) {
+        handle = std::make_unique<TableHandle>(info, bpm_);
+    }
+    return *handle;
+}
+
+}  // namespace cloudsql::executor
@@ -0,0 +1,139 @@
+/**
+ * @file thread_pool.cpp
+ * @brief Work-stealing thread pool
+ */
+
+#include "executor/thread_pool.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace cloudsql::executor {
+
+WorkStealingPool::WorkStealingPool(size_t threads) {
+    threads = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; ++i) {
+        queues_.push_back(std::make_unique<TaskQueue>());
+    }
+    threads_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back([this, i]() { worker_loop(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        const std::lock_guard<std::mutex> lock(state_mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& thread : threads_) {
+        if (thread.joinable()) thread.join();
+    }
+}
+
+WorkStealingPool& WorkStealingPool::shared() {
+    static WorkStealingPool pool(std::max<size_t>(std::thread::hardware_concurrency(), 1));
+    return pool;
+}
+
+void WorkStealingPool::run_task(size_t id, size_t task, const TaskFn& fn) {
+    if (failed_.load(std::memory_order_relaxed)) return;
+    try {
+        fn(id, task);
+    } catch (...) {
+        const std::lock_guard<std::mutex> lock(state_mutex_);
+        if (!error_) error_ = std::current_exception();
+        failed_.store(true, std::memory_order_relaxed);
+    }
+}
+
+bool WorkStealingPool::pop_task(size_t id, size_t* task) {
+    {
+        TaskQueue& own = *queues_[id];
+        const std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            *task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    // Steal from the far end of a victim's block, away from where its owner works
+    for (size_t offset = 1; offset < job_workers_; ++offset) {
+        TaskQueue& victim = *queues_[(id + offset) % job_workers_];
+        const std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            *task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::worker_loop(size_t id) {
+    uint64_t seen = 0;
+    while (true) {
+        const TaskFn* fn = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(state_mutex_);
+            work_cv_.wait(lock, [&]() {
+                return stop_ || (generation_ != seen && id < job_workers_);
+            });
+            if (stop_) return;
+            seen = generation_;
+            fn = job_fn_;
+        }
+
+        size_t task = 0;
+        while (pop_task(id, &task)) run_task(id, task, *fn);
+
+        {
+            const std::lock_guard<std::mutex> lock(state_mutex_);
+            if (--active_workers_ == 0) done_cv_.notify_all();
+        }
+    }
+}
+
+void WorkStealingPool::parallel_for(size_t task_count, size_t workers, const TaskFn& fn) {
+    if (task_count == 0) return;
+    workers = workers == 0 ? threads_.size() : std::min(workers, threads_.size());
+    workers = std::min(workers, task_count);
+    if (workers <= 1) {
+        for (size_t task = 0; task < task_count; ++task) fn(0, task);
+        return;
+    }
+
+    const std::lock_guard<std::mutex> job_lock(job_mutex_);
+    for (size_t w = 0; w < workers; ++w) {
+        TaskQueue& queue = *queues_[w];
+        const std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.clear();
+        for (size_t task = w * task_count / workers; task < (w + 1) * task_count / workers;
+             ++task) {
+            queue.tasks.push_back(task);
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(state_mutex_);
+        job_fn_ = &fn;
+        job_workers_ = workers;
+        active_workers_ = workers;
+        error_ = nullptr;
+        failed_.store(false, std::memory_order_relaxed);
+        ++generation_;
+        work_cv_.notify_all();
+        done_cv_.wait(lock, [this]() { return active_workers_ == 0; });
+        job_fn_ = nullptr;
+        error = std::exchange(error_, nullptr);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+}  // namespace cloudsql::executor
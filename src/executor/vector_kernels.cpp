@@ -0,0 +1,277 @@
+/**
+ * @file vector_kernels.cpp
+ * @brief Typed vectorized kernels
+ *
+ * Each entry point switches on the operator once and then runs a tight loop
+ * the compiler turns into SIMD code. The entry points are cloned for AVX2 on
+ * x86-64 (resolved once by the dynamic loader). Other targets and ThreadSanitizer
+ * builds use the baseline instruction set, which includes NEON on AArch64.
+ */
+
+#include "executor/vector_kernels.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__GNUC__)
+#define CLOUDSQL_KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#define CLOUDSQL_KERNEL_INLINE inline
+#endif
+
+// ThreadSanitizer crashes in ifunc resolvers, which target_clones relies on
+#if defined(__SANITIZE_THREAD__)
+#define CLOUDSQL_KERNEL_NO_CLONES
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define CLOUDSQL_KERNEL_NO_CLONES
+#endif
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__) && defined(__linux__) && \
+    !defined(CLOUDSQL_KERNEL_NO_CLONES)
+#define CLOUDSQL_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define CLOUDSQL_KERNEL
+#endif
+
+namespace cloudsql::executor::kernels {
+
+namespace {
+
+struct Equal {
+    template <typename T>
+    uint8_t operator()(T x, T y) const {
+        return static_cast<uint8_t>(x == y);
+    }
+};
+struct NotEqual {
+    template <typename T>
+    uint8_t operator()(T x, T y) const {
+        return static_cast<uint8_t>(x != y);
+    }
+};
+struct Less {
+    template <typename T>
+    uint8_t operator()(T x, T y) const {
+        return static_cast<uint8_t>(x < y);
+    }
+};
+struct LessEqual {
+    template <typename T>
+    uint8_t operator()(T x, T y) const {
+        return static_cast<uint8_t>(x <= y);
+    }
+};
+struct Greater {
+    template <typename T>
+    uint8_t operator()(T x, T y) const {
+        return static_cast<uint8_t>(x > y);
+    }
+};
+struct GreaterEqual {
+    template <typename T>
+    uint8_t operator()(T x, T y) const {
+        return static_cast<uint8_t>(x >= y);
+    }
+};
+
+/* Integer arithmetic goes through uint64_t so overflow wraps instead of being UB */
+struct Add {
+    int64_t operator()(int64_t x, int64_t y) const {
+        return static_cast<int64_t>(static_cast<uint64_t>(x) + static_cast<uint64_t>(y));
+    }
+    double operator()(double x, double y) const { return x + y; }
+};
+struct Subtract {
+    int64_t operator()(int64_t x, int64_t y) const {
+        return static_cast<int64_t>(static_cast<uint64_t>(x) - static_cast<uint64_t>(y));
+    }
+    double operator()(double x, double y) const { return x - y; }
+};
+struct Multiply {
+    int64_t operator()(int64_t x, int64_t y) const {
+        return static_cast<int64_t>(static_cast<uint64_t>(x) * static_cast<uint64_t>(y));
+    }
+    double operator()(double x, double y) const { return x * y; }
+};
+struct Divide {
+    double operator()(double x, double y) const { return x / y; }
+};
+
+template <typename T, typename R, typename F>
+CLOUDSQL_KERNEL_INLINE void zip(const T* a, const T* b, size_t n, R* out, F f) {
+    for (size_t i = 0; i < n; ++i) out[i] = f(a[i], b[i]);
+}
+
+template <typename T, typename R, typename F>
+CLOUDSQL_KERNEL_INLINE void zip_right(const T* a, T b, size_t n, R* out, F f) {
+    for (size_t i = 0; i < n; ++i) out[i] = f(a[i], b);
+}
+
+template <typename T, typename R, typename F>
+CLOUDSQL_KERNEL_INLINE void zip_left(T a, const T* b, size_t n, R* out, F f) {
+    for (size_t i = 0; i < n; ++i) out[i] = f(a, b[i]);
+}
+
+template <typename Body>
+CLOUDSQL_KERNEL_INLINE void with_compare(CompareKind kind, Body body) {
+    switch (kind) {
+        case CompareKind::Eq:
+            body(Equal{});
+            return;
+        case CompareKind::Ne:
+            body(NotEqual{});
+            return;
+        case CompareKind::Lt:
+            body(Less{});
+            return;
+        case CompareKind::Le:
+            body(LessEqual{});
+            return;
+        case CompareKind::Gt:
+            body(Greater{});
+            return;
+        case CompareKind::Ge:
+            body(GreaterEqual{});
+            return;
+    }
+}
+
+template <typename Body>
+CLOUDSQL_KERNEL_INLINE void with_int_arith(ArithKind kind, Body body) {
+    switch (kind) {
+        case ArithKind::Add:
+            body(Add{});
+            return;
+        case ArithKind::Sub:
+            body(Subtract{});
+            return;
+        case ArithKind::Mul:
+            body(Multiply{});
+            return;
+        case ArithKind::Div:
+            break;
+    }
+    throw std::invalid_argument("kernels::arith: integer division must be done on doubles");
+}
+
+template <typename Body>
+CLOUDSQL_KERNEL_INLINE void with_float_arith(ArithKind kind, Body body) {
+    switch (kind) {
+        case ArithKind::Add:
+            body(Add{});
+            return;
+        case ArithKind::Sub:
+            body(Subtract{});
+            return;
+        case ArithKind::Mul:
+            body(Multiply{});
+            return;
+        case ArithKind::Div:
+            body(Divide{});
+            return;
+    }
+}
+
+}  // namespace
+
+CompareKind flip(CompareKind kind) {
+    switch (kind) {
+        case CompareKind::Lt:
+            return CompareKind::Gt;
+        case CompareKind::Le:
+            return CompareKind::Ge;
+        case CompareKind::Gt:
+            return CompareKind::Lt;
+        case CompareKind::Ge:
+            return CompareKind::Le;
+        default:
+            return kind;
+    }
+}
+
+CLOUDSQL_KERNEL void compare(CompareKind kind, const int64_t* a, const int64_t* b, size_t n,
+                             uint8_t* out) {
+    with_compare(kind, [&](auto op) { zip(a, b, n, out, op); });
+}
+
+CLOUDSQL_KERNEL void compare(CompareKind kind, const int64_t* a, int64_t b, size_t n,
+                             uint8_t* out) {
+    with_compare(kind, [&](auto op) { zip_right(a, b, n, out, op); });
+}
+
+CLOUDSQL_KERNEL void compare(CompareKind kind, const double* a, const double* b, size_t n,
+                             uint8_t* out) {
+    with_compare(kind, [&](auto op) { zip(a, b, n, out, op); });
+}
+
+CLOUDSQL_KERNEL void compare(CompareKind kind, const double* a, double b, size_t n,
+                             uint8_t* out) {
+    with_compare(kind, [&](auto op) { zip_right(a, b, n, out, op); });
+}
+
+CLOUDSQL_KERNEL void arith(ArithKind kind, const int64_t* a, const int64_t* b, size_t n,
+                           int64_t* out) {
+    with_int_arith(kind, [&](auto op) { zip(a, b, n, out, op); });
+}
+
+CLOUDSQL_KERNEL void arith(ArithKind kind, const int64_t* a, int64_t b, size_t n, int64_t* out) {
+    with_int_arith(kind, [&](auto op) { zip_right(a, b, n, out, op); });
+}
+
+CLOUDSQL_KERNEL void arith(ArithKind kind, int64_t a, const int64_t* b, size_t n, int64_t* out) {
+    with_int_arith(kind, [&](auto op) { zip_left(a, b, n, out, op); });
+}
+
+CLOUDSQL_KERNEL void arith(ArithKind kind, const double* a, const double* b, size_t n,
+                           double* out) {
+    with_float_arith(kind, [&](auto op) { zip(a, b, n, out, op); });
+}
+
+CLOUDSQL_KERNEL void arith(ArithKind kind, const double* a, double b, size_t n, double* out) {
+    with_float_arith(kind, [&](auto op) { zip_right(a, b, n, out, op); });
+}
+
+CLOUDSQL_KERNEL void arith(ArithKind kind, double a, const double* b, size_t n, double* out) {
+    with_float_arith(kind, [&](auto op) { zip_left(a, b, n, out, op); });
+}
+
+CLOUDSQL_KERNEL void widen(const int64_t* in, size_t n, double* out) {
+    for (size_t i = 0; i < n; ++i) out[i] = static_cast<double>(in[i]);
+}
+
+CLOUDSQL_KERNEL void and_masks(const uint8_t* a, const uint8_t* b, size_t n, uint8_t* out) {
+    for (size_t i = 0; i < n; ++i) out[i] = static_cast<uint8_t>(a[i] & b[i]);
+}
+
+CLOUDSQL_KERNEL void or_masks(const uint8_t* a, const uint8_t* b, size_t n, uint8_t* out) {
+    for (size_t i = 0; i < n; ++i) out[i] = static_cast<uint8_t>(a[i] | b[i]);
+}
+
+CLOUDSQL_KERNEL void logical_and(const uint8_t* a, const uint8_t* a_null, const uint8_t* b,
+                                 const uint8_t* b_null, size_t n, uint8_t* out,
+                                 uint8_t* out_null) {
+    for (size_t i = 0; i < n; ++i) {
+        // A known FALSE decides the result even when the other side is NULL
+        const auto a_false = static_cast<uint8_t>(~a_null[i] & ~a[i] & 1U);
+        const auto b_false = static_cast<uint8_t>(~b_null[i] & ~b[i] & 1U);
+        out[i] = static_cast<uint8_t>(a[i] & b[i] & 1U);
+        out_null[i] = static_cast<uint8_t>((a_null[i] | b_null[i]) & ~(a_false | b_false) & 1U);
+    }
+}
+
+CLOUDSQL_KERNEL void logical_or(const uint8_t* a, const uint8_t* a_null, const uint8_t* b,
+                                const uint8_t* b_null, size_t n, uint8_t* out,
+                                uint8_t* out_null) {
+    for (size_t i = 0; i < n; ++i) {
+        // A known TRUE decides the result even when the other side is NULL
+        const auto a_true = static_cast<uint8_t>(~a_null[i] & a[i] & 1U);
+        const auto b_true = static_cast<uint8_t>(~b_null[i] & b[i] & 1U);
+        out[i] = static_cast<uint8_t>((a[i] | b[i]) & 1U);
+        out_null[i] = static_cast<uint8_t>((a_null[i] | b_null[i]) & ~(a_true | b_true) & 1U);
+    }
+}
+
+}  // namespace cloudsql::executor::kernels
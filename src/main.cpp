@@ -14,12 +14,14 @@
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <csignal>
 #include <cstdint>
 #include <cstring>
 #include <exception>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -27,21 +29,32 @@
 #include <vector>
 
 #include "catalog/catalog.hpp"
+#include "common/arena.hpp"
 #include "common/cluster_manager.hpp"
 #include "common/config.hpp"
+#include "common/memory_tracker.hpp"
+#include "common/trace.hpp"
 #include "distributed/distributed_executor.hpp"
 #include "distributed/raft_manager.hpp"
 #include "distributed/shard_manager.hpp"
+#include "distributed/shuffle_writer.hpp"
+#include "executor/morsel_scheduler.hpp"
+#include "executor/parallel_scan.hpp"
 #include "executor/query_executor.hpp"
+#include "network/metrics_server.hpp"
 #include "network/rpc_client.hpp"
 #include "network/rpc_message.hpp"
 #include "network/rpc_server.hpp"
 #include "network/server.hpp"
+#include "parser/ast_arena.hpp"
 #include "parser/lexer.hpp"
 #include "parser/parser.hpp"
+#include "parser/statement.hpp"
 #include "recovery/log_manager.hpp"
 #include "recovery/recovery_manager.hpp"
 #include "storage/buffer_pool_manager.hpp"
+#include "storage/io_backend.hpp"
+#include "storage/replacer.hpp"
 #include "storage/storage_manager.hpp"
 #include "transaction/lock_manager.hpp"
 #include "transaction/transaction_manager.hpp"
@@ -81,6 +94,9 @@ void print_usage(const char* prog) {
     std::cout << "  -p, --port PORT           PostgreSQL client port (default: 5432)\n";
     std::cout
         << "  -cp, --cluster-port PORT  Internal cluster communication port (default: 6432)\n";
+    std::cout << "  -mp, --metrics-port PORT  HTTP port serving /metrics (default: off)\n";
+    std::cout << "  -ts, --trace-sample-rate RATE\n"
+                 "                            Fraction of statements traced, 0 to 1 (default: 0)\n";
     std::cout << "  -d, --data DIR            Data directory (default: ./data)\n";
     std::cout << "  -c, --config FILE         Configuration file (optional)\n";
     std::cout << "  -m, --mode MODE           Run mode: standalone, coordinator, or data\n";
@@ -152,6 +168,30 @@ int main(int argc, char* argv[]) {
                               << ")\n";
                     return 1;
                 }
+            } else if ((arg == "-mp" || arg == "--metrics-port") && i + 1 < cmd_args.size()) {
+                try {
+                    const unsigned long port_val = std::stoul(cmd_args[++i]);
+                    if (port_val > CONST_MAX_PORT) {
+                        throw std::out_of_range("Metrics port out of range");
+                    }
+                    config.metrics_port = static_cast<uint16_t>(port_val);
+                } catch (const std::exception& e) {
+                    std::cerr << "Invalid metrics port: " << cmd_args[i] << " (" << e.what()
+                              << ")\n";
+                    return 1;
+                }
+            } else if ((arg == "-ts" || arg == "--trace-sample-rate") && i + 1 < cmd_args.size()) {
+                try {
+                    const double rate = std::stod(cmd_args[++i]);
+                    if (rate < 0 || rate > 1) {
+                        throw std::out_of_range("Sample rate must be between 0 and 1");
+                    }
+                    config.trace_sample_rate = rate;
+                } catch (const std::exception& e) {
+                    std::cerr << "Invalid trace sample rate: " << cmd_args[i] << " (" << e.what()
+                              << ")\n";
+                    return 1;
+                }
             } else if ((arg == "-d" || arg == "--data") && i + 1 < cmd_args.size()) {
                 config.data_dir = cmd_args[++i];
             } else if ((arg == "-c" || arg == "--config") && i + 1 < cmd_args.size()) {
@@ -195,36 +235,99 @@ int main(int argc, char* argv[]) {
         }
         std::cout << std::endl;
 
+        cloudsql::executor::MorselScheduler::set_default_parallelism(
+            static_cast<size_t>(std::max(0, config.parallelism)));
+        cloudsql::executor::ParallelHeapScan::set_max_workers(
+            static_cast<size_t>(std::max(0, config.scan_workers)));
+        cloudsql::executor::HashJoinOperator::set_default_memory_budget(
+            config.join_memory_mb == 0
+                ? SIZE_MAX
+                : static_cast<size_t>(std::max(0, config.join_memory_mb)) * 1024 * 1024);
+        cloudsql::executor::SortOperator::set_default_memory_budget(
+            config.sort_memory_mb == 0
+                ? SIZE_MAX
+                : static_cast<size_t>(std::max(0, config.sort_memory_mb)) * 1024 * 1024);
+        cloudsql::executor::AggregateOperator::set_default_memory_budget(
+            config.aggregate_memory_mb == 0
+                ? SIZE_MAX
+                : static_cast<size_t>(std::max(0, config.aggregate_memory_mb)) * 1024 * 1024);
+        cloudsql::common::MemoryTracker::global().set_limit(
+            static_cast<size_t>(std::max(0, config.max_memory_mb)) * 1024 * 1024);
+        cloudsql::executor::QueryExecutor::set_default_query_memory_limit(
+            static_cast<size_t>(std::max(0, config.query_memory_mb)) * 1024 * 1024);
+        auto& tracer = cloudsql::common::Tracer::global();
+        tracer.set_sample_rate(config.trace_sample_rate);
+        tracer.set_capacity(static_cast<size_t>(std::max(1, config.trace_buffer_spans)));
+        tracer.set_node(config.mode == cloudsql::config::RunMode::Standalone
+                            ? "standalone"
+                            : "node_" + std::to_string(config.cluster_port));
+
         /* Set up signal handlers */
         static_cast<void>(std::signal(SIGINT, signal_handler));
         static_cast<void>(std::signal(SIGTERM, signal_handler));
 
         /* Initialize storage manager & buffer pool */
-        auto disk_manager = std::make_unique<cloudsql::storage::StorageManager>(config.data_dir);
+        cloudsql::storage::IoBackendType io_backend = cloudsql::storage::IoBackendType::Posix;
+        if (!cloudsql::storage::parse_io_backend(config.io_backend, &io_backend)) {
+            std::cerr << "Unknown I/O backend '" << config.io_backend
+                      << "', falling back to posix\n";
+        }
+        auto disk_manager = std::make_unique<cloudsql::storage::StorageManager>(
+            config.data_dir, io_backend, config.direct_io,
+            static_cast<uint32_t>(config.page_size));
+        cloudsql::storage::ReplacerPolicy replacer_policy = cloudsql::storage::ReplacerPolicy::Lru;
+        if (!cloudsql::storage::parse_replacer_policy(config.buffer_replacer, &replacer_policy)) {
+            std::cerr << "Unknown buffer replacer '" << config.buffer_replacer
+                      << "', falling back to lru\n";
+        }
+        /* The pool holds each page back until the log covers its latest change */
+        auto log_manager =
+            std::make_unique<cloudsql::recovery::LogManager>(config.data_dir + "/wal.log");
         auto bpm = std::make_unique<cloudsql::storage::BufferPoolManager>(
-            cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, *disk_manager);
+            static_cast<size_t>(std::max(1, config.buffer_pool_size)), *disk_manager,
+            log_manager.get(), 0, replacer_policy,
+            cloudsql::storage::FrameOptions{config.buffer_huge_pages, config.buffer_numa});
         /* Initialize catalog */
         const auto catalog = cloudsql::Catalog::create();
         if (!catalog) {
             std::cerr << "Failed to initialize catalog" << std::endl;
             return 1;
         }
+        if (!catalog->load(config.data_dir + "/catalog.db")) {
+            std::cerr << "Failed to load catalog; changes will not be persisted" << std::endl;
+        }
 
-        /* Initialize log manager & run recovery */
-        auto log_manager =
-            std::make_unique<cloudsql::recovery::LogManager>(config.data_dir + "/wal.log");
-
+        /* Run recovery */
         std::cout << "Running Crash Recovery..." << std::endl;
-        cloudsql::recovery::RecoveryManager rm(*bpm, *catalog, *log_manager);
+        cloudsql::recovery::RecoveryManager rm(*bpm, *catalog, *log_manager,
+                                               static_cast<size_t>(config.recovery_threads));
         if (!rm.recover()) {
             std::cerr << "Crash recovery failed. Restarting anyway." << std::endl;
         }
+        log_manager->set_commit_delay(std::chrono::microseconds(config.commit_delay_us));
+        log_manager->set_group_size(static_cast<size_t>(config.commit_group_size));
         log_manager->run_flush_thread();
 
+        /* Keep the coldest frames clean so evictions rarely wait on a write */
+        if (config.bgwriter_delay_ms > 0) {
+            cloudsql::storage::BufferPoolManager::WriterOptions writer;
+            writer.interval = std::chrono::milliseconds(config.bgwriter_delay_ms);
+            writer.max_pages = static_cast<size_t>(config.bgwriter_max_pages);
+            writer.clean_target = static_cast<size_t>(std::max(1, config.buffer_pool_size)) *
+                                  static_cast<size_t>(config.bgwriter_clean_pct) / 100;
+            bpm->start_background_writer(writer);
+        }
+
         /* Initialize transaction management */
         cloudsql::transaction::LockManager lock_manager;
         cloudsql::transaction::TransactionManager transaction_manager(lock_manager, *catalog, *bpm,
                                                                       log_manager.get());
+        /* Prepared transactions keep their locks until the coordinator resolves them */
+        for (const auto& prepared : rm.in_doubt()) {
+            static_cast<void>(
+                transaction_manager.restore_prepared(prepared, rm.changes_of(prepared.txn_id)));
+        }
+        transaction_manager.set_next_txn_id(rm.max_txn_id() + 1);
 
         std::unique_ptr<cloudsql::network::RpcServer> rpc_server = nullptr;
         std::unique_ptr<cloudsql::cluster::ClusterManager> cluster_manager = nullptr;
@@ -279,11 +382,11 @@ int main(int argc, char* argv[]) {
                         rargs.port = info.cluster_port;
                         rargs.mode = 2;  // Data
 
-                        cloudsql::network::RpcClient client(target.address, target.cluster_port);
-                        if (client.connect()) {
+                        auto client = cluster_manager->get_client(target);
+                        if (client) {
                             std::vector<uint8_t> resp;
-                            static_cast<void>(client.call(cloudsql::network::RpcType::RegisterNode,
-                                                          rargs.serialize(), resp));
+                            static_cast<void>(client->call(
+                                cloudsql::network::RpcType::RegisterNode, rargs.serialize(), resp));
                         }
                     }
                     // Also tell them about the coordinator
@@ -293,19 +396,20 @@ int main(int argc, char* argv[]) {
                     cargs.port = config.cluster_port;
                     cargs.mode = 1;  // Coordinator
 
-                    cloudsql::network::RpcClient client(target.address, target.cluster_port);
-                    if (client.connect()) {
+                    auto client = cluster_manager->get_client(target);
+                    if (client) {
                         std::vector<uint8_t> resp;
-                        static_cast<void>(client.call(cloudsql::network::RpcType::RegisterNode,
-                                                      cargs.serialize(), resp));
+                        static_cast<void>(client->call(cloudsql::network::RpcType::RegisterNode,
+                                                       cargs.serialize(), resp));
                     }
                 }
             }
 
             if (config.mode == cloudsql::config::RunMode::Data) {
                 // Data nodes also participate in shard consensus (e.g. Group 1)
-                auto shard_group = raft_manager->get_or_create_group(1);
-                cluster_manager->add_node_to_group(1, node_id);
+                const uint16_t shard_group_id = cloudsql::executor::QueryExecutor::SHARD_GROUP_ID;
+                auto shard_group = raft_manager->get_or_create_group(shard_group_id);
+                cluster_manager->add_node_to_group(shard_group_id, node_id);
                 // Mock state machine for shard 1
                 static cloudsql::executor::ShardStateMachine shard_sm("data", *bpm, *catalog);
                 shard_group->set_state_machine(&shard_sm);
@@ -315,7 +419,6 @@ int main(int argc, char* argv[]) {
                     cloudsql::network::RpcType::RegisterNode,
                     [&](const cloudsql::network::RpcHeader& h, const std::vector<uint8_t>& p,
                         int fd) {
-                        (void)h;
                         auto args = cloudsql::network::RegisterNodeArgs::deserialize(p);
                         if (cluster_manager != nullptr) {
                             cluster_manager->register_node(
@@ -324,34 +427,40 @@ int main(int argc, char* argv[]) {
                         }
                         cloudsql::network::QueryResultsReply reply;
                         reply.success = true;
-                        auto resp_p = reply.serialize();
-                        cloudsql::network::RpcHeader resp_h;
-                        resp_h.type = cloudsql::network::RpcType::QueryResults;
-                        resp_h.payload_len = static_cast<uint16_t>(resp_p.size());
-                        char h_buf[cloudsql::network::RpcHeader::HEADER_SIZE];
-                        resp_h.encode(h_buf);
-                        static_cast<void>(
-                            send(fd, h_buf, cloudsql::network::RpcHeader::HEADER_SIZE, 0));
-                        static_cast<void>(send(fd, resp_p.data(), resp_p.size(), 0));
+                        static_cast<void>(rpc_server->send_response(
+                            fd, h, cloudsql::network::RpcType::QueryResults, reply.serialize()));
                     });
 
                 rpc_server->set_handler(
                     cloudsql::network::RpcType::ExecuteFragment,
                     [&](const cloudsql::network::RpcHeader& h, const std::vector<uint8_t>& p,
                         int fd) {
-                        (void)h;
                         auto args = cloudsql::network::ExecuteFragmentArgs::deserialize(p);
                         cloudsql::network::QueryResultsReply reply;
+                        auto canceled = cluster_manager->begin_fragment(args.context_id);
+                        /* Fragments are parsed, run once and dropped: their ASTs share an arena */
+                        thread_local cloudsql::common::Arena parse_arena;
                         try {
                             auto lexer = std::make_unique<cloudsql::parser::Lexer>(args.sql);
                             cloudsql::parser::Parser parser(std::move(lexer));
-                            auto stmt = parser.parse_statement();
+                            std::unique_ptr<cloudsql::parser::Statement> stmt;
+                            {
+                                const cloudsql::parser::AstArenaScope scope(parse_arena);
+                                stmt = parser.parse_statement();
+                            }
                             if (stmt) {
                                 cloudsql::executor::QueryExecutor exec(
                                     *catalog, *bpm, lock_manager, transaction_manager,
                                     log_manager.get(), cluster_manager.get());
                                 exec.set_context_id(args.context_id);
                                 exec.set_local_only(true);  // Crucial for fragment execution
+                                exec.set_cancel_flag(canceled.get());
+                                exec.set_exchange(args.exchange_tables, args.exchange_senders);
+                                cloudsql::executor::ReadSettings read_settings;
+                                read_settings.consistency = args.read_consistency;
+                                read_settings.max_staleness =
+                                    std::chrono::milliseconds(args.max_staleness_ms);
+                                exec.set_read_settings(read_settings);
                                 auto res = exec.execute(*stmt);
                                 reply.success = res.success();
                                 if (res.success()) {
@@ -368,16 +477,26 @@ int main(int argc, char* argv[]) {
                             reply.success = false;
                             reply.error_msg = e.what();
                         }
+                        parse_arena.reset();
+                        cluster_manager->end_fragment(args.context_id, canceled);
+
+                        const bool columnar =
+                            h.accepts(cloudsql::network::RpcHeader::FLAG_ACCEPT_COLUMNAR);
+                        static_cast<void>(rpc_server->send_response(
+                            fd, h, cloudsql::network::RpcType::QueryResults,
+                            reply.serialize(columnar)));
+                    });
 
-                        auto resp_p = reply.serialize();
-                        cloudsql::network::RpcHeader resp_h;
-                        resp_h.type = cloudsql::network::RpcType::QueryResults;
-                        resp_h.payload_len = static_cast<uint16_t>(resp_p.size());
-                        char h_buf[cloudsql::network::RpcHeader::HEADER_SIZE];
-                        resp_h.encode(h_buf);
-                        static_cast<void>(
-                            send(fd, h_buf, cloudsql::network::RpcHeader::HEADER_SIZE, 0));
-                        static_cast<void>(send(fd, resp_p.data(), resp_p.size(), 0));
+                rpc_server->set_handler(
+                    cloudsql::network::RpcType::CancelFragment,
+                    [&](const cloudsql::network::RpcHeader& h, const std::vector<uint8_t>& p,
+                        int fd) {
+                        auto args = cloudsql::network::CancelFragmentArgs::deserialize(p);
+                        const size_t canceled = cluster_manager->cancel_fragments(args.context_id);
+                        cloudsql::network::QueryResultsReply reply;
+                        reply.success = canceled > 0;
+                        static_cast<void>(rpc_server->send_response(
+                            fd, h, cloudsql::network::RpcType::QueryResults, reply.serialize()));
                     });
 
                 // Register 2PC Handlers
@@ -385,33 +504,29 @@ int main(int argc, char* argv[]) {
                     cloudsql::network::RpcType::TxnPrepare,
                     [&](const cloudsql::network::RpcHeader& h, const std::vector<uint8_t>& p,
                         int fd) {
-                        (void)h;
                         auto args = cloudsql::network::TxnOperationArgs::deserialize(p);
                         cloudsql::network::QueryResultsReply reply;
                         try {
-                            log_manager->flush(true);
+                            auto txn = transaction_manager.get_transaction(args.txn_id);
+                            if (txn) {
+                                transaction_manager.prepare(txn);
+                            } else {
+                                log_manager->flush(true);
+                            }
                             reply.success = true;
                         } catch (const std::exception& e) {
                             reply.success = false;
                             reply.error_msg = e.what();
                         }
 
-                        auto resp_p = reply.serialize();
-                        cloudsql::network::RpcHeader resp_h;
-                        resp_h.type = cloudsql::network::RpcType::QueryResults;
-                        resp_h.payload_len = static_cast<uint16_t>(resp_p.size());
-                        char h_buf[cloudsql::network::RpcHeader::HEADER_SIZE];
-                        resp_h.encode(h_buf);
-                        static_cast<void>(
-                            send(fd, h_buf, cloudsql::network::RpcHeader::HEADER_SIZE, 0));
-                        static_cast<void>(send(fd, resp_p.data(), resp_p.size(), 0));
+                        static_cast<void>(rpc_server->send_response(
+                            fd, h, cloudsql::network::RpcType::QueryResults, reply.serialize()));
                     });
 
                 rpc_server->set_handler(
                     cloudsql::network::RpcType::TxnCommit,
                     [&](const cloudsql::network::RpcHeader& h, const std::vector<uint8_t>& p,
                         int fd) {
-                        (void)h;
                         auto args = cloudsql::network::TxnOperationArgs::deserialize(p);
                         cloudsql::network::QueryResultsReply reply;
                         try {
@@ -425,22 +540,14 @@ int main(int argc, char* argv[]) {
                             reply.error_msg = e.what();
                         }
 
-                        auto resp_p = reply.serialize();
-                        cloudsql::network::RpcHeader resp_h;
-                        resp_h.type = cloudsql::network::RpcType::QueryResults;
-                        resp_h.payload_len = static_cast<uint16_t>(resp_p.size());
-                        char h_buf[cloudsql::network::RpcHeader::HEADER_SIZE];
-                        resp_h.encode(h_buf);
-                        static_cast<void>(
-                            send(fd, h_buf, cloudsql::network::RpcHeader::HEADER_SIZE, 0));
-                        static_cast<void>(send(fd, resp_p.data(), resp_p.size(), 0));
+                        static_cast<void>(rpc_server->send_response(
+                            fd, h, cloudsql::network::RpcType::QueryResults, reply.serialize()));
                     });
 
                 rpc_server->set_handler(
                     cloudsql::network::RpcType::TxnAbort,
                     [&](const cloudsql::network::RpcHeader& h, const std::vector<uint8_t>& p,
                         int fd) {
-                        (void)h;
                         auto args = cloudsql::network::TxnOperationArgs::deserialize(p);
                         cloudsql::network::QueryResultsReply reply;
                         try {
@@ -454,46 +561,36 @@ int main(int argc, char* argv[]) {
                             reply.error_msg = e.what();
                         }
 
-                        auto resp_p = reply.serialize();
-                        cloudsql::network::RpcHeader resp_h;
-                        resp_h.type = cloudsql::network::RpcType::QueryResults;
-                        resp_h.payload_len = static_cast<uint16_t>(resp_p.size());
-                        char h_buf[cloudsql::network::RpcHeader::HEADER_SIZE];
-                        resp_h.encode(h_buf);
-                        static_cast<void>(
-                            send(fd, h_buf, cloudsql::network::RpcHeader::HEADER_SIZE, 0));
-                        static_cast<void>(send(fd, resp_p.data(), resp_p.size(), 0));
+                        static_cast<void>(rpc_server->send_response(
+                            fd, h, cloudsql::network::RpcType::QueryResults, reply.serialize()));
                     });
 
                 rpc_server->set_handler(
                     cloudsql::network::RpcType::PushData,
                     [&](const cloudsql::network::RpcHeader& h, const std::vector<uint8_t>& p,
                         int fd) {
-                        (void)h;
                         auto args = cloudsql::network::PushDataArgs::deserialize(p);
-                        if (cluster_manager != nullptr) {
-                            cluster_manager->buffer_shuffle_data(args.context_id, args.table_name,
-                                                                 std::move(args.rows));
+                        /* Acknowledged once buffered, or later if the buffer is full (credit) */
+                        auto ack = [&rpc_server, h, fd] {
+                            cloudsql::network::QueryResultsReply reply;
+                            reply.success = true;
+                            static_cast<void>(rpc_server->send_response(
+                                fd, h, cloudsql::network::RpcType::QueryResults,
+                                reply.serialize()));
+                        };
+                        if (cluster_manager == nullptr) {
+                            ack();
+                            return;
                         }
-
-                        cloudsql::network::QueryResultsReply reply;
-                        reply.success = true;
-                        auto resp_p = reply.serialize();
-                        cloudsql::network::RpcHeader resp_h;
-                        resp_h.type = cloudsql::network::RpcType::QueryResults;
-                        resp_h.payload_len = static_cast<uint16_t>(resp_p.size());
-                        char h_buf[cloudsql::network::RpcHeader::HEADER_SIZE];
-                        resp_h.encode(h_buf);
-                        static_cast<void>(
-                            send(fd, h_buf, cloudsql::network::RpcHeader::HEADER_SIZE, 0));
-                        static_cast<void>(send(fd, resp_p.data(), resp_p.size(), 0));
+                        cluster_manager->push_shuffle_chunk(args.context_id, args.table_name,
+                                                            std::move(args.rows), args.last,
+                                                            std::move(ack));
                     });
 
                 rpc_server->set_handler(
                     cloudsql::network::RpcType::ShuffleFragment,
                     [&](const cloudsql::network::RpcHeader& h, const std::vector<uint8_t>& p,
                         int fd) {
-                        (void)h;
                         auto args = cloudsql::network::ShuffleFragmentArgs::deserialize(p);
                         cloudsql::network::QueryResultsReply reply;
                         try {
@@ -522,87 +619,108 @@ int main(int argc, char* argv[]) {
                             std::sort(data_nodes.begin(), data_nodes.end(),
                                       [](const auto& a, const auto& b) { return a.id < b.id; });
 
-                            std::unordered_map<std::string, std::vector<cloudsql::executor::Tuple>>
-                                partitions;
-
-                            for (const auto& node : data_nodes) {
-                                partitions[node.id] = {};
+                            /* Of a replicated table, each node keeps its own partition */
+                            size_t own_partition = data_nodes.size();
+                            if (args.replicated) {
+                                for (size_t i = 0; i < data_nodes.size(); ++i) {
+                                    if (data_nodes[i].cluster_port == config.cluster_port) {
+                                        own_partition = i;
+                                    }
+                                }
+                                if (own_partition == data_nodes.size()) {
+                                    throw std::runtime_error(
+                                        "Replicated shuffle on a node that is not a data node");
+                                }
                             }
 
+                            /* Chunks leave while the scan goes on */
+                            const auto node_count = static_cast<uint32_t>(data_nodes.size());
+                            cloudsql::cluster::ShuffleWriter writer(*cluster_manager, data_nodes,
+                                                                    args.context_id,
+                                                                    args.table_name);
+                            const auto& key_filter = args.key_filter;
                             auto iter = table.scan();
                             cloudsql::storage::HeapTable::TupleMeta t_meta;
                             while (iter.next_meta(t_meta)) {
-                                if (t_meta.xmax == 0) {  // Visible
-                                    const auto& key_val = t_meta.tuple.get(key_idx);
-                                    uint32_t node_idx =
+                                /* Rows no row of the other side can match stay here */
+                                if (t_meta.xmax == 0 &&
+                                    (!key_filter ||
+                                     key_filter->may_contain(t_meta.tuple.get(key_idx)))) {
+                                    const uint32_t node_idx =
                                         cloudsql::cluster::ShardManager::compute_shard(
-                                            key_val, static_cast<uint32_t>(data_nodes.size()));
-                                    partitions[data_nodes[node_idx].id].push_back(
-                                        std::move(t_meta.tuple));
+                                            t_meta.tuple.get(key_idx), node_count);
+                                    if (args.replicated && node_idx != own_partition) {
+                                        continue;
+                                    }
+                                    if (!writer.add(node_idx, std::move(t_meta.tuple))) {
+                                        break;
+                                    }
                                 }
                             }
 
-                            bool overall_success = true;
                             std::string delivery_errors;
+                            reply.success = writer.finish(delivery_errors);
+                            if (!reply.success) {
+                                reply.error_msg = "Shuffle delivery failed: " + delivery_errors;
+                            }
+                        } catch (const std::exception& e) {
+                            reply.success = false;
+                            reply.error_msg = e.what();
+                        }
 
-                            for (auto& [node_id, rows] : partitions) {
-                                const cloudsql::cluster::NodeInfo* target_node = nullptr;
-                                for (const auto& n : data_nodes) {
-                                    if (n.id == node_id) {
-                                        target_node = &n;
-                                        break;
-                                    }
-                                }
+                        static_cast<void>(rpc_server->send_response(
+                            fd, h, cloudsql::network::RpcType::QueryResults, reply.serialize()));
+                    });
 
-                                if (target_node != nullptr) {
-                                    cloudsql::network::RpcClient client(target_node->address,
-                                                                        target_node->cluster_port);
-                                    if (!client.connect()) {
-                                        overall_success = false;
-                                        delivery_errors += "Connect failed to " + node_id + "; ";
-                                        continue;
-                                    }
+                rpc_server->set_handler(
+                    cloudsql::network::RpcType::KeyFilter,
+                    [&](const cloudsql::network::RpcHeader& h, const std::vector<uint8_t>& p,
+                        int fd) {
+                        auto args = cloudsql::network::KeyFilterArgs::deserialize(p);
+                        cloudsql::network::KeyFilterReply reply;
+                        try {
+                            auto table_meta_opt = catalog->get_table_by_name(args.table_name);
+                            if (!table_meta_opt.has_value()) {
+                                throw std::runtime_error("Table not found: " + args.table_name);
+                            }
+                            const auto* table_meta = table_meta_opt.value();
+                            cloudsql::executor::Schema schema;
+                            for (const auto& col : table_meta->columns) {
+                                schema.add_column(col.name, col.type);
+                            }
+                            const size_t key_idx = schema.find_column(args.key_col);
+                            if (key_idx == static_cast<size_t>(-1)) {
+                                throw std::runtime_error("Join key column not found: " +
+                                                         args.key_col);
+                            }
 
-                                    cloudsql::network::PushDataArgs push_args;
-                                    push_args.context_id = args.context_id;
-                                    push_args.table_name = args.table_name;
-                                    push_args.rows = std::move(rows);
-                                    std::vector<uint8_t> resp;
-                                    if (!client.call(cloudsql::network::RpcType::PushData,
-                                                     push_args.serialize(), resp)) {
-                                        overall_success = false;
-                                        delivery_errors += "RPC failed to " + node_id + "; ";
-                                    } else {
-                                        auto push_reply =
-                                            cloudsql::network::QueryResultsReply::deserialize(resp);
-                                        if (!push_reply.success) {
-                                            overall_success = false;
-                                            delivery_errors += "Push failed on " + node_id + ": " +
-                                                               push_reply.error_msg + "; ";
-                                        }
-                                    }
+                            /* Keys first, so the filter can be sized for them */
+                            cloudsql::storage::HeapTable table(args.table_name, *bpm, schema);
+                            std::vector<bool> read_columns(schema.column_count(), false);
+                            read_columns[key_idx] = true;
+                            table.set_read_columns(std::move(read_columns));
+                            std::vector<cloudsql::common::Value> keys;
+                            auto iter = table.scan();
+                            cloudsql::storage::HeapTable::TupleMeta t_meta;
+                            while (iter.next_meta(t_meta)) {
+                                if (t_meta.xmax == 0) {
+                                    keys.push_back(t_meta.tuple.get(key_idx));
                                 }
                             }
-                            if (overall_success) {
-                                reply.success = true;
-                            } else {
-                                reply.success = false;
-                                reply.error_msg = "Shuffle delivery failed: " + delivery_errors;
+                            cloudsql::executor::RuntimeFilter filter(
+                                keys.size() * std::max<uint32_t>(args.node_count, 1));
+                            for (const auto& key : keys) {
+                                filter.add(key);
                             }
+                            reply.filter = std::move(filter);
+                            reply.success = true;
                         } catch (const std::exception& e) {
                             reply.success = false;
                             reply.error_msg = e.what();
                         }
 
-                        auto resp_p = reply.serialize();
-                        cloudsql::network::RpcHeader resp_h;
-                        resp_h.type = cloudsql::network::RpcType::QueryResults;
-                        resp_h.payload_len = static_cast<uint16_t>(resp_p.size());
-                        char h_buf[cloudsql::network::RpcHeader::HEADER_SIZE];
-                        resp_h.encode(h_buf);
-                        static_cast<void>(
-                            send(fd, h_buf, cloudsql::network::RpcHeader::HEADER_SIZE, 0));
-                        static_cast<void>(send(fd, resp_p.data(), resp_p.size(), 0));
+                        static_cast<void>(rpc_server->send_response(
+                            fd, h, cloudsql::network::RpcType::KeyFilter, reply.serialize()));
                     });
             }
 
@@ -647,8 +765,43 @@ int main(int argc, char* argv[]) {
             }
         }
 
+        std::unique_ptr<cloudsql::network::MetricsServer> metrics_server;
+        if (config.metrics_port != 0) {
+            metrics_server = std::make_unique<cloudsql::network::MetricsServer>(config.metrics_port);
+            if (metrics_server->start()) {
+                std::cout << "Serving metrics on port " << config.metrics_port << " at /metrics"
+                          << std::endl;
+            } else {
+                std::cerr << "Failed to start metrics endpoint; continuing without it"
+                          << std::endl;
+                metrics_server.reset();
+            }
+        }
+
         std::cout << "Node ready. Press Ctrl+C to stop." << std::endl;
 
+        /* Checkpointer: page writes for each checkpoint are spread over part of the interval */
+        const auto checkpoint_interval = std::chrono::seconds(config.checkpoint_interval_s);
+        std::mutex checkpoint_latch;
+        std::condition_variable checkpoint_cv;
+        bool checkpoint_stop = false;
+        std::thread checkpointer;
+        if (checkpoint_interval.count() > 0) {
+            checkpointer = std::thread([&] {
+                const auto spread =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(checkpoint_interval) *
+                    config.checkpoint_spread_pct / 100;
+                std::unique_lock<std::mutex> lock(checkpoint_latch);
+                while (!checkpoint_cv.wait_for(lock, checkpoint_interval,
+                                               [&] { return checkpoint_stop; })) {
+                    lock.unlock();
+                    static_cast<void>(rm.checkpoint(
+                        [&] { return transaction_manager.checkpoint_txns(); }, spread));
+                    lock.lock();
+                }
+            });
+        }
+
         /* Monitor shutdown flag */
         while (!shutdown_requested.load()) {
             /* Check if STDIN is piped SQL */
@@ -685,6 +838,9 @@ int main(int argc, char* argv[]) {
 
         /* Cleanup */
         std::cout << std::endl << "Shutting down..." << std::endl;
+        if (metrics_server) {
+            metrics_server->stop();
+        }
         auto& server = get_server_instance();
         if (server) {
             static_cast<void>(server->stop());
@@ -699,6 +855,16 @@ int main(int argc, char* argv[]) {
             rpc_server->stop();
         }
 
+        if (checkpointer.joinable()) {
+            {
+                const std::scoped_lock<std::mutex> lock(checkpoint_latch);
+                checkpoint_stop = true;
+            }
+            checkpoint_cv.notify_all();
+            checkpointer.join();
+        }
+        bpm->stop_background_writer();
+
         log_manager->stop_flush_thread();
 
         std::cout << "Goodbye!" << std::endl;
@@ -0,0 +1,283 @@
+/**
+ * @file columnar_codec.cpp
+ * @brief Column-at-a-time wire encoding of result rows
+ */
+
+#include "network/columnar_codec.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "common/value.hpp"
+#include "executor/types.hpp"
+#include "network/rpc_message.hpp"
+
+namespace cloudsql::network {
+
+namespace {
+
+enum class ColumnKind : uint8_t { Null = 0, Int64 = 1, Float64 = 2, Bool = 3, Text = 4, Mixed = 5 };
+
+constexpr size_t FIXED_WIDTH = 8;
+
+ColumnKind kind_of(const common::Value& val) {
+    switch (val.type()) {
+        case common::ValueType::TYPE_NULL:
+            return ColumnKind::Null;
+        case common::ValueType::TYPE_BOOL:
+            return ColumnKind::Bool;
+        case common::ValueType::TYPE_INT8:
+        case common::ValueType::TYPE_INT16:
+        case common::ValueType::TYPE_INT32:
+        case common::ValueType::TYPE_INT64:
+        case common::ValueType::TYPE_DECIMAL:
+            return ColumnKind::Int64;
+        case common::ValueType::TYPE_FLOAT32:
+        case common::ValueType::TYPE_FLOAT64:
+            return ColumnKind::Float64;
+        case common::ValueType::TYPE_CHAR:
+        case common::ValueType::TYPE_VARCHAR:
+        case common::ValueType::TYPE_TEXT:
+            return ColumnKind::Text;
+        default:
+            return ColumnKind::Mixed;
+    }
+}
+
+void put32(uint32_t v, std::vector<uint8_t>& out) {
+    const size_t offset = out.size();
+    out.resize(offset + sizeof(v));
+    std::memcpy(out.data() + offset, &v, sizeof(v));
+}
+
+bool get32(const uint8_t* data, size_t& offset, size_t size, uint32_t& v) {
+    if (size - offset < sizeof(v)) {
+        return false;
+    }
+    std::memcpy(&v, data + offset, sizeof(v));
+    offset += sizeof(v);
+    return true;
+}
+
+}  // namespace
+
+void encode_columnar_rows(const std::vector<executor::Tuple>& rows, std::vector<uint8_t>& out) {
+    size_t columns = 0;
+    for (const auto& row : rows) {
+        columns = std::max(columns, row.size());
+    }
+    const size_t count = rows.size();
+    put32(static_cast<uint32_t>(count), out);
+    put32(static_cast<uint32_t>(columns), out);
+
+    static const common::Value null_value = common::Value::make_null();
+    const auto cell = [&rows](size_t row, size_t col) -> const common::Value& {
+        return col < rows[row].size() ? rows[row].get(col) : null_value;
+    };
+
+    for (size_t col = 0; col < columns; ++col) {
+        ColumnKind kind = ColumnKind::Null;
+        bool has_nulls = false;
+        for (size_t row = 0; row < count; ++row) {
+            const ColumnKind k = kind_of(cell(row, col));
+            if (k == ColumnKind::Null) {
+                has_nulls = true;
+            } else if (kind == ColumnKind::Null) {
+                kind = k;
+            } else if (k != kind) {
+                kind = ColumnKind::Mixed;
+            }
+        }
+        out.push_back(static_cast<uint8_t>(kind));
+        if (kind == ColumnKind::Mixed) {
+            out.push_back(0);
+            for (size_t row = 0; row < count; ++row) {
+                Serializer::serialize_value(cell(row, col), out);
+            }
+            continue;
+        }
+        out.push_back(has_nulls ? 1 : 0);
+        if (has_nulls && kind != ColumnKind::Null) {
+            const size_t bitmap = out.size();
+            out.resize(bitmap + (count + 7) / 8, 0);
+            for (size_t row = 0; row < count; ++row) {
+                if (cell(row, col).is_null()) {
+                    out[bitmap + row / 8] |= static_cast<uint8_t>(1U << (row % 8));
+                }
+            }
+        }
+
+        switch (kind) {
+            case ColumnKind::Int64:
+            case ColumnKind::Float64: {
+                const size_t base = out.size();
+                out.resize(base + count * FIXED_WIDTH, 0);
+                for (size_t row = 0; row < count; ++row) {
+                    const auto& val = cell(row, col);
+                    if (val.is_null()) {
+                        continue;
+                    }
+                    uint8_t* const dst = out.data() + base + row * FIXED_WIDTH;
+                    if (kind == ColumnKind::Int64) {
+                        const int64_t v = val.to_int64();
+                        std::memcpy(dst, &v, FIXED_WIDTH);
+                    } else {
+                        const double v = val.to_float64();
+                        std::memcpy(dst, &v, FIXED_WIDTH);
+                    }
+                }
+                break;
+            }
+            case ColumnKind::Bool:
+                for (size_t row = 0; row < count; ++row) {
+                    const auto& val = cell(row, col);
+                    out.push_back(!val.is_null() && val.as_bool() ? 1 : 0);
+                }
+                break;
+            case ColumnKind::Text: {
+                /* Offsets first, so the reader can slice the strings without scanning */
+                const size_t offsets = out.size();
+                out.resize(offsets + (count + 1) * sizeof(uint32_t));
+                uint32_t end = 0;
+                for (size_t row = 0; row < count; ++row) {
+                    std::memcpy(out.data() + offsets + row * sizeof(uint32_t), &end, sizeof(end));
+                    const auto& val = cell(row, col);
+                    if (!val.is_null()) {
+                        const std::string s = val.to_string();
+                        out.insert(out.end(), s.begin(), s.end());
+                        end += static_cast<uint32_t>(s.size());
+                    }
+                }
+                std::memcpy(out.data() + offsets + count * sizeof(uint32_t), &end, sizeof(end));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+bool decode_columnar_rows(const uint8_t* data, size_t& offset, size_t size,
+                          std::vector<executor::Tuple>& rows) {
+    uint32_t count = 0;
+    uint32_t columns = 0;
+    if (!get32(data, offset, size, count) || !get32(data, offset, size, columns)) {
+        return false;
+    }
+    const size_t first = rows.size();
+    rows.resize(first + count);
+    for (size_t row = 0; row < count; ++row) {
+        rows[first + row].values().reserve(columns);
+    }
+    const auto append = [&](size_t row, common::Value val) {
+        rows[first + row].values().push_back(std::move(val));
+    };
+
+    for (uint32_t col = 0; col < columns; ++col) {
+        if (size - offset < 2) {
+            return false;
+        }
+        const auto kind = static_cast<ColumnKind>(data[offset]);
+        const bool has_nulls = data[offset + 1] != 0;
+        offset += 2;
+
+        if (kind == ColumnKind::Mixed) {
+            for (size_t row = 0; row < count; ++row) {
+                if (offset >= size) {
+                    return false;
+                }
+                append(row, Serializer::deserialize_value(data, offset, size));
+            }
+            continue;
+        }
+        if (kind == ColumnKind::Null) {
+            for (size_t row = 0; row < count; ++row) {
+                append(row, common::Value::make_null());
+            }
+            continue;
+        }
+
+        const uint8_t* nulls = nullptr;
+        if (has_nulls) {
+            const size_t bitmap_size = (static_cast<size_t>(count) + 7) / 8;
+            if (size - offset < bitmap_size) {
+                return false;
+            }
+            nulls = data + offset;
+            offset += bitmap_size;
+        }
+        const auto is_null = [nulls](size_t row) {
+            return nulls != nullptr && (nulls[row / 8] & (1U << (row % 8))) != 0;
+        };
+
+        switch (kind) {
+            case ColumnKind::Int64:
+            case ColumnKind::Float64: {
+                if ((size - offset) / FIXED_WIDTH < count) {
+                    return false;
+                }
+                for (size_t row = 0; row < count; ++row, offset += FIXED_WIDTH) {
+                    if (is_null(row)) {
+                        append(row, common::Value::make_null());
+                    } else if (kind == ColumnKind::Int64) {
+                        int64_t v = 0;
+                        std::memcpy(&v, data + offset, FIXED_WIDTH);
+                        append(row, common::Value::make_int64(v));
+                    } else {
+                        double v = 0;
+                        std::memcpy(&v, data + offset, FIXED_WIDTH);
+                        append(row, common::Value::make_float64(v));
+                    }
+                }
+                break;
+            }
+            case ColumnKind::Bool:
+                if (size - offset < count) {
+                    return false;
+                }
+                for (size_t row = 0; row < count; ++row, ++offset) {
+                    append(row, is_null(row) ? common::Value::make_null()
+                                             : common::Value::make_bool(data[offset] != 0));
+                }
+                break;
+            case ColumnKind::Text: {
+                if ((size - offset) / sizeof(uint32_t) < static_cast<size_t>(count) + 1) {
+                    return false;
+                }
+                const uint8_t* const offsets = data + offset;
+                offset += (static_cast<size_t>(count) + 1) * sizeof(uint32_t);
+                uint32_t total = 0;
+                std::memcpy(&total, offsets + count * sizeof(uint32_t), sizeof(total));
+                if (size - offset < total) {
+                    return false;
+                }
+                const char* const chars = reinterpret_cast<const char*>(data + offset);
+                uint32_t begin = 0;
+                for (size_t row = 0; row < count; ++row) {
+                    uint32_t end = 0;
+                    std::memcpy(&end, offsets + (row + 1) * sizeof(uint32_t), sizeof(end));
+                    if (end < begin || end > total) {
+                        return false;
+                    }
+                    append(row, is_null(row) ? common::Value::make_null()
+                                             : common::Value::make_text(std::string_view(
+                                                   chars + begin, end - begin)));
+                    begin = end;
+                }
+                offset += total;
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace cloudsql::network
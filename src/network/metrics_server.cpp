@@ -0,0 +1,186 @@
+/**
+ * @file metrics_server.cpp
+ * @brief HTTP metrics endpoint implementation
+ */
+
+#include "network/metrics_server.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "common/metrics.hpp"
+#include "common/trace.hpp"
+
+namespace cloudsql::network {
+
+namespace {
+
+constexpr int REQUEST_TIMEOUT_MS = 2000;
+constexpr size_t MAX_REQUEST_BYTES = 8192;
+constexpr size_t READ_CHUNK_SIZE = 1024;
+
+std::string http_response(const char* status, const char* content_type, const std::string& body) {
+    return std::string("HTTP/1.0 ") + status + "\r\nContent-Type: " + content_type +
+           "\r\nContent-Length: " + std::to_string(body.size()) +
+           "\r\nConnection: close\r\n\r\n" + body;
+}
+
+}  // namespace
+
+std::string MetricsServer::respond(const std::string& request_line) {
+    const size_t method_end = request_line.find(' ');
+    const size_t path_end = request_line.find(' ', method_end + 1);
+    if (method_end == std::string::npos) {
+        return http_response("400 Bad Request", "text/plain", "bad request\n");
+    }
+    const std::string method = request_line.substr(0, method_end);
+    std::string path = request_line.substr(method_end + 1, path_end == std::string::npos
+                                                               ? std::string::npos
+                                                               : path_end - method_end - 1);
+    path = path.substr(0, path.find('?'));
+    if (method != "GET" && method != "HEAD") {
+        return http_response("405 Method Not Allowed", "text/plain", "only GET is supported\n");
+    }
+    std::string body;
+    const char* content_type = nullptr;
+    if (path == "/metrics") {
+        body = common::MetricsRegistry::global().collect().to_prometheus();
+        content_type = "text/plain; version=0.0.4; charset=utf-8";
+    } else if (path == "/traces") {
+        body = common::Tracer::global().to_otlp_json();
+        content_type = "application/json";
+    } else {
+        return http_response("404 Not Found", "text/plain",
+                             "metrics are served at /metrics, spans at /traces\n");
+    }
+    std::string response = http_response("200 OK", content_type, body);
+    if (method == "HEAD") {
+        response.resize(response.size() - body.size());
+    }
+    return response;
+}
+
+bool MetricsServer::start() {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        return false;
+    }
+    int opt = 1;
+    static_cast<void>(setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)));
+
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port_);
+    socklen_t addr_len = sizeof(addr);
+    if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd_, SOMAXCONN) < 0 ||
+        getsockname(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), &addr_len) < 0) {
+        std::cerr << "--- [MetricsServer] cannot listen on port " << port_ << " ---" << std::endl;
+        static_cast<void>(close(listen_fd_));
+        listen_fd_ = -1;
+        return false;
+    }
+    port_ = ntohs(addr.sin_port);
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        static_cast<void>(close(listen_fd_));
+        listen_fd_ = -1;
+        return false;
+    }
+    running_ = true;
+    thread_ = std::thread(&MetricsServer::accept_loop, this);
+    return true;
+}
+
+void MetricsServer::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    const uint64_t one = 1;
+    static_cast<void>(write(wake_fd_, &one, sizeof(one)));
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    static_cast<void>(close(listen_fd_));
+    static_cast<void>(close(wake_fd_));
+    listen_fd_ = -1;
+    wake_fd_ = -1;
+}
+
+void MetricsServer::accept_loop() {
+    std::array<struct pollfd, 2> fds{};
+    fds[0] = {listen_fd_, POLLIN, 0};
+    fds[1] = {wake_fd_, POLLIN, 0};
+    while (running_) {
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if ((fds[1].revents & POLLIN) != 0) {
+            break;
+        }
+        if ((fds[0].revents & POLLIN) == 0) {
+            continue;
+        }
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0) {
+            serve(fd);
+            static_cast<void>(close(fd));
+        }
+    }
+}
+
+void MetricsServer::serve(int fd) const {
+    /* Only the request line matters; read until the headers end */
+    std::string request;
+    std::array<char, READ_CHUNK_SIZE> buf{};
+    while (request.find("\r\n\r\n") == std::string::npos &&
+           request.find("\n\n") == std::string::npos && request.size() < MAX_REQUEST_BYTES) {
+        struct pollfd pfd {
+            fd, POLLIN, 0
+        };
+        if (poll(&pfd, 1, REQUEST_TIMEOUT_MS) <= 0) {
+            return;
+        }
+        const ssize_t n = recv(fd, buf.data(), buf.size(), 0);
+        if (n <= 0) {
+            break;
+        }
+        request.append(buf.data(), static_cast<size_t>(n));
+    }
+    std::string line = request.substr(0, request.find('\n'));
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+
+    const std::string response = respond(line);
+    size_t sent = 0;
+    while (sent < response.size()) {
+        const ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
+
+}  // namespace cloudsql::network
@@ -7,21 +7,60 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "common/latency_histogram.hpp"
+#include "common/metrics.hpp"
+#include "common/trace.hpp"
 #include "network/rpc_message.hpp"
 
 namespace cloudsql::network {
 
+namespace {
+
+struct ClientMetrics {
+    common::Counter& requests;
+    common::Counter& failures;
+    common::Counter& bytes_sent;
+    common::Counter& bytes_received;
+    common::LatencyHistogram& latency;
+};
+
+ClientMetrics& client_metrics() {
+    auto& registry = common::MetricsRegistry::global();
+    static ClientMetrics metrics{
+        registry.counter("cloudsql_rpc_client_requests_total", "RPC requests sent"),
+        registry.counter("cloudsql_rpc_client_failures_total",
+                         "RPC calls failed by a send or receive error"),
+        registry.counter("cloudsql_rpc_client_sent_bytes_total", "RPC request frame bytes sent"),
+        registry.counter("cloudsql_rpc_client_received_bytes_total",
+                         "RPC response payload bytes received"),
+        registry.histogram("cloudsql_rpc_client_call_latency_seconds",
+                           "Request sent to response received")};
+    return metrics;
+}
+
+}  // namespace
+
 RpcClient::RpcClient(const std::string& address, uint16_t port) : address_(address), port_(port) {}
 
 RpcClient::~RpcClient() {
@@ -29,11 +68,17 @@ RpcClient::~RpcClient() {
 }
 
 bool RpcClient::connect() {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    return connect_locked();
+}
+
+bool RpcClient::connect_locked() {
     if (fd_ >= 0) {
         return true;
     }
 
-    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    peer_flags_ = 0; /* A new connection may reach a different build */
+    fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (fd_ < 0) {
         std::cerr << "--- [RpcClient] socket creation FAILED: " << strerror(errno) << " ---"
                   << std::endl;
@@ -54,100 +99,328 @@ bool RpcClient::connect() {
         return false;
     }
 
+    /* Requests are small and latency-bound; long-lived pooled connections need keep-alive */
+    int opt = 1;
+    static_cast<void>(setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt)));
+    static_cast<void>(setsockopt(fd_, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof(opt)));
+
     std::cerr << "--- [RpcClient] connected to " << address_ << ":" << port_ << " ---" << std::endl;
     return true;
 }
 
 void RpcClient::disconnect() {
-    const std::scoped_lock<std::mutex> lock(mutex_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    reader_stop_ = true;
     if (fd_ >= 0) {
-        static_cast<void>(close(fd_));
-        fd_ = -1;
+        /* Wakes whoever is blocked receiving */
+        static_cast<void>(shutdown(fd_, SHUT_RDWR));
+    }
+    response_cv_.notify_all();
+    std::thread reader = std::move(reader_);
+    lock.unlock();
+    if (reader.joinable()) {
+        reader.join();
     }
+
+    lock.lock();
+    response_cv_.wait(lock, [this] { return !reading_; });
+    Completions done;
+    fail_pending(done);
+    reader_stop_ = false;
+    lock.unlock();
+    run(done);
+}
+
+bool RpcClient::healthy() const {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    if (fd_ < 0) {
+        return false;
+    }
+    if (reading_ || !pending_.empty()) {
+        return true; /* In use: a broken connection fails the calls on it */
+    }
+    /* Idle, so nothing may be readable: either the peer closed or the stream is out of step */
+    struct pollfd pfd {
+        fd_, POLLIN, 0
+    };
+    return poll(&pfd, 1, 0) == 0;
+}
+
+bool RpcClient::peer_accepts(uint8_t capability) const {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    return (peer_flags_ & capability) != 0;
 }
 
 bool RpcClient::call(RpcType type, const std::vector<uint8_t>& payload,
                      std::vector<uint8_t>& response_out, uint16_t group_id) {
-    const std::scoped_lock<std::mutex> lock(mutex_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto slot = start_call(type, payload, group_id);
+    if (!slot) {
+        return false;
+    }
 
-    std::cerr << "--- [RpcClient] call type=" << (int)type << " to " << address_ << ":" << port_
-              << " ---" << std::endl;
+    /* Whoever is not already covered by another thread's read receives for everyone */
+    Completions done;
+    while (!slot->done) {
+        if (reading_) {
+            response_cv_.wait(lock);
+            continue;
+        }
+        read_response(lock, done);
+        if (!done.empty()) {
+            lock.unlock();
+            run(done);
+            lock.lock();
+        }
+    }
 
-    if (fd_ < 0 && !connect()) {
-        std::cerr << "--- [RpcClient] connect failed to " << address_ << ":" << port_ << " ---"
-                  << std::endl;
+    if (slot->failed) {
         return false;
     }
+    response_out = std::move(slot->response);
+    return true;
+}
+
+void RpcClient::call_async(RpcType type, const std::vector<uint8_t>& payload,
+                           RpcCallback callback, uint16_t group_id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!reader_.joinable()) {
+        reader_ = std::thread(&RpcClient::reader_loop, this);
+    }
+    const auto slot = start_call(type, payload, group_id);
+    if (!slot) {
+        lock.unlock();
+        callback(RpcResult{});
+        return;
+    }
+    slot->callback = std::move(callback);
+}
+
+std::future<RpcResult> RpcClient::call_async(RpcType type, const std::vector<uint8_t>& payload,
+                                             uint16_t group_id) {
+    auto promise = std::make_shared<std::promise<RpcResult>>();
+    auto future = promise->get_future();
+    call_async(
+        type, payload,
+        [promise](RpcResult result) { promise->set_value(std::move(result)); }, group_id);
+    return future;
+}
+
+bool RpcClient::send_only(RpcType type, const std::vector<uint8_t>& payload, uint16_t group_id) {
+    const std::scoped_lock<std::mutex> lock(mutex_);
 
-    // Transmission Phase
     RpcHeader header;
     header.type = type;
+    header.flags = RpcHeader::FLAG_NO_REPLY;
     header.group_id = group_id;
-    header.payload_len = static_cast<uint16_t>(payload.size());
-
-    char header_buf[RpcHeader::HEADER_SIZE];
-    header.encode(header_buf);
+    /* Nothing comes back to time, so the handler's span hangs off the caller's */
+    const common::TraceContext trace = common::Tracer::current();
+    header.trace_id = trace.trace_id;
+    header.parent_span_id = trace.span_id;
+    return send_request(header, payload);
+}
 
-    if (send(fd_, header_buf, RpcHeader::HEADER_SIZE, 0) <= 0) {
-        std::cerr << "--- [RpcClient] header send failed ---" << std::endl;
-        return false;
+std::shared_ptr<RpcClient::PendingCall> RpcClient::start_call(RpcType type,
+                                                              const std::vector<uint8_t>& payload,
+                                                              uint16_t group_id) {
+    RpcHeader header;
+    header.type = type;
+    header.group_id = group_id;
+    auto slot = std::make_shared<PendingCall>();
+    const common::TraceContext trace = common::Tracer::current();
+    if (trace.traced()) {
+        common::SpanRecord& span = slot->span;
+        span.trace_id = trace.trace_id;
+        span.parent_id = trace.span_id;
+        span.span_id = common::Tracer::new_id();
+        span.name = "rpc.client";
+        span.start_us = common::Tracer::wall_clock_us();
+        span.attributes = {{"rpc.method", rpc_type_name(type)},
+                           {"peer", address_ + ":" + std::to_string(port_)}};
+        header.trace_id = span.trace_id;
+        header.parent_span_id = span.span_id;
+    }
+    if (!send_request(header, payload)) {
+        end_span(*slot, false);
+        return nullptr;
     }
+    pending_.emplace_back(header.request_id, slot);
+    response_cv_.notify_all(); /* The reader thread only receives while calls are in flight */
+    return slot;
+}
 
-    if (!payload.empty()) {
-        if (send(fd_, payload.data(), payload.size(), 0) <= 0) {
-            std::cerr << "--- [RpcClient] payload send failed ---" << std::endl;
+bool RpcClient::send_request(RpcHeader& header, const std::vector<uint8_t>& payload) {
+    if (fd_ < 0) {
+        common::Span span("rpc.connect");
+        if (span.active()) {
+            span.set_attribute("peer", address_ + ":" + std::to_string(port_));
+        }
+        if (!connect_locked()) {
+            span.set_attribute("error", "connect failed");
+            std::cerr << "--- [RpcClient] connect failed to " << address_ << ":" << port_
+                      << " ---" << std::endl;
+            client_metrics().failures.inc();
             return false;
         }
     }
 
-    // Reception Phase: Must occur under the same lock to ensure atomicity
-    std::cerr << "--- [RpcClient] waiting for response ---" << std::endl;
-    std::array<char, RpcHeader::HEADER_SIZE> resp_buf{};
-    if (recv(fd_, resp_buf.data(), RpcHeader::HEADER_SIZE, MSG_WAITALL) <= 0) {
-        std::cerr << "--- [RpcClient] recv header failed ---" << std::endl;
-        return false;
+    if ((header.flags & RpcHeader::FLAG_NO_REPLY) == 0) {
+        const auto in_flight = [this](uint16_t id) {
+            return std::any_of(pending_.begin(), pending_.end(),
+                               [id](const auto& entry) { return entry.first == id; });
+        };
+        do {
+            header.request_id = ++next_request_id_;
+        } while (header.request_id == 0 || in_flight(header.request_id));
     }
 
-    const RpcHeader resp_header = RpcHeader::decode(resp_buf.data());
-    response_out.resize(resp_header.payload_len);
-
-    if (resp_header.payload_len > 0) {
-        if (recv(fd_, response_out.data(), resp_header.payload_len, MSG_WAITALL) <= 0) {
-            std::cerr << "--- [RpcClient] recv payload failed ---" << std::endl;
+    header.flags |= RpcHeader::FLAGS_ACCEPTED;
+    std::vector<uint8_t> compressed;
+    const auto& body = (peer_flags_ & RpcHeader::FLAG_ACCEPT_LZ4) != 0
+                           ? compress_payload(header, payload, compressed)
+                           : payload;
+    header.payload_len = static_cast<uint32_t>(body.size());
+
+    /* One write per frame: header and payload never go out as separate segments */
+    const size_t header_size = header.encoded_size();
+    std::vector<char> frame(header_size + body.size());
+    header.encode(frame.data());
+    if (!body.empty()) {
+        std::memcpy(frame.data() + header_size, body.data(), body.size());
+    }
+    size_t sent = 0;
+    while (sent < frame.size()) {
+        const ssize_t n = send(fd_, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            std::cerr << "--- [RpcClient] request send failed ---" << std::endl;
+            client_metrics().failures.inc();
             return false;
         }
+        sent += static_cast<size_t>(n);
     }
-
-    std::cerr << "--- [RpcClient] call success ---" << std::endl;
+    client_metrics().requests.inc();
+    client_metrics().bytes_sent.inc(frame.size());
     return true;
 }
 
-bool RpcClient::send_only(RpcType type, const std::vector<uint8_t>& payload, uint16_t group_id) {
-    const std::scoped_lock<std::mutex> lock(mutex_);
-
-    if (fd_ < 0 && !connect()) {
-        return false;
+void RpcClient::read_response(std::unique_lock<std::mutex>& lock, Completions& done) {
+    reading_ = true;
+    const int fd = fd_;
+    lock.unlock();
+
+    const auto receive = [fd](void* buf, size_t size) {
+        return size == 0 || recv(fd, buf, size, MSG_WAITALL) == static_cast<ssize_t>(size);
+    };
+    std::array<char, RpcHeader::MAX_HEADER_SIZE> resp_buf{};
+    RpcHeader resp_header;
+    std::vector<uint8_t> response;
+    bool ok = receive(resp_buf.data(), RpcHeader::HEADER_SIZE);
+    if (ok) {
+        resp_header = RpcHeader::decode(resp_buf.data());
+        ok = receive(resp_buf.data() + RpcHeader::HEADER_SIZE, resp_header.extension_size());
+        resp_header.decode_extension(resp_buf.data() + RpcHeader::HEADER_SIZE);
+    }
+    if (ok) {
+        response.resize(resp_header.payload_len);
+        ok = receive(response.data(), response.size()) &&
+             decompress_payload(resp_header, response);
     }
 
-    RpcHeader header;
-    header.type = type;
-    header.group_id = group_id;
-    header.payload_len = static_cast<uint16_t>(payload.size());
+    lock.lock();
+    reading_ = false;
+    if (ok) {
+        peer_flags_ = resp_header.flags & RpcHeader::FLAGS_ACCEPTED;
+    }
+    if (!ok) {
+        if (!reader_stop_) {
+            std::cerr << "--- [RpcClient] recv response failed from " << address_ << ":" << port_
+                      << " ---" << std::endl;
+        }
+        fail_pending(done);
+    } else {
+        /* A server that does not echo ids answers in order: give it to the oldest call */
+        auto it = std::find_if(pending_.begin(), pending_.end(), [&](const auto& entry) {
+            return entry.first == resp_header.request_id;
+        });
+        if (resp_header.request_id == 0 && !pending_.empty()) {
+            it = pending_.begin();
+        }
+        client_metrics().bytes_received.inc(RpcHeader::HEADER_SIZE + response.size());
+        if (it != pending_.end()) {
+            PendingCall& call = *it->second;
+            client_metrics().latency.record(std::chrono::steady_clock::now() - call.started);
+            end_span(call, true);
+            if (call.callback) {
+                done.emplace_back(std::move(call.callback), RpcResult{true, std::move(response)});
+            } else {
+                call.response = std::move(response);
+            }
+            call.done = true;
+            pending_.erase(it);
+        }
+    }
+    response_cv_.notify_all();
+}
 
-    char header_buf[RpcHeader::HEADER_SIZE];
-    header.encode(header_buf);
+void RpcClient::fail_pending(Completions& done) {
+    client_metrics().failures.inc(pending_.size());
+    for (auto& entry : pending_) {
+        PendingCall& call = *entry.second;
+        end_span(call, false);
+        if (call.callback) {
+            done.emplace_back(std::move(call.callback), RpcResult{});
+        }
+        call.failed = true;
+        call.done = true;
+    }
+    pending_.clear();
+    /* The stream is out of step now; later calls start on a new connection */
+    if (fd_ >= 0) {
+        static_cast<void>(close(fd_));
+        fd_ = -1;
+    }
+}
 
-    if (send(fd_, header_buf, RpcHeader::HEADER_SIZE, 0) <= 0) {
-        return false;
+void RpcClient::end_span(PendingCall& call, bool ok) {
+    if (call.span.trace_id == 0) {
+        return;
     }
+    call.span.duration_us = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                              call.started)
+            .count());
+    if (!ok) {
+        call.span.attributes.emplace_back("error", "no response");
+    }
+    common::Tracer::global().record(std::move(call.span));
+    call.span = common::SpanRecord{};
+}
 
-    if (!payload.empty()) {
-        if (send(fd_, payload.data(), payload.size(), 0) <= 0) {
-            return false;
+void RpcClient::reader_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Completions done;
+    while (!reader_stop_) {
+        if (reading_ || pending_.empty()) {
+            response_cv_.wait(lock);
+            continue;
+        }
+        read_response(lock, done);
+        if (!done.empty()) {
+            lock.unlock();
+            run(done);
+            lock.lock();
         }
     }
+}
 
-    return true;
+void RpcClient::run(Completions& done) {
+    for (auto& [callback, result] : done) {
+        callback(std::move(result));
+    }
+    done.clear();
 }
 
 }  // namespace cloudsql::network
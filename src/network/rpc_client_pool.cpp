@@ -0,0 +1,114 @@
+/**
+ * @file rpc_client_pool.cpp
+ * @brief Per-node pool of connected RPC clients
+ */
+
+#include "network/rpc_client_pool.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cloudsql::network {
+
+namespace {
+
+std::string node_key(const std::string& address, uint16_t port) {
+    return address + ":" + std::to_string(port);
+}
+
+}  // namespace
+
+std::shared_ptr<RpcClient> RpcClientPool::get(const std::string& address, uint16_t port) {
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<RpcClient>> expired; /* Disconnected after the lock is released */
+    size_t index = 0;
+    {
+        const std::scoped_lock<std::mutex> lock(mutex_);
+        prune_idle(now, expired);
+        Node& node = nodes_[node_key(address, port)];
+        if (node.slots.size() < clients_per_node_) {
+            node.slots.resize(clients_per_node_);
+        }
+        index = node.next;
+        node.next = (node.next + 1) % node.slots.size();
+        Slot& slot = node.slots[index];
+        if (slot.client && slot.client->healthy()) {
+            slot.last_used = now;
+            return slot.client;
+        }
+    }
+
+    /* Connect outside the lock: other nodes' callers need not wait for this one */
+    auto client = std::make_shared<RpcClient>(address, port);
+    if (!client->connect()) {
+        return nullptr;
+    }
+
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    Node& node = nodes_[node_key(address, port)];
+    if (node.slots.size() < clients_per_node_) {
+        node.slots.resize(clients_per_node_);
+    }
+    Slot& slot = node.slots[index];
+    if (slot.client && slot.client->healthy()) {
+        return slot.client; /* Someone else reconnected it meanwhile */
+    }
+    if (slot.client) {
+        expired.push_back(std::move(slot.client));
+    }
+    slot.client = client;
+    slot.last_used = now;
+    return client;
+}
+
+void RpcClientPool::remove(const std::string& address, uint16_t port) {
+    Node removed;
+    {
+        const std::scoped_lock<std::mutex> lock(mutex_);
+        const auto it = nodes_.find(node_key(address, port));
+        if (it == nodes_.end()) {
+            return;
+        }
+        removed = std::move(it->second);
+        nodes_.erase(it);
+    }
+    /* Clients disconnect as they are destroyed, once their current users let go */
+}
+
+void RpcClientPool::clear() {
+    std::unordered_map<std::string, Node> removed;
+    {
+        const std::scoped_lock<std::mutex> lock(mutex_);
+        removed.swap(nodes_);
+    }
+}
+
+size_t RpcClientPool::size() const {
+    const std::scoped_lock<std::mutex> lock(mutex_);
+    size_t open = 0;
+    for (const auto& [key, node] : nodes_) {
+        for (const auto& slot : node.slots) {
+            open += slot.client && slot.client->is_connected() ? 1 : 0;
+        }
+    }
+    return open;
+}
+
+void RpcClientPool::prune_idle(std::chrono::steady_clock::time_point now,
+                               std::vector<std::shared_ptr<RpcClient>>& expired) {
+    for (auto& [key, node] : nodes_) {
+        for (auto& slot : node.slots) {
+            if (slot.client && slot.client.use_count() == 1 &&
+                now - slot.last_used > idle_timeout_) {
+                expired.push_back(std::move(slot.client));
+            }
+        }
+    }
+}
+
+}  // namespace cloudsql::network
@@ -7,24 +7,125 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
-#include <sys/select.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
-#include <sys/time.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <exception>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#include "common/latency_histogram.hpp"
+#include "common/metrics.hpp"
+#include "common/trace.hpp"
 #include "network/rpc_message.hpp"
 
 namespace cloudsql::network {
 
+namespace {
+
+constexpr size_t READ_CHUNK_SIZE = 16384;
+
+/*
+ * Consensus traffic, fragment cancellation and shuffle chunks: short requests
+ * served ahead of everything else and by the reserved handler thread. Shuffle
+ * chunks are here because a fragment waiting on its exchange holds a handler
+ * thread; the chunks it waits for must not queue behind it.
+ */
+constexpr std::array<RpcType, 6> CONTROL_TYPES = {
+    RpcType::Heartbeat,      RpcType::RequestVote,    RpcType::AppendEntries,
+    RpcType::GroupHeartbeat, RpcType::CancelFragment, RpcType::PushData};
+
+bool is_control(RpcType type) {
+    return std::find(CONTROL_TYPES.begin(), CONTROL_TYPES.end(), type) != CONTROL_TYPES.end();
+}
+
+/** @brief Writes all of `data` to a non-blocking socket, waiting while it is full */
+bool send_all(int fd, const char* data, size_t size) {
+    size_t sent = 0;
+    while (sent < size) {
+        const ssize_t n = send(fd, data + sent, size - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd pfd {
+                fd, POLLOUT, 0
+            };
+            static_cast<void>(poll(&pfd, 1, -1));
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+struct ServerMetrics {
+    common::Counter& requests;
+    common::Counter& handler_errors;
+    common::Counter& bytes_received;
+    common::Counter& bytes_sent;
+    common::LatencyHistogram& latency;
+};
+
+ServerMetrics& server_metrics() {
+    auto& registry = common::MetricsRegistry::global();
+    static ServerMetrics metrics{
+        registry.counter("cloudsql_rpc_server_requests_total", "RPC requests handled"),
+        registry.counter("cloudsql_rpc_server_handler_errors_total",
+                         "RPC requests dropped, unhandled or failed by their handler"),
+        registry.counter("cloudsql_rpc_server_received_bytes_total", "RPC bytes received"),
+        registry.counter("cloudsql_rpc_server_sent_bytes_total", "RPC response frame bytes sent"),
+        registry.histogram("cloudsql_rpc_server_handler_latency_seconds",
+                           "Time a handler spent on one request")};
+    return metrics;
+}
+
+}  // namespace
+
+/**
+ * @brief An accepted socket, shared by the I/O thread and the requests it read
+ *
+ * The socket is closed when the last reference goes, so its descriptor is not
+ * reused while a handler may still reply on it.
+ */
+struct RpcServer::Connection {
+    Connection(RpcServer& owner, int socket_fd) : server(owner), fd(socket_fd) {}
+    ~Connection() {
+        server.forget_connection(fd);
+        static_cast<void>(close(fd));
+    }
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+    Connection(Connection&&) = delete;
+    Connection& operator=(Connection&&) = delete;
+
+    RpcServer& server;
+    const int fd;
+    std::vector<char> in; /**< Bytes of a request frame not fully received yet */
+    std::mutex write_mutex;
+};
+
 bool RpcServer::start() {
     std::cerr << "--- [RpcServer] starting on port " << port_ << " ---" << std::endl;
-    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (listen_fd_ < 0) {
         std::cerr << "--- [RpcServer] socket creation FAILED ---" << std::endl;
         return false;
@@ -45,41 +146,67 @@ bool RpcServer::start() {
         return false;
     }
 
-    if (listen(listen_fd_, 10) < 0) {
+    if (listen(listen_fd_, SOMAXCONN) < 0) {
         std::cerr << "--- [RpcServer] listen FAILED on port " << port_ << " ---" << std::endl;
         static_cast<void>(close(listen_fd_));
         listen_fd_ = -1;
         return false;
     }
 
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        std::cerr << "--- [RpcServer] eventfd FAILED ---" << std::endl;
+        static_cast<void>(close(listen_fd_));
+        listen_fd_ = -1;
+        return false;
+    }
+
     running_ = true;
-    accept_thread_ = std::thread(&RpcServer::accept_loop, this);
+    {
+        const std::scoped_lock<std::mutex> lock(queue_mutex_);
+        handlers_stop_ = false;
+    }
+    const size_t threads = std::max<size_t>(handler_threads_, 1);
+    for (size_t i = 0; i < threads; ++i) {
+        /* With more than one thread, the first is kept free for Raft and cancellations */
+        handler_pool_.emplace_back(&RpcServer::handler_loop, this, i == 0 && threads > 1);
+    }
+    io_thread_ = std::thread(&RpcServer::io_loop, this);
     std::cerr << "--- [RpcServer] started and listening ---" << std::endl;
     return true;
 }
 
 void RpcServer::stop() {
     running_ = false;
-    if (listen_fd_ >= 0) {
-        static_cast<void>(shutdown(listen_fd_, SHUT_RDWR));
-        static_cast<void>(close(listen_fd_));
-        listen_fd_ = -1;
+    if (wake_fd_ >= 0) {
+        const uint64_t one = 1;
+        static_cast<void>(write(wake_fd_, &one, sizeof(one)));
     }
-    if (accept_thread_.joinable()) {
-        accept_thread_.join();
+    if (io_thread_.joinable()) {
+        io_thread_.join();
     }
 
-    std::vector<std::thread> workers;
     {
-        const std::scoped_lock<std::mutex> lock(worker_mutex_);
-        workers.swap(worker_threads_);
+        const std::scoped_lock<std::mutex> lock(queue_mutex_);
+        handlers_stop_ = true;
+        queues_.clear();
     }
-
-    for (auto& t : workers) {
+    queue_cv_.notify_all();
+    for (auto& t : handler_pool_) {
         if (t.joinable()) {
             t.join();
         }
     }
+    handler_pool_.clear();
+
+    if (listen_fd_ >= 0) {
+        static_cast<void>(close(listen_fd_));
+        listen_fd_ = -1;
+    }
+    if (wake_fd_ >= 0) {
+        static_cast<void>(close(wake_fd_));
+        wake_fd_ = -1;
+    }
 
     const std::scoped_lock<std::mutex> lock(handlers_mutex_);
     handlers_.clear();
@@ -90,63 +217,236 @@ void RpcServer::set_handler(RpcType type, RpcHandler handler) {
     handlers_[type] = std::move(handler);
 }
 
-void RpcServer::accept_loop() {
+bool RpcServer::send_response(int fd, const RpcHeader& request, RpcType type,
+                              const std::vector<uint8_t>& payload) {
+    if ((request.flags & RpcHeader::FLAG_NO_REPLY) != 0) {
+        return true;
+    }
+    std::shared_ptr<Connection> conn;
+    {
+        const std::scoped_lock<std::mutex> lock(connections_mutex_);
+        const auto it = connections_.find(fd);
+        if (it != connections_.end()) {
+            conn = it->second.lock();
+        }
+    }
+    if (!conn) {
+        return false;
+    }
+
+    RpcHeader header;
+    header.type = type;
+    header.group_id = request.group_id;
+    header.request_id = request.request_id;
+    header.flags = RpcHeader::FLAGS_ACCEPTED;
+    std::vector<uint8_t> compressed;
+    const auto& body = request.accepts(RpcHeader::FLAG_ACCEPT_LZ4)
+                           ? compress_payload(header, payload, compressed)
+                           : payload;
+    header.payload_len = static_cast<uint32_t>(body.size());
+    const size_t header_size = header.encoded_size();
+    std::vector<char> frame(header_size + body.size());
+    header.encode(frame.data());
+    if (!body.empty()) {
+        std::memcpy(frame.data() + header_size, body.data(), body.size());
+    }
+
+    server_metrics().bytes_sent.inc(frame.size());
+    const std::scoped_lock<std::mutex> lock(conn->write_mutex);
+    return send_all(conn->fd, frame.data(), frame.size());
+}
+
+void RpcServer::io_loop() {
+    std::vector<std::shared_ptr<Connection>> conns;
+    std::vector<struct pollfd> fds;
     while (running_) {
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(listen_fd_, &fds);
-        struct timeval tv {
-            1, 0
-        };
-
-        if (select(listen_fd_ + 1, &fds, nullptr, nullptr, &tv) > 0) {
-            const int client_fd = accept(listen_fd_, nullptr, nullptr);
-            if (client_fd >= 0) {
-                const std::scoped_lock<std::mutex> lock(worker_mutex_);
-                worker_threads_.emplace_back(&RpcServer::handle_client, this, client_fd);
+        fds.clear();
+        fds.push_back({wake_fd_, POLLIN, 0});
+        fds.push_back({listen_fd_, POLLIN, 0});
+        for (const auto& conn : conns) {
+            fds.push_back({conn->fd, POLLIN, 0});
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "--- [RpcServer] poll FAILED: " << strerror(errno) << " ---" << std::endl;
+            break;
+        }
+        if (!running_) {
+            break;
+        }
+
+        /* Back to front, so dropping a connection keeps the earlier pollfds lined up */
+        for (size_t i = conns.size(); i-- > 0;) {
+            if (fds[i + 2].revents != 0 && !read_requests(conns[i])) {
+                conns.erase(conns.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+        }
+
+        if ((fds[1].revents & POLLIN) != 0) {
+            while (true) {
+                const int client_fd =
+                    accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (client_fd < 0) {
+                    break;
+                }
+                auto conn = std::make_shared<Connection>(*this, client_fd);
+                {
+                    const std::scoped_lock<std::mutex> lock(connections_mutex_);
+                    connections_[client_fd] = conn;
+                }
+                conns.push_back(std::move(conn));
             }
         }
     }
 }
 
-void RpcServer::handle_client(int client_fd) {
-    std::array<char, RpcHeader::HEADER_SIZE> header_buf{};
-    while (running_) {
-        const ssize_t n = recv(client_fd, header_buf.data(), RpcHeader::HEADER_SIZE, MSG_WAITALL);
-        if (n <= 0) {
+bool RpcServer::read_requests(const std::shared_ptr<Connection>& conn) {
+    std::array<char, READ_CHUNK_SIZE> buf{};
+    bool open = true;
+    while (true) {
+        const ssize_t n = recv(conn->fd, buf.data(), buf.size(), 0);
+        if (n > 0) {
+            server_metrics().bytes_received.inc(static_cast<uint64_t>(n));
+            conn->in.insert(conn->in.end(), buf.data(), buf.data() + n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        /* Requests that arrived before the peer closed still run */
+        open = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        break;
+    }
+
+    std::vector<Request> requests;
+    const auto now = std::chrono::steady_clock::now();
+    size_t pos = 0;
+    while (conn->in.size() - pos >= RpcHeader::HEADER_SIZE) {
+        RpcHeader header = RpcHeader::decode(conn->in.data() + pos);
+        if (header.magic != RpcHeader::MAGIC) {
+            std::cerr << "--- [RpcServer] bad request magic, dropping connection ---" << std::endl;
+            open = false;
+            break;
+        }
+        const size_t header_size = RpcHeader::HEADER_SIZE + header.extension_size();
+        if (conn->in.size() - pos < header_size) {
+            break;
+        }
+        header.decode_extension(conn->in.data() + pos + RpcHeader::HEADER_SIZE);
+        const size_t frame_size = header_size + header.payload_len;
+        if (conn->in.size() - pos < frame_size) {
             break;
         }
+        const auto* payload =
+            reinterpret_cast<const uint8_t*>(conn->in.data() + pos + header_size);
+        requests.push_back(
+            {conn, header, std::vector<uint8_t>(payload, payload + header.payload_len), now});
+        pos += frame_size;
+    }
+    conn->in.erase(conn->in.begin(), conn->in.begin() + static_cast<std::ptrdiff_t>(pos));
 
-        const RpcHeader header = RpcHeader::decode(header_buf.data());
-        std::cerr << "--- [RpcServer] received request type=" << (int)header.type
-                  << " payload=" << header.payload_len << " ---" << std::endl;
+    if (!requests.empty()) {
+        {
+            const std::scoped_lock<std::mutex> lock(queue_mutex_);
+            for (auto& req : requests) {
+                queues_[req.header.type].push_back(std::move(req));
+            }
+        }
+        /* All: the reserved control thread may be the one woken and not take the request */
+        queue_cv_.notify_all();
+    }
+    return open;
+}
 
-        std::vector<uint8_t> payload(header.payload_len);
-        if (header.payload_len > 0) {
-            if (recv(client_fd, payload.data(), header.payload_len, MSG_WAITALL) <= 0) {
-                std::cerr << "--- [RpcServer] payload recv failed ---" << std::endl;
-                break;
+bool RpcServer::next_request(bool control_only, Request& out) {
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    while (!handlers_stop_) {
+        for (const RpcType type : CONTROL_TYPES) {
+            const auto it = queues_.find(type);
+            if (it != queues_.end() && !it->second.empty()) {
+                out = std::move(it->second.front());
+                it->second.pop_front();
+                return true;
+            }
+        }
+        if (!control_only && !queues_.empty()) {
+            /* Other types take turns, starting after the one served last */
+            auto it = queues_.upper_bound(last_served_);
+            for (size_t i = 0; i < queues_.size(); ++i, ++it) {
+                if (it == queues_.end()) {
+                    it = queues_.begin();
+                }
+                if (!is_control(it->first) && !it->second.empty()) {
+                    last_served_ = it->first;
+                    out = std::move(it->second.front());
+                    it->second.pop_front();
+                    return true;
+                }
             }
         }
+        queue_cv_.wait(lock);
+    }
+    return false;
+}
+
+void RpcServer::handler_loop(bool control_only) {
+    Request req;
+    while (next_request(control_only, req)) {
+        /* Decompressed here rather than on the I/O thread, which serves every connection */
+        if (!decompress_payload(req.header, req.payload)) {
+            std::cerr << "--- [RpcServer] corrupt compressed request of type "
+                      << (int)req.header.type << ", dropped ---" << std::endl;
+            req = Request{};
+            continue;
+        }
 
         RpcHandler handler = nullptr;
         {
             const std::scoped_lock<std::mutex> lock(handlers_mutex_);
-            if (handlers_.count(header.type) != 0U) {
-                handler = handlers_[header.type];
+            const auto it = handlers_.find(req.header.type);
+            if (it != handlers_.end()) {
+                handler = it->second;
             }
         }
 
+        server_metrics().requests.inc();
         if (handler) {
-            std::cerr << "--- [RpcServer] dispatching to handler ---" << std::endl;
-            handler(header, payload, client_fd);
-            std::cerr << "--- [RpcServer] handler finished ---" << std::endl;
+            const auto start = std::chrono::steady_clock::now();
+            common::Span span("rpc.server", {req.header.trace_id, req.header.parent_span_id});
+            if (span.active()) {
+                span.set_attribute("rpc.method", rpc_type_name(req.header.type));
+                span.set_attribute(
+                    "queued_us",
+                    std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(
+                                       start - req.received)
+                                       .count()));
+            }
+            try {
+                handler(req.header, req.payload, req.conn->fd);
+            } catch (const std::exception& e) {
+                std::cerr << "--- [RpcServer] handler for type " << (int)req.header.type
+                          << " FAILED: " << e.what() << " ---" << std::endl;
+                server_metrics().handler_errors.inc();
+                span.set_attribute("error", e.what());
+            }
+            span.end();
+            server_metrics().latency.record(std::chrono::steady_clock::now() - start);
         } else {
-            std::cerr << "--- [RpcServer] NO HANDLER FOUND for type " << (int)header.type << " ---"
-                      << std::endl;
+            std::cerr << "--- [RpcServer] NO HANDLER FOUND for type " << (int)req.header.type
+                      << " ---" << std::endl;
+            server_metrics().handler_errors.inc();
+            /* An empty Error reply lets a caller that expects an answer move on */
+            static_cast<void>(send_response(req.conn->fd, req.header, RpcType::Error, {}));
         }
+        req = Request{}; /* Let go of the connection */
     }
-    static_cast<void>(close(client_fd));
+}
+
+void RpcServer::forget_connection(int fd) {
+    const std::scoped_lock<std::mutex> lock(connections_mutex_);
+    connections_.erase(fd);
 }
 
 }  // namespace cloudsql::network
@@ -9,32 +9,45 @@
 #include "network/server.hpp"
 
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <netinet/in.h>
-#include <sys/select.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
-#include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <array>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <exception>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "catalog/catalog.hpp"
 #include "common/config.hpp"
+#include "common/memory_tracker.hpp"
+#include "common/metrics.hpp"
 #include "distributed/distributed_executor.hpp"
+#include "executor/plan_cache.hpp"
 #include "executor/query_executor.hpp"
+#include "executor/result_cache.hpp"
 #include "executor/types.hpp"
-#include "parser/lexer.hpp"
-#include "parser/parser.hpp"
 #include "storage/buffer_pool_manager.hpp"
 #include "transaction/lock_manager.hpp"
 #include "transaction/transaction_manager.hpp"
@@ -44,23 +57,41 @@ namespace cloudsql::network {
 namespace {
 
 constexpr size_t HEADER_SIZE = 4;
-constexpr int SELECT_TIMEOUT_SEC = 1;
 constexpr uint32_t PG_SSL_CODE = 80877103;
 constexpr uint32_t PG_STARTUP_CODE = 196608;
 
+/* Largest startup or SSL request packet accepted */
+constexpr size_t MAX_STARTUP_SIZE = 8192;
+/* Bytes read from a socket per recv() */
+constexpr size_t READ_CHUNK_SIZE = 16384;
+/* Buffer capacity an idle connection may keep; larger buffers are released */
+constexpr size_t IDLE_BUFFER_SIZE = 4096;
+constexpr int MAX_EPOLL_EVENTS = 64;
+constexpr uint32_t CONNECTION_EVENTS = EPOLLIN | EPOLLONESHOT;
+
 /**
- * @brief Simple utility to receive exactly N bytes
+ * @brief Sends all of `data` on a non-blocking socket, waiting while it is full
+ * @return false if the client went away
  */
-ssize_t recv_all(int fd, char* buf, size_t count) {
-    size_t total = 0;
-    while (total < count) {
-        const ssize_t n = recv(fd, buf + total, count - total, 0);
-        if (n <= 0) {
-            return n;
+bool send_all(int fd, const char* data, size_t size) {
+    size_t sent = 0;
+    while (sent < size) {
+        const ssize_t n = send(fd, data + sent, size - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += static_cast<size_t>(n);
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            /* A slow reader holds its worker here, which throttles what it is sent */
+            pollfd pfd{fd, POLLOUT, 0};
+            if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+                return false;
+            }
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
         }
-        total += static_cast<size_t>(n);
     }
-    return static_cast<ssize_t>(total);
+    return true;
 }
 
 /**
@@ -91,8 +122,970 @@ class ProtocolWriter {
     }
 };
 
+/* Type OIDs of the PostgreSQL catalog */
+constexpr uint32_t OID_UNSPECIFIED = 0;
+constexpr uint32_t OID_BOOL = 16;
+constexpr uint32_t OID_INT8 = 20;
+constexpr uint32_t OID_INT2 = 21;
+constexpr uint32_t OID_INT4 = 23;
+constexpr uint32_t OID_TEXT = 25;
+constexpr uint32_t OID_FLOAT4 = 700;
+constexpr uint32_t OID_FLOAT8 = 701;
+constexpr uint32_t OID_BPCHAR = 1042;
+constexpr uint32_t OID_VARCHAR = 1043;
+constexpr uint32_t OID_NUMERIC = 1700;
+
+constexpr int16_t FORMAT_TEXT = 0;
+constexpr int16_t FORMAT_BINARY = 1;
+
+/* Largest message body accepted from a client */
+constexpr uint32_t MAX_MESSAGE_SIZE = static_cast<uint32_t>(64) * 1024 * 1024;
+
+/**
+ * @brief Bounds-checked reader of a message body
+ * @throws std::runtime_error when a field runs past the end of the message
+ */
+class MessageReader {
+   public:
+    explicit MessageReader(const std::vector<char>& body) : body_(body) {}
+
+    uint16_t read_int16() {
+        uint16_t val = 0;
+        std::memcpy(&val, take(2), 2);
+        return ntohs(val);
+    }
+
+    uint32_t read_int32() { return ProtocolReader::read_int32(take(4)); }
+
+    std::string read_string() {
+        const auto* begin = body_.data() + offset_;
+        const auto* end = static_cast<const char*>(std::memchr(begin, 0, body_.size() - offset_));
+        if (end == nullptr) {
+            throw std::runtime_error("malformed message: unterminated string");
+        }
+        std::string text(begin, end);
+        offset_ += text.size() + 1;
+        return text;
+    }
+
+    const char* read_bytes(size_t count) { return take(count); }
+
+   private:
+    const char* take(size_t count) {
+        if (count > body_.size() - offset_) {
+            throw std::runtime_error("malformed message: truncated");
+        }
+        const char* data = body_.data() + offset_;
+        offset_ += count;
+        return data;
+    }
+
+    const std::vector<char>& body_;
+    size_t offset_ = 0;
+};
+
+/**
+ * @brief Backend messages collected in one buffer, sent with a single write
+ *
+ * The buffer's capacity is charged to the session's memory tracker when it is
+ * flushed or released; what the client is owed is never refused.
+ */
+class MessageBuffer {
+   public:
+    explicit MessageBuffer(common::MemoryTracker* memory = nullptr) : memory_(memory) {}
+    ~MessageBuffer() {
+        if (memory_ != nullptr) memory_->release(charged_);
+    }
+
+    MessageBuffer(const MessageBuffer&) = delete;
+    MessageBuffer& operator=(const MessageBuffer&) = delete;
+    MessageBuffer(MessageBuffer&&) = delete;
+    MessageBuffer& operator=(MessageBuffer&&) = delete;
+
+    void begin(char type) {
+        start_ = data_.size();
+        data_.push_back(type);
+        data_.append(4, '\0');
+    }
+
+    /** @brief Fills in the length of the message since begin() */
+    void end() {
+        ProtocolWriter::write_int32(data_.data() + start_ + 1,
+                                    static_cast<uint32_t>(data_.size() - start_ - 1));
+    }
+
+    void add_int16(uint16_t val) {
+        data_.append(2, '\0');
+        ProtocolWriter::write_int16(data_.data() + data_.size() - 2, val);
+    }
+
+    void add_int32(uint32_t val) {
+        data_.append(4, '\0');
+        ProtocolWriter::write_int32(data_.data() + data_.size() - 4, val);
+    }
+
+    void add_string(const std::string& text) { data_.append(text.c_str(), text.size() + 1); }
+    void add_bytes(const std::string& bytes) { data_.append(bytes); }
+
+    /** @brief Message with no body, e.g. ParseComplete */
+    void add_empty(char type) {
+        begin(type);
+        end();
+    }
+
+    [[nodiscard]] size_t size() const { return data_.size(); }
+
+    /** @return false if the client went away */
+    bool flush(int fd) {
+        track();
+        const bool sent = send_all(fd, data_.data(), data_.size());
+        data_.clear();
+        return sent;
+    }
+
+    /** @brief Frees a large buffer once it has been flushed, for an idle connection */
+    void release() {
+        if (data_.empty() && data_.capacity() > IDLE_BUFFER_SIZE) {
+            std::string().swap(data_);
+            track();
+        }
+    }
+
+   private:
+    /** @brief Moves the tracker's charge to the buffer's capacity */
+    void track() {
+        if (memory_ == nullptr || data_.capacity() == charged_) return;
+        if (data_.capacity() > charged_) {
+            memory_->consume(data_.capacity() - charged_);
+        } else {
+            memory_->release(charged_ - data_.capacity());
+        }
+        charged_ = data_.capacity();
+    }
+
+    std::string data_;
+    size_t start_ = 0;
+    common::MemoryTracker* memory_;
+    size_t charged_ = 0; /**< Bytes memory_ holds for the buffer */
+};
+
+struct TypeInfo {
+    uint32_t oid;
+    int16_t length; /**< -1 for variable length */
+};
+
+TypeInfo wire_type(common::ValueType type) {
+    switch (type) {
+        case common::ValueType::TYPE_BOOL:
+            return {OID_BOOL, 1};
+        case common::ValueType::TYPE_INT8:
+        case common::ValueType::TYPE_INT16:
+            return {OID_INT2, 2};
+        case common::ValueType::TYPE_INT32:
+            return {OID_INT4, 4};
+        case common::ValueType::TYPE_INT64:
+            return {OID_INT8, 8};
+        case common::ValueType::TYPE_FLOAT32:
+            return {OID_FLOAT4, 4};
+        case common::ValueType::TYPE_FLOAT64:
+            return {OID_FLOAT8, 8};
+        case common::ValueType::TYPE_VARCHAR:
+            return {OID_VARCHAR, -1};
+        default:
+            return {OID_TEXT, -1};
+    }
+}
+
+void add_row_description(MessageBuffer& out, const executor::Schema& schema) {
+    out.begin('T');
+    out.add_int16(static_cast<uint16_t>(schema.column_count()));
+    for (size_t i = 0; i < schema.column_count(); ++i) {
+        const auto& col = schema.get_column(i);
+        const TypeInfo type = wire_type(col.type());
+        out.add_string(col.name());
+        out.add_int32(0); /* table OID */
+        out.add_int16(0); /* column number */
+        out.add_int32(type.oid);
+        out.add_int16(static_cast<uint16_t>(type.length));
+        out.add_int32(0xFFFFFFFF); /* type modifier */
+        out.add_int16(FORMAT_TEXT);
+    }
+    out.end();
+}
+
+void add_data_row(MessageBuffer& out, const executor::Tuple& row, size_t num_cols) {
+    out.begin('D');
+    out.add_int16(static_cast<uint16_t>(num_cols));
+    for (size_t i = 0; i < num_cols; ++i) {
+        const auto& v = row.get(i);
+        if (v.is_null()) {
+            out.add_int32(0xFFFFFFFF);
+        } else {
+            const std::string text = v.to_string();
+            out.add_int32(static_cast<uint32_t>(text.size()));
+            out.add_bytes(text);
+        }
+    }
+    out.end();
+}
+
+void add_error(MessageBuffer& out, const std::string& message) {
+    out.begin('E');
+    out.add_bytes("S");
+    out.add_string("ERROR");
+    out.add_bytes("C");
+    out.add_string("XX000"); /* internal_error */
+    out.add_bytes("M");
+    out.add_string(message);
+    out.add_bytes(std::string(1, '\0'));
+    out.end();
+}
+
+/**
+ * @brief DataRows, pruning NOTICE and CommandComplete of a successful result
+ */
+void add_result_rows(MessageBuffer& out, const executor::QueryResult& res) {
+    const size_t num_cols = res.schema().column_count();
+    if (num_cols > 0) {
+        for (const auto& row : res.rows()) {
+            add_data_row(out, row, num_cols);
+        }
+    }
+
+    // Notice Response (N) with columnar chunk pruning stats
+    if (res.chunks_scanned() != 0 || res.chunks_skipped() != 0) {
+        out.begin('N');
+        out.add_bytes("S");
+        out.add_string("NOTICE");
+        out.add_bytes("M");
+        out.add_string("chunks scanned: " + std::to_string(res.chunks_scanned()) +
+                       ", skipped: " + std::to_string(res.chunks_skipped()));
+        out.add_bytes(std::string(1, '\0'));
+        out.end();
+    }
+
+    // Command Complete (C)
+    out.begin('C');
+    out.add_string("SELECT " + std::to_string(res.row_count()));
+    out.end();
+}
+
+/**
+ * @brief Decodes one Bind parameter
+ * @param type_oid Type given at Parse; unspecified text parameters become
+ * numbers when they parse as one and TEXT otherwise
+ */
+common::Value decode_parameter(const char* data, size_t size, uint32_t type_oid, int16_t format) {
+    const std::string text(data, size);
+    if (format == FORMAT_BINARY) {
+        const auto be = [data, size](size_t bytes) {
+            if (size != bytes) {
+                throw std::runtime_error("invalid binary parameter length");
+            }
+            uint64_t val = 0;
+            for (size_t i = 0; i < bytes; ++i) {
+                val = (val << 8U) | static_cast<uint8_t>(data[i]);
+            }
+            return val;
+        };
+        switch (type_oid) {
+            case OID_BOOL:
+                return common::Value::make_bool(be(1) != 0);
+            case OID_INT2:
+                return common::Value::make_int64(static_cast<int16_t>(be(2)));
+            case OID_INT4:
+                return common::Value::make_int64(static_cast<int32_t>(be(4)));
+            case OID_INT8:
+                return common::Value::make_int64(static_cast<int64_t>(be(8)));
+            case OID_FLOAT4: {
+                const auto bits = static_cast<uint32_t>(be(4));
+                float val = 0;
+                std::memcpy(&val, &bits, sizeof(val));
+                return common::Value::make_float64(val);
+            }
+            case OID_FLOAT8: {
+                const uint64_t bits = be(8);
+                double val = 0;
+                std::memcpy(&val, &bits, sizeof(val));
+                return common::Value::make_float64(val);
+            }
+            case OID_UNSPECIFIED:
+            case OID_TEXT:
+            case OID_BPCHAR:
+            case OID_VARCHAR:
+                return common::Value::make_text(text);
+            default:
+                throw std::runtime_error("unsupported binary parameter type " +
+                                         std::to_string(type_oid));
+        }
+    }
+
+    const auto parses = [&text](auto parse) {
+        size_t used = 0;
+        try {
+            static_cast<void>(parse(text, &used));
+        } catch (const std::exception&) {
+            return false;
+        }
+        return used == text.size() && !text.empty();
+    };
+    const auto to_int = [](const std::string& t, size_t* used) { return std::stoll(t, used); };
+    const auto to_float = [](const std::string& t, size_t* used) { return std::stod(t, used); };
+    switch (type_oid) {
+        case OID_BOOL:
+            return common::Value::make_bool(text == "t" || text == "true" || text == "1" ||
+                                            text == "on" || text == "yes");
+        case OID_INT2:
+        case OID_INT4:
+        case OID_INT8:
+            if (!parses(to_int)) throw std::runtime_error("invalid integer parameter: " + text);
+            return common::Value::make_int64(std::stoll(text));
+        case OID_FLOAT4:
+        case OID_FLOAT8:
+        case OID_NUMERIC:
+            if (!parses(to_float)) throw std::runtime_error("invalid numeric parameter: " + text);
+            return common::Value::make_float64(std::stod(text));
+        case OID_UNSPECIFIED:
+            if (parses(to_int)) return common::Value::make_int64(std::stoll(text));
+            if (parses(to_float)) return common::Value::make_float64(std::stod(text));
+            return common::Value::make_text(text);
+        default:
+            return common::Value::make_text(text);
+    }
+}
+
+constexpr size_t MALFORMED_MESSAGE = std::numeric_limits<size_t>::max();
+
+/**
+ * @return Size of the message starting at `pos` of `in`: 0 if it has not
+ * fully arrived, MALFORMED_MESSAGE if its length is out of bounds. Before
+ * startup, messages are untyped startup or SSL request packets.
+ */
+size_t message_size(const std::string& in, size_t pos, bool started) {
+    const size_t type_size = started ? 1 : 0;
+    if (in.size() - pos < type_size + HEADER_SIZE) {
+        return 0;
+    }
+    const size_t len = ProtocolReader::read_int32(in.data() + pos + type_size);
+    if (len < HEADER_SIZE || (started ? len - HEADER_SIZE > MAX_MESSAGE_SIZE
+                                      : len > MAX_STARTUP_SIZE)) {
+        return MALFORMED_MESSAGE;
+    }
+    return in.size() - pos < type_size + len ? 0 : type_size + len;
+}
+
+/**
+ * @brief Protocol state of one client connection
+ *
+ * Handles the simple query ('Q') and extended query (Parse, Bind, Describe,
+ * Execute, Close, Sync) flows. Statements go through a per-session plan
+ * cache, so repeating a query, prepared or not, skips the parser.
+ *
+ * Local SELECTs stream: DataRows are sent every `stream_batch_rows` rows as
+ * the plan produces them, and an Execute with a row limit suspends its
+ * portal with the plan still open, to resume on the next Execute.
+ *
+ * On a coordinator a simple-query SELECT runs asynchronously: once its
+ * fragments are sent, handle() returns and the worker is free for other
+ * connections. The session is then awaiting() and its connection parked;
+ * the query's completion calls the wake function, and the next worker to
+ * serve the connection resume()s it, answering the query before any message
+ * after it.
+ */
+class ClientSession {
+   public:
+    ClientSession(int fd, Catalog& catalog, executor::QueryExecutor& exec,
+                  const config::Config& config, cluster::ClusterManager* cm, ServerStats& stats)
+        : fd_(fd),
+          catalog_(catalog),
+          exec_(exec),
+          config_(config),
+          cm_(cm),
+          stats_(stats),
+          cache_(catalog),
+          out_(&exec.session_memory()),
+          batch_rows_(static_cast<uint64_t>(std::max(0, config.stream_batch_rows))) {}
+
+    ClientSession(const ClientSession&) = delete;
+    ClientSession& operator=(const ClientSession&) = delete;
+    ClientSession(ClientSession&&) = delete;
+    ClientSession& operator=(ClientSession&&) = delete;
+
+    /** @brief Waits for a query still running remotely, whose completion refers to the session */
+    ~ClientSession() {
+        std::unique_lock<std::mutex> lock(remote_.mutex);
+        remote_.cv.wait(lock, [this] { return !remote_.running; });
+    }
+
+    /** @brief What a completed remote query calls to have its parked connection served again */
+    void set_wake(std::function<void()> wake) { remote_.wake = std::move(wake); }
+
+    /**
+     * @brief Handles one frontend message
+     * @return false when the connection should close
+     */
+    bool handle(char type, const std::vector<char>& body) {
+        if (copy_ && type != 'X') {
+            handle_copy(type, body);
+            return flush();
+        }
+        if (skip_to_sync_ && type != 'S' && type != 'X') {
+            return true; /* Error in an extended query: discard until Sync */
+        }
+        try {
+            switch (type) {
+                case 'Q':
+                    handle_query(body);
+                    break;
+                case 'P':
+                    handle_parse(body);
+                    break;
+                case 'B':
+                    handle_bind(body);
+                    break;
+                case 'D':
+                    handle_describe(body);
+                    break;
+                case 'E':
+                    handle_execute(body);
+                    break;
+                case 'C':
+                    handle_close(body);
+                    break;
+                case 'H':
+                    break;
+                case 'S':
+                    /* Sync ends an implicit transaction, and with it every portal */
+                    skip_to_sync_ = false;
+                    if (!exec_.in_transaction()) {
+                        portals_.clear();
+                    }
+                    add_ready();
+                    break;
+                case 'X':
+                    return false;
+                default:
+                    add_ready();
+                    break;
+            }
+        } catch (const std::exception& e) {
+            add_error(out_, e.what());
+            if (type == 'Q') {
+                add_ready();
+            } else {
+                skip_to_sync_ = true;
+            }
+        }
+        return flush();
+    }
+
+    /** @return false if the client went away */
+    bool flush() {
+        static_cast<void>(stats_.bytes_sent.fetch_add(out_.size()));
+        return out_.flush(fd_);
+    }
+
+    void add_ready() {
+        out_.begin('Z');
+        out_.add_bytes("I");
+        out_.end();
+    }
+
+    /** @brief Called when every buffered message has been handled */
+    void release_buffers() { out_.release(); }
+
+    /** @return Whether a query was started remotely and has not been answered yet */
+    bool awaiting() {
+        const std::scoped_lock<std::mutex> lock(remote_.mutex);
+        return remote_.awaiting;
+    }
+
+    /**
+     * @brief Parks the connection until the remote query completes
+     * @return false if it already has: resume() can answer it now
+     */
+    bool park() {
+        const std::scoped_lock<std::mutex> lock(remote_.mutex);
+        if (!remote_.awaiting || remote_.result) {
+            return false;
+        }
+        remote_.parked = true;
+        return true;
+    }
+
+    /**
+     * @brief Answers the remote query if it has completed; does nothing otherwise
+     * @return false if the client went away
+     */
+    bool resume() {
+        std::optional<executor::QueryResult> res;
+        {
+            const std::scoped_lock<std::mutex> lock(remote_.mutex);
+            if (!remote_.result) {
+                return true;
+            }
+            res = std::move(remote_.result);
+            remote_.result.reset();
+            remote_.awaiting = false;
+        }
+        add_query_result(*res);
+        add_ready();
+        return flush();
+    }
+
+   private:
+    /** @brief The query running remotely, shared with its completion on an RPC thread */
+    struct Remote {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool awaiting = false; /**< Started and not answered to the client yet */
+        bool running = false;  /**< Started and not completed yet */
+        bool parked = false;   /**< No worker holds the connection: wake it on completion */
+        std::optional<executor::QueryResult> result; /**< Completed, to be answered */
+        std::function<void()> wake;
+    };
+
+    struct Portal {
+        std::shared_ptr<const executor::PreparedStatement> prepared;
+        std::vector<common::Value> parameters;
+        std::unique_ptr<executor::ResultStream> stream; /**< Open while suspended */
+        bool complete = false;
+    };
+
+    void handle_query(const std::vector<char>& body) {
+        const std::string sql(body.data(), strnlen(body.data(), body.size()));
+        const auto prepared = cache_.prepare(sql);
+        if (prepared && prepared->statement->type() == parser::StmtType::Copy) {
+            if (start_copy(dynamic_cast<const parser::CopyStatement&>(*prepared->statement))) {
+                return; /* ReadyForQuery follows CopyDone or CopyFail */
+            }
+        } else if (prepared && streams(*prepared)) {
+            auto stream = start_stream(*prepared);
+            // Row Description (T), once there is a row to describe
+            executor::Tuple row;
+            if (stream->next(row)) {
+                const size_t num_cols = stream->schema().column_count();
+                if (num_cols > 0) {
+                    add_row_description(out_, stream->schema());
+                    add_data_row(out_, row, num_cols);
+                }
+                send_rows(*stream, 0);
+            }
+            if (stream->success()) {
+                add_command_complete(stream->row_count());
+            } else {
+                add_error(out_, stream->error());
+            }
+        } else if (prepared && runs_remotely(*prepared)) {
+            start_remote(prepared);
+            return; /* ReadyForQuery follows the result, in resume() */
+        } else if (prepared) {
+            add_query_result(run(*prepared));
+        }
+        add_ready();
+    }
+
+    void add_query_result(const executor::QueryResult& res) {
+        if (res.success()) {
+            // Row Description (T)
+            if (!res.rows().empty() && res.schema().column_count() > 0) {
+                add_row_description(out_, res.schema());
+            }
+            add_result_rows(out_, res);
+        } else {
+            add_error(out_, res.error());
+        }
+    }
+
+    void handle_parse(const std::vector<char>& body) {
+        MessageReader in(body);
+        const std::string name = in.read_string();
+        const std::string sql = in.read_string();
+        std::vector<uint32_t> types(in.read_int16());
+        for (auto& oid : types) oid = in.read_int32();
+
+        if (!name.empty() && statements_.count(name) != 0) {
+            throw std::runtime_error("prepared statement \"" + name + "\" already exists");
+        }
+        auto prepared = cache_.prepare(sql, types);
+        if (!prepared) {
+            throw std::runtime_error("syntax error in statement: " + sql);
+        }
+        statements_[name] = std::move(prepared);
+        out_.add_empty('1'); /* ParseComplete */
+    }
+
+    void handle_bind(const std::vector<char>& body) {
+        MessageReader in(body);
+        const std::string portal_name = in.read_string();
+        const std::string statement_name = in.read_string();
+        const auto& prepared = find_statement(statement_name);
+
+        std::vector<int16_t> formats(in.read_int16());
+        for (auto& format : formats) format = static_cast<int16_t>(in.read_int16());
+        const uint16_t count = in.read_int16();
+        if (count != prepared->parameters.size()) {
+            throw std::runtime_error("bind message supplies " + std::to_string(count) +
+                                     " parameters, but prepared statement requires " +
+                                     std::to_string(prepared->parameters.size()));
+        }
+        if (formats.size() > 1 && formats.size() != count) {
+            throw std::runtime_error("bind message has " + std::to_string(formats.size()) +
+                                     " parameter formats but " + std::to_string(count) +
+                                     " parameters");
+        }
+
+        Portal portal{prepared, {}, nullptr, false};
+        portal.parameters.reserve(count);
+        for (uint16_t i = 0; i < count; ++i) {
+            const auto size = static_cast<int32_t>(in.read_int32());
+            if (size < 0) {
+                portal.parameters.push_back(common::Value::make_null());
+                continue;
+            }
+            const int16_t format = formats.empty() ? FORMAT_TEXT
+                                                   : formats[formats.size() == 1 ? 0 : i];
+            const uint32_t oid =
+                i < prepared->parameter_types.size() ? prepared->parameter_types[i] : 0;
+            const char* data = in.read_bytes(static_cast<size_t>(size));
+            portal.parameters.push_back(
+                decode_parameter(data, static_cast<size_t>(size), oid, format));
+        }
+
+        const uint16_t result_formats = in.read_int16();
+        for (uint16_t i = 0; i < result_formats; ++i) {
+            if (static_cast<int16_t>(in.read_int16()) != FORMAT_TEXT) {
+                throw std::runtime_error("binary result format is not supported");
+            }
+        }
+
+        portals_.erase(portal_name);
+        portals_.emplace(portal_name, std::move(portal));
+        out_.add_empty('2'); /* BindComplete */
+    }
+
+    void handle_describe(const std::vector<char>& body) {
+        MessageReader in(body);
+        const char kind = *in.read_bytes(1);
+        const std::string name = in.read_string();
+        const executor::PreparedStatement* prepared = nullptr;
+        if (kind == 'S') {
+            prepared = find_statement(name).get();
+            /* ParameterDescription: unspecified parameters are accepted as text */
+            out_.begin('t');
+            out_.add_int16(static_cast<uint16_t>(prepared->parameters.size()));
+            for (size_t i = 0; i < prepared->parameters.size(); ++i) {
+                const uint32_t oid =
+                    i < prepared->parameter_types.size() ? prepared->parameter_types[i] : 0;
+                out_.add_int32(oid == OID_UNSPECIFIED ? OID_TEXT : oid);
+            }
+            out_.end();
+        } else {
+            const Portal& portal = find_portal(name);
+            prepared = portal.prepared.get();
+            prepared->bind(portal.parameters);
+        }
+
+        const executor::Schema schema = exec_.describe(*prepared->statement);
+        if (schema.column_count() > 0) {
+            add_row_description(out_, schema);
+        } else {
+            out_.add_empty('n'); /* NoData */
+        }
+    }
+
+    void handle_execute(const std::vector<char>& body) {
+        MessageReader in(body);
+        Portal& portal = find_portal(in.read_string());
+        const uint32_t limit = in.read_int32(); /* 0 = all rows */
+
+        if (portal.complete) {
+            add_command_complete(0);
+            return;
+        }
+        /* Placeholders read their slots while rows are produced, so rebind on every resume */
+        portal.prepared->bind(portal.parameters);
+        if (!portal.stream) {
+            if (!streams(*portal.prepared)) {
+                portal.complete = true;
+                const auto res = run(*portal.prepared);
+                if (!res.success()) {
+                    throw std::runtime_error(res.error());
+                }
+                add_result_rows(out_, res);
+                return;
+            }
+            portal.stream = start_stream(*portal.prepared);
+        }
+
+        auto& stream = *portal.stream;
+        send_rows(stream, limit);
+        if (!stream.success()) {
+            const std::string error = stream.error();
+            portal.stream.reset();
+            portal.complete = true;
+            throw std::runtime_error(error);
+        }
+        if (stream.done()) {
+            add_command_complete(stream.row_count());
+            portal.stream.reset();
+            portal.complete = true;
+        } else {
+            out_.add_empty('s'); /* PortalSuspended */
+        }
+    }
+
+    /**
+     * @brief Enters copy-in mode with CopyInResponse
+     * @return false, with the error queued, if the copy cannot start
+     */
+    bool start_copy(const parser::CopyStatement& stmt) {
+        if (config_.mode == config::RunMode::Coordinator && cm_ != nullptr) {
+            add_error(out_, "COPY is not supported by the distributed executor");
+            return false;
+        }
+        static_cast<void>(stats_.queries_executed.fetch_add(1));
+        auto copy = exec_.copy_from(stmt);
+        if (!copy->success()) {
+            add_error(out_, copy->error());
+            return false;
+        }
+        const auto format = static_cast<uint16_t>(
+            stmt.options().format == parser::CopyFormat::Binary ? FORMAT_BINARY : FORMAT_TEXT);
+        out_.begin('G');
+        out_.add_bytes(std::string(1, static_cast<char>(format)));
+        out_.add_int16(static_cast<uint16_t>(copy->schema().column_count()));
+        for (size_t i = 0; i < copy->schema().column_count(); ++i) {
+            out_.add_int16(format);
+        }
+        out_.end();
+        copy_ = std::move(copy);
+        return true;
+    }
+
+    /**
+     * @brief Copy-in mode: CopyData until CopyDone or CopyFail
+     *
+     * Data after a decoding error is discarded; the error is reported when
+     * the client ends the copy.
+     */
+    void handle_copy(char type, const std::vector<char>& body) {
+        switch (type) {
+            case 'd':
+                static_cast<void>(copy_->write(body.data(), body.size()));
+                return;
+            case 'c':
+                if (copy_->finish()) {
+                    out_.begin('C');
+                    out_.add_string("COPY " + std::to_string(copy_->row_count()));
+                    out_.end();
+                } else {
+                    add_error(out_, copy_->error());
+                }
+                break;
+            case 'f':
+                copy_->abort(std::string(body.data(), strnlen(body.data(), body.size())));
+                add_error(out_, copy_->error());
+                break;
+            case 'H':
+            case 'S':
+                return;
+            default:
+                copy_->abort("unexpected message type during COPY");
+                add_error(out_, copy_->error());
+                break;
+        }
+        copy_.reset();
+        add_ready();
+    }
+
+    /**
+     * @return Whether `prepared` runs as a ResultStream; a SELECT that may be
+     * answered from the result cache runs whole instead
+     */
+    bool streams(const executor::PreparedStatement& prepared) const {
+        return batch_rows_ > 0 && prepared.statement->type() == parser::StmtType::Select &&
+               !(config_.mode == config::RunMode::Coordinator && cm_ != nullptr) &&
+               !exec_.caches_results();
+    }
+
+    std::unique_ptr<executor::ResultStream> start_stream(
+        const executor::PreparedStatement& prepared) {
+        static_cast<void>(stats_.queries_executed.fetch_add(1));
+        auto stream =
+            exec_.stream(dynamic_cast<const parser::SelectStatement&>(*prepared.statement));
+        if (!stream->success()) {
+            throw std::runtime_error(stream->error());
+        }
+        return stream;
+    }
+
+    /**
+     * @brief Sends up to `limit` rows (0 = all) of `stream`, flushing every batch
+     * @throws std::runtime_error if the client goes away
+     */
+    void send_rows(executor::ResultStream& stream, uint64_t limit) {
+        const size_t num_cols = stream.schema().column_count();
+        executor::Tuple row;
+        for (uint64_t sent = 0; (limit == 0 || sent < limit) && stream.next(row);) {
+            if (num_cols > 0) {
+                add_data_row(out_, row, num_cols);
+            }
+            if (++sent % batch_rows_ == 0 && !flush()) {
+                throw std::runtime_error("client connection lost");
+            }
+        }
+    }
+
+    void add_command_complete(uint64_t rows) {
+        out_.begin('C');
+        out_.add_string("SELECT " + std::to_string(rows));
+        out_.end();
+    }
+
+    void handle_close(const std::vector<char>& body) {
+        MessageReader in(body);
+        const char kind = *in.read_bytes(1);
+        const std::string name = in.read_string();
+        if (kind == 'S') {
+            statements_.erase(name);
+        } else {
+            portals_.erase(name);
+        }
+        out_.add_empty('3'); /* CloseComplete */
+    }
+
+    executor::QueryResult run(const executor::PreparedStatement& prepared) {
+        static_cast<void>(stats_.queries_executed.fetch_add(1));
+        const auto type = prepared.statement->type();
+        if (type == parser::StmtType::TransactionCommit ||
+            type == parser::StmtType::TransactionRollback) {
+            /* Portals reading in the ending transaction cannot outlive it */
+            for (auto& [name, portal] : portals_) {
+                if (portal.stream) {
+                    portal.stream.reset();
+                    portal.complete = true;
+                }
+            }
+        }
+        if (config_.mode == config::RunMode::Coordinator && cm_ != nullptr) {
+            /* The coordinator forwards SQL text, which cannot carry bound parameters */
+            if (!prepared.parameters.empty()) {
+                executor::QueryResult res;
+                res.set_error("parameters are not supported by the distributed executor");
+                return res;
+            }
+            return distributed().execute(*prepared.statement, prepared.sql);
+        }
+        return exec_.execute(*prepared.statement);
+    }
+
+    /** @return Whether `prepared` is a SELECT the coordinator fans out without waiting */
+    bool runs_remotely(const executor::PreparedStatement& prepared) const {
+        return config_.mode == config::RunMode::Coordinator && cm_ != nullptr &&
+               prepared.statement->type() == parser::StmtType::Select &&
+               prepared.parameters.empty();
+    }
+
+    /** @brief Starts `prepared` across the cluster; its result comes back through remote_ */
+    void start_remote(const std::shared_ptr<const executor::PreparedStatement>& prepared) {
+        static_cast<void>(stats_.queries_executed.fetch_add(1));
+        auto& dist = distributed();
+        {
+            const std::scoped_lock<std::mutex> lock(remote_.mutex);
+            remote_.awaiting = true;
+            remote_.running = true;
+        }
+        /* The completion holds the statement, which the fragments' merge reads */
+        const auto complete = [this, prepared](executor::QueryResult res) {
+            const std::scoped_lock<std::mutex> lock(remote_.mutex);
+            remote_.result = std::move(res);
+            remote_.running = false;
+            if (remote_.parked) {
+                remote_.parked = false;
+                remote_.wake();
+            }
+            remote_.cv.notify_all();
+        };
+        try {
+            dist.execute_async(*prepared->statement, prepared->sql, complete);
+        } catch (...) {
+            const std::scoped_lock<std::mutex> lock(remote_.mutex);
+            if (remote_.running) {
+                remote_.awaiting = false;
+                remote_.running = false;
+            }
+            throw;
+        }
+    }
+
+    executor::DistributedExecutor& distributed() {
+        if (!dist_exec_) {
+            dist_exec_ = std::make_unique<executor::DistributedExecutor>(catalog_, *cm_);
+            dist_exec_->set_result_cache(exec_.result_cache());
+        }
+        return *dist_exec_;
+    }
+
+    const std::shared_ptr<const executor::PreparedStatement>& find_statement(
+        const std::string& name) const {
+        const auto it = statements_.find(name);
+        if (it == statements_.end()) {
+            throw std::runtime_error("prepared statement \"" + name + "\" does not exist");
+        }
+        return it->second;
+    }
+
+    Portal& find_portal(const std::string& name) {
+        const auto it = portals_.find(name);
+        if (it == portals_.end()) {
+            throw std::runtime_error("portal \"" + name + "\" does not exist");
+        }
+        return it->second;
+    }
+
+    int fd_;
+    Catalog& catalog_;
+    executor::QueryExecutor& exec_;
+    const config::Config& config_;
+    cluster::ClusterManager* cm_;
+    ServerStats& stats_;
+    executor::PlanCache cache_;
+    MessageBuffer out_;
+    std::unordered_map<std::string, std::shared_ptr<const executor::PreparedStatement>>
+        statements_;
+    std::unordered_map<std::string, Portal> portals_;
+    std::unique_ptr<executor::CopyIn> copy_; /**< Set while in copy-in mode */
+    /** Coordinator only; kept for the session so it knows which nodes its transaction ran on */
+    std::unique_ptr<executor::DistributedExecutor> dist_exec_;
+    uint64_t batch_rows_;
+    bool skip_to_sync_ = false;
+    Remote remote_;
+};
+
 }  // namespace
 
+/* The client's socket, its buffers and its protocol session */
+struct Server::Connection {
+    int fd;
+    IoLoop* loop;
+    std::string in;         /**< Bytes received but not handled yet */
+    std::vector<char> body; /**< Body of the message being handled */
+    bool started = false;   /**< Startup packet handled */
+    bool eof = false;       /**< The client closed its end: run what is buffered, then close */
+    std::unique_ptr<executor::QueryExecutor> exec;
+    std::unique_ptr<ClientSession> session;
+
+    /**
+     * Held by a worker while it re-arms the connection and taken by the loop
+     * before it touches it: an event may arrive before epoll_ctl() returns,
+     * and the hand-off through epoll is not one the memory model knows about
+     */
+    std::mutex handoff;
+
+    Connection(int socket, IoLoop* io_loop) : fd(socket), loop(io_loop) {}
+};
+
 Server::Server(uint16_t port, Catalog& catalog, storage::BufferPoolManager& bpm,
                const config::Config& config, cluster::ClusterManager* cm)
     : port_(port),
@@ -100,7 +1093,43 @@ Server::Server(uint16_t port, Catalog& catalog, storage::BufferPoolManager& bpm,
       bpm_(bpm),
       config_(config),
       cluster_manager_(cm),
-      transaction_manager_(lock_manager_, catalog, bpm, bpm.get_log_manager()) {}
+      transaction_manager_(lock_manager_, catalog, bpm, bpm.get_log_manager()),
+      vacuum_(catalog, bpm, transaction_manager_) {
+    if (config.result_cache_mb > 0) {
+        result_cache_ = std::make_unique<executor::ResultCache>(
+            static_cast<size_t>(config.result_cache_mb) * 1024 * 1024);
+    }
+    if (bpm.get_log_manager() != nullptr) {
+        replicas_ = std::make_unique<executor::ColumnarReplicaManager>(
+            bpm, transaction_manager_, *bpm.get_log_manager());
+    }
+    metrics_ = common::MetricsRegistry::global().add_collector([this](common::MetricsSnapshot& out) {
+        const auto value = [](const std::atomic<uint64_t>& v) {
+            return static_cast<double>(v.load(std::memory_order_relaxed));
+        };
+        out.add_counter("cloudsql_server_connections_accepted_total", "Client connections accepted",
+                        value(stats_.connections_accepted));
+        out.add_gauge("cloudsql_server_connections_active", "Client connections open",
+                      value(stats_.connections_active));
+        out.add_counter("cloudsql_server_queries_total", "Queries run for clients",
+                        value(stats_.queries_executed));
+        out.add_counter("cloudsql_server_received_bytes_total", "Bytes received from clients",
+                        value(stats_.bytes_received));
+        out.add_counter("cloudsql_server_sent_bytes_total", "Bytes sent to clients",
+                        value(stats_.bytes_sent));
+    });
+}
+
+Server::~Server() noexcept {
+    try {
+        static_cast<void>(stop());
+    } catch (...) {
+        static_cast<void>(0);  // Destructors should not throw
+    }
+    if (listen_fd_ >= 0) {
+        static_cast<void>(close(listen_fd_));
+    }
+}
 
 std::unique_ptr<Server> Server::create(uint16_t port, Catalog& catalog,
                                        storage::BufferPoolManager& bpm,
@@ -109,7 +1138,7 @@ std::unique_ptr<Server> Server::create(uint16_t port, Catalog& catalog,
 }
 
 bool Server::start() {
-    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (fd < 0) {
         return false;
     }
@@ -135,15 +1164,78 @@ bool Server::start() {
         return false;
     }
 
+    /* One epoll set and wakeup eventfd per I/O thread */
+    std::vector<std::unique_ptr<IoLoop>> loops;
+    const int wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    bool ready = wake_fd >= 0;
+    for (int i = 0; ready && i < std::max(config_.io_threads, 1); ++i) {
+        auto loop = std::make_unique<IoLoop>();
+        loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        struct epoll_event ev {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr; /* The wakeup fd is the only entry without a connection */
+        ready = loop->epoll_fd >= 0 && loop->wake_fd >= 0 &&
+                epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &ev) == 0;
+        loops.push_back(std::move(loop));
+    }
+    if (!ready) {
+        for (const auto& loop : loops) {
+            if (loop->epoll_fd >= 0) static_cast<void>(close(loop->epoll_fd));
+            if (loop->wake_fd >= 0) static_cast<void>(close(loop->wake_fd));
+        }
+        if (wake_fd >= 0) static_cast<void>(close(wake_fd));
+        static_cast<void>(close(fd));
+        return false;
+    }
+
     {
         const std::scoped_lock<std::mutex> lock(state_mutex_);
         listen_fd_ = fd;
         status_ = ServerStatus::Running;
         running_ = true;
     }
+    {
+        const std::scoped_lock<std::mutex> lock(ready_mutex_);
+        workers_stop_ = false;
+    }
 
     const std::scoped_lock<std::mutex> lock(thread_mutex_);
+    accept_wake_fd_ = wake_fd;
+    io_loops_ = std::move(loops);
+    next_loop_ = 0;
+    const size_t workers =
+        config_.worker_threads > 0
+            ? static_cast<size_t>(config_.worker_threads)
+            : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    for (size_t i = 0; i < workers; ++i) {
+        worker_threads_.emplace_back(&Server::run_worker, this);
+    }
+    for (auto& loop : io_loops_) {
+        loop->thread = std::thread(&Server::run_io_loop, this, std::ref(*loop));
+    }
     accept_thread_ = std::thread(&Server::accept_connections, this);
+
+    if (config_.autovacuum_naptime_ms > 0) {
+        transaction::VacuumManager::Options options;
+        options.naptime = std::chrono::milliseconds(config_.autovacuum_naptime_ms);
+        options.threshold = static_cast<uint64_t>(config_.autovacuum_threshold);
+        options.cost_limit = static_cast<size_t>(config_.vacuum_cost_limit);
+        options.cost_delay = std::chrono::milliseconds(config_.vacuum_cost_delay_ms);
+        vacuum_.start(options);
+    }
+    if (replicas_) {
+        /* Replicas are not recovered; each is rebuilt from its heap */
+        for (const auto* table : catalog_.get_all_tables()) {
+            if (table->columnar_replica()) {
+                static_cast<void>(replicas_->attach(*table));
+            }
+        }
+        executor::ColumnarReplicaManager::Options options;
+        options.naptime = std::chrono::milliseconds(config_.replica_naptime_ms);
+        options.max_lag = std::chrono::milliseconds(config_.replica_max_lag_ms);
+        replicas_->start(options);
+    }
     return true;
 }
 
@@ -159,34 +1251,75 @@ bool Server::stop() {
         listen_fd_ = -1;
     }
 
+    const auto wake = [](int fd) {
+        const uint64_t one = 1;
+        static_cast<void>(write(fd, &one, sizeof(one)));
+    };
+
+    vacuum_.stop();
+    if (replicas_) {
+        replicas_->stop();
+    }
+
+    /* 1. Stop accepting, then stop the I/O loops */
     std::thread t;
+    std::vector<std::unique_ptr<IoLoop>> loops;
     {
         const std::scoped_lock<std::mutex> lock(thread_mutex_);
         if (accept_thread_.joinable()) {
             t = std::move(accept_thread_);
         }
+        loops.swap(io_loops_);
     }
+    wake(accept_wake_fd_);
     if (t.joinable()) {
         t.join();
     }
+    for (auto& loop : loops) {
+        wake(loop->wake_fd);
+        if (loop->thread.joinable()) {
+            loop->thread.join();
+        }
+    }
 
+    /* 2. Workers finish the messages they are running; a blocked send fails on shutdown */
     std::vector<std::thread> workers;
-    std::vector<int> fds;
     {
         const std::scoped_lock<std::mutex> lock(thread_mutex_);
-        fds.swap(client_fds_);
+        for (const auto& [fd, conn] : connections_) {
+            static_cast<void>(shutdown(fd, SHUT_RDWR));
+        }
         workers.swap(worker_threads_);
     }
+    {
+        const std::scoped_lock<std::mutex> lock(ready_mutex_);
+        workers_stop_ = true;
+        ready_.clear();
+    }
+    ready_cv_.notify_all();
     for (auto& worker : workers) {
         if (worker.joinable()) {
             worker.join();
         }
     }
 
-    // Now close the fds
-    for (const int fd : fds) {
+    /* 3. Sessions go before their sockets, aborting any open transaction */
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    {
+        const std::scoped_lock<std::mutex> lock(thread_mutex_);
+        connections.swap(connections_);
+    }
+    for (auto& [fd, conn] : connections) {
+        conn.reset();
         static_cast<void>(close(fd));
+        static_cast<void>(stats_.connections_active.fetch_sub(1));
     }
+    for (const auto& loop : loops) {
+        static_cast<void>(close(loop->epoll_fd));
+        static_cast<void>(close(loop->wake_fd));
+    }
+    static_cast<void>(close(accept_wake_fd_));
+    accept_wake_fd_ = -1;
 
     if (fd_to_close >= 0) {
         static_cast<void>(close(fd_to_close));
@@ -246,257 +1379,231 @@ std::string Server::get_status_string() const {
 }
 
 void Server::accept_connections() {
-    while (true) {
-        int fd = -1;
-        {
-            const std::scoped_lock<std::mutex> lock(state_mutex_);
-            if (!running_) {
-                break;
-            }
-            fd = listen_fd_;
-        }
-
-        fd_set read_fds;
-        FD_ZERO(&read_fds);
-        FD_SET(fd, &read_fds);
-        struct timeval timeout {
-            SELECT_TIMEOUT_SEC, 0
-        };
+    int listen_fd = -1;
+    {
+        const std::scoped_lock<std::mutex> lock(state_mutex_);
+        listen_fd = listen_fd_;
+    }
+    const int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        return;
+    }
+    for (const int fd : {listen_fd, accept_wake_fd_}) {
+        struct epoll_event ev {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        static_cast<void>(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev));
+    }
 
-        const int res = select(fd + 1, &read_fds, nullptr, nullptr, &timeout);
-        if (res <= 0) {
-            continue;
+    std::array<struct epoll_event, 2> events{};
+    while (is_running()) {
+        const int n = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+        if (n <= 0 || std::none_of(events.begin(), events.begin() + n, [&](const auto& ev) {
+                return ev.data.fd == listen_fd;
+            })) {
+            continue; /* EINTR, or the wakeup of stop() */
         }
 
-        struct sockaddr_in client_addr {};
-        socklen_t client_len = sizeof(client_addr);
-
-        const int client_fd =
-            accept(fd, reinterpret_cast<struct sockaddr*>(&client_addr), &client_len);
-
-        if (client_fd >= 0) {
+        /* Drain the backlog; each socket goes to the next loop in turn */
+        while (true) {
+            const int client_fd =
+                accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (client_fd < 0) {
+                break;
+            }
             const std::scoped_lock<std::mutex> lock(thread_mutex_);
-            client_fds_.push_back(client_fd);
-            worker_threads_.emplace_back(&Server::handle_connection, this, client_fd);
+            IoLoop& loop = *io_loops_[next_loop_++ % io_loops_.size()];
+            auto& conn = connections_[client_fd];
+            conn = std::make_unique<Connection>(client_fd, &loop);
+            /* Counted before the loop can see it, and so close it */
+            static_cast<void>(stats_.connections_accepted.fetch_add(1));
+            static_cast<void>(stats_.connections_active.fetch_add(1));
+            struct epoll_event ev {};
+            ev.events = CONNECTION_EVENTS;
+            ev.data.ptr = conn.get();
+            if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+                connections_.erase(client_fd);
+                static_cast<void>(close(client_fd));
+                static_cast<void>(stats_.connections_active.fetch_sub(1));
+            }
         }
     }
+    static_cast<void>(close(epoll_fd));
 }
 
-void Server::handle_connection(int client_fd) {
-    std::cerr << "--- [Server] handle_connection CALLED for fd " << client_fd << " ---"
-              << std::endl;
-    constexpr size_t PKT_BUF_SIZE = 8192;
-    std::array<char, PKT_BUF_SIZE> buffer{};
-
-    // 1. Handshake
-    ssize_t n = recv_all(client_fd, buffer.data(), HEADER_SIZE);
-    if (n < static_cast<ssize_t>(HEADER_SIZE)) {
-        static_cast<void>(close(client_fd));
-        return;
-    }
-
-    uint32_t len = ProtocolReader::read_int32(buffer.data());
-    if (len > buffer.size() || len < HEADER_SIZE) {
-        static_cast<void>(close(client_fd));
-        return;
+void Server::run_io_loop(IoLoop& loop) {
+    std::array<struct epoll_event, MAX_EPOLL_EVENTS> events{};
+    while (is_running()) {
+        const int n = epoll_wait(loop.epoll_fd, events.data(), MAX_EPOLL_EVENTS, -1);
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.ptr == nullptr) {
+                uint64_t count = 0;
+                static_cast<void>(read(loop.wake_fd, &count, sizeof(count)));
+                continue;
+            }
+            read_connection(*static_cast<Connection*>(events[i].data.ptr));
+        }
     }
+}
 
-    n = recv_all(client_fd, buffer.data() + HEADER_SIZE, len - HEADER_SIZE);
-    if (n < static_cast<ssize_t>(len - HEADER_SIZE)) {
-        static_cast<void>(close(client_fd));
-        return;
+void Server::read_connection(Connection& conn) {
+    {
+        const std::scoped_lock<std::mutex> lock(conn.handoff);
     }
-
-    uint32_t code = ProtocolReader::read_int32(buffer.data() + HEADER_SIZE);
-    if (code == PG_SSL_CODE) {  // SSL Request
-        const char n_response = 'N';
-        static_cast<void>(send(client_fd, &n_response, 1, 0));
-
-        // Expect startup packet next
-        n = recv_all(client_fd, buffer.data(), HEADER_SIZE);
-        if (n < static_cast<ssize_t>(HEADER_SIZE)) {
-            static_cast<void>(close(client_fd));
+    std::array<char, READ_CHUNK_SIZE> chunk{};
+    size_t size = 0;
+    /* Stop at the first complete message; the rest waits in the socket until it is run */
+    while ((size = message_size(conn.in, 0, conn.started)) == 0) {
+        const ssize_t n = recv(conn.fd, chunk.data(), chunk.size(), 0);
+        if (n > 0) {
+            conn.in.append(chunk.data(), static_cast<size_t>(n));
+            static_cast<void>(stats_.bytes_received.fetch_add(static_cast<uint64_t>(n)));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            rearm_connection(conn);
             return;
         }
-        len = ProtocolReader::read_int32(buffer.data());
-        static_cast<void>(recv_all(client_fd, buffer.data() + HEADER_SIZE, len - HEADER_SIZE));
-        code = ProtocolReader::read_int32(buffer.data() + HEADER_SIZE);
+        conn.eof = true; /* Closed by the client, or a socket error */
+        break;
     }
 
-    if (code != PG_STARTUP_CODE) {
-        static_cast<void>(close(client_fd));
+    if (size == 0 || size == MALFORMED_MESSAGE) {
+        close_connection(conn);
         return;
     }
+    queue_connection(conn);
+}
 
-    // Auth OK
-    const std::array<char, 9> auth_ok = {'R', 0, 0, 0, 8, 0, 0, 0, 0};
-    static_cast<void>(send(client_fd, auth_ok.data(), auth_ok.size(), 0));
-
-    // Ready for Query
-    const std::array<char, 6> ready = {'Z', 0, 0, 0, 5, 'I'};
-    static_cast<void>(send(client_fd, ready.data(), ready.size(), 0));
-
-    // 2. Query Loop
-    executor::QueryExecutor exec(catalog_, bpm_, lock_manager_, transaction_manager_);
+void Server::queue_connection(Connection& conn) {
+    {
+        const std::scoped_lock<std::mutex> lock(ready_mutex_);
+        if (workers_stop_) {
+            return; /* Shutting down: the connection is closed where it is */
+        }
+        ready_.push_back(&conn);
+    }
+    ready_cv_.notify_one();
+}
 
+void Server::run_worker() {
     while (true) {
-        char type = 0;
-        n = recv(client_fd, &type, 1, 0);
-        if (n <= 0) {
-            break;
-        }
-
-        n = recv_all(client_fd, buffer.data(), 4);
-        if (n < 4) {
-            break;
-        }
-        len = ProtocolReader::read_int32(buffer.data());
-
-        if (type == 'Q') {
-            std::vector<char> sql_buf(len - 4);
-            static_cast<void>(recv_all(client_fd, sql_buf.data(), len - 4));
-            const std::string sql(sql_buf.data());
-
-            try {
-                auto lexer = std::make_unique<parser::Lexer>(sql);
-                parser::Parser parser(std::move(lexer));
-                auto stmt = parser.parse_statement();
-
-                if (stmt) {
-                    executor::QueryResult res;
-                    if (config_.mode == config::RunMode::Coordinator &&
-                        cluster_manager_ != nullptr) {
-                        executor::DistributedExecutor dist_exec(catalog_, *cluster_manager_);
-                        res = dist_exec.execute(*stmt, sql);
-                    } else {
-                        res = exec.execute(*stmt);
-                    }
+        Connection* conn = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(ready_mutex_);
+            ready_cv_.wait(lock, [this]() { return workers_stop_ || !ready_.empty(); });
+            if (workers_stop_) {
+                return;
+            }
+            conn = ready_.front();
+            ready_.pop_front();
+        }
+        serve_connection(*conn);
+    }
+}
 
-                    if (res.success()) {
-                        // Row Description (T)
-                        if (!res.rows().empty() && res.schema().column_count() > 0) {
-                            const auto& schema = res.schema();
-                            const auto num_cols = static_cast<uint32_t>(schema.column_count());
-
-                            // Calculate T packet length
-                            uint32_t t_len = 4 + 2;  // len + num_cols
-                            for (uint32_t i = 0; i < num_cols; ++i) {
-                                t_len += static_cast<uint32_t>(schema.get_column(i).name().size()) +
-                                         1 + 4 + 2 + 4 + 2 + 4 + 2;
-                            }
-
-                            const char t_type = 'T';
-                            const uint32_t net_t_len = htonl(t_len);
-                            const uint16_t net_num_cols = htons(static_cast<uint16_t>(num_cols));
-
-                            static_cast<void>(send(client_fd, &t_type, 1, 0));
-                            static_cast<void>(send(client_fd, &net_t_len, 4, 0));
-                            static_cast<void>(send(client_fd, &net_num_cols, 2, 0));
-
-                            for (uint32_t i = 0; i < num_cols; ++i) {
-                                const auto& col = schema.get_column(i);
-                                static_cast<void>(
-                                    send(client_fd, col.name().c_str(), col.name().size() + 1, 0));
-                                const uint32_t table_oid = 0;
-                                const uint16_t col_attr = 0;
-                                const uint32_t type_oid = htonl(23);  // 23 is int4, simplified
-                                const uint16_t type_len = htons(4);
-                                const uint32_t type_mod = htonl(0xFFFFFFFF);
-                                const uint16_t format = 0;  // Text format
-
-                                static_cast<void>(send(client_fd, &table_oid, 4, 0));
-                                static_cast<void>(send(client_fd, &col_attr, 2, 0));
-                                static_cast<void>(send(client_fd, &type_oid, 4, 0));
-                                static_cast<void>(send(client_fd, &type_len, 2, 0));
-                                static_cast<void>(send(client_fd, &type_mod, 4, 0));
-                                static_cast<void>(send(client_fd, &format, 2, 0));
-                            }
-
-                            // Data Rows (D)
-                            for (const auto& row : res.rows()) {
-                                const char d_type = 'D';
-                                uint32_t d_len = 4 + 2;  // len + num_cols
-
-                                struct ColValue {
-                                    bool is_null;
-                                    std::string val;
-                                };
-                                std::vector<ColValue> col_vals;
-                                col_vals.reserve(num_cols);
-
-                                for (uint32_t i = 0; i < num_cols; ++i) {
-                                    const auto& v = row.get(i);
-                                    if (v.is_null()) {
-                                        col_vals.push_back({true, ""});
-                                        d_len += 4;
-                                    } else {
-                                        std::string s_val = v.to_string();
-                                        d_len += 4 + static_cast<uint32_t>(s_val.size());
-                                        col_vals.push_back({false, std::move(s_val)});
-                                    }
-                                }
-
-                                const uint32_t net_d_len = htonl(d_len);
-                                static_cast<void>(send(client_fd, &d_type, 1, 0));
-                                static_cast<void>(send(client_fd, &net_d_len, 4, 0));
-                                static_cast<void>(send(client_fd, &net_num_cols, 2, 0));
-
-                                for (const auto& cv : col_vals) {
-                                    if (cv.is_null) {
-                                        const uint32_t null_len = 0xFFFFFFFF;
-                                        static_cast<void>(send(client_fd, &null_len, 4, 0));
-                                    } else {
-                                        const uint32_t val_len =
-                                            htonl(static_cast<uint32_t>(cv.val.size()));
-                                        static_cast<void>(send(client_fd, &val_len, 4, 0));
-                                        static_cast<void>(
-                                            send(client_fd, cv.val.c_str(), cv.val.size(), 0));
-                                    }
-                                }
-                            }
-                        }
-
-                        // Command Complete (C)
-                        const std::string tag = "SELECT " + std::to_string(res.row_count());
-                        const uint32_t tag_len = htonl(static_cast<uint32_t>(tag.size() + 4 + 1));
-                        const char c_type = 'C';
-                        static_cast<void>(send(client_fd, &c_type, 1, 0));
-                        static_cast<void>(send(client_fd, &tag_len, 4, 0));
-                        static_cast<void>(send(client_fd, tag.c_str(), tag.size() + 1, 0));
-                    } else {
-                        // Error Response (E)
-                        const std::string& err = res.error();
-                        const uint32_t e_len = htonl(static_cast<uint32_t>(err.size() + 4 + 1));
-                        const char e_type = 'E';
-                        static_cast<void>(send(client_fd, &e_type, 1, 0));
-                        static_cast<void>(send(client_fd, &e_len, 4, 0));
-                        static_cast<void>(send(client_fd, err.c_str(), err.size() + 1, 0));
+void Server::serve_connection(Connection& conn) {
+    bool keep = true;
+    size_t pos = 0;
+    try {
+        if (conn.session) {
+            keep = conn.session->resume(); /* Woken by a remote query that completed */
+        }
+        size_t size = 0;
+        while (keep && (size = message_size(conn.in, pos, conn.started)) != 0) {
+            if (size == MALFORMED_MESSAGE) {
+                keep = false;
+                break;
+            }
+            const char* const msg = conn.in.data() + pos;
+            pos += size;
+
+            if (conn.started) {
+                conn.body.assign(msg + 1 + HEADER_SIZE, msg + size);
+                keep = conn.session->handle(msg[0], conn.body);
+                if (keep && conn.session->awaiting()) {
+                    /* The rest waits for the query; whoever resumes it must find only that */
+                    conn.in.erase(0, pos);
+                    pos = 0;
+                    if (conn.session->park()) {
+                        return; /* Queued again by the completion */
                     }
+                    keep = conn.session->resume();
                 }
-            } catch (const std::exception& e) {
-                const std::string err = e.what();
-                const uint32_t e_len = htonl(static_cast<uint32_t>(err.size() + 4 + 1));
-                const char e_type = 'E';
-                static_cast<void>(send(client_fd, &e_type, 1, 0));
-                static_cast<void>(send(client_fd, &e_len, 4, 0));
-                static_cast<void>(send(client_fd, err.c_str(), err.size() + 1, 0));
+                continue;
+            }
+
+            const uint32_t code = ProtocolReader::read_int32(msg + HEADER_SIZE);
+            if (code == PG_SSL_CODE) {
+                /* SSL is not supported; the startup packet follows in the clear */
+                keep = send_all(conn.fd, "N", 1);
+            } else if (code == PG_STARTUP_CODE) {
+                // Auth OK, then Ready for Query
+                const std::array<char, 15> auth_ok = {'R', 0, 0, 0, 8, 0,   0, 0,
+                                                      0,   'Z', 0, 0, 0, 5, 'I'};
+                keep = send_all(conn.fd, auth_ok.data(), auth_ok.size());
+                conn.exec = std::make_unique<executor::QueryExecutor>(
+                    catalog_, bpm_, lock_manager_, transaction_manager_, bpm_.get_log_manager());
+                conn.exec->set_result_cache(result_cache_.get());
+                conn.exec->set_columnar_replicas(replicas_.get());
+                conn.session = std::make_unique<ClientSession>(conn.fd, catalog_, *conn.exec,
+                                                               config_, cluster_manager_, stats_);
+                conn.session->set_wake([this, &conn]() { queue_connection(conn); });
+                conn.started = true;
+            } else {
+                keep = false;
             }
-        } else if (type == 'X') {
-            break;
         }
+    } catch (const std::exception& e) {
+        std::cerr << "--- [Server] Closing connection on fd " << conn.fd << ": " << e.what()
+                  << " ---" << std::endl;
+        keep = false;
+    }
+
+    if (!keep || conn.eof) {
+        close_connection(conn);
+        return;
+    }
 
-        /* Ready for Query */
-        static_cast<void>(send(client_fd, ready.data(), ready.size(), 0));
+    /* Idle from here: keep only small buffers */
+    conn.in.erase(0, pos);
+    if (conn.in.capacity() > IDLE_BUFFER_SIZE && conn.in.size() <= IDLE_BUFFER_SIZE) {
+        conn.in.shrink_to_fit();
+    }
+    std::vector<char>().swap(conn.body);
+    if (conn.session) {
+        conn.session->release_buffers();
     }
+    rearm_connection(conn);
+}
+
+void Server::rearm_connection(Connection& conn) {
+    const std::scoped_lock<std::mutex> lock(conn.handoff);
+    struct epoll_event ev {};
+    ev.events = CONNECTION_EVENTS;
+    ev.data.ptr = &conn;
+    static_cast<void>(epoll_ctl(conn.loop->epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev));
+}
 
+void Server::close_connection(Connection& conn) {
+    const int fd = conn.fd;
+    static_cast<void>(epoll_ctl(conn.loop->epoll_fd, EPOLL_CTL_DEL, fd, nullptr));
+    std::unique_ptr<Connection> owned;
     {
         const std::scoped_lock<std::mutex> lock(thread_mutex_);
-        auto it = std::find(client_fds_.begin(), client_fds_.end(), client_fd);
-        if (it != client_fds_.end()) {
-            static_cast<void>(client_fds_.erase(it));
+        const auto it = connections_.find(fd);
+        if (it != connections_.end()) {
+            owned = std::move(it->second);
+            connections_.erase(it);
         }
     }
-    static_cast<void>(close(client_fd));
+    /* The fd is closed last, so that it cannot be reused while still in the map */
+    owned.reset();
+    static_cast<void>(close(fd));
+    static_cast<void>(stats_.connections_active.fetch_sub(1));
 }
 
 }  // namespace cloudsql::network
@@ -0,0 +1,55 @@
+/**
+ * @file ast_arena.cpp
+ * @brief AST node allocation
+ */
+
+#include "parser/ast_arena.hpp"
+
+#include <cstddef>
+#include <new>
+
+#include "common/arena.hpp"
+
+namespace cloudsql::parser {
+
+namespace {
+
+thread_local common::Arena* current_arena = nullptr;
+
+/* Keeps the node behind the header as aligned as operator new would */
+constexpr size_t HEADER_SIZE = alignof(std::max_align_t);
+
+}  // namespace
+
+AstArenaScope::AstArenaScope(common::Arena& arena) : previous_(current_arena) {
+    current_arena = &arena;
+}
+
+AstArenaScope::~AstArenaScope() {
+    current_arena = previous_;
+}
+
+common::Arena* AstArenaScope::current() {
+    return current_arena;
+}
+
+void* AstNode::operator new(size_t size) {
+    common::Arena* const arena = current_arena;
+    void* const block = arena != nullptr ? arena->allocate(HEADER_SIZE + size, HEADER_SIZE)
+                                         : ::operator new(HEADER_SIZE + size);
+    *static_cast<common::Arena**>(block) = arena;
+    return static_cast<char*>(block) + HEADER_SIZE;
+}
+
+void AstNode::operator delete(void* ptr) noexcept {
+    if (ptr == nullptr) {
+        return;
+    }
+    void* const block = static_cast<char*>(ptr) - HEADER_SIZE;
+    if (*static_cast<common::Arena**>(block) == nullptr) {
+        ::operator delete(block);
+    }
+    /* Arena nodes go when their arena is reset */
+}
+
+}  // namespace cloudsql::parser
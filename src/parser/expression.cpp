@@ -6,6 +6,8 @@
 #include "parser/expression.hpp"
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -14,10 +16,340 @@
 
 #include "common/value.hpp"
 #include "executor/types.hpp"
+#include "executor/vector_kernels.hpp"
 #include "parser/token.hpp"
 
 namespace cloudsql::parser {
 
+namespace {
+
+namespace kernels = executor::kernels;
+
+/** How a subexpression's values are laid out on the typed kernel path */
+enum class KernelType : uint8_t { None, Int, Float, Bool };
+
+KernelType kernel_type_of(common::ValueType type) {
+    switch (type) {
+        case common::ValueType::TYPE_INT8:
+        case common::ValueType::TYPE_INT16:
+        case common::ValueType::TYPE_INT32:
+        case common::ValueType::TYPE_INT64:
+            return KernelType::Int;
+        case common::ValueType::TYPE_FLOAT32:
+        case common::ValueType::TYPE_FLOAT64:
+            return KernelType::Float;
+        case common::ValueType::TYPE_BOOL:
+            return KernelType::Bool;
+        default:
+            return KernelType::None;
+    }
+}
+
+bool to_compare_kind(TokenType op, kernels::CompareKind* kind) {
+    switch (op) {
+        case TokenType::Eq:
+            *kind = kernels::CompareKind::Eq;
+            return true;
+        case TokenType::Ne:
+            *kind = kernels::CompareKind::Ne;
+            return true;
+        case TokenType::Lt:
+            *kind = kernels::CompareKind::Lt;
+            return true;
+        case TokenType::Le:
+            *kind = kernels::CompareKind::Le;
+            return true;
+        case TokenType::Gt:
+            *kind = kernels::CompareKind::Gt;
+            return true;
+        case TokenType::Ge:
+            *kind = kernels::CompareKind::Ge;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool to_arith_kind(TokenType op, kernels::ArithKind* kind) {
+    switch (op) {
+        case TokenType::Plus:
+            *kind = kernels::ArithKind::Add;
+            return true;
+        case TokenType::Minus:
+            *kind = kernels::ArithKind::Sub;
+            return true;
+        case TokenType::Star:
+            *kind = kernels::ArithKind::Mul;
+            return true;
+        case TokenType::Slash:
+            *kind = kernels::ArithKind::Div;
+            return true;
+        default:
+            return false;
+    }
+}
+
+size_t resolve_column(const ColumnExpr& column, const executor::Schema& schema) {
+    size_t index = schema.find_column(column.to_string());
+    if (index == static_cast<size_t>(-1) && column.has_table()) {
+        index = schema.find_column(column.name());
+    }
+    return index;
+}
+
+/**
+ * @brief Result layout of `expr` if it can run on the kernels, else None
+ *
+ * Arithmetic follows the row evaluator: integers stay integers except under
+ * division, and any double operand makes the result a double.
+ */
+KernelType kernel_type(const Expression& expr, const executor::VectorBatch& batch,
+                       const executor::Schema& schema) {
+    if (expr.type() == ExprType::Column) {
+        const size_t index = resolve_column(static_cast<const ColumnExpr&>(expr), schema);
+        if (index == static_cast<size_t>(-1) || index >= batch.column_count()) {
+            return KernelType::None;
+        }
+        return kernel_type_of(const_cast<executor::VectorBatch&>(batch).get_column(index).type());
+    }
+    if (expr.type() == ExprType::Constant) {
+        const common::Value& value = static_cast<const ConstantExpr&>(expr).value();
+        return value.is_null() ? KernelType::None : kernel_type_of(value.type());
+    }
+    if (expr.type() != ExprType::Binary) {
+        return KernelType::None;
+    }
+
+    const auto& binary = static_cast<const BinaryExpr&>(expr);
+    if (binary.left().type() == ExprType::Constant && binary.right().type() == ExprType::Constant) {
+        return KernelType::None;
+    }
+    const KernelType left = kernel_type(binary.left(), batch, schema);
+    const KernelType right = kernel_type(binary.right(), batch, schema);
+    if (left == KernelType::None || right == KernelType::None) {
+        return KernelType::None;
+    }
+    const bool numeric = left != KernelType::Bool && right != KernelType::Bool;
+
+    kernels::CompareKind compare = kernels::CompareKind::Eq;
+    kernels::ArithKind arith = kernels::ArithKind::Add;
+    if (to_compare_kind(binary.op(), &compare)) {
+        return numeric ? KernelType::Bool : KernelType::None;
+    }
+    if (to_arith_kind(binary.op(), &arith)) {
+        if (!numeric) return KernelType::None;
+        return (left == KernelType::Int && right == KernelType::Int &&
+                arith != kernels::ArithKind::Div)
+                   ? KernelType::Int
+                   : KernelType::Float;
+    }
+    if (binary.op() == TokenType::And || binary.op() == TokenType::Or) {
+        return (left == KernelType::Bool && right == KernelType::Bool) ? KernelType::Bool
+                                                                       : KernelType::None;
+    }
+    return KernelType::None;
+}
+
+/** One side of a binary expression, bound to raw buffers (or a scalar) */
+struct Operand {
+    bool scalar = false;
+    int64_t int_value = 0;
+    double float_value = 0;
+    const int64_t* ints = nullptr;
+    const double* floats = nullptr;
+    const uint8_t* bools = nullptr;
+    const uint8_t* nulls = nullptr; /**< nullptr when no row is NULL */
+    std::unique_ptr<executor::ColumnVector> owned; /**< Evaluated subexpression */
+    std::vector<double> widened;
+    std::vector<uint8_t> broadcast;
+};
+
+std::unique_ptr<executor::ColumnVector> make_vector(KernelType type) {
+    switch (type) {
+        case KernelType::Int:
+            return std::make_unique<executor::NumericVector<int64_t>>(
+                common::ValueType::TYPE_INT64);
+        case KernelType::Float:
+            return std::make_unique<executor::NumericVector<double>>(
+                common::ValueType::TYPE_FLOAT64);
+        default:
+            return std::make_unique<executor::NumericVector<bool>>(common::ValueType::TYPE_BOOL);
+    }
+}
+
+/**
+ * @brief Bind `expr` as an operand laid out as `want`, widening integers to doubles
+ * @return false if the operand cannot be bound (the caller falls back)
+ */
+bool bind_operand(const Expression& expr, KernelType want, const executor::VectorBatch& batch,
+                  const executor::Schema& schema, Operand* op) {
+    const size_t rows = batch.row_count();
+    const KernelType have = kernel_type(expr, batch, schema);
+
+    if (expr.type() == ExprType::Constant) {
+        const common::Value& value = static_cast<const ConstantExpr&>(expr).value();
+        if (want == KernelType::Bool) {
+            op->broadcast.assign(rows, value.as_bool() ? 1 : 0);
+            op->bools = op->broadcast.data();
+            return true;
+        }
+        op->scalar = true;
+        op->int_value = value.to_int64();
+        op->float_value = value.to_float64();
+        return true;
+    }
+
+    const executor::ColumnVector* column = nullptr;
+    if (expr.type() == ExprType::Column) {
+        const size_t index = resolve_column(static_cast<const ColumnExpr&>(expr), schema);
+        column = &const_cast<executor::VectorBatch&>(batch).get_column(index);
+    } else {
+        op->owned = make_vector(have);
+        expr.evaluate_vectorized(batch, schema, *op->owned);
+        column = op->owned.get();
+    }
+    if (column->size() < rows) return false;
+    op->nulls = column->null_data();
+
+    if (have == KernelType::Bool) {
+        op->bools = dynamic_cast<const executor::NumericVector<bool>&>(*column).raw_data();
+    } else if (have == KernelType::Float) {
+        op->floats = dynamic_cast<const executor::NumericVector<double>&>(*column).raw_data();
+    } else {
+        op->ints = dynamic_cast<const executor::NumericVector<int64_t>&>(*column).raw_data();
+        if (want == KernelType::Float) {
+            op->widened.resize(rows);
+            kernels::widen(op->ints, rows, op->widened.data());
+            op->floats = op->widened.data();
+        }
+    }
+    return true;
+}
+
+void combine_nulls(const Operand& left, const Operand& right, size_t rows, uint8_t* out) {
+    if (left.nulls != nullptr && right.nulls != nullptr) {
+        kernels::or_masks(left.nulls, right.nulls, rows, out);
+    } else if (left.nulls != nullptr || right.nulls != nullptr) {
+        std::memcpy(out, left.nulls != nullptr ? left.nulls : right.nulls, rows);
+    } else {
+        std::memset(out, 0, rows);
+    }
+}
+
+template <typename T>
+void run_arith(kernels::ArithKind kind, const Operand& left, const Operand& right,
+               const T* left_values, const T* right_values, T left_scalar, T right_scalar,
+               size_t rows, T* out) {
+    if (left.scalar) {
+        kernels::arith(kind, left_scalar, right_values, rows, out);
+    } else if (right.scalar) {
+        kernels::arith(kind, left_values, right_scalar, rows, out);
+    } else {
+        kernels::arith(kind, left_values, right_values, rows, out);
+    }
+}
+
+template <typename T>
+void run_compare(kernels::CompareKind kind, const Operand& left, const Operand& right,
+                 const T* left_values, const T* right_values, T left_scalar, T right_scalar,
+                 size_t rows, uint8_t* out) {
+    if (left.scalar) {
+        kernels::compare(kernels::flip(kind), right_values, left_scalar, rows, out);
+    } else if (right.scalar) {
+        kernels::compare(kind, left_values, right_scalar, rows, out);
+    } else {
+        kernels::compare(kind, left_values, right_values, rows, out);
+    }
+}
+
+/**
+ * @brief Evaluate `expr` over the whole batch with the typed kernels
+ * @return false if some part of it is not supported; `result` is then untouched
+ */
+bool evaluate_with_kernels(const BinaryExpr& expr, const executor::VectorBatch& batch,
+                           const executor::Schema& schema, executor::ColumnVector& result) {
+    const KernelType out_type = kernel_type(expr, batch, schema);
+    if (out_type == KernelType::None) return false;
+
+    // The caller picks the result vector; only fill the layout the kernels produce
+    auto* int_out = dynamic_cast<executor::NumericVector<int64_t>*>(&result);
+    auto* float_out = dynamic_cast<executor::NumericVector<double>*>(&result);
+    auto* bool_out = dynamic_cast<executor::NumericVector<bool>*>(&result);
+    if ((out_type == KernelType::Int && int_out == nullptr) ||
+        (out_type == KernelType::Float && float_out == nullptr) ||
+        (out_type == KernelType::Bool && bool_out == nullptr)) {
+        return false;
+    }
+
+    kernels::CompareKind compare = kernels::CompareKind::Eq;
+    kernels::ArithKind arith = kernels::ArithKind::Add;
+    const bool is_compare = to_compare_kind(expr.op(), &compare);
+    const bool is_arith = to_arith_kind(expr.op(), &arith);
+    KernelType want = out_type;
+    if (is_compare) {
+        want = (kernel_type(expr.left(), batch, schema) == KernelType::Int &&
+                kernel_type(expr.right(), batch, schema) == KernelType::Int)
+                   ? KernelType::Int
+                   : KernelType::Float;
+    }
+
+    Operand left;
+    Operand right;
+    if (!bind_operand(expr.left(), want, batch, schema, &left) ||
+        !bind_operand(expr.right(), want, batch, schema, &right)) {
+        return false;
+    }
+
+    const size_t rows = batch.row_count();
+    result.clear();
+    if (out_type == KernelType::Int) {
+        int_out->resize(rows);
+    } else if (out_type == KernelType::Float) {
+        float_out->resize(rows);
+    } else {
+        bool_out->resize(rows);
+    }
+    if (rows == 0) return true;
+    uint8_t* const out_nulls = result.null_data_mut();
+
+    if (!is_compare && !is_arith) {
+        // AND / OR decide some rows even when one side is NULL
+        const std::vector<uint8_t> no_nulls(
+            (left.nulls == nullptr || right.nulls == nullptr) ? rows : 0, 0);
+        const uint8_t* const left_nulls = left.nulls != nullptr ? left.nulls : no_nulls.data();
+        const uint8_t* const right_nulls = right.nulls != nullptr ? right.nulls : no_nulls.data();
+        if (expr.op() == TokenType::And) {
+            kernels::logical_and(left.bools, left_nulls, right.bools, right_nulls, rows,
+                                 bool_out->raw_data_mut(), out_nulls);
+        } else {
+            kernels::logical_or(left.bools, left_nulls, right.bools, right_nulls, rows,
+                                bool_out->raw_data_mut(), out_nulls);
+        }
+        return true;
+    }
+
+    combine_nulls(left, right, rows, out_nulls);
+    if (is_compare) {
+        uint8_t* const out = bool_out->raw_data_mut();
+        if (want == KernelType::Int) {
+            run_compare(compare, left, right, left.ints, right.ints, left.int_value,
+                        right.int_value, rows, out);
+        } else {
+            run_compare(compare, left, right, left.floats, right.floats, left.float_value,
+                        right.float_value, rows, out);
+        }
+    } else if (out_type == KernelType::Int) {
+        run_arith(arith, left, right, left.ints, right.ints, left.int_value, right.int_value,
+                  rows, int_out->raw_data_mut());
+    } else {
+        run_arith(arith, left, right, left.floats, right.floats, left.float_value,
+                  right.float_value, rows, float_out->raw_data_mut());
+    }
+    return true;
+}
+
+}  // namespace
+
 /**
  * @brief Evaluate binary expression
  */
@@ -74,52 +406,9 @@ void BinaryExpr::evaluate_vectorized(const executor::VectorBatch& batch,
     const size_t row_count = batch.row_count();
     result.clear();
 
-    // Try to optimize: Column op Constant
-    if (left_->type() == ExprType::Column && right_->type() == ExprType::Constant) {
-        const auto& col_expr = static_cast<const ColumnExpr&>(*left_);
-        const auto& const_expr = static_cast<const ConstantExpr&>(*right_);
-        const size_t col_idx = schema.find_column(col_expr.name());
-
-        if (col_idx != static_cast<size_t>(-1)) {
-            auto& src_col = const_cast<executor::VectorBatch&>(batch).get_column(col_idx);
-
-            // INT64 optimize
-            if (src_col.type() == common::ValueType::TYPE_INT64 &&
-                const_expr.value().type() == common::ValueType::TYPE_INT64) {
-                auto& num_src = dynamic_cast<executor::NumericVector<int64_t>&>(src_col);
-                const int64_t* src_data = num_src.raw_data();
-                const int64_t const_val = const_expr.value().as_int64();
-
-                if (op_ == TokenType::Gt) {
-                    auto& bool_res = dynamic_cast<executor::NumericVector<bool>&>(result);
-                    bool_res.resize(row_count);
-                    uint8_t* res_data = bool_res.raw_data_mut();
-                    for (size_t i = 0; i < row_count; ++i) {
-                        if (num_src.is_null(i)) {
-                            bool_res.set_null(i, true);
-                        } else {
-                            res_data[i] = static_cast<uint8_t>(src_data[i] > const_val);
-                            bool_res.set_null(i, false);
-                        }
-                    }
-                    return;
-                }
-                if (op_ == TokenType::Eq) {
-                    auto& bool_res = dynamic_cast<executor::NumericVector<bool>&>(result);
-                    bool_res.resize(row_count);
-                    uint8_t* res_data = bool_res.raw_data_mut();
-                    for (size_t i = 0; i < row_count; ++i) {
-                        if (num_src.is_null(i)) {
-                            bool_res.set_null(i, true);
-                        } else {
-                            res_data[i] = static_cast<uint8_t>(src_data[i] == const_val);
-                            bool_res.set_null(i, false);
-                        }
-                    }
-                    return;
-                }
-            }
-        }
+    // Typed kernels over the raw column buffers
+    if (evaluate_with_kernels(*this, batch, schema, result)) {
+        return;
     }
 
     // Fallback to row-by-row if not optimized
@@ -274,6 +563,9 @@ void ColumnExpr::evaluate_vectorized(const executor::VectorBatch& batch,
     }
 
     auto& src_col = const_cast<executor::VectorBatch&>(batch).get_column(index);
+    if (result.gather_from(src_col, nullptr, batch.row_count())) {
+        return;
+    }
     for (size_t i = 0; i < batch.row_count(); ++i) {
         result.append(src_col.get(i));
     }
@@ -292,7 +584,7 @@ common::Value ConstantExpr::evaluate(const executor::Tuple* tuple,
                                      const executor::Schema* schema) const {
     (void)tuple;
     (void)schema;
-    return value_;
+    return value();
 }
 
 void ConstantExpr::evaluate_vectorized(const executor::VectorBatch& batch,
@@ -301,11 +593,14 @@ void ConstantExpr::evaluate_vectorized(const executor::VectorBatch& batch,
     (void)schema;
     result.clear();
     for (size_t i = 0; i < batch.row_count(); ++i) {
-        result.append(value_);
+        result.append(value());
     }
 }
 
 std::string ConstantExpr::to_string() const {
+    if (parameter_) {
+        return "$" + std::to_string(parameter_index_);
+    }
     if (value_.type() == common::ValueType::TYPE_TEXT) {
         return "'" + value_.to_string() + "'";
     }
@@ -313,6 +608,9 @@ std::string ConstantExpr::to_string() const {
 }
 
 std::unique_ptr<Expression> ConstantExpr::clone() const {
+    if (parameter_) {
+        return std::make_unique<ConstantExpr>(parameter_index_, parameter_);
+    }
     return std::make_unique<ConstantExpr>(value_);
 }
 
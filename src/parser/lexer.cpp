@@ -5,20 +5,153 @@
 
 #include "parser/lexer.hpp"
 
-#include <algorithm>
+#include <array>
 #include <cctype>
+#include <charconv>
 #include <cstddef>
 #include <cstdint>
-#include <map>
 #include <string>
+#include <string_view>
+#include <system_error>
 #include <utility>
 
 #include "parser/token.hpp"
 
 namespace cloudsql::parser {
 
-// Static member initialization
-const std::map<std::string, TokenType> Lexer::keywords_ = Lexer::init_keywords();
+namespace {
+
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+constexpr std::array<Keyword, 60> KEYWORDS = {{{"SELECT", TokenType::Select},
+                                               {"FROM", TokenType::From},
+                                               {"WHERE", TokenType::Where},
+                                               {"INSERT", TokenType::Insert},
+                                               {"INTO", TokenType::Into},
+                                               {"VALUES", TokenType::Values},
+                                               {"DELETE", TokenType::Delete},
+                                               {"UPDATE", TokenType::Update},
+                                               {"SET", TokenType::Set},
+                                               {"CREATE", TokenType::Create},
+                                               {"TABLE", TokenType::Table},
+                                               {"INDEX", TokenType::Index},
+                                               {"DROP", TokenType::Drop},
+                                               {"AND", TokenType::And},
+                                               {"OR", TokenType::Or},
+                                               {"NOT", TokenType::Not},
+                                               {"IN", TokenType::In},
+                                               {"LIKE", TokenType::Like},
+                                               {"BETWEEN", TokenType::Between},
+                                               {"IS", TokenType::Is},
+                                               {"NULL", TokenType::Null},
+                                               {"TRUE", TokenType::True},
+                                               {"FALSE", TokenType::False},
+                                               {"JOIN", TokenType::Join},
+                                               {"ON", TokenType::On},
+                                               {"LEFT", TokenType::Left},
+                                               {"RIGHT", TokenType::Right},
+                                               {"INNER", TokenType::Inner},
+                                               {"OUTER", TokenType::Outer},
+                                               {"FULL", TokenType::Full},
+                                               {"GROUP", TokenType::Group},
+                                               {"BY", TokenType::By},
+                                               {"ORDER", TokenType::Order},
+                                               {"ASC", TokenType::Asc},
+                                               {"DESC", TokenType::Desc},
+                                               {"LIMIT", TokenType::Limit},
+                                               {"OFFSET", TokenType::Offset},
+                                               {"BEGIN", TokenType::Begin},
+                                               {"COMMIT", TokenType::Commit},
+                                               {"ROLLBACK", TokenType::Rollback},
+                                               {"IF", TokenType::If},
+                                               {"EXISTS", TokenType::Exists},
+                                               {"UNIQUE", TokenType::Unique},
+                                               {"INT", TokenType::TypeInt},
+                                               {"INTEGER", TokenType::TypeInt},
+                                               {"BIGINT", TokenType::TypeBigInt},
+                                               {"FLOAT", TokenType::TypeFloat},
+                                               {"DOUBLE", TokenType::TypeDouble},
+                                               {"TEXT", TokenType::TypeText},
+                                               {"VARCHAR", TokenType::TypeVarchar},
+                                               {"CHAR", TokenType::TypeChar},
+                                               {"BOOL", TokenType::TypeBool},
+                                               {"BOOLEAN", TokenType::TypeBool},
+                                               {"DISTINCT", TokenType::Distinct},
+                                               {"HAVING", TokenType::Having},
+                                               {"ANALYZE", TokenType::Analyze},
+                                               {"COPY", TokenType::Copy},
+                                               {"VACUUM", TokenType::Vacuum},
+                                               {"EXPLAIN", TokenType::Explain}}};
+
+char to_upper(char c) {
+    return static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+}
+
+/**
+ * @brief Case-insensitive keyword lookup through a perfect hash
+ *
+ * The seed is searched for once, at startup, so that every keyword has a slot
+ * of its own. A lookup hashes the word as it stands in the input, upper-casing
+ * on the fly, and compares it with the one keyword in its slot.
+ */
+class KeywordTable {
+   public:
+    KeywordTable() {
+        for (seed_ = 1;; ++seed_) {
+            slots_.fill(nullptr);
+            bool collided = false;
+            for (const auto& keyword : KEYWORDS) {
+                const Keyword*& slot = slots_[hash(keyword.text)];
+                if (slot != nullptr) {
+                    collided = true;
+                    break;
+                }
+                slot = &keyword;
+            }
+            if (!collided) {
+                return;
+            }
+        }
+    }
+
+    /** @return The keyword `word` spells, or nullptr if it is an identifier */
+    [[nodiscard]] const Keyword* find(std::string_view word) const {
+        const Keyword* const keyword = slots_[hash(word)];
+        if (keyword == nullptr || keyword->text.size() != word.size()) {
+            return nullptr;
+        }
+        for (size_t i = 0; i < word.size(); ++i) {
+            if (to_upper(word[i]) != keyword->text[i]) {
+                return nullptr;
+            }
+        }
+        return keyword;
+    }
+
+   private:
+    static constexpr size_t SLOTS = 512; /**< A power of two well above the keyword count */
+
+    [[nodiscard]] size_t hash(std::string_view word) const {
+        uint32_t h = seed_ * 2166136261U;
+        for (const char c : word) {
+            h = (h ^ static_cast<uint8_t>(to_upper(c))) * 16777619U;
+        }
+        return (h ^ (h >> 15)) & (SLOTS - 1);
+    }
+
+    uint32_t seed_ = 1;
+    std::array<const Keyword*, SLOTS> slots_{};
+};
+
+const KeywordTable& keywords() {
+    static const KeywordTable table;
+    return table;
+}
+
+}  // namespace
 
 Lexer::Lexer(std::string input) : input_(std::move(input)) {
     if (!input_.empty()) {
@@ -26,66 +159,6 @@ Lexer::Lexer(std::string input) : input_(std::move(input)) {
     }
 }
 
-/**
- * @brief Initialize SQL keywords map
- */
-std::map<std::string, TokenType> Lexer::init_keywords() {
-    return {{"SELECT", TokenType::Select},
-            {"FROM", TokenType::From},
-            {"WHERE", TokenType::Where},
-            {"INSERT", TokenType::Insert},
-            {"INTO", TokenType::Into},
-            {"VALUES", TokenType::Values},
-            {"DELETE", TokenType::Delete},
-            {"UPDATE", TokenType::Update},
-            {"SET", TokenType::Set},
-            {"CREATE", TokenType::Create},
-            {"TABLE", TokenType::Table},
-            {"INDEX", TokenType::Index},
-            {"DROP", TokenType::Drop},
-            {"AND", TokenType::And},
-            {"OR", TokenType::Or},
-            {"NOT", TokenType::Not},
-            {"IN", TokenType::In},
-            {"LIKE", TokenType::Like},
-            {"IS", TokenType::Is},
-            {"NULL", TokenType::Null},
-            {"TRUE", TokenType::True},
-            {"FALSE", TokenType::False},
-            {"JOIN", TokenType::Join},
-            {"ON", TokenType::On},
-            {"LEFT", TokenType::Left},
-            {"RIGHT", TokenType::Right},
-            {"INNER", TokenType::Inner},
-            {"OUTER", TokenType::Outer},
-            {"FULL", TokenType::Full},
-            {"GROUP", TokenType::Group},
-            {"BY", TokenType::By},
-            {"ORDER", TokenType::Order},
-            {"ASC", TokenType::Asc},
-            {"DESC", TokenType::Desc},
-            {"LIMIT", TokenType::Limit},
-            {"OFFSET", TokenType::Offset},
-            {"BEGIN", TokenType::Begin},
-            {"COMMIT", TokenType::Commit},
-            {"ROLLBACK", TokenType::Rollback},
-            {"IF", TokenType::If},
-            {"EXISTS", TokenType::Exists},
-            {"UNIQUE", TokenType::Unique},
-            {"INT", TokenType::TypeInt},
-            {"INTEGER", TokenType::TypeInt},
-            {"BIGINT", TokenType::TypeBigInt},
-            {"FLOAT", TokenType::TypeFloat},
-            {"DOUBLE", TokenType::TypeDouble},
-            {"TEXT", TokenType::TypeText},
-            {"VARCHAR", TokenType::TypeVarchar},
-            {"CHAR", TokenType::TypeChar},
-            {"BOOL", TokenType::TypeBool},
-            {"BOOLEAN", TokenType::TypeBool},
-            {"DISTINCT", TokenType::Distinct},
-            {"HAVING", TokenType::Having}};
-}
-
 Token Lexer::next_token() {
     while (true) {
         skip_whitespace();
@@ -166,20 +239,15 @@ Token Lexer::read_identifier() {
         advance();
     }
 
-    const std::string text = input_.substr(start, position_ - start);
-    std::string upper_text = text;
-    std::transform(upper_text.begin(), upper_text.end(), upper_text.begin(),
-                   [](unsigned char val) { return static_cast<char>(std::toupper(val)); });
-
-    auto it = keywords_.find(upper_text);
-    if (it != keywords_.end()) {
-        if (it->second == TokenType::True) {
-            return {it->second, true};
+    const std::string_view text(input_.data() + start, position_ - start);
+    if (const Keyword* keyword = keywords().find(text)) {
+        if (keyword->type == TokenType::True) {
+            return {keyword->type, true};
         }
-        if (it->second == TokenType::False) {
-            return {it->second, false};
+        if (keyword->type == TokenType::False) {
+            return {keyword->type, false};
         }
-        return {it->second, text};
+        return {keyword->type, text};
     }
 
     return {TokenType::Identifier, text};
@@ -199,33 +267,29 @@ Token Lexer::read_number() {
         advance();
     }
 
-    const std::string text = input_.substr(start, position_ - start);
-    if (is_float) {
-        try {
-            const double v = std::stod(text);
-            return {TokenType::Number, v};
-        } catch (...) {
-            static_cast<void>(0);
-            return {TokenType::Error, text};
-        }
-    } else {
-        try {
-            const int64_t v = std::stoll(text);
-            return {TokenType::Number, v};
-        } catch (...) {
-            /* If it overflows int64, try as double */
-            try {
-                const double v = std::stod(text);
-                return {TokenType::Number, v};
-            } catch (...) {
-                static_cast<void>(0);
-                return {TokenType::Error, text};
-            }
+    const std::string_view text(input_.data() + start, position_ - start);
+    const char* const first = text.data();
+    const char* const last = text.data() + text.size();
+    if (!is_float) {
+        int64_t v = 0;
+        const auto [end, ec] = std::from_chars(first, last, v);
+        if (ec == std::errc() && end == last) {
+            return {TokenType::Number, text, v};
         }
+        /* If it overflows int64, try as double */
+    }
+    try {
+        /* strtod needs a terminator, which the view lacks; numbers are short */
+        const double v = std::stod(std::string(text));
+        return {TokenType::Number, text, v};
+    } catch (...) {
+        static_cast<void>(0);
+        return {TokenType::Error, text};
     }
 }
 
 Token Lexer::read_string() {
+    const size_t quote = position_;
     advance(); /* Skip opening quote */
     const size_t start = position_;
 
@@ -234,12 +298,12 @@ Token Lexer::read_string() {
     }
 
     if (position_ >= input_.length()) {
-        return {TokenType::Error, input_.substr(start)};
+        return {TokenType::Error, std::string_view(input_).substr(start)};
     }
 
-    const std::string text = input_.substr(start, position_ - start);
+    const std::string_view text(input_.data() + start, position_ - start);
     advance(); /* Skip closing quote */
-    return {TokenType::String, text, true};
+    return {TokenType::String, std::string_view(input_.data() + quote, position_ - quote), text};
 }
 
 Token Lexer::read_operator() {
@@ -282,6 +346,15 @@ Token Lexer::read_operator() {
                 return {TokenType::Ge, ">="};
             }
             return {TokenType::Gt, ">"};
+        case '$': {
+            /* Placeholder of a prepared statement: $1, $2, ... */
+            const size_t start = position_ - 1;
+            while (position_ < input_.length() && std::isdigit(current_char_)) {
+                advance();
+            }
+            const std::string_view text(input_.data() + start, position_ - start);
+            return {text.size() > 1 ? TokenType::Param : TokenType::Error, text};
+        }
         case '!':
             if (current_char_ == '=') {
                 advance();
@@ -289,7 +362,7 @@ Token Lexer::read_operator() {
             }
             return {TokenType::Error, "!"};
         default:
-            return {TokenType::Error, std::string(1, c)};
+            return {TokenType::Error, std::string_view(input_.data() + position_ - 1, 1)};
     }
 }
 
@@ -10,9 +10,11 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -24,6 +26,20 @@
 
 namespace cloudsql::parser {
 
+namespace {
+
+/* The wire protocol counts parameters in 16 bits */
+constexpr uint32_t MAX_PARAMETERS = 65535;
+
+std::string upper(std::string_view view) {
+    std::string text(view);
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    return text;
+}
+
+}  // namespace
+
 /**
  * @brief Construct a new Parser
  */
@@ -73,6 +89,40 @@ std::unique_ptr<Statement> Parser::parse_statement() {
             static_cast<void>(next_token());
             stmt = std::make_unique<TransactionRollbackStatement>();
             break;
+        case TokenType::Copy:
+            stmt = parse_copy();
+            break;
+        case TokenType::Set:
+            stmt = parse_set();
+            break;
+        case TokenType::Analyze:
+            static_cast<void>(next_token());
+            if (peek_token().type() == TokenType::Identifier) {
+                stmt = std::make_unique<AnalyzeStatement>(std::string(next_token().lexeme()));
+            } else {
+                stmt = std::make_unique<AnalyzeStatement>();
+            }
+            break;
+        case TokenType::Vacuum:
+            static_cast<void>(next_token());
+            if (peek_token().type() == TokenType::Identifier) {
+                stmt = std::make_unique<VacuumStatement>(std::string(next_token().lexeme()));
+            } else {
+                stmt = std::make_unique<VacuumStatement>();
+            }
+            break;
+        case TokenType::Explain: {
+            static_cast<void>(next_token());
+            const bool analyze = consume(TokenType::Analyze);
+            if (peek_token().type() == TokenType::Explain) {
+                break;
+            }
+            auto inner = parse_statement();
+            if (inner) {
+                stmt = std::make_unique<ExplainStatement>(analyze, std::move(inner));
+            }
+            break;
+        }
         default:
             break;
     }
@@ -297,7 +347,7 @@ std::unique_ptr<Statement> Parser::parse_create_table() {
     if (name.type() != TokenType::Identifier) {
         return nullptr;
     }
-    stmt->set_table_name(name.lexeme());
+    stmt->set_table_name(std::string(name.lexeme()));
 
     if (!consume(TokenType::LParen)) {
         return nullptr;
@@ -316,7 +366,7 @@ std::unique_ptr<Statement> Parser::parse_create_table() {
         }
 
         const Token col_type = next_token();
-        std::string type_str = col_type.lexeme();
+        std::string type_str(col_type.lexeme());
 
         if (col_type.type() == TokenType::TypeVarchar) {
             if (consume(TokenType::LParen)) {
@@ -325,11 +375,11 @@ std::unique_ptr<Statement> Parser::parse_create_table() {
                     return nullptr;
                 }
                 static_cast<void>(consume(TokenType::RParen));
-                type_str += "(" + len.lexeme() + ")";
+                type_str += "(" + std::string(len.lexeme()) + ")";
             }
         }
 
-        stmt->add_column(col_name.lexeme(), type_str);
+        stmt->add_column(std::string(col_name.lexeme()), type_str);
 
         while (true) {
             const Token t = peek_token();
@@ -361,6 +411,37 @@ std::unique_ptr<Statement> Parser::parse_create_table() {
     if (!consume(TokenType::RParen)) {
         return nullptr;
     }
+
+    /* Storage options: WITH (COMPRESSION = lz4, DISTRIBUTION = REPLICATED,
+       COLUMNAR_REPLICA = ON) */
+    if (peek_token().type() == TokenType::Identifier && upper(peek_token().lexeme()) == "WITH") {
+        static_cast<void>(next_token());
+        if (!consume(TokenType::LParen)) {
+            return nullptr;
+        }
+        do {
+            const std::string option = upper(next_token().lexeme());
+            static_cast<void>(consume(TokenType::Eq));
+            const Token value = next_token();
+            const std::string text(value.type() == TokenType::String ? value.as_string()
+                                                                     : value.lexeme());
+            if (option == "COMPRESSION") {
+                stmt->set_compression(text);
+            } else if (option == "DISTRIBUTION" &&
+                       (upper(text) == "REPLICATED" || upper(text) == "SHARDED")) {
+                stmt->set_replicated(upper(text) == "REPLICATED");
+            } else if (option == "COLUMNAR_REPLICA" &&
+                       (upper(text) == "ON" || upper(text) == "OFF")) {
+                stmt->set_columnar_replica(upper(text) == "ON");
+            } else {
+                std::cerr << "Parser Error: Unknown table option " << option << "\n";
+                return nullptr;
+            }
+        } while (consume(TokenType::Comma));
+        if (!consume(TokenType::RParen)) {
+            return nullptr;
+        }
+    }
     return stmt;
 }
 
@@ -375,12 +456,17 @@ std::unique_ptr<Statement> Parser::parse_create_index() {
     if (!consume(TokenType::Index)) {
         return nullptr;
     }
+    if (peek_token().type() == TokenType::Identifier &&
+        upper(peek_token().lexeme()) == "CONCURRENTLY") {
+        static_cast<void>(next_token());
+        stmt->set_concurrently(true);
+    }
 
     const Token name = next_token();
     if (name.type() != TokenType::Identifier) {
         return nullptr;
     }
-    stmt->set_index_name(name.lexeme());
+    stmt->set_index_name(std::string(name.lexeme()));
 
     if (!consume(TokenType::On)) {
         return nullptr;
@@ -390,7 +476,13 @@ std::unique_ptr<Statement> Parser::parse_create_index() {
     if (table_name.type() != TokenType::Identifier) {
         return nullptr;
     }
-    stmt->set_table_name(table_name.lexeme());
+    stmt->set_table_name(std::string(table_name.lexeme()));
+
+    /* Access method: USING BTREE | HASH */
+    if (peek_token().type() == TokenType::Identifier && upper(peek_token().lexeme()) == "USING") {
+        static_cast<void>(next_token());
+        stmt->set_method(upper(next_token().lexeme()));
+    }
 
     if (!consume(TokenType::LParen)) {
         return nullptr;
@@ -407,7 +499,7 @@ std::unique_ptr<Statement> Parser::parse_create_index() {
         if (col_name.type() != TokenType::Identifier) {
             return nullptr;
         }
-        stmt->add_column(col_name.lexeme());
+        stmt->add_column(std::string(col_name.lexeme()));
 
         if (peek_token().type() == TokenType::RParen) {
             break;
@@ -436,7 +528,7 @@ std::unique_ptr<Statement> Parser::parse_insert() {
     if (table_tok.type() != TokenType::Identifier) {
         return nullptr;
     }
-    stmt->set_table(std::make_unique<ColumnExpr>(table_tok.lexeme()));
+    stmt->set_table(std::make_unique<ColumnExpr>(std::string(table_tok.lexeme())));
 
     if (consume(TokenType::LParen)) {
         bool first = true;
@@ -450,7 +542,7 @@ std::unique_ptr<Statement> Parser::parse_insert() {
             if (col_tok.type() != TokenType::Identifier) {
                 return nullptr;
             }
-            stmt->add_column(std::make_unique<ColumnExpr>(col_tok.lexeme()));
+            stmt->add_column(std::make_unique<ColumnExpr>(std::string(col_tok.lexeme())));
 
             if (peek_token().type() == TokenType::RParen) {
                 break;
@@ -518,7 +610,7 @@ std::unique_ptr<Statement> Parser::parse_update() {
     if (table_tok.type() != TokenType::Identifier) {
         return nullptr;
     }
-    stmt->set_table(std::make_unique<ColumnExpr>(table_tok.lexeme()));
+    stmt->set_table(std::make_unique<ColumnExpr>(std::string(table_tok.lexeme())));
 
     if (!consume(TokenType::Set)) {
         return nullptr;
@@ -545,7 +637,8 @@ std::unique_ptr<Statement> Parser::parse_update() {
             return nullptr;
         }
 
-        stmt->add_set(std::make_unique<ColumnExpr>(col_tok.lexeme()), std::move(val_expr));
+        stmt->add_set(std::make_unique<ColumnExpr>(std::string(col_tok.lexeme())),
+                      std::move(val_expr));
 
         if (peek_token().type() != TokenType::Comma) {
             break;
@@ -579,7 +672,7 @@ std::unique_ptr<Statement> Parser::parse_delete() {
     if (table_tok.type() != TokenType::Identifier) {
         return nullptr;
     }
-    stmt->set_table(std::make_unique<ColumnExpr>(table_tok.lexeme()));
+    stmt->set_table(std::make_unique<ColumnExpr>(std::string(table_tok.lexeme())));
 
     if (consume(TokenType::Where)) {
         auto where_expr = parse_expression();
@@ -669,8 +762,28 @@ std::unique_ptr<Expression> Parser::parse_compare() {  // NOLINT(misc-no-recursi
         return std::make_unique<IsNullExpr>(std::move(left), not_flag);
     }
 
-    /* Handle IN / NOT IN */
+    /* Handle IN / NOT IN and [NOT] BETWEEN */
     const bool not_flag = consume(TokenType::Not);
+    if (consume(TokenType::Between)) {
+        /* x BETWEEN a AND b is x >= a AND x <= b; the bounds bind tighter than AND */
+        auto low = parse_add_sub();
+        if (!low || !consume(TokenType::And)) {
+            return nullptr;
+        }
+        auto high = parse_add_sub();
+        if (!high) {
+            return nullptr;
+        }
+        auto column = left->clone();
+        std::unique_ptr<Expression> range = std::make_unique<BinaryExpr>(
+            std::make_unique<BinaryExpr>(std::move(left), TokenType::Ge, std::move(low)),
+            TokenType::And,
+            std::make_unique<BinaryExpr>(std::move(column), TokenType::Le, std::move(high)));
+        if (not_flag) {
+            return std::make_unique<UnaryExpr>(TokenType::Not, std::move(range));
+        }
+        return range;
+    }
     if (consume(TokenType::In)) {
         if (!consume(TokenType::LParen)) {
             return nullptr;
@@ -753,7 +866,7 @@ std::unique_ptr<Expression> Parser::parse_primary() {  // NOLINT(misc-no-recursi
 
     if (tok.type() == TokenType::Number) {
         static_cast<void>(next_token());
-        if (tok.lexeme().find('.') != std::string::npos) {
+        if (tok.lexeme().find('.') != std::string_view::npos) {
             return std::make_unique<ConstantExpr>(common::Value::make_float64(tok.as_double()));
         }
         return std::make_unique<ConstantExpr>(common::Value::make_int64(tok.as_int64()));
@@ -764,6 +877,20 @@ std::unique_ptr<Expression> Parser::parse_primary() {  // NOLINT(misc-no-recursi
         return std::make_unique<ConstantExpr>(common::Value::make_text(tok.as_string()));
     }
 
+    if (tok.type() == TokenType::Param) {
+        static_cast<void>(next_token());
+        const std::string digits(tok.lexeme().substr(1));
+        const auto index =
+            digits.size() > 5 ? 0 : static_cast<uint32_t>(std::stoul(digits));
+        if (index == 0 || index > MAX_PARAMETERS) {
+            return nullptr;
+        }
+        while (parameters_.size() < index) {
+            parameters_.push_back(std::make_shared<common::Value>());
+        }
+        return std::make_unique<ConstantExpr>(index, parameters_[index - 1]);
+    }
+
     if (tok.type() == TokenType::Star) {
         static_cast<void>(next_token());
         return std::make_unique<ColumnExpr>("*");
@@ -782,7 +909,7 @@ std::unique_ptr<Expression> Parser::parse_primary() {  // NOLINT(misc-no-recursi
             static_cast<void>(consume(TokenType::LParen));
 
             /* Normalize function name to uppercase for consistency */
-            std::string func_name = id.lexeme();
+            std::string func_name(id.lexeme());
             std::transform(func_name.begin(), func_name.end(), func_name.begin(),
                            [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
 
@@ -828,10 +955,11 @@ std::unique_ptr<Expression> Parser::parse_primary() {  // NOLINT(misc-no-recursi
                           << col_id.to_string() << "\n";
                 return nullptr;
             }
-            return std::make_unique<ColumnExpr>(id.lexeme(), col_id.lexeme());
+            return std::make_unique<ColumnExpr>(std::string(id.lexeme()),
+                                                std::string(col_id.lexeme()));
         }
 
-        return std::make_unique<ColumnExpr>(id.lexeme());
+        return std::make_unique<ColumnExpr>(std::string(id.lexeme()));
     }
 
     if (consume(TokenType::LParen)) {
@@ -870,7 +998,7 @@ std::unique_ptr<Statement> Parser::parse_drop() {
         if (name.type() != TokenType::Identifier) {
             return nullptr;
         }
-        return std::make_unique<DropTableStatement>(name.lexeme(), if_exists);
+        return std::make_unique<DropTableStatement>(std::string(name.lexeme()), if_exists);
     }
 
     if (peek_token().type() == TokenType::Index) {
@@ -886,12 +1014,115 @@ std::unique_ptr<Statement> Parser::parse_drop() {
         if (name.type() != TokenType::Identifier) {
             return nullptr;
         }
-        return std::make_unique<DropIndexStatement>(name.lexeme(), if_exists);
+        return std::make_unique<DropIndexStatement>(std::string(name.lexeme()), if_exists);
     }
 
     return nullptr;
 }
 
+/**
+ * @brief Parse COPY ... FROM STDIN
+ */
+std::unique_ptr<Statement> Parser::parse_copy() {
+    if (!consume(TokenType::Copy)) {
+        return nullptr;
+    }
+    const Token table = next_token();
+    if (table.type() != TokenType::Identifier || !consume(TokenType::From)) {
+        return nullptr;
+    }
+    const Token source = next_token();
+    if (source.type() != TokenType::Identifier || upper(source.lexeme()) != "STDIN") {
+        std::cerr << "Parser Error: COPY only reads FROM STDIN" << "\n";
+        return nullptr;
+    }
+
+    CopyOptions options;
+    bool delimiter_set = false;
+    if (peek_token().type() == TokenType::Identifier && upper(peek_token().lexeme()) == "WITH") {
+        static_cast<void>(next_token());
+    }
+    if (consume(TokenType::LParen)) {
+        do {
+            const std::string option = upper(next_token().lexeme());
+            if (option == "FORMAT") {
+                const std::string format = upper(next_token().lexeme());
+                if (format == "TEXT") {
+                    options.format = CopyFormat::Text;
+                } else if (format == "CSV") {
+                    options.format = CopyFormat::Csv;
+                } else if (format == "BINARY") {
+                    options.format = CopyFormat::Binary;
+                } else {
+                    std::cerr << "Parser Error: Unknown COPY format " << format << "\n";
+                    return nullptr;
+                }
+            } else if (option == "DELIMITER") {
+                const Token delimiter = next_token();
+                if (delimiter.type() != TokenType::String || delimiter.as_string().size() != 1) {
+                    std::cerr << "Parser Error: COPY delimiter must be one character" << "\n";
+                    return nullptr;
+                }
+                options.delimiter = delimiter.as_string()[0];
+                delimiter_set = true;
+            } else if (option == "HEADER") {
+                if (consume(TokenType::False)) {
+                    options.header = false;
+                } else {
+                    static_cast<void>(consume(TokenType::True));
+                    options.header = true;
+                }
+            } else {
+                std::cerr << "Parser Error: Unknown COPY option " << option << "\n";
+                return nullptr;
+            }
+        } while (consume(TokenType::Comma));
+        if (!consume(TokenType::RParen)) {
+            return nullptr;
+        }
+    }
+    if (options.format == CopyFormat::Csv && !delimiter_set) {
+        options.delimiter = ',';
+    }
+    return std::make_unique<CopyStatement>(std::string(table.lexeme()), options);
+}
+
+/**
+ * @brief Parse SET name { = | TO } value
+ */
+std::unique_ptr<Statement> Parser::parse_set() {
+    if (!consume(TokenType::Set)) {
+        return nullptr;
+    }
+    const Token name = next_token();
+    if (name.type() != TokenType::Identifier) {
+        return nullptr;
+    }
+    if (!consume(TokenType::Eq)) {
+        const Token to = next_token();
+        if (to.type() != TokenType::Identifier || upper(to.lexeme()) != "TO") {
+            return nullptr;
+        }
+    }
+    const Token value = next_token();
+    std::string text;
+    if (value.type() == TokenType::String) {
+        text = value.as_string();
+    } else if (value.type() == TokenType::Identifier || value.is_keyword()) {
+        /* Keywords such as ON and TRUE are names here */
+        text = value.lexeme();
+    } else if (value.type() == TokenType::Number) {
+        text = std::to_string(value.as_int64());
+    } else {
+        std::cerr << "Parser Error: SET needs a name, integer or string value" << "\n";
+        return nullptr;
+    }
+    std::string lowered(name.lexeme());
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return std::make_unique<SetStatement>(std::move(lowered), std::move(text));
+}
+
 /**
  * @brief Get next token from lexer
  */
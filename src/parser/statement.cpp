@@ -193,6 +193,19 @@ std::string CreateTableStatement::to_string() const {
     }
 
     result += ")";
+    std::string options;
+    if (!compression_.empty()) {
+        options += "COMPRESSION = " + compression_;
+    }
+    if (replicated_) {
+        options += std::string(options.empty() ? "" : ", ") + "DISTRIBUTION = REPLICATED";
+    }
+    if (columnar_replica_) {
+        options += std::string(options.empty() ? "" : ", ") + "COLUMNAR_REPLICA = ON";
+    }
+    if (!options.empty()) {
+        result += " WITH (" + options + ")";
+    }
     return result;
 }
 
@@ -5,39 +5,91 @@
 
 #include "recovery/log_manager.hpp"
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
-#include <cstring>
 #include <iostream>
 #include <iterator>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
+#include "common/metrics.hpp"
 #include "recovery/log_record.hpp"
+#include "storage/page.hpp"
 
 namespace cloudsql::recovery {
 
 namespace {
 constexpr std::chrono::milliseconds FLUSH_TIMEOUT(30);
+constexpr int LOG_FILE_MODE = 0644;
+constexpr unsigned CLAIM_RECORD_SHIFT = 32;
+constexpr uint64_t CLAIM_BYTES_MASK = (uint64_t{1} << CLAIM_RECORD_SHIFT) - 1;
+constexpr uint32_t LARGE_LINK = uint32_t{1} << 31; /* Link flag: record lives in Buffer::large */
+/* Spacing of offsets_ entries */
+constexpr uint64_t OFFSET_INTERVAL = storage::Page::DEFAULT_PAGE_SIZE;
+
+bool write_all(int fd, const char* data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t n = ::write(fd, data + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
 }  // anonymous namespace
 
-LogManager::LogManager(std::string log_file_path)
-    : log_file_path_(std::move(log_file_path)), log_buffer_(new char[log_buffer_size_]) {
-    // Open log file in binary append mode
-    log_stream_.open(log_file_path_, std::ios::binary | std::ios::app | std::ios::out);
-    if (!log_stream_.is_open()) {
+LogManager::LogManager(std::string log_file_path) : log_file_path_(std::move(log_file_path)) {
+    for (Buffer& buf : slots_) {
+        buf.data.resize(DEFAULT_BUFFER_SIZE);
+        buf.links = std::vector<std::atomic<uint32_t>>(BUFFER_RECORDS);
+        buf.large.resize(BUFFER_RECORDS);
+    }
+    metrics_ = common::MetricsRegistry::global().add_collector([this](common::MetricsSnapshot& out) {
+        const auto value = [](const std::atomic<uint64_t>& v) {
+            return static_cast<double>(v.load(std::memory_order_relaxed));
+        };
+        out.add_counter("cloudsql_wal_flushes_total", "WAL group flushes, one fdatasync each",
+                        value(stats_.flushes));
+        out.add_counter("cloudsql_wal_records_flushed_total", "Log records made durable",
+                        value(stats_.records_flushed));
+        out.add_counter("cloudsql_wal_bytes_flushed_total", "Log bytes made durable",
+                        value(stats_.bytes_flushed));
+        out.add_counter("cloudsql_wal_commits_waited_total", "Commits that waited on a flush",
+                        value(stats_.commits_waited));
+        out.add_counter("cloudsql_wal_appends_waited_total",
+                        "Appends stalled on a log buffer switch", value(stats_.appends_waited));
+        out.add_gauge("cloudsql_wal_persistent_lsn", "Newest durable log sequence number",
+                      static_cast<double>(persistent_lsn_.load(std::memory_order_relaxed)));
+        out.add_histogram("cloudsql_wal_fsync_latency_seconds",
+                          "Write plus fdatasync of one flush group", stats_.fsync_latency);
+    });
+    // Open log file for appending
+    log_fd_ = ::open(log_file_path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                     LOG_FILE_MODE);
+    if (log_fd_ < 0) {
         std::cerr << "Error: Could not open log file: " << log_file_path_ << "\n";
+        return;
     }
+    const off_t end = ::lseek(log_fd_, 0, SEEK_END);
+    log_end_ = end > 0 ? static_cast<uint64_t>(end) : 0;
 }
 
 LogManager::~LogManager() {
     stop_flush_thread();
-    if (log_stream_.is_open()) {
-        log_stream_.close();
+    if (log_fd_ >= 0) {
+        flush();
+        static_cast<void>(::close(log_fd_));
     }
-    delete[] log_buffer_;
 }
 
 void LogManager::run_flush_thread() {
@@ -55,61 +107,339 @@ void LogManager::stop_flush_thread() {
         return;
     }
 
-    enable_flushing_ = false;
-    stop_flush_thread_flag_ = true;
+    {
+        const std::scoped_lock<std::mutex> lock(latch_);
+        stop_flush_thread_flag_ = true;
+    }
     cv_.notify_one();
 
     if (flush_thread_.joinable()) {
         flush_thread_.join();
     }
+    {
+        /* Committers still waiting flush for themselves from here on */
+        const std::scoped_lock<std::mutex> lock(latch_);
+        enable_flushing_ = false;
+    }
+    durable_cv_.notify_all();
 }
 
 lsn_t LogManager::append_log_record(LogRecord& log_record) {
-    const std::unique_lock<std::mutex> lock(latch_);
-
-    // If record size > buffer size, flush first
     const uint32_t record_size = log_record.get_size();
-    if (log_buffer_offset_ + record_size > log_buffer_size_) {
-        flush_internal();
+    log_record.size_ = record_size; /* Serialized into the header */
+    const bool large = record_size >= LARGE_RECORD_SIZE;
+    const uint32_t bytes = large ? 0 : record_size;
+    const uint64_t claim = (uint64_t{1} << CLAIM_RECORD_SHIFT) | bytes;
+
+    while (true) {
+        const uint64_t gen = active_gen_.load(std::memory_order_acquire);
+        Buffer& buf = slots_[gen % slots_.size()];
+
+        // One step assigns the LSN and the bytes it is serialized into
+        const uint64_t before = buf.reserved.fetch_add(claim, std::memory_order_acq_rel);
+        const auto index = static_cast<uint32_t>(before >> CLAIM_RECORD_SHIFT);
+        const auto offset = static_cast<uint32_t>(before & CLAIM_BYTES_MASK);
+        if (index < BUFFER_RECORDS && offset + bytes <= DEFAULT_BUFFER_SIZE) {
+            const lsn_t lsn = buf.base_lsn.load(std::memory_order_relaxed) + index;
+            log_record.lsn_ = lsn;
+            if (large) {
+                buf.large[index].resize(record_size);
+                static_cast<void>(log_record.serialize(buf.large[index].data()));
+                buf.links[index].store(record_size | LARGE_LINK, std::memory_order_release);
+            } else {
+                static_cast<void>(log_record.serialize(buf.data.data() + offset));
+                buf.links[index].store(record_size, std::memory_order_release);
+            }
+            return lsn;
+        }
+
+        // Claims after the first that did not fit only wait for the switch it makes
+        stats_.appends_waited++;
+        std::unique_lock<std::mutex> lock(latch_);
+        if (index <= BUFFER_RECORDS && offset <= DEFAULT_BUFFER_SIZE) {
+            switch_buffer(lock, buf, index);
+        } else {
+            durable_cv_.wait(lock, [this, gen] { return active_gen_.load() > gen; });
+        }
     }
+}
+
+void LogManager::switch_buffer(std::unique_lock<std::mutex>& lock, Buffer& buf,
+                               uint32_t records) {
+    const uint64_t gen = buf.gen.load(std::memory_order_relaxed);
 
-    // Assign LSN
-    const lsn_t lsn = next_lsn_++;
-    log_record.lsn_ = lsn;
+    // The other buffer holds the previous generation until that is durable
+    Buffer& next = slots_[(gen + 1) % slots_.size()];
+    urgent_waiters_++;
+    cv_.notify_one();
+    while ((flush_gen_ < gen && !io_failed_) || flushing_) {
+        if (enable_flushing_) {
+            durable_cv_.wait(lock);
+        } else {
+            flush_step(lock);
+        }
+    }
+    urgent_waiters_--;
 
-    // Serialize to buffer
-    static_cast<void>(log_record.serialize(
-        std::next(log_buffer_, static_cast<std::ptrdiff_t>(log_buffer_offset_))));
-    log_buffer_offset_ += record_size;
+    /* Closed only now, so the flusher never retires a generation before the next is open */
+    buf.closed = true;
+    buf.valid_records = records;
+    for (uint32_t i = 0; i < next.valid_records; ++i) {
+        next.links[i].store(0, std::memory_order_relaxed);
+        next.large[i] = std::vector<char>();
+    }
+    next.closed = false;
+    next.valid_records = 0;
+    next.flushed_records = 0;
+    next.flushed_bytes = 0;
+    next.base_lsn.store(buf.base_lsn.load(std::memory_order_relaxed) + records,
+                        std::memory_order_relaxed);
+    next.gen.store(gen + 1, std::memory_order_relaxed);
+    next.reserved.store(0, std::memory_order_release);
+    active_gen_.store(gen + 1, std::memory_order_release);
+    durable_cv_.notify_all();
+}
 
-    return lsn;
+lsn_t LogManager::get_next_lsn() const {
+    while (true) {
+        const uint64_t gen = active_gen_.load(std::memory_order_acquire);
+        const Buffer& buf = slots_[gen % slots_.size()];
+        const lsn_t base = buf.base_lsn.load(std::memory_order_acquire);
+        const uint64_t claimed = buf.reserved.load(std::memory_order_acquire);
+        if (buf.gen.load(std::memory_order_acquire) == gen) {
+            const auto index = static_cast<uint32_t>(claimed >> CLAIM_RECORD_SHIFT);
+            const auto offset = static_cast<uint32_t>(claimed & CLAIM_BYTES_MASK);
+            if (index <= BUFFER_RECORDS && offset <= DEFAULT_BUFFER_SIZE) {
+                return base + index;
+            }
+        }
+        std::this_thread::yield(); /* The buffer is full and being switched */
+    }
 }
 
 void LogManager::flush(bool force) {
-    (void)force;
-    const std::unique_lock<std::mutex> lock(latch_);
-    flush_internal();
+    if (!wait_durable(get_next_lsn() - 1, force)) {
+        std::cerr << "Error: log flush failed: " << log_file_path_ << "\n";
+    }
+}
+
+bool LogManager::wait_durable(lsn_t lsn, bool force) {
+    std::unique_lock<std::mutex> lock(latch_);
+    bool waited = false;
+    while (persistent_lsn_.load() < lsn && !io_failed_) {
+        if (!enable_flushing_) {
+            flush_step(lock);
+            continue;
+        }
+        waited = true;
+        waiters_++;
+        urgent_waiters_ += force ? 1 : 0;
+        cv_.notify_one();
+        durable_cv_.wait(lock);
+        waiters_--;
+        urgent_waiters_ -= force ? 1 : 0;
+    }
+    if (waited) {
+        stats_.commits_waited++;
+    }
+    return persistent_lsn_.load() >= lsn;
+}
+
+void LogManager::set_next_lsn(lsn_t lsn) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    Buffer& buf = slots_[active_gen_.load() % slots_.size()];
+    if (buf.reserved.load() != 0 || buf.gen.load() != 0) {
+        std::cerr << "Error: next LSN set after records were appended: " << log_file_path_
+                  << "\n";
+        return;
+    }
+    buf.base_lsn.store(lsn);
+    persistent_lsn_ = lsn - 1;
+}
+
+bool LogManager::truncate(uint64_t size) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    if (log_fd_ < 0 || ::ftruncate(log_fd_, static_cast<off_t>(size)) != 0) {
+        std::cerr << "Error: Could not truncate log file: " << log_file_path_ << "\n";
+        return false;
+    }
+    log_end_ = size;
+    for (auto it = offsets_.begin(); it != offsets_.end();) {
+        it = it->second >= size ? offsets_.erase(it) : std::next(it);
+    }
+    return true;
 }
 
-void LogManager::flush_internal() {
-    if (log_buffer_offset_ > 0) {
-        log_stream_.write(log_buffer_, static_cast<std::streamsize>(log_buffer_offset_));
-        log_stream_.flush();
-        persistent_lsn_ = next_lsn_.load() - 1;
-        log_buffer_offset_ = 0;
+uint64_t LogManager::offset_before(lsn_t lsn) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    auto it = offsets_.upper_bound(lsn);
+    if (it == offsets_.begin()) {
+        return 0;
     }
+    return std::prev(it)->second;
+}
+
+void LogManager::mark_offset(lsn_t lsn, uint64_t offset) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    offsets_[lsn] = offset;
+}
+
+void LogManager::trim_offsets(lsn_t lsn) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    auto it = offsets_.upper_bound(lsn);
+    if (it != offsets_.begin()) {
+        offsets_.erase(offsets_.begin(), std::prev(it));
+    }
+}
+
+void LogManager::set_commit_delay(std::chrono::microseconds delay) {
+    {
+        const std::scoped_lock<std::mutex> lock(latch_);
+        commit_delay_ = delay;
+    }
+    cv_.notify_one();
+}
+
+void LogManager::set_group_size(size_t committers) {
+    {
+        const std::scoped_lock<std::mutex> lock(latch_);
+        group_size_ = committers;
+    }
+    cv_.notify_one();
+}
+
+bool LogManager::flush_ready() const {
+    const Buffer& buf = slots_[flush_gen_ % slots_.size()];
+    const uint32_t limit = buf.closed ? buf.valid_records : BUFFER_RECORDS;
+    if (buf.flushed_records < limit) {
+        return buf.links[buf.flushed_records].load(std::memory_order_acquire) != 0;
+    }
+    return buf.closed;
+}
+
+void LogManager::flush_step(std::unique_lock<std::mutex>& lock) {
+    if (flushing_) {
+        durable_cv_.wait(lock);
+    } else if (!flush_internal(lock)) {
+        /* An appender ahead of the waiter is still serializing its record */
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+    }
+}
+
+bool LogManager::flush_internal(std::unique_lock<std::mutex>& lock) {
+    if (flushing_ || io_failed_) {
+        return false;
+    }
+
+    // Collect the highest contiguous run of filled records
+    Buffer& buf = slots_[flush_gen_ % slots_.size()];
+    const uint32_t limit = buf.closed ? buf.valid_records : BUFFER_RECORDS;
+    uint32_t end = buf.flushed_records;
+    uint32_t end_bytes = buf.flushed_bytes;
+    uint64_t bytes = 0;
+    pieces_.clear();
+    while (end < limit) {
+        const uint32_t link = buf.links[end].load(std::memory_order_acquire);
+        if (link == 0) {
+            break;
+        }
+        if ((link & LARGE_LINK) != 0) {
+            pieces_.emplace_back(buf.large[end].data(), buf.large[end].size());
+        } else if (!pieces_.empty() &&
+                   pieces_.back().first + pieces_.back().second == buf.data.data() + end_bytes) {
+            pieces_.back().second += link;
+            end_bytes += link;
+        } else {
+            pieces_.emplace_back(buf.data.data() + end_bytes, link);
+            end_bytes += link;
+        }
+        bytes += link & ~LARGE_LINK;
+        end++;
+    }
+
+    const uint32_t records = end - buf.flushed_records;
+    if (records == 0) {
+        if (!buf.closed || end != buf.valid_records) {
+            return false;
+        }
+        flush_gen_++; /* Closed and fully written: free for the generation after next */
+        durable_cv_.notify_all();
+        return true;
+    }
+    const lsn_t base_lsn = buf.base_lsn.load(std::memory_order_relaxed);
+    const lsn_t group_lsn = base_lsn + end - 1;
+    const size_t committers = waiters_;
+    if (offsets_.empty() || log_end_ >= offsets_.rbegin()->second + OFFSET_INTERVAL) {
+        offsets_.emplace(base_lsn + buf.flushed_records, log_end_);
+    }
+    flushing_ = true;
+    lock.unlock();
+
+    const auto start = std::chrono::steady_clock::now();
+    bool synced = log_fd_ >= 0;
+    for (const auto& [data, size] : pieces_) {
+        synced = synced && write_all(log_fd_, data, size);
+    }
+    synced = synced && ::fdatasync(log_fd_) == 0;
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    lock.lock();
+    flushing_ = false;
+    if (synced) {
+        buf.flushed_records = end;
+        buf.flushed_bytes = end_bytes;
+        log_end_ += bytes;
+        if (buf.closed && end == buf.valid_records) {
+            flush_gen_++;
+        }
+        persistent_lsn_ = group_lsn;
+        stats_.flushes++;
+        stats_.records_flushed += records;
+        stats_.bytes_flushed += bytes;
+        stats_.fsync_latency.record(elapsed);
+        stats_.group_records.record(records);
+        if (committers > 0) {
+            stats_.group_commits.record(committers);
+        }
+    } else {
+        /* The records' fate on disk is unknown: no later commit may claim durability */
+        io_failed_ = true;
+        std::cerr << "Error: WAL write or fdatasync FAILED: " << log_file_path_ << "\n";
+    }
+    durable_cv_.notify_all();
+    return synced;
 }
 
 void LogManager::flush_thread_loop() {
-    while (!stop_flush_thread_flag_) {
-        std::unique_lock<std::mutex> lock(latch_);
+    std::unique_lock<std::mutex> lock(latch_);
+    while (true) {
         static_cast<void>(cv_.wait_for(lock, FLUSH_TIMEOUT, [this] {
-            return stop_flush_thread_flag_.load() || log_buffer_offset_ > 0;
+            return stop_flush_thread_flag_.load() || waiters_ > 0 || urgent_waiters_ > 0;
         }));
+        if (!flush_ready() || io_failed_) {
+            if (stop_flush_thread_flag_) {
+                break;
+            }
+            if (waiters_ > 0 || urgent_waiters_ > 0) {
+                /* Wait out an appender still serializing ahead of the waiters */
+                lock.unlock();
+                std::this_thread::yield();
+                lock.lock();
+            }
+            continue;
+        }
 
-        if (log_buffer_offset_ > 0) {
-            flush_internal();
+        // Hold the group open for more committers, unless enough are waiting already
+        if (waiters_ > 0 && waiters_ < group_size_ && urgent_waiters_ == 0 &&
+            commit_delay_.count() > 0 && !stop_flush_thread_flag_) {
+            static_cast<void>(cv_.wait_for(lock, commit_delay_, [this] {
+                return stop_flush_thread_flag_.load() || urgent_waiters_ > 0 ||
+                       waiters_ >= group_size_;
+            }));
         }
+        static_cast<void>(flush_internal(lock));
     }
 }
 
@@ -10,10 +10,13 @@
 #include <cstring>
 #include <iterator>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #include "common/value.hpp"
+#include "executor/types.hpp"
+#include "storage/buffer_pool_manager.hpp"
 #include "storage/heap_table.hpp"
 
 namespace cloudsql::recovery {
@@ -78,11 +81,11 @@ void serialize_value(const common::Value& val, char*& ptr) {
         case common::ValueType::TYPE_TEXT:
         case common::ValueType::TYPE_VARCHAR:
         case common::ValueType::TYPE_CHAR: {
-            const std::string& s = val.as_text();
+            const std::string_view s = val.text_view();
             const auto len = static_cast<uint32_t>(s.length());
             std::memcpy(ptr, &len, sizeof(uint32_t));
             ptr = std::next(ptr, static_cast<std::ptrdiff_t>(sizeof(uint32_t)));
-            std::memcpy(ptr, s.c_str(), len);
+            std::memcpy(ptr, s.data(), len);
             ptr = std::next(ptr, static_cast<std::ptrdiff_t>(len));
             break;
         }
@@ -192,12 +195,70 @@ uint32_t get_value_size(const common::Value& val) {
         case common::ValueType::TYPE_VARCHAR:
         case common::ValueType::TYPE_CHAR:
             return size + static_cast<uint32_t>(sizeof(uint32_t)) +
-                   static_cast<uint32_t>(val.as_text().length());
+                   static_cast<uint32_t>(val.text_view().length());
         default:
             return size;
     }
 }
 
+void serialize_tuple(const executor::Tuple& tuple, char*& ptr) {
+    const auto count = static_cast<uint32_t>(tuple.size());
+    std::memcpy(ptr, &count, sizeof(uint32_t));
+    ptr = std::next(ptr, static_cast<std::ptrdiff_t>(sizeof(uint32_t)));
+    for (size_t i = 0; i < count; ++i) {
+        serialize_value(tuple.get(i), ptr);
+    }
+}
+
+executor::Tuple deserialize_tuple(const char*& ptr) {
+    uint32_t count = 0;
+    std::memcpy(&count, ptr, sizeof(uint32_t));
+    ptr = std::next(ptr, static_cast<std::ptrdiff_t>(sizeof(uint32_t)));
+    std::vector<common::Value> values;
+    values.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        values.push_back(deserialize_value(ptr));
+    }
+    return executor::Tuple(std::move(values));
+}
+
+uint32_t get_tuple_size(const executor::Tuple& tuple) {
+    auto s = static_cast<uint32_t>(sizeof(uint32_t));
+    for (size_t i = 0; i < tuple.size(); ++i) {
+        s += get_value_size(tuple.get(i));
+    }
+    return s;
+}
+
+template <typename T>
+void put(char*& ptr, const T& value) {
+    std::memcpy(ptr, &value, sizeof(T));
+    ptr = std::next(ptr, static_cast<std::ptrdiff_t>(sizeof(T)));
+}
+
+template <typename T>
+void take(const char*& ptr, T& value) {
+    std::memcpy(&value, ptr, sizeof(T));
+    ptr = std::next(ptr, static_cast<std::ptrdiff_t>(sizeof(T)));
+}
+
+void put_string(char*& ptr, const std::string& s) {
+    put(ptr, static_cast<uint32_t>(s.length()));
+    std::memcpy(ptr, s.data(), s.length());
+    ptr = std::next(ptr, static_cast<std::ptrdiff_t>(s.length()));
+}
+
+std::string take_string(const char*& ptr) {
+    uint32_t len = 0;
+    take(ptr, len);
+    std::string s(ptr, len);
+    ptr = std::next(ptr, static_cast<std::ptrdiff_t>(len));
+    return s;
+}
+
+/* CHECKPOINT_END entries: txn_id, first_lsn, last_lsn, prepared */
+constexpr uint32_t CHECKPOINT_TXN_SIZE = sizeof(txn_id_t) + (sizeof(lsn_t) * 2) + sizeof(uint8_t);
+
 }  // anonymous namespace
 
 uint32_t LogRecord::serialize(char* buffer) const {
@@ -265,6 +326,44 @@ uint32_t LogRecord::serialize(char* buffer) const {
     } else if (type_ == LogRecordType::NEW_PAGE) {
         std::memcpy(buffer, &page_id_, sizeof(uint32_t));
         buffer = std::next(buffer, static_cast<std::ptrdiff_t>(sizeof(uint32_t)));
+    } else if (type_ == LogRecordType::INSERT_BATCH) {
+        const auto name_len = static_cast<uint32_t>(table_name_.length());
+        std::memcpy(buffer, &name_len, sizeof(uint32_t));
+        buffer = std::next(buffer, static_cast<std::ptrdiff_t>(sizeof(uint32_t)));
+        std::memcpy(buffer, table_name_.c_str(), name_len);
+        buffer = std::next(buffer, static_cast<std::ptrdiff_t>(name_len));
+
+        const auto count = static_cast<uint32_t>(tuples_.size());
+        std::memcpy(buffer, &count, sizeof(uint32_t));
+        buffer = std::next(buffer, static_cast<std::ptrdiff_t>(sizeof(uint32_t)));
+        for (uint32_t i = 0; i < count; ++i) {
+            std::memcpy(buffer, &rids_[i], sizeof(storage::HeapTable::TupleId));
+            buffer = std::next(buffer,
+                               static_cast<std::ptrdiff_t>(sizeof(storage::HeapTable::TupleId)));
+            serialize_tuple(tuples_[i], buffer);
+        }
+    } else if (type_ == LogRecordType::CLR) {
+        put_string(buffer, table_name_);
+        put(buffer, undone_type_);
+        put(buffer, undo_next_lsn_);
+        put(buffer, static_cast<uint32_t>(rids_.size()));
+        for (const auto& rid : rids_) {
+            put(buffer, rid);
+        }
+    } else if (type_ == LogRecordType::CHECKPOINT_END) {
+        put(buffer, static_cast<uint32_t>(checkpoint_txns_.size()));
+        for (const auto& txn : checkpoint_txns_) {
+            put(buffer, txn.txn_id);
+            put(buffer, txn.first_lsn);
+            put(buffer, txn.last_lsn);
+            put(buffer, static_cast<uint8_t>(txn.prepared ? 1 : 0));
+        }
+        put(buffer, static_cast<uint32_t>(checkpoint_pages_.size()));
+        for (const auto& page : checkpoint_pages_) {
+            put_string(buffer, page.file_name);
+            put(buffer, page.page_id);
+            put(buffer, page.rec_lsn);
+        }
     }
 
     return static_cast<uint32_t>(buffer - start);
@@ -346,6 +445,53 @@ LogRecord LogRecord::deserialize(const char* buffer) {
         }
     } else if (record.type_ == LogRecordType::NEW_PAGE) {
         std::memcpy(&record.page_id_, ptr, sizeof(uint32_t));
+    } else if (record.type_ == LogRecordType::INSERT_BATCH) {
+        auto name_len = uint32_t{0};
+        std::memcpy(&name_len, ptr, sizeof(uint32_t));
+        ptr = std::next(ptr, static_cast<std::ptrdiff_t>(sizeof(uint32_t)));
+        record.table_name_ = std::string(ptr, name_len);
+        ptr = std::next(ptr, static_cast<std::ptrdiff_t>(name_len));
+
+        uint32_t count = 0;
+        std::memcpy(&count, ptr, sizeof(uint32_t));
+        ptr = std::next(ptr, static_cast<std::ptrdiff_t>(sizeof(uint32_t)));
+        record.rids_.resize(count);
+        record.tuples_.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            std::memcpy(&record.rids_[i], ptr, sizeof(storage::HeapTable::TupleId));
+            ptr = std::next(ptr, static_cast<std::ptrdiff_t>(sizeof(storage::HeapTable::TupleId)));
+            record.tuples_.push_back(deserialize_tuple(ptr));
+        }
+    } else if (record.type_ == LogRecordType::CLR) {
+        record.table_name_ = take_string(ptr);
+        take(ptr, record.undone_type_);
+        take(ptr, record.undo_next_lsn_);
+        uint32_t count = 0;
+        take(ptr, count);
+        record.rids_.resize(count);
+        for (auto& rid : record.rids_) {
+            take(ptr, rid);
+        }
+    } else if (record.type_ == LogRecordType::CHECKPOINT_END) {
+        uint32_t txns = 0;
+        take(ptr, txns);
+        record.checkpoint_txns_.resize(txns);
+        for (auto& txn : record.checkpoint_txns_) {
+            take(ptr, txn.txn_id);
+            take(ptr, txn.first_lsn);
+            take(ptr, txn.last_lsn);
+            uint8_t prepared = 0;
+            take(ptr, prepared);
+            txn.prepared = prepared != 0;
+        }
+        uint32_t pages = 0;
+        take(ptr, pages);
+        record.checkpoint_pages_.resize(pages);
+        for (auto& page : record.checkpoint_pages_) {
+            page.file_name = take_string(ptr);
+            take(ptr, page.page_id);
+            take(ptr, page.rec_lsn);
+        }
     }
 
     return record;
@@ -388,6 +534,25 @@ uint32_t LogRecord::get_size() const {
         }
     } else if (type_ == LogRecordType::NEW_PAGE) {
         s += static_cast<uint32_t>(sizeof(uint32_t));
+    } else if (type_ == LogRecordType::INSERT_BATCH) {
+        s += static_cast<uint32_t>(sizeof(uint32_t)) + static_cast<uint32_t>(table_name_.length());
+        s += static_cast<uint32_t>(sizeof(uint32_t));
+        for (const auto& tuple : tuples_) {
+            s += static_cast<uint32_t>(sizeof(storage::HeapTable::TupleId)) +
+                 get_tuple_size(tuple);
+        }
+    } else if (type_ == LogRecordType::CLR) {
+        s += static_cast<uint32_t>(sizeof(uint32_t)) + static_cast<uint32_t>(table_name_.length());
+        s += static_cast<uint32_t>(sizeof(LogRecordType) + sizeof(lsn_t) + sizeof(uint32_t));
+        s += static_cast<uint32_t>(rids_.size() * sizeof(storage::HeapTable::TupleId));
+    } else if (type_ == LogRecordType::CHECKPOINT_END) {
+        s += static_cast<uint32_t>(sizeof(uint32_t)) +
+             (static_cast<uint32_t>(checkpoint_txns_.size()) * CHECKPOINT_TXN_SIZE);
+        s += static_cast<uint32_t>(sizeof(uint32_t));
+        for (const auto& page : checkpoint_pages_) {
+            s += static_cast<uint32_t>(sizeof(uint32_t) + page.file_name.length() +
+                                       sizeof(uint32_t) + sizeof(int32_t));
+        }
     }
 
     return s;
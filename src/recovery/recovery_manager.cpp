@@ -5,40 +5,556 @@
 
 #include "recovery/recovery_manager.hpp"
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "catalog/catalog.hpp"
+#include "executor/types.hpp"
+#include "recovery/log_manager.hpp"
+#include "recovery/log_record.hpp"
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/heap_table.hpp"
 
 namespace cloudsql::recovery {
 
+namespace {
+
+constexpr int MASTER_FILE_MODE = 0644;
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t elapsed_us(Clock::time_point start) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+}
+
+/* Run `task(worker)` on `workers` threads and wait for them all */
+void run_workers(size_t workers, const std::function<void(size_t)>& task) {
+    if (workers <= 1) {
+        task(0);
+        return;
+    }
+    std::vector<std::thread> threads;
+    threads.reserve(workers);
+    for (size_t i = 0; i < workers; ++i) {
+        threads.emplace_back(task, i);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+/* Records that change a heap page, and so take part in redo */
+bool changes_page(const LogRecord& record) {
+    switch (record.type_) {
+        case LogRecordType::INSERT:
+        case LogRecordType::MARK_DELETE:
+            return true;
+        case LogRecordType::INSERT_BATCH:
+        case LogRecordType::CLR:
+            return !record.rids_.empty();
+        default:
+            return false;
+    }
+}
+
+/* The one heap page a page-changing record touches */
+uint32_t page_of(const LogRecord& record) {
+    return record.rids_.empty() ? record.rid_.page_num : record.rids_.front().page_num;
+}
+
+/* Heap tables a worker has opened, by name; nullptr for tables the catalog lacks */
+class TableCache {
+   public:
+    TableCache(storage::BufferPoolManager& bpm, Catalog& catalog) : bpm_(bpm), catalog_(catalog) {}
+
+    storage::HeapTable* get(const std::string& name) {
+        const auto it = tables_.find(name);
+        if (it != tables_.end()) {
+            return it->second.get();
+        }
+        std::unique_ptr<storage::HeapTable> table;
+        const auto meta = catalog_.get_table_by_name(name);
+        if (meta.has_value()) {
+            executor::Schema schema;
+            for (const auto& col : meta.value()->columns) {
+                schema.add_column(col.name, col.type);
+            }
+            table = std::make_unique<storage::HeapTable>(name, bpm_, std::move(schema));
+        }
+        return tables_.emplace(name, std::move(table)).first->second.get();
+    }
+
+   private:
+    storage::BufferPoolManager& bpm_;
+    Catalog& catalog_;
+    std::unordered_map<std::string, std::unique_ptr<storage::HeapTable>> tables_;
+};
+
+}  // anonymous namespace
+
+RecoveryManager::RecoveryManager(storage::BufferPoolManager& bpm, Catalog& catalog,
+                                 LogManager& log_manager, size_t threads)
+    : bpm_(bpm),
+      catalog_(catalog),
+      log_manager_(log_manager),
+      threads_(threads != 0 ? threads : std::max(1U, std::thread::hardware_concurrency())) {}
+
+std::string RecoveryManager::master_path() const {
+    return log_manager_.log_file_path() + ".ckpt";
+}
+
+bool RecoveryManager::read_master(Master& out) const {
+    std::ifstream file(master_path());
+    if (!file.is_open()) {
+        return false;
+    }
+    Master master;
+    if (!(file >> master.begin_lsn >> master.scan_offset)) {
+        std::cerr << "Error: unreadable checkpoint master file: " << master_path() << "\n";
+        return false;
+    }
+    out = master;
+    return true;
+}
+
+bool RecoveryManager::write_master(const Master& master) const {
+    /* Written aside and renamed over, so a crash leaves the old or the new one whole */
+    const std::string path = master_path();
+    const std::string tmp = path + ".tmp";
+    std::ostringstream text;
+    text << master.begin_lsn << " " << master.scan_offset << "\n";
+    const std::string data = text.str();
+
+    const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, MASTER_FILE_MODE);
+    if (fd < 0) {
+        std::cerr << "Error: Could not write checkpoint master file: " << tmp << "\n";
+        return false;
+    }
+    const bool written = ::write(fd, data.data(), data.size()) ==
+                             static_cast<ssize_t>(data.size()) &&
+                         ::fsync(fd) == 0;
+    static_cast<void>(::close(fd));
+    if (!written || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cerr << "Error: Could not write checkpoint master file: " << path << "\n";
+        static_cast<void>(std::remove(tmp.c_str()));
+        return false;
+    }
+    return true;
+}
+
+size_t RecoveryManager::workers_for(size_t tasks) const {
+    return std::max<size_t>(1, std::min(threads_, tasks));
+}
+
 bool RecoveryManager::recover() {
-    active_txns_.clear();
-    max_lsn_ = 0;
+    records_.clear();
+    by_lsn_.clear();
+    att_.clear();
+    dpt_.clear();
+    in_doubt_.clear();
+    max_txn_id_ = 0;
+    max_lsn_ = INVALID_LSN;
+    stats_ = Stats{};
 
     std::cout << "[Recovery] Starting Crash Recovery...\n";
+    Master master;
+    const bool have_master = read_master(master);
+    if (have_master) {
+        std::cout << "[Recovery] Last checkpoint at LSN " << master.begin_lsn << "\n";
+    }
+    if (!load(have_master ? master.scan_offset : 0)) {
+        return false;
+    }
     analyze();
+    log_manager_.set_next_lsn(max_lsn_ + 1);
     redo();
     undo();
-    std::cout << "[Recovery] Crash Recovery Complete.\n";
 
+    /* Everything recovered reaches disk, so the next recovery can start past it */
+    log_manager_.flush(true);
+    bpm_.flush_all_pages();
+    if (!checkpoint([this] { return in_doubt_; })) {
+        return false;
+    }
+    std::cout << "[Recovery] Crash Recovery Complete: " << stats_.records_scanned
+              << " records from LSN " << stats_.scan_lsn << ", " << stats_.redo_applied
+              << " redone, " << stats_.redo_skipped << " already applied, " << stats_.losers
+              << " rolled back, " << stats_.in_doubt << " in doubt\n";
+    return true;
+}
+
+std::vector<LogRecord> RecoveryManager::changes_of(txn_id_t txn_id) const {
+    const auto txn = std::find_if(in_doubt_.begin(), in_doubt_.end(),
+                                  [txn_id](const CheckpointTxn& t) { return t.txn_id == txn_id; });
+    if (txn == in_doubt_.end()) {
+        return {};
+    }
+    /* The scan starts at or before its BEGIN, so the whole chain is loaded */
+    std::vector<LogRecord> changes;
+    lsn_t lsn = txn->last_lsn;
+    for (auto it = by_lsn_.find(lsn); it != by_lsn_.end(); it = by_lsn_.find(lsn)) {
+        const LogRecord& record = records_[it->second];
+        if (record.type_ == LogRecordType::CLR) {
+            lsn = record.undo_next_lsn_;
+            continue;
+        }
+        if (changes_page(record)) {
+            changes.push_back(record);
+        }
+        lsn = record.prev_lsn_;
+    }
+    std::reverse(changes.begin(), changes.end());
+    return changes;
+}
+
+bool RecoveryManager::load(uint64_t offset) {
+    std::ifstream file(log_manager_.log_file_path(), std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return true; /* No log yet */
+    }
+    const auto file_size = static_cast<uint64_t>(file.tellg());
+    if (offset > file_size) {
+        std::cerr << "Error: checkpoint offset " << offset << " past the end of the log, "
+                  << "reading it all\n";
+        offset = 0;
+    }
+    std::vector<char> data(file_size - offset);
+    file.seekg(static_cast<std::streamoff>(offset));
+    if (!file.read(data.data(), static_cast<std::streamsize>(data.size()))) {
+        std::cerr << "Error: Could not read log file: " << log_manager_.log_file_path() << "\n";
+        return false;
+    }
+
+    size_t pos = 0;
+    while (data.size() - pos >= LogRecord::HEADER_SIZE) {
+        uint32_t size = 0;
+        std::memcpy(&size, std::next(data.data(), static_cast<std::ptrdiff_t>(pos)),
+                    sizeof(uint32_t));
+        if (size < LogRecord::HEADER_SIZE || size > data.size() - pos) {
+            break;
+        }
+        LogRecord record =
+            LogRecord::deserialize(std::next(data.data(), static_cast<std::ptrdiff_t>(pos)));
+        if (record.lsn_ <= max_lsn_) {
+            break; /* Stale bytes past the real end */
+        }
+        if (records_.empty()) {
+            log_manager_.mark_offset(record.lsn_, offset + pos);
+        }
+        max_lsn_ = record.lsn_;
+        by_lsn_.emplace(record.lsn_, records_.size());
+        records_.push_back(std::move(record));
+        pos += size;
+    }
+
+    stats_.records_scanned = records_.size();
+    stats_.scan_lsn = records_.empty() ? INVALID_LSN : records_.front().lsn_;
+    if (pos < data.size()) {
+        /* Later appends must not land behind bytes the next recovery would stop at */
+        stats_.bytes_ignored = data.size() - pos;
+        std::cerr << "--- [Recovery] Dropping " << stats_.bytes_ignored
+                  << " torn bytes at the end of the log ---" << std::endl;
+        if (!log_manager_.truncate(offset + pos)) {
+            return false;
+        }
+    }
     return true;
 }
 
 void RecoveryManager::analyze() {
     std::cout << "[Recovery] Analysis phase...\n";
-    // Real implementation would read log records from disk.
-    // stubs to avoid static warnings
-    static_cast<void>(bpm_);
-    static_cast<void>(catalog_);
-    static_cast<void>(log_manager_);
+    const auto start = Clock::now();
+    std::unordered_set<txn_id_t> ended;
+
+    for (const LogRecord& record : records_) {
+        max_txn_id_ = std::max(max_txn_id_, record.txn_id_);
+        switch (record.type_) {
+            case LogRecordType::CHECKPOINT_BEGIN:
+                continue;
+            case LogRecordType::CHECKPOINT_END:
+                /* Fill in what the scan started too late to see */
+                for (const CheckpointTxn& txn : record.checkpoint_txns_) {
+                    max_txn_id_ = std::max(max_txn_id_, txn.txn_id);
+                    if (ended.count(txn.txn_id) == 0) {
+                        att_.emplace(txn.txn_id, txn);
+                    }
+                }
+                for (const auto& page : record.checkpoint_pages_) {
+                    const std::string& file = page.file_name;
+                    const std::string ext = storage::HeapTable::FILE_EXTENSION;
+                    if (file.size() > ext.size() &&
+                        file.compare(file.size() - ext.size(), ext.size(), ext) == 0) {
+                        const std::string table = file.substr(0, file.size() - ext.size());
+                        dpt_.emplace(PageKey{table, page.page_id}, page.rec_lsn);
+                    }
+                }
+                continue;
+            case LogRecordType::COMMIT:
+            case LogRecordType::ABORT:
+                /* ABORT follows a complete rollback, so it ends the transaction too */
+                att_.erase(record.txn_id_);
+                ended.insert(record.txn_id_);
+                continue;
+            default:
+                break;
+        }
+
+        auto [it, added] = att_.try_emplace(record.txn_id_);
+        CheckpointTxn& txn = it->second;
+        if (added) {
+            txn.txn_id = record.txn_id_;
+            txn.first_lsn = record.lsn_;
+        }
+        txn.last_lsn = record.lsn_;
+        txn.prepared = txn.prepared || record.type_ == LogRecordType::PREPARE;
+
+        if (changes_page(record)) {
+            dpt_.emplace(PageKey{record.table_name_, page_of(record)}, record.lsn_);
+        }
+    }
+
+    stats_.dirty_pages = dpt_.size();
+    stats_.analysis_us = elapsed_us(start);
+    std::cout << "[Recovery] Analysis: " << att_.size() << " active transactions, "
+              << dpt_.size() << " dirty pages\n";
 }
 
 void RecoveryManager::redo() {
     std::cout << "[Recovery] Redo phase...\n";
-    static_cast<void>(bpm_);
+    const auto start = Clock::now();
+
+    /* Each page goes to one worker, which replays that page's records in log order */
+    const size_t workers = workers_for(dpt_.size());
+    std::vector<std::vector<size_t>> work(workers);
+    const std::hash<std::string> hash_name;
+    lsn_t redo_lsn = INVALID_LSN;
+    for (const auto& [key, rec_lsn] : dpt_) {
+        redo_lsn = redo_lsn == INVALID_LSN ? rec_lsn : std::min(redo_lsn, rec_lsn);
+    }
+    for (size_t i = 0; i < records_.size(); ++i) {
+        const LogRecord& record = records_[i];
+        if (record.lsn_ < redo_lsn || !changes_page(record)) {
+            continue;
+        }
+        const PageKey key{record.table_name_, page_of(record)};
+        const auto it = dpt_.find(key);
+        if (it == dpt_.end() || record.lsn_ < it->second) {
+            continue; /* The page was on disk with this change already */
+        }
+        work[((hash_name(key.first) * 31) + key.second) % workers].push_back(i);
+    }
+
+    std::vector<Stats> counts(workers);
+    run_workers(workers, [&](size_t worker) {
+        TableCache tables(bpm_, catalog_);
+        Stats& count = counts[worker];
+        for (const size_t i : work[worker]) {
+            const LogRecord& record = records_[i];
+            storage::HeapTable* const table = tables.get(record.table_name_);
+            if (table == nullptr) {
+                count.unknown_tables++;
+                continue;
+            }
+            const uint32_t page = page_of(record);
+            if (table->page_lsn(page) >= record.lsn_) {
+                count.redo_skipped++;
+                continue;
+            }
+            /* Every action checks the slot's state, so pages without a page LSN redo safely */
+            switch (record.type_) {
+                case LogRecordType::INSERT:
+                    static_cast<void>(table->insert_at(record.rid_, record.tuple_, record.txn_id_));
+                    break;
+                case LogRecordType::INSERT_BATCH:
+                    for (size_t r = 0; r < record.rids_.size(); ++r) {
+                        static_cast<void>(
+                            table->insert_at(record.rids_[r], record.tuples_[r], record.txn_id_));
+                    }
+                    break;
+                case LogRecordType::MARK_DELETE:
+                    static_cast<void>(table->remove(record.rid_, record.txn_id_));
+                    break;
+                case LogRecordType::CLR:
+                    for (const auto& rid : record.rids_) {
+                        if (record.undone_type_ == LogRecordType::MARK_DELETE) {
+                            static_cast<void>(table->undo_remove(rid));
+                        } else {
+                            static_cast<void>(table->physical_remove(rid));
+                        }
+                    }
+                    break;
+                default:
+                    break;
+            }
+            static_cast<void>(table->set_page_lsn(page, record.lsn_));
+            count.redo_applied++;
+        }
+    });
+
+    for (const Stats& count : counts) {
+        stats_.redo_applied += count.redo_applied;
+        stats_.redo_skipped += count.redo_skipped;
+        stats_.unknown_tables += count.unknown_tables;
+    }
+    stats_.redo_lsn = redo_lsn;
+    stats_.redo_us = elapsed_us(start);
+    std::cout << "[Recovery] Redo from LSN " << redo_lsn << ": " << stats_.redo_applied
+              << " applied, " << stats_.redo_skipped << " skipped, " << workers << " workers\n";
 }
 
 void RecoveryManager::undo() {
     std::cout << "[Recovery] Undo phase...\n";
-    static_cast<void>(bpm_);
+    const auto start = Clock::now();
+
+    std::vector<CheckpointTxn> losers;
+    for (const auto& [id, txn] : att_) {
+        if (txn.prepared) {
+            in_doubt_.push_back(txn);
+        } else {
+            losers.push_back(txn);
+        }
+    }
+    std::sort(in_doubt_.begin(), in_doubt_.end(),
+              [](const CheckpointTxn& a, const CheckpointTxn& b) { return a.txn_id < b.txn_id; });
+
+    /* Losers hold disjoint row locks, so each worker rolls back its own share of them */
+    const size_t workers = workers_for(losers.size());
+    std::vector<Stats> counts(workers);
+    run_workers(workers, [&](size_t worker) {
+        TableCache tables(bpm_, catalog_);
+        Stats& count = counts[worker];
+
+        /* (next LSN to undo, loser slot): always the latest change among this worker's losers */
+        std::priority_queue<std::pair<lsn_t, size_t>> next;
+        for (size_t i = worker; i < losers.size(); i += workers) {
+            next.emplace(losers[i].last_lsn, i);
+        }
+        while (!next.empty()) {
+            const auto [lsn, slot] = next.top();
+            next.pop();
+            CheckpointTxn& txn = losers[slot];
+
+            const auto it = by_lsn_.find(lsn);
+            const LogRecord* const record = it != by_lsn_.end() ? &records_[it->second] : nullptr;
+            lsn_t undo_next = INVALID_LSN;
+            if (record != nullptr && record->type_ == LogRecordType::CLR) {
+                undo_next = record->undo_next_lsn_;
+            } else if (record != nullptr && record->type_ != LogRecordType::BEGIN) {
+                undo_next = record->prev_lsn_;
+                if (changes_page(*record)) {
+                    std::vector<storage::HeapTable::TupleId> rids = record->rids_;
+                    if (rids.empty()) {
+                        rids.push_back(record->rid_);
+                    }
+                    storage::HeapTable* const table = tables.get(record->table_name_);
+                    if (table == nullptr) {
+                        count.unknown_tables++;
+                    }
+                    for (const auto& rid : rids) {
+                        if (table == nullptr) {
+                            break;
+                        }
+                        if (record->type_ == LogRecordType::MARK_DELETE) {
+                            static_cast<void>(table->undo_remove(rid));
+                        } else {
+                            static_cast<void>(table->physical_remove(rid));
+                        }
+                    }
+                    const LogRecordType undone = record->type_ == LogRecordType::MARK_DELETE
+                                                     ? LogRecordType::MARK_DELETE
+                                                     : LogRecordType::INSERT;
+                    LogRecord clr(txn.txn_id, txn.last_lsn, undone, record->table_name_, rids,
+                                  undo_next);
+                    txn.last_lsn = log_manager_.append_log_record(clr);
+                    count.clrs_written++;
+                    if (table != nullptr) {
+                        static_cast<void>(table->set_page_lsn(rids.front().page_num, txn.last_lsn));
+                    }
+                }
+            } else if (record == nullptr && lsn != INVALID_LSN) {
+                std::cerr << "--- [Recovery] Transaction " << txn.txn_id << " reaches LSN " << lsn
+                          << " before the log scan; ending its rollback there ---" << std::endl;
+            }
+
+            if (undo_next != INVALID_LSN && by_lsn_.count(undo_next) != 0) {
+                next.emplace(undo_next, slot);
+                continue;
+            }
+            if (undo_next != INVALID_LSN) {
+                std::cerr << "--- [Recovery] Transaction " << txn.txn_id << " reaches LSN "
+                          << undo_next << " before the log scan; ending its rollback there ---"
+                          << std::endl;
+            }
+            LogRecord abort(txn.txn_id, txn.last_lsn, LogRecordType::ABORT);
+            txn.last_lsn = log_manager_.append_log_record(abort);
+            count.losers++;
+        }
+    });
+
+    for (const Stats& count : counts) {
+        stats_.losers += count.losers;
+        stats_.clrs_written += count.clrs_written;
+        stats_.unknown_tables += count.unknown_tables;
+    }
+    stats_.in_doubt = in_doubt_.size();
+    stats_.undo_us = elapsed_us(start);
+    std::cout << "[Recovery] Undo: " << stats_.losers << " transactions rolled back with "
+              << stats_.clrs_written << " CLRs, " << in_doubt_.size() << " prepared in doubt\n";
+}
+
+bool RecoveryManager::checkpoint(const std::function<std::vector<CheckpointTxn>()>& active_txns,
+                                 std::chrono::milliseconds spread) {
+    if (spread.count() > 0) {
+        static_cast<void>(bpm_.flush_dirty_pages(log_manager_.get_next_lsn() - 1, spread));
+    }
+    LogRecord begin(0, INVALID_LSN, LogRecordType::CHECKPOINT_BEGIN);
+    const lsn_t begin_lsn = log_manager_.append_log_record(begin);
+
+    /* Both tables are taken while work goes on; anything they miss comes after begin_lsn */
+    std::vector<CheckpointTxn> txns = active_txns();
+    std::vector<storage::BufferPoolManager::DirtyPage> pages = bpm_.dirty_page_table();
+    lsn_t scan_lsn = begin_lsn;
+    for (const auto& txn : txns) {
+        if (txn.first_lsn >= 0) {
+            scan_lsn = std::min(scan_lsn, txn.first_lsn);
+        }
+    }
+    for (const auto& page : pages) {
+        scan_lsn = std::min(scan_lsn, page.rec_lsn);
+    }
+
+    LogRecord end(begin_lsn, std::move(txns), std::move(pages));
+    const lsn_t end_lsn = log_manager_.append_log_record(end);
+    if (!log_manager_.wait_durable(end_lsn, true)) {
+        std::cerr << "Error: checkpoint at LSN " << begin_lsn << " is not durable\n";
+        return false;
+    }
+    if (!write_master({begin_lsn, log_manager_.offset_before(scan_lsn)})) {
+        return false;
+    }
+    log_manager_.trim_offsets(scan_lsn);
+    return true;
 }
 
 }  // namespace cloudsql::recovery
@@ -0,0 +1,343 @@
+/**
+ * @file brin_index.cpp
+ * @brief BRIN index implementation
+ */
+
+#include "storage/brin_index.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "common/value.hpp"
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/heap_table.hpp"
+#include "storage/page_guard.hpp"
+#include "storage/page_map.hpp"
+
+namespace cloudsql::storage {
+
+namespace {
+
+using RangeSummary = BrinIndex::RangeSummary;
+
+bool is_integer_type(common::ValueType type) {
+    return type == common::ValueType::TYPE_INT8 || type == common::ValueType::TYPE_INT16 ||
+           type == common::ValueType::TYPE_INT32 || type == common::ValueType::TYPE_INT64;
+}
+
+bool is_float_type(common::ValueType type) {
+    return type == common::ValueType::TYPE_FLOAT32 || type == common::ValueType::TYPE_FLOAT64;
+}
+
+bool is_text_type(common::ValueType type) {
+    return type == common::ValueType::TYPE_CHAR || type == common::ValueType::TYPE_VARCHAR ||
+           type == common::ValueType::TYPE_TEXT;
+}
+
+}  // namespace
+
+bool BrinIndex::supports(common::ValueType type) {
+    return is_integer_type(type) || is_float_type(type) || is_text_type(type);
+}
+
+BrinIndex::BrinIndex(std::string index_name, BufferPoolManager& bpm, common::ValueType key_type,
+                     uint32_t pages_per_range)
+    : index_name_(std::move(index_name)),
+      filename_(index_name_ + ".idx"),
+      bpm_(bpm),
+      page_size_(bpm.page_size()),
+      key_type_(key_type),
+      pages_per_range_(std::max<uint32_t>(1, pages_per_range)),
+      summaries_per_page_(static_cast<uint32_t>(page_size_ / sizeof(RangeSummary))) {}
+
+bool BrinIndex::create() {
+    if (!bpm_.open_file(filename_)) {
+        return false;
+    }
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, META_PAGE);
+    if (!guard.valid()) {
+        return false;
+    }
+    const MetaPage meta{META_MAGIC, pages_per_range_, 0};
+    std::memset(guard.data(), 0, page_size_);
+    std::memcpy(guard.data(), &meta, sizeof(MetaPage));
+    return true;
+}
+
+bool BrinIndex::open() {
+    return bpm_.open_file(filename_);
+}
+
+void BrinIndex::close() {
+    bpm_.close_file(filename_);
+}
+
+bool BrinIndex::drop() {
+    static_cast<void>(bpm_.close_file(filename_));
+    static_cast<void>(std::remove((filename_ + PageMap::FILE_SUFFIX).c_str()));
+    return (std::remove(filename_.c_str()) == 0);
+}
+
+BrinIndex::MetaPage BrinIndex::meta() {
+    MetaPage meta{};
+    const ReadPageGuard guard = bpm_.fetch_page_read(filename_, META_PAGE);
+    if (guard.valid()) {
+        std::memcpy(&meta, guard.data(), sizeof(MetaPage));
+    }
+    if (meta.magic != META_MAGIC || meta.pages_per_range == 0) {
+        meta.magic = 0;
+    }
+    return meta;
+}
+
+uint32_t BrinIndex::summary_page(uint32_t range) const {
+    return 1 + range / summaries_per_page_;
+}
+
+size_t BrinIndex::summary_offset(uint32_t range) const {
+    return static_cast<size_t>(range % summaries_per_page_) * sizeof(RangeSummary);
+}
+
+common::Value BrinIndex::bound_value(const RangeSummary& summary, bool max) const {
+    const char* const bytes = max ? summary.max : summary.min;
+    if (is_integer_type(key_type_)) {
+        int64_t v = 0;
+        std::memcpy(&v, bytes, sizeof(v));
+        return common::Value::make_int64(v);
+    }
+    if (is_float_type(key_type_)) {
+        double v = 0;
+        std::memcpy(&v, bytes, sizeof(v));
+        return common::Value::make_float64(v);
+    }
+    return common::Value::make_text(std::string_view(bytes, max ? summary.max_len : summary.min_len));
+}
+
+void BrinIndex::store_bound(RangeSummary& summary, const common::Value& key, bool max) const {
+    char* const bytes = max ? summary.max : summary.min;
+    if (is_integer_type(key_type_)) {
+        const int64_t v = key.to_int64();
+        std::memcpy(bytes, &v, sizeof(v));
+        return;
+    }
+    if (is_float_type(key_type_)) {
+        const double v = key.to_float64();
+        std::memcpy(bytes, &v, sizeof(v));
+        return;
+    }
+    const std::string text = key.to_string();
+    /* A prefix still bounds a key from below, but not from above */
+    if (max && text.size() > BOUND_BYTES) {
+        summary.flags |= MAX_UNBOUNDED;
+        return;
+    }
+    const size_t len = std::min(text.size(), BOUND_BYTES);
+    std::memcpy(bytes, text.data(), len);
+    (max ? summary.max_len : summary.min_len) = static_cast<uint8_t>(len);
+}
+
+void BrinIndex::merge(RangeSummary& summary, const common::Value& key) const {
+    if (key.is_null()) {
+        summary.flags |= SUMMARIZED | HAS_NULLS;
+        return;
+    }
+    if ((summary.flags & HAS_VALUES) == 0) {
+        summary.flags |= SUMMARIZED | HAS_VALUES;
+        store_bound(summary, key, false);
+        store_bound(summary, key, true);
+        return;
+    }
+    if (key < bound_value(summary, false)) {
+        store_bound(summary, key, false);
+    }
+    if ((summary.flags & MAX_UNBOUNDED) == 0 && bound_value(summary, true) < key) {
+        store_bound(summary, key, true);
+    }
+}
+
+void BrinIndex::merge(RangeSummary& into, const RangeSummary& from) const {
+    if ((from.flags & HAS_NULLS) != 0) {
+        merge(into, common::Value::make_null());
+    }
+    if ((from.flags & HAS_VALUES) != 0) {
+        merge(into, bound_value(from, false));
+        if ((from.flags & MAX_UNBOUNDED) != 0) {
+            into.flags |= MAX_UNBOUNDED;
+        } else {
+            merge(into, bound_value(from, true));
+        }
+    }
+}
+
+bool BrinIndex::overlaps(const RangeSummary& summary, const std::optional<Bound>& lower,
+                         const std::optional<Bound>& upper) const {
+    if ((summary.flags & SUMMARIZED) == 0) {
+        return true;
+    }
+    if ((summary.flags & HAS_NULLS) != 0 && !upper) {
+        return true;
+    }
+    if ((summary.flags & HAS_VALUES) == 0) {
+        return false;
+    }
+    if (upper) {
+        const common::Value min = bound_value(summary, false);
+        if (upper->key < min || (!upper->inclusive && !(min < upper->key))) {
+            return false;
+        }
+    }
+    if (lower && (summary.flags & MAX_UNBOUNDED) == 0) {
+        const common::Value max = bound_value(summary, true);
+        if (max < lower->key || (!lower->inclusive && !(lower->key < max))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BrinIndex::extend(uint32_t range_count) {
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, META_PAGE);
+    if (!guard.valid()) {
+        return false;
+    }
+    MetaPage meta{};
+    std::memcpy(&meta, guard.data(), sizeof(MetaPage));
+    if (meta.range_count >= range_count) {
+        return true;
+    }
+    /* Clear the new slots first: their pages may hold a dropped index's bytes */
+    for (uint32_t range = meta.range_count; range < range_count;) {
+        WritePageGuard page = bpm_.fetch_page_write(filename_, summary_page(range));
+        if (!page.valid()) {
+            return false;
+        }
+        const uint32_t last =
+            std::min(range_count, (range / summaries_per_page_ + 1) * summaries_per_page_);
+        std::memset(page.data() + summary_offset(range), 0,
+                    static_cast<size_t>(last - range) * sizeof(RangeSummary));
+        range = last;
+    }
+    meta.range_count = range_count;
+    std::memcpy(guard.data(), &meta, sizeof(MetaPage));
+    return true;
+}
+
+bool BrinIndex::insert(const common::Value& key, HeapTable::TupleId tuple_id) {
+    const MetaPage current = meta();
+    if (current.magic == 0) {
+        return false;
+    }
+    const uint32_t range = tuple_id.page_num / current.pages_per_range;
+    /* Readers treat a range without a summary as matching, so the slot may appear first */
+    if (range >= current.range_count && !extend(range + 1)) {
+        return false;
+    }
+
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, summary_page(range));
+    if (!guard.valid()) {
+        return false;
+    }
+    char* const slot = guard.data() + summary_offset(range);
+    RangeSummary summary{};
+    std::memcpy(&summary, slot, sizeof(RangeSummary));
+    merge(summary, key);
+    std::memcpy(slot, &summary, sizeof(RangeSummary));
+    return true;
+}
+
+bool BrinIndex::remove(const common::Value& /*key*/, HeapTable::TupleId /*tuple_id*/) {
+    return true;
+}
+
+bool BrinIndex::bulk_load(std::vector<Entry> entries) {
+    if (entries.empty()) {
+        return true;
+    }
+    const MetaPage current = meta();
+    if (current.magic == 0) {
+        return false;
+    }
+
+    std::vector<RangeSummary> summaries;
+    for (const auto& entry : entries) {
+        const uint32_t range = entry.tuple_id.page_num / current.pages_per_range;
+        if (range >= summaries.size()) {
+            summaries.resize(static_cast<size_t>(range) + 1, RangeSummary{});
+        }
+        merge(summaries[range], entry.key);
+    }
+
+    const auto range_count = static_cast<uint32_t>(summaries.size());
+    if (range_count > current.range_count && !extend(range_count)) {
+        return false;
+    }
+    for (uint32_t first = 0; first < range_count; first += summaries_per_page_) {
+        WritePageGuard guard = bpm_.fetch_page_write(filename_, summary_page(first));
+        if (!guard.valid()) {
+            return false;
+        }
+        const uint32_t last = std::min(range_count, first + summaries_per_page_);
+        for (uint32_t range = first; range < last; ++range) {
+            if ((summaries[range].flags & SUMMARIZED) == 0) {
+                continue;
+            }
+            char* const slot = guard.data() + summary_offset(range);
+            RangeSummary summary{};
+            std::memcpy(&summary, slot, sizeof(RangeSummary));
+            merge(summary, summaries[range]);
+            std::memcpy(slot, &summary, sizeof(RangeSummary));
+        }
+    }
+    return true;
+}
+
+std::vector<HeapTable::TupleId> BrinIndex::search(const common::Value& /*key*/) {
+    return {};
+}
+
+std::vector<HeapTable::PageRange> BrinIndex::matching_ranges(const std::optional<Bound>& lower,
+                                                             const std::optional<Bound>& upper) {
+    const MetaPage current = meta();
+    if (current.magic == 0) {
+        /* Unreadable: every page may match */
+        return {HeapTable::PageRange{0, HeapTable::PageRange::TO_END}};
+    }
+
+    std::vector<HeapTable::PageRange> ranges;
+    const auto add = [&ranges](uint32_t first, uint32_t end) {
+        if (!ranges.empty() && ranges.back().end == first) {
+            ranges.back().end = end;
+        } else {
+            ranges.push_back({first, end});
+        }
+    };
+
+    const uint32_t ppr = current.pages_per_range;
+    for (uint32_t first = 0; first < current.range_count; first += summaries_per_page_) {
+        const ReadPageGuard guard = bpm_.fetch_page_read(filename_, summary_page(first));
+        if (!guard.valid()) {
+            return {HeapTable::PageRange{0, HeapTable::PageRange::TO_END}};
+        }
+        const uint32_t last = std::min(current.range_count, first + summaries_per_page_);
+        for (uint32_t range = first; range < last; ++range) {
+            RangeSummary summary{};
+            std::memcpy(&summary, guard.data() + summary_offset(range), sizeof(RangeSummary));
+            if (overlaps(summary, lower, upper)) {
+                add(range * ppr, (range + 1) * ppr);
+            }
+        }
+    }
+    /* Pages appended since the last summary was made room for */
+    add(current.range_count * ppr, HeapTable::PageRange::TO_END);
+    return ranges;
+}
+
+}  // namespace cloudsql::storage
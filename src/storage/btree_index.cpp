@@ -1,18 +1,20 @@
 /**
  * @file btree_index.cpp
- * @brief B-tree index implementation
+ * @brief B+ tree index implementation
  */
 
 #include "storage/btree_index.hpp"
 
-#include <array>
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <iostream>
 #include <iterator>
-#include <sstream>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -20,32 +22,426 @@
 #include "storage/buffer_pool_manager.hpp"
 #include "storage/heap_table.hpp"
 #include "storage/page.hpp"
+#include "storage/page_guard.hpp"
+#include "storage/page_map.hpp"
 
 namespace cloudsql::storage {
 
+namespace {
+
+using NodeHeader = BTreeIndex::NodeHeader;
+using NodeType = BTreeIndex::NodeType;
+using TupleId = HeapTable::TupleId;
+
+constexpr size_t SLOT_SIZE = sizeof(uint16_t);
+constexpr size_t KEY_LEN_SIZE = sizeof(uint16_t);
+constexpr size_t TID_SIZE = sizeof(uint32_t) + sizeof(uint16_t);
+constexpr size_t CHILD_SIZE = sizeof(uint32_t);
+
+/* Bytes for cells and slots; the fan-out grows with the page size */
+size_t node_capacity(size_t page_size) {
+    return page_size - sizeof(NodeHeader);
+}
+
+/* Nodes below a quarter full are merged or refilled from a sibling */
+size_t min_fill(size_t page_size) {
+    return node_capacity(page_size) / 4;
+}
+
+/* Bulk-loaded nodes keep ~10% free so the first inserts do not split them at once */
+size_t bulk_fill(size_t page_size) {
+    return node_capacity(page_size) * 9 / 10;
+}
+
+/* Keys order first by class, so mixed-type keys still have a total order */
+enum class KeyClass : uint8_t { Number = 0, Bool = 1, String = 2, Null = 3 };
+
+bool is_integer_type(common::ValueType type) {
+    return type == common::ValueType::TYPE_INT8 || type == common::ValueType::TYPE_INT16 ||
+           type == common::ValueType::TYPE_INT32 || type == common::ValueType::TYPE_INT64;
+}
+
+bool is_float_type(common::ValueType type) {
+    return type == common::ValueType::TYPE_FLOAT32 || type == common::ValueType::TYPE_FLOAT64 ||
+           type == common::ValueType::TYPE_DECIMAL;
+}
+
+KeyClass key_class(common::ValueType type) {
+    if (type == common::ValueType::TYPE_NULL) {
+        return KeyClass::Null;
+    }
+    if (type == common::ValueType::TYPE_BOOL) {
+        return KeyClass::Bool;
+    }
+    if (is_integer_type(type) || is_float_type(type)) {
+        return KeyClass::Number;
+    }
+    return KeyClass::String;
+}
+
+/* Encode a key as its type byte followed by a fixed-width payload or raw string bytes */
+bool encode_key(const common::Value& value, std::string* out) {
+    const common::ValueType type = value.type();
+    out->assign(1, static_cast<char>(type));
+    if (is_integer_type(type)) {
+        const int64_t v = value.to_int64();
+        out->append(reinterpret_cast<const char*>(&v), sizeof(v));
+    } else if (is_float_type(type)) {
+        const double v = value.to_float64();
+        out->append(reinterpret_cast<const char*>(&v), sizeof(v));
+    } else if (type == common::ValueType::TYPE_BOOL) {
+        out->push_back(value.as_bool() ? 1 : 0);
+    } else if (type != common::ValueType::TYPE_NULL) {
+        out->append(value.to_string());
+    }
+    return out->size() <= BTreeIndex::MAX_KEY_SIZE;
+}
+
+common::Value decode_key(const char* key, size_t len) {
+    const auto type = static_cast<common::ValueType>(key[0]);
+    const char* const payload = std::next(key);
+    if (is_integer_type(type)) {
+        int64_t v = 0;
+        std::memcpy(&v, payload, sizeof(v));
+        switch (type) {
+            case common::ValueType::TYPE_INT8:
+                return common::Value(static_cast<int8_t>(v));
+            case common::ValueType::TYPE_INT16:
+                return common::Value(static_cast<int16_t>(v));
+            case common::ValueType::TYPE_INT32:
+                return common::Value(static_cast<int32_t>(v));
+            default:
+                return common::Value::make_int64(v);
+        }
+    }
+    if (is_float_type(type)) {
+        double v = 0;
+        std::memcpy(&v, payload, sizeof(v));
+        if (type == common::ValueType::TYPE_FLOAT32) {
+            return common::Value(static_cast<float>(v));
+        }
+        return common::Value::make_float64(v);
+    }
+    if (type == common::ValueType::TYPE_BOOL) {
+        return common::Value::make_bool(payload[0] != 0);
+    }
+    if (type == common::ValueType::TYPE_NULL) {
+        return common::Value::make_null();
+    }
+    return common::Value::make_text(std::string_view(payload, len - 1));
+}
+
+/* Three-way compare of two encoded keys, consistent with Value::operator< within a class */
+int compare_keys(const char* a, size_t a_len, const char* b, size_t b_len) {
+    const auto a_type = static_cast<common::ValueType>(a[0]);
+    const auto b_type = static_cast<common::ValueType>(b[0]);
+    const KeyClass a_class = key_class(a_type);
+    const KeyClass b_class = key_class(b_type);
+    if (a_class != b_class) {
+        return a_class < b_class ? -1 : 1;
+    }
+
+    const char* const pa = std::next(a);
+    const char* const pb = std::next(b);
+    switch (a_class) {
+        case KeyClass::Number: {
+            if (is_integer_type(a_type) && is_integer_type(b_type)) {
+                int64_t x = 0;
+                int64_t y = 0;
+                std::memcpy(&x, pa, sizeof(x));
+                std::memcpy(&y, pb, sizeof(y));
+                return x < y ? -1 : (y < x ? 1 : 0);
+            }
+            double x = 0;
+            double y = 0;
+            if (is_integer_type(a_type)) {
+                int64_t i = 0;
+                std::memcpy(&i, pa, sizeof(i));
+                x = static_cast<double>(i);
+            } else {
+                std::memcpy(&x, pa, sizeof(x));
+            }
+            if (is_integer_type(b_type)) {
+                int64_t i = 0;
+                std::memcpy(&i, pb, sizeof(i));
+                y = static_cast<double>(i);
+            } else {
+                std::memcpy(&y, pb, sizeof(y));
+            }
+            return x < y ? -1 : (y < x ? 1 : 0);
+        }
+        case KeyClass::Bool:
+            return static_cast<int>(pa[0] != 0) - static_cast<int>(pb[0] != 0);
+        case KeyClass::String: {
+            const size_t len = std::min(a_len, b_len) - 1;
+            const int c = std::memcmp(pa, pb, len);
+            if (c != 0) {
+                return c < 0 ? -1 : 1;
+            }
+            return a_len < b_len ? -1 : (b_len < a_len ? 1 : 0);
+        }
+        case KeyClass::Null:
+        default:
+            return 0;
+    }
+}
+
+int compare_tids(const TupleId& a, const TupleId& b) {
+    if (a.page_num != b.page_num) {
+        return a.page_num < b.page_num ? -1 : 1;
+    }
+    if (a.slot_num != b.slot_num) {
+        return a.slot_num < b.slot_num ? -1 : 1;
+    }
+    return 0;
+}
+
+/* Decoded view of a cell in place */
+struct CellView {
+    const char* key = nullptr;
+    uint16_t key_len = 0;
+    TupleId tid;
+    uint32_t child = 0;
+};
+
+CellView view_cell(const char* cell, bool internal) {
+    CellView view;
+    std::memcpy(&view.key_len, cell, KEY_LEN_SIZE);
+    view.key = std::next(cell, static_cast<std::ptrdiff_t>(KEY_LEN_SIZE));
+    const char* const tid = std::next(view.key, view.key_len);
+    std::memcpy(&view.tid.page_num, tid, sizeof(uint32_t));
+    std::memcpy(&view.tid.slot_num, std::next(tid, sizeof(uint32_t)), sizeof(uint16_t));
+    if (internal) {
+        std::memcpy(&view.child, std::next(tid, static_cast<std::ptrdiff_t>(TID_SIZE)),
+                    CHILD_SIZE);
+    }
+    return view;
+}
+
+size_t cell_size(const char* cell, bool internal) {
+    uint16_t key_len = 0;
+    std::memcpy(&key_len, cell, KEY_LEN_SIZE);
+    return KEY_LEN_SIZE + key_len + TID_SIZE + (internal ? CHILD_SIZE : 0);
+}
+
+std::string make_cell(const char* key, size_t key_len, const TupleId& tid, bool internal,
+                      uint32_t child = 0) {
+    std::string cell;
+    cell.reserve(KEY_LEN_SIZE + key_len + TID_SIZE + CHILD_SIZE);
+    const auto len = static_cast<uint16_t>(key_len);
+    cell.append(reinterpret_cast<const char*>(&len), KEY_LEN_SIZE);
+    cell.append(key, key_len);
+    cell.append(reinterpret_cast<const char*>(&tid.page_num), sizeof(uint32_t));
+    cell.append(reinterpret_cast<const char*>(&tid.slot_num), sizeof(uint16_t));
+    if (internal) {
+        cell.append(reinterpret_cast<const char*>(&child), CHILD_SIZE);
+    }
+    return cell;
+}
+
+/* Re-point an internal cell (or turn a leaf cell into one) at a new child */
+std::string as_separator(const std::string& cell, bool internal, uint32_t child) {
+    const CellView view = view_cell(cell.data(), internal);
+    return make_cell(view.key, view.key_len, view.tid, true, child);
+}
+
+int compare_cell(const CellView& cell, const std::string& key, const TupleId& tid) {
+    const int c = compare_keys(cell.key, cell.key_len, key.data(), key.size());
+    return c != 0 ? c : compare_tids(cell.tid, tid);
+}
+
+NodeHeader read_node(const char* page) {
+    NodeHeader header{};
+    std::memcpy(&header, page, sizeof(NodeHeader));
+    return header;
+}
+
+void write_node_header(char* page, const NodeHeader& header) {
+    std::memcpy(page, &header, sizeof(NodeHeader));
+}
+
+uint16_t slot_offset(const char* page, uint16_t slot) {
+    uint16_t offset = 0;
+    std::memcpy(&offset,
+                std::next(page, static_cast<std::ptrdiff_t>(sizeof(NodeHeader) + slot * SLOT_SIZE)),
+                SLOT_SIZE);
+    return offset;
+}
+
+const char* cell_ptr(const char* page, uint16_t slot) {
+    return std::next(page, slot_offset(page, slot));
+}
+
+CellView view_slot(const char* page, const NodeHeader& header, uint16_t slot) {
+    return view_cell(cell_ptr(page, slot), header.type == NodeType::Internal);
+}
+
+std::vector<std::string> node_cells(const char* page, const NodeHeader& header) {
+    const bool internal = header.type == NodeType::Internal;
+    std::vector<std::string> cells;
+    cells.reserve(header.num_keys);
+    for (uint16_t i = 0; i < header.num_keys; ++i) {
+        const char* const cell = cell_ptr(page, i);
+        cells.emplace_back(cell, cell_size(cell, internal));
+    }
+    return cells;
+}
+
+size_t cells_bytes(const std::vector<std::string>& cells, size_t begin, size_t end) {
+    size_t bytes = 0;
+    for (size_t i = begin; i < end; ++i) {
+        bytes += cells[i].size() + SLOT_SIZE;
+    }
+    return bytes;
+}
+
+/* Bytes taken by live cells and their slots (holes left by deletes do not count) */
+size_t used_bytes(const char* page, const NodeHeader& header) {
+    const bool internal = header.type == NodeType::Internal;
+    size_t bytes = 0;
+    for (uint16_t i = 0; i < header.num_keys; ++i) {
+        bytes += cell_size(cell_ptr(page, i), internal) + SLOT_SIZE;
+    }
+    return bytes;
+}
+
+/* Rewrite a node from cells[begin, end) */
+void write_node(char* page, size_t page_size, NodeType type, const std::vector<std::string>& cells,
+                size_t begin, size_t end, uint32_t next_leaf, uint32_t first_child) {
+    std::memset(page, 0, page_size);
+    NodeHeader header{};
+    header.type = type;
+    header.num_keys = static_cast<uint16_t>(end - begin);
+    header.next_leaf = next_leaf;
+    header.first_child = first_child;
+
+    size_t top = page_size;
+    for (size_t i = begin; i < end; ++i) {
+        top -= cells[i].size();
+        std::memcpy(std::next(page, static_cast<std::ptrdiff_t>(top)), cells[i].data(),
+                    cells[i].size());
+        const auto offset = static_cast<uint16_t>(top);
+        std::memcpy(std::next(page, static_cast<std::ptrdiff_t>(sizeof(NodeHeader) +
+                                                                (i - begin) * SLOT_SIZE)),
+                    &offset, SLOT_SIZE);
+    }
+    header.free_space_offset = static_cast<uint16_t>(top);
+    write_node_header(page, header);
+}
+
+/* Insert a cell at slot `pos`, compacting the node first if only fragmented space is left */
+bool insert_cell(char* page, size_t page_size, NodeHeader& header, uint16_t pos,
+                 const std::string& cell) {
+    const size_t dir_end = sizeof(NodeHeader) + (header.num_keys + 1U) * SLOT_SIZE;
+    if (header.free_space_offset < dir_end + cell.size()) {
+        if (used_bytes(page, header) + cell.size() + SLOT_SIZE > node_capacity(page_size)) {
+            return false;
+        }
+        const std::vector<std::string> cells = node_cells(page, header);
+        write_node(page, page_size, header.type, cells, 0, cells.size(), header.next_leaf,
+                   header.first_child);
+        header = read_node(page);
+    }
+
+    const auto offset = static_cast<uint16_t>(header.free_space_offset - cell.size());
+    std::memcpy(std::next(page, offset), cell.data(), cell.size());
+
+    char* const slots = std::next(page, static_cast<std::ptrdiff_t>(sizeof(NodeHeader)));
+    std::memmove(std::next(slots, static_cast<std::ptrdiff_t>((pos + 1U) * SLOT_SIZE)),
+                 std::next(slots, static_cast<std::ptrdiff_t>(pos * SLOT_SIZE)),
+                 (header.num_keys - pos) * SLOT_SIZE);
+    std::memcpy(std::next(slots, static_cast<std::ptrdiff_t>(pos * SLOT_SIZE)), &offset,
+                SLOT_SIZE);
+
+    header.num_keys++;
+    header.free_space_offset = offset;
+    write_node_header(page, header);
+    return true;
+}
+
+void erase_cell(char* page, NodeHeader& header, uint16_t pos) {
+    char* const slots = std::next(page, static_cast<std::ptrdiff_t>(sizeof(NodeHeader)));
+    std::memmove(std::next(slots, static_cast<std::ptrdiff_t>(pos * SLOT_SIZE)),
+                 std::next(slots, static_cast<std::ptrdiff_t>((pos + 1U) * SLOT_SIZE)),
+                 (header.num_keys - pos - 1U) * SLOT_SIZE);
+    header.num_keys--;
+    write_node_header(page, header);
+}
+
+/* First slot whose cell is >= (key, tid) */
+uint16_t lower_bound(const char* page, const NodeHeader& header, const std::string& key,
+                     const TupleId& tid) {
+    uint16_t lo = 0;
+    uint16_t hi = header.num_keys;
+    while (lo < hi) {
+        const auto mid = static_cast<uint16_t>(lo + (hi - lo) / 2);
+        if (compare_cell(view_slot(page, header, mid), key, tid) < 0) {
+            lo = static_cast<uint16_t>(mid + 1);
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Number of separators <= (key, tid), i.e. the index of the child to descend into */
+uint16_t child_index_for(const char* page, const NodeHeader& header, const std::string& key,
+                         const TupleId& tid) {
+    uint16_t lo = 0;
+    uint16_t hi = header.num_keys;
+    while (lo < hi) {
+        const auto mid = static_cast<uint16_t>(lo + (hi - lo) / 2);
+        if (compare_cell(view_slot(page, header, mid), key, tid) <= 0) {
+            lo = static_cast<uint16_t>(mid + 1);
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+uint32_t child_at(const char* page, const NodeHeader& header, uint16_t index) {
+    return index == 0 ? header.first_child : view_slot(page, header, index - 1).child;
+}
+
+/* Split point balancing bytes, keeping at least `min_side` cells on each side */
+size_t split_point(const std::vector<std::string>& cells, size_t min_side) {
+    const size_t total = cells_bytes(cells, 0, cells.size());
+    size_t acc = 0;
+    size_t mid = 0;
+    while (mid < cells.size() && acc + cells[mid].size() + SLOT_SIZE <= total / 2) {
+        acc += cells[mid].size() + SLOT_SIZE;
+        mid++;
+    }
+    return std::clamp(mid, min_side, cells.size() - min_side);
+}
+
+}  // namespace
+
 BTreeIndex::BTreeIndex(std::string index_name, BufferPoolManager& bpm, common::ValueType key_type)
     : index_name_(std::move(index_name)),
       filename_(index_name_ + ".idx"),
       bpm_(bpm),
+      page_size_(bpm.page_size()),
       key_type_(key_type) {}
 
 /**
  * @brief Iterator implementation
  */
 BTreeIndex::Iterator::Iterator(BTreeIndex& index, uint32_t page, uint16_t slot)
-    : index_(index), current_page_(page), current_slot_(slot) {}
+    : index_(index), current_page_(page), current_slot_(slot) {
+    eof_ = page == META_PAGE;
+}
 
 bool BTreeIndex::Iterator::next(Entry& out_entry) {
     while (!eof_) {
-        std::array<char, Page::PAGE_SIZE> buffer{};
-        if (!index_.read_page(current_page_, buffer.data())) {
+        const ReadPageGuard guard = index_.bpm_.fetch_page_read(index_.filename_, current_page_);
+        if (!guard.valid()) {
             eof_ = true;
             return false;
         }
 
-        NodeHeader header{};
-        std::memcpy(&header, buffer.data(), sizeof(NodeHeader));
-
+        const NodeHeader header = read_node(guard.data());
         if (current_slot_ >= header.num_keys) {
             /* Move to next leaf if exists */
             if (header.next_leaf != 0) {
@@ -57,46 +453,17 @@ bool BTreeIndex::Iterator::next(Entry& out_entry) {
             return false;
         }
 
-        /* Deserialize entry (crude implementation) */
-        const char* const data_start =
-            std::next(buffer.data(), static_cast<std::ptrdiff_t>(sizeof(NodeHeader)));
-        /* Find the N-th pipe-delimited segment */
-        const std::string s(data_start);
-        std::stringstream ss(s);
-        std::string item;
-        uint16_t i = 0;
-        while (i < current_slot_ && std::getline(ss, item, '|')) {
-            // Skip previous entries
-            // Each entry is: type|lexeme|page|slot|
-            for (int j = 0; j < 3; ++j) {
-                static_cast<void>(std::getline(ss, item, '|'));
-            }
-            i++;
-        }
-
-        /* Read our entry */
-        std::string type_str;
-        std::string lexeme;
-        std::string page_str;
-        std::string slot_str;
-        if (std::getline(ss, type_str, '|') && std::getline(ss, lexeme, '|') &&
-            std::getline(ss, page_str, '|') && std::getline(ss, slot_str, '|')) {
-            common::Value val;
-            if (std::stoi(type_str) == static_cast<int>(common::ValueType::TYPE_INT64)) {
-                val = common::Value::make_int64(std::stoll(lexeme));
-            } else {
-                val = common::Value::make_text(lexeme);
+        const CellView cell = view_cell(cell_ptr(guard.data(), current_slot_), false);
+        if (has_upper_) {
+            const int c = compare_keys(cell.key, cell.key_len, upper_.data(), upper_.size());
+            if (c > 0 || (c == 0 && !upper_inclusive_)) {
+                eof_ = true;
+                return false;
             }
-
-            out_entry = Entry(std::move(val),
-                              HeapTable::TupleId(static_cast<uint32_t>(std::stoul(page_str)),
-                                                 static_cast<uint16_t>(std::stoi(slot_str))));
-            current_slot_++;
-            return true;
         }
-
-        eof_ = true;
-        return false;
+        out_entry = Entry(decode_key(cell.key, cell.key_len), cell.tid);
+        current_slot_++;
+        return true;
     }
     return false;
 }
@@ -110,16 +477,28 @@ bool BTreeIndex::create() {
         return false;
     }
 
-    /* Initialize root page */
-    std::array<char, Page::PAGE_SIZE> buffer{};
-    NodeHeader header{};
-    header.type = NodeType::Leaf;
-    header.num_keys = 0;
-    header.parent_page = 0;
-    header.next_leaf = 0;
-    std::memcpy(buffer.data(), &header, sizeof(NodeHeader));
+    constexpr uint32_t ROOT_PAGE = 1;
+    {
+        WritePageGuard root = bpm_.fetch_page_write(filename_, ROOT_PAGE);
+        if (!root.valid()) {
+            return false;
+        }
+        write_node(root.data(), page_size_, NodeType::Leaf, {}, 0, 0, 0, 0);
+    }
 
-    return write_page(0, buffer.data());
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, META_PAGE);
+    if (!guard.valid()) {
+        return false;
+    }
+    MetaPage meta{};
+    meta.magic = META_MAGIC;
+    meta.root_page = ROOT_PAGE;
+    meta.page_count = ROOT_PAGE + 1;
+    meta.free_list = 0;
+    meta.height = 1;
+    std::memset(guard.data(), 0, page_size_);
+    std::memcpy(guard.data(), &meta, sizeof(MetaPage));
+    return true;
 }
 
 bool BTreeIndex::open() {
@@ -132,107 +511,649 @@ void BTreeIndex::close() {
 
 bool BTreeIndex::drop() {
     static_cast<void>(bpm_.close_file(filename_));
+    static_cast<void>(std::remove((filename_ + PageMap::FILE_SUFFIX).c_str()));
     return (std::remove(filename_.c_str()) == 0);
 }
 
+bool BTreeIndex::read_meta(MetaPage* out) {
+    const ReadPageGuard guard = bpm_.fetch_page_read(filename_, META_PAGE);
+    if (!guard.valid()) {
+        return false;
+    }
+    std::memcpy(out, guard.data(), sizeof(MetaPage));
+    return out->magic == META_MAGIC;
+}
+
+uint32_t BTreeIndex::height() {
+    MetaPage meta{};
+    return read_meta(&meta) ? meta.height : 0;
+}
+
+ReadPageGuard BTreeIndex::find_leaf_read(ReadPageGuard meta_guard, const std::string& key,
+                                         HeapTable::TupleId tuple_id) {
+    MetaPage meta{};
+    std::memcpy(&meta, meta_guard.data(), sizeof(MetaPage));
+    if (meta.magic != META_MAGIC) {
+        return {};
+    }
+
+    /* The meta latch is dropped as soon as the root is latched */
+    ReadPageGuard guard = bpm_.fetch_page_read(filename_, meta.root_page);
+    meta_guard.release();
+    while (guard.valid()) {
+        const NodeHeader header = read_node(guard.data());
+        if (header.type != NodeType::Internal) {
+            break;
+        }
+        const uint16_t index = child_index_for(guard.data(), header, key, tuple_id);
+        /* Latch the child before letting go of the parent */
+        ReadPageGuard child = bpm_.fetch_page_read(filename_, child_at(guard.data(), header, index));
+        guard = std::move(child);
+    }
+    return guard;
+}
+
+WritePageGuard BTreeIndex::find_leaf_optimistic(const MetaPage& meta, const std::string& key,
+                                                HeapTable::TupleId tuple_id) {
+    if (meta.height <= 1) {
+        return bpm_.fetch_page_write(filename_, meta.root_page);
+    }
+
+    /* Shared latches down to the parent of the leaf; the height cannot change while the
+     * caller holds the meta page shared */
+    ReadPageGuard guard = bpm_.fetch_page_read(filename_, meta.root_page);
+    for (uint32_t level = meta.height; guard.valid(); --level) {
+        const NodeHeader header = read_node(guard.data());
+        if (header.type != NodeType::Internal) {
+            return {};
+        }
+        const uint32_t child =
+            child_at(guard.data(), header, child_index_for(guard.data(), header, key, tuple_id));
+        if (level == 2) {
+            return bpm_.fetch_page_write(filename_, child);
+        }
+        ReadPageGuard next = bpm_.fetch_page_read(filename_, child);
+        guard = std::move(next);
+    }
+    return {};
+}
+
+WritePageGuard BTreeIndex::find_leaf_pessimistic(const MetaPage& meta, const std::string& key,
+                                                 HeapTable::TupleId tuple_id,
+                                                 std::vector<PathStep>* path) {
+    /* Every node on the path stays latched: a split or merge may reach any of them. The
+     * caller holds the meta page exclusively, so only readers wait on these latches. */
+    uint32_t page_num = meta.root_page;
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, page_num);
+    while (guard.valid()) {
+        const NodeHeader header = read_node(guard.data());
+        if (header.type != NodeType::Internal) {
+            break;
+        }
+        const uint16_t index = child_index_for(guard.data(), header, key, tuple_id);
+        const uint32_t child = child_at(guard.data(), header, index);
+        WritePageGuard next = bpm_.fetch_page_write(filename_, child);
+        path->push_back({std::move(guard), page_num, index});
+        guard = std::move(next);
+        page_num = child;
+    }
+    return guard;
+}
+
+uint32_t BTreeIndex::allocate_page(MetaPage& meta) {
+    if (meta.free_list != 0) {
+        const uint32_t page_num = meta.free_list;
+        const ReadPageGuard guard = bpm_.fetch_page_read(filename_, page_num);
+        meta.free_list = guard.valid() ? read_node(guard.data()).first_child : 0;
+        return page_num;
+    }
+    return meta.page_count++;
+}
+
+void BTreeIndex::free_page(MetaPage& meta, uint32_t page_num) {
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, page_num);
+    if (!guard.valid()) {
+        return;
+    }
+    /* next_leaf is left intact so a scan parked on this page still reaches its successor */
+    NodeHeader header = read_node(guard.data());
+    header.type = NodeType::Free;
+    header.num_keys = 0;
+    header.first_child = meta.free_list;
+    write_node_header(guard.data(), header);
+    meta.free_list = page_num;
+}
+
 bool BTreeIndex::insert(const common::Value& key, HeapTable::TupleId tuple_id) {
-    const uint32_t leaf_page = find_leaf(key);
-    std::array<char, Page::PAGE_SIZE> buffer{};
-    if (!read_page(leaf_page, buffer.data())) {
+    std::string encoded;
+    if (!encode_key(key, &encoded)) {
+        std::cerr << "--- [BTreeIndex] Key of " << encoded.size() << " bytes exceeds "
+                  << MAX_KEY_SIZE << " ---" << std::endl;
         return false;
     }
+    const std::string cell = make_cell(encoded.data(), encoded.size(), tuple_id, false);
 
-    NodeHeader header{};
-    std::memcpy(&header, buffer.data(), sizeof(NodeHeader));
-
-    /* Simple append-style serialization for this phase */
-    const std::string entry_data = std::to_string(static_cast<int>(key.type())) + "|" +
-                                   key.to_string() + "|" + std::to_string(tuple_id.page_num) + "|" +
-                                   std::to_string(tuple_id.slot_num) + "|";
-
-    /* Check space (very crude) */
-    char* const data_area =
-        std::next(buffer.data(), static_cast<std::ptrdiff_t>(sizeof(NodeHeader)));
-    const size_t existing_len = std::strlen(data_area);
-    if (existing_len + entry_data.size() + 1 > Page::PAGE_SIZE - sizeof(NodeHeader)) {
-        /* TODO: split_leaf(leaf_page, buffer); */
+    {
+        /* Optimistic pass: only the leaf is latched exclusively */
+        const ReadPageGuard meta_guard = bpm_.fetch_page_read(filename_, META_PAGE);
+        if (!meta_guard.valid()) {
+            return false;
+        }
+        MetaPage meta{};
+        std::memcpy(&meta, meta_guard.data(), sizeof(MetaPage));
+        if (meta.magic != META_MAGIC) {
+            return false;
+        }
+
+        WritePageGuard leaf = find_leaf_optimistic(meta, encoded, tuple_id);
+        if (!leaf.valid()) {
+            return false;
+        }
+        NodeHeader header = read_node(leaf.data());
+        const uint16_t pos = lower_bound(leaf.data(), header, encoded, tuple_id);
+        if (pos < header.num_keys &&
+            compare_cell(view_slot(leaf.data(), header, pos), encoded, tuple_id) == 0) {
+            return true;
+        }
+        if (insert_cell(leaf.data(), page_size_, header, pos, cell)) {
+            return true;
+        }
+    }
+
+    /* The leaf has to split: restart with the meta page and the whole path held exclusively */
+    WritePageGuard meta_guard = bpm_.fetch_page_write(filename_, META_PAGE);
+    if (!meta_guard.valid()) {
         return false;
     }
+    MetaPage meta{};
+    std::memcpy(&meta, meta_guard.data(), sizeof(MetaPage));
 
-    std::memcpy(std::next(data_area, static_cast<std::ptrdiff_t>(existing_len)), entry_data.c_str(),
-                entry_data.size() + 1);
-    header.num_keys++;
+    std::vector<PathStep> path;
+    WritePageGuard leaf = find_leaf_pessimistic(meta, encoded, tuple_id, &path);
+    if (!leaf.valid()) {
+        return false;
+    }
+
+    /* Another writer may have added the entry or split the leaf in the meantime */
+    NodeHeader header = read_node(leaf.data());
+    const uint16_t pos = lower_bound(leaf.data(), header, encoded, tuple_id);
+    if (pos < header.num_keys &&
+        compare_cell(view_slot(leaf.data(), header, pos), encoded, tuple_id) == 0) {
+        return true;
+    }
+    if (insert_cell(leaf.data(), page_size_, header, pos, cell)) {
+        return true;
+    }
 
-    std::memcpy(buffer.data(), &header, sizeof(NodeHeader));
-    return write_page(leaf_page, buffer.data());
+    std::vector<std::string> cells = node_cells(leaf.data(), header);
+    cells.insert(cells.begin() + pos, cell);
+    std::string separator;
+    split_leaf(meta, leaf.data(), header, cells, &separator);
+    const uint32_t leaf_page = leaf.page_id();
+    leaf.release();
+
+    const bool ok = insert_into_parent(meta, path, leaf_page, std::move(separator));
+    std::memcpy(meta_guard.data(), &meta, sizeof(MetaPage));
+    return ok;
+}
+
+void BTreeIndex::split_leaf(MetaPage& meta, char* buffer, const NodeHeader& header,
+                            const std::vector<std::string>& cells, std::string* separator) {
+    const size_t mid = split_point(cells, 1);
+    const uint32_t right_page = allocate_page(meta);
+
+    WritePageGuard right = bpm_.fetch_page_write(filename_, right_page);
+    write_node(right.data(), page_size_, NodeType::Leaf, cells, mid, cells.size(),
+               header.next_leaf, 0);
+    write_node(buffer, page_size_, NodeType::Leaf, cells, 0, mid, right_page, 0);
+    *separator = as_separator(cells[mid], false, right_page);
+}
+
+void BTreeIndex::split_internal(MetaPage& meta, char* buffer, const NodeHeader& header,
+                                const std::vector<std::string>& cells, std::string* separator) {
+    /* The middle separator moves up; its child becomes the right node's first child */
+    const size_t mid = split_point(cells, 1);
+    const CellView pushed = view_cell(cells[mid].data(), true);
+    const uint32_t right_page = allocate_page(meta);
+
+    WritePageGuard right = bpm_.fetch_page_write(filename_, right_page);
+    write_node(right.data(), page_size_, NodeType::Internal, cells, mid + 1, cells.size(), 0,
+               pushed.child);
+    *separator = make_cell(pushed.key, pushed.key_len, pushed.tid, true, right_page);
+    write_node(buffer, page_size_, NodeType::Internal, cells, 0, mid, 0, header.first_child);
+}
+
+bool BTreeIndex::insert_into_parent(MetaPage& meta, std::vector<PathStep>& path,
+                                    uint32_t left_page, std::string separator) {
+    while (true) {
+        if (path.empty()) {
+            /* The root split: grow the tree by one level */
+            const uint32_t root_page = allocate_page(meta);
+            WritePageGuard root = bpm_.fetch_page_write(filename_, root_page);
+            if (!root.valid()) {
+                return false;
+            }
+            write_node(root.data(), page_size_, NodeType::Internal, {separator}, 0, 1, 0,
+                       left_page);
+            meta.root_page = root_page;
+            meta.height++;
+            return true;
+        }
+
+        PathStep step = std::move(path.back());
+        path.pop_back();
+        char* const parent = step.guard.data();
+        NodeHeader header = read_node(parent);
+
+        /* The new separator lands right after the child that split */
+        if (insert_cell(parent, page_size_, header, step.child_index, separator)) {
+            return true;
+        }
+
+        std::vector<std::string> cells = node_cells(parent, header);
+        cells.insert(cells.begin() + step.child_index, separator);
+        split_internal(meta, parent, header, cells, &separator);
+        left_page = step.page;
+    }
 }
 
 bool BTreeIndex::remove(const common::Value& key, HeapTable::TupleId tuple_id) {
-    (void)this;
-    (void)key;
-    (void)tuple_id;
+    std::string encoded;
+    if (!encode_key(key, &encoded)) {
+        return true; /* Such a key can never have been inserted */
+    }
+
+    {
+        /* Optimistic pass: succeeds unless the leaf would drop below the fill threshold */
+        const ReadPageGuard meta_guard = bpm_.fetch_page_read(filename_, META_PAGE);
+        if (!meta_guard.valid()) {
+            return false;
+        }
+        MetaPage meta{};
+        std::memcpy(&meta, meta_guard.data(), sizeof(MetaPage));
+        if (meta.magic != META_MAGIC) {
+            return false;
+        }
+
+        WritePageGuard leaf = find_leaf_optimistic(meta, encoded, tuple_id);
+        if (!leaf.valid()) {
+            return false;
+        }
+        NodeHeader header = read_node(leaf.data());
+        const uint16_t pos = lower_bound(leaf.data(), header, encoded, tuple_id);
+        if (pos >= header.num_keys ||
+            compare_cell(view_slot(leaf.data(), header, pos), encoded, tuple_id) != 0) {
+            return true;
+        }
+        const size_t remaining = used_bytes(leaf.data(), header) -
+                                 cell_size(cell_ptr(leaf.data(), pos), false) - SLOT_SIZE;
+        if (meta.height == 1 || remaining >= min_fill(page_size_)) {
+            erase_cell(leaf.data(), header, pos);
+            return true;
+        }
+    }
+
+    WritePageGuard meta_guard = bpm_.fetch_page_write(filename_, META_PAGE);
+    if (!meta_guard.valid()) {
+        return false;
+    }
+    MetaPage meta{};
+    std::memcpy(&meta, meta_guard.data(), sizeof(MetaPage));
+
+    std::vector<PathStep> path;
+    WritePageGuard leaf = find_leaf_pessimistic(meta, encoded, tuple_id, &path);
+    if (!leaf.valid()) {
+        return false;
+    }
+    NodeHeader header = read_node(leaf.data());
+    const uint16_t pos = lower_bound(leaf.data(), header, encoded, tuple_id);
+    if (pos >= header.num_keys ||
+        compare_cell(view_slot(leaf.data(), header, pos), encoded, tuple_id) != 0) {
+        return true;
+    }
+    erase_cell(leaf.data(), header, pos);
+
+    rebalance(meta, path, std::move(leaf));
+    std::memcpy(meta_guard.data(), &meta, sizeof(MetaPage));
+    return true;
+}
+
+void BTreeIndex::rebalance(MetaPage& meta, std::vector<PathStep>& path, WritePageGuard node) {
+    while (!path.empty()) {
+        if (used_bytes(node.data(), read_node(node.data())) >= min_fill(page_size_)) {
+            return;
+        }
+
+        PathStep step = std::move(path.back());
+        path.pop_back();
+        char* const parent = step.guard.data();
+        NodeHeader parent_header = read_node(parent);
+        if (parent_header.num_keys == 0) {
+            return;
+        }
+
+        /* Pair the node with its left sibling, or its right one if it is the first child */
+        const uint16_t sep_index =
+            step.child_index > 0 ? static_cast<uint16_t>(step.child_index - 1) : 0;
+        const uint32_t left_page = child_at(parent, parent_header, sep_index);
+        const uint32_t right_page =
+            child_at(parent, parent_header, static_cast<uint16_t>(sep_index + 1));
+
+        /* Siblings are latched left to right, the order leaf scans take them in, so a right
+         * node lets go of itself first. With the parent latched only readers can reach it. */
+        WritePageGuard left;
+        WritePageGuard right;
+        if (step.child_index > 0) {
+            node.release();
+            left = bpm_.fetch_page_write(filename_, left_page);
+            right = bpm_.fetch_page_write(filename_, right_page);
+        } else {
+            left = std::move(node);
+            right = bpm_.fetch_page_write(filename_, right_page);
+        }
+        if (!left.valid() || !right.valid()) {
+            return;
+        }
+        const NodeHeader left_header = read_node(left.data());
+        const NodeHeader right_header = read_node(right.data());
+        const bool internal = left_header.type == NodeType::Internal;
+
+        /* Internal nodes pull the parent separator down between the two halves */
+        std::vector<std::string> combined = node_cells(left.data(), left_header);
+        if (internal) {
+            const char* const sep = cell_ptr(parent, sep_index);
+            combined.push_back(as_separator(std::string(sep, cell_size(sep, true)), true,
+                                            right_header.first_child));
+        }
+        const std::vector<std::string> right_cells = node_cells(right.data(), right_header);
+        combined.insert(combined.end(), right_cells.begin(), right_cells.end());
+
+        if (cells_bytes(combined, 0, combined.size()) <= node_capacity(page_size_)) {
+            /* Merge right into left and drop the separator */
+            write_node(left.data(), page_size_, left_header.type, combined, 0, combined.size(),
+                       internal ? 0 : right_header.next_leaf, left_header.first_child);
+            right.release();
+            free_page(meta, right_page);
+            erase_cell(parent, parent_header, sep_index);
+
+            if (step.page == meta.root_page && parent_header.num_keys == 0) {
+                /* The root lost its last separator: shrink the tree by one level */
+                step.guard.release();
+                meta.root_page = left_page;
+                meta.height--;
+                free_page(meta, step.page);
+                return;
+            }
+            node = std::move(step.guard);
+            continue;
+        }
+
+        /* Redistribute; the new separator is the first entry of the right half */
+        const size_t mid = split_point(combined, 1);
+        const std::string new_sep = as_separator(combined[mid], internal, right_page);
+        const size_t old_sep_size = cell_size(cell_ptr(parent, sep_index), true);
+        if (used_bytes(parent, parent_header) - old_sep_size + new_sep.size() >
+            node_capacity(page_size_)) {
+            return; /* No room for a longer separator; leave the node underfull */
+        }
+
+        if (internal) {
+            const CellView pushed = view_cell(combined[mid].data(), true);
+            write_node(left.data(), page_size_, NodeType::Internal, combined, 0, mid, 0,
+                       left_header.first_child);
+            write_node(right.data(), page_size_, NodeType::Internal, combined, mid + 1,
+                       combined.size(), 0, pushed.child);
+        } else {
+            write_node(left.data(), page_size_, NodeType::Leaf, combined, 0, mid, right_page, 0);
+            write_node(right.data(), page_size_, NodeType::Leaf, combined, mid, combined.size(),
+                       right_header.next_leaf, 0);
+        }
+        erase_cell(parent, parent_header, sep_index);
+        static_cast<void>(insert_cell(parent, page_size_, parent_header, sep_index, new_sep));
+        return;
+    }
+}
+
+bool BTreeIndex::bulk_load(std::vector<Entry> entries) {
+    struct Item {
+        std::string key;
+        HeapTable::TupleId tid;
+    };
+    std::vector<Item> items;
+    items.reserve(entries.size());
+    for (const auto& entry : entries) {
+        Item item;
+        if (!encode_key(entry.key, &item.key)) {
+            std::cerr << "--- [BTreeIndex] Key of " << item.key.size() << " bytes exceeds "
+                      << MAX_KEY_SIZE << " ---" << std::endl;
+            return false;
+        }
+        item.tid = entry.tuple_id;
+        items.push_back(std::move(item));
+    }
+    entries.clear();
+
+    const auto less = [](const Item& a, const Item& b) {
+        const int c = compare_keys(a.key.data(), a.key.size(), b.key.data(), b.key.size());
+        return c != 0 ? c < 0 : compare_tids(a.tid, b.tid) < 0;
+    };
+    if (!std::is_sorted(items.begin(), items.end(), less)) {
+        std::sort(items.begin(), items.end(), less);
+    }
+    items.erase(std::unique(items.begin(), items.end(),
+                            [&less](const Item& a, const Item& b) {
+                                return !less(a, b) && !less(b, a);
+                            }),
+                items.end());
+    if (items.empty()) {
+        return true;
+    }
+
+    WritePageGuard meta_guard = bpm_.fetch_page_write(filename_, META_PAGE);
+    if (!meta_guard.valid()) {
+        return false;
+    }
+    MetaPage meta{};
+    std::memcpy(&meta, meta_guard.data(), sizeof(MetaPage));
+    if (meta.magic != META_MAGIC) {
+        return false;
+    }
+
+    bool empty = meta.height == 1;
+    if (empty) {
+        const ReadPageGuard root = bpm_.fetch_page_read(filename_, meta.root_page);
+        empty = root.valid() && read_node(root.data()).num_keys == 0;
+    }
+    if (!empty) {
+        meta_guard.release();
+        bool ok = true;
+        for (const auto& item : items) {
+            ok = insert(decode_key(item.key.data(), item.key.size()), item.tid) && ok;
+        }
+        return ok;
+    }
+
+    /* Leaf level: pack cells left to right; the existing empty root becomes the first leaf */
+    struct Child {
+        std::string first; /**< First entry of the subtree, as a leaf cell */
+        uint32_t page;
+    };
+    std::vector<std::string> cells;
+    cells.reserve(items.size());
+    for (const auto& item : items) {
+        cells.push_back(make_cell(item.key.data(), item.key.size(), item.tid, false));
+    }
+
+    std::vector<size_t> bounds{0};
+    size_t fill = 0;
+    for (size_t i = 0; i < cells.size(); ++i) {
+        if (fill + cells[i].size() + SLOT_SIZE > bulk_fill(page_size_) && i > bounds.back()) {
+            bounds.push_back(i);
+            fill = 0;
+        }
+        fill += cells[i].size() + SLOT_SIZE;
+    }
+    bounds.push_back(cells.size());
+
+    std::vector<uint32_t> pages{meta.root_page};
+    for (size_t g = 1; g + 1 < bounds.size(); ++g) {
+        pages.push_back(allocate_page(meta));
+    }
+
+    std::vector<Child> level;
+    for (size_t g = 0; g + 1 < bounds.size(); ++g) {
+        WritePageGuard leaf = bpm_.fetch_page_write(filename_, pages[g]);
+        if (!leaf.valid()) {
+            return false;
+        }
+        const uint32_t next = g + 2 < bounds.size() ? pages[g + 1] : 0;
+        write_node(leaf.data(), page_size_, NodeType::Leaf, cells, bounds[g], bounds[g + 1], next,
+                   0);
+        level.push_back({cells[bounds[g]], pages[g]});
+    }
+    bool leaf_level = true;
+
+    /* Internal levels: each node takes a first child plus separators for the rest */
+    uint32_t height = 1;
+    while (level.size() > 1) {
+        std::vector<std::string> seps;
+        seps.reserve(level.size());
+        for (const auto& child : level) {
+            seps.push_back(as_separator(child.first, !leaf_level, child.page));
+        }
+
+        std::vector<size_t> groups{0};
+        fill = 0;
+        for (size_t i = 1; i < level.size(); ++i) {
+            if (fill + seps[i].size() + SLOT_SIZE > bulk_fill(page_size_)) {
+                /* Never leave a lone child for the last node */
+                const size_t cut = (i + 1 == level.size()) ? i - 1 : i;
+                groups.push_back(cut);
+                fill = cut == i ? 0 : seps[i - 1].size() + SLOT_SIZE;
+            }
+            fill += seps[i].size() + SLOT_SIZE;
+        }
+        groups.push_back(level.size());
+
+        std::vector<Child> parents;
+        for (size_t g = 0; g + 1 < groups.size(); ++g) {
+            const uint32_t page_num = allocate_page(meta);
+            WritePageGuard node = bpm_.fetch_page_write(filename_, page_num);
+            if (!node.valid()) {
+                return false;
+            }
+            write_node(node.data(), page_size_, NodeType::Internal, seps, groups[g] + 1,
+                       groups[g + 1], 0, level[groups[g]].page);
+            parents.push_back({seps[groups[g]], page_num});
+        }
+        level = std::move(parents);
+        leaf_level = false;
+        height++;
+    }
+
+    meta.root_page = level.front().page;
+    meta.height = height;
+    std::memcpy(meta_guard.data(), &meta, sizeof(MetaPage));
     return true;
 }
 
 std::vector<HeapTable::TupleId> BTreeIndex::search(const common::Value& key) {
-    const uint32_t leaf_page = find_leaf(key);
-    std::array<char, Page::PAGE_SIZE> buffer{};
-    if (!read_page(leaf_page, buffer.data())) {
+    std::string encoded;
+    if (!encode_key(key, &encoded)) {
         return {};
     }
 
-    std::vector<HeapTable::TupleId> results;
+    ReadPageGuard meta_guard = bpm_.fetch_page_read(filename_, META_PAGE);
+    if (!meta_guard.valid()) {
+        return {};
+    }
 
-    const char* const data =
-        std::next(buffer.data(), static_cast<std::ptrdiff_t>(sizeof(NodeHeader)));
-    const std::string s(data);
-    std::stringstream ss(s);
-    std::string type_s;
-    std::string val_s;
-    std::string page_s;
-    std::string slot_s;
+    /* Descend towards the smallest tuple id so the leftmost duplicate is reached */
+    const HeapTable::TupleId first_tid(0, 0);
+    ReadPageGuard leaf = find_leaf_read(std::move(meta_guard), encoded, first_tid);
 
-    while (std::getline(ss, type_s, '|') && std::getline(ss, val_s, '|') &&
-           std::getline(ss, page_s, '|') && std::getline(ss, slot_s, '|')) {
-        if (val_s == key.to_string()) {
-            results.emplace_back(static_cast<uint32_t>(std::stoul(page_s)),
-                                 static_cast<uint16_t>(std::stoi(slot_s)));
+    std::vector<HeapTable::TupleId> results;
+    bool first_leaf = true;
+    while (leaf.valid()) {
+        const NodeHeader header = read_node(leaf.data());
+        uint16_t slot = first_leaf ? lower_bound(leaf.data(), header, encoded, first_tid) : 0;
+        first_leaf = false;
+        for (; slot < header.num_keys; ++slot) {
+            const CellView cell = view_slot(leaf.data(), header, slot);
+            if (compare_keys(cell.key, cell.key_len, encoded.data(), encoded.size()) != 0) {
+                return results;
+            }
+            results.push_back(cell.tid);
+        }
+        if (header.next_leaf == 0) {
+            break;
         }
+        /* Couple along the leaf chain as well */
+        ReadPageGuard next = bpm_.fetch_page_read(filename_, header.next_leaf);
+        leaf = std::move(next);
     }
-
     return results;
 }
 
 BTreeIndex::Iterator BTreeIndex::scan() {
-    return {*this, root_page_, 0};
-}
+    ReadPageGuard guard = bpm_.fetch_page_read(filename_, META_PAGE);
+    if (!guard.valid()) {
+        return {*this, META_PAGE, 0};
+    }
+    MetaPage meta{};
+    std::memcpy(&meta, guard.data(), sizeof(MetaPage));
+    if (meta.magic != META_MAGIC) {
+        return {*this, META_PAGE, 0};
+    }
 
-uint32_t BTreeIndex::find_leaf(const common::Value& key) const {
-    (void)key;
-    return root_page_;  // Root is leaf in this simple 1-level tree
+    /* Walk down the leftmost spine */
+    uint32_t page_num = meta.root_page;
+    while (true) {
+        ReadPageGuard child = bpm_.fetch_page_read(filename_, page_num);
+        guard = std::move(child);
+        if (!guard.valid()) {
+            return {*this, META_PAGE, 0};
+        }
+        const NodeHeader header = read_node(guard.data());
+        if (header.type != NodeType::Internal) {
+            break;
+        }
+        page_num = header.first_child;
+    }
+    return {*this, page_num, 0};
 }
 
-bool BTreeIndex::read_page(uint32_t page_num, char* buffer) const {
-    Page* page = bpm_.fetch_page(filename_, page_num);
-    if (!page) {
-        return false;
+BTreeIndex::Iterator BTreeIndex::scan_range(const std::optional<Bound>& lower,
+                                            const std::optional<Bound>& upper) {
+    Iterator it = lower.has_value() ? seek(*lower) : scan();
+
+    /* An upper bound that cannot be encoded is dropped; callers re-check the predicate */
+    if (upper.has_value() && encode_key(upper->key, &it.upper_)) {
+        it.has_upper_ = true;
+        it.upper_inclusive_ = upper->inclusive;
     }
-    std::memcpy(buffer, page->get_data(), Page::PAGE_SIZE);
-    bpm_.unpin_page(filename_, page_num, false);
-    return true;
+    return it;
 }
 
-bool BTreeIndex::write_page(uint32_t page_num, const char* buffer) {
-    Page* page = bpm_.fetch_page(filename_, page_num);
-    if (!page) {
-        page = bpm_.new_page(filename_, &page_num);
-        if (!page) {
-            return false;
-        }
+BTreeIndex::Iterator BTreeIndex::seek(const Bound& lower) {
+    /* Start at the first entry >= (key, smallest tid) for an inclusive bound and
+     * > (key, largest tid) otherwise. A truncated string sorts before the full
+     * one, so truncation only widens the range */
+    std::string start;
+    if (!encode_key(lower.key, &start)) start.resize(MAX_KEY_SIZE);
+    const TupleId start_tid =
+        lower.inclusive ? TupleId(0, 0) : TupleId(UINT32_MAX, UINT16_MAX);
+
+    ReadPageGuard meta_guard = bpm_.fetch_page_read(filename_, META_PAGE);
+    if (!meta_guard.valid()) {
+        return {*this, META_PAGE, 0};
     }
-    std::memcpy(page->get_data(), buffer, Page::PAGE_SIZE);
-    bpm_.unpin_page(filename_, page_num, true);
-    return true;
+    const ReadPageGuard leaf = find_leaf_read(std::move(meta_guard), start, start_tid);
+    if (!leaf.valid()) {
+        return {*this, META_PAGE, 0};
+    }
+    return {*this, leaf.page_id(),
+            lower_bound(leaf.data(), read_node(leaf.data()), start, start_tid)};
 }
 
 }  // namespace cloudsql::storage
@@ -5,31 +5,101 @@
 
 #include "storage/buffer_pool_manager.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <memory>
 #include <mutex>
 #include <string>
-
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "common/metrics.hpp"
+#include "recovery/log_manager.hpp"
+#include "storage/frame_memory.hpp"
+#include "storage/io_backend.hpp"
+#include "storage/io_counters.hpp"
 #include "storage/page.hpp"
 #include "storage/storage_manager.hpp"
 
 namespace cloudsql::storage {
 
+namespace {
+constexpr uint64_t PARTITION_HASH_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+constexpr uint32_t PARTITION_HASH_SHIFT = 32;
+
+/* A single read-ahead request may claim at most this fraction of the pool */
+constexpr size_t PREFETCH_POOL_FRACTION = 4;
+/* Pending requests beyond this are dropped; the reader is not keeping up anyway */
+constexpr size_t MAX_PREFETCH_QUEUE = 16;
+/* Checkpoint writes are paced in batches of this many pages */
+constexpr size_t CHECKPOINT_BATCH = 16;
+}  // namespace
+
 BufferPoolManager::BufferPoolManager(size_t pool_size, StorageManager& storage_manager,
-                                     recovery::LogManager* log_manager)
+                                     recovery::LogManager* log_manager, size_t num_partitions,
+                                     ReplacerPolicy policy, const FrameOptions& frame_options)
     : pool_size_(pool_size),
       storage_manager_(storage_manager),
       log_manager_(log_manager),
-      pages_(std::make_unique<Page[]>(pool_size)),
-      replacer_(pool_size) {
+      policy_(policy),
+      frame_memory_(pool_size, storage_manager.page_size(), frame_options.huge_pages),
+      pages_(std::make_unique<Page[]>(pool_size)) {
     for (size_t i = 0; i < pool_size_; ++i) {
-        free_list_.push_back(static_cast<uint32_t>(i));
+        pages_[i].data_ = frame_memory_.frame(i);
+    }
+    if (num_partitions == 0) {
+        num_partitions = std::min(MAX_PARTITIONS, pool_size_ / MIN_FRAMES_PER_PARTITION);
+    }
+    num_partitions = std::max<size_t>(1, std::min(num_partitions, std::max<size_t>(1, pool_size_)));
+
+    /* Every node gets the same number of partitions */
+    if (frame_options.numa) {
+        const auto nodes = std::min<size_t>(static_cast<size_t>(FrameMemory::numa_node_count()),
+                                            std::max<size_t>(1, pool_size_));
+        num_partitions = std::max(nodes, num_partitions / nodes * nodes);
+        numa_nodes_ = static_cast<int>(nodes);
+    }
+
+    /* Distribute frames as evenly as possible; the first (pool_size % n) partitions get one more */
+    const size_t base = pool_size_ / num_partitions;
+    const size_t extra = pool_size_ % num_partitions;
+    size_t next_frame = 0;
+    partitions_.reserve(num_partitions);
+    for (size_t p = 0; p < num_partitions; ++p) {
+        const size_t frames = base + (p < extra ? 1 : 0);
+        auto part =
+            std::make_unique<Partition>(policy_, frames, static_cast<uint32_t>(next_frame));
+        if (numa_nodes_ > 1) {
+            /* Nothing has touched the frames yet, so the policy decides where they land */
+            part->numa_node =
+                static_cast<int>(p * static_cast<size_t>(numa_nodes_) / num_partitions);
+            static_cast<void>(frame_memory_.bind(next_frame, frames, part->numa_node));
+        }
+        for (size_t i = 0; i < frames; ++i) {
+            part->free_list.push_back(static_cast<uint32_t>(next_frame++));
+        }
+        partitions_.push_back(std::move(part));
     }
+    register_metrics();
 }
 
 BufferPoolManager::~BufferPoolManager() {
+    stop_background_writer();
+    {
+        const std::scoped_lock<std::mutex> lock(prefetch_latch_);
+        prefetch_stop_ = true;
+    }
+    prefetch_cv_.notify_all();
+    if (prefetch_thread_.joinable()) {
+        prefetch_thread_.join();
+    }
+
     try {
         flush_all_pages();
     } catch (const std::exception& e) {
@@ -43,57 +113,132 @@ BufferPoolManager::~BufferPoolManager() {
     }
 }
 
-Page* BufferPoolManager::fetch_page(const std::string& file_name, uint32_t page_id) {
-    const std::scoped_lock<std::mutex> lock(latch_);
+BufferPoolManager::Partition& BufferPoolManager::partition_for(uint64_t key) const {
+    if (partitions_.size() == 1) {
+        return *partitions_[0];
+    }
+    const uint64_t mixed = (key * PARTITION_HASH_MULTIPLIER) >> PARTITION_HASH_SHIFT;
+    return *partitions_[mixed % partitions_.size()];
+}
 
-    const std::string key = make_page_key(file_name, page_id);
-    if (page_table_.find(key) != page_table_.end()) {
-        const uint32_t frame_id = page_table_[key];
+bool BufferPoolManager::acquire_frame(Partition& part, uint32_t* frame_id) {
+    if (!part.free_list.empty()) {
+        *frame_id = part.free_list.back();
+        part.free_list.pop_back();
+        return true;
+    }
+    Page* page = nullptr;
+    while (page == nullptr) {
+        if (!part.replacer->victim(frame_id)) {
+            return false;
+        }
+        /* A frame being written in the background goes back to the replacer when released */
+        if (pages_[*frame_id].pin_count_ == 0) {
+            page = &pages_[*frame_id];
+        }
+    }
+
+    static_cast<void>(stats_.evictions.fetch_add(1, std::memory_order_relaxed));
+    if (page->is_dirty_) {
+        static_cast<void>(stats_.dirty_evictions.fetch_add(1, std::memory_order_relaxed));
+        static_cast<void>(write_back(page));
+    }
+
+    const auto it = part.page_table.find(make_page_key(page->file_id_, page->page_id_));
+    if (it != part.page_table.end() && it->second == *frame_id) {
+        part.page_table.erase(it);
+    }
+    return true;
+}
+
+Page* BufferPoolManager::fetch_page(const std::string& file_name, uint32_t page_id,
+                                    AccessType access) {
+    const uint32_t file_id = storage_manager_.get_file_id(file_name);
+    const uint64_t key = make_page_key(file_id, page_id);
+    Partition& part = partition_for(key);
+    std::unique_lock<std::mutex> lock(part.latch);
+
+    const auto it = part.page_table.find(key);
+    if (it != part.page_table.end()) {
+        const uint32_t frame_id = it->second;
         Page* const page = &pages_[frame_id];
         page->pin_count_++;
-        replacer_.pin(frame_id);
+        if (access == AccessType::Normal) {
+            page->scan_only_ = false;
+        }
+        if (page->prefetched_) {
+            page->prefetched_ = false;
+            static_cast<void>(stats_.prefetch_hits.fetch_add(1, std::memory_order_relaxed));
+        }
+        part.replacer->pin(frame_id);
+        static_cast<void>(stats_.hits.fetch_add(1, std::memory_order_relaxed));
+        thread_io_counters().buffer_hits++;
+
+        if (page->io_pending_.load(std::memory_order_acquire)) {
+            /* Read-ahead holds the write latch until its I/O lands */
+            lock.unlock();
+            page->r_lock();
+            page->r_unlock();
+        }
         return page;
     }
 
+    static_cast<void>(stats_.misses.fetch_add(1, std::memory_order_relaxed));
+    thread_io_counters().buffer_misses++;
     uint32_t frame_id = 0;
-    if (!free_list_.empty()) {
-        frame_id = free_list_.back();
-        free_list_.pop_back();
-    } else if (!replacer_.victim(&frame_id)) {
+    if (!acquire_frame(part, &frame_id)) {
         return nullptr;
     }
 
     Page* const page = &pages_[frame_id];
-    if (page->is_dirty_) {
-        storage_manager_.write_page(page->file_name_, page->page_id_, page->get_data());
-    }
-
-    page_table_.erase(make_page_key(page->file_name_, page->page_id_));
-    page_table_[key] = frame_id;
+    part.page_table[key] = frame_id;
 
     page->page_id_ = page_id;
     page->file_name_ = file_name;
+    page->file_id_ = file_id;
     page->pin_count_ = 1;
     page->is_dirty_ = false;
+    page->scan_only_ = (access == AccessType::Scan);
+    reset_lsns(page);
 
     if (!storage_manager_.read_page(file_name, page_id, page->get_data())) {
         // If read fails (e.g. file too short), initialize with zeros
-        std::memset(page->get_data(), 0, Page::PAGE_SIZE);
+        std::memset(page->get_data(), 0, page_size());
     }
 
-    replacer_.pin(frame_id);
+    part.replacer->pin(frame_id);
     return page;
 }
 
+ReadPageGuard BufferPoolManager::fetch_page_read(const std::string& file_name, uint32_t page_id,
+                                                AccessType access) {
+    return {this, fetch_page(file_name, page_id, access)};
+}
+
+WritePageGuard BufferPoolManager::fetch_page_write(const std::string& file_name,
+                                                   uint32_t page_id) {
+    return {this, fetch_page(file_name, page_id)};
+}
+
 bool BufferPoolManager::unpin_page(const std::string& file_name, uint32_t page_id, bool is_dirty) {
-    const std::scoped_lock<std::mutex> lock(latch_);
+    return unpin_key(make_page_key(storage_manager_.get_file_id(file_name), page_id), is_dirty);
+}
 
-    const std::string key = make_page_key(file_name, page_id);
-    if (page_table_.find(key) == page_table_.end()) {
+bool BufferPoolManager::unpin_page(Page* page, bool is_dirty) {
+    /* The caller holds a pin, so the frame's identity cannot change underneath us */
+    return unpin_key(make_page_key(page->file_id_, page->page_id_), is_dirty);
+}
+
+bool BufferPoolManager::unpin_key(uint64_t key, bool is_dirty) {
+    Partition& part = partition_for(key);
+    const std::scoped_lock<std::mutex> lock(part.latch);
+
+    const auto it = part.page_table.find(key);
+    if (it == part.page_table.end()) {
         return false;
     }
 
-    const uint32_t frame_id = page_table_[key];
+    const uint32_t frame_id = it->second;
     Page* const page = &pages_[frame_id];
 
     if (page->pin_count_ <= 0) {
@@ -106,98 +251,516 @@ bool BufferPoolManager::unpin_page(const std::string& file_name, uint32_t page_i
 
     page->pin_count_--;
     if (page->pin_count_ == 0) {
-        replacer_.unpin(frame_id);
+        if (page->scan_only_) {
+            part.replacer->unpin_cold(frame_id);
+        } else {
+            part.replacer->unpin(frame_id);
+        }
     }
 
     return true;
 }
 
 bool BufferPoolManager::flush_page(const std::string& file_name, uint32_t page_id) {
-    const std::scoped_lock<std::mutex> lock(latch_);
+    const uint64_t key = make_page_key(storage_manager_.get_file_id(file_name), page_id);
+    Partition& part = partition_for(key);
+    const std::scoped_lock<std::mutex> lock(part.latch);
 
-    const std::string key = make_page_key(file_name, page_id);
-    if (page_table_.find(key) == page_table_.end()) {
+    const auto it = part.page_table.find(key);
+    if (it == part.page_table.end()) {
         return false;
     }
 
-    const uint32_t frame_id = page_table_[key];
-    Page* const page = &pages_[frame_id];
-    storage_manager_.write_page(file_name, page_id, page->get_data());
+    Page* const page = &pages_[it->second];
+    if (page->io_pending_.load(std::memory_order_acquire)) {
+        return true; /* Still being read in, so there is nothing newer than disk */
+    }
+    static_cast<void>(write_back(page));
     page->is_dirty_ = false;
 
     return true;
 }
 
 Page* BufferPoolManager::new_page(const std::string& file_name, const uint32_t* page_id) {
-    const std::scoped_lock<std::mutex> lock(latch_);
-
+    const uint32_t file_id = storage_manager_.get_file_id(file_name);
     const uint32_t target_page_id = storage_manager_.allocate_page(file_name);
     if (page_id != nullptr) {
         // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
         const_cast<uint32_t&>(*page_id) = target_page_id;
     }
-    const std::string key = make_page_key(file_name, target_page_id);
+    const uint64_t key = make_page_key(file_id, target_page_id);
+    Partition& part = partition_for(key);
+    const std::scoped_lock<std::mutex> lock(part.latch);
 
     uint32_t frame_id = 0;
-    if (!free_list_.empty()) {
-        frame_id = free_list_.back();
-        free_list_.pop_back();
-    } else if (!replacer_.victim(&frame_id)) {
+    if (!acquire_frame(part, &frame_id)) {
         return nullptr;
     }
 
     Page* const page = &pages_[frame_id];
-    if (page->is_dirty_) {
-        storage_manager_.write_page(page->file_name_, page->page_id_, page->get_data());
-    }
-
-    page_table_.erase(make_page_key(page->file_name_, page->page_id_));
-    page_table_[key] = frame_id;
+    part.page_table[key] = frame_id;
 
     page->page_id_ = target_page_id;
     page->file_name_ = file_name;
+    page->file_id_ = file_id;
     page->pin_count_ = 1;
     page->is_dirty_ = false;
-    std::memset(page->get_data(), 0, Page::PAGE_SIZE);
+    page->scan_only_ = false;
+    reset_lsns(page);
+    std::memset(page->get_data(), 0, page_size());
 
-    replacer_.pin(frame_id);
+    part.replacer->pin(frame_id);
     return page;
 }
 
 bool BufferPoolManager::delete_page(const std::string& file_name, uint32_t page_id) {
-    const std::scoped_lock<std::mutex> lock(latch_);
+    const uint64_t key = make_page_key(storage_manager_.get_file_id(file_name), page_id);
+    Partition& part = partition_for(key);
+    {
+        const std::scoped_lock<std::mutex> lock(part.latch);
+
+        const auto it = part.page_table.find(key);
+        if (it != part.page_table.end()) {
+            const uint32_t frame_id = it->second;
+            Page* const page = &pages_[frame_id];
+            if (page->pin_count_ > 0) {
+                return false;
+            }
+
+            part.page_table.erase(it);
+            part.replacer->remove(frame_id);
+            page->page_id_ = 0;
+            page->file_name_ = "";
+            page->file_id_ = StorageManager::INVALID_FILE_ID;
+            page->pin_count_ = 0;
+            page->is_dirty_ = false;
+            page->scan_only_ = false;
+            part.free_list.push_back(frame_id);
+        }
+    }
 
-    const std::string key = make_page_key(file_name, page_id);
-    if (page_table_.find(key) != page_table_.end()) {
-        const uint32_t frame_id = page_table_[key];
-        Page* const page = &pages_[frame_id];
-        if (page->pin_count_ > 0) {
-            return false;
+    StorageManager::deallocate_page(file_name, page_id);
+    return true;
+}
+
+void BufferPoolManager::prefetch_pages(const std::string& file_name, uint32_t first_page,
+                                       uint32_t count) {
+    count = static_cast<uint32_t>(
+        std::min<size_t>(count, std::max<size_t>(1, pool_size_ / PREFETCH_POOL_FRACTION)));
+    if (count == 0) {
+        return;
+    }
+
+    {
+        const std::scoped_lock<std::mutex> lock(prefetch_latch_);
+        if (prefetch_stop_ || prefetch_queue_.size() >= MAX_PREFETCH_QUEUE) {
+            return;
+        }
+        prefetch_queue_.push_back({file_name, first_page, count});
+        if (!prefetch_thread_.joinable()) {
+            prefetch_thread_ = std::thread([this] { prefetch_worker(); });
+        }
+    }
+    prefetch_cv_.notify_one();
+}
+
+void BufferPoolManager::wait_for_prefetch() {
+    std::unique_lock<std::mutex> lock(prefetch_latch_);
+    prefetch_idle_cv_.wait(lock, [this] { return prefetch_queue_.empty() && prefetch_active_ == 0; });
+}
+
+void BufferPoolManager::prefetch_worker() {
+    std::unique_lock<std::mutex> lock(prefetch_latch_);
+    while (true) {
+        prefetch_cv_.wait(lock, [this] { return prefetch_stop_ || !prefetch_queue_.empty(); });
+        if (prefetch_stop_) {
+            prefetch_queue_.clear();
+            prefetch_idle_cv_.notify_all();
+            return;
+        }
+
+        const PrefetchRequest request = std::move(prefetch_queue_.front());
+        prefetch_queue_.pop_front();
+        prefetch_active_++;
+        lock.unlock();
+
+        read_ahead(request);
+
+        lock.lock();
+        prefetch_active_--;
+        if (prefetch_queue_.empty() && prefetch_active_ == 0) {
+            prefetch_idle_cv_.notify_all();
         }
+    }
+}
 
-        page_table_.erase(key);
-        replacer_.pin(frame_id);
-        page->page_id_ = 0;
-        page->file_name_ = "";
-        page->pin_count_ = 0;
+void BufferPoolManager::read_ahead(const PrefetchRequest& request) {
+    const uint32_t file_id = storage_manager_.get_file_id(request.file_name);
+    const uint32_t file_pages = storage_manager_.page_count(request.file_name);
+    const uint64_t end = std::min<uint64_t>(
+        static_cast<uint64_t>(request.first_page) + request.count, file_pages);
+
+    /* Claim frames first; each stays pinned and write-latched until its read completes */
+    std::vector<StorageManager::PageIo> batch;
+    std::vector<Page*> loading;
+    for (uint64_t page_num = request.first_page; page_num < end; ++page_num) {
+        const auto page_id = static_cast<uint32_t>(page_num);
+        const uint64_t key = make_page_key(file_id, page_id);
+        Partition& part = partition_for(key);
+        const std::scoped_lock<std::mutex> lock(part.latch);
+
+        if (part.page_table.find(key) != part.page_table.end()) {
+            continue;
+        }
+        uint32_t frame_id = 0;
+        if (!acquire_frame(part, &frame_id)) {
+            continue; /* Partition fully pinned; the reader will fetch this page itself */
+        }
+
+        Page* const page = &pages_[frame_id];
+        page->w_lock();
+        page->io_pending_.store(true, std::memory_order_relaxed);
+        part.page_table[key] = frame_id;
+        page->page_id_ = page_id;
+        page->file_name_ = request.file_name;
+        page->file_id_ = file_id;
+        page->pin_count_ = 1;
         page->is_dirty_ = false;
-        free_list_.push_back(frame_id);
+        page->scan_only_ = true;
+        page->prefetched_ = true;
+        reset_lsns(page);
+        part.replacer->pin(frame_id);
+
+        StorageManager::PageIo io;
+        io.op = IoRequest::Op::Read;
+        io.filename = request.file_name;
+        io.page_num = page_id;
+        io.buffer = page->get_data();
+        batch.push_back(std::move(io));
+        loading.push_back(page);
     }
 
-    StorageManager::deallocate_page(file_name, page_id);
-    return true;
+    static_cast<void>(storage_manager_.submit_batch(batch));
+
+    for (size_t i = 0; i < loading.size(); ++i) {
+        Page* const page = loading[i];
+        if (!batch[i].ok) {
+            std::memset(page->get_data(), 0, page_size());
+        }
+        page->io_pending_.store(false, std::memory_order_release);
+        page->w_unlock();
+
+        /* Unpin to the hot end so later read-ahead does not evict pages not yet scanned */
+        const uint64_t key = make_page_key(page->file_id_, page->page_id_);
+        Partition& part = partition_for(key);
+        const std::scoped_lock<std::mutex> lock(part.latch);
+        page->pin_count_--;
+        if (page->pin_count_ == 0) {
+            part.replacer->unpin(static_cast<uint32_t>(page - pages_.get()));
+        }
+    }
+    static_cast<void>(stats_.prefetched.fetch_add(loading.size(), std::memory_order_relaxed));
 }
 
 void BufferPoolManager::flush_all_pages() {
-    const std::scoped_lock<std::mutex> lock(latch_);
+    std::vector<StorageManager::PageIo> batch;
+    std::vector<Page*> flushed;
+    std::vector<int32_t> rec_lsns;
+    int32_t durable_lsn = -1;
+    for (const auto& part : partitions_) {
+        const std::scoped_lock<std::mutex> lock(part->latch);
+
+        /* Write back each partition's dirty pages in one backend submission */
+        batch.clear();
+        flushed.clear();
+        rec_lsns.clear();
+        for (auto const& [key, frame_id] : part->page_table) {
+            Page* const page = &pages_[frame_id];
+            if (page->is_dirty_) {
+                durable_lsn = std::max(durable_lsn, page->get_lsn());
+                rec_lsns.push_back(page->get_rec_lsn());
+                StorageManager::PageIo io;
+                io.op = IoRequest::Op::Write;
+                io.filename = page->file_name_;
+                io.page_num = page->page_id_;
+                io.buffer = page->get_data();
+                batch.push_back(std::move(io));
+                flushed.push_back(page);
+            }
+        }
 
-    for (auto const& [key, frame_id] : page_table_) {
+        /* WAL rule: the log covers every change in the batch before any of it is written */
+        if (log_manager_ != nullptr && durable_lsn > log_manager_->get_persistent_lsn()) {
+            static_cast<void>(log_manager_->wait_durable(durable_lsn, true));
+        }
+        static_cast<void>(storage_manager_.submit_batch(batch));
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (batch[i].ok) {
+                flushed[i]->is_dirty_ = false;
+                mark_written(flushed[i], rec_lsns[i]);
+            }
+        }
+    }
+}
+
+void BufferPoolManager::start_background_writer(const WriterOptions& options) {
+    stop_background_writer();
+    const std::scoped_lock<std::mutex> lock(writer_latch_);
+    writer_options_ = options;
+    writer_stop_ = false;
+    writer_thread_ = std::thread([this] { background_writer(); });
+}
+
+void BufferPoolManager::register_metrics() {
+    static std::atomic<uint64_t> next_pool{0};
+    const std::string pool = common::metric_label("pool", std::to_string(next_pool++));
+    auto collect = [this, pool](common::MetricsSnapshot& out) {
+        const auto value = [](const std::atomic<uint64_t>& v) {
+            return static_cast<double>(v.load(std::memory_order_relaxed));
+        };
+        const double hits = value(stats_.hits);
+        const double misses = value(stats_.misses);
+        out.add_gauge("cloudsql_buffer_pool_frames", "Frames in the buffer pool",
+                      static_cast<double>(pool_size_), pool);
+        out.add_gauge("cloudsql_buffer_pool_frame_memory_bytes", "Bytes mapped for frame data",
+                      static_cast<double>(frame_memory_.mapped_bytes()),
+                      pool + "," +
+                          common::metric_label("backing", frame_backing_name(frame_backing())));
+        out.add_counter("cloudsql_buffer_pool_hits_total", "Page fetches served from a frame",
+                        hits, pool);
+        out.add_counter("cloudsql_buffer_pool_misses_total", "Page fetches that read the page",
+                        misses, pool);
+        out.add_gauge("cloudsql_buffer_pool_hit_ratio", "Hits over all page fetches",
+                      hits + misses == 0 ? 0.0 : hits / (hits + misses), pool);
+        out.add_counter("cloudsql_buffer_pool_evictions_total", "Pages evicted from a frame",
+                        value(stats_.evictions), pool);
+        out.add_counter("cloudsql_buffer_pool_dirty_evictions_total",
+                        "Evicted pages written back first", value(stats_.dirty_evictions), pool);
+        out.add_counter("cloudsql_buffer_pool_prefetched_total", "Pages loaded by read-ahead",
+                        value(stats_.prefetched), pool);
+        out.add_counter("cloudsql_buffer_pool_prefetch_hits_total",
+                        "Read-ahead pages later fetched", value(stats_.prefetch_hits), pool);
+        out.add_counter("cloudsql_buffer_pool_background_writes_total",
+                        "Pages written by the background writer", value(stats_.background_writes),
+                        pool);
+        out.add_counter("cloudsql_buffer_pool_checkpoint_writes_total",
+                        "Pages written by checkpoints", value(stats_.checkpoint_writes), pool);
+    };
+    metrics_ = common::MetricsRegistry::global().add_collector(std::move(collect));
+}
+
+void BufferPoolManager::stop_background_writer() {
+    {
+        const std::scoped_lock<std::mutex> lock(writer_latch_);
+        if (!writer_thread_.joinable()) {
+            return;
+        }
+        writer_stop_ = true;
+    }
+    writer_cv_.notify_all();
+    writer_thread_.join();
+}
+
+void BufferPoolManager::background_writer() {
+    std::unique_lock<std::mutex> lock(writer_latch_);
+    const WriterOptions options = writer_options_;
+    const size_t per_partition =
+        (options.clean_target + partitions_.size() - 1) / partitions_.size();
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> claimed;
+    size_t next_part = 0;
+
+    while (!writer_cv_.wait_for(lock, options.interval, [this] { return writer_stop_; })) {
+        lock.unlock();
+
+        /* Rotate the starting partition so a small budget still reaches all of them */
+        size_t budget = options.max_pages;
+        for (size_t n = 0; n < partitions_.size() && budget > 0; ++n) {
+            Partition& part = *partitions_[(next_part + n) % partitions_.size()];
+            claimed.clear();
+            {
+                const std::scoped_lock<std::mutex> part_lock(part.latch);
+                size_t clean = part.free_list.size();
+                if (clean >= per_partition) {
+                    continue;
+                }
+                candidates.clear();
+                part.replacer->peek_victims(per_partition - clean, &candidates);
+                for (const uint32_t frame_id : candidates) {
+                    if (!pages_[frame_id].is_dirty_) {
+                        clean++;
+                    } else if (claimed.size() < budget && claim_for_write(frame_id)) {
+                        claimed.push_back(frame_id);
+                    }
+                }
+            }
+            budget -= claimed.size();
+            static_cast<void>(stats_.background_writes.fetch_add(write_claimed(part, claimed),
+                                                                 std::memory_order_relaxed));
+        }
+        next_part = (next_part + 1) % partitions_.size();
+
+        lock.lock();
+    }
+}
+
+size_t BufferPoolManager::flush_dirty_pages(int32_t max_rec_lsn,
+                                            std::chrono::milliseconds spread) {
+    /* Snapshot what is due now; pages dirtied later belong to the next checkpoint */
+    std::vector<std::vector<uint32_t>> due(partitions_.size());
+    size_t total = 0;
+    for (size_t p = 0; p < partitions_.size(); ++p) {
+        const std::scoped_lock<std::mutex> lock(partitions_[p]->latch);
+        for (auto const& [key, frame_id] : partitions_[p]->page_table) {
+            const int32_t rec_lsn = pages_[frame_id].get_rec_lsn();
+            if (rec_lsn >= 0 && rec_lsn <= max_rec_lsn) {
+                due[p].push_back(frame_id);
+            }
+        }
+        total += due[p].size();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    size_t visited = 0;
+    size_t written = 0;
+    std::vector<uint32_t> claimed;
+    for (size_t p = 0; p < partitions_.size(); ++p) {
+        Partition& part = *partitions_[p];
+        for (size_t i = 0; i < due[p].size(); i += CHECKPOINT_BATCH) {
+            const size_t end = std::min(due[p].size(), i + CHECKPOINT_BATCH);
+            claimed.clear();
+            {
+                const std::scoped_lock<std::mutex> lock(part.latch);
+                for (size_t j = i; j < end; ++j) {
+                    /* The frame may have been written or reused since the snapshot */
+                    const int32_t rec_lsn = pages_[due[p][j]].get_rec_lsn();
+                    if (rec_lsn >= 0 && rec_lsn <= max_rec_lsn && claim_for_write(due[p][j])) {
+                        claimed.push_back(due[p][j]);
+                    }
+                }
+            }
+            written += write_claimed(part, claimed);
+            visited += end - i;
+
+            /* Stay on a straight line from start to start + spread */
+            std::this_thread::sleep_until(start + spread * visited / total);
+        }
+    }
+    static_cast<void>(stats_.checkpoint_writes.fetch_add(written, std::memory_order_relaxed));
+    return written;
+}
+
+bool BufferPoolManager::claim_for_write(uint32_t frame_id) {
+    Page* const page = &pages_[frame_id];
+    if (page->pin_count_ > 0 || !page->is_dirty_ ||
+        page->io_pending_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    page->pin_count_++;
+    return true;
+}
+
+size_t BufferPoolManager::write_claimed(Partition& part, const std::vector<uint32_t>& frames) {
+    if (frames.empty()) {
+        return 0;
+    }
+
+    /*
+     * A shared page latch keeps writers out while the page is copied to disk. Only try it:
+     * a page someone is changing is not worth waiting for, and blocking here while holding
+     * other pages' latches could deadlock with a writer that latches several pages.
+     */
+    std::vector<StorageManager::PageIo> batch;
+    std::vector<Page*> latched;
+    std::vector<int32_t> rec_lsns;
+    int32_t durable_lsn = -1;
+    for (const uint32_t frame_id : frames) {
         Page* const page = &pages_[frame_id];
-        if (page->is_dirty_) {
-            storage_manager_.write_page(page->file_name_, page->page_id_, page->get_data());
-            page->is_dirty_ = false;
+        if (!page->rwlatch_.try_lock_shared()) {
+            continue;
+        }
+        durable_lsn = std::max(durable_lsn, page->get_lsn());
+        rec_lsns.push_back(page->get_rec_lsn());
+        StorageManager::PageIo io;
+        io.op = IoRequest::Op::Write;
+        io.filename = page->file_name_;
+        io.page_num = page->page_id_;
+        io.buffer = page->get_data();
+        batch.push_back(std::move(io));
+        latched.push_back(page);
+    }
+
+    /* WAL rule: the log covers every change in the batch before any of it is written */
+    if (log_manager_ != nullptr && durable_lsn > log_manager_->get_persistent_lsn()) {
+        static_cast<void>(log_manager_->wait_durable(durable_lsn, true));
+    }
+    static_cast<void>(storage_manager_.submit_batch(batch));
+
+    size_t written = 0;
+    {
+        const std::scoped_lock<std::mutex> lock(part.latch);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (batch[i].ok) {
+                latched[i]->is_dirty_ = false;
+                mark_written(latched[i], rec_lsns[i]);
+                written++;
+            }
+        }
+        for (const uint32_t frame_id : frames) {
+            Page* const page = &pages_[frame_id];
+            page->pin_count_--;
+            if (page->pin_count_ == 0) {
+                /* No-op unless a fetch or an eviction attempt took it out meanwhile */
+                if (page->scan_only_) {
+                    part.replacer->unpin_cold(frame_id);
+                } else {
+                    part.replacer->unpin(frame_id);
+                }
+            }
         }
     }
+    for (Page* const page : latched) {
+        page->r_unlock();
+    }
+    return written;
+}
+
+std::vector<BufferPoolManager::DirtyPage> BufferPoolManager::dirty_page_table() const {
+    std::vector<DirtyPage> pages;
+    for (const auto& part : partitions_) {
+        const std::scoped_lock<std::mutex> lock(part->latch);
+        for (auto const& [key, frame_id] : part->page_table) {
+            const Page& page = pages_[frame_id];
+            const int32_t rec_lsn = page.get_rec_lsn();
+            if (rec_lsn >= 0) {
+                pages.push_back({page.file_name_, page.page_id_, rec_lsn});
+            }
+        }
+    }
+    return pages;
+}
+
+bool BufferPoolManager::write_back(Page* page) {
+    /* WAL rule: no change reaches the data file before its log record */
+    const int32_t lsn = page->get_lsn();
+    if (log_manager_ != nullptr && lsn > log_manager_->get_persistent_lsn()) {
+        static_cast<void>(log_manager_->wait_durable(lsn, true));
+    }
+    const int32_t rec_lsn = page->get_rec_lsn();
+    if (!storage_manager_.write_page(page->file_name_, page->page_id_, page->get_data())) {
+        return false;
+    }
+    mark_written(page, rec_lsn);
+    return true;
+}
+
+void BufferPoolManager::mark_written(Page* page, int32_t rec_lsn) {
+    static_cast<void>(page->rec_lsn_.compare_exchange_strong(rec_lsn, -1));
+}
+
+void BufferPoolManager::reset_lsns(Page* page) {
+    page->lsn_.store(-1, std::memory_order_relaxed);
+    page->rec_lsn_.store(-1, std::memory_order_relaxed);
 }
 
 }  // namespace cloudsql::storage
@@ -0,0 +1,152 @@
+/**
+ * @file clock_replacer.cpp
+ * @brief CLOCK replacement policy implementation
+ */
+
+#include "storage/clock_replacer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace cloudsql::storage {
+
+ClockReplacer::ClockReplacer(size_t num_frames, uint32_t first_frame)
+    : num_frames_(num_frames),
+      first_frame_(first_frame),
+      present_(num_frames, false),
+      reference_(num_frames, false),
+      cold_(num_frames, false) {}
+
+bool ClockReplacer::victim(uint32_t* frame_id) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+
+    if (count_ == 0) {
+        return false;
+    }
+
+    /* Scan-only frames go first; stale queue entries were re-pinned since */
+    while (!cold_queue_.empty()) {
+        const uint32_t idx = cold_queue_.front();
+        cold_queue_.pop_front();
+        if (present_[idx] && cold_[idx]) {
+            present_[idx] = false;
+            cold_[idx] = false;
+            count_--;
+            *frame_id = first_frame_ + idx;
+            return true;
+        }
+    }
+
+    /* Two full sweeps are enough: the first clears every reference bit */
+    for (size_t step = 0; step < 2 * num_frames_; ++step) {
+        const size_t idx = hand_;
+        hand_ = (hand_ + 1) % num_frames_;
+        if (!present_[idx]) {
+            continue;
+        }
+        if (reference_[idx]) {
+            reference_[idx] = false;
+            continue;
+        }
+        present_[idx] = false;
+        count_--;
+        *frame_id = first_frame_ + static_cast<uint32_t>(idx);
+        return true;
+    }
+    return false;
+}
+
+void ClockReplacer::pin(uint32_t frame_id) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+
+    if (!owns(frame_id)) {
+        return;
+    }
+    const size_t idx = frame_id - first_frame_;
+    if (present_[idx]) {
+        present_[idx] = false;
+        count_--;
+    }
+    cold_[idx] = false;
+}
+
+void ClockReplacer::unpin(uint32_t frame_id) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+
+    if (!owns(frame_id)) {
+        return;
+    }
+    const size_t idx = frame_id - first_frame_;
+    if (present_[idx]) {
+        return;
+    }
+    present_[idx] = true;
+    reference_[idx] = true;
+    count_++;
+}
+
+void ClockReplacer::unpin_cold(uint32_t frame_id) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+
+    if (!owns(frame_id)) {
+        return;
+    }
+    const size_t idx = frame_id - first_frame_;
+    if (present_[idx]) {
+        return;
+    }
+    present_[idx] = true;
+    reference_[idx] = false;
+    cold_[idx] = true;
+    count_++;
+
+    /* Re-pinned frames leave stale entries behind; compact before the queue outgrows the pool */
+    if (cold_queue_.size() >= 2 * num_frames_) {
+        std::deque<uint32_t> live;
+        for (const uint32_t entry : cold_queue_) {
+            if (present_[entry] && cold_[entry]) {
+                live.push_back(entry);
+            }
+        }
+        cold_queue_.swap(live);
+    }
+    cold_queue_.push_back(static_cast<uint32_t>(idx));
+}
+
+void ClockReplacer::peek_victims(size_t max_frames, std::vector<uint32_t>* frames) const {
+    const std::scoped_lock<std::mutex> lock(latch_);
+
+    /* Same order as victim(): live cold entries, then the hand's sweep, unreferenced first */
+    std::vector<bool> taken(num_frames_, false);
+    for (const uint32_t idx : cold_queue_) {
+        if (frames->size() >= max_frames) {
+            return;
+        }
+        if (present_[idx] && cold_[idx] && !taken[idx]) {
+            taken[idx] = true;
+            frames->push_back(first_frame_ + idx);
+        }
+    }
+    for (const bool referenced : {false, true}) {
+        for (size_t step = 0; step < num_frames_; ++step) {
+            if (frames->size() >= max_frames) {
+                return;
+            }
+            const size_t idx = (hand_ + step) % num_frames_;
+            if (present_[idx] && !taken[idx] && reference_[idx] == referenced) {
+                taken[idx] = true;
+                frames->push_back(first_frame_ + static_cast<uint32_t>(idx));
+            }
+        }
+    }
+}
+
+size_t ClockReplacer::size() const {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    return count_;
+}
+
+}  // namespace cloudsql::storage
@@ -0,0 +1,546 @@
+/**
+ * @file column_encoding.cpp
+ * @brief Column chunk encoders and decoders
+ */
+
+#include "storage/column_encoding.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cloudsql::storage {
+
+namespace {
+
+constexpr size_t VALUE_SIZE = sizeof(int64_t);
+constexpr size_t RUN_SIZE = sizeof(int64_t) + sizeof(uint32_t);
+constexpr size_t LENGTH_SIZE = sizeof(uint32_t);
+constexpr unsigned MAX_WIDTH = 64;
+
+unsigned bit_width(uint64_t max_value) {
+    unsigned width = 0;
+    while (max_value != 0) {
+        width++;
+        max_value >>= 1U;
+    }
+    return width;
+}
+
+size_t packed_bytes(size_t count, unsigned width) {
+    return (count * width + 7) / 8;
+}
+
+template <typename T>
+void append_raw(std::string* out, const T& value) {
+    out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T load_raw(const char* data) {
+    T value{};
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+/* Pack `count` values of `width` bits each, least significant bit first */
+void pack_bits(const std::vector<uint64_t>& values, unsigned width, std::string* out) {
+    const size_t start = out->size();
+    out->resize(start + packed_bytes(values.size(), width), '\0');
+    if (width == 0) {
+        return;
+    }
+    auto* const bytes = reinterpret_cast<uint8_t*>(&(*out)[start]);
+    uint64_t bit = 0;
+    for (uint64_t value : values) {
+        unsigned left = width;
+        while (left > 0) {
+            const size_t byte = bit / 8;
+            const unsigned shift = bit % 8;
+            const unsigned take = std::min(8U - shift, left);
+            bytes[byte] = static_cast<uint8_t>(bytes[byte] | ((value << shift) & 0xFFU));
+            value = take < MAX_WIDTH ? value >> take : 0;
+            left -= take;
+            bit += take;
+        }
+    }
+}
+
+/* Read packed value `index`; the caller has checked that the packed area is complete */
+uint64_t unpack_at(const uint8_t* bytes, size_t size, size_t index, unsigned width) {
+    if (width == 0) {
+        return 0;
+    }
+    const uint64_t bit = static_cast<uint64_t>(index) * width;
+    const size_t byte = bit / 8;
+    const unsigned shift = bit % 8;
+
+    uint8_t window[VALUE_SIZE + 1] = {};
+    std::memcpy(window, &bytes[byte], std::min(sizeof(window), size - byte));
+    uint64_t value = load_raw<uint64_t>(reinterpret_cast<const char*>(window)) >> shift;
+    if (shift != 0 && shift + width > MAX_WIDTH) {
+        value |= static_cast<uint64_t>(window[VALUE_SIZE]) << (MAX_WIDTH - shift);
+    }
+    return width < MAX_WIDTH ? value & ((uint64_t{1} << width) - 1) : value;
+}
+
+struct PackedArea {
+    const uint8_t* bytes = nullptr;
+    size_t size = 0;
+    unsigned width = 0;
+};
+
+/* Parse a width byte followed by `count` packed values starting at `data + offset` */
+bool read_packed_area(const char* data, size_t size, size_t offset, size_t count,
+                      PackedArea* area) {
+    if (offset + 1 > size) {
+        return false;
+    }
+    area->width = static_cast<uint8_t>(data[offset]);
+    area->bytes = reinterpret_cast<const uint8_t*>(data + offset + 1);
+    area->size = size - offset - 1;
+    return area->width <= MAX_WIDTH && packed_bytes(count, area->width) <= area->size;
+}
+
+size_t count_runs(const int64_t* values, size_t count) {
+    size_t runs = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (i == 0 || values[i] != values[i - 1]) {
+            runs++;
+        }
+    }
+    return runs;
+}
+
+/**
+ * @brief Reads the entries of a Dictionary string chunk
+ * @param[out] offset Where the packed codes begin
+ */
+bool read_dictionary(const char* data, size_t size,
+                     std::vector<std::pair<const char*, uint32_t>>* entries, size_t* offset) {
+    if (size < LENGTH_SIZE) {
+        return false;
+    }
+    const auto entry_count = load_raw<uint32_t>(data);
+    entries->reserve(entry_count);
+    *offset = LENGTH_SIZE;
+    for (uint32_t e = 0; e < entry_count; ++e) {
+        if (*offset + LENGTH_SIZE > size) {
+            return false;
+        }
+        const auto length = load_raw<uint32_t>(data + *offset);
+        *offset += LENGTH_SIZE;
+        if (*offset + length > size) {
+            return false;
+        }
+        entries->emplace_back(data + *offset, length);
+        *offset += length;
+    }
+    return true;
+}
+
+}  // namespace
+
+const char* column_encoding_name(ColumnEncoding encoding) {
+    switch (encoding) {
+        case ColumnEncoding::Plain:
+            return "plain";
+        case ColumnEncoding::Rle:
+            return "rle";
+        case ColumnEncoding::BitPacked:
+            return "bitpacked";
+        case ColumnEncoding::Delta:
+            return "delta";
+        case ColumnEncoding::Dictionary:
+            return "dictionary";
+        default:
+            return "unknown";
+    }
+}
+
+ColumnEncoding encode_int_chunk(const int64_t* values, size_t count, std::string* out) {
+    if (count == 0) {
+        return ColumnEncoding::Plain;
+    }
+
+    /* Size every candidate first; only the winner is materialised */
+    const auto [min_it, max_it] = std::minmax_element(values, values + count);
+    const int64_t min_value = *min_it;
+    const unsigned for_width =
+        bit_width(static_cast<uint64_t>(*max_it) - static_cast<uint64_t>(min_value));
+
+    /* Deltas wrap in unsigned arithmetic, so any int64 sequence is representable */
+    int64_t min_delta = 0;
+    int64_t max_delta = 0;
+    for (size_t i = 1; i < count; ++i) {
+        const auto delta =
+            static_cast<int64_t>(static_cast<uint64_t>(values[i]) -
+                                 static_cast<uint64_t>(values[i - 1]));
+        min_delta = i == 1 ? delta : std::min(min_delta, delta);
+        max_delta = i == 1 ? delta : std::max(max_delta, delta);
+    }
+    const unsigned delta_width =
+        bit_width(static_cast<uint64_t>(max_delta) - static_cast<uint64_t>(min_delta));
+
+    const size_t runs = count_runs(values, count);
+    const size_t plain_size = count * VALUE_SIZE;
+    const size_t for_size = VALUE_SIZE + 1 + packed_bytes(count, for_width);
+    const size_t rle_size = runs * RUN_SIZE;
+    const size_t delta_size = 2 * VALUE_SIZE + 1 + packed_bytes(count - 1, delta_width);
+
+    /* Ties go to the encoding that is cheaper to decode */
+    ColumnEncoding best = ColumnEncoding::Plain;
+    size_t best_size = plain_size;
+    const std::pair<ColumnEncoding, size_t> candidates[] = {{ColumnEncoding::BitPacked, for_size},
+                                                            {ColumnEncoding::Rle, rle_size},
+                                                            {ColumnEncoding::Delta, delta_size}};
+    for (const auto& [encoding, size] : candidates) {
+        if (size < best_size) {
+            best = encoding;
+            best_size = size;
+        }
+    }
+
+    out->reserve(out->size() + best_size);
+    switch (best) {
+        case ColumnEncoding::BitPacked: {
+            append_raw(out, min_value);
+            out->push_back(static_cast<char>(for_width));
+            std::vector<uint64_t> offsets(count);
+            for (size_t i = 0; i < count; ++i) {
+                offsets[i] = static_cast<uint64_t>(values[i]) - static_cast<uint64_t>(min_value);
+            }
+            pack_bits(offsets, for_width, out);
+            break;
+        }
+        case ColumnEncoding::Rle: {
+            size_t i = 0;
+            while (i < count) {
+                size_t j = i + 1;
+                while (j < count && values[j] == values[i]) {
+                    j++;
+                }
+                append_raw(out, values[i]);
+                append_raw(out, static_cast<uint32_t>(j - i));
+                i = j;
+            }
+            break;
+        }
+        case ColumnEncoding::Delta: {
+            append_raw(out, values[0]);
+            append_raw(out, min_delta);
+            out->push_back(static_cast<char>(delta_width));
+            std::vector<uint64_t> deltas(count - 1);
+            for (size_t i = 1; i < count; ++i) {
+                deltas[i - 1] = static_cast<uint64_t>(values[i]) -
+                                static_cast<uint64_t>(values[i - 1]) -
+                                static_cast<uint64_t>(min_delta);
+            }
+            pack_bits(deltas, delta_width, out);
+            break;
+        }
+        default:
+            out->append(reinterpret_cast<const char*>(values), plain_size);
+            break;
+    }
+    return best;
+}
+
+ColumnEncoding encode_string_chunk(const std::string* values, size_t count, std::string* out) {
+    std::unordered_map<std::string, uint32_t> dictionary;
+    std::vector<uint64_t> codes(count);
+    size_t plain_size = 0;
+    size_t entries_size = LENGTH_SIZE;
+    for (size_t i = 0; i < count; ++i) {
+        plain_size += LENGTH_SIZE + values[i].size();
+        const auto [it, inserted] =
+            dictionary.emplace(values[i], static_cast<uint32_t>(dictionary.size()));
+        if (inserted) {
+            entries_size += LENGTH_SIZE + values[i].size();
+        }
+        codes[i] = it->second;
+    }
+
+    const unsigned code_width = dictionary.empty() ? 0 : bit_width(dictionary.size() - 1);
+    const size_t dictionary_size = entries_size + 1 + packed_bytes(count, code_width);
+    if (dictionary_size >= plain_size) {
+        for (size_t i = 0; i < count; ++i) {
+            append_raw(out, static_cast<uint32_t>(values[i].size()));
+        }
+        for (size_t i = 0; i < count; ++i) {
+            out->append(values[i]);
+        }
+        return ColumnEncoding::Plain;
+    }
+
+    std::vector<const std::string*> entries(dictionary.size());
+    for (const auto& [value, code] : dictionary) {
+        entries[code] = &value;
+    }
+    append_raw(out, static_cast<uint32_t>(entries.size()));
+    for (const std::string* entry : entries) {
+        append_raw(out, static_cast<uint32_t>(entry->size()));
+        out->append(*entry);
+    }
+    out->push_back(static_cast<char>(code_width));
+    pack_bits(codes, code_width, out);
+    return ColumnEncoding::Dictionary;
+}
+
+bool decode_int_chunk(ColumnEncoding encoding, const char* data, size_t size, size_t rows,
+                      size_t begin, size_t count, int64_t* out) {
+    if (begin + count > rows) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
+
+    switch (encoding) {
+        case ColumnEncoding::Plain:
+            if (size < rows * VALUE_SIZE) {
+                return false;
+            }
+            std::memcpy(out, data + begin * VALUE_SIZE, count * VALUE_SIZE);
+            return true;
+
+        case ColumnEncoding::Rle: {
+            size_t row = 0;
+            size_t filled = 0;
+            for (size_t offset = 0; filled < count; offset += RUN_SIZE) {
+                if (offset + RUN_SIZE > size) {
+                    return false;
+                }
+                const auto value = load_raw<int64_t>(data + offset);
+                const auto length = load_raw<uint32_t>(data + offset + VALUE_SIZE);
+                const size_t run_end = row + length;
+                if (run_end > begin) {
+                    const size_t from = std::max(row, begin + filled);
+                    const size_t n = std::min(run_end - from, count - filled);
+                    std::fill_n(out + filled, n, value);
+                    filled += n;
+                }
+                row = run_end;
+            }
+            return true;
+        }
+
+        case ColumnEncoding::BitPacked: {
+            PackedArea area;
+            if (size < VALUE_SIZE || !read_packed_area(data, size, VALUE_SIZE, rows, &area)) {
+                return false;
+            }
+            const auto base = load_raw<uint64_t>(data);
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = static_cast<int64_t>(
+                    base + unpack_at(area.bytes, area.size, begin + i, area.width));
+            }
+            return true;
+        }
+
+        case ColumnEncoding::Delta: {
+            PackedArea area;
+            if (size < 2 * VALUE_SIZE ||
+                !read_packed_area(data, size, 2 * VALUE_SIZE, rows - 1, &area)) {
+                return false;
+            }
+            /* Values are a running sum, so rows before `begin` still have to be walked */
+            auto value = load_raw<uint64_t>(data);
+            const auto min_delta = load_raw<uint64_t>(data + VALUE_SIZE);
+            for (size_t i = 0; i < begin + count; ++i) {
+                if (i > 0) {
+                    value += unpack_at(area.bytes, area.size, i - 1, area.width) + min_delta;
+                }
+                if (i >= begin) {
+                    out[i - begin] = static_cast<int64_t>(value);
+                }
+            }
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+bool decode_string_chunk(ColumnEncoding encoding, const char* data, size_t size, size_t rows,
+                         size_t begin, size_t count, std::string* out) {
+    if (begin + count > rows) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
+
+    if (encoding == ColumnEncoding::Plain) {
+        if (size < rows * LENGTH_SIZE) {
+            return false;
+        }
+        size_t offset = rows * LENGTH_SIZE;
+        for (size_t i = 0; i < begin + count; ++i) {
+            const auto length = load_raw<uint32_t>(data + i * LENGTH_SIZE);
+            if (offset + length > size) {
+                return false;
+            }
+            if (i >= begin) {
+                out[i - begin].assign(data + offset, length);
+            }
+            offset += length;
+        }
+        return true;
+    }
+
+    if (encoding == ColumnEncoding::Dictionary) {
+        std::vector<std::pair<const char*, uint32_t>> entries;
+        size_t offset = 0;
+        if (!read_dictionary(data, size, &entries, &offset)) {
+            return false;
+        }
+
+        PackedArea area;
+        if (!read_packed_area(data, size, offset, rows, &area)) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const uint64_t code = unpack_at(area.bytes, area.size, begin + i, area.width);
+            if (code >= entries.size()) {
+                return false;
+            }
+            out[i].assign(entries[code].first, entries[code].second);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool decode_int_rows(ColumnEncoding encoding, const char* data, size_t size, size_t rows,
+                     const uint32_t* positions, size_t count, int64_t* out) {
+    if (count == 0) {
+        return true;
+    }
+    if (positions[count - 1] >= rows) {
+        return false;
+    }
+
+    switch (encoding) {
+        case ColumnEncoding::Plain:
+            if (size < rows * VALUE_SIZE) {
+                return false;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = load_raw<int64_t>(data + positions[i] * VALUE_SIZE);
+            }
+            return true;
+
+        case ColumnEncoding::Rle: {
+            size_t row = 0;
+            size_t i = 0;
+            for (size_t offset = 0; i < count; offset += RUN_SIZE) {
+                if (offset + RUN_SIZE > size) {
+                    return false;
+                }
+                const auto value = load_raw<int64_t>(data + offset);
+                row += load_raw<uint32_t>(data + offset + VALUE_SIZE);
+                for (; i < count && positions[i] < row; ++i) {
+                    out[i] = value;
+                }
+            }
+            return true;
+        }
+
+        case ColumnEncoding::BitPacked: {
+            PackedArea area;
+            if (size < VALUE_SIZE || !read_packed_area(data, size, VALUE_SIZE, rows, &area)) {
+                return false;
+            }
+            const auto base = load_raw<uint64_t>(data);
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = static_cast<int64_t>(
+                    base + unpack_at(area.bytes, area.size, positions[i], area.width));
+            }
+            return true;
+        }
+
+        case ColumnEncoding::Delta: {
+            PackedArea area;
+            if (size < 2 * VALUE_SIZE ||
+                !read_packed_area(data, size, 2 * VALUE_SIZE, rows - 1, &area)) {
+                return false;
+            }
+            auto value = load_raw<uint64_t>(data);
+            const auto min_delta = load_raw<uint64_t>(data + VALUE_SIZE);
+            size_t i = 0;
+            for (size_t row = 0; i < count; ++row) {
+                if (row > 0) {
+                    value += unpack_at(area.bytes, area.size, row - 1, area.width) + min_delta;
+                }
+                for (; i < count && positions[i] == row; ++i) {
+                    out[i] = static_cast<int64_t>(value);
+                }
+            }
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+bool decode_string_rows(ColumnEncoding encoding, const char* data, size_t size, size_t rows,
+                        const uint32_t* positions, size_t count, std::string* out) {
+    if (count == 0) {
+        return true;
+    }
+    if (positions[count - 1] >= rows) {
+        return false;
+    }
+
+    if (encoding == ColumnEncoding::Plain) {
+        if (size < rows * LENGTH_SIZE) {
+            return false;
+        }
+        /* Values follow each other, so the lengths before the last row still have to be summed */
+        size_t offset = rows * LENGTH_SIZE;
+        size_t i = 0;
+        for (size_t row = 0; i < count; ++row) {
+            const auto length = load_raw<uint32_t>(data + row * LENGTH_SIZE);
+            if (offset + length > size) {
+                return false;
+            }
+            for (; i < count && positions[i] == row; ++i) {
+                out[i].assign(data + offset, length);
+            }
+            offset += length;
+        }
+        return true;
+    }
+
+    if (encoding == ColumnEncoding::Dictionary) {
+        std::vector<std::pair<const char*, uint32_t>> entries;
+        size_t offset = 0;
+        if (!read_dictionary(data, size, &entries, &offset)) {
+            return false;
+        }
+
+        PackedArea area;
+        if (!read_packed_area(data, size, offset, rows, &area)) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const uint64_t code = unpack_at(area.bytes, area.size, positions[i], area.width);
+            if (code >= entries.size()) {
+                return false;
+            }
+            out[i].assign(entries[code].first, entries[code].second);
+        }
+        return true;
+    }
+    return false;
+}
+
+}  // namespace cloudsql::storage
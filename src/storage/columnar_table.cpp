@@ -10,29 +10,476 @@
 
 #include "storage/columnar_table.hpp"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <shared_mutex>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace cloudsql::storage {
 
-bool ColumnarTable::create() {
+namespace {
+
+/** Marks a meta file that carries zone maps after its row count ("ZMAP") */
+constexpr uint32_t META_ZONE_MAGIC = 0x5A4D4150;
+
+/** Marks the ids of deleted sealed rows, after the zone maps ("DELS") */
+constexpr uint32_t META_DELETES_MAGIC = 0x44454C53;
+
+/** First byte of a delta log record */
+enum class DeltaRecord : uint8_t {
+    Insert = 1, /**< [u64 first row][u32 rows] then per column: NULL flags, values */
+    Delete = 2, /**< [u32 count][u64 row id x count] */
+};
+
+/** How a column's values are held in a VectorBatch and handed to the encoders */
+enum class StorageKind : uint8_t { Integer, Float, Bool, String };
+
+StorageKind storage_kind(common::ValueType type, const char* caller) {
+    switch (type) {
+        case common::ValueType::TYPE_INT8:
+        case common::ValueType::TYPE_INT16:
+        case common::ValueType::TYPE_INT32:
+        case common::ValueType::TYPE_INT64:
+            return StorageKind::Integer;
+        case common::ValueType::TYPE_FLOAT32:
+        case common::ValueType::TYPE_FLOAT64:
+            return StorageKind::Float;
+        case common::ValueType::TYPE_BOOL:
+            return StorageKind::Bool;
+        case common::ValueType::TYPE_CHAR:
+        case common::ValueType::TYPE_VARCHAR:
+        case common::ValueType::TYPE_TEXT:
+            return StorageKind::String;
+        default:
+            throw std::runtime_error(std::string(caller) + ": Unsupported persistence type " +
+                                     std::to_string(static_cast<int>(type)));
+    }
+}
+
+size_t bitmap_bytes(uint32_t rows) {
+    return (static_cast<size_t>(rows) + 7) / 8;
+}
+
+size_t align_up(size_t bytes) {
+    return (bytes + CHUNK_ALIGNMENT - 1) / CHUNK_ALIGNMENT * CHUNK_ALIGNMENT;
+}
+
+/** @brief Sizes a batch column to `rows`; added rows hold default values */
+void size_column(executor::ColumnVector& column, uint32_t rows) {
+    switch (storage_kind(column.type(), "ColumnarTable::size_column")) {
+        case StorageKind::Integer:
+            dynamic_cast<executor::NumericVector<int64_t>&>(column).resize(rows);
+            break;
+        case StorageKind::Float:
+            dynamic_cast<executor::NumericVector<double>&>(column).resize(rows);
+            break;
+        case StorageKind::Bool:
+            dynamic_cast<executor::NumericVector<bool>&>(column).resize(rows);
+            break;
+        case StorageKind::String:
+            dynamic_cast<executor::StringVector&>(column).resize(rows);
+            break;
+    }
+}
+
+/* Raw buffer of a fixed-width column, widened to the int64 the encoders work on */
+struct FixedWidthSource {
+    StorageKind kind = StorageKind::Integer;
+    const int64_t* ints = nullptr;
+    const double* floats = nullptr;
+    const uint8_t* bools = nullptr;
+
+    [[nodiscard]] int64_t at(size_t row) const {
+        if (kind == StorageKind::Integer) return ints[row];
+        if (kind == StorageKind::Bool) return bools[row];
+        int64_t bits = 0;
+        std::memcpy(&bits, &floats[row], sizeof(bits));
+        return bits;
+    }
+};
+
+FixedWidthSource fixed_width_source(executor::ColumnVector& col, StorageKind kind) {
+    FixedWidthSource source;
+    source.kind = kind;
+    if (kind == StorageKind::Integer) {
+        source.ints = dynamic_cast<executor::NumericVector<int64_t>&>(col).raw_data();
+    } else if (kind == StorageKind::Float) {
+        source.floats = dynamic_cast<executor::NumericVector<double>&>(col).raw_data();
+    } else if (kind == StorageKind::Bool) {
+        source.bools = dynamic_cast<executor::NumericVector<bool>&>(col).raw_data();
+    }
+    return source;
+}
+
+double bits_to_double(int64_t bits) {
+    double value = 0;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+bool is_integer_type(common::ValueType type) {
+    return type == common::ValueType::TYPE_INT8 || type == common::ValueType::TYPE_INT16 ||
+           type == common::ValueType::TYPE_INT32 || type == common::ValueType::TYPE_INT64;
+}
+
+/* Whether some value in [lo, hi] can satisfy `value op constant` */
+template <typename T>
+bool range_may_match(T lo, T hi, T constant, CompareOp op) {
+    switch (op) {
+        case CompareOp::Eq:
+            return lo <= constant && constant <= hi;
+        case CompareOp::Ne:
+            return !(lo == hi && lo == constant);
+        case CompareOp::Lt:
+            return lo < constant;
+        case CompareOp::Le:
+            return lo <= constant;
+        case CompareOp::Gt:
+            return hi > constant;
+        case CompareOp::Ge:
+            return hi >= constant;
+        default:
+            return true;
+    }
+}
+
+/* Min / max / NULL count of rows [start, start + count) of a column */
+ColumnarTable::ZoneMap compute_zone(const executor::ColumnVector& col,
+                                    const FixedWidthSource& source, StorageKind kind, size_t start,
+                                    uint32_t count) {
+    ColumnarTable::ZoneMap zone;
+    zone.known = 1;
+    bool bounded = kind != StorageKind::String;
+    bool seen = false;
+    for (uint32_t r = 0; r < count; ++r) {
+        if (col.is_null(start + r)) {
+            ++zone.null_count;
+            continue;
+        }
+        if (!bounded) continue;
+        const int64_t value = source.at(start + r);
+        if (kind == StorageKind::Float) {
+            // NaN is unordered, so a chunk holding one cannot be bounded
+            const double d = bits_to_double(value);
+            if (std::isnan(d)) {
+                bounded = false;
+                continue;
+            }
+            if (!seen || d < bits_to_double(zone.min)) zone.min = value;
+            if (!seen || d > bits_to_double(zone.max)) zone.max = value;
+        } else {
+            if (!seen || value < zone.min) zone.min = value;
+            if (!seen || value > zone.max) zone.max = value;
+        }
+        seen = true;
+    }
+    zone.has_bounds = (bounded && seen) ? 1 : 0;
+    return zone;
+}
+
+bool write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        const ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+template <typename T>
+void put(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/** Reads fixed-size fields of a log record, failing past its end */
+class RecordReader {
+   public:
+    RecordReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    bool get(T& value) {
+        if (size_ - offset_ < sizeof(T)) return false;
+        std::memcpy(&value, data_ + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return true;
+    }
+
+    const char* take(size_t bytes) {
+        if (size_ - offset_ < bytes) return nullptr;
+        const char* const at = data_ + offset_;
+        offset_ += bytes;
+        return at;
+    }
+
+   private:
+    const char* data_;
+    size_t size_;
+    size_t offset_ = 0;
+};
+
+/** @brief Appends rows [begin, begin + rows) of `from` to `to`; false on a type mismatch */
+bool append_rows(executor::VectorBatch& to, const executor::VectorBatch& from, size_t begin,
+                 size_t rows) {
+    if (from.column_count() != to.column_count() || begin + rows > from.row_count()) {
+        return false;
+    }
+    std::vector<uint32_t> indices(rows);
+    std::iota(indices.begin(), indices.end(), static_cast<uint32_t>(begin));
+    for (size_t i = 0; i < to.column_count(); ++i) {
+        if (!to.get_column(i).gather_from(from.get_column(i), indices.data(), rows)) {
+            return false;
+        }
+    }
+    to.set_row_count(to.row_count() + rows);
+    return true;
+}
+
+/** @brief Frames an Insert record of rows [begin, begin + rows) of `batch` as row `first_row` on */
+std::string encode_insert(const executor::Schema& schema, const executor::VectorBatch& batch,
+                          size_t begin, uint32_t rows, uint64_t first_row) {
+    std::string record;
+    put(record, static_cast<uint8_t>(DeltaRecord::Insert));
+    put(record, first_row);
+    put(record, rows);
+    for (size_t i = 0; i < schema.column_count(); ++i) {
+        const executor::ColumnVector& col = batch.get_column(i);
+        for (uint32_t r = 0; r < rows; ++r) {
+            put(record, static_cast<uint8_t>(col.is_null(begin + r) ? 1 : 0));
+        }
+        switch (storage_kind(schema.get_column(i).type(), "ColumnarTable::insert_batch")) {
+            case StorageKind::Integer: {
+                const auto* values =
+                    dynamic_cast<const executor::NumericVector<int64_t>&>(col).raw_data();
+                record.append(reinterpret_cast<const char*>(values + begin), rows * sizeof(int64_t));
+                break;
+            }
+            case StorageKind::Float: {
+                const auto* values =
+                    dynamic_cast<const executor::NumericVector<double>&>(col).raw_data();
+                record.append(reinterpret_cast<const char*>(values + begin), rows * sizeof(double));
+                break;
+            }
+            case StorageKind::Bool: {
+                const auto* values =
+                    dynamic_cast<const executor::NumericVector<bool>&>(col).raw_data();
+                record.append(reinterpret_cast<const char*>(values + begin), rows);
+                break;
+            }
+            case StorageKind::String: {
+                const auto* values = dynamic_cast<const executor::StringVector&>(col).raw_data();
+                for (uint32_t r = 0; r < rows; ++r) {
+                    const std::string& text = values[begin + r];
+                    put(record, static_cast<uint32_t>(text.size()));
+                    record.append(text);
+                }
+                break;
+            }
+        }
+    }
+    return record;
+}
+
+/** @brief Decodes the rows of an Insert record, after its first row id, into `out` */
+bool decode_insert(const executor::Schema& schema, RecordReader& in, uint32_t rows,
+                   executor::VectorBatch& out) {
+    out.init_from_schema(schema);
+    for (size_t i = 0; i < schema.column_count(); ++i) {
+        executor::ColumnVector& col = out.get_column(i);
+        const char* const nulls = in.take(rows);
+        if (nulls == nullptr) return false;
+        switch (storage_kind(schema.get_column(i).type(), "ColumnarTable::open")) {
+            case StorageKind::Integer: {
+                auto& typed = dynamic_cast<executor::NumericVector<int64_t>&>(col);
+                typed.resize(rows);
+                const char* const values = in.take(rows * sizeof(int64_t));
+                if (values == nullptr) return false;
+                std::memcpy(typed.raw_data_mut(), values, rows * sizeof(int64_t));
+                break;
+            }
+            case StorageKind::Float: {
+                auto& typed = dynamic_cast<executor::NumericVector<double>&>(col);
+                typed.resize(rows);
+                const char* const values = in.take(rows * sizeof(double));
+                if (values == nullptr) return false;
+                std::memcpy(typed.raw_data_mut(), values, rows * sizeof(double));
+                break;
+            }
+            case StorageKind::Bool: {
+                auto& typed = dynamic_cast<executor::NumericVector<bool>&>(col);
+                typed.resize(rows);
+                const char* const values = in.take(rows);
+                if (values == nullptr) return false;
+                std::memcpy(typed.raw_data_mut(), values, rows);
+                break;
+            }
+            case StorageKind::String: {
+                auto& typed = dynamic_cast<executor::StringVector&>(col);
+                typed.resize(rows);
+                for (uint32_t r = 0; r < rows; ++r) {
+                    uint32_t length = 0;
+                    const char* text = nullptr;
+                    if (!in.get(length) || (text = in.take(length)) == nullptr) return false;
+                    typed.raw_data_mut()[r].assign(text, length);
+                }
+                break;
+            }
+        }
+        for (uint32_t r = 0; r < rows; ++r) {
+            if (nulls[r] != 0) col.set_null(r, true);
+        }
+    }
+    out.set_row_count(rows);
+    return true;
+}
+
+std::string encode_delete(const std::vector<uint64_t>& rows) {
+    std::string record;
+    put(record, static_cast<uint8_t>(DeltaRecord::Delete));
+    put(record, static_cast<uint32_t>(rows.size()));
+    for (const uint64_t row : rows) put(record, row);
+    return record;
+}
+
+/** @brief Frames a record as it is stored in the log: [u32 length][record] */
+void frame(std::string& out, const std::string& record) {
+    put(out, static_cast<uint32_t>(record.size()));
+    out.append(record);
+}
+
+}  // namespace
+
+ColumnarTable::ColumnarTable(const ColumnarTable& other)
+    : name_(other.name_), storage_manager_(other.storage_manager_), schema_(other.schema_) {
+    const std::shared_lock<std::shared_mutex> lock(other.state_mutex_);
+    row_count_ = other.row_count_.load();
+    sealed_rows_ = other.sealed_rows_;
+    chunks_ = other.chunks_;
+    mappings_ = other.mappings_;
+    if (other.delta_) {
+        delta_ = executor::VectorBatch::create(schema_);
+        static_cast<void>(append_rows(*delta_, *other.delta_, 0, other.delta_->row_count()));
+    }
+    deleted_ = other.deleted_;
+    deleted_count_ = other.deleted_count_;
+}
+
+ColumnarTable::~ColumnarTable() {
+    if (log_fd_ >= 0) {
+        static_cast<void>(::close(log_fd_));
+    }
+}
+
+std::string ColumnarTable::column_path(size_t column) const {
+    return storage_manager_.get_full_path(name_ + ".col" + std::to_string(column) + ".data.bin");
+}
+
+std::string ColumnarTable::log_path() const {
+    return storage_manager_.get_full_path(name_ + ".delta.log");
+}
+
+std::shared_ptr<const MappedFile> ColumnarTable::column_mapping(size_t column) {
+    const std::lock_guard<std::mutex> lock(mappings_mutex_);
+    if (mappings_.size() != schema_.column_count()) {
+        mappings_.resize(schema_.column_count());
+    }
+    if (!mappings_[column]) {
+        mappings_[column] = MappedFile::map(column_path(column), true);
+    }
+    return mappings_[column];
+}
+
+bool ColumnarTable::write_meta() {
+    // [u64 sealed rows][u32 magic][u32 columns]{[u32 chunks][ZoneMap x chunks]} per column,
+    // [u32 magic][u64 count][u64 deleted row x count], written aside and renamed so a
+    // crash never leaves a torn directory behind
     const std::string meta_path = storage_manager_.get_full_path(name_ + ".meta.bin");
-    std::ofstream out(meta_path, std::ios::binary);
-    if (!out.is_open()) return false;
+    const std::string tmp_path = meta_path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out.write(reinterpret_cast<const char*>(&sealed_rows_), 8);
+        const auto columns = static_cast<uint32_t>(chunks_.size());
+        out.write(reinterpret_cast<const char*>(&META_ZONE_MAGIC), sizeof(META_ZONE_MAGIC));
+        out.write(reinterpret_cast<const char*>(&columns), sizeof(columns));
+        for (const auto& directory : chunks_) {
+            const auto count = static_cast<uint32_t>(directory.size());
+            out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+            for (const auto& info : directory) {
+                out.write(reinterpret_cast<const char*>(&info.zone), sizeof(ZoneMap));
+            }
+        }
+        // Deletes of delta rows stay in the log until their rows are sealed
+        std::vector<uint64_t> deleted;
+        const uint64_t marked = std::min<uint64_t>(sealed_rows_, deleted_.size());
+        for (uint64_t row = 0; deleted_count_ != 0 && row < marked; ++row) {
+            if (deleted_[row]) deleted.push_back(row);
+        }
+        const auto count = static_cast<uint64_t>(deleted.size());
+        out.write(reinterpret_cast<const char*>(&META_DELETES_MAGIC), sizeof(META_DELETES_MAGIC));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(deleted.data()),
+                  static_cast<std::streamsize>(count * sizeof(uint64_t)));
+        if (!out) return false;
+    }
+    return std::rename(tmp_path.c_str(), meta_path.c_str()) == 0;
+}
 
-    uint64_t initial_rows = 0;
-    out.write(reinterpret_cast<const char*>(&initial_rows), 8);
-    out.close();
+bool ColumnarTable::create() {
+    row_count_ = 0;
+    sealed_rows_ = 0;
+    chunks_.assign(schema_.column_count(), {});
+    mappings_.assign(schema_.column_count(), nullptr);
+    delta_ = executor::VectorBatch::create(schema_);
+    deleted_.clear();
+    deleted_count_ = 0;
+    if (!write_meta()) return false;
 
     for (size_t i = 0; i < schema_.column_count(); ++i) {
-        const std::string base = name_ + ".col" + std::to_string(i);
-        std::ofstream n_out(storage_manager_.get_full_path(base + ".nulls.bin"), std::ios::binary);
-        std::ofstream d_out(storage_manager_.get_full_path(base + ".data.bin"), std::ios::binary);
-        if (!n_out.is_open() || !d_out.is_open()) return false;
+        std::ofstream d_out(column_path(i), std::ios::binary);
+        if (!d_out.is_open()) return false;
     }
-    return true;
+    if (log_fd_ >= 0) {
+        static_cast<void>(::close(log_fd_));
+    }
+    log_fd_ = ::open(log_path().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+                     0644);
+    return log_fd_ >= 0;
+}
+
+bool ColumnarTable::drop() {
+    const std::scoped_lock<std::mutex> write_lock(write_mutex_);
+    if (log_fd_ >= 0) {
+        static_cast<void>(::close(log_fd_));
+        log_fd_ = -1;
+    }
+    bool ok = true;
+    const auto remove = [&ok](const std::string& path) {
+        if (std::remove(path.c_str()) != 0 && errno != ENOENT) ok = false;
+    };
+    remove(storage_manager_.get_full_path(name_ + ".meta.bin"));
+    for (size_t i = 0; i < schema_.column_count(); ++i) {
+        remove(column_path(i));
+    }
+    remove(log_path());
+    return ok;
 }
 
 bool ColumnarTable::open() {
@@ -40,113 +487,718 @@ bool ColumnarTable::open() {
     std::ifstream in(meta_path, std::ios::binary);
     if (!in.is_open()) return false;
 
-    in.read(reinterpret_cast<char*>(&row_count_), 8);
+    in.read(reinterpret_cast<char*>(&sealed_rows_), 8);
+    if (!in) return false;
+
+    // Zone maps follow; files from before they existed stop here and stay unpruned
+    std::vector<std::vector<ZoneMap>> zones(schema_.column_count());
+    std::vector<uint64_t> deleted;
+    uint32_t magic = 0;
+    uint32_t columns = 0;
+    if (in.read(reinterpret_cast<char*>(&magic), sizeof(magic)) && magic == META_ZONE_MAGIC &&
+        in.read(reinterpret_cast<char*>(&columns), sizeof(columns))) {
+        bool complete = true;
+        for (uint32_t i = 0; i < columns; ++i) {
+            uint32_t count = 0;
+            if (!in.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+                complete = false;
+                break;
+            }
+            std::vector<ZoneMap> directory(count);
+            if (!in.read(reinterpret_cast<char*>(directory.data()),
+                         static_cast<std::streamsize>(count * sizeof(ZoneMap)))) {
+                complete = false;
+                break;
+            }
+            if (i < zones.size()) zones[i] = std::move(directory);
+        }
+        // Then the deleted sealed rows, in files written since deletes existed
+        uint64_t count = 0;
+        if (complete && in.read(reinterpret_cast<char*>(&magic), sizeof(magic)) &&
+            magic == META_DELETES_MAGIC &&
+            in.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+            deleted.resize(count);
+            if (!in.read(reinterpret_cast<char*>(deleted.data()),
+                         static_cast<std::streamsize>(count * sizeof(uint64_t)))) {
+                return false;
+            }
+        }
+    }
     in.close();
-    return true;
+
+    // Map every column once and rebuild the chunk directory from its headers
+    chunks_.assign(schema_.column_count(), {});
+    mappings_.assign(schema_.column_count(), nullptr);
+    for (size_t i = 0; i < schema_.column_count(); ++i) {
+        const auto mapping = column_mapping(i);
+        if (!mapping) return false;
+
+        uint64_t first_row = 0;
+        uint64_t offset = 0;
+        // Chunks past sealed_rows_ belong to a write that never committed its meta update
+        while (first_row < sealed_rows_ && offset + sizeof(ChunkHeader) <= mapping->size()) {
+            ChunkHeader header{};
+            std::memcpy(&header, mapping->data() + offset, sizeof(header));
+            const size_t index = chunks_[i].size();
+            chunks_[i].push_back({first_row, offset, header,
+                                  index < zones[i].size() ? zones[i][index] : ZoneMap{}});
+            first_row += header.row_count;
+            offset += sizeof(header) + header.payload_size;
+        }
+        if (first_row < sealed_rows_ || offset > mapping->size()) return false;
+    }
+
+    row_count_ = sealed_rows_;
+    delta_ = executor::VectorBatch::create(schema_);
+    deleted_.clear();
+    deleted_count_ = 0;
+    for (const uint64_t row : deleted) {
+        if (row >= sealed_rows_) continue;
+        if (deleted_.empty()) deleted_.resize(sealed_rows_, false);
+        if (!deleted_[row]) {
+            deleted_[row] = true;
+            ++deleted_count_;
+        }
+    }
+    return replay_log();
 }
 
-bool ColumnarTable::append_batch(const executor::VectorBatch& batch) {
+bool ColumnarTable::replay_log() {
+    std::string log;
+    {
+        std::ifstream in(log_path(), std::ios::binary);
+        if (in.is_open()) {
+            log.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+    }
+
+    // Records of rows already sealed were written before the last compaction
+    size_t offset = 0;
+    executor::VectorBatch rows;
+    while (offset + sizeof(uint32_t) <= log.size()) {
+        uint32_t length = 0;
+        std::memcpy(&length, log.data() + offset, sizeof(length));
+        if (log.size() - offset - sizeof(length) < length) {
+            break; /* Cut short by a crash; the write was never acknowledged */
+        }
+        RecordReader record(log.data() + offset + sizeof(length), length);
+        uint8_t kind = 0;
+        if (!record.get(kind)) return false;
+        if (kind == static_cast<uint8_t>(DeltaRecord::Insert)) {
+            uint64_t first_row = 0;
+            uint32_t count = 0;
+            if (!record.get(first_row) || !record.get(count) ||
+                !decode_insert(schema_, record, count, rows) || first_row > row_count_) {
+                return false;
+            }
+            const uint64_t known = row_count_ - first_row;
+            if (known < count) {
+                if (!append_rows(*delta_, rows, known, count - known)) return false;
+                row_count_ += count - known;
+            }
+        } else if (kind == static_cast<uint8_t>(DeltaRecord::Delete)) {
+            uint32_t count = 0;
+            if (!record.get(count)) return false;
+            for (uint32_t i = 0; i < count; ++i) {
+                uint64_t row = 0;
+                if (!record.get(row)) return false;
+                if (row >= row_count_) continue;
+                if (deleted_.size() < row_count_) deleted_.resize(row_count_, false);
+                if (!deleted_[row]) {
+                    deleted_[row] = true;
+                    ++deleted_count_;
+                }
+            }
+        } else {
+            return false;
+        }
+        offset += sizeof(length) + length;
+    }
+    if (!deleted_.empty()) deleted_.resize(row_count_, false);
+
+    if (log_fd_ >= 0) {
+        static_cast<void>(::close(log_fd_));
+    }
+    log_fd_ = ::open(log_path().c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    return log_fd_ >= 0 &&
+           (offset == log.size() || ::ftruncate(log_fd_, static_cast<off_t>(offset)) == 0);
+}
+
+bool ColumnarTable::log_record(const std::string& record) {
+    if (log_fd_ < 0) {
+        log_fd_ = ::open(log_path().c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (log_fd_ < 0) return false;
+    }
+    std::string framed;
+    frame(framed, record);
+    return write_all(log_fd_, framed.data(), framed.size()) && ::fdatasync(log_fd_) == 0;
+}
+
+bool ColumnarTable::rewrite_log() {
+    std::string image;
+    const uint64_t delta = row_count_ - sealed_rows_;
+    if (delta != 0) {
+        frame(image,
+              encode_insert(schema_, *delta_, 0, static_cast<uint32_t>(delta), sealed_rows_));
+    }
+    std::vector<uint64_t> deleted;
+    for (uint64_t row = sealed_rows_; row < deleted_.size(); ++row) {
+        if (deleted_[row]) deleted.push_back(row);
+    }
+    if (!deleted.empty()) frame(image, encode_delete(deleted));
+
+    const std::string path = log_path();
+    const std::string tmp = path + ".tmp";
+    const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    const bool written = write_all(fd, image.data(), image.size()) && ::fdatasync(fd) == 0;
+    static_cast<void>(::close(fd));
+    if (!written || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        static_cast<void>(std::remove(tmp.c_str()));
+        return false;
+    }
+    if (log_fd_ >= 0) {
+        static_cast<void>(::close(log_fd_));
+    }
+    log_fd_ = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    return log_fd_ >= 0;
+}
+
+bool ColumnarTable::write_chunks(const executor::VectorBatch& batch, size_t begin, size_t rows,
+                                 std::vector<std::vector<ChunkInfo>>& directories) {
+    directories.assign(schema_.column_count(), {});
     for (size_t i = 0; i < schema_.column_count(); ++i) {
-        const std::string base = name_ + ".col" + std::to_string(i);
-        std::ofstream n_out(storage_manager_.get_full_path(base + ".nulls.bin"),
-                            std::ios::binary | std::ios::app);
-        std::ofstream d_out(storage_manager_.get_full_path(base + ".data.bin"),
-                            std::ios::binary | std::ios::app);
-        if (!n_out.is_open() || !d_out.is_open()) return false;
+        const std::vector<ChunkInfo>* const sealed = i < chunks_.size() ? &chunks_[i] : nullptr;
+        uint64_t offset = sealed == nullptr || sealed->empty()
+                              ? 0
+                              : sealed->back().offset + sizeof(ChunkHeader) +
+                                    sealed->back().header.payload_size;
+
+        // Drop whatever a failed write left past the last chunk, so appends land at `offset`
+        const std::string path = column_path(i);
+        if (::truncate(path.c_str(), static_cast<off_t>(offset)) != 0 && errno != ENOENT) {
+            return false;
+        }
+        std::ofstream d_out(path, std::ios::binary | std::ios::app);
+        if (!d_out.is_open()) return false;
 
         auto& col_vec = const_cast<executor::VectorBatch&>(batch).get_column(i);
+        const StorageKind kind =
+            storage_kind(schema_.get_column(i).type(), "ColumnarTable::append_batch");
+
+        const FixedWidthSource source = kind == StorageKind::String
+                                            ? FixedWidthSource{}
+                                            : fixed_width_source(col_vec, kind);
+        std::string payload;
+        std::vector<int64_t> values;
+        for (size_t start = begin; start < begin + rows; start += chunk_rows()) {
+            const auto count =
+                static_cast<uint32_t>(std::min<size_t>(chunk_rows(), begin + rows - start));
 
-        // Persist nullability information (1 byte per row for simplicity in this POC)
-        for (size_t r = 0; r < batch.row_count(); ++r) {
-            uint8_t is_null = col_vec.is_null(r) ? 1 : 0;
-            n_out.write(reinterpret_cast<const char*>(&is_null), 1);
+            // Nullability as a bitmap, omitted entirely for chunks without NULLs
+            payload.assign(align_up(bitmap_bytes(count)), '\0');
+            bool has_nulls = false;
+            for (uint32_t r = 0; r < count; ++r) {
+                if (col_vec.is_null(start + r)) {
+                    payload[r / 8] = static_cast<char>(payload[r / 8] | (1U << (r % 8)));
+                    has_nulls = true;
+                }
+            }
+            if (!has_nulls) payload.clear();
+            const auto values_offset = static_cast<uint32_t>(payload.size());
+
+            ColumnEncoding encoding = ColumnEncoding::Plain;
+            if (kind == StorageKind::String) {
+                const auto& str_vec = dynamic_cast<executor::StringVector&>(col_vec);
+                encoding = encode_string_chunk(str_vec.raw_data() + start, count, &payload);
+            } else {
+                // NULL slots repeat their predecessor so they do not break runs or deltas
+                values.assign(count, 0);
+                bool seen = false;
+                for (uint32_t r = 0; r < count; ++r) {
+                    if (!col_vec.is_null(start + r)) {
+                        values[r] = source.at(start + r);
+                        if (!seen) std::fill_n(values.begin(), r, values[r]);
+                        seen = true;
+                    } else if (r > 0) {
+                        values[r] = values[r - 1];
+                    }
+                }
+                encoding = encode_int_chunk(values.data(), count, &payload);
+            }
+
+            // Pad so the next chunk starts aligned too
+            payload.resize(align_up(payload.size()), '\0');
+
+            ChunkHeader header{};
+            header.row_count = count;
+            header.payload_size = static_cast<uint32_t>(payload.size());
+            header.values_offset = values_offset;
+            header.encoding = encoding;
+            header.has_nulls = has_nulls ? 1 : 0;
+            d_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            d_out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+
+            directories[i].push_back({sealed_rows_ + (start - begin), offset, header,
+                                      compute_zone(col_vec, source, kind, start, count)});
+            offset += sizeof(header) + header.payload_size;
         }
+        if (!d_out) return false;
+    }
+    return true;
+}
 
-        // Persist raw binary data
-        const auto type = schema_.get_column(i).type();
-        if (type == common::ValueType::TYPE_INT64) {
-            auto& num_vec = dynamic_cast<executor::NumericVector<int64_t>&>(col_vec);
-            d_out.write(reinterpret_cast<const char*>(num_vec.raw_data()), batch.row_count() * 8);
-        } else if (type == common::ValueType::TYPE_FLOAT64) {
-            auto& num_vec = dynamic_cast<executor::NumericVector<double>&>(col_vec);
-            d_out.write(reinterpret_cast<const char*>(num_vec.raw_data()), batch.row_count() * 8);
-        } else {
-            throw std::runtime_error("ColumnarTable::append_batch: Unsupported persistence type " +
-                                     std::to_string(static_cast<int>(type)));
+void ColumnarTable::publish_chunks(std::vector<std::vector<ChunkInfo>>& directories,
+                                   uint64_t rows) {
+    if (chunks_.size() != schema_.column_count()) {
+        chunks_.resize(schema_.column_count());
+    }
+    for (size_t i = 0; i < directories.size(); ++i) {
+        chunks_[i].insert(chunks_[i].end(), directories[i].begin(), directories[i].end());
+    }
+    sealed_rows_ += rows;
+    const std::lock_guard<std::mutex> lock(mappings_mutex_);
+    for (auto& mapping : mappings_) mapping.reset();
+}
+
+bool ColumnarTable::append_batch(const executor::VectorBatch& batch) {
+    const std::scoped_lock<std::mutex> write(write_mutex_);
+    const size_t rows = batch.row_count();
+    if (row_count_ != sealed_rows_ && !compact_locked(true)) return false;
+
+    std::vector<std::vector<ChunkInfo>> directories;
+    if (!write_chunks(batch, 0, rows, directories)) return false;
+    {
+        const std::unique_lock<std::shared_mutex> lock(state_mutex_);
+        publish_chunks(directories, rows);
+        row_count_ += rows;
+        if (!deleted_.empty()) deleted_.resize(row_count_, false);
+    }
+    return write_meta();
+}
+
+bool ColumnarTable::insert_batch(const executor::VectorBatch& batch, uint64_t* first_row) {
+    const std::scoped_lock<std::mutex> write(write_mutex_);
+    const size_t rows = batch.row_count();
+    if (!delta_) delta_ = executor::VectorBatch::create(schema_);
+
+    // Staged first, so a batch of the wrong shape is refused before it is logged
+    auto staged = executor::VectorBatch::create(schema_);
+    if (!append_rows(*staged, batch, 0, rows)) return false;
+    const uint64_t first = row_count_;
+    if (rows != 0 &&
+        !log_record(encode_insert(schema_, *staged, 0, static_cast<uint32_t>(rows), first))) {
+        return false;
+    }
+    {
+        const std::unique_lock<std::shared_mutex> lock(state_mutex_);
+        if (!append_rows(*delta_, *staged, 0, rows)) return false;
+        row_count_ += rows;
+        if (!deleted_.empty()) deleted_.resize(row_count_, false);
+    }
+    if (first_row != nullptr) *first_row = first;
+    return true;
+}
+
+bool ColumnarTable::delete_rows(const std::vector<uint64_t>& rows) {
+    const std::scoped_lock<std::mutex> write(write_mutex_);
+    const uint64_t count = row_count_;
+    if (std::any_of(rows.begin(), rows.end(), [count](uint64_t row) { return row >= count; })) {
+        return false;
+    }
+    if (rows.empty()) return true;
+    if (!log_record(encode_delete(rows))) return false;
+
+    const std::unique_lock<std::shared_mutex> lock(state_mutex_);
+    if (deleted_.size() < count) deleted_.resize(count, false);
+    for (const uint64_t row : rows) {
+        if (!deleted_[row]) {
+            deleted_[row] = true;
+            ++deleted_count_;
         }
     }
+    return true;
+}
+
+bool ColumnarTable::compact(bool seal_all) {
+    const std::scoped_lock<std::mutex> write(write_mutex_);
+    return compact_locked(seal_all);
+}
 
-    row_count_ += batch.row_count();
+bool ColumnarTable::compact_locked(bool seal_all) {
+    // Only writers change the delta, so it can be encoded while readers carry on
+    const uint64_t delta = row_count_ - sealed_rows_;
+    const uint64_t rows = seal_all ? delta : delta / chunk_rows() * chunk_rows();
+    if (rows == 0) return true;
 
-    const std::string meta_path = storage_manager_.get_full_path(name_ + ".meta.bin");
-    std::ofstream out(meta_path, std::ios::binary | std::ios::in | std::ios::out);
-    out.write(reinterpret_cast<const char*>(&row_count_), 8);
+    std::vector<std::vector<ChunkInfo>> directories;
+    if (!write_chunks(*delta_, 0, rows, directories)) return false;
+    {
+        const std::unique_lock<std::shared_mutex> lock(state_mutex_);
+        publish_chunks(directories, rows);
+        auto rest = executor::VectorBatch::create(schema_);
+        static_cast<void>(append_rows(*rest, *delta_, rows, delta - rows));
+        delta_ = std::move(rest);
+    }
+    // The chunks are durable once meta names them; only then may the log forget their rows
+    return write_meta() && rewrite_log();
+}
+
+bool ColumnarTable::live_mask(uint64_t start_row, size_t rows,
+                              executor::NumericVector<bool>& keep) const {
+    const std::shared_lock<std::shared_mutex> lock(state_mutex_);
+    if (deleted_count_ == 0 || start_row >= deleted_.size()) return false;
+    const uint64_t end = std::min<uint64_t>(start_row + rows, deleted_.size());
+    bool any = false;
+    for (uint64_t row = start_row; row < end && !any; ++row) any = deleted_[row];
+    if (!any) return false;
+
+    keep.clear();
+    keep.resize(rows);
+    uint8_t* const live = keep.raw_data_mut();
+    for (size_t r = 0; r < rows; ++r) {
+        live[r] = static_cast<uint8_t>(start_row + r >= end || !deleted_[start_row + r]);
+    }
+    return true;
+}
+
+bool ColumnarTable::is_deleted(uint64_t row) const {
+    const std::shared_lock<std::shared_mutex> lock(state_mutex_);
+    return row < deleted_.size() && deleted_[row];
+}
+
+uint64_t ColumnarTable::sealed_rows() const {
+    const std::shared_lock<std::shared_mutex> lock(state_mutex_);
+    return sealed_rows_;
+}
+
+uint64_t ColumnarTable::delta_rows() const {
+    const std::shared_lock<std::shared_mutex> lock(state_mutex_);
+    return row_count_ - sealed_rows_;
+}
+
+uint64_t ColumnarTable::deleted_count() const {
+    const std::shared_lock<std::shared_mutex> lock(state_mutex_);
+    return deleted_count_;
+}
+
+size_t ColumnarTable::chunk_count() const {
+    const std::shared_lock<std::shared_mutex> lock(state_mutex_);
+    return chunks_.empty() ? 0 : chunks_[0].size();
+}
+
+size_t ColumnarTable::chunk_index(uint64_t row) const {
+    const std::shared_lock<std::shared_mutex> lock(state_mutex_);
+    if (chunks_.empty() || chunks_[0].empty()) return 0;
+    if (row >= sealed_rows_) return chunks_[0].size();
+    const auto& directory = chunks_[0];
+    auto chunk =
+        std::upper_bound(directory.begin(), directory.end(), row,
+                         [](uint64_t r, const ChunkInfo& info) { return r < info.first_row; });
+    return chunk == directory.begin() ? 0 : static_cast<size_t>(chunk - directory.begin()) - 1;
+}
+
+uint64_t ColumnarTable::chunk_end_row(size_t index) const {
+    const std::shared_lock<std::shared_mutex> lock(state_mutex_);
+    if (chunks_.empty() || index >= chunks_[0].size()) return row_count_;
+    const ChunkInfo& info = chunks_[0][index];
+    return info.first_row + info.header.row_count;
+}
+
+bool ColumnarTable::chunk_may_match(size_t index,
+                                    const std::vector<ColumnPredicate>& predicates) const {
+    const std::shared_lock<std::shared_mutex> lock(state_mutex_);
+    for (const auto& predicate : predicates) {
+        if (predicate.column >= chunks_.size() || index >= chunks_[predicate.column].size()) {
+            continue;
+        }
+        const ChunkInfo& info = chunks_[predicate.column][index];
+        const ZoneMap& zone = info.zone;
+        if (zone.known == 0U) continue;
+
+        const bool all_null = zone.null_count == info.header.row_count;
+        if (predicate.op == CompareOp::IsNull) {
+            if (zone.null_count == 0) return false;
+            continue;
+        }
+        if (predicate.op == CompareOp::IsNotNull) {
+            if (all_null) return false;
+            continue;
+        }
+
+        // A comparison is never true for a NULL on either side
+        if (all_null || predicate.value.is_null()) return false;
+        if (zone.has_bounds == 0U || !predicate.value.is_numeric()) continue;
+
+        const common::ValueType type = schema_.get_column(predicate.column).type();
+        const StorageKind kind = storage_kind(type, "ColumnarTable::chunk_may_match");
+        bool may_match = true;
+        if (kind == StorageKind::Integer) {
+            // Evaluation compares integers exactly or through doubles depending on the
+            // path taken, so only skip when neither comparison could hold
+            may_match = range_may_match(static_cast<double>(zone.min),
+                                        static_cast<double>(zone.max),
+                                        predicate.value.to_float64(), predicate.op);
+            if (!may_match && is_integer_type(predicate.value.type())) {
+                may_match = range_may_match(zone.min, zone.max, predicate.value.to_int64(),
+                                            predicate.op);
+            }
+        } else if (kind == StorageKind::Float) {
+            may_match = range_may_match(bits_to_double(zone.min), bits_to_double(zone.max),
+                                        predicate.value.to_float64(), predicate.op);
+        }
+        if (!may_match) return false;
+    }
     return true;
 }
 
 bool ColumnarTable::read_batch(uint64_t start_row, uint32_t batch_size,
                                executor::VectorBatch& out_batch) {
-    if (start_row >= row_count_) return false;
+    std::vector<size_t> columns(schema_.column_count());
+    for (size_t i = 0; i < columns.size(); ++i) columns[i] = i;
+    return read_columns(start_row, batch_size, columns, out_batch);
+}
+
+bool ColumnarTable::read_columns(uint64_t start_row, uint32_t batch_size,
+                                 const std::vector<size_t>& columns,
+                                 executor::VectorBatch& out_batch) {
+    const std::shared_lock<std::shared_mutex> lock(state_mutex_);
+    const uint64_t rows = row_count_;
+    if (start_row >= rows) return false;
 
-    uint32_t actual_rows =
-        static_cast<uint32_t>(std::min(static_cast<uint64_t>(batch_size), row_count_ - start_row));
+    // A batch ends where the sealed chunks do, so each comes from one side only
+    const uint64_t end = start_row < sealed_rows_ ? sealed_rows_ : rows;
+    const auto actual_rows =
+        static_cast<uint32_t>(std::min(static_cast<uint64_t>(batch_size), end - start_row));
 
     // Ensure the output batch is correctly structured for the current schema
     out_batch.init_from_schema(schema_);
+    std::vector<bool> wanted(schema_.column_count(), false);
+    for (const size_t column : columns) {
+        if (column >= wanted.size()) return false;
+        wanted[column] = true;
+    }
+    for (size_t i = 0; i < wanted.size(); ++i) {
+        if (!wanted[i]) {
+            // Left at default values, still sized so the batch stays rectangular
+            size_column(out_batch.get_column(i), actual_rows);
+        } else if (!read_column(i, start_row, actual_rows, nullptr, out_batch)) {
+            return false;
+        }
+    }
+    out_batch.set_row_count(actual_rows);
+    return true;
+}
 
-    for (size_t i = 0; i < schema_.column_count(); ++i) {
-        const std::string base = name_ + ".col" + std::to_string(i);
-        std::ifstream n_in(storage_manager_.get_full_path(base + ".nulls.bin"), std::ios::binary);
-        std::ifstream d_in(storage_manager_.get_full_path(base + ".data.bin"), std::ios::binary);
-        if (!n_in.is_open() || !d_in.is_open()) return false;
+bool ColumnarTable::fetch_columns(uint64_t start_row, const std::vector<size_t>& columns,
+                                  const std::vector<uint32_t>* selection,
+                                  executor::VectorBatch& out_batch) {
+    const std::shared_lock<std::shared_mutex> lock(state_mutex_);
+    const auto rows = static_cast<uint32_t>(out_batch.row_count());
+    if (start_row + rows > row_count_) return false;
+    for (const size_t column : columns) {
+        if (column >= out_batch.column_count() ||
+            !read_column(column, start_row, rows, selection, out_batch)) {
+            return false;
+        }
+    }
+    return true;
+}
 
-        auto& target_col = out_batch.get_column(i);
-        const auto type = schema_.get_column(i).type();
+bool ColumnarTable::read_column(size_t column, uint64_t start_row, uint32_t rows,
+                                const std::vector<uint32_t>* selection,
+                                executor::VectorBatch& out_batch) {
+    if (start_row >= sealed_rows_) return read_delta_column(column, start_row, rows, out_batch);
+    if (column >= chunks_.size() || start_row + rows > sealed_rows_) return false;
+    const auto mapping = column_mapping(column);
+    if (!mapping) return false;
 
-        if (type == common::ValueType::TYPE_INT64) {
-            auto& num_vec = dynamic_cast<executor::NumericVector<int64_t>&>(target_col);
+    auto& target_col = out_batch.get_column(column);
+    const StorageKind kind =
+        storage_kind(schema_.get_column(column).type(), "ColumnarTable::read_batch");
 
-            n_in.seekg(static_cast<std::streamoff>(start_row), std::ios::beg);
-            std::vector<uint8_t> nulls(actual_rows);
-            n_in.read(reinterpret_cast<char*>(nulls.data()), actual_rows);
+    const auto& directory = chunks_[column];
+    auto chunk = std::upper_bound(
+        directory.begin(), directory.end(), start_row,
+        [](uint64_t row, const ChunkInfo& info) { return row < info.first_row; });
+    if (chunk == directory.begin()) return false;
+    --chunk;
 
-            d_in.seekg(static_cast<std::streamoff>(start_row * 8), std::ios::beg);
-            std::vector<int64_t> data(actual_rows);
-            d_in.read(reinterpret_cast<char*>(data.data()), actual_rows * 8);
+    const auto payload_of = [&mapping](const ChunkInfo& info) -> const char* {
+        const uint64_t start = info.offset + sizeof(ChunkHeader);
+        if (start + info.header.payload_size > mapping->size() ||
+            info.header.values_offset > info.header.payload_size) {
+            return nullptr;
+        }
+        return mapping->data() + start;
+    };
+    const auto is_null_at = [](const char* payload, const ChunkHeader& header, uint32_t bit) {
+        return header.has_nulls != 0U &&
+               ((static_cast<uint8_t>(payload[bit / 8]) >> (bit % 8)) & 1U) != 0;
+    };
 
-            for (uint32_t r = 0; r < actual_rows; ++r) {
-                if (nulls[r] != 0U) {
-                    num_vec.append(common::Value::make_null());
-                } else {
-                    num_vec.append(common::Value::make_int64(data[r]));
-                }
+    // Zero-copy: the whole batch sits in one plain chunk of a fixed-width column. Referencing
+    // the mapping beats decoding even a few selected rows
+    if ((kind == StorageKind::Integer || kind == StorageKind::Float) &&
+        chunk->header.encoding == ColumnEncoding::Plain &&
+        start_row + rows <= chunk->first_row + chunk->header.row_count) {
+        const char* const payload = payload_of(*chunk);
+        if (payload == nullptr || chunk->header.payload_size - chunk->header.values_offset <
+                                      chunk->header.row_count * sizeof(int64_t)) {
+            return false;
+        }
+        const auto begin = static_cast<uint32_t>(start_row - chunk->first_row);
+        const char* const values = payload + chunk->header.values_offset + begin * sizeof(int64_t);
+        if (kind == StorageKind::Integer) {
+            dynamic_cast<executor::NumericVector<int64_t>&>(target_col)
+                .reference(reinterpret_cast<const int64_t*>(values), rows, mapping);
+        } else {
+            dynamic_cast<executor::NumericVector<double>&>(target_col)
+                .reference(reinterpret_cast<const double*>(values), rows, mapping);
+        }
+        if (chunk->header.has_nulls != 0U) {
+            for (uint32_t r = 0; r < rows; ++r) {
+                if (is_null_at(payload, chunk->header, begin + r)) target_col.set_null(r, true);
             }
-        } else if (type == common::ValueType::TYPE_FLOAT64) {
-            auto& num_vec = dynamic_cast<executor::NumericVector<double>&>(target_col);
+        }
+        return true;
+    }
 
-            n_in.seekg(static_cast<std::streamoff>(start_row), std::ios::beg);
-            std::vector<uint8_t> nulls(actual_rows);
-            n_in.read(reinterpret_cast<char*>(nulls.data()), actual_rows);
+    // Size the output once; chunks then decode straight into its buffers
+    size_column(target_col, rows);
+    int64_t* int_out = nullptr;
+    double* float_out = nullptr;
+    uint8_t* bool_out = nullptr;
+    std::string* str_out = nullptr;
+    switch (kind) {
+        case StorageKind::Integer:
+            int_out = dynamic_cast<executor::NumericVector<int64_t>&>(target_col).raw_data_mut();
+            break;
+        case StorageKind::Float:
+            float_out = dynamic_cast<executor::NumericVector<double>&>(target_col).raw_data_mut();
+            break;
+        case StorageKind::Bool:
+            bool_out = dynamic_cast<executor::NumericVector<bool>&>(target_col).raw_data_mut();
+            break;
+        case StorageKind::String:
+            str_out = dynamic_cast<executor::StringVector&>(target_col).raw_data_mut();
+            break;
+    }
+
+    std::vector<int64_t> scratch;
+    if (selection == nullptr) {
+        uint32_t filled = 0;
+        while (filled < rows) {
+            if (chunk == directory.end()) return false;
+            const ChunkHeader& header = chunk->header;
+            const auto begin = static_cast<uint32_t>(start_row + filled - chunk->first_row);
+            const uint32_t count = std::min(header.row_count - begin, rows - filled);
 
-            d_in.seekg(static_cast<std::streamoff>(start_row * 8), std::ios::beg);
-            std::vector<double> data(actual_rows);
-            d_in.read(reinterpret_cast<char*>(data.data()), actual_rows * 8);
+            const char* const payload = payload_of(*chunk);
+            if (payload == nullptr) return false;
+            for (uint32_t r = 0; header.has_nulls != 0U && r < count; ++r) {
+                if (is_null_at(payload, header, begin + r)) target_col.set_null(filled + r, true);
+            }
+            const char* const data = payload + header.values_offset;
+            const size_t size = header.payload_size - header.values_offset;
 
-            for (uint32_t r = 0; r < actual_rows; ++r) {
-                if (nulls[r] != 0U) {
-                    num_vec.append(common::Value::make_null());
+            bool ok = false;
+            if (kind == StorageKind::String) {
+                ok = decode_string_chunk(header.encoding, data, size, header.row_count, begin,
+                                         count, str_out + filled);
+            } else if (kind == StorageKind::Integer) {
+                ok = decode_int_chunk(header.encoding, data, size, header.row_count, begin, count,
+                                      int_out + filled);
+            } else {
+                scratch.resize(count);
+                ok = decode_int_chunk(header.encoding, data, size, header.row_count, begin, count,
+                                      scratch.data());
+                if (kind == StorageKind::Float) {
+                    std::memcpy(float_out + filled, scratch.data(), count * sizeof(double));
                 } else {
-                    num_vec.append(common::Value::make_float64(data[r]));
+                    std::transform(scratch.begin(), scratch.end(), bool_out + filled,
+                                   [](int64_t v) { return static_cast<uint8_t>(v != 0); });
                 }
             }
-        } else {
-            throw std::runtime_error(
-                "ColumnarTable::read_batch: Symmetric serialization failure for type " +
-                std::to_string(static_cast<int>(type)));
+            if (!ok) return false;
+
+            filled += count;
+            ++chunk;
+        }
+        return true;
+    }
+
+    // Only the selected rows, one chunk at a time
+    std::vector<uint32_t> positions;
+    std::vector<std::string> strings;
+    const std::vector<uint32_t>& sel = *selection;
+    for (size_t next = 0; next < sel.size();) {
+        if (sel[next] >= rows) return false;
+        while (chunk != directory.end() &&
+               start_row + sel[next] >= chunk->first_row + chunk->header.row_count) {
+            ++chunk;
+        }
+        if (chunk == directory.end()) return false;
+        const ChunkHeader& header = chunk->header;
+        const uint64_t chunk_end = chunk->first_row + header.row_count;
+
+        const size_t first = next;
+        positions.clear();
+        for (; next < sel.size() && start_row + sel[next] < chunk_end; ++next) {
+            positions.push_back(static_cast<uint32_t>(start_row + sel[next] - chunk->first_row));
+        }
+
+        const char* const payload = payload_of(*chunk);
+        if (payload == nullptr) return false;
+        for (size_t i = 0; header.has_nulls != 0U && i < positions.size(); ++i) {
+            if (is_null_at(payload, header, positions[i])) {
+                target_col.set_null(sel[first + i], true);
+            }
+        }
+        const char* const data = payload + header.values_offset;
+        const size_t size = header.payload_size - header.values_offset;
+
+        if (kind == StorageKind::String) {
+            strings.resize(positions.size());
+            if (!decode_string_rows(header.encoding, data, size, header.row_count,
+                                    positions.data(), positions.size(), strings.data())) {
+                return false;
+            }
+            for (size_t i = 0; i < positions.size(); ++i) {
+                str_out[sel[first + i]] = std::move(strings[i]);
+            }
+            continue;
+        }
+        scratch.resize(positions.size());
+        if (!decode_int_rows(header.encoding, data, size, header.row_count, positions.data(),
+                             positions.size(), scratch.data())) {
+            return false;
+        }
+        for (size_t i = 0; i < positions.size(); ++i) {
+            const uint32_t row = sel[first + i];
+            if (kind == StorageKind::Integer) {
+                int_out[row] = scratch[i];
+            } else if (kind == StorageKind::Float) {
+                std::memcpy(float_out + row, &scratch[i], sizeof(double));
+            } else {
+                bool_out[row] = static_cast<uint8_t>(scratch[i] != 0);
+            }
         }
     }
-    out_batch.set_row_count(actual_rows);
     return true;
 }
 
+bool ColumnarTable::read_delta_column(size_t column, uint64_t start_row, uint32_t rows,
+                                      executor::VectorBatch& out_batch) {
+    const uint64_t begin = start_row - sealed_rows_;
+    if (!delta_ || column >= delta_->column_count() || begin + rows > delta_->row_count()) {
+        return false;
+    }
+    auto& target_col = out_batch.get_column(column);
+    target_col.clear();
+    std::vector<uint32_t> indices(rows);
+    std::iota(indices.begin(), indices.end(), static_cast<uint32_t>(begin));
+    return target_col.gather_from(delta_->get_column(column), indices.data(), rows);
+}
+
 }  // namespace cloudsql::storage
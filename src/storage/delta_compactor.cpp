@@ -0,0 +1,86 @@
+/**
+ * @file delta_compactor.cpp
+ * @brief Background sealing of ColumnarTable deltas
+ */
+
+#include "storage/delta_compactor.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "storage/columnar_table.hpp"
+
+namespace cloudsql::storage {
+
+DeltaCompactor::~DeltaCompactor() { stop(); }
+
+void DeltaCompactor::add_table(const std::shared_ptr<ColumnarTable>& table) {
+    const std::scoped_lock<std::mutex> lock(tables_mutex_);
+    tables_.push_back(table);
+}
+
+size_t DeltaCompactor::compact_all() {
+    std::vector<std::shared_ptr<ColumnarTable>> due;
+    {
+        const std::scoped_lock<std::mutex> lock(tables_mutex_);
+        tables_.erase(std::remove_if(tables_.begin(), tables_.end(),
+                                     [](const auto& table) { return table.expired(); }),
+                      tables_.end());
+        for (const auto& weak : tables_) {
+            auto table = weak.lock();
+            if (table && table->delta_rows() >= table->chunk_rows()) {
+                due.push_back(std::move(table));
+            }
+        }
+    }
+
+    size_t compacted = 0;
+    for (const auto& table : due) {
+        if (!table->compact()) {
+            std::cerr << "--- [DeltaCompactor] Failed to compact " << table->name() << " ---"
+                      << std::endl;
+            continue;
+        }
+        compactions_.fetch_add(1, std::memory_order_relaxed);
+        compacted++;
+    }
+    return compacted;
+}
+
+void DeltaCompactor::start(const Options& options) {
+    const std::scoped_lock<std::mutex> lock(worker_latch_);
+    if (worker_.joinable()) {
+        return;
+    }
+    options_ = options;
+    worker_stop_ = false;
+    worker_ = std::thread(&DeltaCompactor::run, this);
+}
+
+void DeltaCompactor::stop() {
+    {
+        const std::scoped_lock<std::mutex> lock(worker_latch_);
+        if (!worker_.joinable()) {
+            return;
+        }
+        worker_stop_ = true;
+    }
+    worker_cv_.notify_all();
+    worker_.join();
+}
+
+void DeltaCompactor::run() {
+    std::unique_lock<std::mutex> lock(worker_latch_);
+    while (!worker_cv_.wait_for(lock, options_.naptime, [this] { return worker_stop_; })) {
+        lock.unlock();
+        static_cast<void>(compact_all());
+        lock.lock();
+    }
+}
+
+}  // namespace cloudsql::storage
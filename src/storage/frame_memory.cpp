@@ -0,0 +1,137 @@
+/**
+ * @file frame_memory.cpp
+ * @brief FrameMemory implementation
+ */
+
+#include "storage/frame_memory.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <new>
+#include <string>
+
+namespace cloudsql::storage {
+
+namespace {
+
+constexpr size_t BASE_PAGE_SIZE = 4096;
+/* From <linux/mempolicy.h>; preferred rather than bound, so a full node spills over */
+constexpr int MPOL_PREFERRED_POLICY = 1;
+constexpr int MAX_NUMA_NODES = 64;
+
+size_t round_up(size_t value, size_t unit) {
+    return (value + unit - 1) / unit * unit;
+}
+
+size_t round_nearest(size_t value, size_t unit) {
+    return (value + unit / 2) / unit * unit;
+}
+
+}  // namespace
+
+const char* frame_backing_name(FrameBacking backing) {
+    switch (backing) {
+        case FrameBacking::Pages:
+            return "pages";
+        case FrameBacking::TransparentHuge:
+            return "thp";
+        case FrameBacking::HugeTlb:
+            return "hugetlb";
+    }
+    return "pages";
+}
+
+FrameMemory::FrameMemory(size_t frame_count, size_t frame_size, bool huge_pages)
+    : frame_size_(frame_size) {
+    const size_t bytes = std::max<size_t>(1, frame_count * frame_size);
+    const bool huge = huge_pages && bytes >= HUGE_PAGE_SIZE;
+
+    if (huge) {
+        length_ = round_up(bytes, HUGE_PAGE_SIZE);
+        void* const addr = ::mmap(nullptr, length_, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (addr != MAP_FAILED) {
+            base_ = static_cast<char*>(addr);
+            backing_ = FrameBacking::HugeTlb;
+            return;
+        }
+
+        /* No reserved huge pages: over-map, trim to 2 MB alignment and ask for THP */
+        void* const raw = ::mmap(nullptr, length_ + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        const auto start = reinterpret_cast<uintptr_t>(raw);
+        const uintptr_t aligned = round_up(start, HUGE_PAGE_SIZE);
+        if (aligned > start) {
+            static_cast<void>(::munmap(raw, aligned - start));
+        }
+        const uintptr_t tail = aligned + length_;
+        const uintptr_t raw_end = start + length_ + HUGE_PAGE_SIZE;
+        if (raw_end > tail) {
+            static_cast<void>(::munmap(reinterpret_cast<void*>(tail), raw_end - tail));
+        }
+        base_ = reinterpret_cast<char*>(aligned);
+        backing_ = ::madvise(base_, length_, MADV_HUGEPAGE) == 0 ? FrameBacking::TransparentHuge
+                                                                 : FrameBacking::Pages;
+        return;
+    }
+
+    length_ = round_up(bytes, BASE_PAGE_SIZE);
+    void* const addr = ::mmap(nullptr, length_, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    base_ = static_cast<char*>(addr);
+}
+
+FrameMemory::~FrameMemory() {
+    if (base_ != nullptr) {
+        static_cast<void>(::munmap(base_, length_));
+    }
+}
+
+bool FrameMemory::bind(size_t first_frame, size_t count, int node) {
+    if (node < 0 || node >= MAX_NUMA_NODES) {
+        return false;
+    }
+    const size_t unit = backing_ == FrameBacking::Pages ? BASE_PAGE_SIZE : HUGE_PAGE_SIZE;
+    const size_t begin = round_nearest(first_frame * frame_size_, unit);
+    const size_t last = (first_frame + count) * frame_size_;
+    /* The range reaching into the final page takes all of it */
+    const size_t end = last + unit > length_ ? length_ : round_nearest(last, unit);
+    if (begin >= end) {
+        return true;
+    }
+    /* The kernel reads maxnode - 1 bits of the mask */
+    const unsigned long mask = 1UL << static_cast<unsigned>(node);
+    return ::syscall(SYS_mbind, base_ + begin, end - begin, MPOL_PREFERRED_POLICY, &mask,
+                     static_cast<unsigned long>(MAX_NUMA_NODES + 1), 0) == 0;
+}
+
+int FrameMemory::numa_node_count() {
+    /* A range list such as "0" or "0-3"; node ids are dense in practice */
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string list;
+    if (!online || !std::getline(online, list) || list.empty()) {
+        return 1;
+    }
+    const size_t last = list.find_last_of(",-");
+    try {
+        const int max_node = std::stoi(last == std::string::npos ? list : list.substr(last + 1));
+        return std::max(1, std::min(MAX_NUMA_NODES, max_node + 1));
+    } catch (const std::exception&) {
+        return 1;
+    }
+}
+
+}  // namespace cloudsql::storage
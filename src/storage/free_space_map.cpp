@@ -0,0 +1,188 @@
+/**
+ * @file free_space_map.cpp
+ * @brief Free-space map implementation
+ */
+
+#include "storage/free_space_map.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/page_guard.hpp"
+
+namespace cloudsql::storage {
+
+namespace {
+
+constexpr uint8_t MAX_CATEGORY = UINT8_MAX;
+
+FreeSpaceMap::MapPageHeader read_header(const char* data) {
+    FreeSpaceMap::MapPageHeader header{};
+    std::memcpy(&header, data, sizeof(header));
+    return header;
+}
+
+void write_header(char* data, const FreeSpaceMap::MapPageHeader& header) {
+    std::memcpy(data, &header, sizeof(header));
+}
+
+const uint8_t* entries(const char* data) {
+    return reinterpret_cast<const uint8_t*>(data + sizeof(FreeSpaceMap::MapPageHeader));
+}
+
+uint8_t* entries(char* data) {
+    return reinterpret_cast<uint8_t*>(data + sizeof(FreeSpaceMap::MapPageHeader));
+}
+
+}  // namespace
+
+FreeSpaceMap::FreeSpaceMap(std::string filename, BufferPoolManager& bpm)
+    : filename_(std::move(filename)),
+      bpm_(bpm),
+      granule_(bpm.page_size() / (MAX_CATEGORY + 1U)),
+      entries_per_page_(bpm.page_size() - sizeof(MapPageHeader)) {}
+
+uint8_t FreeSpaceMap::category_for(size_t free_bytes) const {
+    return static_cast<uint8_t>(std::min<size_t>(free_bytes / granule_, MAX_CATEGORY));
+}
+
+uint32_t FreeSpaceMap::page_count() {
+    const ReadPageGuard guard = bpm_.fetch_page_read(filename_, 0);
+    if (!guard.valid()) {
+        return 0;
+    }
+    return read_header(guard.data()).tracked_pages;
+}
+
+uint32_t FreeSpaceMap::find_page(size_t needed) {
+    /* Round up so any page in the chosen category really has `needed` bytes */
+    const size_t want = (needed + granule_ - 1) / granule_;
+    if (want > MAX_CATEGORY) {
+        return INVALID_PAGE;
+    }
+
+    uint32_t tracked = 0;
+    uint32_t hint = 0;
+    {
+        const ReadPageGuard guard = bpm_.fetch_page_read(filename_, 0);
+        if (!guard.valid()) {
+            return INVALID_PAGE;
+        }
+        const MapPageHeader header = read_header(guard.data());
+        tracked = header.tracked_pages;
+        hint = header.search_hint < tracked ? header.search_hint : 0;
+    }
+
+    /* Next-fit: resume where the last search succeeded, then wrap around */
+    uint32_t found = search(hint, tracked, static_cast<uint8_t>(want));
+    if (found == INVALID_PAGE && hint != 0) {
+        found = search(0, hint, static_cast<uint8_t>(want));
+    }
+    if (found != INVALID_PAGE && found != hint) {
+        set_search_hint(found);
+    }
+    return found;
+}
+
+uint32_t FreeSpaceMap::search(uint32_t begin, uint32_t end, uint8_t want) {
+    uint32_t page_num = begin;
+    while (page_num < end) {
+        const auto map_page = static_cast<uint32_t>(page_num / entries_per_page_);
+        const auto first = static_cast<uint32_t>(map_page * entries_per_page_);
+        const uint32_t last = std::min<uint32_t>(first + entries_per_page_, end);
+        const size_t lo = page_num - first;
+        const size_t hi = last - first;
+
+        bool tighten = false;
+        {
+            const ReadPageGuard guard = bpm_.fetch_page_read(filename_, map_page);
+            if (!guard.valid()) {
+                return INVALID_PAGE;
+            }
+            const MapPageHeader header = read_header(guard.data());
+            if (header.max_category >= want) {
+                const uint8_t* const slots = entries(guard.data());
+                for (size_t i = lo; i < hi; ++i) {
+                    if (slots[i] >= want) {
+                        return static_cast<uint32_t>(first + i);
+                    }
+                }
+                /* A failed scan of the whole map page means its bound is stale */
+                tighten = lo == 0 && hi == entries_per_page_;
+            }
+        }
+
+        if (tighten) {
+            WritePageGuard guard = bpm_.fetch_page_write(filename_, map_page);
+            if (guard.valid()) {
+                MapPageHeader header = read_header(guard.data());
+                const uint8_t* const slots = entries(guard.data());
+                header.max_category = *std::max_element(slots, slots + entries_per_page_);
+                write_header(guard.data(), header);
+            }
+        }
+        page_num = last;
+    }
+    return INVALID_PAGE;
+}
+
+void FreeSpaceMap::record(uint32_t page_num, size_t free_bytes) {
+    const uint8_t category = category_for(free_bytes);
+    const auto map_page = static_cast<uint32_t>(page_num / entries_per_page_);
+    const size_t index = page_num % entries_per_page_;
+
+    {
+        WritePageGuard guard = bpm_.fetch_page_write(filename_, map_page);
+        if (!guard.valid()) {
+            return;
+        }
+        entries(guard.data())[index] = category;
+        MapPageHeader header = read_header(guard.data());
+        if (category > header.max_category) {
+            header.max_category = category;
+            write_header(guard.data(), header);
+        }
+    }
+
+    /* Extend the tracked range; never hold two map pages at once */
+    {
+        const ReadPageGuard guard = bpm_.fetch_page_read(filename_, 0);
+        if (!guard.valid() || read_header(guard.data()).tracked_pages > page_num) {
+            return;
+        }
+    }
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, 0);
+    if (guard.valid()) {
+        MapPageHeader header = read_header(guard.data());
+        header.tracked_pages = std::max(header.tracked_pages, page_num + 1);
+        write_header(guard.data(), header);
+    }
+}
+
+void FreeSpaceMap::reset() {
+    const uint32_t tracked = page_count();
+    const auto map_pages =
+        static_cast<uint32_t>((tracked + entries_per_page_ - 1) / entries_per_page_);
+    for (uint32_t map_page = 0; map_page < std::max<uint32_t>(map_pages, 1); ++map_page) {
+        WritePageGuard guard = bpm_.fetch_page_write(filename_, map_page);
+        if (guard.valid()) {
+            std::memset(guard.data(), 0, bpm_.page_size());
+        }
+    }
+}
+
+void FreeSpaceMap::set_search_hint(uint32_t page_num) {
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, 0);
+    if (guard.valid()) {
+        MapPageHeader header = read_header(guard.data());
+        header.search_hint = page_num;
+        write_header(guard.data(), header);
+    }
+}
+
+}  // namespace cloudsql::storage
@@ -0,0 +1,779 @@
+/**
+ * @file hash_index.cpp
+ * @brief Extendible hash index implementation
+ */
+
+#include "storage/hash_index.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/value.hpp"
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/heap_table.hpp"
+#include "storage/page_guard.hpp"
+#include "storage/page_map.hpp"
+
+namespace cloudsql::storage {
+
+namespace {
+
+using BucketHeader = HashIndex::BucketHeader;
+using MetaPage = HashIndex::MetaPage;
+using TupleId = HeapTable::TupleId;
+
+constexpr uint32_t NO_PAGE = 0; /* The meta page is never part of a chain */
+constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+constexpr size_t CELL_OVERHEAD =
+    sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(uint16_t);
+
+/* The directory never grows past this many bits, whatever the page size allows */
+constexpr uint32_t DEPTH_LIMIT = 30;
+
+/* A bulk load sizes the directory so buckets start ~70% full */
+constexpr double BULK_FILL = 0.7;
+
+/* Numbers that compare equal must encode alike, so integral values share one tag */
+enum KeyTag : char { TAG_NULL = 'n', TAG_INT = 'i', TAG_FLOAT = 'f', TAG_BOOL = 'b', TAG_TEXT = 's' };
+
+bool is_integer_type(common::ValueType type) {
+    return type == common::ValueType::TYPE_INT8 || type == common::ValueType::TYPE_INT16 ||
+           type == common::ValueType::TYPE_INT32 || type == common::ValueType::TYPE_INT64;
+}
+
+bool is_float_type(common::ValueType type) {
+    return type == common::ValueType::TYPE_FLOAT32 || type == common::ValueType::TYPE_FLOAT64 ||
+           type == common::ValueType::TYPE_DECIMAL;
+}
+
+bool encode_key(const common::Value& value, std::string* out) {
+    const common::ValueType type = value.type();
+    if (type == common::ValueType::TYPE_NULL) {
+        out->assign(1, TAG_NULL);
+    } else if (is_integer_type(type)) {
+        const int64_t v = value.to_int64();
+        out->assign(1, TAG_INT);
+        out->append(reinterpret_cast<const char*>(&v), sizeof(v));
+    } else if (is_float_type(type)) {
+        constexpr double INT64_BOUND = 9223372036854775808.0;
+        const double v = value.to_float64();
+        if (v >= -INT64_BOUND && v < INT64_BOUND && std::trunc(v) == v) {
+            const auto i = static_cast<int64_t>(v);
+            out->assign(1, TAG_INT);
+            out->append(reinterpret_cast<const char*>(&i), sizeof(i));
+        } else {
+            out->assign(1, TAG_FLOAT);
+            out->append(reinterpret_cast<const char*>(&v), sizeof(v));
+        }
+    } else if (type == common::ValueType::TYPE_BOOL) {
+        out->assign(1, TAG_BOOL);
+        out->push_back(value.as_bool() ? 1 : 0);
+    } else {
+        out->assign(1, TAG_TEXT);
+        out->append(value.to_string());
+    }
+    return out->size() <= HashIndex::MAX_KEY_SIZE;
+}
+
+/* FNV-1a with a final mix so the low bits, which index the directory, are well spread.
+ * The hash is stored in every cell, so it must not change between builds. */
+uint32_t hash_key(const std::string& key) {
+    uint64_t h = 14695981039346656037ULL;
+    for (const char c : key) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<uint32_t>(h);
+}
+
+uint32_t depth_mask(uint32_t depth) {
+    return depth == 0 ? 0 : (1U << depth) - 1;
+}
+
+std::string make_cell(uint32_t hash, const std::string& key, const TupleId& tid) {
+    std::string cell(CELL_OVERHEAD + key.size(), '\0');
+    char* p = cell.data();
+    const auto key_len = static_cast<uint16_t>(key.size());
+    std::memcpy(p, &hash, sizeof(hash));
+    p += sizeof(hash);
+    std::memcpy(p, &key_len, sizeof(key_len));
+    p += sizeof(key_len);
+    std::memcpy(p, key.data(), key.size());
+    p += key.size();
+    std::memcpy(p, &tid.page_num, sizeof(tid.page_num));
+    p += sizeof(tid.page_num);
+    std::memcpy(p, &tid.slot_num, sizeof(tid.slot_num));
+    return cell;
+}
+
+struct CellView {
+    uint32_t hash = 0;
+    uint16_t key_len = 0;
+    const char* key = nullptr;
+    TupleId tid;
+    size_t size = 0;
+};
+
+CellView view_cell(const char* p) {
+    CellView cell;
+    std::memcpy(&cell.hash, p, sizeof(cell.hash));
+    p += sizeof(cell.hash);
+    std::memcpy(&cell.key_len, p, sizeof(cell.key_len));
+    p += sizeof(cell.key_len);
+    cell.key = p;
+    p += cell.key_len;
+    std::memcpy(&cell.tid.page_num, p, sizeof(cell.tid.page_num));
+    p += sizeof(cell.tid.page_num);
+    std::memcpy(&cell.tid.slot_num, p, sizeof(cell.tid.slot_num));
+    cell.size = CELL_OVERHEAD + cell.key_len;
+    return cell;
+}
+
+BucketHeader read_bucket(const char* page) {
+    BucketHeader header{};
+    std::memcpy(&header, page, sizeof(BucketHeader));
+    return header;
+}
+
+void write_bucket(char* page, const BucketHeader& header) {
+    std::memcpy(page, &header, sizeof(BucketHeader));
+}
+
+const char* cells_begin(const char* page) {
+    return page + sizeof(BucketHeader);
+}
+
+char* cells_begin(char* page) {
+    return page + sizeof(BucketHeader);
+}
+
+void init_bucket(char* page, size_t page_size, uint16_t depth) {
+    std::memset(page, 0, page_size);
+    write_bucket(page, BucketHeader{HashIndex::BUCKET_MAGIC, depth, 0, 0, NO_PAGE});
+}
+
+bool fits(const BucketHeader& header, size_t page_size, size_t cell_size) {
+    return sizeof(BucketHeader) + header.used + cell_size <= page_size;
+}
+
+/* Offset of a cell identical to `cell` (same key and tuple id), or NOT_FOUND */
+size_t find_cell(const char* page, const BucketHeader& header, const std::string& cell) {
+    const char* const cells = cells_begin(page);
+    for (size_t offset = 0; offset < header.used;) {
+        const CellView view = view_cell(cells + offset);
+        if (view.size == cell.size() && std::memcmp(cells + offset, cell.data(), cell.size()) == 0) {
+            return offset;
+        }
+        offset += view.size;
+    }
+    return NOT_FOUND;
+}
+
+void append_cell(char* page, BucketHeader& header, const std::string& cell) {
+    std::memcpy(cells_begin(page) + header.used, cell.data(), cell.size());
+    header.used += static_cast<uint32_t>(cell.size());
+    header.num_entries++;
+    write_bucket(page, header);
+}
+
+void erase_cell(char* page, BucketHeader& header, size_t offset, size_t size) {
+    char* const cells = cells_begin(page);
+    std::memmove(cells + offset, cells + offset + size, header.used - offset - size);
+    std::memset(cells + header.used - size, 0, size);
+    header.used -= static_cast<uint32_t>(size);
+    header.num_entries--;
+    write_bucket(page, header);
+}
+
+void collect_cells(const char* page, std::vector<std::string>* out, uint32_t incoming_hash,
+                   bool* separable) {
+    const BucketHeader header = read_bucket(page);
+    const char* const cells = cells_begin(page);
+    for (size_t offset = 0; offset < header.used;) {
+        const CellView view = view_cell(cells + offset);
+        out->emplace_back(cells + offset, view.size);
+        if (view.hash != incoming_hash) {
+            *separable = true;
+        }
+        offset += view.size;
+    }
+}
+
+MetaPage read_meta(const char* page) {
+    MetaPage meta{};
+    std::memcpy(&meta, page, sizeof(MetaPage));
+    return meta;
+}
+
+void write_meta(char* page, const MetaPage& meta) {
+    std::memcpy(page, &meta, sizeof(MetaPage));
+}
+
+uint32_t directory_page(const char* meta_page, uint32_t index) {
+    uint32_t page = NO_PAGE;
+    std::memcpy(&page, meta_page + sizeof(MetaPage) + index * sizeof(uint32_t), sizeof(page));
+    return page;
+}
+
+void set_directory_page(char* meta_page, uint32_t index, uint32_t page) {
+    std::memcpy(meta_page + sizeof(MetaPage) + index * sizeof(uint32_t), &page, sizeof(page));
+}
+
+/* Deepest directory whose page list still fits in the meta page */
+uint32_t max_directory_depth(size_t page_size) {
+    const uint64_t slots_per_page = page_size / sizeof(uint32_t);
+    const uint64_t capacity = slots_per_page * ((page_size - sizeof(MetaPage)) / sizeof(uint32_t));
+    uint32_t depth = 0;
+    while (depth < DEPTH_LIMIT && (uint64_t{2} << depth) <= capacity) {
+        ++depth;
+    }
+    return depth;
+}
+
+}  // namespace
+
+HashIndex::HashIndex(std::string index_name, BufferPoolManager& bpm, common::ValueType key_type)
+    : index_name_(std::move(index_name)),
+      filename_(index_name_ + ".idx"),
+      bpm_(bpm),
+      page_size_(bpm.page_size()),
+      key_type_(key_type),
+      slots_per_page_(static_cast<uint32_t>(page_size_ / sizeof(uint32_t))),
+      max_depth_(max_directory_depth(page_size_)) {}
+
+bool HashIndex::create() {
+    if (!bpm_.open_file(filename_)) {
+        return false;
+    }
+
+    constexpr uint32_t DIRECTORY_PAGE = 1;
+    constexpr uint32_t FIRST_BUCKET = 2;
+    {
+        WritePageGuard bucket = bpm_.fetch_page_write(filename_, FIRST_BUCKET);
+        if (!bucket.valid()) {
+            return false;
+        }
+        init_bucket(bucket.data(), page_size_, 0);
+    }
+    {
+        WritePageGuard directory = bpm_.fetch_page_write(filename_, DIRECTORY_PAGE);
+        if (!directory.valid()) {
+            return false;
+        }
+        std::memset(directory.data(), 0, page_size_);
+        std::memcpy(directory.data(), &FIRST_BUCKET, sizeof(FIRST_BUCKET));
+    }
+
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, META_PAGE);
+    if (!guard.valid()) {
+        return false;
+    }
+    MetaPage meta{};
+    meta.magic = META_MAGIC;
+    meta.global_depth = 0;
+    meta.page_count = FIRST_BUCKET + 1;
+    meta.free_list = 0;
+    meta.directory_pages = 1;
+    std::memset(guard.data(), 0, page_size_);
+    write_meta(guard.data(), meta);
+    set_directory_page(guard.data(), 0, DIRECTORY_PAGE);
+    return true;
+}
+
+bool HashIndex::open() {
+    return bpm_.open_file(filename_);
+}
+
+void HashIndex::close() {
+    bpm_.close_file(filename_);
+}
+
+bool HashIndex::drop() {
+    static_cast<void>(bpm_.close_file(filename_));
+    static_cast<void>(std::remove((filename_ + PageMap::FILE_SUFFIX).c_str()));
+    return (std::remove(filename_.c_str()) == 0);
+}
+
+uint32_t HashIndex::global_depth() {
+    const ReadPageGuard guard = bpm_.fetch_page_read(filename_, META_PAGE);
+    if (!guard.valid()) {
+        return 0;
+    }
+    const MetaPage meta = read_meta(guard.data());
+    return meta.magic == META_MAGIC ? meta.global_depth : 0;
+}
+
+uint32_t HashIndex::directory_slot(const char* meta_page, uint32_t slot) {
+    const ReadPageGuard guard =
+        bpm_.fetch_page_read(filename_, directory_page(meta_page, slot / slots_per_page_));
+    if (!guard.valid()) {
+        return NO_PAGE;
+    }
+    uint32_t bucket = NO_PAGE;
+    std::memcpy(&bucket, guard.data() + (slot % slots_per_page_) * sizeof(uint32_t),
+                sizeof(bucket));
+    return bucket;
+}
+
+bool HashIndex::set_directory_slot(const char* meta_page, uint32_t slot, uint32_t bucket) {
+    WritePageGuard guard =
+        bpm_.fetch_page_write(filename_, directory_page(meta_page, slot / slots_per_page_));
+    if (!guard.valid()) {
+        return false;
+    }
+    std::memcpy(guard.data() + (slot % slots_per_page_) * sizeof(uint32_t), &bucket,
+                sizeof(bucket));
+    return true;
+}
+
+bool HashIndex::double_directory(char* meta_page, MetaPage& meta) {
+    if (meta.global_depth >= max_depth_) {
+        return false;
+    }
+    const uint32_t size = 1U << meta.global_depth;
+    if (size < slots_per_page_) {
+        /* Both halves share the first directory page */
+        WritePageGuard guard = bpm_.fetch_page_write(filename_, directory_page(meta_page, 0));
+        if (!guard.valid()) {
+            return false;
+        }
+        std::memcpy(guard.data() + size * sizeof(uint32_t), guard.data(), size * sizeof(uint32_t));
+    } else {
+        /* The upper half is a page-by-page copy of the lower */
+        const uint32_t pages = size / slots_per_page_;
+        for (uint32_t i = 0; i < pages; ++i) {
+            const uint32_t page_num = allocate_page(meta);
+            const ReadPageGuard src = bpm_.fetch_page_read(filename_, directory_page(meta_page, i));
+            WritePageGuard dst = bpm_.fetch_page_write(filename_, page_num);
+            if (!src.valid() || !dst.valid()) {
+                return false;
+            }
+            std::memcpy(dst.data(), src.data(), page_size_);
+            set_directory_page(meta_page, meta.directory_pages++, page_num);
+        }
+    }
+    meta.global_depth++;
+    return true;
+}
+
+bool HashIndex::presize(char* meta_page, MetaPage& meta, uint32_t depth) {
+    const uint32_t first = directory_slot(meta_page, 0);
+    {
+        const ReadPageGuard bucket = bpm_.fetch_page_read(filename_, first);
+        if (!bucket.valid()) {
+            return false;
+        }
+        const BucketHeader header = read_bucket(bucket.data());
+        if (header.num_entries != 0 || header.overflow != NO_PAGE) {
+            return true;
+        }
+    }
+
+    while (meta.global_depth < depth) {
+        if (!double_directory(meta_page, meta)) {
+            return false;
+        }
+    }
+    for (uint32_t slot = 0; slot < (1U << depth); ++slot) {
+        const uint32_t page_num = slot == 0 ? first : allocate_page(meta);
+        {
+            WritePageGuard bucket = bpm_.fetch_page_write(filename_, page_num);
+            if (!bucket.valid()) {
+                return false;
+            }
+            init_bucket(bucket.data(), page_size_, static_cast<uint16_t>(depth));
+        }
+        if (slot != 0 && !set_directory_slot(meta_page, slot, page_num)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t HashIndex::allocate_page(MetaPage& meta) {
+    if (meta.free_list != NO_PAGE) {
+        const uint32_t page_num = meta.free_list;
+        const ReadPageGuard guard = bpm_.fetch_page_read(filename_, page_num);
+        meta.free_list = guard.valid() ? read_bucket(guard.data()).overflow : NO_PAGE;
+        return page_num;
+    }
+    return meta.page_count++;
+}
+
+void HashIndex::free_page(MetaPage& meta, uint32_t page_num) {
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, page_num);
+    if (!guard.valid()) {
+        return;
+    }
+    std::memset(guard.data(), 0, page_size_);
+    write_bucket(guard.data(), BucketHeader{0, 0, 0, 0, meta.free_list});
+    meta.free_list = page_num;
+}
+
+HashIndex::Placement HashIndex::place(WritePageGuard& bucket, const std::string& cell) {
+    BucketHeader header = read_bucket(bucket.data());
+    if (header.magic != BUCKET_MAGIC) {
+        return Placement::Failed;
+    }
+    if (find_cell(bucket.data(), header, cell) != NOT_FOUND) {
+        return Placement::Present;
+    }
+
+    /* The whole chain is checked for the entry before it is added anywhere */
+    uint32_t room = fits(header, page_size_, cell.size()) ? bucket.page_id() : NO_PAGE;
+    for (uint32_t next = header.overflow; next != NO_PAGE;) {
+        const ReadPageGuard page = bpm_.fetch_page_read(filename_, next);
+        if (!page.valid()) {
+            return Placement::Failed;
+        }
+        const BucketHeader page_header = read_bucket(page.data());
+        if (find_cell(page.data(), page_header, cell) != NOT_FOUND) {
+            return Placement::Present;
+        }
+        if (room == NO_PAGE && fits(page_header, page_size_, cell.size())) {
+            room = next;
+        }
+        next = page_header.overflow;
+    }
+
+    if (room == NO_PAGE) {
+        return Placement::Full;
+    }
+    if (room == bucket.page_id()) {
+        append_cell(bucket.data(), header, cell);
+        return Placement::Added;
+    }
+    WritePageGuard page = bpm_.fetch_page_write(filename_, room);
+    if (!page.valid()) {
+        return Placement::Failed;
+    }
+    BucketHeader page_header = read_bucket(page.data());
+    append_cell(page.data(), page_header, cell);
+    return Placement::Added;
+}
+
+bool HashIndex::split(char* meta_page, MetaPage& meta, uint32_t slot, WritePageGuard& bucket,
+                      uint32_t incoming_hash) {
+    const BucketHeader header = read_bucket(bucket.data());
+    const uint16_t depth = header.local_depth;
+    if (depth >= max_depth_) {
+        return false;
+    }
+
+    std::vector<std::string> cells;
+    std::vector<uint32_t> spare;
+    bool separable = false;
+    collect_cells(bucket.data(), &cells, incoming_hash, &separable);
+    for (uint32_t next = header.overflow; next != NO_PAGE;) {
+        const ReadPageGuard page = bpm_.fetch_page_read(filename_, next);
+        if (!page.valid()) {
+            return false;
+        }
+        collect_cells(page.data(), &cells, incoming_hash, &separable);
+        spare.push_back(next);
+        next = read_bucket(page.data()).overflow;
+    }
+    /* Every entry hashes like the incoming one: no split can make room */
+    if (!separable) {
+        return false;
+    }
+
+    if (depth == meta.global_depth && !double_directory(meta_page, meta)) {
+        return false;
+    }
+    const uint32_t sibling = allocate_page(meta);
+
+    std::vector<std::string> low;
+    std::vector<std::string> high;
+    for (auto& cell : cells) {
+        uint32_t hash = 0;
+        std::memcpy(&hash, cell.data(), sizeof(hash));
+        ((hash >> depth) & 1U) != 0 ? high.push_back(std::move(cell))
+                                    : low.push_back(std::move(cell));
+    }
+
+    const auto new_depth = static_cast<uint16_t>(depth + 1);
+    if (!write_chain(bucket.data(), low, new_depth, meta, spare)) {
+        return false;
+    }
+    {
+        WritePageGuard sibling_guard = bpm_.fetch_page_write(filename_, sibling);
+        if (!sibling_guard.valid() ||
+            !write_chain(sibling_guard.data(), high, new_depth, meta, spare)) {
+            return false;
+        }
+    }
+    for (const uint32_t page_num : spare) {
+        free_page(meta, page_num);
+    }
+
+    /* Slots agreeing on the low `depth` bits with bit `depth` set now name the sibling */
+    const uint32_t first = (slot & depth_mask(depth)) | (1U << depth);
+    for (uint32_t s = first; s < (1U << meta.global_depth); s += (2U << depth)) {
+        if (!set_directory_slot(meta_page, s, sibling)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HashIndex::write_chain(char* first, const std::vector<std::string>& cells, uint16_t depth,
+                            MetaPage& meta, std::vector<uint32_t>& spare) {
+    init_bucket(first, page_size_, depth);
+    char* current = first;
+    BucketHeader header = read_bucket(first);
+    WritePageGuard overflow; /* The overflow page being filled, if past the first */
+    for (const auto& cell : cells) {
+        if (!fits(header, page_size_, cell.size())) {
+            uint32_t next = NO_PAGE;
+            if (!spare.empty()) {
+                next = spare.back();
+                spare.pop_back();
+            } else {
+                next = allocate_page(meta);
+            }
+            header.overflow = next;
+            write_bucket(current, header);
+
+            WritePageGuard next_guard = bpm_.fetch_page_write(filename_, next);
+            if (!next_guard.valid()) {
+                return false;
+            }
+            overflow = std::move(next_guard);
+            current = overflow.data();
+            init_bucket(current, page_size_, depth);
+            header = read_bucket(current);
+        }
+        append_cell(current, header, cell);
+    }
+    return true;
+}
+
+bool HashIndex::append_overflow(MetaPage& meta, WritePageGuard& bucket, const std::string& cell) {
+    BucketHeader header = read_bucket(bucket.data());
+    const uint32_t page_num = allocate_page(meta);
+    WritePageGuard page = bpm_.fetch_page_write(filename_, page_num);
+    if (!page.valid()) {
+        return false;
+    }
+    init_bucket(page.data(), page_size_, header.local_depth);
+    BucketHeader page_header = read_bucket(page.data());
+    append_cell(page.data(), page_header, cell);
+
+    /* Linked right behind the bucket, so chaining never walks the chain */
+    page_header.overflow = header.overflow;
+    write_bucket(page.data(), page_header);
+    header.overflow = page_num;
+    write_bucket(bucket.data(), header);
+    return true;
+}
+
+bool HashIndex::insert(const common::Value& key, HeapTable::TupleId tuple_id) {
+    std::string encoded;
+    if (!encode_key(key, &encoded)) {
+        std::cerr << "--- [HashIndex] Key of " << encoded.size() << " bytes exceeds "
+                  << MAX_KEY_SIZE << " ---" << std::endl;
+        return false;
+    }
+    const uint32_t hash = hash_key(encoded);
+    const std::string cell = make_cell(hash, encoded, tuple_id);
+
+    {
+        /* Optimistic pass: only the bucket is latched exclusively */
+        ReadPageGuard meta_guard = bpm_.fetch_page_read(filename_, META_PAGE);
+        if (!meta_guard.valid()) {
+            return false;
+        }
+        const MetaPage meta = read_meta(meta_guard.data());
+        if (meta.magic != META_MAGIC) {
+            return false;
+        }
+        WritePageGuard bucket = bpm_.fetch_page_write(
+            filename_, directory_slot(meta_guard.data(), hash & depth_mask(meta.global_depth)));
+        meta_guard.release();
+        if (!bucket.valid()) {
+            return false;
+        }
+        const Placement placed = place(bucket, cell);
+        if (placed != Placement::Full) {
+            return placed != Placement::Failed;
+        }
+    }
+
+    /* Pessimistic pass: the directory is ours until the entry is placed */
+    WritePageGuard meta_guard = bpm_.fetch_page_write(filename_, META_PAGE);
+    if (!meta_guard.valid()) {
+        return false;
+    }
+    MetaPage meta = read_meta(meta_guard.data());
+    while (true) {
+        const uint32_t slot = hash & depth_mask(meta.global_depth);
+        WritePageGuard bucket =
+            bpm_.fetch_page_write(filename_, directory_slot(meta_guard.data(), slot));
+        if (!bucket.valid()) {
+            return false;
+        }
+        const Placement placed = place(bucket, cell);
+        if (placed != Placement::Full) {
+            write_meta(meta_guard.data(), meta);
+            return placed != Placement::Failed;
+        }
+        if (!split(meta_guard.data(), meta, slot, bucket, hash)) {
+            const bool ok = append_overflow(meta, bucket, cell);
+            write_meta(meta_guard.data(), meta);
+            return ok;
+        }
+        write_meta(meta_guard.data(), meta);
+    }
+}
+
+bool HashIndex::remove(const common::Value& key, HeapTable::TupleId tuple_id) {
+    std::string encoded;
+    if (!encode_key(key, &encoded)) {
+        return false;
+    }
+    const std::string cell = make_cell(hash_key(encoded), encoded, tuple_id);
+    uint32_t hash = 0;
+    std::memcpy(&hash, cell.data(), sizeof(hash));
+
+    ReadPageGuard meta_guard = bpm_.fetch_page_read(filename_, META_PAGE);
+    if (!meta_guard.valid()) {
+        return false;
+    }
+    const MetaPage meta = read_meta(meta_guard.data());
+    if (meta.magic != META_MAGIC) {
+        return false;
+    }
+    WritePageGuard bucket = bpm_.fetch_page_write(
+        filename_, directory_slot(meta_guard.data(), hash & depth_mask(meta.global_depth)));
+    meta_guard.release();
+    if (!bucket.valid()) {
+        return false;
+    }
+
+    BucketHeader header = read_bucket(bucket.data());
+    size_t offset = find_cell(bucket.data(), header, cell);
+    if (offset != NOT_FOUND) {
+        erase_cell(bucket.data(), header, offset, cell.size());
+        return true;
+    }
+    /* Emptied overflow pages stay on the chain until the bucket next splits */
+    for (uint32_t next = header.overflow; next != NO_PAGE;) {
+        WritePageGuard page = bpm_.fetch_page_write(filename_, next);
+        if (!page.valid()) {
+            return false;
+        }
+        BucketHeader page_header = read_bucket(page.data());
+        offset = find_cell(page.data(), page_header, cell);
+        if (offset != NOT_FOUND) {
+            erase_cell(page.data(), page_header, offset, cell.size());
+            return true;
+        }
+        next = page_header.overflow;
+    }
+    return true;
+}
+
+bool HashIndex::bulk_load(std::vector<Entry> entries) {
+    if (entries.empty()) {
+        return true;
+    }
+
+    {
+        WritePageGuard meta_guard = bpm_.fetch_page_write(filename_, META_PAGE);
+        if (!meta_guard.valid()) {
+            return false;
+        }
+        MetaPage meta = read_meta(meta_guard.data());
+        if (meta.magic != META_MAGIC) {
+            return false;
+        }
+        if (meta.global_depth == 0) {
+            size_t bytes = 0;
+            std::string encoded;
+            for (const auto& entry : entries) {
+                static_cast<void>(encode_key(entry.key, &encoded));
+                bytes += CELL_OVERHEAD + encoded.size();
+            }
+            const double per_bucket =
+                static_cast<double>(page_size_ - sizeof(BucketHeader)) * BULK_FILL;
+            uint32_t depth = 0;
+            while (depth < max_depth_ &&
+                   static_cast<double>(uint64_t{1} << depth) * per_bucket <
+                       static_cast<double>(bytes)) {
+                ++depth;
+            }
+            if (depth > 0 && !presize(meta_guard.data(), meta, depth)) {
+                return false;
+            }
+            write_meta(meta_guard.data(), meta);
+        }
+    }
+
+    for (const auto& entry : entries) {
+        if (!insert(entry.key, entry.tuple_id)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<HeapTable::TupleId> HashIndex::search(const common::Value& key) {
+    std::string encoded;
+    if (!encode_key(key, &encoded)) {
+        return {};
+    }
+    const uint32_t hash = hash_key(encoded);
+
+    ReadPageGuard meta_guard = bpm_.fetch_page_read(filename_, META_PAGE);
+    if (!meta_guard.valid()) {
+        return {};
+    }
+    const MetaPage meta = read_meta(meta_guard.data());
+    if (meta.magic != META_MAGIC) {
+        return {};
+    }
+    const ReadPageGuard bucket = bpm_.fetch_page_read(
+        filename_, directory_slot(meta_guard.data(), hash & depth_mask(meta.global_depth)));
+    meta_guard.release();
+
+    std::vector<HeapTable::TupleId> results;
+    const auto scan_page = [&](const char* page) {
+        const BucketHeader header = read_bucket(page);
+        const char* const cells = cells_begin(page);
+        for (size_t offset = 0; offset < header.used;) {
+            const CellView cell = view_cell(cells + offset);
+            if (cell.hash == hash && cell.key_len == encoded.size() &&
+                std::memcmp(cell.key, encoded.data(), encoded.size()) == 0) {
+                results.push_back(cell.tid);
+            }
+            offset += cell.size;
+        }
+        return header.overflow;
+    };
+
+    if (!bucket.valid()) {
+        return results;
+    }
+    /* The bucket stays latched while its overflow chain is read */
+    for (uint32_t next = scan_page(bucket.data()); next != NO_PAGE;) {
+        const ReadPageGuard page = bpm_.fetch_page_read(filename_, next);
+        if (!page.valid()) {
+            break;
+        }
+        next = scan_page(page.data());
+    }
+    return results;
+}
+
+}  // namespace cloudsql::storage
@@ -8,7 +8,7 @@
 
 #include "storage/heap_table.hpp"
 
-#include <array>
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -16,7 +16,9 @@
 #include <iostream>
 #include <iterator>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -24,23 +26,359 @@
 #include "executor/types.hpp"
 #include "storage/buffer_pool_manager.hpp"
 #include "storage/page.hpp"
+#include "storage/page_guard.hpp"
+#include "storage/page_map.hpp"
 
 namespace cloudsql::storage {
 
 namespace {
-constexpr uint16_t DEFAULT_SLOT_COUNT = 64;
+constexpr uint16_t DEFAULT_SLOT_COUNT = 64; /* Legacy text pages only */
+constexpr size_t PAGE_LSN_SIZE = sizeof(int32_t);
+
+/* Binary record layout (byte offsets from the start of the record) */
+constexpr size_t REC_XMAX_OFFSET = 8;
+constexpr size_t REC_LENGTH_OFFSET = 16;
+constexpr size_t REC_NCOLS_OFFSET = 18;
+constexpr size_t REC_BITMAP_OFFSET = 20;
+constexpr size_t FIXED_WIDTH_8 = 8;
+constexpr size_t FIXED_WIDTH_BOOL = 1;
+constexpr size_t VARLENA_DESC_SIZE = 4;
+constexpr size_t BITS_PER_BYTE = 8;
+
+/* Sequential read-ahead: start once a scan passes this page, then double up to the max */
+constexpr uint32_t READ_AHEAD_TRIGGER_PAGES = 2;
+constexpr uint32_t READ_AHEAD_INITIAL_PAGES = 4;
+constexpr uint32_t READ_AHEAD_MAX_PAGES = 64;
+
+size_t fixed_width(common::ValueType type) {
+    switch (type) {
+        case common::ValueType::TYPE_INT8:
+        case common::ValueType::TYPE_INT16:
+        case common::ValueType::TYPE_INT32:
+        case common::ValueType::TYPE_INT64:
+        case common::ValueType::TYPE_FLOAT32:
+        case common::ValueType::TYPE_FLOAT64:
+            return FIXED_WIDTH_8;
+        case common::ValueType::TYPE_BOOL:
+            return FIXED_WIDTH_BOOL;
+        default:
+            return VARLENA_DESC_SIZE;
+    }
+}
+
+/* Offset of the page LSN, in the last bytes of the page */
+size_t lsn_offset(size_t page_size) {
+    return page_size - PAGE_LSN_SIZE;
+}
+
+/* Largest record (with its slot) a page can take */
+size_t max_record_space(size_t page_size) {
+    return lsn_offset(page_size) - sizeof(HeapTable::PageHeader);
+}
+
+size_t bitmap_size(size_t num_columns) {
+    return (num_columns + BITS_PER_BYTE - 1) / BITS_PER_BYTE;
+}
+
+char* slot_ptr(char* buffer, uint16_t slot) {
+    return std::next(buffer, static_cast<std::ptrdiff_t>(sizeof(HeapTable::PageHeader) +
+                                                         (slot * sizeof(uint16_t))));
+}
+
+const char* slot_ptr(const char* buffer, uint16_t slot) {
+    return std::next(buffer, static_cast<std::ptrdiff_t>(sizeof(HeapTable::PageHeader) +
+                                                         (slot * sizeof(uint16_t))));
+}
+
+/* End of the record area: the page LSN, when the page has one, follows it */
+size_t page_end(const HeapTable::PageHeader& header, size_t page_size) {
+    return (header.flags & HeapTable::PAGE_FLAG_PAGE_LSN) != 0 ? lsn_offset(page_size)
+                                                                : page_size;
+}
+
+/* Initialise an empty page in the binary layout */
+void init_binary_page(char* buffer, size_t page_size) {
+    std::memset(buffer, 0, page_size);
+    HeapTable::PageHeader header{};
+    header.num_slots = 0;
+    header.free_space_offset = static_cast<uint16_t>(lsn_offset(page_size));
+    header.flags = HeapTable::PAGE_FLAG_BINARY_TUPLES | HeapTable::PAGE_FLAG_PAGE_LSN;
+    std::memcpy(buffer, &header, sizeof(HeapTable::PageHeader));
+    const int32_t lsn = HeapTable::NO_PAGE_LSN;
+    std::memcpy(std::next(buffer, static_cast<std::ptrdiff_t>(lsn_offset(page_size))), &lsn,
+                sizeof(lsn));
+}
+
+/* Bytes available for one more record and its slot on a binary page (0 for legacy pages) */
+size_t page_free_bytes(const HeapTable::PageHeader& header) {
+    if ((header.flags & HeapTable::PAGE_FLAG_BINARY_TUPLES) == 0) {
+        return 0;
+    }
+    const size_t dir_end = sizeof(HeapTable::PageHeader) + ((header.num_slots + 1U) * sizeof(uint16_t));
+    return header.free_space_offset > dir_end ? header.free_space_offset - dir_end : 0;
+}
+
+/* Append `record` to a binary page with page_free_bytes() >= its size; returns its slot */
+uint16_t append_record(char* buffer, HeapTable::PageHeader& header,
+                       const std::vector<char>& record) {
+    const auto offset = static_cast<uint16_t>(header.free_space_offset - record.size());
+    std::memcpy(std::next(buffer, static_cast<std::ptrdiff_t>(offset)), record.data(),
+                record.size());
+    std::memcpy(slot_ptr(buffer, header.num_slots), &offset, sizeof(uint16_t));
+    header.free_space_offset = offset;
+    return header.num_slots++;
+}
+
+/* Pack the live records of a binary page against its end; slot numbers are unchanged */
+void compact_binary_page(char* buffer, size_t page_size) {
+    HeapTable::PageHeader header{};
+    std::memcpy(&header, buffer, sizeof(HeapTable::PageHeader));
+
+    std::vector<char> scratch(page_size);
+    const size_t end = page_end(header, page_size);
+    size_t top = end;
+    for (uint16_t slot = 0; slot < header.num_slots; ++slot) {
+        uint16_t offset = 0;
+        std::memcpy(&offset, slot_ptr(buffer, slot), sizeof(uint16_t));
+        if (offset == 0) {
+            continue;
+        }
+        uint16_t length = 0;
+        std::memcpy(&length, std::next(buffer, static_cast<std::ptrdiff_t>(offset + REC_LENGTH_OFFSET)),
+                    sizeof(uint16_t));
+        top -= length;
+        std::memcpy(std::next(scratch.data(), static_cast<std::ptrdiff_t>(top)),
+                    std::next(buffer, static_cast<std::ptrdiff_t>(offset)), length);
+        offset = static_cast<uint16_t>(top);
+        std::memcpy(slot_ptr(buffer, slot), &offset, sizeof(uint16_t));
+    }
+
+    header.free_space_offset = static_cast<uint16_t>(top);
+    std::memcpy(buffer, &header, sizeof(HeapTable::PageHeader));
+    std::memcpy(std::next(buffer, static_cast<std::ptrdiff_t>(top)),
+                std::next(scratch.data(), static_cast<std::ptrdiff_t>(top)), end - top);
+}
+
+/* Convert a value to the column's fixed-width representation; false means store NULL */
+bool encode_int(const common::Value& val, int64_t& out) {
+    if (val.is_numeric() || val.type() == common::ValueType::TYPE_BOOL) {
+        out = val.to_int64();
+        return true;
+    }
+    try {
+        out = std::stoll(val.to_string());
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+bool encode_float(const common::Value& val, double& out) {
+    if (val.is_numeric() || val.type() == common::ValueType::TYPE_BOOL) {
+        out = val.to_float64();
+        return true;
+    }
+    try {
+        out = std::stod(val.to_string());
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+/* Typed buffers of one VectorBatch column while a page is decoded into it */
+struct BatchColumn {
+    int64_t* ints = nullptr;
+    double* floats = nullptr;
+    uint8_t* bools = nullptr;
+    std::string* strings = nullptr;
+    uint8_t* nulls = nullptr;
+};
+
+/* Resize a column created by VectorBatch::init_from_schema and expose its buffers */
+BatchColumn resize_batch_column(executor::ColumnVector& column, size_t rows) {
+    BatchColumn target;
+    if (auto* iv = dynamic_cast<executor::NumericVector<int64_t>*>(&column)) {
+        iv->resize(rows);
+        target.ints = iv->raw_data_mut();
+    } else if (auto* dv = dynamic_cast<executor::NumericVector<double>*>(&column)) {
+        dv->resize(rows);
+        target.floats = dv->raw_data_mut();
+    } else if (auto* bv = dynamic_cast<executor::NumericVector<bool>*>(&column)) {
+        bv->resize(rows);
+        target.bools = bv->raw_data_mut();
+    } else if (auto* sv = dynamic_cast<executor::StringVector*>(&column)) {
+        sv->resize(rows);
+        target.strings = sv->raw_data_mut();
+    } else {
+        throw std::runtime_error("HeapTable: unsupported batch column vector");
+    }
+    target.nulls = column.null_data_mut();
+    return target;
+}
 }  // anonymous namespace
 
 HeapTable::HeapTable(std::string table_name, BufferPoolManager& bpm, executor::Schema schema)
     : table_name_(std::move(table_name)),
-      filename_(table_name_ + ".heap"),
+      filename_(table_name_ + FILE_EXTENSION),
       bpm_(bpm),
-      schema_(std::move(schema)) {}
+      schema_(std::move(schema)),
+      fsm_(table_name_ + ".fsm", bpm_) {
+    compute_layout();
+}
+
+void HeapTable::compute_layout() {
+    column_offsets_.clear();
+    column_offsets_.reserve(schema_.column_count());
+    size_t offset = 0;
+    for (size_t i = 0; i < schema_.column_count(); ++i) {
+        column_offsets_.push_back(static_cast<uint16_t>(offset));
+        offset += fixed_width(schema_.get_column(i).type());
+    }
+    fixed_size_ = static_cast<uint16_t>(offset);
+}
+
+std::vector<char> HeapTable::serialize(const executor::Tuple& tuple, uint64_t xmin) const {
+    const size_t num_cols = schema_.column_count();
+    const size_t bitmap_len = bitmap_size(num_cols);
+    const size_t fixed_start = REC_BITMAP_OFFSET + bitmap_len;
+
+    std::vector<char> out(fixed_start + fixed_size_, 0);
+    const TupleHeader mvcc{xmin, 0};
+    std::memcpy(out.data(), &mvcc, sizeof(TupleHeader));
+    const auto ncols = static_cast<uint16_t>(num_cols);
+    std::memcpy(out.data() + REC_NCOLS_OFFSET, &ncols, sizeof(uint16_t));
+
+    for (size_t i = 0; i < num_cols; ++i) {
+        const common::ValueType type = schema_.get_column(i).type();
+        char* const field = out.data() + fixed_start + column_offsets_[i];
+        const bool present = i < tuple.size() && !tuple.get(i).is_null();
+        bool encoded = false;
+
+        if (present) {
+            const common::Value& val = tuple.get(i);
+            switch (type) {
+                case common::ValueType::TYPE_INT8:
+                case common::ValueType::TYPE_INT16:
+                case common::ValueType::TYPE_INT32:
+                case common::ValueType::TYPE_INT64: {
+                    int64_t v = 0;
+                    encoded = encode_int(val, v);
+                    std::memcpy(field, &v, sizeof(v));
+                    break;
+                }
+                case common::ValueType::TYPE_FLOAT32:
+                case common::ValueType::TYPE_FLOAT64: {
+                    double v = 0;
+                    encoded = encode_float(val, v);
+                    std::memcpy(field, &v, sizeof(v));
+                    break;
+                }
+                case common::ValueType::TYPE_BOOL: {
+                    bool v = false;
+                    if (val.type() == common::ValueType::TYPE_BOOL) {
+                        v = val.as_bool();
+                    } else if (val.is_numeric()) {
+                        v = val.to_int64() != 0;
+                    } else {
+                        const std::string str = val.to_string();
+                        v = (str == "TRUE" || str == "1");
+                    }
+                    *field = v ? 1 : 0;
+                    encoded = true;
+                    break;
+                }
+                default: {
+                    const std::string str = val.to_string();
+                    const auto var_off = static_cast<uint16_t>(out.size());
+                    const auto var_len = static_cast<uint16_t>(str.size());
+                    std::memcpy(field, &var_off, sizeof(uint16_t));
+                    std::memcpy(field + sizeof(uint16_t), &var_len, sizeof(uint16_t));
+                    out.insert(out.end(), str.begin(), str.end());
+                    encoded = true;
+                    break;
+                }
+            }
+        }
+
+        if (!encoded) {
+            out[REC_BITMAP_OFFSET + (i / BITS_PER_BYTE)] |=
+                static_cast<char>(1U << (i % BITS_PER_BYTE));
+        }
+    }
+
+    const auto length = static_cast<uint16_t>(out.size());
+    std::memcpy(out.data() + REC_LENGTH_OFFSET, &length, sizeof(uint16_t));
+    return out;
+}
+
+void HeapTable::deserialize(const char* record, TupleMeta& out_meta) const {
+    TupleHeader mvcc{};
+    std::memcpy(&mvcc, record, sizeof(TupleHeader));
+    out_meta.xmin = mvcc.xmin;
+    out_meta.xmax = mvcc.xmax;
+
+    uint16_t stored_cols = 0;
+    std::memcpy(&stored_cols, record + REC_NCOLS_OFFSET, sizeof(uint16_t));
+    const size_t fixed_start = REC_BITMAP_OFFSET + bitmap_size(stored_cols);
+
+    /* Decoded in place, so a caller that reuses out_meta does not allocate per record */
+    auto& values = out_meta.tuple.values();
+    values.clear();
+    values.reserve(schema_.column_count());
+    for (size_t i = 0; i < schema_.column_count(); ++i) {
+        const bool is_null =
+            i >= stored_cols ||
+            (static_cast<uint8_t>(record[REC_BITMAP_OFFSET + (i / BITS_PER_BYTE)]) &
+             (1U << (i % BITS_PER_BYTE))) != 0;
+        if (is_null || (i < read_columns_.size() && !read_columns_[i])) {
+            values.push_back(common::Value::make_null());
+            continue;
+        }
+
+        const char* const field = record + fixed_start + column_offsets_[i];
+        switch (schema_.get_column(i).type()) {
+            case common::ValueType::TYPE_INT8:
+            case common::ValueType::TYPE_INT16:
+            case common::ValueType::TYPE_INT32:
+            case common::ValueType::TYPE_INT64: {
+                int64_t v = 0;
+                std::memcpy(&v, field, sizeof(v));
+                values.push_back(common::Value::make_int64(v));
+                break;
+            }
+            case common::ValueType::TYPE_FLOAT32:
+            case common::ValueType::TYPE_FLOAT64: {
+                double v = 0;
+                std::memcpy(&v, field, sizeof(v));
+                values.push_back(common::Value::make_float64(v));
+                break;
+            }
+            case common::ValueType::TYPE_BOOL:
+                values.push_back(common::Value::make_bool(*field != 0));
+                break;
+            default: {
+                uint16_t var_off = 0;
+                uint16_t var_len = 0;
+                std::memcpy(&var_off, field, sizeof(uint16_t));
+                std::memcpy(&var_len, field + sizeof(uint16_t), sizeof(uint16_t));
+                values.push_back(
+                    common::Value::make_text(std::string_view(record + var_off, var_len)));
+                break;
+            }
+        }
+    }
+}
 
 /* --- Iterator Implementation --- */
 
 HeapTable::Iterator::Iterator(HeapTable& table) : table_(table), next_id_(0, 0), last_id_(0, 0) {}
 
+HeapTable::Iterator::Iterator(HeapTable& table, std::vector<PageRange> ranges)
+    : table_(table), next_id_(0, 0), last_id_(0, 0), ranged_(true), ranges_(std::move(ranges)) {
+    enter_range();
+}
+
 bool HeapTable::Iterator::next(executor::Tuple& out_tuple) {
     TupleMeta meta;
     while (next_meta(meta)) {
@@ -56,124 +394,343 @@ bool HeapTable::Iterator::next(executor::Tuple& out_tuple) {
  * @brief Fetches next versioned record from scan
  */
 bool HeapTable::Iterator::next_meta(TupleMeta& out_meta) {
-    if (eof_) {
-        return false;
-    }
+    while (!eof_) {
+        /* The guard is dropped before returning so callers may modify the page between calls */
+        const ReadPageGuard guard =
+            table_.bpm_.fetch_page_read(table_.filename_, next_id_.page_num, AccessType::Scan);
+        if (!guard.valid()) {
+            eof_ = true;
+            return false;
+        }
 
-    while (true) {
-        if (table_.get_meta(next_id_, out_meta)) {
-            /* Record successfully retrieved */
-            last_id_ = next_id_;
+        PageHeader header{};
+        std::memcpy(&header, guard.data(), sizeof(PageHeader));
 
-            /* Prepare for next call: advance slot index */
-            next_id_.slot_num++;
-            return true;
+        /* An uninitialized page marks the end of the heap */
+        if (header.free_space_offset == 0) {
+            eof_ = true;
+            return false;
         }
 
-        /* Check if the current page has more slots to explore */
-        std::array<char, Page::PAGE_SIZE> buf{};
-        if (table_.read_page(next_id_.page_num, buf.data())) {
-            PageHeader header{};
-            std::memcpy(&header, buf.data(), sizeof(PageHeader));
-            if (next_id_.slot_num < header.num_slots) {
-                /* Current slot is empty/deleted; skip to the next */
-                next_id_.slot_num++;
-                continue;
+        while (next_id_.slot_num < header.num_slots) {
+            const uint16_t slot = next_id_.slot_num++;
+            if (table_.read_record(guard.data(), header, slot, out_meta)) {
+                last_id_ = TupleId(next_id_.page_num, slot);
+                return true;
             }
         }
 
-        /* Move to the beginning of the next physical page */
-        next_id_.page_num++;
-        next_id_.slot_num = 0;
+        next_page();
+    }
+    return false;
+}
 
-        /* If the next page cannot be read, end of file is reached */
-        if (!table_.read_page(next_id_.page_num, buf.data())) {
+bool HeapTable::Iterator::next_batch(executor::VectorBatch& out, size_t max_rows,
+                                     const VisibilityFn& visible) {
+    size_t appended = 0;
+    while (!eof_ && appended < max_rows) {
+        const ReadPageGuard guard =
+            table_.bpm_.fetch_page_read(table_.filename_, next_id_.page_num, AccessType::Scan);
+        if (!guard.valid()) {
             eof_ = true;
-            return false;
+            break;
         }
 
-        /* Validate that the page has been initialized */
-        PageHeader next_header{};
-        std::memcpy(&next_header, buf.data(), sizeof(PageHeader));
-        if (next_header.free_space_offset == 0) {
+        PageHeader header{};
+        std::memcpy(&header, guard.data(), sizeof(PageHeader));
+        if (header.free_space_offset == 0) {
             eof_ = true;
-            return false;
+            break;
+        }
+
+        appended += table_.read_page_batch(guard.data(), header, &next_id_.slot_num,
+                                           max_rows - appended, visible, out);
+        if (next_id_.slot_num >= header.num_slots) {
+            next_page();
         }
     }
+    return appended > 0;
+}
+
+void HeapTable::Iterator::next_page() {
+    /* Move to the beginning of the next physical page */
+    next_id_.page_num++;
+    next_id_.slot_num = 0;
+    if (!ranged_ || ranges_[range_].end == PageRange::TO_END) {
+        read_ahead();
+        return;
+    }
+    if (next_id_.page_num >= ranges_[range_].end) {
+        range_++;
+        enter_range();
+    }
+}
+
+void HeapTable::Iterator::enter_range() {
+    if (range_ >= ranges_.size()) {
+        eof_ = true;
+        return;
+    }
+    const PageRange& range = ranges_[range_];
+    next_id_ = TupleId(range.first, 0);
+    /* A range is read whole, so all of it is requested at once; the end of the heap is not
+     * known, so a range running to it gets the usual growing read-ahead instead */
+    const uint32_t count = std::min(range.end - range.first, READ_AHEAD_MAX_PAGES);
+    if (range.end != PageRange::TO_END && count > 1) {
+        table_.bpm_.prefetch_pages(table_.filename_, range.first, count);
+    }
+}
+
+void HeapTable::Iterator::read_ahead() {
+    const uint32_t page = next_id_.page_num;
+    if (page < READ_AHEAD_TRIGGER_PAGES) {
+        return; /* Short scans never pay for read-ahead */
+    }
+    if (read_ahead_until_ > page + read_ahead_window_ / 2) {
+        return; /* Still well inside the window already requested */
+    }
+
+    read_ahead_window_ = read_ahead_window_ == 0
+                             ? READ_AHEAD_INITIAL_PAGES
+                             : std::min(read_ahead_window_ * 2, READ_AHEAD_MAX_PAGES);
+    /* The current page is being fetched synchronously; start after it */
+    const uint32_t first = std::max(page + 1, read_ahead_until_);
+    const uint32_t until = page + 1 + read_ahead_window_;
+    if (until > first) {
+        table_.bpm_.prefetch_pages(table_.filename_, first, until - first);
+        read_ahead_until_ = until;
+    }
 }
 
 /* --- HeapTable Methods --- */
 
 HeapTable::TupleId HeapTable::insert(const executor::Tuple& tuple, uint64_t xmin) {
-    uint32_t page_num = 0;
-    std::array<char, Page::PAGE_SIZE> buffer{};
+    const std::vector<char> record = serialize(tuple, xmin);
+    if (record.size() + sizeof(uint16_t) > max_record_space(bpm_.page_size())) {
+        std::cerr << "--- [HeapTable] Tuple of " << record.size() << " bytes exceeds page size ---"
+                  << std::endl;
+        return {};
+    }
+
+    /* Go straight to a page the free-space map says has room, else extend the heap */
+    uint32_t page_num = fsm_.find_page(record.size());
+    if (page_num == FreeSpaceMap::INVALID_PAGE) {
+        page_num = fsm_.page_count();
+    }
 
     while (true) {
-        /* Read existing page or initialize a new one */
-        if (!read_page(page_num, buffer.data())) {
-            std::memset(buffer.data(), 0, Page::PAGE_SIZE);
-            PageHeader header{};
-            header.free_space_offset =
-                static_cast<uint16_t>(sizeof(PageHeader) + (DEFAULT_SLOT_COUNT * sizeof(uint16_t)));
-            header.num_slots = 0;
-            std::memcpy(buffer.data(), &header, sizeof(PageHeader));
-            static_cast<void>(write_page(page_num, buffer.data()));
+        WritePageGuard guard = bpm_.fetch_page_write(filename_, page_num);
+        if (!guard.valid()) {
+            std::cerr << "--- [HeapTable] Buffer pool exhausted during insert ---" << std::endl;
+            return {};
         }
+        char* const buffer = guard.data();
 
         PageHeader header{};
-        std::memcpy(&header, buffer.data(), sizeof(PageHeader));
-        if (header.free_space_offset == 0) {
-            header.free_space_offset =
-                static_cast<uint16_t>(sizeof(PageHeader) + (DEFAULT_SLOT_COUNT * sizeof(uint16_t)));
-            header.num_slots = 0;
+        std::memcpy(&header, buffer, sizeof(PageHeader));
+
+        /* Fresh pages, and legacy pages that never received a tuple, adopt the binary layout */
+        if (header.free_space_offset == 0 ||
+            ((header.flags & PAGE_FLAG_BINARY_TUPLES) == 0 && header.num_slots == 0)) {
+            init_binary_page(buffer, bpm_.page_size());
+            std::memcpy(&header, buffer, sizeof(PageHeader));
         }
 
-        /* Serialize tuple data prefixed by MVCC header (xmin|xmax|) */
-        std::string data_str = std::to_string(xmin) + "|0|";
-        for (const auto& val : tuple.values()) {
-            data_str += val.to_string() + "|";
+        /* Legacy text pages with data are left as they are */
+        if (page_free_bytes(header) >= record.size()) {
+            const TupleId tid(page_num, append_record(buffer, header, record));
+            std::memcpy(buffer, &header, sizeof(PageHeader));
+            fsm_.record(page_num, page_free_bytes(header));
+            return tid;
         }
 
-        const auto required = static_cast<uint16_t>(data_str.size() + 1);
+        /* The map was stale (or has not seen this page yet): correct it and look again */
+        fsm_.record(page_num, page_free_bytes(header));
+        guard.release();
 
-        /* Check for sufficient free space in the current page */
-        if (header.free_space_offset + required < Page::PAGE_SIZE &&
-            header.num_slots < DEFAULT_SLOT_COUNT) {
-            const uint16_t offset = header.free_space_offset;
-            std::memcpy(std::next(buffer.data(), static_cast<std::ptrdiff_t>(offset)),
-                        data_str.c_str(), data_str.size() + 1);
+        const uint32_t next = fsm_.find_page(record.size());
+        page_num = next != FreeSpaceMap::INVALID_PAGE && next != page_num
+                       ? next
+                       : std::max(fsm_.page_count(), page_num + 1);
+    }
+}
 
-            /* Update slot directory */
-            std::memcpy(std::next(buffer.data(),
-                                  static_cast<std::ptrdiff_t>(
-                                      sizeof(PageHeader) + (header.num_slots * sizeof(uint16_t)))),
-                        &offset, sizeof(uint16_t));
+std::vector<HeapTable::TupleId> HeapTable::insert_batch(const std::vector<executor::Tuple>& tuples,
+                                                        uint64_t xmin) {
+    std::vector<TupleId> ids;
+    ids.reserve(tuples.size());
+    if (tuples.empty()) {
+        return ids;
+    }
 
-            TupleId tid(page_num, header.num_slots);
-            header.num_slots++;
-            header.free_space_offset += required;
+    /* `record` holds the serialized form of tuples[ids.size()] */
+    std::vector<char> record;
+    const auto load = [&]() {
+        record = serialize(tuples[ids.size()], xmin);
+        if (record.size() + sizeof(uint16_t) > max_record_space(bpm_.page_size())) {
+            std::cerr << "--- [HeapTable] Tuple of " << record.size()
+                      << " bytes exceeds page size ---" << std::endl;
+            return false;
+        }
+        return true;
+    };
+    if (!load()) {
+        return ids;
+    }
 
-            std::memcpy(buffer.data(), &header, sizeof(PageHeader));
-            static_cast<void>(write_page(page_num, buffer.data()));
-            return tid;
+    uint32_t page_num = fsm_.find_page(record.size());
+    if (page_num == FreeSpaceMap::INVALID_PAGE) {
+        page_num = fsm_.page_count();
+    }
+
+    while (true) {
+        WritePageGuard guard = bpm_.fetch_page_write(filename_, page_num);
+        if (!guard.valid()) {
+            std::cerr << "--- [HeapTable] Buffer pool exhausted during insert ---" << std::endl;
+            return ids;
         }
+        char* const buffer = guard.data();
 
-        /* Page is full; attempt insertion in the next page */
-        page_num++;
+        PageHeader header{};
+        std::memcpy(&header, buffer, sizeof(PageHeader));
+        if (header.free_space_offset == 0 ||
+            ((header.flags & PAGE_FLAG_BINARY_TUPLES) == 0 && header.num_slots == 0)) {
+            init_binary_page(buffer, bpm_.page_size());
+            std::memcpy(&header, buffer, sizeof(PageHeader));
+        }
+
+        /* Fill the page while the latch is held, then publish its free space once */
+        bool more = true;
+        while (more && page_free_bytes(header) >= record.size()) {
+            ids.emplace_back(page_num, append_record(buffer, header, record));
+            more = ids.size() < tuples.size() && load();
+        }
+        std::memcpy(buffer, &header, sizeof(PageHeader));
+        fsm_.record(page_num, page_free_bytes(header));
+        if (!more) {
+            return ids;
+        }
+        guard.release();
+
+        const uint32_t found = fsm_.find_page(record.size());
+        page_num = found != FreeSpaceMap::INVALID_PAGE && found != page_num
+                       ? found
+                       : std::max(fsm_.page_count(), page_num + 1);
+    }
+}
+
+bool HeapTable::insert_at(const TupleId& tuple_id, const executor::Tuple& tuple, uint64_t xmin) {
+    const std::vector<char> record = serialize(tuple, xmin);
+    if (record.size() + sizeof(uint16_t) > max_record_space(bpm_.page_size())) {
+        return false;
+    }
+
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, tuple_id.page_num);
+    if (!guard.valid()) {
+        return false;
+    }
+    char* const buffer = guard.data();
+
+    PageHeader header{};
+    std::memcpy(&header, buffer, sizeof(PageHeader));
+    if (header.free_space_offset == 0 ||
+        ((header.flags & PAGE_FLAG_BINARY_TUPLES) == 0 && header.num_slots == 0)) {
+        init_binary_page(buffer, bpm_.page_size());
+        std::memcpy(&header, buffer, sizeof(PageHeader));
+    }
+    if ((header.flags & PAGE_FLAG_BINARY_TUPLES) == 0) {
+        return false;
+    }
+
+    if (tuple_id.slot_num < header.num_slots) {
+        uint16_t offset = 0;
+        std::memcpy(&offset, slot_ptr(buffer, tuple_id.slot_num), sizeof(uint16_t));
+        if (offset != 0) {
+            return true;
+        }
+    }
+
+    /* Room for the record plus any slots the directory has to grow by */
+    const uint16_t num_slots =
+        std::max<uint16_t>(header.num_slots, static_cast<uint16_t>(tuple_id.slot_num + 1U));
+    const size_t dir_end = sizeof(PageHeader) + (num_slots * sizeof(uint16_t));
+    const auto fits = [&]() {
+        return header.free_space_offset >= dir_end &&
+               header.free_space_offset - dir_end >= record.size();
+    };
+    if (!fits()) {
+        compact_binary_page(buffer, bpm_.page_size());
+        std::memcpy(&header, buffer, sizeof(PageHeader));
+        if (!fits()) {
+            return false;
+        }
+    }
+
+    const uint16_t zero = 0;
+    for (uint16_t slot = header.num_slots; slot < num_slots; ++slot) {
+        std::memcpy(slot_ptr(buffer, slot), &zero, sizeof(uint16_t));
+    }
+    header.num_slots = num_slots;
+    const auto offset = static_cast<uint16_t>(header.free_space_offset - record.size());
+    std::memcpy(std::next(buffer, static_cast<std::ptrdiff_t>(offset)), record.data(),
+                record.size());
+    std::memcpy(slot_ptr(buffer, tuple_id.slot_num), &offset, sizeof(uint16_t));
+    header.free_space_offset = offset;
+    std::memcpy(buffer, &header, sizeof(PageHeader));
+    fsm_.record(tuple_id.page_num, page_free_bytes(header));
+    return true;
+}
+
+int32_t HeapTable::page_lsn(uint32_t page_num) const {
+    const ReadPageGuard guard = bpm_.fetch_page_read(filename_, page_num);
+    if (!guard.valid()) {
+        return NO_PAGE_LSN;
+    }
+    PageHeader header{};
+    std::memcpy(&header, guard.data(), sizeof(PageHeader));
+    if (header.free_space_offset == 0 || (header.flags & PAGE_FLAG_PAGE_LSN) == 0) {
+        return NO_PAGE_LSN;
+    }
+    int32_t lsn = NO_PAGE_LSN;
+    const auto offset = static_cast<std::ptrdiff_t>(lsn_offset(bpm_.page_size()));
+    std::memcpy(&lsn, std::next(guard.data(), offset), sizeof(lsn));
+    return lsn;
+}
+
+bool HeapTable::set_page_lsn(uint32_t page_num, int32_t lsn) {
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, page_num);
+    if (!guard.valid()) {
+        return false;
+    }
+    PageHeader header{};
+    std::memcpy(&header, guard.data(), sizeof(PageHeader));
+    if (header.free_space_offset == 0 || (header.flags & PAGE_FLAG_PAGE_LSN) == 0) {
+        return false;
+    }
+    char* const trailer =
+        std::next(guard.data(), static_cast<std::ptrdiff_t>(lsn_offset(bpm_.page_size())));
+    int32_t current = NO_PAGE_LSN;
+    std::memcpy(&current, trailer, sizeof(current));
+    if (lsn > current) {
+        std::memcpy(trailer, &lsn, sizeof(lsn));
     }
+    /* The frame's LSN holds the page back from disk until the log is durable up to it */
+    guard.page()->set_lsn(lsn);
+    return true;
 }
 
 /**
  * @brief Logical deletion: update xmax field in the record blob
  */
 bool HeapTable::remove(const TupleId& tuple_id, uint64_t xmax) {
-    std::array<char, Page::PAGE_SIZE> buffer{};
-    if (!read_page(tuple_id.page_num, buffer.data())) {
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, tuple_id.page_num);
+    if (!guard.valid()) {
         return false;
     }
+    char* const buffer = guard.data();
 
     PageHeader header{};
-    std::memcpy(&header, buffer.data(), sizeof(PageHeader));
+    std::memcpy(&header, buffer, sizeof(PageHeader));
     if (header.free_space_offset == 0) {
         return false;
     }
@@ -182,16 +739,28 @@ bool HeapTable::remove(const TupleId& tuple_id, uint64_t xmax) {
     }
 
     uint16_t offset = 0;
-    std::memcpy(
-        &offset,
-        std::next(buffer.data(), static_cast<std::ptrdiff_t>(
-                                     sizeof(PageHeader) + (tuple_id.slot_num * sizeof(uint16_t)))),
-        sizeof(uint16_t));
+    std::memcpy(&offset, slot_ptr(buffer, tuple_id.slot_num), sizeof(uint16_t));
     if (offset == 0) {
         return false;
     }
 
-    const char* const data_ptr = std::next(buffer.data(), static_cast<std::ptrdiff_t>(offset));
+    if ((header.flags & PAGE_FLAG_BINARY_TUPLES) == 0) {
+        return legacy_remove(buffer, header, tuple_id, offset, xmax);
+    }
+
+    /* Binary records carry xmax at a fixed offset: patch it in place */
+    std::memcpy(std::next(buffer, static_cast<std::ptrdiff_t>(offset + REC_XMAX_OFFSET)), &xmax,
+                sizeof(uint64_t));
+    return true;
+}
+
+/**
+ * @brief Rewrite the textual xmax of a legacy record, reorganising the page if it grows
+ */
+bool HeapTable::legacy_remove(char* buffer, const PageHeader& page_header,
+                              const TupleId& tuple_id, uint16_t offset, uint64_t xmax) const {
+    PageHeader header = page_header;
+    const char* const data_ptr = std::next(buffer, static_cast<std::ptrdiff_t>(offset));
     const std::string raw_data(data_ptr);
 
     std::stringstream ss(raw_data);
@@ -218,19 +787,16 @@ bool HeapTable::remove(const TupleId& tuple_id, uint64_t xmax) {
     const auto new_len = new_data.size() + 1;
 
     if (new_len <= old_len) {
-        std::memcpy(std::next(buffer.data(), static_cast<std::ptrdiff_t>(offset)), new_data.c_str(),
+        std::memcpy(std::next(buffer, static_cast<std::ptrdiff_t>(offset)), new_data.c_str(),
                     new_len);
-        return write_page(tuple_id.page_num, buffer.data());
+        return true;
     }
 
     /* Reorganize page to accommodate potentially longer xmax string */
     std::vector<std::string> all_tuples;
     for (uint16_t i = 0; i < header.num_slots; ++i) {
         uint16_t slot_off = 0;
-        std::memcpy(&slot_off,
-                    std::next(buffer.data(), static_cast<std::ptrdiff_t>(sizeof(PageHeader) +
-                                                                         (i * sizeof(uint16_t)))),
-                    sizeof(uint16_t));
+        std::memcpy(&slot_off, slot_ptr(buffer, i), sizeof(uint16_t));
         if (slot_off == 0) {
             all_tuples.emplace_back("");
             continue;
@@ -238,12 +804,12 @@ bool HeapTable::remove(const TupleId& tuple_id, uint64_t xmax) {
         if (i == tuple_id.slot_num) {
             all_tuples.push_back(new_data);
         } else {
-            all_tuples.emplace_back(
-                std::next(buffer.data(), static_cast<std::ptrdiff_t>(slot_off)));
+            all_tuples.emplace_back(std::next(buffer, static_cast<std::ptrdiff_t>(slot_off)));
         }
     }
 
-    std::memset(buffer.data(), 0, Page::PAGE_SIZE);
+    /* Rebuild into scratch space so a failed reorganisation leaves the frame untouched */
+    std::vector<char> scratch(bpm_.page_size());
     header.free_space_offset =
         static_cast<uint16_t>(sizeof(PageHeader) + (DEFAULT_SLOT_COUNT * sizeof(uint16_t)));
     header.num_slots = 0;
@@ -251,45 +817,39 @@ bool HeapTable::remove(const TupleId& tuple_id, uint64_t xmax) {
     for (const auto& t_data : all_tuples) {
         if (t_data.empty()) {
             const uint16_t zero = 0;
-            std::memcpy(std::next(buffer.data(),
-                                  static_cast<std::ptrdiff_t>(
-                                      sizeof(PageHeader) + (header.num_slots * sizeof(uint16_t)))),
-                        &zero, sizeof(uint16_t));
+            std::memcpy(slot_ptr(scratch.data(), header.num_slots), &zero, sizeof(uint16_t));
             header.num_slots++;
             continue;
         }
 
         const auto req = static_cast<uint16_t>(t_data.size() + 1);
-        if (header.free_space_offset + req > Page::PAGE_SIZE) {
+        if (header.free_space_offset + req > bpm_.page_size()) {
             return false;
         }
 
         const uint16_t off = header.free_space_offset;
-        std::memcpy(std::next(buffer.data(), static_cast<std::ptrdiff_t>(off)), t_data.c_str(),
-                    req);
-        std::memcpy(std::next(buffer.data(),
-                              static_cast<std::ptrdiff_t>(sizeof(PageHeader) +
-                                                          (header.num_slots * sizeof(uint16_t)))),
-                    &off, sizeof(uint16_t));
+        std::memcpy(std::next(scratch.data(), static_cast<std::ptrdiff_t>(off)), t_data.c_str(), req);
+        std::memcpy(slot_ptr(scratch.data(), header.num_slots), &off, sizeof(uint16_t));
         header.num_slots++;
         header.free_space_offset += req;
     }
 
-    std::memcpy(buffer.data(), &header, sizeof(PageHeader));
-    return write_page(tuple_id.page_num, buffer.data());
+    std::memcpy(scratch.data(), &header, sizeof(PageHeader));
+    std::memcpy(buffer, scratch.data(), scratch.size());
+    return true;
 }
 
 /**
  * @brief Physical deletion: zero out slot offset (rollback only)
  */
 bool HeapTable::physical_remove(const TupleId& tuple_id) {
-    std::array<char, Page::PAGE_SIZE> buffer{};
-    if (!read_page(tuple_id.page_num, buffer.data())) {
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, tuple_id.page_num);
+    if (!guard.valid()) {
         return false;
     }
 
     PageHeader header{};
-    std::memcpy(&header, buffer.data(), sizeof(PageHeader));
+    std::memcpy(&header, guard.data(), sizeof(PageHeader));
     if (header.free_space_offset == 0) {
         return false;
     }
@@ -298,12 +858,15 @@ bool HeapTable::physical_remove(const TupleId& tuple_id) {
     }
 
     const uint16_t zero = 0;
-    std::memcpy(
-        std::next(buffer.data(), static_cast<std::ptrdiff_t>(
-                                     sizeof(PageHeader) + (tuple_id.slot_num * sizeof(uint16_t)))),
-        &zero, sizeof(uint16_t));
+    std::memcpy(slot_ptr(guard.data(), tuple_id.slot_num), &zero, sizeof(uint16_t));
 
-    return write_page(tuple_id.page_num, buffer.data());
+    /* Binary pages can give the record's bytes straight back to inserts */
+    if ((header.flags & PAGE_FLAG_BINARY_TUPLES) != 0) {
+        compact_binary_page(guard.data(), bpm_.page_size());
+        std::memcpy(&header, guard.data(), sizeof(PageHeader));
+        fsm_.record(tuple_id.page_num, page_free_bytes(header));
+    }
+    return true;
 }
 
 /**
@@ -321,33 +884,263 @@ bool HeapTable::update(const TupleId& tuple_id, const executor::Tuple& tuple, ui
     return true;
 }
 
+bool HeapTable::vacuum_page(uint32_t page_num, const DeadFn& is_dead, const DeadTupleFn& on_dead,
+                            size_t* removed) {
+    *removed = 0;
+
+    /* Look for dead records under a read latch first; most pages have none */
+    {
+        const ReadPageGuard guard = bpm_.fetch_page_read(filename_, page_num, AccessType::Scan);
+        if (!guard.valid()) {
+            return false;
+        }
+        PageHeader header{};
+        std::memcpy(&header, guard.data(), sizeof(PageHeader));
+        if (header.free_space_offset == 0) {
+            return false;
+        }
+        if ((header.flags & PAGE_FLAG_BINARY_TUPLES) == 0) {
+            return true;
+        }
+
+        bool any_dead = false;
+        for (uint16_t slot = 0; slot < header.num_slots && !any_dead; ++slot) {
+            uint16_t offset = 0;
+            std::memcpy(&offset, slot_ptr(guard.data(), slot), sizeof(uint16_t));
+            if (offset == 0) {
+                continue;
+            }
+            uint64_t xmax = 0;
+            std::memcpy(&xmax, guard.data() + offset + REC_XMAX_OFFSET, sizeof(uint64_t));
+            any_dead = xmax != 0 && is_dead(xmax);
+        }
+        if (!any_dead) {
+            return true;
+        }
+    }
+
+    /*
+     * The slots may have changed between the latches, so each record is tested
+     * again under the write latch; holding it across on_dead keeps inserts from
+     * reusing a slot before its index entries are gone.
+     */
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, page_num);
+    if (!guard.valid()) {
+        return true;
+    }
+    char* const buffer = guard.data();
+    PageHeader header{};
+    std::memcpy(&header, buffer, sizeof(PageHeader));
+
+    const uint16_t zero = 0;
+    for (uint16_t slot = 0; slot < header.num_slots; ++slot) {
+        uint16_t offset = 0;
+        std::memcpy(&offset, slot_ptr(buffer, slot), sizeof(uint16_t));
+        if (offset == 0) {
+            continue;
+        }
+        uint64_t xmax = 0;
+        std::memcpy(&xmax, buffer + offset + REC_XMAX_OFFSET, sizeof(uint64_t));
+        if (xmax == 0 || !is_dead(xmax)) {
+            continue;
+        }
+        if (on_dead) {
+            TupleMeta meta;
+            deserialize(buffer + offset, meta);
+            on_dead(TupleId(page_num, slot), meta.tuple);
+        }
+        std::memcpy(slot_ptr(buffer, slot), &zero, sizeof(uint16_t));
+        ++*removed;
+    }
+
+    /* Slots past the last record go back to the directory; the records keep theirs */
+    while (header.num_slots > 0) {
+        uint16_t offset = 0;
+        std::memcpy(&offset, slot_ptr(buffer, header.num_slots - 1), sizeof(uint16_t));
+        if (offset != 0) {
+            break;
+        }
+        header.num_slots--;
+    }
+    std::memcpy(buffer, &header, sizeof(PageHeader));
+
+    compact_binary_page(buffer, bpm_.page_size());
+    std::memcpy(&header, buffer, sizeof(PageHeader));
+    fsm_.record(page_num, page_free_bytes(header));
+    return true;
+}
+
 bool HeapTable::get_meta(const TupleId& tuple_id, TupleMeta& out_meta) const {
-    std::array<char, Page::PAGE_SIZE> buffer{};
-    if (!read_page(tuple_id.page_num, buffer.data())) {
+    return get_meta(tuple_id, out_meta, AccessType::Normal);
+}
+
+bool HeapTable::get_meta(const TupleId& tuple_id, TupleMeta& out_meta, AccessType access) const {
+    const ReadPageGuard guard = bpm_.fetch_page_read(filename_, tuple_id.page_num, access);
+    if (!guard.valid()) {
         return false;
     }
 
     PageHeader header{};
-    std::memcpy(&header, buffer.data(), sizeof(PageHeader));
+    std::memcpy(&header, guard.data(), sizeof(PageHeader));
     if (header.free_space_offset == 0) {
         return false;
     }
-    if (tuple_id.slot_num >= header.num_slots) {
+    return read_record(guard.data(), header, tuple_id.slot_num, out_meta);
+}
+
+bool HeapTable::get_versions(const TupleId& tuple_id, uint64_t* xmin, uint64_t* xmax) const {
+    const ReadPageGuard guard = bpm_.fetch_page_read(filename_, tuple_id.page_num);
+    if (!guard.valid()) {
+        return false;
+    }
+
+    PageHeader header{};
+    std::memcpy(&header, guard.data(), sizeof(PageHeader));
+    if (header.free_space_offset == 0 || tuple_id.slot_num >= header.num_slots) {
         return false;
     }
+    if ((header.flags & PAGE_FLAG_BINARY_TUPLES) == 0) {
+        /* Legacy text records have to be parsed to reach their versions */
+        TupleMeta meta;
+        if (!read_record(guard.data(), header, tuple_id.slot_num, meta)) {
+            return false;
+        }
+        *xmin = meta.xmin;
+        *xmax = meta.xmax;
+        return true;
+    }
 
     uint16_t offset = 0;
-    std::memcpy(
-        &offset,
-        std::next(buffer.data(), static_cast<std::ptrdiff_t>(
-                                     sizeof(PageHeader) + (tuple_id.slot_num * sizeof(uint16_t)))),
-        sizeof(uint16_t));
+    std::memcpy(&offset, slot_ptr(guard.data(), tuple_id.slot_num), sizeof(uint16_t));
     if (offset == 0) {
         return false;
     }
+    TupleHeader mvcc{};
+    std::memcpy(&mvcc, std::next(guard.data(), static_cast<std::ptrdiff_t>(offset)),
+                sizeof(TupleHeader));
+    *xmin = mvcc.xmin;
+    *xmax = mvcc.xmax;
+    return true;
+}
+
+bool HeapTable::read_record(const char* page_data, const PageHeader& header, uint16_t slot,
+                            TupleMeta& out_meta) const {
+    if (slot >= header.num_slots) {
+        return false;
+    }
+
+    uint16_t offset = 0;
+    std::memcpy(&offset, slot_ptr(page_data, slot), sizeof(uint16_t));
+    if (offset == 0) {
+        return false;
+    }
+
+    const char* const data = std::next(page_data, static_cast<std::ptrdiff_t>(offset));
+    if ((header.flags & PAGE_FLAG_BINARY_TUPLES) == 0) {
+        return legacy_deserialize(data, out_meta);
+    }
+
+    deserialize(data, out_meta);
+    return true;
+}
+
+size_t HeapTable::read_page_batch(const char* page_data, const PageHeader& header,
+                                  uint16_t* slot, size_t max_rows,
+                                  const Iterator::VisibilityFn& visible,
+                                  executor::VectorBatch& out) const {
+    const size_t base = out.row_count();
+    const size_t num_cols = schema_.column_count();
+    if (out.column_count() != num_cols) {
+        throw std::runtime_error("HeapTable: batch does not match the table schema");
+    }
+    for (size_t i = 0; i < num_cols; ++i) {
+        if (out.get_column(i).type() != schema_.get_column(i).type()) {
+            throw std::runtime_error("HeapTable: batch does not match the table schema");
+        }
+    }
+    size_t rows = 0;
 
-    const char* const data = std::next(buffer.data(), static_cast<std::ptrdiff_t>(offset));
-    const std::string s(data);
+    if ((header.flags & PAGE_FLAG_BINARY_TUPLES) == 0) {
+        TupleMeta meta;
+        for (; *slot < header.num_slots && rows < max_rows; ++*slot) {
+            if (!read_record(page_data, header, *slot, meta) ||
+                (visible && !visible(meta.xmin, meta.xmax))) {
+                continue;
+            }
+            for (size_t i = 0; i < num_cols; ++i) {
+                out.get_column(i).append(i < meta.tuple.size() ? meta.tuple.get(i)
+                                                               : common::Value::make_null());
+            }
+            out.set_row_count(base + ++rows);
+        }
+        return rows;
+    }
+
+    /* Make room for every remaining slot, decode in place, then trim to the rows kept */
+    const size_t room = std::min<size_t>(max_rows, header.num_slots - *slot);
+    std::vector<BatchColumn> targets;
+    targets.reserve(num_cols);
+    for (size_t i = 0; i < num_cols; ++i) {
+        targets.push_back(resize_batch_column(out.get_column(i), base + room));
+    }
+
+    for (; *slot < header.num_slots && rows < room; ++*slot) {
+        uint16_t offset = 0;
+        std::memcpy(&offset, slot_ptr(page_data, *slot), sizeof(uint16_t));
+        if (offset == 0) {
+            continue;
+        }
+        const char* const record = std::next(page_data, static_cast<std::ptrdiff_t>(offset));
+        TupleHeader mvcc{};
+        std::memcpy(&mvcc, record, sizeof(TupleHeader));
+        if (visible && !visible(mvcc.xmin, mvcc.xmax)) {
+            continue;
+        }
+
+        uint16_t stored_cols = 0;
+        std::memcpy(&stored_cols, record + REC_NCOLS_OFFSET, sizeof(uint16_t));
+        const char* const fixed = record + REC_BITMAP_OFFSET + bitmap_size(stored_cols);
+        const size_t row = base + rows++;
+        for (size_t i = 0; i < num_cols; ++i) {
+            BatchColumn& target = targets[i];
+            const bool is_null =
+                i >= stored_cols ||
+                (static_cast<uint8_t>(record[REC_BITMAP_OFFSET + (i / BITS_PER_BYTE)]) &
+                 (1U << (i % BITS_PER_BYTE))) != 0;
+            target.nulls[row] = is_null ? 1 : 0;
+            if (is_null) {
+                continue;
+            }
+
+            const char* const field = fixed + column_offsets_[i];
+            if (target.ints != nullptr) {
+                std::memcpy(&target.ints[row], field, sizeof(int64_t));
+            } else if (target.floats != nullptr) {
+                std::memcpy(&target.floats[row], field, sizeof(double));
+            } else if (target.bools != nullptr) {
+                target.bools[row] = *field != 0 ? 1 : 0;
+            } else {
+                uint16_t var_off = 0;
+                uint16_t var_len = 0;
+                std::memcpy(&var_off, field, sizeof(uint16_t));
+                std::memcpy(&var_len, field + sizeof(uint16_t), sizeof(uint16_t));
+                target.strings[row].assign(record + var_off, var_len);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < num_cols; ++i) {
+        static_cast<void>(resize_batch_column(out.get_column(i), base + rows));
+    }
+    out.set_row_count(base + rows);
+    return rows;
+}
+
+/**
+ * @brief Parse a legacy pipe-delimited text record ("xmin|xmax|v1|v2|...")
+ */
+bool HeapTable::legacy_deserialize(const char* record, TupleMeta& out_meta) const {
+    const std::string s(record);
     std::stringstream ss(s);
     std::string item;
 
@@ -378,6 +1171,11 @@ bool HeapTable::get_meta(const TupleId& tuple_id, TupleMeta& out_meta) const {
             break;
         }
 
+        if (i < read_columns_.size() && !read_columns_[i]) {
+            values.push_back(common::Value::make_null());
+            continue;
+        }
+
         const auto& col = schema_.get_column(i);
         try {
             switch (col.type()) {
@@ -419,20 +1217,34 @@ bool HeapTable::get(const TupleId& tuple_id, executor::Tuple& out_tuple) const {
 uint64_t HeapTable::tuple_count() const {
     uint64_t count = 0;
     uint32_t page_num = 0;
-    std::array<char, Page::PAGE_SIZE> buffer{};
-    while (read_page(page_num, buffer.data())) {
+    while (true) {
+        const ReadPageGuard guard = bpm_.fetch_page_read(filename_, page_num, AccessType::Scan);
+        if (!guard.valid()) {
+            break;
+        }
         PageHeader header{};
-        std::memcpy(&header, buffer.data(), sizeof(PageHeader));
+        std::memcpy(&header, guard.data(), sizeof(PageHeader));
         if (header.free_space_offset == 0) {
             break;
         }
 
+        const bool binary = (header.flags & PAGE_FLAG_BINARY_TUPLES) != 0;
         for (uint16_t i = 0; i < header.num_slots; ++i) {
+            uint16_t offset = 0;
+            std::memcpy(&offset, slot_ptr(guard.data(), i), sizeof(uint16_t));
+            if (offset == 0) {
+                continue;
+            }
+            if (binary) {
+                /* Only xmax is needed; skip decoding the columns */
+                uint64_t xmax = 0;
+                std::memcpy(&xmax, guard.data() + offset + REC_XMAX_OFFSET, sizeof(uint64_t));
+                count += (xmax == 0) ? 1 : 0;
+                continue;
+            }
             TupleMeta meta;
-            if (get_meta(TupleId(page_num, i), meta)) {
-                if (meta.xmax == 0) {
-                    count++;
-                }
+            if (read_record(guard.data(), header, i, meta) && meta.xmax == 0) {
+                count++;
             }
         }
         page_num++;
@@ -440,48 +1252,36 @@ uint64_t HeapTable::tuple_count() const {
     return count;
 }
 
+uint32_t HeapTable::page_count() {
+    /* A heap written before it had a free-space map has pages the map does not track */
+    return std::max(fsm_.page_count(), bpm_.get_storage_manager().page_count(filename_));
+}
+
 bool HeapTable::create() {
     if (!bpm_.open_file(filename_)) {
         return false;
     }
 
-    std::array<char, Page::PAGE_SIZE> buffer{};
-    std::memset(buffer.data(), 0, Page::PAGE_SIZE);
-    PageHeader header{};
-    header.free_space_offset =
-        static_cast<uint16_t>(sizeof(PageHeader) + (DEFAULT_SLOT_COUNT * sizeof(uint16_t)));
-    header.num_slots = 0;
-    std::memcpy(buffer.data(), &header, sizeof(PageHeader));
+    WritePageGuard guard = bpm_.fetch_page_write(filename_, 0);
+    if (!guard.valid()) {
+        return false;
+    }
+    init_binary_page(guard.data(), bpm_.page_size());
 
-    return write_page(0, buffer.data());
+    /* A new heap starts with an empty map, even if a stale fork file is lying around */
+    PageHeader header{};
+    std::memcpy(&header, guard.data(), sizeof(PageHeader));
+    fsm_.reset();
+    fsm_.record(0, page_free_bytes(header));
+    return true;
 }
 
 bool HeapTable::drop() {
     static_cast<void>(bpm_.close_file(filename_));
+    static_cast<void>(bpm_.close_file(fsm_.filename()));
+    static_cast<void>(std::remove(fsm_.filename().c_str()));
+    static_cast<void>(std::remove((filename_ + PageMap::FILE_SUFFIX).c_str()));
     return (std::remove(filename_.c_str()) == 0);
 }
 
-bool HeapTable::read_page(uint32_t page_num, char* buffer) const {
-    Page* page = bpm_.fetch_page(filename_, page_num);
-    if (!page) {
-        return false;
-    }
-    std::memcpy(buffer, page->get_data(), Page::PAGE_SIZE);
-    bpm_.unpin_page(filename_, page_num, false);
-    return true;
-}
-
-bool HeapTable::write_page(uint32_t page_num, const char* buffer) {
-    Page* page = bpm_.fetch_page(filename_, page_num);
-    if (!page) {
-        page = bpm_.new_page(filename_, &page_num);
-        if (!page) {
-            return false;
-        }
-    }
-    std::memcpy(page->get_data(), buffer, Page::PAGE_SIZE);
-    bpm_.unpin_page(filename_, page_num, true);
-    return true;
-}
-
 }  // namespace cloudsql::storage
@@ -0,0 +1,102 @@
+/**
+ * @file io_backend.cpp
+ * @brief POSIX I/O backend and backend factory
+ */
+
+#include "storage/io_backend.hpp"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef CLOUDSQL_HAVE_IO_URING
+#include "storage/io_uring_backend.hpp"
+#endif
+
+namespace cloudsql::storage {
+
+int64_t IoBackend::read(int fd, char* buffer, uint32_t length, uint64_t offset) {
+    uint32_t done = 0;
+    while (done < length) {
+        const ssize_t n = ::pread(fd, buffer + done, length - done,
+                                  static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (n == 0) {
+            break; /* End of file */
+        }
+        done += static_cast<uint32_t>(n);
+    }
+    return done;
+}
+
+int64_t IoBackend::write(int fd, const char* buffer, uint32_t length, uint64_t offset) {
+    uint32_t done = 0;
+    while (done < length) {
+        const ssize_t n = ::pwrite(fd, buffer + done, length - done,
+                                   static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        done += static_cast<uint32_t>(n);
+    }
+    return done;
+}
+
+void IoBackend::submit(std::vector<IoRequest>& batch) {
+    for (auto& req : batch) {
+        req.result = req.op == IoRequest::Op::Read
+                         ? read(req.fd, req.buffer, req.length, req.offset)
+                         : write(req.fd, req.buffer, req.length, req.offset);
+    }
+}
+
+std::unique_ptr<IoBackend> make_io_backend(IoBackendType type) {
+    if (type == IoBackendType::IoUring) {
+#ifdef CLOUDSQL_HAVE_IO_URING
+        auto uring = std::make_unique<IoUringBackend>();
+        if (uring->is_valid()) {
+            return uring;
+        }
+        std::cerr << "--- [Storage] io_uring setup failed, falling back to posix I/O ---\n";
+#else
+        std::cerr << "--- [Storage] io_uring not compiled in, falling back to posix I/O ---\n";
+#endif
+    }
+    return std::make_unique<PosixIoBackend>();
+}
+
+bool parse_io_backend(const std::string& name, IoBackendType* out) {
+    if (name == "posix") {
+        *out = IoBackendType::Posix;
+    } else if (name == "io_uring" || name == "io-uring" || name == "uring") {
+        *out = IoBackendType::IoUring;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* io_backend_name(IoBackendType type) {
+    switch (type) {
+        case IoBackendType::IoUring:
+            return "io_uring";
+        case IoBackendType::Posix:
+        default:
+            return "posix";
+    }
+}
+
+}  // namespace cloudsql::storage
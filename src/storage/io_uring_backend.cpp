@@ -0,0 +1,222 @@
+/**
+ * @file io_uring_backend.cpp
+ * @brief io_uring backend using the raw setup/enter system calls
+ */
+
+#include "storage/io_uring_backend.hpp"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace cloudsql::storage {
+
+namespace {
+
+int sys_io_uring_setup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(
+        ::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+template <typename T>
+T* ring_field(void* ring, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+
+}  // namespace
+
+IoUringBackend::IoUringBackend(uint32_t queue_depth) {
+    io_uring_params params{};
+    ring_fd_ = sys_io_uring_setup(queue_depth, &params);
+    if (ring_fd_ < 0) {
+        ring_fd_ = -1;
+        return;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        cq_ring_size_ = sq_ring_size_;
+    }
+
+    sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        ::close(ring_fd_);
+        ring_fd_ = -1;
+        return;
+    }
+
+    if (single_mmap) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            cq_ring_ = nullptr;
+            ::munmap(sq_ring_, sq_ring_size_);
+            sq_ring_ = nullptr;
+            ::close(ring_fd_);
+            ring_fd_ = -1;
+            return;
+        }
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ring_fd_, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+        sqes_ = nullptr;
+        if (cq_ring_ != sq_ring_) {
+            ::munmap(cq_ring_, cq_ring_size_);
+        }
+        ::munmap(sq_ring_, sq_ring_size_);
+        cq_ring_ = sq_ring_ = nullptr;
+        ::close(ring_fd_);
+        ring_fd_ = -1;
+        return;
+    }
+
+    sq_entries_ = params.sq_entries;
+    sq_tail_ = ring_field<unsigned>(sq_ring_, params.sq_off.tail);
+    sq_mask_ = ring_field<unsigned>(sq_ring_, params.sq_off.ring_mask);
+    sq_array_ = ring_field<unsigned>(sq_ring_, params.sq_off.array);
+    cq_head_ = ring_field<unsigned>(cq_ring_, params.cq_off.head);
+    cq_tail_ = ring_field<unsigned>(cq_ring_, params.cq_off.tail);
+    cq_mask_ = ring_field<unsigned>(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = ring_field<void>(cq_ring_, params.cq_off.cqes);
+}
+
+IoUringBackend::~IoUringBackend() {
+    if (sqes_ != nullptr) {
+        ::munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+        ::munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != nullptr) {
+        ::munmap(sq_ring_, sq_ring_size_);
+    }
+    if (ring_fd_ >= 0) {
+        ::close(ring_fd_);
+    }
+}
+
+void IoUringBackend::submit(std::vector<IoRequest>& batch) {
+    if (!is_valid()) {
+        IoBackend::submit(batch);
+        return;
+    }
+
+    const std::scoped_lock<std::mutex> lock(ring_latch_);
+    for (size_t begin = 0; begin < batch.size(); begin += sq_entries_) {
+        const size_t count = std::min<size_t>(sq_entries_, batch.size() - begin);
+        if (!submit_chunk(batch, begin, count)) {
+            /* Ring unusable for this chunk; run it synchronously */
+            for (size_t i = begin; i < begin + count; ++i) {
+                auto& req = batch[i];
+                req.result = req.op == IoRequest::Op::Read
+                                 ? read(req.fd, req.buffer, req.length, req.offset)
+                                 : write(req.fd, req.buffer, req.length, req.offset);
+            }
+        }
+    }
+
+    /* Opcodes unsupported by older kernels and short transfers finish synchronously */
+    for (auto& req : batch) {
+        if (req.result == -EINVAL || req.result == -EOPNOTSUPP) {
+            req.result = req.op == IoRequest::Op::Read
+                             ? read(req.fd, req.buffer, req.length, req.offset)
+                             : write(req.fd, req.buffer, req.length, req.offset);
+        } else if (req.result > 0 && req.result < static_cast<int64_t>(req.length)) {
+            const auto done = static_cast<uint32_t>(req.result);
+            const int64_t rest =
+                req.op == IoRequest::Op::Read
+                    ? read(req.fd, req.buffer + done, req.length - done, req.offset + done)
+                    : write(req.fd, req.buffer + done, req.length - done, req.offset + done);
+            req.result = rest < 0 ? rest : req.result + rest;
+        }
+    }
+}
+
+bool IoUringBackend::submit_chunk(std::vector<IoRequest>& batch, size_t begin, size_t count) {
+    auto* const sqes = static_cast<io_uring_sqe*>(sqes_);
+    auto* const cqes = static_cast<io_uring_cqe*>(cqes_);
+
+    /* Only this thread produces into the SQ, so the tail can be read plainly */
+    unsigned tail = *sq_tail_;
+    const unsigned mask = *sq_mask_;
+    for (size_t i = 0; i < count; ++i) {
+        const auto& req = batch[begin + i];
+        const unsigned index = tail & mask;
+        io_uring_sqe* const sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = req.op == IoRequest::Op::Read ? IORING_OP_READ : IORING_OP_WRITE;
+        sqe->fd = req.fd;
+        sqe->off = req.offset;
+        sqe->addr = reinterpret_cast<uint64_t>(req.buffer);
+        sqe->len = req.length;
+        sqe->user_data = begin + i;
+        sq_array_[index] = index;
+        tail++;
+    }
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+    const auto to_submit = static_cast<unsigned>(count);
+    unsigned submitted = 0;
+    while (submitted < to_submit) {
+        const int ret = sys_io_uring_enter(ring_fd_, to_submit - submitted, to_submit - submitted,
+                                           IORING_ENTER_GETEVENTS);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (submitted == 0) {
+                /* Nothing reached the kernel; retract the entries */
+                __atomic_store_n(sq_tail_, tail - to_submit, __ATOMIC_RELEASE);
+                return false;
+            }
+            break;
+        }
+        submitted += static_cast<unsigned>(ret);
+    }
+
+    unsigned reaped = 0;
+    while (reaped < submitted) {
+        unsigned head = *cq_head_;
+        const unsigned cq_tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        if (head == cq_tail) {
+            const int ret = sys_io_uring_enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS);
+            if (ret < 0 && errno != EINTR) {
+                return false;
+            }
+            continue;
+        }
+        while (head != cq_tail) {
+            const io_uring_cqe& cqe = cqes[head & *cq_mask_];
+            batch[static_cast<size_t>(cqe.user_data)].result = cqe.res;
+            head++;
+            reaped++;
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+    return submitted == to_submit;
+}
+
+}  // namespace cloudsql::storage
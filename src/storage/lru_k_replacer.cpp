@@ -0,0 +1,137 @@
+/**
+ * @file lru_k_replacer.cpp
+ * @brief LRU-K replacement policy implementation
+ */
+
+#include "storage/lru_k_replacer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace cloudsql::storage {
+
+LRUKReplacer::LRUKReplacer(size_t num_frames, uint32_t first_frame, size_t k)
+    : num_frames_(num_frames),
+      first_frame_(first_frame),
+      k_(k == 0 ? 1 : k),
+      history_(num_frames),
+      present_(num_frames, false),
+      cold_(num_frames, false),
+      ranks_(num_frames) {}
+
+LRUKReplacer::Rank LRUKReplacer::rank(size_t idx) const {
+    /*
+     * Rank candidates by (class, timestamp): cold frames first, then frames with fewer
+     * than k accesses by their first access, then the rest by their k-th latest access.
+     */
+    const auto& hist = history_[idx];
+    int cls = CLASS_FINITE;
+    if (cold_[idx]) {
+        cls = CLASS_COLD;
+    } else if (hist.size() < k_) {
+        cls = CLASS_INFINITE;
+    }
+    return {cls, hist.empty() ? 0 : hist.front(), idx};
+}
+
+void LRUKReplacer::add_evictable(size_t idx) {
+    present_[idx] = true;
+    ranks_[idx] = rank(idx);
+    evictable_.insert(ranks_[idx]);
+}
+
+void LRUKReplacer::remove_evictable(size_t idx) {
+    if (present_[idx]) {
+        present_[idx] = false;
+        evictable_.erase(ranks_[idx]);
+    }
+}
+
+bool LRUKReplacer::victim(uint32_t* frame_id) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+
+    /* A frame's rank only changes while it is pinned, so the set stays ordered */
+    if (evictable_.empty()) {
+        return false;
+    }
+    const size_t best = std::get<2>(*evictable_.begin());
+    evictable_.erase(evictable_.begin());
+    present_[best] = false;
+    cold_[best] = false;
+    history_[best].clear();
+    *frame_id = first_frame_ + static_cast<uint32_t>(best);
+    return true;
+}
+
+void LRUKReplacer::pin(uint32_t frame_id) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+
+    if (!owns(frame_id)) {
+        return;
+    }
+    const size_t idx = frame_id - first_frame_;
+    remove_evictable(idx);
+    cold_[idx] = false;
+
+    auto& hist = history_[idx];
+    hist.push_back(++current_ts_);
+    if (hist.size() > k_) {
+        hist.pop_front();
+    }
+}
+
+void LRUKReplacer::unpin(uint32_t frame_id) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+
+    if (!owns(frame_id)) {
+        return;
+    }
+    const size_t idx = frame_id - first_frame_;
+    if (!present_[idx]) {
+        add_evictable(idx);
+    }
+}
+
+void LRUKReplacer::unpin_cold(uint32_t frame_id) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+
+    if (!owns(frame_id)) {
+        return;
+    }
+    const size_t idx = frame_id - first_frame_;
+    remove_evictable(idx);
+    cold_[idx] = true;
+    add_evictable(idx);
+}
+
+void LRUKReplacer::remove(uint32_t frame_id) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+
+    if (!owns(frame_id)) {
+        return;
+    }
+    const size_t idx = frame_id - first_frame_;
+    remove_evictable(idx);
+    cold_[idx] = false;
+    history_[idx].clear();
+}
+
+void LRUKReplacer::peek_victims(size_t max_frames, std::vector<uint32_t>* frames) const {
+    const std::scoped_lock<std::mutex> lock(latch_);
+
+    for (auto it = evictable_.begin(); it != evictable_.end() && max_frames > 0;
+         ++it, --max_frames) {
+        frames->push_back(first_frame_ + static_cast<uint32_t>(std::get<2>(*it)));
+    }
+}
+
+size_t LRUKReplacer::size() const {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    return evictable_.size();
+}
+
+}  // namespace cloudsql::storage
@@ -7,7 +7,9 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <iterator>
 #include <mutex>
+#include <vector>
 
 namespace cloudsql::storage {
 
@@ -51,6 +53,30 @@ void LRUReplacer::unpin(uint32_t frame_id) {
     lru_map_[frame_id] = lru_list_.begin();
 }
 
+void LRUReplacer::unpin_cold(uint32_t frame_id) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+
+    if (lru_map_.count(frame_id) != 0) {
+        return;
+    }
+
+    if (lru_list_.size() >= capacity_) {
+        return;
+    }
+
+    lru_list_.push_back(frame_id);
+    lru_map_[frame_id] = std::prev(lru_list_.end());
+}
+
+void LRUReplacer::peek_victims(size_t max_frames, std::vector<uint32_t>* frames) const {
+    const std::scoped_lock<std::mutex> lock(latch_);
+
+    for (auto it = lru_list_.rbegin(); it != lru_list_.rend() && max_frames > 0; ++it) {
+        frames->push_back(*it);
+        max_frames--;
+    }
+}
+
 size_t LRUReplacer::size() const {
     const std::scoped_lock<std::mutex> lock(latch_);
     return lru_list_.size();
@@ -0,0 +1,56 @@
+/**
+ * @file mapped_file.cpp
+ * @brief MappedFile implementation
+ */
+
+#include "storage/mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace cloudsql::storage {
+
+std::shared_ptr<const MappedFile> MappedFile::map(const std::string& path, bool sequential) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        static_cast<void>(::close(fd));
+        return nullptr;
+    }
+    const auto size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        static_cast<void>(::close(fd));
+        return std::shared_ptr<const MappedFile>(new MappedFile(nullptr, 0));
+    }
+
+    /* The mapping keeps its own reference to the file, so the descriptor can go now */
+    void* const addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    static_cast<void>(::close(fd));
+    if (addr == MAP_FAILED) {
+        std::cerr << "--- [MappedFile] mmap failed for " << path << " ---" << std::endl;
+        return nullptr;
+    }
+    if (sequential) {
+        static_cast<void>(::madvise(addr, size, MADV_SEQUENTIAL));
+    }
+    return std::shared_ptr<const MappedFile>(new MappedFile(addr, size));
+}
+
+MappedFile::~MappedFile() {
+    if (addr_ != nullptr) {
+        static_cast<void>(::munmap(addr_, size_));
+    }
+}
+
+}  // namespace cloudsql::storage
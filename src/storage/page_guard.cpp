@@ -0,0 +1,75 @@
+/**
+ * @file page_guard.cpp
+ * @brief RAII page guard implementation
+ */
+
+#include "storage/page_guard.hpp"
+
+#include <utility>
+
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/page.hpp"
+
+namespace cloudsql::storage {
+
+/* --- ReadPageGuard --- */
+
+ReadPageGuard::ReadPageGuard(BufferPoolManager* bpm, Page* page) : bpm_(bpm), page_(page) {
+    if (page_ != nullptr) {
+        page_->r_lock();
+    }
+}
+
+ReadPageGuard::ReadPageGuard(ReadPageGuard&& other) noexcept
+    : bpm_(std::exchange(other.bpm_, nullptr)), page_(std::exchange(other.page_, nullptr)) {}
+
+ReadPageGuard& ReadPageGuard::operator=(ReadPageGuard&& other) noexcept {
+    if (this != &other) {
+        release();
+        bpm_ = std::exchange(other.bpm_, nullptr);
+        page_ = std::exchange(other.page_, nullptr);
+    }
+    return *this;
+}
+
+void ReadPageGuard::release() {
+    if (page_ == nullptr) {
+        return;
+    }
+    page_->r_unlock();
+    static_cast<void>(bpm_->unpin_page(page_, false));
+    page_ = nullptr;
+    bpm_ = nullptr;
+}
+
+/* --- WritePageGuard --- */
+
+WritePageGuard::WritePageGuard(BufferPoolManager* bpm, Page* page) : bpm_(bpm), page_(page) {
+    if (page_ != nullptr) {
+        page_->w_lock();
+    }
+}
+
+WritePageGuard::WritePageGuard(WritePageGuard&& other) noexcept
+    : bpm_(std::exchange(other.bpm_, nullptr)), page_(std::exchange(other.page_, nullptr)) {}
+
+WritePageGuard& WritePageGuard::operator=(WritePageGuard&& other) noexcept {
+    if (this != &other) {
+        release();
+        bpm_ = std::exchange(other.bpm_, nullptr);
+        page_ = std::exchange(other.page_, nullptr);
+    }
+    return *this;
+}
+
+void WritePageGuard::release() {
+    if (page_ == nullptr) {
+        return;
+    }
+    page_->w_unlock();
+    static_cast<void>(bpm_->unpin_page(page_, true));
+    page_ = nullptr;
+    bpm_ = nullptr;
+}
+
+}  // namespace cloudsql::storage
@@ -0,0 +1,220 @@
+/**
+ * @file page_map.cpp
+ * @brief PageMap implementation
+ */
+
+#include "storage/page_map.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cloudsql::storage {
+
+namespace {
+
+constexpr int DEFAULT_FILE_MODE = 0644;
+
+struct MapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t compression;
+    uint32_t reserved;
+};
+constexpr uint32_t MAP_MAGIC = 0x4D505343; /* "CSPM" */
+constexpr uint32_t MAP_VERSION = 1;
+
+off_t entry_offset(uint32_t page_num) {
+    return static_cast<off_t>(sizeof(MapHeader) +
+                              static_cast<uint64_t>(page_num) * sizeof(PageExtent));
+}
+
+}  // namespace
+
+bool parse_page_compression(const std::string& name, PageCompression* out) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (lower == "none" || lower == "off") {
+        *out = PageCompression::None;
+        return true;
+    }
+    if (lower == "lz4") {
+        *out = PageCompression::Lz4;
+        return true;
+    }
+    return false;
+}
+
+const char* page_compression_name(PageCompression compression) {
+    return compression == PageCompression::Lz4 ? "lz4" : "none";
+}
+
+PageMap::~PageMap() {
+    static_cast<void>(::close(fd_));
+}
+
+bool PageMap::create(const std::string& path, PageCompression compression) {
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                          DEFAULT_FILE_MODE);
+    if (fd < 0) {
+        return false;
+    }
+    const MapHeader header{MAP_MAGIC, MAP_VERSION, static_cast<uint32_t>(compression), 0};
+    const bool ok = ::pwrite(fd, &header, sizeof(header), 0) ==
+                        static_cast<ssize_t>(sizeof(header)) &&
+                    ::fsync(fd) == 0;
+    static_cast<void>(::close(fd));
+    return ok;
+}
+
+std::unique_ptr<PageMap> PageMap::open(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    MapHeader header{};
+    struct stat st {};
+    if (::pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        header.magic != MAP_MAGIC ||
+        header.compression > static_cast<uint32_t>(PageCompression::Lz4) || ::fstat(fd, &st) != 0) {
+        static_cast<void>(::close(fd));
+        return nullptr;
+    }
+
+    std::unique_ptr<PageMap> map(new PageMap(fd, static_cast<PageCompression>(header.compression)));
+    const auto entries = static_cast<size_t>(
+        (static_cast<uint64_t>(st.st_size) - sizeof(header)) / sizeof(PageExtent));
+    map->extents_.resize(entries);
+    const auto bytes = static_cast<ssize_t>(entries * sizeof(PageExtent));
+    if (entries > 0 && ::pread(fd, map->extents_.data(), static_cast<size_t>(bytes),
+                               sizeof(header)) != bytes) {
+        return nullptr;
+    }
+
+    /* Whatever lies between the extents in use is free */
+    std::vector<PageExtent> used;
+    std::copy_if(map->extents_.begin(), map->extents_.end(), std::back_inserter(used),
+                 [](const PageExtent& e) { return e.capacity > 0; });
+    std::sort(used.begin(), used.end(),
+              [](const PageExtent& a, const PageExtent& b) { return a.offset < b.offset; });
+    for (const auto& extent : used) {
+        if (extent.offset > map->end_) {
+            map->free_.emplace_back(map->end_, extent.offset - map->end_);
+        }
+        map->end_ = std::max(map->end_, extent.offset + extent.capacity);
+    }
+    return map;
+}
+
+PageExtent PageMap::lookup(uint32_t page_num) const {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    return page_num < extents_.size() ? extents_[page_num] : PageExtent{};
+}
+
+PageExtent PageMap::place(uint32_t page_num, uint32_t length) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    if (page_num < extents_.size() && extents_[page_num].capacity >= length) {
+        PageExtent extent = extents_[page_num];
+        extent.length = length;
+        return extent;
+    }
+    const uint32_t capacity = (length + EXTENT_ALIGNMENT - 1) / EXTENT_ALIGNMENT * EXTENT_ALIGNMENT;
+    return PageExtent{allocate(capacity), length, capacity};
+}
+
+bool PageMap::commit(uint32_t page_num, const PageExtent& extent) {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    if (page_num >= extents_.size()) {
+        extents_.resize(static_cast<size_t>(page_num) + 1);
+    }
+    const PageExtent old = extents_[page_num];
+    extents_[page_num] = extent;
+    /* The page reads from its new extent from here on, so the old one can go */
+    if (old.capacity > 0 && old.offset != extent.offset) {
+        release(old.offset, old.capacity);
+    }
+    return ::pwrite(fd_, &extent, sizeof(extent), entry_offset(page_num)) ==
+           static_cast<ssize_t>(sizeof(extent));
+}
+
+uint32_t PageMap::page_count() const {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    return static_cast<uint32_t>(extents_.size());
+}
+
+uint64_t PageMap::stored_bytes() const {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    uint64_t total = 0;
+    for (const auto& extent : extents_) {
+        total += extent.length;
+    }
+    return total;
+}
+
+bool PageMap::clear() {
+    const std::scoped_lock<std::mutex> lock(latch_);
+    extents_.clear();
+    free_.clear();
+    end_ = 0;
+    return ::ftruncate(fd_, static_cast<off_t>(sizeof(MapHeader))) == 0;
+}
+
+uint64_t PageMap::allocate(uint32_t capacity) {
+    for (auto it = free_.begin(); it != free_.end(); ++it) {
+        if (it->second < capacity) {
+            continue;
+        }
+        const uint64_t offset = it->first;
+        if (it->second == capacity) {
+            static_cast<void>(free_.erase(it));
+        } else {
+            it->first += capacity;
+            it->second -= capacity;
+        }
+        return offset;
+    }
+    const uint64_t offset = end_;
+    end_ += capacity;
+    return offset;
+}
+
+void PageMap::release(uint64_t offset, uint32_t capacity) {
+    if (offset + capacity == end_) {
+        end_ = offset;
+        /* The gap now at the end of the file merges into it */
+        if (!free_.empty() && free_.back().first + free_.back().second == end_) {
+            end_ = free_.back().first;
+            free_.pop_back();
+        }
+        return;
+    }
+    auto it = std::lower_bound(free_.begin(), free_.end(), offset,
+                               [](const auto& gap, uint64_t value) { return gap.first < value; });
+    it = free_.emplace(it, offset, capacity);
+    const auto next = std::next(it);
+    if (next != free_.end() && it->first + it->second == next->first) {
+        it->second += next->second;
+        static_cast<void>(free_.erase(next));
+    }
+    if (it != free_.begin()) {
+        const auto prev = std::prev(it);
+        if (prev->first + prev->second == it->first) {
+            prev->second += it->second;
+            static_cast<void>(free_.erase(it));
+        }
+    }
+}
+
+}  // namespace cloudsql::storage
@@ -0,0 +1,57 @@
+/**
+ * @file replacer.cpp
+ * @brief Replacement policy factory
+ */
+
+#include "storage/replacer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "storage/clock_replacer.hpp"
+#include "storage/lru_k_replacer.hpp"
+#include "storage/lru_replacer.hpp"
+
+namespace cloudsql::storage {
+
+std::unique_ptr<Replacer> make_replacer(ReplacerPolicy policy, size_t num_frames,
+                                        uint32_t first_frame) {
+    switch (policy) {
+        case ReplacerPolicy::Clock:
+            return std::make_unique<ClockReplacer>(num_frames, first_frame);
+        case ReplacerPolicy::LruK:
+            return std::make_unique<LRUKReplacer>(num_frames, first_frame);
+        case ReplacerPolicy::Lru:
+        default:
+            return std::make_unique<LRUReplacer>(num_frames);
+    }
+}
+
+bool parse_replacer_policy(const std::string& name, ReplacerPolicy* policy) {
+    if (name == "lru") {
+        *policy = ReplacerPolicy::Lru;
+    } else if (name == "clock") {
+        *policy = ReplacerPolicy::Clock;
+    } else if (name == "lru-k" || name == "lru_k" || name == "lruk") {
+        *policy = ReplacerPolicy::LruK;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* replacer_policy_name(ReplacerPolicy policy) {
+    switch (policy) {
+        case ReplacerPolicy::Clock:
+            return "clock";
+        case ReplacerPolicy::LruK:
+            return "lru-k";
+        case ReplacerPolicy::Lru:
+        default:
+            return "lru";
+    }
+}
+
+}  // namespace cloudsql::storage
@@ -8,36 +8,123 @@
 
 #include "storage/storage_manager.hpp"
 
+#include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
-#include <fstream>
-#include <ios>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <iterator>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <utility>
+#include <vector>
+
+#include "common/lz4.hpp"
+#include "common/metrics.hpp"
+#include "storage/io_backend.hpp"
+#include "storage/io_counters.hpp"
+#include "storage/page.hpp"
+#include "storage/page_map.hpp"
 
 namespace cloudsql::storage {
 
+namespace {
+
+constexpr int DEFAULT_FILE_MODE = 0644;
+
+struct AlignedFree {
+    void operator()(char* ptr) const { std::free(ptr); }
+};
+using AlignedBuffer = std::unique_ptr<char, AlignedFree>;
+
+/* O_DIRECT buffers and offsets must be aligned to the device's logical block size */
+constexpr size_t DIRECT_IO_ALIGNMENT = 4096;
+
+/* Records the page size of a database in its data directory */
+struct ControlHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t reserved;
+};
+constexpr uint32_t CONTROL_MAGIC = 0x43535143; /* "CSQC" */
+constexpr uint32_t CONTROL_VERSION = 1;
+
+/** @brief Aligned scratch buffer for O_DIRECT transfers from unaligned memory */
+AlignedBuffer make_aligned_page(uint32_t page_size) {
+    return AlignedBuffer(static_cast<char*>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, page_size)));
+}
+
+bool is_page_aligned(const void* ptr) {
+    return reinterpret_cast<uintptr_t>(ptr) % DIRECT_IO_ALIGNMENT == 0;
+}
+
+/** @brief Zero-fill the tail of a short read; partial pages only happen at end of file */
+void zero_fill_tail(char* buffer, int64_t bytes_read, uint32_t page_size) {
+    std::fill(std::next(buffer, static_cast<std::ptrdiff_t>(bytes_read)),
+              std::next(buffer, static_cast<std::ptrdiff_t>(page_size)), 0);
+}
+
+/** @brief Per-thread buffer for compressed page images */
+std::vector<uint8_t>& compression_scratch() {
+    thread_local std::vector<uint8_t> scratch;
+    return scratch;
+}
+
+}  // namespace
+
 /**
  * @brief Construct a new Storage Manager
  */
-StorageManager::StorageManager(std::string data_dir) : data_dir_(std::move(data_dir)) {
+StorageManager::StorageManager(std::string data_dir, IoBackendType backend, bool direct_io,
+                               uint32_t page_size)
+    : data_dir_(std::move(data_dir)), backend_(make_io_backend(backend)), direct_io_(direct_io) {
     static_cast<void>(create_dir_if_not_exists());
+    load_control(page_size);
+    metrics_ = common::MetricsRegistry::global().add_collector([this](common::MetricsSnapshot& out) {
+        const auto value = [](const auto& v) {
+            return static_cast<double>(v.load(std::memory_order_relaxed));
+        };
+        out.add_counter("cloudsql_storage_pages_read_total", "Pages read from data files",
+                        value(stats_.pages_read));
+        out.add_counter("cloudsql_storage_pages_written_total", "Pages written to data files",
+                        value(stats_.pages_written));
+        out.add_counter("cloudsql_storage_read_bytes_total", "Bytes read from data files",
+                        value(stats_.bytes_read));
+        out.add_counter("cloudsql_storage_written_bytes_total", "Bytes written to data files",
+                        value(stats_.bytes_written));
+        out.add_counter("cloudsql_storage_files_opened_total", "Data files opened",
+                        value(stats_.files_opened));
+        out.add_counter("cloudsql_storage_batches_submitted_total",
+                        "Batches of page transfers submitted to the I/O backend",
+                        value(stats_.batches_submitted));
+        out.add_counter("cloudsql_storage_compression_saved_bytes_total",
+                        "Page bytes that compression kept from being written",
+                        value(stats_.compression_saved_bytes));
+        out.add_histogram("cloudsql_storage_read_latency_seconds", "Per-page read latency",
+                          stats_.read_latency);
+        out.add_histogram("cloudsql_storage_write_latency_seconds", "Per-page write latency",
+                          stats_.write_latency);
+    });
 }
 
 /**
  * @brief Destroy the Storage Manager and close all files
  */
 StorageManager::~StorageManager() {
+    const std::unique_lock<std::shared_mutex> lock(files_latch_);
     for (auto& pair : open_files_) {
-        if (pair.second->is_open()) {
-            pair.second->close();
-        }
+        static_cast<void>(::close(pair.second.fd));
     }
 }
 
@@ -45,35 +132,56 @@ StorageManager::~StorageManager() {
  * @brief Open a database file
  */
 bool StorageManager::open_file(const std::string& filename) {
-    if (open_files_.find(filename) != open_files_.end()) {
-        auto& file = open_files_[filename];
-        if (file->is_open()) {
-            return true;
+    const std::unique_lock<std::shared_mutex> lock(files_latch_);
+    return open_file_unlocked(filename);
+}
+
+/**
+ * @brief Intern a file name into a compact id
+ */
+uint32_t StorageManager::get_file_id(const std::string& filename) {
+    {
+        const std::shared_lock<std::shared_mutex> lock(file_ids_latch_);
+        const auto it = file_ids_.find(filename);
+        if (it != file_ids_.end()) {
+            return it->second;
         }
-        static_cast<void>(open_files_.erase(filename));
     }
 
-    const std::string filepath = data_dir_ + "/" + filename;
-    auto file = std::make_unique<std::fstream>();
-
-    /* Open for read/write in binary mode. */
-    file->open(filepath, std::ios::in | std::ios::out | std::ios::binary);
+    const std::unique_lock<std::shared_mutex> lock(file_ids_latch_);
+    const auto [it, inserted] = file_ids_.try_emplace(filename, next_file_id_);
+    if (inserted) {
+        next_file_id_++;
+    }
+    return it->second;
+}
 
-    if (!file->is_open()) {
-        /* Create empty file then reopen */
-        file->open(filepath, std::ios::out | std::ios::binary);
-        if (!file->is_open()) {
-            return false;
-        }
-        file->close();
-        file->open(filepath, std::ios::in | std::ios::out | std::ios::binary);
+/**
+ * @brief Open a database file (caller holds files_latch_ exclusively)
+ */
+bool StorageManager::open_file_unlocked(const std::string& filename) {
+    if (open_files_.find(filename) != open_files_.end()) {
+        return true;
     }
 
-    if (!file->is_open()) {
+    const std::string filepath = data_dir_ + "/" + filename;
+    OpenFile file;
+    file.map = PageMap::open(filepath + PageMap::FILE_SUFFIX);
+
+    if (direct_io_ && !file.map) {
+        /* Not every filesystem (e.g. tmpfs) accepts O_DIRECT; fall back to buffered I/O */
+        file.fd = ::open(filepath.c_str(), O_RDWR | O_CREAT | O_DIRECT | O_CLOEXEC,
+                         DEFAULT_FILE_MODE);
+        file.direct = file.fd >= 0;
+    }
+    if (file.fd < 0) {
+        file.fd = ::open(filepath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, DEFAULT_FILE_MODE);
+    }
+    if (file.fd < 0) {
         return false;
     }
 
-    open_files_[filename] = std::move(file);
+    open_files_[filename] = file;
     static_cast<void>(stats_.files_opened.fetch_add(1));
     return true;
 }
@@ -82,50 +190,77 @@ bool StorageManager::open_file(const std::string& filename) {
  * @brief Close a database file
  */
 bool StorageManager::close_file(const std::string& filename) {
+    const std::unique_lock<std::shared_mutex> lock(files_latch_);
     auto it = open_files_.find(filename);
     if (it == open_files_.end()) {
         return false;
     }
 
-    it->second->close();
+    static_cast<void>(::close(it->second.fd));
     static_cast<void>(open_files_.erase(it));
     return true;
 }
 
 /**
- * @brief Read a page from storage
+ * @brief Resolve a descriptor, opening the file on first use
  */
-bool StorageManager::read_page(const std::string& filename, uint32_t page_num, char* buffer) {
-    if (open_files_.find(filename) == open_files_.end()) {
+std::shared_lock<std::shared_mutex> StorageManager::acquire_file(const std::string& filename,
+                                                                 OpenFile* out) {
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        std::shared_lock<std::shared_mutex> lock(files_latch_);
+        const auto it = open_files_.find(filename);
+        if (it != open_files_.end()) {
+            *out = it->second;
+            return lock;
+        }
+        lock.unlock();
         if (!open_file(filename)) {
-            return false;
+            break;
         }
     }
+    return {};
+}
 
-    auto& file = open_files_[filename];
-    file->clear(); /* Clear flags like EOF */
-    file->seekg(static_cast<std::streamoff>(page_num) * static_cast<std::streamoff>(PAGE_SIZE),
-                std::ios::beg);
-
-    if (file->fail()) {
+/**
+ * @brief Read a page from storage
+ */
+bool StorageManager::read_page(const std::string& filename, uint32_t page_num, char* buffer) {
+    OpenFile file;
+    const auto lock = acquire_file(filename, &file);
+    if (!lock.owns_lock()) {
         return false;
     }
+    if (file.map) {
+        return read_extent(file, page_num, buffer);
+    }
 
-    static_cast<void>(file->read(buffer, PAGE_SIZE));
+    AlignedBuffer bounce;
+    char* target = buffer;
+    if (file.direct && !is_page_aligned(buffer)) {
+        bounce = make_aligned_page(page_size_);
+        target = bounce.get();
+    }
 
-    if (file->gcount() < static_cast<std::streamsize>(PAGE_SIZE)) {
-        if (file->eof() || file->gcount() == 0) {
-            /* If we reached end of file or read nothing, zero-fill the rest */
-            std::fill(std::next(buffer, file->gcount()),
-                      std::next(buffer, static_cast<std::ptrdiff_t>(PAGE_SIZE)), 0);
-            file->clear();
-            return true;
-        }
+    const auto start = std::chrono::steady_clock::now();
+    const int64_t n = backend_->read(file.fd, target, page_size_,
+                                     static_cast<uint64_t>(page_num) * page_size_);
+    stats_.read_latency.record(std::chrono::steady_clock::now() - start);
+    if (n < 0) {
         return false;
     }
 
+    if (bounce) {
+        std::copy(target, std::next(target, static_cast<std::ptrdiff_t>(n)), buffer);
+    }
+    if (n < static_cast<int64_t>(page_size_)) {
+        /* If we reached end of file or read nothing, zero-fill the rest */
+        zero_fill_tail(buffer, n, page_size_);
+        return true;
+    }
+
     static_cast<void>(stats_.pages_read.fetch_add(1));
-    static_cast<void>(stats_.bytes_read.fetch_add(PAGE_SIZE));
+    static_cast<void>(stats_.bytes_read.fetch_add(page_size_));
+    thread_io_counters().pages_read++;
     return true;
 }
 
@@ -134,49 +269,270 @@ bool StorageManager::read_page(const std::string& filename, uint32_t page_num, c
  */
 bool StorageManager::write_page(const std::string& filename, uint32_t page_num,
                                 const char* buffer) {
-    if (open_files_.find(filename) == open_files_.end()) {
-        if (!open_file(filename)) {
-            return false;
-        }
+    OpenFile file;
+    const auto lock = acquire_file(filename, &file);
+    if (!lock.owns_lock()) {
+        return false;
+    }
+    if (file.map) {
+        return write_extent(file, page_num, buffer);
     }
 
-    auto& file = open_files_[filename];
-    file->clear();
-    file->seekp(static_cast<std::streamoff>(page_num) * static_cast<std::streamoff>(PAGE_SIZE),
-                std::ios::beg);
+    AlignedBuffer bounce;
+    const char* source = buffer;
+    if (file.direct && !is_page_aligned(buffer)) {
+        bounce = make_aligned_page(page_size_);
+        std::copy(buffer, std::next(buffer, static_cast<std::ptrdiff_t>(page_size_)),
+                  bounce.get());
+        source = bounce.get();
+    }
 
-    if (file->fail()) {
+    const auto start = std::chrono::steady_clock::now();
+    const int64_t n = backend_->write(file.fd, source, page_size_,
+                                      static_cast<uint64_t>(page_num) * page_size_);
+    stats_.write_latency.record(std::chrono::steady_clock::now() - start);
+    if (n != static_cast<int64_t>(page_size_)) {
         return false;
     }
 
-    static_cast<void>(file->write(buffer, PAGE_SIZE));
-    if (file->fail()) {
+    static_cast<void>(stats_.pages_written.fetch_add(1));
+    static_cast<void>(stats_.bytes_written.fetch_add(page_size_));
+    return true;
+}
+
+/**
+ * @brief Submit a batch of page transfers through the backend
+ */
+size_t StorageManager::submit_batch(std::vector<PageIo>& batch) {
+    if (batch.empty()) {
+        return 0;
+    }
+
+    /* Open any files the batch touches before taking the shared latch for the I/O */
+    for (const auto& io : batch) {
+        OpenFile file;
+        static_cast<void>(acquire_file(io.filename, &file));
+    }
+
+    const std::shared_lock<std::shared_mutex> lock(files_latch_);
+    std::vector<IoRequest> requests;
+    std::vector<size_t> origin;
+    std::vector<AlignedBuffer> bounce(batch.size());
+    requests.reserve(batch.size());
+    origin.reserve(batch.size());
+    size_t succeeded = 0;
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        auto& io = batch[i];
+        io.ok = false;
+        const auto it = open_files_.find(io.filename);
+        if (it == open_files_.end()) {
+            continue;
+        }
+        if (it->second.map) {
+            /* Extents differ in size and place, so these go one at a time */
+            io.ok = io.op == IoRequest::Op::Read ? read_extent(it->second, io.page_num, io.buffer)
+                                                 : write_extent(it->second, io.page_num, io.buffer);
+            succeeded += io.ok ? 1 : 0;
+            continue;
+        }
+
+        IoRequest req;
+        req.op = io.op;
+        req.fd = it->second.fd;
+        req.offset = static_cast<uint64_t>(io.page_num) * page_size_;
+        req.buffer = io.buffer;
+        req.length = page_size_;
+        if (it->second.direct && !is_page_aligned(io.buffer)) {
+            bounce[i] = make_aligned_page(page_size_);
+            if (io.op == IoRequest::Op::Write) {
+                std::copy(io.buffer, std::next(io.buffer, static_cast<std::ptrdiff_t>(page_size_)),
+                          bounce[i].get());
+            }
+            req.buffer = bounce[i].get();
+        }
+        requests.push_back(req);
+        origin.push_back(i);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    backend_->submit(requests);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    static_cast<void>(stats_.batches_submitted.fetch_add(1));
+
+    for (size_t r = 0; r < requests.size(); ++r) {
+        const auto& req = requests[r];
+        auto& io = batch[origin[r]];
+        if (req.op == IoRequest::Op::Read) {
+            stats_.read_latency.record(elapsed);
+            if (req.result < 0) {
+                continue;
+            }
+            if (bounce[origin[r]]) {
+                std::copy(req.buffer, std::next(req.buffer, static_cast<std::ptrdiff_t>(req.result)),
+                          io.buffer);
+            }
+            if (req.result < static_cast<int64_t>(page_size_)) {
+                zero_fill_tail(io.buffer, req.result, page_size_);
+            } else {
+                static_cast<void>(stats_.pages_read.fetch_add(1));
+                static_cast<void>(stats_.bytes_read.fetch_add(page_size_));
+                thread_io_counters().pages_read++;
+            }
+        } else {
+            stats_.write_latency.record(elapsed);
+            if (req.result != static_cast<int64_t>(page_size_)) {
+                continue;
+            }
+            static_cast<void>(stats_.pages_written.fetch_add(1));
+            static_cast<void>(stats_.bytes_written.fetch_add(page_size_));
+        }
+        io.ok = true;
+        succeeded++;
+    }
+    return succeeded;
+}
+
+/**
+ * @brief Allocate a new page in the database file
+ */
+uint32_t StorageManager::allocate_page(const std::string& filename) {
+    return page_count(filename);
+}
+
+/**
+ * @brief Number of whole pages on disk
+ */
+uint32_t StorageManager::page_count(const std::string& filename) {
+    OpenFile file;
+    const auto lock = acquire_file(filename, &file);
+    if (!lock.owns_lock()) {
+        return 0;
+    }
+
+    if (file.map) {
+        return file.map->page_count();
+    }
+
+    struct stat st {};
+    if (::fstat(file.fd, &st) != 0) {
+        return 0;
+    }
+    return static_cast<uint32_t>(static_cast<uint64_t>(st.st_size) / page_size_);
+}
+
+/**
+ * @brief Read a page from its extent in a compressed file
+ */
+bool StorageManager::read_extent(const OpenFile& file, uint32_t page_num, char* buffer) {
+    const PageExtent extent = file.map->lookup(page_num);
+    if (extent.length == 0) {
+        /* Never written, like a read past the end of an uncompressed file */
+        zero_fill_tail(buffer, 0, page_size_);
+        return true;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    bool ok = false;
+    if (extent.length == page_size_) {
+        /* Stored as is because it did not compress */
+        ok = backend_->read(file.fd, buffer, extent.length, extent.offset) == extent.length;
+    } else {
+        std::vector<uint8_t>& scratch = compression_scratch();
+        scratch.resize(extent.length);
+        ok = backend_->read(file.fd, reinterpret_cast<char*>(scratch.data()), extent.length,
+                            extent.offset) == extent.length &&
+             common::lz4::decompress(scratch.data(), extent.length,
+                                     reinterpret_cast<uint8_t*>(buffer), page_size_);
+    }
+    stats_.read_latency.record(std::chrono::steady_clock::now() - start);
+    if (!ok) {
+        std::cerr << "--- [StorageManager] cannot read compressed page " << page_num << " ---"
+                  << std::endl;
         return false;
     }
 
-    file->flush();
+    static_cast<void>(stats_.pages_read.fetch_add(1));
+    static_cast<void>(stats_.bytes_read.fetch_add(extent.length));
+    thread_io_counters().pages_read++;
+    return true;
+}
+
+/**
+ * @brief Compress a page and write it to an extent of a compressed file
+ */
+bool StorageManager::write_extent(const OpenFile& file, uint32_t page_num, const char* buffer) {
+    std::vector<uint8_t>& scratch = compression_scratch();
+    scratch.clear();
+    common::lz4::compress(reinterpret_cast<const uint8_t*>(buffer), page_size_, scratch);
+    const char* source = reinterpret_cast<const char*>(scratch.data());
+    auto length = static_cast<uint32_t>(scratch.size());
+    if (length >= page_size_) {
+        source = buffer;
+        length = page_size_;
+    }
+
+    const PageExtent extent = file.map->place(page_num, length);
+    const auto start = std::chrono::steady_clock::now();
+    const int64_t n = backend_->write(file.fd, source, length, extent.offset);
+    stats_.write_latency.record(std::chrono::steady_clock::now() - start);
+    if (n != static_cast<int64_t>(length) || !file.map->commit(page_num, extent)) {
+        return false;
+    }
 
     static_cast<void>(stats_.pages_written.fetch_add(1));
-    static_cast<void>(stats_.bytes_written.fetch_add(PAGE_SIZE));
+    static_cast<void>(stats_.bytes_written.fetch_add(length));
+    static_cast<void>(stats_.compression_saved_bytes.fetch_add(page_size_ - length));
     return true;
 }
 
 /**
- * @brief Allocate a new page in the database file
+ * @brief Record how a file's pages are stored
  */
-uint32_t StorageManager::allocate_page(const std::string& filename) {
-    if (open_files_.find(filename) == open_files_.end()) {
-        if (!open_file(filename)) {
-            return 0;
-        }
+bool StorageManager::set_compression(const std::string& filename, PageCompression compression) {
+    if (page_count(filename) != 0) {
+        return this->compression(filename) == compression;
     }
 
-    auto& file = open_files_[filename];
-    file->clear();
-    file->seekg(0, std::ios::end);
-    const std::streamoff size = file->tellg();
+    const std::unique_lock<std::shared_mutex> lock(files_latch_);
+    const std::string map_path = get_full_path(filename) + PageMap::FILE_SUFFIX;
+    if (compression == PageCompression::None) {
+        static_cast<void>(std::remove(map_path.c_str()));
+    } else if (!PageMap::create(map_path, compression)) {
+        return false;
+    }
 
-    return static_cast<uint32_t>(static_cast<uint64_t>(size) / PAGE_SIZE);
+    /* Reopened on next use, with the new layout */
+    const auto it = open_files_.find(filename);
+    if (it != open_files_.end()) {
+        static_cast<void>(::close(it->second.fd));
+        static_cast<void>(open_files_.erase(it));
+    }
+    return true;
+}
+
+/**
+ * @brief How a file's pages are stored
+ */
+PageCompression StorageManager::compression(const std::string& filename) {
+    OpenFile file;
+    const auto lock = acquire_file(filename, &file);
+    return file.map ? file.map->compression() : PageCompression::None;
+}
+
+/**
+ * @brief Remove every page of a file
+ */
+bool StorageManager::truncate_file(const std::string& filename) {
+    OpenFile file;
+    const auto lock = acquire_file(filename, &file);
+    if (!lock.owns_lock()) {
+        return false;
+    }
+    if (file.map && !file.map->clear()) {
+        return false;
+    }
+    return ::ftruncate(file.fd, 0) == 0;
 }
 
 /**
@@ -215,6 +571,63 @@ bool StorageManager::create_dir_if_not_exists() {
     return true;
 }
 
+/**
+ * @brief Adopt the page size recorded for the database, recording one if there is none
+ */
+void StorageManager::load_control(uint32_t requested) {
+    const std::string path = get_full_path(CONTROL_FILE);
+    ControlHeader header{};
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        const ssize_t n = ::read(fd, &header, sizeof(header));
+        static_cast<void>(::close(fd));
+        if (n == static_cast<ssize_t>(sizeof(header)) && header.magic == CONTROL_MAGIC &&
+            Page::valid_page_size(header.page_size)) {
+            page_size_ = header.page_size;
+        } else {
+            std::cerr << "--- [StorageManager] unreadable " << path << "; assuming "
+                      << Page::DEFAULT_PAGE_SIZE << "-byte pages ---" << std::endl;
+        }
+        if (requested != 0 && requested != page_size_) {
+            std::cerr << "--- [StorageManager] database uses " << page_size_
+                      << "-byte pages; the page size is fixed when it is created ---" << std::endl;
+        }
+        return;
+    }
+
+    /* Files written before the size was recorded are in the default size */
+    bool has_files = false;
+    DIR* dir = ::opendir(data_dir_.c_str());
+    if (dir != nullptr) {
+        while (const dirent* file = ::readdir(dir)) {
+            const std::string name = file->d_name;
+            if (name != "." && name != "..") {
+                has_files = true;
+                break;
+            }
+        }
+        static_cast<void>(::closedir(dir));
+    }
+    if (requested != 0 && !Page::valid_page_size(requested)) {
+        std::cerr << "--- [StorageManager] invalid page size " << requested << "; using "
+                  << Page::DEFAULT_PAGE_SIZE << " ---" << std::endl;
+    } else if (requested != 0 && has_files && requested != Page::DEFAULT_PAGE_SIZE) {
+        std::cerr << "--- [StorageManager] " << data_dir_ << " already holds "
+                  << Page::DEFAULT_PAGE_SIZE << "-byte pages; keeping them ---" << std::endl;
+    } else if (requested != 0) {
+        page_size_ = requested;
+    }
+
+    header = ControlHeader{CONTROL_MAGIC, CONTROL_VERSION, page_size_, 0};
+    const int out = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                           DEFAULT_FILE_MODE);
+    if (out >= 0) {
+        static_cast<void>(::write(out, &header, sizeof(header)));
+        static_cast<void>(::fsync(out));
+        static_cast<void>(::close(out));
+    }
+}
+
 }  // namespace cloudsql::storage
 
 /** @} */
@@ -0,0 +1,163 @@
+/**
+ * @file commit_log.cpp
+ * @brief Commit log implementation
+ */
+
+#include "transaction/commit_log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace cloudsql::transaction {
+
+CommitLog::CommitLog() : segments_(std::make_unique<std::atomic<Segment*>[]>(MAX_SEGMENTS)) {
+    for (size_t i = 0; i < MAX_SEGMENTS; ++i) {
+        segments_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+CommitLog::~CommitLog() {
+    for (size_t i = 0; i < MAX_SEGMENTS; ++i) {
+        delete segments_[i].load(std::memory_order_relaxed);
+    }
+}
+
+std::atomic<csn_t>* CommitLog::entry(txn_id_t txn_id) {
+    const uint64_t number = txn_id >> SEGMENT_BITS;
+    std::atomic<Segment*>& ring_slot = segments_[number % MAX_SEGMENTS];
+    Segment* segment = ring_slot.load(std::memory_order_acquire);
+    if (segment == nullptr) {
+        auto fresh = std::make_unique<Segment>();
+        fresh->number.store(number, std::memory_order_relaxed);
+        for (auto& slot : fresh->entries) {
+            slot.store(IN_PROGRESS, std::memory_order_relaxed);
+        }
+        /* Whoever loses the race frees its copy and uses the winner's */
+        if (ring_slot.compare_exchange_strong(segment, fresh.get(), std::memory_order_acq_rel)) {
+            segment = fresh.release();
+        }
+    }
+
+    uint64_t held = segment->number.load();
+    while (held != number) {
+        if (held == RECYCLING) {
+            std::this_thread::yield(); /* Another committer is resetting it for our ids */
+            held = segment->number.load();
+            continue;
+        }
+        /* Only a truncated segment may be reused; a live one means the ring is full */
+        if (held > number || held >= (truncated_below_.load() >> SEGMENT_BITS)) {
+            return nullptr;
+        }
+        if (segment->number.compare_exchange_strong(held, RECYCLING)) {
+            for (auto& slot : segment->entries) {
+                slot.store(IN_PROGRESS);
+            }
+            segment->number.store(number);
+            held = number;
+        }
+    }
+    return &segment->entries[txn_id & (SEGMENT_SIZE - 1)];
+}
+
+csn_t CommitLog::commit(txn_id_t txn_id) {
+    std::atomic<csn_t>* const slot = entry(txn_id);
+    if (slot == nullptr) {
+        throw std::runtime_error("CommitLog: no room to record the commit of transaction " +
+                                 std::to_string(txn_id));
+    }
+    slot->store(COMMITTING);
+    const csn_t csn = last_csn_.fetch_add(1) + 1;
+    slot->store(csn);
+    return csn;
+}
+
+void CommitLog::abort(txn_id_t txn_id) {
+    std::atomic<csn_t>* const slot = entry(txn_id);
+    if (slot != nullptr) {
+        slot->store(ABORTED);
+    }
+}
+
+void CommitLog::set_frozen_below(txn_id_t txn_id, const std::vector<txn_id_t>& in_doubt) {
+    txn_id_t below = txn_id;
+    if (!in_doubt.empty()) {
+        const txn_id_t first = *std::min_element(in_doubt.begin(), in_doubt.end());
+        const std::unordered_set<txn_id_t> waiting(in_doubt.begin(), in_doubt.end());
+        for (txn_id_t id = first; id < txn_id; ++id) {
+            if (waiting.count(id) != 0) {
+                continue;
+            }
+            std::atomic<csn_t>* const slot = entry(id);
+            if (slot == nullptr) {
+                std::cerr << "CommitLog: no room to freeze transaction " << id << "\n";
+                continue;
+            }
+            slot->store(FROZEN);
+        }
+        below = std::min(below, first);
+    }
+    if (below > frozen_below_.load()) {
+        frozen_below_.store(below);
+    }
+}
+
+void CommitLog::truncate(txn_id_t oldest_running, csn_t horizon) {
+    const txn_id_t frozen = frozen_below_.load();
+    txn_id_t below = std::max(truncated_below_.load(), frozen & ~txn_id_t{SEGMENT_SIZE - 1});
+    while (below + SEGMENT_SIZE <= oldest_running) {
+        const uint64_t number = below >> SEGMENT_BITS;
+        const Segment* const segment = segments_[number % MAX_SEGMENTS].load();
+        if (segment == nullptr || segment->number.load() != number) {
+            break; /* Never reserved; ids missing their outcome stay unknown */
+        }
+        bool settled = true;
+        /* Id 0 is never handed out */
+        const txn_id_t first = std::max({below, frozen, txn_id_t{1}});
+        for (txn_id_t id = first; id < below + SEGMENT_SIZE && settled; ++id) {
+            const csn_t csn = segment->entries[id & (SEGMENT_SIZE - 1)].load();
+            settled = csn == ABORTED || (csn != IN_PROGRESS && csn <= horizon);
+        }
+        if (!settled) {
+            break;
+        }
+        below += SEGMENT_SIZE;
+    }
+    if (below > truncated_below_.load()) {
+        truncated_below_.store(below);
+    }
+}
+
+csn_t CommitLog::csn(txn_id_t txn_id) const {
+    if (txn_id < frozen_below_.load(std::memory_order_relaxed) ||
+        txn_id < truncated_below_.load()) {
+        return FROZEN;
+    }
+    const uint64_t number = txn_id >> SEGMENT_BITS;
+    const Segment* const segment = segments_[number % MAX_SEGMENTS].load(std::memory_order_acquire);
+    if (segment == nullptr || segment->number.load() != number) {
+        return txn_id < truncated_below_.load() ? FROZEN : IN_PROGRESS;
+    }
+    const std::atomic<csn_t>& slot = segment->entries[txn_id & (SEGMENT_SIZE - 1)];
+    csn_t csn = slot.load();
+    while (csn == COMMITTING) {
+        std::this_thread::yield(); /* The committer is between two stores */
+        csn = slot.load();
+    }
+    /* Recycled while we read: only done past the truncation point, so the id is frozen */
+    if (segment->number.load() != number) {
+        return FROZEN;
+    }
+    return csn;
+}
+
+}  // namespace cloudsql::transaction
@@ -5,143 +5,430 @@
 
 #include "transaction/lock_manager.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iterator>
+#include <map>
 #include <mutex>
-#include <string>
+#include <vector>
 
+#include "common/metrics.hpp"
 #include "transaction/transaction.hpp"
 
 namespace cloudsql::transaction {
 
-bool LockManager::acquire_shared(Transaction* txn, const std::string& rid) {
-    std::unique_lock<std::mutex> lock(latch_);
-    auto& queue = lock_table_[rid];
+namespace {
 
-    /* Check if we already hold a lock */
-    for (const auto& req : queue.request_queue) {
-        if (req.txn_id == txn->get_id()) {
-            if (req.mode == LockMode::EXCLUSIVE || req.mode == LockMode::SHARED) {
-                return true;
-            }
-        }
+/* Index order: SHARED, EXCLUSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE, SHARED_INTENTION_EXCLUSIVE */
+constexpr std::array<std::array<bool, 5>, 5> COMPATIBLE = {{
+    {true, false, true, false, false},  /* S */
+    {false, false, false, false, false}, /* X */
+    {true, false, true, true, true},    /* IS */
+    {false, false, true, true, false},  /* IX */
+    {false, false, true, false, false}, /* SIX */
+}};
+
+bool compatible(LockMode a, LockMode b) {
+    return COMPATIBLE[static_cast<size_t>(a)][static_cast<size_t>(b)];
+}
+
+/** @return true if holding `held` already grants everything `wanted` would */
+bool covers(LockMode held, LockMode wanted) {
+    if (held == wanted || held == LockMode::EXCLUSIVE) {
+        return true;
+    }
+    switch (held) {
+        case LockMode::SHARED_INTENTION_EXCLUSIVE:
+            return wanted != LockMode::EXCLUSIVE;
+        case LockMode::SHARED:
+        case LockMode::INTENTION_EXCLUSIVE:
+            return wanted == LockMode::INTENTION_SHARED;
+        default:
+            return false;
     }
+}
 
-    queue.request_queue.push_back({txn->get_id(), LockMode::SHARED, false});
-    const auto it = std::prev(queue.request_queue.end());  // Iterator to our request
+/** @return The weakest mode covering both */
+LockMode combine(LockMode held, LockMode wanted) {
+    if (covers(held, wanted)) {
+        return held;
+    }
+    if (covers(wanted, held)) {
+        return wanted;
+    }
+    /* S and IX (in either order) are both covered by SIX; every other pair needs X */
+    if ((held == LockMode::SHARED && wanted == LockMode::INTENTION_EXCLUSIVE) ||
+        (held == LockMode::INTENTION_EXCLUSIVE && wanted == LockMode::SHARED)) {
+        return LockMode::SHARED_INTENTION_EXCLUSIVE;
+    }
+    return LockMode::EXCLUSIVE;
+}
 
-    /* Wait loop with timeout to avoid permanent hangs */
-    const auto timeout = std::chrono::milliseconds(1000);
-    const bool success = queue.cv.wait_for(lock, timeout, [&]() {
-        /* Check if we are aborted */
-        if (txn->get_state() == TransactionState::ABORTED) {
-            return true;
-        }
+}  // namespace
 
-        /* Check compatibility */
-        /* Shared locks are compatible with other shared locks, but not exclusive */
-        bool compatible = true;
-        for (auto iter = queue.request_queue.begin(); iter != it; ++iter) {
-            if (iter->mode == LockMode::EXCLUSIVE) {
-                compatible = false;
-                break;
-            }
-        }
-        return compatible;
+LockManager::LockManager(std::chrono::milliseconds detection_interval,
+                         std::chrono::milliseconds lock_timeout)
+    : detection_interval_(detection_interval), lock_timeout_(lock_timeout) {
+    detector_thread_ = std::thread([this] { detector(); });
+    metrics_ = common::MetricsRegistry::global().add_collector([this](common::MetricsSnapshot& out) {
+        const auto value = [](const std::atomic<uint64_t>& v) {
+            return static_cast<double>(v.load(std::memory_order_relaxed));
+        };
+        out.add_counter("cloudsql_lock_waits_total", "Lock requests that waited for a conflict",
+                        value(waits_));
+        out.add_counter("cloudsql_lock_timeouts_total", "Lock waits that ran out of time",
+                        value(timeouts_));
+        out.add_counter("cloudsql_lock_deadlocks_total", "Waiters chosen as deadlock victims",
+                        value(deadlocks_));
+        out.add_counter("cloudsql_lock_escalations_total",
+                        "Row locks traded for a table lock", value(escalations_));
+        out.add_histogram("cloudsql_lock_wait_seconds", "Time spent waiting for a lock",
+                          wait_latency_);
     });
+}
 
-    if (!success || txn->get_state() == TransactionState::ABORTED) {
-        static_cast<void>(queue.request_queue.erase(it));
-        return false;
+LockManager::~LockManager() {
+    {
+        const std::scoped_lock<std::mutex> lock(detector_latch_);
+        detector_stop_ = true;
     }
+    detector_cv_.notify_all();
+    detector_thread_.join();
+}
 
-    it->granted = true;
-    txn->add_shared_lock(rid);
+LockManager::LockQueue& LockManager::pin_queue(lock_key_t rid) {
+    Partition& part = partition_for(rid);
+    const std::scoped_lock<std::mutex> lock(part.latch);
+    auto& queue = part.queues[rid];
+    if (!queue) {
+        queue = std::make_unique<LockQueue>();
+    }
+    queue->refs++;
+    return *queue;
+}
+
+void LockManager::unpin_queue(lock_key_t rid) {
+    Partition& part = partition_for(rid);
+    const std::scoped_lock<std::mutex> lock(part.latch);
+    const auto it = part.queues.find(rid);
+    if (it == part.queues.end()) {
+        return;
+    }
+    /* With no references left nobody else can be looking at the queue */
+    LockQueue& queue = *it->second;
+    if (--queue.refs == 0 && queue.request_queue.empty() && queue.upgrading == NO_TXN) {
+        part.queues.erase(it);
+    }
+}
+
+bool LockManager::grantable(const LockQueue& queue,
+                            std::list<LockRequest>::const_iterator req) {
+    /* A pending conversion goes first; otherwise nobody jumps a conflicting request ahead */
+    if (queue.upgrading != NO_TXN && queue.upgrading != req->txn_id) {
+        return false;
+    }
+    for (auto it = queue.request_queue.begin(); it != req; ++it) {
+        if (!compatible(req->mode, it->mode)) {
+            return false;
+        }
+    }
     return true;
 }
 
-bool LockManager::acquire_exclusive(Transaction* txn, const std::string& rid) {
-    std::unique_lock<std::mutex> lock(latch_);
-    auto& queue = lock_table_[rid];
+bool LockManager::compatible_with_granted(const LockQueue& queue, txn_id_t txn_id,
+                                          LockMode mode) {
+    return std::all_of(queue.request_queue.begin(), queue.request_queue.end(),
+                       [&](const LockRequest& r) {
+                           return !r.granted || r.txn_id == txn_id || compatible(mode, r.mode);
+                       });
+}
 
-    /* Check for lock upgrade */
-    bool upgrade = false;
-    [[maybe_unused]] auto it = queue.request_queue.end();
+bool LockManager::wait_for_grant(std::unique_lock<std::mutex>& lock, LockQueue& queue,
+                                 Transaction* txn, const std::function<bool()>& ready,
+                                 LockRequest& req) {
+    const auto start = std::chrono::steady_clock::now();
+    const bool woken = queue.cv.wait_until(lock, start + lock_timeout_, [&] {
+        return req.victim || txn->get_state() == TransactionState::ABORTED || ready();
+    });
+    static_cast<void>(waits_.fetch_add(1, std::memory_order_relaxed));
+    wait_latency_.record(std::chrono::steady_clock::now() - start);
+    if (!woken) {
+        static_cast<void>(timeouts_.fetch_add(1, std::memory_order_relaxed));
+    }
+    if (req.victim || txn->get_state() == TransactionState::ABORTED) {
+        req.victim = false;
+        return false;
+    }
+    return ready();
+}
+
+bool LockManager::acquire(Transaction* txn, lock_key_t key, LockMode mode, bool wait) {
+    /* The transaction's own record answers repeat requests without touching the queue */
+    const auto held = txn->held_lock(key);
+    if (held.has_value() && covers(*held, mode)) {
+        return true;
+    }
+
+    LockQueue& queue = pin_queue(key);
+    bool granted = false;
+    {
+        std::unique_lock<std::mutex> lock(queue.latch);
 
-    for (auto iter = queue.request_queue.begin(); iter != queue.request_queue.end(); ++iter) {
-        if (iter->txn_id == txn->get_id()) {
-            if (iter->mode == LockMode::EXCLUSIVE) {
-                return true;  // Already held
+        const auto own = std::find_if(queue.request_queue.begin(), queue.request_queue.end(),
+                                      [&](const LockRequest& r) { return r.txn_id == txn->get_id(); });
+        if (own != queue.request_queue.end()) {
+            /*
+             * Convert in place: keep the held lock and wait until the combined mode is
+             * compatible with every other granted lock. Two converters could each wait
+             * for the other's current lock, so a second one gives up.
+             */
+            const LockMode target = combine(own->mode, mode);
+            if (compatible_with_granted(queue, txn->get_id(), target)) {
+                granted = true;
+            } else if (wait && queue.upgrading == NO_TXN) {
+                queue.upgrading = txn->get_id();
+                queue.upgrade_mode = target;
+                granted = wait_for_grant(
+                    lock, queue, txn,
+                    [&] { return compatible_with_granted(queue, txn->get_id(), target); }, *own);
+                queue.upgrading = NO_TXN;
+                if (!granted) {
+                    queue.cv.notify_all();
+                }
             }
-            if (iter->mode == LockMode::SHARED) {
-                /* We have S lock, need upgrade */
-                upgrade = true;
-                it = iter;  // Mark our current S lock
-                break;
+            if (granted) {
+                own->mode = target;
+                txn->add_lock(key, target);
+            }
+        } else {
+            queue.request_queue.push_back({txn->get_id(), mode, false, false});
+            const auto it = std::prev(queue.request_queue.end());
+            if (grantable(queue, it)) {
+                granted = true;
+            } else if (wait) {
+                granted =
+                    wait_for_grant(lock, queue, txn, [&] { return grantable(queue, it); }, *it);
+            }
+            if (granted) {
+                it->granted = true;
+                txn->add_lock(key, mode);
+            } else {
+                static_cast<void>(queue.request_queue.erase(it));
+                queue.cv.notify_all();
             }
         }
     }
+    unpin_queue(key);
+    return granted;
+}
 
-    if (upgrade) {
-        /* Release S lock temporarily or just modify request? */
-        /* Simple upgrade: drop S, queue X. Real implementation needs care for deadlocks/starvation
-         */
-        /* For now, let's just queue a new X request and wait. This is simplistic. */
-        /* NOTE: Upgrades are deadlock-prone without proper handling. */
+bool LockManager::lock_row(Transaction* txn, uint32_t table_oid,
+                           const storage::HeapTable::TupleId& tid, LockMode mode) {
+    const lock_key_t table = table_key(table_oid);
+    const auto table_mode = txn->held_lock(table);
+    if (table_mode.has_value() && covers(*table_mode, mode)) {
+        return true;
     }
 
-    queue.request_queue.push_back({txn->get_id(), LockMode::EXCLUSIVE, false});
-    const auto my_req = std::prev(queue.request_queue.end());
+    const LockMode intention =
+        mode == LockMode::SHARED ? LockMode::INTENTION_SHARED : LockMode::INTENTION_EXCLUSIVE;
+    const lock_key_t row = row_key(table_oid, tid);
+    const bool new_row = !txn->held_lock(row).has_value();
+    if (!acquire(txn, table, intention) ||
+        !acquire(txn, page_key(table_oid, tid.page_num), intention) ||
+        !acquire(txn, row, mode)) {
+        return false;
+    }
 
-    const auto timeout = std::chrono::milliseconds(1000);
-    const bool success = queue.cv.wait_for(lock, timeout, [&]() {
-        if (txn->get_state() == TransactionState::ABORTED) {
-            return true;
-        }
+    /* Re-locks and upgrades hold no more rows; a failed escalation retries on the next row */
+    const size_t threshold = escalation_threshold_.load(std::memory_order_relaxed);
+    if (new_row && threshold > 0 && txn->count_row_lock(table) >= threshold) {
+        escalate(txn, table);
+    }
+    return true;
+}
 
-        /* Exclusive requires NO other locks held by OTHERS */
-        bool can_grant = true;
-        for (auto iter = queue.request_queue.begin(); iter != my_req; ++iter) {
-            /* If it's us (upgrade case), we ignore our own previous lock? */
-            /* Simplified: Strictly FIFO for X locks relative to others */
-            if (iter->txn_id != txn->get_id()) {
-                can_grant = false;
-                break;
-            }
-        }
-        return can_grant;
+bool LockManager::lock_rows(Transaction* txn, uint32_t table_oid,
+                            const std::vector<storage::HeapTable::TupleId>& tids,
+                            LockMode mode) {
+    return std::all_of(tids.begin(), tids.end(), [&](const storage::HeapTable::TupleId& tid) {
+        return lock_row(txn, table_oid, tid, mode);
     });
+}
 
-    if (!success || txn->get_state() == TransactionState::ABORTED) {
-        static_cast<void>(queue.request_queue.erase(my_req));
-        return false;
+void LockManager::escalate(Transaction* txn, lock_key_t table) {
+    /* IX or SIX means some rows below are exclusive, so the table lock must be too */
+    const auto held = txn->held_lock(table);
+    const LockMode mode = held.has_value() && *held != LockMode::INTENTION_SHARED
+                              ? LockMode::EXCLUSIVE
+                              : LockMode::SHARED;
+    if (!acquire(txn, table, mode, false)) {
+        return; /* Others hold locks in the table; retry on the next row locked */
     }
 
-    my_req->granted = true;
-    txn->add_exclusive_lock(rid);
-    return true;
+    for (const lock_key_t key : txn->get_lock_set()) {
+        if ((key & TABLE_MASK) == (table & TABLE_MASK) && (key & LEVEL_MASK) != LEVEL_TABLE) {
+            static_cast<void>(unlock(txn, key));
+        }
+    }
+    txn->clear_row_locks(table);
+    static_cast<void>(escalations_.fetch_add(1, std::memory_order_relaxed));
 }
 
-bool LockManager::unlock(Transaction* txn, const std::string& rid) {
-    const std::unique_lock<std::mutex> lock(latch_);
-    if (lock_table_.find(rid) == lock_table_.end()) {
-        return false;
+bool LockManager::acquire_exclusive(Transaction* txn, const std::vector<lock_key_t>& rids) {
+    std::vector<lock_key_t> contended;
+    for (const lock_key_t rid : rids) {
+        LockQueue& queue = pin_queue(rid);
+        {
+            const std::scoped_lock<std::mutex> lock(queue.latch);
+            if (queue.request_queue.empty() && queue.upgrading == NO_TXN) {
+                queue.request_queue.push_back({txn->get_id(), LockMode::EXCLUSIVE, true, false});
+                txn->add_lock(rid, LockMode::EXCLUSIVE);
+            } else {
+                contended.push_back(rid);
+            }
+        }
+        unpin_queue(rid);
     }
+    return std::all_of(contended.begin(), contended.end(),
+                       [&](lock_key_t rid) { return acquire_exclusive(txn, rid); });
+}
 
-    auto& queue = lock_table_[rid];
+bool LockManager::unlock(Transaction* txn, lock_key_t rid) {
+    {
+        Partition& part = partition_for(rid);
+        const std::scoped_lock<std::mutex> lock(part.latch);
+        if (part.queues.find(rid) == part.queues.end()) {
+            return false;
+        }
+    }
+
+    LockQueue& queue = pin_queue(rid);
     bool found = false;
-    for (auto it = queue.request_queue.begin(); it != queue.request_queue.end(); ++it) {
-        if (it->txn_id == txn->get_id()) {
+    {
+        const std::scoped_lock<std::mutex> lock(queue.latch);
+        const auto it = std::find_if(queue.request_queue.begin(), queue.request_queue.end(),
+                                     [&](const LockRequest& r) { return r.txn_id == txn->get_id(); });
+        if (it != queue.request_queue.end()) {
             static_cast<void>(queue.request_queue.erase(it));
             found = true;
+            queue.cv.notify_all();
+        }
+    }
+    unpin_queue(rid);
+    txn->remove_lock(rid);
+    return found;
+}
+
+void LockManager::detector() {
+    std::unique_lock<std::mutex> lock(detector_latch_);
+    while (!detector_cv_.wait_for(lock, detection_interval_, [this] { return detector_stop_; })) {
+        lock.unlock();
+        detect_deadlocks();
+        lock.lock();
+    }
+}
+
+void LockManager::detect_deadlocks() {
+    /* Waits-for graph; ordered so victims are chosen the same way on every scan */
+    std::map<txn_id_t, std::vector<txn_id_t>> waits_for;
+    std::unordered_map<txn_id_t, lock_key_t> waiting_on;
+    for (auto& part : partitions_) {
+        const std::scoped_lock<std::mutex> part_lock(part.latch);
+        for (auto& [rid, queue] : part.queues) {
+            const std::scoped_lock<std::mutex> lock(queue->latch);
+            if (queue->upgrading != NO_TXN) {
+                auto& edges = waits_for[queue->upgrading];
+                for (const auto& req : queue->request_queue) {
+                    if (req.granted && req.txn_id != queue->upgrading &&
+                        !compatible(queue->upgrade_mode, req.mode)) {
+                        edges.push_back(req.txn_id);
+                    }
+                }
+                waiting_on[queue->upgrading] = rid;
+            }
+            for (auto req = queue->request_queue.begin(); req != queue->request_queue.end();
+                 ++req) {
+                if (req->granted) {
+                    continue;
+                }
+                auto& edges = waits_for[req->txn_id];
+                for (auto ahead = queue->request_queue.begin(); ahead != req; ++ahead) {
+                    if (ahead->txn_id != req->txn_id && !compatible(req->mode, ahead->mode)) {
+                        edges.push_back(ahead->txn_id);
+                    }
+                }
+                if (queue->upgrading != NO_TXN && queue->upgrading != req->txn_id) {
+                    edges.push_back(queue->upgrading);
+                }
+                waiting_on[req->txn_id] = rid;
+            }
+        }
+    }
+
+    /* Depth-first search; each cycle found gives up its youngest member */
+    std::vector<txn_id_t> victims;
+    while (true) {
+        std::unordered_map<txn_id_t, int> state; /* 1 = on the stack, 2 = done */
+        std::vector<txn_id_t> stack;
+        std::vector<txn_id_t> cycle;
+        const std::function<bool(txn_id_t)> visit = [&](txn_id_t txn) {
+            state[txn] = 1;
+            stack.push_back(txn);
+            const auto edges = waits_for.find(txn);
+            if (edges != waits_for.end()) {
+                for (const txn_id_t next : edges->second) {
+                    if (state[next] == 1) {
+                        cycle.assign(std::find(stack.begin(), stack.end(), next), stack.end());
+                        return true;
+                    }
+                    if (state[next] == 0 && visit(next)) {
+                        return true;
+                    }
+                }
+            }
+            stack.pop_back();
+            state[txn] = 2;
+            return false;
+        };
+        for (const auto& [txn, edges] : waits_for) {
+            if (state[txn] == 0 && visit(txn)) {
+                break;
+            }
+        }
+        if (cycle.empty()) {
             break;
         }
+        const txn_id_t victim = *std::max_element(cycle.begin(), cycle.end());
+        victims.push_back(victim);
+        waits_for.erase(victim);
     }
 
-    if (found) {
-        queue.cv.notify_all();
+    for (const txn_id_t victim : victims) {
+        const lock_key_t rid = waiting_on[victim];
+        Partition& part = partition_for(rid);
+        const std::scoped_lock<std::mutex> part_lock(part.latch);
+        const auto it = part.queues.find(rid);
+        if (it == part.queues.end()) {
+            continue;
+        }
+        LockQueue& queue = *it->second;
+        const std::scoped_lock<std::mutex> lock(queue.latch);
+        /* Only wake it if it is still waiting there; otherwise the cycle is already gone */
+        for (auto& req : queue.request_queue) {
+            if (req.txn_id == victim && (!req.granted || queue.upgrading == victim)) {
+                req.victim = true;
+                static_cast<void>(deadlocks_.fetch_add(1, std::memory_order_relaxed));
+                queue.cv.notify_all();
+                break;
+            }
+        }
     }
-    return found;
 }
 
 }  // namespace cloudsql::transaction
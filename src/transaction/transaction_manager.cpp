@@ -6,17 +6,24 @@
 #include "transaction/transaction_manager.hpp"
 
 #include <algorithm>
+#include <condition_variable>
 #include <cstddef>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "catalog/catalog.hpp"
+#include "executor/index_build.hpp"
+#include "executor/table_handles.hpp"
 #include "executor/types.hpp"
 #include "recovery/log_manager.hpp"
 #include "recovery/log_record.hpp"
-#include "storage/btree_index.hpp"
 #include "storage/buffer_pool_manager.hpp"
 #include "storage/heap_table.hpp"
 #include "transaction/lock_manager.hpp"
@@ -32,19 +39,21 @@ TransactionManager::TransactionManager(LockManager& lock_manager, Catalog& catal
 Transaction* TransactionManager::begin(IsolationLevel level) {
     const std::scoped_lock<std::mutex> lock(manager_latch_);
     const txn_id_t txn_id = next_txn_id_++;
-    auto txn = std::make_unique<Transaction>(txn_id, level);
-
-    /* Capture Snapshot */
-    TransactionSnapshot snapshot;
-    snapshot.xmax = next_txn_id_.load();
-    snapshot.xmin = snapshot.xmax;
 
-    for (const auto& [id, _] : active_transactions_) {
-        snapshot.active_txns.insert(id);
-        snapshot.xmin = std::min(id, snapshot.xmin);
+    /* Hand finished segments of the commit log back once per segment of new ids */
+    if ((txn_id & (CommitLog::SEGMENT_SIZE - 1)) == 0 || !commit_log_.reserve(txn_id)) {
+        truncate_commit_log();
+        if (!commit_log_.reserve(txn_id)) {
+            throw std::runtime_error(
+                "Transaction " + std::to_string(txn_id) +
+                " cannot start: the commit log is full behind an old transaction");
+        }
     }
+    auto txn = std::make_unique<Transaction>(txn_id, level);
 
-    txn->set_snapshot(std::move(snapshot));
+    /* One load: the snapshot sees every commit numbered up to now. Taken under the
+       latch so vacuum_horizon() never misses a snapshot about to be registered */
+    txn->set_snapshot({commit_log_.snapshot(), &commit_log_});
 
     Transaction* const txn_ptr = txn.get();
     active_transactions_[txn_id] = std::move(txn);
@@ -53,6 +62,7 @@ Transaction* TransactionManager::begin(IsolationLevel level) {
         recovery::LogRecord record(txn_id, txn_ptr->get_prev_lsn(), recovery::LogRecordType::BEGIN);
         const recovery::lsn_t lsn = log_manager_->append_log_record(record);
         txn_ptr->set_prev_lsn(lsn);
+        txn_ptr->set_first_lsn(lsn);
     }
 
     return txn_ptr;
@@ -68,7 +78,10 @@ void TransactionManager::prepare(Transaction* txn) {
                                    recovery::LogRecordType::PREPARE);
         const recovery::lsn_t lsn = log_manager_->append_log_record(record);
         txn->set_prev_lsn(lsn);
-        log_manager_->flush(true);
+        if (!log_manager_->wait_durable(lsn)) {
+            std::cerr << "Prepare ERROR: WAL not durable for transaction " << txn->get_id()
+                      << "\n";
+        }
     }
 
     txn->set_state(TransactionState::PREPARED);
@@ -84,26 +97,43 @@ void TransactionManager::commit(Transaction* txn) {
                                    recovery::LogRecordType::COMMIT);
         const recovery::lsn_t lsn = log_manager_->append_log_record(record);
         txn->set_prev_lsn(lsn);
-        log_manager_->flush(true);
+        /* Durable before the locks go; commits waiting together share one flush */
+        if (!log_manager_->wait_durable(lsn)) {
+            std::cerr << "Commit ERROR: WAL not durable for transaction " << txn->get_id()
+                      << "\n";
+        }
     }
 
-    const auto lock_set = txn->get_shared_lock_set();
-    for (const auto& rid : lock_set) {
-        lock_manager_.unlock(txn, rid);
+    /* Visible to new snapshots before its locks let anyone else at its rows */
+    static_cast<void>(commit_log_.commit(txn->get_id()));
+
+    /* After it is visible, so a reader that sees the old data version cannot miss the change */
+    const std::string* changed = nullptr;
+    for (const auto& log : txn->get_undo_logs()) {
+        if (changed == nullptr || *changed != log.table_name) {
+            changed = &log.table_name;
+            catalog_.note_data_change(log.table_name);
+        }
     }
-    const auto ex_lock_set = txn->get_exclusive_lock_set();
-    for (const auto& rid : ex_lock_set) {
-        lock_manager_.unlock(txn, rid);
+
+    for (const lock_key_t key : txn->get_lock_set()) {
+        lock_manager_.unlock(txn, key);
     }
 
     txn->set_state(TransactionState::COMMITTED);
 
     {
         const std::scoped_lock<std::mutex> lock(manager_latch_);
+        for (const auto& log : txn->get_undo_logs()) {
+            if (log.type == UndoLog::Type::DELETE) {
+                dead_tuples_[log.table_name]++;
+            }
+        }
         auto it = active_transactions_.find(txn->get_id());
         if (it != active_transactions_.end()) {
             completed_transactions_.push_back(std::move(it->second));
             active_transactions_.erase(it);
+            txn_ended_.notify_all();
         }
 
         constexpr std::size_t MAX_COMPLETED = 100;
@@ -128,16 +158,14 @@ void TransactionManager::abort(Transaction* txn) {
                                    recovery::LogRecordType::ABORT);
         const recovery::lsn_t lsn = log_manager_->append_log_record(record);
         txn->set_prev_lsn(lsn);
-        log_manager_->flush(true);
+        /* Not waited on: without a commit record, recovery rolls the transaction back anyway */
     }
-
-    const auto lock_set = txn->get_shared_lock_set();
-    for (const auto& rid : lock_set) {
-        lock_manager_.unlock(txn, rid);
+    if (txn->get_state() != TransactionState::COMMITTED) {
+        commit_log_.abort(txn->get_id());
     }
-    const auto ex_lock_set = txn->get_exclusive_lock_set();
-    for (const auto& rid : ex_lock_set) {
-        lock_manager_.unlock(txn, rid);
+
+    for (const lock_key_t key : txn->get_lock_set()) {
+        lock_manager_.unlock(txn, key);
     }
 
     txn->set_state(TransactionState::ABORTED);
@@ -148,6 +176,7 @@ void TransactionManager::abort(Transaction* txn) {
         if (it != active_transactions_.end()) {
             completed_transactions_.push_back(std::move(it->second));
             active_transactions_.erase(it);
+            txn_ended_.notify_all();
         }
 
         constexpr std::size_t MAX_COMPLETED = 100;
@@ -163,6 +192,19 @@ bool TransactionManager::undo_transaction(Transaction* txn) {
     /* Undo in reverse order */
     for (auto it = logs.rbegin(); it != logs.rend(); ++it) {
         const auto& log = *it;
+        /* A CLR per undone change, so recovery after a crash mid-rollback resumes past it */
+        const recovery::lsn_t undo_next = std::next(it) != logs.rend() ? std::next(it)->lsn : -1;
+        const auto compensate = [&](storage::HeapTable& table, recovery::LogRecordType undone,
+                                    const storage::HeapTable::TupleId& rid) {
+            if (log_manager_ == nullptr || log.lsn < 0) {
+                return;
+            }
+            recovery::LogRecord clr(txn->get_id(), txn->get_prev_lsn(), undone, log.table_name,
+                                    {rid}, undo_next);
+            const recovery::lsn_t lsn = log_manager_->append_log_record(clr);
+            txn->set_prev_lsn(lsn);
+            static_cast<void>(table.set_page_lsn(rid.page_num, lsn));
+        };
         auto table_meta_opt = catalog_.get_table_by_name(log.table_name);
         if (!table_meta_opt) {
             std::cerr << "Rollback ERROR: Table metadata not found for '" << log.table_name
@@ -189,8 +231,8 @@ bool TransactionManager::undo_transaction(Transaction* txn) {
                         if (!idx_info.column_positions.empty()) {
                             uint16_t pos = idx_info.column_positions[0];
                             common::ValueType ktype = table_meta->columns[pos].type;
-                            storage::BTreeIndex index(idx_info.name, bpm_, ktype);
-                            if (!index.remove(tuple.get(pos), log.rid)) {
+                            const auto index = executor::open_index(idx_info, ktype, bpm_);
+                            if (!index->remove(tuple.get(pos), log.rid)) {
                                 std::cerr << "Rollback ERROR: Index remove failed for table '"
                                           << log.table_name << "', index '" << idx_info.name
                                           << "'\n";
@@ -202,7 +244,11 @@ bool TransactionManager::undo_transaction(Transaction* txn) {
                 if (!table.physical_remove(log.rid)) {
                     std::cerr << "Rollback ERROR: physical_remove failed for INSERT undo\n";
                     success = false;
+                } else if (!tuple.empty()) {
+                    executor::ConcurrentIndexBuild::record_remove(bpm_, log.table_name, log.rid,
+                                                                  tuple);
                 }
+                compensate(table, recovery::LogRecordType::INSERT, log.rid);
                 break;
             }
             case UndoLog::Type::DELETE: {
@@ -213,12 +259,14 @@ bool TransactionManager::undo_transaction(Transaction* txn) {
                 } else {
                     executor::Tuple tuple;
                     if (table.get(log.rid, tuple)) {
+                        executor::ConcurrentIndexBuild::record_insert(bpm_, log.table_name,
+                                                                      log.rid, tuple);
                         for (const auto& idx_info : table_meta->indexes) {
                             if (!idx_info.column_positions.empty()) {
                                 uint16_t pos = idx_info.column_positions[0];
                                 common::ValueType ktype = table_meta->columns[pos].type;
-                                storage::BTreeIndex index(idx_info.name, bpm_, ktype);
-                                if (!index.insert(tuple.get(pos), log.rid)) {
+                                const auto index = executor::open_index(idx_info, ktype, bpm_);
+                                if (!index->insert(tuple.get(pos), log.rid)) {
                                     std::cerr << "Rollback ERROR: Index insert failed for table '"
                                               << log.table_name << "', index '" << idx_info.name
                                               << "'\n";
@@ -228,6 +276,7 @@ bool TransactionManager::undo_transaction(Transaction* txn) {
                         }
                     }
                 }
+                compensate(table, recovery::LogRecordType::MARK_DELETE, log.rid);
                 break;
             }
             case UndoLog::Type::UPDATE: {
@@ -239,8 +288,8 @@ bool TransactionManager::undo_transaction(Transaction* txn) {
                         if (!idx_info.column_positions.empty()) {
                             uint16_t pos = idx_info.column_positions[0];
                             common::ValueType ktype = table_meta->columns[pos].type;
-                            storage::BTreeIndex index(idx_info.name, bpm_, ktype);
-                            if (!index.remove(new_tuple.get(pos), log.rid)) {
+                            const auto index = executor::open_index(idx_info, ktype, bpm_);
+                            if (!index->remove(new_tuple.get(pos), log.rid)) {
                                 std::cerr << "Rollback ERROR: Index remove failed for table '"
                                           << log.table_name << "', index '" << idx_info.name
                                           << "'\n";
@@ -253,7 +302,11 @@ bool TransactionManager::undo_transaction(Transaction* txn) {
                     std::cerr << "Rollback ERROR: physical_remove failed for new version in UPDATE "
                                  "undo\n";
                     success = false;
+                } else if (!new_tuple.empty()) {
+                    executor::ConcurrentIndexBuild::record_remove(bpm_, log.table_name, log.rid,
+                                                                  new_tuple);
                 }
+                compensate(table, recovery::LogRecordType::INSERT, log.rid);
 
                 if (log.old_rid.has_value()) {
                     if (!table.undo_remove(log.old_rid.value())) {
@@ -263,12 +316,14 @@ bool TransactionManager::undo_transaction(Transaction* txn) {
                     } else {
                         executor::Tuple old_tuple;
                         if (table.get(log.old_rid.value(), old_tuple)) {
+                            executor::ConcurrentIndexBuild::record_insert(
+                                bpm_, log.table_name, log.old_rid.value(), old_tuple);
                             for (const auto& idx_info : table_meta->indexes) {
                                 if (!idx_info.column_positions.empty()) {
                                     uint16_t pos = idx_info.column_positions[0];
                                     common::ValueType ktype = table_meta->columns[pos].type;
-                                    storage::BTreeIndex index(idx_info.name, bpm_, ktype);
-                                    if (!index.insert(old_tuple.get(pos), log.old_rid.value())) {
+                                    const auto index = executor::open_index(idx_info, ktype, bpm_);
+                                    if (!index->insert(old_tuple.get(pos), log.old_rid.value())) {
                                         std::cerr
                                             << "Rollback ERROR: Index insert failed for table '"
                                             << log.table_name << "', index '" << idx_info.name
@@ -279,6 +334,7 @@ bool TransactionManager::undo_transaction(Transaction* txn) {
                             }
                         }
                     }
+                    compensate(table, recovery::LogRecordType::MARK_DELETE, log.old_rid.value());
                 }
                 break;
             }
@@ -295,4 +351,134 @@ Transaction* TransactionManager::get_transaction(txn_id_t txn_id) {
     return nullptr;
 }
 
+void TransactionManager::set_next_txn_id(txn_id_t txn_id) {
+    const std::scoped_lock<std::mutex> lock(manager_latch_);
+    if (txn_id > next_txn_id_.load()) {
+        next_txn_id_.store(txn_id);
+        /* Prepared transactions restored from the log stay in doubt, not committed */
+        std::vector<txn_id_t> in_doubt;
+        for (const auto& [id, txn] : active_transactions_) {
+            if (id < txn_id) {
+                in_doubt.push_back(id);
+            }
+        }
+        commit_log_.set_frozen_below(txn_id, in_doubt);
+    }
+}
+
+Transaction* TransactionManager::restore_prepared(const recovery::CheckpointTxn& prepared,
+                                                  const std::vector<recovery::LogRecord>& changes) {
+    auto txn = std::make_unique<Transaction>(prepared.txn_id);
+    txn->set_first_lsn(prepared.first_lsn);
+    bool locked = true;
+    for (const auto& record : changes) {
+        std::vector<storage::HeapTable::TupleId> rids = record.rids_;
+        if (rids.empty()) {
+            rids.push_back(record.rid_);
+        }
+        const UndoLog::Type type = record.type_ == recovery::LogRecordType::MARK_DELETE
+                                       ? UndoLog::Type::DELETE
+                                       : UndoLog::Type::INSERT;
+        const size_t first = txn->undo_log_count();
+        for (const auto& rid : rids) {
+            txn->add_undo_log(type, record.table_name_, rid);
+        }
+        txn->set_undo_lsn(first, txn->undo_log_count(), record.lsn_);
+
+        const auto table = catalog_.get_table_by_name(record.table_name_);
+        if (table.has_value() && !lock_manager_.lock_rows(txn.get(), (*table)->table_id, rids,
+                                                          LockMode::EXCLUSIVE)) {
+            locked = false;
+        }
+    }
+    txn->set_prev_lsn(prepared.last_lsn);
+    txn->set_state(TransactionState::PREPARED);
+    if (!locked) {
+        std::cerr << "Recovery ERROR: row locks of prepared transaction " << prepared.txn_id
+                  << " are held by another transaction\n";
+        for (const lock_key_t key : txn->get_lock_set()) {
+            lock_manager_.unlock(txn.get(), key);
+        }
+        return nullptr;
+    }
+
+    const std::scoped_lock<std::mutex> lock(manager_latch_);
+    static_cast<void>(commit_log_.reserve(prepared.txn_id));
+    txn->set_snapshot({commit_log_.snapshot(), &commit_log_});
+    Transaction* const txn_ptr = txn.get();
+    active_transactions_[prepared.txn_id] = std::move(txn);
+    return txn_ptr;
+}
+
+void TransactionManager::truncate_commit_log() {
+    txn_id_t oldest = next_txn_id_.load();
+    csn_t horizon = commit_log_.snapshot();
+    for (const auto& [id, txn] : active_transactions_) {
+        oldest = std::min(oldest, id);
+        horizon = std::min(horizon, txn->get_snapshot().csn);
+    }
+    commit_log_.truncate(oldest, horizon);
+}
+
+csn_t TransactionManager::vacuum_horizon() {
+    const std::scoped_lock<std::mutex> lock(manager_latch_);
+    csn_t horizon = commit_log_.snapshot();
+    for (const auto& [id, txn] : active_transactions_) {
+        horizon = std::min(horizon, txn->get_snapshot().csn);
+    }
+    return horizon;
+}
+
+std::unordered_map<std::string, uint64_t> TransactionManager::dead_tuple_counts() {
+    const std::scoped_lock<std::mutex> lock(manager_latch_);
+    return dead_tuples_;
+}
+
+void TransactionManager::clear_dead_tuples(const std::string& table, uint64_t count) {
+    const std::scoped_lock<std::mutex> lock(manager_latch_);
+    auto it = dead_tuples_.find(table);
+    if (it == dead_tuples_.end()) {
+        return;
+    }
+    if (it->second <= count) {
+        dead_tuples_.erase(it);
+    } else {
+        it->second -= count;
+    }
+}
+
+std::mutex& TransactionManager::vacuum_latch(const std::string& table) {
+    const std::scoped_lock<std::mutex> lock(manager_latch_);
+    auto& latch = vacuum_latches_[table];
+    if (!latch) {
+        latch = std::make_unique<std::mutex>();
+    }
+    return *latch;
+}
+
+void TransactionManager::wait_for_running() {
+    std::unique_lock<std::mutex> lock(manager_latch_);
+    /* Ids are handed out under the latch, so every transaction below this one is registered */
+    const txn_id_t horizon = next_txn_id_.load();
+    txn_ended_.wait(lock, [this, horizon] {
+        return std::none_of(active_transactions_.begin(), active_transactions_.end(),
+                            [horizon](const auto& entry) { return entry.first < horizon; });
+    });
+}
+
+std::vector<recovery::CheckpointTxn> TransactionManager::checkpoint_txns() {
+    const std::scoped_lock<std::mutex> lock(manager_latch_);
+    std::vector<recovery::CheckpointTxn> txns;
+    txns.reserve(active_transactions_.size());
+    for (const auto& [id, txn] : active_transactions_) {
+        const recovery::lsn_t first = txn->get_first_lsn();
+        if (first < 0) {
+            continue; /* Began before WAL was enabled, or never logged */
+        }
+        txns.push_back({id, first, txn->get_prev_lsn(),
+                        txn->get_state() == TransactionState::PREPARED});
+    }
+    return txns;
+}
+
 }  // namespace cloudsql::transaction
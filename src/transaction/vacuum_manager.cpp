@@ -0,0 +1,151 @@
+/**
+ * @file vacuum_manager.cpp
+ * @brief Vacuum and the autovacuum worker
+ */
+
+#include "transaction/vacuum_manager.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "catalog/catalog.hpp"
+#include "executor/table_handles.hpp"
+#include "executor/types.hpp"
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/heap_table.hpp"
+#include "transaction/commit_log.hpp"
+#include "transaction/transaction_manager.hpp"
+
+namespace cloudsql::transaction {
+
+VacuumManager::VacuumManager(Catalog& catalog, storage::BufferPoolManager& bpm,
+                             TransactionManager& transaction_manager)
+    : catalog_(catalog), bpm_(bpm), transaction_manager_(transaction_manager) {}
+
+VacuumManager::~VacuumManager() { stop(); }
+
+VacuumStats VacuumManager::vacuum_table(const TableInfo& table) {
+    return vacuum_table(table, nullptr);
+}
+
+VacuumStats VacuumManager::vacuum_all() {
+    VacuumStats total;
+    for (const auto* table : catalog_.get_all_tables()) {
+        const VacuumStats stats = vacuum_table(*table, nullptr);
+        total.pages_scanned += stats.pages_scanned;
+        total.tuples_removed += stats.tuples_removed;
+    }
+    return total;
+}
+
+VacuumStats VacuumManager::vacuum_table(const TableInfo& table, const Options* throttle) {
+    /* A second vacuum could free a slot this one found dead and an insert reuse it */
+    const std::scoped_lock<std::mutex> table_lock(transaction_manager_.vacuum_latch(table.name));
+
+    executor::Schema schema;
+    for (const auto& col : table.columns) {
+        schema.add_column(col.name, col.type);
+    }
+    storage::HeapTable heap(table.name, bpm_, schema);
+
+    std::vector<executor::IndexHandle> indexes;
+    for (const auto& idx_info : table.indexes) {
+        if (!idx_info.column_positions.empty()) {
+            const uint16_t pos = idx_info.column_positions[0];
+            indexes.push_back(
+                {executor::open_index(idx_info, table.columns[pos].type, bpm_), pos});
+        }
+    }
+
+    /* DELETE and UPDATE drop their index entries eagerly; this catches any left behind */
+    const auto drop_entries = [&indexes](const storage::HeapTable::TupleId& tid,
+                                         const executor::Tuple& tuple) {
+        for (auto& idx : indexes) {
+            if (idx.column < tuple.size()) {
+                static_cast<void>(idx.index->remove(tuple.get(idx.column), tid));
+            }
+        }
+    };
+
+    /* Deleted by a transaction the oldest running snapshot already sees committed */
+    const csn_t horizon = transaction_manager_.vacuum_horizon();
+    const CommitLog& commit_log = transaction_manager_.commit_log();
+    const auto is_dead = [&commit_log, horizon](uint64_t xmax) {
+        return commit_log.is_visible(xmax, horizon);
+    };
+
+    VacuumStats stats;
+    size_t since_pause = 0;
+    size_t removed = 0;
+    for (uint32_t page = 0; heap.vacuum_page(page, is_dead, drop_entries, &removed); ++page) {
+        stats.pages_scanned++;
+        stats.tuples_removed += removed;
+
+        if (throttle != nullptr && throttle->cost_delay.count() > 0 &&
+            ++since_pause >= throttle->cost_limit) {
+            since_pause = 0;
+            std::unique_lock<std::mutex> lock(worker_latch_);
+            if (worker_cv_.wait_for(lock, throttle->cost_delay, [this] { return worker_stop_; })) {
+                break;
+            }
+        }
+    }
+
+    transaction_manager_.clear_dead_tuples(table.name, stats.tuples_removed);
+    return stats;
+}
+
+void VacuumManager::start(const Options& options) {
+    const std::scoped_lock<std::mutex> lock(worker_latch_);
+    if (worker_.joinable()) {
+        return;
+    }
+    options_ = options;
+    worker_stop_ = false;
+    worker_ = std::thread(&VacuumManager::run, this);
+}
+
+void VacuumManager::stop() {
+    {
+        const std::scoped_lock<std::mutex> lock(worker_latch_);
+        if (!worker_.joinable()) {
+            return;
+        }
+        worker_stop_ = true;
+    }
+    worker_cv_.notify_all();
+    worker_.join();
+}
+
+void VacuumManager::run() {
+    std::unique_lock<std::mutex> lock(worker_latch_);
+    while (!worker_cv_.wait_for(lock, options_.naptime, [this] { return worker_stop_; })) {
+        lock.unlock();
+        for (const auto& [name, dead] : transaction_manager_.dead_tuple_counts()) {
+            if (dead < options_.threshold) {
+                continue;
+            }
+            auto table = catalog_.get_table_by_name(name);
+            if (!table.has_value()) {
+                transaction_manager_.clear_dead_tuples(name, dead); /* Dropped since */
+                continue;
+            }
+            /* A copy, as DDL may change the catalog entry while the table is vacuumed */
+            const TableInfo info = *table.value();
+            static_cast<void>(vacuum_table(info, &options_));
+            autovacuum_runs_.fetch_add(1, std::memory_order_relaxed);
+
+            const std::scoped_lock<std::mutex> stop_lock(worker_latch_);
+            if (worker_stop_) {
+                break;
+            }
+        }
+        lock.lock();
+    }
+}
+
+}  // namespace cloudsql::transaction
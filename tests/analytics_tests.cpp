@@ -5,13 +5,33 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "common/config.hpp"
+#include "executor/morsel_scheduler.hpp"
+#include "executor/thread_pool.hpp"
+#include "executor/vector_kernels.hpp"
 #include "executor/vectorized_operator.hpp"
 #include "parser/expression.hpp"
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/column_encoding.hpp"
 #include "storage/columnar_table.hpp"
+#include "storage/delta_compactor.hpp"
+#include "storage/heap_table.hpp"
 #include "storage/storage_manager.hpp"
+#include "transaction/transaction.hpp"
 
 using namespace cloudsql;
 using namespace cloudsql::storage;
@@ -255,4 +275,1568 @@ TEST(AnalyticsTests, VectorizedExpressionAdvanced) {
     EXPECT_TRUE(res.get(2).as_bool());
 }
 
+TEST(AnalyticsTests, ColumnEncodingsRoundTrip) {
+    constexpr size_t N = 1000;
+    std::vector<int64_t> sorted(N);
+    std::vector<int64_t> runs(N);
+    std::vector<int64_t> narrow(N);
+    std::vector<int64_t> wide(N);
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < N; ++i) {
+        sorted[i] = 1700000000000LL + static_cast<int64_t>(i) * 1000 + static_cast<int64_t>(i % 7);
+        runs[i] = static_cast<int64_t>(i / 100);
+        narrow[i] = -50 + static_cast<int64_t>((i * 37) % 101);
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        wide[i] = static_cast<int64_t>(seed);
+    }
+
+    const std::pair<const std::vector<int64_t>*, ColumnEncoding> cases[] = {
+        {&sorted, ColumnEncoding::Delta},
+        {&runs, ColumnEncoding::Rle},
+        {&narrow, ColumnEncoding::BitPacked},
+        {&wide, ColumnEncoding::Plain}};
+    for (const auto& [values, expected] : cases) {
+        std::string encoded;
+        EXPECT_EQ(encode_int_chunk(values->data(), N, &encoded), expected)
+            << column_encoding_name(expected);
+
+        /* Decode an unaligned window as well as the whole chunk */
+        std::vector<int64_t> decoded(N);
+        ASSERT_TRUE(decode_int_chunk(expected, encoded.data(), encoded.size(), N, 0, N,
+                                     decoded.data()));
+        EXPECT_EQ(decoded, *values);
+        ASSERT_TRUE(decode_int_chunk(expected, encoded.data(), encoded.size(), N, 333, 101,
+                                     decoded.data()));
+        EXPECT_TRUE(std::equal(decoded.begin(), decoded.begin() + 101, values->begin() + 333));
+    }
+
+    std::vector<std::string> cities(N);
+    const char* const names[] = {"berlin", "lisbon", "osaka", "quito"};
+    for (size_t i = 0; i < N; ++i) {
+        cities[i] = names[(i * 3) % 4];
+    }
+    std::string encoded;
+    ASSERT_EQ(encode_string_chunk(cities.data(), N, &encoded), ColumnEncoding::Dictionary);
+    EXPECT_LT(encoded.size(), N / 2);
+    std::vector<std::string> decoded(10);
+    ASSERT_TRUE(decode_string_chunk(ColumnEncoding::Dictionary, encoded.data(), encoded.size(), N,
+                                    500, 10, decoded.data()));
+    EXPECT_TRUE(std::equal(decoded.begin(), decoded.end(), cities.begin() + 500));
+
+    /* Distinct strings stay plain */
+    std::vector<std::string> ids(N);
+    for (size_t i = 0; i < N; ++i) {
+        ids[i] = "id-" + std::to_string(i);
+    }
+    encoded.clear();
+    ASSERT_EQ(encode_string_chunk(ids.data(), N, &encoded), ColumnEncoding::Plain);
+    ASSERT_TRUE(decode_string_chunk(ColumnEncoding::Plain, encoded.data(), encoded.size(), N, 990,
+                                    10, decoded.data()));
+    EXPECT_EQ(decoded[9], "id-999");
+}
+
+TEST(AnalyticsTests, CompressedColumnarTable) {
+    StorageManager storage("./test_analytics");
+    Schema schema;
+    schema.add_column("ts", common::ValueType::TYPE_INT64);
+    schema.add_column("region", common::ValueType::TYPE_TEXT, true);
+    schema.add_column("price", common::ValueType::TYPE_FLOAT64);
+    schema.add_column("flag", common::ValueType::TYPE_BOOL);
+
+    ColumnarTable table("compressed_test", storage, schema);
+    ASSERT_TRUE(table.create());
+    ASSERT_TRUE(table.open());
+
+    /* Several appends so batches straddle chunk boundaries */
+    constexpr int64_t ROWS = 20000;
+    const char* const regions[] = {"us-east", "us-west", "eu-central", "ap-south"};
+    for (int64_t base = 0; base < ROWS; base += 5000) {
+        auto batch = VectorBatch::create(schema);
+        for (int64_t i = base; i < base + 5000; ++i) {
+            std::vector<common::Value> row;
+            row.push_back(common::Value::make_int64(1700000000000LL + i * 1000));
+            row.push_back(i % 11 == 0 ? common::Value::make_null()
+                                      : common::Value::make_text(regions[(i / 64) % 4]));
+            row.push_back(common::Value::make_float64(static_cast<double>(i % 50) * 0.25));
+            row.push_back(common::Value::make_bool(i % 3 == 0));
+            batch->append_tuple(Tuple(std::move(row)));
+        }
+        ASSERT_TRUE(table.append_batch(*batch));
+    }
+    EXPECT_EQ(table.chunks(0).front().header.encoding, ColumnEncoding::Delta);
+    EXPECT_EQ(table.chunks(1).front().header.encoding, ColumnEncoding::Dictionary);
+
+    /* Encoded timestamps and strings take a fraction of their plain size */
+    const auto ts_bytes =
+        std::filesystem::file_size(storage.get_full_path("compressed_test.col0.data.bin"));
+    const auto region_bytes =
+        std::filesystem::file_size(storage.get_full_path("compressed_test.col1.data.bin"));
+    EXPECT_LT(ts_bytes * 4, static_cast<uintmax_t>(ROWS * 8));
+    EXPECT_LT(region_bytes * 4, static_cast<uintmax_t>(ROWS * 8));
+
+    /* A fresh handle rebuilds the chunk directory from the files */
+    ColumnarTable reopened("compressed_test", storage, schema);
+    ASSERT_TRUE(reopened.open());
+    ASSERT_EQ(reopened.row_count(), static_cast<uint64_t>(ROWS));
+
+    auto out = VectorBatch::create(schema);
+    int64_t row = 0;
+    while (reopened.read_batch(static_cast<uint64_t>(row), 1000, *out)) {
+        for (size_t r = 0; r < out->row_count(); ++r, ++row) {
+            ASSERT_EQ(out->get_column(0).get(r).to_int64(), 1700000000000LL + row * 1000);
+            if (row % 11 == 0) {
+                ASSERT_TRUE(out->get_column(1).is_null(r));
+            } else {
+                ASSERT_EQ(out->get_column(1).get(r).to_string(), regions[(row / 64) % 4]);
+            }
+            ASSERT_DOUBLE_EQ(out->get_column(2).get(r).to_float64(),
+                             static_cast<double>(row % 50) * 0.25);
+            ASSERT_EQ(out->get_column(3).get(r).as_bool(), row % 3 == 0);
+        }
+    }
+    EXPECT_EQ(row, ROWS);
+}
+
+TEST(AnalyticsTests, MappedZeroCopyReads) {
+    StorageManager storage("./test_analytics");
+    Schema schema;
+    schema.add_column("id", common::ValueType::TYPE_INT64);
+    schema.add_column("noise", common::ValueType::TYPE_FLOAT64, true);
+
+    auto table = std::make_shared<ColumnarTable>("mapped_test", storage, schema);
+    ASSERT_TRUE(table->create());
+    ASSERT_TRUE(table->open());
+
+    /* Pseudo-random values defeat every encoding, so both columns stay plain */
+    constexpr int64_t ROWS = 2 * ColumnarTable::CHUNK_ROWS;
+    const auto id_at = [](int64_t i) {
+        uint64_t z = static_cast<uint64_t>(i) + 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27U)) * 0x94D049BB133111EBULL;
+        return static_cast<int64_t>(z ^ (z >> 31U));
+    };
+    auto batch = VectorBatch::create(schema);
+    for (int64_t i = 0; i < ROWS; ++i) {
+        batch->append_tuple(Tuple({common::Value::make_int64(id_at(i)),
+                                   i % 5 == 0 ? common::Value::make_null()
+                                              : common::Value::make_float64(
+                                                    static_cast<double>(id_at(i)) / 3.0)}));
+    }
+    ASSERT_TRUE(table->append_batch(*batch));
+    ASSERT_EQ(table->chunks(0).front().header.encoding, ColumnEncoding::Plain);
+
+    /* A batch inside one chunk borrows the mapping, NULLs included */
+    auto out = VectorBatch::create(schema);
+    ASSERT_TRUE(table->read_batch(1024, 1024, *out));
+    auto& ids = dynamic_cast<NumericVector<int64_t>&>(out->get_column(0));
+    auto& noise = dynamic_cast<NumericVector<double>&>(out->get_column(1));
+    EXPECT_TRUE(ids.is_view());
+    EXPECT_TRUE(noise.is_view());
+    for (size_t r = 0; r < out->row_count(); ++r) {
+        const auto row = static_cast<int64_t>(1024 + r);
+        ASSERT_EQ(ids.get(r).to_int64(), id_at(row));
+        ASSERT_EQ(noise.is_null(r), row % 5 == 0);
+    }
+
+    /* Views survive a remap triggered by an append and copy on first write */
+    ASSERT_TRUE(table->append_batch(*batch));
+    EXPECT_EQ(ids.get(7).to_int64(), id_at(1031));
+    ids.set(0, -1);
+    EXPECT_FALSE(ids.is_view());
+    EXPECT_EQ(ids.get(1).to_int64(), id_at(1025));
+
+    /* A batch straddling two chunks is copied */
+    auto straddle = VectorBatch::create(schema);
+    ASSERT_TRUE(table->read_batch(ColumnarTable::CHUNK_ROWS - 10, 20, *straddle));
+    EXPECT_FALSE(dynamic_cast<NumericVector<int64_t>&>(straddle->get_column(0)).is_view());
+    EXPECT_EQ(straddle->get_column(0).get(15).to_int64(), id_at(ColumnarTable::CHUNK_ROWS + 5));
+
+    ASSERT_TRUE(table->read_batch(ROWS + 100, 10, *straddle));
+    EXPECT_EQ(straddle->get_column(0).get(0).to_int64(), id_at(100));
+}
+
+TEST(AnalyticsTests, ZoneMapPredicatePushdown) {
+    StorageManager storage("./test_analytics");
+    Schema schema;
+    schema.add_column("ts", common::ValueType::TYPE_INT64);
+    schema.add_column("price", common::ValueType::TYPE_FLOAT64, true);
+
+    auto table = std::make_shared<ColumnarTable>("zone_map_test", storage, schema);
+    ASSERT_TRUE(table->create());
+    ASSERT_TRUE(table->open());
+
+    /* Sorted timestamps; price is NULL for the whole first chunk */
+    constexpr int64_t ROWS = 20000;
+    auto batch = VectorBatch::create(schema);
+    for (int64_t i = 0; i < ROWS; ++i) {
+        std::vector<common::Value> row;
+        row.push_back(common::Value::make_int64(i));
+        row.push_back(i < ColumnarTable::CHUNK_ROWS
+                          ? common::Value::make_null()
+                          : common::Value::make_float64(static_cast<double>(i) * 0.5));
+        batch->append_tuple(Tuple(std::move(row)));
+    }
+    ASSERT_TRUE(table->append_batch(*batch));
+    ASSERT_EQ(table->chunk_count(), 5U);
+    EXPECT_EQ(table->chunks(0)[1].zone.min, ColumnarTable::CHUNK_ROWS);
+    EXPECT_EQ(table->chunks(0)[1].zone.max, 2 * ColumnarTable::CHUNK_ROWS - 1);
+    EXPECT_EQ(table->chunks(1)[0].zone.null_count, ColumnarTable::CHUNK_ROWS);
+
+    const auto run = [&schema](const std::shared_ptr<ColumnarTable>& source,
+                               std::unique_ptr<Expression> condition, ScanStats* stats) {
+        auto scan = std::make_unique<VectorizedSeqScanOperator>("zone_map_test", source);
+        VectorizedFilterOperator filter(std::move(scan), std::move(condition));
+        auto out = VectorBatch::create(schema);
+        int64_t rows = 0;
+        while (filter.next_batch(*out)) {
+            rows += static_cast<int64_t>(out->row_count());
+            out->clear();
+        }
+        filter.collect_scan_stats(*stats);
+        return rows;
+    };
+
+    /* ts > 15000 AND price IS NOT NULL: only the last two chunks can match */
+    auto cond = std::make_unique<BinaryExpr>(
+        std::make_unique<BinaryExpr>(std::make_unique<ColumnExpr>("ts"), TokenType::Gt,
+                                     std::make_unique<ConstantExpr>(
+                                         common::Value::make_int64(15000))),
+        TokenType::And,
+        std::make_unique<IsNullExpr>(std::make_unique<ColumnExpr>("price"), true));
+    ScanStats stats;
+    EXPECT_EQ(run(table, std::move(cond), &stats), ROWS - 15001);
+    EXPECT_EQ(stats.chunks_scanned, 2U);
+    EXPECT_EQ(stats.chunks_skipped, 3U);
+
+    /* Zone maps survive a reopen; constant-first comparisons are flipped */
+    auto reopened = std::make_shared<ColumnarTable>("zone_map_test", storage, schema);
+    ASSERT_TRUE(reopened->open());
+    ASSERT_TRUE(reopened->chunks(1)[2].zone.known);
+
+    stats = ScanStats{};
+    cond = std::make_unique<BinaryExpr>(
+        std::make_unique<ConstantExpr>(common::Value::make_int64(100)), TokenType::Ge,
+        std::make_unique<ColumnExpr>("ts"));
+    EXPECT_EQ(run(reopened, std::move(cond), &stats), 101);
+    EXPECT_EQ(stats.chunks_scanned, 1U);
+    EXPECT_EQ(stats.chunks_skipped, 4U);
+
+    /* Double bounds: price < 2100.0 only holds in the second chunk */
+    stats = ScanStats{};
+    cond = std::make_unique<BinaryExpr>(
+        std::make_unique<ColumnExpr>("price"), TokenType::Lt,
+        std::make_unique<ConstantExpr>(common::Value::make_float64(2100.0)));
+    EXPECT_EQ(run(reopened, std::move(cond), &stats), 4200 - ColumnarTable::CHUNK_ROWS);
+    EXPECT_EQ(stats.chunks_scanned, 1U);
+    EXPECT_EQ(stats.chunks_skipped, 4U);
+
+    /* No pushdown possible: every chunk is read */
+    stats = ScanStats{};
+    cond = std::make_unique<BinaryExpr>(
+        std::make_unique<BinaryExpr>(std::make_unique<ColumnExpr>("ts"), TokenType::Plus,
+                                     std::make_unique<ConstantExpr>(common::Value::make_int64(1))),
+        TokenType::Gt, std::make_unique<ConstantExpr>(common::Value::make_int64(ROWS - 10)));
+    EXPECT_EQ(run(reopened, std::move(cond), &stats), 10);
+    EXPECT_EQ(stats.chunks_scanned, 5U);
+    EXPECT_EQ(stats.chunks_skipped, 0U);
+}
+
+TEST(AnalyticsTests, SelectionVectorPipeline) {
+    StorageManager storage("./test_analytics");
+    Schema schema;
+    schema.add_column("id", common::ValueType::TYPE_INT64);
+    schema.add_column("name", common::ValueType::TYPE_TEXT, true);
+    schema.add_column("score", common::ValueType::TYPE_FLOAT64);
+
+    auto table = std::make_shared<ColumnarTable>("selection_test", storage, schema);
+    ASSERT_TRUE(table->create());
+    ASSERT_TRUE(table->open());
+
+    constexpr int64_t ROWS = 3000;
+    auto input_batch = VectorBatch::create(schema);
+    for (int64_t i = 0; i < ROWS; ++i) {
+        std::vector<common::Value> row;
+        row.push_back(common::Value::make_int64(i));
+        row.push_back(i % 7 == 0 ? common::Value::make_null()
+                                 : common::Value::make_text("n" + std::to_string(i)));
+        row.push_back(common::Value::make_float64(static_cast<double>(i) * 0.5));
+        input_batch->append_tuple(Tuple(std::move(row)));
+    }
+    ASSERT_TRUE(table->append_batch(*input_batch));
+
+    const auto keep = [](int64_t i) { return i >= 1000 && i % 7 != 0; };
+    const auto make_filters = [&table]() -> std::unique_ptr<VectorizedOperator> {
+        auto scan = std::make_unique<VectorizedSeqScanOperator>("selection_test", table);
+        auto by_id = std::make_unique<VectorizedFilterOperator>(
+            std::move(scan),
+            std::make_unique<BinaryExpr>(
+                std::make_unique<ColumnExpr>("id"), TokenType::Ge,
+                std::make_unique<ConstantExpr>(common::Value::make_int64(1000))));
+        return std::make_unique<VectorizedFilterOperator>(
+            std::move(by_id),
+            std::make_unique<IsNullExpr>(std::make_unique<ColumnExpr>("name"), true));
+    };
+
+    /* Stacked filters only narrow the selection; the scanned rows stay in place */
+    {
+        auto filters = make_filters();
+        auto batch = VectorBatch::create(schema);
+        int64_t live = 0;
+        while (filters->next_selected_batch(*batch)) {
+            ASSERT_TRUE(batch->has_selection());
+            EXPECT_EQ(batch->selected_count(), batch->selection().size());
+            EXPECT_GT(batch->row_count(), batch->selected_count());
+            batch->for_each_selected([&](size_t r) {
+                const int64_t id = batch->get_column(0).get(r).to_int64();
+                EXPECT_TRUE(keep(id));
+                ++live;
+            });
+        }
+        int64_t expected = 0;
+        for (int64_t i = 0; i < ROWS; ++i) expected += keep(i) ? 1 : 0;
+        EXPECT_EQ(live, expected);
+    }
+
+    /* Project materializes once, at the boundary */
+    {
+        std::vector<std::unique_ptr<Expression>> exprs;
+        exprs.push_back(std::make_unique<ColumnExpr>("name"));
+        exprs.push_back(std::make_unique<ColumnExpr>("id"));
+        Schema out_schema;
+        out_schema.add_column("name", common::ValueType::TYPE_TEXT);
+        out_schema.add_column("id", common::ValueType::TYPE_INT64);
+        VectorizedProjectOperator project(make_filters(), std::move(out_schema),
+                                          std::move(exprs));
+
+        auto out = VectorBatch::create(project.output_schema());
+        int64_t next = 1000;
+        while (project.next_batch(*out)) {
+            EXPECT_FALSE(out->has_selection());
+            for (size_t r = 0; r < out->row_count(); ++r) {
+                while (!keep(next)) ++next;
+                ASSERT_EQ(out->get_column(1).get(r).to_int64(), next);
+                ASSERT_EQ(out->get_column(0).get(r).to_string(), "n" + std::to_string(next));
+                ++next;
+            }
+        }
+        EXPECT_EQ(next, ROWS);
+    }
+
+    /* Aggregates consume the selection directly */
+    {
+        Schema out_schema;
+        out_schema.add_column("count", common::ValueType::TYPE_INT64);
+        out_schema.add_column("sum_score", common::ValueType::TYPE_FLOAT64);
+        VectorizedAggregateOperator agg(make_filters(), std::move(out_schema),
+                                        {{AggregateType::Count, -1}, {AggregateType::Sum, 2}});
+        auto out = VectorBatch::create(agg.output_schema());
+        ASSERT_TRUE(agg.next_batch(*out));
+
+        int64_t count = 0;
+        double sum = 0;
+        for (int64_t i = 0; i < ROWS; ++i) {
+            if (keep(i)) {
+                ++count;
+                sum += static_cast<double>(i) * 0.5;
+            }
+        }
+        EXPECT_EQ(out->get_column(0).get(0).as_int64(), count);
+        EXPECT_DOUBLE_EQ(out->get_column(1).get(0).to_float64(), sum);
+    }
+}
+
+/* Per-row evaluation through Values, the path the vectorized kernels replace */
+void evaluate_boxed(const Expression& expr, VectorBatch& batch, const Schema& schema,
+                    ColumnVector& result) {
+    result.clear();
+    for (size_t r = 0; r < batch.row_count(); ++r) {
+        std::vector<common::Value> row;
+        for (size_t c = 0; c < batch.column_count(); ++c) {
+            row.push_back(batch.get_column(c).get(r));
+        }
+        const Tuple tuple(std::move(row));
+        result.append(expr.evaluate(&tuple, &schema));
+    }
+}
+
+std::unique_ptr<Expression> col(const std::string& name) {
+    return std::make_unique<ColumnExpr>(name);
+}
+
+std::unique_ptr<Expression> lit(common::Value value) {
+    return std::make_unique<ConstantExpr>(std::move(value));
+}
+
+std::unique_ptr<Expression> bin(std::unique_ptr<Expression> left, TokenType op,
+                                std::unique_ptr<Expression> right) {
+    return std::make_unique<BinaryExpr>(std::move(left), op, std::move(right));
+}
+
+TEST(AnalyticsTests, LateMaterialization) {
+    StorageManager storage("./test_analytics");
+    Schema schema;
+    schema.add_column("id", common::ValueType::TYPE_INT64);
+    schema.add_column("grp", common::ValueType::TYPE_INT64);
+    schema.add_column("k", common::ValueType::TYPE_INT64);
+    schema.add_column("status", common::ValueType::TYPE_INT64);
+    schema.add_column("region", common::ValueType::TYPE_TEXT);
+    schema.add_column("note", common::ValueType::TYPE_TEXT, true);
+    schema.add_column("price", common::ValueType::TYPE_FLOAT64);
+
+    auto table = std::make_shared<ColumnarTable>("late_test", storage, schema);
+    ASSERT_TRUE(table->create());
+    ASSERT_TRUE(table->open());
+
+    constexpr int64_t ROWS = 3 * ColumnarTable::CHUNK_ROWS;
+    const char* const regions[] = {"north", "south", "east", "west"};
+    auto input_batch = VectorBatch::create(schema);
+    for (int64_t i = 0; i < ROWS; ++i) {
+        std::vector<common::Value> row;
+        row.push_back(common::Value::make_int64(i * 3));
+        row.push_back(common::Value::make_int64((i / 2048) % 2));
+        row.push_back(common::Value::make_int64(i % 97));
+        row.push_back(common::Value::make_int64((i / 300) % 3));
+        row.push_back(common::Value::make_text(regions[(i / 10) % 4]));
+        row.push_back(i % 5 == 0 ? common::Value::make_null()
+                                 : common::Value::make_text("note-" + std::to_string(i)));
+        row.push_back(common::Value::make_float64(static_cast<double>(i) * 0.5));
+        input_batch->append_tuple(Tuple(std::move(row)));
+    }
+    ASSERT_TRUE(table->append_batch(*input_batch));
+    EXPECT_EQ(table->chunks(0).front().header.encoding, ColumnEncoding::Delta);
+    EXPECT_EQ(table->chunks(2).front().header.encoding, ColumnEncoding::BitPacked);
+    EXPECT_EQ(table->chunks(3).front().header.encoding, ColumnEncoding::Rle);
+    EXPECT_EQ(table->chunks(4).front().header.encoding, ColumnEncoding::Dictionary);
+    EXPECT_EQ(table->chunks(5).front().header.encoding, ColumnEncoding::Plain);
+
+    /* grp = 0 AND k = 5: half the batches have no survivor at all */
+    const auto keep = [](int64_t i) { return (i / 2048) % 2 == 0 && i % 97 == 5; };
+    const auto condition = []() {
+        return bin(bin(col("grp"), TokenType::Eq, lit(common::Value::make_int64(0))),
+                   TokenType::And, bin(col("k"), TokenType::Eq, lit(common::Value::make_int64(5))));
+    };
+
+    /* The scan reads the filter's columns, then the required ones at the survivors */
+    {
+        VectorizedSeqScanOperator scan("late_test", table);
+        ASSERT_TRUE(scan.set_filter(condition()));
+        scan.require_columns({0, 3, 4, 5});
+        auto batch = VectorBatch::create(schema);
+        int64_t live = 0;
+        while (scan.next_selected_batch(*batch)) {
+            ASSERT_TRUE(batch->has_selection());
+            batch->for_each_selected([&](size_t r) {
+                const int64_t i = batch->get_column(0).get(r).to_int64() / 3;
+                ASSERT_TRUE(keep(i));
+                EXPECT_EQ(batch->get_column(3).get(r).to_int64(), (i / 300) % 3);
+                EXPECT_EQ(batch->get_column(4).get(r).to_string(), regions[(i / 10) % 4]);
+                if (i % 5 == 0) {
+                    EXPECT_TRUE(batch->get_column(5).is_null(r));
+                } else {
+                    EXPECT_EQ(batch->get_column(5).get(r).to_string(),
+                              "note-" + std::to_string(i));
+                }
+                /* Never read */
+                EXPECT_DOUBLE_EQ(batch->get_column(6).get(r).to_float64(), 0.0);
+                ++live;
+            });
+        }
+        int64_t expected = 0;
+        for (int64_t i = 0; i < ROWS; ++i) expected += keep(i) ? 1 : 0;
+        EXPECT_EQ(live, expected);
+        EXPECT_EQ(scan.late_batches_skipped(),
+                  static_cast<uint64_t>(ROWS / 1024 / 2));
+    }
+
+    /* Through a filter and a projection, as a plan stacks them */
+    std::vector<std::unique_ptr<Expression>> exprs;
+    exprs.push_back(col("note"));
+    exprs.push_back(col("price"));
+    exprs.push_back(col("id"));
+    Schema out_schema;
+    out_schema.add_column("note", common::ValueType::TYPE_TEXT, true);
+    out_schema.add_column("price", common::ValueType::TYPE_FLOAT64);
+    out_schema.add_column("id", common::ValueType::TYPE_INT64);
+    auto scan = std::make_unique<VectorizedSeqScanOperator>("late_test", table);
+    const VectorizedSeqScanOperator* const scan_ptr = scan.get();
+    VectorizedProjectOperator project(
+        std::make_unique<VectorizedFilterOperator>(std::move(scan), condition()),
+        std::move(out_schema), std::move(exprs));
+
+    ExplainNode plan;
+    project.explain(plan);
+    const auto& details = plan.children.front().children.front().details;
+    EXPECT_NE(std::find(details.begin(), details.end(), "Columns Read: 5 of 7"), details.end());
+
+    auto out = VectorBatch::create(project.output_schema());
+    int64_t next = 0;
+    while (project.next_batch(*out)) {
+        for (size_t r = 0; r < out->row_count(); ++r) {
+            while (!keep(next)) ++next;
+            ASSERT_EQ(out->get_column(2).get(r).to_int64(), next * 3);
+            ASSERT_DOUBLE_EQ(out->get_column(1).get(r).to_float64(),
+                             static_cast<double>(next) * 0.5);
+            ASSERT_EQ(out->get_column(0).is_null(r), next % 5 == 0);
+            ++next;
+        }
+    }
+    while (next < ROWS && !keep(next)) ++next;
+    EXPECT_EQ(next, ROWS);
+    EXPECT_GT(scan_ptr->late_batches_skipped(), 0U);
+}
+
+TEST(AnalyticsTests, ExpressionKernels) {
+    Schema schema;
+    schema.add_column("a", common::ValueType::TYPE_INT64, true);
+    schema.add_column("b", common::ValueType::TYPE_INT64);
+    schema.add_column("x", common::ValueType::TYPE_FLOAT64);
+
+    auto batch = VectorBatch::create(schema);
+    for (int64_t i = 0; i < 100; ++i) {
+        batch->append_tuple(Tuple({i % 10 == 3 ? common::Value::make_null()
+                                               : common::Value::make_int64(i - 50),
+                                   common::Value::make_int64(i % 7),
+                                   common::Value::make_float64(static_cast<double>(i) * 0.25)}));
+    }
+
+    /* Each case against the row evaluator, on rows where every input is non-NULL */
+    struct Case {
+        std::unique_ptr<Expression> expr;
+        common::ValueType type;
+    };
+    std::vector<Case> cases;
+    cases.push_back({bin(col("a"), TokenType::Lt, lit(common::Value::make_int64(5))),
+                     common::ValueType::TYPE_BOOL});
+    cases.push_back({bin(lit(common::Value::make_int64(5)), TokenType::Lt, col("a")),
+                     common::ValueType::TYPE_BOOL});
+    cases.push_back({bin(col("a"), TokenType::Ge, col("b")), common::ValueType::TYPE_BOOL});
+    cases.push_back({bin(col("x"), TokenType::Ne, col("b")), common::ValueType::TYPE_BOOL});
+    cases.push_back({bin(col("a"), TokenType::Le, lit(common::Value::make_float64(-10.5))),
+                     common::ValueType::TYPE_BOOL});
+    cases.push_back({bin(col("a"), TokenType::Minus, col("b")), common::ValueType::TYPE_INT64});
+    cases.push_back({bin(lit(common::Value::make_int64(100)), TokenType::Minus, col("a")),
+                     common::ValueType::TYPE_INT64});
+    cases.push_back({bin(col("a"), TokenType::Star, lit(common::Value::make_int64(3))),
+                     common::ValueType::TYPE_INT64});
+    cases.push_back({bin(col("a"), TokenType::Plus, col("x")), common::ValueType::TYPE_FLOAT64});
+    cases.push_back({bin(col("a"), TokenType::Slash, lit(common::Value::make_int64(4))),
+                     common::ValueType::TYPE_FLOAT64});
+    cases.push_back({bin(lit(common::Value::make_float64(1.5)), TokenType::Slash, col("x")),
+                     common::ValueType::TYPE_FLOAT64});
+    cases.push_back({bin(bin(col("a"), TokenType::Plus, col("b")), TokenType::Gt,
+                         bin(col("x"), TokenType::Star, lit(common::Value::make_int64(2)))),
+                     common::ValueType::TYPE_BOOL});
+
+    Schema out;
+    for (auto& c : cases) {
+        out = Schema();
+        out.add_column("r", c.type);
+        auto kernel = VectorBatch::create(out);
+        auto boxed = VectorBatch::create(out);
+        c.expr->evaluate_vectorized(*batch, schema, kernel->get_column(0));
+        evaluate_boxed(*c.expr, *batch, schema, boxed->get_column(0));
+        ASSERT_EQ(kernel->get_column(0).size(), batch->row_count()) << c.expr->to_string();
+        for (size_t r = 0; r < batch->row_count(); ++r) {
+            if (batch->get_column(0).is_null(r)) continue;
+            ASSERT_EQ(kernel->get_column(0).get(r), boxed->get_column(0).get(r))
+                << c.expr->to_string() << " row " << r;
+        }
+    }
+
+    /* NULL operands propagate */
+    NumericVector<int64_t> diff(common::ValueType::TYPE_INT64);
+    cases[5].expr->evaluate_vectorized(*batch, schema, diff);
+    for (size_t r = 0; r < batch->row_count(); ++r) {
+        EXPECT_EQ(diff.is_null(r), batch->get_column(0).is_null(r));
+    }
+
+    /* AND / OR are three-valued: a known side can decide a NULL row */
+    auto and_expr = bin(bin(col("a"), TokenType::Gt, lit(common::Value::make_int64(0))),
+                        TokenType::And, bin(col("b"), TokenType::Eq,
+                                            lit(common::Value::make_int64(0))));
+    auto or_expr = bin(bin(col("a"), TokenType::Gt, lit(common::Value::make_int64(0))),
+                       TokenType::Or, bin(col("b"), TokenType::Eq,
+                                          lit(common::Value::make_int64(0))));
+    NumericVector<bool> and_res(common::ValueType::TYPE_BOOL);
+    NumericVector<bool> or_res(common::ValueType::TYPE_BOOL);
+    and_expr->evaluate_vectorized(*batch, schema, and_res);
+    or_expr->evaluate_vectorized(*batch, schema, or_res);
+    for (int64_t i = 0; i < 100; ++i) {
+        const auto r = static_cast<size_t>(i);
+        const bool b_zero = i % 7 == 0;
+        if (i % 10 == 3) {
+            EXPECT_EQ(and_res.is_null(r), b_zero) << i;  // NULL AND FALSE is FALSE
+            EXPECT_EQ(or_res.is_null(r), !b_zero) << i;  // NULL OR TRUE is TRUE
+            if (!b_zero) EXPECT_FALSE(and_res.get(r).as_bool());
+            if (b_zero) EXPECT_TRUE(or_res.get(r).as_bool());
+        } else {
+            const bool a_pos = i - 50 > 0;
+            EXPECT_EQ(and_res.get(r).as_bool(), a_pos && b_zero) << i;
+            EXPECT_EQ(or_res.get(r).as_bool(), a_pos || b_zero) << i;
+        }
+    }
+}
+
+TEST(AnalyticsTests, ExpressionKernelMicrobenchmark) {
+    Schema schema;
+    schema.add_column("a", common::ValueType::TYPE_INT64);
+    schema.add_column("b", common::ValueType::TYPE_INT64);
+    schema.add_column("x", common::ValueType::TYPE_FLOAT64);
+
+    constexpr size_t ROWS = 1 << 16;
+    auto batch = VectorBatch::create(schema);
+    auto& a = dynamic_cast<NumericVector<int64_t>&>(batch->get_column(0));
+    auto& b = dynamic_cast<NumericVector<int64_t>&>(batch->get_column(1));
+    auto& x = dynamic_cast<NumericVector<double>&>(batch->get_column(2));
+    a.resize(ROWS);
+    b.resize(ROWS);
+    x.resize(ROWS);
+    for (size_t i = 0; i < ROWS; ++i) {
+        a.raw_data_mut()[i] = static_cast<int64_t>((i * 2654435761U) % 100000);
+        b.raw_data_mut()[i] = static_cast<int64_t>(i % 1000);
+        x.raw_data_mut()[i] = static_cast<double>(i) * 0.5;
+    }
+    batch->set_row_count(ROWS);
+
+    struct Case {
+        const char* name;
+        std::unique_ptr<Expression> expr;
+        common::ValueType type;
+    };
+    std::vector<Case> cases;
+    cases.push_back({"int_gt_const", bin(col("a"), TokenType::Gt,
+                                         lit(common::Value::make_int64(50000))),
+                     common::ValueType::TYPE_BOOL});
+    cases.push_back({"int_lt_col", bin(col("a"), TokenType::Lt, col("b")),
+                     common::ValueType::TYPE_BOOL});
+    cases.push_back({"int_add_col", bin(col("a"), TokenType::Plus, col("b")),
+                     common::ValueType::TYPE_INT64});
+    cases.push_back({"float_mul_const", bin(col("x"), TokenType::Star,
+                                            lit(common::Value::make_float64(1.5))),
+                     common::ValueType::TYPE_FLOAT64});
+    cases.push_back({"and_of_compares",
+                     bin(bin(col("a"), TokenType::Gt, lit(common::Value::make_int64(1000))),
+                         TokenType::And,
+                         bin(col("x"), TokenType::Lt, lit(common::Value::make_float64(9000.0)))),
+                     common::ValueType::TYPE_BOOL});
+
+    const auto time_us = [](auto&& fn) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+    };
+
+    for (auto& c : cases) {
+        Schema out;
+        out.add_column("r", c.type);
+        auto kernel = VectorBatch::create(out);
+        auto boxed = VectorBatch::create(out);
+
+        constexpr int REPS = 20;
+        const auto kernel_us = time_us([&] {
+            for (int rep = 0; rep < REPS; ++rep) {
+                c.expr->evaluate_vectorized(*batch, schema, kernel->get_column(0));
+            }
+        });
+        const auto boxed_us =
+            time_us([&] { evaluate_boxed(*c.expr, *batch, schema, boxed->get_column(0)); });
+
+        for (size_t r = 0; r < ROWS; r += 97) {
+            ASSERT_EQ(kernel->get_column(0).get(r), boxed->get_column(0).get(r)) << c.name;
+        }
+        const double kernel_rows_per_us =
+            static_cast<double>(ROWS) * REPS / static_cast<double>(kernel_us + 1);
+        const double boxed_rows_per_us =
+            static_cast<double>(ROWS) / static_cast<double>(boxed_us + 1);
+        std::cout << "[ExprKernels] case=" << c.name << " rows=" << ROWS
+                  << " boxed_rows_per_us=" << boxed_rows_per_us
+                  << " kernel_rows_per_us=" << kernel_rows_per_us
+                  << " speedup=" << kernel_rows_per_us / boxed_rows_per_us << "\n";
+    }
+}
+
+/* Drains `op` and renders every output row as text, keyed by its group columns */
+std::map<std::string, std::vector<std::string>> collect_groups(VectorizedOperator& op,
+                                                               size_t key_columns) {
+    std::map<std::string, std::vector<std::string>> groups;
+    auto batch = VectorBatch::create(op.output_schema());
+    while (op.next_batch(*batch)) {
+        for (size_t r = 0; r < batch->row_count(); ++r) {
+            std::string key;
+            std::vector<std::string> values;
+            for (size_t c = 0; c < batch->column_count(); ++c) {
+                const common::Value v = batch->get_column(c).get(r);
+                const std::string text = v.is_null() ? "NULL" : v.to_string();
+                if (c < key_columns) {
+                    key += text + "|";
+                } else {
+                    values.push_back(text);
+                }
+            }
+            EXPECT_TRUE(groups.emplace(key, std::move(values)).second) << "duplicate " << key;
+        }
+    }
+    return groups;
+}
+
+TEST(AnalyticsTests, VectorizedHashAggregation) {
+    StorageManager storage("./test_analytics");
+    Schema schema;
+    schema.add_column("id", common::ValueType::TYPE_INT64);
+    schema.add_column("k", common::ValueType::TYPE_INT64, true);
+    schema.add_column("name", common::ValueType::TYPE_TEXT, true);
+    schema.add_column("v", common::ValueType::TYPE_FLOAT64, true);
+
+    auto table = std::make_shared<ColumnarTable>("hash_agg_test", storage, schema);
+    ASSERT_TRUE(table->create());
+    ASSERT_TRUE(table->open());
+
+    constexpr int64_t ROWS = 5000;
+    const auto k_of = [](int64_t i) { return i % 97 == 0 ? -1 : i % 40; };
+    const auto name_of = [](int64_t i) {
+        return i % 11 == 0 ? std::string() : "g" + std::to_string(i % 3);
+    };
+    const auto v_null = [](int64_t i) { return i % 13 == 0; };
+    auto input = VectorBatch::create(schema);
+    for (int64_t i = 0; i < ROWS; ++i) {
+        std::vector<common::Value> row;
+        row.push_back(common::Value::make_int64(i));
+        row.push_back(k_of(i) < 0 ? common::Value::make_null()
+                                  : common::Value::make_int64(k_of(i)));
+        row.push_back(name_of(i).empty() ? common::Value::make_null()
+                                         : common::Value::make_text(name_of(i)));
+        row.push_back(v_null(i) ? common::Value::make_null()
+                                : common::Value::make_float64(static_cast<double>(i % 500) * 0.5));
+        input->append_tuple(Tuple(std::move(row)));
+    }
+    ASSERT_TRUE(table->append_batch(*input));
+
+    /* Expected groups for id >= 100, computed row by row */
+    struct Expected {
+        int64_t rows = 0;
+        int64_t values = 0;
+        double sum = 0.0;
+        double min = 0.0;
+        int64_t max_id = 0;
+        std::vector<double> distinct;
+    };
+    std::map<std::string, Expected> expected;
+    for (int64_t i = 100; i < ROWS; ++i) {
+        const std::string key = (k_of(i) < 0 ? "NULL" : std::to_string(k_of(i))) + "|" +
+                                (name_of(i).empty() ? "NULL" : name_of(i)) + "|";
+        Expected& e = expected[key];
+        e.rows++;
+        e.max_id = std::max(e.max_id, i);
+        if (v_null(i)) continue;
+        const double v = static_cast<double>(i % 500) * 0.5;
+        e.min = e.values == 0 ? v : std::min(e.min, v);
+        e.sum += v;
+        e.values++;
+        if (std::find(e.distinct.begin(), e.distinct.end(), v) == e.distinct.end()) {
+            e.distinct.push_back(v);
+        }
+    }
+
+    Schema out;
+    out.add_column("k", common::ValueType::TYPE_INT64);
+    out.add_column("name", common::ValueType::TYPE_TEXT);
+    out.add_column("rows", common::ValueType::TYPE_INT64);
+    out.add_column("sum_v", common::ValueType::TYPE_FLOAT64);
+    out.add_column("avg_v", common::ValueType::TYPE_FLOAT64);
+    out.add_column("min_v", common::ValueType::TYPE_FLOAT64);
+    out.add_column("max_id", common::ValueType::TYPE_INT64);
+    out.add_column("distinct_v", common::ValueType::TYPE_INT64);
+    std::vector<VectorizedAggregateInfo> aggs = {
+        {AggregateType::Count, -1}, {AggregateType::Sum, 3}, {AggregateType::Avg, 3},
+        {AggregateType::Min, 3},    {AggregateType::Max, 0}, {AggregateType::Count, 3, true},
+    };
+
+    auto scan = std::make_unique<VectorizedSeqScanOperator>("hash_agg_test", table);
+    auto filter = std::make_unique<VectorizedFilterOperator>(
+        std::move(scan), bin(col("id"), TokenType::Ge, lit(common::Value::make_int64(100))));
+    VectorizedHashAggregateOperator agg(std::move(filter), {1, 2}, out, aggs);
+    const auto groups = collect_groups(agg, 2);
+
+    ASSERT_EQ(groups.size(), expected.size());
+    for (const auto& [key, e] : expected) {
+        const auto it = groups.find(key);
+        ASSERT_NE(it, groups.end()) << key;
+        const auto& got = it->second;
+        EXPECT_EQ(got[0], std::to_string(e.rows)) << key;
+        if (e.values == 0) {
+            EXPECT_EQ(got[1], "NULL") << key;
+            EXPECT_EQ(got[2], "NULL") << key;
+            EXPECT_EQ(got[3], "NULL") << key;
+        } else {
+            // Rendered values carry a fixed number of digits
+            EXPECT_NEAR(std::stod(got[1]), e.sum, 1e-6) << key;
+            EXPECT_NEAR(std::stod(got[2]), e.sum / static_cast<double>(e.values), 1e-6) << key;
+            EXPECT_NEAR(std::stod(got[3]), e.min, 1e-6) << key;
+        }
+        EXPECT_EQ(got[4], std::to_string(e.max_id)) << key;
+        EXPECT_EQ(got[5], std::to_string(e.distinct.size())) << key;
+    }
+
+    /* A global aggregate over no rows still yields its one row */
+    {
+        auto empty_scan = std::make_unique<VectorizedSeqScanOperator>("hash_agg_test", table);
+        auto none = std::make_unique<VectorizedFilterOperator>(
+            std::move(empty_scan),
+            bin(col("id"), TokenType::Lt, lit(common::Value::make_int64(0))));
+        Schema global;
+        global.add_column("rows", common::ValueType::TYPE_INT64);
+        global.add_column("sum_v", common::ValueType::TYPE_FLOAT64);
+        VectorizedHashAggregateOperator total(
+            std::move(none), {}, global,
+            {{AggregateType::Count, -1}, {AggregateType::Sum, 3}});
+        const auto rows = collect_groups(total, 0);
+        ASSERT_EQ(rows.size(), 1U);
+        EXPECT_EQ(rows.begin()->second, (std::vector<std::string>{"0", "NULL"}));
+    }
+
+    /* MIN / MAX over strings; SUM over strings is rejected up front */
+    {
+        auto str_scan = std::make_unique<VectorizedSeqScanOperator>("hash_agg_test", table);
+        Schema minmax;
+        minmax.add_column("lo", common::ValueType::TYPE_TEXT);
+        minmax.add_column("hi", common::ValueType::TYPE_TEXT);
+        VectorizedHashAggregateOperator names(std::move(str_scan), {}, minmax,
+                                              {{AggregateType::Min, 2}, {AggregateType::Max, 2}});
+        const auto rows = collect_groups(names, 0);
+        ASSERT_EQ(rows.size(), 1U);
+        EXPECT_EQ(rows.begin()->second, (std::vector<std::string>{"g0", "g2"}));
+
+        EXPECT_THROW(AggregateHashTable(schema, {}, {{AggregateType::Sum, 2}}),
+                     std::runtime_error);
+    }
+}
+
+TEST(AnalyticsTests, HashAggregatePartialMerge) {
+    Schema schema;
+    schema.add_column("k", common::ValueType::TYPE_TEXT, true);
+    schema.add_column("x", common::ValueType::TYPE_INT64, true);
+
+    constexpr size_t BATCHES = 8;
+    constexpr size_t ROWS = 1500;
+    std::vector<std::unique_ptr<VectorBatch>> batches;
+    for (size_t b = 0; b < BATCHES; ++b) {
+        auto batch = VectorBatch::create(schema);
+        for (size_t i = 0; i < ROWS; ++i) {
+            const size_t n = b * ROWS + i;
+            std::vector<common::Value> row;
+            // Later batches introduce keys the early ones never saw
+            const std::string key = "key" + std::to_string(n % (50 + 30 * b));
+            row.push_back(n % 101 == 0 ? common::Value::make_null()
+                                       : common::Value::make_text(key));
+            row.push_back(n % 9 == 0
+                              ? common::Value::make_null()
+                              : common::Value::make_int64(static_cast<int64_t>(n % 37) - 18));
+            batch->append_tuple(Tuple(std::move(row)));
+        }
+        batches.push_back(std::move(batch));
+    }
+
+    const std::vector<VectorizedAggregateInfo> aggs = {
+        {AggregateType::Count, -1}, {AggregateType::Count, 1}, {AggregateType::Sum, 1},
+        {AggregateType::Avg, 1},    {AggregateType::Min, 1},   {AggregateType::Max, 1},
+        {AggregateType::Count, 1, true},
+    };
+    Schema out;
+    out.add_column("k", common::ValueType::TYPE_TEXT);
+    out.add_column("rows", common::ValueType::TYPE_INT64);
+    out.add_column("xs", common::ValueType::TYPE_INT64);
+    out.add_column("sum_x", common::ValueType::TYPE_INT64);
+    out.add_column("avg_x", common::ValueType::TYPE_FLOAT64);
+    out.add_column("min_x", common::ValueType::TYPE_INT64);
+    out.add_column("max_x", common::ValueType::TYPE_INT64);
+    out.add_column("distinct_x", common::ValueType::TYPE_INT64);
+
+    const auto render = [&out](const AggregateHashTable& table) {
+        std::map<std::string, std::string> rows;
+        auto batch = VectorBatch::create(out);
+        for (size_t begin = 0; begin < table.group_count(); begin += 64) {
+            table.emit(begin, 64, *batch);
+            for (size_t r = 0; r < batch->row_count(); ++r) {
+                std::string line;
+                for (size_t c = 1; c < batch->column_count(); ++c) {
+                    const common::Value v = batch->get_column(c).get(r);
+                    line += (v.is_null() ? "NULL" : v.to_string()) + " ";
+                }
+                const common::Value k = batch->get_column(0).get(r);
+                rows[k.is_null() ? "NULL" : k.to_string()] = line;
+            }
+        }
+        return rows;
+    };
+
+    AggregateHashTable single(schema, {0}, aggs);
+    for (const auto& batch : batches) single.add_batch(*batch);
+
+    /* Four partials over interleaved batches, merged pairwise */
+    std::vector<AggregateHashTable> partials(4, AggregateHashTable(schema, {0}, aggs));
+    for (size_t b = 0; b < BATCHES; ++b) partials[b % 4].add_batch(*batches[b]);
+    partials[0].merge(partials[1]);
+    partials[2].merge(partials[3]);
+    partials[0].merge(partials[2]);
+
+    EXPECT_EQ(partials[0].group_count(), single.group_count());
+    EXPECT_EQ(render(partials[0]), render(single));
+
+    /* Merging into an empty table reproduces the source */
+    AggregateHashTable empty(schema, {0}, aggs);
+    empty.merge(single);
+    EXPECT_EQ(render(empty), render(single));
+
+    AggregateHashTable other_layout(schema, {1}, aggs);
+    EXPECT_THROW(single.merge(other_layout), std::runtime_error);
+
+    /* Throughput of the batch path on one core */
+    const auto start = std::chrono::steady_clock::now();
+    constexpr int REPS = 10;
+    size_t groups = 0;
+    for (int rep = 0; rep < REPS; ++rep) {
+        AggregateHashTable timed(schema, {0}, aggs);
+        for (const auto& batch : batches) timed.add_batch(*batch);
+        groups = timed.group_count();
+    }
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    std::cout << "[HashAgg] rows=" << BATCHES * ROWS * REPS << " groups=" << groups
+              << " aggregates=" << aggs.size() << " rows_per_us="
+              << static_cast<double>(BATCHES * ROWS * REPS) / static_cast<double>(us + 1) << "\n";
+}
+
+/* Drains `op` through next_batch() and renders its rows as sorted text */
+std::vector<std::string> collect_rows(VectorizedOperator& op, size_t* max_batch = nullptr) {
+    std::vector<std::string> rows;
+    auto batch = VectorBatch::create(op.output_schema());
+    while (op.next_batch(*batch)) {
+        EXPECT_FALSE(batch->has_selection());
+        if (max_batch != nullptr) *max_batch = std::max(*max_batch, batch->row_count());
+        for (size_t r = 0; r < batch->row_count(); ++r) {
+            std::string line;
+            for (size_t c = 0; c < batch->column_count(); ++c) {
+                const common::Value v = batch->get_column(c).get(r);
+                line += (v.is_null() ? "NULL" : v.to_string()) + "|";
+            }
+            rows.push_back(std::move(line));
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+TEST(AnalyticsTests, VectorizedHashJoin) {
+    StorageManager storage("./test_analytics");
+    Schema dim_schema;
+    dim_schema.add_column("id", common::ValueType::TYPE_INT64, true);
+    dim_schema.add_column("region", common::ValueType::TYPE_TEXT);
+    Schema fact_schema;
+    fact_schema.add_column("fk", common::ValueType::TYPE_INT64, true);
+    fact_schema.add_column("amount", common::ValueType::TYPE_INT64);
+
+    /* Dimension ids 0..49 with a duplicate id 7 and a NULL id; facts reference 0..59 */
+    std::vector<std::pair<int64_t, std::string>> dim_rows;
+    for (int64_t id = 0; id < 50; ++id) dim_rows.emplace_back(id, "r" + std::to_string(id % 4));
+    dim_rows.emplace_back(7, "dup");
+    dim_rows.emplace_back(-1, "nokey");
+    constexpr int64_t FACTS = 5000;
+    const auto fk_of = [](int64_t i) { return i % 31 == 0 ? -1 : i % 60; };
+
+    auto dim = std::make_shared<ColumnarTable>("join_dim", storage, dim_schema);
+    ASSERT_TRUE(dim->create());
+    ASSERT_TRUE(dim->open());
+    auto dim_batch = VectorBatch::create(dim_schema);
+    for (const auto& [id, region] : dim_rows) {
+        dim_batch->append_tuple(Tuple({id < 0 ? common::Value::make_null()
+                                              : common::Value::make_int64(id),
+                                       common::Value::make_text(region)}));
+    }
+    ASSERT_TRUE(dim->append_batch(*dim_batch));
+
+    auto fact = std::make_shared<ColumnarTable>("join_fact", storage, fact_schema);
+    ASSERT_TRUE(fact->create());
+    ASSERT_TRUE(fact->open());
+    auto fact_batch = VectorBatch::create(fact_schema);
+    for (int64_t i = 0; i < FACTS; ++i) {
+        fact_batch->append_tuple(Tuple({fk_of(i) < 0 ? common::Value::make_null()
+                                                     : common::Value::make_int64(fk_of(i)),
+                                        common::Value::make_int64(i)}));
+    }
+    ASSERT_TRUE(fact->append_batch(*fact_batch));
+
+    /* Facts with amount >= 1000 joined on fk = id, by nested loops */
+    const auto fact_text = [&](int64_t i) {
+        return (fk_of(i) < 0 ? std::string("NULL") : std::to_string(fk_of(i))) + "|" +
+               std::to_string(i) + "|";
+    };
+    std::vector<std::string> inner;
+    std::vector<std::string> left;
+    std::vector<std::string> semi;
+    std::vector<std::string> anti;
+    for (int64_t i = 1000; i < FACTS; ++i) {
+        bool matched = false;
+        for (const auto& [id, region] : dim_rows) {
+            if (fk_of(i) < 0 || id != fk_of(i)) continue;
+            const std::string line = fact_text(i) + std::to_string(id) + "|" + region + "|";
+            inner.push_back(line);
+            left.push_back(line);
+            matched = true;
+        }
+        if (!matched) left.push_back(fact_text(i) + "NULL|NULL|");
+        (matched ? semi : anti).push_back(fact_text(i));
+    }
+    for (auto* expected : {&inner, &left, &semi, &anti}) {
+        std::sort(expected->begin(), expected->end());
+    }
+
+    const auto make_join = [&](JoinType type) {
+        auto probe = std::make_unique<VectorizedFilterOperator>(
+            std::make_unique<VectorizedSeqScanOperator>("join_fact", fact),
+            bin(col("amount"), TokenType::Ge, lit(common::Value::make_int64(1000))));
+        auto build = std::make_unique<VectorizedSeqScanOperator>("join_dim", dim);
+        return std::make_unique<VectorizedHashJoinOperator>(
+            std::move(probe), std::move(build), std::vector<size_t>{0}, std::vector<size_t>{0},
+            type);
+    };
+
+    EXPECT_EQ(collect_rows(*make_join(JoinType::Inner)), inner);
+    {
+        auto join = make_join(JoinType::Left);
+        EXPECT_TRUE(join->output_schema().get_column(2).nullable());
+        EXPECT_EQ(collect_rows(*join), left);
+    }
+    {
+        auto join = make_join(JoinType::Semi);
+        EXPECT_EQ(join->output_schema().column_count(), 2U);
+        EXPECT_EQ(collect_rows(*join), semi);
+    }
+    EXPECT_EQ(collect_rows(*make_join(JoinType::Anti)), anti);
+
+    /* Semi join output stays a selection over the scanned batch */
+    {
+        auto join = make_join(JoinType::Semi);
+        auto batch = VectorBatch::create(join->output_schema());
+        size_t live = 0;
+        while (join->next_selected_batch(*batch)) {
+            EXPECT_TRUE(batch->has_selection());
+            live += batch->selected_count();
+        }
+        EXPECT_EQ(live, semi.size());
+    }
+
+    EXPECT_THROW(make_join(JoinType::Full), std::runtime_error);
+
+    /* Heavy fan-out on a string key spills over several output batches */
+    {
+        auto build = VectorBatch::create(dim_schema);
+        for (int64_t i = 0; i < 1200; ++i) {
+            build->append_tuple(Tuple({common::Value::make_int64(i),
+                                       common::Value::make_text("r" + std::to_string(i % 3))}));
+        }
+        auto build_table = std::make_shared<ColumnarTable>("join_fanout", storage, dim_schema);
+        ASSERT_TRUE(build_table->create());
+        ASSERT_TRUE(build_table->open());
+        ASSERT_TRUE(build_table->append_batch(*build));
+
+        const auto make_fanout = [&](JoinType type) {
+            return std::make_unique<VectorizedHashJoinOperator>(
+                std::make_unique<VectorizedSeqScanOperator>("join_dim", dim),
+                std::make_unique<VectorizedSeqScanOperator>("join_fanout", build_table),
+                std::vector<size_t>{1}, std::vector<size_t>{1}, type);
+        };
+        // Regions r0, r1 and r2 each have 400 partners; the others have none
+        size_t expected = 0;
+        size_t unmatched = 0;
+        for (const auto& [id, region] : dim_rows) {
+            if (region == "r0" || region == "r1" || region == "r2") {
+                expected += 400;
+            } else {
+                ++unmatched;
+            }
+        }
+        size_t max_batch = 0;
+        EXPECT_EQ(collect_rows(*make_fanout(JoinType::Inner), &max_batch).size(), expected);
+        EXPECT_EQ(max_batch, 1024U);
+        EXPECT_EQ(collect_rows(*make_fanout(JoinType::Left)).size(), expected + unmatched);
+    }
+
+    /* Left join against an empty build side pads every row with NULLs */
+    {
+        auto empty = std::make_unique<VectorizedFilterOperator>(
+            std::make_unique<VectorizedSeqScanOperator>("join_dim", dim),
+            bin(col("id"), TokenType::Lt, lit(common::Value::make_int64(0))));
+        VectorizedHashJoinOperator join(
+            std::make_unique<VectorizedSeqScanOperator>("join_dim", dim), std::move(empty), {0},
+            {0}, JoinType::Left);
+        const auto rows = collect_rows(join);
+        ASSERT_EQ(rows.size(), dim_rows.size());
+        for (const auto& row : rows) {
+            EXPECT_EQ(row.substr(row.size() - 10), "NULL|NULL|");
+        }
+    }
+}
+
+TEST(AnalyticsTests, RuntimeFilterSkipsProbeChunks) {
+    StorageManager storage("./test_analytics");
+    Schema dim_schema;
+    dim_schema.add_column("id", common::ValueType::TYPE_INT64);
+    Schema fact_schema;
+    fact_schema.add_column("fk", common::ValueType::TYPE_INT64);
+    fact_schema.add_column("amount", common::ValueType::TYPE_INT64);
+
+    /* Facts sorted on fk, 100 per key, five chunks; the dimension holds keys 5, 9 and 20 */
+    constexpr int64_t FACTS = 5 * ColumnarTable::CHUNK_ROWS;
+    auto fact = std::make_shared<ColumnarTable>("rf_fact", storage, fact_schema);
+    ASSERT_TRUE(fact->create());
+    ASSERT_TRUE(fact->open());
+    auto fact_batch = VectorBatch::create(fact_schema);
+    for (int64_t i = 0; i < FACTS; ++i) {
+        fact_batch->append_tuple(
+            Tuple({common::Value::make_int64(i / 100), common::Value::make_int64(i)}));
+    }
+    ASSERT_TRUE(fact->append_batch(*fact_batch));
+
+    auto dim = std::make_shared<ColumnarTable>("rf_dim", storage, dim_schema);
+    ASSERT_TRUE(dim->create());
+    ASSERT_TRUE(dim->open());
+    auto dim_batch = VectorBatch::create(dim_schema);
+    for (const int64_t id : {5, 9, 20}) {
+        dim_batch->append_tuple(Tuple({common::Value::make_int64(id)}));
+    }
+    ASSERT_TRUE(dim->append_batch(*dim_batch));
+
+    const auto make_join = [&](JoinType type, VectorizedSeqScanOperator** probe_scan) {
+        auto probe = std::make_unique<VectorizedSeqScanOperator>("rf_fact", fact);
+        *probe_scan = probe.get();
+        return std::make_unique<VectorizedHashJoinOperator>(
+            std::move(probe), std::make_unique<VectorizedSeqScanOperator>("rf_dim", dim),
+            std::vector<size_t>{0}, std::vector<size_t>{0}, type);
+    };
+
+    /* Keys 5..20 lie in the first chunk: the range skips the rest, the Bloom filter the gaps */
+    VectorizedSeqScanOperator* scan = nullptr;
+    auto join = make_join(JoinType::Inner, &scan);
+    EXPECT_EQ(collect_rows(*join).size(), 300U);
+    ScanStats stats;
+    join->collect_scan_stats(stats);
+    EXPECT_EQ(stats.chunks_skipped, 4U);
+    EXPECT_EQ(scan->filtered_rows(), ColumnarTable::CHUNK_ROWS - 300U);
+
+    /* A left join must see every probe row */
+    auto left = make_join(JoinType::Left, &scan);
+    EXPECT_EQ(collect_rows(*left).size(), static_cast<size_t>(FACTS));
+    EXPECT_EQ(scan->filtered_rows(), 0U);
+}
+
+TEST(AnalyticsTests, WorkStealingPool) {
+    WorkStealingPool pool(4);
+    EXPECT_EQ(pool.thread_count(), 4U);
+
+    /* Every task runs exactly once */
+    constexpr size_t TASKS = 1000;
+    std::vector<std::atomic<int>> runs(TASKS);
+    pool.parallel_for(TASKS, 0, [&](size_t worker, size_t task) {
+        EXPECT_LT(worker, 4U);
+        runs[task].fetch_add(1);
+    });
+    for (const auto& count : runs) EXPECT_EQ(count.load(), 1);
+
+    /* A stalled worker's block is stolen by the others */
+    {
+        // Tasks 0..3 form one block; task 0 only returns once another of them has run
+        std::atomic<bool> neighbour_ran{false};
+        bool released = false;
+        pool.parallel_for(16, 4, [&](size_t, size_t task) {
+            if (task == 0) {
+                for (int i = 0; i < 5000 && !neighbour_ran.load(); ++i) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                released = neighbour_ran.load();
+            } else if (task < 4) {
+                neighbour_ran = true;
+            }
+        });
+        EXPECT_TRUE(released);
+    }
+
+    /* The first exception surfaces in the caller and the pool stays usable */
+    EXPECT_THROW(pool.parallel_for(64, 3,
+                                   [](size_t, size_t task) {
+                                       if (task == 10) throw std::runtime_error("task failed");
+                                   }),
+                 std::runtime_error);
+    std::atomic<size_t> total{0};
+    pool.parallel_for(10, 2, [&](size_t, size_t task) { total += task; });
+    EXPECT_EQ(total.load(), 45U);
+}
+
+TEST(AnalyticsTests, MorselParallelAggregation) {
+    StorageManager storage("./test_analytics");
+    Schema schema;
+    schema.add_column("id", common::ValueType::TYPE_INT64);
+    schema.add_column("grp", common::ValueType::TYPE_TEXT);
+    schema.add_column("v", common::ValueType::TYPE_FLOAT64, true);
+
+    auto table = std::make_shared<ColumnarTable>("morsel_test", storage, schema);
+    ASSERT_TRUE(table->create());
+    ASSERT_TRUE(table->open());
+    constexpr int64_t ROWS = 200000;
+    for (int64_t start = 0; start < ROWS; start += 50000) {
+        auto batch = VectorBatch::create(schema);
+        for (int64_t i = start; i < start + 50000; ++i) {
+            batch->append_tuple(Tuple({common::Value::make_int64(i),
+                                       common::Value::make_text("g" + std::to_string(i % 37)),
+                                       i % 10 == 0 ? common::Value::make_null()
+                                                   : common::Value::make_float64(
+                                                         static_cast<double>(i % 1000))}));
+        }
+        ASSERT_TRUE(table->append_batch(*batch));
+    }
+
+    // WHERE id >= 30000 AND v < 900, then GROUP BY grp
+    const MorselScheduler::PipelineFactory pipeline =
+        [](std::unique_ptr<VectorizedSeqScanOperator> scan) -> std::unique_ptr<VectorizedOperator> {
+        return std::make_unique<VectorizedFilterOperator>(
+            std::move(scan),
+            bin(bin(col("id"), TokenType::Ge, lit(common::Value::make_int64(30000))),
+                TokenType::And,
+                bin(col("v"), TokenType::Lt, lit(common::Value::make_float64(900)))));
+    };
+    Schema out;
+    out.add_column("grp", common::ValueType::TYPE_TEXT);
+    out.add_column("rows", common::ValueType::TYPE_INT64);
+    out.add_column("sum_v", common::ValueType::TYPE_FLOAT64);
+    out.add_column("max_id", common::ValueType::TYPE_INT64);
+    out.add_column("distinct_v", common::ValueType::TYPE_INT64);
+    const std::vector<VectorizedAggregateInfo> aggs = {{AggregateType::Count, -1},
+                                                       {AggregateType::Sum, 2},
+                                                       {AggregateType::Max, 0},
+                                                       {AggregateType::Count, 2, true}};
+
+    VectorizedHashAggregateOperator serial(
+        pipeline(std::make_unique<VectorizedSeqScanOperator>("morsel_test", table)), {1}, out,
+        aggs);
+    const auto expected = collect_groups(serial, 1);
+    ASSERT_EQ(expected.size(), 37U);
+
+    MorselOptions options;
+    options.morsel_rows = 16384;
+    options.parallelism = 4;
+    WorkStealingPool pool(4);
+    MorselScheduler scheduler("morsel_test", table, options, &pool);
+    EXPECT_EQ(scheduler.parallelism(), 4U);
+    ASSERT_GT(scheduler.morsels().size(), 4U);
+    uint64_t covered = 0;
+    for (const auto& morsel : scheduler.morsels()) {
+        EXPECT_EQ(morsel.begin, covered);
+        EXPECT_EQ(table->chunk_end_row(table->chunk_index(morsel.end - 1)), morsel.end);
+        covered = morsel.end;
+    }
+    EXPECT_EQ(covered, static_cast<uint64_t>(ROWS));
+
+    /* Every surviving row reaches the sink exactly once */
+    {
+        std::mutex mutex;
+        std::vector<int> seen(ROWS);
+        ASSERT_TRUE(scheduler.run(pipeline, [&](size_t, VectorBatch& batch) {
+            const std::lock_guard<std::mutex> lock(mutex);
+            for (size_t r = 0; r < batch.row_count(); ++r) {
+                seen[static_cast<size_t>(batch.get_column(0).get(r).to_int64())]++;
+            }
+        }));
+        int64_t rows = 0;
+        for (int64_t i = 0; i < ROWS; ++i) {
+            const bool keep = i >= 30000 && i % 10 != 0 && i % 1000 < 900;
+            EXPECT_EQ(seen[static_cast<size_t>(i)], keep ? 1 : 0);
+            rows += seen[static_cast<size_t>(i)];
+        }
+        EXPECT_GT(rows, 0);
+        // The id predicate reaches every morsel's scan and prunes the leading chunks
+        EXPECT_GT(scheduler.scan_stats().chunks_skipped, 0U);
+    }
+
+    /* Partial aggregates merged across workers match the serial plan */
+    const auto time_ms = [](auto&& fn) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count();
+    };
+    for (const size_t dop : {1U, 2U, 4U}) {
+        options.parallelism = dop;
+        std::map<std::string, std::vector<std::string>> groups;
+        const double ms = time_ms([&] {
+            ParallelHashAggregateOperator parallel("morsel_test", table, pipeline, {1}, out, aggs,
+                                                   options);
+            groups = collect_groups(parallel, 1);
+        });
+        EXPECT_EQ(groups, expected) << "dop=" << dop;
+        std::cout << "[Morsel] dop=" << dop << " rows=" << ROWS << " groups=" << groups.size()
+                  << " ms=" << ms << "\n";
+    }
+
+    /* Global aggregate over an empty table still yields one row */
+    {
+        auto empty = std::make_shared<ColumnarTable>("morsel_empty", storage, schema);
+        ASSERT_TRUE(empty->create());
+        ASSERT_TRUE(empty->open());
+        Schema total;
+        total.add_column("rows", common::ValueType::TYPE_INT64);
+        ParallelHashAggregateOperator count("morsel_empty", empty, nullptr, {}, total,
+                                            {{AggregateType::Count, -1}});
+        const auto rows = collect_groups(count, 0);
+        ASSERT_EQ(rows.size(), 1U);
+        EXPECT_EQ(rows.begin()->second, std::vector<std::string>{"0"});
+    }
+
+    /* A failing pipeline reports its error instead of partial results */
+    {
+        ParallelHashAggregateOperator bad("morsel_test", table, pipeline, {1}, out,
+                                          {{AggregateType::Sum, 1}}, options);
+        auto batch = VectorBatch::create(out);
+        EXPECT_FALSE(bad.next_batch(*batch));
+        EXPECT_EQ(bad.state(), ExecState::Error);
+        EXPECT_FALSE(bad.error().empty());
+    }
+}
+
+TEST(AnalyticsTests, VectorizedHeapScan) {
+    for (const char* file : {"heap_scan_test.heap", "heap_scan_test.fsm"}) {
+        std::filesystem::remove(std::filesystem::path("./test_analytics") / file);
+    }
+    StorageManager storage("./test_analytics");
+    BufferPoolManager bpm(config::Config::DEFAULT_BUFFER_POOL_SIZE, storage);
+    Schema schema;
+    schema.add_column("id", common::ValueType::TYPE_INT64);
+    schema.add_column("name", common::ValueType::TYPE_TEXT, true);
+    schema.add_column("score", common::ValueType::TYPE_FLOAT64, true);
+    schema.add_column("flag", common::ValueType::TYPE_BOOL);
+
+    HeapTable heap("heap_scan_test", bpm, schema);
+    ASSERT_TRUE(heap.create());
+    constexpr int64_t ROWS = 3000;
+    for (int64_t i = 0; i < ROWS; ++i) {
+        // Rows 2000.. were inserted by transaction 9, which readers below cannot see
+        const HeapTable::TupleId rid = heap.insert(
+            Tuple({common::Value::make_int64(i),
+                   i % 7 == 0 ? common::Value::make_null()
+                              : common::Value::make_text("n" + std::to_string(i)),
+                   i % 5 == 0 ? common::Value::make_null()
+                              : common::Value::make_float64(static_cast<double>(i) / 4),
+                   common::Value::make_bool(i % 2 == 0)}),
+            i >= 2000 ? 9 : 0);
+        // Transaction 5 deleted every tenth row
+        if (i % 10 == 3) {
+            ASSERT_TRUE(heap.remove(rid, 5));
+        }
+    }
+
+    const auto scan_rows = [&](const transaction::Transaction* txn, size_t* max_batch) {
+        VectorizedHeapScanOperator scan(std::make_unique<HeapTable>("heap_scan_test", bpm, schema),
+                                        txn);
+        EXPECT_EQ(scan.output_schema().get_column(0).name(), "heap_scan_test.id");
+        std::vector<std::string> rows;
+        auto batch = VectorBatch::create(scan.output_schema());
+        while (scan.next_batch(*batch)) {
+            *max_batch = std::max(*max_batch, batch->row_count());
+            for (size_t r = 0; r < batch->row_count(); ++r) {
+                std::string row;
+                for (size_t c = 0; c < batch->column_count(); ++c) {
+                    row += batch->get_column(c).get(r).to_string() + "|";
+                }
+                rows.push_back(row);
+            }
+        }
+        EXPECT_NE(scan.state(), ExecState::Error) << scan.error();
+        return rows;
+    };
+    const auto expected_rows = [&](const auto& visible) {
+        std::vector<std::string> rows;
+        HeapTable::Iterator it = heap.scan();
+        HeapTable::TupleMeta meta;
+        while (it.next_meta(meta)) {
+            if (!visible(meta.xmin, meta.xmax)) continue;
+            std::string row;
+            for (const auto& val : meta.tuple.values()) row += val.to_string() + "|";
+            rows.push_back(row);
+        }
+        return rows;
+    };
+
+    /* Without a transaction only never-deleted tuples are visible */
+    size_t max_batch = 0;
+    const auto active = scan_rows(nullptr, &max_batch);
+    EXPECT_EQ(active, expected_rows([](uint64_t, uint64_t xmax) { return xmax == 0; }));
+    EXPECT_EQ(active.size(), static_cast<size_t>(ROWS - ROWS / 10));
+    EXPECT_EQ(max_batch, 1024U);
+    EXPECT_EQ(active[0], "0|NULL|NULL|TRUE|");
+
+    /* A snapshot taken while 5 and 9 were running still sees the deleted rows */
+    transaction::CommitLog commit_log;
+    for (transaction::txn_id_t id = 1; id < 9; ++id) {
+        if (id != 5) {
+            static_cast<void>(commit_log.commit(id));
+        }
+    }
+    transaction::Transaction reader(7);
+    reader.set_snapshot({commit_log.snapshot(), &commit_log});
+    max_batch = 0;
+    const auto visible = scan_rows(&reader, &max_batch);
+    EXPECT_EQ(visible, expected_rows([&](uint64_t xmin, uint64_t xmax) {
+                  return reader.can_see(xmin, xmax);
+              }));
+    EXPECT_EQ(visible.size(), 2000U);
+    EXPECT_LE(max_batch, 1024U);
+
+    /* ... while transaction 9 sees its own inserts, minus the rows 5 had deleted by then */
+    static_cast<void>(commit_log.commit(5));
+    transaction::Transaction writer(9);
+    writer.set_snapshot({commit_log.snapshot(), &commit_log});
+    EXPECT_EQ(scan_rows(&writer, &max_batch).size(), static_cast<size_t>(ROWS - ROWS / 10));
+
+    /* The vectorized filter and hash aggregate run on top of the heap scan */
+    Schema out;
+    out.add_column("flag", common::ValueType::TYPE_BOOL);
+    out.add_column("rows", common::ValueType::TYPE_INT64);
+    out.add_column("sum_score", common::ValueType::TYPE_FLOAT64);
+    out.add_column("names", common::ValueType::TYPE_INT64);
+    VectorizedHashAggregateOperator agg(
+        std::make_unique<VectorizedFilterOperator>(
+            std::make_unique<VectorizedHeapScanOperator>(
+                std::make_unique<HeapTable>("heap_scan_test", bpm, schema)),
+            bin(col("id"), TokenType::Lt, lit(common::Value::make_int64(1000)))),
+        {3}, out, {{AggregateType::Count, -1}, {AggregateType::Sum, 2}, {AggregateType::Count, 1}});
+    const auto groups = collect_groups(agg, 1);
+    ASSERT_EQ(groups.size(), 2U);
+    int64_t rows[2] = {0, 0};
+    double sums[2] = {0, 0};
+    int64_t names[2] = {0, 0};
+    for (int64_t i = 0; i < 1000; ++i) {
+        if (i % 10 == 3) continue;
+        const int g = i % 2 == 0 ? 1 : 0;
+        rows[g]++;
+        if (i % 5 != 0) sums[g] += static_cast<double>(i) / 4;
+        if (i % 7 != 0) names[g]++;
+    }
+    for (const int g : {0, 1}) {
+        const auto& group = groups.at(g == 1 ? "TRUE|" : "FALSE|");
+        EXPECT_EQ(group[0], std::to_string(rows[g]));
+        EXPECT_NEAR(std::stod(group[1]), sums[g], 1e-6);
+        EXPECT_EQ(group[2], std::to_string(names[g]));
+    }
+
+    /* A batch that does not match the table schema is reported, not misread */
+    VectorizedHeapScanOperator scan(std::make_unique<HeapTable>("heap_scan_test", bpm, schema));
+    auto wrong = VectorBatch::create(out);
+    EXPECT_FALSE(scan.next_batch(*wrong));
+    EXPECT_EQ(scan.state(), ExecState::Error);
+}
+
+TEST(AnalyticsTests, DeltaStore) {
+    StorageManager storage("./test_analytics");
+    Schema schema;
+    schema.add_column("id", common::ValueType::TYPE_INT64);
+    schema.add_column("name", common::ValueType::TYPE_TEXT);
+
+    const auto scan_ids = [](const std::shared_ptr<ColumnarTable>& table) {
+        VectorizedSeqScanOperator scan("delta_test", table);
+        std::vector<int64_t> ids;
+        auto batch = VectorBatch::create(scan.output_schema());
+        while (scan.next_batch(*batch)) {
+            for (size_t r = 0; r < batch->row_count(); ++r) {
+                ids.push_back(batch->get_column(0).get(r).to_int64());
+                EXPECT_EQ(batch->get_column(1).get(r).to_string(),
+                          "n" + std::to_string(ids.back()));
+            }
+        }
+        return ids;
+    };
+    const auto insert = [&schema](ColumnarTable& table, int64_t first, int64_t count) {
+        auto batch = VectorBatch::create(schema);
+        for (int64_t i = first; i < first + count; ++i) {
+            batch->append_tuple(Tuple({common::Value::make_int64(i),
+                                       common::Value::make_text("n" + std::to_string(i))}));
+        }
+        return table.insert_batch(*batch);
+    };
+    const auto expected = [](int64_t count, const std::vector<int64_t>& deleted) {
+        std::vector<int64_t> ids;
+        for (int64_t i = 0; i < count; ++i) {
+            if (std::find(deleted.begin(), deleted.end(), i) == deleted.end()) ids.push_back(i);
+        }
+        return ids;
+    };
+
+    /* Small inserts stay in the logged delta; nothing is encoded yet */
+    auto table = std::make_shared<ColumnarTable>("delta_test", storage, schema);
+    ASSERT_TRUE(table->create());
+    const int64_t rows = ColumnarTable::CHUNK_ROWS + 300;
+    for (int64_t first = 0; first < rows; first += 100) {
+        ASSERT_TRUE(insert(*table, first, std::min<int64_t>(100, rows - first)));
+    }
+    EXPECT_EQ(table->chunk_count(), 0U);
+    EXPECT_EQ(table->delta_rows(), static_cast<uint64_t>(rows));
+    EXPECT_EQ(scan_ids(table), expected(rows, {}));
+
+    /* Deletes mask rows without moving the others */
+    ASSERT_TRUE(table->delete_rows({3, 500, static_cast<uint64_t>(rows) - 1}));
+    EXPECT_FALSE(table->delete_rows({static_cast<uint64_t>(rows)}));
+    const std::vector<int64_t> deleted = {3, 500, rows - 1};
+    EXPECT_EQ(table->deleted_count(), 3U);
+    EXPECT_EQ(scan_ids(table), expected(rows, deleted));
+
+    /* A reopen replays the log */
+    auto reopened = std::make_shared<ColumnarTable>("delta_test", storage, schema);
+    ASSERT_TRUE(reopened->open());
+    EXPECT_EQ(reopened->row_count(), static_cast<uint64_t>(rows));
+    EXPECT_EQ(scan_ids(reopened), expected(rows, deleted));
+    reopened.reset();
+
+    /* Compaction seals whole chunks only; ids and deletes survive it and a reopen */
+    ASSERT_TRUE(table->compact());
+    EXPECT_EQ(table->chunk_count(), 1U);
+    EXPECT_EQ(table->sealed_rows(), static_cast<uint64_t>(ColumnarTable::CHUNK_ROWS));
+    EXPECT_EQ(table->delta_rows(), 300U);
+    EXPECT_EQ(scan_ids(table), expected(rows, deleted));
+    reopened = std::make_shared<ColumnarTable>("delta_test", storage, schema);
+    ASSERT_TRUE(reopened->open());
+    EXPECT_EQ(reopened->sealed_rows(), table->sealed_rows());
+    EXPECT_EQ(reopened->deleted_count(), 3U);
+    EXPECT_EQ(scan_ids(reopened), expected(rows, deleted));
+    reopened.reset();
+
+    /* The background compactor seals a delta once it fills a chunk */
+    ASSERT_TRUE(insert(*table, rows, ColumnarTable::CHUNK_ROWS));
+    DeltaCompactor compactor;
+    compactor.add_table(table);
+    compactor.start({std::chrono::milliseconds(5)});
+    for (int i = 0; i < 400 && compactor.compactions() == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    compactor.stop();
+    EXPECT_EQ(compactor.compactions(), 1U);
+    EXPECT_EQ(table->chunk_count(), 2U);
+    EXPECT_EQ(table->delta_rows(), 300U);
+    EXPECT_EQ(scan_ids(table), expected(rows + ColumnarTable::CHUNK_ROWS, deleted));
+
+    /* A bulk append seals what is left in the delta first */
+    auto bulk = VectorBatch::create(schema);
+    const int64_t total = rows + ColumnarTable::CHUNK_ROWS + 10;
+    for (int64_t i = rows + ColumnarTable::CHUNK_ROWS; i < total; ++i) {
+        bulk->append_tuple(Tuple(
+            {common::Value::make_int64(i), common::Value::make_text("n" + std::to_string(i))}));
+    }
+    ASSERT_TRUE(table->append_batch(*bulk));
+    EXPECT_EQ(table->delta_rows(), 0U);
+    EXPECT_EQ(table->chunk_count(), 4U);
+    EXPECT_EQ(scan_ids(table), expected(total, deleted));
+    reopened = std::make_shared<ColumnarTable>("delta_test", storage, schema);
+    ASSERT_TRUE(reopened->open());
+    EXPECT_EQ(scan_ids(reopened), expected(total, deleted));
+}
+
 }  // namespace
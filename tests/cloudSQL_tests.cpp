@@ -5,30 +5,64 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <exception>
+#include <fstream>
+#include <iostream>
+#include <map>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "catalog/catalog.hpp"
+#include "common/arena.hpp"
+#include "common/cluster_manager.hpp"
 #include "common/config.hpp"
+#include "common/metrics.hpp"
+#include "common/trace.hpp"
 #include "common/value.hpp"
+#include "executor/columnar_replica.hpp"
+#include "executor/compiled_expression.hpp"
+#include "executor/copy_decoder.hpp"
+#include "executor/cost_model.hpp"
+#include "executor/explain.hpp"
+#include "executor/index_build.hpp"
+#include "executor/parallel_scan.hpp"
+#include "executor/plan_cache.hpp"
 #include "executor/query_executor.hpp"
+#include "executor/result_cache.hpp"
+#include "executor/runtime_filter.hpp"
+#include "executor/statistics.hpp"
+#include "executor/thread_pool.hpp"
 #include "executor/types.hpp"
 #include "parser/expression.hpp"
 #include "parser/lexer.hpp"
 #include "parser/parser.hpp"
 #include "parser/statement.hpp"
 #include "parser/token.hpp"
+#include "storage/brin_index.hpp"
 #include "storage/btree_index.hpp"
 #include "storage/buffer_pool_manager.hpp"
+#include "storage/columnar_table.hpp"
+#include "storage/free_space_map.hpp"
+#include "storage/hash_index.hpp"
 #include "storage/heap_table.hpp"
+#include "storage/io_backend.hpp"
+#include "storage/page.hpp"
 #include "storage/storage_manager.hpp"
 #include "transaction/lock_manager.hpp"
 #include "transaction/transaction_manager.hpp"
+#include "transaction/vacuum_manager.hpp"
 
 using namespace cloudsql;
 using namespace cloudsql::common;
@@ -75,6 +109,72 @@ TEST(CloudSQLTests, ValueTypeVariety) {
     EXPECT_STREQ(s.as_text().c_str(), "cloudSQL");
 }
 
+TEST(CloudSQLTests, ValueCompactText) {
+    EXPECT_EQ(sizeof(Value), 16U);
+
+    const std::string short_text(Value::INLINE_TEXT_CAPACITY, 's');
+    const std::string long_text(Value::INLINE_TEXT_CAPACITY + 1, 'l');
+    const Value small = Value::make_text(short_text);
+    const Value large = Value::make_text(long_text);
+    EXPECT_EQ(small.heap_bytes(), 0U);
+    EXPECT_EQ(large.heap_bytes(), long_text.size());
+    EXPECT_EQ(small.text_view(), short_text);
+    EXPECT_EQ(large.as_text(), long_text);
+    EXPECT_THROW(static_cast<void>(Value::make_int64(1).text_view()), std::runtime_error);
+
+    /* Copies own their text; moves hand it over and leave NULL behind */
+    Value copy = large;
+    EXPECT_NE(copy.text_view().data(), large.text_view().data());
+    EXPECT_EQ(copy, large);
+    EXPECT_EQ(Value::Hash{}(copy), Value::Hash{}(large));
+    Value moved = std::move(copy);
+    EXPECT_EQ(moved, large);
+    EXPECT_TRUE(copy.is_null());  // NOLINT(bugprone-use-after-move)
+
+    moved = small;
+    EXPECT_EQ(moved, small);
+    moved.swap(copy);
+    EXPECT_TRUE(moved.is_null());
+    EXPECT_EQ(copy, small);
+    EXPECT_LT(large, small);  // "lll..." < "sss..."
+
+    EXPECT_EQ(Value(ValueType::TYPE_VARCHAR).text_view(), "");
+    EXPECT_EQ(Value::make_float64(2.5).to_string(), "2.5");
+    EXPECT_EQ(Value(static_cast<int32_t>(7)), Value::make_float64(7.0));
+}
+
+TEST(CloudSQLTests, ArenaBackedResults) {
+    Arena arena(1024);
+    void* const first = arena.allocate(100, 8);
+    static_cast<void>(arena.allocate(4000, 16)); /* Larger than a block */
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(first) % 8, 0U);
+    EXPECT_EQ(arena.bytes_used(), 4100U);
+    EXPECT_GE(arena.bytes_reserved(), 5000U);
+    arena.reset();
+    EXPECT_EQ(arena.bytes_used(), 0U);
+    EXPECT_GE(arena.bytes_reserved(), 4000U);
+    EXPECT_LT(arena.bytes_reserved(), 5000U); /* Only the largest block is kept */
+
+    const std::string long_text(40, 'x');
+    QueryResult copied;
+    {
+        QueryResult result;
+        result.set_arena(std::make_shared<Arena>());
+        Tuple row({Value::make_int64(1), Value::make_text(long_text)});
+        for (int i = 0; i < 1000; ++i) {
+            row.values()[0] = Value::make_int64(i);
+            result.add_row(row);
+        }
+        ASSERT_EQ(result.row_count(), 1000U);
+        EXPECT_EQ(result.rows()[999].get(0).to_int64(), 999);
+        copied = result;
+    }
+    /* A copied result owns heap rows and outlives the original and its arena */
+    ASSERT_EQ(copied.row_count(), 1000U);
+    EXPECT_EQ(copied.rows()[500].get(0).to_int64(), 500);
+    EXPECT_EQ(copied.rows()[500].get(1).text_view(), long_text);
+}
+
 // ============= Parser Tests =============
 
 TEST(CloudSQLTests, ParserExpressions) {
@@ -167,6 +267,9 @@ TEST(CloudSQLTests, ConfigBasic) {
 
     cfg.port = PORT_9999;
     cfg.data_dir = "./tmp_data";
+    cfg.parallelism = 4;
+    cfg.scan_workers = 3;
+    cfg.replica_max_lag_ms = 250;
 
     EXPECT_TRUE(cfg.validate());
 
@@ -177,6 +280,12 @@ TEST(CloudSQLTests, ConfigBasic) {
     EXPECT_TRUE(cfg2.load(cfg_file));
     EXPECT_EQ(cfg2.port, PORT_9999);
     EXPECT_STREQ(cfg2.data_dir.c_str(), "./tmp_data");
+    EXPECT_EQ(cfg2.parallelism, 4);
+    EXPECT_EQ(cfg2.scan_workers, 3);
+    EXPECT_EQ(cfg2.replica_max_lag_ms, 250);
+
+    cfg2.parallelism = -1;
+    EXPECT_FALSE(cfg2.validate());
 
     static_cast<void>(std::remove(cfg_file.c_str()));
 }
@@ -235,6 +344,522 @@ TEST(CloudSQLTests, StorageDelete) {
     static_cast<void>(std::remove(filepath.c_str()));
 }
 
+TEST(CloudSQLTests, StorageBinaryTupleRoundTrip) {
+    const std::string filename = "binary_tuple_test";
+    const std::string filepath = "./test_data/" + filename + ".heap";
+    static_cast<void>(std::remove(filepath.c_str()));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    Schema schema;
+    schema.add_column("id", ValueType::TYPE_INT64);
+    schema.add_column("name", ValueType::TYPE_TEXT);
+    schema.add_column("score", ValueType::TYPE_FLOAT64);
+    schema.add_column("active", ValueType::TYPE_BOOL);
+    HeapTable table(filename, sm, schema);
+    ASSERT_TRUE(table.create());
+
+    const auto tid = table.insert(
+        Tuple({Value::make_int64(-VAL_42), Value::make_text("pipe|inside"),
+               Value::make_float64(VAL_1_5), Value::make_bool(true)}),
+        7);
+    const auto tid_null = table.insert(
+        Tuple({Value::make_int64(VAL_1), Value::make_null(), Value::make_null(),
+               Value::make_bool(false)}));
+
+    HeapTable::TupleMeta meta;
+    ASSERT_TRUE(table.get_meta(tid, meta));
+    EXPECT_EQ(meta.xmin, 7U);
+    EXPECT_EQ(meta.xmax, 0U);
+    EXPECT_EQ(meta.tuple.get(0).to_int64(), -VAL_42);
+    EXPECT_STREQ(meta.tuple.get(1).as_text().c_str(), "pipe|inside");
+    EXPECT_DOUBLE_EQ(meta.tuple.get(2).to_float64(), VAL_1_5);
+    EXPECT_TRUE(meta.tuple.get(3).as_bool());
+
+    ASSERT_TRUE(table.get_meta(tid_null, meta));
+    EXPECT_TRUE(meta.tuple.get(1).is_null());
+    EXPECT_TRUE(meta.tuple.get(2).is_null());
+    EXPECT_FALSE(meta.tuple.get(3).as_bool());
+
+    /* xmax is patched in place */
+    EXPECT_TRUE(table.remove(tid, 99));
+    ASSERT_TRUE(table.get_meta(tid, meta));
+    EXPECT_EQ(meta.xmax, 99U);
+    EXPECT_TRUE(table.undo_remove(tid));
+    EXPECT_EQ(table.tuple_count(), 2U);
+    static_cast<void>(std::remove(filepath.c_str()));
+}
+
+TEST(CloudSQLTests, StorageBinaryPageDensity) {
+    const std::string filename = "binary_density_test";
+    const std::string filepath = "./test_data/" + filename + ".heap";
+    static_cast<void>(std::remove(filepath.c_str()));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    Schema schema;
+    schema.add_column("id", ValueType::TYPE_INT64);
+    HeapTable table(filename, sm, schema);
+    ASSERT_TRUE(table.create());
+
+    /* The legacy layout capped pages at 64 slots; an int64 row now takes 31 bytes */
+    constexpr int64_t ROWS = 100;
+    HeapTable::TupleId last;
+    for (int64_t i = 0; i < ROWS; ++i) {
+        last = table.insert(Tuple({Value::make_int64(i)}));
+    }
+    EXPECT_EQ(last.page_num, 0U);
+    EXPECT_EQ(table.tuple_count(), static_cast<uint64_t>(ROWS));
+
+    auto iter = table.scan();
+    Tuple t;
+    int64_t expected = 0;
+    while (iter.next(t)) {
+        EXPECT_EQ(t.get(0).to_int64(), expected++);
+    }
+    EXPECT_EQ(expected, ROWS);
+    static_cast<void>(std::remove(filepath.c_str()));
+}
+
+TEST(CloudSQLTests, StorageScanReadAhead) {
+    const std::string filename = "read_ahead_test";
+    const std::string filepath = "./test_data/" + filename + ".heap";
+    static_cast<void>(std::remove(filepath.c_str()));
+    StorageManager disk_manager("./test_data");
+    Schema schema;
+    schema.add_column("id", ValueType::TYPE_INT64);
+    schema.add_column("pad", ValueType::TYPE_TEXT);
+
+    constexpr int64_t ROWS = 2000;
+    const std::string pad(100, 'p');
+    {
+        BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+        HeapTable table(filename, sm, schema);
+        ASSERT_TRUE(table.create());
+        for (int64_t i = 0; i < ROWS; ++i) {
+            static_cast<void>(table.insert(Tuple({Value::make_int64(i), Value::make_text(pad)})));
+        }
+    }
+
+    /* Cold pool: the scan must see every row exactly once while read-ahead runs beside it */
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    HeapTable table(filename, sm, schema);
+    auto iter = table.scan();
+    Tuple t;
+    int64_t expected = 0;
+    while (iter.next(t)) {
+        EXPECT_EQ(t.get(0).to_int64(), expected++);
+    }
+    EXPECT_EQ(expected, ROWS);
+    EXPECT_GT(iter.current_id().page_num, 8U);
+
+    sm.wait_for_prefetch();
+    const auto& stats = sm.get_stats();
+    EXPECT_LE(stats.prefetch_hits.load(), stats.prefetched.load());
+    static_cast<void>(std::remove(filepath.c_str()));
+}
+
+TEST(CloudSQLTests, StorageFreeSpaceMap) {
+    static_cast<void>(std::remove("./test_data/fsm_unit.fsm"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    FreeSpaceMap fsm("fsm_unit.fsm", sm);
+
+    EXPECT_EQ(fsm.page_count(), 0U);
+    EXPECT_EQ(fsm.find_page(10), FreeSpaceMap::INVALID_PAGE);
+
+    for (uint32_t i = 0; i < 10; ++i) {
+        fsm.record(i, 20);
+    }
+    fsm.record(7, 1000);
+    EXPECT_EQ(fsm.page_count(), 10U);
+    EXPECT_EQ(fsm.find_page(500), 7U);
+    EXPECT_EQ(fsm.find_page(16), 7U); /* Next-fit resumes at the last hit */
+    EXPECT_EQ(fsm.find_page(2000), FreeSpaceMap::INVALID_PAGE);
+
+    /* Categories round down, so the map never promises more than the page has */
+    fsm.record(7, 40);
+    EXPECT_EQ(fsm.find_page(32), 7U);
+    EXPECT_EQ(fsm.find_page(40), FreeSpaceMap::INVALID_PAGE);
+
+    /* Pages on the second map page are found too */
+    const auto far = static_cast<uint32_t>(fsm.entries_per_page() + 5);
+    fsm.record(far, 3000);
+    EXPECT_EQ(fsm.page_count(), far + 1);
+    EXPECT_EQ(fsm.find_page(2500), far);
+
+    fsm.reset();
+    EXPECT_EQ(fsm.page_count(), 0U);
+    EXPECT_EQ(fsm.find_page(10), FreeSpaceMap::INVALID_PAGE);
+    static_cast<void>(std::remove("./test_data/fsm_unit.fsm"));
+}
+
+TEST(CloudSQLTests, StorageInsertUsesFreeSpaceMap) {
+    const std::string filename = "fsm_insert_test";
+    const std::string filepath = "./test_data/" + filename + ".heap";
+    static_cast<void>(std::remove(filepath.c_str()));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    Schema schema;
+    schema.add_column("id", ValueType::TYPE_INT64);
+    schema.add_column("pad", ValueType::TYPE_TEXT);
+    HeapTable table(filename, sm, schema);
+    ASSERT_TRUE(table.create());
+
+    /* Two rows fill a page, so every page but the newest is full */
+    const std::string pad(1900, 'p');
+    constexpr int64_t ROWS = 40;
+    HeapTable::TupleId early;
+    HeapTable::TupleId last;
+    for (int64_t i = 0; i < ROWS; ++i) {
+        last = table.insert(Tuple({Value::make_int64(i), Value::make_text(pad)}));
+        if (i == 2) {
+            early = last;
+        }
+    }
+    ASSERT_EQ(last.page_num, static_cast<uint32_t>(ROWS / 2 - 1));
+    ASSERT_EQ(early.page_num, 1U);
+
+    /* Appending touches a bounded number of pages, not the whole chain */
+    const uint64_t before = sm.get_stats().hits.load() + sm.get_stats().misses.load();
+    const HeapTable::TupleId appended =
+        table.insert(Tuple({Value::make_int64(ROWS), Value::make_text(pad)}));
+    const uint64_t fetches = sm.get_stats().hits.load() + sm.get_stats().misses.load() - before;
+    EXPECT_EQ(appended.page_num, last.page_num + 1);
+    EXPECT_LE(fetches, 8U);
+
+    /* Fill the new tail page, then roll back an insert on an early page: its space is reused */
+    EXPECT_EQ(table.insert(Tuple({Value::make_int64(ROWS + 1), Value::make_text(pad)})).page_num,
+              appended.page_num);
+    ASSERT_TRUE(table.physical_remove(early));
+    const HeapTable::TupleId reused =
+        table.insert(Tuple({Value::make_int64(999), Value::make_text(pad)}));
+    EXPECT_EQ(reused.page_num, early.page_num);
+
+    Tuple t;
+    EXPECT_TRUE(table.get(reused, t));
+    EXPECT_EQ(t.get(0).to_int64(), 999);
+    EXPECT_TRUE(table.get(HeapTable::TupleId(early.page_num, early.slot_num + 1), t));
+    EXPECT_EQ(t.get(0).to_int64(), 3);
+    EXPECT_EQ(table.tuple_count(), static_cast<uint64_t>(ROWS + 2));
+    static_cast<void>(std::remove(filepath.c_str()));
+    static_cast<void>(std::remove(("./test_data/" + filename + ".fsm").c_str()));
+}
+
+TEST(CloudSQLTests, StorageInsertBatch) {
+    const std::string filename = "batch_insert_test";
+    static_cast<void>(std::remove(("./test_data/" + filename + ".heap").c_str()));
+    static_cast<void>(std::remove(("./test_data/" + filename + ".fsm").c_str()));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    Schema schema;
+    schema.add_column("id", ValueType::TYPE_INT64);
+    schema.add_column("pad", ValueType::TYPE_TEXT);
+    HeapTable table(filename, sm, schema);
+    ASSERT_TRUE(table.create());
+
+    /* Three rows fit a page: the batch fills pages in order */
+    const std::string pad(1200, 'p');
+    std::vector<Tuple> rows;
+    for (int64_t i = 0; i < 10; ++i) {
+        rows.push_back(Tuple({Value::make_int64(i), Value::make_text(pad)}));
+    }
+    const auto ids = table.insert_batch(rows, 7);
+    ASSERT_EQ(ids.size(), rows.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        EXPECT_EQ(ids[i].page_num, i / 3);
+        EXPECT_EQ(ids[i].slot_num, i % 3);
+        HeapTable::TupleMeta meta;
+        ASSERT_TRUE(table.get_meta(ids[i], meta));
+        EXPECT_EQ(meta.tuple.get(0).to_int64(), static_cast<int64_t>(i));
+        EXPECT_EQ(meta.xmin, 7U);
+    }
+
+    /* The next batch tops up the partly filled last page first */
+    const auto more = table.insert_batch({Tuple({Value::make_int64(10), Value::make_text(pad)})});
+    ASSERT_EQ(more.size(), 1U);
+    EXPECT_EQ(more[0].page_num, 3U);
+    EXPECT_EQ(more[0].slot_num, 1U);
+
+    /* A record too large for a page stops the batch there */
+    const auto stopped = table.insert_batch(
+        {Tuple({Value::make_int64(11), Value::make_text("x")}),
+         Tuple({Value::make_int64(12),
+                Value::make_text(std::string(Page::DEFAULT_PAGE_SIZE, 'x'))}),
+         Tuple({Value::make_int64(13), Value::make_text("x")})});
+    EXPECT_EQ(stopped.size(), 1U);
+    EXPECT_EQ(table.tuple_count(), 12U);
+    static_cast<void>(std::remove(("./test_data/" + filename + ".heap").c_str()));
+    static_cast<void>(std::remove(("./test_data/" + filename + ".fsm").c_str()));
+}
+
+TEST(CloudSQLTests, StorageReadColumns) {
+    const std::string filename = "read_columns_test";
+    static_cast<void>(std::remove(("./test_data/" + filename + ".heap").c_str()));
+    static_cast<void>(std::remove(("./test_data/" + filename + ".fsm").c_str()));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    Schema schema;
+    schema.add_column("id", ValueType::TYPE_INT64);
+    schema.add_column("name", ValueType::TYPE_TEXT);
+    schema.add_column("score", ValueType::TYPE_FLOAT64);
+    schema.add_column("note", ValueType::TYPE_TEXT);
+    HeapTable table(filename, sm, schema);
+    ASSERT_TRUE(table.create());
+    const auto rid = table.insert(Tuple({Value::make_int64(1), Value::make_text("a"),
+                                         Value::make_float64(VAL_1_5), Value::make_text("n")}),
+                                  3);
+    static_cast<void>(table.remove(table.insert(Tuple({Value::make_int64(2), Value::make_text("b"),
+                                                       Value::make_null(), Value::make_text("m")})),
+                                   4));
+
+    /* Columns that are not read come back NULL; MVCC headers are still decoded */
+    table.set_read_columns({false, true, false, true});
+    HeapTable::TupleMeta meta;
+    ASSERT_TRUE(table.get_meta(rid, meta));
+    ASSERT_EQ(meta.tuple.size(), 4U);
+    EXPECT_TRUE(meta.tuple.get(0).is_null());
+    EXPECT_EQ(meta.tuple.get(1).to_string(), "a");
+    EXPECT_TRUE(meta.tuple.get(2).is_null());
+    EXPECT_EQ(meta.tuple.get(3).to_string(), "n");
+    EXPECT_EQ(meta.xmin, 3U);
+
+    auto iter = table.scan();
+    ASSERT_TRUE(iter.next_meta(meta));
+    EXPECT_TRUE(meta.tuple.get(0).is_null());
+    ASSERT_TRUE(iter.next_meta(meta));
+    EXPECT_EQ(meta.tuple.get(1).to_string(), "b");
+    EXPECT_EQ(meta.xmax, 4U);
+    EXPECT_EQ(table.tuple_count(), 1U);
+
+    table.set_read_columns({});
+    ASSERT_TRUE(table.get_meta(rid, meta));
+    EXPECT_EQ(meta.tuple.get(0).to_int64(), 1);
+    EXPECT_DOUBLE_EQ(meta.tuple.get(2).to_float64(), VAL_1_5);
+    static_cast<void>(std::remove(("./test_data/" + filename + ".heap").c_str()));
+    static_cast<void>(std::remove(("./test_data/" + filename + ".fsm").c_str()));
+}
+
+TEST(CloudSQLTests, StorageLegacyTextPageReadable) {
+    const std::string filename = "legacy_page_test";
+    const std::string filepath = "./test_data/" + filename + ".heap";
+    static_cast<void>(std::remove(filepath.c_str()));
+
+    /* Hand-build a page in the pre-binary text layout (flags == 0, 64 fixed slots) */
+    {
+        StorageManager disk_manager("./test_data");
+        std::array<char, Page::DEFAULT_PAGE_SIZE> page{};
+        const std::string rec = "5|0|17|legacy|";
+        HeapTable::PageHeader header{};
+        header.num_slots = 1;
+        const auto data_off = static_cast<uint16_t>(sizeof(HeapTable::PageHeader) + 64 * 2);
+        header.free_space_offset = static_cast<uint16_t>(data_off + rec.size() + 1);
+        std::memcpy(page.data(), &header, sizeof(header));
+        std::memcpy(page.data() + sizeof(header), &data_off, sizeof(data_off));
+        std::memcpy(page.data() + data_off, rec.c_str(), rec.size() + 1);
+        ASSERT_TRUE(disk_manager.write_page(filename + ".heap", 0, page.data()));
+    }
+
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    Schema schema;
+    schema.add_column("id", ValueType::TYPE_INT64);
+    schema.add_column("tag", ValueType::TYPE_TEXT);
+    HeapTable table(filename, sm, schema);
+
+    HeapTable::TupleMeta meta;
+    ASSERT_TRUE(table.get_meta(HeapTable::TupleId(0, 0), meta));
+    EXPECT_EQ(meta.xmin, 5U);
+    EXPECT_EQ(meta.tuple.get(0).to_int64(), 17);
+    EXPECT_STREQ(meta.tuple.get(1).as_text().c_str(), "legacy");
+
+    /* New rows go to a fresh binary page; the legacy row stays deletable */
+    const auto tid = table.insert(Tuple({Value::make_int64(VAL_2), Value::make_text("new")}));
+    EXPECT_EQ(tid.page_num, 1U);
+    EXPECT_TRUE(table.remove(HeapTable::TupleId(0, 0), 12345));
+    EXPECT_EQ(table.tuple_count(), 1U);
+    static_cast<void>(std::remove(filepath.c_str()));
+}
+
+TEST(CloudSQLTests, StorageConfigurablePageSize) {
+    const std::string dir = "./test_data/page_16k";
+    for (const char* file : {StorageManager::CONTROL_FILE, "wide.heap", "wide.fsm", "wide_k.idx"}) {
+        static_cast<void>(std::remove((dir + "/" + file).c_str()));
+    }
+    constexpr uint32_t PAGE = 16384;
+    Schema schema;
+    schema.add_column("id", ValueType::TYPE_INT64);
+    schema.add_column("payload", ValueType::TYPE_TEXT);
+    const std::string payload(10000, 'w');
+    HeapTable::TupleId tid;
+    {
+        StorageManager disk_manager(dir, IoBackendType::Posix, false, PAGE);
+        EXPECT_EQ(disk_manager.page_size(), PAGE);
+        BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+        EXPECT_EQ(sm.page_size(), PAGE);
+
+        /* A row larger than a default page fits on one of these */
+        HeapTable table("wide", sm, schema);
+        ASSERT_TRUE(table.create());
+        tid = table.insert(Tuple({Value::make_int64(1), Value::make_text(payload)}));
+        Tuple row;
+        ASSERT_TRUE(table.get(tid, row));
+        EXPECT_EQ(row.get(1).as_text().size(), payload.size());
+        EXPECT_EQ(FreeSpaceMap("wide.fsm", sm).granule(), PAGE / 256);
+
+        /* Fan-out follows the page: 600 keys split a default-size leaf but not this one */
+        BTreeIndex idx("wide_k", sm, ValueType::TYPE_INT64);
+        ASSERT_TRUE(idx.create());
+        for (int i = 0; i < 600; ++i) {
+            ASSERT_TRUE(idx.insert(Value::make_int64(i), HeapTable::TupleId(1, 1)));
+        }
+        EXPECT_EQ(idx.height(), 1U);
+        EXPECT_EQ(idx.search(Value::make_int64(599)).size(), 1U);
+
+        const ColumnarTable columns("wide_col", disk_manager, schema);
+        EXPECT_EQ(columns.chunk_rows(), ColumnarTable::CHUNK_ROWS * (PAGE / Page::DEFAULT_PAGE_SIZE));
+        sm.flush_all_pages();
+    }
+
+    /* The size belongs to the database: reopening keeps it whatever is asked for */
+    StorageManager disk_manager(dir, IoBackendType::Posix, false, Page::DEFAULT_PAGE_SIZE);
+    EXPECT_EQ(disk_manager.page_size(), PAGE);
+    EXPECT_EQ(disk_manager.page_count("wide.heap"), 1U);
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    const HeapTable table("wide", sm, schema);
+    Tuple row;
+    ASSERT_TRUE(table.get(tid, row));
+    EXPECT_EQ(row.get(1).as_text(), payload);
+
+    /* Directories written before sizes were recorded keep default pages */
+    const std::string legacy_dir = "./test_data/page_legacy";
+    static_cast<void>(std::remove((legacy_dir + "/" + StorageManager::CONTROL_FILE).c_str()));
+    {
+        const StorageManager create(legacy_dir);
+        std::ofstream(legacy_dir + "/old.heap").put('x');
+    }
+    static_cast<void>(std::remove((legacy_dir + "/" + StorageManager::CONTROL_FILE).c_str()));
+    EXPECT_EQ(StorageManager(legacy_dir, IoBackendType::Posix, false, PAGE).page_size(),
+              Page::DEFAULT_PAGE_SIZE);
+    EXPECT_EQ(StorageManager("./test_data/page_bad", IoBackendType::Posix, false, 5000).page_size(),
+              Page::DEFAULT_PAGE_SIZE);
+}
+
+TEST(CloudSQLTests, StorageCompressedPages) {
+    const std::string dir = "./test_data/compressed";
+    for (const std::string file : {"c.heap", "c.heap.pmap", "c.fsm", "raw.heap"}) {
+        static_cast<void>(std::remove((dir + "/" + file).c_str()));
+    }
+    Schema schema;
+    schema.add_column("id", ValueType::TYPE_INT64);
+    schema.add_column("note", ValueType::TYPE_TEXT);
+    std::vector<HeapTable::TupleId> tids;
+    {
+        StorageManager disk_manager(dir);
+        ASSERT_TRUE(disk_manager.set_compression("c.heap", PageCompression::Lz4));
+        BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+        HeapTable table("c", sm, schema);
+        ASSERT_TRUE(table.create());
+        for (int64_t i = 0; i < 2000; ++i) {
+            tids.push_back(table.insert(
+                Tuple({Value::make_int64(i), Value::make_text("status=open region=emea")})));
+        }
+        sm.flush_all_pages();
+
+        /* Repetitive rows shrink well below a page each */
+        const auto& stats = disk_manager.get_stats();
+        ASSERT_GT(stats.pages_written.load(), 1U);
+        EXPECT_LT(stats.bytes_written.load(),
+                  stats.pages_written.load() * disk_manager.page_size() / 2);
+        EXPECT_GT(stats.compression_saved_bytes.load(), 0U);
+        EXPECT_FALSE(disk_manager.set_compression("c.heap", PageCompression::None));
+    }
+
+    /* The layout survives a restart, and pages come back whole */
+    StorageManager disk_manager(dir);
+    EXPECT_EQ(disk_manager.compression("c.heap"), PageCompression::Lz4);
+    EXPECT_EQ(disk_manager.compression("raw.heap"), PageCompression::None);
+    EXPECT_GT(disk_manager.page_count("c.heap"), 1U);
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    const HeapTable table("c", sm, schema);
+    for (size_t i = 0; i < tids.size(); i += 97) {
+        Tuple row;
+        ASSERT_TRUE(table.get(tids[i], row));
+        EXPECT_EQ(row.get(0).as_int64(), static_cast<int64_t>(i));
+    }
+
+    /* A page that stops compressing moves to a larger extent; unwritten pages read as zero */
+    std::vector<char> noise(disk_manager.page_size());
+    uint32_t seed = 7;
+    for (auto& byte : noise) {
+        seed = seed * 1103515245U + 12345U;
+        byte = static_cast<char>(seed >> 24);
+    }
+    const uint32_t page = disk_manager.page_count("c.heap");
+    std::vector<char> back(disk_manager.page_size(), 'x');
+    ASSERT_TRUE(disk_manager.read_page("c.heap", page + 3, back.data()));
+    EXPECT_TRUE(std::all_of(back.begin(), back.end(), [](char c) { return c == 0; }));
+    std::vector<char> zeros(disk_manager.page_size(), 0);
+    ASSERT_TRUE(disk_manager.write_page("c.heap", page, zeros.data()));
+    ASSERT_TRUE(disk_manager.write_page("c.heap", page, noise.data()));
+    ASSERT_TRUE(disk_manager.read_page("c.heap", page, back.data()));
+    EXPECT_EQ(back, noise);
+    ASSERT_TRUE(disk_manager.write_page("c.heap", page, zeros.data()));
+    ASSERT_TRUE(disk_manager.read_page("c.heap", page, back.data()));
+    EXPECT_EQ(back, zeros);
+
+    ASSERT_TRUE(disk_manager.truncate_file("c.heap"));
+    EXPECT_EQ(disk_manager.page_count("c.heap"), 0U);
+}
+
+TEST(ExecutionTests, CreateTableWithCompression) {
+    const std::string dir = "./test_data/compressed_sql";
+    for (const std::string file :
+         {"ct.heap", "ct.heap.pmap", "ct.fsm", "ct_id.idx", "ct_id.idx.pmap", "ct_dim.heap",
+          "ct_dim.heap.pmap", "ct_dim.fsm"}) {
+        static_cast<void>(std::remove((dir + "/" + file).c_str()));
+    }
+    StorageManager disk_manager(dir);
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+    const auto run = [&exec](const std::string& sql) {
+        return exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+    };
+
+    auto stmt = Parser(std::make_unique<Lexer>(
+                           "CREATE TABLE ct (id BIGINT, note TEXT) WITH (COMPRESSION = lz4)"))
+                    .parse_statement();
+    ASSERT_NE(stmt, nullptr);
+    EXPECT_EQ(stmt->to_string(), "CREATE TABLE ct (id BIGINT, note TEXT) WITH (COMPRESSION = lz4)");
+    ASSERT_TRUE(exec.execute(*stmt).success());
+    EXPECT_EQ(disk_manager.compression("ct.heap"), PageCompression::Lz4);
+    ASSERT_TRUE(run("INSERT INTO ct VALUES (1, 'a'), (2, 'b'), (3, 'c')").success());
+
+    /* Indexes follow their table */
+    ASSERT_TRUE(run("CREATE INDEX ct_id ON ct (id)").success());
+    EXPECT_EQ(disk_manager.compression("ct_id.idx"), PageCompression::Lz4);
+    const auto res = run("SELECT note FROM ct WHERE id = 2");
+    ASSERT_TRUE(res.success());
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_EQ(res.rows()[0].get(0).to_string(), "b");
+
+    EXPECT_FALSE(run("CREATE TABLE ct_bad (id INT) WITH (COMPRESSION = zip)").success());
+
+    /* Distribution is a table option too; the catalog records it */
+    const std::string replicated_sql =
+        "CREATE TABLE ct_dim (id INT) WITH (COMPRESSION = lz4, DISTRIBUTION = REPLICATED)";
+    stmt = Parser(std::make_unique<Lexer>(replicated_sql)).parse_statement();
+    ASSERT_NE(stmt, nullptr);
+    EXPECT_EQ(stmt->to_string(), replicated_sql);
+    ASSERT_TRUE(exec.execute(*stmt).success());
+    EXPECT_TRUE((*catalog->get_table_by_name("ct_dim"))->replicated());
+    EXPECT_FALSE((*catalog->get_table_by_name("ct"))->replicated());
+    EXPECT_EQ(Parser(std::make_unique<Lexer>("CREATE TABLE t (id INT) WITH (FILLFACTOR = 50)"))
+                  .parse_statement(),
+              nullptr);
+}
+
 // ============= Index Tests =============
 
 TEST(IndexTests, BTreeBasic) {
@@ -270,10 +895,1985 @@ TEST(IndexTests, Scan) {
     static_cast<void>(idx.drop());
 }
 
-// ============= Execution Tests =============
+namespace {
+/* Zero-padded so lexical order matches numeric order and few keys fit per node */
+std::string wide_key(int i) {
+    std::string digits = std::to_string(i);
+    return std::string(200 - digits.size(), '0') + digits;
+}
+}  // namespace
+
+TEST(IndexTests, MultiLevelSplits) {
+    static_cast<void>(std::remove("./test_data/idx_multi.idx"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    BTreeIndex idx("idx_multi", sm, ValueType::TYPE_TEXT);
+    ASSERT_TRUE(idx.create());
+
+    constexpr int ROWS = 3000;
+    /* Insert in a scrambled order so splits happen all over the tree */
+    for (int i = 0; i < ROWS; ++i) {
+        const int k = (i * 7919) % ROWS;
+        ASSERT_TRUE(idx.insert(Value::make_text(wide_key(k)),
+                               HeapTable::TupleId(static_cast<uint32_t>(k), 1)));
+    }
+    EXPECT_GT(idx.height(), 2U);
+
+    for (int k = 0; k < ROWS; k += 97) {
+        const auto res = idx.search(Value::make_text(wide_key(k)));
+        ASSERT_EQ(res.size(), 1U);
+        EXPECT_EQ(res[0].page_num, static_cast<uint32_t>(k));
+    }
+    EXPECT_TRUE(idx.search(Value::make_text(wide_key(ROWS))).empty());
+
+    auto iter = idx.scan();
+    BTreeIndex::Entry entry;
+    int expected = 0;
+    while (iter.next(entry)) {
+        ASSERT_EQ(entry.key.to_string(), wide_key(expected));
+        expected++;
+    }
+    EXPECT_EQ(expected, ROWS);
+    static_cast<void>(idx.drop());
+}
+
+TEST(IndexTests, DeleteMergesAndShrinks) {
+    static_cast<void>(std::remove("./test_data/idx_shrink.idx"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    BTreeIndex idx("idx_shrink", sm, ValueType::TYPE_TEXT);
+    ASSERT_TRUE(idx.create());
+
+    constexpr int ROWS = 2000;
+    for (int k = 0; k < ROWS; ++k) {
+        ASSERT_TRUE(idx.insert(Value::make_text(wide_key(k)), HeapTable::TupleId(1, 1)));
+    }
+    const uint32_t full_height = idx.height();
+    ASSERT_GT(full_height, 2U);
+
+    /* Keep every 50th key; the rest of the tree has to collapse around them */
+    for (int k = 0; k < ROWS; ++k) {
+        if (k % 50 != 0) {
+            ASSERT_TRUE(idx.remove(Value::make_text(wide_key(k)), HeapTable::TupleId(1, 1)));
+        }
+    }
+    EXPECT_LT(idx.height(), full_height);
+    /* Removing an absent entry is a no-op */
+    EXPECT_TRUE(idx.remove(Value::make_text(wide_key(1)), HeapTable::TupleId(1, 1)));
+
+    auto iter = idx.scan();
+    BTreeIndex::Entry entry;
+    int seen = 0;
+    while (iter.next(entry)) {
+        ASSERT_EQ(entry.key.to_string(), wide_key(seen * 50));
+        seen++;
+    }
+    EXPECT_EQ(seen, ROWS / 50);
+
+    /* Freed pages are reused by later splits */
+    for (int k = 0; k < ROWS; ++k) {
+        if (k % 50 != 0) {
+            ASSERT_TRUE(idx.insert(Value::make_text(wide_key(k)), HeapTable::TupleId(1, 1)));
+        }
+    }
+    EXPECT_EQ(idx.search(Value::make_text(wide_key(1234))).size(), 1U);
+    static_cast<void>(idx.drop());
+}
+
+TEST(IndexTests, BulkLoadMatchesInserts) {
+    static_cast<void>(std::remove("./test_data/idx_bulk.idx"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    BTreeIndex idx("idx_bulk", sm, ValueType::TYPE_INT64);
+    ASSERT_TRUE(idx.create());
+
+    constexpr int ROWS = 5000;
+    std::vector<BTreeIndex::Entry> entries;
+    for (int i = ROWS - 1; i >= 0; --i) {
+        /* Two entries per key to exercise duplicates across leaf boundaries */
+        entries.emplace_back(Value::make_int64(i / 2), HeapTable::TupleId(i, 0));
+    }
+    ASSERT_TRUE(idx.bulk_load(std::move(entries)));
+    EXPECT_GT(idx.height(), 1U);
+
+    for (int k = 0; k < ROWS / 2; k += 113) {
+        EXPECT_EQ(idx.search(Value::make_int64(k)).size(), 2U);
+    }
+
+    auto iter = idx.scan();
+    BTreeIndex::Entry entry;
+    int seen = 0;
+    while (iter.next(entry)) {
+        ASSERT_EQ(entry.key.to_int64(), seen / 2);
+        ASSERT_EQ(entry.tuple_id.page_num, static_cast<uint32_t>(seen));
+        seen++;
+    }
+    EXPECT_EQ(seen, ROWS);
+
+    /* The loaded tree accepts regular inserts */
+    ASSERT_TRUE(idx.insert(Value::make_int64(10), HeapTable::TupleId(99999, 0)));
+    EXPECT_EQ(idx.search(Value::make_int64(10)).size(), 3U);
+    static_cast<void>(idx.drop());
+}
+
+TEST(IndexTests, HashSplitsAndChains) {
+    static_cast<void>(std::remove("./test_data/idx_hash.idx"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    {
+        HashIndex idx("idx_hash", sm, ValueType::TYPE_TEXT);
+        ASSERT_TRUE(idx.create());
+        EXPECT_FALSE(idx.ordered());
+
+        constexpr int ROWS = 3000;
+        for (int k = 0; k < ROWS; ++k) {
+            ASSERT_TRUE(idx.insert(Value::make_text(wide_key(k)),
+                                   HeapTable::TupleId(static_cast<uint32_t>(k), 1)));
+        }
+        /* ~200-byte keys: a few hundred buckets' worth */
+        EXPECT_GT(idx.global_depth(), 5U);
+        EXPECT_LE(idx.global_depth(), idx.max_global_depth());
+
+        /* Entries that hash alike spill into an overflow chain instead of splitting */
+        for (uint32_t i = 0; i < 200; ++i) {
+            ASSERT_TRUE(idx.insert(Value::make_text("dup"), HeapTable::TupleId(i, 2)));
+        }
+        ASSERT_TRUE(idx.insert(Value::make_text("dup"), HeapTable::TupleId(0, 2)));
+        EXPECT_EQ(idx.search(Value::make_text("dup")).size(), 200U);
+        ASSERT_TRUE(idx.remove(Value::make_text("dup"), HeapTable::TupleId(150, 2)));
+        EXPECT_EQ(idx.search(Value::make_text("dup")).size(), 199U);
+
+        for (int k = 0; k < ROWS; k += 2) {
+            ASSERT_TRUE(idx.remove(Value::make_text(wide_key(k)),
+                                   HeapTable::TupleId(static_cast<uint32_t>(k), 1)));
+        }
+        idx.close();
+    }
+
+    /* Everything is on disk: a fresh object over the same file sees the same entries */
+    HashIndex idx("idx_hash", sm, ValueType::TYPE_TEXT);
+    ASSERT_TRUE(idx.open());
+    for (int k = 0; k < 3000; k += 37) {
+        const auto res = idx.search(Value::make_text(wide_key(k)));
+        if (k % 2 == 0) {
+            EXPECT_TRUE(res.empty()) << k;
+        } else {
+            ASSERT_EQ(res.size(), 1U) << k;
+            EXPECT_EQ(res[0].page_num, static_cast<uint32_t>(k));
+        }
+    }
+    EXPECT_EQ(idx.search(Value::make_text("dup")).size(), 199U);
+    static_cast<void>(idx.drop());
+}
+
+TEST(IndexTests, HashKeysCompareLikeValues) {
+    static_cast<void>(std::remove("./test_data/idx_hash_num.idx"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    HashIndex idx("idx_hash_num", sm, ValueType::TYPE_INT64);
+    ASSERT_TRUE(idx.create());
+
+    constexpr int ROWS = 5000;
+    std::vector<HashIndex::Entry> entries;
+    for (int i = 0; i < ROWS; ++i) {
+        entries.emplace_back(Value::make_int64(i / 2), HeapTable::TupleId(i, 0));
+    }
+    ASSERT_TRUE(idx.bulk_load(std::move(entries)));
+    /* The directory was sized for the batch up front */
+    EXPECT_GT(idx.global_depth(), 0U);
+
+    for (int k = 0; k < ROWS / 2; k += 113) {
+        EXPECT_EQ(idx.search(Value::make_int64(k)).size(), 2U);
+    }
+    /* 2.0 equals 2, as under Value::operator== */
+    EXPECT_EQ(idx.search(Value::make_float64(2.0)).size(), 2U);
+    EXPECT_TRUE(idx.search(Value::make_float64(2.5)).empty());
+    EXPECT_TRUE(idx.search(Value::make_int64(ROWS)).empty());
+    static_cast<void>(idx.drop());
+}
+
+TEST(IndexTests, BrinRangesFollowInsertOrder) {
+    using Bound = BrinIndex::Bound;
+    using PageRange = HeapTable::PageRange;
+    static_cast<void>(std::remove("./test_data/idx_brin.idx"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    BrinIndex idx("idx_brin", sm, ValueType::TYPE_INT64, 4);
+    ASSERT_TRUE(idx.create());
+
+    /* Ten ascending keys per heap page, 100 pages: 25 ranges of 40 keys */
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(idx.insert(Value::make_int64(i), HeapTable::TupleId(i / 10, i % 10)));
+    }
+    EXPECT_EQ(idx.meta().range_count, 25U);
+    EXPECT_TRUE(idx.search(Value::make_int64(5)).empty());
+
+    auto ranges = idx.matching_ranges(Bound{Value::make_int64(200)}, Bound{Value::make_int64(250)});
+    ASSERT_EQ(ranges.size(), 2U);
+    EXPECT_EQ(ranges[0].first, 20U);
+    EXPECT_EQ(ranges[0].end, 28U);
+    /* Pages past the last summary always match */
+    EXPECT_EQ(ranges[1].first, 100U);
+    EXPECT_EQ(ranges[1].end, PageRange::TO_END);
+
+    /* An exclusive bound at a range's edge leaves the range out */
+    ranges = idx.matching_ranges(std::nullopt, Bound{Value::make_int64(40), false});
+    ASSERT_EQ(ranges.size(), 2U);
+    EXPECT_EQ(ranges[0].end, 4U);
+
+    /* A NULL widens nothing but still matches an open upper end */
+    ASSERT_TRUE(idx.insert(Value::make_null(), HeapTable::TupleId(0, 10)));
+    ranges = idx.matching_ranges(Bound{Value::make_int64(990)}, std::nullopt);
+    ASSERT_EQ(ranges.size(), 2U);
+    EXPECT_EQ(ranges[0].first, 0U);
+    EXPECT_EQ(ranges[1].first, 96U);
+
+    /* A late, out-of-order key widens its range only */
+    ASSERT_TRUE(idx.insert(Value::make_int64(5000), HeapTable::TupleId(50, 10)));
+    ranges = idx.matching_ranges(Bound{Value::make_int64(4000)}, std::nullopt);
+    ASSERT_EQ(ranges.size(), 3U);
+    EXPECT_EQ(ranges[1].first, 48U);
+    EXPECT_EQ(ranges[1].end, 52U);
+    static_cast<void>(idx.drop());
+
+    /* A bulk load summarizes the same way, here over text keys */
+    BrinIndex text_idx("idx_brin", sm, ValueType::TYPE_TEXT, 4);
+    ASSERT_TRUE(text_idx.create());
+    std::vector<BrinIndex::Entry> entries;
+    for (int i = 0; i < 1000; ++i) {
+        char key[16];
+        static_cast<void>(std::snprintf(key, sizeof(key), "k%04d", i));
+        entries.emplace_back(Value::make_text(key), HeapTable::TupleId(i / 10, i % 10));
+    }
+    ASSERT_TRUE(text_idx.bulk_load(std::move(entries)));
+    ranges = text_idx.matching_ranges(Bound{Value::make_text("k0500")},
+                                      Bound{Value::make_text("k0519")});
+    ASSERT_EQ(ranges.size(), 2U);
+    EXPECT_EQ(ranges[0].first, 48U);
+    EXPECT_EQ(ranges[0].end, 52U);
+    static_cast<void>(text_idx.drop());
+}
+
+/**
+ * @brief Concurrency benchmark: threads insert interleaved keys and read them back.
+ *
+ * Prints throughput per thread count; only correctness is asserted. A second phase
+ * removes half the keys while readers keep searching the other half, which drives
+ * the pessimistic merge path under contention.
+ */
+TEST(IndexTests, ConcurrentInsertSearch) {
+    constexpr size_t POOL = 1024;
+    constexpr int KEYS_PER_THREAD = 6000;
+
+    for (const int threads : {1, 2, 4}) {
+        static_cast<void>(std::remove("./test_data/idx_concurrent.idx"));
+        StorageManager disk_manager("./test_data");
+        BufferPoolManager sm(POOL, disk_manager);
+        BTreeIndex idx("idx_concurrent", sm, ValueType::TYPE_INT64);
+        ASSERT_TRUE(idx.create());
+        std::atomic<int> failures{0};
+
+        /* Interleaved keys make every thread hit the same leaves and split them */
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                for (int i = 0; i < KEYS_PER_THREAD; ++i) {
+                    const int64_t k = static_cast<int64_t>(i) * threads + t;
+                    const HeapTable::TupleId tid(static_cast<uint32_t>(k), 1);
+                    if (!idx.insert(Value::make_int64(k), tid) ||
+                        idx.search(Value::make_int64(k)).size() != 1U) {
+                        failures++;
+                    }
+                }
+            });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+        EXPECT_EQ(failures.load(), 0);
+        std::cout << "[BTreeConcurrency] threads=" << threads
+                  << " ops=" << (2 * threads * KEYS_PER_THREAD) << " elapsed_us=" << elapsed
+                  << "\n";
+
+        /* Remove odd keys concurrently with searches for the even ones */
+        const int64_t total = static_cast<int64_t>(threads) * KEYS_PER_THREAD;
+        workers.clear();
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                for (int64_t k = t; k < total; k += threads) {
+                    if (k % 2 == 1) {
+                        const HeapTable::TupleId tid(static_cast<uint32_t>(k), 1);
+                        if (!idx.remove(Value::make_int64(k), tid)) {
+                            failures++;
+                        }
+                    } else if (idx.search(Value::make_int64(k)).size() != 1U) {
+                        failures++;
+                    }
+                }
+            });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+        EXPECT_EQ(failures.load(), 0);
+
+        auto iter = idx.scan();
+        BTreeIndex::Entry entry;
+        int64_t expected = 0;
+        while (iter.next(entry)) {
+            ASSERT_EQ(entry.key.to_int64(), expected);
+            expected += 2;
+        }
+        EXPECT_EQ(expected, total);
+        static_cast<void>(idx.drop());
+    }
+}
+
+// ============= Execution Tests =============
+
+TEST(ExecutionTests, EndToEnd) {
+    static_cast<void>(std::remove("./test_data/users_e2e.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    {
+        auto lexer = std::make_unique<Lexer>("CREATE TABLE users_e2e (id BIGINT, age BIGINT)");
+        auto stmt = Parser(std::move(lexer)).parse_statement();
+        const auto res = exec.execute(*stmt);
+        EXPECT_TRUE(res.success());
+    }
+    {
+        auto lexer = std::make_unique<Lexer>(
+            "INSERT INTO users_e2e (id, age) VALUES (1, 20), (2, 30), (3, 40)");
+        auto stmt = Parser(std::move(lexer)).parse_statement();
+        const auto res = exec.execute(*stmt);
+        EXPECT_TRUE(res.success());
+    }
+    {
+        auto lexer = std::make_unique<Lexer>("SELECT id FROM users_e2e WHERE age > 25");
+        auto stmt = Parser(std::move(lexer)).parse_statement();
+        const auto res = exec.execute(*stmt);
+        EXPECT_TRUE(res.success());
+        EXPECT_EQ(res.row_count(), 2U);
+    }
+    static_cast<void>(std::remove("./test_data/users_e2e.heap"));
+}
+
+TEST(ExecutionTests, Sort) {
+    static_cast<void>(std::remove("./test_data/sort_test.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    static_cast<void>(exec.execute(
+        *Parser(std::make_unique<Lexer>("CREATE TABLE sort_test (val INT)")).parse_statement()));
+    static_cast<void>(exec.execute(
+        *Parser(std::make_unique<Lexer>("INSERT INTO sort_test VALUES (30), (10), (20)"))
+             .parse_statement()));
+
+    const auto res =
+        exec.execute(*Parser(std::make_unique<Lexer>("SELECT val FROM sort_test ORDER BY val"))
+                          .parse_statement());
+    ASSERT_EQ(res.row_count(), 3U);
+    EXPECT_STREQ(res.rows()[0].get(0).to_string().c_str(), "10");
+    EXPECT_STREQ(res.rows()[1].get(0).to_string().c_str(), "20");
+    EXPECT_STREQ(res.rows()[2].get(0).to_string().c_str(), "30");
+    static_cast<void>(std::remove("./test_data/sort_test.heap"));
+}
+
+TEST(ExecutionTests, Aggregate) {
+    static_cast<void>(std::remove("./test_data/agg_test.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    static_cast<void>(
+        exec.execute(*Parser(std::make_unique<Lexer>("CREATE TABLE agg_test (cat TEXT, val INT)"))
+                          .parse_statement()));
+    static_cast<void>(
+        exec.execute(*Parser(std::make_unique<Lexer>(
+                                 "INSERT INTO agg_test VALUES ('A', 10), ('A', 20), ('B', 5)"))
+                          .parse_statement()));
+
+    auto lex =
+        std::make_unique<Lexer>("SELECT cat, COUNT(val), SUM(val) FROM agg_test GROUP BY cat");
+    auto stmt = Parser(std::move(lex)).parse_statement();
+    ASSERT_NE(stmt, nullptr);
+
+    const auto res = exec.execute(*stmt);
+    EXPECT_TRUE(res.success());
+
+    ASSERT_EQ(res.row_count(), 2U);
+    /* Row 0: 'A', 2, 30 */
+    EXPECT_STREQ(res.rows()[0].get(0).to_string().c_str(), "A");
+    EXPECT_STREQ(res.rows()[0].get(1).to_string().c_str(), "2");
+    EXPECT_STREQ(res.rows()[0].get(2).to_string().c_str(), "30");
+    static_cast<void>(std::remove("./test_data/agg_test.heap"));
+}
+
+TEST(ExecutionTests, AggregateAdvanced) {
+    static_cast<void>(std::remove("./test_data/adv_agg.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    static_cast<void>(exec.execute(
+        *Parser(std::make_unique<Lexer>("CREATE TABLE adv_agg (val INT)")).parse_statement()));
+    static_cast<void>(
+        exec.execute(*Parser(std::make_unique<Lexer>("INSERT INTO adv_agg VALUES (10), (20), (30)"))
+                          .parse_statement()));
+
+    const auto res = exec.execute(
+        *Parser(std::make_unique<Lexer>("SELECT MIN(val), MAX(val), AVG(val) FROM adv_agg"))
+             .parse_statement());
+    EXPECT_TRUE(res.success());
+
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_STREQ(res.rows()[0].get(0).to_string().c_str(), "10");
+    EXPECT_STREQ(res.rows()[0].get(1).to_string().c_str(), "30");
+    EXPECT_STREQ(res.rows()[0].get(2).to_string().c_str(), "20");
+    static_cast<void>(std::remove("./test_data/adv_agg.heap"));
+}
+
+TEST(ExecutionTests, AggregateDistinct) {
+    static_cast<void>(std::remove("./test_data/dist_agg.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    static_cast<void>(exec.execute(
+        *Parser(std::make_unique<Lexer>("CREATE TABLE dist_agg (val INT)")).parse_statement()));
+    static_cast<void>(
+        exec.execute(*Parser(std::make_unique<Lexer>(
+                                 "INSERT INTO dist_agg VALUES (10), (10), (20), (30), (30), (30)"))
+                          .parse_statement()));
+
+    const auto res =
+        exec.execute(*Parser(std::make_unique<Lexer>(
+                                 "SELECT COUNT(DISTINCT val), SUM(DISTINCT val) FROM dist_agg"))
+                          .parse_statement());
+    EXPECT_TRUE(res.success());
+
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_STREQ(res.rows()[0].get(0).to_string().c_str(), "3");
+    EXPECT_STREQ(res.rows()[0].get(1).to_string().c_str(), "60");
+    static_cast<void>(std::remove("./test_data/dist_agg.heap"));
+}
+
+TEST(ExecutionTests, AggregateSnapshotVisibility) {
+    static_cast<void>(std::remove("./test_data/agg_mvcc.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor writer(*catalog, sm, lm, tm);
+    QueryExecutor reader(*catalog, sm, lm, tm);
+    const auto run = [](QueryExecutor& exec, const std::string& sql) {
+        return exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+    };
+
+    static_cast<void>(run(writer, "CREATE TABLE agg_mvcc (cat TEXT, val INT)"));
+    static_cast<void>(
+        run(writer, "INSERT INTO agg_mvcc VALUES ('A', 10), ('A', 20), ('B', 5), ('B', 1)"));
+    static_cast<void>(run(writer, "BEGIN"));
+    static_cast<void>(run(writer, "DELETE FROM agg_mvcc WHERE val = 20"));
+    static_cast<void>(run(writer, "INSERT INTO agg_mvcc VALUES ('C', 7)"));
+
+    const std::string query =
+        "SELECT cat, COUNT(*), SUM(val), MAX(val) FROM agg_mvcc WHERE val > 1 GROUP BY cat";
+    const auto render = [](const QueryResult& res) {
+        std::vector<std::string> rows;
+        for (const auto& row : res.rows()) {
+            std::string text;
+            for (const auto& val : row.values()) text += val.to_string() + "|";
+            rows.push_back(text);
+        }
+        return rows;
+    };
+
+    /* The writer sees its own delete and insert */
+    const auto own = run(writer, query);
+    ASSERT_TRUE(own.success()) << own.error();
+    EXPECT_EQ(render(own), (std::vector<std::string>{"A|1|10|10|", "B|1|5|5|", "C|1|7|7|"}));
+
+    /* Others see the table as it was before the transaction */
+    const auto other = run(reader, query);
+    ASSERT_TRUE(other.success()) << other.error();
+    EXPECT_EQ(render(other), (std::vector<std::string>{"A|2|30|20|", "B|1|5|5|"}));
+
+    static_cast<void>(run(writer, "COMMIT"));
+    const auto total = run(reader, "SELECT COUNT(*), SUM(val) FROM agg_mvcc");
+    ASSERT_EQ(total.row_count(), 1U);
+    EXPECT_EQ(render(total), std::vector<std::string>{"4|23|"});
+    static_cast<void>(std::remove("./test_data/agg_mvcc.heap"));
+}
+
+TEST(ExecutionTests, HashJoinSpill) {
+    Schema left_schema;
+    left_schema.add_column("id", ValueType::TYPE_INT32);
+    left_schema.add_column("name", ValueType::TYPE_TEXT);
+    Schema right_schema;
+    right_schema.add_column("id", ValueType::TYPE_FLOAT64);
+    right_schema.add_column("val", ValueType::TYPE_TEXT);
+
+    /* Left keys are INT32 values, right keys floats, so matching compares numbers by value */
+    std::vector<Tuple> left_rows;
+    for (int32_t i = 0; i < 1200; ++i) {
+        left_rows.emplace_back(std::vector<Value>{
+            i % 97 == 0 ? Value::make_null() : Value(static_cast<int32_t>(i % 700)),
+            Value::make_text("left_" + std::to_string(i))});
+    }
+    std::vector<Tuple> right_rows;
+    for (int32_t i = 0; i < 3000; ++i) {
+        const double key = i % 5 == 4 ? (i % 600) + 0.5 : static_cast<double>(i % 600);
+        right_rows.emplace_back(std::vector<Value>{
+            i % 89 == 0 ? Value::make_null() : Value::make_float64(key),
+            Value::make_text("right_payload_" + std::to_string(i))});
+    }
+
+    auto parse_key = [](const std::string& column) {
+        auto stmt =
+            Parser(std::make_unique<Lexer>("SELECT " + column + " FROM t")).parse_statement();
+        return dynamic_cast<SelectStatement&>(*stmt).columns()[0]->clone();
+    };
+    auto run = [&](JoinType type, size_t budget, size_t* spilled) {
+        HashJoinOperator join(
+            std::make_unique<BufferScanOperator>("ctx", "l", left_rows, left_schema),
+            std::make_unique<BufferScanOperator>("ctx", "r", right_rows, right_schema),
+            parse_key("l.id"), parse_key("r.id"), type, budget);
+        EXPECT_TRUE(join.init());
+        EXPECT_TRUE(join.open());
+        std::vector<std::string> rows;
+        Tuple tuple;
+        while (join.next(tuple)) rows.push_back(tuple.to_string());
+        EXPECT_FALSE(join.has_error()) << join.error();
+        join.close();
+        *spilled = join.spilled_partitions();
+        std::sort(rows.begin(), rows.end());
+        return rows;
+    };
+
+    /* Reference: nested loops over the SQL '=' of the keys; NULLs never match */
+    auto matches = [](const Tuple& l, const Tuple& r) {
+        return !l.get(0).is_null() && !r.get(0).is_null() &&
+               l.get(0).to_float64() == r.get(0).to_float64();
+    };
+    size_t inner = 0;
+    size_t unmatched_left = 0;
+    for (const auto& l : left_rows) {
+        size_t count = 0;
+        for (const auto& r : right_rows) count += matches(l, r) ? 1 : 0;
+        inner += count;
+        unmatched_left += count == 0 ? 1 : 0;
+    }
+    size_t unmatched_right = 0;
+    for (const auto& r : right_rows) {
+        bool matched = false;
+        for (const auto& l : left_rows) matched = matched || matches(l, r);
+        unmatched_right += matched ? 0 : 1;
+    }
+    ASSERT_GT(inner, 0U);
+
+    const std::vector<std::pair<JoinType, size_t>> expected_counts = {
+        {JoinType::Inner, inner},
+        {JoinType::Left, inner + unmatched_left},
+        {JoinType::Right, inner + unmatched_right},
+        {JoinType::Full, inner + unmatched_left + unmatched_right},
+    };
+    for (const auto& [type, expected] : expected_counts) {
+        size_t spilled = 0;
+        const auto in_memory = run(type, SIZE_MAX, &spilled);
+        EXPECT_EQ(spilled, 0U);
+        EXPECT_EQ(in_memory.size(), expected) << static_cast<int>(type);
+
+        /* A budget far below the build side spills most partitions to disk */
+        const auto grace = run(type, 16 * 1024, &spilled);
+        EXPECT_GT(spilled, 0U);
+        EXPECT_EQ(grace, in_memory) << static_cast<int>(type);
+    }
+}
+
+TEST(ExecutionTests, RuntimeFilterKeys) {
+    RuntimeFilter filter(1000);
+    for (int64_t i = 0; i < 1000; ++i) filter.add(Value::make_int64(i * 3));
+    filter.add(Value::make_null());
+    EXPECT_EQ(filter.key_count(), 1000U);
+
+    /* Every added key passes, as does the same number of another type */
+    for (int64_t i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(filter.may_contain(Value::make_int64(i * 3))) << i;
+    }
+    EXPECT_TRUE(filter.may_contain(Value(static_cast<int32_t>(6))));
+    EXPECT_TRUE(filter.may_contain(Value::make_float64(6.0)));
+    EXPECT_FALSE(filter.may_contain(Value::make_null()));
+    EXPECT_FALSE(filter.may_contain(Value::make_int64(-1)));
+    EXPECT_FALSE(filter.may_contain(Value::make_int64(3000)));
+
+    /* Absent keys inside the range are rejected at about the target rate */
+    size_t passed = 0;
+    for (int64_t i = 0; i < 1000; ++i) {
+        passed += filter.may_contain(Value::make_int64(i * 3 + 1)) ? 1 : 0;
+    }
+    EXPECT_LT(passed, 50U);
+
+    /* Filters of different sizes merge into one that passes both key sets */
+    RuntimeFilter small(10);
+    small.add(Value::make_int64(-50));
+    small.add(Value::make_int64(7));
+    RuntimeFilter merged = filter;
+    merged.merge(small);
+    EXPECT_EQ(merged.bit_count(), small.bit_count());
+    EXPECT_EQ(merged.key_count(), 1002U);
+    EXPECT_TRUE(merged.may_contain(Value::make_int64(-50)));
+    EXPECT_TRUE(merged.may_contain(Value::make_int64(7)));
+    for (int64_t i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(merged.may_contain(Value::make_int64(i * 3))) << i;
+    }
+
+    /* Text keys; an empty filter rejects everything */
+    RuntimeFilter text(4);
+    text.add(Value::make_text("alpha"));
+    EXPECT_TRUE(text.may_contain(Value::make_text("alpha")));
+    EXPECT_FALSE(text.may_contain(Value::make_text("zeta")));
+    EXPECT_FALSE(RuntimeFilter(4).may_contain(Value::make_int64(0)));
+}
+
+TEST(ExecutionTests, RuntimeFilterPushedIntoProbeScan) {
+    static_cast<void>(std::remove("./test_data/rf_fact.heap"));
+    static_cast<void>(std::remove("./test_data/rf_dim.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    auto run = [&](const std::string& sql) {
+        auto res = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+    static_cast<void>(run("CREATE TABLE rf_fact (id INT, dim_id INT)"));
+    static_cast<void>(run("CREATE TABLE rf_dim (id INT, name TEXT)"));
+    std::string sql = "INSERT INTO rf_fact VALUES ";
+    for (int i = 0; i < 2000; ++i) {
+        sql += (i > 0 ? ", (" : "(") + std::to_string(i) + ", " + std::to_string(i % 200) + ")";
+    }
+    static_cast<void>(run(sql));
+    static_cast<void>(run("INSERT INTO rf_dim VALUES (7, 'seven'), (150, 'one fifty')"));
+
+    /* 10 fact rows match each dimension row; the scan drops the other 1980 */
+    const std::string query =
+        "SELECT rf_fact.id, rf_dim.name FROM rf_fact JOIN rf_dim ON rf_fact.dim_id = rf_dim.id";
+    const auto analyzed = run("EXPLAIN ANALYZE " + query);
+    std::string plan;
+    for (const auto& row : analyzed.rows()) plan += row.get(0).to_string() + "\n";
+    EXPECT_NE(plan.find("Runtime Filter: rf_fact.dim_id (2 keys)"), std::string::npos) << plan;
+    EXPECT_NE(plan.find("Rows Removed by Runtime Filter: 1980"), std::string::npos) << plan;
+    EXPECT_EQ(run(query).row_count(), 20U);
+
+    /* A LEFT join keeps every probe row, so nothing is filtered */
+    const std::string left =
+        "SELECT rf_fact.id, rf_dim.name FROM rf_fact LEFT JOIN rf_dim "
+        "ON rf_fact.dim_id = rf_dim.id";
+    const auto left_plan = run("EXPLAIN " + left);
+    for (const auto& row : left_plan.rows()) {
+        EXPECT_EQ(row.get(0).to_string().find("Runtime Filter"), std::string::npos);
+    }
+    EXPECT_EQ(run(left).row_count(), 2000U);
+    static_cast<void>(std::remove("./test_data/rf_fact.heap"));
+    static_cast<void>(std::remove("./test_data/rf_dim.heap"));
+}
+
+TEST(ExecutionTests, SortExternalAndTopN) {
+    Schema schema;
+    schema.add_column("a", ValueType::TYPE_FLOAT64);
+    schema.add_column("b", ValueType::TYPE_TEXT);
+    schema.add_column("seq", ValueType::TYPE_INT64);
+
+    /* Many duplicate keys, mixed numeric types, NULLs and strings with embedded zero bytes */
+    std::vector<Tuple> rows;
+    for (int64_t i = 0; i < 3000; ++i) {
+        Value a;
+        if (i % 13 == 0) {
+            a = Value::make_null();
+        } else if (i % 3 == 0) {
+            a = Value(static_cast<int32_t>((i * 7) % 50 - 25));
+        } else {
+            a = Value::make_float64(static_cast<double>((i * 7) % 50 - 25) / (i % 2 == 0 ? 1 : 4));
+        }
+        std::string b = "k" + std::to_string(i % 11);
+        if (i % 5 == 0) b += std::string(1, '\0') + "z";
+        rows.emplace_back(std::vector<Value>{a, Value::make_text(b), Value::make_int64(i)});
+    }
+
+    auto parse_key = [](const std::string& column) {
+        auto stmt =
+            Parser(std::make_unique<Lexer>("SELECT " + column + " FROM t")).parse_statement();
+        return dynamic_cast<SelectStatement&>(*stmt).columns()[0]->clone();
+    };
+    const std::vector<bool> ascending = {true, false};
+    auto run = [&](SortOptions options, size_t* spilled) {
+        std::vector<std::unique_ptr<Expression>> keys;
+        keys.push_back(parse_key("s.a"));
+        keys.push_back(parse_key("s.b"));
+        SortOperator sort(std::make_unique<BufferScanOperator>("ctx", "s", rows, schema),
+                          std::move(keys), ascending, std::move(options));
+        EXPECT_TRUE(sort.init());
+        EXPECT_TRUE(sort.open()) << sort.error();
+        std::vector<std::string> out;
+        Tuple tuple;
+        while (sort.next(tuple)) out.push_back(tuple.to_string());
+        EXPECT_FALSE(sort.has_error()) << sort.error();
+        *spilled = sort.spilled_runs();
+        sort.close();
+        return out;
+    };
+
+    /* Reference: a stable sort comparing Values directly */
+    std::vector<Tuple> expected_rows = rows;
+    std::stable_sort(expected_rows.begin(), expected_rows.end(),
+                     [](const Tuple& x, const Tuple& y) {
+                         if (x.get(0) < y.get(0)) return true;
+                         if (y.get(0) < x.get(0)) return false;
+                         return y.get(1) < x.get(1);
+                     });
+    std::vector<std::string> expected;
+    for (const auto& row : expected_rows) expected.push_back(row.to_string());
+
+    size_t spilled = 0;
+    SortOptions in_memory;
+    in_memory.memory_budget = SIZE_MAX;
+    EXPECT_EQ(run(in_memory, &spilled), expected);
+    EXPECT_EQ(spilled, 0U);
+
+    /* Enough runs to need more than one merge pass */
+    SortOptions external;
+    external.memory_budget = 2048;
+    external.spill_dir = ".";
+    EXPECT_EQ(run(external, &spilled), expected);
+    EXPECT_GT(spilled, SortOperator::MERGE_FANIN);
+
+    SortOptions top_n;
+    top_n.limit = 25;
+    const auto top = run(top_n, &spilled);
+    EXPECT_EQ(top, std::vector<std::string>(expected.begin(), expected.begin() + 25));
+
+    /* Key encodings compare bytewise like the values they encode */
+    const std::vector<Value> ordered = {Value::make_float64(-1e300),
+                                        Value::make_int64(-3),
+                                        Value::make_float64(-0.5),
+                                        Value::make_int64(0),
+                                        Value::make_float64(0.25),
+                                        Value(static_cast<int32_t>(7)),
+                                        Value::make_float64(1e300),
+                                        Value::make_text(""),
+                                        Value::make_text(std::string(1, '\0')),
+                                        Value::make_text("a"),
+                                        Value::make_text("ab"),
+                                        Value::make_null()};
+    for (size_t i = 0; i + 1 < ordered.size(); ++i) {
+        std::string lo;
+        std::string hi;
+        SortOperator::encode_sort_key(ordered[i], true, lo);
+        SortOperator::encode_sort_key(ordered[i + 1], true, hi);
+        EXPECT_LT(lo, hi) << i;
+        lo.clear();
+        hi.clear();
+        SortOperator::encode_sort_key(ordered[i], false, lo);
+        SortOperator::encode_sort_key(ordered[i + 1], false, hi);
+        EXPECT_GT(lo, hi) << i;
+    }
+}
+
+TEST(ExecutionTests, AggregateSpillAndStreaming) {
+    Schema schema;
+    schema.add_column("g", ValueType::TYPE_INT64);
+    schema.add_column("v", ValueType::TYPE_FLOAT64);
+
+    /* Group keys arrive as both INT32 and integral FLOAT64 values; both are one group */
+    constexpr int64_t GROUPS = 700;
+    std::vector<Tuple> rows;
+    for (int64_t i = 0; i < 6000; ++i) {
+        const int64_t g = (i * 31) % GROUPS;
+        Value key = i % 2 == 0 ? Value(static_cast<int32_t>(g))
+                               : Value::make_float64(static_cast<double>(g));
+        Value v = i % 17 == 0 ? Value::make_null()
+                              : Value::make_float64(static_cast<double>(i % 9));
+        rows.emplace_back(std::vector<Value>{std::move(key), std::move(v)});
+    }
+
+    auto parse_expr = [](const std::string& text) {
+        auto stmt = Parser(std::make_unique<Lexer>("SELECT " + text + " FROM t")).parse_statement();
+        return dynamic_cast<SelectStatement&>(*stmt).columns()[0]->clone();
+    };
+    auto run = [&](const std::vector<Tuple>& input, bool grouped, AggregateOptions options,
+                   size_t* spilled) {
+        std::vector<std::unique_ptr<Expression>> group_by;
+        if (grouped) group_by.push_back(parse_expr("a.g"));
+        std::vector<AggregateInfo> aggs;
+        const std::vector<std::pair<AggregateType, bool>> specs = {
+            {AggregateType::Count, false}, {AggregateType::Sum, false},
+            {AggregateType::Min, false},   {AggregateType::Max, false},
+            {AggregateType::Avg, false},   {AggregateType::Count, true}};
+        for (const auto& [type, distinct] : specs) {
+            AggregateInfo info;
+            info.type = type;
+            info.expr = parse_expr("a.v");
+            info.is_distinct = distinct;
+            info.name = "agg" + std::to_string(aggs.size());
+            aggs.push_back(std::move(info));
+        }
+        AggregateOperator agg(std::make_unique<BufferScanOperator>("ctx", "a", input, schema),
+                              std::move(group_by), std::move(aggs), std::move(options));
+        EXPECT_TRUE(agg.init());
+        EXPECT_TRUE(agg.open()) << agg.error();
+        std::vector<std::string> out;
+        Tuple tuple;
+        while (agg.next(tuple)) out.push_back(tuple.to_string());
+        EXPECT_FALSE(agg.has_error()) << agg.error();
+        *spilled = agg.spilled_partitions();
+        agg.close();
+        return out;
+    };
+
+    size_t spilled = 0;
+    AggregateOptions in_memory;
+    in_memory.memory_budget = SIZE_MAX;
+    auto expected = run(rows, true, in_memory, &spilled);
+    EXPECT_EQ(expected.size(), static_cast<size_t>(GROUPS));
+    EXPECT_EQ(spilled, 0U);
+
+    /* Reference for one group: g = 0 */
+    int64_t count = 0;
+    double sum = 0;
+    std::vector<double> distinct;
+    for (const auto& row : rows) {
+        if (row.get(0).to_int64() != 0 || row.get(1).is_null()) continue;
+        ++count;
+        sum += row.get(1).to_float64();
+        distinct.push_back(row.get(1).to_float64());
+    }
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+    ASSERT_GT(count, 0);
+    const std::string first = expected.front();
+    EXPECT_NE(first.find(std::to_string(count)), std::string::npos) << first;
+    EXPECT_NE(first.find(std::to_string(distinct.size())), std::string::npos) << first;
+
+    /* A tiny budget spills, and the partitions are split again on later hash bits */
+    std::sort(expected.begin(), expected.end());
+    AggregateOptions spilling;
+    spilling.memory_budget = 4096;
+    spilling.spill_dir = ".";
+    auto spilled_out = run(rows, true, spilling, &spilled);
+    EXPECT_GT(spilled, AggregateOperator::SPILL_PARTITIONS);
+    std::sort(spilled_out.begin(), spilled_out.end());
+    EXPECT_EQ(spilled_out, expected);
+
+    /* Input that arrives grouped streams through, one group at a time */
+    std::vector<Tuple> ordered = rows;
+    std::stable_sort(ordered.begin(), ordered.end(), [](const Tuple& a, const Tuple& b) {
+        return a.get(0).to_int64() < b.get(0).to_int64();
+    });
+    AggregateOptions streaming;
+    streaming.input_grouped = true;
+    auto streamed = run(ordered, true, streaming, &spilled);
+    EXPECT_EQ(spilled, 0U);
+    std::sort(streamed.begin(), streamed.end());
+    EXPECT_EQ(streamed, expected);
+
+    /* A global aggregate still yields its row over empty input */
+    const auto global = run({}, false, spilling, &spilled);
+    ASSERT_EQ(global.size(), 1U);
+}
+
+TEST(ExecutionTests, MemoryTrackerLimits) {
+    /* A charge counts up the tree and is refused, whole, by the first limit it would pass */
+    MemoryTracker root("root", 1000);
+    {
+        MemoryTracker query("query", 600, &root);
+        MemoryTracker op("operator", 0, &query);
+        EXPECT_TRUE(op.try_consume(500));
+        EXPECT_EQ(root.consumed(), 500U);
+        const MemoryTracker* refused = nullptr;
+        EXPECT_FALSE(op.try_consume(200, &refused));
+        ASSERT_NE(refused, nullptr);
+        EXPECT_EQ(refused->label(), "query");
+        EXPECT_EQ(op.consumed(), 500U);
+        EXPECT_EQ(query.refusals(), 1U);
+        EXPECT_THROW(op.resize(700, "Test"), MemoryLimitError);
+        op.resize(100, "Test");
+        EXPECT_EQ(query.consumed(), 100U);
+        EXPECT_EQ(query.peak(), 500U);
+    }
+    /* Trackers give back what they hold when destroyed */
+    EXPECT_EQ(root.consumed(), 0U);
+
+    Schema schema;
+    schema.add_column("g", ValueType::TYPE_INT64);
+    schema.add_column("v", ValueType::TYPE_INT64);
+    std::vector<Tuple> rows;
+    for (int64_t i = 0; i < 5000; ++i) {
+        rows.emplace_back(std::vector<Value>{Value::make_int64(i % 900), Value::make_int64(i)});
+    }
+    auto parse_expr = [](const std::string& text) {
+        auto stmt = Parser(std::make_unique<Lexer>("SELECT " + text + " FROM t")).parse_statement();
+        return dynamic_cast<SelectStatement&>(*stmt).columns()[0]->clone();
+    };
+    auto make_agg = [&](bool grouped) {
+        std::vector<std::unique_ptr<Expression>> group_by;
+        if (grouped) group_by.push_back(parse_expr("a.g"));
+        std::vector<AggregateInfo> aggs(1);
+        aggs[0].type = AggregateType::Count;
+        aggs[0].expr = parse_expr("a.v");
+        aggs[0].is_distinct = true;
+        aggs[0].name = "n";
+        AggregateOptions options;
+        options.memory_budget = SIZE_MAX;
+        options.spill_dir = ".";
+        return std::make_unique<AggregateOperator>(
+            std::make_unique<BufferScanOperator>("ctx", "a", rows, schema), std::move(group_by),
+            std::move(aggs), std::move(options));
+    };
+    auto drain = [](Operator& op) {
+        std::vector<std::string> out;
+        EXPECT_TRUE(op.init());
+        EXPECT_TRUE(op.open()) << op.error();
+        Tuple tuple;
+        while (op.next(tuple)) out.push_back(tuple.to_string());
+        EXPECT_FALSE(op.has_error()) << op.error();
+        op.close();
+        std::sort(out.begin(), out.end());
+        return out;
+    };
+
+    /* Without a budget of its own, a GROUP BY spills once the query's limit refuses it */
+    auto unlimited = make_agg(true);
+    const auto expected = drain(*unlimited);
+    ASSERT_EQ(expected.size(), 900U);
+    EXPECT_EQ(static_cast<AggregateOperator&>(*unlimited).spilled_partitions(), 0U);
+    {
+        MemoryTracker query("query", 64 * 1024);
+        std::unique_ptr<Operator> agg;
+        {
+            const MemoryTracker::Scope scope(&query);
+            agg = make_agg(true);
+        }
+        ASSERT_NE(agg->memory_tracker(), nullptr);
+        EXPECT_EQ(drain(*agg), expected);
+        EXPECT_GT(static_cast<AggregateOperator&>(*agg).spilled_partitions(), 0U);
+        EXPECT_GT(query.refusals(), 0U);
+        EXPECT_LE(query.peak(), query.limit());
+    }
+
+    /* One global group cannot spill: the query fails with the limit that refused it */
+    {
+        MemoryTracker query("query", 16 * 1024);
+        std::unique_ptr<Operator> agg;
+        {
+            const MemoryTracker::Scope scope(&query);
+            agg = make_agg(false);
+        }
+        try {
+            static_cast<void>(drain(*agg));
+            ADD_FAILURE() << "expected a MemoryLimitError";
+        } catch (const MemoryLimitError& e) {
+            EXPECT_NE(std::string(e.what()).find("query memory limit"), std::string::npos)
+                << e.what();
+        }
+        agg.reset();
+        EXPECT_EQ(query.consumed(), 0U);
+    }
+
+    /* Through the executor, a result larger than the query limit fails the statement */
+    static_cast<void>(std::remove("./test_data/mem_limit.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+    auto run = [&exec](const std::string& sql) {
+        return exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+    };
+    ASSERT_TRUE(run("CREATE TABLE mem_limit (id INT, name TEXT)").success());
+    std::string insert = "INSERT INTO mem_limit VALUES ";
+    for (int i = 0; i < 2000; ++i) {
+        insert += (i == 0 ? "(" : ", (") + std::to_string(i) + ", 'name_" + std::to_string(i) +
+                  "')";
+    }
+    ASSERT_TRUE(run(insert).success());
+
+    const size_t previous = QueryExecutor::default_query_memory_limit();
+    QueryExecutor::set_default_query_memory_limit(32 * 1024);
+    const auto failed = run("SELECT id, name FROM mem_limit");
+    const auto small = run("SELECT id FROM mem_limit WHERE id < 10");
+    QueryExecutor::set_default_query_memory_limit(previous);
+    EXPECT_FALSE(failed.success());
+    EXPECT_NE(failed.error().find("out of memory: query result"), std::string::npos)
+        << failed.error();
+    EXPECT_TRUE(small.success()) << small.error();
+    EXPECT_EQ(small.row_count(), 10U);
+    EXPECT_EQ(run("SELECT id, name FROM mem_limit").row_count(), 2000U);
+    EXPECT_EQ(exec.session_memory().consumed(), 0U);
+    static_cast<void>(std::remove("./test_data/mem_limit.heap"));
+}
+
+TEST(ExecutionTests, IndexRangeScan) {
+    static_cast<void>(std::remove("./test_data/idx_range.heap"));
+    static_cast<void>(std::remove("./test_data/idx_range_k.idx"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    auto run = [&](const std::string& sql) {
+        auto res = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+    auto rows = [&](const std::string& sql, bool sorted) {
+        const auto res = run(sql);
+        std::vector<std::string> out;
+        for (const auto& row : res.rows()) out.push_back(row.to_string());
+        if (sorted) std::sort(out.begin(), out.end());
+        return out;
+    };
+
+    static_cast<void>(run("CREATE TABLE idx_range (k BIGINT, v TEXT)"));
+    for (int batch = 0; batch < 4; ++batch) {
+        std::string sql = "INSERT INTO idx_range VALUES ";
+        for (int i = 0; i < 100; ++i) {
+            const int n = batch * 100 + i;
+            if (i > 0) sql += ", ";
+            sql += n % 41 == 0 ? "(NULL" : "(" + std::to_string((n * 37) % 200);
+            sql += ", 'row" + std::to_string(n) + "')";
+        }
+        static_cast<void>(run(sql));
+    }
+    static_cast<void>(run("DELETE FROM idx_range WHERE k = 74"));
+
+    const std::vector<std::string> queries = {
+        "SELECT k, v FROM idx_range WHERE k < 20",
+        "SELECT k, v FROM idx_range WHERE k >= 190",
+        "SELECT k, v FROM idx_range WHERE k BETWEEN 70 AND 80",
+        "SELECT k, v FROM idx_range WHERE k NOT BETWEEN 10 AND 190",
+        "SELECT k, v FROM idx_range WHERE 50 < k AND k <= 60 AND v <> 'row1'",
+        "SELECT k, v FROM idx_range WHERE k > 90 AND k > 95 AND k < 99.5",
+        "SELECT k, v FROM idx_range WHERE k = 74",
+        "SELECT k FROM idx_range WHERE k > 120 AND k < 130",
+        "SELECT k, k * 2 FROM idx_range WHERE k >= 150 AND k <= 152",
+        "SELECT COUNT(*) FROM idx_range WHERE k <= 100"};
+
+    /* Row sets before the index exist come from sequential scans */
+    std::vector<std::vector<std::string>> expected;
+    for (const auto& sql : queries) expected.push_back(rows(sql, true));
+    const auto ordered = rows("SELECT k, v FROM idx_range ORDER BY k", false);
+    const auto ordered_range = rows("SELECT k FROM idx_range WHERE k >= 100 ORDER BY k", false);
+    EXPECT_EQ(expected[2].size(), 20U);
+    EXPECT_TRUE(expected[6].empty());
+
+    static_cast<void>(run("CREATE INDEX idx_range_k ON idx_range (k)"));
+    for (size_t i = 0; i < queries.size(); ++i) {
+        EXPECT_EQ(rows(queries[i], true), expected[i]) << queries[i];
+    }
+
+    /* Key order of the index replaces the sort; NULL keys still come last */
+    auto top = rows("SELECT k, v FROM idx_range ORDER BY k LIMIT 15", false);
+    ASSERT_EQ(top.size(), 15U);
+    for (size_t i = 0; i < top.size(); ++i) {
+        EXPECT_EQ(top[i].substr(0, top[i].find(',')), ordered[i].substr(0, ordered[i].find(',')));
+    }
+    const auto all = rows("SELECT k FROM idx_range ORDER BY k LIMIT 1000", false);
+    ASSERT_EQ(all.size(), ordered.size());
+    EXPECT_EQ(all.back(), "(NULL)");
+    EXPECT_EQ(rows("SELECT k FROM idx_range WHERE k >= 100 ORDER BY k", false), ordered_range);
+
+    static_cast<void>(run("DROP INDEX idx_range_k"));
+    static_cast<void>(std::remove("./test_data/idx_range.heap"));
+    static_cast<void>(std::remove("./test_data/idx_range_k.idx"));
+}
+
+TEST(ExecutionTests, HashIndexEquality) {
+    static_cast<void>(std::remove("./test_data/hash_exec.heap"));
+    static_cast<void>(std::remove("./test_data/hash_exec_k.idx"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    auto run = [&](const std::string& sql) {
+        auto res = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+    auto plan_text = [&](const std::string& sql) {
+        const auto res = run("EXPLAIN " + sql);
+        std::string text;
+        for (const auto& row : res.rows()) text += row.get(0).to_string() + "\n";
+        return text;
+    };
+
+    const auto stmt =
+        Parser(std::make_unique<Lexer>("CREATE INDEX hash_exec_k ON hash_exec USING hash (k)"))
+            .parse_statement();
+    ASSERT_NE(stmt, nullptr);
+    EXPECT_EQ(dynamic_cast<const CreateIndexStatement&>(*stmt).method(), "HASH");
+    EXPECT_EQ(stmt->to_string(), "CREATE INDEX hash_exec_k ON hash_exec USING HASH (k)");
+
+    static_cast<void>(run("CREATE TABLE hash_exec (k BIGINT, v TEXT)"));
+    std::string sql = "INSERT INTO hash_exec VALUES ";
+    for (int i = 0; i < 300; ++i) {
+        sql += (i > 0 ? ", (" : "(") + std::to_string(i % 100) + ", 'row" + std::to_string(i) +
+               "')";
+    }
+    static_cast<void>(run(sql));
+    EXPECT_FALSE(
+        exec.execute(*Parser(std::make_unique<Lexer>(
+                                 "CREATE INDEX hash_exec_g ON hash_exec USING gist (k)"))
+                          .parse_statement())
+            .success());
+    static_cast<void>(exec.execute(*stmt));
+
+    EXPECT_NE(plan_text("SELECT v FROM hash_exec WHERE k = 42").find("Index Scan using hash_exec_k"),
+              std::string::npos);
+    EXPECT_EQ(run("SELECT v FROM hash_exec WHERE k = 42").row_count(), 3U);
+    /* A hash index cannot answer ranges */
+    EXPECT_EQ(plan_text("SELECT v FROM hash_exec WHERE k < 42").find("hash_exec_k"),
+              std::string::npos);
+    EXPECT_EQ(run("SELECT v FROM hash_exec WHERE k < 42").row_count(), 126U);
+
+    /* DML keeps the index in step */
+    static_cast<void>(run("INSERT INTO hash_exec VALUES (42, 'new')"));
+    static_cast<void>(run("DELETE FROM hash_exec WHERE v = 'row42'"));
+    static_cast<void>(run("UPDATE hash_exec SET k = 7 WHERE v = 'row142'"));
+    EXPECT_EQ(run("SELECT v FROM hash_exec WHERE k = 42").row_count(), 2U);
+    EXPECT_EQ(run("SELECT v FROM hash_exec WHERE k = 7").row_count(), 4U);
+
+    static_cast<void>(run("DROP TABLE hash_exec"));
+}
+
+TEST(ExecutionTests, BrinBitmapHeapScan) {
+    static_cast<void>(std::remove("./test_data/brin_exec.heap"));
+    static_cast<void>(std::remove("./test_data/brin_exec_ts.idx"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    auto run = [&](const std::string& sql) {
+        auto res = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+    auto plan_text = [&](const std::string& sql) {
+        const auto res = run("EXPLAIN " + sql);
+        std::string text;
+        for (const auto& row : res.rows()) text += row.get(0).to_string() + "\n";
+        return text;
+    };
+    auto insert_rows = [&](int from, int to) {
+        std::string sql = "INSERT INTO brin_exec VALUES ";
+        for (int i = from; i < to; ++i) {
+            sql += (i > from ? ", (" : "(") + std::to_string(i) +
+                   ", 'event payload padded out to fill the heap page " + std::to_string(i) +
+                   "', TRUE)";
+        }
+        static_cast<void>(run(sql));
+    };
+
+    static_cast<void>(run("CREATE TABLE brin_exec (ts BIGINT, v TEXT, ok BOOLEAN)"));
+    for (int i = 0; i < 6000; i += 500) {
+        insert_rows(i, i + 500);
+    }
+    /* Booleans have no useful bounds */
+    EXPECT_FALSE(exec.execute(*Parser(std::make_unique<Lexer>(
+                                          "CREATE INDEX brin_exec_ok ON brin_exec USING brin (ok)"))
+                                   .parse_statement())
+                     .success());
+    static_cast<void>(run("CREATE INDEX brin_exec_ts ON brin_exec USING BRIN (ts)"));
+
+    const std::string query = "SELECT v FROM brin_exec WHERE ts >= 1000 AND ts < 1100";
+    const std::string plan = plan_text(query);
+    EXPECT_NE(plan.find("Bitmap Heap Scan on brin_exec"), std::string::npos) << plan;
+    EXPECT_NE(plan.find("Bitmap Index Scan on brin_exec_ts"), std::string::npos) << plan;
+    EXPECT_EQ(run(query).row_count(), 100U);
+
+    /* Rows added after the index was built are summarized as they arrive */
+    insert_rows(6000, 6500);
+    EXPECT_EQ(run("SELECT v FROM brin_exec WHERE ts >= 6400").row_count(), 100U);
+    EXPECT_EQ(run("SELECT v FROM brin_exec WHERE ts > 6499").row_count(), 0U);
+
+    /* Analyzed, the planner costs the pages the summaries select */
+    static_cast<void>(run("ANALYZE brin_exec"));
+    const auto analyzed = run("EXPLAIN ANALYZE " + query);
+    std::string text;
+    for (const auto& row : analyzed.rows()) text += row.get(0).to_string() + "\n";
+    EXPECT_NE(text.find("Bitmap Heap Scan on brin_exec"), std::string::npos) << text;
+    EXPECT_NE(text.find("Page Ranges: 2"), std::string::npos) << text;
+    EXPECT_EQ(run(query).row_count(), 100U);
+    /* A predicate matching most of the table reads it sequentially instead */
+    EXPECT_EQ(plan_text("SELECT v FROM brin_exec WHERE ts > 10").find("Bitmap"),
+              std::string::npos);
+
+    static_cast<void>(run("DROP TABLE brin_exec"));
+}
+
+TEST(ExecutionTests, AnalyzeStatistics) {
+    static_cast<void>(std::remove("./test_data/analyze_test.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    auto run = [&](const std::string& sql) {
+        auto res = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+
+    const auto stmt = Parser(std::make_unique<Lexer>("ANALYZE analyze_test")).parse_statement();
+    ASSERT_NE(stmt, nullptr);
+    ASSERT_EQ(stmt->type(), StmtType::Analyze);
+    EXPECT_EQ(dynamic_cast<const AnalyzeStatement&>(*stmt).table_name(), "analyze_test");
+    EXPECT_FALSE(exec.execute(*stmt).success());
+
+    /* k: ten values, every 20th row NULL; v: distinct */
+    static_cast<void>(run("CREATE TABLE analyze_test (k BIGINT, v BIGINT)"));
+    for (int batch = 0; batch < 10; ++batch) {
+        std::string sql = "INSERT INTO analyze_test VALUES ";
+        for (int i = 0; i < 100; ++i) {
+            const int n = batch * 100 + i;
+            if (i > 0) sql += ", ";
+            sql += n % 20 == 0 ? "(NULL" : "(" + std::to_string(n % 10);
+            sql += ", " + std::to_string(n) + ")";
+        }
+        static_cast<void>(run(sql));
+    }
+    EXPECT_EQ(run("ANALYZE").rows_affected(), 1U);
+
+    const auto* table = catalog->get_table_by_name("analyze_test").value();
+    ASSERT_TRUE(table->stats.has_value());
+    const TableStats& stats = *table->stats;
+    EXPECT_EQ(stats.row_count, 1000U);
+    EXPECT_EQ(table->num_rows, 1000U);
+    EXPECT_GE(stats.page_count, 1U);
+    ASSERT_EQ(stats.columns.size(), 2U);
+
+    /* n % 20 == 0 rows all have k = 0, so 0 is the rarest value */
+    const ColumnStats& k = stats.columns[0];
+    EXPECT_DOUBLE_EQ(k.null_fraction, 0.05);
+    EXPECT_DOUBLE_EQ(k.distinct_count, 10.0);
+    ASSERT_EQ(k.most_common_values.size(), 10U);
+    EXPECT_TRUE(k.histogram_bounds.empty());
+    EXPECT_DOUBLE_EQ(cost::equality_selectivity(k, Value::make_int64(3)), 0.1);
+    EXPECT_DOUBLE_EQ(cost::equality_selectivity(k, Value::make_int64(0)), 0.05);
+    EXPECT_DOUBLE_EQ(cost::equality_selectivity(k, Value::make_int64(42)), 0.0);
+    EXPECT_DOUBLE_EQ(cost::equality_selectivity(k, Value::make_null()), 0.0);
+
+    const ColumnStats& v = stats.columns[1];
+    EXPECT_DOUBLE_EQ(v.null_fraction, 0.0);
+    EXPECT_DOUBLE_EQ(v.distinct_count, 1000.0);
+    EXPECT_TRUE(v.most_common_values.empty());
+    ASSERT_EQ(v.histogram_bounds.size(), StatsBuilder::HISTOGRAM_BUCKETS + 1);
+    EXPECT_EQ(v.histogram_bounds.front().to_int64(), 0);
+    EXPECT_EQ(v.histogram_bounds.back().to_int64(), 999);
+    EXPECT_NEAR(cost::equality_selectivity(v, Value::make_int64(7)), 0.001, 1e-9);
+    const auto half = cost::range_selectivity(v, std::nullopt,
+                                              storage::BTreeIndex::Bound{Value::make_int64(500)});
+    EXPECT_NEAR(half, 0.5, 0.01);
+    const auto tenth = cost::range_selectivity(
+        v, storage::BTreeIndex::Bound{Value::make_int64(100)},
+        storage::BTreeIndex::Bound{Value::make_int64(200)});
+    EXPECT_NEAR(tenth, 0.1, 0.01);
+
+    /* A sample smaller than the table still finds the common values */
+    StatsBuilder sampled(1, 200, 7);
+    for (int i = 0; i < 5000; ++i) sampled.add_row(Tuple({Value::make_int64(i % 4)}));
+    const TableStats small = sampled.build();
+    EXPECT_EQ(small.row_count, 5000U);
+    EXPECT_EQ(small.sampled_rows, 200U);
+    EXPECT_EQ(small.columns[0].most_common_values.size(), 4U);
+    EXPECT_DOUBLE_EQ(small.columns[0].distinct_count, 4.0);
+
+    /* Join the small relation 2 first: relation 0 joined with 1 makes 1M rows */
+    const std::vector<double> rows = {1000.0, 1000000.0, 10.0};
+    const std::vector<cost::JoinEdge> edges = {{0, 1, 0.001}, {0, 2, 0.1}};
+    EXPECT_EQ(cost::order_joins(rows, edges), (std::vector<size_t>{0, 2, 1}));
+    EXPECT_LT(cost::join_order_cost(rows, edges, {0, 2, 1}),
+              cost::join_order_cost(rows, edges, {0, 1, 2}));
+    EXPECT_TRUE(cost::order_joins(rows, {{0, 1, 0.001}}).empty());
+
+    static_cast<void>(std::remove("./test_data/analyze_test.heap"));
+}
+
+TEST(ExecutionTests, ExplainAnalyze) {
+    static_cast<void>(std::remove("./test_data/explain_test.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    auto run = [&](const std::string& sql) {
+        auto res = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+    auto plan_text = [](const QueryResult& res) {
+        std::string text;
+        for (const auto& row : res.rows()) text += row.get(0).to_string() + "\n";
+        return text;
+    };
+
+    const auto stmt =
+        Parser(std::make_unique<Lexer>("EXPLAIN ANALYZE SELECT * FROM explain_test")).parse_statement();
+    ASSERT_NE(stmt, nullptr);
+    ASSERT_EQ(stmt->type(), StmtType::Explain);
+    EXPECT_TRUE(dynamic_cast<const ExplainStatement&>(*stmt).analyze());
+    EXPECT_EQ(dynamic_cast<const ExplainStatement&>(*stmt).statement().type(), StmtType::Select);
+    EXPECT_EQ(Parser(std::make_unique<Lexer>("EXPLAIN EXPLAIN SELECT 1")).parse_statement(),
+              nullptr);
+
+    static_cast<void>(run("CREATE TABLE explain_test (id BIGINT, grp BIGINT)"));
+    std::string sql = "INSERT INTO explain_test VALUES ";
+    for (int i = 0; i < 100; ++i) {
+        sql += (i > 0 ? ", (" : "(") + std::to_string(i) + ", " + std::to_string(i % 4) + ")";
+    }
+    static_cast<void>(run(sql));
+
+    /* Without ANALYZE nothing runs: the tree has no figures */
+    const auto plain = run("EXPLAIN SELECT id FROM explain_test WHERE grp = 1 LIMIT 5");
+    ASSERT_EQ(plain.schema().column_count(), 1U);
+    EXPECT_EQ(plain.schema().get_column(0).name(), "QUERY PLAN");
+    const std::string plain_text = plan_text(plain);
+    EXPECT_EQ(plain_text.rfind("Limit", 0), 0U) << plain_text;
+    EXPECT_NE(plain_text.find("->  Filter"), std::string::npos) << plain_text;
+    EXPECT_NE(plain_text.find("Seq Scan on explain_test"), std::string::npos) << plain_text;
+    EXPECT_EQ(plain_text.find("actual time"), std::string::npos) << plain_text;
+
+    /* The scan stops once the limit is met: 5 rows of group 1 are ids 1..17 */
+    const std::string text =
+        plan_text(run("EXPLAIN ANALYZE SELECT id FROM explain_test WHERE grp = 1 LIMIT 5"));
+    EXPECT_NE(text.find("Limit (actual time="), std::string::npos) << text;
+    EXPECT_NE(text.find("rows=5 loops=1"), std::string::npos) << text;
+    EXPECT_NE(text.find("Seq Scan on explain_test (actual time="), std::string::npos) << text;
+    EXPECT_NE(text.find("rows=18 loops=1"), std::string::npos) << text;
+    EXPECT_NE(text.find("Buffers: hit="), std::string::npos) << text;
+    EXPECT_NE(text.find("Execution Time: "), std::string::npos) << text;
+
+    /* Operators built outside EXPLAIN ANALYZE keep no statistics */
+    EXPECT_EQ(run("SELECT id FROM explain_test").row_count(), 100U);
+    EXPECT_FALSE(InstrumentScope::active());
+
+    EXPECT_FALSE(exec.execute(*Parser(std::make_unique<Lexer>("EXPLAIN DELETE FROM explain_test"))
+                                   .parse_statement())
+                     .success());
+
+    static_cast<void>(std::remove("./test_data/explain_test.heap"));
+}
+
+TEST(MetricsTests, PrometheusText) {
+    MetricsRegistry registry;
+    Counter& requests = registry.counter("test_requests_total", "Requests", "kind=\"a\"");
+    EXPECT_EQ(&registry.counter("test_requests_total", "Requests", "kind=\"a\""), &requests);
+    requests.inc(3);
+    registry.gauge("test_depth", "Queue depth").set(-2);
+    LatencyHistogram& latency = registry.histogram("test_latency_seconds", "Latency");
+    latency.record(uint64_t{3});    /* [2, 4) us */
+    latency.record(uint64_t{1000}); /* [512, 1024) us */
+
+    /* Collectors add to the owned series; equal names and labels are summed */
+    auto first = registry.add_collector([](MetricsSnapshot& out) {
+        out.add_counter("test_requests_total", "Requests", 2, "kind=\"a\"");
+        out.add_gauge("test_pool_hit_ratio", "Hit ratio", 0.25);
+    });
+    {
+        auto second = registry.add_collector(
+            [](MetricsSnapshot& out) { out.add_counter("test_requests_total", "Requests", 1); });
+        const std::string text = registry.collect().to_prometheus();
+        EXPECT_NE(text.find("# TYPE test_requests_total counter\n"), std::string::npos);
+        EXPECT_NE(text.find("test_requests_total{kind=\"a\"} 5\n"), std::string::npos);
+        EXPECT_NE(text.find("test_requests_total 1\n"), std::string::npos);
+        EXPECT_NE(text.find("test_depth -2\n"), std::string::npos);
+        EXPECT_NE(text.find("test_pool_hit_ratio 0.25\n"), std::string::npos);
+        EXPECT_NE(text.find("# TYPE test_latency_seconds histogram\n"), std::string::npos);
+        EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"2e-06\"} 0\n"), std::string::npos);
+        EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"4e-06\"} 1\n"), std::string::npos);
+        EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"+Inf\"} 2\n"), std::string::npos);
+        EXPECT_NE(text.find("test_latency_seconds_sum 0.001003\n"), std::string::npos);
+        EXPECT_NE(text.find("test_latency_seconds_count 2\n"), std::string::npos);
+    }
+    /* A dropped registration takes its collector with it */
+    EXPECT_EQ(registry.collect().to_prometheus().find("test_requests_total 1\n"),
+              std::string::npos);
+
+    const auto rows = registry.collect().rows();
+    const auto find = [&](const std::string& name, const std::string& labels) {
+        return std::find_if(rows.begin(), rows.end(), [&](const MetricsSnapshot::Row& row) {
+            return row.name == name && row.labels == labels;
+        });
+    };
+    ASSERT_NE(find("test_latency_seconds_count", ""), rows.end());
+    EXPECT_DOUBLE_EQ(find("test_latency_seconds_count", "")->value, 2.0);
+    ASSERT_NE(find("test_latency_seconds", "quantile=\"0.99\""), rows.end());
+    EXPECT_DOUBLE_EQ(find("test_latency_seconds", "quantile=\"0.99\"")->value, 1024e-6);
+    EXPECT_EQ(metric_label("q", "a\"b"), "q=\"a\\\"b\"");
+}
+
+TEST(ExecutionTests, SysMetricsView) {
+    static_cast<void>(std::remove("./test_data/sys_metrics_src.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    auto run = [&](const std::string& sql) {
+        auto res = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+    static_cast<void>(run("CREATE TABLE sys_metrics_src (id BIGINT)"));
+    static_cast<void>(run("INSERT INTO sys_metrics_src VALUES (1), (2)"));
+    static_cast<void>(run("SELECT id FROM sys_metrics_src"));
+
+    const auto all = run("SELECT * FROM sys_metrics");
+    ASSERT_EQ(all.schema().column_count(), 4U);
+    EXPECT_GT(all.row_count(), 10U);
+
+    /* Buffer pool, storage and executor series, filtered like any table */
+    const auto hits = run(
+        "SELECT name, value FROM sys_metrics WHERE name = 'cloudsql_buffer_pool_hits_total'");
+    EXPECT_GE(hits.row_count(), 1U);
+    const auto selects = run(
+        "SELECT value FROM sys_metrics WHERE name = 'cloudsql_executor_statements_total' "
+        "AND labels = 'type=\"select\"'");
+    ASSERT_EQ(selects.row_count(), 1U);
+    EXPECT_GE(selects.rows()[0].get(0).to_float64(), 2.0);
+    const auto reads = run(
+        "SELECT type FROM sys_metrics WHERE name = 'cloudsql_storage_read_latency_seconds_count'");
+    ASSERT_EQ(reads.row_count(), 1U);
+    EXPECT_EQ(reads.rows()[0].get(0).to_string(), "histogram");
+    static_cast<void>(std::remove("./test_data/sys_metrics_src.heap"));
+}
+
+TEST(TraceTests, SpansNestSampleAndExport) {
+    Tracer& tracer = Tracer::global();
+    const size_t capacity = tracer.capacity();
+    tracer.clear();
+
+    /* Unsampled: nothing is recorded and no context leaks to the thread */
+    tracer.set_sample_rate(0);
+    {
+        const Span root("test.root", Span::Start::RootIfSampled);
+        EXPECT_FALSE(root.active());
+        EXPECT_FALSE(Tracer::current().traced());
+    }
+    EXPECT_TRUE(tracer.spans().empty());
+
+    tracer.set_sample_rate(1);
+    TraceContext root_context;
+    {
+        Span root("test.root", Span::Start::RootIfSampled);
+        ASSERT_TRUE(root.active());
+        root_context = root.context();
+        EXPECT_EQ(Tracer::current().span_id, root_context.span_id);
+        {
+            Span child("test.child");
+            child.set_attribute("rows", "3");
+            EXPECT_EQ(Tracer::current().span_id, child.context().span_id);
+        }
+        EXPECT_EQ(Tracer::current().span_id, root_context.span_id);
+    }
+    tracer.set_sample_rate(0);
+    EXPECT_FALSE(Tracer::current().traced());
+    /* A child outside any trace stays off even with sampling on */
+    EXPECT_FALSE(Span("test.orphan").active());
+
+    auto spans = tracer.spans();
+    ASSERT_EQ(spans.size(), 2U);
+    EXPECT_EQ(spans[0].name, "test.child"); /* Recorded when it ends, first */
+    EXPECT_EQ(spans[0].parent_id, root_context.span_id);
+    EXPECT_EQ(spans[0].trace_id, root_context.trace_id);
+    EXPECT_EQ(spans[0].attributes_text(), "rows=3");
+    EXPECT_EQ(spans[1].parent_id, 0U);
+
+    const std::string json = tracer.to_otlp_json();
+    EXPECT_NE(json.find("\"resourceSpans\""), std::string::npos);
+    EXPECT_NE(json.find("\"traceId\":\"0000000000000000" + Tracer::id_hex(root_context.trace_id)),
+              std::string::npos);
+    EXPECT_NE(json.find("\"parentSpanId\":\"" + Tracer::id_hex(root_context.span_id)),
+              std::string::npos);
+    EXPECT_NE(json.find("{\"key\":\"rows\",\"value\":{\"stringValue\":\"3\"}}"),
+              std::string::npos);
+
+    /* The buffer keeps the newest spans */
+    tracer.set_capacity(2);
+    for (const char* name : {"a", "b", "c"}) {
+        tracer.record(SpanRecord{1, 2, 0, name, "", 0, 0, {}});
+    }
+    spans = tracer.spans();
+    ASSERT_EQ(spans.size(), 2U);
+    EXPECT_EQ(spans[0].name, "b");
+    EXPECT_EQ(spans[1].name, "c");
+    tracer.set_capacity(capacity);
+}
+
+TEST(ExecutionTests, SysTracesView) {
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+    auto run = [&](const std::string& sql) {
+        auto res = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+
+    Tracer& tracer = Tracer::global();
+    tracer.clear();
+    tracer.set_sample_rate(1);
+    static_cast<void>(run("SELECT name FROM sys_metrics WHERE name = 'none'"));
+    tracer.set_sample_rate(0);
+
+    /* The statement, its planning and its run, as one trace rooted at the statement */
+    const auto spans = run("SELECT name, parent_id, trace_id, attributes FROM sys_traces");
+    ASSERT_EQ(spans.row_count(), 3U);
+    std::map<std::string, size_t> by_name;
+    for (size_t i = 0; i < spans.row_count(); ++i) {
+        by_name[spans.rows()[i].get(0).to_string()] = i;
+    }
+    ASSERT_EQ(by_name.count("executor.statement"), 1U);
+    ASSERT_EQ(by_name.count("executor.plan"), 1U);
+    ASSERT_EQ(by_name.count("executor.run"), 1U);
+    const auto& root = spans.rows()[by_name["executor.statement"]];
+    EXPECT_TRUE(root.get(1).is_null());
+    EXPECT_EQ(root.get(3).to_string(), "statement=select, rows=0");
+    for (const char* name : {"executor.plan", "executor.run"}) {
+        EXPECT_EQ(spans.rows()[by_name[name]].get(2).to_string(), root.get(2).to_string());
+    }
+    tracer.clear();
+}
+
+TEST(ExecutionTests, CostBasedJoinOrder) {
+    for (const char* name : {"cbo_a", "cbo_b", "cbo_c"}) {
+        static_cast<void>(std::remove(("./test_data/" + std::string(name) + ".heap").c_str()));
+    }
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    auto run = [&](const std::string& sql) {
+        auto res = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+    auto rows = [&](const std::string& sql) {
+        const auto res = run(sql);
+        std::vector<std::string> out;
+        for (size_t i = 0; i < res.schema().column_count(); ++i) {
+            out.push_back(res.schema().get_column(i).name());
+        }
+        std::vector<std::string> body;
+        for (const auto& row : res.rows()) body.push_back(row.to_string());
+        std::sort(body.begin(), body.end());
+        out.insert(out.end(), body.begin(), body.end());
+        return out;
+    };
+    auto insert = [&](const std::string& table, int count, auto&& make_row) {
+        std::string sql = "INSERT INTO " + table + " VALUES ";
+        for (int i = 0; i < count; ++i) sql += (i > 0 ? ", " : "") + make_row(i);
+        static_cast<void>(run(sql));
+    };
+
+    static_cast<void>(run("CREATE TABLE cbo_a (id BIGINT, x BIGINT)"));
+    static_cast<void>(run("CREATE TABLE cbo_b (id BIGINT, aid BIGINT)"));
+    static_cast<void>(run("CREATE TABLE cbo_c (id BIGINT, label TEXT)"));
+    insert("cbo_a", 60, [](int i) {
+        return "(" + std::to_string(i) + ", " + std::to_string(i % 50) + ")";
+    });
+    for (int batch = 0; batch < 4; ++batch) {
+        insert("cbo_b", 500, [batch](int i) {
+            const int n = batch * 500 + i;
+            return "(" + std::to_string(n) + ", " + std::to_string(n % 50) + ")";
+        });
+    }
+    insert("cbo_c", 5, [](int i) {
+        return "(" + std::to_string(i) + ", 'c" + std::to_string(i) + "')";
+    });
+
+    const std::vector<std::string> queries = {
+        /* Written order joins the large table first */
+        "SELECT cbo_a.x, cbo_b.id, cbo_c.label FROM cbo_a JOIN cbo_b ON cbo_a.id = cbo_b.aid "
+        "JOIN cbo_c ON cbo_c.id = cbo_a.x",
+        "SELECT id, label FROM cbo_a JOIN cbo_b ON cbo_a.id = cbo_b.aid "
+        "JOIN cbo_c ON cbo_c.id = cbo_a.x WHERE cbo_b.id < 300",
+        /* Outer joins keep their order but may build on the left input */
+        "SELECT cbo_a.id, cbo_b.id FROM cbo_a LEFT JOIN cbo_b ON cbo_a.id = cbo_b.aid",
+        "SELECT cbo_c.id, cbo_a.id FROM cbo_c RIGHT JOIN cbo_a ON cbo_c.id = cbo_a.x"};
+
+    std::vector<std::vector<std::string>> expected;
+    for (const auto& sql : queries) expected.push_back(rows(sql));
+    EXPECT_EQ(expected[0].size(), 3U + 200U);
+
+    static_cast<void>(run("ANALYZE cbo_a"));
+    static_cast<void>(run("ANALYZE cbo_b"));
+    static_cast<void>(run("ANALYZE cbo_c"));
+    for (size_t i = 0; i < queries.size(); ++i) {
+        EXPECT_EQ(rows(queries[i]), expected[i]) << queries[i];
+    }
+
+    for (const char* name : {"cbo_a", "cbo_b", "cbo_c"}) {
+        static_cast<void>(std::remove(("./test_data/" + std::string(name) + ".heap").c_str()));
+    }
+}
+
+TEST(ExecutionTests, PreparedStatementCache) {
+    static_cast<void>(std::remove("./test_data/prep_test.heap"));
+    static_cast<void>(std::remove("./test_data/prep_test_id.idx"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+    PlanCache cache(*catalog, 2);
+
+    auto run = [&](const std::string& sql, const std::vector<Value>& params = {}) {
+        const auto prepared = cache.prepare(sql);
+        EXPECT_NE(prepared, nullptr) << sql;
+        prepared->bind(params);
+        auto res = exec.execute(*prepared->statement);
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+
+    static_cast<void>(run("CREATE TABLE prep_test (id BIGINT, name TEXT)"));
+    static_cast<void>(run("INSERT INTO prep_test VALUES (1, 'a'), (2, 'b'), (3, 'c'), (4, NULL)"));
+    const std::string lookup = "SELECT name FROM prep_test WHERE id = $1 OR name = $2";
+    const uint64_t misses = cache.misses();
+
+    auto res = run(lookup, {Value::make_int64(2), Value::make_text("c")});
+    ASSERT_EQ(res.row_count(), 2U);
+    res = run(lookup, {Value::make_int64(1), Value::make_text("z")});
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_EQ(res.rows()[0].get(0).to_string(), "a");
+    EXPECT_EQ(cache.misses(), misses + 1);
+    EXPECT_EQ(cache.hits(), 1U);
+
+    const auto prepared = cache.prepare(lookup);
+    ASSERT_EQ(prepared->parameters.size(), 2U);
+    EXPECT_NE(prepared->statement->to_string().find("$2"), std::string::npos);
+    EXPECT_EQ(cache.prepare(lookup, {20, 25}) == prepared, false);
+
+    /* DDL bumps the catalog version: the next use parses again, and the index is used */
+    static_cast<void>(run("CREATE INDEX prep_test_id ON prep_test (id)"));
+    const auto reparsed = cache.prepare("SELECT name FROM prep_test WHERE id = $1");
+    EXPECT_EQ(cache.prepare("SELECT name FROM prep_test WHERE id = $1"), reparsed);
+    EXPECT_NE(cache.prepare(lookup), prepared);
+    res = run("SELECT name FROM prep_test WHERE id = $1", {Value::make_int64(3)});
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_EQ(res.rows()[0].get(0).to_string(), "c");
+    EXPECT_LE(cache.size(), 2U);
+
+    EXPECT_EQ(cache.prepare("SELECT name FROM prep_test WHERE id = $0"), nullptr);
+    EXPECT_EQ(cache.prepare("SELEKT 1"), nullptr);
+
+    static_cast<void>(run("DROP INDEX prep_test_id"));
+    static_cast<void>(std::remove("./test_data/prep_test.heap"));
+    static_cast<void>(std::remove("./test_data/prep_test_id.idx"));
+}
+
+TEST(ExecutionTests, ResultCacheInvalidatesOnWrite) {
+    static_cast<void>(std::remove("./test_data/rcache_test.heap"));
+    static_cast<void>(std::remove("./test_data/rcache_test_id.idx"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    ResultCache cache;
+    QueryExecutor reader(*catalog, sm, lm, tm);
+    QueryExecutor other(*catalog, sm, lm, tm);
+    QueryExecutor writer(*catalog, sm, lm, tm);
+    for (auto* exec : {&reader, &other, &writer}) {
+        exec->set_result_cache(&cache);
+    }
+    PlanCache plans(*catalog);
+
+    auto run = [&](QueryExecutor& exec, const std::string& sql,
+                   const std::vector<Value>& params = {}) {
+        const auto prepared = plans.prepare(sql);
+        EXPECT_NE(prepared, nullptr) << sql;
+        prepared->bind(params);
+        auto res = exec.execute(*prepared->statement);
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+    auto count = [&](QueryExecutor& exec, const std::string& sql) {
+        const auto res = run(exec, sql);
+        return res.row_count() == 1 ? res.rows()[0].get(0).to_int64() : -1;
+    };
+
+    static_cast<void>(run(writer, "CREATE TABLE rcache_test (id BIGINT, grp BIGINT)"));
+    static_cast<void>(run(writer, "INSERT INTO rcache_test VALUES (1, 0), (2, 0), (3, 1), (4, 1)"));
+    const std::string total = "SELECT COUNT(*) FROM rcache_test";
+
+    /* Opt-in: without the setting the cache is not consulted */
+    EXPECT_EQ(count(reader, total), 4);
+    EXPECT_EQ(cache.hits() + cache.misses(), 0U);
+    const auto bad = reader.execute(*plans.prepare("SET result_cache = maybe")->statement);
+    EXPECT_NE(bad.error().find("result_cache"), std::string::npos);
+    static_cast<void>(run(reader, "SET result_cache = on"));
+    static_cast<void>(run(other, "SET result_cache = on"));
+    EXPECT_TRUE(reader.caches_results());
+
+    /* Keyed by the parsed statement: spacing and keyword case do not matter */
+    EXPECT_EQ(count(reader, total), 4);
+    EXPECT_EQ(cache.misses(), 1U);
+    EXPECT_EQ(count(other, "select   count(*)  from rcache_test"), 4);
+    EXPECT_EQ(cache.hits(), 1U);
+    EXPECT_EQ(cache.size(), 1U);
+
+    /* A write to the table, from any session, invalidates its results */
+    static_cast<void>(run(writer, "INSERT INTO rcache_test VALUES (5, 2)"));
+    EXPECT_EQ(count(reader, total), 5);
+    EXPECT_EQ(cache.invalidations(), 1U);
+    EXPECT_EQ(count(other, total), 5);
+    EXPECT_EQ(cache.hits(), 2U);
+
+    /* Rolled back writes change nothing; committed ones count once they commit */
+    static_cast<void>(run(writer, "BEGIN"));
+    static_cast<void>(run(writer, "DELETE FROM rcache_test WHERE id = 5"));
+    EXPECT_EQ(count(reader, total), 5);
+    static_cast<void>(run(writer, "ROLLBACK"));
+    EXPECT_EQ(count(reader, total), 5);
+    static_cast<void>(run(writer, "BEGIN"));
+    static_cast<void>(run(writer, "DELETE FROM rcache_test WHERE id = 5"));
+    static_cast<void>(run(writer, "COMMIT"));
+    EXPECT_EQ(count(reader, total), 4);
+
+    /* Bound parameters are part of the key */
+    const std::string by_id = "SELECT grp FROM rcache_test WHERE id = $1";
+    const uint64_t hits = cache.hits();
+    EXPECT_EQ(run(reader, by_id, {Value::make_int64(1)}).rows()[0].get(0).to_int64(), 0);
+    EXPECT_EQ(run(reader, by_id, {Value::make_int64(3)}).rows()[0].get(0).to_int64(), 1);
+    EXPECT_EQ(run(reader, by_id, {Value::make_int64(1)}).rows()[0].get(0).to_int64(), 0);
+    EXPECT_EQ(cache.hits(), hits + 1);
+
+    /* Statements that print alike but group differently are different keys */
+    const std::string where = "SELECT COUNT(*) FROM rcache_test WHERE ";
+    EXPECT_EQ(count(reader, where + "(id = 1 OR id = 3) AND grp = 1"), 1);
+    EXPECT_EQ(count(reader, where + "id = 1 OR (id = 3 AND grp = 1)"), 2);
+
+    /* DDL moves the catalog version; inside a transaction the cache is not used */
+    static_cast<void>(run(writer, "CREATE INDEX rcache_test_id ON rcache_test (id)"));
+    const uint64_t misses = cache.misses();
+    EXPECT_EQ(count(reader, total), 4);
+    EXPECT_EQ(cache.misses(), misses + 1);
+    static_cast<void>(run(reader, "BEGIN"));
+    EXPECT_FALSE(reader.caches_results());
+    EXPECT_EQ(count(reader, total), 4);
+    static_cast<void>(run(reader, "COMMIT"));
+    EXPECT_EQ(cache.misses(), misses + 1);
+
+    /* System views are never cached */
+    const auto* view = dynamic_cast<const SelectStatement*>(
+        plans.prepare("SELECT name FROM sys_metrics")->statement.get());
+    ASSERT_NE(view, nullptr);
+    EXPECT_TRUE(ResultCache::probe(*catalog, *view).key.empty());
+
+    /* Bounded by memory: older entries are evicted */
+    ResultCache small(16 * 1024);
+    for (int i = 0; i < 64; ++i) {
+        const auto prepared =
+            plans.prepare("SELECT id FROM rcache_test WHERE id > " + std::to_string(i));
+        const auto& select = dynamic_cast<const SelectStatement&>(*prepared->statement);
+        const auto probe = ResultCache::probe(*catalog, select);
+        ASSERT_FALSE(probe.key.empty());
+        small.insert(probe, reader.execute(select));
+        EXPECT_LE(small.bytes(), small.capacity());
+    }
+    EXPECT_GT(small.evictions(), 0U);
+    EXPECT_LT(small.size(), 64U);
+
+    EXPECT_NE(MetricsRegistry::global().collect().to_prometheus().find(
+                  "cloudsql_result_cache_hits_total"),
+              std::string::npos);
+
+    static_cast<void>(run(writer, "DROP TABLE rcache_test"));
+    static_cast<void>(std::remove("./test_data/rcache_test.heap"));
+    static_cast<void>(std::remove("./test_data/rcache_test_id.idx"));
+}
+
+TEST(ExecutionTests, ResultStream) {
+    static_cast<void>(std::remove("./test_data/stream_test.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    auto parse = [](const std::string& sql) {
+        return Parser(std::make_unique<Lexer>(sql)).parse_statement();
+    };
+    auto run = [&](const std::string& sql) {
+        auto res = exec.execute(*parse(sql));
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+
+    static_cast<void>(run("CREATE TABLE stream_test (id BIGINT, v TEXT)"));
+    std::string sql = "INSERT INTO stream_test VALUES ";
+    for (int i = 0; i < 500; ++i) {
+        sql += (i > 0 ? ", (" : "(") + std::to_string(i) + ", 'v" + std::to_string(i) + "')";
+    }
+    static_cast<void>(run(sql));
+
+    const auto select = parse("SELECT id, v FROM stream_test WHERE id >= 100");
+    const auto& stmt = dynamic_cast<const SelectStatement&>(*select);
+    const auto expected = run("SELECT id, v FROM stream_test WHERE id >= 100");
+
+    auto stream = exec.stream(stmt);
+    ASSERT_TRUE(stream->success()) << stream->error();
+    EXPECT_EQ(stream->schema().column_count(), 2U);
+    Tuple row;
+    std::vector<std::string> rows;
+    while (stream->next(row)) rows.push_back(row.to_string());
+    EXPECT_TRUE(stream->done());
+    EXPECT_TRUE(stream->success());
+    EXPECT_EQ(stream->row_count(), 400U);
+    ASSERT_EQ(rows.size(), expected.row_count());
+    for (size_t i = 0; i < rows.size(); ++i) EXPECT_EQ(rows[i], expected.rows()[i].to_string());
+    EXPECT_FALSE(stream->next(row));
+
+    /* Abandoned early, a stream ends its transaction; writes go on afterwards */
+    stream = exec.stream(stmt);
+    ASSERT_TRUE(stream->next(row));
+    EXPECT_FALSE(stream->done());
+    stream.reset();
+    static_cast<void>(run("INSERT INTO stream_test VALUES (1000, 'late')"));
+
+    /* Inside BEGIN the stream sees the transaction's own writes */
+    static_cast<void>(run("BEGIN"));
+    static_cast<void>(run("INSERT INTO stream_test VALUES (1001, 'txn')"));
+    stream = exec.stream(stmt);
+    uint64_t count = 0;
+    while (stream->next(row)) ++count;
+    EXPECT_EQ(count, 402U);
+    stream.reset();
+    static_cast<void>(run("COMMIT"));
+
+    const auto missing = parse("SELECT id FROM no_such_table");
+    stream = exec.stream(dynamic_cast<const SelectStatement&>(*missing));
+    EXPECT_FALSE(stream->success());
+    EXPECT_TRUE(stream->done());
+
+    static_cast<void>(std::remove("./test_data/stream_test.heap"));
+}
+
+TEST(ExecutionTests, TableHandleCache) {
+    for (const char* file : {"handle_test.heap", "handle_test_id.idx", "handle_test_name.idx"}) {
+        static_cast<void>(std::remove((std::string("./test_data/") + file).c_str()));
+    }
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    auto run = [&](const std::string& sql) {
+        auto lexer = std::make_unique<Lexer>(sql);
+        Parser parser(std::move(lexer));
+        auto stmt = parser.parse_statement();
+        EXPECT_NE(stmt, nullptr) << sql;
+        auto res = exec.execute(*stmt);
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+
+    static_cast<void>(run("CREATE TABLE handle_test (id BIGINT, name TEXT)"));
+    static_cast<void>(run("CREATE INDEX handle_test_id ON handle_test (id)"));
+    static_cast<void>(run("INSERT INTO handle_test VALUES (1, 'a'), (2, 'b'), (3, 'c')"));
+
+    /* An index created after the handle was cached receives later writes as well */
+    static_cast<void>(run("CREATE INDEX handle_test_name ON handle_test (name)"));
+    static_cast<void>(run("INSERT INTO handle_test VALUES (4, 'd')"));
+    static_cast<void>(run("UPDATE handle_test SET name = 'z' WHERE id = 2"));
+    static_cast<void>(run("DELETE FROM handle_test WHERE id = 3"));
+
+    BTreeIndex by_id("handle_test_id", sm, ValueType::TYPE_INT64);
+    BTreeIndex by_name("handle_test_name", sm, ValueType::TYPE_TEXT);
+    EXPECT_EQ(by_id.search(Value::make_int64(4)).size(), 1U);
+    EXPECT_EQ(by_id.search(Value::make_int64(3)).size(), 0U);
+    EXPECT_EQ(by_name.search(Value::make_text("d")).size(), 1U);
+    EXPECT_EQ(by_name.search(Value::make_text("z")).size(), 1U);
+    EXPECT_EQ(by_name.search(Value::make_text("b")).size(), 0U);
+    EXPECT_EQ(by_name.search(Value::make_text("c")).size(), 0U);
+
+    auto res = run("SELECT id FROM handle_test WHERE name = 'z'");
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_EQ(res.rows()[0].get(0).to_int64(), 2);
+
+    /* A table recreated under the same name is opened with its new columns */
+    static_cast<void>(run("DROP TABLE handle_test"));
+    static_cast<void>(run("CREATE TABLE handle_test (name TEXT, score DOUBLE)"));
+    static_cast<void>(run("INSERT INTO handle_test VALUES ('x', 1.5)"));
+    res = run("SELECT score FROM handle_test WHERE name = 'x'");
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_DOUBLE_EQ(res.rows()[0].get(0).to_float64(), VAL_1_5);
 
-TEST(ExecutionTests, EndToEnd) {
-    static_cast<void>(std::remove("./test_data/users_e2e.heap"));
+    static_cast<void>(run("DROP TABLE handle_test"));
+    for (const char* file : {"handle_test.heap", "handle_test_id.idx", "handle_test_name.idx"}) {
+        static_cast<void>(std::remove((std::string("./test_data/") + file).c_str()));
+    }
+}
+
+TEST(ExecutionTests, ParallelAndConcurrentIndexBuild) {
+    for (const char* file : {"ibuild.heap", "ibuild.fsm", "ibuild_id.idx", "ibuild_v.idx",
+                             "ibuild_side.idx"}) {
+        static_cast<void>(std::remove((std::string("./test_data/") + file).c_str()));
+    }
     StorageManager disk_manager("./test_data");
     BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
     auto catalog = Catalog::create();
@@ -281,31 +2881,114 @@ TEST(ExecutionTests, EndToEnd) {
     TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
     QueryExecutor exec(*catalog, sm, lm, tm);
 
-    {
-        auto lexer = std::make_unique<Lexer>("CREATE TABLE users_e2e (id BIGINT, age BIGINT)");
-        auto stmt = Parser(std::move(lexer)).parse_statement();
-        const auto res = exec.execute(*stmt);
-        EXPECT_TRUE(res.success());
+    auto run = [&](const std::string& sql) {
+        Parser parser(std::make_unique<Lexer>(sql));
+        auto stmt = parser.parse_statement();
+        EXPECT_NE(stmt, nullptr) << sql;
+        return exec.execute(*stmt);
+    };
+    auto ok = [&](const std::string& sql) {
+        auto res = run(sql);
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+
+    constexpr int ROWS = 3000;
+    static_cast<void>(ok("CREATE TABLE ibuild (id BIGINT, v TEXT)"));
+    for (int base = 0; base < ROWS; base += 500) {
+        std::string sql = "INSERT INTO ibuild VALUES ";
+        for (int i = base; i < base + 500; ++i) {
+            sql += (i == base ? "(" : ", (") + std::to_string(i) + ", 'v" + std::to_string(i) +
+                   "')";
+        }
+        static_cast<void>(ok(sql));
     }
-    {
-        auto lexer = std::make_unique<Lexer>(
-            "INSERT INTO users_e2e (id, age) VALUES (1, 20), (2, 30), (3, 40)");
-        auto stmt = Parser(std::move(lexer)).parse_statement();
-        const auto res = exec.execute(*stmt);
-        EXPECT_TRUE(res.success());
+    static_cast<void>(ok("DELETE FROM ibuild WHERE id < 100"));
+
+    Schema schema;
+    schema.add_column("id", ValueType::TYPE_INT64);
+    schema.add_column("v", ValueType::TYPE_TEXT);
+
+    /* Runs of many small page ranges merge into the order a serial scan and sort gives */
+    IndexBuildOptions serial;
+    serial.parallelism = 1;
+    IndexBuildOptions parallel;
+    parallel.parallelism = 4;
+    parallel.pages_per_task = 2;
+    parallel.min_parallel_pages = 1;
+    const auto expected = collect_index_entries(sm, "ibuild", schema, 1, serial);
+    WorkStealingPool pool(4);
+    const auto entries = collect_index_entries(sm, "ibuild", schema, 1, parallel, &pool);
+    ASSERT_EQ(entries.size(), static_cast<size_t>(ROWS - 100));
+    ASSERT_EQ(entries.size(), expected.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        EXPECT_EQ(entries[i].key.to_string(), expected[i].key.to_string());
+        EXPECT_EQ(entries[i].tuple_id.to_string(), expected[i].tuple_id.to_string());
+    }
+    for (size_t i = 1; i < entries.size(); ++i) {
+        ASSERT_FALSE(entries[i].key < entries[i - 1].key);
     }
+
+    static_cast<void>(ok("CREATE INDEX ibuild_id ON ibuild (id)"));
+    BTreeIndex by_id("ibuild_id", sm, ValueType::TYPE_INT64);
+    EXPECT_EQ(by_id.search(Value::make_int64(2999)).size(), 1U);
+    EXPECT_EQ(by_id.search(Value::make_int64(50)).size(), 0U);
+
+    /* Writes made while a build is registered reach the index through its side log, whether
+     * the backfill scan saw them or not */
+    BTreeIndex side("ibuild_side", sm, ValueType::TYPE_TEXT);
+    ASSERT_TRUE(side.create());
     {
-        auto lexer = std::make_unique<Lexer>("SELECT id FROM users_e2e WHERE age > 25");
-        auto stmt = Parser(std::move(lexer)).parse_statement();
-        const auto res = exec.execute(*stmt);
-        EXPECT_TRUE(res.success());
-        EXPECT_EQ(res.row_count(), 2U);
+        ConcurrentIndexBuild build(sm, "ibuild", 1, side);
+        static_cast<void>(ok("INSERT INTO ibuild VALUES (5000, 'early')"));
+        auto backfill = collect_index_entries(sm, "ibuild", schema, 1, parallel, &pool);
+        static_cast<void>(ok("INSERT INTO ibuild VALUES (5001, 'late')"));
+        static_cast<void>(ok("UPDATE ibuild SET v = 'moved' WHERE id = 200"));
+        static_cast<void>(ok("DELETE FROM ibuild WHERE id = 5000"));
+        static_cast<void>(ok("BEGIN"));
+        static_cast<void>(ok("INSERT INTO ibuild VALUES (5002, 'undone')"));
+        static_cast<void>(ok("DELETE FROM ibuild WHERE id = 300"));
+        static_cast<void>(ok("ROLLBACK"));
+        EXPECT_EQ(build.logged(), 9U);
+
+        ASSERT_TRUE(side.bulk_load(std::move(backfill)));
+        ASSERT_TRUE(build.catch_up());
+        ASSERT_TRUE(build.publish([] { return true; }));
     }
-    static_cast<void>(std::remove("./test_data/users_e2e.heap"));
+    EXPECT_EQ(side.search(Value::make_text("early")).size(), 0U);
+    EXPECT_EQ(side.search(Value::make_text("late")).size(), 1U);
+    EXPECT_EQ(side.search(Value::make_text("moved")).size(), 1U);
+    EXPECT_EQ(side.search(Value::make_text("v200")).size(), 0U);
+    EXPECT_EQ(side.search(Value::make_text("undone")).size(), 0U);
+    EXPECT_EQ(side.search(Value::make_text("v300")).size(), 1U);
+    EXPECT_EQ(side.search(Value::make_text("v50")).size(), 0U);
+
+    /* The SQL form publishes the index only when built, and not inside a transaction */
+    static_cast<void>(ok("BEGIN"));
+    EXPECT_FALSE(run("CREATE INDEX CONCURRENTLY ibuild_v ON ibuild (v)").success());
+    static_cast<void>(ok("ROLLBACK"));
+    static_cast<void>(ok("CREATE INDEX CONCURRENTLY ibuild_v ON ibuild (v)"));
+    EXPECT_FALSE(run("CREATE INDEX CONCURRENTLY ibuild_v ON ibuild (v)").success());
+    const auto table = catalog->get_table_by_name("ibuild");
+    ASSERT_TRUE(table.has_value());
+    EXPECT_EQ((*table)->indexes.size(), 2U);
+    static_cast<void>(ok("INSERT INTO ibuild VALUES (6000, 'after')"));
+    BTreeIndex by_v("ibuild_v", sm, ValueType::TYPE_TEXT);
+    EXPECT_EQ(by_v.search(Value::make_text("after")).size(), 1U);
+    EXPECT_EQ(by_v.search(Value::make_text("moved")).size(), 1U);
+    EXPECT_EQ(by_v.search(Value::make_text("v1234")).size(), 1U);
+    auto res = ok("SELECT id FROM ibuild WHERE v = 'late'");
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_EQ(res.rows()[0].get(0).to_int64(), 5001);
+
+    static_cast<void>(side.drop());
+    static_cast<void>(ok("DROP TABLE ibuild"));
 }
 
-TEST(ExecutionTests, Sort) {
-    static_cast<void>(std::remove("./test_data/sort_test.heap"));
+TEST(ExecutionTests, ParallelScanGather) {
+    for (const char* file : {"pscan.heap", "pscan.fsm"}) {
+        static_cast<void>(std::remove((std::string("./test_data/") + file).c_str()));
+    }
     StorageManager disk_manager("./test_data");
     BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
     auto catalog = Catalog::create();
@@ -313,57 +2996,255 @@ TEST(ExecutionTests, Sort) {
     TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
     QueryExecutor exec(*catalog, sm, lm, tm);
 
-    static_cast<void>(exec.execute(
-        *Parser(std::make_unique<Lexer>("CREATE TABLE sort_test (val INT)")).parse_statement()));
-    static_cast<void>(exec.execute(
-        *Parser(std::make_unique<Lexer>("INSERT INTO sort_test VALUES (30), (10), (20)"))
-             .parse_statement()));
+    auto run = [&](const std::string& sql) {
+        Parser parser(std::make_unique<Lexer>(sql));
+        auto stmt = parser.parse_statement();
+        EXPECT_NE(stmt, nullptr) << sql;
+        return exec.execute(*stmt);
+    };
+    auto ok = [&](const std::string& sql) {
+        auto res = run(sql);
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+    auto plan_text = [&](const std::string& sql) {
+        const auto res = run("EXPLAIN " + sql);
+        std::string text;
+        for (const auto& row : res.rows()) text += row.get(0).to_string() + "\n";
+        return text;
+    };
+
+    /* Wide rows, so the heap spans enough pages for two workers */
+    constexpr int64_t ROWS = 12000;
+    static_cast<void>(ok("CREATE TABLE pscan (id BIGINT, g BIGINT, pad TEXT)"));
+    Schema schema;
+    schema.add_column("id", ValueType::TYPE_INT64);
+    schema.add_column("g", ValueType::TYPE_INT64);
+    schema.add_column("pad", ValueType::TYPE_TEXT);
+    HeapTable heap("pscan", sm, schema);
+    for (int64_t i = 0; i < ROWS; ++i) {
+        static_cast<void>(heap.insert(Tuple({Value::make_int64(i), Value::make_int64(i % 7),
+                                             Value::make_text(std::string(200, 'x'))})));
+    }
+    const uint32_t pages = heap.page_count();
+    ASSERT_GE(pages, 2 * ParallelHeapScan::PAGES_PER_WORKER);
+
+    /* Every page is handed out once, the last range running to the end of the heap */
+    ParallelHeapScan ranges(100, 32);
+    HeapTable::PageRange range{};
+    uint32_t claimed = 0;
+    while (ranges.next_range(range)) {
+        EXPECT_EQ(range.first, claimed);
+        claimed = range.end == HeapTable::PageRange::TO_END ? 100 : range.end;
+    }
+    EXPECT_EQ(claimed, 100U);
+    EXPECT_EQ(range.first, 96U);
+
+    ParallelHeapScan::set_max_workers(1);
+    EXPECT_EQ(ParallelHeapScan::plan_workers(pages), 1U);
+    EXPECT_EQ(plan_text("SELECT id FROM pscan").find("Gather"), std::string::npos);
+
+    ParallelHeapScan::set_max_workers(4);
+    const size_t workers = ParallelHeapScan::plan_workers(pages);
+    EXPECT_EQ(workers, std::min<size_t>(4, pages / ParallelHeapScan::PAGES_PER_WORKER));
+    EXPECT_EQ(ParallelHeapScan::plan_workers(ParallelHeapScan::PAGES_PER_WORKER), 1U);
+
+    /* Decomposable aggregates are computed per worker and merged */
+    const std::string agg_sql =
+        "SELECT g, COUNT(*), SUM(id), MIN(id), MAX(id), AVG(id) FROM pscan WHERE id >= 100 "
+        "GROUP BY g";
+    const std::string plan = plan_text(agg_sql);
+    EXPECT_NE(plan.find("Finalize HashAggregate"), std::string::npos) << plan;
+    EXPECT_NE(plan.find("Gather"), std::string::npos) << plan;
+    EXPECT_NE(plan.find("Workers: " + std::to_string(workers)), std::string::npos) << plan;
+    EXPECT_NE(plan.find("Partial HashAggregate"), std::string::npos) << plan;
+    EXPECT_NE(plan.find("Parallel Seq Scan on pscan"), std::string::npos) << plan;
+
+    auto res = ok(agg_sql);
+    ASSERT_EQ(res.row_count(), 7U);
+    for (const auto& row : res.rows()) {
+        const int64_t g = row.get(0).to_int64();
+        int64_t count = 0;
+        double sum = 0;
+        int64_t min = INT64_MAX;
+        int64_t max = -1;
+        for (int64_t i = 100; i < ROWS; ++i) {
+            if (i % 7 != g) continue;
+            count++;
+            sum += static_cast<double>(i);
+            min = std::min(min, i);
+            max = std::max(max, i);
+        }
+        EXPECT_EQ(row.get(1).to_int64(), count);
+        EXPECT_DOUBLE_EQ(row.get(2).to_float64(), sum);
+        EXPECT_EQ(row.get(3).to_int64(), min);
+        EXPECT_EQ(row.get(4).to_int64(), max);
+        EXPECT_DOUBLE_EQ(row.get(5).to_float64(), sum / static_cast<double>(count));
+    }
 
-    const auto res =
-        exec.execute(*Parser(std::make_unique<Lexer>("SELECT val FROM sort_test ORDER BY val"))
-                          .parse_statement());
+    /* A global aggregate has its one row, also when no worker sees a match */
+    res = ok("SELECT COUNT(*), SUM(id) FROM pscan WHERE id < 0");
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_EQ(res.rows()[0].get(0).to_int64(), 0);
+
+    /* DISTINCT aggregates do not split; the rows are still read in parallel */
+    res = ok("SELECT COUNT(DISTINCT g) FROM pscan");
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_EQ(res.rows()[0].get(0).to_int64(), 7);
+
+    /* Plain scans gather the workers' rows; each row once */
+    EXPECT_NE(plan_text("SELECT id FROM pscan WHERE g = 3").find("Gather"), std::string::npos);
+    res = ok("SELECT id FROM pscan WHERE g = 3");
+    std::vector<int64_t> ids;
+    for (const auto& row : res.rows()) ids.push_back(row.get(0).to_int64());
+    std::sort(ids.begin(), ids.end());
+    ASSERT_EQ(ids.size(), static_cast<size_t>((ROWS - 3 + 6) / 7));
+    for (size_t i = 0; i < ids.size(); ++i) {
+        EXPECT_EQ(ids[i], static_cast<int64_t>(3 + 7 * i));
+    }
+
+    /* Rows deleted by a committed statement are invisible to every worker */
+    static_cast<void>(ok("DELETE FROM pscan WHERE id < 1000"));
+    res = ok("SELECT COUNT(*) FROM pscan");
+    EXPECT_EQ(res.rows()[0].get(0).to_int64(), ROWS - 1000);
+
+    /* ORDER BY and LIMIT stop the workers early */
+    res = ok("SELECT id FROM pscan ORDER BY id LIMIT 3");
     ASSERT_EQ(res.row_count(), 3U);
-    EXPECT_STREQ(res.rows()[0].get(0).to_string().c_str(), "10");
-    EXPECT_STREQ(res.rows()[1].get(0).to_string().c_str(), "20");
-    EXPECT_STREQ(res.rows()[2].get(0).to_string().c_str(), "30");
-    static_cast<void>(std::remove("./test_data/sort_test.heap"));
+    EXPECT_EQ(res.rows()[0].get(0).to_int64(), 1000);
+    res = ok("SELECT id FROM pscan LIMIT 5");
+    EXPECT_EQ(res.row_count(), 5U);
+
+    ParallelHeapScan::set_max_workers(0);
+    static_cast<void>(ok("DROP TABLE pscan"));
 }
 
-TEST(ExecutionTests, Aggregate) {
-    static_cast<void>(std::remove("./test_data/agg_test.heap"));
+TEST(ExecutionTests, ColumnarReplica) {
+    for (const char* file : {"htap.log", "htap.heap", "htap.fsm", "htap2.heap", "htap2.fsm"}) {
+        static_cast<void>(std::remove((std::string("./test_data/") + file).c_str()));
+    }
+    recovery::LogManager log("./test_data/htap.log");
     StorageManager disk_manager("./test_data");
-    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager, &log);
     auto catalog = Catalog::create();
     LockManager lm;
-    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
-    QueryExecutor exec(*catalog, sm, lm, tm);
-
-    static_cast<void>(
-        exec.execute(*Parser(std::make_unique<Lexer>("CREATE TABLE agg_test (cat TEXT, val INT)"))
-                          .parse_statement()));
-    static_cast<void>(
-        exec.execute(*Parser(std::make_unique<Lexer>(
-                                 "INSERT INTO agg_test VALUES ('A', 10), ('A', 20), ('B', 5)"))
-                          .parse_statement()));
-
-    auto lex =
-        std::make_unique<Lexer>("SELECT cat, COUNT(val), SUM(val) FROM agg_test GROUP BY cat");
-    auto stmt = Parser(std::move(lex)).parse_statement();
-    ASSERT_NE(stmt, nullptr);
-
-    const auto res = exec.execute(*stmt);
-    EXPECT_TRUE(res.success());
+    TransactionManager tm(lm, *catalog, sm, &log);
+    QueryExecutor exec(*catalog, sm, lm, tm, &log);
+    ColumnarReplicaManager replicas(sm, tm, log);
+    exec.set_columnar_replicas(&replicas);
 
-    ASSERT_EQ(res.row_count(), 2U);
-    /* Row 0: 'A', 2, 30 */
-    EXPECT_STREQ(res.rows()[0].get(0).to_string().c_str(), "A");
-    EXPECT_STREQ(res.rows()[0].get(1).to_string().c_str(), "2");
-    EXPECT_STREQ(res.rows()[0].get(2).to_string().c_str(), "30");
-    static_cast<void>(std::remove("./test_data/agg_test.heap"));
+    auto run = [&](const std::string& sql) {
+        Parser parser(std::make_unique<Lexer>(sql));
+        auto stmt = parser.parse_statement();
+        EXPECT_NE(stmt, nullptr) << sql;
+        return exec.execute(*stmt);
+    };
+    auto ok = [&](const std::string& sql) {
+        auto res = run(sql);
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+    auto plan_text = [&](const std::string& sql) {
+        const auto res = run("EXPLAIN " + sql);
+        std::string text;
+        for (const auto& row : res.rows()) text += row.get(0).to_string() + "\n";
+        return text;
+    };
+    using Totals = std::pair<int64_t, int64_t>;
+    auto sum_count = [&]() {
+        const auto res = ok("SELECT SUM(v), COUNT(*) FROM htap");
+        EXPECT_EQ(res.row_count(), 1U);
+        return Totals(res.rows()[0].get(0).to_int64(), res.rows()[0].get(1).to_int64());
+    };
+
+    /* Rows written before attach() come from the initial copy, as on a server restart */
+    static_cast<void>(ok("CREATE TABLE htap (id BIGINT, v BIGINT)"));
+    for (int64_t i = 0; i < 25; ++i) {
+        static_cast<void>(ok("INSERT INTO htap VALUES (" + std::to_string(i) + ", " +
+                             std::to_string(i) + ")"));
+    }
+    auto info = catalog->get_table_by_name("htap");
+    ASSERT_TRUE(info.has_value());
+    EXPECT_FALSE((*info)->columnar_replica());
+    EXPECT_EQ(replicas.snapshot("htap"), nullptr);
+    ASSERT_TRUE(replicas.attach(**info));
+    EXPECT_TRUE(replicas.attached("htap"));
+    for (int64_t i = 25; i < 50; ++i) {
+        static_cast<void>(ok("INSERT INTO htap VALUES (" + std::to_string(i) + ", " +
+                             std::to_string(i) + ")"));
+    }
+    ASSERT_TRUE(replicas.catch_up());
+    EXPECT_EQ(sum_count(), Totals(1225, 50));
+
+    const std::string agg_plan = plan_text("SELECT SUM(v) FROM htap");
+    EXPECT_NE(agg_plan.find("columnar replica"), std::string::npos) << agg_plan;
+    EXPECT_EQ(plan_text("SELECT v FROM htap WHERE id = 3").find("columnar replica"),
+              std::string::npos);
+
+    /* Deletes, updates and committed transactions reach the replica; aborted ones do not */
+    static_cast<void>(ok("DELETE FROM htap WHERE id < 10"));
+    static_cast<void>(ok("UPDATE htap SET v = 100 WHERE id = 20"));
+    static_cast<void>(ok("BEGIN"));
+    static_cast<void>(ok("INSERT INTO htap VALUES (1000, 1000)"));
+    EXPECT_EQ(plan_text("SELECT SUM(v) FROM htap").find("columnar replica"), std::string::npos);
+    static_cast<void>(ok("ROLLBACK"));
+    static_cast<void>(ok("BEGIN"));
+    static_cast<void>(ok("INSERT INTO htap VALUES (50, 7)"));
+    static_cast<void>(ok("COMMIT"));
+    ASSERT_TRUE(replicas.catch_up());
+    const int64_t expected = 1225 - 45 - 20 + 100 + 7;
+    EXPECT_EQ(sum_count(), Totals(expected, 41));
+    EXPECT_GE(replicas.get_stats().rows_deleted.load(), 11U);
+
+    auto res = ok("SELECT COUNT(*) FROM htap WHERE v >= 100");
+    EXPECT_EQ(res.rows()[0].get(0).to_int64(), 1);
+
+    /* Inside a transaction the heap answers, seeing the transaction's own rows */
+    static_cast<void>(ok("BEGIN"));
+    static_cast<void>(ok("INSERT INTO htap VALUES (51, 1)"));
+    EXPECT_EQ(sum_count(), Totals(expected + 1, 42));
+    static_cast<void>(ok("ROLLBACK"));
+
+    /* The worker keeps the replica current without an explicit pass */
+    replicas.start({std::chrono::milliseconds(5), std::chrono::milliseconds(60000)});
+    static_cast<void>(ok("INSERT INTO htap VALUES (52, 3)"));
+    for (int i = 0; i < 200 && replicas.lag() > std::chrono::milliseconds(0); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    const uint64_t passes = replicas.get_stats().passes.load();
+    while (replicas.get_stats().passes.load() < passes + 2) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(sum_count(), Totals(expected + 3, 42));
+    replicas.stop();
+
+    /* CREATE TABLE attaches a replica when asked to, but not inside a transaction */
+    static_cast<void>(ok("BEGIN"));
+    EXPECT_FALSE(run("CREATE TABLE htap2 (id BIGINT) WITH (COLUMNAR_REPLICA = ON)").success());
+    static_cast<void>(ok("ROLLBACK"));
+    static_cast<void>(ok("CREATE TABLE htap2 (id BIGINT) WITH (COLUMNAR_REPLICA = ON)"));
+    info = catalog->get_table_by_name("htap2");
+    ASSERT_TRUE(info.has_value());
+    EXPECT_TRUE((*info)->columnar_replica());
+    EXPECT_TRUE(replicas.attached("htap2"));
+    static_cast<void>(ok("INSERT INTO htap2 VALUES (4)"));
+    ASSERT_TRUE(replicas.catch_up());
+    res = ok("SELECT MAX(id) FROM htap2");
+    EXPECT_EQ(res.rows()[0].get(0).to_int64(), 4);
+    static_cast<void>(ok("DROP TABLE htap2"));
+
+    /* Dropping the table removes its replica */
+    static_cast<void>(ok("DROP TABLE htap"));
+    EXPECT_FALSE(replicas.attached("htap"));
+    EXPECT_FALSE(std::ifstream("./test_data/htap.replica.meta.bin").good());
+    EXPECT_EQ(replicas.snapshot("htap"), nullptr);
 }
 
-TEST(ExecutionTests, AggregateAdvanced) {
-    static_cast<void>(std::remove("./test_data/adv_agg.heap"));
+TEST(ExecutionTests, CopyFrom) {
+    const std::vector<std::string> files = {"copy_test.heap", "copy_test.fsm", "copy_test_id.idx",
+                                            "copy_col.meta.bin", "copy_col.col0.data.bin",
+                                            "copy_col.col1.data.bin"};
+    for (const auto& file : files) static_cast<void>(std::remove(("./test_data/" + file).c_str()));
     StorageManager disk_manager("./test_data");
     BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
     auto catalog = Catalog::create();
@@ -371,26 +3252,138 @@ TEST(ExecutionTests, AggregateAdvanced) {
     TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
     QueryExecutor exec(*catalog, sm, lm, tm);
 
-    static_cast<void>(exec.execute(
-        *Parser(std::make_unique<Lexer>("CREATE TABLE adv_agg (val INT)")).parse_statement()));
-    static_cast<void>(
-        exec.execute(*Parser(std::make_unique<Lexer>("INSERT INTO adv_agg VALUES (10), (20), (30)"))
-                          .parse_statement()));
-
-    const auto res = exec.execute(
-        *Parser(std::make_unique<Lexer>("SELECT MIN(val), MAX(val), AVG(val) FROM adv_agg"))
-             .parse_statement());
-    EXPECT_TRUE(res.success());
-
+    std::vector<std::unique_ptr<Statement>> parsed;
+    auto parse = [&](const std::string& sql) -> Statement& {
+        Parser parser(std::make_unique<Lexer>(sql));
+        parsed.push_back(parser.parse_statement());
+        EXPECT_NE(parsed.back(), nullptr) << sql;
+        return *parsed.back();
+    };
+    auto run = [&](const std::string& sql) {
+        auto res = exec.execute(parse(sql));
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+    /* Feeds `data` in small pieces, so rows and fields straddle the writes */
+    auto copy = [&](const std::string& sql, const std::string& data) {
+        auto in = exec.copy_from(dynamic_cast<const CopyStatement&>(parse(sql)));
+        EXPECT_TRUE(in->success()) << in->error();
+        for (size_t i = 0; i < data.size(); i += 5) {
+            static_cast<void>(in->write(data.data() + i, std::min<size_t>(5, data.size() - i)));
+        }
+        static_cast<void>(in->finish());
+        return in;
+    };
+
+    static_cast<void>(run("CREATE TABLE copy_test (id BIGINT, name TEXT, score DOUBLE, ok BOOL)"));
+    static_cast<void>(run("CREATE INDEX copy_test_id ON copy_test (id)"));
+
+    auto in = copy("COPY copy_test FROM STDIN",
+                   "1\tann\t1.5\tt\n2\ttab\\there\t\\N\tf\n3\t\\N\t-2\ttrue");
+    ASSERT_TRUE(in->success()) << in->error();
+    EXPECT_EQ(in->row_count(), 3U);
+    auto res = run("SELECT name, score, ok FROM copy_test WHERE id = 2");
     ASSERT_EQ(res.row_count(), 1U);
-    EXPECT_STREQ(res.rows()[0].get(0).to_string().c_str(), "10");
-    EXPECT_STREQ(res.rows()[0].get(1).to_string().c_str(), "30");
-    EXPECT_STREQ(res.rows()[0].get(2).to_string().c_str(), "20");
-    static_cast<void>(std::remove("./test_data/adv_agg.heap"));
+    EXPECT_EQ(res.rows()[0].get(0).to_string(), "tab\there");
+    EXPECT_TRUE(res.rows()[0].get(1).is_null());
+    EXPECT_FALSE(res.rows()[0].get(2).as_bool());
+
+    in = copy("COPY copy_test FROM STDIN WITH (FORMAT csv, HEADER)",
+              "id,name,score,ok\r\n4,\"a,\"\"b\"\"\n\",,\r\n5,\"\",0.25,no\n\\.\nignored\n");
+    ASSERT_TRUE(in->success()) << in->error();
+    EXPECT_EQ(in->row_count(), 2U);
+    res = run("SELECT name, score FROM copy_test WHERE id = 4");
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_EQ(res.rows()[0].get(0).to_string(), "a,\"b\"\n");
+    EXPECT_TRUE(res.rows()[0].get(1).is_null());
+    res = run("SELECT name FROM copy_test WHERE id = 5");
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_FALSE(res.rows()[0].get(0).is_null());
+
+    /* Binary: signature, flags and extension length, one tuple, then the trailer */
+    std::string binary(CopyDecoder::BINARY_SIGNATURE);
+    const auto be = [&binary](uint64_t val, size_t bytes) {
+        for (size_t i = bytes; i-- > 0;) {
+            binary.push_back(static_cast<char>((val >> (i * 8)) & 0xFF));
+        }
+    };
+    be(0, 8);
+    be(4, 2);
+    be(8, 4);
+    be(6, 8);
+    be(3, 4);
+    binary += "bin";
+    double three = 3.0;
+    uint64_t bits = 0;
+    std::memcpy(&bits, &three, sizeof(bits));
+    be(8, 4);
+    be(bits, 8);
+    be(0xFFFFFFFF, 4);
+    be(0xFFFF, 2);
+    in = copy("COPY copy_test FROM STDIN (FORMAT binary)", binary);
+    ASSERT_TRUE(in->success()) << in->error();
+    EXPECT_EQ(in->row_count(), 1U);
+    res = run("SELECT name, score, ok FROM copy_test WHERE id = 6");
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_EQ(res.rows()[0].get(0).to_string(), "bin");
+    EXPECT_DOUBLE_EQ(res.rows()[0].get(1).to_float64(), 3.0);
+    EXPECT_TRUE(res.rows()[0].get(2).is_null());
+
+    /* A malformed row fails the copy, and its transaction takes the earlier rows back */
+    in = copy("COPY copy_test FROM STDIN", "7\tx\t1\tt\nseven\tx\t1\tt\n8\tx\t1\tt\n");
+    EXPECT_FALSE(in->success());
+    EXPECT_NE(in->error().find("COPY row 2"), std::string::npos) << in->error();
+    in = copy("COPY copy_test FROM STDIN", "9\tx\n");
+    EXPECT_NE(in->error().find("missing data for column \"score\""), std::string::npos);
+    res = run("SELECT COUNT(*) FROM copy_test");
+    EXPECT_EQ(res.rows()[0].get(0).to_int64(), 6);
+    BTreeIndex by_id("copy_test_id", sm, ValueType::TYPE_INT64);
+    EXPECT_TRUE(by_id.search(Value::make_int64(7)).empty());
+    EXPECT_EQ(by_id.search(Value::make_int64(6)).size(), 1U);
+
+    /* A multi-row INSERT spanning several batches keeps every index entry */
+    constexpr int64_t INSERTED = 2500;
+    std::string insert = "INSERT INTO copy_test VALUES ";
+    for (int64_t i = 0; i < INSERTED; ++i) {
+        insert += (i == 0 ? "(" : ", (") + std::to_string(INSERTED - i + 100) + ", 'n', 1.0, true)";
+    }
+    EXPECT_EQ(run(insert).rows_affected(), static_cast<uint64_t>(INSERTED));
+    res = run("SELECT COUNT(*) FROM copy_test");
+    EXPECT_EQ(res.rows()[0].get(0).to_int64(), INSERTED + 6);
+    for (const int64_t key : {int64_t{101}, int64_t{1337}, INSERTED + 100}) {
+        EXPECT_EQ(by_id.search(Value::make_int64(key)).size(), 1U) << key;
+    }
+
+    EXPECT_FALSE(exec.execute(parse("COPY copy_test FROM STDIN")).success());
+
+    /* The same pipeline appends to a columnar table */
+    Schema col_schema;
+    col_schema.add_column("id", ValueType::TYPE_INT64);
+    col_schema.add_column("tag", ValueType::TYPE_TEXT);
+    ColumnarTable columnar("copy_col", disk_manager, col_schema);
+    ASSERT_TRUE(columnar.create());
+    parser::CopyOptions csv;
+    csv.format = parser::CopyFormat::Csv;
+    csv.delimiter = ',';
+    auto col_in = exec.copy_from(columnar, csv);
+    const std::string col_data = "1,x\n2,y\n3,";
+    ASSERT_TRUE(col_in->write(col_data.data(), col_data.size()));
+    ASSERT_TRUE(col_in->finish()) << col_in->error();
+    EXPECT_EQ(columnar.row_count(), 3U);
+    auto batch = VectorBatch::create(col_schema);
+    ASSERT_TRUE(columnar.read_batch(0, 3, *batch));
+    EXPECT_EQ(batch->get_column(0).get(2).to_int64(), 3);
+    EXPECT_EQ(batch->get_column(1).get(1).to_string(), "y");
+    EXPECT_TRUE(batch->get_column(1).get(2).is_null());
+
+    static_cast<void>(run("DROP TABLE copy_test"));
+    for (const auto& file : files) static_cast<void>(std::remove(("./test_data/" + file).c_str()));
 }
 
-TEST(ExecutionTests, AggregateDistinct) {
-    static_cast<void>(std::remove("./test_data/dist_agg.heap"));
+TEST(ExecutionTests, ProjectionPushdown) {
+    const std::vector<std::string> files = {"proj_a.heap", "proj_a.fsm", "proj_a_k.idx",
+                                            "proj_b.heap", "proj_b.fsm"};
+    for (const auto& file : files) static_cast<void>(std::remove(("./test_data/" + file).c_str()));
     StorageManager disk_manager("./test_data");
     BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
     auto catalog = Catalog::create();
@@ -398,23 +3391,54 @@ TEST(ExecutionTests, AggregateDistinct) {
     TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
     QueryExecutor exec(*catalog, sm, lm, tm);
 
-    static_cast<void>(exec.execute(
-        *Parser(std::make_unique<Lexer>("CREATE TABLE dist_agg (val INT)")).parse_statement()));
+    auto run = [&](const std::string& sql) {
+        auto lexer = std::make_unique<Lexer>(sql);
+        Parser parser(std::move(lexer));
+        auto stmt = parser.parse_statement();
+        EXPECT_NE(stmt, nullptr) << sql;
+        auto res = exec.execute(*stmt);
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+
     static_cast<void>(
-        exec.execute(*Parser(std::make_unique<Lexer>(
-                                 "INSERT INTO dist_agg VALUES (10), (10), (20), (30), (30), (30)"))
-                          .parse_statement()));
+        run("CREATE TABLE proj_a (k BIGINT, a TEXT, b BIGINT, c TEXT, d DOUBLE, e TEXT)"));
+    static_cast<void>(run("CREATE TABLE proj_b (k BIGINT, label TEXT)"));
+    static_cast<void>(run("CREATE INDEX proj_a_k ON proj_a (k)"));
+    static_cast<void>(
+        run("INSERT INTO proj_a VALUES (1, 'a1', 10, 'c1', 1.5, 'e1'), "
+            "(2, 'a2', 20, 'c2', 2.5, 'e2'), (3, 'a3', 30, 'c3', 3.5, 'e3')"));
+    static_cast<void>(run("INSERT INTO proj_b VALUES (1, 'one'), (3, 'three')"));
 
-    const auto res =
-        exec.execute(*Parser(std::make_unique<Lexer>(
-                                 "SELECT COUNT(DISTINCT val), SUM(DISTINCT val) FROM dist_agg"))
-                          .parse_statement());
-    EXPECT_TRUE(res.success());
+    /* Columns read only by WHERE, ORDER BY or an aggregate are still decoded */
+    auto res = run("SELECT c FROM proj_a WHERE b > 15 ORDER BY d");
+    ASSERT_EQ(res.row_count(), 2U);
+    EXPECT_EQ(res.rows()[0].get(0).to_string(), "c2");
+    EXPECT_EQ(res.rows()[1].get(0).to_string(), "c3");
+
+    res = run("SELECT e, SUM(b) FROM proj_a GROUP BY e HAVING SUM(b) > 15");
+    EXPECT_EQ(res.row_count(), 2U);
+
+    res = run("SELECT proj_a.a, label FROM proj_a JOIN proj_b ON proj_a.k = proj_b.k");
+    ASSERT_EQ(res.row_count(), 2U);
+    for (const auto& row : res.rows()) {
+        EXPECT_FALSE(row.get(0).is_null());
+        EXPECT_FALSE(row.get(1).is_null());
+    }
 
+    /* The heap fetch of an index scan decodes the referenced columns */
+    res = run("SELECT e FROM proj_a WHERE k = 2 AND c = 'c2'");
     ASSERT_EQ(res.row_count(), 1U);
-    EXPECT_STREQ(res.rows()[0].get(0).to_string().c_str(), "3");
-    EXPECT_STREQ(res.rows()[0].get(1).to_string().c_str(), "60");
-    static_cast<void>(std::remove("./test_data/dist_agg.heap"));
+    EXPECT_EQ(res.rows()[0].get(0).to_string(), "e2");
+
+    res = run("SELECT k, a, b, c, d, e FROM proj_a WHERE k = 3");
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_EQ(res.rows()[0].get(1).to_string(), "a3");
+    EXPECT_EQ(res.rows()[0].get(5).to_string(), "e3");
+
+    static_cast<void>(run("DROP TABLE proj_a"));
+    static_cast<void>(run("DROP TABLE proj_b"));
+    for (const auto& file : files) static_cast<void>(std::remove(("./test_data/" + file).c_str()));
 }
 
 TEST(ExecutionTests, Transaction) {
@@ -561,6 +3585,143 @@ TEST(ExecutionTests, MVCC) {
     static_cast<void>(std::remove("./test_data/mvcc_test.heap"));
 }
 
+TEST(ExecutionTests, Vacuum) {
+    for (const char* file : {"vac_test.heap", "vac_test.fsm", "vac_test_id.idx"}) {
+        static_cast<void>(std::remove((std::string("./test_data/") + file).c_str()));
+    }
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+    QueryExecutor reader(*catalog, sm, lm, tm);
+
+    auto run = [](QueryExecutor& session, const std::string& sql) {
+        auto res = session.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+
+    static_cast<void>(run(exec, "CREATE TABLE vac_test (id BIGINT, v BIGINT)"));
+    static_cast<void>(run(exec, "CREATE INDEX vac_test_id ON vac_test (id)"));
+    std::string insert = "INSERT INTO vac_test VALUES ";
+    for (int i = 0; i < 200; ++i) {
+        insert += (i == 0 ? "(" : ", (") + std::to_string(i) + ", " + std::to_string(i * 2) + ")";
+    }
+    static_cast<void>(run(exec, insert));
+
+    /* An older snapshot still sees the deleted rows, so nothing can be removed yet */
+    static_cast<void>(run(reader, "BEGIN"));
+    EXPECT_FALSE(reader.execute(*Parser(std::make_unique<Lexer>("VACUUM")).parse_statement())
+                     .success());
+    static_cast<void>(run(exec, "DELETE FROM vac_test WHERE id < 150"));
+    EXPECT_EQ(tm.dead_tuple_counts()["vac_test"], 150U);
+    EXPECT_EQ(run(exec, "VACUUM vac_test").rows_affected(), 0U);
+    EXPECT_EQ(run(reader, "SELECT id FROM vac_test").row_count(), 200U);
+    static_cast<void>(run(reader, "COMMIT"));
+
+    EXPECT_EQ(run(exec, "VACUUM vac_test").rows_affected(), 150U);
+    EXPECT_TRUE(tm.dead_tuple_counts().empty());
+    EXPECT_EQ(run(exec, "SELECT id FROM vac_test").row_count(), 50U);
+    auto res = run(exec, "SELECT v FROM vac_test WHERE id = 160");
+    ASSERT_EQ(res.row_count(), 1U);
+    EXPECT_EQ(res.rows()[0].get(0).to_int64(), 320);
+
+    /* The space goes back to inserts: the heap does not grow */
+    FreeSpaceMap fsm("vac_test.fsm", sm);
+    const uint32_t pages = fsm.page_count();
+    std::string refill = "INSERT INTO vac_test VALUES ";
+    for (int i = 1000; i < 1150; ++i) {
+        refill += (i == 1000 ? "(" : ", (") + std::to_string(i) + ", 0)";
+    }
+    static_cast<void>(run(exec, refill));
+    EXPECT_EQ(fsm.page_count(), pages);
+    EXPECT_EQ(run(exec, "SELECT id FROM vac_test WHERE id = 1005").row_count(), 1U);
+
+    /* Autovacuum picks up tables once enough of their rows are dead */
+    VacuumManager autovacuum(*catalog, sm, tm);
+    VacuumManager::Options options;
+    options.naptime = std::chrono::milliseconds(5);
+    options.threshold = 100;
+    options.cost_limit = 1;
+    options.cost_delay = std::chrono::milliseconds(1);
+    autovacuum.start(options);
+    static_cast<void>(run(exec, "UPDATE vac_test SET v = 1 WHERE id >= 1000"));
+    for (int i = 0; i < 500 && !tm.dead_tuple_counts().empty(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    autovacuum.stop();
+    EXPECT_GE(autovacuum.autovacuum_runs(), 1U);
+    EXPECT_TRUE(tm.dead_tuple_counts().empty());
+    EXPECT_EQ(run(exec, "SELECT id FROM vac_test").row_count(), 200U);
+
+    static_cast<void>(run(exec, "DROP TABLE vac_test"));
+}
+
+TEST(ExecutionTests, ConcurrentVacuum) {
+    for (const char* file : {"vac_conc.heap", "vac_conc.fsm", "vac_conc_id.idx"}) {
+        static_cast<void>(std::remove((std::string("./test_data/") + file).c_str()));
+    }
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+
+    auto run = [&exec](const std::string& sql) {
+        auto res = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        return res;
+    };
+
+    static_cast<void>(run("CREATE TABLE vac_conc (id BIGINT, v BIGINT)"));
+    static_cast<void>(run("CREATE INDEX vac_conc_id ON vac_conc (id)"));
+    const auto* table = catalog->get_table_by_name("vac_conc").value();
+
+    /* Two vacuums of the table race the inserts reusing the slots they free */
+    int64_t next_id = 0;
+    int64_t live = 0;
+    for (int round = 0; round < 20; ++round) {
+        std::string insert = "INSERT INTO vac_conc VALUES ";
+        for (int i = 0; i < 100; ++i) {
+            insert += (i == 0 ? "(" : ", (") + std::to_string(next_id++) + ", 0)";
+        }
+        static_cast<void>(run(insert));
+        static_cast<void>(run("DELETE FROM vac_conc WHERE v = 0"));
+
+        std::vector<std::thread> vacuums;
+        for (int t = 0; t < 2; ++t) {
+            vacuums.emplace_back([&] {
+                VacuumManager vacuum(*catalog, sm, tm);
+                static_cast<void>(vacuum.vacuum_table(*table));
+            });
+        }
+        for (int i = 0; i < 20; ++i) {
+            static_cast<void>(
+                run("INSERT INTO vac_conc VALUES (" + std::to_string(next_id++) + ", 1)"));
+            live++;
+        }
+        for (auto& vacuum : vacuums) {
+            vacuum.join();
+        }
+    }
+
+    /* No committed row was freed, and each is still reachable through the index */
+    auto res = run("SELECT id FROM vac_conc");
+    EXPECT_EQ(res.row_count(), static_cast<size_t>(live));
+    for (const auto& row : res.rows()) {
+        const std::string id = row.get(0).to_string();
+        EXPECT_EQ(run("SELECT v FROM vac_conc WHERE id = " + id).row_count(), 1U) << id;
+    }
+    VacuumManager vacuum(*catalog, sm, tm);
+    static_cast<void>(vacuum.vacuum_table(*table));
+    EXPECT_EQ(run("SELECT id FROM vac_conc").row_count(), static_cast<size_t>(live));
+
+    static_cast<void>(run("DROP TABLE vac_conc"));
+}
+
 TEST(ExecutionTests, Join) {
     static_cast<void>(std::remove("./test_data/users_join.heap"));
     static_cast<void>(std::remove("./test_data/orders_join.heap"));
@@ -606,6 +3767,64 @@ TEST(ExecutionTests, Join) {
     static_cast<void>(std::remove("./test_data/orders_join.heap"));
 }
 
+TEST(ExecutionTests, ExchangeJoin) {
+    static_cast<void>(std::remove("./test_data/ex_users.heap"));
+    static_cast<void>(std::remove("./test_data/ex_orders.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    const cloudsql::config::Config config;
+    cloudsql::cluster::ClusterManager cm(&config);
+    QueryExecutor exec(*catalog, sm, lm, tm, nullptr, &cm);
+
+    static_cast<void>(
+        exec.execute(*Parser(std::make_unique<Lexer>("CREATE TABLE ex_users (id INT, name TEXT)"))
+                          .parse_statement()));
+    static_cast<void>(exec.execute(
+        *Parser(std::make_unique<Lexer>("CREATE TABLE ex_orders (id INT, user_id INT)"))
+             .parse_statement()));
+
+    /* Both tables stream in from two senders while the join runs */
+    exec.set_context_id("ctx_ex");
+    exec.set_exchange({"ex_orders", "ex_users"}, 2);
+    const auto row = [](int64_t a, Value b) {
+        return Tuple({Value::make_int64(a), std::move(b)});
+    };
+    std::thread senders([&] {
+        const auto ack = [] {};
+        for (int sender = 0; sender < 2; ++sender) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            std::vector<Tuple> orders;
+            orders.push_back(row(100 + sender, Value::make_int64(1)));
+            orders.push_back(row(110 + sender, Value::make_int64(2)));
+            cm.push_shuffle_chunk("ctx_ex", "ex_orders", std::move(orders), true, ack);
+            std::vector<Tuple> users;
+            users.push_back(row(sender + 1, Value::make_text(sender == 0 ? "Alice" : "Bob")));
+            cm.push_shuffle_chunk("ctx_ex", "ex_users", std::move(users), true, ack);
+        }
+    });
+    const std::string sql =
+        "SELECT ex_users.name, ex_orders.id FROM ex_users JOIN ex_orders "
+        "ON ex_users.id = ex_orders.user_id";
+    const auto result = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+    senders.join();
+    ASSERT_TRUE(result.success()) << result.error();
+    EXPECT_EQ(result.row_count(), 4U);
+    EXPECT_FALSE(cm.has_shuffle_data("ctx_ex", "ex_users"));
+
+    /* A canceled query stops waiting for its streams */
+    std::atomic<bool> canceled{true};
+    exec.set_context_id("ctx_ex2");
+    exec.set_cancel_flag(&canceled);
+    const auto stopped = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+    EXPECT_FALSE(stopped.success());
+    EXPECT_NE(stopped.error().find("canceled"), std::string::npos) << stopped.error();
+    static_cast<void>(std::remove("./test_data/ex_users.heap"));
+    static_cast<void>(std::remove("./test_data/ex_orders.heap"));
+}
+
 TEST(ExecutionTests, DDL) {
     static_cast<void>(std::remove("./test_data/ddl_test.heap"));
     StorageManager disk_manager("./test_data");
@@ -645,6 +3864,40 @@ TEST(ExecutionTests, DDL) {
     static_cast<void>(std::remove("./test_data/ddl_test.heap"));
 }
 
+/**
+ * @brief SET changes the session's read settings; without a replicated shard
+ * every level reads the node's own data
+ */
+TEST(ExecutionTests, SessionReadSettings) {
+    static_cast<void>(std::remove("./test_data/read_set_test.heap"));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager sm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, sm, sm.get_log_manager());
+    QueryExecutor exec(*catalog, sm, lm, tm);
+    const auto run = [&](const std::string& sql) {
+        return exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+    };
+
+    EXPECT_FALSE(exec.read_settings().constrained());
+    EXPECT_TRUE(run("SET read_consistency = LEADER").success());
+    EXPECT_TRUE(run("SET max_staleness = 100").success());
+    EXPECT_EQ(exec.read_settings().consistency, cloudsql::raft::ReadConsistency::Leader);
+    EXPECT_EQ(exec.read_settings().max_staleness.count(), 100);
+    const auto bad = run("SET read_consistency = eventual");
+    EXPECT_FALSE(bad.success());
+    EXPECT_NE(bad.error().find("read_consistency"), std::string::npos);
+    EXPECT_EQ(exec.read_settings().consistency, cloudsql::raft::ReadConsistency::Leader);
+
+    ASSERT_TRUE(run("CREATE TABLE read_set_test (id INT)").success());
+    ASSERT_TRUE(run("INSERT INTO read_set_test VALUES (1), (2)").success());
+    const auto rows = run("SELECT id FROM read_set_test");
+    ASSERT_TRUE(rows.success()) << rows.error();
+    EXPECT_EQ(rows.row_count(), 2U);
+    static_cast<void>(std::remove("./test_data/read_set_test.heap"));
+}
+
 TEST(LexerTests, Advanced) {
     /* 1. Test comments and line tracking */
     {
@@ -653,7 +3906,7 @@ TEST(LexerTests, Advanced) {
         const auto t1 = lexer.next_token();
         EXPECT_EQ(static_cast<int>(t1.type()), static_cast<int>(TokenType::Select));
         const auto t2 = lexer.next_token();  // Should skip comment and newline
-        EXPECT_STREQ(t2.lexeme().c_str(), "*");
+        EXPECT_EQ(t2.lexeme(), "*");
         EXPECT_EQ(t2.line(), 2U);
     }
     /* 2. Test Error and Unknown operators */
@@ -740,6 +3993,133 @@ TEST(CloudSQLTests, ExpressionTypes) {
     }
 }
 
+TEST(CloudSQLTests, CompiledExpressionMatchesInterpreter) {
+    Schema schema;
+    schema.add_column("t.a", ValueType::TYPE_INT64);
+    schema.add_column("t.b", ValueType::TYPE_FLOAT64);
+    schema.add_column("t.s", ValueType::TYPE_TEXT);
+    schema.add_column("t.flag", ValueType::TYPE_BOOL);
+    schema.add_column("COUNT(*)", ValueType::TYPE_INT64);
+
+    /* Includes NULLs and values whose type differs from the schema's */
+    const std::vector<Tuple> tuples = {
+        Tuple({Value::make_int64(5), Value::make_float64(2.5), Value::make_text("x"),
+               Value::make_bool(true), Value::make_int64(3)}),
+        Tuple({Value::make_int64(20), Value::make_float64(7.0), Value::make_text("abc"),
+               Value::make_bool(false), Value::make_int64(0)}),
+        Tuple({Value::make_null(), Value::make_null(), Value::make_null(), Value::make_null(),
+               Value::make_null()}),
+        Tuple({Value(static_cast<int32_t>(10)), Value::make_int64(10), Value::make_int64(4),
+               Value::make_int64(1), Value::make_float64(1.5)}),
+        Tuple({Value::make_float64(10.0), Value::make_text("7"), Value::make_text("x"),
+               Value::make_bool(true)}),
+    };
+    const std::vector<std::string> expressions = {
+        "a",
+        "t.a",
+        "missing",
+        "a + 1",
+        "a * b - 2",
+        "a / 4",
+        "-b",
+        "a = 10",
+        "a <> 10",
+        "10 = a",
+        "a < 10",
+        "a <= 10",
+        "a > 10",
+        "a >= 10",
+        "10 > a",
+        "b < 2.5",
+        "b >= 7.0",
+        "2.5 = b",
+        "a < b",
+        "s = 'x'",
+        "s > 'ab'",
+        "a > 1 AND b < 5.0",
+        "a > 100 OR s = 'abc'",
+        "NOT (a = 5)",
+        "flag AND a > 1",
+        "a IS NULL",
+        "s IS NOT NULL",
+        "a IN (5, 10, 20)",
+        "s NOT IN ('x', 'y')",
+        "COUNT(*) > 2",
+        "(a + 1) * 2 = b",
+    };
+
+    Schema output;
+    for (const auto& text : expressions) {
+        auto stmt = Parser(std::make_unique<Lexer>("SELECT " + text + " FROM t")).parse_statement();
+        ASSERT_NE(stmt, nullptr) << text;
+        const auto& select = dynamic_cast<const SelectStatement&>(*stmt);
+        const Expression& expr = *select.columns()[0];
+        const CompiledExpression compiled(expr, schema);
+
+        for (size_t t = 0; t < tuples.size(); ++t) {
+            /* AND / OR / NOT of non-booleans throw in the interpreter; so must the plan */
+            Value expected;
+            try {
+                expected = expr.evaluate(&tuples[t], &schema);
+            } catch (const std::runtime_error&) {
+                EXPECT_THROW(static_cast<void>(compiled.evaluate(tuples[t])), std::runtime_error)
+                    << text << " tuple " << t;
+                EXPECT_THROW(static_cast<void>(compiled.test(tuples[t])), std::runtime_error)
+                    << text << " tuple " << t;
+                continue;
+            }
+            const Value actual = compiled.evaluate(tuples[t]);
+            EXPECT_EQ(actual.type(), expected.type()) << text << " tuple " << t;
+            EXPECT_EQ(actual.to_string(), expected.to_string()) << text << " tuple " << t;
+
+            /* As a predicate it fails exactly where Value::as_bool() does */
+            bool expected_throws = false;
+            bool expected_match = false;
+            try {
+                expected_match = expected.as_bool();
+            } catch (const std::runtime_error&) {
+                expected_throws = true;
+            }
+            if (expected_throws) {
+                EXPECT_THROW(static_cast<void>(compiled.test(tuples[t])), std::runtime_error)
+                    << text << " tuple " << t;
+            } else {
+                EXPECT_EQ(compiled.test(tuples[t]), expected_match) << text << " tuple " << t;
+            }
+        }
+    }
+
+    /* Throughput of a typical OLTP filter, interpreted and compiled */
+    auto stmt = Parser(std::make_unique<Lexer>("SELECT a FROM t WHERE a > 100 AND b < 500.0"))
+                    .parse_statement();
+    ASSERT_NE(stmt, nullptr);
+    const Expression& where = *dynamic_cast<const SelectStatement&>(*stmt).where();
+    std::vector<Tuple> rows;
+    constexpr int64_t ROWS = 100000;
+    rows.reserve(ROWS);
+    for (int64_t i = 0; i < ROWS; ++i) {
+        rows.emplace_back(std::vector<Value>{Value::make_int64(i % 1000),
+                                             Value::make_float64(static_cast<double>(i % 700)),
+                                             Value::make_text("s"), Value::make_bool(true)});
+    }
+    const auto time_ms = [&](const auto& matches) {
+        const auto start = std::chrono::steady_clock::now();
+        int64_t count = 0;
+        for (const auto& row : rows) count += matches(row) ? 1 : 0;
+        const std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        return std::make_pair(count, elapsed.count());
+    };
+    const auto interpreted =
+        time_ms([&](const Tuple& row) { return where.evaluate(&row, &schema).as_bool(); });
+    const CompiledExpression compiled(where, schema);
+    const auto fast = time_ms([&](const Tuple& row) { return compiled.test(row); });
+    EXPECT_EQ(fast.first, interpreted.first);
+    std::cout << "[CompiledExpr] rows=" << ROWS << " matches=" << fast.first
+              << " interpreted_ms=" << interpreted.second << " compiled_ms=" << fast.second
+              << "\n";
+}
+
 TEST(CatalogTests, Errors) {
     auto catalog = Catalog::create();
     const std::vector<ColumnInfo> cols = {{"id", ValueType::TYPE_INT64, 0}};
@@ -778,6 +4158,173 @@ TEST(CatalogTests, Stats) {
     catalog->print();
 }
 
+TEST(CatalogTests, SnapshotRoundTrip) {
+    auto catalog = Catalog::create();
+    const std::vector<ColumnInfo> cols = {{"id", ValueType::TYPE_INT64, 0},
+                                          {"name", ValueType::TYPE_TEXT, 1}};
+    const oid_t dropped = catalog->create_table("snap_dropped", cols);
+    const oid_t kept = catalog->create_table("snap_kept", cols);
+    const oid_t replicated =
+        catalog->create_table("snap_replicated", cols, TableInfo::FLAG_REPLICATED);
+    EXPECT_TRUE(catalog->drop_table(dropped));
+    ShardRing ring;
+    ring.tokens.push_back({42, "node1"});
+    ring.tokens.push_back({7, "node2"});
+    catalog->set_shard_ring(ring);
+
+    std::stringstream image;
+    ASSERT_TRUE(catalog->save_snapshot(image));
+    auto restored = Catalog::create();
+    static_cast<void>(restored->create_table("snap_stale", cols));
+    ASSERT_TRUE(restored->load_snapshot(image));
+
+    /* Ids survive, so DropTable entries after the snapshot still find their table */
+    EXPECT_FALSE(restored->table_exists_by_name("snap_stale"));
+    EXPECT_FALSE(restored->table_exists(dropped));
+    ASSERT_TRUE(restored->table_exists(kept));
+    const auto table = restored->get_table(kept);
+    ASSERT_TRUE(table.has_value());
+    EXPECT_EQ((*table)->name, "snap_kept");
+    ASSERT_EQ((*table)->columns.size(), 2U);
+    EXPECT_EQ((*table)->columns[1].name, "name");
+    EXPECT_FALSE((*table)->replicated());
+    ASSERT_TRUE(restored->get_table(replicated).has_value());
+    EXPECT_TRUE((*restored->get_table(replicated))->replicated());
+    EXPECT_GT(restored->create_table("snap_next", cols), replicated);
+    ASSERT_EQ(restored->shard_ring().tokens.size(), 2U);
+    EXPECT_EQ(restored->shard_ring().tokens[0].token, 7U);
+    EXPECT_EQ(restored->shard_ring().tokens[1].node_id, "node1");
+}
+
+TEST(CatalogTests, FileRecordsChangesIncrementally) {
+    const std::string path = "./test_data/catalog_file.db";
+    static_cast<void>(std::remove(path.c_str()));
+    const std::vector<ColumnInfo> cols = {{"id", ValueType::TYPE_INT64, 0},
+                                          {"name", ValueType::TYPE_TEXT, 1}};
+    const auto file_size = [&path] {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        return static_cast<size_t>(in.tellg());
+    };
+
+    oid_t kept = 0;
+    oid_t index = 0;
+    {
+        auto catalog = Catalog::create();
+        ASSERT_TRUE(catalog->load(path));
+        kept = catalog->create_table("file_kept", cols);
+        const oid_t dropped = catalog->create_table("file_dropped", cols);
+        index = catalog->create_index("file_kept_name", kept, {1}, IndexType::BTree, false);
+        const oid_t index_dropped =
+            catalog->create_index("file_kept_id", kept, {0}, IndexType::BTree, true);
+        EXPECT_TRUE(catalog->drop_table(dropped));
+        EXPECT_TRUE(catalog->drop_index(index_dropped));
+        ShardRing ring;
+        ring.tokens.push_back({9, "node1"});
+        catalog->set_shard_ring(ring);
+    }
+
+    /* A record cut short by a crash is dropped */
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        const uint32_t torn_len = 100;
+        out.write(reinterpret_cast<const char*>(&torn_len), 4);
+        out.write("\x01\x02", 2);
+    }
+    const size_t before_torn = file_size() - 6;
+    {
+        auto catalog = Catalog::create();
+        ASSERT_TRUE(catalog->load(path));
+        EXPECT_EQ(file_size(), before_torn);
+        const auto table = catalog->get_table_by_name("file_kept");
+        ASSERT_TRUE(table.has_value());
+        EXPECT_EQ((*table)->table_id, kept);
+        EXPECT_EQ((*table)->columns[1].name, "name");
+        EXPECT_FALSE(catalog->table_exists_by_name("file_dropped"));
+        ASSERT_EQ((*table)->indexes.size(), 1U);
+        EXPECT_EQ((*table)->indexes[0].index_id, index);
+        EXPECT_EQ((*table)->indexes[0].column_positions, std::vector<uint16_t>{1});
+        const auto found = catalog->get_index(index);
+        ASSERT_TRUE(found.has_value());
+        EXPECT_EQ(found->first->table_id, kept);
+        ASSERT_EQ(catalog->shard_ring().tokens.size(), 1U);
+        EXPECT_EQ(catalog->shard_ring().tokens[0].node_id, "node1");
+        EXPECT_GT(catalog->create_table("file_next", cols), index);
+
+        /* Each change appends one record rather than rewriting the catalog */
+        const size_t before = file_size();
+        for (int i = 0; i < 100; ++i) {
+            const oid_t tid = catalog->create_table("file_churn", cols);
+            EXPECT_TRUE(catalog->drop_table(tid));
+        }
+        EXPECT_GT(file_size(), before);
+    }
+
+    /* Superseded records are compacted away on the next load */
+    const size_t churned = file_size();
+    {
+        auto catalog = Catalog::create();
+        ASSERT_TRUE(catalog->load(path));
+        EXPECT_LT(file_size(), churned);
+        EXPECT_TRUE(catalog->table_exists_by_name("file_next"));
+        EXPECT_FALSE(catalog->table_exists_by_name("file_churn"));
+    }
+    {
+        auto catalog = Catalog::create();
+        ASSERT_TRUE(catalog->load(path));
+        EXPECT_TRUE(catalog->table_exists(kept));
+        EXPECT_TRUE(catalog->get_index(index).has_value());
+    }
+
+    /* Not a catalog file */
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "# System Catalog\n";
+    }
+    EXPECT_FALSE(Catalog::create()->load(path));
+    static_cast<void>(std::remove(path.c_str()));
+}
+
+TEST(CatalogTests, ShardSnapshotKeepsRowIds) {
+    const std::string name = "shard_snapshot";
+    static_cast<void>(std::remove(("./test_data/" + name + ".heap").c_str()));
+    static_cast<void>(std::remove(("./test_data/" + name + ".fsm").c_str()));
+    StorageManager disk_manager("./test_data");
+    BufferPoolManager bpm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    auto catalog = Catalog::create();
+    static_cast<void>(catalog->create_table(name, {{"id", ValueType::TYPE_INT64, 0}}));
+    Schema schema;
+    schema.add_column("id", ValueType::TYPE_INT64);
+    ShardStateMachine shard(name, bpm, *catalog);
+
+    std::vector<HeapTable::TupleId> rids;
+    {
+        HeapTable table(name, bpm, schema);
+        ASSERT_TRUE(table.create());
+        for (int64_t i = 0; i < 3; ++i) {
+            rids.push_back(table.insert(Tuple({Value::make_int64(i)})));
+        }
+    }
+    std::stringstream image;
+    ASSERT_TRUE(shard.save_snapshot(image));
+    {
+        HeapTable table(name, bpm, schema);
+        static_cast<void>(table.insert(Tuple({Value::make_int64(99)})));
+        EXPECT_TRUE(table.remove(rids[0], 100));
+    }
+    ASSERT_TRUE(shard.load_snapshot(image));
+
+    /* Entries after the snapshot name rows by page and slot: each is where it was */
+    HeapTable table(name, bpm, schema);
+    EXPECT_EQ(table.tuple_count(), 3U);
+    for (size_t i = 0; i < rids.size(); ++i) {
+        Tuple row;
+        ASSERT_TRUE(table.get(rids[i], row));
+        EXPECT_EQ(row.get(0).to_int64(), static_cast<int64_t>(i));
+    }
+    static_cast<void>(std::remove(("./test_data/" + name + ".heap").c_str()));
+    static_cast<void>(std::remove(("./test_data/" + name + ".fsm").c_str()));
+}
+
 // ============= Parser Advanced Tests =============
 
 TEST(ParserAdvanced, JoinAndComplexSelect) {
@@ -993,6 +4540,34 @@ TEST(ParserTests, CreateIndexAndAlter) {
     }
 }
 
+TEST(ParserTests, SetStatement) {
+    {
+        Parser parser(std::make_unique<Lexer>("SET Read_Consistency = lease"));
+        auto stmt = parser.parse_statement();
+        ASSERT_NE(stmt, nullptr);
+        EXPECT_EQ(stmt->type(), StmtType::Set);
+        const auto* set = dynamic_cast<const SetStatement*>(stmt.get());
+        ASSERT_NE(set, nullptr);
+        EXPECT_EQ(set->name(), "read_consistency");
+        EXPECT_EQ(set->value(), "lease");
+    }
+    {
+        Parser parser(std::make_unique<Lexer>("SET max_staleness TO 500"));
+        auto stmt = parser.parse_statement();
+        ASSERT_NE(stmt, nullptr);
+        EXPECT_EQ(dynamic_cast<const SetStatement&>(*stmt).value(), "500");
+        EXPECT_EQ(stmt->to_string(), "SET max_staleness = '500'");
+    }
+    {
+        Parser parser(std::make_unique<Lexer>("SET read_consistency = 'Follower'"));
+        auto stmt = parser.parse_statement();
+        ASSERT_NE(stmt, nullptr);
+        EXPECT_EQ(dynamic_cast<const SetStatement&>(*stmt).value(), "Follower");
+    }
+    EXPECT_EQ(Parser(std::make_unique<Lexer>("SET read_consistency")).parse_statement(), nullptr);
+    EXPECT_EQ(Parser(std::make_unique<Lexer>("SET = 1")).parse_statement(), nullptr);
+}
+
 TEST(ParserTests, ExhaustiveParserErrors) {
     // 1. Invalid Table Name in CREATE
     {
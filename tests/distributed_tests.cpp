@@ -7,21 +7,36 @@
 #include <gtest/gtest.h>
 #include <sys/socket.h>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
+#include <string>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
 #include "catalog/catalog.hpp"
 #include "common/cluster_manager.hpp"
+#include "common/lz4.hpp"
+#include "common/trace.hpp"
 #include "distributed/distributed_executor.hpp"
 #include "distributed/shard_manager.hpp"
+#include "distributed/shuffle_writer.hpp"
 #include "network/rpc_client.hpp"
+#include "network/rpc_client_pool.hpp"
 #include "network/rpc_message.hpp"
 #include "network/rpc_server.hpp"
 #include "parser/lexer.hpp"
 #include "parser/parser.hpp"
+#include "storage/buffer_pool_manager.hpp"
+#include "storage/storage_manager.hpp"
+#include "transaction/lock_manager.hpp"
+#include "transaction/transaction_manager.hpp"
 
 using namespace cloudsql;
 using namespace cloudsql::executor;
@@ -43,6 +58,40 @@ TEST(ShardManagerTests, BasicHashing) {
     EXPECT_EQ(s2, ShardManager::compute_shard(v2, 2));
 }
 
+TEST(ShardManagerTests, TypedHashAndRing) {
+    /* Equal values hash equally whatever their type; text hashes its bytes */
+    EXPECT_EQ(ShardManager::hash_value(common::Value::make_int64(5)),
+              ShardManager::hash_value(common::Value(static_cast<int32_t>(5))));
+    EXPECT_EQ(ShardManager::hash_value(common::Value::make_int64(5)),
+              ShardManager::hash_value(common::Value::make_float64(5.0)));
+    EXPECT_NE(ShardManager::hash_value(common::Value::make_int64(5)),
+              ShardManager::hash_value(common::Value::make_text("5")));
+    EXPECT_NE(ShardManager::hash_value(common::Value::make_float64(5.5)),
+              ShardManager::hash_value(common::Value::make_float64(6.5)));
+
+    const auto three = ShardManager::build_ring({"n1", "n2", "n3"});
+    const auto four = ShardManager::build_ring({"n1", "n2", "n3", "n4"});
+    ASSERT_EQ(three.tokens.size(), 3 * ShardManager::VIRTUAL_NODES);
+    ASSERT_TRUE(std::is_sorted(
+        three.tokens.begin(), three.tokens.end(),
+        [](const auto& a, const auto& b) { return a.token < b.token; }));
+
+    /* A new node takes a fair share of the keys, and only keys that move to it move */
+    constexpr int KEYS = 4000;
+    int moved = 0;
+    for (int k = 0; k < KEYS; ++k) {
+        const auto key = common::Value::make_int64(k);
+        const auto& before = ShardManager::owner(three, key);
+        const auto& after = ShardManager::owner(four, key);
+        if (before != after) {
+            EXPECT_EQ(after, "n4");
+            ++moved;
+        }
+    }
+    EXPECT_GT(moved, KEYS / 8);
+    EXPECT_LT(moved, KEYS * 3 / 8);
+}
+
 TEST(DistributedExecutorTests, DDLRouting) {
     auto catalog = Catalog::create();
     const config::Config config;
@@ -159,6 +208,8 @@ TEST(DistributedExecutorTests, ShardPruningSelect) {
     ClusterManager cm(&config);
     cm.register_node("n1", "127.0.0.1", 7400, config::RunMode::Data);
     cm.register_node("n2", "127.0.0.1", 7401, config::RunMode::Data);
+    /* The shard key is the table's first column */
+    catalog->create_table("test", {ColumnInfo("id", common::ValueType::TYPE_INT64, 0)});
     DistributedExecutor exec(*catalog, cm);
 
     // Execute point query. We don't care which node it hits, as long as it hits EXACTLY ONE.
@@ -174,6 +225,94 @@ TEST(DistributedExecutorTests, ShardPruningSelect) {
     node2.stop();
 }
 
+TEST(DistributedExecutorTests, ShardPruningInListsRangesAndCommit) {
+    constexpr size_t NODES = 3;
+    std::array<std::unique_ptr<RpcServer>, NODES> servers;
+    std::array<std::atomic<int>, NODES> fragments{};
+    std::atomic<int> prepares{0};
+    std::atomic<int> commits{0};
+    for (size_t i = 0; i < NODES; ++i) {
+        servers[i] = std::make_unique<RpcServer>(static_cast<uint16_t>(7915 + i));
+        auto* server = servers[i].get();
+        const auto reply_to = [server](std::atomic<int>& counter) {
+            return [server, &counter](const RpcHeader& h, const std::vector<uint8_t>&, int fd) {
+                counter++;
+                QueryResultsReply reply;
+                reply.success = true;
+                static_cast<void>(
+                    server->send_response(fd, h, RpcType::QueryResults, reply.serialize()));
+            };
+        };
+        server->set_handler(RpcType::ExecuteFragment, reply_to(fragments[i]));
+        server->set_handler(RpcType::TxnPrepare, reply_to(prepares));
+        server->set_handler(RpcType::TxnCommit, reply_to(commits));
+        ASSERT_TRUE(server->start());
+    }
+
+    auto catalog = Catalog::create();
+    catalog->create_table("pruned", {ColumnInfo("id", common::ValueType::TYPE_INT64, 0),
+                                     ColumnInfo("name", common::ValueType::TYPE_TEXT, 1)});
+    const config::Config config;
+    ClusterManager cm(&config);
+    for (size_t i = 0; i < NODES; ++i) {
+        cm.register_node("n" + std::to_string(i + 1), "127.0.0.1",
+                         static_cast<uint16_t>(7915 + i), config::RunMode::Data);
+    }
+    DistributedExecutor exec(*catalog, cm);
+    const auto shard_of = [](int64_t id) {
+        return ShardManager::compute_shard(common::Value::make_int64(id), NODES);
+    };
+    /* Nodes hit by `sql`, one bit per node */
+    const auto hits = [&](const std::string& sql) {
+        for (auto& f : fragments) f = 0;
+        const auto res = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement(), sql);
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+        uint32_t mask = 0;
+        for (size_t i = 0; i < NODES; ++i) {
+            if (fragments[i] > 0) mask |= 1U << i;
+        }
+        return mask;
+    };
+    const uint32_t all = (1U << NODES) - 1;
+
+    /* Two keys on one shard and a third elsewhere */
+    int64_t same = 2;
+    while (shard_of(same) != shard_of(1)) ++same;
+    int64_t other = 2;
+    while (shard_of(other) == shard_of(1)) ++other;
+    const std::string in_one = "SELECT name FROM pruned WHERE id IN (1, " +
+                               std::to_string(same) + ")";
+    EXPECT_EQ(hits(in_one), 1U << shard_of(1));
+    EXPECT_EQ(hits("SELECT name FROM pruned WHERE id = 1 OR id = " + std::to_string(other)),
+              (1U << shard_of(1)) | (1U << shard_of(other)));
+
+    /* A narrow integer range is pruned value by value; BETWEEN is a range */
+    uint32_t expected = 0;
+    for (int64_t id = 10; id <= 11; ++id) expected |= 1U << shard_of(id);
+    EXPECT_EQ(hits("SELECT name FROM pruned WHERE id BETWEEN 10 AND 11"), expected);
+    EXPECT_EQ(hits("SELECT name FROM pruned WHERE id > 9 AND id < 12 AND name = 'x'"), expected);
+    EXPECT_EQ(hits("SELECT name FROM pruned WHERE id > 9"), all);
+
+    /* Conditions on other columns, or OR with one, cannot prune */
+    EXPECT_EQ(hits("SELECT name FROM pruned WHERE name = 'x'"), all);
+    EXPECT_EQ(hits("SELECT name FROM pruned WHERE id = 1 OR name = 'x'"), all);
+    /* A contradiction matches nothing; just one node answers */
+    const uint32_t none =
+        hits("SELECT name FROM pruned WHERE id = 1 AND id = " + std::to_string(other));
+    EXPECT_TRUE(none != 0 && (none & (none - 1)) == 0);
+
+    /* A transaction that only touched one shard commits there, in one phase */
+    static_cast<void>(hits("COMMIT"));
+    prepares = 0;
+    commits = 0;
+    EXPECT_EQ(hits("UPDATE pruned SET name = 'y' WHERE id = 1"), 1U << shard_of(1));
+    static_cast<void>(hits("COMMIT"));
+    EXPECT_EQ(prepares.load(), 0);
+    EXPECT_EQ(commits.load(), 1);
+
+    for (auto& server : servers) server->stop();
+}
+
 TEST(DistributedExecutorTests, DataRedistributionShuffle) {
     // 1. Setup target mock node
     RpcServer target_node(7500);
@@ -365,6 +504,191 @@ TEST(DistributedExecutorTests, ShuffleJoinOrchestration) {
     node1.stop();
     node2.stop();
 }
+TEST(DistributedExecutorTests, ShuffleJoinFiltersProbeKeys) {
+    RpcServer node1(7710);
+    RpcServer node2(7711);
+
+    std::mutex mu;
+    std::vector<ShuffleFragmentArgs> shuffles;
+    std::vector<KeyFilterArgs> key_requests;
+
+    const auto reply_with = [](int fd, RpcType type, const std::vector<uint8_t>& resp_p) {
+        RpcHeader resp_h;
+        resp_h.type = type;
+        resp_h.payload_len = static_cast<uint16_t>(resp_p.size());
+        char h_buf[RpcHeader::HEADER_SIZE];
+        resp_h.encode(h_buf);
+        static_cast<void>(send(fd, h_buf, RpcHeader::HEADER_SIZE, 0));
+        static_cast<void>(send(fd, resp_p.data(), resp_p.size(), 0));
+    };
+    /* Node 1 holds build keys 1 and 2, node 2 key 30 */
+    const auto key_handler = [&](int64_t first, int64_t last) {
+        return [&, first, last](const RpcHeader&, const std::vector<uint8_t>& p, int fd) {
+            {
+                const std::scoped_lock lock(mu);
+                key_requests.push_back(KeyFilterArgs::deserialize(p));
+            }
+            KeyFilterReply reply;
+            reply.success = true;
+            reply.filter.emplace(last - first + 1);
+            for (int64_t k = first; k <= last; ++k) {
+                reply.filter->add(common::Value::make_int64(k));
+            }
+            reply_with(fd, RpcType::KeyFilter, reply.serialize());
+        };
+    };
+    const auto handler = [&](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+        if (h.type == RpcType::ShuffleFragment) {
+            const std::scoped_lock lock(mu);
+            shuffles.push_back(ShuffleFragmentArgs::deserialize(p));
+        }
+        QueryResultsReply reply;
+        reply.success = true;
+        reply_with(fd, RpcType::QueryResults, reply.serialize());
+    };
+    for (auto* node : {&node1, &node2}) {
+        node->set_handler(RpcType::ShuffleFragment, handler);
+        node->set_handler(RpcType::ExecuteFragment, handler);
+    }
+    node1.set_handler(RpcType::KeyFilter, key_handler(1, 2));
+    node2.set_handler(RpcType::KeyFilter, key_handler(30, 30));
+    ASSERT_TRUE(node1.start());
+    ASSERT_TRUE(node2.start());
+
+    auto catalog = Catalog::create();
+    const config::Config config;
+    ClusterManager cm(&config);
+    cm.register_node("n1", "127.0.0.1", 7710, config::RunMode::Data);
+    cm.register_node("n2", "127.0.0.1", 7711, config::RunMode::Data);
+    DistributedExecutor exec(*catalog, cm);
+
+    const auto run = [&](const std::string& sql) {
+        auto stmt = Parser(std::make_unique<Lexer>(sql)).parse_statement();
+        return exec.execute(*stmt, sql);
+    };
+
+    /* Only the FROM table's shuffle carries the union of the build keys */
+    ASSERT_TRUE(run("SELECT * FROM facts JOIN dims ON facts.dim_id = dims.id").success());
+    ASSERT_EQ(key_requests.size(), 2U);
+    EXPECT_EQ(key_requests[0].table_name, "dims");
+    EXPECT_EQ(key_requests[0].key_col, "id");
+    EXPECT_EQ(key_requests[0].node_count, 2U);
+    ASSERT_EQ(shuffles.size(), 4U);
+    for (const auto& args : shuffles) {
+        if (args.table_name == "dims") {
+            EXPECT_FALSE(args.key_filter.has_value());
+            continue;
+        }
+        ASSERT_TRUE(args.key_filter.has_value());
+        for (const int64_t k : {1, 2, 30}) {
+            EXPECT_TRUE(args.key_filter->may_contain(common::Value::make_int64(k)));
+        }
+        EXPECT_FALSE(args.key_filter->may_contain(common::Value::make_int64(31)));
+    }
+
+    /* A LEFT join ships every FROM row */
+    shuffles.clear();
+    key_requests.clear();
+    ASSERT_TRUE(run("SELECT * FROM facts LEFT JOIN dims ON facts.dim_id = dims.id").success());
+    EXPECT_TRUE(key_requests.empty());
+    for (const auto& args : shuffles) EXPECT_FALSE(args.key_filter.has_value());
+
+    node1.stop();
+    node2.stop();
+}
+
+
+TEST(DistributedExecutorTests, ReplicatedTablesJoinWithoutShuffle) {
+    RpcServer node1(7720);
+    RpcServer node2(7721);
+
+    std::mutex mu;
+    std::vector<std::pair<std::string, ExecuteFragmentArgs>> fragments; /**< (node, args) */
+    std::vector<ShuffleFragmentArgs> shuffles;
+    const auto make_handler = [&](const std::string& node) {
+        return [&, node](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+            {
+                const std::scoped_lock lock(mu);
+                if (h.type == RpcType::ShuffleFragment) {
+                    shuffles.push_back(ShuffleFragmentArgs::deserialize(p));
+                } else {
+                    fragments.emplace_back(node, ExecuteFragmentArgs::deserialize(p));
+                }
+            }
+            QueryResultsReply reply;
+            reply.success = true;
+            auto resp_p = reply.serialize();
+            RpcHeader resp_h;
+            resp_h.type = RpcType::QueryResults;
+            resp_h.payload_len = static_cast<uint16_t>(resp_p.size());
+            char h_buf[RpcHeader::HEADER_SIZE];
+            resp_h.encode(h_buf);
+            static_cast<void>(send(fd, h_buf, RpcHeader::HEADER_SIZE, 0));
+            static_cast<void>(send(fd, resp_p.data(), resp_p.size(), 0));
+        };
+    };
+    for (auto [server, node] : {std::pair{&node1, "n1"}, std::pair{&node2, "n2"}}) {
+        server->set_handler(RpcType::ExecuteFragment, make_handler(node));
+        server->set_handler(RpcType::ShuffleFragment, make_handler(node));
+        ASSERT_TRUE(server->start());
+    }
+
+    auto catalog = Catalog::create();
+    const std::vector<ColumnInfo> cols = {{"id", common::ValueType::TYPE_INT64, 0},
+                                          {"dim_id", common::ValueType::TYPE_INT64, 1}};
+    static_cast<void>(catalog->create_table("facts", cols));
+    static_cast<void>(catalog->create_table("dims", cols, TableInfo::FLAG_REPLICATED));
+    const config::Config config;
+    ClusterManager cm(&config);
+    cm.register_node("n1", "127.0.0.1", 7720, config::RunMode::Data);
+    cm.register_node("n2", "127.0.0.1", 7721, config::RunMode::Data);
+    DistributedExecutor exec(*catalog, cm);
+    const auto run = [&](const std::string& sql) {
+        fragments.clear();
+        shuffles.clear();
+        auto stmt = Parser(std::make_unique<Lexer>(sql)).parse_statement();
+        return exec.execute(*stmt, sql);
+    };
+
+    /* Every node stores every row */
+    const std::string insert = "INSERT INTO dims VALUES (1, 10), (2, 20)";
+    const auto inserted = run(insert);
+    ASSERT_TRUE(inserted.success()) << inserted.error();
+    EXPECT_EQ(inserted.rows_affected(), 2U);
+    ASSERT_EQ(fragments.size(), 2U);
+    for (const auto& [node, args] : fragments) EXPECT_EQ(args.sql, insert);
+
+    /* One node answers a read, and successive reads take turns */
+    ASSERT_TRUE(run("SELECT id FROM dims WHERE id > 0").success());
+    ASSERT_EQ(fragments.size(), 1U);
+    const std::string first_reader = fragments[0].first;
+    ASSERT_TRUE(run("SELECT id FROM dims").success());
+    ASSERT_EQ(fragments.size(), 1U);
+    EXPECT_NE(fragments[0].first, first_reader);
+
+    /* A join of a sharded table with a replicated one runs where the rows lie */
+    const auto join = [](const std::string& type) {
+        return "SELECT facts.id FROM facts " + type + " dims ON facts.dim_id = dims.id";
+    };
+    ASSERT_TRUE(run(join("JOIN")).success());
+    EXPECT_TRUE(shuffles.empty());
+    ASSERT_EQ(fragments.size(), 2U);
+    for (const auto& [node, args] : fragments) EXPECT_TRUE(args.exchange_tables.empty());
+    ASSERT_TRUE(run(join("LEFT JOIN")).success());
+    EXPECT_TRUE(shuffles.empty());
+
+    /* Keeping unmatched replicated rows needs a shuffle; each node keeps its own partition */
+    ASSERT_TRUE(run(join("RIGHT JOIN")).success());
+    ASSERT_EQ(shuffles.size(), 4U);
+    for (const auto& args : shuffles) EXPECT_EQ(args.replicated, args.table_name == "dims");
+
+    /* Writes go to every copy */
+    ASSERT_TRUE(run("DELETE FROM dims WHERE id = 1").success());
+    EXPECT_EQ(fragments.size(), 2U);
+
+    node1.stop();
+    node2.stop();
+}
 
 TEST(DistributedExecutorTests, ConcurrentShuffleIsolation) {
     auto cfg = std::make_unique<config::Config>();
@@ -400,6 +724,390 @@ TEST(DistributedExecutorTests, ConcurrentShuffleIsolation) {
     EXPECT_EQ(fetch2.size(), 1U);
     EXPECT_EQ(fetch2[0].get(0).as_int64(), 2);
 }
+TEST(DistributedExecutorTests, ShuffleStreamCreditAndEnd) {
+    const config::Config config;
+    ClusterManager cm(&config);
+    const std::string ctx = "stream_1";
+    std::atomic<int> acks{0};
+    const auto chunk = [](int64_t v) {
+        std::vector<executor::Tuple> rows;
+        rows.push_back(executor::Tuple({common::Value::make_int64(v)}));
+        return rows;
+    };
+
+    /* Past the buffer limit, acknowledgements are held back until chunks are consumed */
+    const auto limit = static_cast<int>(ClusterManager::SHUFFLE_BUFFERED_CHUNKS);
+    for (int i = 0; i < limit + 2; ++i) {
+        cm.push_shuffle_chunk(ctx, "t", chunk(i), false, [&acks] { acks++; });
+    }
+    EXPECT_EQ(acks.load(), limit);
+
+    std::vector<executor::Tuple> out;
+    ASSERT_EQ(cm.next_shuffle_chunk(ctx, "t", 2, out, nullptr, std::chrono::milliseconds(100)),
+              ClusterManager::ShuffleWait::Chunk);
+    EXPECT_EQ(out[0].get(0).as_int64(), 0);
+    EXPECT_EQ(acks.load(), limit + 1);
+
+    /* The stream ends once both senders sent their last chunk and all is read */
+    cm.push_shuffle_chunk(ctx, "t", {}, true, [&acks] { acks++; });
+    cm.push_shuffle_chunk(ctx, "t", chunk(99), true, [&acks] { acks++; });
+    int chunks = 1;
+    while (cm.next_shuffle_chunk(ctx, "t", 2, out, nullptr, std::chrono::milliseconds(100)) ==
+           ClusterManager::ShuffleWait::Chunk) {
+        chunks++;
+    }
+    EXPECT_EQ(chunks, limit + 3);
+    EXPECT_EQ(acks.load(), limit + 4);
+    EXPECT_FALSE(cm.has_shuffle_data(ctx, "t"));
+
+    /* A waiting consumer wakes up when its fragment is canceled */
+    auto canceled = cm.begin_fragment("stream_2");
+    auto waiter = std::async(std::launch::async, [&] {
+        std::vector<executor::Tuple> rows;
+        return cm.next_shuffle_chunk("stream_2", "t", 1, rows, canceled.get(),
+                                     std::chrono::seconds(10));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(cm.cancel_fragments("stream_2"), 1U);
+    EXPECT_EQ(waiter.get(), ClusterManager::ShuffleWait::Canceled);
+    cm.end_fragment("stream_2", canceled);
+}
+
+TEST(DistributedExecutorTests, ShuffleWriterStreamsChunks) {
+    /* Two receivers buffer PushData into their own cluster managers, as data nodes do */
+    const config::Config config;
+    std::array<std::unique_ptr<ClusterManager>, 2> receiver_cms;
+    std::array<std::unique_ptr<RpcServer>, 2> receivers;
+    std::atomic<int> pushes{0};
+    for (size_t r = 0; r < receivers.size(); ++r) {
+        receiver_cms[r] = std::make_unique<ClusterManager>(&config);
+        receivers[r] = std::make_unique<RpcServer>(static_cast<uint16_t>(7909 + r));
+        auto* server = receivers[r].get();
+        auto* rcm = receiver_cms[r].get();
+        server->set_handler(RpcType::PushData,
+                            [&pushes, server, rcm](const RpcHeader& h,
+                                                   const std::vector<uint8_t>& p, int fd) {
+                                pushes++;
+                                auto args = PushDataArgs::deserialize(p);
+                                rcm->push_shuffle_chunk(
+                                    args.context_id, args.table_name, std::move(args.rows),
+                                    args.last, [server, h, fd] {
+                                        QueryResultsReply reply;
+                                        reply.success = true;
+                                        static_cast<void>(server->send_response(
+                                            fd, h, RpcType::QueryResults, reply.serialize()));
+                                    });
+                            });
+        ASSERT_TRUE(server->start());
+    }
+
+    ClusterManager cm(&config);
+    cm.register_node("n1", "127.0.0.1", 7909, config::RunMode::Data);
+    cm.register_node("n2", "127.0.0.1", 7910, config::RunMode::Data);
+    auto nodes = cm.get_data_nodes();
+    std::sort(nodes.begin(), nodes.end(), [](const auto& a, const auto& b) { return a.id < b.id; });
+
+    /* Consumers read while the writer is still sending */
+    constexpr int ROWS = 995;
+    std::array<std::future<int64_t>, 2> sums;
+    for (size_t r = 0; r < sums.size(); ++r) {
+        sums[r] = std::async(std::launch::async, [rcm = receiver_cms[r].get()] {
+            int64_t sum = 0;
+            std::vector<executor::Tuple> chunk;
+            while (rcm->next_shuffle_chunk("ctx_w", "t", 1, chunk, nullptr,
+                                           std::chrono::seconds(5)) ==
+                   ClusterManager::ShuffleWait::Chunk) {
+                for (const auto& row : chunk) sum += row.get(0).to_int64();
+            }
+            return sum;
+        });
+    }
+
+    ShuffleWriter writer(cm, nodes, "ctx_w", "t", 10);
+    int64_t expected = 0;
+    for (int i = 0; i < ROWS; ++i) {
+        expected += i;
+        ASSERT_TRUE(writer.add(static_cast<size_t>(i % 2),
+                               executor::Tuple({common::Value::make_int64(i)})));
+    }
+    std::string error;
+    EXPECT_TRUE(writer.finish(error)) << error;
+    EXPECT_EQ(sums[0].get() + sums[1].get(), expected);
+    /* 498 and 497 rows: 49 full chunks each, then a final one with the rest */
+    EXPECT_EQ(pushes.load(), 100);
+
+    for (auto& server : receivers) server->stop();
+}
+
+/** @brief Fragment SQL that data nodes were sent, in arrival order */
+struct FragmentLog {
+    std::mutex mutex;
+    std::vector<std::string> sql;
+
+    std::string last() {
+        const std::scoped_lock<std::mutex> lock(mutex);
+        return sql.empty() ? std::string() : sql.back();
+    }
+};
+
+QueryResult run_sql(QueryExecutor& exec, const std::string& sql) {
+    return exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement());
+}
+
+/** @brief A data node with storage of its own that runs the fragments it is sent for real */
+struct SqlDataNode {
+    std::unique_ptr<storage::StorageManager> disk;
+    std::unique_ptr<storage::BufferPoolManager> bpm;
+    std::unique_ptr<Catalog> catalog;
+    std::unique_ptr<transaction::LockManager> lm;
+    std::unique_ptr<transaction::TransactionManager> tm;
+    std::unique_ptr<QueryExecutor> exec;
+    std::unique_ptr<RpcServer> server;
+
+    /**
+     * @brief Creates `table` in `dir`, fills it with `values` (if any) and serves fragments
+     * on `port`
+     */
+    bool start(const std::string& dir, uint16_t port, const std::string& table,
+               const std::string& columns, const std::string& values, FragmentLog& log) {
+        static_cast<void>(std::remove((dir + "/" + table + ".heap").c_str()));
+        disk = std::make_unique<storage::StorageManager>(dir);
+        bpm = std::make_unique<storage::BufferPoolManager>(config::Config::DEFAULT_BUFFER_POOL_SIZE,
+                                                           *disk);
+        catalog = Catalog::create();
+        lm = std::make_unique<transaction::LockManager>();
+        tm = std::make_unique<transaction::TransactionManager>(*lm, *catalog, *bpm,
+                                                               bpm->get_log_manager());
+        exec = std::make_unique<QueryExecutor>(*catalog, *bpm, *lm, *tm);
+        if (!run_sql(*exec, "CREATE TABLE " + table + " (" + columns + ")").success() ||
+            (!values.empty() &&
+             !run_sql(*exec, "INSERT INTO " + table + " VALUES " + values).success())) {
+            return false;
+        }
+
+        server = std::make_unique<RpcServer>(port);
+        const auto handler = [&log, srv = server.get(), ex = exec.get()](
+                                 const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+            const auto args = ExecuteFragmentArgs::deserialize(p);
+            {
+                const std::scoped_lock<std::mutex> lock(log.mutex);
+                log.sql.push_back(args.sql);
+            }
+            const auto res = run_sql(*ex, args.sql);
+            QueryResultsReply reply;
+            reply.success = res.success();
+            reply.error_msg = res.error();
+            reply.schema = res.schema();
+            reply.rows = res.rows();
+            static_cast<void>(srv->send_response(fd, h, RpcType::QueryResults, reply.serialize()));
+        };
+        server->set_handler(RpcType::ExecuteFragment, handler);
+        return server->start();
+    }
+};
+
+TEST(DistributedExecutorTests, TwoPhaseGroupedAggregation) {
+    const std::array<const char*, 2> data = {"('east', 10), ('east', 20), ('west', 5)",
+                                             "('east', 30), ('west', 7), ('north', 1)"};
+    std::array<SqlDataNode, 2> nodes;
+    FragmentLog log;
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        ASSERT_TRUE(nodes[n].start("./test_data/pagg_n" + std::to_string(n + 1),
+                                   static_cast<uint16_t>(7911 + n), "pagg_sales",
+                                   "region TEXT, amount INT", data[n], log));
+    }
+
+    auto catalog = Catalog::create();
+    const config::Config config;
+    ClusterManager cm(&config);
+    cm.register_node("n1", "127.0.0.1", 7911, config::RunMode::Data);
+    cm.register_node("n2", "127.0.0.1", 7912, config::RunMode::Data);
+    DistributedExecutor exec(*catalog, cm);
+    const auto query = [&exec](const std::string& sql) {
+        return exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement(), sql);
+    };
+
+    /* AVG travels as SUM and COUNT; HAVING and ORDER BY apply to the merged groups */
+    const auto grouped = query(
+        "SELECT region, COUNT(*), AVG(amount), SUM(amount) FROM pagg_sales GROUP BY region "
+        "HAVING COUNT(*) > 1 ORDER BY region");
+    ASSERT_TRUE(grouped.success()) << grouped.error();
+    ASSERT_EQ(grouped.row_count(), 2U);
+    EXPECT_EQ(grouped.rows()[0].get(0).to_string(), "east");
+    EXPECT_EQ(grouped.rows()[0].get(1).to_int64(), 3);
+    EXPECT_DOUBLE_EQ(grouped.rows()[0].get(2).to_float64(), 20.0);
+    EXPECT_DOUBLE_EQ(grouped.rows()[0].get(3).to_float64(), 60.0);
+    EXPECT_EQ(grouped.rows()[1].get(0).to_string(), "west");
+    EXPECT_DOUBLE_EQ(grouped.rows()[1].get(2).to_float64(), 6.0);
+    EXPECT_THAT(log.last(), testing::HasSubstr("SUM(amount), COUNT(amount)"));
+    EXPECT_THAT(log.last(), testing::Not(testing::HasSubstr("HAVING")));
+
+    const auto paged = query(
+        "SELECT region, MAX(amount) FROM pagg_sales GROUP BY region ORDER BY region LIMIT 1 "
+        "OFFSET 1");
+    ASSERT_TRUE(paged.success()) << paged.error();
+    ASSERT_EQ(paged.row_count(), 1U);
+    EXPECT_EQ(paged.rows()[0].get(0).to_string(), "north");
+    EXPECT_EQ(paged.rows()[0].get(1).to_int64(), 1);
+
+    const auto global = query("SELECT AVG(amount), MIN(amount) FROM pagg_sales");
+    ASSERT_TRUE(global.success()) << global.error();
+    ASSERT_EQ(global.row_count(), 1U);
+    EXPECT_DOUBLE_EQ(global.rows()[0].get(0).to_float64(), 73.0 / 6.0);
+    EXPECT_EQ(global.rows()[0].get(1).to_int64(), 1);
+
+    /* EXPLAIN ANALYZE lists every node's plan of its fragment, with the round trip */
+    const auto explained =
+        query("EXPLAIN ANALYZE SELECT region, SUM(amount) FROM pagg_sales GROUP BY region");
+    ASSERT_TRUE(explained.success()) << explained.error();
+    std::string plan;
+    for (const auto& row : explained.rows()) plan += row.get(0).to_string() + "\n";
+    EXPECT_THAT(plan, testing::StartsWith("Gather (merge partial aggregates, 2 fragments)"));
+    EXPECT_THAT(plan, testing::HasSubstr("Fragment on node n1 (round trip="));
+    EXPECT_THAT(plan, testing::HasSubstr("Fragment on node n2 (round trip="));
+    EXPECT_THAT(plan, testing::HasSubstr("Scan on pagg_sales (actual time="));
+    EXPECT_THAT(plan, testing::HasSubstr("Execution Time: "));
+    EXPECT_THAT(log.last(), testing::StartsWith("EXPLAIN ANALYZE SELECT region, SUM(amount)"));
+
+    for (auto& node : nodes) node.server->stop();
+}
+
+TEST(DistributedExecutorTests, TopNPushdownAndMerge) {
+    const std::array<const char*, 2> data = {
+        "(1, 'a', 50), (2, 'b', 10), (3, 'c', 30), (4, 'd', 70)",
+        "(5, 'e', 20), (6, 'f', 60), (7, 'g', 40), (8, 'h', 10)"};
+    std::array<SqlDataNode, 2> nodes;
+    FragmentLog log;
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        ASSERT_TRUE(nodes[n].start("./test_data/topn_n" + std::to_string(n + 1),
+                                   static_cast<uint16_t>(7913 + n), "topn_items",
+                                   "id INT, name TEXT, price INT", data[n], log));
+    }
+
+    auto catalog = Catalog::create();
+    const config::Config config;
+    ClusterManager cm(&config);
+    cm.register_node("n1", "127.0.0.1", 7913, config::RunMode::Data);
+    cm.register_node("n2", "127.0.0.1", 7914, config::RunMode::Data);
+    DistributedExecutor exec(*catalog, cm);
+    const auto query = [&exec](const std::string& sql) {
+        return exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement(), sql);
+    };
+    const auto names = [](const QueryResult& res) {
+        std::string out;
+        for (const auto& row : res.rows()) out += row.get(0).to_string();
+        return out;
+    };
+
+    /* Every node sorts and keeps offset + limit rows; the merge orders on all keys */
+    const auto paged =
+        query("SELECT name, price FROM topn_items ORDER BY price, name LIMIT 3 OFFSET 1");
+    ASSERT_TRUE(paged.success()) << paged.error();
+    EXPECT_EQ(names(paged), "hec");
+    EXPECT_THAT(log.last(), testing::HasSubstr("ORDER BY price, name LIMIT 4"));
+    EXPECT_THAT(log.last(), testing::Not(testing::HasSubstr("OFFSET")));
+
+    /* A key outside the SELECT list travels as an extra column; ties keep node order */
+    const auto hidden = query("SELECT name FROM topn_items ORDER BY price LIMIT 2");
+    ASSERT_TRUE(hidden.success()) << hidden.error();
+    EXPECT_EQ(names(hidden), "bh");
+    EXPECT_EQ(hidden.schema().column_count(), 1U);
+    ASSERT_EQ(hidden.row_count(), 2U);
+    EXPECT_EQ(hidden.rows()[0].size(), 1U);
+    EXPECT_THAT(log.last(), testing::HasSubstr("SELECT name, price FROM"));
+
+    const auto all = query("SELECT name FROM topn_items ORDER BY id");
+    ASSERT_TRUE(all.success()) << all.error();
+    EXPECT_EQ(names(all), "abcdefgh");
+    EXPECT_THAT(log.last(), testing::Not(testing::HasSubstr("LIMIT")));
+
+    /* DISTINCT drops the duplicates that meet across nodes */
+    const auto distinct = query("SELECT DISTINCT price FROM topn_items ORDER BY price LIMIT 3");
+    ASSERT_TRUE(distinct.success()) << distinct.error();
+    ASSERT_EQ(distinct.row_count(), 3U);
+    EXPECT_EQ(distinct.rows()[0].get(0).to_int64(), 10);
+    EXPECT_EQ(distinct.rows()[1].get(0).to_int64(), 20);
+    EXPECT_EQ(distinct.rows()[2].get(0).to_int64(), 30);
+
+    for (auto& node : nodes) node.server->stop();
+}
+
+TEST(DistributedExecutorTests, RebalanceMovesRowsToANewNode) {
+    std::array<SqlDataNode, 3> nodes;
+    FragmentLog log;
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        ASSERT_TRUE(nodes[n].start("./test_data/rebal_n" + std::to_string(n + 1),
+                                   static_cast<uint16_t>(7918 + n), "rebal_items",
+                                   "id INT, name TEXT", "", log));
+        const std::string dims_heap = "./test_data/rebal_n" + std::to_string(n + 1) +
+                                      "/rebal_dims.heap";
+        static_cast<void>(std::remove(dims_heap.c_str()));
+        ASSERT_TRUE(run_sql(*nodes[n].exec, "CREATE TABLE rebal_dims (id INT)").success());
+    }
+    auto catalog = Catalog::create();
+    catalog->create_table("rebal_items", {ColumnInfo("id", common::ValueType::TYPE_INT64, 0),
+                                          ColumnInfo("name", common::ValueType::TYPE_TEXT, 1)});
+    catalog->create_table("rebal_dims", {ColumnInfo("id", common::ValueType::TYPE_INT64, 0)},
+                          TableInfo::FLAG_REPLICATED);
+    const config::Config config;
+    ClusterManager cm(&config);
+    cm.register_node("n1", "127.0.0.1", 7918, config::RunMode::Data);
+    cm.register_node("n2", "127.0.0.1", 7919, config::RunMode::Data);
+    DistributedExecutor exec(*catalog, cm);
+    const auto query = [&exec](const std::string& sql) {
+        return exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement(), sql);
+    };
+
+    /* Two nodes on the ring, nothing to move yet */
+    const auto placed = exec.rebalance();
+    ASSERT_TRUE(placed.success()) << placed.error();
+    EXPECT_EQ(placed.rows_affected(), 0U);
+    constexpr int ROWS = 60;
+    std::string values;
+    for (int i = 0; i < ROWS; ++i) {
+        values += (i == 0 ? "(" : ", (") + std::to_string(i) + ", 'item " + std::to_string(i);
+        values += "')";
+    }
+    const auto inserted = query("INSERT INTO rebal_items VALUES " + values);
+    ASSERT_TRUE(inserted.success()) << inserted.error();
+    constexpr size_t DIMS = 4;
+    ASSERT_TRUE(query("INSERT INTO rebal_dims VALUES (1), (2), (3), (4)").success());
+
+    /* A third node joins: only the keys it now owns move, and nothing is lost */
+    cm.register_node("n3", "127.0.0.1", 7920, config::RunMode::Data);
+    const auto moved = exec.rebalance();
+    ASSERT_TRUE(moved.success()) << moved.error();
+    EXPECT_GT(moved.rows_affected(), 0U);
+    EXPECT_FALSE(catalog->shard_ring().migrating);
+
+    size_t total = 0;
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        const auto local = run_sql(*nodes[n].exec, "SELECT id, name FROM rebal_items");
+        ASSERT_TRUE(local.success()) << local.error();
+        total += local.row_count();
+        for (const auto& row : local.rows()) {
+            EXPECT_EQ(ShardManager::owner(catalog->shard_ring(), row.get(0)),
+                      "n" + std::to_string(n + 1));
+        }
+        if (n == 2) {
+            EXPECT_EQ(local.row_count() + DIMS, moved.rows_affected());
+        }
+        /* The new node gets a whole copy of the replicated table */
+        EXPECT_EQ(run_sql(*nodes[n].exec, "SELECT id FROM rebal_dims").row_count(), DIMS);
+    }
+    EXPECT_EQ(total, static_cast<size_t>(ROWS));
+
+    /* Point lookups prune to the new owner and find the moved rows */
+    for (int i = 0; i < ROWS; i += 7) {
+        const auto row = query("SELECT name FROM rebal_items WHERE id = " + std::to_string(i));
+        ASSERT_TRUE(row.success()) << row.error();
+        ASSERT_EQ(row.row_count(), 1U) << i;
+        EXPECT_EQ(row.rows()[0].get(0).to_string(), "item " + std::to_string(i));
+    }
+
+    for (auto& node : nodes) node.server->stop();
+}
+
 TEST(DistributedExecutorTests, NonEqualityJoinRejection) {
     auto catalog = Catalog::create();
     const config::Config config;
@@ -420,4 +1128,648 @@ TEST(DistributedExecutorTests, NonEqualityJoinRejection) {
     EXPECT_THAT(res.error(), testing::HasSubstr("equality join condition"));
 }
 
+TEST(DistributedExecutorTests, FirstErrorCancelsOutstandingFragments) {
+    RpcServer failing(7904);
+    RpcServer slow(7905);
+    failing.set_handler(RpcType::ExecuteFragment,
+                        [&](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+                            (void)p;
+                            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                            QueryResultsReply reply;
+                            reply.error_msg = "shard offline";
+                            static_cast<void>(failing.send_response(
+                                fd, h, RpcType::QueryResults, reply.serialize()));
+                        });
+
+    /* The slow node runs its fragment until the coordinator cancels it */
+    const config::Config data_config;
+    ClusterManager data_cm(&data_config);
+    std::promise<std::string> canceled_context;
+    slow.set_handler(RpcType::ExecuteFragment,
+                     [&](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+                         const auto args = ExecuteFragmentArgs::deserialize(p);
+                         auto canceled = data_cm.begin_fragment(args.context_id);
+                         for (int i = 0; i < 500 && !canceled->load(); ++i) {
+                             std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                         }
+                         data_cm.end_fragment(args.context_id, canceled);
+                         QueryResultsReply reply;
+                         reply.error_msg = "Query canceled";
+                         static_cast<void>(
+                             slow.send_response(fd, h, RpcType::QueryResults, reply.serialize()));
+                     });
+    slow.set_handler(RpcType::CancelFragment,
+                     [&](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+                         (void)h;
+                         (void)fd;
+                         const auto args = CancelFragmentArgs::deserialize(p);
+                         if (data_cm.cancel_fragments(args.context_id) > 0) {
+                             canceled_context.set_value(args.context_id);
+                         }
+                     });
+    ASSERT_TRUE(failing.start());
+    ASSERT_TRUE(slow.start());
+
+    auto catalog = Catalog::create();
+    const config::Config config;
+    ClusterManager cm(&config);
+    cm.register_node("n1", "127.0.0.1", 7904, config::RunMode::Data);
+    cm.register_node("n2", "127.0.0.1", 7905, config::RunMode::Data);
+    DistributedExecutor exec(*catalog, cm);
+
+    auto lexer = std::make_unique<Lexer>("SELECT * FROM test");
+    Parser parser(std::move(lexer));
+    auto stmt = parser.parse_statement();
+    const auto start = std::chrono::steady_clock::now();
+    auto res = exec.execute(*stmt, "SELECT * FROM test");
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    /* The error comes back without waiting for the slow node */
+    EXPECT_FALSE(res.success());
+    EXPECT_THAT(res.error(), testing::HasSubstr("shard offline"));
+    EXPECT_LT(elapsed, std::chrono::seconds(2));
+    auto context = canceled_context.get_future();
+    ASSERT_EQ(context.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_THAT(context.get(), testing::StartsWith("ctx_"));
+
+    failing.stop();
+    slow.stop();
+}
+
+TEST(DistributedExecutorTests, AsyncQueriesShareTheCallingThread) {
+    RpcServer node1(7730);
+    RpcServer node2(7731);
+    /* Nodes hold every fragment until released, so all queries are in flight together */
+    std::promise<void> release;
+    const std::shared_future<void> released = release.get_future().share();
+    const auto make_handler = [&released](RpcServer& server) {
+        return [&server, released](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+            (void)p;
+            released.wait();
+            QueryResultsReply reply;
+            reply.success = true;
+            reply.rows.emplace_back(std::vector<common::Value>{common::Value::make_int64(10)});
+            static_cast<void>(server.send_response(fd, h, RpcType::QueryResults,
+                                                   reply.serialize()));
+        };
+    };
+    node1.set_handler(RpcType::ExecuteFragment, make_handler(node1));
+    node2.set_handler(RpcType::ExecuteFragment, make_handler(node2));
+    ASSERT_TRUE(node1.start());
+    ASSERT_TRUE(node2.start());
+
+    auto catalog = Catalog::create();
+    const config::Config config;
+    ClusterManager cm(&config);
+    cm.register_node("n1", "127.0.0.1", 7730, config::RunMode::Data);
+    cm.register_node("n2", "127.0.0.1", 7731, config::RunMode::Data);
+
+    constexpr size_t QUERIES = 8;
+    const std::string sql = "SELECT COUNT(*) FROM test";
+    auto lexer = std::make_unique<Lexer>(sql);
+    Parser parser(std::move(lexer));
+    const auto stmt = parser.parse_statement();
+    std::vector<std::unique_ptr<DistributedExecutor>> sessions;
+    std::vector<std::promise<QueryResult>> results(QUERIES);
+    for (size_t i = 0; i < QUERIES; ++i) {
+        sessions.push_back(std::make_unique<DistributedExecutor>(*catalog, cm));
+    }
+
+    /* One thread starts every query; none of them waits for the nodes */
+    auto started = std::async(std::launch::async, [&]() {
+        for (size_t i = 0; i < QUERIES; ++i) {
+            sessions[i]->execute_async(*stmt, sql, [&results, i](QueryResult res) {
+                results[i].set_value(std::move(res));
+            });
+        }
+    });
+    const bool returned =
+        started.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+    release.set_value();
+    started.wait();
+    EXPECT_TRUE(returned);
+
+    for (auto& result : results) {
+        auto future = result.get_future();
+        ASSERT_EQ(future.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+        const auto res = future.get();
+        ASSERT_TRUE(res.success()) << res.error();
+        ASSERT_EQ(res.rows().size(), 1U);
+        EXPECT_EQ(res.rows()[0].get(0).to_int64(), 20);
+    }
+
+    node1.stop();
+    node2.stop();
+}
+
+TEST(DistributedExecutorTests, DDLWaitsForEveryDataNode) {
+    RpcServer node(7906);
+    std::atomic<int> applied{0};
+    node.set_handler(RpcType::ExecuteFragment,
+                     [&](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+                         (void)p;
+                         applied++;
+                         QueryResultsReply reply;
+                         reply.success = true;
+                         static_cast<void>(
+                             node.send_response(fd, h, RpcType::QueryResults, reply.serialize()));
+                     });
+    ASSERT_TRUE(node.start());
+
+    auto catalog = Catalog::create();
+    const config::Config config;
+    ClusterManager cm(&config);
+    cm.register_node("n1", "127.0.0.1", 7906, config::RunMode::Data);
+    DistributedExecutor exec(*catalog, cm);
+
+    auto lexer = std::make_unique<Lexer>("CREATE TABLE ddl_ack (id INT)");
+    Parser parser(std::move(lexer));
+    auto stmt = parser.parse_statement();
+    auto res = exec.execute(*stmt, "CREATE TABLE ddl_ack (id INT)");
+    EXPECT_TRUE(res.success());
+    EXPECT_EQ(applied.load(), 1);
+
+    /* A node that cannot be reached has not applied the change */
+    cm.register_node("n2", "127.0.0.1", 7907, config::RunMode::Data);
+    auto drop_lexer = std::make_unique<Lexer>("DROP TABLE ddl_ack");
+    Parser drop_parser(std::move(drop_lexer));
+    auto drop = drop_parser.parse_statement();
+    res = exec.execute(*drop, "DROP TABLE ddl_ack");
+    EXPECT_FALSE(res.success());
+    EXPECT_THAT(res.error(), testing::HasSubstr("n2"));
+
+    node.stop();
+}
+
+TEST(RpcServerTests, MultiplexedCalls) {
+    constexpr int CALLS = 4;
+    constexpr auto HANDLER_TIME = std::chrono::milliseconds(200);
+    RpcServer node(7900, CALLS + 1);
+    node.set_handler(RpcType::ExecuteFragment,
+                     [&](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+                         std::this_thread::sleep_for(HANDLER_TIME);
+                         static_cast<void>(node.send_response(fd, h, RpcType::QueryResults, p));
+                     });
+    ASSERT_TRUE(node.start());
+
+    /* All calls share one connection; each must get the echo of its own payload */
+    RpcClient client("127.0.0.1", 7900);
+    ASSERT_TRUE(client.connect());
+    std::array<std::vector<uint8_t>, CALLS> responses;
+    std::atomic<int> succeeded{0};
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> callers;
+    for (int i = 0; i < CALLS; ++i) {
+        callers.emplace_back([&, i] {
+            const std::vector<uint8_t> payload(static_cast<size_t>(i) + 1,
+                                               static_cast<uint8_t>(i));
+            if (client.call(RpcType::ExecuteFragment, payload, responses[i])) {
+                succeeded++;
+            }
+        });
+    }
+    for (auto& t : callers) {
+        t.join();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(succeeded.load(), CALLS);
+    for (int i = 0; i < CALLS; ++i) {
+        EXPECT_EQ(responses[i], std::vector<uint8_t>(static_cast<size_t>(i) + 1,
+                                                     static_cast<uint8_t>(i)));
+    }
+    /* Run side by side, not one after another on the connection */
+    EXPECT_LT(elapsed, HANDLER_TIME * (CALLS - 1));
+
+    node.stop();
+}
+
+TEST(RpcServerTests, RaftNotStarvedByFragments) {
+    RpcServer node(7901, 2); /* One thread for Raft, one for everything else */
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    node.set_handler(RpcType::ExecuteFragment,
+                     [&](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+                         static_cast<void>(released.wait_for(std::chrono::seconds(10)));
+                         static_cast<void>(node.send_response(fd, h, RpcType::QueryResults, p));
+                     });
+    node.set_handler(RpcType::AppendEntries,
+                     [&](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+                         static_cast<void>(node.send_response(fd, h, RpcType::AppendEntries, p));
+                     });
+    ASSERT_TRUE(node.start());
+
+    /* Two fragments: one holds the general thread, the other queues behind it */
+    RpcClient fragments("127.0.0.1", 7901);
+    ASSERT_TRUE(fragments.connect());
+    std::vector<std::thread> callers;
+    for (int i = 0; i < 2; ++i) {
+        callers.emplace_back([&] {
+            std::vector<uint8_t> resp;
+            static_cast<void>(fragments.call(RpcType::ExecuteFragment, {1}, resp));
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    RpcClient raft("127.0.0.1", 7901);
+    ASSERT_TRUE(raft.connect());
+    auto heartbeat = std::async(std::launch::async, [&] {
+        std::vector<uint8_t> resp;
+        return raft.call(RpcType::AppendEntries, {2}, resp) && resp == std::vector<uint8_t>{2};
+    });
+    ASSERT_EQ(heartbeat.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+    EXPECT_TRUE(heartbeat.get());
+
+    release.set_value();
+    for (auto& t : callers) {
+        t.join();
+    }
+    node.stop();
+}
+
+TEST(RpcClientTests, CallAsync) {
+    auto node = std::make_unique<RpcServer>(7902);
+    node->set_handler(RpcType::ExecuteFragment,
+                      [&](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+                          static_cast<void>(node->send_response(fd, h, RpcType::QueryResults, p));
+                      });
+    ASSERT_TRUE(node->start());
+
+    RpcClient client("127.0.0.1", 7902);
+    auto first = client.call_async(RpcType::ExecuteFragment, {1, 2});
+    std::promise<RpcResult> second_done;
+    client.call_async(RpcType::ExecuteFragment, {3},
+                      [&](RpcResult result) { second_done.set_value(std::move(result)); });
+    auto second = second_done.get_future();
+
+    ASSERT_EQ(first.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    ASSERT_EQ(second.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    auto r1 = first.get();
+    auto r2 = second.get();
+    EXPECT_TRUE(r1.ok);
+    EXPECT_EQ(r1.response, (std::vector<uint8_t>{1, 2}));
+    EXPECT_TRUE(r2.ok);
+    EXPECT_EQ(r2.response, (std::vector<uint8_t>{3}));
+
+    /* Synchronous calls still work alongside the reader thread */
+    std::vector<uint8_t> resp;
+    EXPECT_TRUE(client.call(RpcType::ExecuteFragment, {4}, resp));
+    EXPECT_EQ(resp, (std::vector<uint8_t>{4}));
+
+    node->stop();
+    node.reset();
+    auto failed = client.call_async(RpcType::ExecuteFragment, {5});
+    ASSERT_EQ(failed.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_FALSE(failed.get().ok);
+}
+
+TEST(RpcClientPoolTests, ReusesAndReplacesConnections) {
+    constexpr uint16_t PORT = 7903;
+    auto make_node = [](uint16_t port) {
+        auto node = std::make_unique<RpcServer>(port);
+        auto* raw = node.get();
+        node->set_handler(RpcType::ExecuteFragment,
+                          [raw](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+                              static_cast<void>(
+                                  raw->send_response(fd, h, RpcType::QueryResults, p));
+                          });
+        return node;
+    };
+
+    RpcClientPool pool(1);
+    EXPECT_EQ(pool.get("127.0.0.1", PORT), nullptr); /* Nobody listening yet */
+
+    auto node = make_node(PORT);
+    ASSERT_TRUE(node->start());
+    auto client = pool.get("127.0.0.1", PORT);
+    ASSERT_NE(client, nullptr);
+    EXPECT_EQ(pool.get("127.0.0.1", PORT), client);
+    EXPECT_EQ(pool.size(), 1U);
+
+    /* The node restarts: the pooled connection is stale and gets replaced */
+    node->stop();
+    node = make_node(PORT);
+    ASSERT_TRUE(node->start());
+    for (int i = 0; i < 50 && client->healthy(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    auto fresh = pool.get("127.0.0.1", PORT);
+    ASSERT_NE(fresh, nullptr);
+    EXPECT_NE(fresh, client);
+    std::vector<uint8_t> resp;
+    EXPECT_TRUE(fresh->call(RpcType::ExecuteFragment, {7}, resp));
+    EXPECT_EQ(resp, (std::vector<uint8_t>{7}));
+
+    pool.clear();
+    EXPECT_EQ(pool.size(), 0U);
+    node->stop();
+}
+
+TEST(WireFormatTests, ColumnarRowsRoundTrip) {
+    QueryResultsReply reply;
+    reply.success = true;
+    reply.schema.add_column("id", common::ValueType::TYPE_INT64);
+    for (int64_t i = 0; i < 100; ++i) {
+        std::vector<common::Value> vals;
+        vals.push_back(common::Value::make_int64(i));
+        vals.push_back(i % 7 == 0 ? common::Value::make_null()
+                                  : common::Value::make_float64(static_cast<double>(i) * 0.5));
+        vals.push_back(common::Value::make_text("name_" + std::to_string(i % 10)));
+        vals.push_back(common::Value::make_bool(i % 2 == 0));
+        /* No common kind: sent value by value */
+        vals.push_back(i % 2 == 0 ? common::Value::make_int64(i) : common::Value::make_text("x"));
+        vals.push_back(common::Value::make_null());
+        reply.rows.emplace_back(std::move(vals));
+    }
+
+    const auto columnar = reply.serialize(true);
+    const auto decoded = QueryResultsReply::deserialize(columnar);
+    EXPECT_TRUE(decoded.success);
+    EXPECT_EQ(decoded.schema.column_count(), 1U);
+    ASSERT_EQ(decoded.rows.size(), reply.rows.size());
+    for (size_t r = 0; r < reply.rows.size(); ++r) {
+        ASSERT_EQ(decoded.rows[r].size(), 6U);
+        for (size_t c = 0; c < 6; ++c) {
+            EXPECT_EQ(decoded.rows[r].get(c).to_string(), reply.rows[r].get(c).to_string())
+                << "row " << r << " column " << c;
+            EXPECT_EQ(decoded.rows[r].get(c).is_null(), reply.rows[r].get(c).is_null());
+        }
+    }
+    /* No per-value type tags */
+    EXPECT_LT(columnar.size(), reply.serialize().size());
+
+    /* The row format still decodes, and so does PushData in both */
+    EXPECT_EQ(QueryResultsReply::deserialize(reply.serialize()).rows.size(), 100U);
+    PushDataArgs push;
+    push.context_id = "ctx_1";
+    push.table_name = "t";
+    push.rows = reply.rows;
+    for (const bool use_columnar : {false, true}) {
+        const auto args = PushDataArgs::deserialize(push.serialize(use_columnar));
+        EXPECT_EQ(args.context_id, "ctx_1");
+        EXPECT_EQ(args.table_name, "t");
+        ASSERT_EQ(args.rows.size(), 100U);
+        EXPECT_EQ(args.rows[42].get(2).to_string(), "name_2");
+    }
+}
+
+TEST(WireFormatTests, KeyFilterRoundTrip) {
+    ShuffleFragmentArgs args;
+    args.context_id = "ctx_1";
+    args.table_name = "facts";
+    args.join_key_col = "dim_id";
+    EXPECT_FALSE(ShuffleFragmentArgs::deserialize(args.serialize()).key_filter.has_value());
+
+    args.key_filter.emplace(100);
+    for (int64_t k = 0; k < 100; ++k) args.key_filter->add(common::Value::make_int64(k * 10));
+    const auto decoded = ShuffleFragmentArgs::deserialize(args.serialize());
+    EXPECT_EQ(decoded.join_key_col, "dim_id");
+    ASSERT_TRUE(decoded.key_filter.has_value());
+    EXPECT_EQ(decoded.key_filter->key_count(), 100U);
+    EXPECT_EQ(decoded.key_filter->words(), args.key_filter->words());
+    EXPECT_EQ(decoded.key_filter->max().to_int64(), 990);
+    EXPECT_TRUE(decoded.key_filter->may_contain(common::Value::make_int64(420)));
+    EXPECT_FALSE(decoded.key_filter->may_contain(common::Value::make_int64(1000)));
+
+    /* A node without the handler answers with an empty payload: no filter */
+    EXPECT_FALSE(KeyFilterReply::deserialize({}).success);
+    KeyFilterReply failed;
+    failed.error_msg = "Table not found: dims";
+    const auto failure = KeyFilterReply::deserialize(failed.serialize());
+    EXPECT_FALSE(failure.success);
+    EXPECT_EQ(failure.error_msg, "Table not found: dims");
+}
+
+TEST(WireFormatTests, Lz4RoundTrip) {
+    std::vector<uint8_t> repetitive;
+    for (int i = 0; i < 10000; ++i) {
+        repetitive.push_back(static_cast<uint8_t>("abcabcabd"[i % 9]));
+    }
+    std::vector<uint8_t> noisy(5000);
+    uint32_t seed = 12345;
+    for (auto& b : noisy) {
+        seed = seed * 1103515245U + 12345U;
+        b = static_cast<uint8_t>(seed >> 16U);
+    }
+
+    for (const auto* input : {&repetitive, &noisy}) {
+        std::vector<uint8_t> block;
+        common::lz4::compress(input->data(), input->size(), block);
+        EXPECT_LE(block.size(), common::lz4::max_compressed_size(input->size()));
+        std::vector<uint8_t> restored(input->size());
+        ASSERT_TRUE(common::lz4::decompress(block.data(), block.size(), restored.data(),
+                                            restored.size()));
+        EXPECT_EQ(restored, *input);
+        if (input == &repetitive) {
+            EXPECT_LT(block.size(), input->size() / 10);
+            /* The wrong size or a cut-off block is rejected, not overrun */
+            EXPECT_FALSE(common::lz4::decompress(block.data(), block.size(), restored.data(),
+                                                 restored.size() - 1));
+            EXPECT_FALSE(common::lz4::decompress(block.data(), block.size() / 2, restored.data(),
+                                                 restored.size()));
+        }
+    }
+
+    std::vector<uint8_t> empty_block;
+    common::lz4::compress(nullptr, 0, empty_block);
+    EXPECT_TRUE(common::lz4::decompress(empty_block.data(), empty_block.size(), nullptr, 0));
+}
+
+TEST(RpcClientTests, NegotiatesCompressionAndLongPayloads) {
+    RpcServer node(7908);
+    node.set_handler(RpcType::ExecuteFragment,
+                     [&](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+                         static_cast<void>(node.send_response(fd, h, RpcType::QueryResults, p));
+                     });
+    ASSERT_TRUE(node.start());
+
+    /* Well over the 64 KB a 16-bit length can describe */
+    std::vector<uint8_t> payload(300000);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<uint8_t>(i % 251 < 200 ? 'a' : i % 251);
+    }
+
+    RpcClient client("127.0.0.1", 7908);
+    ASSERT_TRUE(client.connect());
+    EXPECT_FALSE(client.peer_accepts(RpcHeader::FLAG_ACCEPT_LZ4)); /* Not offered yet */
+    std::vector<uint8_t> resp;
+    ASSERT_TRUE(client.call(RpcType::ExecuteFragment, payload, resp));
+    EXPECT_EQ(resp, payload);
+    EXPECT_TRUE(client.peer_accepts(RpcHeader::FLAG_ACCEPT_LZ4));
+    EXPECT_TRUE(client.peer_accepts(RpcHeader::FLAG_ACCEPT_COLUMNAR));
+
+    /* Now compressed both ways; the handler still sees the original bytes */
+    ASSERT_TRUE(client.call(RpcType::ExecuteFragment, payload, resp));
+    EXPECT_EQ(resp, payload);
+
+    RpcHeader header;
+    std::vector<uint8_t> scratch;
+    auto body = compress_payload(header, payload, scratch);
+    EXPECT_TRUE(header.accepts(RpcHeader::FLAG_LZ4));
+    EXPECT_LT(body.size(), payload.size() / 4);
+    ASSERT_TRUE(decompress_payload(header, body));
+    EXPECT_EQ(body, payload);
+
+    node.stop();
+}
+
+/**
+ * @brief SET read_consistency stays with the coordinator's session and travels
+ * with every SELECT fragment, while DML fragments keep the defaults
+ */
+TEST(DistributedExecutorTests, ReadConsistencyTravelsWithFragments) {
+    RpcServer node(7930);
+    std::mutex mutex;
+    std::vector<ExecuteFragmentArgs> seen;
+    node.set_handler(RpcType::ExecuteFragment,
+                     [&](const RpcHeader& h, const std::vector<uint8_t>& p, int fd) {
+                         {
+                             const std::scoped_lock<std::mutex> lock(mutex);
+                             seen.push_back(ExecuteFragmentArgs::deserialize(p));
+                         }
+                         QueryResultsReply reply;
+                         reply.success = true;
+                         static_cast<void>(
+                             node.send_response(fd, h, RpcType::QueryResults, reply.serialize()));
+                     });
+    ASSERT_TRUE(node.start());
+
+    auto catalog = Catalog::create();
+    const config::Config config;
+    ClusterManager cm(&config);
+    cm.register_node("n1", "127.0.0.1", 7930, config::RunMode::Data);
+    DistributedExecutor exec(*catalog, cm);
+    const auto run = [&](const std::string& sql) {
+        Parser parser(std::make_unique<Lexer>(sql));
+        auto stmt = parser.parse_statement();
+        EXPECT_NE(stmt, nullptr) << sql;
+        return stmt ? exec.execute(*stmt, sql) : QueryResult{};
+    };
+
+    EXPECT_TRUE(run("SELECT id FROM t").success());
+    EXPECT_TRUE(run("SET read_consistency = follower").success());
+    EXPECT_TRUE(run("SET max_staleness TO 250").success());
+    EXPECT_EQ(exec.read_settings().consistency, raft::ReadConsistency::Follower);
+    EXPECT_TRUE(run("SELECT id FROM t").success());
+    EXPECT_TRUE(run("DELETE FROM t WHERE id = 1").success());
+    EXPECT_FALSE(run("SET read_consistency = strong").success());
+    EXPECT_FALSE(run("SET max_staleness = 'soon'").success());
+    EXPECT_FALSE(run("SET work_mem = 64").success());
+    EXPECT_EQ(exec.read_settings().consistency, raft::ReadConsistency::Follower);
+
+    node.stop();
+    ASSERT_EQ(seen.size(), 3U);
+    EXPECT_EQ(seen[0].read_consistency, raft::ReadConsistency::Stale);
+    EXPECT_EQ(seen[0].max_staleness_ms, 0U);
+    EXPECT_EQ(seen[1].read_consistency, raft::ReadConsistency::Follower);
+    EXPECT_EQ(seen[1].max_staleness_ms, 250U);
+    EXPECT_EQ(seen[2].read_consistency, raft::ReadConsistency::Stale);
+
+    /* The read options follow an empty exchange block; older payloads decode to the defaults */
+    ExecuteFragmentArgs args;
+    args.sql = "SELECT 1";
+    args.read_consistency = raft::ReadConsistency::Lease;
+    const auto decoded = ExecuteFragmentArgs::deserialize(args.serialize());
+    EXPECT_EQ(decoded.read_consistency, raft::ReadConsistency::Lease);
+    EXPECT_TRUE(decoded.exchange_tables.empty());
+    ExecuteFragmentArgs plain;
+    plain.sql = args.sql;
+    EXPECT_LT(plain.serialize().size(), args.serialize().size());
+    EXPECT_EQ(ExecuteFragmentArgs::deserialize(plain.serialize()).read_consistency,
+              raft::ReadConsistency::Stale);
+}
+
+TEST(DistributedExecutorTests, TraceFollowsFragmentsAcrossNodes) {
+    RpcServer node(7931);
+    node.set_handler(RpcType::ExecuteFragment,
+                     [&](const RpcHeader& h, const std::vector<uint8_t>&, int fd) {
+                         const common::Span work("test.fragment_work");
+                         QueryResultsReply reply;
+                         reply.success = true;
+                         static_cast<void>(
+                             node.send_response(fd, h, RpcType::QueryResults, reply.serialize()));
+                     });
+    ASSERT_TRUE(node.start());
+
+    auto catalog = Catalog::create();
+    const config::Config config;
+    ClusterManager cm(&config);
+    cm.register_node("n1", "127.0.0.1", 7931, config::RunMode::Data);
+    DistributedExecutor exec(*catalog, cm);
+    const auto run = [&](const std::string& sql) {
+        Parser parser(std::make_unique<Lexer>(sql));
+        auto stmt = parser.parse_statement();
+        return stmt ? exec.execute(*stmt, sql) : QueryResult{};
+    };
+
+    auto& tracer = common::Tracer::global();
+    tracer.clear();
+    tracer.set_sample_rate(0);
+    EXPECT_TRUE(run("SELECT id FROM t").success());
+    EXPECT_TRUE(tracer.spans().empty());
+
+    tracer.set_sample_rate(1);
+    EXPECT_TRUE(run("SELECT id FROM t").success());
+    tracer.set_sample_rate(0);
+    node.stop();
+
+    const auto spans = tracer.spans();
+    const auto find = [&spans](const std::string& name) {
+        const auto it = std::find_if(spans.begin(), spans.end(),
+                                     [&name](const auto& span) { return span.name == name; });
+        return it == spans.end() ? nullptr : &*it;
+    };
+    const auto* root = find("coordinator.statement");
+    const auto* fragments = find("coordinator.fragments");
+    const auto* client = find("rpc.client");
+    const auto* server = find("rpc.server");
+    const auto* work = find("test.fragment_work");
+    ASSERT_NE(root, nullptr);
+    ASSERT_NE(fragments, nullptr);
+    ASSERT_NE(client, nullptr);
+    ASSERT_NE(server, nullptr);
+    ASSERT_NE(work, nullptr);
+
+    /* One trace, linked from the coordinator's statement down to the handler's own span */
+    EXPECT_EQ(root->parent_id, 0U);
+    for (const auto* span : {fragments, client, server, work}) {
+        EXPECT_EQ(span->trace_id, root->trace_id) << span->name;
+    }
+    EXPECT_EQ(fragments->parent_id, root->span_id);
+    EXPECT_EQ(client->parent_id, fragments->span_id);
+    EXPECT_EQ(server->parent_id, client->span_id);
+    EXPECT_EQ(work->parent_id, server->span_id);
+    EXPECT_NE(client->attributes_text().find("rpc.method=ExecuteFragment"), std::string::npos);
+    EXPECT_NE(root->attributes_text().find("sql=SELECT id FROM t"), std::string::npos);
+    EXPECT_GE(client->duration_us, server->duration_us);
+    tracer.clear();
+}
+
+TEST(WireFormatTests, TraceContextInHeader) {
+    RpcHeader header;
+    header.type = RpcType::ExecuteFragment;
+    header.payload_len = 70000;
+    header.trace_id = 0x0123456789abcdefULL;
+    header.parent_span_id = 42;
+    ASSERT_EQ(header.encoded_size(), RpcHeader::MAX_HEADER_SIZE);
+    std::array<char, RpcHeader::MAX_HEADER_SIZE> buf{};
+    header.encode(buf.data());
+
+    RpcHeader decoded = RpcHeader::decode(buf.data());
+    EXPECT_TRUE(decoded.accepts(RpcHeader::FLAG_TRACE));
+    ASSERT_EQ(decoded.extension_size(),
+              RpcHeader::LONG_LENGTH_SIZE + RpcHeader::TRACE_CONTEXT_SIZE);
+    decoded.decode_extension(buf.data() + RpcHeader::HEADER_SIZE);
+    EXPECT_EQ(decoded.payload_len, 70000U);
+    EXPECT_EQ(decoded.trace_id, header.trace_id);
+    EXPECT_EQ(decoded.parent_span_id, 42U);
+
+    /* Untraced frames are as before: no flag, no extra bytes */
+    RpcHeader plain;
+    plain.payload_len = 10;
+    EXPECT_EQ(plain.encoded_size(), RpcHeader::HEADER_SIZE);
+    plain.encode(buf.data());
+    EXPECT_FALSE(RpcHeader::decode(buf.data()).accepts(RpcHeader::FLAG_TRACE));
+}
+
 }  // namespace
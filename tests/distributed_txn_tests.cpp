@@ -6,13 +6,19 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "catalog/catalog.hpp"
 #include "common/cluster_manager.hpp"
 #include "distributed/distributed_executor.hpp"
+#include "distributed/shard_manager.hpp"
 #include "network/rpc_server.hpp"
 #include "parser/lexer.hpp"
 #include "parser/parser.hpp"
@@ -223,4 +229,98 @@ TEST(DistributedTxnTests, TwoPhaseCommitAbortOnFailure) {
     data_node2.stop();
 }
 
+TEST(DistributedTxnTests, ParticipantsDecideTheCommitProtocol) {
+    constexpr size_t NODES = 3;
+    std::array<std::unique_ptr<RpcServer>, NODES> servers;
+    std::atomic<int> prepares{0};
+    std::atomic<int> commits{0};
+    std::atomic<int> aborts{0};
+    std::atomic<int> fragments{0};
+    for (size_t i = 0; i < NODES; ++i) {
+        servers[i] = std::make_unique<RpcServer>(static_cast<uint16_t>(7250 + i));
+        auto* server = servers[i].get();
+        const auto reply_to = [server](std::atomic<int>& counter) {
+            return [server, &counter](const RpcHeader& h, const std::vector<uint8_t>&, int fd) {
+                counter++;
+                QueryResultsReply reply;
+                reply.success = true;
+                static_cast<void>(
+                    server->send_response(fd, h, RpcType::QueryResults, reply.serialize()));
+            };
+        };
+        server->set_handler(RpcType::ExecuteFragment, reply_to(fragments));
+        server->set_handler(RpcType::TxnPrepare, reply_to(prepares));
+        server->set_handler(RpcType::TxnCommit, reply_to(commits));
+        server->set_handler(RpcType::TxnAbort, reply_to(aborts));
+        ASSERT_TRUE(server->start());
+    }
+
+    auto catalog = Catalog::create();
+    catalog->create_table("accounts", {ColumnInfo("id", common::ValueType::TYPE_INT64, 0),
+                                       ColumnInfo("balance", common::ValueType::TYPE_INT64, 1)});
+    const config::Config config;
+    ClusterManager cm(&config);
+    for (size_t i = 0; i < NODES; ++i) {
+        cm.register_node("n" + std::to_string(i + 1), "127.0.0.1",
+                         static_cast<uint16_t>(7250 + i), config::RunMode::Data);
+    }
+    DistributedExecutor exec(*catalog, cm);
+    const auto run = [&](const std::string& sql) {
+        const auto res = exec.execute(*Parser(std::make_unique<Lexer>(sql)).parse_statement(), sql);
+        EXPECT_TRUE(res.success()) << sql << ": " << res.error();
+    };
+    const auto reset = [&] {
+        prepares = 0;
+        commits = 0;
+        aborts = 0;
+    };
+    int64_t other = 2;
+    while (ShardManager::compute_shard(common::Value::make_int64(other), NODES) ==
+           ShardManager::compute_shard(common::Value::make_int64(1), NODES)) {
+        ++other;
+    }
+
+    /* Nothing ran since BEGIN: there is nobody to commit on */
+    run("BEGIN");
+    run("COMMIT");
+    EXPECT_EQ(prepares.load(), 0);
+    EXPECT_EQ(commits.load(), 0);
+
+    /* One writer commits in one phase; the nodes only read from are released */
+    run("BEGIN");
+    run("SELECT balance FROM accounts");
+    run("INSERT INTO accounts VALUES (1, 100)");
+    run("COMMIT");
+    EXPECT_EQ(prepares.load(), 0);
+    EXPECT_EQ(commits.load(), 3);
+
+    /* Two writers prepare; the reader skips the prepare */
+    reset();
+    run("BEGIN");
+    run("SELECT balance FROM accounts");
+    run("INSERT INTO accounts VALUES (1, 100), (" + std::to_string(other) + ", 50)");
+    run("COMMIT");
+    EXPECT_EQ(prepares.load(), 2);
+    EXPECT_EQ(commits.load(), 3);
+
+    /* A read-only transaction never prepares */
+    reset();
+    run("BEGIN");
+    run("SELECT balance FROM accounts WHERE id = 1");
+    run("COMMIT");
+    EXPECT_EQ(prepares.load(), 0);
+    EXPECT_EQ(commits.load(), 1);
+
+    /* Rollback reaches every participant, readers included */
+    reset();
+    run("BEGIN");
+    run("SELECT balance FROM accounts");
+    run("UPDATE accounts SET balance = 0 WHERE id = 1");
+    run("ROLLBACK");
+    EXPECT_EQ(aborts.load(), 3);
+    EXPECT_EQ(commits.load(), 0);
+
+    for (auto& server : servers) server->stop();
+}
+
 }  // namespace
@@ -17,17 +17,20 @@ using namespace cloudsql::transaction;
 namespace {
 
 constexpr auto TEST_SLEEP_MS = std::chrono::milliseconds(100);
+constexpr lock_key_t RID1 = 1;
+constexpr lock_key_t RID_A = 10;
+constexpr lock_key_t RID_B = 11;
 
 TEST(LockManagerTests, Shared) {
     LockManager lm;
     Transaction txn1(1);
     Transaction txn2(2);
 
-    EXPECT_TRUE(lm.acquire_shared(&txn1, "RID1"));
-    EXPECT_TRUE(lm.acquire_shared(&txn2, "RID1"));
+    EXPECT_TRUE(lm.acquire_shared(&txn1, RID1));
+    EXPECT_TRUE(lm.acquire_shared(&txn2, RID1));
 
-    static_cast<void>(lm.unlock(&txn1, "RID1"));
-    static_cast<void>(lm.unlock(&txn2, "RID1"));
+    static_cast<void>(lm.unlock(&txn1, RID1));
+    static_cast<void>(lm.unlock(&txn2, RID1));
 }
 
 TEST(LockManagerTests, Exclusive) {
@@ -35,22 +38,22 @@ TEST(LockManagerTests, Exclusive) {
     Transaction txn1(1);
     Transaction txn2(2);
 
-    EXPECT_TRUE(lm.acquire_exclusive(&txn1, "RID1"));
-    EXPECT_FALSE(lm.acquire_shared(&txn2, "RID1"));
+    EXPECT_TRUE(lm.acquire_exclusive(&txn1, RID1));
+    EXPECT_FALSE(lm.acquire_shared(&txn2, RID1));
 
-    static_cast<void>(lm.unlock(&txn1, "RID1"));
-    EXPECT_TRUE(lm.acquire_shared(&txn2, "RID1"));
-    static_cast<void>(lm.unlock(&txn2, "RID1"));
+    static_cast<void>(lm.unlock(&txn1, RID1));
+    EXPECT_TRUE(lm.acquire_shared(&txn2, RID1));
+    static_cast<void>(lm.unlock(&txn2, RID1));
 }
 
 TEST(LockManagerTests, Upgrade) {
     LockManager lm;
     Transaction txn1(1);
 
-    EXPECT_TRUE(lm.acquire_shared(&txn1, "RID1"));
-    EXPECT_TRUE(lm.acquire_exclusive(&txn1, "RID1"));
+    EXPECT_TRUE(lm.acquire_shared(&txn1, RID1));
+    EXPECT_TRUE(lm.acquire_exclusive(&txn1, RID1));
 
-    static_cast<void>(lm.unlock(&txn1, "RID1"));
+    static_cast<void>(lm.unlock(&txn1, RID1));
 }
 
 TEST(LockManagerTests, Wait) {
@@ -62,16 +65,16 @@ TEST(LockManagerTests, Wait) {
     std::atomic<int> shared_granted{0};
 
     // 1. Get Exclusive
-    EXPECT_TRUE(lm.acquire_exclusive(&txn1, "RID1"));
+    EXPECT_TRUE(lm.acquire_exclusive(&txn1, RID1));
 
     // 2. Try to get Shared from two other txns (should block)
     std::thread t2([&]() {
-        if (lm.acquire_shared(&txn2, "RID1")) {
+        if (lm.acquire_shared(&txn2, RID1)) {
             shared_granted++;
         }
     });
     std::thread t3([&]() {
-        if (lm.acquire_shared(&txn3, "RID1")) {
+        if (lm.acquire_shared(&txn3, RID1)) {
             shared_granted++;
         }
     });
@@ -81,15 +84,15 @@ TEST(LockManagerTests, Wait) {
     EXPECT_EQ(shared_granted.load(), 0);
 
     // 3. Release Exclusive (should grant both shared)
-    static_cast<void>(lm.unlock(&txn1, "RID1"));
+    static_cast<void>(lm.unlock(&txn1, RID1));
 
     t2.join();
     t3.join();
 
     EXPECT_EQ(shared_granted.load(), 2);
 
-    static_cast<void>(lm.unlock(&txn2, "RID1"));
-    static_cast<void>(lm.unlock(&txn3, "RID1"));
+    static_cast<void>(lm.unlock(&txn2, RID1));
+    static_cast<void>(lm.unlock(&txn3, RID1));
 }
 
 TEST(LockManagerTests, Deadlock) {
@@ -98,24 +101,180 @@ TEST(LockManagerTests, Deadlock) {
     Transaction txn2(2);
 
     // txn1 holds A, txn2 holds B
-    EXPECT_TRUE(lm.acquire_exclusive(&txn1, "A"));
-    EXPECT_TRUE(lm.acquire_exclusive(&txn2, "B"));
+    EXPECT_TRUE(lm.acquire_exclusive(&txn1, RID_A));
+    EXPECT_TRUE(lm.acquire_exclusive(&txn2, RID_B));
 
     // txn1 waits for B
-    std::thread t1([&]() { static_cast<void>(lm.acquire_exclusive(&txn1, "B")); });
+    std::thread t1([&]() { static_cast<void>(lm.acquire_exclusive(&txn1, RID_B)); });
 
     // Small sleep to ensure t1 is waiting
     std::this_thread::sleep_for(TEST_SLEEP_MS);
 
     // txn2 waits for A -> Deadlock!
-    static_cast<void>(lm.unlock(&txn1, "A"));
-    static_cast<void>(lm.acquire_exclusive(&txn2, "A"));
+    static_cast<void>(lm.unlock(&txn1, RID_A));
+    static_cast<void>(lm.acquire_exclusive(&txn2, RID_A));
 
-    static_cast<void>(lm.unlock(&txn2, "B"));
+    static_cast<void>(lm.unlock(&txn2, RID_B));
     t1.join();
 
-    static_cast<void>(lm.unlock(&txn1, "B"));
-    static_cast<void>(lm.unlock(&txn2, "A"));
+    static_cast<void>(lm.unlock(&txn1, RID_B));
+    static_cast<void>(lm.unlock(&txn2, RID_A));
+}
+
+TEST(LockManagerTests, RowKeysSeparateTables) {
+    const cloudsql::storage::HeapTable::TupleId tid(3, 7);
+    EXPECT_NE(LockManager::row_key(1, tid), LockManager::row_key(2, tid));
+    EXPECT_NE(LockManager::row_key(1, tid),
+              LockManager::row_key(1, cloudsql::storage::HeapTable::TupleId(7, 3)));
+}
+
+TEST(LockManagerTests, DeadlockVictimIsYoungest) {
+    LockManager lm(std::chrono::milliseconds(5), std::chrono::milliseconds(10000));
+    Transaction txn1(1);
+    Transaction txn2(2);
+
+    EXPECT_TRUE(lm.acquire_exclusive(&txn1, RID_A));
+    EXPECT_TRUE(lm.acquire_exclusive(&txn2, RID_B));
+
+    std::atomic<bool> txn1_granted{false};
+    std::thread t1([&]() { txn1_granted = lm.acquire_exclusive(&txn1, RID_B); });
+    std::this_thread::sleep_for(TEST_SLEEP_MS);
+
+    /* Closing the cycle fails txn2 long before the lock timeout */
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(lm.acquire_exclusive(&txn2, RID_A));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    EXPECT_EQ(lm.deadlocks(), 1U);
+
+    static_cast<void>(lm.unlock(&txn2, RID_B));
+    t1.join();
+    EXPECT_TRUE(txn1_granted.load());
+
+    static_cast<void>(lm.unlock(&txn1, RID_A));
+    static_cast<void>(lm.unlock(&txn1, RID_B));
+}
+
+TEST(LockManagerTests, UpgradeWaitsForOtherReaders) {
+    LockManager lm;
+    Transaction txn1(1);
+    Transaction txn2(2);
+
+    EXPECT_TRUE(lm.acquire_shared(&txn1, RID1));
+    EXPECT_TRUE(lm.acquire_shared(&txn2, RID1));
+
+    std::atomic<bool> upgraded{false};
+    std::thread t1([&]() { upgraded = lm.acquire_exclusive(&txn1, RID1); });
+    std::this_thread::sleep_for(TEST_SLEEP_MS);
+    EXPECT_FALSE(upgraded.load());
+
+    /* A second upgrade would wait on the first one's shared lock forever */
+    EXPECT_FALSE(lm.acquire_exclusive(&txn2, RID1));
+
+    static_cast<void>(lm.unlock(&txn2, RID1));
+    t1.join();
+    EXPECT_TRUE(upgraded.load());
+    EXPECT_EQ(txn1.held_lock(RID1), LockMode::EXCLUSIVE);
+
+    static_cast<void>(lm.unlock(&txn1, RID1));
+}
+
+TEST(LockManagerTests, IntentionLocks) {
+    LockManager lm(LockManager::DEFAULT_DETECTION_INTERVAL, std::chrono::milliseconds(50));
+    Transaction txn1(1);
+    Transaction txn2(2);
+    Transaction txn3(3);
+    using TupleId = cloudsql::storage::HeapTable::TupleId;
+    constexpr uint32_t TABLE = 7;
+
+    /* Writers of different rows share the table through IX */
+    EXPECT_TRUE(lm.lock_row(&txn1, TABLE, TupleId(1, 1), LockMode::EXCLUSIVE));
+    EXPECT_TRUE(lm.lock_row(&txn2, TABLE, TupleId(1, 2), LockMode::EXCLUSIVE));
+    EXPECT_EQ(txn1.held_lock(LockManager::table_key(TABLE)), LockMode::INTENTION_EXCLUSIVE);
+    EXPECT_EQ(txn1.held_lock(LockManager::page_key(TABLE, 1)), LockMode::INTENTION_EXCLUSIVE);
+
+    /* A table reader conflicts with their IX, a row reader does not */
+    EXPECT_FALSE(lm.lock_table(&txn3, TABLE, LockMode::SHARED));
+    EXPECT_TRUE(lm.lock_row(&txn3, TABLE, TupleId(2, 1), LockMode::SHARED));
+    EXPECT_FALSE(lm.lock_row(&txn3, TABLE, TupleId(1, 1), LockMode::SHARED));
+
+    for (Transaction* txn : {&txn1, &txn2, &txn3}) {
+        for (const lock_key_t key : txn->get_lock_set()) {
+            static_cast<void>(lm.unlock(txn, key));
+        }
+        EXPECT_TRUE(txn->get_lock_set().empty());
+    }
+
+    /* A table S holder writing a row ends up with SIX on the table */
+    EXPECT_TRUE(lm.lock_table(&txn1, TABLE, LockMode::SHARED));
+    EXPECT_TRUE(lm.lock_row(&txn1, TABLE, TupleId(1, 1), LockMode::SHARED));
+    EXPECT_EQ(txn1.get_lock_set().size(), 1U); /* Covered by the table lock */
+    EXPECT_TRUE(lm.lock_row(&txn1, TABLE, TupleId(1, 1), LockMode::EXCLUSIVE));
+    EXPECT_EQ(txn1.held_lock(LockManager::table_key(TABLE)),
+              LockMode::SHARED_INTENTION_EXCLUSIVE);
+    EXPECT_TRUE(lm.lock_row(&txn2, TABLE, TupleId(5, 5), LockMode::SHARED));
+    EXPECT_FALSE(lm.lock_row(&txn3, TABLE, TupleId(5, 6), LockMode::EXCLUSIVE));
+}
+
+TEST(LockManagerTests, EscalatesToTableLock) {
+    LockManager lm;
+    lm.set_escalation_threshold(10);
+    Transaction txn1(1);
+    using TupleId = cloudsql::storage::HeapTable::TupleId;
+    constexpr uint32_t TABLE = 3;
+
+    for (uint16_t slot = 0; slot < 10; ++slot) {
+        EXPECT_TRUE(lm.lock_row(&txn1, TABLE, TupleId(slot / 4, slot), LockMode::EXCLUSIVE));
+    }
+    EXPECT_EQ(lm.escalations(), 1U);
+    EXPECT_EQ(txn1.held_lock(LockManager::table_key(TABLE)), LockMode::EXCLUSIVE);
+    EXPECT_EQ(txn1.get_lock_set().size(), 1U);
+
+    /* Further rows cost nothing */
+    EXPECT_TRUE(lm.lock_rows(&txn1, TABLE, {TupleId(9, 1), TupleId(9, 2)}, LockMode::EXCLUSIVE));
+    EXPECT_EQ(txn1.get_lock_set().size(), 1U);
+
+    /* Escalation does not wait: with a reader in the table, txn2 keeps its row locks */
+    Transaction txn2(2);
+    Transaction txn3(3);
+    constexpr uint32_t OTHER = 4;
+    EXPECT_TRUE(lm.lock_row(&txn3, OTHER, TupleId(100, 0), LockMode::SHARED));
+    for (uint16_t slot = 0; slot < 10; ++slot) {
+        EXPECT_TRUE(lm.lock_row(&txn2, OTHER, TupleId(1, slot), LockMode::EXCLUSIVE));
+    }
+    EXPECT_EQ(lm.escalations(), 1U);
+    EXPECT_EQ(txn2.held_lock(LockManager::table_key(OTHER)), LockMode::INTENTION_EXCLUSIVE);
+
+    /* Once the reader is gone, the next row txn2 locks escalates */
+    for (const auto key : txn3.get_lock_set()) {
+        EXPECT_TRUE(lm.unlock(&txn3, key));
+    }
+    EXPECT_TRUE(lm.lock_row(&txn2, OTHER, TupleId(1, 10), LockMode::EXCLUSIVE));
+    EXPECT_EQ(lm.escalations(), 2U);
+    EXPECT_EQ(txn2.held_lock(LockManager::table_key(OTHER)), LockMode::EXCLUSIVE);
+    EXPECT_EQ(txn2.get_lock_set().size(), 1U);
+}
+
+TEST(LockManagerTests, EscalationCountsDistinctRows) {
+    LockManager lm;
+    lm.set_escalation_threshold(4);
+    Transaction txn1(1);
+    using TupleId = cloudsql::storage::HeapTable::TupleId;
+    constexpr uint32_t TABLE = 5;
+
+    /* Locking a row again, or upgrading it, does not count towards the threshold */
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(lm.lock_row(&txn1, TABLE, TupleId(0, 0), LockMode::SHARED));
+    }
+    EXPECT_TRUE(lm.lock_row(&txn1, TABLE, TupleId(0, 0), LockMode::EXCLUSIVE));
+    EXPECT_TRUE(lm.lock_row(&txn1, TABLE, TupleId(0, 1), LockMode::SHARED));
+    EXPECT_TRUE(lm.lock_row(&txn1, TABLE, TupleId(0, 1), LockMode::EXCLUSIVE));
+    EXPECT_TRUE(lm.lock_row(&txn1, TABLE, TupleId(0, 2), LockMode::EXCLUSIVE));
+    EXPECT_EQ(lm.escalations(), 0U);
+    EXPECT_EQ(txn1.held_lock(LockManager::table_key(TABLE)), LockMode::INTENTION_EXCLUSIVE);
+
+    EXPECT_TRUE(lm.lock_row(&txn1, TABLE, TupleId(0, 3), LockMode::EXCLUSIVE));
+    EXPECT_EQ(lm.escalations(), 1U);
+    EXPECT_EQ(txn1.held_lock(LockManager::table_key(TABLE)), LockMode::EXCLUSIVE);
 }
 
 }  // namespace
@@ -5,8 +5,14 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <chrono>
+#include <cstdio>
 #include <csignal>
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -163,4 +169,520 @@ TEST(MultiRaftTests, LeaderElectionAndFailover) {
     }
 }
 
+class CountingStateMachine : public RaftStateMachine {
+   public:
+    void apply(const LogEntry& entry) override {
+        if (!entry.data.empty() && entry.data[0] == next_value.load()) {
+            next_value++;
+        } else {
+            out_of_order = true;
+        }
+    }
+    std::atomic<uint8_t> next_value{0};
+    std::atomic<bool> out_of_order{false};
+};
+
+/**
+ * @brief Entries proposed on the leader reach every follower in order, in
+ * batches, including a follower that comes up after they were committed
+ */
+TEST(MultiRaftTests, BatchedPipelinedReplication) {
+    signal(SIGPIPE, SIG_IGN);
+    static_cast<void>(std::remove("raft_group_0.state"));
+    std::filesystem::remove_all("raft_group_0.log");
+    const int num_nodes = 3;
+    const int base_port = 9210;
+    const int entries = 100;
+
+    std::vector<std::unique_ptr<config::Config>> configs;
+    std::vector<std::unique_ptr<cluster::ClusterManager>> cms;
+    std::vector<std::unique_ptr<RpcServer>> rpcs;
+    std::vector<std::unique_ptr<RaftManager>> rms;
+    std::vector<std::unique_ptr<CountingStateMachine>> sms;
+
+    for (int i = 0; i < num_nodes; ++i) {
+        auto cfg = std::make_unique<config::Config>();
+        cfg->mode = config::RunMode::Coordinator;
+        cfg->cluster_port = base_port + i;
+        configs.push_back(std::move(cfg));
+        cms.push_back(std::make_unique<cluster::ClusterManager>(configs.back().get()));
+        rpcs.push_back(std::make_unique<RpcServer>(base_port + i));
+    }
+    for (int i = 0; i < num_nodes; ++i) {
+        rms.push_back(std::make_unique<RaftManager>("node" + std::to_string(i + 1), *cms[i],
+                                                    *rpcs[i]));
+        cms[i]->set_raft_manager(rms.back().get());
+        for (int j = 0; j < num_nodes; ++j) {
+            const std::string peer_id = "node" + std::to_string(j + 1);
+            cms[i]->register_node(peer_id, "127.0.0.1", base_port + j,
+                                  config::RunMode::Coordinator);
+            cms[i]->add_node_to_group(0, peer_id);
+        }
+        sms.push_back(std::make_unique<CountingStateMachine>());
+        rms[i]->get_or_create_group(0)->set_state_machine(sms.back().get());
+    }
+
+    /* node3 stays down: two of three elect a leader and commit without it */
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_TRUE(rpcs[i]->start());
+        rms[i]->start();
+    }
+    std::shared_ptr<RaftGroup> leader;
+    int leader_idx = -1;
+    for (int attempt = 0; attempt < 200 && !leader; ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        for (int i = 0; i < 2; ++i) {
+            if (rms[i]->get_group(0)->is_leader()) {
+                leader = rms[i]->get_group(0);
+                leader_idx = i;
+            }
+        }
+    }
+    ASSERT_NE(leader, nullptr);
+
+    for (int i = 0; i < entries; ++i) {
+        ASSERT_TRUE(leader->replicate({static_cast<uint8_t>(i)}));
+    }
+    const auto wait_for = [](const auto& done) {
+        for (int attempt = 0; attempt < 200 && !done(); ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(25));
+        }
+        return done();
+    };
+    EXPECT_TRUE(wait_for([&] { return leader->commit_index() == entries; }));
+    const int follower = 1 - leader_idx;
+    EXPECT_TRUE(wait_for([&] { return sms[follower]->next_value.load() == entries; }));
+
+    /* The late follower catches up from an empty log, a full batch at a time */
+    ASSERT_TRUE(rpcs[2]->start());
+    rms[2]->start();
+    EXPECT_TRUE(wait_for([&] { return sms[2]->next_value.load() == entries; }));
+    EXPECT_TRUE(leader->is_leader());
+
+    const auto stats = leader->replication_stats();
+    EXPECT_GE(stats.entries_sent, static_cast<uint64_t>(2 * entries));
+    EXPECT_GT(stats.max_batch, 1U);
+    EXPECT_LT(stats.batches_sent, stats.entries_sent);
+    EXPECT_GT(stats.batches_acked, 0U);
+    EXPECT_GT(stats.mean_batch(), 1.0);
+    EXPECT_EQ(stats.entries_synced, static_cast<uint64_t>(entries));
+    EXPECT_LE(stats.log_syncs, static_cast<uint64_t>(entries));
+    /* The leader applied nothing: its own proposals are applied by their callers */
+    EXPECT_EQ(sms[leader_idx]->next_value.load(), 0);
+    for (const auto& sm : sms) {
+        EXPECT_FALSE(sm->out_of_order.load());
+    }
+
+    for (int i = 0; i < num_nodes; ++i) {
+        rms[i]->stop();
+        rpcs[i]->stop();
+    }
+    static_cast<void>(std::remove("raft_group_0.state"));
+    std::filesystem::remove_all("raft_group_0.log");
+}
+
+/** @brief Snapshots its counter, padded so the image spans several InstallSnapshot chunks */
+class SnapshotStateMachine : public CountingStateMachine {
+   public:
+    static constexpr size_t PADDING = 200 * 1024;
+
+    bool save_snapshot(std::ostream& out) override {
+        const uint8_t value = next_value.load();
+        out.put(static_cast<char>(value));
+        const std::string padding(PADDING, static_cast<char>(value));
+        out.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+        return static_cast<bool>(out);
+    }
+    bool load_snapshot(std::istream& in) override {
+        const auto value = static_cast<uint8_t>(in.get());
+        std::string padding(PADDING, '\0');
+        in.read(padding.data(), static_cast<std::streamsize>(padding.size()));
+        if (!in || padding != std::string(PADDING, static_cast<char>(value))) return false;
+        next_value = value;
+        loads++;
+        return true;
+    }
+    std::atomic<int> loads{0};
+};
+
+/**
+ * @brief A follower snapshots and compacts its log; once it leads, it brings a
+ * new follower up with the snapshot, in chunks, then with the entries after it
+ */
+TEST(MultiRaftTests, SnapshotCompactionAndInstall) {
+    signal(SIGPIPE, SIG_IGN);
+    const int num_nodes = 3;
+    const int base_port = 9220;
+    const int entries = 100;
+    const auto dir = [](int i) { return "raft_snapshot_node" + std::to_string(i + 1); };
+    for (int i = 0; i < num_nodes; ++i) {
+        std::filesystem::remove_all(dir(i));
+    }
+
+    std::vector<std::unique_ptr<config::Config>> configs;
+    std::vector<std::unique_ptr<cluster::ClusterManager>> cms;
+    std::vector<std::unique_ptr<RpcServer>> rpcs;
+    std::vector<std::unique_ptr<RaftManager>> rms;
+    std::vector<std::unique_ptr<SnapshotStateMachine>> sms;
+
+    for (int i = 0; i < num_nodes; ++i) {
+        auto cfg = std::make_unique<config::Config>();
+        cfg->mode = config::RunMode::Coordinator;
+        cfg->cluster_port = base_port + i;
+        configs.push_back(std::move(cfg));
+        cms.push_back(std::make_unique<cluster::ClusterManager>(configs.back().get()));
+        rpcs.push_back(std::make_unique<RpcServer>(base_port + i));
+    }
+    for (int i = 0; i < num_nodes; ++i) {
+        rms.push_back(std::make_unique<RaftManager>("node" + std::to_string(i + 1), *cms[i],
+                                                    *rpcs[i], dir(i)));
+        cms[i]->set_raft_manager(rms.back().get());
+        for (int j = 0; j < num_nodes; ++j) {
+            const std::string peer_id = "node" + std::to_string(j + 1);
+            cms[i]->register_node(peer_id, "127.0.0.1", base_port + j,
+                                  config::RunMode::Coordinator);
+            cms[i]->add_node_to_group(0, peer_id);
+        }
+        sms.push_back(std::make_unique<SnapshotStateMachine>());
+        auto group = rms[i]->get_or_create_group(0);
+        group->set_state_machine(sms.back().get());
+        group->set_snapshot_threshold(20);
+    }
+
+    const auto wait_for = [](const auto& done) {
+        for (int attempt = 0; attempt < 400 && !done(); ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(25));
+        }
+        return done();
+    };
+    const auto stop_all = [&] {
+        for (int i = 0; i < num_nodes; ++i) {
+            rms[i]->stop();
+            rpcs[i]->stop();
+        }
+    };
+
+    /* node3 stays down while the first leader commits everything */
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_TRUE(rpcs[i]->start());
+        rms[i]->start();
+    }
+    int leader_idx = -1;
+    wait_for([&] {
+        for (int i = 0; i < 2; ++i) {
+            if (rms[i]->get_group(0)->is_leader()) leader_idx = i;
+        }
+        return leader_idx >= 0;
+    });
+    if (leader_idx < 0) {
+        stop_all();
+        FAIL() << "no leader elected";
+    }
+    for (int i = 0; i < entries; ++i) {
+        ASSERT_TRUE(rms[leader_idx]->get_group(0)->replicate({static_cast<uint8_t>(i)}));
+    }
+
+    /* The follower applies everything, then snapshots it and drops the log it covers */
+    const int follower = 1 - leader_idx;
+    auto group = rms[follower]->get_group(0);
+    EXPECT_TRUE(wait_for([&] { return sms[follower]->next_value.load() == entries; }));
+    EXPECT_TRUE(wait_for([&] { return group->snapshot_index() > 0; }));
+    const index_t snapshot = group->snapshot_index();
+    EXPECT_EQ(group->first_log_index(), snapshot + 1);
+    EXPECT_GE(group->replication_stats().snapshots_taken, 1U);
+    EXPECT_EQ(rms[leader_idx]->get_group(0)->snapshot_index(), 0U); /* Leaders never cut one */
+
+    /* Without the old leader, the follower leads node3, which has nothing */
+    rms[leader_idx]->stop();
+    rpcs[leader_idx]->stop();
+    ASSERT_TRUE(rpcs[2]->start());
+    rms[2]->start();
+    EXPECT_TRUE(wait_for([&] { return group->is_leader(); }));
+    EXPECT_TRUE(wait_for([&] { return sms[2]->next_value.load() == entries; }));
+    EXPECT_EQ(sms[2]->loads.load(), 1);
+    EXPECT_GE(rms[2]->get_group(0)->snapshot_index(), snapshot);
+    EXPECT_EQ(rms[2]->get_group(0)->replication_stats().snapshots_installed, 1U);
+    const auto stats = group->replication_stats();
+    EXPECT_EQ(stats.snapshots_sent, 1U);
+    EXPECT_GT(stats.snapshot_bytes_sent, SnapshotStateMachine::PADDING);
+
+    /* Replication carries on from the snapshot with ordinary entries */
+    ASSERT_TRUE(group->replicate({static_cast<uint8_t>(entries)}));
+    EXPECT_TRUE(wait_for([&] { return sms[2]->next_value.load() == entries + 1; }));
+    for (const auto& sm : sms) {
+        EXPECT_FALSE(sm->out_of_order.load());
+    }
+    stop_all();
+    const index_t installed = rms[2]->get_group(0)->snapshot_index();
+
+    /* A restart loads the snapshot instead of replaying the entries it covers */
+    rms[2].reset();
+    RaftManager restarted("node3", *cms[2], *rpcs[2], dir(2));
+    SnapshotStateMachine restored;
+    restarted.get_or_create_group(0)->set_state_machine(&restored);
+    EXPECT_EQ(restored.loads.load(), 1);
+    EXPECT_EQ(restored.next_value.load(), installed);
+    EXPECT_EQ(restarted.get_group(0)->commit_index(), installed);
+
+    for (int i = 0; i < num_nodes; ++i) {
+        std::filesystem::remove_all(dir(i));
+    }
+}
+
+/**
+ * @brief Leader and lease reads are served only by the leader; a follower read
+ * waits for the leader's commit index, and a stale read for a recent leader
+ */
+TEST(MultiRaftTests, ReadConsistencyLevels) {
+    signal(SIGPIPE, SIG_IGN);
+    const int num_nodes = 3;
+    const int base_port = 9230;
+    const int entries = 50;
+    const auto dir = [](int i) { return "raft_read_node" + std::to_string(i + 1); };
+    for (int i = 0; i < num_nodes; ++i) {
+        std::filesystem::remove_all(dir(i));
+    }
+
+    std::vector<std::unique_ptr<config::Config>> configs;
+    std::vector<std::unique_ptr<cluster::ClusterManager>> cms;
+    std::vector<std::unique_ptr<RpcServer>> rpcs;
+    std::vector<std::unique_ptr<RaftManager>> rms;
+    std::vector<std::unique_ptr<CountingStateMachine>> sms;
+
+    for (int i = 0; i < num_nodes; ++i) {
+        auto cfg = std::make_unique<config::Config>();
+        cfg->mode = config::RunMode::Coordinator;
+        cfg->cluster_port = base_port + i;
+        configs.push_back(std::move(cfg));
+        cms.push_back(std::make_unique<cluster::ClusterManager>(configs.back().get()));
+        rpcs.push_back(std::make_unique<RpcServer>(base_port + i));
+    }
+    for (int i = 0; i < num_nodes; ++i) {
+        rms.push_back(std::make_unique<RaftManager>("node" + std::to_string(i + 1), *cms[i],
+                                                    *rpcs[i], dir(i)));
+        cms[i]->set_raft_manager(rms.back().get());
+        for (int j = 0; j < num_nodes; ++j) {
+            const std::string peer_id = "node" + std::to_string(j + 1);
+            cms[i]->register_node(peer_id, "127.0.0.1", base_port + j,
+                                  config::RunMode::Coordinator);
+            cms[i]->add_node_to_group(0, peer_id);
+        }
+        sms.push_back(std::make_unique<CountingStateMachine>());
+        rms[i]->get_or_create_group(0)->set_state_machine(sms.back().get());
+    }
+
+    const auto wait_for = [](const auto& done) {
+        for (int attempt = 0; attempt < 200 && !done(); ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(25));
+        }
+        return done();
+    };
+    const auto stop_all = [&] {
+        for (int i = 0; i < num_nodes; ++i) {
+            rms[i]->stop();
+            rpcs[i]->stop();
+        }
+    };
+    for (int i = 0; i < num_nodes; ++i) {
+        ASSERT_TRUE(rpcs[i]->start());
+        rms[i]->start();
+    }
+    int leader_idx = -1;
+    wait_for([&] {
+        for (int i = 0; i < num_nodes; ++i) {
+            if (rms[i]->get_group(0)->is_leader()) leader_idx = i;
+        }
+        return leader_idx >= 0;
+    });
+    if (leader_idx < 0) {
+        stop_all();
+        FAIL() << "no leader elected";
+    }
+    auto leader = rms[leader_idx]->get_group(0);
+    const int follower = (leader_idx + 1) % num_nodes;
+    const int other = (leader_idx + 2) % num_nodes;
+    auto group = rms[follower]->get_group(0);
+
+    /* The first read commits an entry of the new term, then confirms leadership */
+    EXPECT_TRUE(leader->prepare_read(ReadConsistency::Leader));
+    EXPECT_GE(leader->replication_stats().read_index_rounds, 1U);
+    EXPECT_GE(leader->commit_index(), 1U);
+    /* Heartbeats keep the lease fresh, so lease reads skip the round */
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    EXPECT_TRUE(leader->prepare_read(ReadConsistency::Lease));
+    EXPECT_GE(leader->replication_stats().lease_reads, 1U);
+
+    /* Followers serve neither; a follower read sees every committed entry */
+    EXPECT_FALSE(group->prepare_read(ReadConsistency::Leader));
+    EXPECT_FALSE(group->prepare_read(ReadConsistency::Lease));
+    for (int i = 0; i < entries; ++i) {
+        ASSERT_TRUE(leader->replicate({static_cast<uint8_t>(i)}));
+    }
+    EXPECT_TRUE(wait_for([&] { return leader->commit_index() > entries; }));
+    EXPECT_TRUE(group->prepare_read(ReadConsistency::Follower));
+    EXPECT_EQ(sms[follower]->next_value.load(), entries);
+    EXPECT_EQ(group->replication_stats().follower_reads, 1U);
+    EXPECT_TRUE(group->prepare_read(ReadConsistency::Stale, std::chrono::milliseconds(500)));
+
+    /* Alone, a follower cannot elect a leader: bounded stale and follower reads stop */
+    rms[leader_idx]->stop();
+    rpcs[leader_idx]->stop();
+    rms[other]->stop();
+    rpcs[other]->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_FALSE(group->prepare_read(ReadConsistency::Stale, std::chrono::milliseconds(100)));
+    EXPECT_TRUE(group->prepare_read(ReadConsistency::Stale));
+    EXPECT_FALSE(group->prepare_read(ReadConsistency::Follower));
+    for (const auto& sm : sms) {
+        EXPECT_FALSE(sm->out_of_order.load());
+    }
+
+    stop_all();
+    for (int i = 0; i < num_nodes; ++i) {
+        std::filesystem::remove_all(dir(i));
+    }
+}
+
+/**
+ * @brief Many groups share a few tick threads and one heartbeat message per
+ * peer node; idle groups go dormant, wake for a write, and still fail over
+ * when the node leading them goes down
+ */
+TEST(MultiRaftTests, CoalescedHeartbeatsAndDormantGroups) {
+    signal(SIGPIPE, SIG_IGN);
+    const int num_nodes = 3;
+    const int base_port = 9240;
+    const uint16_t num_groups = 16;
+    const uint16_t written = 5;
+    const auto dir = [](int i) { return "raft_tick_node" + std::to_string(i + 1); };
+    for (int i = 0; i < num_nodes; ++i) {
+        std::filesystem::remove_all(dir(i));
+    }
+
+    std::vector<std::unique_ptr<config::Config>> configs;
+    std::vector<std::unique_ptr<cluster::ClusterManager>> cms;
+    std::vector<std::unique_ptr<RpcServer>> rpcs;
+    std::vector<std::unique_ptr<RaftManager>> rms;
+    std::vector<std::unique_ptr<CountingStateMachine>> sms;
+
+    for (int i = 0; i < num_nodes; ++i) {
+        auto cfg = std::make_unique<config::Config>();
+        cfg->mode = config::RunMode::Coordinator;
+        cfg->cluster_port = base_port + i;
+        configs.push_back(std::move(cfg));
+        cms.push_back(std::make_unique<cluster::ClusterManager>(configs.back().get()));
+        rpcs.push_back(std::make_unique<RpcServer>(base_port + i));
+    }
+    for (int i = 0; i < num_nodes; ++i) {
+        rms.push_back(std::make_unique<RaftManager>("node" + std::to_string(i + 1), *cms[i],
+                                                    *rpcs[i], dir(i), 2));
+        cms[i]->set_raft_manager(rms.back().get());
+        for (int j = 0; j < num_nodes; ++j) {
+            const std::string peer_id = "node" + std::to_string(j + 1);
+            cms[i]->register_node(peer_id, "127.0.0.1", base_port + j,
+                                  config::RunMode::Coordinator);
+            for (uint16_t g = 0; g < num_groups; ++g) {
+                cms[i]->add_node_to_group(g, peer_id);
+            }
+        }
+        for (uint16_t g = 0; g < num_groups; ++g) {
+            rms[i]->get_or_create_group(g);
+        }
+        sms.push_back(std::make_unique<CountingStateMachine>());
+        rms[i]->get_group(written)->set_state_machine(sms.back().get());
+        EXPECT_EQ(rms[i]->tick_threads(), 2U);
+    }
+
+    const auto wait_for = [](const auto& done) {
+        for (int attempt = 0; attempt < 400 && !done(); ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(25));
+        }
+        return done();
+    };
+    std::vector<bool> down(num_nodes, false);
+    const auto leader_of = [&](uint16_t g) {
+        for (int i = 0; i < num_nodes; ++i) {
+            if (!down[i] && rms[i]->get_group(g)->is_leader()) return i;
+        }
+        return -1;
+    };
+    const auto all_led = [&] {
+        for (uint16_t g = 0; g < num_groups; ++g) {
+            if (leader_of(g) < 0) return false;
+        }
+        return true;
+    };
+    const auto all_dormant = [&] {
+        for (int i = 0; i < num_nodes; ++i) {
+            if (!down[i] && rms[i]->heartbeat_stats().dormant_groups != num_groups) return false;
+        }
+        return true;
+    };
+    const auto stop_all = [&] {
+        for (int i = 0; i < num_nodes; ++i) {
+            rms[i]->stop();
+            rpcs[i]->stop();
+        }
+    };
+    for (int i = 0; i < num_nodes; ++i) {
+        ASSERT_TRUE(rpcs[i]->start());
+        rms[i]->start();
+    }
+    if (!wait_for(all_led) || !wait_for(all_dormant)) {
+        stop_all();
+        FAIL() << "groups did not elect leaders and settle";
+    }
+
+    /* Dormant groups cost nothing; each node still sends one empty message per peer */
+    std::vector<HeartbeatStats> before;
+    for (int i = 0; i < num_nodes; ++i) {
+        before.push_back(rms[i]->heartbeat_stats());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    for (int i = 0; i < num_nodes; ++i) {
+        const auto after = rms[i]->heartbeat_stats();
+        const auto messages = after.messages_sent - before[i].messages_sent;
+        EXPECT_GE(messages, 2U * 5U);
+        EXPECT_LE(messages, 2U * 12U);
+        EXPECT_EQ(after.groups_carried, before[i].groups_carried);
+        EXPECT_GT(after.messages_received, before[i].messages_received);
+    }
+    for (uint16_t g = 0; g < num_groups; ++g) {
+        const auto stats = rms[leader_of(g)]->get_group(g)->replication_stats();
+        EXPECT_GE(stats.heartbeats_coalesced, 2U);
+        EXPECT_GE(stats.quiesces, 1U);
+    }
+
+    /* A write wakes its group alone, reaches both followers, and the group settles again */
+    const int leader_idx = leader_of(written);
+    ASSERT_GE(leader_idx, 0);
+    ASSERT_TRUE(rms[leader_idx]->get_group(written)->replicate({0}));
+    EXPECT_TRUE(wait_for([&] {
+        for (int i = 0; i < num_nodes; ++i) {
+            if (i != leader_idx && sms[i]->next_value.load() != 1) return false;
+        }
+        return true;
+    }));
+    EXPECT_TRUE(wait_for(all_dormant));
+
+    /* The leader's node goes down: followers notice its silence and elect new leaders */
+    rms[leader_idx]->stop();
+    rpcs[leader_idx]->stop();
+    down[leader_idx] = true;
+    EXPECT_TRUE(wait_for(all_led));
+    const int new_leader = leader_of(written);
+    ASSERT_GE(new_leader, 0);
+    const int follower = 3 - leader_idx - new_leader;
+    ASSERT_TRUE(rms[new_leader]->get_group(written)->replicate({1}));
+    EXPECT_TRUE(wait_for([&] { return sms[follower]->next_value.load() == 2; }));
+    for (const auto& sm : sms) {
+        EXPECT_FALSE(sm->out_of_order.load());
+    }
+
+    stop_all();
+    for (int i = 0; i < num_nodes; ++i) {
+        std::filesystem::remove_all(dir(i));
+    }
+}
+
 }  // namespace
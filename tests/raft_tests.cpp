@@ -5,9 +5,16 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
 #include "common/cluster_manager.hpp"
 #include "common/config.hpp"
 #include "distributed/raft_group.hpp"
+#include "distributed/raft_log.hpp"
 #include "distributed/raft_manager.hpp"
 #include "network/rpc_server.hpp"
 
@@ -29,4 +36,160 @@ TEST(RaftTests, StateTransitions) {
     EXPECT_FALSE(group.is_leader());
 }
 
+LogEntry make_entry(index_t index, term_t term) {
+    LogEntry entry;
+    entry.index = index;
+    entry.term = term;
+    entry.data.assign(16, static_cast<uint8_t>(index));
+    return entry;
+}
+
+TEST(RaftLogTests, SegmentsSurviveReopen) {
+    const std::string dir = "raft_log_segments_test";
+    std::filesystem::remove_all(dir);
+    {
+        /* Small segments and cache: most entries live only on disk */
+        RaftLog log(dir, 256, 4);
+        ASSERT_TRUE(log.open());
+        EXPECT_TRUE(log.empty());
+        EXPECT_EQ(log.last_index(), 0U);
+        for (index_t i = 1; i <= 50; ++i) {
+            ASSERT_TRUE(log.append(make_entry(i, 1 + (i / 20))));
+        }
+        EXPECT_FALSE(log.append(make_entry(52, 3))); /* Out of order */
+        EXPECT_GT(log.segment_count(), 1U);
+        EXPECT_EQ(log.term_at(19), 1U);
+        EXPECT_EQ(log.term_at(45), 3U);
+        EXPECT_EQ(log.term_at(51), 0U);
+
+        std::vector<LogEntry> entries;
+        ASSERT_TRUE(log.read(1, 10, entries));
+        ASSERT_EQ(entries.size(), 10U);
+        EXPECT_EQ(entries[9].index, 10U);
+        EXPECT_EQ(entries[9].data, std::vector<uint8_t>(16, 10));
+    }
+
+    RaftLog log(dir, 256, 4);
+    ASSERT_TRUE(log.open());
+    EXPECT_EQ(log.first_index(), 1U);
+    EXPECT_EQ(log.last_index(), 50U);
+    EXPECT_EQ(log.durable_index(), 50U);
+    std::vector<LogEntry> entries;
+    ASSERT_TRUE(log.read(1, 100, entries));
+    ASSERT_EQ(entries.size(), 50U);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        EXPECT_EQ(entries[i].index, i + 1);
+        EXPECT_EQ(entries[i].term, 1 + ((i + 1) / 20));
+        EXPECT_EQ(entries[i].data, std::vector<uint8_t>(16, static_cast<uint8_t>(i + 1)));
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST(RaftLogTests, BatchedSyncTruncateAndTornTail) {
+    const std::string dir = "raft_log_truncate_test";
+    std::filesystem::remove_all(dir);
+    {
+        RaftLog log(dir, 256, 4);
+        ASSERT_TRUE(log.open());
+        for (index_t i = 1; i <= 20; ++i) {
+            ASSERT_TRUE(log.append(make_entry(i, 1)));
+        }
+        /* Appends only write; one sync covers all of them */
+        EXPECT_LT(log.durable_index(), 20U);
+        ASSERT_TRUE(log.sync());
+        EXPECT_EQ(log.durable_index(), 20U);
+        EXPECT_TRUE(log.sync()); /* Nothing new: no flush */
+        EXPECT_EQ(log.synced_entries(), 20U);
+
+        /* A new leader overwrites the uncommitted tail */
+        ASSERT_TRUE(log.truncate_suffix(12));
+        EXPECT_EQ(log.last_index(), 11U);
+        EXPECT_EQ(log.durable_index(), 11U);
+        ASSERT_TRUE(log.append(make_entry(12, 2)));
+        ASSERT_TRUE(log.sync());
+    }
+
+    /* A crash mid-append leaves a partial record at the end of the newest segment */
+    std::string newest;
+    for (const auto& file : std::filesystem::directory_iterator(dir)) {
+        newest = std::max(newest, file.path().string());
+    }
+    {
+        std::ofstream torn(newest, std::ios::binary | std::ios::app);
+        const uint64_t term = 2;
+        torn.write(reinterpret_cast<const char*>(&term), 8);
+    }
+
+    RaftLog log(dir, 256, 4);
+    ASSERT_TRUE(log.open());
+    EXPECT_EQ(log.last_index(), 12U);
+    EXPECT_EQ(log.term_at(11), 1U);
+    EXPECT_EQ(log.term_at(12), 2U);
+    ASSERT_TRUE(log.append(make_entry(13, 2)));
+    std::vector<LogEntry> entries;
+    ASSERT_TRUE(log.read(12, 2, entries));
+    ASSERT_EQ(entries.size(), 2U);
+    EXPECT_EQ(entries[1].index, 13U);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(RaftLogTests, CompactToSnapshotAndReset) {
+    const std::string dir = "raft_log_compact_test";
+    std::filesystem::remove_all(dir);
+    {
+        RaftLog log(dir, 256, 4);
+        ASSERT_TRUE(log.open());
+        for (index_t i = 1; i <= 50; ++i) {
+            ASSERT_TRUE(log.append(make_entry(i, 1 + (i / 20))));
+        }
+        const size_t segments = log.segment_count();
+
+        /* A snapshot through 23 drops whole segments and starts the log right after it */
+        ASSERT_TRUE(log.compact(23));
+        EXPECT_EQ(log.first_index(), 24U);
+        EXPECT_EQ(log.last_index(), 50U);
+        EXPECT_LT(log.segment_count(), segments);
+        EXPECT_EQ(log.term_at(23), 0U);
+        EXPECT_EQ(log.term_at(24), 2U);
+        std::vector<LogEntry> entries;
+        EXPECT_FALSE(log.read(23, 1, entries));
+        ASSERT_TRUE(log.read(24, 100, entries));
+        ASSERT_EQ(entries.size(), 27U);
+        EXPECT_EQ(entries.front().index, 24U);
+        EXPECT_EQ(entries.front().data, std::vector<uint8_t>(16, 24));
+        EXPECT_TRUE(log.compact(10)); /* Already gone */
+        ASSERT_TRUE(log.append(make_entry(51, 3)));
+    }
+
+    {
+        RaftLog log(dir, 256, 4);
+        ASSERT_TRUE(log.open());
+        EXPECT_EQ(log.first_index(), 24U);
+        EXPECT_EQ(log.last_index(), 51U);
+        std::vector<LogEntry> entries;
+        ASSERT_TRUE(log.read(24, 100, entries));
+        ASSERT_EQ(entries.size(), 28U);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            EXPECT_EQ(entries[i].index, 24 + i);
+        }
+
+        /* An installed snapshot past the end replaces the whole log */
+        ASSERT_TRUE(log.reset(80));
+        EXPECT_TRUE(log.empty());
+        EXPECT_EQ(log.first_index(), 80U);
+        EXPECT_EQ(log.last_index(), 79U);
+        EXPECT_EQ(log.segment_count(), 0U);
+        EXPECT_FALSE(log.append(make_entry(1, 4)));
+        ASSERT_TRUE(log.append(make_entry(80, 4)));
+        ASSERT_TRUE(log.sync());
+    }
+
+    RaftLog log(dir, 256, 4);
+    ASSERT_TRUE(log.open());
+    EXPECT_EQ(log.first_index(), 80U);
+    EXPECT_EQ(log.last_index(), 80U);
+    EXPECT_EQ(log.term_at(80), 4U);
+    std::filesystem::remove_all(dir);
+}
+
 }  // namespace
@@ -5,14 +5,28 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
+#include <fstream>
+#include <iterator>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "catalog/catalog.hpp"
+#include "common/value.hpp"
+#include "executor/types.hpp"
 #include "recovery/log_manager.hpp"
+#include "recovery/log_record.hpp"
 #include "recovery/recovery_manager.hpp"
 #include "storage/buffer_pool_manager.hpp"
+#include "storage/heap_table.hpp"
 #include "storage/storage_manager.hpp"
+#include "transaction/lock_manager.hpp"
+#include "transaction/transaction.hpp"
+#include "transaction/transaction_manager.hpp"
 
 using namespace cloudsql;
 using namespace cloudsql::recovery;
@@ -20,6 +34,85 @@ using namespace cloudsql::recovery;
 namespace {
 
 constexpr size_t TEST_BPM_SIZE = 10;
+constexpr size_t RECOVERY_THREADS = 2;
+
+void cleanup(const std::string& log_file, const std::string& table) {
+    static_cast<void>(std::remove(log_file.c_str()));
+    static_cast<void>(std::remove((log_file + ".ckpt").c_str()));
+    static_cast<void>(std::remove(("./test_data/" + table + ".heap").c_str()));
+    static_cast<void>(std::remove(("./test_data/" + table + ".fsm").c_str()));
+}
+
+std::vector<char> read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+void write_file(const std::string& path, const std::vector<char>& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+executor::Schema make_schema() {
+    executor::Schema schema;
+    schema.add_column("id", common::ValueType::TYPE_INT64);
+    schema.add_column("name", common::ValueType::TYPE_TEXT);
+    return schema;
+}
+
+void add_table(Catalog& catalog, const std::string& table) {
+    const std::vector<ColumnInfo> cols = {{"id", common::ValueType::TYPE_INT64, 0},
+                                          {"name", common::ValueType::TYPE_TEXT, 1}};
+    static_cast<void>(catalog.create_table(table, cols));
+}
+
+executor::Tuple make_row(int64_t id) {
+    return executor::Tuple(
+        {common::Value::make_int64(id), common::Value::make_text("row" + std::to_string(id))});
+}
+
+/* Changes a heap and logs them the way the executor does, stamping the page LSN */
+class Writer {
+   public:
+    Writer(LogManager& lm, storage::HeapTable& table, std::string name)
+        : lm_(lm), table_(table), name_(std::move(name)) {}
+
+    lsn_t control(txn_id_t txn, LogRecordType type) {
+        LogRecord record(txn, prev(txn), type);
+        return last_[txn] = lm_.append_log_record(record);
+    }
+
+    storage::HeapTable::TupleId insert(txn_id_t txn, int64_t id) {
+        const auto tid = table_.insert(make_row(id), txn);
+        LogRecord record(txn, prev(txn), LogRecordType::INSERT, name_, tid, make_row(id));
+        stamp(txn, tid, record);
+        return tid;
+    }
+
+    void remove(txn_id_t txn, const storage::HeapTable::TupleId& tid) {
+        executor::Tuple old;
+        static_cast<void>(table_.get(tid, old));
+        static_cast<void>(table_.remove(tid, txn));
+        LogRecord record(txn, prev(txn), LogRecordType::MARK_DELETE, name_, tid, old);
+        stamp(txn, tid, record);
+    }
+
+   private:
+    lsn_t prev(txn_id_t txn) const {
+        const auto it = last_.find(txn);
+        return it == last_.end() ? INVALID_LSN : it->second;
+    }
+
+    void stamp(txn_id_t txn, const storage::HeapTable::TupleId& tid, LogRecord& record) {
+        last_[txn] = lm_.append_log_record(record);
+        static_cast<void>(table_.set_page_lsn(tid.page_num, last_[txn]));
+    }
+
+    LogManager& lm_;
+    storage::HeapTable& table_;
+    std::string name_;
+    std::unordered_map<txn_id_t, lsn_t> last_;
+};
 
 TEST(RecoveryManagerTests, Basic) {
     const std::string log_file = "recovery_test.log";
@@ -33,7 +126,262 @@ TEST(RecoveryManagerTests, Basic) {
     RecoveryManager rm(bpm, *catalog, lm);
     EXPECT_TRUE(rm.recover());
 
-    static_cast<void>(std::remove(log_file.c_str()));
+    cleanup(log_file, "");
+}
+
+/**
+ * @brief A crash after one page write: redo restores what came later, undo
+ * rolls back the loser, and the prepared transaction stays in doubt
+ */
+TEST(RecoveryManagerTests, RedoUndoAfterCrash) {
+    const std::string log_file = "recovery_crash.log";
+    const std::string name = "rm_crash";
+    const std::string heap_path = "./test_data/" + name + ".heap";
+    const std::string fsm_path = "./test_data/" + name + ".fsm";
+    cleanup(log_file, name);
+
+    auto catalog = Catalog::create();
+    add_table(*catalog, name);
+    std::vector<char> heap_image;
+    std::vector<char> fsm_image;
+    std::vector<storage::HeapTable::TupleId> committed;
+    storage::HeapTable::TupleId loser_row;
+    storage::HeapTable::TupleId late_row;
+    storage::HeapTable::TupleId prepared_row;
+    lsn_t prepared_begin = INVALID_LSN;
+    {
+        storage::StorageManager disk_manager("./test_data");
+        LogManager lm(log_file);
+        storage::BufferPoolManager bpm(TEST_BPM_SIZE, disk_manager, &lm);
+        storage::HeapTable table(name, bpm, make_schema());
+        ASSERT_TRUE(table.create());
+        Writer writer(lm, table, name);
+
+        static_cast<void>(writer.control(1, LogRecordType::BEGIN));
+        for (int64_t i = 0; i < 3; ++i) {
+            committed.push_back(writer.insert(1, i));
+        }
+        ASSERT_TRUE(lm.wait_durable(writer.control(1, LogRecordType::COMMIT)));
+
+        /* The last page write before the crash */
+        bpm.flush_all_pages();
+        heap_image = read_file(heap_path);
+        fsm_image = read_file(fsm_path);
+
+        static_cast<void>(writer.control(2, LogRecordType::BEGIN));
+        loser_row = writer.insert(2, 10);
+        writer.remove(2, committed[0]);
+
+        static_cast<void>(writer.control(3, LogRecordType::BEGIN));
+        late_row = writer.insert(3, 20);
+        static_cast<void>(writer.control(3, LogRecordType::COMMIT));
+
+        prepared_begin = writer.control(4, LogRecordType::BEGIN);
+        prepared_row = writer.insert(4, 30);
+        static_cast<void>(writer.control(4, LogRecordType::PREPARE));
+        lm.flush(true);
+    }
+    /* Lose every page write after the image */
+    write_file(heap_path, heap_image);
+    write_file(fsm_path, fsm_image);
+
+    {
+        storage::StorageManager disk_manager("./test_data");
+        LogManager lm(log_file);
+        storage::BufferPoolManager bpm(TEST_BPM_SIZE, disk_manager, &lm);
+        RecoveryManager rm(bpm, *catalog, lm, RECOVERY_THREADS);
+        ASSERT_TRUE(rm.recover());
+
+        const auto& stats = rm.get_stats();
+        EXPECT_EQ(stats.scan_lsn, 0);
+        EXPECT_EQ(stats.redo_skipped, 3U); /* Transaction 1 reached disk with the page */
+        EXPECT_EQ(stats.redo_applied, 4U);
+        EXPECT_EQ(stats.losers, 1U);
+        EXPECT_EQ(stats.clrs_written, 2U);
+        ASSERT_EQ(rm.in_doubt().size(), 1U);
+        EXPECT_EQ(rm.in_doubt()[0].txn_id, 4U);
+        EXPECT_EQ(rm.max_txn_id(), 4U);
+
+        storage::HeapTable table(name, bpm, make_schema());
+        uint64_t xmin = 0;
+        uint64_t xmax = 0;
+        ASSERT_TRUE(table.get_versions(committed[0], &xmin, &xmax));
+        EXPECT_EQ(xmax, 0U); /* The loser's delete is undone */
+        executor::Tuple tuple;
+        EXPECT_FALSE(table.get(loser_row, tuple));
+        ASSERT_TRUE(table.get(late_row, tuple));
+        EXPECT_EQ(tuple.get(0).to_int64(), 20);
+        ASSERT_TRUE(table.get_versions(prepared_row, &xmin, &xmax));
+        EXPECT_EQ(xmin, 4U);
+        EXPECT_EQ(table.tuple_count(), 5U);
+    }
+
+    /* Recovering again resumes from the end-of-recovery checkpoint and changes nothing */
+    {
+        storage::StorageManager disk_manager("./test_data");
+        LogManager lm(log_file);
+        storage::BufferPoolManager bpm(TEST_BPM_SIZE, disk_manager, &lm);
+        RecoveryManager rm(bpm, *catalog, lm, RECOVERY_THREADS);
+        ASSERT_TRUE(rm.recover());
+        /* Kept for the transaction in doubt; a log this small has one offset entry */
+        EXPECT_LE(rm.get_stats().scan_lsn, prepared_begin);
+        EXPECT_EQ(rm.get_stats().redo_applied, 0U);
+        EXPECT_EQ(rm.get_stats().losers, 0U);
+        EXPECT_EQ(rm.in_doubt().size(), 1U);
+
+        storage::HeapTable table(name, bpm, make_schema());
+        EXPECT_EQ(table.tuple_count(), 5U);
+    }
+
+    cleanup(log_file, name);
+}
+
+/**
+ * @brief A fuzzy checkpoint moves the scan start up to the oldest active transaction
+ */
+TEST(RecoveryManagerTests, CheckpointBoundsLogScan) {
+    const std::string log_file = "recovery_ckpt.log";
+    const std::string name = "rm_ckpt";
+    constexpr int64_t COMMITTED = 50;
+    cleanup(log_file, name);
+
+    auto catalog = Catalog::create();
+    add_table(*catalog, name);
+    lsn_t active_begin = INVALID_LSN;
+    storage::HeapTable::TupleId active_row;
+    {
+        storage::StorageManager disk_manager("./test_data");
+        LogManager lm(log_file);
+        storage::BufferPoolManager bpm(TEST_BPM_SIZE, disk_manager, &lm);
+        storage::HeapTable table(name, bpm, make_schema());
+        ASSERT_TRUE(table.create());
+        Writer writer(lm, table, name);
+        for (int64_t i = 0; i < COMMITTED; ++i) {
+            const auto txn = static_cast<txn_id_t>(i + 1);
+            static_cast<void>(writer.control(txn, LogRecordType::BEGIN));
+            static_cast<void>(writer.insert(txn, i));
+            static_cast<void>(writer.control(txn, LogRecordType::COMMIT));
+        }
+        bpm.flush_all_pages();
+
+        const txn_id_t active = COMMITTED + 1;
+        active_begin = writer.control(active, LogRecordType::BEGIN);
+        active_row = writer.insert(active, COMMITTED);
+
+        RecoveryManager rm(bpm, *catalog, lm, RECOVERY_THREADS);
+        ASSERT_TRUE(rm.checkpoint([&] {
+            return std::vector<CheckpointTxn>{{active, active_begin, active_begin + 1, false}};
+        }));
+        lm.flush(true);
+    }
+
+    {
+        storage::StorageManager disk_manager("./test_data");
+        LogManager lm(log_file);
+        storage::BufferPoolManager bpm(TEST_BPM_SIZE, disk_manager, &lm);
+        RecoveryManager rm(bpm, *catalog, lm, RECOVERY_THREADS);
+        ASSERT_TRUE(rm.recover());
+
+        /* BEGIN, INSERT, CHECKPOINT_BEGIN and CHECKPOINT_END of the active transaction */
+        const auto& stats = rm.get_stats();
+        EXPECT_EQ(stats.scan_lsn, active_begin);
+        EXPECT_EQ(stats.records_scanned, 4U);
+        EXPECT_EQ(stats.redo_skipped, 1U); /* The page went to disk after the insert */
+        EXPECT_EQ(stats.losers, 1U);
+
+        storage::HeapTable table(name, bpm, make_schema());
+        executor::Tuple tuple;
+        EXPECT_FALSE(table.get(active_row, tuple));
+        EXPECT_EQ(table.tuple_count(), static_cast<uint64_t>(COMMITTED));
+    }
+
+    cleanup(log_file, name);
+}
+
+/**
+ * @brief Prepared transactions come back PREPARED after a restart: their rows stay
+ * invisible and locked until the coordinator commits or aborts them
+ */
+TEST(RecoveryManagerTests, InDoubtTransactionResolvedAfterRestart) {
+    const std::string log_file = "recovery_in_doubt.log";
+    const std::string name = "rm_in_doubt";
+    cleanup(log_file, name);
+
+    auto catalog = Catalog::create();
+    add_table(*catalog, name);
+    storage::HeapTable::TupleId committed_row;
+    storage::HeapTable::TupleId commit_row;
+    storage::HeapTable::TupleId abort_row;
+    {
+        storage::StorageManager disk_manager("./test_data");
+        LogManager lm(log_file);
+        storage::BufferPoolManager bpm(TEST_BPM_SIZE, disk_manager, &lm);
+        storage::HeapTable table(name, bpm, make_schema());
+        ASSERT_TRUE(table.create());
+        Writer writer(lm, table, name);
+
+        static_cast<void>(writer.control(1, LogRecordType::BEGIN));
+        committed_row = writer.insert(1, 1);
+        static_cast<void>(writer.control(1, LogRecordType::COMMIT));
+        for (txn_id_t txn = 2; txn <= 3; ++txn) {
+            static_cast<void>(writer.control(txn, LogRecordType::BEGIN));
+            (txn == 2 ? commit_row : abort_row) = writer.insert(txn, static_cast<int64_t>(txn));
+            static_cast<void>(writer.control(txn, LogRecordType::PREPARE));
+        }
+        lm.flush(true);
+        bpm.flush_all_pages();
+    }
+
+    storage::StorageManager disk_manager("./test_data");
+    LogManager lm(log_file);
+    storage::BufferPoolManager bpm(TEST_BPM_SIZE, disk_manager, &lm);
+    RecoveryManager rm(bpm, *catalog, lm, RECOVERY_THREADS);
+    ASSERT_TRUE(rm.recover());
+    ASSERT_EQ(rm.in_doubt().size(), 2U);
+
+    transaction::LockManager locks(std::chrono::milliseconds(10), std::chrono::milliseconds(50));
+    transaction::TransactionManager tm(locks, *catalog, bpm, &lm);
+    for (const auto& prepared : rm.in_doubt()) {
+        ASSERT_NE(tm.restore_prepared(prepared, rm.changes_of(prepared.txn_id)), nullptr);
+    }
+    tm.set_next_txn_id(rm.max_txn_id() + 1);
+
+    transaction::Transaction* reader = tm.begin();
+    EXPECT_TRUE(reader->get_snapshot().is_visible(1));
+    EXPECT_FALSE(reader->get_snapshot().is_visible(2));
+    EXPECT_FALSE(reader->get_snapshot().is_visible(3));
+    tm.commit(reader);
+
+    transaction::Transaction* const to_commit = tm.get_transaction(2);
+    transaction::Transaction* const to_abort = tm.get_transaction(3);
+    ASSERT_NE(to_commit, nullptr);
+    ASSERT_NE(to_abort, nullptr);
+    EXPECT_EQ(to_commit->get_state(), transaction::TransactionState::PREPARED);
+    const auto checkpointed = tm.checkpoint_txns();
+    ASSERT_EQ(checkpointed.size(), 2U);
+    EXPECT_TRUE(checkpointed[0].prepared && checkpointed[1].prepared);
+
+    const uint32_t table_id = (*catalog->get_table_by_name(name))->table_id;
+    transaction::Transaction* writer = tm.begin();
+    EXPECT_FALSE(
+        locks.lock_row(writer, table_id, commit_row, transaction::LockMode::EXCLUSIVE));
+    tm.abort(writer);
+
+    tm.commit(to_commit);
+    tm.abort(to_abort);
+    reader = tm.begin();
+    EXPECT_TRUE(reader->get_snapshot().is_visible(2));
+    EXPECT_FALSE(reader->get_snapshot().is_visible(3));
+    tm.commit(reader);
+
+    storage::HeapTable table(name, bpm, make_schema());
+    executor::Tuple tuple;
+    EXPECT_TRUE(table.get(committed_row, tuple));
+    EXPECT_TRUE(table.get(commit_row, tuple));
+    EXPECT_FALSE(table.get(abort_row, tuple)); /* Undone from the rebuilt undo log */
+    EXPECT_TRUE(tm.checkpoint_txns().empty());
+
+    cleanup(log_file, name);
 }
 
 }  // namespace
@@ -5,11 +5,17 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <fstream>
 #include <ios>
+#include <iostream>
+#include <iterator>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -144,6 +150,68 @@ TEST(RecoveryTests, LogRecordVariants) {
     }
 }
 
+TEST(RecoveryTests, LogRecordInsertBatch) {
+    std::vector<HeapTable::TupleId> rids;
+    std::vector<Tuple> tuples;
+    for (uint16_t i = 0; i < 3; ++i) {
+        rids.emplace_back(4, i);
+        std::vector<Value> values;
+        values.emplace_back(Value::make_int64(VAL_42 + i));
+        values.emplace_back(i == 1 ? Value::make_null() : Value::make_text("row"));
+        tuples.emplace_back(std::move(values));
+    }
+
+    LogRecord original(TXN_100, PREV_LSN_99, "batch_table", rids, tuples);
+    original.size_ = original.get_size();
+    std::vector<char> buffer(original.size_);
+    EXPECT_EQ(original.serialize(buffer.data()), original.size_);
+
+    const LogRecord deserialized = LogRecord::deserialize(buffer.data());
+    EXPECT_EQ(deserialized.type_, LogRecordType::INSERT_BATCH);
+    EXPECT_EQ(deserialized.txn_id_, TXN_100);
+    EXPECT_EQ(deserialized.table_name_, "batch_table");
+    ASSERT_EQ(deserialized.rids_.size(), 3U);
+    ASSERT_EQ(deserialized.tuples_.size(), 3U);
+    for (uint16_t i = 0; i < 3; ++i) {
+        EXPECT_EQ(deserialized.rids_[i], HeapTable::TupleId(4, i));
+        EXPECT_EQ(deserialized.tuples_[i].get(0).to_int64(), VAL_42 + i);
+    }
+    EXPECT_TRUE(deserialized.tuples_[1].get(1).is_null());
+    EXPECT_EQ(deserialized.tuples_[2].get(1).as_text(), "row");
+}
+
+TEST(RecoveryTests, LogRecordCompensationAndCheckpoint) {
+    LogRecord clr(TXN_100, PREV_LSN_99, LogRecordType::MARK_DELETE, "clr_table",
+                  {HeapTable::TupleId(3, 7)}, PREV_LSN_49);
+    clr.size_ = clr.get_size();
+    std::vector<char> buffer(clr.size_);
+    EXPECT_EQ(clr.serialize(buffer.data()), clr.size_);
+    const LogRecord clr_out = LogRecord::deserialize(buffer.data());
+    EXPECT_EQ(clr_out.type_, LogRecordType::CLR);
+    EXPECT_EQ(clr_out.undone_type_, LogRecordType::MARK_DELETE);
+    EXPECT_EQ(clr_out.undo_next_lsn_, PREV_LSN_49);
+    EXPECT_EQ(clr_out.table_name_, "clr_table");
+    ASSERT_EQ(clr_out.rids_.size(), 1U);
+    EXPECT_EQ(clr_out.rids_[0], HeapTable::TupleId(3, 7));
+
+    LogRecord end(CUR_LSN_101, {{TXN_50, PREV_LSN_49, PREV_LSN_99, true}},
+                  {{"t.heap", 2, PREV_LSN_49}, {"u.heap", 0, CUR_LSN_101}});
+    end.size_ = end.get_size();
+    buffer.assign(end.size_, 0);
+    EXPECT_EQ(end.serialize(buffer.data()), end.size_);
+    const LogRecord end_out = LogRecord::deserialize(buffer.data());
+    EXPECT_EQ(end_out.type_, LogRecordType::CHECKPOINT_END);
+    EXPECT_EQ(end_out.prev_lsn_, CUR_LSN_101);
+    ASSERT_EQ(end_out.checkpoint_txns_.size(), 1U);
+    EXPECT_EQ(end_out.checkpoint_txns_[0].txn_id, TXN_50);
+    EXPECT_EQ(end_out.checkpoint_txns_[0].first_lsn, PREV_LSN_49);
+    EXPECT_EQ(end_out.checkpoint_txns_[0].last_lsn, PREV_LSN_99);
+    EXPECT_TRUE(end_out.checkpoint_txns_[0].prepared);
+    ASSERT_EQ(end_out.checkpoint_pages_.size(), 2U);
+    EXPECT_EQ(end_out.checkpoint_pages_[1].file_name, "u.heap");
+    EXPECT_EQ(end_out.checkpoint_pages_[1].rec_lsn, CUR_LSN_101);
+}
+
 TEST(RecoveryTests, LogManagerBasic) {
     const std::string log_file = "test_log_basic.log";
     cleanup(log_file);
@@ -173,4 +241,149 @@ TEST(RecoveryTests, LogManagerBasic) {
     cleanup(log_file);
 }
 
+TEST(RecoveryTests, LogManagerGroupCommit) {
+    const std::string log_file = "test_log_group.log";
+    cleanup(log_file);
+
+    constexpr int COMMITTERS = 8;
+    constexpr int COMMITS_EACH = 20;
+    {
+        LogManager log_manager(log_file);
+        log_manager.set_commit_delay(std::chrono::milliseconds(2));
+        log_manager.set_group_size(COMMITTERS);
+        log_manager.run_flush_thread();
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < COMMITTERS; ++t) {
+            threads.emplace_back([&log_manager, t] {
+                for (int i = 0; i < COMMITS_EACH; ++i) {
+                    LogRecord commit(static_cast<txn_id_t>(t), -1, LogRecordType::COMMIT);
+                    const lsn_t lsn = log_manager.append_log_record(commit);
+                    EXPECT_TRUE(log_manager.wait_durable(lsn));
+                    EXPECT_GE(log_manager.get_persistent_lsn(), lsn);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        // Committers shared flushes rather than paying for one each
+        const auto& stats = log_manager.get_stats();
+        EXPECT_EQ(stats.records_flushed.load(), static_cast<uint64_t>(COMMITTERS * COMMITS_EACH));
+        EXPECT_LT(stats.flushes.load(), static_cast<uint64_t>(COMMITTERS * COMMITS_EACH));
+        EXPECT_EQ(stats.fsync_latency.count(), stats.flushes.load());
+        EXPECT_EQ(stats.group_records.count(), stats.flushes.load());
+        EXPECT_GT(stats.group_commits.count(), 0U);
+        log_manager.stop_flush_thread();
+    }
+
+    std::ifstream in(log_file, std::ios::binary | std::ios::ate);
+    EXPECT_GT(in.tellg(), 0);
+    cleanup(log_file);
+}
+
+TEST(RecoveryTests, LogManagerInlineFlush) {
+    const std::string log_file = "test_log_inline.log";
+    cleanup(log_file);
+
+    LogManager log_manager(log_file);
+    LogRecord begin(1, -1, LogRecordType::BEGIN);
+    const lsn_t first = log_manager.append_log_record(begin);
+    EXPECT_EQ(log_manager.get_persistent_lsn(), INVALID_LSN);
+
+    // No flush thread: the waiter writes the group itself
+    EXPECT_TRUE(log_manager.wait_durable(first));
+    EXPECT_EQ(log_manager.get_persistent_lsn(), first);
+
+    // A record larger than the whole buffer still goes through
+    std::vector<Value> values;
+    values.emplace_back(Value::make_text(std::string(LogManager::DEFAULT_BUFFER_SIZE * 2, 'x')));
+    LogRecord big(1, first, LogRecordType::INSERT, "big_table", HeapTable::TupleId(1, 0),
+                  Tuple(std::move(values)));
+    const lsn_t big_lsn = log_manager.append_log_record(big);
+    EXPECT_EQ(log_manager.get_stats().flushes.load(), 1U);
+    LogRecord commit(1, big_lsn, LogRecordType::COMMIT);
+    const lsn_t last = log_manager.append_log_record(commit);
+    log_manager.flush();
+    EXPECT_EQ(log_manager.get_persistent_lsn(), last);
+    EXPECT_EQ(log_manager.get_stats().flushes.load(), 2U);
+    EXPECT_GT(log_manager.get_stats().bytes_flushed.load(),
+              static_cast<uint64_t>(LogManager::DEFAULT_BUFFER_SIZE * 2));
+    cleanup(log_file);
+}
+
+/**
+ * @brief Append benchmark: threads reserving WAL space concurrently.
+ *
+ * Prints append throughput per thread count. Asserts that LSNs are dense and
+ * that the log on disk holds every record in LSN order, large ones included.
+ */
+TEST(RecoveryTests, LogManagerConcurrentAppend) {
+    const std::string log_file = "test_log_append.log";
+    constexpr int APPENDS_EACH = 20000;
+    constexpr int LARGE_EVERY = 5000;
+
+    for (const int threads : {1, 4, 8}) {
+        cleanup(log_file);
+        const auto total = static_cast<size_t>(threads) * APPENDS_EACH;
+        std::vector<int> seen(total, 0);
+        int64_t elapsed = 0;
+        {
+            LogManager log_manager(log_file);
+            log_manager.run_flush_thread();
+
+            const auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back([&log_manager, &seen, t] {
+                    for (int i = 0; i < APPENDS_EACH; ++i) {
+                        std::vector<Value> values;
+                        values.emplace_back(Value::make_int64(i));
+                        if (i % LARGE_EVERY == 0) {
+                            values.emplace_back(Value::make_text(
+                                std::string(LogManager::DEFAULT_BUFFER_SIZE / 2, 'L')));
+                        }
+                        LogRecord record(static_cast<txn_id_t>(t), -1, LogRecordType::INSERT,
+                                         "bench", HeapTable::TupleId(1, 0),
+                                         Tuple(std::move(values)));
+                        const lsn_t lsn = log_manager.append_log_record(record);
+                        seen[static_cast<size_t>(lsn)]++;
+                    }
+                });
+            }
+            for (auto& w : workers) {
+                w.join();
+            }
+            elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+            EXPECT_EQ(log_manager.get_next_lsn(), static_cast<lsn_t>(total));
+            log_manager.flush(true);
+            EXPECT_EQ(log_manager.get_persistent_lsn(), static_cast<lsn_t>(total - 1));
+            EXPECT_EQ(log_manager.get_stats().records_flushed.load(), total);
+            std::cout << "[WalAppend] threads=" << threads << " appends=" << total
+                      << " elapsed_us=" << elapsed
+                      << " buffer_waits=" << log_manager.get_stats().appends_waited.load() << "\n";
+        }
+        EXPECT_EQ(std::count(seen.begin(), seen.end(), 1), static_cast<std::ptrdiff_t>(total));
+
+        std::ifstream in(log_file, std::ios::binary);
+        const std::vector<char> log((std::istreambuf_iterator<char>(in)),
+                                    std::istreambuf_iterator<char>());
+        size_t pos = 0;
+        lsn_t expected = 0;
+        while (pos < log.size()) {
+            const LogRecord record = LogRecord::deserialize(log.data() + pos);
+            ASSERT_EQ(record.lsn_, expected);
+            ASSERT_GT(record.get_size(), 0U);
+            pos += record.get_size();
+            expected++;
+        }
+        EXPECT_EQ(expected, static_cast<lsn_t>(total));
+    }
+    cleanup(log_file);
+}
+
 }  // namespace
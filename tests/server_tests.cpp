@@ -11,14 +11,23 @@
 #include <unistd.h>
 
 #include <array>
+#include <atomic>
+#include <cstring>
 #include <chrono>
+#include <cstdio>
+#include <future>
 #include <memory>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "catalog/catalog.hpp"
+#include "common/cluster_manager.hpp"
 #include "common/config.hpp"
+#include "network/metrics_server.hpp"
+#include "network/rpc_message.hpp"
+#include "network/rpc_server.hpp"
 #include "network/server.hpp"
 #include "storage/buffer_pool_manager.hpp"
 #include "storage/storage_manager.hpp"
@@ -34,8 +43,74 @@ constexpr uint16_t PORT_CONNECT = 6002;
 constexpr uint16_t PORT_STARTUP = 6003;
 constexpr uint16_t PORT_SSL = 6004;
 constexpr uint16_t PORT_INVALID = 6005;
+constexpr uint16_t PORT_EXTENDED = 6006;
+constexpr uint16_t PORT_STREAMING = 6007;
+constexpr uint16_t PORT_COPY = 6008;
+constexpr uint16_t PORT_EVENTS = 6009;
+constexpr uint16_t PORT_METRICS = 6010;
+constexpr uint16_t PORT_COORDINATOR = 6011;
 constexpr size_t STARTUP_PKT_LEN = 8;
 
+/* Frontend message bodies */
+void put_int16(std::string& out, uint16_t val) {
+    const uint16_t net = htons(val);
+    out.append(reinterpret_cast<const char*>(&net), 2);
+}
+
+void put_int32(std::string& out, uint32_t val) {
+    const uint32_t net = htonl(val);
+    out.append(reinterpret_cast<const char*>(&net), 4);
+}
+
+void put_string(std::string& out, const std::string& text) {
+    out.append(text.c_str(), text.size() + 1);
+}
+
+void send_message(int sock, char type, const std::string& body) {
+    std::string msg(1, type);
+    put_int32(msg, static_cast<uint32_t>(body.size() + 4));
+    msg += body;
+    send(sock, msg.data(), msg.size(), 0);
+}
+
+bool recv_exact(int sock, char* buf, size_t count) {
+    size_t total = 0;
+    while (total < count) {
+        const ssize_t n = recv(sock, buf + total, count - total, 0);
+        if (n <= 0) return false;
+        total += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/** @return Type and body of the next backend message; type 0 if the connection closed */
+std::pair<char, std::string> recv_message(int sock) {
+    std::array<char, 5> header{};
+    if (!recv_exact(sock, header.data(), header.size())) return {0, ""};
+    uint32_t len = 0;
+    std::memcpy(&len, header.data() + 1, 4);
+    std::string body(ntohl(len) - 4, '\0');
+    if (!body.empty() && !recv_exact(sock, body.data(), body.size())) return {0, ""};
+    return {header[0], body};
+}
+
+/** @return Message types up to and including ReadyForQuery; DataRow values go to `values` */
+std::string recv_until_ready(int sock, std::vector<std::string>* values = nullptr) {
+    std::string types;
+    while (true) {
+        const auto [type, body] = recv_message(sock);
+        if (type == 0) return types;
+        types.push_back(type);
+        if (type == 'D' && values != nullptr) {
+            uint32_t len = 0;
+            std::memcpy(&len, body.data() + 2, 4);
+            len = ntohl(len);
+            values->push_back(len == 0xFFFFFFFF ? "NULL" : body.substr(6, len));
+        }
+        if (type == 'Z') return types;
+    }
+}
+
 TEST(ServerTests, StatusStrings) {
     auto catalog = Catalog::create();
     StorageManager disk_manager("./test_data");
@@ -213,4 +288,485 @@ TEST(ServerTests, InvalidHandshake) {
     static_cast<void>(server->stop());
 }
 
+TEST(ServerTests, ExtendedQuery) {
+    static_cast<void>(std::remove("./test_data/srv_prep.heap"));
+    auto catalog = Catalog::create();
+    StorageManager disk_manager("./test_data");
+    storage::BufferPoolManager sm(config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    config::Config cfg;
+
+    auto server = Server::create(PORT_EXTENDED, *catalog, sm, cfg, nullptr);
+    ASSERT_TRUE(server->start());
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT_EXTENDED);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    bool connected = false;
+    for (int i = 0; i < 5; ++i) {
+        if (connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+            connected = true;
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_TRUE(connected);
+
+    const std::array<uint32_t, 2> startup = {htonl(static_cast<uint32_t>(STARTUP_PKT_LEN)),
+                                             htonl(196608)};
+    send(sock, startup.data(), startup.size() * 4, 0);
+    EXPECT_EQ(recv_until_ready(sock), "RZ");
+
+    const auto query = [sock](const std::string& sql) {
+        std::string body;
+        put_string(body, sql);
+        send_message(sock, 'Q', body);
+        return recv_until_ready(sock);
+    };
+    EXPECT_EQ(query("CREATE TABLE srv_prep (id BIGINT, name TEXT)"), "CZ");
+    EXPECT_EQ(query("INSERT INTO srv_prep VALUES (1, 'one'), (2, 'two'), (3, 'three')"), "CZ");
+
+    /* Parse once with an int8 parameter, describe it, then execute it twice */
+    std::string parse;
+    put_string(parse, "lookup");
+    put_string(parse, "SELECT name FROM srv_prep WHERE id = $1");
+    put_int16(parse, 1);
+    put_int32(parse, 20);
+    send_message(sock, 'P', parse);
+
+    std::string describe = "S";
+    put_string(describe, "lookup");
+    send_message(sock, 'D', describe);
+
+    const auto bind_execute = [sock](const std::string& value, int16_t format) {
+        std::string bind;
+        put_string(bind, "");
+        put_string(bind, "lookup");
+        put_int16(bind, 1);
+        put_int16(bind, static_cast<uint16_t>(format));
+        put_int16(bind, 1);
+        put_int32(bind, static_cast<uint32_t>(value.size()));
+        bind += value;
+        put_int16(bind, 0);
+        send_message(sock, 'B', bind);
+
+        std::string execute;
+        put_string(execute, "");
+        put_int32(execute, 0);
+        send_message(sock, 'E', execute);
+    };
+    bind_execute("2", 0);
+    const std::string binary_three = {0, 0, 0, 0, 0, 0, 0, 3};
+    bind_execute(binary_three, 1);
+    send_message(sock, 'S', "");
+
+    std::vector<std::string> values;
+    EXPECT_EQ(recv_until_ready(sock, &values), "1tT2DC2DCZ");
+    EXPECT_EQ(values, (std::vector<std::string>{"two", "three"}));
+
+    /* After an error the rest of the batch is skipped up to Sync */
+    std::string bad_bind;
+    put_string(bad_bind, "");
+    put_string(bad_bind, "missing");
+    put_int16(bad_bind, 0);
+    put_int16(bad_bind, 0);
+    put_int16(bad_bind, 0);
+    send_message(sock, 'B', bad_bind);
+    std::string execute;
+    put_string(execute, "");
+    put_int32(execute, 0);
+    send_message(sock, 'E', execute);
+    send_message(sock, 'S', "");
+    EXPECT_EQ(recv_until_ready(sock), "EZ");
+
+    /* The named statement survives the error and DDL in between */
+    EXPECT_EQ(query("CREATE TABLE srv_prep_other (id BIGINT)"), "CZ");
+    values.clear();
+    bind_execute("1", 0);
+    send_message(sock, 'S', "");
+    EXPECT_EQ(recv_until_ready(sock, &values), "2DCZ");
+    EXPECT_EQ(values, (std::vector<std::string>{"one"}));
+
+    std::string close_stmt = "S";
+    put_string(close_stmt, "lookup");
+    send_message(sock, 'C', close_stmt);
+    send_message(sock, 'S', "");
+    EXPECT_EQ(recv_until_ready(sock), "3Z");
+
+    send_message(sock, 'X', "");
+    close(sock);
+    static_cast<void>(server->stop());
+    static_cast<void>(std::remove("./test_data/srv_prep.heap"));
+    static_cast<void>(std::remove("./test_data/srv_prep_other.heap"));
+}
+
+TEST(ServerTests, StreamingPortal) {
+    static_cast<void>(std::remove("./test_data/srv_stream.heap"));
+    auto catalog = Catalog::create();
+    StorageManager disk_manager("./test_data");
+    storage::BufferPoolManager sm(config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    config::Config cfg;
+    cfg.stream_batch_rows = 3;
+
+    auto server = Server::create(PORT_STREAMING, *catalog, sm, cfg, nullptr);
+    ASSERT_TRUE(server->start());
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT_STREAMING);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    bool connected = false;
+    for (int i = 0; i < 5; ++i) {
+        if (connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+            connected = true;
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_TRUE(connected);
+
+    const std::array<uint32_t, 2> startup = {htonl(static_cast<uint32_t>(STARTUP_PKT_LEN)),
+                                             htonl(196608)};
+    send(sock, startup.data(), startup.size() * 4, 0);
+    EXPECT_EQ(recv_until_ready(sock), "RZ");
+
+    const auto query = [sock](const std::string& sql, std::vector<std::string>* values) {
+        std::string body;
+        put_string(body, sql);
+        send_message(sock, 'Q', body);
+        return recv_until_ready(sock, values);
+    };
+    EXPECT_EQ(query("CREATE TABLE srv_stream (id BIGINT)", nullptr), "CZ");
+    EXPECT_EQ(query("INSERT INTO srv_stream VALUES (1), (2), (3), (4), (5), (6), (7)", nullptr),
+              "CZ");
+
+    /* Simple query: every row arrives, sent in batches of three */
+    std::vector<std::string> values;
+    EXPECT_EQ(query("SELECT id FROM srv_stream", &values), "TDDDDDDDCZ");
+    EXPECT_EQ(values, (std::vector<std::string>{"1", "2", "3", "4", "5", "6", "7"}));
+    EXPECT_EQ(query("SELECT id FROM srv_stream WHERE id > 100", nullptr), "CZ");
+
+    std::string parse;
+    put_string(parse, "");
+    put_string(parse, "SELECT id FROM srv_stream WHERE id > $1");
+    put_int16(parse, 0);
+    send_message(sock, 'P', parse);
+    std::string bind;
+    put_string(bind, "");
+    put_string(bind, "");
+    put_int16(bind, 0);
+    put_int16(bind, 1);
+    put_int32(bind, 1);
+    bind += "2";
+    put_int16(bind, 0);
+    send_message(sock, 'B', bind);
+    const auto execute = [sock](uint32_t limit) {
+        std::string body;
+        put_string(body, "");
+        put_int32(body, limit);
+        send_message(sock, 'E', body);
+    };
+
+    /* A row limit suspends the portal; the next Execute resumes where it stopped */
+    execute(2);
+    execute(2);
+    execute(0);
+    execute(0);
+    send_message(sock, 'S', "");
+    values.clear();
+    EXPECT_EQ(recv_until_ready(sock, &values), "12DDsDDsDCCZ");
+    EXPECT_EQ(values, (std::vector<std::string>{"3", "4", "5", "6", "7"}));
+
+    /* Sync outside a transaction drops the suspended portal and its transaction */
+    send_message(sock, 'B', bind);
+    execute(1);
+    send_message(sock, 'S', "");
+    EXPECT_EQ(recv_until_ready(sock), "2DsZ");
+    execute(1);
+    send_message(sock, 'S', "");
+    EXPECT_EQ(recv_until_ready(sock), "EZ");
+    EXPECT_EQ(query("INSERT INTO srv_stream VALUES (8)", nullptr), "CZ");
+
+    send_message(sock, 'X', "");
+    close(sock);
+    static_cast<void>(server->stop());
+    static_cast<void>(std::remove("./test_data/srv_stream.heap"));
+}
+
+TEST(ServerTests, CopyFromStdin) {
+    static_cast<void>(std::remove("./test_data/srv_copy.heap"));
+    auto catalog = Catalog::create();
+    StorageManager disk_manager("./test_data");
+    storage::BufferPoolManager sm(config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    config::Config cfg;
+
+    auto server = Server::create(PORT_COPY, *catalog, sm, cfg, nullptr);
+    ASSERT_TRUE(server->start());
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT_COPY);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    bool connected = false;
+    for (int i = 0; i < 5; ++i) {
+        if (connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+            connected = true;
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_TRUE(connected);
+
+    const std::array<uint32_t, 2> startup = {htonl(static_cast<uint32_t>(STARTUP_PKT_LEN)),
+                                             htonl(196608)};
+    send(sock, startup.data(), startup.size() * 4, 0);
+    EXPECT_EQ(recv_until_ready(sock), "RZ");
+
+    const auto query = [sock](const std::string& sql, std::vector<std::string>* values) {
+        std::string body;
+        put_string(body, sql);
+        send_message(sock, 'Q', body);
+        return recv_until_ready(sock, values);
+    };
+    EXPECT_EQ(query("CREATE TABLE srv_copy (id BIGINT, name TEXT)", nullptr), "CZ");
+
+    /* CopyInResponse, then CopyData split mid-row, then CopyDone */
+    std::string body;
+    put_string(body, "COPY srv_copy FROM STDIN WITH (FORMAT csv)");
+    send_message(sock, 'Q', body);
+    const auto [type, response] = recv_message(sock);
+    EXPECT_EQ(type, 'G');
+    ASSERT_EQ(response.size(), 7U);
+    EXPECT_EQ(response[0], 0);
+    send_message(sock, 'd', "1,a\n2,");
+    send_message(sock, 'd', "b\n3,c\n");
+    send_message(sock, 'c', "");
+    const auto [complete, tag] = recv_message(sock);
+    EXPECT_EQ(complete, 'C');
+    EXPECT_EQ(tag, std::string("COPY 3", 7));
+    EXPECT_EQ(recv_until_ready(sock), "Z");
+
+    std::vector<std::string> values;
+    EXPECT_EQ(query("SELECT id FROM srv_copy", &values), "TDDDCZ");
+    EXPECT_EQ(values, (std::vector<std::string>{"1", "2", "3"}));
+
+    /* CopyFail rolls the whole copy back */
+    send_message(sock, 'Q', body);
+    EXPECT_EQ(recv_message(sock).first, 'G');
+    send_message(sock, 'd', "4,d\n");
+    send_message(sock, 'f', std::string("cancelled", 10));
+    EXPECT_EQ(recv_until_ready(sock), "EZ");
+    EXPECT_EQ(query("SELECT id FROM srv_copy", nullptr), "TDDDCZ");
+
+    send_message(sock, 'X', "");
+    close(sock);
+    static_cast<void>(server->stop());
+    static_cast<void>(std::remove("./test_data/srv_copy.heap"));
+}
+
+TEST(ServerTests, EventLoopConnections) {
+    static_cast<void>(std::remove("./test_data/srv_events.heap"));
+    auto catalog = Catalog::create();
+    StorageManager disk_manager("./test_data");
+    storage::BufferPoolManager sm(config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    config::Config cfg;
+    cfg.io_threads = 2;
+    cfg.worker_threads = 2;
+
+    auto server = Server::create(PORT_EVENTS, *catalog, sm, cfg, nullptr);
+    ASSERT_TRUE(server->start());
+
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT_EVENTS);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    const std::array<uint32_t, 2> startup = {htonl(static_cast<uint32_t>(STARTUP_PKT_LEN)),
+                                             htonl(196608)};
+    std::string select;
+    put_string(select, "SELECT id FROM srv_events");
+
+    /* Far more connections than threads, all open at once */
+    constexpr size_t CLIENTS = 64;
+    std::vector<int> socks;
+    for (size_t i = 0; i < CLIENTS; ++i) {
+        const int sock = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)), 0);
+        send(sock, startup.data(), startup.size() * 4, 0);
+        socks.push_back(sock);
+    }
+    for (const int sock : socks) {
+        EXPECT_EQ(recv_until_ready(sock), "RZ");
+    }
+    EXPECT_EQ(server->get_stats().connections_active.load(), CLIENTS);
+    std::string create;
+    put_string(create, "CREATE TABLE srv_events (id BIGINT)");
+    send_message(socks[0], 'Q', create);
+    EXPECT_EQ(recv_until_ready(socks[0]), "CZ");
+    for (const int sock : socks) {
+        send_message(sock, 'Q', select);
+    }
+    for (const int sock : socks) {
+        EXPECT_EQ(recv_until_ready(sock), "CZ");
+    }
+
+    /* A message split across sends, then several pipelined in one */
+    const int sock = socks[0];
+    std::string msg(1, 'Q');
+    put_int32(msg, static_cast<uint32_t>(select.size() + 4));
+    msg += select;
+    for (const char c : msg) {
+        send(sock, &c, 1, 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(recv_until_ready(sock), "CZ");
+    const std::string pipelined = msg + msg + msg;
+    send(sock, pipelined.data(), pipelined.size(), 0);
+    EXPECT_EQ(recv_until_ready(sock) + recv_until_ready(sock) + recv_until_ready(sock), "CZCZCZ");
+
+    /* Closed connections are dropped by their loop */
+    for (const int fd : socks) {
+        send_message(fd, 'X', "");
+        close(fd);
+    }
+    for (int i = 0; i < 50 && server->get_stats().connections_active.load() != 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(server->get_stats().connections_active.load(), 0U);
+    EXPECT_EQ(server->get_stats().connections_accepted.load(), CLIENTS);
+    static_cast<void>(server->stop());
+    static_cast<void>(std::remove("./test_data/srv_events.heap"));
+}
+
+TEST(ServerTests, CoordinatorQueriesDoNotHoldWorkers) {
+    /* Two data nodes that hold every fragment until released */
+    std::atomic<int> arrived{0};
+    std::promise<void> release;
+    const std::shared_future<void> released = release.get_future().share();
+    RpcServer node1(7732, 16);
+    RpcServer node2(7733, 16);
+    const auto make_handler = [&](RpcServer& node) {
+        return [&node, &arrived, released](const RpcHeader& h, const std::vector<uint8_t>& p,
+                                           int fd) {
+            (void)p;
+            arrived.fetch_add(1);
+            released.wait();
+            QueryResultsReply reply;
+            reply.success = true;
+            reply.schema.add_column("id", common::ValueType::TYPE_INT64);
+            reply.rows.emplace_back(std::vector<common::Value>{common::Value::make_int64(1)});
+            static_cast<void>(
+                node.send_response(fd, h, RpcType::QueryResults, reply.serialize()));
+        };
+    };
+    node1.set_handler(RpcType::ExecuteFragment, make_handler(node1));
+    node2.set_handler(RpcType::ExecuteFragment, make_handler(node2));
+    ASSERT_TRUE(node1.start());
+    ASSERT_TRUE(node2.start());
+
+    auto catalog = Catalog::create();
+    StorageManager disk_manager("./test_data");
+    storage::BufferPoolManager sm(config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    config::Config cfg;
+    cfg.mode = config::RunMode::Coordinator;
+    cfg.worker_threads = 1;
+    cluster::ClusterManager cm(&cfg);
+    cm.register_node("n1", "127.0.0.1", 7732, config::RunMode::Data);
+    cm.register_node("n2", "127.0.0.1", 7733, config::RunMode::Data);
+    auto server = Server::create(PORT_COORDINATOR, *catalog, sm, cfg, &cm);
+    ASSERT_TRUE(server->start());
+
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT_COORDINATOR);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    const std::array<uint32_t, 2> startup = {htonl(static_cast<uint32_t>(STARTUP_PKT_LEN)),
+                                             htonl(196608)};
+    std::string select;
+    put_string(select, "SELECT id FROM t");
+
+    /* One worker thread, yet every client's query reaches the nodes before any is answered */
+    constexpr int CLIENTS = 4;
+    std::vector<int> socks;
+    for (int i = 0; i < CLIENTS; ++i) {
+        const int sock = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)), 0);
+        send(sock, startup.data(), startup.size() * 4, 0);
+        EXPECT_EQ(recv_until_ready(sock), "RZ");
+        socks.push_back(sock);
+    }
+    for (const int sock : socks) {
+        send_message(sock, 'Q', select);
+    }
+    /* Waits behind the first query of its connection */
+    send_message(socks[0], 'Q', select);
+    for (int i = 0; i < 500 && arrived.load() < 2 * CLIENTS; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(arrived.load(), 2 * CLIENTS);
+    release.set_value();
+
+    for (const int sock : socks) {
+        std::vector<std::string> values;
+        EXPECT_EQ(recv_until_ready(sock, &values), "TDDCZ");
+        EXPECT_EQ(values, (std::vector<std::string>{"1", "1"}));
+    }
+    EXPECT_EQ(recv_until_ready(socks[0]), "TDDCZ");
+
+    for (const int sock : socks) {
+        send_message(sock, 'X', "");
+        close(sock);
+    }
+    static_cast<void>(server->stop());
+    node1.stop();
+    node2.stop();
+}
+
+TEST(ServerTests, MetricsEndpoint) {
+    auto catalog = Catalog::create();
+    StorageManager disk_manager("./test_data");
+    storage::BufferPoolManager sm(config::Config::DEFAULT_BUFFER_POOL_SIZE, disk_manager);
+    config::Config cfg;
+    auto server = Server::create(PORT_METRICS, *catalog, sm, cfg, nullptr);
+    ASSERT_TRUE(server->start());
+
+    MetricsServer metrics(0);
+    ASSERT_TRUE(metrics.start());
+    ASSERT_NE(metrics.port(), 0);
+
+    const auto get = [&](const std::string& path) {
+        const int sock = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(metrics.port());
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        EXPECT_EQ(connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)), 0);
+        const std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        send(sock, request.data(), request.size(), 0);
+        std::string response;
+        std::array<char, 4096> buf{};
+        ssize_t n = 0;
+        while ((n = recv(sock, buf.data(), buf.size(), 0)) > 0) {
+            response.append(buf.data(), static_cast<size_t>(n));
+        }
+        close(sock);
+        return response;
+    };
+
+    const std::string scrape = get("/metrics");
+    EXPECT_EQ(scrape.rfind("HTTP/1.0 200 OK\r\n", 0), 0U);
+    EXPECT_NE(scrape.find("Content-Type: text/plain; version=0.0.4"), std::string::npos);
+    EXPECT_NE(scrape.find("# TYPE cloudsql_server_connections_active gauge\n"),
+              std::string::npos);
+    EXPECT_NE(scrape.find("cloudsql_buffer_pool_hit_ratio{pool="), std::string::npos);
+    EXPECT_NE(scrape.find("cloudsql_lock_wait_seconds_count"), std::string::npos);
+    EXPECT_EQ(get("/").rfind("HTTP/1.0 404", 0), 0U);
+    EXPECT_EQ(MetricsServer::respond("POST /metrics HTTP/1.1").rfind("HTTP/1.0 405", 0), 0U);
+
+    metrics.stop();
+    static_cast<void>(server->stop());
+}
+
 }  // namespace
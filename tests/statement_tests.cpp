@@ -5,15 +5,22 @@
 
 #include <gtest/gtest.h>
 
+#include <array>
+#include <chrono>
 #include <cstdint>
+#include <iostream>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "common/arena.hpp"
 #include "common/value.hpp"
+#include "parser/ast_arena.hpp"
 #include "parser/expression.hpp"
+#include "parser/lexer.hpp"
+#include "parser/parser.hpp"
 #include "parser/statement.hpp"
 #include "parser/token.hpp"
 #include "test_utils.hpp"
@@ -143,4 +150,90 @@ TEST(StatementTests, CreateTableStatementComplex) {
                  "CREATE TABLE complex_table (id INT PRIMARY KEY, name TEXT NOT NULL UNIQUE)");
 }
 
+TEST(ParserTests, KeywordsAndZeroCopyTokens) {
+    const std::string sql = "select Selection, 'it''s' FROM t WHERE x >= 12 AND y = 1.5";
+    Lexer lexer(sql);
+    const auto select = lexer.next_token();
+    EXPECT_EQ(select.type(), TokenType::Select);
+    EXPECT_EQ(select.lexeme(), "select");
+    const auto ident = lexer.next_token();
+    EXPECT_EQ(ident.type(), TokenType::Identifier);
+    EXPECT_EQ(ident.lexeme(), "Selection");
+    /* Views into the lexer's copy of the text, not copies of their own */
+    static_cast<void>(lexer.next_token());
+    const auto str = lexer.next_token();
+    EXPECT_EQ(str.type(), TokenType::String);
+    EXPECT_EQ(str.lexeme(), "'it'");
+    EXPECT_EQ(str.as_string(), "it");
+
+    Token number;
+    while ((number = lexer.next_token()).type() != TokenType::Number) {
+    }
+    EXPECT_EQ(number.lexeme(), "12");
+    EXPECT_EQ(number.as_int64(), 12);
+    while ((number = lexer.next_token()).type() != TokenType::Number) {
+    }
+    EXPECT_DOUBLE_EQ(number.as_double(), 1.5);
+}
+
+TEST(ParserTests, ArenaAstThroughput) {
+    const std::array<std::string, 5> queries = {
+        "SELECT id, name FROM users WHERE age > 18 AND name = 'x' ORDER BY id LIMIT 10 OFFSET 5",
+        "INSERT INTO products VALUES (1, 'apple', 100), (2, 'pear', 50)",
+        "UPDATE products SET price = 100, stock = 50 WHERE id = 7",
+        "DELETE FROM users WHERE id < 0",
+        "CREATE TABLE complex_table (id INT NOT NULL UNIQUE, name VARCHAR(32))"};
+    const auto parse = [](const std::string& sql) {
+        return Parser(std::make_unique<Lexer>(sql)).parse_statement();
+    };
+
+    /* Arena and heap nodes make the same statements; a reset frees the arena ones at once */
+    common::Arena arena;
+    for (const auto& sql : queries) {
+        const auto heap = parse(sql);
+        ASSERT_NE(heap, nullptr) << sql;
+        std::unique_ptr<Statement> pooled;
+        {
+            const AstArenaScope scope(arena);
+            EXPECT_EQ(AstArenaScope::current(), &arena);
+            pooled = parse(sql);
+        }
+        EXPECT_EQ(AstArenaScope::current(), nullptr);
+        ASSERT_NE(pooled, nullptr) << sql;
+        EXPECT_EQ(pooled->to_string(), heap->to_string());
+        EXPECT_GT(arena.bytes_used(), 0U);
+        pooled.reset();
+        arena.reset();
+        EXPECT_EQ(arena.bytes_used(), 0U);
+    }
+
+    constexpr int ROUNDS = 2000;
+    const auto time_us = [&](common::Arena* pool) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ROUNDS; ++i) {
+            for (const auto& sql : queries) {
+                std::unique_ptr<Statement> stmt;
+                if (pool != nullptr) {
+                    const AstArenaScope scope(*pool);
+                    stmt = parse(sql);
+                } else {
+                    stmt = parse(sql);
+                }
+                stmt.reset();
+                if (pool != nullptr) pool->reset();
+            }
+        }
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+    };
+    const auto heap_us = time_us(nullptr);
+    const auto arena_us = time_us(&arena);
+    const auto statements = static_cast<double>(ROUNDS * queries.size());
+    std::cout << "[ParserBench] statements=" << ROUNDS * queries.size()
+              << " heap_stmts_per_s=" << statements * 1e6 / static_cast<double>(heap_us + 1)
+              << " arena_stmts_per_s=" << statements * 1e6 / static_cast<double>(arena_us + 1)
+              << "\n";
+}
+
 }  // namespace
@@ -5,6 +5,7 @@
 
 #include <gtest/gtest.h>
 
+#include <stdexcept>
 #include <string>
 
 #include "catalog/catalog.hpp"
@@ -57,4 +58,77 @@ TEST(TransactionManagerTests, Isolation) {
     tm.commit(txn2);
 }
 
+TEST(TransactionManagerTests, CommitSequenceSnapshots) {
+    auto catalog = Catalog::create();
+    storage::StorageManager disk_manager("./test_data");
+    storage::BufferPoolManager bpm(cloudsql::config::Config::DEFAULT_BUFFER_POOL_SIZE,
+                                   disk_manager);
+    LockManager lm;
+    TransactionManager tm(lm, *catalog, bpm, bpm.get_log_manager());
+
+    Transaction* const old_reader = tm.begin();
+    Transaction* const writer = tm.begin();
+    Transaction* const loser = tm.begin();
+    EXPECT_FALSE(old_reader->get_snapshot().is_visible(writer->get_id()));
+
+    tm.commit(writer);
+    tm.abort(loser);
+    Transaction* const new_reader = tm.begin();
+
+    /* Commit order, not id order, decides: the older snapshot never sees the commit */
+    EXPECT_FALSE(old_reader->get_snapshot().is_visible(writer->get_id()));
+    EXPECT_TRUE(new_reader->get_snapshot().is_visible(writer->get_id()));
+    EXPECT_FALSE(new_reader->get_snapshot().is_visible(loser->get_id()));
+    EXPECT_EQ(tm.commit_log().csn(loser->get_id()), CommitLog::ABORTED);
+
+    /* Vacuum may only remove what the oldest running snapshot sees as deleted */
+    EXPECT_EQ(tm.vacuum_horizon(), old_reader->get_snapshot().csn);
+    tm.commit(old_reader);
+    EXPECT_EQ(tm.vacuum_horizon(), new_reader->get_snapshot().csn);
+    tm.commit(new_reader);
+    EXPECT_EQ(tm.vacuum_horizon(), tm.commit_log().snapshot());
+
+    /* Transactions from before a restart count as committed */
+    tm.set_next_txn_id(1000);
+    EXPECT_TRUE(tm.begin()->get_snapshot().is_visible(999));
+    EXPECT_FALSE(tm.begin()->get_snapshot().is_visible(1000));
+}
+
+TEST(TransactionManagerTests, CommitLogTruncation) {
+    CommitLog log;
+    constexpr txn_id_t SEGMENT = CommitLog::SEGMENT_SIZE;
+    for (txn_id_t id = 1; id < 3 * SEGMENT; ++id) {
+        if (id == 7) {
+            log.abort(id);
+        } else if (id != SEGMENT + 5) {
+            static_cast<void>(log.commit(id));
+        }
+    }
+
+    /* A segment goes only once its ids have ended and the horizon sees their commits */
+    log.truncate(SEGMENT - 1, log.snapshot());
+    EXPECT_EQ(log.truncated_below(), 0U);
+    log.truncate(3 * SEGMENT, 1);
+    EXPECT_EQ(log.truncated_below(), 0U);
+    log.truncate(3 * SEGMENT, log.snapshot());
+    EXPECT_EQ(log.truncated_below(), SEGMENT); /* SEGMENT + 5 has no outcome yet */
+    EXPECT_EQ(log.csn(7), CommitLog::FROZEN);
+    EXPECT_TRUE(log.is_visible(SEGMENT - 1, CommitLog::FROZEN));
+    EXPECT_FALSE(log.is_visible(SEGMENT + 5, log.snapshot()));
+
+    /* Ids a ring further on reuse the truncated segment */
+    const txn_id_t wrapped = CommitLog::MAX_SEGMENTS * SEGMENT + 3;
+    EXPECT_TRUE(log.reserve(wrapped));
+    EXPECT_EQ(log.csn(wrapped), CommitLog::IN_PROGRESS);
+    const csn_t csn = log.commit(wrapped);
+    EXPECT_EQ(log.csn(wrapped), csn);
+    EXPECT_EQ(log.csn(3), CommitLog::FROZEN);
+
+    /* ...but not a live one: the commit fails instead of going unrecorded */
+    EXPECT_FALSE(log.reserve(wrapped + SEGMENT));
+    EXPECT_THROW(static_cast<void>(log.commit(wrapped + SEGMENT)), std::runtime_error);
+    EXPECT_EQ(log.snapshot(), csn);
+    EXPECT_EQ(log.csn(SEGMENT + 1), CommitLog::FROZEN + SEGMENT);
+}
+
 }  // namespace